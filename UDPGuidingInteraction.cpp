@@ -92,7 +92,7 @@ UDPGuidingInteraction::~UDPGuidingInteraction() {
 }
 
 
-bool UDPGuidingInteraction::SendToUDPPort(void *buf, wxUint32 len) {
+bool UDPGuidingInteraction::SendToUDPPort(const void *buf, wxUint32 len) {
     while (!sendSocket->WaitForWrite()) {
         LOG_INFO("Socket not ready to write!");
     }
@@ -55,7 +55,7 @@ private:
     wxDatagramSocket* receiveSocket;
 
 
-    void* last_sent_buffer;
+    const void* last_sent_buffer;
     wxUint32 last_sent_buffer_length;
 
 
@@ -63,7 +63,7 @@ public:
     UDPGuidingInteraction(wxString host, wxString sendPort, wxString rcvPort);
     ~UDPGuidingInteraction();
 
-    bool SendToUDPPort(void * buf, wxUint32 len);
+    bool SendToUDPPort(const void * buf, wxUint32 len);
 	bool ReceiveFromUDPPort(void * buf, wxUint32 len);
 };
 
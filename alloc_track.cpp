@@ -0,0 +1,167 @@
+/*
+ *  alloc_track.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#ifdef PHD_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+# define PHD_THREAD_LOCAL __declspec(thread)
+#else
+# define PHD_THREAD_LOCAL __thread
+#endif
+
+// static storage, so zero before any constructor runs: operator new may be
+// called during static initialization
+static std::atomic<long long> s_counts[NUM_ALLOC_TAGS];
+static std::atomic<long long> s_lastCycle[NUM_ALLOC_TAGS];
+static long long s_cycleMark[NUM_ALLOC_TAGS];      // main thread only
+
+static PHD_THREAD_LOCAL int t_tag = ALLOC_TAG_OTHER;
+
+void *operator new(std::size_t size)
+{
+    s_counts[t_tag].fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+bool AllocTrack::IsEnabled()
+{
+    return true;
+}
+
+void AllocTrack::GetCounts(AllocCounts *counts)
+{
+    counts->total = 0;
+    for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+    {
+        counts->tag[i] = s_counts[i].load(std::memory_order_relaxed);
+        counts->total += counts->tag[i];
+    }
+}
+
+void AllocTrack::GetLastCycle(AllocCounts *counts)
+{
+    counts->total = 0;
+    for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+    {
+        counts->tag[i] = s_lastCycle[i].load(std::memory_order_relaxed);
+        counts->total += counts->tag[i];
+    }
+}
+
+void AllocTrack::CycleDone()
+{
+    for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+    {
+        long long n = s_counts[i].load(std::memory_order_relaxed);
+        s_lastCycle[i].store(n - s_cycleMark[i], std::memory_order_relaxed);
+        s_cycleMark[i] = n;
+    }
+}
+
+int AllocTrack::EnterTag(int tag)
+{
+    int prev = t_tag;
+    t_tag = tag;
+    return prev;
+}
+
+void AllocTrack::LeaveTag(int prev)
+{
+    t_tag = prev;
+}
+
+#else // PHD_COUNT_ALLOCATIONS
+
+bool AllocTrack::IsEnabled()
+{
+    return false;
+}
+
+void AllocTrack::GetCounts(AllocCounts *counts)
+{
+    memset(counts, 0, sizeof(*counts));
+}
+
+void AllocTrack::GetLastCycle(AllocCounts *counts)
+{
+    memset(counts, 0, sizeof(*counts));
+}
+
+void AllocTrack::CycleDone()
+{
+}
+
+int AllocTrack::EnterTag(int tag)
+{
+    return ALLOC_TAG_OTHER;
+}
+
+void AllocTrack::LeaveTag(int prev)
+{
+}
+
+#endif // PHD_COUNT_ALLOCATIONS
+
+const char *AllocTrack::TagName(int tag)
+{
+    if (tag >= 0 && tag < NUM_PERF_STAGES)
+        return PerfStats::StageName((PerfStage) tag);
+    switch (tag)
+    {
+    case ALLOC_TAG_DEBUG_LOG: return "debug_log";
+    default: return "other";
+    }
+}
@@ -0,0 +1,344 @@
+/*
+ *  ao_fast_loop.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+wxDEFINE_EVENT(AO_FAST_LOOP_DONE_EVENT, wxThreadEvent);
+
+AOFastLoopRequest::AOFastLoopRequest()
+    : exposure(50),
+    roiSize(16),
+    gain(0.7),
+    bumpInterval(1000)
+{
+}
+
+AOFastLoopStatus::AOFastLoopStatus()
+    : state(AO_FAST_LOOP_IDLE),
+    frames(0),
+    lost(0),
+    bumps(0),
+    rateHz(0.0),
+    cycleMs(0.0),
+    rmsPx(0.0)
+{
+}
+
+class AOFastLoopThread : public wxThread
+{
+    AOFastLoopRequest m_req;
+    StepGuider *m_ao;
+    PHD_Point m_lock;
+    PHD_Point m_star;
+
+public:
+    AOFastLoopThread(const AOFastLoopRequest& req, StepGuider *ao, const PHD_Point& lock, const PHD_Point& star)
+        : wxThread(wxTHREAD_JOINABLE), m_req(req), m_ao(ao), m_lock(lock), m_star(star) { }
+
+    ExitCode Entry();
+};
+
+// s_status is shared with the loop thread and protected by s_lock; the
+// remaining state is only touched in the main thread
+static wxCriticalSection s_lock;
+static AOFastLoopStatus s_status;
+static AO_FAST_LOOP_STATE s_result;
+static wxString s_message;
+static volatile bool s_stop;
+static AOFastLoopThread *s_thread;
+
+wxThread::ExitCode AOFastLoopThread::Entry()
+{
+    PerfTrace::SetThreadName("ao fast loop");
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, "ao fast loop");
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("ao fast loop CoInitializeEx returns %x\n", hr));
+#endif
+
+    // frames in a row the star can be missing from before the loop gives up,
+    // and the time constant of the average AO position the bumps go by
+    enum { MAX_LOST = 10, AVERAGE_MS = 3000 };
+
+    Debug.Write(wxString::Format("AOFastLoop: start exposure=%d roi=%d gain=%.2f bump_interval=%d lock=(%.2f,%.2f)\n",
+        m_req.exposure, m_req.roiSize, m_req.gain, m_req.bumpInterval, m_lock.X, m_lock.Y));
+
+    pCamera->InitCapture();
+
+    wxRect const frame(pCamera->FullSize);
+    int const size = m_req.roiSize;
+
+    wxPoint const aoPos = m_ao->GetAoPos();
+    PHD_Point avgOffset((double) aoPos.x, (double) aoPos.y);
+    PHD_Point pos(m_star);
+
+    usImage img;
+    Star star;
+    wxStopWatch clock;
+    double nextBump = m_req.bumpInterval;
+    double intervalStart = 0.0;
+    int intervalFrames = 0;
+    double intervalSq = 0.0;
+    double cycleTotal = 0.0;
+    int frames = 0;
+    int lostRun = 0;
+    bool err = false;
+    wxString errMsg;
+
+    while (!s_stop)
+    {
+        double const t0 = clock.TimeInMicro().ToDouble() / 1000.0;
+
+        wxRect roi(ROUND(pos.X) - size, ROUND(pos.Y) - size, 2 * size + 1, 2 * size + 1);
+        roi.Intersect(frame);
+
+        if (GuideCamera::Capture(pCamera, m_req.exposure, img, CAPTURE_SUBTRACT_DARK | CAPTURE_STATS_SUBFRAME, roi))
+        {
+            errMsg = _("The camera capture failed");
+            err = true;
+            break;
+        }
+        pCamera->CaptureComplete();
+
+        if (!star.Find(&img, size, ROUND(pos.X), ROUND(pos.Y), Star::FIND_CENTROID))
+        {
+            {
+                wxCriticalSectionLocker lck(s_lock);
+                ++s_status.lost;
+            }
+            if (++lostRun >= MAX_LOST)
+            {
+                errMsg = _("The guide star was lost");
+                err = true;
+                break;
+            }
+            continue;
+        }
+        lostRun = 0;
+        pos.SetXY(star.X, star.Y);
+
+        PHD_Point const offset(star.X - m_lock.X, star.Y - m_lock.Y);
+        if (m_ao->FastLoopMove(PHD_Point(offset.X * m_req.gain, offset.Y * m_req.gain)) != Mount::MOVE_OK)
+        {
+            errMsg = _("The AO step failed");
+            err = true;
+            break;
+        }
+
+        double const t1 = clock.TimeInMicro().ToDouble() / 1000.0;
+
+        double const alpha = wxMin(1.0, (t1 - t0) / AVERAGE_MS);
+        wxPoint const ao = m_ao->GetAoPos();
+        avgOffset.X += alpha * (ao.x - avgOffset.X);
+        avgOffset.Y += alpha * (ao.y - avgOffset.Y);
+
+        ++frames;
+        cycleTotal += t1 - t0;
+        ++intervalFrames;
+        intervalSq += offset.X * offset.X + offset.Y * offset.Y;
+
+        if (t1 < nextBump)
+            continue;
+
+        // the bump only queues a move on the secondary mount's thread
+        bool bumped = false;
+        if (pSecondaryMount && pSecondaryMount->IsConnected())
+        {
+            if (m_ao->FastLoopBump(avgOffset))
+                Debug.Write("AOFastLoop: bump update failed\n");
+            else
+                bumped = true;
+        }
+
+        {
+            wxCriticalSectionLocker lck(s_lock);
+            s_status.frames = frames;
+            if (bumped)
+                ++s_status.bumps;
+            s_status.rateHz = intervalFrames * 1000.0 / wxMax(t1 - intervalStart, 1.0);
+            s_status.cycleMs = cycleTotal / frames;
+            s_status.rmsPx = sqrt(intervalSq / intervalFrames);
+        }
+
+        nextBump = t1 + m_req.bumpInterval;
+        intervalStart = t1;
+        intervalFrames = 0;
+        intervalSq = 0.0;
+    }
+
+    AO_FAST_LOOP_STATE const result = err ? AO_FAST_LOOP_FAILED : AO_FAST_LOOP_STOPPED;
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.frames = frames;
+        if (frames)
+            s_status.cycleMs = cycleTotal / frames;
+        s_result = result;
+        s_message = errMsg;
+    }
+
+    Debug.Write(wxString::Format("AOFastLoop: done result=%d frames=%d cycle=%.1f ms %s\n", result, frames,
+        frames ? cycleTotal / frames : 0.0, errMsg));
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    wxQueueEvent(pFrame, new wxThreadEvent(wxEVT_THREAD, AO_FAST_LOOP_DONE_EVENT));
+
+    return (ExitCode) 0;
+}
+
+bool AOFastLoop::Start(const AOFastLoopRequest& req, wxString *error)
+{
+    if (s_thread)
+    {
+        *error = _("The AO fast loop is already running");
+        return true;
+    }
+    StepGuider *ao = pMount && pMount->IsStepGuider() ? static_cast<StepGuider *>(pMount) : NULL;
+    if (!ao || !ao->IsConnected())
+    {
+        *error = _("Please connect to an AO first");
+        return true;
+    }
+    if (!ao->IsCalibrated() || !ao->GetGuidingEnabled())
+    {
+        *error = _("The AO must be calibrated and guiding enabled");
+        return true;
+    }
+    if (!pCamera || !pCamera->Connected)
+    {
+        *error = _("Please connect to a camera first");
+        return true;
+    }
+    if (pFrame->CaptureActive || DarkBuilder::IsActive() || CameraTest::IsActive() || PulseProfiler::IsActive() ||
+        CaptureNode::IsRunning())
+    {
+        *error = _("Cannot start the AO fast loop while capture is active");
+        return true;
+    }
+    PHD_Point const lock = pFrame->pGuider->LockPosition();
+    PHD_Point const star = pFrame->pGuider->CurrentPosition();
+    if (!lock.IsValid() || !star.IsValid())
+    {
+        *error = _("The AO fast loop needs a guide star and a lock position");
+        return true;
+    }
+    if (req.exposure < 1 || req.roiSize < 4 || req.gain <= 0.0 || req.gain > 1.0 || req.bumpInterval < 100)
+    {
+        *error = _("Invalid AO fast loop parameters");
+        return true;
+    }
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status = AOFastLoopStatus();
+        s_status.state = AO_FAST_LOOP_RUNNING;
+        s_result = AO_FAST_LOOP_RUNNING;
+        s_message.clear();
+    }
+    s_stop = false;
+
+    AOFastLoopThread *thread = new AOFastLoopThread(req, ao, lock, star);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = AO_FAST_LOOP_IDLE;
+        *error = _("Could not start the AO fast loop thread");
+        return true;
+    }
+
+    s_thread = thread;
+
+    pFrame->StatusMsgNoTimeout(_("AO fast loop running"));
+
+    return false;
+}
+
+void AOFastLoop::Stop(void)
+{
+    if (s_thread)
+    {
+        Debug.AddLine("AOFastLoop: stop requested");
+        s_stop = true;
+    }
+}
+
+bool AOFastLoop::IsActive(void)
+{
+    return s_thread != NULL;
+}
+
+AOFastLoopStatus AOFastLoop::GetStatus(void)
+{
+    wxCriticalSectionLocker lck(s_lock);
+    return s_status;
+}
+
+void AOFastLoop::OnLoopDone(void)
+{
+    if (!s_thread)
+        return;
+
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+
+    AO_FAST_LOOP_STATE result;
+    wxString msg;
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = result = s_result;
+        s_status.message = msg = s_message;
+    }
+
+    pFrame->StatusMsg(result == AO_FAST_LOOP_FAILED ? msg : _("AO fast loop stopped"));
+    pFrame->UpdateStateLabels();
+
+    EvtServer.NotifyAOFastLoopStopped(result != AO_FAST_LOOP_FAILED, msg);
+}
+
+void AOFastLoop::Shutdown(void)
+{
+    if (!s_thread)
+        return;
+
+    Debug.AddLine("AOFastLoop: waiting for loop thread to exit");
+    s_stop = true;
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+}
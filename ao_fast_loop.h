@@ -0,0 +1,91 @@
+/*
+ *  ao_fast_loop.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AO_FAST_LOOP_INCLUDED
+#define AO_FAST_LOOP_INCLUDED
+
+struct AOFastLoopRequest
+{
+    int exposure;       // exposure (ms)
+    int roiSize;        // the square captured around the star extends this far (pixels) from it
+    double gain;        // fraction of the star's offset from the lock position corrected each frame
+    int bumpInterval;   // ms between mount bump updates
+
+    AOFastLoopRequest();
+};
+
+enum AO_FAST_LOOP_STATE
+{
+    AO_FAST_LOOP_IDLE,
+    AO_FAST_LOOP_RUNNING,
+    AO_FAST_LOOP_STOPPED,
+    AO_FAST_LOOP_FAILED,
+};
+
+struct AOFastLoopStatus
+{
+    AO_FAST_LOOP_STATE state;
+    int frames;         // frames the star was found in
+    int lost;           // frames the star was not found in
+    int bumps;          // bump updates
+    double rateHz;      // frames per second over the last bump interval
+    double cycleMs;     // mean time per frame, capture and step
+    double rmsPx;       // rms offset of the star from the lock position over the last bump interval
+    wxString message;
+
+    AOFastLoopStatus();
+};
+
+wxDECLARE_EVENT(AO_FAST_LOOP_DONE_EVENT, wxThreadEvent);
+
+// Guides with the AO alone at the highest frame rate the camera can manage,
+// in place of the normal guide loop. A thread of its own captures a small
+// square around the guide star, finds its centroid, and steps the AO
+// straight back toward the lock position, with none of the image processing,
+// display, guide algorithms or per-frame event handling of the normal loop.
+// The AO position is averaged over the frames, and every bumpInterval ms the
+// mount bumps are updated from the average and sent to the secondary mount's
+// thread, so a slow mount move never holds up an AO frame. The loop needs a
+// calibrated AO, a lock position and the normal loop stopped.
+class AOFastLoop
+{
+public:
+    static bool Start(const AOFastLoopRequest& req, wxString *error);  // returns true on error
+    static void Stop(void);
+    static bool IsActive(void);        // running or not yet finalized
+    static AOFastLoopStatus GetStatus(void);
+    static void OnLoopDone(void);
+    static void Shutdown(void);        // stop and wait for the loop thread
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ *  auto_exposure.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+#include "auto_exposure.h"
+
+// exposures compared by BestExposure, log spaced
+static const int ScanSteps = 40;
+
+// offsets more than this many rms from the mean are not used
+static const double OutlierLimit = 5.0;
+
+AutoExposureModel::AutoExposureModel()
+{
+    Reset();
+}
+
+void AutoExposureModel::Reset(void)
+{
+    m_clock.Start();
+    m_lastFrameTime = -1;
+    m_samples = 0;
+    m_exposure = 0.0;
+    m_overhead = 0.0;
+    m_snr = 0.0;
+    m_centroidVar = 0.0;
+    m_meanOffset.SetXY(0.0, 0.0);
+    m_offsetVar = 0.0;
+}
+
+void AutoExposureModel::AddFrame(int exposure, double snr, double hfd, const PHD_Point& offset)
+{
+    long const now = m_clock.Time();
+    long const cycle = m_lastFrameTime >= 0 ? now - m_lastFrameTime : -1;
+    m_lastFrameTime = now;
+
+    if (exposure <= 0 || snr <= 0.0 || hfd <= 0.0 || !offset.IsValid())
+        return;
+
+    // a gap much longer than a cycle is a pause, not overhead
+    double const expected = m_samples ? m_exposure + m_overhead : (double) exposure;
+    if (cycle < exposure || cycle > 3.0 * expected + 2000.0)
+        return;
+
+    // dithers and settling show up as offsets far outside the usual spread
+    PHD_Point const dev = offset - m_meanOffset;
+    if (IsValid() && dev.X * dev.X + dev.Y * dev.Y > OutlierLimit * OutlierLimit * m_offsetVar)
+        return;
+
+    double const w = 1.0 / (double) wxMin(m_samples + 1, (unsigned int) MAX_WEIGHT);
+    ++m_samples;
+
+    // the centroid error of a well sampled star is about sigma / SNR per
+    // axis, and sigma = HFD / 2.355 for a gaussian profile
+    double const sigma = hfd / 2.355 / snr;
+    double const centroidVar = 2.0 * sigma * sigma;
+
+    // scale what was seen at the previous exposure to this one before mixing
+    if (m_samples > 1 && m_exposure != exposure)
+    {
+        m_snr *= sqrt(exposure / m_exposure);
+        m_centroidVar *= m_exposure / exposure;
+    }
+    m_exposure = exposure;
+
+    m_overhead += w * ((double)(cycle - exposure) - m_overhead);
+    m_snr += w * (snr - m_snr);
+    m_centroidVar += w * (centroidVar - m_centroidVar);
+
+    m_meanOffset.SetXY(m_meanOffset.X + w * dev.X, m_meanOffset.Y + w * dev.Y);
+    m_offsetVar += w * ((1.0 - w) * (dev.X * dev.X + dev.Y * dev.Y) - m_offsetVar);
+}
+
+double AutoExposureModel::Age(double exposure) const
+{
+    // seconds from the middle of an exposure to the mount applying the
+    // correction, plus half the cycle the correction then stands for
+    return (exposure + 1.5 * m_overhead) / 1000.0;
+}
+
+double AutoExposureModel::SNR(double exposure) const
+{
+    return m_exposure > 0.0 ? m_snr * sqrt(exposure / m_exposure) : 0.0;
+}
+
+double AutoExposureModel::CentroidNoise(double exposure) const
+{
+    return exposure > 0.0 ? sqrt(m_centroidVar * m_exposure / exposure) : 0.0;
+}
+
+double AutoExposureModel::WanderRate(void) const
+{
+    // each offset holds the noise of two measurements, the one that set the
+    // last correction and its own, plus the wander over a cycle
+    double const cycle = (m_exposure + m_overhead) / 1000.0;
+    if (cycle <= 0.0)
+        return 0.0;
+    return wxMax(0.0, m_offsetVar - 2.0 * m_centroidVar) / cycle;
+}
+
+double AutoExposureModel::DriftRate(void) const
+{
+    double const age = Age(m_exposure);
+    return age > 0.0 ? m_meanOffset.Distance() / age : 0.0;
+}
+
+double AutoExposureModel::PredictedError(double exposure) const
+{
+    if (exposure <= 0.0 || m_exposure <= 0.0)
+        return 0.0;
+
+    double const noise = CentroidNoise(exposure);
+    double const age = Age(exposure);
+    double const drift = DriftRate() * age;
+
+    return sqrt(noise * noise + WanderRate() * age + drift * drift);
+}
+
+int AutoExposureModel::BestExposure(int minExp, int maxExp, double minSNR) const
+{
+    if (minExp >= maxExp)
+        return minExp;
+
+    double const ratio = pow((double) maxExp / (double) minExp, 1.0 / (ScanSteps - 1));
+
+    double best = (double) maxExp;
+    double bestErr = -1.0;
+
+    double e = (double) minExp;
+    for (int i = 0; i < ScanSteps; i++, e *= ratio)
+    {
+        double const exposure = i == ScanSteps - 1 ? (double) maxExp : e;
+        if (SNR(exposure) < minSNR)
+            continue;
+        double const err = PredictedError(exposure);
+        if (bestErr < 0.0 || err < bestErr)
+        {
+            best = exposure;
+            bestErr = err;
+        }
+    }
+
+    return (int) floor(best + 0.5);
+}
@@ -0,0 +1,95 @@
+/*
+ *  auto_exposure.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef AUTO_EXPOSURE_H_INCLUDED
+#define AUTO_EXPOSURE_H_INCLUDED
+
+// Predicts the guide error for a range of exposure durations from what the
+// guide frames show at the current one, so auto exposure can choose the
+// exposure that corrects best rather than just reaching a target SNR.
+//
+// The error at exposure E is modeled as
+//
+//   V(E) = a / E + q * A(E) + r^2 * A(E)^2,    A(E) = E + 1.5 * O
+//
+// where a / E is the centroid noise (the SNR grows as sqrt(E)), q is the
+// rate the star wanders (seeing, tracking noise) as a random walk, r is the
+// steady drift the loop lags behind, O is the overhead per cycle that is not
+// exposure (download, processing, mount moves, time lapse) and A(E) is the
+// mean age of the measurement that the mount is following during a cycle.
+// The overhead is the measured cycle time less the exposure, so a slow
+// download shifts the trade-off toward shorter exposures when the drift
+// dominates and costs nothing extra when the random walk does.
+class AutoExposureModel
+{
+    enum { MIN_SAMPLES = 10, MAX_WEIGHT = 20 };
+
+    wxStopWatch m_clock;
+    long m_lastFrameTime;       // ms on m_clock
+    unsigned int m_samples;
+    double m_exposure;          // ms, of the last frame
+    double m_overhead;          // ms
+    double m_snr;
+    double m_centroidVar;       // px^2 at m_exposure
+    PHD_Point m_meanOffset;     // px
+    double m_offsetVar;         // px^2, about the mean
+
+    double Age(double exposure) const;
+
+public:
+    AutoExposureModel();
+
+    void Reset(void);
+
+    // add a guide frame; offset is from the lock position in pixels
+    void AddFrame(int exposure, double snr, double hfd, const PHD_Point& offset);
+
+    bool IsValid(void) const { return m_samples >= MIN_SAMPLES; }
+    unsigned int Samples(void) const { return m_samples; }
+
+    double OverheadMs(void) const { return m_overhead; }
+    double SNR(double exposure) const;
+    double CentroidNoise(double exposure) const;    // rms px
+    double WanderRate(void) const;                  // px^2 per second
+    double DriftRate(void) const;                   // px per second
+
+    // rms error predicted at an exposure, px
+    double PredictedError(double exposure) const;
+
+    // the exposure in [minExp, maxExp] with the least predicted error whose
+    // SNR is at least minSNR, or maxExp if none reach it
+    int BestExposure(int minExp, int maxExp, double minSNR) const;
+};
+
+#endif // AUTO_EXPOSURE_H_INCLUDED
@@ -36,8 +36,10 @@
 #include "phd.h"
 #include "backlash_comp.h"
 
-static const unsigned int HISTORY_SIZE = 10;
+#include <wx/tokenzr.h>
+
 static const unsigned int MAX_COMP_AMOUNT = 8000;             // max pulse in ms
+static const double MODEL_ALPHA = 0.1;                        // weight of each new reversal once the model has settled
 
 BacklashComp::BacklashComp(Mount *theMount)
 {
@@ -45,6 +47,7 @@ BacklashComp::BacklashComp(Mount *theMount)
     m_pScope = reinterpret_cast<Scope *>(theMount);
     int lastAmt = pConfig->Profile.GetInt("/" + m_pMount->GetMountClassName() + "/DecBacklashPulse", 0);
     SetCompValues(lastAmt, false);
+    SeedModel(true);
     if (m_pulseWidth > 0)
         m_compActive = pConfig->Profile.GetBoolean("/" + m_pMount->GetMountClassName() + "/BacklashCompEnabled", false);
     else
@@ -87,6 +90,7 @@ void BacklashComp::SetBacklashPulse(int ms)
     if (m_pulseWidth != ms)
     {
         SetCompValues(ms, false);
+        SeedModel(false);           // a new amount, measured or entered, replaces what was learned
         pFrame->NotifyGuidingParam("Backlash comp amount", m_pulseWidth);
         Debug.Write(wxString::Format("BLC: Comp pulse set to %d ms\n", m_pulseWidth));
     }
@@ -112,6 +116,7 @@ void BacklashComp::ResetBaseline()
     {
         m_lastDirection = NONE;
         m_justCompensated = false;
+        m_lastCell = NULL;
         Debug.Write("BLC: Last direction was reset\n");
     }
 }
@@ -119,71 +124,117 @@ void BacklashComp::ResetBaseline()
 void BacklashComp::_TrackBLCResults(double yDistance, double minMove, double yRate)
 {
     assert(m_justCompensated); // caller checks this
-        
-    // The previous Dec correction included a BLC
+    assert(m_lastCell);
 
-    // Record the history even if residual error is zero. Sign convention has nothing to do with N or S direction - only whether we 
-    // needed more correction (+) or less (-)
-    GUIDE_DIRECTION dir = yDistance > 0.0 ? DOWN : UP;
-    yDistance = fabs(yDistance);
-    double miss;
-    if (dir == m_lastDirection)
-        miss = yDistance;            // + => we needed more of the same, under-shoot
-    else
-        miss = -yDistance;           // over-shoot
-    minMove = fmax(minMove, 0);         // Algo w/ no min-move returns -1
-    if (m_residualOffsets.GetCount() == HISTORY_SIZE)
+    if (pFrame->InDitherRecovery())
     {
-        m_residualOffsets.RemoveAt(0);
+        // the offset after a dither is mostly the dither itself, not a miss of the comp pulse
+        Debug.Write("BLC: dither recovery, backlash model not updated\n");
+        m_justCompensated = false;
+        m_lastCell = NULL;
+        return;
     }
-    m_residualOffsets.Add(miss);
 
-    if (yDistance >= minMove)           // Don't adjust for a residual error < min_move_equivalent
+    // The previous Dec correction included a BLC, so the offset now says how far the pulse fell short of
+    // the backlash (+) or went past it (-). An offset inside min-move is noise and says the pulse was right.
+    GUIDE_DIRECTION dir = yDistance > 0.0 ? DOWN : UP;
+    minMove = fmax(minMove, 0);         // Algo w/ no min-move returns -1
+    double miss = fabs(yDistance) >= minMove ? fabs(yDistance) : 0.0;
+    if (dir != m_lastDirection)
+        miss = -miss;
+
+    double observed = wxMax(0.0, wxMin((double) m_adjustmentCeiling, m_lastCompAmount + miss / yRate));
+
+    // Running mean that starts out as an average over the first reversals and then forgets, so the
+    // estimate follows the mount as the temperature changes through the night
+    BacklashModelCell& cell = *m_lastCell;
+    double alpha = wxMax(MODEL_ALPHA, 1.0 / (cell.count + 2));
+    double err = observed - cell.ms;
+    cell.ms += alpha * err;
+    cell.var = (1.0 - alpha) * (cell.var + alpha * err * err);
+    ++cell.count;
+
+    Debug.Write(wxString::Format("BLC: %s reversal, %s pier, comp %d ms missed by %.1f px, estimate now %.0f +/- %.0f ms (%d)\n",
+        m_lastDirection == NORTH ? "North" : "South", cell.side == PIER_SIDE_EAST ? "East" : cell.side == PIER_SIDE_WEST ? "West" : "unknown",
+        m_lastCompAmount, miss, cell.ms, sqrt(cell.var), cell.count));
+
+    pConfig->Profile.SetDouble(ModelKey(m_lastDirection, cell.side), cell.ms);
+
+    m_justCompensated = false;
+    m_lastCell = NULL;
+}
+
+// "blc1", the last Dec direction, then the estimate, spread and count of each
+// model cell. Only the estimates are kept in the profile; the rest says how
+// far a restored model can be trusted, and the direction which side of the
+// backlash the gears are on.
+wxString BacklashComp::SaveState() const
+{
+    wxString s = wxString::Format("blc1 %d", m_lastDirection);
+    for (int d = 0; d < 2; d++)
+        for (int c = 0; c < 3; c++)
+            s += wxString::Format(" %.6g %.6g %d", m_model[d][c].ms, m_model[d][c].var, m_model[d][c].count);
+    return s;
+}
+
+bool BacklashComp::RestoreState(const wxString& state)
+{
+    wxStringTokenizer tok(state, " ");
+    long dir;
+    if (tok.GetNextToken() != "blc1" || !tok.GetNextToken().ToLong(&dir))
+        return true;
+
+    BacklashModelCell model[2][3];
+    for (int d = 0; d < 2; d++)
     {
-        // Compute the average residual error
-        int numPoints = m_residualOffsets.GetCount();
-        double avgMiss = 0.;
-        for (int inx = 0; inx < numPoints; inx++)
-            avgMiss += m_residualOffsets.Item(inx);
-        avgMiss = avgMiss / numPoints;
-
-        if (abs(avgMiss) > minMove)                        // Don't make micro-adjustments
+        for (int c = 0; c < 3; c++)
         {
-            double corr = (int)floor(fabs(avgMiss / yRate) + 0.5);
-            int nominalBLC;
-            int newBLC;
-            if (miss >= 0)                                  // We under-shot the target
-            {
-                if (avgMiss > 0)
-                    nominalBLC = m_pulseWidth + corr;
-                else
-                    nominalBLC = m_pulseWidth;              // Need more evidence of under-shooting
-                // Don't increase by more than 10% or go above ceiling
-                newBLC = ROUND(fmin(m_pulseWidth * 1.1, wxMin(m_adjustmentCeiling, nominalBLC)));
-            }
-            else
-            {                                              // we over-shot the target
-                if (avgMiss < 0)
-                    nominalBLC = m_pulseWidth - corr;
-                else
-                    nominalBLC = m_pulseWidth;            // Need more evidence of over-shooting
-                // Don't decrease by more than 20% or go below zero
-                newBLC = ROUND(fmax(0.8 * m_pulseWidth, wxMax(0, nominalBLC)));
-            }
-
-            if (newBLC != m_pulseWidth && numPoints > 2)
-                m_residualOffsets.RemoveAt(0);               // Don't let initial big deflection dominate adjustments
-            if (newBLC != m_pulseWidth)
+            BacklashModelCell& cell = model[d][c];
+            long count;
+            if (!tok.GetNextToken().ToCDouble(&cell.ms) || !tok.GetNextToken().ToCDouble(&cell.var) ||
+                !tok.GetNextToken().ToLong(&count))
             {
-                Debug.Write(wxString::Format("BLC: Adjustment from %d to %d based on avg residual of %.1f px\n", m_pulseWidth, newBLC, avgMiss));
-                pConfig->Profile.SetInt("/" + m_pMount->GetMountClassName() + "/DecBacklashPulse", newBLC);
-                SetCompValues(newBLC, true);
+                return true;
             }
-
+            cell.side = (PierSide) (c - 1);
+            cell.ms = wxMax(0.0, wxMin((double) m_adjustmentCeiling, cell.ms));
+            cell.count = (int) count;
         }
     }
 
+    memcpy(m_model, model, sizeof(m_model));
+    m_lastDirection = dir == NORTH || dir == SOUTH ? (int) dir : NONE;
     m_justCompensated = false;
+    m_lastCell = NULL;
+    Debug.Write(wxString::Format("BLC: model restored, last direction %d\n", m_lastDirection));
+    return false;
+}
+
+wxString BacklashComp::ModelKey(int dir, PierSide side) const
+{
+    return wxString::Format("/%s/BacklashModel/%s%s", m_pMount->GetMountClassName(),
+        dir == NORTH ? "North" : "South", side == PIER_SIDE_EAST ? "East" : side == PIER_SIDE_WEST ? "West" : "");
+}
+
+// Start every direction and pier side from the given pulse, or from what was learned before
+void BacklashComp::SeedModel(bool useSaved)
+{
+    for (int d = 0; d < 2; d++)
+    {
+        for (int s = 0; s < 3; s++)
+        {
+            BacklashModelCell& cell = m_model[d][s];
+            cell.side = (PierSide) (s - 1);
+            cell.ms = m_pulseWidth;
+            if (useSaved)
+                cell.ms = wxMax(0.0, wxMin((double) m_adjustmentCeiling, pConfig->Profile.GetDouble(ModelKey(d, cell.side), m_pulseWidth)));
+            cell.var = 0.0;
+            cell.count = 0;
+        }
+    }
+    if (!useSaved)
+        pConfig->Profile.DeleteGroup("/" + m_pMount->GetMountClassName() + "/BacklashModel");
+    m_lastCell = NULL;
 }
 
 // Possibly add the backlash comp to the pending guide pulse (yAmount)
@@ -196,11 +247,15 @@ void BacklashComp::ApplyBacklashComp(int dir, double yDist, int *yAmount)
 
     if (m_lastDirection != NONE && dir != m_lastDirection)
     {
-        *yAmount += m_pulseWidth;
+        // the pier side only from the cache, a round trip to the mount here would hold up the guide pulse
+        PierSide side = PointingCache::IsActive() ? PointingCache::SideOfPier() : PIER_SIDE_UNKNOWN;
+        m_lastCell = &m_model[dir == NORTH ? 0 : 1][side + 1];
+        m_lastCompAmount = (int) floor(m_lastCell->ms + 0.5);
+        *yAmount += m_lastCompAmount;
         m_justCompensated = true;
 
         Debug.Write(wxString::Format("BLC: Dec direction reversal from %s to %s, backlash comp pulse of %d applied\n",
-            m_lastDirection == NORTH ? "North" : "South", dir == NORTH ? "North" : "South", m_pulseWidth));
+            m_lastDirection == NORTH ? "North" : "South", dir == NORTH ? "North" : "South", m_lastCompAmount));
     }
 
     m_lastDirection = dir;
@@ -367,8 +422,17 @@ BacklashTool::BacklashTool()
 
     m_backlashResultPx = 0;
     m_backlashResultMs = 0;
+    m_backlashSigmaMs = 0;
     m_cumClearingDistance = 0;
     m_backlashExemption = false;
+    m_adaptive = pConfig->Global.GetBoolean("/BacklashTool/Adaptive", true);
+    m_noise = 0.5;
+}
+
+void BacklashTool::SetAdaptive(bool adaptive)
+{
+    m_adaptive = adaptive;
+    pConfig->Global.SetBoolean("/BacklashTool/Adaptive", adaptive);
 }
 
 void BacklashTool::StartMeasurement()
@@ -385,6 +449,65 @@ void BacklashTool::StopMeasurement()
     DecMeasurementStep(pFrame->pGuider->CurrentPosition());
 }
 
+// Least-squares rate of the North moves in px/ms, steadier than the end points alone
+static double FitNorthRate(const std::vector<double>& steps, int pulseWidth)
+{
+    size_t const n = steps.size();
+    if (n < 3)
+        return 0.0;
+
+    double st = 0.0, sy = 0.0, stt = 0.0, sty = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double const t = (double) i * pulseWidth;
+        st += t;
+        sy += steps[i];
+        stt += t * t;
+        sty += t * steps[i];
+    }
+    double const d = n * stt - st * st;
+    return d > 0.0 ? fabs((n * sty - st * sy) / d) : 0.0;
+}
+
+// Looks for the mount moving South again at the end of the South steps so far plus the position y.
+// Once the last ADAPTIVE_SOUTH_POINTS steps have all moved, each moving position gives the backlash
+// as the pulse time spent less the time the North rate needs to cover the distance from the top
+// of the North leg; the mean of these is the result and their spread gives its uncertainty
+bool BacklashTool::FitSouthBacklash(double y)
+{
+    if (m_southBLSteps.empty() || m_northBLSteps.empty() || m_northRate <= 0.0)
+        return false;
+
+    std::vector<double> pos(m_southBLSteps);
+    pos.push_back(y);
+    int const k = (int) pos.size() - 1;
+    double const top = pos[0];
+    double const northSign = top >= m_northBLSteps[0] ? 1.0 : -1.0;
+
+    int first = k + 1;
+    while (first > 1 && (pos[first - 2] - pos[first - 1]) * northSign >= m_moveThreshold)
+        --first;
+    int const moving = k - first + 1;
+    if (moving < ADAPTIVE_SOUTH_POINTS)
+        return false;
+
+    double sum = 0.0, sum2 = 0.0;
+    for (int i = first; i <= k; i++)
+    {
+        double const b = (double) i * m_pulseWidth - (top - pos[i]) * northSign / m_northRate;
+        sum += b;
+        sum2 += b * b;
+    }
+    double const mean = sum / moving;
+    double const var = wxMax(0.0, sum2 / moving - mean * mean);
+    double const topSigma = m_noise / m_northRate;        // the top of the North leg is common to all the estimates
+
+    m_backlashResultMs = (int) floor(wxMax(0.0, mean) + 0.5);
+    m_backlashResultPx = m_backlashResultMs * m_northRate;
+    m_backlashSigmaMs = sqrt(var / (moving - 1) + topSigma * topSigma);
+    return true;
+}
+
 static bool OutOfRoom(const wxSize& frameSize, double camX, double camY, int margin)
 {
     return camX < margin ||
@@ -418,6 +541,16 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
             m_startingPoint = currMountLocation;
             // Compute pulse size for clearing backlash - just use the last known guide rate
             m_pulseWidth = BACKLASH_EXPECTED_DISTANCE * 1.25 / m_lastDecGuideRate;      // px/px_per_ms, bump it to sidestep near misses
+            m_moveThreshold = BACKLASH_EXPECTED_DISTANCE;
+            if (m_adaptive)
+            {
+                // Size the clearing moves to stand well above the seeing rather than to a fixed distance, and
+                // take a move as real once it is clear of the noise in the difference of two positions
+                double const target = wxMin(wxMax(2.0, 6.0 * m_noise), 0.3 * pFrame->pGuider->GetMaxMovePixels());
+                m_pulseWidth = (int) ceil(target / m_lastDecGuideRate);
+                m_moveThreshold = wxMax(0.5 * target, 3.0 * sqrt(2.0) * m_noise);
+            }
+            m_backlashSigmaMs = 0;
             m_acceptedMoves = 0;
             m_lastClearRslt = 0;
             m_cumClearingDistance = 0;
@@ -435,13 +568,13 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
             {
                 // Get things moving with the first clearing pulse
                 Debug.Write(wxString::Format("BLT starting North backlash clearing using pulse width of %d,"
-                    " looking for moves >= %d px\n", m_pulseWidth, BACKLASH_EXPECTED_DISTANCE));
+                    " looking for moves >= %.2f px\n", m_pulseWidth, m_moveThreshold));
                 pFrame->ScheduleCalibrationMove(m_scope, NORTH, m_pulseWidth);
                 m_stepCount = 1;
                 m_lastStatus = wxString::Format(_("Clearing North backlash, step %d"), m_stepCount);
                 break;
             }
-            if (fabs(decDelta) >= BACKLASH_EXPECTED_DISTANCE)
+            if (fabs(decDelta) >= m_moveThreshold)
             {
                 if (m_acceptedMoves == 0 || (m_lastClearRslt * decDelta) > 0)    // Just starting or still moving in same direction
                 {
@@ -456,7 +589,7 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
             }
             else
                 Debug.Write(wxString::Format("BLT backlash clearing move of %0.2f px was not large enough\n", decDelta));
-            if (m_acceptedMoves < BACKLASH_MIN_COUNT)                    // More work to do
+            if (m_acceptedMoves < (m_adaptive ? ADAPTIVE_MIN_COUNT : BACKLASH_MIN_COUNT))   // More work to do
             {
                 if (m_stepCount < MAX_CLEARING_STEPS)
                 {
@@ -469,7 +602,7 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
                     }
                     else
                     {
-                        if (!OutOfRoom(pCamera->FullSize, currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))
+                        if (!OutOfRoom(pCamera->FrameSize(), currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))
                         {
                             pFrame->ScheduleCalibrationMove(m_scope, NORTH, m_pulseWidth);
                             m_stepCount++;
@@ -488,7 +621,7 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
                     throw ERROR_INFO("BLT: Could not clear N backlash");
                 }
             }
-            if (m_acceptedMoves >= BACKLASH_MIN_COUNT || m_backlashExemption || OutOfRoom(pCamera->FullSize, currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))    // Ok to go ahead with actual backlash measurement
+            if (m_acceptedMoves >= (m_adaptive ? ADAPTIVE_MIN_COUNT : BACKLASH_MIN_COUNT) || m_backlashExemption || OutOfRoom(pCamera->FrameSize(), currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))    // Ok to go ahead with actual backlash measurement
             {
                 m_markerPoint = currMountLocation;            // Marker point at start of big Dec move North
                 m_bltState = BLT_STATE_STEP_NORTH;
@@ -502,13 +635,20 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
                 // for giving South moves time to clear backlash and actually get moving
                 m_northPulseCount = wxMax((MAX_NORTH_PULSES + m_pulseWidth - 1) / m_pulseWidth,
                                           totalBacklashCleared * 1.5 / m_pulseWidth);  // Up to 8 secs
+                if (m_adaptive)
+                {
+                    // The South moves stop as soon as the mount is seen moving, so the North leg only has to be
+                    // longer than the backlash, which the clearing has already bounded
+                    m_northPulseCount = wxMax(wxMax((ADAPTIVE_NORTH_PULSES + m_pulseWidth - 1) / m_pulseWidth, 3),
+                                              (int) ceil(totalBacklashCleared * 1.5 / m_pulseWidth));
+                }
 
                 Debug.Write(wxString::Format("BLT: Starting North moves at Dec=%0.2f\n", currMountLocation.Y));
                 // falling through to start moving North
             }
 
         case BLT_STATE_STEP_NORTH:
-            if (m_stepCount < m_northPulseCount && !OutOfRoom(pCamera->FullSize, currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))
+            if (m_stepCount < m_northPulseCount && !OutOfRoom(pCamera->FrameSize(), currentCamLoc.X, currentCamLoc.Y, pFrame->pGuider->GetMaxMovePixels()))
             {
                 m_lastStatus = wxString::Format(_("Moving North for %d ms, step %d / %d"), m_pulseWidth, m_stepCount + 1, m_northPulseCount);
                 Debug.Write(wxString::Format("BLT: %s, DecLoc = %0.2f\n", m_lastStatus, currMountLocation.Y));
@@ -532,6 +672,16 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
                     Debug.Write("BLT: North pulses truncated, too close to frame edge\n");
                 }
                 m_northRate = fabs(decDelta / (m_stepCount * m_pulseWidth));
+                if (m_adaptive)
+                {
+                    double fitRate = FitNorthRate(m_northBLSteps, m_pulseWidth);
+                    if (fitRate > 0.0)
+                        m_northRate = fitRate;
+                    // a South step has moved once it covers half the distance a North step did
+                    m_moveThreshold = wxMax(0.5 * m_northRate * m_pulseWidth, 3.0 * sqrt(2.0) * m_noise);
+                    Debug.Write(wxString::Format("BLT: North rate %.4f px/ms, South moves >= %.2f px will show motion\n",
+                        m_northRate, m_moveThreshold));
+                }
                 m_northPulseCount = m_stepCount;
                 m_stepCount = 0;
                 m_bltState = BLT_STATE_STEP_SOUTH;
@@ -539,6 +689,21 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
             }
 
         case BLT_STATE_STEP_SOUTH:
+            if (m_adaptive && m_stepCount > 0 && FitSouthBacklash(currMountLocation.Y))
+            {
+                // The mount is moving South again, no need to finish the leg
+                Debug.Write(wxString::Format("BLT: South motion seen after %d steps, backlash %0.2f px, %d +/- %d ms\n",
+                    m_stepCount, m_backlashResultPx, m_backlashResultMs, (int) m_backlashSigmaMs));
+                m_southBLSteps.push_back(currMountLocation.Y);
+                m_endSouth = currMountLocation;
+                if (m_Rslt == MEASUREMENT_VALID && m_backlashResultMs >= 0.8 * m_northPulseCount * m_pulseWidth)
+                    m_Rslt = MEASUREMENT_IMPAIRED;
+                if (m_Rslt == MEASUREMENT_VALID && m_backlashResultMs >= 100 && m_backlashSigmaMs <= 0.25 * m_backlashResultMs)
+                    m_scope->GetBacklashComp()->SetBacklashPulse(m_backlashResultMs);
+                m_stepCount = 0;
+                m_bltState = BLT_STATE_RESTORE;
+                goto restore;               // the trial correction is not needed with a fitted result
+            }
             if (m_stepCount < m_northPulseCount)
             {
                 m_lastStatus = wxString::Format(_("Moving South for %d ms, step %d / %d"), m_pulseWidth, m_stepCount + 1, m_northPulseCount);
@@ -611,6 +776,7 @@ void BacklashTool::DecMeasurementStep(const PHD_Point& currentCamLoc)
             // fall through
 
         case BLT_STATE_RESTORE:
+        restore:
             // We could be a considerable distance from where we started, so get back close to the starting point without losing the star
             if (m_stepCount == 0)
             {
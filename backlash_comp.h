@@ -53,6 +53,10 @@ class BacklashTool
     bool m_backlashExemption;
     int m_backlashResultMs;
     double m_northRate;
+    bool m_adaptive;                          // size and end the moves from what is seen
+    double m_noise;                           // px, star position noise
+    double m_moveThreshold;                   // px, a step moving less than this is taken as noise
+    double m_backlashSigmaMs;
     PHD_Point m_lastMountLocation;
     PHD_Point m_startingPoint;
     PHD_Point m_markerPoint;
@@ -62,6 +66,8 @@ class BacklashTool
     std::vector<double> m_northBLSteps;
     std::vector<double> m_southBLSteps;
 
+    bool FitSouthBacklash(double y);
+
 public:
     enum BLT_STATE
     {
@@ -84,7 +90,10 @@ public:
         MAX_CLEARING_STEPS = 100,
         NORTH_PULSE_SIZE = 500,
         MAX_NORTH_PULSES = 8000,    
-        TRIAL_TOLERANCE = 2
+        TRIAL_TOLERANCE = 2,
+        ADAPTIVE_MIN_COUNT = 2,             // consecutive moves that show the mount is moving
+        ADAPTIVE_NORTH_PULSES = 3000,
+        ADAPTIVE_SOUTH_POINTS = 3           // moving South positions the backlash is fitted to
     };
 
     enum MeasurementResults
@@ -107,6 +116,10 @@ public:
     double GetBacklashResultPx() const { return m_backlashResultPx; }
     int GetBacklashResultMs() const { return m_backlashResultMs; }
     bool GetBacklashExempted() const { return m_backlashExemption; }
+    int GetBacklashSigmaMs() const { return (int) m_backlashSigmaMs; }
+    bool IsAdaptive() const { return m_adaptive; }
+    void SetAdaptive(bool adaptive);
+    void SetSeeingNoise(double px) { m_noise = px; }
     wxString GetLastStatus() const { return m_lastStatus; }
     void SetBacklashPulse(int amt);
     void ShowGraph(wxDialog *pGA);
@@ -114,14 +127,27 @@ public:
     const std::vector<double>& GetSouthSteps() const { return m_southBLSteps; }
 };
 
+// Adds a compensation pulse to the first Dec correction after a direction reversal. The amount is
+// learned separately for each reversal direction and pier side from how far the following offset
+// says the pulse missed, starting from the configured pulse and saved in the profile
 class BacklashComp
 {
+    struct BacklashModelCell
+    {
+        PierSide side;
+        double ms;                  // estimated backlash
+        double var;                 // ms^2, weighted spread of the recent observations
+        int count;                  // reversals seen
+    };
+
     bool m_compActive;
     int m_lastDirection;
     bool m_justCompensated;
     int m_adjustmentCeiling;
-    int m_pulseWidth;
-    ArrayOfDbl m_residualOffsets;
+    int m_pulseWidth;               // configured amount, seeds the model
+    BacklashModelCell m_model[2][3];    // [North, South][pier side unknown, East, West]
+    BacklashModelCell *m_lastCell;  // the estimate used by the last compensation
+    int m_lastCompAmount;
     Mount *m_pMount;
     Scope *m_pScope;
 
@@ -136,10 +162,14 @@ public:
     void ApplyBacklashComp(int dir, double yDist, int *yAmount);
     void TrackBLCResults(double yDistance, double minMove, double yRate);
     void ResetBaseline();
+    wxString SaveState() const;
+    bool RestoreState(const wxString& state);   // true on error
 
 private:
     void _TrackBLCResults(double yDistance, double minMove, double yRate);
     void SetCompValues(int requestSize, bool autoAdjust);
+    void SeedModel(bool useSaved);
+    wxString ModelKey(int dir, PierSide side) const;
 };
 
 inline void BacklashComp::TrackBLCResults(double yDistance, double minMove, double yRate)
@@ -0,0 +1,615 @@
+/*
+ *  backtest.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <wx/stopwatch.h>
+#include <wx/tokenzr.h>
+
+#include <algorithm>
+
+namespace
+{
+
+struct Step
+{
+    double raw[2];          // RA and Dec offsets, mount coordinates, pixels
+    double guide[2];        // the corrections the recorded algorithms asked for
+    bool restart;           // first step of a session, or the lock position moved
+};
+
+struct Config
+{
+    GuideAxis axis;
+    GuideAlgorithm *algorithm;
+    wxString settings;
+    double rms;
+};
+
+struct Param
+{
+    wxString name;
+    std::vector<double> values;
+};
+
+}
+
+static const unsigned int MAX_CONFIGS = 200000;
+
+static GuideAlgorithm *CreateAlgorithm(const wxString& name, GuideAxis axis)
+{
+    // no mount: the settings go to a scratch group, see GuideAlgorithm::GetConfigPath()
+    if (name.CmpNoCase("Identity") == 0)
+        return new GuideAlgorithmIdentity(0, axis);
+    if (name.CmpNoCase("Hysteresis") == 0)
+        return new GuideAlgorithmHysteresis(0, axis);
+    if (name.CmpNoCase("Lowpass") == 0)
+        return new GuideAlgorithmLowpass(0, axis);
+    if (name.CmpNoCase("Lowpass2") == 0)
+        return new GuideAlgorithmLowpass2(0, axis);
+    if (name.CmpNoCase("ResistSwitch") == 0)
+        return new GuideAlgorithmResistSwitch(0, axis);
+    if (name.CmpNoCase("Chain") == 0)
+        return new GuideAlgorithmChain(0, axis);
+    return 0;
+}
+
+// returns true on error
+static bool ParseValues(const wxString& spec, std::vector<double> *values)
+{
+    values->clear();
+
+    wxArrayString range = wxSplit(spec, ':', 0);
+    if (range.size() == 3)
+    {
+        double lo, hi, step;
+        if (!range[0].ToDouble(&lo) || !range[1].ToDouble(&hi) || !range[2].ToDouble(&step) || step <= 0.0 || hi < lo)
+            return true;
+        // count the steps up front so rounding cannot add or drop the last value
+        int n = (int) floor((hi - lo) / step + 1e-6);
+        for (int i = 0; i <= n; i++)
+            values->push_back(lo + i * step);
+        return false;
+    }
+    if (range.size() != 1)
+        return true;
+
+    wxArrayString list = wxSplit(spec, ',', 0);
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        double val;
+        if (!list[i].ToDouble(&val))
+            return true;
+        values->push_back(val);
+    }
+
+    return values->empty();
+}
+
+static bool LoadBinaryGuideLog(const wxString& logFile, std::vector<Step> *steps, double *pixelScale, wxString *errorMsg)
+{
+    GuideLogBinaryReader reader;
+    if (reader.Open(logFile, errorMsg))
+        return true;
+
+    bool guiding = false;
+    bool restart = true;
+    GuideLogBinRecord rec;
+
+    while (reader.Next(&rec))
+    {
+        if (rec.type == GLB_REC_EVENT)
+        {
+            switch (rec.event)
+            {
+            case GLB_EV_GUIDING_BEGINS:
+                guiding = true;
+                restart = true;
+                break;
+            case GLB_EV_GUIDING_ENDS:
+                guiding = false;
+                break;
+            case GLB_EV_DITHER:
+            case GLB_EV_LOCK_POSITION:
+                restart = true;
+                break;
+            case GLB_EV_TEXT:
+            {
+                if (!guiding)
+                    break;
+                // the pixel scale is in the settings summary
+                int pos = rec.text.Find("Pixel scale = ");
+                double scale;
+                if (pos != wxNOT_FOUND && rec.text.Mid(pos + 14).BeforeFirst(' ').ToDouble(&scale))
+                    *pixelScale = scale;
+                break;
+            }
+            default:
+                break;
+            }
+            continue;
+        }
+
+        // AO steps are left out, as are dropped frames
+        if (!guiding || rec.step.kind != GLB_STEP_MOUNT)
+            continue;
+
+        Step step;
+        step.raw[GUIDE_RA] = rec.step.raRaw;
+        step.raw[GUIDE_DEC] = rec.step.decRaw;
+        step.guide[GUIDE_RA] = rec.step.raGuide;
+        step.guide[GUIDE_DEC] = rec.step.decGuide;
+        step.restart = restart;
+        restart = false;
+        steps->push_back(step);
+    }
+
+    if (steps->empty())
+    {
+        *errorMsg = wxString::Format("no guide steps in %s", logFile);
+        return true;
+    }
+
+    return false;
+}
+
+static bool LoadGuideLog(const wxString& logFile, std::vector<Step> *steps, double *pixelScale, wxString *errorMsg)
+{
+    if (GuideLogBinaryReader::IsBinaryLog(logFile))
+        return LoadBinaryGuideLog(logFile, steps, pixelScale, errorMsg);
+
+    wxTextFile file;
+    if (!file.Open(logFile))
+    {
+        *errorMsg = wxString::Format("cannot open guide log %s", logFile);
+        return true;
+    }
+
+    bool guiding = false;
+    bool restart = true;
+
+    for (size_t i = 0; i < file.GetLineCount(); i++)
+    {
+        const wxString& line = file[i];
+
+        if (line.StartsWith("Guiding Begins"))
+        {
+            guiding = true;
+            restart = true;
+            continue;
+        }
+        if (line.StartsWith("Guiding Ends"))
+        {
+            guiding = false;
+            continue;
+        }
+        if (!guiding)
+            continue;
+
+        wxString rest;
+        if (line.StartsWith("Pixel scale = ", &rest))
+        {
+            double scale;
+            if (rest.BeforeFirst(' ').ToDouble(&scale))
+                *pixelScale = scale;
+            continue;
+        }
+        if (line.StartsWith("INFO: DITHER") || line.StartsWith("INFO: SET LOCK POSITION"))
+        {
+            restart = true;
+            continue;
+        }
+        if (line.empty() || !wxIsdigit(line[0]))
+            continue;
+
+        // Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,...
+        // AO steps are left out, as are dropped frames
+        wxArrayString fields = wxSplit(line, ',', 0);
+        if (fields.size() < 9 || fields[2] != "\"Mount\"")
+            continue;
+
+        Step step;
+        if (!fields[5].ToDouble(&step.raw[GUIDE_RA]) || !fields[6].ToDouble(&step.raw[GUIDE_DEC]) ||
+            !fields[7].ToDouble(&step.guide[GUIDE_RA]) || !fields[8].ToDouble(&step.guide[GUIDE_DEC]))
+        {
+            continue;
+        }
+        step.restart = restart;
+        restart = false;
+        steps->push_back(step);
+    }
+
+    if (steps->empty())
+    {
+        *errorMsg = wxString::Format("no guide steps in %s", logFile);
+        return true;
+    }
+
+    return false;
+}
+
+static bool LoadGrid(const wxString& gridFile, std::vector<Config> *configs, double *response, wxString *errorMsg)
+{
+    wxTextFile file;
+    if (!file.Open(gridFile))
+    {
+        *errorMsg = wxString::Format("cannot open grid file %s", gridFile);
+        return true;
+    }
+
+    for (size_t lineno = 0; lineno < file.GetLineCount(); lineno++)
+    {
+        wxString line = file[lineno].BeforeFirst('#');
+        wxArrayString tokens = wxStringTokenize(line, " \t", wxTOKEN_STRTOK);
+        if (tokens.empty())
+            continue;
+
+        wxString where = wxString::Format("%s line %u: ", gridFile, (unsigned int) lineno + 1);
+
+        if (tokens[0].CmpNoCase("response") == 0)
+        {
+            if (tokens.size() != 2 || !tokens[1].ToDouble(response) || *response <= 0.0)
+            {
+                *errorMsg = where + "expected response <fraction>";
+                return true;
+            }
+            continue;
+        }
+
+        GuideAxis axis;
+        if (tokens[0].CmpNoCase("RA") == 0)
+            axis = GUIDE_RA;
+        else if (tokens[0].CmpNoCase("Dec") == 0)
+            axis = GUIDE_DEC;
+        else
+        {
+            *errorMsg = where + "expected RA or Dec";
+            return true;
+        }
+
+        GuideAlgorithm *probe = tokens.size() > 1 ? CreateAlgorithm(tokens[1], axis) : 0;
+        if (!probe)
+        {
+            *errorMsg = where + "expected Identity, Hysteresis, Lowpass, Lowpass2, ResistSwitch or Chain";
+            return true;
+        }
+
+        // a chain's stages come first, as spec=stage>stage(param=value,...)
+        wxString spec;
+        size_t first = 2;
+        if (probe->Algorithm() == GUIDE_ALGORITHM_CHAIN)
+        {
+            wxString err;
+            if (tokens.size() < 3 || !tokens[2].StartsWith("spec=", &spec) ||
+                static_cast<GuideAlgorithmChain *>(probe)->SetSpec(spec, &err))
+            {
+                *errorMsg = where + "expected spec=<stages> " + err;
+                delete probe;
+                return true;
+            }
+            first = 3;
+        }
+
+        wxArrayString names;
+        probe->GetParamNames(names);
+        delete probe;
+
+        std::vector<Param> params;
+        for (size_t i = first; i < tokens.size(); i++)
+        {
+            Param param;
+            param.name = tokens[i].BeforeFirst('=');
+            if (names.Index(param.name) == wxNOT_FOUND)
+            {
+                *errorMsg = where + wxString::Format("%s has no parameter %s", tokens[1], param.name);
+                return true;
+            }
+            if (ParseValues(tokens[i].AfterFirst('='), &param.values))
+            {
+                *errorMsg = where + wxString::Format("bad values for %s", param.name);
+                return true;
+            }
+            params.push_back(param);
+        }
+
+        // every combination of the values, the last parameter varying fastest
+        std::vector<size_t> idx(params.size(), 0);
+        while (true)
+        {
+            if (configs->size() >= MAX_CONFIGS)
+            {
+                *errorMsg = wxString::Format("more than %u configurations", MAX_CONFIGS);
+                return true;
+            }
+
+            Config config;
+            config.axis = axis;
+            config.algorithm = CreateAlgorithm(tokens[1], axis);
+            config.rms = 0.0;
+            configs->push_back(config);
+            Config& c = configs->back();
+
+            if (!spec.empty())
+            {
+                wxString err;
+                static_cast<GuideAlgorithmChain *>(c.algorithm)->SetSpec(spec, &err);
+                c.settings = spec;
+            }
+
+            for (size_t i = 0; i < params.size(); i++)
+            {
+                double val = params[i].values[idx[i]];
+                if (!c.algorithm->SetParam(params[i].name, val))
+                {
+                    *errorMsg = where + wxString::Format("%s rejects %s = %g", tokens[1], params[i].name, val);
+                    return true;
+                }
+                if (!c.settings.empty())
+                    c.settings += " ";
+                c.settings += wxString::Format("%s=%g", params[i].name, val);
+            }
+
+            size_t i = params.size();
+            while (i > 0 && ++idx[i - 1] == params[i - 1].values.size())
+            {
+                idx[i - 1] = 0;
+                --i;
+            }
+            if (i == 0)
+                break;
+        }
+    }
+
+    if (configs->empty())
+    {
+        *errorMsg = wxString::Format("no configurations in %s", gridFile);
+        return true;
+    }
+
+    return false;
+}
+
+namespace
+{
+
+// a GuideAlgorithm behind the interface of a guide chain, for ReplayLoop
+struct VirtualAlgorithm
+{
+    GuideAlgorithm *algorithm;
+
+    void Reset() { algorithm->reset(); }
+    double Step(double input) { return algorithm->result(input); }
+};
+
+// RMS of the offsets the chain would have left on one axis
+template<class Chain>
+double ReplayLoop(Chain& chain, int axis, const std::vector<Step>& steps, double response)
+{
+    double pos = 0.0;
+    double correction = 0.0;
+    double sumsq = 0.0;
+
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        const Step& step = steps[i];
+
+        if (step.restart)
+        {
+            chain.Reset();
+            pos = step.raw[axis];
+        }
+        else
+        {
+            // what the star did since the previous frame, apart from the
+            // recorded correction
+            const Step& prev = steps[i - 1];
+            double drift = step.raw[axis] - prev.raw[axis] + response * prev.guide[axis];
+            pos += drift - response * correction;
+        }
+
+        correction = chain.Step(pos);
+        sumsq += pos * pos;
+    }
+
+    return sqrt(sumsq / steps.size());
+}
+
+// GuideChain::Run() callback, so fused chains replay without a virtual call per step
+struct ChainReplay
+{
+    int axis;
+    const std::vector<Step>& steps;
+    double response;
+    double rms;
+
+    ChainReplay(int axis_, const std::vector<Step>& steps_, double response_)
+        : axis(axis_), steps(steps_), response(response_), rms(0.0) { }
+
+    template<class Chain>
+    void operator()(Chain& chain) { rms = ReplayLoop(chain, axis, steps, response); }
+};
+
+}
+
+static double Replay(GuideAlgorithm *algorithm, int axis, const std::vector<Step>& steps, double response)
+{
+    if (algorithm->Algorithm() == GUIDE_ALGORITHM_CHAIN)
+    {
+        ChainReplay replay(axis, steps, response);
+        static_cast<GuideAlgorithmChain *>(algorithm)->Chain().Run(replay);
+        return replay.rms;
+    }
+
+    VirtualAlgorithm va = { algorithm };
+    return ReplayLoop(va, axis, steps, response);
+}
+
+
+struct BacktestJob : public ImageStripJob
+{
+    const std::vector<Step>& m_steps;
+    std::vector<Config>& m_configs;
+    double m_response;
+
+    BacktestJob(const std::vector<Step>& steps, std::vector<Config>& configs, double response)
+        : m_steps(steps), m_configs(configs), m_response(response) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        for (int i = rowBegin; i < rowEnd; i++)
+            m_configs[i].rms = Replay(m_configs[i].algorithm, m_configs[i].axis, m_steps, m_response);
+    }
+};
+
+static bool ByAxisAndRms(const Config& a, const Config& b)
+{
+    if (a.axis != b.axis)
+        return a.axis < b.axis;
+    return a.rms < b.rms;
+}
+
+static bool WriteResults(const wxString& outFile, const std::vector<Step>& steps, const std::vector<Config>& configs,
+                         double pixelScale, wxString *errorMsg)
+{
+    wxFFile file;
+    if (!file.Open(outFile, "w"))
+    {
+        *errorMsg = wxString::Format("cannot create %s", outFile);
+        return true;
+    }
+
+    file.Write("Axis,Algorithm,Settings,RMS (px),RMS (arc-sec)\n");
+
+    for (int axis = GUIDE_RA; axis <= GUIDE_DEC; axis++)
+    {
+        double sumsq = 0.0;
+        for (size_t i = 0; i < steps.size(); i++)
+            sumsq += steps[i].raw[axis] * steps[i].raw[axis];
+        double rms = sqrt(sumsq / steps.size());
+        file.Write(wxString::Format("%s,recorded,,%.4f,%.3f\n", axis == GUIDE_RA ? "RA" : "Dec", rms,
+            rms * pixelScale));
+    }
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        const Config& c = configs[i];
+        file.Write(wxString::Format("%s,%s,%s,%.4f,%.3f\n", c.axis == GUIDE_RA ? "RA" : "Dec",
+            c.algorithm->GetGuideAlgorithmClassName(), c.settings, c.rms, c.rms * pixelScale));
+    }
+
+    if (!file.Close())
+    {
+        *errorMsg = wxString::Format("error writing %s", outFile);
+        return true;
+    }
+
+    return false;
+}
+
+bool Backtest::LoadDrift(const wxString& logFile, std::vector<double> *raDrift, std::vector<double> *decDrift, wxString *errorMsg)
+{
+    std::vector<Step> steps;
+    double pixelScale;
+    if (LoadGuideLog(logFile, &steps, &pixelScale, errorMsg))
+        return true;
+
+    raDrift->clear();
+    decDrift->clear();
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        const Step& step = steps[i];
+        if (step.restart)
+        {
+            raDrift->push_back(0.0);
+            decDrift->push_back(0.0);
+            continue;
+        }
+        // as in Replay() with the mount delivering the recorded corrections in full
+        const Step& prev = steps[i - 1];
+        raDrift->push_back(step.raw[GUIDE_RA] - prev.raw[GUIDE_RA] + prev.guide[GUIDE_RA]);
+        decDrift->push_back(step.raw[GUIDE_DEC] - prev.raw[GUIDE_DEC] + prev.guide[GUIDE_DEC]);
+    }
+    return false;
+}
+
+bool Backtest::Run(const wxString& logFile, const wxString& gridFile, const wxString& outFile, wxString *errorMsg)
+{
+    std::vector<Step> steps;
+    std::vector<Config> configs;
+    double pixelScale = 0.0;
+    double response = 1.0;
+    bool err = true;
+
+    // settings the grid leaves out start from the defaults
+    pConfig->Profile.DeleteGroup("/backtest");
+
+    if (!LoadGuideLog(logFile, &steps, &pixelScale, errorMsg) &&
+        !LoadGrid(gridFile, &configs, &response, errorMsg))
+    {
+        Debug.Write(wxString::Format("Backtest: %u configurations, %u steps from %s, response %.2f\n",
+            (unsigned int) configs.size(), (unsigned int) steps.size(), logFile, response));
+
+        wxStopWatch swatch;
+
+        // the algorithms log every step
+        bool debugEnabled = Debug.Enable(false);
+
+        BacktestJob job(steps, configs, response);
+        RunImageStrips(job, ImageStripCount((int) configs.size(), 1), (int) configs.size());
+
+        Debug.Enable(debugEnabled);
+
+        std::sort(configs.begin(), configs.end(), ByAxisAndRms);
+
+        Debug.Write(wxString::Format("Backtest: replay took %ld ms\n", swatch.Time()));
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            if (i == 0 || configs[i].axis != configs[i - 1].axis)
+            {
+                Debug.Write(wxString::Format("Backtest: best %s: %s %s rms %.4f px\n",
+                    configs[i].axis == GUIDE_RA ? "RA" : "Dec", configs[i].algorithm->GetGuideAlgorithmClassName(),
+                    configs[i].settings, configs[i].rms));
+            }
+        }
+
+        err = WriteResults(outFile, steps, configs, pixelScale, errorMsg);
+    }
+
+    for (size_t i = 0; i < configs.size(); i++)
+        delete configs[i].algorithm;
+
+    pConfig->Profile.DeleteGroup("/backtest");
+
+    return err;
+}
@@ -0,0 +1,69 @@
+/*
+ *  backtest.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef BACKTEST_INCLUDED
+#define BACKTEST_INCLUDED
+
+// Offline tuning of the guide algorithms: the guiding sessions in a PHD2
+// guide log, text or binary (see guidelog_binary.h), are replayed through every configuration in a grid file and
+// the predicted RMS of each is written to a CSV file.
+//
+// The grid file has one configuration set per line, expanded to every
+// combination of the values given:
+//
+//   # axis algorithm param=values ...
+//   RA Hysteresis minMove=0.1:0.3:0.05 hysteresis=0.1 aggression=0.6:1.0:0.1
+//   Dec ResistSwitch minMove=0.1,0.2 aggression=1.0 fastSwitch=0,1
+//   response 0.9
+//
+// Values are a comma separated list or lo:hi:step. Parameters left out take
+// the algorithm's defaults. "response" is the fraction of each correction
+// the mount model delivers, 1.0 by default.
+//
+// The replay assumes the star would have drifted by what the log shows plus
+// the part of the recorded correction the mount delivered, and applies the
+// candidate algorithm's correction instead. Dithers and lock position
+// changes restart the replay from the recorded position.
+struct Backtest
+{
+    // returns true on error
+    static bool Run(const wxString& logFile, const wxString& gridFile, const wxString& outFile, wxString *errorMsg);
+
+    // what the star did between the guide steps of the log apart from the
+    // recorded corrections, per axis in mount coordinates and pixels, 0 at
+    // the start of each session; for replaying a recorded night through an
+    // algorithm (see Benchmark::RunGuideAlgorithms). Returns true on error.
+    static bool LoadDrift(const wxString& logFile, std::vector<double> *raDrift, std::vector<double> *decDrift, wxString *errorMsg);
+};
+
+#endif
@@ -0,0 +1,715 @@
+/*
+ *  benchmark.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "benchmark.h"
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <algorithm>
+
+static const double MIN_SECONDS = 0.5;      // time each step for at least this long
+enum { MIN_RUNS = 5, MAX_RUNS = 1000 };
+
+struct SyntheticSize
+{
+    const char *name;
+    int width, height;
+};
+
+static const SyntheticSize SYNTHETIC_SIZES[] =
+{
+    { "synthetic_vga", 640, 480 },
+    { "synthetic_1.3mp", 1280, 960 },
+    { "synthetic_5mp", 2448, 2048 },
+    { "synthetic_16mp", 4656, 3520 },
+};
+
+struct BenchInput
+{
+    wxString name;
+    usImage img;
+    usImage dark;
+    DefectMap defects;
+    wxPoint star;           // a star for Star::Find, (-1,-1) if none
+};
+
+// deterministic so that runs of different builds time the same frames
+struct BenchRandom
+{
+    unsigned int state;
+    BenchRandom(unsigned int seed) : state(seed) { }
+    double Uniform()
+    {
+        state = state * 1664525U + 1013904223U;
+        return (state >> 8) / 16777216.0;
+    }
+    double Gaussian()
+    {
+        // sum of uniforms, close enough for sky noise
+        double s = 0.0;
+        for (int i = 0; i < 12; i++)
+            s += Uniform();
+        return s - 6.0;
+    }
+};
+
+static unsigned short clamp_pixel(double v)
+{
+    return v <= 0.0 ? 0 : v >= 65535.0 ? 65535 : (unsigned short) v;
+}
+
+static void AddStar(usImage& img, double cx, double cy, double peak, double sigma)
+{
+    int r = (int) ceil(sigma * 4.0);
+    for (int y = wxMax(0, (int) cy - r); y <= wxMin(img.Size.GetHeight() - 1, (int) cy + r); y++)
+    {
+        for (int x = wxMax(0, (int) cx - r); x <= wxMin(img.Size.GetWidth() - 1, (int) cx + r); x++)
+        {
+            double dx = x - cx, dy = y - cy;
+            double v = img.Pixel(x, y) + peak * exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+            img.Pixel(x, y) = clamp_pixel(v);
+        }
+    }
+}
+
+// sky background with noise, stars, and hot pixels that are also in the dark
+static void MakeSynthetic(BenchInput *in, const SyntheticSize& sz)
+{
+    BenchRandom rnd(12345U);
+
+    in->name = sz.name;
+    in->img.Init(sz.width, sz.height);
+    in->dark.Init(sz.width, sz.height);
+    in->img.BitsPerPixel = in->dark.BitsPerPixel = 16;
+    in->img.ImgExpDur = in->dark.ImgExpDur = 2000;
+
+    for (int i = 0; i < in->img.NPixels; i++)
+    {
+        in->dark.ImageData[i] = clamp_pixel(200.0 + 5.0 * rnd.Gaussian());
+        in->img.ImageData[i] = clamp_pixel(in->dark.ImageData[i] + 800.0 + 20.0 * rnd.Gaussian());
+    }
+
+    int nhot = wxMax(10, in->img.NPixels / 10000);
+    for (int i = 0; i < nhot; i++)
+    {
+        wxPoint pt((int) (rnd.Uniform() * sz.width), (int) (rnd.Uniform() * sz.height));
+        in->dark.Pixel(pt.x, pt.y) = in->img.Pixel(pt.x, pt.y) = 30000;
+        in->defects.push_back(pt);      // AddDefect would append to the profile's map file
+    }
+    in->defects.BuildIndex();
+
+    for (int i = 0; i < 30; i++)
+        AddStar(in->img, 30.0 + rnd.Uniform() * (sz.width - 60), 30.0 + rnd.Uniform() * (sz.height - 60),
+                500.0 + rnd.Uniform() * 8000.0, 1.2 + rnd.Uniform());
+
+    in->star = wxPoint(sz.width / 2, sz.height / 2);
+    AddStar(in->img, in->star.x + 0.3, in->star.y - 0.2, 20000.0, 1.8);
+}
+
+// a real frame has no matching dark, so the dark is the frame's own background
+static bool LoadFits(BenchInput *in, const wxString& fname)
+{
+    if (in->img.Load(fname))
+        return false;
+
+    in->name = wxFileName(fname).GetFullName();
+    in->img.CalcStats();
+    in->dark.Init(in->img.Size);
+    unsigned short bg = (unsigned short) in->img.FiltMin;
+    for (int i = 0; i < in->dark.NPixels; i++)
+        in->dark.ImageData[i] = bg;
+    in->defects.BuildIndex();
+
+    Star star;
+    in->star = star.AutoFind(in->img, 20, 15) ? wxPoint((int) star.X, (int) star.Y) : wxPoint(-1, -1);
+    return true;
+}
+
+struct BenchResult
+{
+    int runs;
+    double minUs;
+    double medianUs;
+    double meanUs;
+};
+
+// Setup prepares the input for one call and Step is the part timed
+struct BenchStep
+{
+    virtual ~BenchStep() { }
+    virtual void Setup() { }
+    virtual void Step() = 0;
+};
+
+static BenchResult TimeStep(BenchStep& step, double minSeconds = MIN_SECONDS, int minRuns = MIN_RUNS)
+{
+    std::vector<double> t;
+    double total = 0.0;
+
+    while ((int) t.size() < MAX_RUNS && ((int) t.size() < minRuns || total < minSeconds * 1.0e6))
+    {
+        step.Setup();
+        wxStopWatch swatch;
+        step.Step();
+        double us = swatch.TimeInMicro().ToDouble();
+        t.push_back(us);
+        total += us;
+    }
+
+    BenchResult r;
+    r.runs = (int) t.size();
+    r.meanUs = total / r.runs;
+    std::sort(t.begin(), t.end());
+    r.minUs = t.front();
+    r.medianUs = t[t.size() / 2];
+    return r;
+}
+
+// most steps change the frame, so each call starts from a fresh copy
+struct CopyStep : public BenchStep
+{
+    const usImage& src;
+    usImage work;
+    CopyStep(const usImage& s) : src(s) { }
+    void Setup() { work.CopyFrom(src); }
+};
+
+struct Median3Step : public CopyStep
+{
+    Median3Step(const usImage& s) : CopyStep(s) { }
+    void Step() { Median3(work); }
+};
+
+struct QuickLReconStep : public CopyStep
+{
+    QuickLReconStep(const usImage& s) : CopyStep(s) { }
+    void Step() { QuickLRecon(work); }
+};
+
+struct SubtractStep : public CopyStep
+{
+    const usImage& dark;
+    SubtractStep(const usImage& s, const usImage& d) : CopyStep(s), dark(d) { }
+    void Step() { Subtract(work, dark); }
+};
+
+// dark subtract, median filter and stats in one pass, to compare with the
+// sum of the Subtract, Median3 and CalcStats steps
+struct CalibrateStep : public CopyStep
+{
+    PreparedDark *dark;
+    int nr;
+    CalibrateStep(const usImage& s, const usImage& d, int nr_ = NR_3x3MEDIAN) : CopyStep(s), dark(new PreparedDark(d)), nr(nr_) { }
+    ~CalibrateStep() { dark->Release(); }
+    void Step() { CalibrateFrame(work, dark, nr, true); }
+};
+
+struct RemoveDefectsStep : public CopyStep
+{
+    const DefectMap& defects;
+    RemoveDefectsStep(const usImage& s, const DefectMap& d) : CopyStep(s), defects(d) { }
+    void Step() { RemoveDefects(work, defects); }
+};
+
+struct SquarePixelsStep : public CopyStep
+{
+    SquarePixelsStep(const usImage& s) : CopyStep(s) { }
+    void Step() { SquarePixels(work, 3.75f, 4.3f); }
+};
+
+struct MedianFilterStep : public BenchStep
+{
+    const usImage& src;
+    usImage dst;
+    MedianFilterStep(const usImage& s) : src(s) { }
+    void Step() { MedianFilter(dst, src, 7); }
+};
+
+struct CalcStatsStep : public CopyStep
+{
+    CalcStatsStep(const usImage& s) : CopyStep(s) { }
+    void Step() { work.CalcStats(); }
+};
+
+struct CopyToImageStep : public CopyStep
+{
+    wxImage *img;
+    CopyToImageStep(const usImage& s) : CopyStep(s), img(0) { work.CopyFrom(s); work.CalcStats(); }
+    ~CopyToImageStep() { delete img; }
+    void Setup() { }
+    void Step() { work.CopyToImage(&img, work.FiltMin, work.FiltMax, 0.4); }
+};
+
+struct StarFindStep : public BenchStep
+{
+    const usImage& img;
+    wxPoint pos;
+    StarFindStep(const usImage& i, const wxPoint& p) : img(i), pos(p) { }
+    void Step() { Star star; star.Find(&img, 15, pos.x, pos.y, Star::FIND_CENTROID); }
+};
+
+struct AutoFindStep : public BenchStep
+{
+    const usImage& img;
+    AutoFindStep(const usImage& i) : img(i) { }
+    void Step() { Star star; star.AutoFind(img, 20, 15); }
+};
+
+struct FrameEncodeStep : public BenchStep
+{
+    const usImage& img;
+    std::vector<unsigned char> buf;
+    FrameEncodeStep(const usImage& i) : img(i) { }
+    void Step() { buf.clear(); FrameCodec::Encode(img, wxRect(), FRAME_CODEC_PACKED, &buf); }
+};
+
+struct FrameDecodeStep : public BenchStep
+{
+    std::vector<unsigned char> buf;
+    usImage img;
+    FrameDecodeStep(const usImage& i) { FrameCodec::Encode(i, wxRect(), FRAME_CODEC_PACKED, &buf); }
+    void Step() { FrameCodec::Decode(&buf[0], buf.size(), &img); }
+};
+
+static void WriteResult(wxFFile& f, const BenchInput& in, const char *step, const BenchResult& r)
+{
+    double mpix = (double) in.img.NPixels / 1.0e6;
+    f.Write(wxString::Format("%s,%d,%d,%s,%d,%.1f,%.1f,%.1f,%.2f\n", in.name, in.img.Size.GetWidth(), in.img.Size.GetHeight(),
+        step, r.runs, r.minUs, r.medianUs, r.meanUs, r.medianUs > 0.0 ? mpix / (r.medianUs / 1.0e6) : 0.0));
+    Debug.Write(wxString::Format("Benchmark: %s %s median %.1f us (%d runs)\n", in.name, step, r.medianUs, r.runs));
+}
+
+static void RunInput(wxFFile& f, BenchInput& in)
+{
+    { Median3Step s(in.img); WriteResult(f, in, "Median3", TimeStep(s)); }
+    { QuickLReconStep s(in.img); WriteResult(f, in, "QuickLRecon", TimeStep(s)); }
+    { SubtractStep s(in.img, in.dark); WriteResult(f, in, "Subtract", TimeStep(s)); }
+    { CalibrateStep s(in.img, in.dark); WriteResult(f, in, "Calibrate", TimeStep(s)); }
+    { RemoveDefectsStep s(in.img, in.defects); WriteResult(f, in, "RemoveDefects", TimeStep(s)); }
+    { SquarePixelsStep s(in.img); WriteResult(f, in, "SquarePixels", TimeStep(s)); }
+    { MedianFilterStep s(in.img); WriteResult(f, in, "MedianFilter", TimeStep(s)); }
+    { CalcStatsStep s(in.img); WriteResult(f, in, "CalcStats", TimeStep(s)); }
+    { CopyToImageStep s(in.img); WriteResult(f, in, "CopyToImage", TimeStep(s)); }
+    if (in.star.x >= 0)
+    {
+        StarFindStep s(in.img, in.star);
+        WriteResult(f, in, "StarFind", TimeStep(s));
+    }
+    { AutoFindStep s(in.img); WriteResult(f, in, "AutoFind", TimeStep(s)); }
+    { FrameEncodeStep s(in.img); WriteResult(f, in, "FrameEncode", TimeStep(s)); }
+    { FrameDecodeStep s(in.img); WriteResult(f, in, "FrameDecode", TimeStep(s)); }
+}
+
+static void ListFitsFiles(const wxString& path, wxArrayString *files)
+{
+    if (path.empty())
+        return;
+    if (wxDirExists(path))
+    {
+        wxDir::GetAllFiles(path, files, "*.fit", wxDIR_FILES);
+        wxDir::GetAllFiles(path, files, "*.fits", wxDIR_FILES);
+        wxDir::GetAllFiles(path, files, "*.fts", wxDIR_FILES);
+        files->Sort();
+    }
+    else
+        files->Add(path);
+}
+
+bool Benchmark::Run(const wxString& dataPath, const wxString& outFile, wxString *errorMsg)
+{
+    wxArrayString files;
+    ListFitsFiles(dataPath, &files);
+    if (!dataPath.empty() && files.empty())
+    {
+        *errorMsg = wxString::Format("no FITS files in %s", dataPath);
+        return true;
+    }
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!wxFileExists(files[i]))
+        {
+            *errorMsg = wxString::Format("cannot open %s", files[i]);
+            return true;
+        }
+    }
+
+    wxFFile f(outFile, "w");
+    if (!f.IsOpened())
+    {
+        *errorMsg = wxString::Format("cannot write %s", outFile);
+        return true;
+    }
+
+    f.Write(wxString::Format("# PHD2 %s benchmark, %s, %d cpus\n", FULLVER, wxDateTime::Now().FormatISOCombined(' '),
+        wxThread::GetCPUCount()));
+    f.Write("input,width,height,step,runs,min_us,median_us,mean_us,mpix_per_sec\n");
+
+    for (size_t i = 0; i < WXSIZEOF(SYNTHETIC_SIZES); i++)
+    {
+        BenchInput in;
+        MakeSynthetic(&in, SYNTHETIC_SIZES[i]);
+        RunInput(f, in);
+        f.Flush();
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        BenchInput in;
+        if (!LoadFits(&in, files[i]))
+        {
+            *errorMsg = wxString::Format("cannot load %s", files[i]);
+            return true;
+        }
+        RunInput(f, in);
+        f.Flush();
+    }
+
+    return false;
+}
+
+// Guide algorithm benchmark. Each algorithm guides a simulated star: the
+// input of each call is the star's offset after the drift of the sequence and
+// the corrections so far, the mount delivering each correction in full before
+// the next frame. The sequences are sampled at ALGO_EXPOSURE_SEC.
+
+static const double ALGO_EXPOSURE_SEC = 2.0;
+enum { ALGO_SYNTHETIC_STEPS = 20000, ALGO_WARMUP_STEPS = 500 };
+
+struct AlgoSequence
+{
+    wxString name;
+    GuideAxis axis;
+    std::vector<double> drift;      // offset change since the previous frame, pixels
+};
+
+static void MakeAlgoSequences(std::vector<AlgoSequence> *seqs)
+{
+    BenchRandom rnd(4321U);
+    double const dt = ALGO_EXPOSURE_SEC;
+
+    // RA: periodic error with a harmonic, slow drift, seeing
+    AlgoSequence ra;
+    ra.name = "synthetic_ra";
+    ra.axis = GUIDE_RA;
+    double prev = 0.0;
+    for (int i = 0; i < ALGO_SYNTHETIC_STEPS; i++)
+    {
+        double t = i * dt;
+        double pos = 4.0 * sin(2.0 * M_PI * t / 480.0) + 1.0 * sin(2.0 * M_PI * t / 160.0 + 1.0) + 0.002 * t +
+            0.3 * rnd.Gaussian();
+        ra.drift.push_back(i ? pos - prev : 0.0);
+        prev = pos;
+    }
+    seqs->push_back(ra);
+
+    // Dec: polar alignment drift and seeing
+    AlgoSequence dec;
+    dec.name = "synthetic_dec";
+    dec.axis = GUIDE_DEC;
+    prev = 0.0;
+    for (int i = 0; i < ALGO_SYNTHETIC_STEPS; i++)
+    {
+        double pos = 0.004 * i * dt + 0.3 * rnd.Gaussian();
+        dec.drift.push_back(i ? pos - prev : 0.0);
+        prev = pos;
+    }
+    seqs->push_back(dec);
+}
+
+static GuideAlgorithm *CreateBenchAlgorithm(int which, GuideAxis axis)
+{
+    // no mount: the settings go to a scratch group, see GuideAlgorithm::GetConfigPath()
+    switch (which)
+    {
+    case GUIDE_ALGORITHM_IDENTITY: return new GuideAlgorithmIdentity(0, axis);
+    case GUIDE_ALGORITHM_HYSTERESIS: return new GuideAlgorithmHysteresis(0, axis);
+    case GUIDE_ALGORITHM_LOWPASS: return new GuideAlgorithmLowpass(0, axis);
+    case GUIDE_ALGORITHM_LOWPASS2: return new GuideAlgorithmLowpass2(0, axis);
+    case GUIDE_ALGORITHM_RESIST_SWITCH: return new GuideAlgorithmResistSwitch(0, axis);
+    case GUIDE_ALGORITHM_PREDICTIVE_PEC: return new GuideAlgorithmPredictivePEC(0, axis);
+    case GUIDE_ALGORITHM_CHAIN: return new GuideAlgorithmChain(0, axis);
+#if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
+    case GUIDE_ALGORITHM_GAUSSIAN_PROCESS: return new GuideGaussianProcess(0, axis);
+#endif
+    default: return 0;
+    }
+}
+
+static const int BENCH_ALGORITHMS[] =
+{
+    GUIDE_ALGORITHM_IDENTITY,
+    GUIDE_ALGORITHM_HYSTERESIS,
+    GUIDE_ALGORITHM_LOWPASS,
+    GUIDE_ALGORITHM_LOWPASS2,
+    GUIDE_ALGORITHM_RESIST_SWITCH,
+    GUIDE_ALGORITHM_PREDICTIVE_PEC,
+    GUIDE_ALGORITHM_CHAIN,
+#if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
+    GUIDE_ALGORITHM_GAUSSIAN_PROCESS,
+#endif
+};
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+// returns true when the algorithm is over budget
+static bool BenchAlgorithm(wxFFile& f, GuideAlgorithm *algo, const AlgoSequence& seq, double budgetUs)
+{
+    std::vector<double> us;
+    us.reserve(seq.drift.size());
+
+    double pos = 0.0;
+    double correction = 0.0;
+    wxLongLong mem0 = 0;
+    AllocCounts allocs0, allocs1;
+    AllocTrack::GetCounts(&allocs0);
+
+    for (size_t i = 0; i < seq.drift.size(); i++)
+    {
+        if (i == ALGO_WARMUP_STEPS)
+        {
+            // growth is measured once the windows and histories have filled
+            mem0 = GuideLoopMetrics::ProcessMemory();
+            AllocTrack::GetCounts(&allocs0);
+        }
+        pos += seq.drift[i] - correction;
+
+        long long t0 = PerfTrace::Now();
+        correction = algo->result(pos);
+        us.push_back((double)(PerfTrace::Now() - t0));
+    }
+
+    wxLongLong mem1 = GuideLoopMetrics::ProcessMemory();
+    AllocTrack::GetCounts(&allocs1);
+
+    double total = 0.0;
+    for (size_t i = 0; i < us.size(); i++)
+        total += us[i];
+    std::sort(us.begin(), us.end());
+
+    double const p99 = Percentile(us, 0.99);
+    bool const over = p99 > budgetUs;
+    int const measured = (int) us.size() - ALGO_WARMUP_STEPS;
+    wxString allocs = AllocTrack::IsEnabled() && measured > 0 ?
+        wxString::Format("%.2f", (double)(allocs1.total - allocs0.total) / measured) : wxString("");
+
+    f.Write(wxString::Format("%s,%s,%s,%u,%.2f,%.1f,%.1f,%.1f,%.1f,%.0f,%s,%.0f,%s\n",
+        algo->GetGuideAlgorithmClassName(), seq.name, seq.axis == GUIDE_RA ? "RA" : "Dec", (unsigned int) us.size(),
+        total / us.size(), Percentile(us, 0.50), Percentile(us, 0.95), p99, us.back(),
+        mem0 > 0 && mem1 > 0 ? (mem1 - mem0).ToDouble() / 1024.0 : 0.0, allocs, budgetUs, over ? "over_budget" : "ok"));
+
+    return over;
+}
+
+bool Benchmark::RunGuideAlgorithms(const wxString& logFile, double budgetPercent, const wxString& outFile, int *overBudget,
+                                   wxString *errorMsg)
+{
+    *overBudget = 0;
+
+    std::vector<AlgoSequence> seqs;
+    MakeAlgoSequences(&seqs);
+
+    if (!logFile.empty())
+    {
+        AlgoSequence ra, dec;
+        if (Backtest::LoadDrift(logFile, &ra.drift, &dec.drift, errorMsg))
+            return true;
+        ra.name = dec.name = wxFileName(logFile).GetFullName();
+        ra.axis = GUIDE_RA;
+        dec.axis = GUIDE_DEC;
+        seqs.push_back(ra);
+        seqs.push_back(dec);
+    }
+
+    wxFFile f(outFile, "w");
+    if (!f.IsOpened())
+    {
+        *errorMsg = wxString::Format("cannot write %s", outFile);
+        return true;
+    }
+
+    double const budgetUs = budgetPercent / 100.0 * ALGO_EXPOSURE_SEC * 1.0e6;
+
+    f.Write(wxString::Format("# PHD2 %s guide algorithm benchmark, %s, budget %.2f%% of a %.1f s exposure\n", FULLVER,
+        wxDateTime::Now().FormatISOCombined(' '), budgetPercent, ALGO_EXPOSURE_SEC));
+    f.Write("algorithm,sequence,axis,calls,mean_us,p50_us,p95_us,p99_us,max_us,mem_growth_kb,allocs_per_call,budget_us,status\n");
+
+    // settings left at their defaults, and the algorithms log every step
+    pConfig->Profile.DeleteGroup("/backtest");
+    bool debugEnabled = Debug.Enable(false);
+
+    for (size_t a = 0; a < WXSIZEOF(BENCH_ALGORITHMS); a++)
+    {
+        for (size_t i = 0; i < seqs.size(); i++)
+        {
+            GuideAlgorithm *algo = CreateBenchAlgorithm(BENCH_ALGORITHMS[a], seqs[i].axis);
+            if (BenchAlgorithm(f, algo, seqs[i], budgetUs))
+                ++*overBudget;
+            delete algo;
+        }
+        f.Flush();
+    }
+
+    Debug.Enable(debugEnabled);
+    pConfig->Profile.DeleteGroup("/backtest");
+
+    return false;
+}
+
+// Host tuning. The steps are timed for less long than in Run so that the
+// profile wizard is kept waiting for a few seconds only. The budget is
+// checked at the exposure new profiles start with; a shorter exposure than
+// the recommended minimum leaves the guide loop short of CPU time.
+
+static const double TUNE_SECONDS = 0.2;
+enum { TUNE_MIN_RUNS = 3, TUNE_CYCLES = 30 };
+static const double TUNE_EXPOSURE_US = 1.0e6;
+static const double AUTOFIND_BUDGET_US = 0.5e6;     // AutoFind runs once per star selection, not per frame
+enum { SUBFRAME_SIZE = 80 };                        // about the guider's subframe with the default search region
+enum { MAX_DISPLAY_RATE = 10 };                     // the default display rate cap
+
+// one guide cycle as the worker thread and the guider run it, without the
+// exposure: calibrate, find the star, stretch the frame for display
+struct GuideCycleStep : public CopyStep
+{
+    PreparedDark *dark;
+    int nr;
+    bool subframes;
+    wxPoint star;
+    wxImage *disp;
+    GuideCycleStep(const BenchInput& in, int nr_, bool subframes_)
+        : CopyStep(in.img), dark(new PreparedDark(in.dark)), nr(nr_), subframes(subframes_), star(in.star), disp(0) { }
+    ~GuideCycleStep() { dark->Release(); delete disp; }
+    void Step()
+    {
+        if (subframes)
+        {
+            wxRect sub(star.x - SUBFRAME_SIZE / 2, star.y - SUBFRAME_SIZE / 2, SUBFRAME_SIZE, SUBFRAME_SIZE);
+            sub.Intersect(wxRect(work.Size));
+            work.Subframe = sub;
+            dark->Subtract(work);
+            if (nr == NR_2x2MEAN)
+                QuickLRecon(work, sub);
+            else if (nr == NR_3x3MEDIAN)
+                Median3(work, sub);
+            work.CalcStats(sub);
+        }
+        else
+            CalibrateFrame(work, dark, nr, true);
+
+        Star s;
+        s.Find(&work, 15, star.x, star.y, Star::FIND_CENTROID);
+        work.CopyToImage(&disp, work.FiltMin, work.FiltMax, 0.4);
+    }
+};
+
+void Benchmark::TuneHost(const wxSize& frameSize, double budgetFraction, HostTuning *t)
+{
+    static const int NR_METHODS[] = { NR_NONE, NR_2x2MEAN, NR_3x3MEDIAN };
+    static const int DOWNSAMPLE[] = { 1, 2, 4 };
+
+    SyntheticSize sz = { "host", frameSize.GetWidth(), frameSize.GetHeight() };
+    BenchInput in;
+    MakeSynthetic(&in, sz);
+
+    t->frameSize = frameSize;
+
+    for (size_t i = 0; i < WXSIZEOF(NR_METHODS); i++)
+    {
+        CalibrateStep s(in.img, in.dark, NR_METHODS[i]);
+        t->calibrateUs[i] = TimeStep(s, TUNE_SECONDS, TUNE_MIN_RUNS).medianUs;
+    }
+    { CopyToImageStep s(in.img); t->displayUs = TimeStep(s, TUNE_SECONDS, TUNE_MIN_RUNS).medianUs; }
+    double findUs;
+    { StarFindStep s(in.img, in.star); findUs = TimeStep(s, TUNE_SECONDS, TUNE_MIN_RUNS).medianUs; }
+
+    // AutoFind reads its downsample factor from the profile
+    int const prevDownsample = pConfig->Profile.GetInt("/StarAutoFind/Downsample", 0);
+    for (size_t i = 0; i < WXSIZEOF(DOWNSAMPLE); i++)
+    {
+        pConfig->Profile.SetInt("/StarAutoFind/Downsample", DOWNSAMPLE[i]);
+        AutoFindStep s(in.img);
+        t->autoFindUs[i] = TimeStep(s, TUNE_SECONDS, TUNE_MIN_RUNS).medianUs;
+    }
+    pConfig->Profile.SetInt("/StarAutoFind/Downsample", prevDownsample);
+
+    double const budgetUs = budgetFraction * TUNE_EXPOSURE_US;
+
+    // display updates are capped per second, so their share of the CPU time
+    // is the same at any exposure
+    t->maxDisplayRate = wxMax(1, wxMin((int) MAX_DISPLAY_RATE, (int) (budgetUs / wxMax(t->displayUs, 1.0))));
+
+    // the most noise reduction that fits, on the full frame if it can be
+    // afforded; on a subframe the calibration costs next to nothing
+    t->useSubframes = true;
+    t->noiseReduction = NR_3x3MEDIAN;
+    for (int i = WXSIZEOF(NR_METHODS) - 1; i >= 0; i--)
+    {
+        if (t->calibrateUs[i] + findUs + t->displayUs <= budgetUs)
+        {
+            t->useSubframes = false;
+            t->noiseReduction = NR_METHODS[i];
+            break;
+        }
+    }
+
+    // the finest downsample that keeps AutoFind quick; 0 if that is what
+    // the frame size would get anyway
+    t->autoFindDownsample = DOWNSAMPLE[WXSIZEOF(DOWNSAMPLE) - 1];
+    for (size_t i = 0; i < WXSIZEOF(DOWNSAMPLE); i++)
+    {
+        if (t->autoFindUs[i] <= AUTOFIND_BUDGET_US)
+        {
+            t->autoFindDownsample = DOWNSAMPLE[i];
+            break;
+        }
+    }
+    double const mpix = (double) frameSize.GetWidth() * (double) frameSize.GetHeight() / 1.0e6;
+    if (t->autoFindDownsample == (mpix >= 16.0 ? 4 : mpix >= 4.0 ? 2 : 1))
+        t->autoFindDownsample = 0;
+
+    // a short guide loop with the recommended settings
+    GuideCycleStep cycle(in, t->noiseReduction, t->useSubframes);
+    t->cycleUs = TimeStep(cycle, 0.0, TUNE_CYCLES).meanUs;
+    t->minExposureMs = (int) ceil(t->cycleUs / budgetFraction / 1000.0 / 50.0) * 50;
+
+    Debug.Write(wxString::Format("Benchmark: host tuning %dx%d calibrate %.0f/%.0f/%.0f us display %.0f us find %.0f us "
+        "autofind %.0f/%.0f/%.0f us cycle %.0f us: nr %d subframes %d display rate %d autofind downsample %d min exposure %d ms\n",
+        frameSize.GetWidth(), frameSize.GetHeight(), t->calibrateUs[0], t->calibrateUs[1], t->calibrateUs[2], t->displayUs, findUs,
+        t->autoFindUs[0], t->autoFindUs[1], t->autoFindUs[2], t->cycleUs, t->noiseReduction, t->useSubframes, t->maxDisplayRate,
+        t->autoFindDownsample, t->minExposureMs));
+}
@@ -0,0 +1,81 @@
+/*
+ *  benchmark.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef BENCHMARK_INCLUDED
+#define BENCHMARK_INCLUDED
+
+// Processing times of the guide loop measured on this computer, and the
+// settings that keep the processing under a fraction of the guide cycle
+struct HostTuning
+{
+    wxSize frameSize;
+    // measured, microseconds per frame
+    double calibrateUs[3];      // dark subtraction with each NOISE_REDUCTION_METHOD, full frame
+    double displayUs;           // display stretch of the full frame
+    double autoFindUs[3];       // AutoFind binning the frame by 1, 2 and 4
+    double cycleUs;             // a simulated guide cycle with the recommended settings
+    // recommended
+    int noiseReduction;         // a NOISE_REDUCTION_METHOD
+    bool useSubframes;
+    int maxDisplayRate;         // display updates per second
+    int autoFindDownsample;     // 0 if the default for the frame size will do
+    int minExposureMs;          // the shortest exposure the processing fits
+};
+
+// Timings of the image processing and star finding steps of the guide loop,
+// for comparing builds. Each step runs on synthetic frames of several sensor
+// sizes, and on the FITS frames in dataPath (a file or a directory, may be
+// empty). Results go to a CSV file, one row per input and step, with the
+// per-call time in microseconds.
+struct Benchmark
+{
+    // returns true on error
+    static bool Run(const wxString& dataPath, const wxString& outFile, wxString *errorMsg);
+
+    // Per-call latency percentiles, memory growth and, in builds that count
+    // them, allocations of each guide algorithm guiding long synthetic
+    // sequences and, if logFile is given, the drift recorded in a guide log.
+    // An algorithm whose 99th percentile exceeds budgetPercent of the
+    // exposure is counted in *overBudget.
+    static bool RunGuideAlgorithms(const wxString& logFile, double budgetPercent, const wxString& outFile, int *overBudget,
+                                   wxString *errorMsg);
+
+    // Times the processing of a synthetic frame of the given size and a
+    // short simulated guide loop, and recommends the HostTuning settings that
+    // keep the processing under budgetFraction of a guide cycle. Takes a few
+    // seconds. AutoFind is timed by changing the current profile's
+    // downsample setting, which is restored afterwards.
+    static void TuneHost(const wxSize& frameSize, double budgetFraction, HostTuning *tuning);
+};
+
+#endif
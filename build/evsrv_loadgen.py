@@ -0,0 +1,415 @@
+#!/usr/bin/env python3
+#
+# Load generator and throughput benchmark for the PHD2 event server.
+#
+# Opens N clients to a running PHD2 (or starts one in the hardware-free
+# guide benchmark mode with --phd2), has each of them issue a mix of
+# JSON-RPC requests at a set rate while receiving the event stream, and
+# reports:
+#
+#   - RPC latency percentiles per method, and errors
+#   - event delivery latency (receive time minus the event Timestamp) per
+#     event, for events of the instance on this host
+#   - dither to SettleDone times, when dithering
+#   - the guide cycle timing (get_cycle_timing) of a phase without load and
+#     of the loaded phase, to show what the load costs the guide loop
+#
+# Examples:
+#
+#   evsrv_loadgen.py --clients 20 --duration 60
+#   evsrv_loadgen.py --phd2 ./phd2 --clients 50 --rate 20 --dither-interval 30
+#   evsrv_loadgen.py --mix get_app_state=1,get_star_image=1 --subscribe GuideStep --json out.json
+#
+# The cycle timing phases reset the session histograms of the instance
+# (get_cycle_timing reset=true), so do not run this against an instance whose
+# session statistics matter.
+#
+
+import argparse
+import json
+import os
+import random
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+DEFAULT_MIX = "get_app_state=4,get_metrics=2,get_lock_position=2,get_star_image=1"
+
+
+def percentiles(values):
+    if not values:
+        return None
+    v = sorted(values)
+
+    def p(q):
+        return v[min(len(v) - 1, int(q * (len(v) - 1) + 0.5))]
+    return {
+        "count": len(v),
+        "mean": sum(v) / len(v),
+        "p50": p(0.50),
+        "p95": p(0.95),
+        "p99": p(0.99),
+        "max": v[-1],
+    }
+
+
+class Client(object):
+    """One event server connection; a thread reads responses and events."""
+
+    def __init__(self, host, port, stats):
+        # the event Timestamp is only comparable with our clock on the same host
+        self.local = host in ("localhost", "127.0.0.1", "::1")
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.sock.settimeout(None)
+        self.stats = stats
+        self.lock = threading.Lock()
+        self.next_id = 1
+        self.pending = {}       # id -> (method, send time, event for waiters, response holder)
+        self.closed = False
+        self.event_waiters = []
+        self.reader = threading.Thread(target=self.read_loop)
+        self.reader.daemon = True
+        self.reader.start()
+
+    def close(self):
+        self.closed = True
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except socket.error:
+            pass
+        self.sock.close()
+
+    def send(self, method, params=None, wait=False, timeout=30.0):
+        with self.lock:
+            rid = self.next_id
+            self.next_id += 1
+            done = threading.Event() if wait else None
+            holder = {}
+            self.pending[rid] = (method, time.time(), done, holder)
+        req = {"method": method, "id": rid}
+        if params is not None:
+            req["params"] = params
+        self.sock.sendall((json.dumps(req) + "\r\n").encode("utf-8"))
+        if wait:
+            if not done.wait(timeout):
+                raise RuntimeError("no response to %s" % method)
+            return holder.get("msg")
+        return None
+
+    def wait_event(self, name, timeout):
+        ev = threading.Event()
+        holder = {}
+        with self.lock:
+            self.event_waiters.append((name, ev, holder))
+        if not ev.wait(timeout):
+            return None
+        return holder["msg"]
+
+    def read_loop(self):
+        buf = b""
+        while not self.closed:
+            try:
+                data = self.sock.recv(65536)
+            except socket.error:
+                break
+            if not data:
+                break
+            buf += data
+            while True:
+                nl = buf.find(b"\n")
+                if nl < 0:
+                    break
+                line, buf = buf[:nl].strip(), buf[nl + 1:]
+                if line:
+                    self.handle(line)
+
+    def handle(self, line):
+        now = time.time()
+        try:
+            msg = json.loads(line.decode("utf-8"))
+        except ValueError:
+            self.stats.add_error("bad json")
+            return
+        if "jsonrpc" in msg and "id" in msg:
+            with self.lock:
+                entry = self.pending.pop(msg["id"], None)
+            if entry is None:
+                return
+            method, sent, done, holder = entry
+            self.stats.add_rpc(method, (now - sent) * 1000.0, "error" in msg)
+            if done is not None:
+                holder["msg"] = msg
+                done.set()
+        elif "Event" in msg:
+            name = msg["Event"]
+            ts = msg.get("Timestamp")
+            if ts is not None and (self.local or msg.get("Host") == socket.gethostname()):
+                self.stats.add_event(name, (now - ts) * 1000.0)
+            else:
+                self.stats.add_event(name, None)
+            with self.lock:
+                waiters = [w for w in self.event_waiters if w[0] == name]
+                self.event_waiters = [w for w in self.event_waiters if w[0] != name]
+            for _, ev, holder in waiters:
+                holder["msg"] = msg
+                ev.set()
+
+
+class Stats(object):
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.rpc = {}
+        self.rpc_errors = {}
+        self.events = {}
+        self.event_counts = {}
+        self.errors = {}
+        self.settle = []
+
+    def add_rpc(self, method, ms, error):
+        with self.lock:
+            self.rpc.setdefault(method, []).append(ms)
+            if error:
+                self.rpc_errors[method] = self.rpc_errors.get(method, 0) + 1
+
+    def add_event(self, name, ms):
+        with self.lock:
+            self.event_counts[name] = self.event_counts.get(name, 0) + 1
+            if ms is not None:
+                self.events.setdefault(name, []).append(ms)
+
+    def add_error(self, what):
+        with self.lock:
+            self.errors[what] = self.errors.get(what, 0) + 1
+
+    def add_settle(self, sec):
+        with self.lock:
+            self.settle.append(sec)
+
+
+def parse_mix(spec):
+    mix = []
+    for item in spec.split(","):
+        item = item.strip()
+        if not item:
+            continue
+        name, _, weight = item.partition("=")
+        mix.append((name, float(weight) if weight else 1.0))
+    return mix
+
+
+def rpc_params(method):
+    if method == "get_star_image":
+        return {"size": 32}
+    if method == "get_guide_history":
+        return {"max": 100}
+    return None
+
+
+def worker(client, mix, rate, stop):
+    names = [m[0] for m in mix]
+    weights = [m[1] for m in mix]
+    interval = 1.0 / rate if rate > 0 else 0.0
+    next_t = time.time() + random.random() * interval
+    while not stop.is_set():
+        now = time.time()
+        if now < next_t:
+            stop.wait(next_t - now)
+            continue
+        next_t += interval
+        method = random.choices(names, weights)[0]
+        try:
+            client.send(method, rpc_params(method))
+        except socket.error:
+            client.stats.add_error("send failed")
+            return
+
+
+def ditherer(client, interval, stats, stop):
+    while not stop.wait(interval):
+        t0 = time.time()
+        try:
+            resp = client.send("dither", {"amount": 3, "raOnly": False,
+                                          "settle": {"pixels": 1.5, "time": 4, "timeout": 60}}, wait=True)
+        except (RuntimeError, socket.error):
+            stats.add_error("dither failed")
+            continue
+        if not resp or "error" in resp:
+            stats.add_error("dither rejected")
+            continue
+        ev = client.wait_event("SettleDone", 90)
+        if ev is None or ev.get("Status", 1) != 0:
+            stats.add_error("settle failed")
+        else:
+            stats.add_settle(time.time() - t0)
+
+
+def cycle_timing(ctl, reset):
+    resp = ctl.send("get_cycle_timing", {"reset": reset}, wait=True)
+    return resp.get("result") if resp else None
+
+
+def wait_for_port(host, port, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            socket.create_connection((host, port), timeout=2).close()
+            return True
+        except socket.error:
+            time.sleep(1)
+    return False
+
+
+def wait_guiding(ctl, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        resp = ctl.send("get_app_state", wait=True)
+        if resp and resp.get("result") == "Guiding":
+            return True
+        time.sleep(1)
+    return False
+
+
+def summarize_cycle(t):
+    if not t:
+        return None
+    s = t.get("session", {})
+    return {
+        "cycles": t.get("cycles"),
+        "slow_cycles": t.get("slow_cycles"),
+        "cycle": s.get("cycle"),
+        "notify": s.get("notify"),
+    }
+
+
+def print_table(title, rows):
+    print(title)
+    print("  %-28s %8s %9s %9s %9s %9s %9s" % ("", "count", "mean", "p50", "p95", "p99", "max"))
+    for name, p in rows:
+        if p:
+            print("  %-28s %8d %9.2f %9.2f %9.2f %9.2f %9.2f" %
+                  (name, p["count"], p["mean"], p["p50"], p["p95"], p["p99"], p["max"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="PHD2 event server load generator")
+    ap.add_argument("--host", default="localhost")
+    ap.add_argument("--port", type=int, default=4400, help="4400 + instance - 1")
+    ap.add_argument("--clients", type=int, default=10)
+    ap.add_argument("--rate", type=float, default=5.0, help="requests per second per client")
+    ap.add_argument("--mix", default=DEFAULT_MIX, help="method=weight,... (default %(default)s)")
+    ap.add_argument("--subscribe", default="", help="comma separated events for set_event_filter, default all")
+    ap.add_argument("--duration", type=float, default=60.0, help="seconds of load")
+    ap.add_argument("--baseline", type=float, default=30.0, help="seconds of guiding without load first, 0 to skip")
+    ap.add_argument("--dither-interval", type=float, default=0.0, help="seconds between dithers, 0 for none")
+    ap.add_argument("--phd2", help="start this phd2 in --guidebench mode and guide the simulator")
+    ap.add_argument("--benchspec", default="width=1280,height=960,stars=20", help="--benchspec for --phd2")
+    ap.add_argument("--json", help="also write the results to this file")
+    args = ap.parse_args()
+
+    proc = None
+    if args.phd2:
+        out = os.path.join(tempfile.gettempdir(), "phd2_loadgen_guidebench.csv")
+        proc = subprocess.Popen([args.phd2, "--guidebench=" + out, "--benchspec=frames=100000000," + args.benchspec])
+        if not wait_for_port(args.host, args.port, 60):
+            print("phd2 did not open the event server", file=sys.stderr)
+            proc.kill()
+            return 1
+
+    stats = Stats()
+    ctl = Client(args.host, args.port, Stats())
+    try:
+        if not wait_guiding(ctl, 600):
+            print("PHD2 is not guiding", file=sys.stderr)
+            return 1
+
+        baseline = None
+        if args.baseline > 0:
+            cycle_timing(ctl, True)
+            time.sleep(args.baseline)
+            baseline = summarize_cycle(cycle_timing(ctl, True))
+        else:
+            cycle_timing(ctl, True)
+
+        clients = []
+        for _ in range(args.clients):
+            c = Client(args.host, args.port, stats)
+            if args.subscribe:
+                c.send("set_event_filter", {"events": [e.strip() for e in args.subscribe.split(",")]})
+            clients.append(c)
+
+        stop = threading.Event()
+        mix = parse_mix(args.mix)
+        threads = [threading.Thread(target=worker, args=(c, mix, args.rate, stop)) for c in clients]
+        if args.dither_interval > 0:
+            threads.append(threading.Thread(target=ditherer, args=(clients[0] if clients else ctl,
+                                                                   args.dither_interval, stats, stop)))
+        t0 = time.time()
+        for t in threads:
+            t.daemon = True
+            t.start()
+        time.sleep(args.duration)
+        elapsed = time.time() - t0
+        loaded = summarize_cycle(cycle_timing(ctl, False))
+        stop.set()
+        for t in threads:
+            t.join(5)
+        time.sleep(1)           # responses in flight
+        for c in clients:
+            c.close()
+
+        with stats.lock:
+            rpc = dict((m, percentiles(v)) for m, v in stats.rpc.items())
+            events = dict((e, percentiles(v)) for e, v in stats.events.items())
+            nreq = sum(len(v) for v in stats.rpc.values())
+            result = {
+                "clients": args.clients,
+                "duration": elapsed,
+                "requests": nreq,
+                "requests_per_sec": nreq / elapsed if elapsed > 0 else 0.0,
+                "rpc_ms": rpc,
+                "rpc_errors": stats.rpc_errors,
+                "event_counts": stats.event_counts,
+                "event_latency_ms": events,
+                "settle_sec": percentiles(stats.settle),
+                "errors": stats.errors,
+                "cycle_baseline": baseline,
+                "cycle_loaded": loaded,
+            }
+    finally:
+        if proc:
+            try:
+                ctl.send("shutdown")
+            except socket.error:
+                pass
+            try:
+                proc.wait(30)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+        ctl.close()
+
+    print("%d clients, %.0f s, %d requests (%.1f/s)" % (args.clients, result["duration"], result["requests"],
+                                                      result["requests_per_sec"]))
+    print_table("RPC latency, ms", sorted(rpc.items()))
+    print_table("event delivery latency, ms", sorted(events.items()))
+    if result["settle_sec"]:
+        print_table("dither to SettleDone, s", [("dither", result["settle_sec"])])
+    for name, c in (("without load", baseline), ("under load", loaded)):
+        if c and c.get("cycle"):
+            cy = c["cycle"]
+            nt = c.get("notify") or {}
+            print("guide cycle %s: %s cycles, %s slow, processing p50 %.2f p99 %.2f ms, notify p99 %.2f ms" %
+                  (name, c["cycles"], c["slow_cycles"], cy["p50"], cy["p99"], nt.get("p99", 0.0)))
+    if stats.errors or stats.rpc_errors:
+        print("errors: %s rpc errors: %s" % (stats.errors, stats.rpc_errors))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
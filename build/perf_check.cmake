@@ -0,0 +1,154 @@
+#
+# Performance regression check, run by the perf_* CTest tests (see the
+# PHD2_PERF_TESTS option in CMakeLists.txt) as
+#
+#   cmake -DPHD2=<phd2> -DMODE=kernels|guide -DBASELINE=<csv> -DMARGIN=<percent>
+#         -DOUT_DIR=<dir> [-DBENCH_SPEC=<spec>] [-DUPDATE=1] -P perf_check.cmake
+#
+# MODE=kernels runs phd2 --benchmark and checks the dark subtract, star find
+# and display stretch (CopyToImage) times on the synthetic frames. MODE=guide
+# runs phd2 --guidebench and checks the time per guide cycle. A metric fails
+# when it is more than MARGIN percent slower than the baseline. With UPDATE
+# set the results become the new baseline instead.
+#
+# The results are also written to OUT_DIR/perf_<mode>.json for publishing.
+#
+
+if(NOT PHD2 OR NOT MODE OR NOT BASELINE OR NOT OUT_DIR)
+  message(FATAL_ERROR "perf_check.cmake needs PHD2, MODE, BASELINE and OUT_DIR")
+endif()
+if(NOT MARGIN)
+  set(MARGIN 15)
+endif()
+
+set(kernel_steps Subtract StarFind CopyToImage)
+
+file(MAKE_DIRECTORY ${OUT_DIR})
+set(results_csv ${OUT_DIR}/perf_${MODE}.csv)
+
+if(MODE STREQUAL "kernels")
+  execute_process(COMMAND ${PHD2} --benchmark=${results_csv} RESULT_VARIABLE rc)
+elseif(MODE STREQUAL "guide")
+  if(NOT BENCH_SPEC)
+    set(BENCH_SPEC "frames=1000")
+  endif()
+  execute_process(COMMAND ${PHD2} --guidebench=${results_csv} --benchspec=${BENCH_SPEC} RESULT_VARIABLE rc)
+else()
+  message(FATAL_ERROR "unknown MODE ${MODE}")
+endif()
+if(NOT EXISTS ${results_csv})
+  message(FATAL_ERROR "${PHD2} did not write ${results_csv} (exit code ${rc})")
+endif()
+
+# metric names and values, lower is better
+set(names)
+file(STRINGS ${results_csv} lines)
+foreach(line ${lines})
+  if(NOT line MATCHES "^#")
+    string(REPLACE "," ";" fields "${line}")
+    if(MODE STREQUAL "kernels")
+      # input,width,height,step,runs,min_us,median_us,...
+      list(LENGTH fields n)
+      if(n GREATER 6)
+        list(GET fields 0 input)
+        list(GET fields 3 step)
+        list(FIND kernel_steps "${step}" idx)
+        if(input MATCHES "^synthetic_" AND NOT idx EQUAL -1)
+          list(GET fields 6 val)
+          list(APPEND names "${input}.${step}_us")
+          set(value_${input}.${step}_us ${val})
+        endif()
+      endif()
+    else()
+      # key,value
+      list(GET fields 0 key)
+      if(key STREQUAL "cycle_us")
+        list(GET fields 1 val)
+        list(APPEND names cycle_us)
+        set(value_cycle_us ${val})
+      endif()
+    endif()
+  endif()
+endforeach()
+if(NOT names)
+  message(FATAL_ERROR "no ${MODE} metrics in ${results_csv}")
+endif()
+
+if(UPDATE)
+  get_filename_component(dir ${BASELINE} PATH)
+  file(MAKE_DIRECTORY ${dir})
+  set(text "# PHD2 ${MODE} baseline, lower is better\n")
+  foreach(name ${names})
+    set(text "${text}${name},${value_${name}}\n")
+  endforeach()
+  file(WRITE ${BASELINE} "${text}")
+  message(STATUS "wrote ${BASELINE}")
+  return()
+endif()
+
+set(have_baseline false)
+if(EXISTS ${BASELINE})
+  set(have_baseline true)
+  file(STRINGS ${BASELINE} lines)
+  foreach(line ${lines})
+    if(NOT line MATCHES "^#")
+      string(REPLACE "," ";" fields "${line}")
+      list(GET fields 0 key)
+      list(GET fields 1 val)
+      set(base_${key} ${val})
+    endif()
+  endforeach()
+else()
+  message(STATUS "no baseline ${BASELINE}, nothing to compare against")
+endif()
+
+# math(EXPR) is integer only, compare in tenths
+macro(to_tenths val out)
+  string(REGEX MATCH "^([0-9]+)(\\.([0-9]))?" _m "${val}")
+  set(_i ${CMAKE_MATCH_1})
+  set(_f ${CMAKE_MATCH_3})
+  if(NOT _f)
+    set(_f 0)
+  endif()
+  math(EXPR ${out} "${_i} * 10 + ${_f}")
+endmacro()
+
+set(failed)
+set(json_metrics)
+foreach(name ${names})
+  set(val ${value_${name}})
+  set(status "new")
+  set(base "null")
+  if(DEFINED base_${name})
+    set(base ${base_${name}})
+    to_tenths(${val} v)
+    to_tenths(${base} b)
+    math(EXPR limit "${b} + ${b} * ${MARGIN} / 100")
+    if(v GREATER limit)
+      set(status "regressed")
+      list(APPEND failed ${name})
+      message(STATUS "${name}: ${val}, baseline ${base}, more than ${MARGIN}% slower")
+    else()
+      set(status "ok")
+      message(STATUS "${name}: ${val}, baseline ${base}")
+    endif()
+  else()
+    message(STATUS "${name}: ${val}")
+  endif()
+  if(json_metrics)
+    set(json_metrics "${json_metrics},\n")
+  endif()
+  set(json_metrics "${json_metrics}    { \"name\": \"${name}\", \"value\": ${val}, \"baseline\": ${base}, \"status\": \"${status}\" }")
+endforeach()
+
+if(failed)
+  set(passed false)
+else()
+  set(passed true)
+endif()
+string(TIMESTAMP now "%Y-%m-%dT%H:%M:%SZ" UTC)
+file(WRITE ${OUT_DIR}/perf_${MODE}.json "{\n  \"mode\": \"${MODE}\",\n  \"time\": \"${now}\",\n  \"margin_percent\": ${MARGIN},\n  \"baseline\": ${have_baseline},\n  \"passed\": ${passed},\n  \"metrics\": [\n${json_metrics}\n  ]\n}\n")
+
+if(failed)
+  message(FATAL_ERROR "performance regression: ${failed}")
+endif()
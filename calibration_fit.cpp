@@ -0,0 +1,228 @@
+/*
+ *  calibration_fit.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+enum { MAX_TERMS = 4 };
+
+// Solves the normal equations by Gauss-Jordan elimination, leaving the
+// inverse of ata in inv. Returns true if the system is singular.
+static bool InvertNormalMatrix(double ata[MAX_TERMS][MAX_TERMS], int n, double inv[MAX_TERMS][MAX_TERMS])
+{
+    double a[MAX_TERMS][2 * MAX_TERMS];
+
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            a[i][j] = ata[i][j];
+            a[i][n + j] = i == j ? 1.0 : 0.0;
+        }
+    }
+
+    for (int col = 0; col < n; col++)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++)
+            if (fabs(a[row][col]) > fabs(a[pivot][col]))
+                pivot = row;
+
+        // the terms are scaled to about one, so a tiny pivot means two
+        // columns are (nearly) collinear
+        if (fabs(a[pivot][col]) < 1e-9)
+            return true;
+
+        if (pivot != col)
+            for (int j = 0; j < 2 * n; j++)
+                std::swap(a[col][j], a[pivot][j]);
+
+        double d = a[col][col];
+        for (int j = 0; j < 2 * n; j++)
+            a[col][j] /= d;
+
+        for (int row = 0; row < n; row++)
+        {
+            if (row == col)
+                continue;
+            double f = a[row][col];
+            if (f != 0.0)
+                for (int j = 0; j < 2 * n; j++)
+                    a[row][j] -= f * a[col][j];
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            inv[i][j] = a[i][n + j];
+
+    return false;
+}
+
+CalibrationFit::CalibrationFit()
+    : m_startTime(0.0)
+{
+}
+
+void CalibrationFit::Reset(void)
+{
+    m_samples.clear();
+    m_startTime = 0.0;
+}
+
+void CalibrationFit::AddSample(const PHD_Point& position, double pulse, double time, bool returnLeg)
+{
+    if (m_samples.empty())
+        m_startTime = time;
+
+    Sample s;
+    s.x = position.X;
+    s.y = position.Y;
+    s.pulse = pulse;
+    s.elapsed = time - m_startTime;
+    s.returnLeg = returnLeg;
+    m_samples.push_back(s);
+}
+
+bool CalibrationFit::FitForward(Result *result) const
+{
+    return Fit(false, result);
+}
+
+bool CalibrationFit::FitBothLegs(Result *result) const
+{
+    return Fit(true, result);
+}
+
+// The model for each image axis is
+//
+//   pos = a + b * pulse [+ c * elapsed + d * returnLeg]
+//
+// where b is the motion per ms of guide pulse. The x and y fits share the
+// normal matrix, and are combined into the rate and angle of (bx, by).
+bool CalibrationFit::Fit(bool bothLegs, Result *result) const
+{
+    int nterms = bothLegs ? 4 : 2;
+    int n = 0;
+    int nReturn = 0;
+
+    double pulseScale = 0.0;
+    double timeScale = 0.0;
+    for (std::vector<Sample>::const_iterator it = m_samples.begin(); it != m_samples.end(); ++it)
+    {
+        if (it->returnLeg && !bothLegs)
+            continue;
+        ++n;
+        if (it->returnLeg)
+            ++nReturn;
+        pulseScale = std::max(pulseScale, fabs(it->pulse));
+        timeScale = std::max(timeScale, it->elapsed);
+    }
+
+    // need residual degrees of freedom for the error estimate, and at least
+    // two return samples to separate the drift from the return-leg offset
+    if (n <= nterms || pulseScale <= 0.0 || (bothLegs && (nReturn < 2 || timeScale <= 0.0)))
+        return true;
+
+    double ata[MAX_TERMS][MAX_TERMS] = { { 0.0 } };
+    double atx[MAX_TERMS] = { 0.0 };
+    double aty[MAX_TERMS] = { 0.0 };
+
+    for (std::vector<Sample>::const_iterator it = m_samples.begin(); it != m_samples.end(); ++it)
+    {
+        if (it->returnLeg && !bothLegs)
+            continue;
+
+        double row[MAX_TERMS] = { 1.0, it->pulse / pulseScale, it->elapsed / timeScale, it->returnLeg ? 1.0 : 0.0 };
+
+        for (int i = 0; i < nterms; i++)
+        {
+            for (int j = 0; j < nterms; j++)
+                ata[i][j] += row[i] * row[j];
+            atx[i] += row[i] * it->x;
+            aty[i] += row[i] * it->y;
+        }
+    }
+
+    double inv[MAX_TERMS][MAX_TERMS];
+    if (InvertNormalMatrix(ata, nterms, inv))
+        return true;
+
+    double px[MAX_TERMS];
+    double py[MAX_TERMS];
+    for (int i = 0; i < nterms; i++)
+    {
+        px[i] = py[i] = 0.0;
+        for (int j = 0; j < nterms; j++)
+        {
+            px[i] += inv[i][j] * atx[j];
+            py[i] += inv[i][j] * aty[j];
+        }
+    }
+
+    double ssx = 0.0;
+    double ssy = 0.0;
+    for (std::vector<Sample>::const_iterator it = m_samples.begin(); it != m_samples.end(); ++it)
+    {
+        if (it->returnLeg && !bothLegs)
+            continue;
+
+        double row[MAX_TERMS] = { 1.0, it->pulse / pulseScale, it->elapsed / timeScale, it->returnLeg ? 1.0 : 0.0 };
+        double fx = 0.0;
+        double fy = 0.0;
+        for (int i = 0; i < nterms; i++)
+        {
+            fx += px[i] * row[i];
+            fy += py[i] * row[i];
+        }
+        ssx += (it->x - fx) * (it->x - fx);
+        ssy += (it->y - fy) * (it->y - fy);
+    }
+
+    double bx = px[1] / pulseScale;
+    double by = py[1] / pulseScale;
+    double varBx = ssx / (n - nterms) * inv[1][1] / (pulseScale * pulseScale);
+    double varBy = ssy / (n - nterms) * inv[1][1] / (pulseScale * pulseScale);
+
+    double rate = hypot(bx, by);
+    if (rate <= 0.0)
+        return true;
+
+    result->rate = rate;
+    result->angle = atan2(by, bx);
+    result->rateErr = sqrt((bx * bx * varBx + by * by * varBy)) / rate;
+    result->angleErr = sqrt((by * by * varBx + bx * bx * varBy)) / (rate * rate);
+    result->samples = n;
+
+    return false;
+}
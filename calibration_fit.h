@@ -0,0 +1,91 @@
+/*
+ *  calibration_fit.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef CALIBRATION_FIT_INCLUDED
+#define CALIBRATION_FIT_INCLUDED
+
+// Least-squares fit of the star position against the guide pulse time for
+// one calibration axis. Every calibration step adds a sample, so the rate
+// and angle use all of the centroids instead of only the end points, and
+// the standard errors of the fit tell the calibration when it has moved the
+// star far enough.
+//
+// Samples from the return leg (the East or South recentering moves) can be
+// included too. The fit of both legs adds a drift term, which separates the
+// mount's drift from the guide rate, and a constant offset for the return
+// leg, which absorbs backlash at the reversal.
+class CalibrationFit
+{
+public:
+    struct Result
+    {
+        double rate;        // pixels per ms
+        double angle;       // radians, direction of the motion for a positive pulse
+        double rateErr;     // standard error of rate
+        double angleErr;    // standard error of angle
+        int samples;
+    };
+
+private:
+    struct Sample
+    {
+        double x;
+        double y;
+        double pulse;
+        double elapsed;
+        bool returnLeg;
+    };
+    std::vector<Sample> m_samples;
+    double m_startTime;
+
+public:
+    CalibrationFit();
+
+    void Reset(void);
+
+    // position relative to the start of the forward leg; pulse is the net
+    // pulse time in ms sent in the forward direction so far; time in ms
+    void AddSample(const PHD_Point& position, double pulse, double time, bool returnLeg);
+    int SampleCount(void) const { return (int) m_samples.size(); }
+
+    // fit of the forward leg, returns true on error
+    bool FitForward(Result *result) const;
+    // fit of both legs with drift and return-leg offset terms, returns true on error
+    bool FitBothLegs(Result *result) const;
+
+private:
+    bool Fit(bool bothLegs, Result *result) const;
+};
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ *  calibration_store.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+enum { MAX_STORED_CALIBRATIONS = 8 };
+
+static const double ROTATOR_MATCH_TOLERANCE = 0.5;     // degrees
+static const double CONSISTENT_ANGLE_TOLERANCE = 5.0;  // degrees
+static const double CONSISTENT_RATE_TOLERANCE = 0.15;  // fraction of the rate
+
+struct StoredCalibration
+{
+    wxString camera;
+    long stored;            // seconds since the epoch, for replacing the oldest entry
+    Calibration cal;
+};
+
+static wxString SlotPrefix(Mount *mount, int slot)
+{
+    return wxString::Format("/%s/calibration_store/%d", mount->GetMountClassName(), slot);
+}
+
+static wxString RotAngleStr(double rotAngle)
+{
+    if (rotAngle == Rotator::POSITION_UNKNOWN)
+        return "None";
+    return wxString::Format("%.1f", rotAngle);
+}
+
+static wxString CurrentCamera(void)
+{
+    return pCamera ? pCamera->Name : wxString();
+}
+
+// returns true if the slot is empty
+static bool LoadSlot(Mount *mount, int slot, StoredCalibration *entry)
+{
+    wxString prefix = SlotPrefix(mount, slot) + "/";
+    if (!pConfig->Profile.HasEntry(prefix + "camera"))
+        return true;
+
+    entry->camera = pConfig->Profile.GetString(prefix + "camera", wxEmptyString);
+    entry->stored = pConfig->Profile.GetLong(prefix + "stored", 0);
+
+    Calibration& cal = entry->cal;
+    cal.xRate = pConfig->Profile.GetDouble(prefix + "xRate", 1.0);
+    cal.yRate = pConfig->Profile.GetDouble(prefix + "yRate", 1.0);
+    cal.xAngle = pConfig->Profile.GetDouble(prefix + "xAngle", 0.0);
+    cal.yAngle = pConfig->Profile.GetDouble(prefix + "yAngle", M_PI / 2.0);
+    cal.declination = pConfig->Profile.GetDouble(prefix + "declination", UNKNOWN_DECLINATION);
+    cal.rotatorAngle = pConfig->Profile.GetDouble(prefix + "rotatorAngle", Rotator::POSITION_UNKNOWN);
+    cal.binning = (unsigned short) pConfig->Profile.GetInt(prefix + "binning", 1);
+    int t = pConfig->Profile.GetInt(prefix + "pierSide", PIER_SIDE_UNKNOWN);
+    cal.pierSide = t == PIER_SIDE_EAST ? PIER_SIDE_EAST :
+        t == PIER_SIDE_WEST ? PIER_SIDE_WEST : PIER_SIDE_UNKNOWN;
+    t = pConfig->Profile.GetInt(prefix + "raGuideParity", GUIDE_PARITY_UNKNOWN);
+    cal.raGuideParity = t == GUIDE_PARITY_EVEN ? GUIDE_PARITY_EVEN :
+        t == GUIDE_PARITY_ODD ? GUIDE_PARITY_ODD : GUIDE_PARITY_UNKNOWN;
+    t = pConfig->Profile.GetInt(prefix + "decGuideParity", GUIDE_PARITY_UNKNOWN);
+    cal.decGuideParity = t == GUIDE_PARITY_EVEN ? GUIDE_PARITY_EVEN :
+        t == GUIDE_PARITY_ODD ? GUIDE_PARITY_ODD : GUIDE_PARITY_UNKNOWN;
+    cal.timestamp = pConfig->Profile.GetString(prefix + "timestamp", wxEmptyString);
+    cal.isValid = true;
+
+    return false;
+}
+
+static void SaveSlot(Mount *mount, int slot, const StoredCalibration& entry)
+{
+    wxString prefix = SlotPrefix(mount, slot) + "/";
+    const Calibration& cal = entry.cal;
+
+    pConfig->Profile.SetString(prefix + "camera", entry.camera);
+    pConfig->Profile.SetLong(prefix + "stored", entry.stored);
+    pConfig->Profile.SetDouble(prefix + "xRate", cal.xRate);
+    pConfig->Profile.SetDouble(prefix + "yRate", cal.yRate);
+    pConfig->Profile.SetDouble(prefix + "xAngle", cal.xAngle);
+    pConfig->Profile.SetDouble(prefix + "yAngle", cal.yAngle);
+    pConfig->Profile.SetDouble(prefix + "declination", cal.declination);
+    pConfig->Profile.SetDouble(prefix + "rotatorAngle", cal.rotatorAngle);
+    pConfig->Profile.SetInt(prefix + "binning", cal.binning);
+    pConfig->Profile.SetInt(prefix + "pierSide", cal.pierSide);
+    pConfig->Profile.SetInt(prefix + "raGuideParity", cal.raGuideParity);
+    pConfig->Profile.SetInt(prefix + "decGuideParity", cal.decGuideParity);
+    pConfig->Profile.SetString(prefix + "timestamp", cal.timestamp);
+}
+
+static void ClearSlot(Mount *mount, int slot)
+{
+    pConfig->Profile.DeleteGroup(SlotPrefix(mount, slot));
+}
+
+static bool SameRotatorAngle(double a, double b)
+{
+    if (a == Rotator::POSITION_UNKNOWN || b == Rotator::POSITION_UNKNOWN)
+        return a == b;
+    return fabs(norm(a - b, -180.0, 180.0)) <= ROTATOR_MATCH_TOLERANCE;
+}
+
+static bool SameConditions(const Calibration& a, unsigned short binning, double rotatorAngle, PierSide pierSide)
+{
+    return a.binning == binning && a.pierSide == pierSide && SameRotatorAngle(a.rotatorAngle, rotatorAngle);
+}
+
+// A calibration measured on the same side of the pier predicts the new one
+// after scaling for binning and rotating for the rotator position. The RA
+// rate depends on declination, so only the Dec rate is compared.
+static bool IsConsistent(const Calibration& older, const Calibration& cal)
+{
+    if (older.pierSide != cal.pierSide)
+        return true;
+
+    double da = 0.0;
+    if (older.rotatorAngle != Rotator::POSITION_UNKNOWN && cal.rotatorAngle != Rotator::POSITION_UNKNOWN)
+        da = radians(cal.rotatorAngle - older.rotatorAngle);
+    else if (older.rotatorAngle != cal.rotatorAngle)
+        return false;
+
+    double angleTol = radians(CONSISTENT_ANGLE_TOLERANCE);
+    if (fabs(norm_angle(older.xAngle - da - cal.xAngle)) > angleTol ||
+        fabs(norm_angle(older.yAngle - da - cal.yAngle)) > angleTol)
+    {
+        return false;
+    }
+
+    if (older.yRate != CALIBRATION_RATE_UNCALIBRATED && cal.yRate != CALIBRATION_RATE_UNCALIBRATED && cal.yRate > 0.0)
+    {
+        double yRate = older.yRate * (double) older.binning / (double) cal.binning;
+        if (fabs(yRate - cal.yRate) > CONSISTENT_RATE_TOLERANCE * cal.yRate)
+            return false;
+    }
+
+    return true;
+}
+
+void CalibrationStore::Record(Mount *mount, const Calibration& cal)
+{
+    StoredCalibration entry;
+    entry.camera = CurrentCamera();
+    entry.stored = (long) wxDateTime::Now().GetTicks();
+    entry.cal = cal;
+    entry.cal.timestamp = wxDateTime::Now().Format();
+
+    int target = -1;
+    int oldest = 0;
+    long oldestStored = 0;
+
+    for (int slot = 0; slot < MAX_STORED_CALIBRATIONS; slot++)
+    {
+        StoredCalibration e;
+        if (LoadSlot(mount, slot, &e))
+        {
+            if (target < 0)
+                target = slot;
+            continue;
+        }
+
+        if (e.camera == entry.camera &&
+            (SameConditions(e.cal, cal.binning, cal.rotatorAngle, cal.pierSide) || !IsConsistent(e.cal, cal)))
+        {
+            Debug.Write(wxString::Format("CalibrationStore: dropping entry %d (bin=%hu pierSide=%d rotAngle=%s)\n",
+                slot, e.cal.binning, e.cal.pierSide, RotAngleStr(e.cal.rotatorAngle)));
+            ClearSlot(mount, slot);
+            if (target < 0)
+                target = slot;
+            continue;
+        }
+
+        if (oldestStored == 0 || e.stored < oldestStored)
+        {
+            oldest = slot;
+            oldestStored = e.stored;
+        }
+    }
+
+    if (target < 0)
+        target = oldest;
+
+    Debug.Write(wxString::Format("CalibrationStore: storing %s calibration in entry %d, camera=%s bin=%hu pierSide=%d rotAngle=%s\n",
+        mount->GetMountClassName(), target, entry.camera, cal.binning, cal.pierSide, RotAngleStr(cal.rotatorAngle)));
+
+    SaveSlot(mount, target, entry);
+}
+
+bool CalibrationStore::Find(Mount *mount, unsigned short binning, double rotatorAngle, PierSide pierSide, Calibration *cal)
+{
+    wxString camera = CurrentCamera();
+
+    for (int slot = 0; slot < MAX_STORED_CALIBRATIONS; slot++)
+    {
+        StoredCalibration e;
+        if (LoadSlot(mount, slot, &e))
+            continue;
+
+        if (e.camera == camera && SameConditions(e.cal, binning, rotatorAngle, pierSide))
+        {
+            *cal = e.cal;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CalibrationStore::FindLatest(Mount *mount, Calibration *cal)
+{
+    wxString camera = CurrentCamera();
+    bool found = false;
+    long latest = 0;
+
+    for (int slot = 0; slot < MAX_STORED_CALIBRATIONS; slot++)
+    {
+        StoredCalibration e;
+        if (LoadSlot(mount, slot, &e))
+            continue;
+
+        if (e.camera == camera && (!found || e.stored > latest))
+        {
+            *cal = e.cal;
+            latest = e.stored;
+            found = true;
+        }
+    }
+
+    return !found;
+}
+
+void CalibrationStore::Clear(Mount *mount)
+{
+    for (int slot = 0; slot < MAX_STORED_CALIBRATIONS; slot++)
+        ClearSlot(mount, slot);
+}
@@ -0,0 +1,67 @@
+/*
+ *  calibration_store.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef CALIBRATION_STORE_INCLUDED
+#define CALIBRATION_STORE_INCLUDED
+
+// Keeps the mount calibrations measured with the current profile, keyed by
+// the camera, binning, rotator position and side of pier they were measured
+// under. When the conditions change back to ones that were calibrated
+// before, the measured calibration is used instead of one transformed from
+// the most recent calibration, so switching binning, rotating the camera or
+// flipping the mount does not accumulate transform errors, and a pier flip
+// recovers the calibration measured on that side.
+//
+// A new calibration replaces the entry for the same conditions, and drops
+// the entries it disagrees with, since those were probably measured with a
+// different optical train.
+class CalibrationStore
+{
+public:
+    // remember a newly measured calibration
+    static void Record(Mount *mount, const Calibration& cal);
+
+    // find the calibration measured for the given conditions with the
+    // current camera; returns true if there is none
+    static bool Find(Mount *mount, unsigned short binning, double rotatorAngle, PierSide pierSide, Calibration *cal);
+
+    // find the most recent calibration measured with the current camera;
+    // returns true if there is none
+    static bool FindLatest(Mount *mount, Calibration *cal);
+
+    // forget all the calibrations for the mount
+    static void Clear(Mount *mount);
+};
+
+#endif
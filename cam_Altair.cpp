@@ -96,6 +96,7 @@ Camera_Altair::Camera_Altair()
     Connected = false;
     m_hasGuideOutput = true;
     HasSubframes = false;
+    HasAsyncCompletion = true;
     HasGainControl = true; // workaround: ok to set to false later, but brain dialog will frash if we start false then change to true later when the camera is connected
 }
 
@@ -121,6 +122,13 @@ inline static int gain_pct(int minval, int maxval, int val)
 
 bool Camera_Altair::EnumCameras(wxArrayString& names, wxArrayString& ids)
 {
+    wxString err;
+    if (!LoadDriverDll("altaircamsdk.dll", &err))
+    {
+        Debug.Write(wxString::Format("Altair: %s\n", err));
+        return true;
+    }
+
 	AltaircamInst ai[ALTAIRCAM_MAX];
 
     unsigned int numCameras = Altaircam_Enum(ai);
@@ -136,6 +144,13 @@ bool Camera_Altair::EnumCameras(wxArrayString& names, wxArrayString& ids)
 
 bool Camera_Altair::Connect(const wxString& camIdArg)
 {
+    wxString err;
+    if (!LoadDriverDll("altaircamsdk.dll", &err))
+    {
+        wxMessageBox(err, _("Error"), wxOK | wxICON_ERROR);
+        return true;
+    }
+
 	AltaircamInst ai[ALTAIRCAM_MAX];
     unsigned int numCameras = Altaircam_Enum(ai);
     if (numCameras == 0)
@@ -263,11 +278,6 @@ bool Camera_Altair::StopCapture(void)
     return true;
 }
 
-void Camera_Altair::FrameReady(void)
-{
-    m_frameReady = true;
-}
-
 bool Camera_Altair::GetDevicePixelSize(double *devPixelSize)
 {
     if (!Connected)
@@ -318,7 +328,7 @@ void __stdcall CameraCallback(unsigned nEvent, void* pCallbackCtx)
     if (nEvent == ALTAIRCAM_EVENT_IMAGE)
     {
         Camera_Altair* pCam = (Camera_Altair*)pCallbackCtx;
-        pCam->FrameReady();
+        pCam->ExposureReady();
     }
 }
 //static void flush_buffered_image(int cameraId, usImage& img)
@@ -371,12 +381,19 @@ bool Camera_Altair::Capture(int duration, usImage& img, int options, const wxRec
     // which could be quite stale. read out all buffered frames so the frame we
     // get is current
 
+    // a frame delivered while draining wakes the wait below, which then
+    // finds nothing to pull and waits for the next one
+    BeginExposureWait();
+
     //flush_buffered_image(m_handle, img);
     unsigned int width, height;
+    unsigned int stale = 0;
     while (SUCCEEDED(Altaircam_PullImage(m_handle, m_buffer, 8, &width, &height)))
     {
-        
+        ++stale;
     }
+    if (stale)
+        GuideMetrics.AddStaleFrames(stale);
 
 
     if (!m_capturing)
@@ -389,13 +406,10 @@ bool Camera_Altair::Capture(int duration, usImage& img, int options, const wxRec
             return true;
         }
         m_capturing = true;
-		m_frameReady = false;
 	}
 
     int frameSize = frame.GetWidth() * frame.GetHeight();
 
-    int poll = wxMin(duration, 100);
-
     CameraWatchdog watchdog(duration, duration + GetTimeoutMs() + 10000); // total timeout is 2 * duration + 15s (typically)
 
 	// do not wait here, as we will miss a frame most likely, leading to poor flow of frames.
@@ -408,15 +422,14 @@ bool Camera_Altair::Capture(int duration, usImage& img, int options, const wxRec
 
     while (true)
     {
-        if (m_frameReady)
+        // the camera calls back when a frame is ready
+        ExposureWaitResult result = WaitForExposure(1000);
+        if (result == EXPOSURE_READY &&
+            SUCCEEDED(Altaircam_PullImage(m_handle, m_buffer, 8, &width, &height)))
         {
-            m_frameReady = false;
-            
-            if (SUCCEEDED(Altaircam_PullImage(m_handle, m_buffer, 8, &width, &height)))
-                break;
+            break;
         }
-        WorkerThread::MilliSleep(poll, WorkerThread::INT_ANY);
-        if (WorkerThread::InterruptRequested())
+        if (result == EXPOSURE_INTERRUPTED)
         {
             StopCapture();
             return true;
@@ -46,7 +46,6 @@ class Camera_Altair : public GuideCamera
     int m_maxGain;
     double m_devicePixelSize;
 	HAltairCam m_handle;
-    volatile bool m_frameReady;
     bool ReduceResolution;
 public:
     Camera_Altair();
@@ -60,7 +59,6 @@ public:
     bool    ST4PulseGuideScope(int direction, int duration);
     void    ClearGuidePort();
 
-    void    FrameReady();
     void    ShowPropertyDialog();
 
     bool HasNonGuiCapture() { return true; }
@@ -49,7 +49,10 @@
 #include "image_math.h"
 #include "cam_INDI.h"
 
+#include <zlib.h>
+
 Camera_INDIClass::Camera_INDIClass()
+    : m_sensorRoi(1, 1, SensorRoi::RECONFIGURE_COSTLY) // each change of frame is a round trip to the server
 {
     ClearStatus();
     // load the values from the current profile
@@ -58,11 +61,13 @@ Camera_INDIClass::Camera_INDIClass()
     INDICameraName = pConfig->Profile.GetString("/indi/INDIcam", _T("INDI Camera"));
     INDICameraCCD = pConfig->Profile.GetLong("/indi/INDIcam_ccd", 0);
     INDICameraPort = pConfig->Profile.GetString("/indi/INDIcam_port",_T(""));
+    INDICameraCompress = pConfig->Profile.GetBoolean("/indi/INDIcam_compress", false);
     Name = INDICameraName;
     SetCCDdevice();
     PropertyDialogType = PROPDLG_ANY;
     FullSize = wxSize(640,480);
     HasSubframes = true;
+    HasAsyncCompletion = true; // exposures complete when the image BLOB arrives
     m_bitsPerPixel = 0;
 }
 
@@ -80,6 +85,7 @@ void Camera_INDIClass::ClearStatus()
     ccdinfo_prop = NULL;
     binning_prop = NULL;
     video_prop = NULL;
+    compression_prop = NULL;
     camera_port = NULL;
     camera_device = NULL;
     pulseGuideNS_prop = NULL;
@@ -173,8 +179,10 @@ void  Camera_INDIClass::newBLOB(IBLOB *bp)
     //printf("Got camera blob %s \n",bp->name);
     if (expose_prop) {
         if (bp->name == INDICameraBlobName) {
+            // the BLOB stays valid until the next one arrives, which is
+            // after the waiting capture has read it
             cam_bp = bp;
-            modal = false;
+            ExposureReady();
         }
     }
     else if (video_prop){
@@ -225,6 +233,10 @@ void Camera_INDIClass::newProperty(INDI::Property *property)
         binning_y = IUFindNumber(binning_prop,"VER_BIN");
         newNumber(binning_prop);
     }
+    else if (PropName == INDICameraCCDCmd + "COMPRESSION" && Proptype == INDI_SWITCH) {
+        compression_prop = property->getSwitch();
+        SetCompression();
+    }
     else if (PropName == "VIDEO_STREAM" && Proptype == INDI_SWITCH) {
         //printf("Found Video %s %s\n",DeviName, PropName);
         video_prop = property->getSwitch();
@@ -406,6 +418,25 @@ void Camera_INDIClass::CameraSetup()
     delete indiDlg;
 }
 
+void Camera_INDIClass::SetCompression()
+{
+    // Compressed BLOBs trade CPU time in the driver for transfer time, which
+    // is worth it over a network link to a remote INDI server
+    ISwitch *compress = IUFindSwitch(compression_prop, (INDICameraCCDCmd + "COMPRESS").mb_str(wxConvUTF8));
+    ISwitch *raw = IUFindSwitch(compression_prop, (INDICameraCCDCmd + "RAW").mb_str(wxConvUTF8));
+    if (!compress || !raw)
+        return;
+
+    ISState want = INDICameraCompress ? ISS_ON : ISS_OFF;
+    if (compress->s != want)
+    {
+        Debug.Write(wxString::Format("INDI Camera: set BLOB compression %s\n", INDICameraCompress ? "on" : "off"));
+        compress->s = want;
+        raw->s = INDICameraCompress ? ISS_OFF : ISS_ON;
+        sendNewSwitch(compression_prop);
+    }
+}
+
 void  Camera_INDIClass::SetCCDdevice()
 {
     if (INDICameraCCD == 0) {
@@ -418,8 +449,185 @@ void  Camera_INDIClass::SetCCDdevice()
     }
 }
 
-bool Camera_INDIClass::ReadFITS(usImage& img, bool takeSubframe, const wxRect& subframe)
+// The INDI client library normally uncompresses ".z" BLOBs as they arrive
+// and strips the suffix from the format. Older versions pass them through
+// compressed, so uncompress them here if need be.
+bool Camera_INDIClass::UncompressBLOB(const void **data, size_t *len, wxString *format)
+{
+    if (!format->EndsWith(".z"))
+        return false;
+
+    *format = format->Left(format->Length() - 2);
+
+    uLongf destLen = cam_bp->size;
+    m_blobBuf.resize(destLen);
+    int ret = uncompress(&m_blobBuf[0], &destLen, (const Bytef *) *data, (uLong) *len);
+    if (ret != Z_OK)
+    {
+        Debug.Write(wxString::Format("INDI Camera: uncompress BLOB failed, ret = %d\n", ret));
+        pFrame->Alert(_("Error uncompressing image data"));
+        return true;
+    }
+
+    *data = &m_blobBuf[0];
+    *len = destLen;
+    return false;
+}
+
+struct FITSImageInfo
+{
+    int bitpix;
+    int naxis;
+    int width;
+    int height;
+    double bzero;
+    double bscale;
+    size_t dataOffset;
+};
+
+enum { FITS_BLOCK = 2880, FITS_CARD = 80 };
+
+static bool fits_card_int(const char *card, const char *key, int *val)
+{
+    size_t const n = strlen(key);
+    if (strncmp(card, key, n) != 0 || (card[n] != ' ' && card[n] != '='))
+        return false;
+    *val = atoi(card + 10);
+    return true;
+}
+
+static bool fits_card_double(const char *card, const char *key, double *val)
+{
+    size_t const n = strlen(key);
+    if (strncmp(card, key, n) != 0 || (card[n] != ' ' && card[n] != '='))
+        return false;
+    *val = atof(card + 10);
+    return true;
+}
+
+// Parse the primary header of a FITS image held in memory. Returns true if the
+// header is not one the direct decoder handles: a single 2-D image of 8- or
+// 16-bit integers, unscaled, with a zero of 0 or 32768.
+static bool ParseFITSHeader(const unsigned char *data, size_t len, FITSImageInfo *info)
+{
+    info->bitpix = 0;
+    info->naxis = 0;
+    info->width = info->height = 0;
+    info->bzero = 0.0;
+    info->bscale = 1.0;
+
+    if (len < FITS_BLOCK || strncmp((const char *) data, "SIMPLE", 6) != 0)
+        return true;
+
+    bool extend = false;
+    size_t pos;
+    for (pos = 0; pos + FITS_CARD <= len; pos += FITS_CARD)
+    {
+        char card[FITS_CARD + 1];
+        memcpy(card, data + pos, FITS_CARD);
+        card[FITS_CARD] = 0;
+
+        int ival;
+        if (strncmp(card, "END ", 4) == 0)
+            break;
+        else if (fits_card_int(card, "BITPIX", &ival))
+            info->bitpix = ival;
+        else if (fits_card_int(card, "NAXIS1", &ival))
+            info->width = ival;
+        else if (fits_card_int(card, "NAXIS2", &ival))
+            info->height = ival;
+        else if (fits_card_int(card, "NAXIS", &ival))
+            info->naxis = ival;
+        else if (strncmp(card, "EXTEND ", 7) == 0)
+            extend = strchr(card + 10, 'T') != NULL;
+        else
+        {
+            fits_card_double(card, "BZERO", &info->bzero);
+            fits_card_double(card, "BSCALE", &info->bscale);
+        }
+    }
+    if (pos + FITS_CARD > len)
+        return true;
+
+    info->dataOffset = (pos / FITS_BLOCK + 1) * FITS_BLOCK;
+
+    if (extend || info->naxis != 2 || info->width <= 0 || info->height <= 0 || info->bscale != 1.0)
+        return true;
+    if (info->bitpix == 8)
+        return info->bzero != 0.0;
+    if (info->bitpix == 16)
+        return info->bzero != 0.0 && info->bzero != 32768.0;
+    return true;
+}
+
+// Decode rows of big-endian FITS pixels straight into the guide frame
+static void fits_decode_row(unsigned short *dst, const unsigned char *src, int n, const FITSImageInfo& info)
+{
+    if (info.bitpix == 8)
+    {
+        for (int i = 0; i < n; i++)
+            dst[i] = src[i];
+    }
+    else if (info.bzero == 32768.0)
+    {
+        for (int i = 0; i < n; i++, src += 2)
+            dst[i] = (unsigned short)(((src[0] << 8) | src[1]) ^ 0x8000);
+    }
+    else
+    {
+        // signed values, negative values are clipped as CFITSIO does for TUSHORT
+        for (int i = 0; i < n; i++, src += 2)
+        {
+            short v = (short)((src[0] << 8) | src[1]);
+            dst[i] = v < 0 ? 0 : (unsigned short) v;
+        }
+    }
+}
+
+static bool DecodeFITS(usImage& img, const void *data, size_t len, const wxSize& fullSize, bool takeSubframe, const wxRect& subframe)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    FITSImageInfo info;
+    if (ParseFITSHeader(p, len, &info))
+        return true;
+
+    size_t const rowBytes = (size_t) info.width * (info.bitpix / 8);
+    if (info.dataOffset + rowBytes * info.height > len)
+        return true;
+    p += info.dataOffset;
+
+    // the driver may have ignored the subframe request and sent the full frame
+    if (takeSubframe && (info.width != subframe.width || info.height != subframe.height))
+        takeSubframe = false;
+
+    if (takeSubframe)
+    {
+        if (img.Init(fullSize))
+            return true;
+        img.Clear();
+        img.Subframe = subframe;
+        for (int y = 0; y < subframe.height; y++, p += rowBytes)
+            fits_decode_row(img.ImageData + (y + subframe.y) * img.Size.GetWidth() + subframe.x, p, subframe.width, info);
+    }
+    else
+    {
+        if (img.Init(info.width, info.height))
+            return true;
+        for (int y = 0; y < info.height; y++, p += rowBytes)
+            fits_decode_row(img.ImageData + y * info.width, p, info.width, info);
+    }
+
+    return false;
+}
+
+bool Camera_INDIClass::ReadFITS(usImage& img, const void *data, size_t len, bool takeSubframe, const wxRect& subframe)
 {
+    // decode common integer images directly, anything else goes through CFITSIO
+
+    if (!DecodeFITS(img, data, len, FullSize, takeSubframe, subframe))
+        return false;
+
     int xsize, ysize;
     fitsfile *fptr;  // FITS file pointer
     int status = 0;  // CFITSIO status value MUST be initialized to zero!
@@ -427,13 +635,14 @@ bool Camera_INDIClass::ReadFITS(usImage& img, bool takeSubframe, const wxRect& s
     int nhdus=0;
     long fits_size[2];
     long fpixel[3] = {1,1,1};
-    size_t bsize = static_cast<size_t>(cam_bp->bloblen);
+    size_t bsize = len;
+    void *buf = const_cast<void *>(data);
 
     // load blob to CFITSIO
     if (fits_open_memfile(&fptr,
             "",
             READONLY,
-            &(cam_bp->blob),
+            &buf,
             &bsize,
             0,
             NULL,
@@ -459,6 +668,8 @@ bool Camera_INDIClass::ReadFITS(usImage& img, bool takeSubframe, const wxRect& s
         PHD_fits_close_file(fptr);
         return true;
     }
+    if (takeSubframe && (xsize != subframe.width || ysize != subframe.height))
+        takeSubframe = false;
     if (takeSubframe) {
         if (img.Init(FullSize)) {
             pFrame->Alert(_("Memory allocation error"));
@@ -467,20 +678,17 @@ bool Camera_INDIClass::ReadFITS(usImage& img, bool takeSubframe, const wxRect& s
         }
         img.Clear();
         img.Subframe = subframe;
-        unsigned short *rawdata = new unsigned short[xsize*ysize];
-        if (fits_read_pix(fptr, TUSHORT, fpixel, xsize*ysize, NULL, rawdata, NULL, &status) ) {
-            pFrame->Alert(_("Error reading data"));
-            PHD_fits_close_file(fptr);
-            return true;
-        }
-        int i = 0;
+        // read each row straight into place in the frame
         for (int y = 0; y < subframe.height; y++)
         {
             unsigned short *dataptr = img.ImageData + (y + subframe.y) * img.Size.GetWidth() + subframe.x;
-            memcpy(dataptr, &rawdata[i], subframe.width * sizeof(unsigned short));
-            i += subframe.width;
+            fpixel[1] = y + 1;
+            if (fits_read_pix(fptr, TUSHORT, fpixel, subframe.width, NULL, dataptr, NULL, &status) ) {
+                pFrame->Alert(_("Error reading data"));
+                PHD_fits_close_file(fptr);
+                return true;
+            }
         }
-        delete[] rawdata;
     }
     else {
         if (img.Init(xsize,ysize)) {
@@ -500,11 +708,9 @@ bool Camera_INDIClass::ReadFITS(usImage& img, bool takeSubframe, const wxRect& s
     return false;
 }
 
-bool Camera_INDIClass::ReadStream(usImage& img)
+bool Camera_INDIClass::ReadStream(usImage& img, const void *data, size_t len)
 {
     int xsize, ysize;
-    unsigned char *inptr;
-    unsigned short *outptr;
 
     if (! frame_prop) {
         pFrame->Alert(_("No CCD_FRAME property, failed to determine image dimensions"));
@@ -523,16 +729,26 @@ bool Camera_INDIClass::ReadStream(usImage& img)
     }
     ysize = frame_height->value;
 
+    size_t const npixels = (size_t) xsize * ysize;
+    if (len < npixels) {
+        pFrame->Alert(_("CCD stream: frame is smaller than the image dimensions"));
+        return true;
+    }
+
     // allocate image
     if (img.Init(xsize,ysize)) {
         pFrame->Alert(_("CCD stream: memory allocation error"));
         return true;
     }
-    // copy image
-    outptr = img.ImageData;
-    inptr = (unsigned char *) cam_bp->blob;
-    for (int i = 0; i < xsize * ysize; i++)
-        *outptr ++ = *inptr++;
+    // copy image, the stream is 8 bits per pixel unless it is large enough to be 16
+    if (len >= npixels * sizeof(unsigned short))
+        memcpy(img.ImageData, data, npixels * sizeof(unsigned short));
+    else {
+        const unsigned char *inptr = (const unsigned char *) data;
+        unsigned short *outptr = img.ImageData;
+        for (size_t i = 0; i < npixels; i++)
+            *outptr++ = *inptr++;
+    }
     return false;
 }
 
@@ -560,6 +776,12 @@ bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wx
               takeSubframe = false;
           }
 
+          // read a region around the subframe that is kept while the star drifts
+          if (takeSubframe && !m_sensorRoi.Negotiate(subframe, FullSize, &subframe))
+          {
+              takeSubframe = false;
+          }
+
           // Program the size
           if (!takeSubframe)
           {
@@ -577,19 +799,20 @@ bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wx
           }
           //printf("Exposing for %d(ms)\n", duration);
 
+          // newBLOB wakes this thread when the image arrives
+          BeginExposureWait();
+
           // set the exposure time, this immediately start the exposure
           expose_prop->np->value = (double)duration/1000;
           sendNewNumber(expose_prop);
 
-          modal = true;  // will be reset when the image blob is received
-
-          unsigned long loopwait = duration > 100 ? 10 : 1;
-
           CameraWatchdog watchdog(duration, GetTimeoutMs());
 
-          while (modal) {
-             wxMilliSleep(loopwait);
-             if (WorkerThread::TerminateRequested())
+          while (true) {
+             ExposureWaitResult result = WaitForExposure(1000);
+             if (result == EXPOSURE_READY)
+                break;
+             if (result == EXPOSURE_INTERRUPTED)
                 return true;
              if (watchdog.Expired())
              {
@@ -622,11 +845,19 @@ bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wx
       }
 
       //printf("Exposure end\n");
+      MarkCapture(CAPTURE_STAGE_READOUT);
+
+      const void *data = cam_bp->blob;
+      size_t len = static_cast<size_t>(cam_bp->bloblen);
+      wxString format(cam_bp->format);
+      if (UncompressBLOB(&data, &len, &format))
+         return true;
 
-      if (strcmp(cam_bp->format, ".fits") == 0) {
+      if (format == ".fits") {
          //printf("Processing fits file\n");
          // for CCD camera
-         if ( ! ReadFITS(img,takeSubframe,subframe) ) {
+         if ( ! ReadFITS(img,data,len,takeSubframe,subframe) ) {
+            MarkCapture(CAPTURE_STAGE_DATA);
             if (options & CAPTURE_SUBTRACT_DARK) {
                //printf("Subtracting dark\n");
                SubtractDark(img);
@@ -638,12 +869,12 @@ bool Camera_INDIClass::Capture(int duration, usImage& img, int options, const wx
          } else {
             return true;
          }
-      } else if (strcmp(cam_bp->format, ".stream") == 0) {
+      } else if (format == ".stream") {
          //printf("Processing stream file\n");
          // for video camera
-         return ReadStream(img);
+         return ReadStream(img,data,len);
       } else {
-         pFrame->Alert(_("Unknown image format: ") + wxString::FromAscii(cam_bp->format));
+         pFrame->Alert(_("Unknown image format: ") + format);
          return true;
       }
 
@@ -60,6 +60,7 @@ private:
     INumber               *binning_x;
     INumber               *binning_y;
     ISwitchVectorProperty *video_prop;
+    ISwitchVectorProperty *compression_prop;
     ITextVectorProperty   *camera_port;
     INDI::BaseDevice      *camera_device;
     INumberVectorProperty *pulseGuideNS_prop;
@@ -86,14 +87,19 @@ private:
     wxString INDICameraCCDCmd;
     wxString INDICameraBlobName;
     wxString INDICameraPort;
+    bool     INDICameraCompress;
     wxRect   m_roi;
+    SensorRoi m_sensorRoi;                  // chooses m_roi for a subframe
+    std::vector<unsigned char> m_blobBuf;   // uncompressed BLOB when the INDI client library left it compressed
     void     SetCCDdevice();
     void     ClearStatus(); 
     void     CheckState();
     void     CameraDialog();
     void     CameraSetup();
-    bool     ReadFITS(usImage& img, bool takeSubframe, const wxRect& subframe);
-    bool     ReadStream(usImage& img);
+    void     SetCompression();
+    bool     UncompressBLOB(const void **data, size_t *len, wxString *format);
+    bool     ReadFITS(usImage& img, const void *data, size_t len, bool takeSubframe, const wxRect& subframe);
+    bool     ReadStream(usImage& img, const void *data, size_t len);
     
 protected:
     virtual void newDevice(INDI::BaseDevice *dp);
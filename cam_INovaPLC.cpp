@@ -55,6 +55,12 @@ wxByte Camera_INovaPLCClass::BitsPerPixel()
 
 bool Camera_INovaPLCClass::Connect(const wxString& camId)
 {
+    wxString err;
+    if (!LoadDriverDll("DICAMSDK.dll", &err)) {
+        wxMessageBox(err, _("Error"));
+        return true;
+    }
+
     DS_CAMERA_STATUS rval;
     rval = DSCameraInit(R_FULL);
     if (rval != STATUS_OK) {
@@ -453,22 +453,20 @@ bool Camera_SBIGClass::Capture(int duration, usImage& img, int options, const wx
     }
 
     CameraWatchdog watchdog(duration, GetTimeoutMs());
+    ExposurePoller poller(duration);
 
-    if (duration > 100)
+    // wait until near end of exposure
+    if (poller.WaitUntilDue() &&
+        (WorkerThread::TerminateRequested() || StopExposure(&eep)))
     {
-        // wait until near end of exposure
-        if (WorkerThread::MilliSleep(duration - 100, WorkerThread::INT_ANY) &&
-            (WorkerThread::TerminateRequested() || StopExposure(&eep)))
-        {
-            return true;
-        }
+        return true;
     }
 
     qcsp.command = CC_START_EXPOSURE;
     while (true)
     {
         // wait for image to finish and d/l
-        wxMilliSleep(20);
+        poller.Wait();
         err = SBIGUnivDrvCommand(CC_QUERY_COMMAND_STATUS, &qcsp, &qcsr);
         if (err != CE_NO_ERROR)
         {
@@ -400,18 +400,17 @@ bool Camera_SSAGClass::Capture(int duration, usImage& img, int options, const wx
 
     //qglogfile->AddLine("Exposure programmed"); //qglogfile->Write();
 
-    if (duration > 100)
+    ExposurePoller poller(duration);
+
+    if (poller.WaitUntilDue() &&
+        (WorkerThread::TerminateRequested() || StopExposure()))
     {
-        if (WorkerThread::MilliSleep(duration - 100, WorkerThread::INT_ANY) &&
-            (WorkerThread::TerminateRequested() || StopExposure()))
-        {
-            return true;
-        }
+        return true;
     }
 
     while (_SSAG_isExposing())
     {
-        wxMilliSleep(50);
+        poller.Wait();
         if (WorkerThread::InterruptRequested() &&
             (WorkerThread::TerminateRequested() || StopExposure()))
         {
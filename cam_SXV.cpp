@@ -194,6 +194,13 @@ void Camera_SXVClass::ShowPropertyDialog()
 
 bool Camera_SXVClass::EnumCameras(wxArrayString& names, wxArrayString& ids)
 {
+    wxString err;
+    if (!LoadDriverDll("SXUSB.dll", &err))
+    {
+        Debug.Write(wxString::Format("SXV: %s\n", err));
+        return true;
+    }
+
     SXHandle hCams[SXCCD_MAX_CAMS];
 
     int ncams = sxOpen(hCams);
@@ -243,6 +250,13 @@ bool Camera_SXVClass::Connect(const wxString& camId)
 {
     // returns true on error
 
+    wxString err;
+    if (!LoadDriverDll("SXUSB.dll", &err))
+    {
+        wxMessageBox(err, _("Error"));
+        return true;
+    }
+
 #if defined (__APPLE__) || defined (__linux__)
     sxSetTimeoutMS(m_timeoutMs);
 #endif
@@ -74,7 +74,7 @@ public:
     bool Connect(const wxString& camId);
     bool Disconnect();
     void ShowPropertyDialog();
-    const wxSize& DarkFrameSize() { return m_darkFrameSize; }
+    wxSize DarkFrameSize() { return m_darkFrameSize; }
 
     bool HasNonGuiCapture() { return true; }
     bool ST4HasNonGuiMove() { return true; }
@@ -164,14 +164,13 @@ bool Camera_StarShootDSCIClass::Capture(int duration, usImage& img, int options,
         return true;
     }
 
-    if (duration > 100)
-    {
-        if (WorkerThread::MilliSleep(duration - 100, WorkerThread::INT_ANY))
-            return true;
-    }
+    ExposurePoller poller(duration);
+
+    if (poller.WaitUntilDue())
+        return true;
     do
     {
-        if (WorkerThread::MilliSleep(20, WorkerThread::INT_ANY))
+        if (poller.Wait())
             return true;
     } while (OCP_Exposing());
 
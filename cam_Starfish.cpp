@@ -86,6 +86,12 @@ bool Camera_StarfishClass::Connect(const wxString& camId)
 
     IOReturn rval;
 
+    wxString err;
+    if (!LoadDriverDll("FCApi.dll", &err)) {
+        wxMessageBox(err, _("Error"));
+        return true;
+    }
+
     wxBeginBusyCursor();
     if (!DriverLoaded) {
         fcUsb_init();               // Init the driver
@@ -189,21 +195,19 @@ bool Camera_StarfishClass::Capture(int duration, usImage& img, int options, cons
     if (rval != kIOReturnSuccess) { if (debug) pFrame->Alert(_T("Starfish Err 2")); return true; }
 
     CameraWatchdog watchdog(duration, GetTimeoutMs());
+    ExposurePoller poller(duration);
 
-    if (duration > 100)
+    // wait until near end of exposure
+    if (poller.WaitUntilDue() &&
+        (WorkerThread::TerminateRequested() || StopExposure(CamNum)))
     {
-        // wait until near end of exposure
-        if (WorkerThread::MilliSleep(duration - 100, WorkerThread::INT_ANY) &&
-            (WorkerThread::TerminateRequested() || StopExposure(CamNum)))
-        {
-            return true;
-        }
+        return true;
     }
 
     // wait for image to finish and d/l
     while (fcUsb_cmd_getState(CamNum) != 0)
     {
-        wxMilliSleep(50);
+        poller.Wait();
         if (WorkerThread::InterruptRequested() &&
             (WorkerThread::TerminateRequested() || StopExposure(CamNum)))
         {
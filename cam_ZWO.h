@@ -40,9 +40,12 @@ class Camera_ZWO : public GuideCamera
 {
     wxRect m_maxSize;
     wxRect m_frame;
+    SensorRoi m_roi;                // chooses m_frame for a subframe
     unsigned short m_prevBinning;
     unsigned char *m_buffer;
     bool m_capturing;
+    wxLongLong_t m_frameTime;       // when the last video frame was delivered
+    wxLongLong_t m_settingsTime;    // when the exposure, gain or ROI position last changed while capturing
     int m_cameraId;
     int m_minGain;
     int m_maxGain;
@@ -69,6 +72,9 @@ public:
 	virtual bool    SetCoolerSetpoint(double temperature);
 	virtual bool    GetCoolerStatus(bool *on, double *setpoint, double *power, double *temperature);
 
+protected:
+    void StreamStop(void);
+
 private:
     bool StopCapture(void);
 };
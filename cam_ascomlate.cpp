@@ -283,7 +283,7 @@ static bool ASCOM_Image(IDispatch *cam, usImage& Image, bool takeSubframe, const
     hr = SafeArrayAccessData(rawarray, (void**)&rawdata);
     if (hr != S_OK)
     {
-        hr = SafeArrayDestroyData(rawarray);
+        hr = SafeArrayDestroy(rawarray);
         return true;
     }
 
@@ -301,22 +301,21 @@ static bool ASCOM_Image(IDispatch *cam, usImage& Image, bool takeSubframe, const
         // Clear out the image
         Image.Clear();
 
-        int i = 0;
-        for (int y = 0; y < subframe.height; y++)
+        // ASCOM longs are 32 bits on Windows
+        const int *src = (const int *) rawdata;
+        for (int y = 0; y < subframe.height; y++, src += subframe.width)
         {
             unsigned short *dataptr = Image.ImageData + (y + subframe.y) * Image.Size.GetWidth() + subframe.x;
-            for (int x = 0; x < subframe.width; x++, i++)
-                *dataptr++ = (unsigned short) rawdata[i];
+            NarrowPixels(dataptr, src, subframe.width);
         }
     }
     else
     {
-        for (int i = 0; i < Image.NPixels; i++)
-            Image.ImageData[i] = (unsigned short) rawdata[i];
+        NarrowPixels(Image.ImageData, (const int *) rawdata, Image.NPixels);
     }
 
     hr = SafeArrayUnaccessData(rawarray);
-    hr = SafeArrayDestroyData(rawarray);
+    hr = SafeArrayDestroy(rawarray);
 
     return false;
 }
@@ -377,6 +376,15 @@ static wxString displayName(const wxString& ascomName)
 
 // map descriptive name to progid
 static std::map<wxString, wxString> s_progid;
+// the device lists are enumerated on a background thread
+static wxCriticalSection s_progidLock;
+
+static wxString ProgId(const wxString& choice)
+{
+    wxCriticalSectionLocker lck(s_progidLock);
+    std::map<wxString, wxString>::const_iterator it = s_progid.find(choice);
+    return it != s_progid.end() ? it->second : wxString();
+}
 
 wxArrayString Camera_ASCOMLateClass::EnumAscomCameras()
 {
@@ -414,7 +422,10 @@ wxArrayString Camera_ASCOMLateClass::EnumAscomCameras()
                     wxString ascomName = vval.bstrVal;
                     wxString displName = displayName(ascomName);
                     wxString progid = vkey.bstrVal;
-                    s_progid[displName] = progid;
+                    {
+                        wxCriticalSectionLocker lck(s_progidLock);
+                        s_progid[displName] = progid;
+                    }
                     list.Add(displName);
                 }
             }
@@ -437,7 +448,14 @@ bool Camera_ASCOMLateClass::Create(DispatchObj *obj, DispatchClass *cls)
         return true;
     }
 
-    wxBasicString progid(s_progid[m_choice]);
+    wxString id = ProgId(m_choice);
+    if (id.IsEmpty())
+    {
+        // the choice was made before the device list was enumerated
+        EnumAscomCameras();
+        id = ProgId(m_choice);
+    }
+    wxBasicString progid(id);
 
     if (!obj->Create(progid))
     {
@@ -921,20 +939,18 @@ bool Camera_ASCOMLateClass::Capture(int duration, usImage& img, int options, con
     }
 
     CameraWatchdog watchdog(duration, GetTimeoutMs());
+    ExposurePoller poller(duration);
 
-    if (duration > 100)
+    // wait until near end of exposure
+    if (poller.WaitUntilDue() &&
+        (WorkerThread::TerminateRequested() || AbortExposure()))
     {
-        // wait until near end of exposure
-        if (WorkerThread::MilliSleep(duration - 100, WorkerThread::INT_ANY) &&
-            (WorkerThread::TerminateRequested() || AbortExposure()))
-        {
-            return true;
-        }
+        return true;
     }
 
     while (true)  // wait for image to finish and d/l
     {
-        wxMilliSleep(20);
+        poller.Wait();
         bool ready;
         EXCEPINFO excep;
         if (ASCOM_ImageReady(cam.IDisp(), &ready, &excep))
@@ -72,6 +72,7 @@ public:
     bool    HasNonGuiCapture(void);
     bool    Connect(const wxString& camId);
     bool    Disconnect(void);
+    bool    CanConnectInBackground(void) const { return true; }
     void    ShowPropertyDialog(void);
     bool    ST4PulseGuideScope(int direction, int duration);
     wxByte  BitsPerPixel();
@@ -87,6 +88,7 @@ private:
     bool Create(DispatchObj *obj, DispatchClass *cls);
 
     bool AbortExposure(void);
+    bool AbortOverdueExposure(void) { return AbortExposure(); }
 
     bool ST4HasNonGuiMove(void);
 
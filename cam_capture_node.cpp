@@ -0,0 +1,388 @@
+/*
+ *  cam_capture_node.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined (CAPTURE_NODE_CAMERA)
+
+#include "cam_capture_node.h"
+
+#define CAPTURE_NODE_HOST_DEFAULT "localhost"
+#define CAPTURE_NODE_COMPRESS_DEFAULT true
+
+// requests are matched to their replies by sequence number; a reply to a
+// request that was given up on, because of a timeout or a stop, is dropped
+class CaptureNodeLink : public NodeChannel
+{
+    struct Pending
+    {
+        wxSemaphore done;
+        NodeMessage *reply;
+        Pending() : reply(NULL) { }
+    };
+
+    wxCriticalSection m_lock;
+    std::map<unsigned int, Pending *> m_pending;
+    unsigned int m_nextSeq;
+
+protected:
+    void OnMessage(NodeMessage *msg);
+    void OnClosed();
+
+public:
+    enum Result
+    {
+        REQUEST_OK,
+        REQUEST_FAILED,         // the node replied with an error
+        REQUEST_LOST,           // connection lost
+        REQUEST_TIMEOUT,
+        REQUEST_INTERRUPTED,
+    };
+
+    CaptureNodeLink(wxSocketBase *sock) : NodeChannel(sock, "capture node client"), m_nextSeq(0) { }
+
+    // takes ownership of req; on REQUEST_OK or REQUEST_FAILED the caller
+    // deletes *reply
+    Result Request(NodeMessage *req, NodeMessage **reply, int timeoutMs);
+};
+
+void CaptureNodeLink::OnMessage(NodeMessage *msg)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    std::map<unsigned int, Pending *>::iterator it = m_pending.find(msg->seq);
+    if (it == m_pending.end())
+    {
+        delete msg;
+        return;
+    }
+    it->second->reply = msg;
+    it->second->done.Post();
+    m_pending.erase(it);
+}
+
+void CaptureNodeLink::OnClosed()
+{
+    wxCriticalSectionLocker lck(m_lock);
+    for (std::map<unsigned int, Pending *>::iterator it = m_pending.begin(); it != m_pending.end(); ++it)
+        it->second->done.Post();
+    m_pending.clear();
+}
+
+CaptureNodeLink::Result CaptureNodeLink::Request(NodeMessage *req, NodeMessage **reply, int timeoutMs)
+{
+    Pending pending;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        if (!IsOpen())
+        {
+            delete req;
+            return REQUEST_LOST;
+        }
+        req->seq = ++m_nextSeq;
+        m_pending[req->seq] = &pending;
+    }
+    unsigned int const seq = req->seq;
+    Send(req);
+
+    wxStopWatch swatch;
+    while (pending.done.WaitTimeout(100) != wxSEMA_NO_ERROR)
+    {
+        bool const interrupted = WorkerThread::InterruptRequested() != 0;
+        if (!interrupted && swatch.Time() < timeoutMs)
+            continue;
+
+        wxCriticalSectionLocker lck(m_lock);
+        if (m_pending.erase(seq))
+            return interrupted ? REQUEST_INTERRUPTED : REQUEST_TIMEOUT;
+        // the reply came in meanwhile and the semaphore is posted
+    }
+
+    if (!pending.reply)
+        return REQUEST_LOST;
+
+    *reply = pending.reply;
+    return pending.reply->type == NODE_ERROR ? REQUEST_FAILED : REQUEST_OK;
+}
+
+Camera_CaptureNodeClass::Camera_CaptureNodeClass()
+    : m_link(NULL),
+      m_bpp(16),
+      m_devicePixelSize(0.0),
+      m_compression(FRAME_CODEC_PACKED)
+{
+    Connected = false;
+    Name = _T("PHD2 Capture Node");
+    m_hasGuideOutput = true;
+    HasSubframes = true;
+    HasPipelinedCapture = true;
+    PropertyDialogType = PROPDLG_ANY;
+    MaxBinning = 1;
+}
+
+Camera_CaptureNodeClass::~Camera_CaptureNodeClass()
+{
+    CloseLink();
+}
+
+void Camera_CaptureNodeClass::CloseLink()
+{
+    if (!m_link)
+        return;
+    m_link->Stop();
+    m_link->Wait();
+    delete m_link;
+    m_link = NULL;
+}
+
+static wxString node_error(const NodeMessage *reply)
+{
+    NodeReader rd(*reply);
+    return rd.String();
+}
+
+bool Camera_CaptureNodeClass::Connect(const wxString& camId)
+{
+    wxString const host = pConfig->Profile.GetString("/camera/CaptureNode/Host", CAPTURE_NODE_HOST_DEFAULT);
+    int const port = pConfig->Profile.GetInt("/camera/CaptureNode/Port", NODE_PORT_BASE);
+    m_compression = pConfig->Profile.GetBoolean("/camera/CaptureNode/Compress", CAPTURE_NODE_COMPRESS_DEFAULT) ?
+        FRAME_CODEC_PACKED : FRAME_CODEC_RAW;
+
+    if (!wxSocketBase::IsInitialized())
+        wxSocketBase::Initialize();
+
+    wxIPV4address addr;
+    addr.Hostname(host);
+    addr.Service(port);
+
+    wxSocketClient *sock = new wxSocketClient(wxSOCKET_BLOCK | wxSOCKET_WAITALL);
+    sock->SetTimeout(10);
+    if (!sock->Connect(addr, true))
+    {
+        sock->Destroy();
+        wxMessageBox(wxString::Format(_("Cannot connect to the capture node at %s:%d"), host, port), _("Error"), wxOK | wxICON_ERROR);
+        return true;
+    }
+
+    m_link = new CaptureNodeLink(sock);
+    if (m_link->Create() != wxTHREAD_NO_ERROR || m_link->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete m_link;
+        m_link = NULL;
+        return true;
+    }
+
+    NodeMessage *reply = NULL;
+    CaptureNodeLink::Result res = m_link->Request(new NodeMessage(NODE_HELLO), &reply, 10000);
+    if (res != CaptureNodeLink::REQUEST_OK)
+    {
+        wxString msg = res == CaptureNodeLink::REQUEST_FAILED ? node_error(reply) : _("no reply");
+        delete reply;
+        CloseLink();
+        wxMessageBox(wxString::Format(_("The capture node at %s:%d did not accept the connection: %s"), host, port, msg),
+            _("Error"), wxOK | wxICON_ERROR);
+        return true;
+    }
+
+    NodeReader rd(*reply);
+    unsigned int const version = rd.U16();
+    int const width = rd.U16();
+    int const height = rd.U16();
+    int const maxBin = rd.U8();
+    int const bin = rd.U8();
+    unsigned int const flags = rd.U32();
+    m_bpp = (wxByte) rd.U8();
+    int const gain = rd.I32();
+    m_devicePixelSize = rd.Double();
+    wxString const nodeCamera = rd.String();
+    bool const failed = rd.Failed();
+    delete reply;
+
+    if (failed || version != NODE_PROTOCOL_VERSION)
+    {
+        CloseLink();
+        wxMessageBox(wxString::Format(_("The capture node at %s:%d runs an incompatible version of PHD2"), host, port),
+            _("Error"), wxOK | wxICON_ERROR);
+        return true;
+    }
+
+    FullSize = wxSize(width, height);
+    MaxBinning = (wxByte) wxMax(1, maxBin);
+    if (Binning > MaxBinning)
+        Binning = MaxBinning;
+    HasSubframes = (flags & NODE_CAP_SUBFRAMES) != 0;
+    m_hasGuideOutput = (flags & NODE_CAP_GUIDE_OUTPUT) != 0;
+    HasGainControl = (flags & NODE_CAP_GAIN) != 0;
+    HasShutter = (flags & NODE_CAP_SHUTTER) != 0;
+
+    Debug.Write(wxString::Format("CaptureNode: connected to %s:%d, camera %s %dx%d bin %d/%d gain %d flags %x\n",
+        host, port, nodeCamera, width, height, bin, maxBin, gain, flags));
+
+    Connected = true;
+    return false;
+}
+
+bool Camera_CaptureNodeClass::Disconnect()
+{
+    CloseLink();
+    Connected = false;
+    return false;
+}
+
+bool Camera_CaptureNodeClass::Capture(int duration, usImage& img, int options, const wxRect& subframe)
+{
+    NodeMessage *req = new NodeMessage(NODE_CAPTURE);
+    NodeWriter w(req);
+    w.I32(duration);
+    w.I32(options & ~(CAPTURE_SUBTRACT_DARK | CAPTURE_LAZY_ROI));
+    w.U16(Binning);
+    w.U16(m_compression);
+    w.U8(ShutterClosed ? 1 : 0);
+    w.I32(HasGainControl ? GuideCameraGain : -1);
+    w.I32(subframe.x);
+    w.I32(subframe.y);
+    w.I32(subframe.width);
+    w.I32(subframe.height);
+
+    NodeMessage *reply = NULL;
+    switch (m_link->Request(req, &reply, duration + GetTimeoutMs()))
+    {
+    case CaptureNodeLink::REQUEST_OK:
+        break;
+    case CaptureNodeLink::REQUEST_FAILED:
+        Debug.Write(wxString::Format("CaptureNode: %s\n", node_error(reply)));
+        delete reply;
+        return true;
+    case CaptureNodeLink::REQUEST_LOST:
+        DisconnectWithAlert(_("Lost the connection to the capture node"), NO_RECONNECT);
+        return true;
+    case CaptureNodeLink::REQUEST_TIMEOUT:
+        DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
+        return true;
+    case CaptureNodeLink::REQUEST_INTERRUPTED:
+        return true;
+    }
+
+    MarkCapture(CAPTURE_STAGE_READOUT);
+
+    // the start time is the one taken here, the clocks of the two computers
+    // need not agree
+    time_t const startTime = img.ImgStartTime;
+    bool const bad = reply->payload.empty() || FrameCodec::Decode(&reply->payload[0], reply->payload.size(), &img);
+    delete reply;
+    if (bad)
+    {
+        DisconnectWithAlert(_("Received an invalid frame from the capture node"), NO_RECONNECT);
+        return true;
+    }
+    img.ImgStartTime = startTime;
+
+    // the node's frame size changes with its binning
+    FullSize = img.Size;
+    m_bpp = img.BitsPerPixel;
+
+    if (options & CAPTURE_SUBTRACT_DARK)
+        SubtractDark(img);
+
+    return false;
+}
+
+bool Camera_CaptureNodeClass::ST4PulseGuideScope(int direction, int duration)
+{
+    NodeMessage *req = new NodeMessage(NODE_PULSE);
+    NodeWriter w(req);
+    w.U8(direction);
+    w.I32(duration);
+
+    NodeMessage *reply = NULL;
+    switch (m_link->Request(req, &reply, duration + 5000))
+    {
+    case CaptureNodeLink::REQUEST_OK:
+        delete reply;
+        return false;
+    case CaptureNodeLink::REQUEST_FAILED:
+        Debug.Write(wxString::Format("CaptureNode: %s\n", node_error(reply)));
+        delete reply;
+        return true;
+    default:
+        Debug.Write("CaptureNode: guide pulse not completed\n");
+        return true;
+    }
+}
+
+bool Camera_CaptureNodeClass::GetDevicePixelSize(double *devPixelSize)
+{
+    if (!Connected || m_devicePixelSize <= 0.0)
+        return true;
+    *devPixelSize = m_devicePixelSize;
+    return false;
+}
+
+void Camera_CaptureNodeClass::ShowPropertyDialog()
+{
+    wxDialog dlg(pFrame, wxID_ANY, _("PHD2 Capture Node"));
+
+    wxTextCtrl *host = new wxTextCtrl(&dlg, wxID_ANY, pConfig->Profile.GetString("/camera/CaptureNode/Host", CAPTURE_NODE_HOST_DEFAULT),
+        wxDefaultPosition, wxSize(StringWidth(&dlg, _T("M")) * 20, -1));
+    host->SetToolTip(_("Name or address of the computer running phd2 --capturenode"));
+    wxSpinCtrl *port = new wxSpinCtrl(&dlg, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, 65535,
+        pConfig->Profile.GetInt("/camera/CaptureNode/Port", NODE_PORT_BASE));
+    port->SetToolTip(wxString::Format(_("The node listens on port %d + its instance number - 1"), (int) NODE_PORT_BASE));
+    wxCheckBox *compress = new wxCheckBox(&dlg, wxID_ANY, _("Compress frames"));
+    compress->SetValue(pConfig->Profile.GetBoolean("/camera/CaptureNode/Compress", CAPTURE_NODE_COMPRESS_DEFAULT));
+    compress->SetToolTip(_("Send the frames with lossless compression, usually about half the raw size or less"));
+
+    wxFlexGridSizer *table = new wxFlexGridSizer(2, 5, 5);
+    table->AddGrowableCol(1);
+    table->Add(new wxStaticText(&dlg, wxID_ANY, _("Host: ")), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxALL, 5));
+    table->Add(host, wxSizerFlags().Expand().Border(wxALL, 5));
+    table->Add(new wxStaticText(&dlg, wxID_ANY, _("Port: ")), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxALL, 5));
+    table->Add(port, wxSizerFlags().Border(wxALL, 5));
+    table->AddSpacer(0);
+    table->Add(compress, wxSizerFlags().Border(wxALL, 5));
+
+    wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(table, wxSizerFlags().Expand().Border(wxALL, 10));
+    sizer->Add(dlg.CreateButtonSizer(wxOK | wxCANCEL), wxSizerFlags().Expand().Border(wxALL, 10));
+    dlg.SetSizerAndFit(sizer);
+
+    if (dlg.ShowModal() != wxID_OK)
+        return;
+
+    // host and port take effect at the next connection
+    pConfig->Profile.SetString("/camera/CaptureNode/Host", host->GetValue().Trim(true).Trim(false));
+    pConfig->Profile.SetInt("/camera/CaptureNode/Port", port->GetValue());
+    pConfig->Profile.SetBoolean("/camera/CaptureNode/Compress", compress->GetValue());
+    m_compression = compress->GetValue() ? FRAME_CODEC_PACKED : FRAME_CODEC_RAW;
+}
+
+#endif // CAPTURE_NODE_CAMERA
@@ -0,0 +1,70 @@
+/*
+ *  cam_capture_node.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAM_CAPTURE_NODE_INCLUDED
+#define CAM_CAPTURE_NODE_INCLUDED
+
+#if defined (CAPTURE_NODE_CAMERA)
+
+class CaptureNodeLink;
+
+// A camera served by "phd2 --capturenode" on another computer, see
+// capture_node.h. Frames arrive raw and dark subtraction is done here with
+// the local dark library; guide pulses go out through the node camera's
+// ST4 port.
+class Camera_CaptureNodeClass : public GuideCamera
+{
+    CaptureNodeLink *m_link;
+    wxByte m_bpp;
+    double m_devicePixelSize;
+    FrameCodecMethod m_compression;
+
+    void CloseLink();
+
+public:
+    Camera_CaptureNodeClass();
+    ~Camera_CaptureNodeClass();
+    bool     Capture(int duration, usImage& img, int options, const wxRect& subframe);
+    bool     Connect(const wxString& camId);
+    bool     Disconnect();
+    void     ShowPropertyDialog();
+    bool     HasNonGuiCapture() { return true; }
+    bool     ST4HasNonGuiMove() { return true; }
+    wxByte   BitsPerPixel() { return m_bpp; }
+    bool     ST4PulseGuideScope(int direction, int duration);
+    bool     GetDevicePixelSize(double *devPixelSize);
+};
+
+#endif // CAPTURE_NODE_CAMERA
+
+#endif
@@ -115,6 +115,34 @@ bool Camera_OpenCVClass::Disconnect()
     return false;
 }
 
+// Adds a captured 8-bit video frame into the 16-bit guide frame. Colour
+// frames, which OpenCV delivers as BGR, are reduced to luminance as they are
+// added, with the same fixed-point weights cvtColor uses, so no intermediate
+// grey image is made.
+static void accumulate_frame(usImage& img, const Mat& frame)
+{
+    int const channels = frame.channels();
+
+    for (int y = 0; y < frame.rows; y++)
+    {
+        const unsigned char *src = frame.ptr<unsigned char>(y);
+        unsigned short *dst = img.ImageData + y * img.Size.GetWidth();
+
+        if (channels == 1)
+        {
+            AccumulatePixels(dst, src, frame.cols);
+            continue;
+        }
+
+        for (int x = 0; x < frame.cols; x++, src += channels)
+        {
+            unsigned int lum = (29 * src[0] + 150 * src[1] + 77 * src[2] + 128) >> 8;
+            unsigned int t = (unsigned int) dst[x] + lum;
+            dst[x] = (unsigned short)(t > 65535 ? 65535 : t);
+        }
+    }
+}
+
 bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const wxRect& subframe)
 {
     bool bError = false;
@@ -122,8 +150,6 @@ bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const
     try
     {
         wxStopWatch swatch;
-        Mat captured_frame;
-        int i, nframes;
 
         if (!pCapDev)
         {
@@ -135,36 +161,30 @@ bool Camera_OpenCVClass::Capture(int duration, usImage& img, int options, const
             throw ERROR_INFO("!pCapDev->isOpened()");
         }
 
-        // Grab at least one frame...
-        pCapDev->read(captured_frame);
-        cvtColor(captured_frame,captured_frame,CV_RGB2GRAY);
-
-        cv::Size sz = captured_frame.size();
+        // Grab at least one frame... m_frame keeps its buffer from one
+        // frame to the next, and each frame is added straight into img
+        if (!pCapDev->read(m_frame) || m_frame.empty() || m_frame.depth() != CV_8U)
+        {
+            throw ERROR_INFO("pCapDev->read failed");
+        }
 
-        if (img.Init(sz.width,sz.height))
+        if (img.Init(m_frame.cols, m_frame.rows))
         {
             pFrame->Alert(_("Memory allocation error"));
             throw ERROR_INFO("img.Init failed");
         }
 
         img.Clear();
+        accumulate_frame(img, m_frame);
 
-        nframes = 0;
-        unsigned char *dptr;
-        dptr = captured_frame.data;
         while (swatch.Time() < duration)
         {
-            nframes++;
-            pCapDev->read(captured_frame);
-            cvtColor(captured_frame,captured_frame,CV_RGB2GRAY);
-            dptr = captured_frame.data;
-            for (i = 0; i < img.NPixels; i++)
+            if (!pCapDev->read(m_frame) || m_frame.cols != img.Size.GetWidth() || m_frame.rows != img.Size.GetHeight() ||
+                m_frame.depth() != CV_8U)
             {
-                unsigned int t = (unsigned int) img.ImageData[i] + (unsigned int) dptr[i];
-                if (t > 65535)
-                    t = 65535;
-                img.ImageData[i] = (unsigned short) t;
+                throw ERROR_INFO("pCapDev->read failed");
             }
+            accumulate_frame(img, m_frame);
         }
     }
     catch (wxString Msg)
@@ -45,6 +45,7 @@ class Camera_OpenCVClass : public GuideCamera
 
 protected:
     cv::VideoCapture *pCapDev;
+    cv::Mat           m_frame;      // last captured frame, reused to avoid an allocation per frame
 
 public:
     Camera_OpenCVClass(int devNumber);
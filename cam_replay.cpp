@@ -0,0 +1,437 @@
+/*
+ *  cam_replay.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2017 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+
+#include "phd.h"
+
+#if defined (REPLAY_CAMERA)
+
+#include "cam_replay.h"
+
+#include <wx/dir.h>
+#include <wx/filepicker.h>
+
+#define REPLAY_MODE_DEFAULT Camera_ReplayClass::REPLAY_REAL_TIME
+#define REPLAY_SPEEDUP_DEFAULT 10.0
+#define REPLAY_SPEEDUP_MAX 1000.0
+#define REPLAY_LOOP_DEFAULT true
+#define REPLAY_PRELOAD_DEFAULT true
+#define REPLAY_PRELOAD_MB_DEFAULT 1024
+#define REPLAY_GUIDE_FEEDBACK_DEFAULT true
+#define REPLAY_GUIDE_RATE_DEFAULT 5.0
+
+void Camera_ReplayClass::Params::Load()
+{
+    dir = pConfig->Profile.GetString("/camera/Replay/Directory", wxFileName(Debug.GetLogDir(), "sim_images").GetFullPath());
+    int m = pConfig->Profile.GetInt("/camera/Replay/Mode", REPLAY_MODE_DEFAULT);
+    mode = m >= REPLAY_REAL_TIME && m <= REPLAY_AS_FAST_AS_POSSIBLE ? (ReplayMode) m : REPLAY_MODE_DEFAULT;
+    speedup = wxMax(1.0, pConfig->Profile.GetDouble("/camera/Replay/Speedup", REPLAY_SPEEDUP_DEFAULT));
+    loop = pConfig->Profile.GetBoolean("/camera/Replay/Loop", REPLAY_LOOP_DEFAULT);
+    preload = pConfig->Profile.GetBoolean("/camera/Replay/Preload", REPLAY_PRELOAD_DEFAULT);
+    preloadMB = wxMax(0, pConfig->Profile.GetInt("/camera/Replay/PreloadMB", REPLAY_PRELOAD_MB_DEFAULT));
+    guideFeedback = pConfig->Profile.GetBoolean("/camera/Replay/GuideFeedback", REPLAY_GUIDE_FEEDBACK_DEFAULT);
+    guideRate = wxMax(0.0, pConfig->Profile.GetDouble("/camera/Replay/GuideRate", REPLAY_GUIDE_RATE_DEFAULT));
+}
+
+void Camera_ReplayClass::Params::Save() const
+{
+    pConfig->Profile.SetString("/camera/Replay/Directory", dir);
+    pConfig->Profile.SetInt("/camera/Replay/Mode", mode);
+    pConfig->Profile.SetDouble("/camera/Replay/Speedup", speedup);
+    pConfig->Profile.SetBoolean("/camera/Replay/Loop", loop);
+    pConfig->Profile.SetBoolean("/camera/Replay/Preload", preload);
+    pConfig->Profile.SetInt("/camera/Replay/PreloadMB", preloadMB);
+    pConfig->Profile.SetBoolean("/camera/Replay/GuideFeedback", guideFeedback);
+    pConfig->Profile.SetDouble("/camera/Replay/GuideRate", guideRate);
+}
+
+Camera_ReplayClass::Camera_ReplayClass()
+    : m_next(0),
+      m_guideOfs(0.0, 0.0)
+{
+    Connected = false;
+    Name = _T("FITS Replay");
+    m_hasGuideOutput = true;
+    HasSubframes = false;
+    HasPipelinedCapture = true;
+    PropertyDialogType = PROPDLG_ANY;
+    MaxBinning = 1;
+}
+
+Camera_ReplayClass::~Camera_ReplayClass()
+{
+    FreeFrames();
+}
+
+void Camera_ReplayClass::FreeFrames()
+{
+    for (std::vector<usImage *>::iterator it = m_frames.begin(); it != m_frames.end(); ++it)
+        delete *it;
+    m_frames.clear();
+}
+
+wxByte Camera_ReplayClass::BitsPerPixel()
+{
+    return 16;
+}
+
+// the time a frame or a guide pulse of the given duration takes to replay
+int Camera_ReplayClass::ReplayInterval(int duration) const
+{
+    switch (m_params.mode)
+    {
+    case REPLAY_REAL_TIME:
+        return duration;
+    case REPLAY_ACCELERATED:
+        return (int) (duration / m_params.speedup + 0.5);
+    default:
+        return 0;
+    }
+}
+
+static bool list_frames(const wxString& dir, wxArrayString *files)
+{
+    files->Clear();
+
+    if (!wxDirExists(dir))
+        return true;
+
+    static const char *const patterns[] = { "*.fit", "*.fits", "*.fts" };
+    for (unsigned int i = 0; i < WXSIZEOF(patterns); i++)
+        wxDir::GetAllFiles(dir, files, patterns[i], wxDIR_FILES);
+
+    // the image loggers name frames by time of capture, so name order is replay order
+    files->Sort();
+
+    return files->IsEmpty();
+}
+
+bool Camera_ReplayClass::Connect(const wxString& camId)
+{
+    m_params.Load();
+    FreeFrames();
+    m_next = 0;
+    m_guideOfs = wxRealPoint(0.0, 0.0);
+
+    if (list_frames(m_params.dir, &m_files))
+    {
+        wxMessageBox(wxString::Format(_("No FITS frames found in %s"), m_params.dir), _("Error"), wxOK | wxICON_ERROR);
+        return true;
+    }
+
+    // all frames must be the size of the first one
+    usImage first;
+    if (first.Load(m_files[0]))
+        return true;
+    FullSize = first.Size;
+
+    Debug.Write(wxString::Format("Replay: %u frames of %dx%d from %s\n", (unsigned int) m_files.size(),
+        FullSize.GetWidth(), FullSize.GetHeight(), m_params.dir));
+
+    m_frames.resize(m_files.size(), NULL);
+
+    if (m_params.preload)
+    {
+        // read the frames up front, as many as fit in the memory budget, so that
+        // file reads and FITS decoding do not show up in the capture timing
+        struct ConnectInBg : public ConnectCameraInBg
+        {
+            Camera_ReplayClass *cam;
+            ConnectInBg(Camera_ReplayClass *cam_) : cam(cam_) { }
+            bool Entry()
+            {
+                wxUint64 const frameBytes = (wxUint64) cam->FullSize.GetWidth() * cam->FullSize.GetHeight() * sizeof(unsigned short);
+                wxUint64 const budget = (wxUint64) cam->m_params.preloadMB * 1024 * 1024;
+                size_t const n = (size_t) wxMin((wxUint64) cam->m_files.size(), frameBytes ? budget / frameBytes : 0);
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (IsCanceled())
+                        return true;
+                    usImage *img = new usImage();
+                    if (img->Load(cam->m_files[i]) || img->Size != cam->FullSize)
+                    {
+                        Debug.Write(wxString::Format("Replay: cannot preload %s\n", cam->m_files[i]));
+                        delete img;
+                        continue;
+                    }
+                    cam->m_frames[i] = img;
+                }
+                return false;
+            }
+        };
+
+        if (ConnectInBg(this).Run())
+        {
+            FreeFrames();
+            return true;
+        }
+    }
+
+    Connected = true;
+    return false;
+}
+
+bool Camera_ReplayClass::Disconnect()
+{
+    FreeFrames();
+    m_files.Clear();
+    Connected = false;
+    return false;
+}
+
+// dst(x, y) = src(x - dx, y - dy), with the pixels shifted in from outside the
+// frame taken from the nearest edge so no artificial edge appears in the frame
+static bool shift_frame(usImage& dst, const usImage& src, int dx, int dy)
+{
+    if (dst.Init(src.Size))
+        return true;
+
+    int const w = src.Size.GetWidth();
+    int const h = src.Size.GetHeight();
+
+    for (int y = 0; y < h; y++)
+    {
+        int const sy = wxMax(0, wxMin(h - 1, y - dy));
+        const unsigned short *const srow = &src.Pixel(0, sy);
+        unsigned short *const drow = &dst.Pixel(0, y);
+
+        int const x0 = wxMax(0, wxMin(w, dx));          // first column copied from the source row
+        int const x1 = wxMax(x0, wxMin(w, w + dx));     // end of the copied columns
+        for (int x = 0; x < x0; x++)
+            drow[x] = srow[0];
+        if (x1 > x0)
+            memcpy(drow + x0, srow + x0 - dx, (x1 - x0) * sizeof(unsigned short));
+        for (int x = x1; x < w; x++)
+            drow[x] = srow[w - 1];
+    }
+
+    return false;
+}
+
+bool Camera_ReplayClass::Capture(int duration, usImage& img, int options, const wxRect& subframe)
+{
+    int const interval = ReplayInterval(duration);
+    CameraWatchdog watchdog(interval, GetTimeoutMs());
+
+    if (m_next >= m_files.size())
+    {
+        if (!m_params.loop || m_files.IsEmpty())
+        {
+            pFrame->Alert(_("End of the replayed FITS sequence"));
+            return true;
+        }
+        m_next = 0;
+    }
+
+    size_t const idx = m_next++;
+
+    usImage loaded;
+    const usImage *frame = m_frames[idx];
+    if (!frame)
+    {
+        if (loaded.Load(m_files[idx]))
+            return true;
+        frame = &loaded;
+    }
+
+    if (frame->Size != FullSize)
+    {
+        pFrame->Alert(wxString::Format(_("Replayed frame %s is not the same size as the first frame"), m_files[idx]));
+        return true;
+    }
+
+    wxRealPoint ofs;
+    { // lock scope
+        wxCriticalSectionLocker lck(m_ofsLock);
+        ofs = m_guideOfs;
+    } // lock scope
+
+    int const dx = ROUND(ofs.x);
+    int const dy = ROUND(ofs.y);
+
+    bool err = dx == 0 && dy == 0 ? img.CopyFrom(*frame) : shift_frame(img, *frame, dx, dy);
+    if (err)
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    if (options & CAPTURE_SUBTRACT_DARK)
+        SubtractDark(img);
+
+    long elapsed = watchdog.Time();
+    if (elapsed < interval)
+    {
+        if (WorkerThread::MilliSleep(interval - elapsed, WorkerThread::INT_ANY))
+            return true;
+        if (watchdog.Expired())
+        {
+            DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
+            return true;
+        }
+    }
+
+    MarkCapture(CAPTURE_STAGE_EXPOSED);
+
+    return false;
+}
+
+// Guide pulses move the replayed frames rather than the star: west and east
+// along +x and -x, north and south along +y and -y. Calibration learns the
+// directions like it would for a real mount.
+bool Camera_ReplayClass::ST4PulseGuideScope(int direction, int duration)
+{
+    double const d = m_params.guideFeedback ? m_params.guideRate * duration / 1000.0 : 0.0;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(m_ofsLock);
+        switch (direction) {
+        case WEST:    m_guideOfs.x += d; break;
+        case EAST:    m_guideOfs.x -= d; break;
+        case NORTH:   m_guideOfs.y += d; break;
+        case SOUTH:   m_guideOfs.y -= d; break;
+        default: return true;
+        }
+    } // lock scope
+
+    int const interval = ReplayInterval(duration);
+    if (interval > 0)
+        WorkerThread::MilliSleep(interval, WorkerThread::INT_ANY);
+
+    return false;
+}
+
+struct ReplayDialog : public wxDialog
+{
+    wxDirPickerCtrl *m_dir;
+    wxChoice *m_mode;
+    wxSpinCtrlDouble *m_speedup;
+    wxCheckBox *m_loop;
+    wxCheckBox *m_preload;
+    wxSpinCtrl *m_preloadMB;
+    wxCheckBox *m_guideFeedback;
+    wxSpinCtrlDouble *m_guideRate;
+
+    ReplayDialog(wxWindow *parent, const Camera_ReplayClass::Params& params);
+    void Get(Camera_ReplayClass::Params *params) const;
+};
+
+static void AddRow(wxWindow *parent, wxFlexGridSizer *table, const wxString& label, wxWindow *ctrl, const wxString& tooltip)
+{
+    ctrl->SetToolTip(tooltip);
+    table->Add(new wxStaticText(parent, wxID_ANY, label + _(": ")), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxALL, 5));
+    table->Add(ctrl, wxSizerFlags().Expand().Border(wxALL, 5));
+}
+
+ReplayDialog::ReplayDialog(wxWindow *parent, const Camera_ReplayClass::Params& params)
+    : wxDialog(parent, wxID_ANY, _("FITS Replay"))
+{
+    wxFlexGridSizer *table = new wxFlexGridSizer(2, 5, 5);
+    table->AddGrowableCol(1);
+
+    m_dir = new wxDirPickerCtrl(this, wxID_ANY, params.dir, _("Choose the folder of FITS frames to replay"),
+        wxDefaultPosition, wxSize(StringWidth(this, _T("M")) * 30, -1));
+    AddRow(this, table, _("Frames folder"), m_dir, _("Folder of FITS frames to replay, in file name order. Takes effect when the camera connects."));
+
+    wxArrayString modes;
+    modes.Add(_("Real time"));
+    modes.Add(_("Accelerated"));
+    modes.Add(_("As fast as possible"));
+    m_mode = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, modes);
+    m_mode->SetSelection(params.mode);
+    AddRow(this, table, _("Replay rate"), m_mode, _("Real time delivers a frame per exposure duration; accelerated divides exposures and guide pulses by the speed-up; "
+        "as fast as possible does not wait at all"));
+
+    m_speedup = new wxSpinCtrlDouble(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1.0, REPLAY_SPEEDUP_MAX, params.speedup, 1.0);
+    AddRow(this, table, _("Speed-up"), m_speedup, _("Speed-up factor for accelerated replay"));
+
+    m_loop = new wxCheckBox(this, wxID_ANY, _("Start over at the end of the sequence"));
+    m_loop->SetValue(params.loop);
+    AddRow(this, table, _("Loop"), m_loop, _("Replay the sequence again from the first frame after the last one"));
+
+    m_preload = new wxCheckBox(this, wxID_ANY, _("Read frames into memory when connecting"));
+    m_preload->SetValue(params.preload);
+    AddRow(this, table, _("Preload"), m_preload, _("Read the frames when the camera connects so that replay does not wait for the disk. Takes effect when the camera connects."));
+
+    m_preloadMB = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 65536, params.preloadMB);
+    AddRow(this, table, _("Preload limit (MB)"), m_preloadMB, _("Frames beyond this much memory are read from disk as they are replayed"));
+
+    m_guideFeedback = new wxCheckBox(this, wxID_ANY, _("Shift frames by guide pulses"));
+    m_guideFeedback->SetValue(params.guideFeedback);
+    AddRow(this, table, _("Guide feedback"), m_guideFeedback, _("Move the replayed frames in response to guide pulses sent through the camera's guide port"));
+
+    m_guideRate = new wxSpinCtrlDouble(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0.0, 100.0, params.guideRate, 0.5);
+    AddRow(this, table, _("Guide rate (px/sec)"), m_guideRate, _("How far the frames move per second of guide pulse"));
+
+    wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+    sizer->Add(table, wxSizerFlags().Expand().Border(wxALL, 10));
+    sizer->Add(CreateButtonSizer(wxOK | wxCANCEL), wxSizerFlags().Expand().Border(wxALL, 10));
+    SetSizerAndFit(sizer);
+}
+
+void ReplayDialog::Get(Camera_ReplayClass::Params *params) const
+{
+    params->dir = m_dir->GetPath();
+    params->mode = (Camera_ReplayClass::ReplayMode) m_mode->GetSelection();
+    params->speedup = m_speedup->GetValue();
+    params->loop = m_loop->GetValue();
+    params->preload = m_preload->GetValue();
+    params->preloadMB = m_preloadMB->GetValue();
+    params->guideFeedback = m_guideFeedback->GetValue();
+    params->guideRate = m_guideRate->GetValue();
+}
+
+void Camera_ReplayClass::ShowPropertyDialog()
+{
+    Params params;
+    params.Load();
+
+    ReplayDialog dlg(pFrame, params);
+    if (dlg.ShowModal() != wxID_OK)
+        return;
+
+    dlg.Get(&params);
+    params.Save();
+
+    // the folder and preloading apply at the next connection, the rest
+    // applies to the next frame or guide pulse
+    if (Connected)
+    {
+        m_params.mode = params.mode;
+        m_params.speedup = params.speedup;
+        m_params.loop = params.loop;
+        m_params.guideFeedback = params.guideFeedback;
+        m_params.guideRate = params.guideRate;
+    }
+}
+
+#endif // REPLAY_CAMERA
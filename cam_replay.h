@@ -0,0 +1,97 @@
+/*
+ *  cam_replay.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2017 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+
+#ifndef CAM_REPLAY_INCLUDED
+#define CAM_REPLAY_INCLUDED
+
+#if defined (REPLAY_CAMERA)
+
+// A camera that replays a recorded sequence of FITS frames, such as the
+// frames saved by the star image logger or the raw image logger, in file name
+// order. Frames can be delivered at the requested exposure rate, at a multiple
+// of it, or as fast as they can be copied out, so the same sequence can be
+// fed through the guiding pipeline repeatably without any hardware. Guide
+// pulses sent through the camera's guide port can be fed back as whole-pixel
+// shifts of the replayed frames, which is enough for calibration and for
+// closed-loop guiding against the recorded motion.
+class Camera_ReplayClass : public GuideCamera
+{
+public:
+    enum ReplayMode
+    {
+        REPLAY_REAL_TIME,       // one frame per requested exposure duration
+        REPLAY_ACCELERATED,     // exposure durations and guide pulses divided by the speed-up factor
+        REPLAY_AS_FAST_AS_POSSIBLE,
+    };
+
+    struct Params
+    {
+        wxString dir;
+        ReplayMode mode;
+        double speedup;
+        bool loop;
+        bool preload;
+        int preloadMB;
+        bool guideFeedback;
+        double guideRate;       // pixels per second of guide pulse
+
+        void Load();
+        void Save() const;
+    };
+
+private:
+    Params m_params;
+    wxArrayString m_files;
+    std::vector<usImage *> m_frames;    // preloaded frames, NULL where a frame is read when it is needed
+    size_t m_next;
+    wxCriticalSection m_ofsLock;        // protects m_guideOfs, pulses arrive on the other worker thread
+    wxRealPoint m_guideOfs;             // accumulated guide pulse motion, pixels
+
+    void FreeFrames();
+    int ReplayInterval(int duration) const;
+
+public:
+    Camera_ReplayClass();
+    ~Camera_ReplayClass();
+    bool     Capture(int duration, usImage& img, int options, const wxRect& subframe);
+    bool     Connect(const wxString& camId);
+    bool     Disconnect();
+    void     ShowPropertyDialog();
+    bool     HasNonGuiCapture() { return true; }
+    bool     ST4HasNonGuiMove() { return true; }
+    wxByte   BitsPerPixel();
+    bool     ST4PulseGuideScope(int direction, int duration);
+};
+
+#endif // REPLAY_CAMERA
+
+#endif
@@ -81,10 +81,11 @@ struct SimCamParams
     static bool show_comet;
     static double comet_rate_x;
     static double comet_rate_y;
+    static bool no_wait;
 };
 
-unsigned int SimCamParams::width = 752;          // simulated camera image width
-unsigned int SimCamParams::height = 580;         // simulated camera image height
+unsigned int SimCamParams::width;                // simulated camera image width
+unsigned int SimCamParams::height;               // simulated camera image height
 unsigned int SimCamParams::border = 12;          // do not place any stars within this size border
 unsigned int SimCamParams::nr_stars;             // number of stars to generate
 unsigned int SimCamParams::nr_hot_pixels;        // number of hot pixels to generate
@@ -106,8 +107,14 @@ double SimCamParams::custom_pe_period;
 bool SimCamParams::show_comet;
 double SimCamParams::comet_rate_x;
 double SimCamParams::comet_rate_y;
+bool SimCamParams::no_wait;                      // do not wait out exposures and pulses, for the guide loop benchmark
 
 // Note: these are all in units appropriate for the UI
+#define FRAME_WIDTH_DEFAULT 752
+#define FRAME_HEIGHT_DEFAULT 580
+#define FRAME_SIZE_MIN 128
+#define FRAME_SIZE_MAX 16384
+#define FRAME_PIXELS_MAX 60000000                 // 60 MP, for load testing the guiding pipeline
 #define NR_STARS_DEFAULT 20
 #define NR_HOT_PIXELS_DEFAULT 8
 #define NOISE_DEFAULT 2.0
@@ -142,10 +149,22 @@ static double range_check(double thisval, double minval, double maxval)
     return wxMin(wxMax(thisval, minval), maxval);
 }
 
+// keep the frame within FRAME_PIXELS_MAX by reducing the height
+static void frame_size_check(unsigned int *width, unsigned int *height)
+{
+    *width = (unsigned int) range_check(*width, FRAME_SIZE_MIN, FRAME_SIZE_MAX);
+    *height = (unsigned int) range_check(*height, FRAME_SIZE_MIN, FRAME_SIZE_MAX);
+    if ((wxUint64) *width * *height > FRAME_PIXELS_MAX)
+        *height = FRAME_PIXELS_MAX / *width;
+}
+
 static void load_sim_params()
 {
     SimCamParams::image_scale = pFrame->GetCameraPixelScale();
 
+    SimCamParams::width = pConfig->Profile.GetInt("/SimCam/frame_width", FRAME_WIDTH_DEFAULT);
+    SimCamParams::height = pConfig->Profile.GetInt("/SimCam/frame_height", FRAME_HEIGHT_DEFAULT);
+    frame_size_check(&SimCamParams::width, &SimCamParams::height);
     SimCamParams::nr_stars = pConfig->Profile.GetInt("/SimCam/nr_stars", NR_STARS_DEFAULT);
     SimCamParams::nr_hot_pixels = pConfig->Profile.GetInt("/SimCam/nr_hot_pixels", NR_HOT_PIXELS_DEFAULT);
     SimCamParams::noise_multiplier = pConfig->Profile.GetDouble("/SimCam/noise", NOISE_DEFAULT);
@@ -170,10 +189,13 @@ static void load_sim_params()
     SimCamParams::show_comet = pConfig->Profile.GetBoolean("/SimCam/show_comet", SHOW_COMET_DEFAULT);
     SimCamParams::comet_rate_x = pConfig->Profile.GetDouble("/SimCam/comet_rate_x", COMET_RATE_X_DEFAULT);
     SimCamParams::comet_rate_y = pConfig->Profile.GetDouble("/SimCam/comet_rate_y", COMET_RATE_Y_DEFAULT);
+    SimCamParams::no_wait = pConfig->Profile.GetBoolean("/SimCam/no_wait", false);
 }
 
 static void save_sim_params()
 {
+    pConfig->Profile.SetInt("/SimCam/frame_width", SimCamParams::width);
+    pConfig->Profile.SetInt("/SimCam/frame_height", SimCamParams::height);
     pConfig->Profile.SetInt("/SimCam/nr_stars", SimCamParams::nr_stars);
     pConfig->Profile.SetInt("/SimCam/nr_hot_pixels", SimCamParams::nr_hot_pixels);
     pConfig->Profile.SetDouble("/SimCam/noise", SimCamParams::noise_multiplier);
@@ -264,7 +286,8 @@ bool StepGuiderSimulator::Step(GUIDE_DIRECTION direction, int steps)
 
     // parent class maintains x/y offsets, so nothing to do here. Just simulate a delay.
     enum { LATENCY_MS_PER_STEP = 5 };
-    wxMilliSleep(steps * LATENCY_MS_PER_STEP);
+    if (!SimCamParams::no_wait)
+        wxMilliSleep(steps * LATENCY_MS_PER_STEP);
     return false;
 }
 
@@ -667,9 +690,7 @@ static void rand_normal(double r[2])
 
 inline static unsigned short *pixel_addr(usImage& img, int x, int y)
 {
-    if (x < 0 || x >= img.Size.x)
-        return 0;
-    if (y < 0 || y >= img.Size.y)
+    if (!img.DataRect.Contains(x, y))
         return 0;
     return &img.Pixel(x, y);
 }
@@ -694,41 +715,156 @@ inline static void incr_pixel(usImage& img, int x, int y, unsigned int val)
     }
 }
 
-static void render_comet(usImage& img, int binning, const wxRect& subframe, const wxRealPoint& p, double inten)
+inline static unsigned short clamp_pixel(double val)
+{
+    if (val <= 0.0)
+        return 0;
+    if (val >= 65535.0)
+        return 65535;
+    return (unsigned short) val;
+}
+
+// Per-pixel noise comes from a xorshift generator rather than rand(), with one
+// generator per strip of rows so that large frames are filled on all cores.
+// Each 64-bit draw gives four 16-bit uniform values, each scaled to the noise
+// range and mapped to a pixel value through a table built once per frame.
+struct SimRandom
+{
+    wxUint64 s;
+
+    SimRandom(wxUint64 seed)
+    {
+        // splitmix64 step, so that consecutive seeds give unrelated sequences
+        seed += 0x9E3779B97F4A7C15ULL;
+        seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+        s = (seed ^ (seed >> 31)) | 1;
+    }
+
+    wxUint64 Next()
+    {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 0x2545F4914F6CDD1DULL;
+    }
+};
+
+struct RandomFillJob : public ImageStripJob
 {
-    enum { WIDTH = 5 };
-    double STAR[][WIDTH] = { { 0.0, 0.8, 2.2, 0.8, 0.0, },
-                             { 0.8, 16.6, 46.1, 16.6, 0.8, },
-                             { 2.2, 46.1, 128.0, 46.1, 2.2, },
-                             { 0.8, 16.6, 46.1, 16.6, 0.8, },
-                             { 0.0, 0.8, 2.2, 0.8, 0.0, },
-                            };
-
-    wxRealPoint intpart;
-    double fx = modf(p.x / (double) binning, &intpart.x);
-    double fy = modf(p.y / (double) binning, &intpart.y);
-    double f00 = (1.0 - fx) * (1.0 - fy);
-    double f01 = (1.0 - fx) * fy;
-    double f10 = fx * (1.0 - fy);
-    double f11 = fx * fy;
-
-    double d[WIDTH + 1][WIDTH + 1] = { { 0.0 } };
-    for (unsigned int i = 0; i < WIDTH; i++)
-    for (unsigned int j = 0; j < WIDTH; j++)
+    usImage& img;
+    wxRect rect;
+    const std::vector<unsigned short>& lut;  // pixel value for each noise sample, at most 65535 entries
+    wxUint64 seed;
+
+    RandomFillJob(usImage& img_, const wxRect& rect_, const std::vector<unsigned short>& lut_)
+        : img(img_), rect(rect_), lut(lut_)
     {
-        double s = STAR[i][j];
-        if (s > 0.0)
+        seed = ((wxUint64) rand() << 32) ^ ((wxUint64) rand() << 16) ^ (wxUint64) rand();
+    }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        SimRandom rng(seed + strip);
+        const unsigned short *const tbl = &lut[0];
+        unsigned int const range = lut.size();
+        unsigned int const w = rect.GetWidth();
+
+#define SAMPLE(v, n) tbl[((unsigned int)(((v) >> (16 * (n))) & 0xffff) * range) >> 16]
+
+        for (int r = rowBegin; r < rowEnd; r++)
         {
-            s *= inten / 256.0;
-            d[i][j] += f00 * s;
-            d[i + 1][j] += f10 * s;
-            d[i][j + 1] += f01 * s;
-            d[i + 1][j + 1] += f11 * s;
+            unsigned short *const p = &img.Pixel(rect.GetLeft(), rect.GetTop() + r);
+            unsigned int x = 0;
+            for (; x + 4 <= w; x += 4)
+            {
+                wxUint64 const v = rng.Next();
+                p[x] = SAMPLE(v, 0);
+                p[x + 1] = SAMPLE(v, 1);
+                p[x + 2] = SAMPLE(v, 2);
+                p[x + 3] = SAMPLE(v, 3);
+            }
+            if (x < w)
+            {
+                wxUint64 const v = rng.Next();
+                for (unsigned int n = 0; x < w; x++, n++)
+                    p[x] = SAMPLE(v, n);
+            }
         }
+
+#undef SAMPLE
+    }
+};
+
+// set each pixel in rect to lut[i] for i uniformly distributed over the table
+static void fill_random(usImage& img, const wxRect& rect, const std::vector<unsigned short>& lut)
+{
+    if (lut.empty() || rect.IsEmpty())
+        return;
+    wxASSERT(lut.size() <= 65535);
+
+    RandomFillJob job(img, rect, lut);
+    RunImageStrips(job, ImageStripCount(rect.GetHeight(), 128), rect.GetHeight());
+}
+
+// The star profile, 128 at the peak. A star is rendered by splitting the
+// profile over the pixels it straddles by bilinear interpolation, giving a
+// stamp one pixel wider and taller than the profile.
+enum { PSF_WIDTH = 5 };
+static const double PSF[PSF_WIDTH][PSF_WIDTH] = {{ 0.0,  0.8,   2.2,  0.8, 0.0, },
+                                                 { 0.8, 16.6,  46.1, 16.6, 0.8, },
+                                                 { 2.2, 46.1, 128.0, 46.1, 2.2, },
+                                                 { 0.8, 16.6,  46.1, 16.6, 0.8, },
+                                                 { 0.0,  0.8,   2.2,  0.8, 0.0, },
+                                                };
+
+struct StarStamp
+{
+    enum { SIZE = PSF_WIDTH + 1 };
+
+    wxPoint origin;                 // image position of val[0][0]
+    double fx, fy;                  // sub-pixel position of the star
+    unsigned int val[SIZE][SIZE];   // pixel increments, indexed [x][y]
+
+    StarStamp(int binning, const wxRealPoint& p)
+    {
+        wxRealPoint intpart;
+        fx = modf(p.x / (double) binning, &intpart.x);
+        fy = modf(p.y / (double) binning, &intpart.y);
+        origin = wxPoint((int) intpart.x - (PSF_WIDTH - 1) / 2,
+                         (int) intpart.y - (PSF_WIDTH - 1) / 2);
+    }
+
+    wxRect Rect() const { return wxRect(origin, wxSize(SIZE, SIZE)); }
+
+    static double psf(int i, int j)
+    {
+        return i >= 0 && i < PSF_WIDTH && j >= 0 && j < PSF_WIDTH ? PSF[i][j] : 0.0;
+    }
+
+    void Render(double inten)
+    {
+        double const k = inten / 256.0;
+        double const f00 = (1.0 - fx) * (1.0 - fy) * k;
+        double const f01 = (1.0 - fx) * fy * k;
+        double const f10 = fx * (1.0 - fy) * k;
+        double const f11 = fx * fy * k;
+
+        for (int i = 0; i < SIZE; i++)
+            for (int j = 0; j < SIZE; j++)
+            {
+                double d = f00 * psf(i, j) + f10 * psf(i - 1, j) + f01 * psf(i, j - 1) + f11 * psf(i - 1, j - 1);
+                val[i][j] = clamp_pixel(d);
+            }
     }
+};
+
+static void render_comet(usImage& img, int binning, const wxRect& subframe, const wxRealPoint& p, double inten)
+{
+    StarStamp stamp(binning, p);
+    stamp.Render(inten);
 
-    wxPoint c((int)intpart.x - (WIDTH - 1) / 2,
-        (int)intpart.y - (WIDTH - 1) / 2);
+    wxPoint const& c = stamp.origin;
 
     for (unsigned int x_inc = 0; x_inc < 10; x_inc++)
     {
@@ -737,7 +873,7 @@ static void render_comet(usImage& img, int binning, const wxRect& subframe, cons
             int const cx = c.x + x_inc;
             int const cy = c.y + y * x_inc;
             if (cx < subframe.GetRight() && cy < subframe.GetBottom() && cy > subframe.GetTop())
-                incr_pixel(img, cx, cy, (int)d[2][2]);
+                incr_pixel(img, cx, cy, stamp.val[2][2]);
         }
 
     }
@@ -746,67 +882,37 @@ static void render_comet(usImage& img, int binning, const wxRect& subframe, cons
 
 static void render_star(usImage& img, int binning, const wxRect& subframe, const wxRealPoint& p, double inten)
 {
-    enum { WIDTH = 5 };
-    double STAR[][WIDTH] = {{ 0.0,  0.8,   2.2,  0.8, 0.0, },
-                            { 0.8, 16.6,  46.1, 16.6, 0.8, },
-                            { 2.2, 46.1, 128.0, 46.1, 2.2, },
-                            { 0.8, 16.6,  46.1, 16.6, 0.8, },
-                            { 0.0,  0.8,   2.2,  0.8, 0.0, },
-                           };
-
-    wxRealPoint intpart;
-    double fx = modf(p.x / (double) binning, &intpart.x);
-    double fy = modf(p.y / (double) binning, &intpart.y);
-    double f00 = (1.0 - fx) * (1.0 - fy);
-    double f01 = (1.0 - fx) * fy;
-    double f10 = fx * (1.0 - fy);
-    double f11 = fx * fy;
-
-    double d[WIDTH + 1][WIDTH + 1] = { { 0.0 } };
-    for (unsigned int i = 0; i < WIDTH; i++)
-        for (unsigned int j = 0; j < WIDTH; j++)
-        {
-            double s = STAR[i][j];
-            if (s > 0.0)
-            {
-                s *= inten / 256.0;
-                d[i][j] += f00 * s;
-                d[i+1][j] += f10 * s;
-                d[i][j+1] += f01 * s;
-                d[i+1][j+1] += f11 * s;
-            }
-        }
+    StarStamp stamp(binning, p);
+
+    // most stars miss a small subframe entirely, so clip before rendering
+    wxRect area(stamp.Rect());
+    area.Intersect(subframe);
+    area.Intersect(img.DataRect);
+    if (area.IsEmpty())
+        return;
 
-    wxPoint c((int) intpart.x - (WIDTH - 1) / 2,
-              (int) intpart.y - (WIDTH - 1) / 2);
+    stamp.Render(inten);
 
-    for (unsigned int i = 0; i < WIDTH + 1; i++)
+    for (int y = area.GetTop(); y <= area.GetBottom(); y++)
     {
-        int const cx = c.x + i;
-        if (cx < subframe.GetLeft() || cx > subframe.GetRight())
-            continue;
-        for (unsigned int j = 0; j < WIDTH + 1; j++)
+        unsigned short *px = &img.Pixel(area.GetLeft(), y);
+        for (int x = area.GetLeft(); x <= area.GetRight(); x++, px++)
         {
-            int const cy = c.y + j;
-            if (cy < subframe.GetTop() || cy > subframe.GetBottom())
-                continue;
-            int incr = (int) d[i][j];
-            if (incr > (unsigned short)-1)
-                incr = (unsigned short)-1;
-            incr_pixel(img, cx, cy, incr);
+            unsigned int t = *px + stamp.val[x - stamp.origin.x][y - stamp.origin.y];
+            *px = t > 65535 ? 65535 : (unsigned short) t;
         }
     }
 }
 
 static void render_clouds(usImage& img, const wxRect& subframe, int exptime, int gain, int offset)
 {
-    unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
-    {
-        unsigned short *const end = p0 + subframe.GetWidth();
-        for (unsigned short *p = p0; p < end; p++)
-            *p = (unsigned short) (SimCamParams::clouds_inten * ((double) gain / 10.0 * offset * exptime / 100.0 + ((rand() % (gain * 100)) / 30.0)));
-    }
+    unsigned int const range = gain * 100;
+    double const dark = (double) gain / 10.0 * offset * exptime / 100.0;
+    std::vector<unsigned short> lut(range);
+    for (unsigned int i = 0; i < range; i++)
+        lut[i] = clamp_pixel(SimCamParams::clouds_inten * (dark + i / 30.0));
+
+    fill_random(img, subframe, lut);
 }
 
 #ifdef SIM_FILE_DISPLACEMENTS
@@ -1068,6 +1174,7 @@ Camera_SimClass::Camera_SimClass()
     HasShutter = true;
     HasGainControl = true;
     HasSubframes = true;
+    HasPipelinedCapture = true;
     PropertyDialogType = PROPDLG_WHEN_CONNECTED;
     MaxBinning = 3;
     HasCooler = true;
@@ -1169,13 +1276,13 @@ bool Camera_SimClass::Capture(int duration, usImage& img, int options, const wxR
 #if SIMMODE == 3
 static void fill_noise(usImage& img, const wxRect& subframe, int exptime, int gain, int offset)
 {
-    unsigned short *p0 = &img.Pixel(subframe.GetLeft(), subframe.GetTop());
-    for (int r = 0; r < subframe.GetHeight(); r++, p0 += img.Size.GetWidth())
-    {
-        unsigned short *const end = p0 + subframe.GetWidth();
-        for (unsigned short *p = p0; p < end; p++)
-            *p = (unsigned short) (SimCamParams::noise_multiplier * ((double) gain / 10.0 * offset * exptime / 100.0 + (rand() % (gain * 100))));
-    }
+    unsigned int const range = gain * 100;
+    double const dark = (double) gain / 10.0 * offset * exptime / 100.0;
+    std::vector<unsigned short> lut(range);
+    for (unsigned int i = 0; i < range; i++)
+        lut[i] = clamp_pixel(SimCamParams::noise_multiplier * (dark + i));
+
+    fill_random(img, subframe, lut);
 }
 #endif // SIMMODE == 3
 
@@ -1210,28 +1317,23 @@ bool Camera_SimClass::Capture(int duration, usImage& img, int options, const wxR
     int const gain = 30;
     int const offset = 100;
 
-    if (img.Init(FullSize))
+    // a subframe is rendered into an image holding just the subframe
+    if (usingSubframe ? img.InitROI(FullSize, subframe) : img.Init(FullSize))
     {
         pFrame->Alert(_("Memory allocation error"));
         return true;
     }
 
-    if (usingSubframe)
-        img.Clear();
-
     fill_noise(img, subframe, exptime, gain, offset);
 
     sim->FillImage(img, subframe, exptime, gain, offset);
 
-    if (usingSubframe)
-        img.Subframe = subframe;
-
     if (options & CAPTURE_SUBTRACT_DARK) SubtractDark(img);
 
 #endif // SIMMODE == 1
 
     long elapsed = watchdog.Time();
-    if (elapsed < duration)
+    if (elapsed < duration && !SimCamParams::no_wait)
     {
         if (WorkerThread::MilliSleep(duration - elapsed, WorkerThread::INT_ANY))
             return true;
@@ -1242,6 +1344,9 @@ bool Camera_SimClass::Capture(int duration, usImage& img, int options, const wxR
         }
     }
 
+    // the frame is rendered before the simulated exposure time has elapsed
+    MarkCapture(CAPTURE_STAGE_EXPOSED);
+
     return false;
 }
 
@@ -1274,7 +1379,8 @@ bool Camera_SimClass::ST4PulseGuideScope(int direction, int duration)
     case SOUTH:   sim->dec_ofs.incr(-d); break;
     default: return true;
     }
-    WorkerThread::MilliSleep(duration, WorkerThread::INT_ANY);
+    if (!SimCamParams::no_wait)
+        WorkerThread::MilliSleep(duration, WorkerThread::INT_ANY);
     return false;
 }
 
@@ -1400,6 +1506,8 @@ bool Camera_SimClass::Capture(int duration, usImage& img, int options, const wxR
 
 struct SimCamDialog : public wxDialog
 {
+    wxSpinCtrl *pWidthSpin;
+    wxSpinCtrl *pHeightSpin;
     wxSlider *pStarsSlider;
     wxSlider *pHotpxSlider;
     wxSlider *pNoiseSlider;
@@ -1457,6 +1565,14 @@ static wxSpinCtrlDouble *NewSpinner(wxWindow *parent, double val, double minval,
     return pNewCtrl;
 }
 
+static wxSpinCtrl *NewSpinnerInt(wxWindow *parent, int val, int minval, int maxval, const wxString& tooltip)
+{
+    wxSpinCtrl *pNewCtrl = new wxSpinCtrl(parent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxDefaultSize, wxSP_ARROW_KEYS, minval, maxval, val);
+    pNewCtrl->SetToolTip(tooltip);
+    return pNewCtrl;
+}
+
 static wxCheckBox *NewCheckBox(wxWindow *parent, bool val, const wxString& label, const wxString& tooltip)
 {
     wxCheckBox *pNewCtrl = new wxCheckBox(parent, wxID_ANY, label);
@@ -1497,6 +1613,8 @@ static void SetControlStates(SimCamDialog *dlg, bool captureActive)
 {
     bool enable = !captureActive;
 
+    dlg->pWidthSpin->Enable(enable);
+    dlg->pHeightSpin->Enable(enable);
     dlg->pBacklashSpin->Enable(enable);
     dlg->pGuideRateSpin->Enable(enable);
     dlg->pCameraAngleSpin->Enable(enable);
@@ -1548,6 +1666,12 @@ void SimCamDialog::OnOkClick(wxCommandEvent& evt)
         }
     }
 
+    if (bOk && (wxUint64) pWidthSpin->GetValue() * pHeightSpin->GetValue() > FRAME_PIXELS_MAX)
+    {
+        wxMessageBox(wxString::Format(_("The frame size cannot exceed %d megapixels"), FRAME_PIXELS_MAX / 1000000), "Error", wxOK | wxICON_ERROR);
+        bOk = false;
+    }
+
     if (bOk)
         wxDialog::EndModal(wxID_OK);
 }
@@ -1562,7 +1686,11 @@ SimCamDialog::SimCamDialog(wxWindow *parent)
 
     // Camera group controls
     wxStaticBoxSizer *pCamGroup = new wxStaticBoxSizer(wxVERTICAL, this, _("Camera"));
-    wxFlexGridSizer *pCamTable = new wxFlexGridSizer(1, 6, 15, 15);
+    wxFlexGridSizer *pCamTable = new wxFlexGridSizer(2, 6, 15, 15);
+    pWidthSpin = NewSpinnerInt(this, SimCamParams::width, FRAME_SIZE_MIN, FRAME_SIZE_MAX, _("Simulated camera frame width, pixels"));
+    AddTableEntryPair(this, pCamTable, _("Frame width"), pWidthSpin);
+    pHeightSpin = NewSpinnerInt(this, SimCamParams::height, FRAME_SIZE_MIN, FRAME_SIZE_MAX, _("Simulated camera frame height, pixels"));
+    AddTableEntryPair(this, pCamTable, _("Frame height"), pHeightSpin);
     pStarsSlider = NewSlider(this, SimCamParams::nr_stars, 1, 100, _("Number of simulated stars"));
     AddTableEntryPair(this, pCamTable, _("Stars"), pStarsSlider);
     pHotpxSlider = NewSlider(this, SimCamParams::nr_hot_pixels, 0, 50, _("Number of hot pixels"));
@@ -1680,6 +1808,8 @@ SimCamDialog::SimCamDialog(wxWindow *parent)
 
 void SimCamDialog::OnReset(wxCommandEvent& event)
 {
+    pWidthSpin->SetValue(FRAME_WIDTH_DEFAULT);
+    pHeightSpin->SetValue(FRAME_HEIGHT_DEFAULT);
     pStarsSlider->SetValue(NR_STARS_DEFAULT);
     pHotpxSlider->SetValue(NR_HOT_PIXELS_DEFAULT);
     pNoiseSlider->SetValue((int)floor(NOISE_DEFAULT * 100.0 / NOISE_MAX));
@@ -1726,6 +1856,9 @@ void Camera_SimClass::ShowPropertyDialog()
     SimCamParams::image_scale = imageScale;                         // keep current - might have gotten changed in brain dialog
     if (dlg.ShowModal() == wxID_OK)
     {
+        SimCamParams::width = dlg.pWidthSpin->GetValue();
+        SimCamParams::height = dlg.pHeightSpin->GetValue();
+        frame_size_check(&SimCamParams::width, &SimCamParams::height);
         SimCamParams::nr_stars = dlg.pStarsSlider->GetValue();
         SimCamParams::nr_hot_pixels = dlg.pHotpxSlider->GetValue();
         SimCamParams::noise_multiplier = (double) dlg.pNoiseSlider->GetValue() * NOISE_MAX / 100.0;
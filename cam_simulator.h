@@ -47,6 +47,7 @@ public:
     bool     Capture(int duration, usImage& img, int options, const wxRect& subframe);
     bool     Connect(const wxString& camId);
     bool     Disconnect();
+    bool     CanConnectInBackground(void) const { return true; }
     void     ShowPropertyDialog();
     bool     HasNonGuiCapture() { return true; }
     bool     ST4HasNonGuiMove() { return true; }
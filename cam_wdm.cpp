@@ -79,21 +79,10 @@ bool Camera_WDMClass::CaptureCallback(CVRES status, CVImage* imagePtr, void* use
 
     if (bReturn && cam->m_captureMode != NOT_CAPTURING)
     {
-        int i;
-        unsigned int sum = 0;
-        unsigned char *imgdata = imagePtr->GetRawDataPtr();
+        // the grey frame is added straight into the guide frame on the
+        // capture thread
         int npixels = cam->FullSize.GetWidth() * cam->FullSize.GetHeight();
-        unsigned short *dptr = cam->m_stackptr;
-
-        for (i = 0; i < npixels; i++, dptr++)
-        {
-            unsigned short pixelValue = *imgdata++;
-            unsigned int newval = (unsigned int) *dptr + pixelValue;
-            if (newval > 65535)
-                newval = 65535;
-            *dptr = (unsigned short) newval;
-            sum += pixelValue;
-        }
+        unsigned long long sum = AccumulatePixels(cam->m_stackptr, imagePtr->GetRawDataPtr(), npixels);
 
         if (sum > 100) // non-black
         {
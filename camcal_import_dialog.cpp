@@ -221,6 +221,7 @@ void CamCalImportDialog::OnOk(wxCommandEvent& evt)
     {
         sourceName = MyFrame::DarkLibFileName(m_sourceDarksProfileId);
         destName = MyFrame::DarkLibFileName(m_thisProfileId);
+        DarkLibCache::Remove(destName); // the copy may keep the source timestamp
         if (wxCopyFile(sourceName, destName, true))
         {
             Debug.Write(wxString::Format("Dark library imported from profile %d to profile %d\n", m_sourceDarksProfileId, m_thisProfileId));
@@ -38,13 +38,19 @@
 #include "camera.h"
 #include <wx/stdpaths.h>
 
+#ifdef __WINDOWS__
+# include <DelayImp.h>
+#endif
+
 static const int DefaultGuideCameraGain = 95;
 static const int DefaultGuideCameraTimeoutMs = 15000;
+static const int DefaultMaxFrameAgeMs = 5000;
 static const bool DefaultUseSubframes = false;
 static const double DefaultPixelSize = 0.0;
 static const int DefaultReadDelay = 150;
 static const bool DefaultLoadDarks = true;
 static const bool DefaultLoadDMap = false;
+static const int DefaultDarkMemoryMB = 256;
 
 wxSize UNDEFINED_FRAME_SIZE = wxSize(0, 0);
 
@@ -136,6 +142,14 @@ wxSize UNDEFINED_FRAME_SIZE = wxSize(0, 0);
 #include "cam_simulator.h"
 //#endif
 
+#if defined (REPLAY_CAMERA)
+#include "cam_replay.h"
+#endif
+
+#if defined (CAPTURE_NODE_CAMERA)
+#include "cam_capture_node.h"
+#endif
+
 #if defined (MEADE_DSI)
 #include "cam_MeadeDSI.h"
 #endif
@@ -197,23 +211,67 @@ GuideCamera::GuideCamera(void)
     HasShutter = false;
     ShutterClosed = false;
     HasSubframes = false;
+    HasPipelinedCapture = false;
+    HasAsyncCompletion = false;
+    HasNativeStream = false;
     HasCooler = false;
     FullSize = UNDEFINED_FRAME_SIZE;
-    UseSubframes = pConfig->Profile.GetBoolean("/camera/UseSubframes", DefaultUseSubframes);
-    ReadDelay = pConfig->Profile.GetInt("/camera/ReadDelay", DefaultReadDelay);
-    GuideCameraGain = pConfig->Profile.GetInt("/camera/gain", DefaultGuideCameraGain);
-    m_timeoutMs = pConfig->Profile.GetInt("/camera/TimeoutMs", DefaultGuideCameraTimeoutMs);
-    m_pixelSize = GetProfilePixelSize();
     MaxBinning = 1;
-    Binning = pConfig->Profile.GetInt("/camera/binning", 1);
+    LoadSettings();
     CurrentDarkFrame = NULL;
     CurrentDefectMap = NULL;
+    m_preparedDark = NULL;
+    m_darkModel = new DarkModel();
+    for (int i = 0; i < NUM_CAPTURE_STAGES; i++)
+        m_captureMarks[i] = -1;
+    m_exposureThread = NULL;
+    m_exposureReady = false;
+    m_lastExposureStartUs = 0;
+    m_watchdogThread = NULL;
+    m_captureOverdue = false;
+    m_streamActive = false;
+    m_streamCapture = false;
 }
 
 GuideCamera::~GuideCamera(void)
 {
+    StopCaptureWatchdog();
     ClearDarks();
     ClearDefectMap();
+    delete m_darkModel;
+}
+
+void GuideCamera::LoadSettings(void)
+{
+    UseSubframes = pConfig->Profile.GetBoolean("/camera/UseSubframes", DefaultUseSubframes);
+    ReadDelay = pConfig->Profile.GetInt("/camera/ReadDelay", DefaultReadDelay);
+    GuideCameraGain = pConfig->Profile.GetInt("/camera/gain", DefaultGuideCameraGain);
+    m_timeoutMs = pConfig->Profile.GetInt("/camera/TimeoutMs", DefaultGuideCameraTimeoutMs);
+    m_maxFrameAgeMs = wxMax(0, pConfig->Profile.GetInt("/camera/MaxFrameAgeMs", DefaultMaxFrameAgeMs));
+    m_pixelSize = GetProfilePixelSize();
+    Binning = pConfig->Profile.GetInt("/camera/binning", 1);
+    SoftwareBinning = wxMax(1, wxMin(pConfig->Profile.GetInt("/camera/SoftwareBinning", 1), (int) MAX_SOFTWARE_BINNING));
+    SoftwareBinningSum = pConfig->Profile.GetBoolean("/camera/SoftwareBinningSum", false);
+    SoftwareBinningGreen = pConfig->Profile.GetInt("/camera/SoftwareBinningGreen", BAYER_GREEN_NONE);
+    if (SoftwareBinningGreen < BAYER_GREEN_NONE || SoftwareBinningGreen > BAYER_GREEN_DIAGONAL)
+        SoftwareBinningGreen = BAYER_GREEN_NONE;
+    StackFrames = wxMax(1, wxMin(pConfig->Profile.GetInt("/camera/StackFrames", 1), (int) MAX_STACK_FRAMES));
+    StackMaxShift = pConfig->Profile.GetDouble("/camera/StackMaxShift", 3.0);
+    m_useDarkModel = pConfig->Profile.GetBoolean("/camera/DarkModel", false);
+    m_interpolateDarks = pConfig->Profile.GetBoolean("/camera/DarkInterpolate", false);
+    m_darkMemoryMB = wxMax(0, pConfig->Profile.GetInt("/camera/DarkMemoryMB", DefaultDarkMemoryMB));
+    m_useCaptureWatchdog = pConfig->Profile.GetBoolean("/camera/CaptureWatchdog", true);
+}
+
+void GuideCamera::LoadProfileSettings(void)
+{
+    LoadSettings();
+
+    // the camera is already connected, so keep the binning within what it reported
+    if (Connected && Binning > MaxBinning)
+        Binning = MaxBinning;
+
+    Debug.Write(wxString::Format("camera: reloaded profile settings, binning = %u\n", (unsigned int) Binning));
 }
 
 static int CompareNoCase(const wxString& first, const wxString& second)
@@ -334,6 +392,12 @@ wxArrayString GuideCamera::List(void)
 #if defined (SIMULATOR)
     CameraList.Add(_T("Simulator"));
 #endif
+#if defined (REPLAY_CAMERA)
+    CameraList.Add(_T("FITS Replay"));
+#endif
+#if defined (CAPTURE_NODE_CAMERA)
+    CameraList.Add(_T("PHD2 Capture Node"));
+#endif
 
 #if defined (NEB_SBIG)
     CameraList.Add(_T("Guide chip on SBIG cam in Nebulosity"));
@@ -371,6 +435,16 @@ GuideCamera *GuideCamera::Factory(const wxString& choice)
         else if (choice.Find(_T("Simulator")) + 1) {
             pReturn = new Camera_SimClass();
         }
+#if defined (REPLAY_CAMERA)
+        else if (choice.Find(_T("FITS Replay")) + 1) {
+            pReturn = new Camera_ReplayClass();
+        }
+#endif
+#if defined (CAPTURE_NODE_CAMERA)
+        else if (choice.Find(_T("PHD2 Capture Node")) + 1) {
+            pReturn = new Camera_CaptureNodeClass();
+        }
+#endif
 #if defined (SAC42)
         else if (choice.Find(_T("SAC4-2")) + 1) {
             pReturn = new Camera_SAC42Class();
@@ -652,6 +726,20 @@ bool GuideCamera::SetBinning(int binning)
 {
     if (binning < 1)
         binning = 1;
+
+    if (HasSoftwareBinning())
+    {
+        if (binning > MAX_SOFTWARE_BINNING)
+            binning = MAX_SOFTWARE_BINNING;
+
+        Debug.Write(wxString::Format("camera: set software binning = %u\n", (unsigned int) binning));
+
+        SoftwareBinning = binning;
+        pConfig->Profile.SetInt("/camera/SoftwareBinning", binning);
+
+        return false;
+    }
+
     if (binning > MaxBinning)
         binning = MaxBinning;
 
@@ -663,6 +751,15 @@ bool GuideCamera::SetBinning(int binning)
     return false;
 }
 
+void GuideCamera::SetStackFrames(int frames)
+{
+    StackFrames = wxMax(1, wxMin(frames, (int) MAX_STACK_FRAMES));
+
+    Debug.Write(wxString::Format("camera: set stack frames = %d\n", StackFrames));
+
+    pConfig->Profile.SetInt("/camera/StackFrames", StackFrames);
+}
+
 void GuideCamera::SetTimeoutMs(int ms)
 {
     static const int MIN_TIMEOUT_MS = 5000;
@@ -672,6 +769,20 @@ void GuideCamera::SetTimeoutMs(int ms)
     pConfig->Profile.SetInt("/camera/TimeoutMs", m_timeoutMs);
 }
 
+void GuideCamera::SetMaxFrameAgeMs(int ms)
+{
+    m_maxFrameAgeMs = wxMax(ms, 0);
+
+    pConfig->Profile.SetInt("/camera/MaxFrameAgeMs", m_maxFrameAgeMs);
+}
+
+void GuideCamera::SetUseCaptureWatchdog(bool enable)
+{
+    m_useCaptureWatchdog = enable;
+
+    pConfig->Profile.SetBoolean("/camera/CaptureWatchdog", m_useCaptureWatchdog);
+}
+
 bool GuideCamera::SetCameraPixelSize(double pixel_size)
 {
     bool bError = false;
@@ -752,12 +863,15 @@ CameraConfigDialogPane::CameraConfigDialogPane(wxWindow *pParent, GuideCamera *p
 void CameraConfigDialogPane::LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap& CtrlMap)
 {
     wxStaticBoxSizer *pGenGroup = new wxStaticBoxSizer(wxVERTICAL, m_pParent, _("General Properties"));
-    wxFlexGridSizer *pTopline = new wxFlexGridSizer(1, 3, 10, 10);
+    wxFlexGridSizer *pTopline = new wxFlexGridSizer(1, 4, 10, 10);
     // Generic controls
     wxSizerFlags def_flags = wxSizerFlags(0).Border(wxALL, 10).Expand();
     pTopline->Add(GetSizerCtrl(CtrlMap, AD_szNoiseReduction));
     pTopline->Add(GetSizerCtrl(CtrlMap, AD_szTimeLapse), wxSizerFlags(0).Border(wxLEFT, 110).Expand());
+    pTopline->Add(GetSizerCtrl(CtrlMap, AD_szCadence), wxSizerFlags(0).Border(wxLEFT, 40).Expand());
     pGenGroup->Add(pTopline, def_flags);
+    pGenGroup->Add(GetSingleCtrl(CtrlMap, AD_cbPipelinedCapture), wxSizerFlags(0).Border(wxLEFT | wxRIGHT, 10));
+    pGenGroup->Add(GetSingleCtrl(CtrlMap, AD_cbLazyROI), wxSizerFlags(0).Border(wxLEFT | wxRIGHT | wxTOP, 10));
     pGenGroup->Add(GetSizerCtrl(CtrlMap, AD_szAutoExposure), def_flags);
     pGenGroup->Layout();
 
@@ -765,11 +879,11 @@ void CameraConfigDialogPane::LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap
     wxStaticBoxSizer *pSpecGroup = new wxStaticBoxSizer(wxVERTICAL, m_pParent, _("Camera-specific Properties"));
     if (pCamera)
     {
-        int numItems = 2;
+        int numItems = 3;
         if (pCamera->HasGainControl) ++numItems;
         if (pCamera->HasDelayParam)  ++numItems;
         if (pCamera->HasPortNum)     ++numItems;
-        if (pCamera->MaxBinning > 1) ++numItems;
+        if (pCamera->MaxEffectiveBinning() > 1) ++numItems;
         if (pCamera->HasCooler)      ++numItems;
         wxFlexGridSizer *pDetailsSizer = new wxFlexGridSizer((numItems + 1) / 2, 3, 15, 15);
 
@@ -778,11 +892,12 @@ void CameraConfigDialogPane::LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap
         if (pCamera->HasGainControl)
             pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_szGain));
         pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_szCameraTimeout));
+        pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_szStackFrames));
         if (pCamera->HasDelayParam)
             pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_szDelay));
         if (pCamera->HasPortNum)
             pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_szPort));
-        if (pCamera->MaxBinning > 1)
+        if (pCamera->MaxEffectiveBinning() > 1)
             pDetailsSizer->Add(GetSizerCtrl(CtrlMap, AD_binning));
         if (pCamera->HasSubframes)
             pDetailsSizer->Add(GetSingleCtrl(CtrlMap, AD_cbUseSubFrames));
@@ -839,14 +954,26 @@ CameraConfigDialogCtrlSet::CameraConfigDialogCtrlSet(wxWindow *pParent, GuideCam
 
     // Binning
     m_binning = 0;
-    if (m_pCamera->MaxBinning > 1)
+    if (m_pCamera->MaxEffectiveBinning() > 1)
     {
         wxArrayString opts;
         m_pCamera->GetBinningOpts(&opts);
         int width = StringArrayWidth(opts);
         m_binning = new wxChoice(GetParentWindow(AD_binning), wxID_ANY, wxPoint(-1, -1),
             wxSize(width + 35, -1), opts);
-        AddLabeledCtrl(CtrlMap, AD_binning, _("Binning"), m_binning, _("Camera pixel binning"));
+        AddLabeledCtrl(CtrlMap, AD_binning, _("Binning"), m_binning,
+            m_pCamera->HasSoftwareBinning() ?
+                _("Camera pixel binning. This camera cannot bin, so PHD2 bins each frame after it is downloaded.") :
+                _("Camera pixel binning"));
+    }
+
+    // Frame stacking
+    {
+        int width = StringWidth(_T("00")) + 30;
+        m_stackFrames = NewSpinnerInt(GetParentWindow(AD_szStackFrames), width, 1, 1, GuideCamera::MAX_STACK_FRAMES, 1);
+        AddLabeledCtrl(CtrlMap, AD_szStackFrames, _("Stack frames"), m_stackFrames,
+            _("Number of short sub-exposures summed into each guide frame, default = 1 (no stacking). "
+            "The exposure duration is divided among the sub-exposures, and stacking stops early if the guide star moves."));
     }
 
     // Delay parameter
@@ -910,13 +1037,14 @@ void CameraConfigDialogCtrlSet::LoadValues()
 
     if (m_binning)
     {
-        int idx = m_pCamera->Binning - 1;
+        int idx = m_pCamera->EffectiveBinning() - 1;
         m_binning->Select(idx);
         // don't allow binning change when calibrating or guiding
         m_binning->Enable(!pFrame->pGuider || !pFrame->pGuider->IsCalibratingOrGuiding());
     }
 
     m_timeoutVal->SetValue(m_pCamera->GetTimeoutMs() / 1000);
+    m_stackFrames->SetValue(m_pCamera->StackFrames);
 
     if (m_pCamera->HasDelayParam)
     {
@@ -1051,6 +1179,7 @@ void CameraConfigDialogCtrlSet::UnloadValues()
     }
 
     m_pCamera->SetTimeoutMs(m_timeoutVal->GetValue() * 1000);
+    m_pCamera->SetStackFrames(m_stackFrames->GetValue());
 
     if (m_pCamera->HasDelayParam)
     {
@@ -1127,6 +1256,22 @@ void GuideCamera::GetBinningOpts(int maxBin, wxArrayString *opts)
         opts->Add(wxString::Format("%d", i));
 }
 
+bool GuideCamera::LoadDriverDll(const char *dllName, wxString *err)
+{
+#ifdef __WINDOWS__
+    // resolves every delay-loaded import of the DLL now, so a missing or
+    // incompatible driver is reported here instead of faulting on first use
+    HRESULT hr = __HrLoadAllImportsForDll(dllName);
+    if (FAILED(hr))
+    {
+        Debug.Write(wxString::Format("LoadDriverDll: %s failed, hr = 0x%x\n", dllName, hr));
+        *err = wxString::Format(_("Could not load the camera driver %s. Please reinstall the camera driver."), dllName);
+        return false;
+    }
+#endif
+    return true;
+}
+
 wxString GuideCamera::GetSettingsSummary()
 {
     int darkDur;
@@ -1143,11 +1288,15 @@ wxString GuideCamera::GetSettingsSummary()
     else
         pixelSizeStr = wxString::Format(_("%0.1f um"), m_pixelSize);
 
-    return wxString::Format("Camera = %s, gain = %d%s%s, full size = %d x %d, %s, %s, pixel size = %s\n",
+    return wxString::Format("Camera = %s, gain = %d%s%s, full size = %d x %d%s, %s, %s, pixel size = %s\n",
                             Name, GuideCameraGain,
                             HasDelayParam ? wxString::Format(", delay = %d", ReadDelay) : "",
                             HasPortNum ? wxString::Format(", port = 0x%hx", Port) : "",
                             FullSize.GetWidth(), FullSize.GetHeight(),
+                            HasSoftwareBinning() && SoftwareBinning > 1 ?
+                                wxString::Format(", software binning = %u%s", (unsigned int) SoftwareBinning,
+                                                 SoftwareBinning == 2 && SoftwareBinningGreen != BAYER_GREEN_NONE ? " (green)" :
+                                                 SoftwareBinningSum ? " (sum)" : "") : "",
                             darkDur ? wxString::Format("have dark, dark dur = %d", darkDur) : "no dark",
                             (CurrentDefectMap) ? "defect map in use" : "no defect map",
                             pixelSizeStr);
@@ -1157,6 +1306,9 @@ void GuideCamera::AddDark(usImage *dark)
 {
     int const expdur = dark->ImgExpDur;
 
+    // the interpolation thread may be reading the dark about to be freed
+    m_darkModel->Cancel();
+
     { // lock scope
         wxCriticalSectionLocker lck(DarkFrameLock);
 
@@ -1173,22 +1325,134 @@ void GuideCamera::AddDark(usImage *dark)
     } // lock scope
 
     Darks[expdur] = dark;
+    m_darkModel->Invalidate();
+
+    if (dark == CurrentDarkFrame)
+        PrepareCurrentDark();
 }
 
 void GuideCamera::SelectDark(int exposureDuration)
 {
     // select the dark frame with the smallest exposure >= the requested exposure.
-    // if there are no darks with exposures > the select exposure, select the dark with the greatest exposure
+    // if there are no darks with exposures > the select exposure, select the dark with the greatest exposure.
+    // With the dark model, an exposure missing from the library gets a synthesized dark instead.
+    // With interpolation, an exposure between two library darks gets a dark interpolated from
+    // the two; it is interpolated in the background, and selected when MyFrame calls again.
 
-    wxCriticalSectionLocker lck(DarkFrameLock);
+    usImage *prev = CurrentDarkFrame;
+
+    // the model is only used in the main thread, no lock is needed to synthesize
+    usImage *synth = NULL;
+    if (Darks.find(exposureDuration) == Darks.end())
+    {
+        bool bracketed = false;
+        if (m_interpolateDarks)
+            synth = m_darkModel->GetInterpolatedDark(Darks, exposureDuration, &bracketed);
+        if (m_useDarkModel && !bracketed)
+            synth = m_darkModel->GetDark(Darks, exposureDuration);
+    }
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+
+        CurrentDarkFrame = synth;
+        for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end() && !synth; ++it)
+        {
+            CurrentDarkFrame = it->second;
+            if (it->first >= exposureDuration)
+                break;
+        }
+
+        m_darkModel->Trim(CurrentDarkFrame);
+    } // lock scope
+
+    if (CurrentDarkFrame != prev || (CurrentDarkFrame && !m_preparedDark))
+        PrepareCurrentDark();
+
+    TrimDarkResidency();
+}
+
+static double ExposureDistance(int a, int b)
+{
+    return fabs(log((double) wxMax(a, 1) / (double) wxMax(b, 1)));
+}
+
+// Of the darks mapped from the library cache, keep those nearest in exposure
+// to the one in use, up to the dark memory limit, and page out the rest; they
+// are paged in again from the cache when next selected. The dark in use and
+// the next ones above and below it, which interpolation needs, are always
+// kept. Darks on the heap cannot be paged out, but count against the limit.
+void GuideCamera::TrimDarkResidency(void)
+{
+    if (m_darkMemoryMB <= 0 || Darks.empty())
+        return;
 
-    CurrentDarkFrame = 0;
+    int const exposure = CurrentDarkFrame ? CurrentDarkFrame->ImgExpDur : Darks.begin()->first;
+
+    std::vector<std::pair<double, const usImage *> > byDistance;
     for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
+        byDistance.push_back(std::make_pair(ExposureDistance(it->first, exposure), it->second));
+    std::sort(byDistance.begin(), byDistance.end());
+
+    ExposureImgMap::const_iterator above = Darks.lower_bound(exposure);
+    const usImage *below = above != Darks.begin() ? (--ExposureImgMap::const_iterator(above))->second : NULL;
+    const usImage *atOrAbove = above != Darks.end() ? above->second : NULL;
+
+    double const limit = m_darkMemoryMB * 1024.0 * 1024.0;
+    double resident = 0.0;
+    int paged = 0;
+    for (size_t i = 0; i < byDistance.size(); i++)
     {
-        CurrentDarkFrame = it->second;
-        if (it->first >= exposureDuration)
-            break;
+        const usImage *dark = byDistance[i].second;
+        double const bytes = (double) dark->NPixels * sizeof(unsigned short);
+        bool const keep = dark == CurrentDarkFrame || dark == below || dark == atOrAbove ||
+            !DarkLibCache::IsMapped(*dark) || resident + bytes <= limit;
+        if (keep)
+            resident += bytes;
+        else
+        {
+            DarkLibCache::Evict(*dark);
+            ++paged;
+        }
+    }
+
+    if (paged)
+        Debug.Write(wxString::Format("Dark library: %d darks paged out, %.0f MB kept for exposure %d\n",
+                                     paged, resident / (1024.0 * 1024.0), exposure));
+}
+
+bool GuideCamera::DarksExceedMemoryLimit(void) const
+{
+    if (m_darkMemoryMB <= 0)
+        return false;
+
+    double bytes = 0.0;
+    for (ExposureImgMap::const_iterator it = Darks.begin(); it != Darks.end(); ++it)
+    {
+        if (!DarkLibCache::IsMapped(*it->second))
+            bytes += (double) it->second->NPixels * sizeof(unsigned short);
     }
+    return bytes > m_darkMemoryMB * 1024.0 * 1024.0;
+}
+
+void GuideCamera::PrepareCurrentDark(void)
+{
+    // Darks and CurrentDarkFrame are only modified in the main thread, so the
+    // dark can be prepared without holding DarkFrameLock; the lock is only
+    // needed to swap in the result
+    assert(wxThread::IsMain());
+
+    PreparedDark *prepared = CurrentDarkFrame ? new PreparedDark(*CurrentDarkFrame) : NULL;
+    PreparedDark *prev;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+        prev = m_preparedDark;
+        m_preparedDark = prepared;
+    } // lock scope
+
+    if (prev)
+        prev->Release();
 }
 
 void GuideCamera::GetDarklibProperties(int *pNumDarks, double *pMinExp, double *pMaxExp)
@@ -1229,6 +1493,10 @@ void GuideCamera::ClearDefectMap()
 
 void GuideCamera::SetDefectMap(DefectMap *defectMap)
 {
+    // build the repair tables now rather than on the first frame
+    if (defectMap && DarkFrameSize() != UNDEFINED_FRAME_SIZE)
+        defectMap->PrepareRepairs(DarkFrameSize());
+
     wxCriticalSectionLocker lck(DarkFrameLock);
     delete CurrentDefectMap;
     CurrentDefectMap = defectMap;
@@ -1236,35 +1504,167 @@ void GuideCamera::SetDefectMap(DefectMap *defectMap)
 
 void GuideCamera::ClearDarks()
 {
+    std::vector<usImage *> frames;
+    DetachDarks(&frames);
+    for (std::vector<usImage *>::iterator it = frames.begin(); it != frames.end(); ++it)
+        delete *it;
+}
+
+// clears the darks like ClearDarks, but hands the dark frames over to the
+// caller to free
+void GuideCamera::DetachDarks(std::vector<usImage *> *frames)
+{
+    m_darkModel->Cancel();
+
     wxCriticalSectionLocker lck(DarkFrameLock);
-    while (!Darks.empty())
+    for (ExposureImgMap::iterator it = Darks.begin(); it != Darks.end(); ++it)
+        frames->push_back(it->second);
+    Darks.clear();
+    CurrentDarkFrame = NULL;
+    m_darkModel->Clear();
+    if (m_preparedDark)
     {
-        ExposureImgMap::iterator it = Darks.begin();
-        delete it->second;
-        Darks.erase(it);
+        m_preparedDark->Release();
+        m_preparedDark = NULL;
     }
-    CurrentDarkFrame = NULL;
 }
 
 void GuideCamera::SubtractDark(usImage& img)
 {
-    // dark subtraction is done in the camera worker thread, so we need to acquire the
-    // DarkFrameLock to protect against the dark frame disappearing when the main
-    // thread does "Load Darks" or "Clear Darks"
+    PERF_STAGE(PERF_STAGE_DARK);
 
-    wxCriticalSectionLocker lck(DarkFrameLock);
+    // In lazy ROI mode a full frame is only calibrated around the guide star
+    // for now; the rest is done by WorkerThread::CompleteLazyROI if the frame
+    // is ever needed in full
 
-    if (CurrentDefectMap)
+    if (img.Subframe.IsEmpty() && !img.LazyROI.IsEmpty())
+    {
+        img.LazyROI.Intersect(wxRect(img.Size));
+        if (!img.LazyROI.IsEmpty())
+        {
+            img.Subframe = img.LazyROI;
+            ApplyDark(img);
+            img.Subframe = wxRect(0, 0, 0, 0);
+            img.LazyDark = true;
+            return;
+        }
+    }
+
+    ApplyDark(img);
+}
+
+void GuideCamera::SubtractDark(usImage& img, const unsigned char *raw)
+{
+    // For cameras that deliver 8-bit pixels: img has been sized for the frame
+    // and raw holds its pixels in the same layout, possibly in the upper half
+    // of img's own buffer. A full frame with a prepared dark is widened and
+    // dark subtracted in one pass; otherwise it is widened and then handled
+    // like any other frame.
+
+    if (img.Subframe.IsEmpty() && img.LazyROI.IsEmpty())
     {
-        RemoveDefects(img, *CurrentDefectMap);
+        PreparedDark *dark = NULL;
+
+        { // lock scope
+            wxCriticalSectionLocker lck(DarkFrameLock);
+            if (!CurrentDefectMap && m_preparedDark)
+            {
+                dark = m_preparedDark;
+                dark->AddRef();
+            }
+        } // lock scope
+
+        if (dark)
+        {
+            bool err = dark->Subtract(img, raw);
+            dark->Release();
+            if (!err)
+                return;
+        }
     }
-    else if (CurrentDarkFrame)
+
+    WidenPixels(img.ImageData, raw, img.NPixels);
+    SubtractDark(img);
+}
+
+void GuideCamera::ApplyDark(usImage& img)
+{
+    // dark subtraction is done in the camera worker thread, so we need to acquire the
+    // DarkFrameLock to protect against the dark frame disappearing when the main
+    // thread does "Load Darks" or "Clear Darks". The prepared dark is reference
+    // counted, so the lock is only held long enough to pin it.
+
+    PreparedDark *dark = NULL;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+
+        if (CurrentDefectMap)
+        {
+            RemoveDefects(img, *CurrentDefectMap);
+            return;
+        }
+
+        if (m_preparedDark)
+        {
+            dark = m_preparedDark;
+            dark->AddRef();
+        }
+        else if (CurrentDarkFrame)
+        {
+            Subtract(img, *CurrentDarkFrame);
+        }
+    } // lock scope
+
+    if (dark)
     {
-        Subtract(img, *CurrentDarkFrame);
+        dark->Subtract(img);
+        dark->Release();
     }
 }
 
-static void InitiateReconnect()
+// Calibrates a full frame that was captured without CAPTURE_SUBTRACT_DARK:
+// dark subtraction, noise reduction and, if stats is set, the image stats in
+// a single pass. A defect map is applied in place first and the rest of the
+// frame is then only filtered. Returns true, with the dark already applied,
+// if the frame could not be handled in one pass and the caller has to do the
+// noise reduction and stats itself.
+bool GuideCamera::CalibrateFrame(usImage& img, int noiseReduction, bool stats)
+{
+    PERF_STAGE(PERF_STAGE_DARK);
+
+    PreparedDark *dark = NULL;
+
+    { // lock scope
+        wxCriticalSectionLocker lck(DarkFrameLock);
+
+        if (CurrentDefectMap)
+            RemoveDefects(img, *CurrentDefectMap);
+        else if (m_preparedDark)
+        {
+            dark = m_preparedDark;
+            dark->AddRef();
+        }
+        else if (CurrentDarkFrame)
+        {
+            // not prepared yet, this frame gets the old treatment
+            Subtract(img, *CurrentDarkFrame);
+            return true;
+        }
+    } // lock scope
+
+    bool err = ::CalibrateFrame(img, dark, noiseReduction, stats);
+
+    if (err && dark)
+        dark->Subtract(img);
+
+    if (dark)
+        dark->Release();
+
+    return err;
+}
+
+static void InitiateReconnect(bool quick = false)
 {
     WorkerThread *thr = WorkerThread::This();
     if (thr)
@@ -1273,7 +1673,7 @@ static void InitiateReconnect()
         // the camera re-connecttion attempt
         thr->SetSkipExposeComplete();
     }
-    pFrame->TryReconnect();
+    pFrame->TryReconnect(quick);
 }
 
 void GuideCamera::DisconnectWithAlert(CaptureFailType type)
@@ -1285,6 +1685,18 @@ void GuideCamera::DisconnectWithAlert(CaptureFailType type)
         break;
 
     case CAPT_FAIL_TIMEOUT:
+        if (m_captureOverdue)
+        {
+            // the capture watchdog gave up on the capture; the quick
+            // reconnect keeps the guiding state, so there is no alert unless
+            // it fails
+            Debug.Write("camera: reconnecting after an overdue capture\n");
+            Disconnect();
+            pFrame->UpdateStateLabels();
+            pFrame->StatusMsg(_("Camera not responding, reconnecting"));
+            InitiateReconnect(true);
+        }
+        else
         {
             wxString msg(wxString::Format(_("After %.1f sec the camera has not completed a %.1f sec exposure, so "
                 "it has been disconnected to prevent other problems. "
@@ -1320,12 +1732,737 @@ void GuideCamera::InitCapture()
 {
 }
 
+void CaptureLatency::Reset()
+{
+    memset(bins, 0, sizeof(bins));
+    count = 0;
+    lastMs = maxMs = totalMs = 0.0;
+}
+
+void CaptureLatency::Add(double ms)
+{
+    if (ms < 0.0)
+        ms = 0.0;
+    int bin = (int) floor(BINS_PER_OCTAVE * log(ms + 1.0) / log(2.0));
+    if (bin >= NUM_BINS)
+        bin = NUM_BINS - 1;
+    ++bins[bin];
+    ++count;
+    lastMs = ms;
+    if (ms > maxMs)
+        maxMs = ms;
+    totalMs += ms;
+}
+
+double CaptureLatency::PercentileMs(double pct) const
+{
+    if (!count)
+        return 0.0;
+    unsigned int const rank = (unsigned int) ceil(pct / 100.0 * count);
+    unsigned int n = 0;
+    for (int i = 0; i < NUM_BINS; i++)
+    {
+        n += bins[i];
+        if (n >= rank)
+            return wxMin(pow(2.0, (double)(i + 1) / BINS_PER_OCTAVE) - 1.0, maxMs);
+    }
+    return maxMs;
+}
+
+void GuideCamera::MarkCapture(CaptureStage stage)
+{
+    m_captureMarks[stage] = m_captureClock.TimeInMicro();
+}
+
+void GuideCamera::CaptureComplete(void)
+{
+    // called in the thread that processed the frame once processing is done
+
+    MarkCapture(CAPTURE_STAGE_PROCESSED);
+
+    const wxLongLong *t = m_captureMarks;
+    wxCriticalSectionLocker lck(m_timingLock);
+
+#define INTERVAL(stat, a, b) \
+    if (t[a] >= 0 && t[b] >= t[a]) \
+        m_timing.stat.Add((t[b] - t[a]).ToDouble() / 1000.0)
+
+    INTERVAL(exposure, CAPTURE_STAGE_START, CAPTURE_STAGE_EXPOSED);
+    INTERVAL(readout, CAPTURE_STAGE_EXPOSED, CAPTURE_STAGE_READOUT);
+    INTERVAL(transfer, CAPTURE_STAGE_READOUT, CAPTURE_STAGE_DATA);
+    INTERVAL(acquire, CAPTURE_STAGE_START, CAPTURE_STAGE_DATA);
+    INTERVAL(processing, CAPTURE_STAGE_DATA, CAPTURE_STAGE_PROCESSED);
+    INTERVAL(total, CAPTURE_STAGE_START, CAPTURE_STAGE_PROCESSED);
+
+#undef INTERVAL
+
+    for (int i = 0; i < NUM_CAPTURE_STAGES; i++)
+        m_captureMarks[i] = -1;
+}
+
+CaptureTimingStats GuideCamera::GetCaptureTiming(void)
+{
+    wxCriticalSectionLocker lck(m_timingLock);
+    return m_timing;
+}
+
+void GuideCamera::ResetCaptureTiming(void)
+{
+    wxCriticalSectionLocker lck(m_timingLock);
+    m_timing = CaptureTimingStats();
+}
+
+static wxString CaptureLatencyStr(const CaptureLatency& lat)
+{
+    return wxString::Format("n=%u mean=%.1f p50=%.0f p95=%.0f max=%.0f", lat.count, lat.MeanMs(),
+        lat.PercentileMs(50.0), lat.PercentileMs(95.0), lat.maxMs);
+}
+
+void GuideCamera::LogCaptureTiming(void)
+{
+    CaptureTimingStats st = GetCaptureTiming();
+
+    if (!st.total.count)
+        return;
+
+    Debug.Write(wxString::Format("%s capture timing (ms, %s completion): exposure %s, readout %s, transfer %s, acquire %s, processing %s, total %s, overhead %s\n",
+        Name, HasAsyncCompletion ? "event" : "polled", CaptureLatencyStr(st.exposure), CaptureLatencyStr(st.readout), CaptureLatencyStr(st.transfer),
+        CaptureLatencyStr(st.acquire), CaptureLatencyStr(st.processing), CaptureLatencyStr(st.total), CaptureLatencyStr(st.overhead)));
+}
+
+ExposurePoller::ExposurePoller(int duration)
+    : m_due(duration),
+      m_interval(1),
+      m_maxInterval(wxMax(2, wxMin(duration / 10, PowerSaver::PollIntervalMs(MAX_INTERVAL))))
+{
+}
+
+unsigned int ExposurePoller::WaitUntilDue(void)
+{
+    // wake a little early, the readout may be quicker than the clocks agree
+    int const lead = wxMin(m_due / 20, 10);
+    return WorkerThread::MilliSleep(m_due - lead - m_clock.Time(), WorkerThread::INT_ANY);
+}
+
+unsigned int ExposurePoller::Wait(void)
+{
+    int const remaining = m_due - m_clock.Time();
+    if (remaining > m_maxInterval)
+        return WorkerThread::MilliSleep(remaining - m_maxInterval, WorkerThread::INT_ANY);
+
+    unsigned int val = WorkerThread::MilliSleep(m_interval, WorkerThread::INT_ANY);
+    m_interval = wxMin(m_interval * 2, m_maxInterval);
+    return val;
+}
+
+SensorRoi::SensorRoi(int posAlign, int sizeAlign, ReconfigureCost cost)
+    : m_posAlign(wxMax(posAlign, 1)),
+      m_sizeAlign(wxMax(sizeAlign, 1)),
+      m_cost(cost)
+{
+}
+
+static int align_down(int v, int m)
+{
+    return v - v % m;
+}
+
+static int align_up(int v, int m)
+{
+    return align_down(v + m - 1, m);
+}
+
+// Position along one axis of a region of length len holding the subframe
+// span [begin, begin + sublen), as near centered on the span as alignment and
+// the sensor edges allow. Returns false if no aligned position holds it.
+static bool place_roi(int begin, int sublen, int len, int sensorLen, int align, int *pos)
+{
+    int const lo = wxMax(0, begin + sublen - len);
+    int const hi = wxMin(begin, sensorLen - len);
+
+    int p = align_down(wxMax(lo, wxMin(begin - (len - sublen) / 2, hi)), align);
+    if (p < lo)
+        p += align;
+
+    *pos = p;
+    return p <= hi;
+}
+
+bool SensorRoi::Negotiate(const wxRect& subframe, const wxSize& sensor, wxRect *roi)
+{
+    if (sensor != m_sensor)
+    {
+        m_sensor = sensor;
+        m_roi = wxRect();
+    }
+
+    if (subframe.IsEmpty() || !wxRect(sensor).Contains(subframe))
+    {
+        m_roi = wxRect();
+        return false;
+    }
+
+    bool const costly = m_cost == RECONFIGURE_COSTLY;
+
+    if (costly && !m_roi.IsEmpty() && m_roi.Contains(subframe))
+    {
+        *roi = m_roi;
+        return true;
+    }
+
+    // the extra m_posAlign - 1 lets the region be aligned down and still
+    // hold the subframe
+    int const minW = align_up(subframe.GetWidth() + m_posAlign - 1, m_sizeAlign);
+    int const minH = align_up(subframe.GetHeight() + m_posAlign - 1, m_sizeAlign);
+
+    // room for the star to drift before the region has to be reprogrammed
+    int const margin = costly ? wxMax(wxMax(subframe.GetWidth(), subframe.GetHeight()) / 4, m_posAlign) : 0;
+    int w = align_up(subframe.GetWidth() + 2 * margin + m_posAlign - 1, m_sizeAlign);
+    int h = align_up(subframe.GetHeight() + 2 * margin + m_posAlign - 1, m_sizeAlign);
+
+    // a region that still fits the subframe is moved rather than resized
+    // unless it has become much larger than needed
+    if (costly && !m_roi.IsEmpty() && m_roi.GetWidth() >= minW && m_roi.GetHeight() >= minH &&
+        (double) m_roi.GetWidth() * m_roi.GetHeight() <= 2.0 * w * h)
+    {
+        w = m_roi.GetWidth();
+        h = m_roi.GetHeight();
+    }
+
+    // near the sensor size give up the drift margin before the subframe
+    w = wxMin(w, align_down(sensor.GetWidth(), m_sizeAlign));
+    h = wxMin(h, align_down(sensor.GetHeight(), m_sizeAlign));
+
+    wxRect r(0, 0, w, h);
+    if (w < minW || h < minH ||
+        !place_roi(subframe.GetLeft(), subframe.GetWidth(), w, sensor.GetWidth(), m_posAlign, &r.x) ||
+        !place_roi(subframe.GetTop(), subframe.GetHeight(), h, sensor.GetHeight(), m_posAlign, &r.y))
+    {
+        m_roi = wxRect();
+        return false;
+    }
+
+    m_roi = r;
+    *roi = r;
+    return true;
+}
+
+void GuideCamera::BeginExposureWait(void)
+{
+    wxCriticalSectionLocker lck(m_exposureLock);
+    m_exposureReady = false;
+    m_exposureThread = WorkerThread::This();
+    if (m_exposureThread)
+        m_exposureThread->ClearWake();
+}
+
+void GuideCamera::ExposureReady(void)
+{
+    wxCriticalSectionLocker lck(m_exposureLock);
+    m_exposureReady = true;
+    if (m_exposureThread)
+        m_exposureThread->Wake();
+}
+
+GuideCamera::ExposureWaitResult GuideCamera::WaitForExposure(int timeoutMs)
+{
+    wxStopWatch swatch;
+
+    while (true)
+    {
+        { // lock scope
+            wxCriticalSectionLocker lck(m_exposureLock);
+            if (m_exposureReady)
+            {
+                m_exposureReady = false;
+                return EXPOSURE_READY;
+            }
+        } // lock scope
+
+        if (m_captureOverdue)
+            return EXPOSURE_TIMEOUT;
+
+        long const remaining = timeoutMs - swatch.Time();
+        if (remaining <= 0)
+            return EXPOSURE_TIMEOUT;
+
+        // a wakeup may be left over from a frame consumed above; the ready
+        // flag is checked again either way
+        if (WorkerThread::WaitForWake(remaining, WorkerThread::INT_ANY))
+            return EXPOSURE_INTERRUPTED;
+    }
+}
+
+// Watches one capture at a time: Arm sets the time the capture should be
+// done by, Disarm clears it, and if the time passes first the camera is told
+// that the capture is overdue. The thread waits on a condition in between,
+// so it costs nothing while captures finish on time.
+class CaptureWatchdogThread : public wxThread
+{
+    GuideCamera *m_camera;
+    wxMutex m_lock;
+    wxCondition m_cond;     // on m_lock
+    bool m_armed;
+    bool m_firing;          // the camera is being told about an overdue capture
+    bool m_stop;
+    wxLongLong m_deadline;  // UTC ms
+
+public:
+    CaptureWatchdogThread(GuideCamera *camera)
+        : wxThread(wxTHREAD_JOINABLE), m_camera(camera), m_cond(m_lock), m_armed(false), m_firing(false), m_stop(false) { }
+
+    void Arm(int timeoutMs);
+    void Disarm(void);
+    void Stop(void);
+
+protected:
+    ExitCode Entry();
+};
+
+void CaptureWatchdogThread::Arm(int timeoutMs)
+{
+    wxMutexLocker lck(m_lock);
+    m_deadline = ::wxGetUTCTimeMillis() + timeoutMs;
+    m_armed = true;
+    m_cond.Broadcast();
+}
+
+// waits for the camera to be told about an overdue capture, if it is being
+// told, so it can not be told after the capture is over
+void CaptureWatchdogThread::Disarm(void)
+{
+    wxMutexLocker lck(m_lock);
+    while (m_firing)
+        m_cond.Wait();
+    m_armed = false;
+}
+
+void CaptureWatchdogThread::Stop(void)
+{
+    wxMutexLocker lck(m_lock);
+    m_stop = true;
+    m_cond.Broadcast();
+}
+
+wxThread::ExitCode CaptureWatchdogThread::Entry()
+{
+    PerfTrace::SetThreadName("capture watchdog");
+
+#if defined(__WINDOWS__)
+    // the driver's abort may be a COM call
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("capture watchdog thread CoInitializeEx returns %x\n", hr));
+#endif
+
+    {
+        wxMutexLocker lck(m_lock);
+        while (!m_stop)
+        {
+            if (!m_armed)
+            {
+                m_cond.Wait();
+                continue;
+            }
+
+            long const remaining = (m_deadline - ::wxGetUTCTimeMillis()).ToLong();
+            if (remaining > 0)
+            {
+                m_cond.WaitTimeout(remaining);
+                continue;
+            }
+
+            m_armed = false;
+            m_firing = true;
+            m_lock.Unlock();
+            m_camera->OnCaptureOverdue();
+            m_lock.Lock();
+            m_firing = false;
+            m_cond.Broadcast();
+        }
+    }
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    return 0;
+}
+
+bool GuideCamera::StartCaptureWatchdog(void)
+{
+    if (m_watchdogThread)
+        return true;
+
+    CaptureWatchdogThread *thread = new CaptureWatchdogThread(this);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.Write("camera: could not start the capture watchdog thread\n");
+        delete thread;
+        m_useCaptureWatchdog = false;
+        return false;
+    }
+
+    m_watchdogThread = thread;
+    return true;
+}
+
+void GuideCamera::StopCaptureWatchdog(void)
+{
+    if (!m_watchdogThread)
+        return;
+
+    m_watchdogThread->Stop();
+    m_watchdogThread->Wait();
+    delete m_watchdogThread;
+    m_watchdogThread = NULL;
+}
+
+// The longest a capture of this duration should take: the exposure, twice the
+// 95th percentile of the overhead beyond the exposure measured so far, and a
+// margin for jitter. 0 until enough captures have been measured, or if the
+// driver's own timeout comes first.
+int GuideCamera::CaptureDeadlineMs(int duration)
+{
+    enum { MIN_CAPTURES = 5, MIN_MARGIN_MS = 3000 };
+
+    double overheadMs;
+    { // lock scope
+        wxCriticalSectionLocker lck(m_timingLock);
+        if (m_timing.overhead.count < MIN_CAPTURES)
+            return 0;
+        overheadMs = m_timing.overhead.PercentileMs(95.0);
+    } // lock scope
+
+    int const deadline = duration + (int) (2.0 * overheadMs) + wxMax((int) MIN_MARGIN_MS, duration / 2);
+
+    return deadline < duration + m_timeoutMs ? deadline : 0;
+}
+
+// called on the watchdog thread
+void GuideCamera::OnCaptureOverdue(void)
+{
+    Debug.Write("camera: capture watchdog, the capture is overdue\n");
+
+    // the abort comes first so the driver can not be disconnected under it
+    bool aborted = AbortOverdueExposure();
+    Debug.Write(wxString::Format("camera: overdue exposure %s\n", aborted ? "aborted" : "left to the driver"));
+
+    m_captureOverdue = true;
+
+    // end a wait for the driver's frame ready event
+    wxCriticalSectionLocker lck(m_exposureLock);
+    if (m_exposureThread)
+        m_exposureThread->Wake();
+}
+
+bool CameraWatchdog::Expired(void) const
+{
+    return Watchdog::Expired() || (pCamera && pCamera->CaptureOverdue());
+}
+
+// A frame the driver timed is dropped, and the next one taken, if it is
+// stale: delivered again, finished before it was asked for, or older than
+// the age limit by the time it arrived. After a few stale frames in a row
+// the last one is used anyway so that guiding does not stall.
 bool GuideCamera::Capture(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe)
+{
+    PERF_STAGE(PERF_STAGE_CAPTURE);
+
+    enum { MAX_STALE_RETRIES = 3 };
+
+    bool const watched = camera->m_useCaptureWatchdog && camera->StartCaptureWatchdog();
+
+    for (int attempt = 0; ; attempt++)
+    {
+        for (int i = 0; i < NUM_CAPTURE_STAGES; i++)
+            camera->m_captureMarks[i] = -1;
+        camera->MarkCapture(CAPTURE_STAGE_START);
+        wxLongLong_t const requestUs = wxGetUTCTimeUSec().GetValue();
+
+        camera->m_captureOverdue = false;
+        int const deadline = watched ? camera->CaptureDeadlineMs(duration) : 0;
+        if (deadline)
+            camera->m_watchdogThread->Arm(deadline);
+
+        bool err = CaptureFrames(camera, duration, img, captureOptions, subframe);
+
+        if (deadline)
+            camera->m_watchdogThread->Disarm();
+
+        if (err)
+        {
+            // reconnect for a driver that gave up on the overdue capture
+            // without going through DisconnectWithAlert
+            if (camera->m_captureOverdue && camera->Connected && !WorkerThread::InterruptRequested())
+                camera->DisconnectWithAlert(CAPT_FAIL_TIMEOUT);
+            return err;
+        }
+
+        if (camera->m_captureMarks[CAPTURE_STAGE_DATA] < 0)
+            camera->MarkCapture(CAPTURE_STAGE_DATA);
+
+        { // lock scope
+            const wxLongLong *t = camera->m_captureMarks;
+            wxCriticalSectionLocker lck(camera->m_timingLock);
+            camera->m_timing.overhead.Add((t[CAPTURE_STAGE_DATA] - t[CAPTURE_STAGE_START]).ToDouble() / 1000.0 - duration);
+        } // lock scope
+
+        camera->CompleteExposureTimes(img, duration);
+
+        if (!camera->FrameIsStale(img, requestUs))
+            break;
+
+        GuideMetrics.AddStaleFrames(1);
+        if (attempt >= MAX_STALE_RETRIES || WorkerThread::InterruptRequested())
+        {
+            Debug.Write("camera: using the stale frame\n");
+            break;
+        }
+    }
+
+    if (img.ExposureTimed)
+        camera->m_lastExposureStartUs = img.ExposureStartUs;
+
+    return false;
+}
+
+// the end of an exposure the driver did not time is where the driver marked
+// the exposure done, or else the requested duration after the start
+void GuideCamera::CompleteExposureTimes(usImage& img, int duration)
+{
+    if (img.ExposureTimed || !img.ExposureStartUs)
+        return;
+
+    const wxLongLong *t = m_captureMarks;
+    if (t[CAPTURE_STAGE_EXPOSED] >= 0 && t[CAPTURE_STAGE_EXPOSED] >= t[CAPTURE_STAGE_START])
+        img.ExposureEndUs = img.ExposureStartUs + (t[CAPTURE_STAGE_EXPOSED] - t[CAPTURE_STAGE_START]).GetValue();
+    else
+        img.ExposureEndUs = img.ExposureStartUs + (wxLongLong_t) duration * 1000;
+}
+
+// Only the times a driver took are checked; estimated ones say nothing about
+// the frame. The checks are against the host clock the driver used.
+bool GuideCamera::FrameIsStale(const usImage& img, wxLongLong_t requestUs)
+{
+    if (!img.ExposureTimed)
+        return false;
+
+    // a little slack for drivers that time the frame from its arrival
+    enum { REQUEST_SLACK_US = 50000 };
+
+    if (m_lastExposureStartUs && img.ExposureStartUs <= m_lastExposureStartUs)
+    {
+        Debug.Write(wxString::Format("camera: stale frame, started %.3f s before the previous frame\n",
+            (double) (m_lastExposureStartUs - img.ExposureStartUs) / 1e6));
+        return true;
+    }
+
+    if (img.ExposureEndUs < requestUs - REQUEST_SLACK_US)
+    {
+        Debug.Write(wxString::Format("camera: stale frame, ended %.3f s before it was requested\n",
+            (double) (requestUs - img.ExposureEndUs) / 1e6));
+        return true;
+    }
+
+    wxLongLong_t const age = wxGetUTCTimeUSec().GetValue() - img.ExposureEndUs;
+    if (m_maxFrameAgeMs > 0 && age > (wxLongLong_t) m_maxFrameAgeMs * 1000)
+    {
+        Debug.Write(wxString::Format("camera: stale frame, %.3f s old\n", (double) age / 1e6));
+        return true;
+    }
+
+    return false;
+}
+
+bool GuideCamera::CaptureFrames(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe)
 {
     img.InitImgStartTime();
     img.BitsPerPixel = camera->BitsPerPixel();
     img.ImgExpDur = duration;
-    bool err = camera->Capture(duration, img, captureOptions, subframe);
+    img.LazyROI = wxRect(0, 0, 0, 0);
+    img.LazyDark = false;
+    if ((captureOptions & CAPTURE_LAZY_ROI) && !subframe.IsEmpty())
+    {
+        enum { LAZY_ROI_MARGIN = 8 };   // keeps the filter edges outside the star search region
+        img.LazyROI = subframe;
+        img.LazyROI.Inflate(LAZY_ROI_MARGIN);
+    }
+
+    if (camera->StackFrames > 1)
+        return CaptureStack(camera, duration, img, captureOptions, subframe);
+
+    return CaptureFrame(camera, duration, img, captureOptions, subframe);
+}
+
+// Stacking sums StackFrames back-to-back sub-exposures that share the
+// requested duration; cameras that stream see them as consecutive frames of
+// the same exposure. Darks are stacked the same way, so the dark is
+// subtracted from the finished stack. If the guide star, which is at the
+// center of the subframe, moves more than StackMaxShift pixels from where it
+// was in the first sub-exposure the partial stack is returned right away, so
+// a large drift is seen one sub-exposure after it happens rather than at the
+// end of the stack.
+bool GuideCamera::CaptureStack(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe)
+{
+    int const nframes = camera->StackFrames;
+    int const subDuration = wxMax(duration / nframes, 1);
+    int const subOptions = captureOptions & ~CAPTURE_SUBTRACT_DARK;
+
+    wxRect lazyROI = img.LazyROI;
+    img.LazyROI = wxRect(0, 0, 0, 0);
+
+    if (CaptureFrame(camera, subDuration, img, subOptions, subframe))
+        return true;
+
+    ImageStack stack;
+    stack.Init(img);
+
+    // locate the star in the first sub-exposure to watch for drift
+    bool track = !subframe.IsEmpty() && camera->StackMaxShift > 0.0;
+    int const searchRegion = wxMin(subframe.GetWidth(), subframe.GetHeight()) / 2 - 1;
+    Star ref;
+    if (track)
+    {
+        wxPoint center(subframe.GetX() + subframe.GetWidth() / 2, subframe.GetY() + subframe.GetHeight() / 2);
+        track = searchRegion > 0 && ref.Find(&img, searchRegion, center.x, center.y, Star::FIND_CENTROID);
+    }
+
+    usImage sub;
+    while (stack.Count() < nframes)
+    {
+        if (WorkerThread::InterruptRequested())
+            return true;
+
+        sub.InitImgStartTime();
+        sub.BitsPerPixel = img.BitsPerPixel;
+        sub.ImgExpDur = subDuration;
+        if (CaptureFrame(camera, subDuration, sub, subOptions, subframe))
+            return true;
+
+        if (stack.Add(sub))
+        {
+            Debug.Write("camera: stacked frame does not match, stack ended early\n");
+            break;
+        }
+
+        if (track)
+        {
+            Star star;
+            if (star.Find(&sub, searchRegion, ROUND(ref.X), ROUND(ref.Y), Star::FIND_CENTROID) &&
+                star.Distance(ref) > camera->StackMaxShift)
+            {
+                Debug.Write(wxString::Format("camera: star moved %.1f px, stack ended at %d of %d\n",
+                    star.Distance(ref), stack.Count(), nframes));
+                break;
+            }
+        }
+    }
+
+    stack.Get(img);
+    img.ImgExpDur = duration;
+    if (sub.ExposureEndUs > img.ExposureEndUs)
+        img.ExposureEndUs = sub.ExposureEndUs;
+
+    img.LazyROI = lazyROI;
+    if (captureOptions & CAPTURE_SUBTRACT_DARK)
+        camera->SubtractDark(img);
+
+    return false;
+}
+
+bool GuideCamera::CaptureFrame(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe)
+{
+    int const softBin = camera->HasSoftwareBinning() ? camera->SoftwareBinning : 1;
+    if (softBin <= 1)
+    {
+        bool err = camera->CaptureOne(duration, img, captureOptions, subframe);
+        return err;
+    }
+
+    // Software binning: the camera captures the unbinned pixels under the
+    // binned subframe, and the dark, which was captured binned, is subtracted
+    // after binning. The lazy ROI is in binned coordinates too, so it is held
+    // back from the camera. Binning a color sensor by 2 can take the green
+    // superpixels of the raw frame instead, in place of the camera's
+    // luminance reconstruction.
+
+    bool const green = softBin == 2 && camera->SoftwareBinningGreen != BAYER_GREEN_NONE;
+
+    wxRect camSubframe;
+    if (!subframe.IsEmpty())
+    {
+        camSubframe = wxRect(subframe.GetX() * softBin, subframe.GetY() * softBin,
+                             subframe.GetWidth() * softBin, subframe.GetHeight() * softBin);
+        camSubframe.Intersect(wxRect(camera->FullSize));
+    }
+
+    wxRect lazyROI = img.LazyROI;
+    img.LazyROI = wxRect(0, 0, 0, 0);
+
+    int const camOptions = captureOptions & ~(green ? CAPTURE_SUBTRACT_DARK | CAPTURE_RECON : CAPTURE_SUBTRACT_DARK);
+    bool err = camera->CaptureOne(duration, img, camOptions, camSubframe);
+    if (err)
+        return err;
+
+    if (green ? GreenSuperpixel(img, (BAYER_GREEN) camera->SoftwareBinningGreen) :
+                SoftwareBin(img, softBin, camera->SoftwareBinningSum))
+        return true;
+
+    img.LazyROI = lazyROI;
+    if (captureOptions & CAPTURE_SUBTRACT_DARK)
+        camera->SubtractDark(img);
+
+    return false;
+}
+
+// The stream is started by the first frame taken from it, with that frame's
+// settings. A native stream is told about each frame's settings as it is
+// taken, so it follows exposure and subframe changes without a restart.
+bool GuideCamera::CaptureStreamFrame(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe)
+{
+    camera->m_streamCapture = true;
+    bool err = Capture(camera, duration, img, captureOptions, subframe);
+    camera->m_streamCapture = false;
+    return err;
+}
+
+void GuideCamera::StopStream(void)
+{
+    if (!m_streamActive)
+        return;
+
+    Debug.Write(wxString::Format("camera: stop %s stream\n", HasNativeStream ? "native" : "single shot"));
+
+    if (HasNativeStream)
+        StreamStop();
+    m_streamActive = false;
+}
+
+bool GuideCamera::CaptureOne(int duration, usImage& img, int options, const wxRect& subframe)
+{
+    if (!m_streamCapture)
+        return Capture(duration, img, options, subframe);
+
+    if (!m_streamActive)
+    {
+        Debug.Write(wxString::Format("camera: start %s stream, d=%d r=(%d,%d,%d,%d)\n", HasNativeStream ? "native" : "single shot",
+            duration, subframe.x, subframe.y, subframe.width, subframe.height));
+
+        if (HasNativeStream && StreamStart(duration, subframe))
+        {
+            Debug.Write("camera: stream start failed\n");
+            return true;
+        }
+        m_streamActive = true;
+    }
+
+    bool err = HasNativeStream ? StreamFrame(duration, img, options, subframe) : Capture(duration, img, options, subframe);
+
+    // the driver's state is unknown after a failed frame, the next frame
+    // starts a new stream
+    if (err)
+        StopStream();
+
     return err;
 }
 
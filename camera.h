@@ -1,231 +1,477 @@
-/*
- *  camera.h
- *  PHD Guiding
- *
- *  Created by Craig Stark.
- *  Copyright (c) 2006-2010 Craig Stark.
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#ifndef CAMERA_H_INCLUDED
-#define CAMERA_H_INCLUDED
-
-typedef std::map<int, usImage *> ExposureImgMap; // map exposure to image
-class DefectMap;
-
-enum PropDlgType
-{
-    PROPDLG_NONE = 0,
-    PROPDLG_WHEN_CONNECTED = (1 << 0),    // property dialog available when connected
-    PROPDLG_WHEN_DISCONNECTED = (1 << 1), // property dialog available when disconnected
-    PROPDLG_ANY = (PROPDLG_WHEN_CONNECTED | PROPDLG_WHEN_DISCONNECTED),
-};
-
-extern wxSize UNDEFINED_FRAME_SIZE;
-
-class GuideCamera;
-
-class CameraConfigDialogPane : public ConfigDialogPane
-{
-public:
-    CameraConfigDialogPane(wxWindow *pParent, GuideCamera *pCamera);
-    virtual ~CameraConfigDialogPane(void) {};
-
-    void LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap& CtrlMap);
-    virtual void LoadValues(void) {};
-    virtual void UnloadValues(void) {};
-};
-
-class CameraConfigDialogCtrlSet : public ConfigDialogCtrlSet
-{
-    GuideCamera *m_pCamera;
-    wxCheckBox *m_pUseSubframes;
-    wxSpinCtrl *m_pCameraGain;
-    wxSpinCtrl *m_timeoutVal;
-    wxChoice   *m_pPortNum;
-    wxSpinCtrl *m_pDelay;
-    wxSpinCtrlDouble *m_pPixelSize;
-    wxChoice *m_binning;
-    wxCheckBox *m_coolerOn;
-    wxSpinCtrl *m_coolerSetpt;
-
-public:
-    CameraConfigDialogCtrlSet(wxWindow *pParent, GuideCamera *pCamera, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
-    virtual ~CameraConfigDialogCtrlSet() {};
-    virtual void LoadValues(void);
-    virtual void UnloadValues(void);
-
-    double GetPixelSize(void);
-    void SetPixelSize(double val);
-    int GetBinning(void);
-    void SetBinning(int val);
-};
-
-enum CaptureOptionBits
-{
-    CAPTURE_SUBTRACT_DARK = 1 << 0,
-    CAPTURE_RECON         = 1 << 1,    // debayer and/or deinterlace as required
-
-    CAPTURE_LIGHT = CAPTURE_SUBTRACT_DARK | CAPTURE_RECON,
-    CAPTURE_DARK = 0,
-    CAPTURE_BPM_REVIEW = CAPTURE_SUBTRACT_DARK,
-};
-
-class GuideCamera :  public wxMessageBoxProxy, public OnboardST4
-{
-    friend class CameraConfigDialogPane;
-    friend class CameraConfigDialogCtrlSet;
-
-    double          m_pixelSize;
-
-protected:
-    bool            m_hasGuideOutput;
-    int             m_timeoutMs;
-
-public:
-    int             GuideCameraGain;
-    wxString        Name;                   // User-friendly name
-    wxSize          FullSize;           // Size of current image
-    bool            Connected;
-    PropDlgType     PropertyDialogType;
-    bool            HasPortNum;
-    bool            HasDelayParam;
-    bool            HasGainControl;
-    bool            HasShutter;
-    bool            HasSubframes;
-    wxByte          MaxBinning;
-    wxByte          Binning;
-    short           Port;
-    int             ReadDelay;
-    bool            ShutterClosed;  // false=light, true=dark
-    bool            UseSubframes;
-    bool            HasCooler;
-
-    wxCriticalSection DarkFrameLock; // dark frames can be accessed in the main thread or the camera worker thread
-    usImage        *CurrentDarkFrame;
-    ExposureImgMap  Darks; // map exposure => dark frame
-    DefectMap      *CurrentDefectMap;
-
-    static wxArrayString List(void);
-    static GuideCamera *Factory(const wxString& choice);
-
-    GuideCamera(void);
-    virtual ~GuideCamera(void);
-
-    virtual bool HasNonGuiCapture(void) = 0;
-    virtual wxByte BitsPerPixel(void) = 0;
-
-    static bool Capture(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
-    static bool Capture(GuideCamera *camera, int duration, usImage& img, int captureOptions) { return Capture(camera, duration, img, captureOptions, wxRect(0, 0, 0, 0)); }
-
-    virtual bool HandleSelectCameraButtonClick(wxCommandEvent& evt);
-    static const wxString DEFAULT_CAMERA_ID;
-    virtual bool    EnumCameras(wxArrayString& names, wxArrayString& ids);
-
-    // Opens up and connects to camera. cameraId identifies which camera to connect to if
-    // there is more than one camera present
-    virtual bool    Connect(const wxString& cameraId) = 0;
-    virtual bool    Disconnect() = 0;               // Disconnects, unloading any DLLs loaded by Connect
-    virtual void    InitCapture();                  // Gets run at the start of any loop (e.g., reset stream, set gain, etc).
-
-    virtual bool    ST4HasGuideOutput(void);
-    virtual bool    ST4HostConnected(void);
-    virtual bool    ST4HasNonGuiMove(void);
-    virtual bool    ST4PulseGuideScope(int direction, int duration);
-
-    CameraConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
-    CameraConfigDialogCtrlSet *GetConfigDlgCtrlSet(wxWindow *pParent, GuideCamera *pCamera, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
-
-    static void GetBinningOpts(int maxBin, wxArrayString *opts);
-    void GetBinningOpts(wxArrayString *opts);
-
-    virtual void    ShowPropertyDialog() { return; }
-    bool            SetCameraPixelSize(double pixel_size);
-    double          GetCameraPixelSize(void) const;
-    virtual bool    GetDevicePixelSize(double *devPixelSize);           // Value from device/driver or error return
-
-    virtual bool    SetCoolerOn(bool on);
-    virtual bool    SetCoolerSetpoint(double temperature);
-    virtual bool    GetCoolerStatus(bool *on, double *setpoint, double *power, double *temperature);
-
-    virtual wxString GetSettingsSummary();
-    void            AddDark(usImage *dark);
-    void            SelectDark(int exposureDuration);
-    void            SetDefectMap(DefectMap *newMap);
-    void            ClearDefectMap(void);
-    void            ClearDarks(void);
-
-    void            SubtractDark(usImage& img);
-    void            GetDarklibProperties(int *pNumDarks, double *pMinExp, double *pMaxExp);
-
-    virtual const wxSize& DarkFrameSize() { return FullSize; }
-
-    static double GetProfilePixelSize(void);
-
-protected:
-
-    virtual bool Capture(int duration, usImage& img, int captureOptions, const wxRect& subframe) = 0;
-    int GetCameraGain(void);
-    bool SetCameraGain(int cameraGain);
-    bool SetBinning(int binning);
-    int GetTimeoutMs(void) const;
-    void SetTimeoutMs(int timeoutMs);
-
-    enum CaptureFailType {
-        CAPT_FAIL_MEMORY,
-        CAPT_FAIL_TIMEOUT,
-    };
-    enum ReconnectType {
-        NO_RECONNECT,
-        RECONNECT,
-    };
-    void DisconnectWithAlert(CaptureFailType type);
-    void DisconnectWithAlert(const wxString& msg, ReconnectType reconnect);
-};
-
-inline int GuideCamera::GetTimeoutMs(void) const
-{
-    return m_timeoutMs;
-}
-
-inline void GuideCamera::GetBinningOpts(wxArrayString *opts)
-{
-    GetBinningOpts(MaxBinning, opts);
-}
-
-inline double GuideCamera::GetCameraPixelSize(void) const
-{
-    return m_pixelSize;
-}
-
-inline bool GuideCamera::GetDevicePixelSize(double *devPixelSize)
-{
-    return true;                // Return an error, the device/driver can't report pixel size
-}
-
-#endif /* CAMERA_H_INCLUDED */
+/*
+ *  camera.h
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark.
+ *  Copyright (c) 2006-2010 Craig Stark.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAMERA_H_INCLUDED
+#define CAMERA_H_INCLUDED
+
+typedef std::map<int, usImage *> ExposureImgMap; // map exposure to image
+class DefectMap;
+class PreparedDark;
+class DarkModel;
+
+enum PropDlgType
+{
+    PROPDLG_NONE = 0,
+    PROPDLG_WHEN_CONNECTED = (1 << 0),    // property dialog available when connected
+    PROPDLG_WHEN_DISCONNECTED = (1 << 1), // property dialog available when disconnected
+    PROPDLG_ANY = (PROPDLG_WHEN_CONNECTED | PROPDLG_WHEN_DISCONNECTED),
+};
+
+extern wxSize UNDEFINED_FRAME_SIZE;
+
+class GuideCamera;
+class WorkerThread;
+
+class CameraConfigDialogPane : public ConfigDialogPane
+{
+public:
+    CameraConfigDialogPane(wxWindow *pParent, GuideCamera *pCamera);
+    virtual ~CameraConfigDialogPane(void) {};
+
+    void LayoutControls(GuideCamera *pCamera, BrainCtrlIdMap& CtrlMap);
+    virtual void LoadValues(void) {};
+    virtual void UnloadValues(void) {};
+};
+
+class CameraConfigDialogCtrlSet : public ConfigDialogCtrlSet
+{
+    GuideCamera *m_pCamera;
+    wxCheckBox *m_pUseSubframes;
+    wxSpinCtrl *m_pCameraGain;
+    wxSpinCtrl *m_timeoutVal;
+    wxChoice   *m_pPortNum;
+    wxSpinCtrl *m_pDelay;
+    wxSpinCtrlDouble *m_pPixelSize;
+    wxChoice *m_binning;
+    wxSpinCtrl *m_stackFrames;
+    wxCheckBox *m_coolerOn;
+    wxSpinCtrl *m_coolerSetpt;
+
+public:
+    CameraConfigDialogCtrlSet(wxWindow *pParent, GuideCamera *pCamera, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
+    virtual ~CameraConfigDialogCtrlSet() {};
+    virtual void LoadValues(void);
+    virtual void UnloadValues(void);
+
+    double GetPixelSize(void);
+    void SetPixelSize(double val);
+    int GetBinning(void);
+    void SetBinning(int val);
+};
+
+enum CaptureOptionBits
+{
+    CAPTURE_SUBTRACT_DARK = 1 << 0,
+    CAPTURE_RECON         = 1 << 1,    // debayer and/or deinterlace as required
+    CAPTURE_STATS_SUBFRAME = 1 << 2,   // image stats are only needed for the guide star subframe
+    CAPTURE_LAZY_ROI      = 1 << 3,    // calibrate and filter a full frame only around the guide star subframe for now
+
+    CAPTURE_LIGHT = CAPTURE_SUBTRACT_DARK | CAPTURE_RECON,
+    CAPTURE_DARK = 0,
+    CAPTURE_BPM_REVIEW = CAPTURE_SUBTRACT_DARK,
+};
+
+// Points in a capture that a driver can timestamp with MarkCapture. The
+// capture wrapper marks the start and, if the driver did not, the arrival of
+// the pixels in the usImage; the worker thread marks the end of processing.
+enum CaptureStage
+{
+    CAPTURE_STAGE_START,        // exposure requested
+    CAPTURE_STAGE_EXPOSED,      // exposure time elapsed
+    CAPTURE_STAGE_READOUT,      // image data read out of the camera or received from the server
+    CAPTURE_STAGE_DATA,         // pixels converted into the usImage
+    CAPTURE_STAGE_PROCESSED,    // dark subtraction, noise reduction and stats done
+
+    NUM_CAPTURE_STAGES
+};
+
+// Histogram of a capture interval with 4 bins per doubling of the duration,
+// from 1 ms to about 65 s
+struct CaptureLatency
+{
+    enum { BINS_PER_OCTAVE = 4, NUM_BINS = 16 * BINS_PER_OCTAVE };
+
+    unsigned int bins[NUM_BINS];
+    unsigned int count;
+    double       lastMs;
+    double       maxMs;
+    double       totalMs;
+
+    CaptureLatency() { Reset(); }
+    void Reset();
+    void Add(double ms);
+    double MeanMs() const { return count ? totalMs / count : 0.0; }
+    double PercentileMs(double pct) const;  // upper edge of the bin holding the percentile
+};
+
+struct CaptureTimingStats
+{
+    CaptureLatency exposure;    // start -> exposed
+    CaptureLatency readout;     // exposed -> readout
+    CaptureLatency transfer;    // readout -> data, including any conversion by the driver
+    CaptureLatency acquire;     // start -> data
+    CaptureLatency processing;  // data -> processed
+    CaptureLatency total;       // start -> processed
+    CaptureLatency overhead;    // acquire time beyond the requested exposure duration
+};
+
+class CaptureWatchdogThread;
+
+// Poll schedule for drivers that can only poll for the end of an exposure.
+// WaitUntilDue sleeps until just before the exposure is due; after that each
+// Wait sleeps for an interval that starts at 1 ms and doubles up to a limit
+// scaled to the exposure, so a short readout is seen within a millisecond or
+// two and a long one is polled at most every MAX_INTERVAL ms. Both return the
+// interrupt bits if the worker thread is asked to stop while sleeping.
+class ExposurePoller
+{
+    enum { MAX_INTERVAL = 20 };
+
+    wxStopWatch m_clock;
+    int m_due;          // ms on m_clock when the exposure should be complete
+    int m_interval;
+    int m_maxInterval;
+
+public:
+    ExposurePoller(int duration);
+    unsigned int WaitUntilDue(void);
+    unsigned int Wait(void);
+};
+
+// Chooses the region of the sensor a subframe-capable driver reads out for a
+// requested subframe. The driver declares the alignment its hardware needs
+// and how costly it is to reprogram the region; for a costly region the
+// chosen one is oversized around the subframe and kept while it still holds
+// the subframe, so the guide star can drift for a while before the sensor is
+// reprogrammed, and a move is preferred over a resize.
+class SensorRoi
+{
+public:
+    enum ReconfigureCost {
+        RECONFIGURE_CHEAP,      // reprogramming costs no more than the smaller readout saves
+        RECONFIGURE_COSTLY,     // reprogramming interrupts capture or needs a round trip
+    };
+
+private:
+    int m_posAlign;
+    int m_sizeAlign;
+    ReconfigureCost m_cost;
+    wxSize m_sensor;    // sensor size m_roi was chosen for
+    wxRect m_roi;       // current region, empty = full frame
+
+public:
+    SensorRoi(int posAlign = 1, int sizeAlign = 1, ReconfigureCost cost = RECONFIGURE_CHEAP);
+
+    // Sets *roi to the region to read for a subframe of a sensor, which
+    // contains the subframe. Returns false if the full frame should be read
+    // instead.
+    bool Negotiate(const wxRect& subframe, const wxSize& sensor, wxRect *roi);
+    void Reset(void) { m_roi = wxRect(); }
+};
+
+class GuideCamera :  public wxMessageBoxProxy, public OnboardST4
+{
+    friend class CameraConfigDialogPane;
+    friend class CameraConfigDialogCtrlSet;
+    friend class CameraTestThread;
+    friend class CaptureNodeSession;
+
+    double          m_pixelSize;
+    PreparedDark   *m_preparedDark; // CurrentDarkFrame prepared for subtraction, protected by DarkFrameLock
+    DarkModel      *m_darkModel;    // darks synthesized from the library for exposures it lacks
+    bool            m_useDarkModel;
+    bool            m_interpolateDarks; // interpolate exposures between two library darks
+    int             m_darkMemoryMB;     // library darks kept in memory, 0 for all of them
+
+    void            PrepareCurrentDark(void);
+    void            TrimDarkResidency(void);
+    void            ApplyDark(usImage& img);
+    static bool     CaptureFrames(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
+    static bool     CaptureFrame(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
+    static bool     CaptureStack(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
+
+    bool            m_streamActive;         // a stream has been started, see CaptureStreamFrame()
+    bool            m_streamCapture;        // the capture in progress takes the next frame of the stream
+    bool            CaptureOne(int duration, usImage& img, int options, const wxRect& subframe);
+
+    wxStopWatch     m_captureClock;
+    wxLongLong      m_captureMarks[NUM_CAPTURE_STAGES];  // microseconds on m_captureClock, -1 = not marked
+    wxCriticalSection m_timingLock;                     // protects m_timing
+    CaptureTimingStats m_timing;
+
+    wxCriticalSection m_exposureLock;   // protects m_exposureThread and m_exposureReady
+    WorkerThread   *m_exposureThread;   // the thread waiting in WaitForExposure
+    bool            m_exposureReady;
+
+    int             m_maxFrameAgeMs;        // frames the driver timed this long before they arrived are stale, 0 = no limit
+    wxLongLong_t    m_lastExposureStartUs;  // of the previous frame the driver timed
+
+    void            CompleteExposureTimes(usImage& img, int duration);
+    bool            FrameIsStale(const usImage& img, wxLongLong_t requestUs);
+
+    bool            m_useCaptureWatchdog;
+    CaptureWatchdogThread *m_watchdogThread;   // started by the first capture
+    volatile bool   m_captureOverdue;       // the watchdog gave up on the capture in progress
+
+    bool            StartCaptureWatchdog(void);
+    void            StopCaptureWatchdog(void);
+    int             CaptureDeadlineMs(int duration);
+    void            OnCaptureOverdue(void);
+
+protected:
+    bool            m_hasGuideOutput;
+    int             m_timeoutMs;
+
+public:
+    int             GuideCameraGain;
+    wxString        Name;                   // User-friendly name
+    wxSize          FullSize;           // Size of current image
+    bool            Connected;
+    PropDlgType     PropertyDialogType;
+    bool            HasPortNum;
+    bool            HasDelayParam;
+    bool            HasGainControl;
+    bool            HasShutter;
+    bool            HasSubframes;
+    bool            HasPipelinedCapture; // can start the next exposure while the previous frame is being processed
+    bool            HasAsyncCompletion; // the driver is told when a frame is ready rather than polling, see WaitForExposure()
+    bool            HasNativeStream;    // the driver keeps acquiring between frames of a stream, see CaptureStreamFrame()
+    wxByte          MaxBinning;
+    wxByte          Binning;
+    wxByte          SoftwareBinning;    // binning applied after capture when the camera cannot bin, see HasSoftwareBinning()
+    bool            SoftwareBinningSum; // software binned pixels are the sum rather than the average of the block
+    int             SoftwareBinningGreen; // a BAYER_GREEN_* value; for a color sensor, bin 2 is the mean of each cell's green pixels
+    int             StackFrames;        // number of sub-exposures summed into each frame, 1 = no stacking
+    double          StackMaxShift;      // stop stacking early if the guide star moves more than this (pixels)
+    short           Port;
+    int             ReadDelay;
+    bool            ShutterClosed;  // false=light, true=dark
+    bool            UseSubframes;
+    bool            HasCooler;
+
+    wxCriticalSection DarkFrameLock; // dark frames can be accessed in the main thread or the camera worker thread
+    usImage        *CurrentDarkFrame;
+    ExposureImgMap  Darks; // map exposure => dark frame
+    DefectMap      *CurrentDefectMap;
+
+    static wxArrayString List(void);
+    static GuideCamera *Factory(const wxString& choice);
+
+    GuideCamera(void);
+    virtual ~GuideCamera(void);
+
+    virtual bool HasNonGuiCapture(void) = 0;
+    virtual wxByte BitsPerPixel(void) = 0;
+
+    static bool Capture(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
+    static bool Capture(GuideCamera *camera, int duration, usImage& img, int captureOptions) { return Capture(camera, duration, img, captureOptions, wxRect(0, 0, 0, 0)); }
+
+    // Continuous acquisition: the next frame of a stream that the camera
+    // keeps running between calls, taken just like Capture takes a single
+    // frame, exposure times included. A driver that can stream sets
+    // HasNativeStream and implements the Stream* methods; for the others
+    // each frame of the stream is a single Capture. The stream runs until
+    // StopStream, which must be called on the thread taking the frames.
+    static bool CaptureStreamFrame(GuideCamera *camera, int duration, usImage& img, int captureOptions, const wxRect& subframe);
+    void            StopStream(void);
+    bool            IsStreaming(void) const { return m_streamActive; }
+
+    virtual bool HandleSelectCameraButtonClick(wxCommandEvent& evt);
+    static const wxString DEFAULT_CAMERA_ID;
+    virtual bool    EnumCameras(wxArrayString& names, wxArrayString& ids);
+
+    // Opens up and connects to camera. cameraId identifies which camera to connect to if
+    // there is more than one camera present
+    virtual bool    Connect(const wxString& cameraId) = 0;
+    virtual bool    Disconnect() = 0;               // Disconnects, unloading any DLLs loaded by Connect
+    // True if Connect can be called on a thread other than the main thread,
+    // so the gear dialog can connect the camera alongside other devices
+    virtual bool    CanConnectInBackground(void) const { return false; }
+    virtual void    InitCapture();                  // Gets run at the start of any loop (e.g., reset stream, set gain, etc).
+
+    virtual bool    ST4HasGuideOutput(void);
+    virtual bool    ST4HostConnected(void);
+    virtual bool    ST4HasNonGuiMove(void);
+    virtual bool    ST4PulseGuideScope(int direction, int duration);
+
+    CameraConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
+    CameraConfigDialogCtrlSet *GetConfigDlgCtrlSet(wxWindow *pParent, GuideCamera *pCamera, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
+
+    static void GetBinningOpts(int maxBin, wxArrayString *opts);
+    void GetBinningOpts(wxArrayString *opts);
+
+    // Vendor SDKs are delay-loaded on Windows so that PHD2 starts without
+    // touching them. Drivers call this before their first SDK call; it
+    // returns true if the DLL is loaded, otherwise false with a message in err.
+    static bool LoadDriverDll(const char *dllName, wxString *err);
+
+    // A connected camera without hardware binning is binned in software. The
+    // effective binning and frame size are what the rest of PHD2 sees: pixel
+    // scale, calibration, subframes and dark frames all use them.
+    enum { MAX_SOFTWARE_BINNING = 4 };
+    enum { MAX_STACK_FRAMES = 16 };
+    void            SetStackFrames(int frames);
+    bool            HasSoftwareBinning(void) const { return Connected && MaxBinning <= 1; }
+    wxByte          MaxEffectiveBinning(void) const { return HasSoftwareBinning() ? (wxByte) MAX_SOFTWARE_BINNING : MaxBinning; }
+    wxByte          EffectiveBinning(void) const { return HasSoftwareBinning() ? SoftwareBinning : Binning; }
+    wxSize          FrameSize(void) const;
+
+    virtual void    ShowPropertyDialog() { return; }
+    bool            SetCameraPixelSize(double pixel_size);
+    double          GetCameraPixelSize(void) const;
+    virtual bool    GetDevicePixelSize(double *devPixelSize);           // Value from device/driver or error return
+
+    virtual bool    SetCoolerOn(bool on);
+    virtual bool    SetCoolerSetpoint(double temperature);
+    virtual bool    GetCoolerStatus(bool *on, double *setpoint, double *power, double *temperature);
+
+    virtual wxString GetSettingsSummary();
+    void            AddDark(usImage *dark);
+    void            SelectDark(int exposureDuration);
+    void            SetDefectMap(DefectMap *newMap);
+    void            ClearDefectMap(void);
+    void            ClearDarks(void);
+    void            DetachDarks(std::vector<usImage *> *frames);
+
+    void            SubtractDark(usImage& img);
+    void            SubtractDark(usImage& img, const unsigned char *raw);
+    bool            CalibrateFrame(usImage& img, int noiseReduction, bool stats);
+    void            GetDarklibProperties(int *pNumDarks, double *pMinExp, double *pMaxExp);
+    // more library darks on the heap than the dark memory limit allows
+    bool            DarksExceedMemoryLimit(void) const;
+
+    virtual wxSize  DarkFrameSize() { return FrameSize(); }
+
+    void            ExposureReady(void);    // called by the driver, from any thread, when a frame is ready
+
+    void            MarkCapture(CaptureStage stage);
+    void            CaptureComplete(void);
+    CaptureTimingStats GetCaptureTiming(void);
+    void            ResetCaptureTiming(void);
+    void            LogCaptureTiming(void);
+
+    // The capture watchdog watches each capture from a thread of its own. A
+    // capture still running well past the time the camera's measured readout
+    // says it should take is aborted, if the driver can, and the camera is
+    // reconnected without an alert, keeping the darks, calibration and lock
+    // position, so guiding resumes within a few seconds.
+    bool            GetUseCaptureWatchdog(void) const { return m_useCaptureWatchdog; }
+    void            SetUseCaptureWatchdog(bool enable);
+    bool            CaptureOverdue(void) const { return m_captureOverdue; }
+
+    static double GetProfilePixelSize(void);
+
+    // re-read the profile settings of a camera that is kept connected across
+    // a profile switch
+    virtual void LoadProfileSettings(void);
+
+protected:
+
+    virtual bool Capture(int duration, usImage& img, int captureOptions, const wxRect& subframe) = 0;
+
+    // native stream: StreamStart is called before the first frame, with its
+    // settings, and StreamFrame for every frame, with the settings then
+    // current; returns true on error
+    virtual bool StreamStart(int duration, const wxRect& subframe) { return false; }
+    virtual bool StreamFrame(int duration, usImage& img, int captureOptions, const wxRect& subframe) { return Capture(duration, img, captureOptions, subframe); }
+    virtual void StreamStop(void) { }
+    int GetCameraGain(void);
+    bool SetCameraGain(int cameraGain);
+    bool SetBinning(int binning);
+    int GetTimeoutMs(void) const;
+    void SetTimeoutMs(int timeoutMs);
+    int GetMaxFrameAgeMs(void) const { return m_maxFrameAgeMs; }
+    void SetMaxFrameAgeMs(int ms);
+
+    enum CaptureFailType {
+        CAPT_FAIL_MEMORY,
+        CAPT_FAIL_TIMEOUT,
+    };
+    enum ReconnectType {
+        NO_RECONNECT,
+        RECONNECT,
+    };
+    void DisconnectWithAlert(CaptureFailType type);
+    // called on the watchdog thread when the capture is overdue; returns true
+    // if the driver aborted the exposure. The driver's wait for the frame
+    // also ends, since CameraWatchdog::Expired and WaitForExposure report a
+    // timeout once the capture is overdue.
+    virtual bool AbortOverdueExposure(void) { return false; }
+    void DisconnectWithAlert(const wxString& msg, ReconnectType reconnect);
+
+    // Drivers whose SDK reports a finished frame through a callback or event
+    // call BeginExposureWait before starting the exposure and ExposureReady
+    // from the callback. WaitForExposure then sleeps on the worker thread's
+    // wakeup event, so it returns as soon as the frame is ready or a stop is
+    // requested, with no polling.
+    enum ExposureWaitResult {
+        EXPOSURE_READY,
+        EXPOSURE_TIMEOUT,
+        EXPOSURE_INTERRUPTED,
+    };
+    void BeginExposureWait(void);
+    ExposureWaitResult WaitForExposure(int timeoutMs);
+
+private:
+    void LoadSettings(void);
+};
+
+inline int GuideCamera::GetTimeoutMs(void) const
+{
+    return m_timeoutMs;
+}
+
+inline void GuideCamera::GetBinningOpts(wxArrayString *opts)
+{
+    GetBinningOpts(MaxEffectiveBinning(), opts);
+}
+
+inline wxSize GuideCamera::FrameSize(void) const
+{
+    if (HasSoftwareBinning() && SoftwareBinning > 1)
+        return wxSize(FullSize.GetWidth() / SoftwareBinning, FullSize.GetHeight() / SoftwareBinning);
+    return FullSize;
+}
+
+inline double GuideCamera::GetCameraPixelSize(void) const
+{
+    return m_pixelSize;
+}
+
+inline bool GuideCamera::GetDevicePixelSize(double *devPixelSize)
+{
+    return true;                // Return an error, the device/driver can't report pixel size
+}
+
+#endif /* CAMERA_H_INCLUDED */
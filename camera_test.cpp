@@ -0,0 +1,457 @@
+/*
+ *  camera_test.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+wxDEFINE_EVENT(CAMERA_TEST_DONE_EVENT, wxThreadEvent);
+
+CameraTestRequest::CameraTestRequest()
+    : subframes(true),
+    subframeSize(64),
+    frameCount(10)
+{
+}
+
+CameraTestResult::CameraTestResult()
+    : exposure(0),
+    binning(1),
+    gain(0),
+    subframe(false),
+    frames(0),
+    failed(0),
+    early(0),
+    duplicate(0),
+    discarded(0),
+    readoutMs(0.0),
+    transferMs(0.0),
+    overheadMs(0.0),
+    intervalMs(0.0),
+    intervalP95Ms(0.0),
+    maxFps(0.0)
+{
+}
+
+CameraTestStatus::CameraTestStatus()
+    : state(CAMERA_TEST_IDLE),
+    setting(0),
+    settingCount(0),
+    frame(0),
+    frameCount(0)
+{
+}
+
+class CameraTestThread : public wxThread
+{
+    CameraTestRequest m_req;
+
+    bool TestSetting(CameraTestResult *result, wxString *errMsg);
+    bool WriteResults(const std::vector<CameraTestResult>& results, wxString *fileName);
+
+public:
+    CameraTestThread(const CameraTestRequest& req)
+        : wxThread(wxTHREAD_JOINABLE), m_req(req) { }
+
+    ExitCode Entry();
+};
+
+// s_status is shared with the test thread and protected by s_lock; the
+// remaining state is only touched in the main thread
+static wxCriticalSection s_lock;
+static CameraTestStatus s_status;
+static CAMERA_TEST_STATE s_result;
+static volatile bool s_cancel;
+static CameraTestThread *s_thread;
+
+// a frame shorter than this fraction of its exposure was not exposed after
+// the capture started, so it must have been buffered by the driver
+static const double EARLY_FRAME_FRACTION = 0.5;
+// below this the exposure is too short to tell a buffered frame from a fast one
+static const int EARLY_FRAME_MIN_EXPOSURE = 100;
+// give up on a setting after this many failed captures
+static const int MAX_CAPTURE_FAILURES = 3;
+
+static unsigned int FrameHash(const usImage& img)
+{
+    // FNV-1a
+    unsigned int h = 2166136261U;
+    for (int i = 0; i < img.NPixels; i++)
+    {
+        h = (h ^ (img.ImageData[i] & 0xff)) * 16777619U;
+        h = (h ^ (img.ImageData[i] >> 8)) * 16777619U;
+    }
+    return h;
+}
+
+bool CameraTestThread::TestSetting(CameraTestResult *result, wxString *errMsg)
+{
+    wxRect subframe;
+    if (result->subframe)
+    {
+        wxSize const full = pCamera->FrameSize();
+        int const w = wxMin(m_req.subframeSize, full.GetWidth());
+        int const h = wxMin(m_req.subframeSize, full.GetHeight());
+        subframe = wxRect((full.GetWidth() - w) / 2, (full.GetHeight() - h) / 2, w, h);
+    }
+
+    pCamera->InitCapture();
+    pCamera->ResetCaptureTiming();
+    unsigned int const staleBefore = GuideMetrics.GetStats().staleFrames;
+
+    std::vector<double> intervals;
+    double totalMs = 0.0;
+    unsigned int prevHash = 0;
+    usImage img;
+
+    for (int i = 0; i < m_req.frameCount && !s_cancel; i++)
+    {
+        long long const t0 = PerfTrace::Now();
+        // raw frames, as the driver delivers them
+        bool err = GuideCamera::Capture(pCamera, result->exposure, img, CAPTURE_DARK, subframe);
+        if (err)
+        {
+            Debug.Write(wxString::Format("CameraTest: capture failed exp=%d bin=%d gain=%d subframe=%d\n",
+                result->exposure, result->binning, result->gain, result->subframe));
+            if (++result->failed >= MAX_CAPTURE_FAILURES)
+                break;
+            continue;
+        }
+        pCamera->CaptureComplete();
+        double const ms = (double)(PerfTrace::Now() - t0) / 1000.0;
+
+        unsigned int const hash = FrameHash(img);
+        if (result->frames > 0 && hash == prevHash)
+            ++result->duplicate;
+        prevHash = hash;
+
+        if (result->exposure >= EARLY_FRAME_MIN_EXPOSURE && ms < result->exposure * EARLY_FRAME_FRACTION)
+            ++result->early;
+
+        result->size = img.Size;
+        ++result->frames;
+        intervals.push_back(ms);
+        totalMs += ms;
+
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.frame = i + 1;
+    }
+
+    result->discarded = GuideMetrics.GetStats().staleFrames - staleBefore;
+
+    if (result->frames == 0)
+    {
+        if (!s_cancel)
+            *errMsg = wxString::Format(_("Capture failed at exposure %d ms, binning %d, gain %d"),
+                result->exposure, result->binning, result->gain);
+        return true;
+    }
+
+    CaptureTimingStats const timing = pCamera->GetCaptureTiming();
+    if (timing.readout.count)
+        result->readoutMs = timing.readout.PercentileMs(50.0);
+    if (timing.transfer.count)
+        result->transferMs = timing.transfer.PercentileMs(50.0);
+
+    std::sort(intervals.begin(), intervals.end());
+    result->intervalMs = totalMs / result->frames;
+    result->intervalP95Ms = intervals[wxMin((size_t)(intervals.size() * 0.95), intervals.size() - 1)];
+    result->overheadMs = result->intervalMs - result->exposure;
+    result->maxFps = result->intervalMs > 0.0 ? 1000.0 / result->intervalMs : 0.0;
+
+    Debug.Write(wxString::Format("CameraTest: exp=%d bin=%d gain=%d subframe=%d size=%dx%d frames=%d failed=%d "
+        "early=%d duplicate=%d discarded=%d readout=%.1f transfer=%.1f overhead=%.1f interval=%.1f p95=%.1f fps=%.2f\n",
+        result->exposure, result->binning, result->gain, result->subframe, result->size.GetWidth(), result->size.GetHeight(),
+        result->frames, result->failed, result->early, result->duplicate, result->discarded, result->readoutMs,
+        result->transferMs, result->overheadMs, result->intervalMs, result->intervalP95Ms, result->maxFps));
+
+    return false;
+}
+
+bool CameraTestThread::WriteResults(const std::vector<CameraTestResult>& results, wxString *fileName)
+{
+    *fileName = Debug.GetLogDir() + PATHSEPSTR + "PHD2_CameraTest_" + wxDateTime::Now().Format("%Y-%m-%d_%H%M%S") + ".csv";
+
+    wxFFile file(*fileName, "w");
+    if (!file.IsOpened())
+        return true;
+
+    file.Write(wxString::Format("# camera %s, pipelined capture %s, async completion %s\n", pCamera->Name,
+        pCamera->HasPipelinedCapture ? "yes" : "no", pCamera->HasAsyncCompletion ? "yes" : "no"));
+    file.Write("exposure_ms,binning,gain,subframe,width,height,frames,failed,early,duplicate,discarded,stale,"
+        "readout_ms,transfer_ms,overhead_ms,interval_ms,interval_p95_ms,max_fps\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const CameraTestResult& r = results[i];
+        file.Write(wxString::Format("%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f\n",
+            r.exposure, r.binning, r.gain, r.subframe ? 1 : 0, r.size.GetWidth(), r.size.GetHeight(), r.frames,
+            r.failed, r.early, r.duplicate, r.discarded, r.Stale(), r.readoutMs, r.transferMs, r.overheadMs,
+            r.intervalMs, r.intervalP95Ms, r.maxFps));
+    }
+
+    return !file.Close();
+}
+
+wxThread::ExitCode CameraTestThread::Entry()
+{
+    PerfTrace::SetThreadName("camera test");
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, "camera test");
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("camera test CoInitializeEx returns %x\n", hr));
+#endif
+
+    int const origBinning = pCamera->EffectiveBinning();
+    int const origGain = pCamera->GuideCameraGain;
+
+    std::vector<int> binnings = m_req.binnings;
+    if (binnings.empty())
+        binnings.push_back(origBinning);
+    std::vector<int> gains = m_req.gains;
+    if (gains.empty() || !pCamera->HasGainControl)
+        gains.assign(1, origGain);
+    int const subframeModes = m_req.subframes && pCamera->HasSubframes ? 2 : 1;
+
+    Debug.Write(wxString::Format("CameraTest: start camera=%s exposures=%u binnings=%u gains=%u subframes=%d frames=%d\n",
+        pCamera->Name, (unsigned int) m_req.exposures.size(), (unsigned int) binnings.size(),
+        (unsigned int) gains.size(), subframeModes == 2, m_req.frameCount));
+
+    std::vector<CameraTestResult> results;
+    wxString errMsg;
+    bool err = false;
+    int setting = 0;
+
+    for (size_t b = 0; b < binnings.size() && !err && !s_cancel; b++)
+    {
+        if (binnings[b] < 1 || binnings[b] > pCamera->MaxEffectiveBinning())
+        {
+            Debug.Write(wxString::Format("CameraTest: skip unsupported binning %d\n", binnings[b]));
+            setting += gains.size() * m_req.exposures.size() * subframeModes;
+            continue;
+        }
+        pCamera->SetBinning(binnings[b]);
+
+        for (size_t g = 0; g < gains.size() && !err && !s_cancel; g++)
+        {
+            if (pCamera->HasGainControl)
+                pCamera->SetCameraGain(gains[g]);
+
+            for (size_t e = 0; e < m_req.exposures.size() && !err && !s_cancel; e++)
+            {
+                for (int sub = 0; sub < subframeModes && !err && !s_cancel; sub++)
+                {
+                    {
+                        wxCriticalSectionLocker lck(s_lock);
+                        s_status.setting = setting++;
+                        s_status.frame = 0;
+                    }
+
+                    CameraTestResult result;
+                    result.exposure = m_req.exposures[e];
+                    result.binning = binnings[b];
+                    result.gain = pCamera->GuideCameraGain;
+                    result.subframe = sub != 0;
+
+                    err = TestSetting(&result, &errMsg);
+                    if (result.frames > 0)
+                    {
+                        results.push_back(result);
+                        wxCriticalSectionLocker lck(s_lock);
+                        s_status.results = results;
+                    }
+                }
+            }
+        }
+    }
+
+    if (pCamera->EffectiveBinning() != origBinning)
+        pCamera->SetBinning(origBinning);
+    if (pCamera->GuideCameraGain != origGain)
+        pCamera->SetCameraGain(origGain);
+
+    wxString fileName;
+    if (!results.empty() && WriteResults(results, &fileName))
+    {
+        if (!err)
+            errMsg = _("Error writing camera test results ") + fileName;
+        fileName.clear();
+        err = true;
+    }
+
+    CAMERA_TEST_STATE result;
+    if (s_cancel)
+    {
+        result = CAMERA_TEST_CANCELLED;
+        errMsg = _("Camera test cancelled");
+    }
+    else if (err)
+        result = CAMERA_TEST_FAILED;
+    else
+        result = CAMERA_TEST_SUCCEEDED;
+
+    Debug.Write(wxString::Format("CameraTest: done result=%d results=%u %s %s\n", result,
+        (unsigned int) results.size(), fileName, errMsg));
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_result = result;
+        s_status.fileName = fileName;
+        s_status.message = errMsg;
+    }
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    wxQueueEvent(pFrame, new wxThreadEvent(wxEVT_THREAD, CAMERA_TEST_DONE_EVENT));
+
+    return (ExitCode) 0;
+}
+
+bool CameraTest::Start(const CameraTestRequest& req, wxString *error)
+{
+    if (s_thread)
+    {
+        *error = _("A camera test is already in progress");
+        return true;
+    }
+    if (!pCamera || !pCamera->Connected)
+    {
+        *error = _("Please connect to a camera first");
+        return true;
+    }
+    if (pFrame->CaptureActive || DarkBuilder::IsActive() || PulseProfiler::IsActive() || AOFastLoop::IsActive() ||
+        CaptureNode::IsRunning())
+    {
+        *error = _("Cannot test the camera while capture is active");
+        return true;
+    }
+    if (req.exposures.empty() || req.frameCount < 1 || req.subframeSize < 8)
+    {
+        *error = _("Invalid camera test parameters");
+        return true;
+    }
+    for (size_t i = 0; i < req.exposures.size(); i++)
+    {
+        if (req.exposures[i] <= 0)
+        {
+            *error = _("Invalid camera test parameters");
+            return true;
+        }
+    }
+
+    size_t nbin = wxMax(req.binnings.size(), (size_t) 1);
+    size_t ngain = pCamera->HasGainControl ? wxMax(req.gains.size(), (size_t) 1) : 1;
+    size_t nsub = req.subframes && pCamera->HasSubframes ? 2 : 1;
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status = CameraTestStatus();
+        s_status.state = CAMERA_TEST_RUNNING;
+        s_status.settingCount = nbin * ngain * req.exposures.size() * nsub;
+        s_status.frameCount = req.frameCount;
+        s_result = CAMERA_TEST_RUNNING;
+    }
+    s_cancel = false;
+
+    CameraTestThread *thread = new CameraTestThread(req);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = CAMERA_TEST_IDLE;
+        *error = _("Could not start the camera test thread");
+        return true;
+    }
+
+    s_thread = thread;
+
+    return false;
+}
+
+void CameraTest::Cancel(void)
+{
+    if (s_thread)
+    {
+        Debug.AddLine("CameraTest: cancel requested");
+        s_cancel = true;
+    }
+}
+
+bool CameraTest::IsActive(void)
+{
+    return s_thread != NULL;
+}
+
+CameraTestStatus CameraTest::GetStatus(void)
+{
+    wxCriticalSectionLocker lck(s_lock);
+    return s_status;
+}
+
+void CameraTest::OnTestDone(void)
+{
+    if (!s_thread)
+        return;
+
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+
+    CAMERA_TEST_STATE result;
+    wxString fileName;
+    wxString msg;
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = result = s_result;
+        fileName = s_status.fileName;
+        msg = s_status.message;
+    }
+
+    EvtServer.NotifyCameraTestComplete(result == CAMERA_TEST_SUCCEEDED, fileName,
+        result == CAMERA_TEST_SUCCEEDED ? wxString() : msg);
+}
+
+void CameraTest::Shutdown(void)
+{
+    if (!s_thread)
+        return;
+
+    Debug.AddLine("CameraTest: waiting for test thread to exit");
+    s_cancel = true;
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+}
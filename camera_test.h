@@ -0,0 +1,118 @@
+/*
+ *  camera_test.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAMERA_TEST_INCLUDED
+#define CAMERA_TEST_INCLUDED
+
+struct CameraTestRequest
+{
+    std::vector<int> exposures;   // exposure durations (ms)
+    std::vector<int> binnings;    // binning values to test, empty = current binning
+    std::vector<int> gains;       // gain values (percent) to test, empty = current gain
+    bool subframes;               // also test a subframe at each setting if the camera supports them
+    int subframeSize;             // subframe width and height (binned pixels)
+    int frameCount;               // frames captured at each setting
+
+    CameraTestRequest();
+};
+
+// measurements for one combination of exposure, binning, gain and subframe
+struct CameraTestResult
+{
+    int exposure;
+    int binning;
+    int gain;
+    bool subframe;
+    wxSize size;                  // size of the captured frames
+    int frames;                   // frames captured
+    int failed;                   // captures that returned an error
+    int early;                    // frames returned in well under the exposure time
+    int duplicate;                // frames identical to the frame before
+    int discarded;                // buffered frames the driver discarded as stale
+    double readoutMs;             // median exposed -> readout, 0 if the driver does not mark it
+    double transferMs;            // median readout -> data
+    double overheadMs;            // mean capture time beyond the exposure
+    double intervalMs;            // mean time between frames
+    double intervalP95Ms;         // 95th percentile time between frames
+    double maxFps;                // frames per second captured back to back
+
+    CameraTestResult();
+    int Stale(void) const { return early + duplicate + discarded; }
+};
+
+enum CAMERA_TEST_STATE
+{
+    CAMERA_TEST_IDLE,
+    CAMERA_TEST_RUNNING,
+    CAMERA_TEST_SUCCEEDED,
+    CAMERA_TEST_FAILED,
+    CAMERA_TEST_CANCELLED,
+};
+
+struct CameraTestStatus
+{
+    CAMERA_TEST_STATE state;
+    int setting;          // index of the setting being tested
+    int settingCount;
+    int frame;            // frames captured at the current setting
+    int frameCount;
+    std::vector<CameraTestResult> results;
+    wxString fileName;    // results file, written when the test finishes
+    wxString message;
+
+    CameraTestStatus();
+};
+
+wxDECLARE_EVENT(CAMERA_TEST_DONE_EVENT, wxThreadEvent);
+
+// Exercises the connected camera through GuideCamera::Capture on a background
+// thread, the same way the dark builder does, to find out how the driver
+// behaves at each combination of the requested settings: how long readout
+// and transfer take, whether it hands back stale buffered frames, and how
+// many frames per second it can deliver back to back. The interval columns
+// tell whether the camera can keep up with a given fixed cadence, and the
+// overhead column how much pipelined capture can hide. The results go to
+// PHD2_CameraTest_<timestamp>.csv in the log directory. The camera's binning
+// and gain are restored when the test finishes.
+class CameraTest
+{
+public:
+    static bool Start(const CameraTestRequest& req, wxString *error);  // returns true on error
+    static void Cancel(void);
+    static bool IsActive(void);        // running or not yet finalized
+    static CameraTestStatus GetStatus(void);
+    static void OnTestDone(void);
+    static void Shutdown(void);        // cancel and wait for the test thread
+};
+
+#endif
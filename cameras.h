@@ -62,6 +62,8 @@
 # define MEADE_DSI
 # define STARFISH
 # define SIMULATOR
+# define REPLAY_CAMERA
+# define CAPTURE_NODE_CAMERA
 # define SXV
 # define ATIK_GEN3
 # define INOVA_PLC
@@ -93,6 +95,8 @@
 # define MEADE_DSI
 # define STARFISH
 # define SIMULATOR
+# define REPLAY_CAMERA
+# define CAPTURE_NODE_CAMERA
 # define SXV
 # define OPENSSAG
 # define KWIQGUIDER
@@ -101,6 +105,8 @@
 
 #elif defined (__linux__)
 # define SIMULATOR
+# define REPLAY_CAMERA
+# define CAPTURE_NODE_CAMERA
 # define CAM_QHY5
 # define INDI_CAMERA
 # define ZWO_ASI
@@ -0,0 +1,640 @@
+/*
+ *  capture_node.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+// the socket timeout bounds a stalled read or write of one message
+static const long NODE_IO_TIMEOUT_SEC = 30;
+
+void NodeWriter::Double(double d)
+{
+    wxUint64 u;
+    memcpy(&u, &d, sizeof(u));
+    U32((unsigned int)(u & 0xffffffffU));
+    U32((unsigned int)(u >> 32));
+}
+
+void NodeWriter::String(const wxString& s)
+{
+    wxScopedCharBuffer utf8 = s.utf8_str();
+    U32((unsigned int) utf8.length());
+    m_buf.insert(m_buf.end(), utf8.data(), utf8.data() + utf8.length());
+}
+
+unsigned int NodeReader::U8()
+{
+    if (m_pos >= m_buf.size())
+    {
+        m_failed = true;
+        return 0;
+    }
+    return m_buf[m_pos++];
+}
+
+unsigned int NodeReader::U16()
+{
+    unsigned int lo = U8();
+    return lo | (U8() << 8);
+}
+
+unsigned int NodeReader::U32()
+{
+    unsigned int lo = U16();
+    return lo | (U16() << 16);
+}
+
+double NodeReader::Double()
+{
+    wxUint64 lo = U32();
+    wxUint64 u = lo | ((wxUint64) U32() << 32);
+    double d;
+    memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+wxString NodeReader::String()
+{
+    unsigned int len = U32();
+    const unsigned char *p = Bytes(len);
+    return p ? wxString::FromUTF8((const char *) p, len) : wxString();
+}
+
+const unsigned char *NodeReader::Bytes(size_t n)
+{
+    if (n > Remaining())
+    {
+        m_failed = true;
+        return NULL;
+    }
+    const unsigned char *p = n ? &m_buf[m_pos] : NULL;
+    m_pos += n;
+    return p;
+}
+
+NodeChannel::NodeChannel(wxSocketBase *sock, const char *threadName)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_sock(sock),
+      m_stop(false),
+      m_open(true),
+      m_threadName(threadName)
+{
+    m_sock->SetFlags(wxSOCKET_BLOCK | wxSOCKET_WAITALL);
+    m_sock->SetTimeout(NODE_IO_TIMEOUT_SEC);
+    m_sock->Notify(false);
+}
+
+NodeChannel::~NodeChannel()
+{
+    for (std::deque<NodeMessage *>::iterator it = m_out.begin(); it != m_out.end(); ++it)
+        delete *it;
+    m_sock->Destroy();
+}
+
+void NodeChannel::Send(NodeMessage *msg)
+{
+    wxCriticalSectionLocker lck(m_outLock);
+    m_out.push_back(msg);
+}
+
+// returns true on error
+static bool read_all(wxSocketBase *sock, void *buf, wxUint32 len)
+{
+    if (len == 0)
+        return false;
+    sock->Read(buf, len);
+    return sock->Error() || sock->LastCount() != len;
+}
+
+bool NodeChannel::ReadMessage(NodeMessage *msg)
+{
+    unsigned char hdr[NODE_HEADER_SIZE];
+    if (read_all(m_sock, hdr, sizeof(hdr)))
+        return true;
+
+    if (memcmp(hdr, "PHDN", 4) != 0)
+    {
+        Debug.Write("CaptureNode: bad message header\n");
+        return true;
+    }
+
+    msg->type = hdr[4] | (hdr[5] << 8);
+    msg->seq = hdr[8] | (hdr[9] << 8) | (hdr[10] << 16) | ((unsigned int) hdr[11] << 24);
+    unsigned int size = hdr[12] | (hdr[13] << 8) | (hdr[14] << 16) | ((unsigned int) hdr[15] << 24);
+    if (size > NODE_MAX_PAYLOAD)
+    {
+        Debug.Write(wxString::Format("CaptureNode: message payload too large (%u bytes)\n", size));
+        return true;
+    }
+
+    msg->payload.resize(size);
+    return size > 0 && read_all(m_sock, &msg->payload[0], size);
+}
+
+bool NodeChannel::WriteMessage(const NodeMessage& msg)
+{
+    unsigned char hdr[NODE_HEADER_SIZE] = { 'P', 'H', 'D', 'N' };
+    unsigned int const size = (unsigned int) msg.payload.size();
+    hdr[4] = (unsigned char)(msg.type & 0xff);
+    hdr[5] = (unsigned char)(msg.type >> 8);
+    for (int i = 0; i < 4; i++)
+    {
+        hdr[8 + i] = (unsigned char)((msg.seq >> (8 * i)) & 0xff);
+        hdr[12 + i] = (unsigned char)((size >> (8 * i)) & 0xff);
+    }
+
+    m_sock->Write(hdr, sizeof(hdr));
+    if (m_sock->Error() || m_sock->LastCount() != sizeof(hdr))
+        return true;
+    if (size == 0)
+        return false;
+    m_sock->Write(&msg.payload[0], size);
+    return m_sock->Error() || m_sock->LastCount() != size;
+}
+
+bool NodeChannel::FlushOutput()
+{
+    std::deque<NodeMessage *> out;
+    {
+        wxCriticalSectionLocker lck(m_outLock);
+        out.swap(m_out);
+    }
+
+    bool err = false;
+    for (std::deque<NodeMessage *>::iterator it = out.begin(); it != out.end(); ++it)
+    {
+        if (!err)
+            err = WriteMessage(**it);
+        delete *it;
+    }
+    return err;
+}
+
+wxThread::ExitCode NodeChannel::Entry()
+{
+    PerfTrace::SetThreadName(m_threadName);
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, m_threadName);
+
+    while (!m_stop && !TestDestroy())
+    {
+        if (FlushOutput())
+            break;
+
+        // also returns true when the connection is lost, then the read fails
+        if (!m_sock->WaitForRead(0, NODE_POLL_MS))
+            continue;
+
+        NodeMessage *msg = new NodeMessage();
+        if (ReadMessage(msg))
+        {
+            delete msg;
+            break;
+        }
+        OnMessage(msg);
+    }
+
+    m_open = false;
+    m_sock->Close();
+    OnClosed();
+
+    return (ExitCode) 0;
+}
+
+// ---------------------------------------------------------------------------
+// the node
+
+class CaptureNodeSession;
+
+// runs the requests of one kind, captures or pulses, in order
+class NodeWorker : public wxThread
+{
+    CaptureNodeSession *m_session;
+    const char *m_name;
+    wxMessageQueue<NodeMessage *> m_queue;
+
+public:
+    NodeWorker(CaptureNodeSession *session, const char *name)
+        : wxThread(wxTHREAD_JOINABLE), m_session(session), m_name(name) { }
+
+    void Post(NodeMessage *msg) { m_queue.Post(msg); }    // NULL ends the thread
+
+    ExitCode Entry();
+};
+
+class CaptureNodeSession : public NodeChannel
+{
+    NodeWorker m_captureWorker;
+    NodeWorker m_pulseWorker;
+
+    void ReplyError(const NodeMessage& req, const wxString& msg);
+    void HandleHello(const NodeMessage& req);
+    void HandleCapture(const NodeMessage& req);
+    void HandlePulse(const NodeMessage& req);
+
+protected:
+    void OnMessage(NodeMessage *msg);
+
+public:
+    CaptureNodeSession(wxSocketBase *sock)
+        : NodeChannel(sock, "capture node"),
+          m_captureWorker(this, "capture node capture"),
+          m_pulseWorker(this, "capture node pulse") { }
+
+    bool Start();       // returns true on error
+    void Finish();      // stop the channel and wait for any request in progress
+
+    void Handle(NodeMessage *req);
+};
+
+wxThread::ExitCode NodeWorker::Entry()
+{
+    PerfTrace::SetThreadName(m_name);
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, m_name);
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("%s CoInitializeEx returns %x\n", m_name, hr));
+#endif
+
+    NodeMessage *msg;
+    while (m_queue.Receive(msg) == wxMSGQUEUE_NO_ERROR && msg)
+    {
+        m_session->Handle(msg);
+        delete msg;
+    }
+
+    return (ExitCode) 0;
+}
+
+static bool run_thread(wxThread *thread)
+{
+    return thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR;
+}
+
+bool CaptureNodeSession::Start()
+{
+    if (run_thread(&m_captureWorker))
+        return true;
+    if (run_thread(&m_pulseWorker))
+    {
+        m_captureWorker.Post(NULL);
+        m_captureWorker.Wait();
+        return true;
+    }
+    if (run_thread(this))
+    {
+        m_captureWorker.Post(NULL);
+        m_pulseWorker.Post(NULL);
+        m_captureWorker.Wait();
+        m_pulseWorker.Wait();
+        return true;
+    }
+    return false;
+}
+
+void CaptureNodeSession::Finish()
+{
+    Stop();
+    Wait();
+    m_captureWorker.Post(NULL);
+    m_pulseWorker.Post(NULL);
+    m_captureWorker.Wait();
+    m_pulseWorker.Wait();
+}
+
+void CaptureNodeSession::OnMessage(NodeMessage *msg)
+{
+    switch (msg->type)
+    {
+    case NODE_HELLO:
+        HandleHello(*msg);
+        delete msg;
+        break;
+    case NODE_CAPTURE:
+        m_captureWorker.Post(msg);
+        break;
+    case NODE_PULSE:
+        m_pulseWorker.Post(msg);
+        break;
+    default:
+        ReplyError(*msg, wxString::Format("unknown request type %u", msg->type));
+        delete msg;
+        break;
+    }
+}
+
+void CaptureNodeSession::Handle(NodeMessage *req)
+{
+    if (req->type == NODE_CAPTURE)
+        HandleCapture(*req);
+    else
+        HandlePulse(*req);
+}
+
+void CaptureNodeSession::ReplyError(const NodeMessage& req, const wxString& msg)
+{
+    Debug.Write(wxString::Format("CaptureNode: request %u failed: %s\n", req.seq, msg));
+    NodeMessage *reply = new NodeMessage(NODE_ERROR, req.seq);
+    NodeWriter(reply).String(msg);
+    Send(reply);
+}
+
+void CaptureNodeSession::HandleHello(const NodeMessage& req)
+{
+    if (!pCamera || !pCamera->Connected)
+    {
+        ReplyError(req, "the node camera is not connected");
+        return;
+    }
+
+    unsigned int flags = 0;
+    if (pCamera->HasSubframes)
+        flags |= NODE_CAP_SUBFRAMES;
+    if (pCamera->ST4HasGuideOutput())
+        flags |= NODE_CAP_GUIDE_OUTPUT;
+    if (pCamera->HasGainControl)
+        flags |= NODE_CAP_GAIN;
+    if (pCamera->HasShutter)
+        flags |= NODE_CAP_SHUTTER;
+
+    double pixelSize;
+    if (pCamera->GetDevicePixelSize(&pixelSize))
+        pixelSize = 0.0;
+
+    wxSize const size = pCamera->FrameSize();
+
+    NodeMessage *reply = new NodeMessage(NODE_HELLO_REPLY, req.seq);
+    NodeWriter w(reply);
+    w.U16(NODE_PROTOCOL_VERSION);
+    w.U16(size.GetWidth());
+    w.U16(size.GetHeight());
+    w.U8(pCamera->MaxEffectiveBinning());
+    w.U8(pCamera->EffectiveBinning());
+    w.U32(flags);
+    w.U8(pCamera->BitsPerPixel());
+    w.I32(pCamera->GetCameraGain());
+    w.Double(pixelSize);
+    w.String(pCamera->Name);
+    Send(reply);
+
+    Debug.Write(wxString::Format("CaptureNode: client hello, camera %s %dx%d\n", pCamera->Name, size.GetWidth(), size.GetHeight()));
+}
+
+// The darks are subtracted by the client, which keeps the dark library, so
+// the node always returns the raw frame.
+void CaptureNodeSession::HandleCapture(const NodeMessage& req)
+{
+    NodeReader rd(req);
+    int const duration = rd.I32();
+    int const options = rd.I32();
+    int const binning = rd.U16();
+    unsigned int const method = rd.U16();
+    bool const dark = rd.U8() != 0;
+    int const gain = rd.I32();
+    wxRect subframe;
+    subframe.x = rd.I32();
+    subframe.y = rd.I32();
+    subframe.width = rd.I32();
+    subframe.height = rd.I32();
+
+    if (rd.Failed() || duration < 0 || method > FRAME_CODEC_PACKED)
+    {
+        ReplyError(req, "invalid capture request");
+        return;
+    }
+    if (!pCamera || !pCamera->Connected)
+    {
+        ReplyError(req, "the node camera is not connected");
+        return;
+    }
+
+    if (binning != pCamera->EffectiveBinning())
+        pCamera->SetBinning(binning);
+    if (gain >= 0 && pCamera->HasGainControl && gain != pCamera->GetCameraGain())
+        pCamera->SetCameraGain(gain);
+    pCamera->ShutterClosed = dark;
+
+    if (!pCamera->HasSubframes)
+        subframe = wxRect();
+
+    usImage img;
+    bool err = GuideCamera::Capture(pCamera, duration, img, options & ~(CAPTURE_SUBTRACT_DARK | CAPTURE_LAZY_ROI), subframe);
+    if (!err)
+        pCamera->CaptureComplete();
+
+    if (err || !img.ImageData)
+    {
+        ReplyError(req, "capture failed");
+        return;
+    }
+
+    NodeMessage *reply = new NodeMessage(NODE_FRAME, req.seq);
+    FrameCodec::Encode(img, img.Subframe, (FrameCodecMethod) method, &reply->payload);
+    Send(reply);
+}
+
+void CaptureNodeSession::HandlePulse(const NodeMessage& req)
+{
+    NodeReader rd(req);
+    int const direction = rd.U8();
+    int const duration = rd.I32();
+
+    if (rd.Failed() || duration < 0)
+    {
+        ReplyError(req, "invalid pulse request");
+        return;
+    }
+    if (!pCamera || !pCamera->Connected || !pCamera->ST4HasGuideOutput())
+    {
+        ReplyError(req, "the node camera has no guide output");
+        return;
+    }
+
+    if (pCamera->ST4PulseGuideScope(direction, duration))
+    {
+        ReplyError(req, "guide pulse failed");
+        return;
+    }
+
+    Send(new NodeMessage(NODE_PULSE_DONE, req.seq));
+}
+
+// accepts one client at a time, a second client is turned away while the
+// first is connected
+class NodeListener : public wxThread
+{
+    wxSocketServer *m_server;
+    volatile bool m_stop;
+
+public:
+    NodeListener(wxSocketServer *server) : wxThread(wxTHREAD_JOINABLE), m_server(server), m_stop(false) { }
+
+    void Stop() { m_stop = true; }
+
+    ExitCode Entry();
+};
+
+wxThread::ExitCode NodeListener::Entry()
+{
+    PerfTrace::SetThreadName("capture node listener");
+
+    CaptureNodeSession *session = NULL;
+
+    while (!m_stop)
+    {
+        if (session && !session->IsOpen())
+        {
+            session->Finish();
+            delete session;
+            session = NULL;
+            Debug.Write("CaptureNode: client disconnected\n");
+        }
+
+        if (!m_server->WaitForAccept(0, 100))
+            continue;
+
+        wxSocketBase *sock = m_server->Accept(false);
+        if (!sock)
+            continue;
+
+        wxIPV4address peer;
+        sock->GetPeer(peer);
+
+        if (session)
+        {
+            Debug.Write(wxString::Format("CaptureNode: refused a second client from %s\n", peer.IPAddress()));
+            sock->Destroy();
+            continue;
+        }
+
+        Debug.Write(wxString::Format("CaptureNode: client connected from %s\n", peer.IPAddress()));
+
+        session = new CaptureNodeSession(sock);
+        if (session->Start())
+        {
+            Debug.Write("CaptureNode: could not start the session threads\n");
+            delete session;
+            session = NULL;
+        }
+    }
+
+    if (session)
+    {
+        session->Finish();
+        delete session;
+    }
+
+    return (ExitCode) 0;
+}
+
+static wxSocketServer *s_server;
+static NodeListener *s_listener;
+static unsigned int s_port;
+
+bool CaptureNode::Start(unsigned int instanceId, wxString *error)
+{
+    if (s_listener)
+    {
+        *error = _("The capture node is already running");
+        return true;
+    }
+
+    // the node only needs the camera, the rest of the gear is optional
+    wxString connectErr;
+    if (pFrame->pGearDialog->ConnectAll(&connectErr))
+        Debug.Write(wxString::Format("CaptureNode: %s\n", connectErr));
+
+    if (!pCamera || !pCamera->Connected)
+    {
+        *error = _("The camera in the profile did not connect");
+        return true;
+    }
+
+    // the node sockets are used on the node's own threads
+    if (!wxSocketBase::IsInitialized())
+        wxSocketBase::Initialize();
+
+    unsigned int const port = NODE_PORT_BASE + instanceId - 1;
+    wxIPV4address addr;
+    addr.Service(port);
+
+    wxSocketServer *server = new wxSocketServer(addr, wxSOCKET_BLOCK | wxSOCKET_REUSEADDR);
+    if (!server->IsOk())
+    {
+        server->Destroy();
+        *error = wxString::Format(_("Cannot listen on port %u"), port);
+        return true;
+    }
+
+    NodeListener *listener = new NodeListener(server);
+    if (run_thread(listener))
+    {
+        delete listener;
+        server->Destroy();
+        *error = _("Could not start the capture node thread");
+        return true;
+    }
+
+    s_server = server;
+    s_listener = listener;
+    s_port = port;
+
+    Debug.Write(wxString::Format("CaptureNode: serving camera %s on port %u\n", pCamera->Name, port));
+
+    return false;
+}
+
+bool CaptureNode::IsRunning(void)
+{
+    return s_listener != NULL;
+}
+
+unsigned int CaptureNode::Port(void)
+{
+    return s_port;
+}
+
+void CaptureNode::Shutdown(void)
+{
+    if (!s_listener)
+        return;
+
+    Debug.Write("CaptureNode: shutting down\n");
+
+    s_listener->Stop();
+    s_listener->Wait();
+    delete s_listener;
+    s_listener = NULL;
+
+    s_server->Destroy();
+    s_server = NULL;
+}
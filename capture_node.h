@@ -0,0 +1,183 @@
+/*
+ *  capture_node.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CAPTURE_NODE_INCLUDED
+#define CAPTURE_NODE_INCLUDED
+
+#include <deque>
+
+// Remote capture: "phd2 --capturenode" runs headless on the computer the
+// camera is plugged into and serves the camera over TCP on port
+// 4600 + instance - 1. The "PHD2 Capture Node" camera in another PHD2
+// instance connects to it, so guiding, calibration and the dark library run
+// on the client while the node only captures frames and passes guide pulses
+// through the camera's ST4 port.
+//
+// Every message is a 16 byte little-endian header followed by the payload:
+//
+//   char[4]  magic "PHDN"
+//   uint16   message type
+//   uint16   reserved (0)
+//   uint32   sequence number, a reply carries the number of its request
+//   uint32   payload size in bytes
+//
+// Requests and their replies:
+//
+//   HELLO    -> HELLO: protocol version, camera geometry and capabilities
+//   CAPTURE  -> FRAME: the subframe as a frame_codec.h frame, which carries
+//               the frame metadata too
+//   PULSE    -> PULSE_DONE, once the pulse has completed
+//
+// and ERROR, with a message, in place of any reply. Captures and pulses are
+// served by separate threads on the node, so a pulse can run during an
+// exposure just as with a local camera.
+
+enum NodeMessageType
+{
+    NODE_HELLO = 1,
+    NODE_CAPTURE = 2,
+    NODE_PULSE = 3,
+
+    NODE_HELLO_REPLY = 101,
+    NODE_FRAME = 102,
+    NODE_PULSE_DONE = 103,
+    NODE_ERROR = 104,
+};
+
+enum
+{
+    NODE_PROTOCOL_VERSION = 1,
+    NODE_PORT_BASE = 4600,
+    NODE_HEADER_SIZE = 16,
+    NODE_MAX_PAYLOAD = 256 * 1024 * 1024,
+};
+
+// HELLO_REPLY capability flags
+enum
+{
+    NODE_CAP_SUBFRAMES = 1 << 0,
+    NODE_CAP_GUIDE_OUTPUT = 1 << 1,
+    NODE_CAP_GAIN = 1 << 2,
+    NODE_CAP_SHUTTER = 1 << 3,
+};
+
+struct NodeMessage
+{
+    unsigned int type;
+    unsigned int seq;
+    std::vector<unsigned char> payload;
+
+    NodeMessage(unsigned int type_ = 0, unsigned int seq_ = 0) : type(type_), seq(seq_) { }
+};
+
+// little-endian payload fields
+class NodeWriter
+{
+    std::vector<unsigned char>& m_buf;
+
+public:
+    NodeWriter(NodeMessage *msg) : m_buf(msg->payload) { }
+
+    void U8(unsigned int v) { m_buf.push_back((unsigned char) v); }
+    void U16(unsigned int v) { U8(v & 0xff); U8((v >> 8) & 0xff); }
+    void U32(unsigned int v) { U16(v & 0xffff); U16(v >> 16); }
+    void I32(int v) { U32((unsigned int) v); }
+    void Double(double d);
+    void String(const wxString& s);
+    std::vector<unsigned char>& Buffer() { return m_buf; }
+};
+
+// reads past the end of the payload return zeros and set Failed()
+class NodeReader
+{
+    const std::vector<unsigned char>& m_buf;
+    size_t m_pos;
+    bool m_failed;
+
+public:
+    NodeReader(const NodeMessage& msg) : m_buf(msg.payload), m_pos(0), m_failed(false) { }
+
+    unsigned int U8();
+    unsigned int U16();
+    unsigned int U32();
+    int I32() { return (int) U32(); }
+    double Double();
+    wxString String();
+    const unsigned char *Bytes(size_t n);     // NULL if fewer than n bytes remain
+    size_t Remaining() const { return m_buf.size() - m_pos; }
+    bool Failed() const { return m_failed; }
+};
+
+// One end of a node connection. The socket is only used on the channel
+// thread: it writes the queued messages, then waits briefly for input, so a
+// message queued with Send goes out within NODE_POLL_MS.
+class NodeChannel : public wxThread
+{
+    wxSocketBase *m_sock;
+    wxCriticalSection m_outLock;
+    std::deque<NodeMessage *> m_out;
+    volatile bool m_stop;
+    volatile bool m_open;
+    const char *m_threadName;
+
+    bool ReadMessage(NodeMessage *msg);
+    bool WriteMessage(const NodeMessage& msg);
+    bool FlushOutput();
+
+protected:
+    virtual void OnMessage(NodeMessage *msg) = 0;   // takes ownership, called on the channel thread
+    virtual void OnClosed() { }                     // connection lost or stopped, on the channel thread
+
+public:
+    enum { NODE_POLL_MS = 1 };
+
+    NodeChannel(wxSocketBase *sock, const char *threadName);
+    virtual ~NodeChannel();
+
+    void Send(NodeMessage *msg);      // takes ownership, any thread
+    void Stop() { m_stop = true; }
+    bool IsOpen() const { return m_open; }
+
+    ExitCode Entry();
+};
+
+class CaptureNode
+{
+public:
+    static bool Start(unsigned int instanceId, wxString *error);  // returns true on error
+    static bool IsRunning(void);
+    static unsigned int Port(void);
+    static void Shutdown(void);
+};
+
+#endif
@@ -36,6 +36,17 @@
 #ifndef CIRCBUF_INCLUDED
 #define CIRCBUF_INCLUDED
 
+#include <algorithm>
+#include <utility>
+
+// Fixed-capacity ring, oldest element at index 0. Once full, each new
+// element replaces the oldest.
+//
+// The elements are in at most two contiguous runs, which segments() returns
+// oldest first, so a loop over the whole buffer can be two straight passes
+// instead of wrapping the index on every access. A buffer created with
+// POWER_OF_TWO rounds its capacity up to a power of two and wraps indexes
+// with a mask instead of a division.
 template<typename T>
 class circular_buffer
 {
@@ -44,7 +55,19 @@ class circular_buffer
     unsigned int m_tail;
     unsigned int m_size;
     unsigned int m_capacity;
+    unsigned int m_mask;        // capacity - 1 in power of two mode, else 0
+
+    unsigned int wrap(unsigned int pos) const { return m_mask ? pos & m_mask : pos % m_capacity; }
+    void advance();
 public:
+    enum CapacityMode { EXACT, POWER_OF_TWO };
+
+    struct span
+    {
+        T *data;
+        unsigned int size;
+    };
+
     class iterator
     {
         friend class circular_buffer<T>;
@@ -56,15 +79,20 @@ public:
         iterator operator++(int) { iterator it(*this); m_pos++; return it; }
         bool operator==(const iterator& rhs) const { assert(&m_cb == &rhs.m_cb); return m_pos == rhs.m_pos; }
         bool operator!=(const iterator& rhs) const { assert(&m_cb == &rhs.m_cb); return m_pos != rhs.m_pos; }
-        T& operator*() const { return m_cb.m_ary[m_pos % m_cb.m_capacity]; }
-        T* operator->() const { return &m_cb.m_ary[m_pos % m_cb.m_capacity]; }
+        T& operator*() const { return m_cb.m_ary[m_cb.wrap(m_pos)]; }
+        T* operator->() const { return &m_cb.m_ary[m_cb.wrap(m_pos)]; }
     };
     friend class circular_buffer<T>::iterator;
     circular_buffer();
-    circular_buffer(unsigned int capacity);
+    circular_buffer(unsigned int capacity, CapacityMode mode = EXACT);
     ~circular_buffer();
-    void resize(unsigned int capacity);
+    void resize(unsigned int capacity, CapacityMode mode = EXACT);
     void push_front(const T& t);
+    void push_front(T&& t);
+    // constructs the new element from args and returns it
+    template<typename... Args> T& emplace_front(Args&&... args);
+    // adds n elements, oldest first; only the last capacity() are kept
+    void append(const T *p, unsigned int n);
     void pop_back(unsigned int n = 1);
     void clear();
     T& operator[](unsigned int n) const;
@@ -72,6 +100,9 @@ public:
     unsigned int capacity() const { return m_capacity; }
     iterator begin() { return iterator(*this, m_tail); }
     iterator end() { return iterator(*this, m_tail + m_size); }
+    // the elements in order, as first followed by second; second is empty
+    // unless the elements wrap around the end of the storage
+    void segments(span *first, span *second) const;
 };
 
 template<typename T>
@@ -80,19 +111,21 @@ circular_buffer<T>::circular_buffer()
     m_head(0),
     m_tail(0),
     m_size(0),
-    m_capacity(0)
+    m_capacity(0),
+    m_mask(0)
 {
 }
 
 template<typename T>
-circular_buffer<T>::circular_buffer(unsigned int capacity)
-    : m_ary(new T[capacity]),
+circular_buffer<T>::circular_buffer(unsigned int capacity, CapacityMode mode)
+    : m_ary(0),
     m_head(0),
     m_tail(0),
     m_size(0),
-    m_capacity(capacity)
+    m_capacity(0),
+    m_mask(0)
 {
-    assert(capacity > 0);
+    resize(capacity, mode);
 }
 
 template<typename T>
@@ -102,10 +135,18 @@ circular_buffer<T>::~circular_buffer()
 }
 
 template<typename T>
-void circular_buffer<T>::resize(unsigned int capacity)
+void circular_buffer<T>::resize(unsigned int capacity, CapacityMode mode)
 {
     assert(capacity > 0);
     assert(m_ary == 0);
+    if (mode == POWER_OF_TWO)
+    {
+        unsigned int n = 1;
+        while (n < capacity)
+            n <<= 1;
+        capacity = n;
+        m_mask = n - 1;
+    }
     m_ary = new T[capacity];
     m_capacity = capacity;
 }
@@ -116,14 +157,14 @@ void circular_buffer<T>::clear()
     m_head = m_tail = m_size = 0;
 }
 
+// the element at m_head has just been written
 template<typename T>
-void circular_buffer<T>::push_front(const T& t)
+void circular_buffer<T>::advance()
 {
-    m_ary[m_head] = t;
-    m_head = (m_head + 1) % m_capacity;
+    m_head = wrap(m_head + 1);
     if (m_size == m_capacity)
     {
-        m_tail = (m_tail + 1) % m_capacity;
+        m_tail = wrap(m_tail + 1);
     }
     else
     {
@@ -131,11 +172,62 @@ void circular_buffer<T>::push_front(const T& t)
     }
 }
 
+template<typename T>
+void circular_buffer<T>::push_front(const T& t)
+{
+    m_ary[m_head] = t;
+    advance();
+}
+
+template<typename T>
+void circular_buffer<T>::push_front(T&& t)
+{
+    m_ary[m_head] = std::move(t);
+    advance();
+}
+
+template<typename T>
+template<typename... Args>
+T& circular_buffer<T>::emplace_front(Args&&... args)
+{
+    // the slots are constructed up front, so the new element is moved into one
+    T& slot = m_ary[m_head];
+    slot = T(std::forward<Args>(args)...);
+    advance();
+    return slot;
+}
+
+template<typename T>
+void circular_buffer<T>::append(const T *p, unsigned int n)
+{
+    if (n >= m_capacity)
+    {
+        p += n - m_capacity;
+        n = m_capacity;
+    }
+
+    unsigned int const run = m_capacity - m_head < n ? m_capacity - m_head : n;
+    std::copy(p, p + run, m_ary + m_head);
+    std::copy(p + run, p + n, m_ary);
+
+    m_head = wrap(m_head + n);
+    unsigned int const size = m_size + n;
+    if (size > m_capacity)
+    {
+        m_tail = wrap(m_tail + (size - m_capacity));
+        m_size = m_capacity;
+    }
+    else
+    {
+        m_size = size;
+    }
+}
+
 template<typename T>
 void circular_buffer<T>::pop_back(unsigned int n)
 {
     assert(m_size >= n);
-    m_tail = (m_tail + n) % m_capacity;
+    m_tail = wrap(m_tail + n);
     m_size -= n;
 }
 
@@ -143,7 +235,17 @@ template<typename T>
 T& circular_buffer<T>::operator[](unsigned int n) const
 {
     assert(n < m_size);
-    return m_ary[(m_tail + n) % m_capacity];
+    return m_ary[wrap(m_tail + n)];
+}
+
+template<typename T>
+void circular_buffer<T>::segments(span *first, span *second) const
+{
+    unsigned int const run = m_capacity - m_tail < m_size ? m_capacity - m_tail : m_size;
+    first->data = m_ary + m_tail;
+    first->size = run;
+    second->data = m_ary;
+    second->size = m_size - run;
 }
 
 #endif
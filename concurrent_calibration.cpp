@@ -0,0 +1,349 @@
+/*
+ *  concurrent_calibration.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+// frames per AO axis, and the triples needed before the response is used
+enum { AXIS_FRAMES = 12, MIN_TRIPLES = 2 };
+
+ConcurrentCalibration::ConcurrentCalibration(StepGuider *ao, Mount *scope)
+    : m_ao(ao),
+      m_scope(scope),
+      m_phase(PHASE_X),
+      m_amplitude(1),
+      m_scopeStarted(false),
+      m_frames(0)
+{
+}
+
+bool ConcurrentCalibration::Wanted(Mount *ao, Mount *scope)
+{
+    return ao && ao->IsStepGuider() && static_cast<StepGuider *>(ao)->GetConcurrentCalibration() &&
+        scope && scope->IsConnected() && !ao->IsCalibrated() && !scope->IsCalibrated();
+}
+
+bool ConcurrentCalibration::Begin(const PHD_Point& currentLocation)
+{
+    m_ao->ResetErrorCount();
+    m_scope->ResetErrorCount();
+
+    if (m_ao->BeginCalibration(currentLocation))
+        return true;
+
+    m_amplitude = wxMax(1, m_ao->GetCalibrationStepsPerIteration());
+    m_amplitude = wxMin(m_amplitude, wxMin(m_ao->MaxPosition(RIGHT), m_ao->MaxPosition(UP)));
+    if (m_amplitude < 1)
+        return true;
+
+    Debug.Write(wxString::Format("Concurrent calibration: begin, AO amplitude %d steps\n", m_amplitude));
+
+    EvtServer.NotifyStartCalibration(m_ao);
+
+    m_phase = PHASE_X;
+    m_samples.clear();
+    m_responses.clear();
+    m_respX.Invalidate();
+    m_respY.Invalidate();
+    m_scopeStarted = false;
+    m_frames = 0;
+
+    MoveAoTo(wxPoint(m_amplitude, 0), m_ao->GetAoPos());
+
+    return false;
+}
+
+bool ConcurrentCalibration::IsComplete(void) const
+{
+    return m_phase == PHASE_DONE && m_scopeStarted && m_scope->IsCalibrated();
+}
+
+void ConcurrentCalibration::MoveAoTo(const wxPoint& target, const wxPoint& ao)
+{
+    int dx = target.x - ao.x;
+    int dy = target.y - ao.y;
+
+    if (dx)
+        pFrame->ScheduleCalibrationMove(m_ao, dx > 0 ? RIGHT : LEFT, abs(dx));
+    if (dy)
+        pFrame->ScheduleCalibrationMove(m_ao, dy > 0 ? UP : DOWN, abs(dy));
+}
+
+static double Median(std::vector<double>& v)
+{
+    size_t n = v.size();
+    std::nth_element(v.begin(), v.begin() + n / 2, v.end());
+    double m = v[n / 2];
+    if (n % 2 == 0)
+    {
+        std::nth_element(v.begin(), v.begin() + n / 2 - 1, v.end());
+        m = (m + v[n / 2 - 1]) / 2.0;
+    }
+    return m;
+}
+
+// the component-wise median of the triples so far
+static PHD_Point MedianResponse(const std::vector<PHD_Point>& responses)
+{
+    std::vector<double> x, y;
+    for (size_t i = 0; i < responses.size(); i++)
+    {
+        x.push_back(responses[i].X);
+        y.push_back(responses[i].Y);
+    }
+    return PHD_Point(Median(x), Median(y));
+}
+
+bool ConcurrentCalibration::FinishAxis(PHD_Point *response, const char *axis)
+{
+    if ((int) m_responses.size() < MIN_TRIPLES)
+    {
+        Debug.Write(wxString::Format("Concurrent calibration: too few AO %s samples (%d)\n", axis, (int) m_responses.size()));
+        return true;
+    }
+
+    PHD_Point r = MedianResponse(m_responses);
+
+    std::vector<double> dev;
+    for (size_t i = 0; i < m_responses.size(); i++)
+        dev.push_back(m_responses[i].Distance(r));
+    double const mad = Median(dev);
+
+    Debug.Write(wxString::Format("Concurrent calibration: AO %s response (%.3f, %.3f) px/step, deviation %.3f, %d samples\n",
+        axis, r.X, r.Y, mad, (int) m_responses.size()));
+
+    // the AO must move the star measurably, and consistently from frame to frame
+    if (r.Distance() * 2 * m_amplitude < 0.5)
+    {
+        pFrame->Alert(_("The AO is not moving the star enough to calibrate it together with the mount. Increase the AO calibration steps, or turn off concurrent calibration."));
+        return true;
+    }
+    if (mad > 0.5 * r.Distance())
+    {
+        pFrame->Alert(_("The AO motion could not be separated from the mount motion. Turn off concurrent calibration if this happens again."));
+        return true;
+    }
+
+    *response = r;
+    return false;
+}
+
+bool ConcurrentCalibration::UpdateAo(const PHD_Point& currentLocation, const wxPoint& ao)
+{
+    enum { MAX_CALIBRATION_MOVE_ERRORS = 12 };
+    if (m_ao->ErrorCount() > MAX_CALIBRATION_MOVE_ERRORS)
+    {
+        pFrame->Alert(_("The AO is failing to move and calibration cannot complete. Check the Debug Log for more information."));
+        return true;
+    }
+
+    switch (m_phase)
+    {
+        case PHASE_X:
+        case PHASE_Y:
+        {
+            bool const isX = m_phase == PHASE_X;
+
+            Sample s;
+            s.pos = currentLocation;
+            s.ao = ao;
+            m_samples.push_back(s);
+
+            size_t n = m_samples.size();
+            if (n >= 3)
+            {
+                const Sample& s0 = m_samples[n - 3];
+                const Sample& s1 = m_samples[n - 2];
+                const Sample& s2 = m_samples[n - 1];
+                double a0 = isX ? s0.ao.x : s0.ao.y;
+                double a1 = isX ? s1.ao.x : s1.ao.y;
+                double a2 = isX ? s2.ao.x : s2.ao.y;
+                double den = a1 - (a0 + a2) / 2.0;
+                // a move that did not happen leaves too little modulation
+                if (fabs(den) >= m_amplitude)
+                {
+                    PHD_Point d = s1.pos - (s0.pos + s2.pos) / 2.0;
+                    m_responses.push_back(d / den);
+                }
+            }
+
+            if ((int) m_responses.size() >= MIN_TRIPLES)
+            {
+                if (isX)
+                    m_respX = MedianResponse(m_responses);
+                else
+                    m_respY = MedianResponse(m_responses);
+            }
+
+            if ((int) n < AXIS_FRAMES)
+            {
+                int const a = isX ? ao.x : ao.y;
+                int const target = a > 0 ? -m_amplitude : m_amplitude;
+                MoveAoTo(isX ? wxPoint(target, 0) : wxPoint(0, target), ao);
+                break;
+            }
+
+            if (FinishAxis(isX ? &m_respX : &m_respY, isX ? "x" : "y"))
+                return true;
+
+            m_samples.clear();
+            m_responses.clear();
+
+            if (isX)
+            {
+                m_phase = PHASE_Y;
+                MoveAoTo(wxPoint(0, m_amplitude), ao);
+            }
+            else
+            {
+                m_phase = PHASE_RECENTER;
+                MoveAoTo(wxPoint(0, 0), ao);
+            }
+            break;
+        }
+
+        case PHASE_RECENTER:
+            if (ao != wxPoint(0, 0))
+            {
+                MoveAoTo(wxPoint(0, 0), ao);
+                break;
+            }
+            CompleteAo();
+            m_phase = PHASE_DONE;
+            break;
+
+        case PHASE_DONE:
+            break;
+    }
+
+    return false;
+}
+
+void ConcurrentCalibration::CompleteAo(void)
+{
+    // the angles are the directions the star moves for steps right and up,
+    // as in StepGuider::UpdateCalibrationState
+    Calibration cal;
+    cal.xAngle = m_respX.Angle();
+    cal.xRate = m_respX.Distance();
+    cal.yAngle = m_respY.Angle();
+    cal.yRate = m_respY.Distance();
+    cal.declination = UNKNOWN_DECLINATION;
+    cal.pierSide = PIER_SIDE_UNKNOWN;
+    cal.raGuideParity = cal.decGuideParity = GUIDE_PARITY_UNKNOWN;
+    cal.rotatorAngle = Rotator::RotatorPosition();
+    cal.binning = pCamera->EffectiveBinning();
+
+    Debug.Write(wxString::Format("Concurrent calibration: AO complete, x angle %.1f rate %.3f, y angle %.1f rate %.3f, %d frames\n",
+        degrees(cal.xAngle), cal.xRate, degrees(cal.yAngle), cal.yRate, m_frames));
+
+    CalibrationDetails details;
+    details.lastIssue = CI_None;
+    m_ao->SetCalibration(cal);
+    m_ao->SetCalibrationDetails(details, cal.xAngle, cal.yAngle, pCamera->EffectiveBinning());
+
+    pFrame->StatusMsg(_("AO calibration complete"));
+    EvtServer.NotifyCalibrationComplete(m_ao);
+}
+
+bool ConcurrentCalibration::Update(const PHD_Point& currentLocation)
+{
+    ++m_frames;
+
+    wxPoint const ao = m_ao->GetAoPos();
+
+    if (m_phase != PHASE_DONE && UpdateAo(currentLocation, ao))
+        return true;
+
+    if (m_scopeStarted && m_scope->IsCalibrated())
+    {
+        // the AO is still being calibrated
+        if (IsComplete())
+            LogComplete();
+        return false;
+    }
+
+    // the star position without the AO motion since the mount calibration
+    // started; skipped while the response of an axis that moved is unknown
+    if (!m_scopeStarted && !m_respX.IsValid())
+        return false;
+
+    wxPoint const ref = m_scopeStarted ? m_aoRef : ao;
+    int const dx = ao.x - ref.x;
+    int const dy = ao.y - ref.y;
+    if ((dx && !m_respX.IsValid()) || (dy && !m_respY.IsValid()))
+    {
+        Debug.Write("Concurrent calibration: AO y response not known yet, mount step skipped\n");
+        return false;
+    }
+
+    PHD_Point pos = currentLocation;
+    if (dx)
+        pos -= m_respX * dx;
+    if (dy)
+        pos -= m_respY * dy;
+
+    if (!m_scopeStarted)
+    {
+        m_aoRef = ao;
+        if (m_scope->BeginCalibration(pos))
+        {
+            Debug.Write("Concurrent calibration: mount BeginCalibration failed\n");
+            return true;
+        }
+        GuideLog.StartCalibration(m_scope);
+        EvtServer.NotifyStartCalibration(m_scope);
+        m_scopeStarted = true;
+        Debug.Write(wxString::Format("Concurrent calibration: mount calibration starts at frame %d\n", m_frames));
+    }
+
+    if (m_scope->UpdateCalibrationState(pos))
+        return true;
+
+    if (IsComplete())
+        LogComplete();
+
+    return false;
+}
+
+// The mount calibration wrote its own section of the guide log. The AO
+// section follows it rather than being interleaved with it.
+void ConcurrentCalibration::LogComplete(void)
+{
+    GuideLog.StartCalibration(m_ao);
+    GuideLog.CalibrationDirectComplete(m_ao, "Right", m_respX.Angle(), m_respX.Distance(), GUIDE_PARITY_UNKNOWN);
+    GuideLog.CalibrationDirectComplete(m_ao, "Up", m_respY.Angle(), m_respY.Distance(), GUIDE_PARITY_UNKNOWN);
+    GuideLog.CalibrationComplete(m_ao);
+    Debug.Write(wxString::Format("Concurrent calibration: complete, %d frames\n", m_frames));
+}
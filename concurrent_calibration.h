@@ -0,0 +1,104 @@
+/*
+ *  concurrent_calibration.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CONCURRENT_CALIBRATION_INCLUDED
+#define CONCURRENT_CALIBRATION_INCLUDED
+
+class StepGuider;
+
+// Calibrates an AO and the mount behind it in the same frames instead of one
+// after the other.
+//
+// The mount runs its own calibration, while the AO is stepped back and forth
+// between two positions a calibration step either side of center, first on
+// its x axis and then on y. Within a calibration leg the mount moves the star
+// at a nearly constant rate per frame, so for three consecutive frames
+//
+//     p1 - (p0 + p2) / 2 = R * (a1 - (a0 + a2) / 2)
+//
+// cancels the mount motion and gives R, the star motion per AO step; a is the
+// AO position of each frame. The median over the frames of an axis rejects the
+// triples that span a turn of the mount. The AO motion is then taken out of
+// the star position the mount calibration sees, using the known AO positions.
+//
+// The mount calibration starts once the AO x response is known, and is skipped
+// on the first frames of the y axis until its response is known too. It keeps
+// all of its own checks, Scope::SanityCheckCalibration included.
+class ConcurrentCalibration
+{
+    enum Phase
+    {
+        PHASE_X,
+        PHASE_Y,
+        PHASE_RECENTER,
+        PHASE_DONE,
+    };
+
+    struct Sample
+    {
+        PHD_Point pos;
+        wxPoint ao;
+    };
+
+    StepGuider *m_ao;
+    Mount *m_scope;
+    Phase m_phase;
+    int m_amplitude;                    // AO steps either side of center
+    std::vector<Sample> m_samples;      // frames of the current axis
+    std::vector<PHD_Point> m_responses; // per-step response of each triple of the current axis
+    PHD_Point m_respX;                  // star motion per AO step right, invalid until known
+    PHD_Point m_respY;                  // star motion per AO step up, invalid until known
+    bool m_scopeStarted;
+    wxPoint m_aoRef;                    // AO position when the mount calibration started
+    int m_frames;
+
+public:
+    ConcurrentCalibration(StepGuider *ao, Mount *scope);
+
+    // the profile option is set and both devices need calibrating
+    static bool Wanted(Mount *ao, Mount *scope);
+
+    // all return true on error
+    bool Begin(const PHD_Point& currentLocation);
+    bool Update(const PHD_Point& currentLocation);
+    bool IsComplete(void) const;
+
+private:
+    bool UpdateAo(const PHD_Point& currentLocation, const wxPoint& ao);
+    bool FinishAxis(PHD_Point *response, const char *axis);
+    void CompleteAo(void);
+    void LogComplete(void);
+    void MoveAoTo(const wxPoint& target, const wxPoint& ao);
+};
+
+#endif
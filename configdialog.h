@@ -51,11 +51,15 @@ enum BRAIN_CTRL_IDS
     AD_szAutoExposure,
     AD_szCameraTimeout,
     AD_szTimeLapse,
+    AD_szCadence,
+    AD_cbPipelinedCapture,
+    AD_cbLazyROI,
     AD_szPixelSize,
     AD_szGain,
     AD_szDelay,
     AD_szPort,
     AD_binning,
+    AD_szStackFrames,
     AD_cooler,
     AD_CAMERA_TAB_BOUNDARY,        // ------ end of camera tab controls
     AD_cbScaleImages,
@@ -68,6 +72,8 @@ enum BRAIN_CTRL_IDS
     AD_szCalibrationDuration,
     AD_cbReverseDecOnFlip,
     AD_cbAssumeOrthogonal,
+    AD_cbFastCalibration,
+    AD_cbShortCalExposures,
     AD_cbSlewDetection,
     AD_cbUseDecComp,
     AD_GUIDER_TAB_BOUNDARY,        // --------------- end of guiding tab controls
@@ -85,6 +91,7 @@ enum BRAIN_CTRL_IDS
     AD_cbBumpOnDither,
     AD_cbClearAOCalibration,
     AD_cbEnableAOGuiding,
+    AD_cbConcurrentCalibration,
     AD_cbRotatorReverse,
     AD_DEVICES_TAB_BOUNDARY         // ----------- end of devices tab controls
 };
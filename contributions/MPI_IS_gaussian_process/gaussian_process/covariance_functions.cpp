@@ -0,0 +1,41 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include "covariance_functions.h"
+#include <cmath>
+
+namespace covariance_functions {
+
+static const double kPi = 3.14159265358979323846;
+
+PeriodicSquareExponential::Parameters::Parameters()
+: se_sd(1.0),
+  se_length(1.0),
+  per_sd(1.0),
+  per_length(1.0),
+  period(1.0) {}
+
+PeriodicSquareExponential::PeriodicSquareExponential(const Parameters& params)
+: params_(params) {}
+
+Eigen::MatrixXd PeriodicSquareExponential::evaluate(
+    const Eigen::VectorXd& a,
+    const Eigen::VectorXd& b) const {
+  const double se_var = params_.se_sd * params_.se_sd;
+  const double per_var = params_.per_sd * params_.per_sd;
+  const double se_scale = -0.5 / (params_.se_length * params_.se_length);
+  const double per_scale = -2.0 / (params_.per_length * params_.per_length);
+  const double omega = kPi / params_.period;
+
+  Eigen::MatrixXd result(a.size(), b.size());
+  for (int col = 0; col < b.size(); ++col) {
+    for (int row = 0; row < a.size(); ++row) {
+      const double d = a[row] - b[col];
+      const double s = std::sin(omega * d);
+      result(row, col) = se_var * std::exp(se_scale * d * d) +
+                         per_var * std::exp(per_scale * s * s);
+    }
+  }
+  return result;
+}
+
+}  // namespace covariance_functions
@@ -0,0 +1,58 @@
+// Copyright (c) 2017 openphdguiding.org
+
+/*!@file
+ * @date    2017-03-02
+ *
+ * @brief
+ * Covariance functions for the Gaussian process toolbox.
+ *
+ */
+
+#ifndef GP_COVARIANCE_FUNCTIONS_H
+#define GP_COVARIANCE_FUNCTIONS_H
+
+#include <Eigen/Dense>
+
+namespace covariance_functions {
+
+/*!
+ * The sum of a squared exponential and a periodic kernel over time. The
+ * squared exponential models slow, aperiodic drift, the periodic part models
+ * the periodic error of a mount's worm gear.
+ *
+ * k(t, t') = se_sd^2 exp(-d^2 / (2 se_length^2))
+ *          + per_sd^2 exp(-2 sin^2(pi d / period) / per_length^2)
+ *
+ * with d = t - t'.
+ */
+class PeriodicSquareExponential {
+ public:
+  struct Parameters {
+    double se_sd;        //!< signal standard deviation of the aperiodic part
+    double se_length;    //!< length scale of the aperiodic part
+    double per_sd;       //!< signal standard deviation of the periodic part
+    double per_length;   //!< length scale of the periodic part, in radians
+    double period;       //!< period of the periodic part
+
+    Parameters();
+  };
+
+ private:
+  Parameters params_;
+
+ public:
+  explicit PeriodicSquareExponential(const Parameters& params);
+
+  const Parameters& parameters() const { return params_; }
+
+  /*!
+   * Returns the matrix of covariances between all pairs of points of a and b,
+   * of size a.size() x b.size().
+   */
+  Eigen::MatrixXd evaluate(const Eigen::VectorXd& a,
+                           const Eigen::VectorXd& b) const;
+};
+
+}  // namespace covariance_functions
+
+#endif  // GP_COVARIANCE_FUNCTIONS_H
@@ -0,0 +1,68 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include "gaussian_process.h"
+
+GP::GP(const covariance_functions::PeriodicSquareExponential& covariance,
+       double noise_variance)
+: covariance_(covariance),
+  noise_variance_(noise_variance),
+  data_locations_(),
+  alpha_(),
+  mean_(0.0) {}
+
+bool GP::infer(const Eigen::VectorXd& x, const Eigen::VectorXd& y) {
+  clear();
+
+  const int n = static_cast<int>(x.size());
+  if (n == 0 || y.size() != n) {
+    return false;
+  }
+
+  const double mean = y.mean();
+
+  Eigen::MatrixXd gram = covariance_.evaluate(x, x);
+  gram.diagonal().array() += noise_variance_;
+
+  /*
+   * With little noise and closely spaced points the Gram matrix can lose
+   * positive definiteness to rounding, so a small jitter is added to the
+   * diagonal before giving up.
+   */
+  Eigen::LLT<Eigen::MatrixXd> chol(gram);
+  if (chol.info() != Eigen::Success) {
+    gram.diagonal().array() += 1e-6 * gram.diagonal().mean();
+    chol.compute(gram);
+    if (chol.info() != Eigen::Success) {
+      return false;
+    }
+  }
+
+  alpha_ = chol.solve((y.array() - mean).matrix());
+  data_locations_ = x;
+  mean_ = mean;
+  return true;
+}
+
+double GP::predict(double x) const {
+  if (data_locations_.size() == 0) {
+    return 0.0;
+  }
+  Eigen::VectorXd location(1);
+  location[0] = x;
+  return predict(location)[0];
+}
+
+Eigen::VectorXd GP::predict(const Eigen::VectorXd& x) const {
+  if (data_locations_.size() == 0) {
+    return Eigen::VectorXd::Zero(x.size());
+  }
+  Eigen::VectorXd result = covariance_.evaluate(x, data_locations_) * alpha_;
+  result.array() += mean_;
+  return result;
+}
+
+void GP::clear() {
+  data_locations_.resize(0);
+  alpha_.resize(0);
+  mean_ = 0.0;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2017 openphdguiding.org
+
+/*!@file
+ * @date    2017-03-02
+ *
+ * @brief
+ * Gaussian process regression in one input dimension.
+ *
+ */
+
+#ifndef GP_GAUSSIAN_PROCESS_H
+#define GP_GAUSSIAN_PROCESS_H
+
+#include <Eigen/Dense>
+#include "gaussian_process/covariance_functions.h"
+
+/*!
+ * A Gaussian process with a constant mean, estimated as the mean of the
+ * data, and a PeriodicSquareExponential covariance.
+ *
+ * Usage:
+ * @code
+ *  GP gp(covariance_functions::PeriodicSquareExponential(params), 0.01);
+ *  gp.infer(timestamps, measurements);
+ *  double prediction = gp.predict(t);
+ * @endcode
+ *
+ * infer() costs O(n^3) for n data points and predict() O(n) per prediction,
+ * so the caller bounds the cost by bounding the number of points.
+ */
+class GP {
+ private:
+  covariance_functions::PeriodicSquareExponential covariance_;
+  double noise_variance_;
+
+  Eigen::VectorXd data_locations_;
+  Eigen::VectorXd alpha_;     //!< (K + noise I)^-1 (y - mean)
+  double mean_;
+
+ public:
+  GP(const covariance_functions::PeriodicSquareExponential& covariance,
+     double noise_variance);
+
+  /*!
+   * Conditions the process on the data points (x, y), replacing any previous
+   * data. The points do not have to be in order.
+   *
+   * @return false if the covariance matrix could not be factorized, in which
+   * case the process is left without data.
+   */
+  bool infer(const Eigen::VectorXd& x, const Eigen::VectorXd& y);
+
+  //! Returns the posterior mean at x, or 0 if there is no data.
+  double predict(double x) const;
+
+  //! Returns the posterior mean at each of the locations x.
+  Eigen::VectorXd predict(const Eigen::VectorXd& x) const;
+
+  //! Discards the data.
+  void clear();
+
+  int size() const { return static_cast<int>(data_locations_.size()); }
+};
+
+#endif  // GP_GAUSSIAN_PROCESS_H
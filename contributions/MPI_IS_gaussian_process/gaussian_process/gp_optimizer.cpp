@@ -0,0 +1,229 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include "gp_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace gp_optimizer {
+
+static const double kPi = 3.14159265358979323846;
+
+Hyperparameters::Hyperparameters()
+: covariance(),
+  noise_sd(1.0) {}
+
+Eigen::VectorXd toLogVector(const Hyperparameters& hyper) {
+  Eigen::VectorXd theta(NUM_HYPERPARAMETERS);
+  theta << std::log(hyper.covariance.se_sd),
+           std::log(hyper.covariance.se_length),
+           std::log(hyper.covariance.per_sd),
+           std::log(hyper.covariance.per_length),
+           std::log(hyper.covariance.period),
+           std::log(hyper.noise_sd);
+  return theta;
+}
+
+Hyperparameters fromLogVector(const Eigen::VectorXd& theta) {
+  Hyperparameters hyper;
+  hyper.covariance.se_sd = std::exp(theta[0]);
+  hyper.covariance.se_length = std::exp(theta[1]);
+  hyper.covariance.per_sd = std::exp(theta[2]);
+  hyper.covariance.per_length = std::exp(theta[3]);
+  hyper.covariance.period = std::exp(theta[4]);
+  hyper.noise_sd = std::exp(theta[5]);
+  return hyper;
+}
+
+double negativeLogLikelihood(const Eigen::VectorXd& theta,
+                             const Eigen::VectorXd& x,
+                             const Eigen::VectorXd& y,
+                             Eigen::VectorXd* gradient) {
+  const int n = static_cast<int>(x.size());
+  const Hyperparameters hyper = fromLogVector(theta);
+  const double se_var = hyper.covariance.se_sd * hyper.covariance.se_sd;
+  const double se_l2 = hyper.covariance.se_length * hyper.covariance.se_length;
+  const double per_var = hyper.covariance.per_sd * hyper.covariance.per_sd;
+  const double per_l2 = hyper.covariance.per_length * hyper.covariance.per_length;
+  const double omega = kPi / hyper.covariance.period;
+  const double noise_var = hyper.noise_sd * hyper.noise_sd;
+
+  // the Gram matrix and, for the gradient, the derivatives of its entries
+  Eigen::MatrixXd gram(n, n);
+  std::vector<Eigen::MatrixXd> derivatives;
+  if (gradient) {
+    derivatives.assign(NUM_HYPERPARAMETERS - 1, Eigen::MatrixXd(n, n));
+  }
+  for (int col = 0; col < n; ++col) {
+    for (int row = col; row < n; ++row) {
+      const double d = x[row] - x[col];
+      const double u = omega * d;
+      const double s = std::sin(u);
+      const double k_se = se_var * std::exp(-0.5 * d * d / se_l2);
+      const double k_per = per_var * std::exp(-2.0 * s * s / per_l2);
+      gram(row, col) = gram(col, row) = k_se + k_per;
+      if (gradient) {
+        const double dk[NUM_HYPERPARAMETERS - 1] = {
+          2.0 * k_se,
+          k_se * d * d / se_l2,
+          2.0 * k_per,
+          k_per * 4.0 * s * s / per_l2,
+          k_per * 2.0 * u * std::sin(2.0 * u) / per_l2,
+        };
+        for (int i = 0; i < NUM_HYPERPARAMETERS - 1; ++i) {
+          derivatives[i](row, col) = derivatives[i](col, row) = dk[i];
+        }
+      }
+    }
+  }
+  gram.diagonal().array() += noise_var;
+
+  Eigen::LLT<Eigen::MatrixXd> chol(gram);
+  if (chol.info() != Eigen::Success) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  const Eigen::VectorXd centered = (y.array() - y.mean()).matrix();
+  const Eigen::VectorXd alpha = chol.solve(centered);
+  const Eigen::MatrixXd l = chol.matrixL();
+  const double log_det = 2.0 * l.diagonal().array().log().sum();
+  const double nll = 0.5 * centered.dot(alpha) + 0.5 * log_det +
+                     0.5 * n * std::log(2.0 * kPi);
+
+  if (gradient) {
+    // d nll / d theta_i = 0.5 tr((K^-1 - alpha alpha^T) dK_i)
+    const Eigen::MatrixXd w =
+        chol.solve(Eigen::MatrixXd::Identity(n, n)) - alpha * alpha.transpose();
+    gradient->resize(NUM_HYPERPARAMETERS);
+    for (int i = 0; i < NUM_HYPERPARAMETERS - 1; ++i) {
+      (*gradient)[i] = 0.5 * w.cwiseProduct(derivatives[i]).sum();
+    }
+    (*gradient)[NUM_HYPERPARAMETERS - 1] = w.trace() * noise_var;
+  }
+
+  return nll;
+}
+
+namespace {
+
+// The objective with the prior, restricted to the free hyperparameters.
+struct Objective {
+  const Eigen::VectorXd& x;
+  const Eigen::VectorXd& y;
+  const Eigen::VectorXd& prior_mean;
+  const Eigen::VectorXi& fixed;
+  double prior_precision;
+
+  Objective(const Eigen::VectorXd& x_, const Eigen::VectorXd& y_,
+            const Eigen::VectorXd& prior_mean_, const Eigen::VectorXi& fixed_,
+            double prior_sd)
+  : x(x_), y(y_), prior_mean(prior_mean_), fixed(fixed_),
+    prior_precision(1.0 / (prior_sd * prior_sd)) {}
+
+  double operator()(const Eigen::VectorXd& theta, Eigen::VectorXd* gradient) const {
+    double value = negativeLogLikelihood(theta, x, y, gradient);
+    const Eigen::VectorXd offset = theta - prior_mean;
+    value += 0.5 * prior_precision * offset.squaredNorm();
+    *gradient += prior_precision * offset;
+    for (int i = 0; i < fixed.size(); ++i) {
+      if (fixed[i]) {
+        (*gradient)[i] = 0.0;
+      }
+    }
+    return value;
+  }
+};
+
+}  // namespace
+
+Result optimize(const Hyperparameters& start,
+                const Eigen::VectorXd& x,
+                const Eigen::VectorXd& y,
+                const Eigen::VectorXi& fixed,
+                double prior_sd,
+                int max_iterations,
+                const std::function<bool()>& keep_going) {
+  const Eigen::VectorXd theta0 = toLogVector(start);
+  Objective objective(x, y, theta0, fixed, prior_sd);
+
+  Result result;
+  result.iterations = 0;
+  result.converged = false;
+
+  Eigen::VectorXd theta = theta0;
+  Eigen::VectorXd gradient(NUM_HYPERPARAMETERS);
+  double value = objective(theta, &gradient);
+  if (!(value < std::numeric_limits<double>::infinity())) {
+    result.hyperparameters = start;
+    result.negative_log_likelihood = value;
+    return result;
+  }
+
+  Eigen::MatrixXd inverse_hessian =
+      Eigen::MatrixXd::Identity(NUM_HYPERPARAMETERS, NUM_HYPERPARAMETERS);
+
+  const double kGradientTolerance = 1e-5;
+  const double kValueTolerance = 1e-9;
+  Eigen::VectorXd next_gradient(NUM_HYPERPARAMETERS);
+
+  while (result.iterations < max_iterations && keep_going()) {
+    ++result.iterations;
+
+    Eigen::VectorXd direction = -inverse_hessian * gradient;
+    double slope = gradient.dot(direction);
+    if (slope >= 0.0) {
+      // not a descent direction: restart from steepest descent
+      inverse_hessian.setIdentity();
+      direction = -gradient;
+      slope = -gradient.squaredNorm();
+    }
+
+    // backtracking line search with the Armijo condition, with steps of at
+    // most a factor e in any hyperparameter
+    double step = std::min(1.0, 1.0 / direction.cwiseAbs().maxCoeff());
+    double next_value = std::numeric_limits<double>::infinity();
+    Eigen::VectorXd next_theta;
+    for (int i = 0; i < 30; ++i) {
+      next_theta = theta + step * direction;
+      next_value = objective(next_theta, &next_gradient);
+      if (next_value <= value + 1e-4 * step * slope) {
+        break;
+      }
+      step *= 0.5;
+    }
+    if (!(next_value <= value)) {
+      // no progress along the direction: at a minimum up to rounding
+      result.converged = gradient.norm() < 1e-2;
+      break;
+    }
+
+    const Eigen::VectorXd s = next_theta - theta;
+    const Eigen::VectorXd g = next_gradient - gradient;
+    const double change = value - next_value;
+
+    theta = next_theta;
+    gradient = next_gradient;
+    value = next_value;
+
+    if (gradient.norm() < kGradientTolerance ||
+        change < kValueTolerance * std::max(1.0, std::abs(value))) {
+      result.converged = true;
+      break;
+    }
+
+    const double sg = s.dot(g);
+    if (sg > 1e-12) {
+      // BFGS update of the inverse Hessian approximation
+      const Eigen::VectorXd hg = inverse_hessian * g;
+      inverse_hessian += ((sg + g.dot(hg)) / (sg * sg)) * (s * s.transpose()) -
+                         (hg * s.transpose() + s * hg.transpose()) / sg;
+    }
+  }
+
+  result.hyperparameters = fromLogVector(theta);
+  result.negative_log_likelihood = negativeLogLikelihood(theta, x, y, 0);
+  return result;
+}
+
+}  // namespace gp_optimizer
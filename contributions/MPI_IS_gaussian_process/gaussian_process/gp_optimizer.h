@@ -0,0 +1,76 @@
+// Copyright (c) 2017 openphdguiding.org
+
+/*!@file
+ * @date    2017-03-16
+ *
+ * @brief
+ * Fitting the hyperparameters of a Gaussian process to data.
+ *
+ */
+
+#ifndef GP_OPTIMIZER_H
+#define GP_OPTIMIZER_H
+
+#include <Eigen/Dense>
+#include <functional>
+#include "gaussian_process/covariance_functions.h"
+
+namespace gp_optimizer {
+
+//! The hyperparameters of a GP with a PeriodicSquareExponential covariance.
+struct Hyperparameters {
+  covariance_functions::PeriodicSquareExponential::Parameters covariance;
+  double noise_sd;
+
+  Hyperparameters();
+};
+
+enum { NUM_HYPERPARAMETERS = 6 };
+
+/*!
+ * The hyperparameters as a vector of their logarithms, in the order se_sd,
+ * se_length, per_sd, per_length, period, noise_sd. The optimizer works on
+ * the logarithms, which keeps all of them positive.
+ */
+Eigen::VectorXd toLogVector(const Hyperparameters& hyper);
+Hyperparameters fromLogVector(const Eigen::VectorXd& theta);
+
+/*!
+ * Returns the negative log marginal likelihood of the data (x, y) under a GP
+ * with a constant mean, the mean of y, and the hyperparameters exp(theta).
+ * If gradient is not null it is set to the derivatives with respect to
+ * theta. Returns infinity if the covariance matrix is not positive definite.
+ */
+double negativeLogLikelihood(const Eigen::VectorXd& theta,
+                             const Eigen::VectorXd& x,
+                             const Eigen::VectorXd& y,
+                             Eigen::VectorXd* gradient);
+
+struct Result {
+  Hyperparameters hyperparameters;
+  double negative_log_likelihood;
+  int iterations;
+  bool converged;   //!< false if stopped by max_iterations or keep_going
+};
+
+/*!
+ * Fits the hyperparameters to the data by minimizing the negative log
+ * marginal likelihood with BFGS, starting from start. A log-normal prior
+ * centered on start, with standard deviation prior_sd in log space, keeps
+ * the fit from running off with little data.
+ *
+ * Hyperparameters whose entry in fixed is nonzero are held at their start
+ * values. keep_going is called before each iteration, the fit stops early
+ * if it returns false.
+ */
+Result optimize(const Hyperparameters& start,
+                const Eigen::VectorXd& x,
+                const Eigen::VectorXd& y,
+                const Eigen::VectorXi& fixed,
+                double prior_sd,
+                int max_iterations,
+                const std::function<bool()>& keep_going);
+
+}  // namespace gp_optimizer
+
+#endif  // GP_OPTIMIZER_H
@@ -0,0 +1,155 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include "incremental_gp.h"
+#include <algorithm>
+#include <cmath>
+
+IncrementalGP::IncrementalGP(
+    const covariance_functions::PeriodicSquareExponential& covariance,
+    double noise_variance,
+    int capacity)
+: covariance_(covariance),
+  noise_variance_(noise_variance),
+  capacity_(capacity > 0 ? capacity : 1),
+  size_(0),
+  appends_since_factorization_(0),
+  chol_(capacity_, capacity_),
+  x_(capacity_),
+  y_(capacity_),
+  alpha_(),
+  mean_(0.0),
+  dirty_(false) {}
+
+void IncrementalGP::append(double x, double y) {
+  if (size_ == capacity_) {
+    removeOldest();
+  }
+
+  const int n = size_;
+  x_[n] = x;
+  y_[n] = y;
+  dirty_ = true;
+
+  /*
+   * The rounding errors of the updates add up, so the factor is recomputed
+   * from scratch once per window length, which keeps the amortized cost at
+   * O(n^2) per point.
+   */
+  if (++appends_since_factorization_ >= capacity_) {
+    size_ = n + 1;
+    factorize();
+    return;
+  }
+
+  Eigen::VectorXd location(1);
+  location[0] = x;
+  Eigen::VectorXd k = covariance_.evaluate(x_.head(n), location).col(0);
+  const double kxx = covariance_.evaluate(location, location)(0, 0) +
+                     noise_variance_;
+
+  // new row of the factor: [l^T d] with L l = k and d^2 = kxx - l^T l
+  Eigen::VectorXd l = chol_.topLeftCorner(n, n).triangularView<Eigen::Lower>().solve(k);
+  const double d2 = kxx - l.squaredNorm();
+
+  size_ = n + 1;
+  if (!(d2 > 1e-12 * kxx)) {
+    factorize();
+    return;
+  }
+
+  chol_.block(n, 0, 1, n) = l.transpose();
+  chol_(n, n) = std::sqrt(d2);
+}
+
+void IncrementalGP::removeOldest() {
+  const int n = size_ - 1;
+
+  /*
+   * With the factor partitioned as [l11 0; l21 L22], the factor of the Gram
+   * matrix without its first row and column is the rank-one update of L22
+   * by l21.
+   */
+  Eigen::VectorXd v = chol_.block(1, 0, n, 1);
+  Eigen::MatrixXd l22 = chol_.block(1, 1, n, n);
+
+  for (int k = 0; k < n; ++k) {
+    const double lkk = l22(k, k);
+    const double r = std::sqrt(lkk * lkk + v[k] * v[k]);
+    const double c = r / lkk;
+    const double s = v[k] / lkk;
+    l22(k, k) = r;
+    const int rest = n - k - 1;
+    if (rest > 0) {
+      l22.block(k + 1, k, rest, 1) =
+          (l22.block(k + 1, k, rest, 1) + s * v.segment(k + 1, rest)) / c;
+      v.segment(k + 1, rest) =
+          c * v.segment(k + 1, rest) - s * l22.block(k + 1, k, rest, 1);
+    }
+  }
+
+  chol_.topLeftCorner(n, n) = l22;
+  x_.head(n) = x_.segment(1, n).eval();
+  y_.head(n) = y_.segment(1, n).eval();
+  size_ = n;
+  dirty_ = true;
+}
+
+void IncrementalGP::factorize() {
+  appends_since_factorization_ = 0;
+  const int n = size_;
+
+  Eigen::MatrixXd gram = covariance_.evaluate(x_.head(n), x_.head(n));
+  gram.diagonal().array() += noise_variance_;
+
+  Eigen::LLT<Eigen::MatrixXd> chol(gram);
+  if (chol.info() != Eigen::Success) {
+    gram.diagonal().array() += 1e-6 * gram.diagonal().mean();
+    chol.compute(gram);
+  }
+  chol_.topLeftCorner(n, n) = chol.matrixL();
+  dirty_ = true;
+}
+
+void IncrementalGP::update() {
+  const int n = size_;
+  mean_ = y_.head(n).mean();
+  alpha_ = (y_.head(n).array() - mean_).matrix();
+  chol_.topLeftCorner(n, n).triangularView<Eigen::Lower>().solveInPlace(alpha_);
+  chol_.topLeftCorner(n, n).triangularView<Eigen::Lower>().transpose().solveInPlace(alpha_);
+  dirty_ = false;
+}
+
+double IncrementalGP::predict(double x) {
+  if (size_ == 0) {
+    return 0.0;
+  }
+  if (dirty_) {
+    update();
+  }
+  Eigen::VectorXd location(1);
+  location[0] = x;
+  return mean_ + (covariance_.evaluate(location, x_.head(size_)) * alpha_)(0, 0);
+}
+
+void IncrementalGP::setCovariance(
+    const covariance_functions::PeriodicSquareExponential& covariance,
+    double noise_variance) {
+  covariance_ = covariance;
+  noise_variance_ = noise_variance;
+  if (size_ > 0) {
+    factorize();
+  }
+}
+
+void IncrementalGP::latest(int n, Eigen::VectorXd* x, Eigen::VectorXd* y) const {
+  n = std::min(n, size_);
+  *x = x_.segment(size_ - n, n);
+  *y = y_.segment(size_ - n, n);
+}
+
+void IncrementalGP::clear() {
+  size_ = 0;
+  appends_since_factorization_ = 0;
+  dirty_ = false;
+  mean_ = 0.0;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2017 openphdguiding.org
+
+/*!@file
+ * @date    2017-03-09
+ *
+ * @brief
+ * Gaussian process regression over a sliding window of data points, updated
+ * one point at a time.
+ *
+ */
+
+#ifndef GP_INCREMENTAL_GP_H
+#define GP_INCREMENTAL_GP_H
+
+#include <Eigen/Dense>
+#include "gaussian_process/covariance_functions.h"
+
+/*!
+ * An exact Gaussian process over the most recent data points, like GP, but
+ * the Cholesky factor of the Gram matrix is kept between calls. A new point
+ * extends the factor by one row and, once the window is full, the oldest
+ * point is dropped with a rank-one update, so each append costs O(n^2)
+ * instead of the O(n^3) of a full GP::infer.
+ *
+ * Usage:
+ * @code
+ *  IncrementalGP gp(covariance, noise_variance, 200);
+ *  for (...) {
+ *    gp.append(t, y);
+ *    double prediction = gp.predict(t + dt);
+ *  }
+ * @endcode
+ */
+class IncrementalGP {
+ private:
+  covariance_functions::PeriodicSquareExponential covariance_;
+  double noise_variance_;
+  int capacity_;
+  int size_;
+  int appends_since_factorization_;
+
+  Eigen::MatrixXd chol_;      //!< lower Cholesky factor, top-left size_ x size_
+  Eigen::VectorXd x_;         //!< data locations, oldest first
+  Eigen::VectorXd y_;
+  Eigen::VectorXd alpha_;     //!< (K + noise I)^-1 (y - mean), valid if !dirty_
+  double mean_;
+  bool dirty_;
+
+  void removeOldest();
+  void factorize();
+  void update();
+
+ public:
+  IncrementalGP(const covariance_functions::PeriodicSquareExponential& covariance,
+                double noise_variance,
+                int capacity);
+
+  /*!
+   * Adds a data point, dropping the oldest one if the window is full.
+   */
+  void append(double x, double y);
+
+  //! Returns the posterior mean at x, or 0 if there is no data.
+  double predict(double x);
+
+  //! Discards the data.
+  void clear();
+
+  /*!
+   * Replaces the covariance and noise variance, keeping the data. This
+   * factorizes the Gram matrix from scratch.
+   */
+  void setCovariance(const covariance_functions::PeriodicSquareExponential& covariance,
+                     double noise_variance);
+
+  //! Copies the latest n data points, oldest first, or all of them if fewer.
+  void latest(int n, Eigen::VectorXd* x, Eigen::VectorXd* y) const;
+
+  int size() const { return size_; }
+  int capacity() const { return capacity_; }
+};
+
+#endif  // GP_INCREMENTAL_GP_H
@@ -0,0 +1,133 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include "sparse_gp.h"
+#include <algorithm>
+
+SparseGP::SparseGP(
+    const covariance_functions::PeriodicSquareExponential& covariance,
+    double noise_variance,
+    const Eigen::VectorXd& inducing_locations,
+    int capacity)
+: covariance_(covariance),
+  noise_variance_(noise_variance),
+  inducing_(inducing_locations),
+  kuu_(covariance.evaluate(inducing_locations, inducing_locations)),
+  capacity_(capacity > 0 ? capacity : 1),
+  x_(capacity_),
+  y_(capacity_),
+  first_(0),
+  size_(0),
+  drops_since_recompute_(0),
+  a_(Eigen::MatrixXd::Zero(inducing_locations.size(), inducing_locations.size())),
+  b_(Eigen::VectorXd::Zero(inducing_locations.size())),
+  s_(Eigen::VectorXd::Zero(inducing_locations.size())),
+  sum_y_(0.0),
+  weights_(),
+  mean_(0.0),
+  dirty_(false) {}
+
+void SparseGP::accumulate(double x, double y, double sign) {
+  Eigen::VectorXd location(1);
+  location[0] = x;
+  Eigen::VectorXd k = covariance_.evaluate(inducing_, location).col(0);
+
+  a_.selfadjointView<Eigen::Lower>().rankUpdate(k, sign);
+  b_ += (sign * y) * k;
+  s_ += sign * k;
+  sum_y_ += sign * y;
+}
+
+void SparseGP::recompute() {
+  drops_since_recompute_ = 0;
+  a_.setZero();
+  b_.setZero();
+  s_.setZero();
+  sum_y_ = 0.0;
+  for (int i = 0; i < size_; ++i) {
+    const int j = (first_ + i) % capacity_;
+    accumulate(x_[j], y_[j], 1.0);
+  }
+}
+
+void SparseGP::append(double x, double y) {
+  if (size_ == capacity_) {
+    accumulate(x_[first_], y_[first_], -1.0);
+    first_ = (first_ + 1) % capacity_;
+    --size_;
+
+    // subtracting leaves rounding errors behind, so once per window length
+    // the sums are rebuilt from the stored points
+    if (++drops_since_recompute_ >= capacity_) {
+      recompute();
+    }
+  }
+
+  const int j = (first_ + size_) % capacity_;
+  x_[j] = x;
+  y_[j] = y;
+  ++size_;
+  accumulate(x, y, 1.0);
+  dirty_ = true;
+}
+
+double SparseGP::predict(double x) {
+  if (size_ == 0) {
+    return 0.0;
+  }
+
+  if (dirty_) {
+    /*
+     * Posterior mean of the deterministic training conditional:
+     * mean + k_u(x)^T (noise Kuu + A)^-1 (b - mean s)
+     */
+    mean_ = sum_y_ / size_;
+    Eigen::MatrixXd m = a_.selfadjointView<Eigen::Lower>();
+    m += noise_variance_ * kuu_;
+    m.diagonal().array() += 1e-9 * m.diagonal().mean();
+    weights_ = m.llt().solve(b_ - mean_ * s_);
+    dirty_ = false;
+  }
+
+  Eigen::VectorXd location(1);
+  location[0] = x;
+  return mean_ + (covariance_.evaluate(location, inducing_) * weights_)(0, 0);
+}
+
+void SparseGP::setCovariance(
+    const covariance_functions::PeriodicSquareExponential& covariance,
+    double noise_variance,
+    const Eigen::VectorXd& inducing_locations) {
+  const int m = static_cast<int>(inducing_locations.size());
+  covariance_ = covariance;
+  noise_variance_ = noise_variance;
+  inducing_ = inducing_locations;
+  kuu_ = covariance_.evaluate(inducing_, inducing_);
+  a_ = Eigen::MatrixXd::Zero(m, m);
+  b_ = Eigen::VectorXd::Zero(m);
+  s_ = Eigen::VectorXd::Zero(m);
+  recompute();
+  dirty_ = true;
+}
+
+void SparseGP::latest(int n, Eigen::VectorXd* x, Eigen::VectorXd* y) const {
+  n = std::min(n, size_);
+  x->resize(n);
+  y->resize(n);
+  for (int i = 0; i < n; ++i) {
+    const int j = (first_ + size_ - n + i) % capacity_;
+    (*x)[i] = x_[j];
+    (*y)[i] = y_[j];
+  }
+}
+
+void SparseGP::clear() {
+  first_ = 0;
+  size_ = 0;
+  drops_since_recompute_ = 0;
+  a_.setZero();
+  b_.setZero();
+  s_.setZero();
+  sum_y_ = 0.0;
+  mean_ = 0.0;
+  dirty_ = false;
+}
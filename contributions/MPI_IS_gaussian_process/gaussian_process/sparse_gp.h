@@ -0,0 +1,89 @@
+// Copyright (c) 2017 openphdguiding.org
+
+/*!@file
+ * @date    2017-03-09
+ *
+ * @brief
+ * Sparse Gaussian process regression with inducing points over a long
+ * sliding window of data points.
+ *
+ */
+
+#ifndef GP_SPARSE_GP_H
+#define GP_SPARSE_GP_H
+
+#include <Eigen/Dense>
+#include <vector>
+#include "gaussian_process/covariance_functions.h"
+
+/*!
+ * A Gaussian process approximated through m inducing points (the
+ * deterministic training conditional approximation). The data only enter
+ * through the sums of k_u(x) k_u(x)^T, k_u(x) y and k_u(x) over the window,
+ * where k_u(x) are the covariances of x with the inducing points, so adding
+ * or dropping a point costs O(m^2) and a prediction O(m^3), both
+ * independent of the length of the window.
+ *
+ * With the inducing points spread over one period and a purely periodic
+ * covariance, the approximation holds over any length of time, which is
+ * what long windows are for.
+ */
+class SparseGP {
+ private:
+  covariance_functions::PeriodicSquareExponential covariance_;
+  double noise_variance_;
+  Eigen::VectorXd inducing_;
+  Eigen::MatrixXd kuu_;
+
+  int capacity_;
+  std::vector<double> x_;     //!< ring of data locations, for dropping them
+  std::vector<double> y_;
+  int first_;
+  int size_;
+  int drops_since_recompute_;
+
+  Eigen::MatrixXd a_;         //!< sum of k_u(x) k_u(x)^T, lower triangle
+  Eigen::VectorXd b_;         //!< sum of k_u(x) y
+  Eigen::VectorXd s_;         //!< sum of k_u(x)
+  double sum_y_;
+
+  Eigen::VectorXd weights_;   //!< valid if !dirty_
+  double mean_;
+  bool dirty_;
+
+  void accumulate(double x, double y, double sign);
+  void recompute();
+
+ public:
+  SparseGP(const covariance_functions::PeriodicSquareExponential& covariance,
+           double noise_variance,
+           const Eigen::VectorXd& inducing_locations,
+           int capacity);
+
+  /*!
+   * Adds a data point, dropping the oldest one if the window is full.
+   */
+  void append(double x, double y);
+
+  //! Returns the posterior mean at x, or 0 if there is no data.
+  double predict(double x);
+
+  //! Discards the data.
+  void clear();
+
+  /*!
+   * Replaces the covariance, noise variance and inducing points, keeping the
+   * data. This costs O(n m^2) for n stored points.
+   */
+  void setCovariance(const covariance_functions::PeriodicSquareExponential& covariance,
+                     double noise_variance,
+                     const Eigen::VectorXd& inducing_locations);
+
+  //! Copies the latest n data points, oldest first, or all of them if fewer.
+  void latest(int n, Eigen::VectorXd* x, Eigen::VectorXd* y) const;
+
+  int size() const { return size_; }
+  int capacity() const { return capacity_; }
+};
+
+#endif  // GP_SPARSE_GP_H
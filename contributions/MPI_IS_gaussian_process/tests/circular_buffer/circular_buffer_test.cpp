@@ -130,6 +130,82 @@ TEST(CircularBufferTest, getEigenVectorTest) {
   EXPECT_EQ((*vec)(0), buffer.get(0));
 }
 
+TEST(CircularBufferTest, ViewTest) {
+  CircularDoubleBuffer buffer(4);
+  EXPECT_EQ(buffer.getView().size(), 0);
+
+  buffer.append(1);
+  buffer.append(2);
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_EQ(buffer.getView().size(), 2);
+  EXPECT_EQ(buffer.getView()[1], 2);
+
+  for (int i = 3; i <= 6; ++i) {
+    buffer.append(i);
+  }
+
+  // storage order, without copying
+  CircularDoubleBuffer::ConstView view = buffer.getView();
+  EXPECT_EQ(view.size(), 4);
+  EXPECT_EQ(view.data(), buffer.getEigenVector()->data());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(view[i], buffer.get(i));
+  }
+}
+
+TEST(CircularBufferTest, SegmentTest) {
+  CircularDoubleBuffer buffer(5);
+  buffer.append(1);
+  buffer.append(2);
+  buffer.append(3);
+
+  EXPECT_EQ(buffer.getSegment(0).size(), 3);
+  EXPECT_EQ(buffer.getSegment(1).size(), 0);
+
+  buffer.append(4);
+  buffer.append(5);
+  buffer.append(6);
+  buffer.append(7);
+
+  CircularDoubleBuffer::ConstView first = buffer.getSegment(0);
+  CircularDoubleBuffer::ConstView second = buffer.getSegment(1);
+  EXPECT_EQ(first.size() + second.size(), 5);
+
+  // the segments together hold 3..7, oldest first
+  double expected = 3;
+  for (int i = 0; i < first.size(); ++i) {
+    EXPECT_EQ(first[i], expected++);
+  }
+  for (int i = 0; i < second.size(); ++i) {
+    EXPECT_EQ(second[i], expected++);
+  }
+}
+
+TEST(CircularBufferTest, OrderedViewTest) {
+  CircularDoubleBuffer buffer(4, true);
+  buffer.append(1);
+  buffer.append(2);
+
+  CircularDoubleBuffer::ConstView view = buffer.getOrderedView();
+  EXPECT_EQ(view.size(), 2);
+  EXPECT_EQ(view[0], 1);
+  EXPECT_EQ(view[1], 2);
+
+  for (int i = 3; i <= 9; ++i) {
+    buffer.append(i);
+    CircularDoubleBuffer::ConstView ordered = buffer.getOrderedView();
+    int n = i < 4 ? i : 4;
+    ASSERT_EQ(ordered.size(), n);
+    for (int j = 0; j < n; ++j) {
+      EXPECT_EQ(ordered[j], i - n + 1 + j);
+    }
+  }
+
+  // the storage-order accessors are unaffected
+  EXPECT_EQ(buffer.getView().size(), 4);
+  EXPECT_EQ(buffer.getLastElement(), 9);
+}
+
 int main(int argc, char ** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
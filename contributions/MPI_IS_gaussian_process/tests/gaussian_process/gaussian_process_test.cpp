@@ -0,0 +1,253 @@
+// Copyright (c) 2017 openphdguiding.org
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include "gaussian_process/gaussian_process.h"
+#include "gaussian_process/gp_optimizer.h"
+#include "gaussian_process/incremental_gp.h"
+#include "gaussian_process/sparse_gp.h"
+
+namespace {
+
+covariance_functions::PeriodicSquareExponential::Parameters test_parameters() {
+  covariance_functions::PeriodicSquareExponential::Parameters params;
+  params.se_sd = 0.1;
+  params.se_length = 500.0;
+  params.per_sd = 1.0;
+  params.per_length = 1.0;
+  params.period = 100.0;
+  return params;
+}
+
+const double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+TEST(CovarianceFunctionsTest, symmetricTest) {
+  covariance_functions::PeriodicSquareExponential cov(test_parameters());
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(10, 0.0, 90.0);
+  Eigen::MatrixXd k = cov.evaluate(x, x);
+
+  EXPECT_EQ(k, k.transpose());
+  for (int i = 0; i < x.size(); ++i) {
+    EXPECT_DOUBLE_EQ(k(i, i), 0.1 * 0.1 + 1.0);
+  }
+}
+
+TEST(CovarianceFunctionsTest, periodicTest) {
+  covariance_functions::PeriodicSquareExponential::Parameters params =
+      test_parameters();
+  params.se_sd = 0.0;
+  covariance_functions::PeriodicSquareExponential cov(params);
+  Eigen::VectorXd a(1), b(1);
+  a << 3.0;
+  b << 3.0 + 2 * params.period;
+
+  EXPECT_NEAR(cov.evaluate(a, b)(0, 0), 1.0, 1e-12);
+}
+
+TEST(GaussianProcessTest, noDataTest) {
+  GP gp(covariance_functions::PeriodicSquareExponential(test_parameters()),
+        0.01);
+  EXPECT_EQ(gp.size(), 0);
+  EXPECT_EQ(gp.predict(5.0), 0.0);
+}
+
+TEST(GaussianProcessTest, interpolationTest) {
+  GP gp(covariance_functions::PeriodicSquareExponential(test_parameters()),
+        1e-6);
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(20, 0.0, 95.0);
+  Eigen::VectorXd y = (x.array() * 2 * kPi / 100.0).sin().matrix();
+
+  ASSERT_TRUE(gp.infer(x, y));
+  EXPECT_EQ(gp.size(), 20);
+  for (int i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(gp.predict(x[i]), y[i], 1e-3);
+  }
+}
+
+TEST(GaussianProcessTest, periodicExtrapolationTest) {
+  GP gp(covariance_functions::PeriodicSquareExponential(test_parameters()),
+        1e-4);
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(40, 0.0, 195.0);
+  Eigen::VectorXd y = (x.array() * 2 * kPi / 100.0).sin().matrix();
+
+  ASSERT_TRUE(gp.infer(x, y));
+  for (double t = 200.0; t < 250.0; t += 5.0) {
+    EXPECT_NEAR(gp.predict(t), std::sin(t * 2 * kPi / 100.0), 0.05);
+  }
+}
+
+TEST(GaussianProcessTest, unorderedDataTest) {
+  GP gp(covariance_functions::PeriodicSquareExponential(test_parameters()),
+        0.01);
+  Eigen::VectorXd x(4), y(4);
+  x << 10.0, 30.0, 20.0, 0.0;
+  y << 1.0, 3.0, 2.0, 0.0;
+  Eigen::VectorXd xs(4), ys(4);
+  xs << 0.0, 10.0, 20.0, 30.0;
+  ys << 0.0, 1.0, 2.0, 3.0;
+  GP sorted(covariance_functions::PeriodicSquareExponential(test_parameters()),
+            0.01);
+
+  ASSERT_TRUE(gp.infer(x, y));
+  ASSERT_TRUE(sorted.infer(xs, ys));
+  EXPECT_NEAR(gp.predict(25.0), sorted.predict(25.0), 1e-9);
+}
+
+TEST(IncrementalGPTest, matchesFullInferenceTest) {
+  covariance_functions::PeriodicSquareExponential cov(test_parameters());
+  const int window = 30;
+  IncrementalGP incremental(cov, 0.01, window);
+  GP full(cov, 0.01);
+
+  // run well past the window so that points are dropped and the factor is
+  // recomputed more than once
+  Eigen::VectorXd x(window), y(window);
+  for (int i = 0; i < 100; ++i) {
+    const double t = 3.0 * i;
+    const double v = std::sin(t * 2 * kPi / 100.0) + 0.1 * std::cos(0.37 * i);
+    incremental.append(t, v);
+
+    const int n = incremental.size();
+    EXPECT_EQ(n, std::min(i + 1, window));
+    for (int j = 0; j < n; ++j) {
+      const double tj = 3.0 * (i - n + 1 + j);
+      x[j] = tj;
+      y[j] = std::sin(tj * 2 * kPi / 100.0) + 0.1 * std::cos(0.37 * (i - n + 1 + j));
+    }
+    ASSERT_TRUE(full.infer(x.head(n), y.head(n)));
+    EXPECT_NEAR(incremental.predict(t + 1.5), full.predict(t + 1.5), 1e-6);
+  }
+}
+
+TEST(IncrementalGPTest, clearTest) {
+  IncrementalGP gp(covariance_functions::PeriodicSquareExponential(test_parameters()),
+                   0.01, 10);
+  gp.append(1.0, 2.0);
+  gp.clear();
+  EXPECT_EQ(gp.size(), 0);
+  EXPECT_EQ(gp.predict(1.0), 0.0);
+}
+
+TEST(SparseGPTest, periodicLongWindowTest) {
+  covariance_functions::PeriodicSquareExponential::Parameters params =
+      test_parameters();
+  params.se_sd = 0.0;
+  covariance_functions::PeriodicSquareExponential cov(params);
+
+  const int inducing = 20;
+  Eigen::VectorXd locations(inducing);
+  for (int i = 0; i < inducing; ++i) {
+    locations[i] = i * params.period / inducing;
+  }
+  SparseGP gp(cov, 1e-3, locations, 500);
+
+  // many periods of data, more than the window holds
+  for (int i = 0; i < 2000; ++i) {
+    const double t = 2.0 * i;
+    gp.append(t, 0.5 + std::sin(t * 2 * kPi / 100.0));
+  }
+  EXPECT_EQ(gp.size(), 500);
+
+  for (double t = 4000.0; t < 4100.0; t += 7.0) {
+    EXPECT_NEAR(gp.predict(t), 0.5 + std::sin(t * 2 * kPi / 100.0), 0.02);
+  }
+}
+
+TEST(GPOptimizerTest, gradientTest) {
+  gp_optimizer::Hyperparameters hyper;
+  hyper.covariance = test_parameters();
+  hyper.noise_sd = 0.2;
+  Eigen::VectorXd theta = gp_optimizer::toLogVector(hyper);
+
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(25, 0.0, 240.0);
+  Eigen::VectorXd y(x.size());
+  for (int i = 0; i < x.size(); ++i) {
+    y[i] = std::sin(x[i] * 2 * kPi / 90.0) + 0.3 * std::cos(1.7 * i);
+  }
+
+  Eigen::VectorXd gradient;
+  gp_optimizer::negativeLogLikelihood(theta, x, y, &gradient);
+
+  const double h = 1e-6;
+  for (int i = 0; i < theta.size(); ++i) {
+    Eigen::VectorXd plus = theta, minus = theta;
+    plus[i] += h;
+    minus[i] -= h;
+    const double numeric =
+        (gp_optimizer::negativeLogLikelihood(plus, x, y, 0) -
+         gp_optimizer::negativeLogLikelihood(minus, x, y, 0)) / (2 * h);
+    EXPECT_NEAR(gradient[i], numeric, 1e-4 * std::max(1.0, std::abs(numeric)));
+  }
+}
+
+TEST(GPOptimizerTest, improvesLikelihoodTest) {
+  gp_optimizer::Hyperparameters start;
+  start.covariance = test_parameters();
+  start.covariance.per_sd = 0.2;
+  start.noise_sd = 1.0;
+
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(60, 0.0, 295.0);
+  Eigen::VectorXd y(x.size());
+  for (int i = 0; i < x.size(); ++i) {
+    y[i] = 2.0 * std::sin(x[i] * 2 * kPi / 100.0) + 0.05 * std::cos(2.3 * i);
+  }
+
+  // the period is known, the rest is fitted
+  Eigen::VectorXi fixed = Eigen::VectorXi::Zero(gp_optimizer::NUM_HYPERPARAMETERS);
+  fixed[4] = 1;
+
+  gp_optimizer::Result result = gp_optimizer::optimize(
+      start, x, y, fixed, 3.0, 100, []() { return true; });
+
+  EXPECT_LT(result.negative_log_likelihood,
+            gp_optimizer::negativeLogLikelihood(gp_optimizer::toLogVector(start), x, y, 0));
+  EXPECT_GT(result.iterations, 0);
+  EXPECT_DOUBLE_EQ(result.hyperparameters.covariance.period, start.covariance.period);
+  EXPECT_LT(result.hyperparameters.noise_sd, 0.5);
+  EXPECT_GT(result.hyperparameters.covariance.per_sd, 0.5);
+}
+
+TEST(GPOptimizerTest, stopsWhenToldTest) {
+  gp_optimizer::Hyperparameters start;
+  start.covariance = test_parameters();
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(10, 0.0, 90.0);
+  Eigen::VectorXd y = x.array().sin().matrix();
+  Eigen::VectorXi fixed = Eigen::VectorXi::Zero(gp_optimizer::NUM_HYPERPARAMETERS);
+
+  gp_optimizer::Result result = gp_optimizer::optimize(
+      start, x, y, fixed, 3.0, 100, []() { return false; });
+
+  EXPECT_EQ(result.iterations, 0);
+  EXPECT_FALSE(result.converged);
+}
+
+TEST(IncrementalGPTest, setCovarianceTest) {
+  covariance_functions::PeriodicSquareExponential cov(test_parameters());
+  covariance_functions::PeriodicSquareExponential::Parameters params =
+      test_parameters();
+  params.period = 120.0;
+  covariance_functions::PeriodicSquareExponential other(params);
+
+  IncrementalGP changed(cov, 0.01, 20);
+  IncrementalGP fresh(other, 0.02, 20);
+  for (int i = 0; i < 30; ++i) {
+    changed.append(4.0 * i, std::sin(0.1 * i));
+    fresh.append(4.0 * i, std::sin(0.1 * i));
+  }
+  changed.setCovariance(other, 0.02);
+  EXPECT_NEAR(changed.predict(125.0), fresh.predict(125.0), 1e-9);
+
+  Eigen::VectorXd x, y;
+  changed.latest(5, &x, &y);
+  ASSERT_EQ(x.size(), 5);
+  EXPECT_EQ(x[4], 4.0 * 29);
+  EXPECT_EQ(x[0], 4.0 * 25);
+}
+
+int main(int argc, char ** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -2,12 +2,16 @@
 
 #include "circular_buffer.h"
 
-CircularDoubleBuffer::CircularDoubleBuffer(int max_size)
+#include <cassert>
+
+CircularDoubleBuffer::CircularDoubleBuffer(int max_size, bool keep_ordered)
 : max_size_(max_size),
 current_position_(0),
 buffer_(max_size),
 trimmed_buffer_(),
-max_size_exceeded_(false) {}
+max_size_exceeded_(false),
+keep_ordered_(keep_ordered),
+ordered_(keep_ordered ? 2 * max_size : 0) {}
 
 double CircularDoubleBuffer::get(int index) {
   return buffer_[index];
@@ -39,6 +43,10 @@ double CircularDoubleBuffer::getSecondLastElement() {
 
 void CircularDoubleBuffer::append(double data) {
   buffer_[current_position_] = data;
+  if (keep_ordered_) {
+    ordered_[current_position_] = data;
+    ordered_[current_position_ + max_size_] = data;
+  }
   current_position_ = (current_position_ + 1) % max_size_;
   if (current_position_ == 0) {
     max_size_exceeded_ = true;
@@ -59,3 +67,27 @@ Eigen::VectorXd* CircularDoubleBuffer::getEigenVector() {
     return &trimmed_buffer_;
   }
 }
+
+int CircularDoubleBuffer::size() const {
+  return max_size_exceeded_ ? max_size_ : current_position_;
+}
+
+CircularDoubleBuffer::ConstView CircularDoubleBuffer::getView() const {
+  return ConstView(buffer_.data(), size());
+}
+
+CircularDoubleBuffer::ConstView CircularDoubleBuffer::getSegment(int segment) const {
+  if (!max_size_exceeded_) {
+    // nothing has wrapped yet, the oldest element is at the start
+    return segment == 0 ? ConstView(buffer_.data(), current_position_)
+                        : ConstView(buffer_.data(), 0);
+  }
+  return segment == 0 ? ConstView(buffer_.data() + current_position_, max_size_ - current_position_)
+                      : ConstView(buffer_.data(), current_position_);
+}
+
+CircularDoubleBuffer::ConstView CircularDoubleBuffer::getOrderedView() const {
+  assert(keep_ordered_);
+  int start = max_size_exceeded_ ? current_position_ : 0;
+  return ConstView(ordered_.data() + start, size());
+}
@@ -36,6 +36,12 @@
  * @note Using @code buffer.get(int) @endcode expects that append has been 
  * called often enough!
  *
+ * To read the data without copying it use @code buffer.getView() @endcode
+ * (storage order, like getEigenVector()), the chronological segments from
+ * @code buffer.getSegment(int) @endcode, or, for a buffer constructed with
+ * keep_ordered, the whole window in chronological order from
+ * @code buffer.getOrderedView() @endcode.
+ *
  */
 class CircularDoubleBuffer {
  private:
@@ -45,13 +51,26 @@ class CircularDoubleBuffer {
   Eigen::VectorXd trimmed_buffer_;
   bool max_size_exceeded_;
 
+  /*
+   * With keep_ordered every value is also written twice, at its position and
+   * max_size_ past it, so the window from the oldest value is always one
+   * contiguous run of ordered_.
+   */
+  bool keep_ordered_;
+  Eigen::VectorXd ordered_;
+
  public:
+  typedef Eigen::Map<const Eigen::VectorXd> ConstView;
+
   /*!
    * Constructor of the CircularBuffer class.
    *
    * @param max_size The maximum size of the Buffer.
+   * @param keep_ordered Maintain a chronologically ordered copy for
+   * getOrderedView(), at the cost of twice the storage and a second write per
+   * append.
    */
-  explicit CircularDoubleBuffer(int max_size);
+  explicit CircularDoubleBuffer(int max_size, bool keep_ordered = false);
 
   ~CircularDoubleBuffer() {}
 
@@ -102,6 +121,33 @@ class CircularDoubleBuffer {
    * function that expects a @code Eigen::VectorXd @endcode
    */
   Eigen::VectorXd* getEigenVector();
+
+  /*!
+   * Returns the number of elements in the buffer.
+   */
+  int size() const;
+
+  /*!
+   * Returns a view of the same elements as getEigenVector(), in storage
+   * order, without copying them.
+   */
+  ConstView getView() const;
+
+  /*!
+   * Returns one of the at most two contiguous runs holding the elements in
+   * chronological order: segment 0 holds the oldest elements and segment 1,
+   * which is empty until the buffer wraps, the newest.
+   *
+   * @param segment 0 or 1
+   */
+  ConstView getSegment(int segment) const;
+
+  /*!
+   * Returns all elements, oldest first, as one contiguous view.
+   *
+   * @pre The buffer was constructed with keep_ordered.
+   */
+  ConstView getOrderedView() const;
 };
 
 
@@ -0,0 +1,388 @@
+/*
+ *  corpus.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "corpus.h"
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
+#include <map>
+
+enum { TIMING_RUNS = 3, MAX_CANDIDATES = 50 };
+
+static const double POS_TOLERANCE = 1e-3;       // pixels
+static const double REL_TOLERANCE = 1e-6;
+
+struct CorpusCase
+{
+    wxString name;
+    usImage img;
+    usImage dark;
+    bool haveDark;
+    DefectMap defects;
+
+    CorpusCase() : haveDark(false) { }
+};
+
+// a check produces either a hash of an output image or a list of values
+struct CheckResult
+{
+    wxString hash;
+    std::vector<double> values;
+    double us;                  // best of TIMING_RUNS
+};
+
+typedef std::map<wxString, CheckResult> CheckResults;
+
+static wxString HashPixels(const usImage& img)
+{
+    // FNV-1a over the pixel values
+    unsigned long long h = 14695981039346656037ULL;
+    for (int i = 0; i < img.NPixels; i++)
+    {
+        unsigned short v = img.ImageData[i];
+        h = (h ^ (v & 0xff)) * 1099511628211ULL;
+        h = (h ^ (v >> 8)) * 1099511628211ULL;
+    }
+    return wxString::Format("%08lx%08lx", (unsigned long)(h >> 32), (unsigned long)(h & 0xffffffffUL));
+}
+
+enum ImageKernel
+{
+    KERNEL_SUBTRACT,
+    KERNEL_DEFECTS,
+    KERNEL_MEDIAN3,
+    KERNEL_LRECON,
+};
+
+static void RunKernel(const CorpusCase& c, ImageKernel kernel, CheckResult *r)
+{
+    usImage work;
+    r->us = 0.0;
+    for (int run = 0; run < TIMING_RUNS; run++)
+    {
+        work.CopyFrom(c.img);
+        wxStopWatch swatch;
+        switch (kernel)
+        {
+        case KERNEL_SUBTRACT: Subtract(work, c.dark); break;
+        case KERNEL_DEFECTS: RemoveDefects(work, c.defects); break;
+        case KERNEL_MEDIAN3: Median3(work); break;
+        case KERNEL_LRECON: QuickLRecon(work); break;
+        }
+        double us = swatch.TimeInMicro().ToDouble();
+        if (run == 0 || us < r->us)
+            r->us = us;
+    }
+    r->hash = HashPixels(work);
+}
+
+static void RunStarChecks(const CorpusCase& c, CheckResults *results)
+{
+    CheckResult af;
+    Star star;
+    std::vector<Star> candidates;
+    bool found = false;
+    for (int run = 0; run < TIMING_RUNS; run++)
+    {
+        candidates.clear();
+        wxStopWatch swatch;
+        found = star.AutoFind(c.img, 20, 15, &candidates);
+        double us = swatch.TimeInMicro().ToDouble();
+        if (run == 0 || us < af.us)
+            af.us = us;
+    }
+    af.values.push_back(found ? 1.0 : 0.0);
+    if (found)
+    {
+        af.values.push_back(star.X);
+        af.values.push_back(star.Y);
+    }
+    for (size_t i = 0; i < candidates.size() && i < MAX_CANDIDATES; i++)
+    {
+        af.values.push_back(candidates[i].X);
+        af.values.push_back(candidates[i].Y);
+    }
+    (*results)["autofind"] = af;
+
+    if (!found)
+        return;
+
+    CheckResult fr;
+    Star s;
+    bool ok = false;
+    for (int run = 0; run < TIMING_RUNS; run++)
+    {
+        s = Star();
+        wxStopWatch swatch;
+        ok = s.Find(&c.img, 15, (int) star.X, (int) star.Y, Star::FIND_CENTROID);
+        double us = swatch.TimeInMicro().ToDouble();
+        if (run == 0 || us < fr.us)
+            fr.us = us;
+    }
+    fr.values.push_back(ok ? 1.0 : 0.0);
+    fr.values.push_back(s.X);
+    fr.values.push_back(s.Y);
+    fr.values.push_back(s.Mass);
+    fr.values.push_back(s.SNR);
+    fr.values.push_back(s.HFD);
+    (*results)["find"] = fr;
+}
+
+static void RunChecks(const CorpusCase& c, CheckResults *results)
+{
+    if (c.haveDark)
+        RunKernel(c, KERNEL_SUBTRACT, &(*results)["subtract"]);
+    if (!c.defects.empty())
+        RunKernel(c, KERNEL_DEFECTS, &(*results)["defects"]);
+    RunKernel(c, KERNEL_MEDIAN3, &(*results)["median3"]);
+    RunKernel(c, KERNEL_LRECON, &(*results)["lrecon"]);
+    RunStarChecks(c, results);
+}
+
+static bool Matches(const CheckResult& a, const CheckResult& b)
+{
+    if (a.hash != b.hash || a.values.size() != b.values.size())
+        return false;
+    for (size_t i = 0; i < a.values.size(); i++)
+    {
+        if (fabs(a.values[i] - b.values[i]) > POS_TOLERANCE + REL_TOLERANCE * fabs(b.values[i]))
+            return false;
+    }
+    return true;
+}
+
+static wxString FormatResult(const CheckResult& r)
+{
+    if (!r.hash.empty())
+        return "h:" + r.hash;
+    wxString s;
+    for (size_t i = 0; i < r.values.size(); i++)
+    {
+        if (i)
+            s += ' ';
+        s += wxString::Format("%.6g", r.values[i]);
+    }
+    return s;
+}
+
+static bool ParseResult(const wxString& str, CheckResult *r)
+{
+    if (str.StartsWith("h:", &r->hash))
+        return true;
+    wxStringTokenizer tok(str, " ");
+    while (tok.HasMoreTokens())
+    {
+        double v;
+        if (!tok.GetNextToken().ToCDouble(&v))
+            return false;
+        r->values.push_back(v);
+    }
+    return true;
+}
+
+// lines of "<check> <result>"; returns true on error
+static bool LoadExpected(const wxString& fname, CheckResults *expected)
+{
+    wxTextFile f;
+    if (!f.Open(fname))
+        return true;
+    for (wxString line = f.GetFirstLine(); !f.Eof(); line = f.GetNextLine())
+    {
+        line.Trim(true).Trim(false);
+        if (line.empty() || line[0] == '#')
+            continue;
+        CheckResult r;
+        if (!ParseResult(line.AfterFirst(' '), &r))
+            return true;
+        (*expected)[line.BeforeFirst(' ')] = r;
+    }
+    return false;
+}
+
+static bool SaveExpected(const wxString& fname, const CheckResults& results)
+{
+    wxFFile f(fname, "w");
+    if (!f.IsOpened())
+        return true;
+    f.Write(wxString::Format("# PHD2 %s reference results\n", FULLVER));
+    for (CheckResults::const_iterator it = results.begin(); it != results.end(); ++it)
+        f.Write(it->first + " " + FormatResult(it->second) + "\n");
+    return !f.Close();
+}
+
+// returns true on error
+static bool LoadDefects(const wxString& fname, DefectMap *defects)
+{
+    wxTextFile f;
+    if (!f.Open(fname))
+        return true;
+    for (wxString line = f.GetFirstLine(); !f.Eof(); line = f.GetNextLine())
+    {
+        line.Trim(true).Trim(false);
+        if (line.empty() || line[0] == '#')
+            continue;
+        long x, y;
+        if (!line.BeforeFirst(' ').ToLong(&x) || !line.AfterFirst(' ').Trim(false).ToLong(&y))
+            return true;
+        defects->push_back(wxPoint(x, y));      // not AddDefect, which appends to the profile's map file
+    }
+    defects->BuildIndex();
+    return false;
+}
+
+static bool LoadCase(const wxString& dir, const wxString& fname, CorpusCase *c, wxString *errorMsg)
+{
+    wxFileName fn(dir, fname);
+    c->name = fn.GetName();
+
+    if (c->img.Load(fn.GetFullPath()))
+    {
+        *errorMsg = wxString::Format("cannot load %s", fn.GetFullPath());
+        return true;
+    }
+
+    wxFileName darkFn(dir, c->name + "_dark." + fn.GetExt());
+    if (darkFn.FileExists())
+    {
+        if (c->dark.Load(darkFn.GetFullPath()) || c->dark.Size != c->img.Size)
+        {
+            *errorMsg = wxString::Format("cannot use %s", darkFn.GetFullPath());
+            return true;
+        }
+        c->haveDark = true;
+    }
+
+    wxFileName defectsFn(dir, c->name + "_defects.txt");
+    if (defectsFn.FileExists() && LoadDefects(defectsFn.GetFullPath(), &c->defects))
+    {
+        *errorMsg = wxString::Format("cannot load %s", defectsFn.GetFullPath());
+        return true;
+    }
+
+    return false;
+}
+
+bool Corpus::Run(const wxString& dir, bool record, int *failures, wxString *errorMsg)
+{
+    *failures = 0;
+
+    wxArrayString files;
+    if (wxDirExists(dir))
+    {
+        wxDir::GetAllFiles(dir, &files, "*.fit", wxDIR_FILES);
+        wxDir::GetAllFiles(dir, &files, "*.fits", wxDIR_FILES);
+    }
+    files.Sort();
+    wxArrayString cases;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        wxFileName fn(files[i]);
+        if (!fn.GetName().EndsWith("_dark"))
+            cases.Add(fn.GetFullName());
+    }
+    if (cases.empty())
+    {
+        *errorMsg = wxString::Format("no FITS frames in %s", dir);
+        return true;
+    }
+
+    wxString outFile = wxFileName(dir, "corpus_results.csv").GetFullPath();
+    wxFFile out(outFile, "w");
+    if (!out.IsOpened())
+    {
+        *errorMsg = wxString::Format("cannot write %s", outFile);
+        return true;
+    }
+    out.Write(wxString::Format("# PHD2 %s corpus check, %s, %d cpus\n", FULLVER, wxDateTime::Now().FormatISOCombined(' '),
+        wxThread::GetCPUCount()));
+    out.Write("case,check,status,reference_us,optimized_us\n");
+
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        CorpusCase c;
+        if (LoadCase(dir, cases[i], &c, errorMsg))
+            return true;
+
+        CheckResults ref, opt;
+        SetImageMathReference(true);
+        RunChecks(c, &ref);
+        SetImageMathReference(false);
+        RunChecks(c, &opt);
+
+        wxString expectedFile = wxFileName(dir, c.name + ".expected").GetFullPath();
+        CheckResults expected;
+        bool haveExpected = false;
+        if (record)
+        {
+            if (SaveExpected(expectedFile, ref))
+            {
+                *errorMsg = wxString::Format("cannot write %s", expectedFile);
+                return true;
+            }
+        }
+        else if (wxFileExists(expectedFile))
+        {
+            if (LoadExpected(expectedFile, &expected))
+            {
+                *errorMsg = wxString::Format("cannot read %s", expectedFile);
+                return true;
+            }
+            haveExpected = true;
+        }
+
+        for (CheckResults::const_iterator it = ref.begin(); it != ref.end(); ++it)
+        {
+            const CheckResult& o = opt[it->first];
+            const char *status = "ok";
+            if (!Matches(o, it->second))
+                status = "optimized_differs";
+            else if (haveExpected && (expected.find(it->first) == expected.end() || !Matches(it->second, expected[it->first])))
+                status = "reference_differs";
+            if (strcmp(status, "ok") != 0)
+            {
+                ++*failures;
+                Debug.Write(wxString::Format("Corpus: %s %s %s: reference %s optimized %s\n", c.name, it->first, status,
+                    FormatResult(it->second), FormatResult(o)));
+            }
+            out.Write(wxString::Format("%s,%s,%s,%.1f,%.1f\n", c.name, it->first, status, it->second.us, o.us));
+        }
+        out.Flush();
+    }
+
+    return false;
+}
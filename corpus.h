@@ -0,0 +1,60 @@
+/*
+ *  corpus.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CORPUS_INCLUDED
+#define CORPUS_INCLUDED
+
+// Correctness check of the image kernels against a corpus of real frames.
+// Each case in the corpus directory is a FITS frame with optional companions:
+//
+//   <case>.fit             the frame
+//   <case>_dark.fit        a dark of the same size, for Subtract
+//   <case>_defects.txt     defect pixels for RemoveDefects, "x y" per line
+//   <case>.expected        the expected results, written by Record
+//
+// For each case the kernels (Subtract, RemoveDefects, Median3, QuickLRecon)
+// and the star finding (AutoFind, then Star::Find on the star it picks) run
+// twice: in the scalar single-threaded reference mode (see
+// SetImageMathReference) and with the normal vector and strip-parallel
+// paths. Image outputs must match bit for bit, star results within a small
+// tolerance. The reference results are also checked against <case>.expected
+// when it exists, so the reference itself cannot drift unnoticed.
+//
+// Results and the timings of both paths go to <dir>/corpus_results.csv.
+struct Corpus
+{
+    // returns true on error; *failures is the number of checks that failed
+    static bool Run(const wxString& dir, bool record, int *failures, wxString *errorMsg);
+};
+
+#endif
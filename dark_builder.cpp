@@ -0,0 +1,688 @@
+/*
+ *  dark_builder.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+wxDEFINE_EVENT(DARK_BUILD_DONE_EVENT, wxThreadEvent);
+
+DarkStacker::DarkStacker(DARK_COMBINE_METHOD method, double clipSigma)
+    : m_method(method),
+    m_clipSigma(clipSigma),
+    m_frames(0),
+    m_pooledVar(0.0),
+    m_groups(0),
+    m_rejected(0)
+{
+}
+
+bool DarkStacker::Add(const usImage& frame)
+{
+    if (m_frames == 0)
+    {
+        m_size = frame.Size;
+        unsigned int const n = frame.NPixels;
+
+        switch (m_method)
+        {
+        case DARK_COMBINE_MEAN:
+            m_sum.assign(n, 0);
+            break;
+        case DARK_COMBINE_SIGMA_CLIP:
+            m_mean.assign(n, 0.f);
+            m_m2.assign(n, 0.f);
+            m_count.assign(n, 0);
+            m_pending[0].resize(n);
+            m_pending[1].resize(n);
+            break;
+        case DARK_COMBINE_MEDIAN:
+            m_sum.assign(n, 0);
+            m_pending[0].resize(n);
+            m_pending[1].resize(n);
+            break;
+        }
+    }
+    else if (frame.Size != m_size)
+    {
+        Debug.Write(wxString::Format("DarkStacker: frame size %dx%d does not match %dx%d\n",
+            frame.Size.GetWidth(), frame.Size.GetHeight(), m_size.GetWidth(), m_size.GetHeight()));
+        return true;
+    }
+
+    const unsigned short *px = frame.ImageData;
+
+    switch (m_method)
+    {
+    case DARK_COMBINE_MEAN:
+    {
+        unsigned int *sum = &m_sum[0];
+        for (int i = 0; i < frame.NPixels; i++)
+            sum[i] += px[i];
+        break;
+    }
+    case DARK_COMBINE_SIGMA_CLIP:
+        AddSigmaClip(px);
+        break;
+    case DARK_COMBINE_MEDIAN:
+        AddMedian(px);
+        break;
+    }
+
+    ++m_frames;
+
+    return false;
+}
+
+inline static unsigned short median3(unsigned short a, unsigned short b, unsigned short c)
+{
+    if (a > b)
+        std::swap(a, b);
+    return c <= a ? a : c >= b ? b : c;
+}
+
+void DarkStacker::SeedSigmaClip(const unsigned short *px)
+{
+    unsigned int const n = m_count.size();
+    const unsigned short *p0 = &m_pending[0][0];
+    const unsigned short *p1 = &m_pending[1][0];
+
+    // noise floor: the median over all pixels of the range of three samples,
+    // which is about 1.58 sigma for Gaussian noise; outliers in a few pixels
+    // do not move it
+    ImageHistogram histo;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned short const lo = std::min(std::min(p0[i], p1[i]), px[i]);
+        unsigned short const hi = std::max(std::max(p0[i], p1[i]), px[i]);
+        histo.Add(hi - lo);
+    }
+    unsigned int range = histo.Median();
+    double sigma = std::max((double) range / 1.58, 1.0);
+    m_pooledVar = sigma * sigma;
+
+    Debug.Write(wxString::Format("DarkStacker: sigma clip noise floor %.1f ADU\n", sigma));
+
+    // seed each pixel with the samples of the first three frames that are
+    // close enough to their median
+    float const thresh = (float)(m_clipSigma * m_clipSigma * m_pooledVar);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        unsigned short const v[3] = { p0[i], p1[i], px[i] };
+        float const med = (float) median3(v[0], v[1], v[2]);
+        unsigned short cnt = 0;
+        float mean = 0.f, m2 = 0.f;
+        for (int j = 0; j < 3; j++)
+        {
+            float const x = (float) v[j];
+            if ((x - med) * (x - med) > thresh)
+            {
+                ++m_rejected;
+                continue;
+            }
+            ++cnt;
+            float const delta = x - mean;
+            mean += delta / cnt;
+            m2 += delta * (x - mean);
+        }
+        m_mean[i] = mean;
+        m_m2[i] = m2;
+        m_count[i] = cnt;
+    }
+
+    std::vector<unsigned short>().swap(m_pending[0]);
+    std::vector<unsigned short>().swap(m_pending[1]);
+}
+
+void DarkStacker::AddSigmaClip(const unsigned short *px)
+{
+    unsigned int const n = m_count.size();
+
+    if (m_frames < 2)
+    {
+        // hold the first two frames until the third one arrives
+        memcpy(&m_pending[m_frames][0], px, n * sizeof(unsigned short));
+        return;
+    }
+
+    if (m_frames == 2)
+    {
+        SeedSigmaClip(px);
+        return;
+    }
+
+    float const k2 = (float)(m_clipSigma * m_clipSigma);
+    float const poolVar = (float) m_pooledVar;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        float const x = (float) px[i];
+        unsigned short cnt = m_count[i];
+
+        float var = cnt > 0 ? m_m2[i] / cnt : 0.f;
+        if (var < poolVar)
+            var = poolVar;
+        float const d = x - m_mean[i];
+        if (cnt > 0 && d * d > k2 * var)
+        {
+            ++m_rejected;
+            continue;
+        }
+
+        // Welford update
+        ++cnt;
+        float const delta = x - m_mean[i];
+        m_mean[i] += delta / cnt;
+        m_m2[i] += delta * (x - m_mean[i]);
+        m_count[i] = cnt;
+    }
+}
+
+void DarkStacker::AddMedian(const unsigned short *px)
+{
+    unsigned int const n = m_sum.size();
+
+    switch (m_frames % 3)
+    {
+    case 0:
+        memcpy(&m_pending[0][0], px, n * sizeof(unsigned short));
+        break;
+    case 1:
+        memcpy(&m_pending[1][0], px, n * sizeof(unsigned short));
+        break;
+    case 2:
+    {
+        const unsigned short *p0 = &m_pending[0][0];
+        const unsigned short *p1 = &m_pending[1][0];
+        unsigned int *sum = &m_sum[0];
+        for (unsigned int i = 0; i < n; i++)
+            sum[i] += median3(p0[i], p1[i], px[i]);
+        ++m_groups;
+        break;
+    }
+    }
+}
+
+// fewer than three frames: nothing can be rejected, use the mean
+void DarkStacker::FinishPending(unsigned short *dst) const
+{
+    unsigned int const n = m_pending[0].size();
+
+    if (m_frames == 1)
+        memcpy(dst, &m_pending[0][0], n * sizeof(unsigned short));
+    else
+    {
+        for (unsigned int i = 0; i < n; i++)
+            dst[i] = (unsigned short)(((unsigned int) m_pending[0][i] + m_pending[1][i]) / 2);
+    }
+}
+
+bool DarkStacker::Finish(usImage& master)
+{
+    if (m_frames == 0)
+        return true;
+
+    if (master.Init(m_size))
+        return true;
+
+    unsigned short *dst = master.ImageData;
+    unsigned int const n = master.NPixels;
+
+    switch (m_method)
+    {
+    case DARK_COMBINE_MEAN:
+        for (unsigned int i = 0; i < n; i++)
+            dst[i] = (unsigned short)(m_sum[i] / m_frames);
+        break;
+
+    case DARK_COMBINE_SIGMA_CLIP:
+        if (m_frames < 3)
+            FinishPending(dst);
+        else
+        {
+            for (unsigned int i = 0; i < n; i++)
+            {
+                float const v = m_mean[i] + 0.5f;
+                dst[i] = v >= 65535.f ? 65535 : (unsigned short) v;
+            }
+        }
+        break;
+
+    case DARK_COMBINE_MEDIAN:
+        if (m_groups == 0)
+            FinishPending(dst);
+        else
+        {
+            // frames left over after the last complete group are not used;
+            // combining them without a median would let their outliers through
+            for (unsigned int i = 0; i < n; i++)
+                dst[i] = (unsigned short)((m_sum[i] + m_groups / 2) / m_groups);
+            if (m_frames % 3)
+                Debug.Write(wxString::Format("DarkStacker: %u frames not used for median\n", m_frames % 3));
+        }
+        break;
+    }
+
+    master.ImgStackCnt = m_frames;
+    master.CalcStats();
+
+    return false;
+}
+
+DarkBuildRequest::DarkBuildRequest()
+    : target(DARK_BUILD_LIBRARY),
+    frameCount(5),
+    combine(DARK_COMBINE_MEAN),
+    clipSigma(3.0),
+    newLibrary(false)
+{
+}
+
+DarkBuildStatus::DarkBuildStatus()
+    : state(DARK_BUILD_IDLE),
+    target(DARK_BUILD_LIBRARY),
+    exposureIndex(0),
+    exposureCount(0),
+    exposure(0),
+    frame(0),
+    frameCount(0),
+    progress(0),
+    total(0)
+{
+}
+
+class DarkBuildThread : public wxThread
+{
+    DarkBuildRequest m_req;
+    int m_profileId;
+
+    bool BuildMaster(int exposure, usImage& master, wxString *errMsg);
+    bool SaveLibrary(const ExposureImgMap& masters, wxString *errMsg);
+
+public:
+    DarkBuildThread(const DarkBuildRequest& req, int profileId)
+        : wxThread(wxTHREAD_JOINABLE), m_req(req), m_profileId(profileId) { }
+
+    ExitCode Entry();
+};
+
+// s_status is shared with the builder thread and protected by s_lock; the
+// remaining state is only touched in the main thread
+static wxCriticalSection s_lock;
+static DarkBuildStatus s_status;
+static DARK_BUILD_STATE s_result;
+static volatile bool s_cancel;
+static DarkBuildThread *s_thread;
+
+static void SetStatusMessage(const wxString& msg)
+{
+    wxCriticalSectionLocker lck(s_lock);
+    s_status.message = msg;
+}
+
+static wxString ExposureLabel(int exposure)
+{
+    if (exposure >= 1000)
+        return wxString::Format(_("%.1f sec"), (double) exposure / 1000.0);
+    else
+        return wxString::Format(_("%d mSec"), exposure);
+}
+
+bool DarkBuildThread::BuildMaster(int exposure, usImage& master, wxString *errMsg)
+{
+    DarkStacker stacker(m_req.combine, m_req.clipSigma);
+    usImage frame;
+
+    for (int j = 1; j <= m_req.frameCount; j++)
+    {
+        if (s_cancel)
+            return true;
+
+        {
+            wxCriticalSectionLocker lck(s_lock);
+            s_status.frame = j - 1;
+            s_status.message = wxString::Format(_("Building master dark at %s: taking dark frame %d/%d"),
+                ExposureLabel(exposure), j, m_req.frameCount);
+        }
+
+        Debug.Write(wxString::Format("Capture dark frame %d/%d exp=%d\n", j, m_req.frameCount, exposure));
+        if (GuideCamera::Capture(pCamera, exposure, frame, CAPTURE_DARK))
+        {
+            *errMsg = wxString::Format(_("%.1f s dark FAILED"), (double) exposure / 1000.0);
+            return true;
+        }
+
+        frame.CalcStats();
+        Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u filtmin %u filtmax %u\n",
+            frame.BitsPerPixel, frame.Min, frame.Max, frame.FiltMin, frame.FiltMax));
+
+        if (stacker.Add(frame))
+        {
+            *errMsg = _("Dark frame size changed");
+            return true;
+        }
+
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.frame = j;
+        s_status.progress += exposure;
+    }
+
+    if (stacker.Finish(master))
+    {
+        *errMsg = _("Could not build master dark");
+        return true;
+    }
+
+    master.ImgExpDur = exposure;
+    master.BitsPerPixel = frame.BitsPerPixel;
+
+    Debug.Write(wxString::Format("master dark exp=%d combine=%s frames=%u rejected=%u min %d max %d\n",
+        exposure, DarkBuilder::CombineMethodName(m_req.combine), stacker.Frames(), stacker.Rejected(),
+        master.Min, master.Max));
+
+    return false;
+}
+
+bool DarkBuildThread::SaveLibrary(const ExposureImgMap& masters, wxString *errMsg)
+{
+    wxString filename = MyFrame::DarkLibFileName(m_profileId);
+
+    // the current darks are only read here; the lock keeps the camera from
+    // replacing them while the library is written
+    wxCriticalSectionLocker lck(pCamera->DarkFrameLock);
+
+    ExposureImgMap darks;
+    if (!m_req.newLibrary)
+        darks = pCamera->Darks;
+    for (ExposureImgMap::const_iterator it = masters.begin(); it != masters.end(); ++it)
+        darks[it->first] = it->second;
+
+    if (MyFrame::SaveDarkLibraryFile(darks, filename, m_req.notes))
+    {
+        *errMsg = _("Error saving darks FITS file ") + filename;
+        return true;
+    }
+
+    return false;
+}
+
+wxThread::ExitCode DarkBuildThread::Entry()
+{
+    PerfTrace::SetThreadName("dark builder");
+    ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "dark builder");
+
+    Debug.Write(wxString::Format("DarkBuilder: start target=%d exposures=%u frames=%d combine=%s\n",
+        m_req.target, (unsigned int) m_req.exposures.size(), m_req.frameCount,
+        DarkBuilder::CombineMethodName(m_req.combine)));
+
+    pCamera->InitCapture();
+
+    wxString errMsg;
+    bool err = false;
+
+    if (m_req.target == DARK_BUILD_LIBRARY)
+    {
+        ExposureImgMap masters;
+
+        for (unsigned int i = 0; i < m_req.exposures.size() && !err; i++)
+        {
+            int const exposure = m_req.exposures[i];
+
+            {
+                wxCriticalSectionLocker lck(s_lock);
+                s_status.exposureIndex = i;
+                s_status.exposure = exposure;
+                s_status.frame = 0;
+            }
+
+            usImage *master = new usImage();
+            err = BuildMaster(exposure, *master, &errMsg);
+            if (err || masters.find(exposure) != masters.end())
+                delete master;
+            else
+                masters[exposure] = master;
+        }
+
+        if (!err)
+        {
+            SetStatusMessage(_("Saving dark library..."));
+            err = SaveLibrary(masters, &errMsg);
+        }
+
+        for (ExposureImgMap::iterator it = masters.begin(); it != masters.end(); ++it)
+            delete it->second;
+    }
+    else
+    {
+        int const exposure = m_req.exposures[0];
+        DefectMapDarks darks;
+
+        {
+            wxCriticalSectionLocker lck(s_lock);
+            s_status.exposure = exposure;
+        }
+
+        err = BuildMaster(exposure, darks.masterDark, &errMsg);
+        if (!err)
+        {
+            SetStatusMessage(_("Analyzing master dark..."));
+
+            // create a median-filtered dark
+            Debug.AddLine("Starting construction of filtered master dark file");
+            darks.BuildFilteredDark();
+            Debug.AddLine("Completed construction of filtered master dark file");
+
+            // save the master dark and the median filtered dark
+            darks.SaveDarks(m_req.notes);
+        }
+    }
+
+    DARK_BUILD_STATE result;
+    if (s_cancel)
+    {
+        result = DARK_BUILD_CANCELLED;
+        errMsg = _("Operation cancelled - no changes have been made");
+    }
+    else if (err)
+        result = DARK_BUILD_FAILED;
+    else
+        result = DARK_BUILD_SUCCEEDED;
+
+    Debug.Write(wxString::Format("DarkBuilder: done result=%d %s\n", result, errMsg));
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_result = result;
+        if (result != DARK_BUILD_SUCCEEDED)
+            s_status.message = errMsg;
+    }
+
+    wxQueueEvent(pFrame, new wxThreadEvent(wxEVT_THREAD, DARK_BUILD_DONE_EVENT));
+
+    return (ExitCode) 0;
+}
+
+bool DarkBuilder::Start(const DarkBuildRequest& req, wxString *error)
+{
+    if (s_thread)
+    {
+        *error = _("A dark build is already in progress");
+        return true;
+    }
+    if (!pCamera || !pCamera->Connected)
+    {
+        *error = _("Please connect to a camera first");
+        return true;
+    }
+    if (pFrame->CaptureActive || CameraTest::IsActive() || PulseProfiler::IsActive() || AOFastLoop::IsActive() ||
+        CaptureNode::IsRunning())
+    {
+        *error = _("Cannot take darks while capture is active");
+        return true;
+    }
+    if (req.exposures.empty() || req.frameCount < 1 || req.frameCount > 65535 ||
+        (req.target == DARK_BUILD_DEFECT_MAP && req.exposures.size() != 1))
+    {
+        *error = _("Invalid dark build parameters");
+        return true;
+    }
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status = DarkBuildStatus();
+        s_status.state = DARK_BUILD_RUNNING;
+        s_status.target = req.target;
+        s_status.exposureCount = req.exposures.size();
+        s_status.frameCount = req.frameCount;
+        for (unsigned int i = 0; i < req.exposures.size(); i++)
+            s_status.total += req.exposures[i] * req.frameCount;
+        s_result = DARK_BUILD_RUNNING;
+    }
+    s_cancel = false;
+
+    pCamera->ShutterClosed = true;
+
+    DarkBuildThread *thread = new DarkBuildThread(req, pConfig->GetCurrentProfileId());
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        pCamera->ShutterClosed = false;
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = DARK_BUILD_IDLE;
+        *error = _("Could not start the dark build thread");
+        return true;
+    }
+
+    s_thread = thread;
+
+    return false;
+}
+
+void DarkBuilder::Cancel(void)
+{
+    if (s_thread)
+    {
+        Debug.AddLine("DarkBuilder: cancel requested");
+        s_cancel = true;
+        SetStatusMessage(_("Cancelling..."));
+    }
+}
+
+bool DarkBuilder::IsActive(void)
+{
+    return s_thread != NULL;
+}
+
+DarkBuildStatus DarkBuilder::GetStatus(void)
+{
+    wxCriticalSectionLocker lck(s_lock);
+    return s_status;
+}
+
+void DarkBuilder::OnBuildDone(void)
+{
+    if (!s_thread)
+        return;
+
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+
+    DARK_BUILD_STATE result;
+    DARK_BUILD_TARGET target;
+    wxString msg;
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        result = s_result;
+        target = s_status.target;
+        msg = s_status.message;
+    }
+
+    if (pCamera)
+        pCamera->ShutterClosed = false;
+
+    if (result == DARK_BUILD_SUCCEEDED)
+    {
+        if (target == DARK_BUILD_LIBRARY)
+        {
+            pFrame->LoadDarkHandler(true);  // put it to use, including selection of matching dark frame
+            msg = _("dark library built");
+        }
+        else
+            msg = _("Master dark data files built");
+    }
+
+    pFrame->SetDarkMenuState();
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = result;
+        s_status.message = msg;
+    }
+
+    EvtServer.NotifyDarkBuildComplete(target == DARK_BUILD_LIBRARY, result == DARK_BUILD_SUCCEEDED,
+        result == DARK_BUILD_SUCCEEDED ? wxString() : msg);
+}
+
+void DarkBuilder::Shutdown(void)
+{
+    if (!s_thread)
+        return;
+
+    Debug.AddLine("DarkBuilder: waiting for builder thread to exit");
+    s_cancel = true;
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+}
+
+wxString DarkBuilder::CombineMethodName(DARK_COMBINE_METHOD method)
+{
+    switch (method)
+    {
+    case DARK_COMBINE_MEAN: default: return "mean";
+    case DARK_COMBINE_SIGMA_CLIP: return "sigma";
+    case DARK_COMBINE_MEDIAN: return "median";
+    }
+}
+
+bool DarkBuilder::ParseCombineMethod(const wxString& name, DARK_COMBINE_METHOD *method)
+{
+    if (name.CmpNoCase("mean") == 0)
+        *method = DARK_COMBINE_MEAN;
+    else if (name.CmpNoCase("sigma") == 0)
+        *method = DARK_COMBINE_SIGMA_CLIP;
+    else if (name.CmpNoCase("median") == 0)
+        *method = DARK_COMBINE_MEDIAN;
+    else
+        return true;
+    return false;
+}
@@ -0,0 +1,152 @@
+/*
+ *  dark_builder.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DARK_BUILDER_INCLUDED
+#define DARK_BUILDER_INCLUDED
+
+enum DARK_COMBINE_METHOD
+{
+    DARK_COMBINE_MEAN,
+    DARK_COMBINE_SIGMA_CLIP,
+    DARK_COMBINE_MEDIAN,
+};
+
+// Combines dark frames into a master dark one frame at a time, using a fixed
+// amount of memory per pixel regardless of the number of frames.
+//
+//   mean        - running sum
+//   sigma clip  - running mean and variance per pixel, seeded from the
+//                 samples of the first three frames that lie close to their
+//                 median; later samples more than clipSigma standard
+//                 deviations from the running mean are rejected. The standard
+//                 deviation is floored at a frame-wide noise estimate so that
+//                 a pixel whose first samples happened to agree does not
+//                 reject everything after
+//   median      - the frames are taken in groups of three and the master is
+//                 the mean of the group medians, so any single outlier in a
+//                 group (a cosmic ray hit) is rejected
+class DarkStacker
+{
+    DARK_COMBINE_METHOD m_method;
+    double m_clipSigma;
+    wxSize m_size;
+    unsigned int m_frames;
+    std::vector<unsigned int> m_sum;
+    std::vector<float> m_mean;
+    std::vector<float> m_m2;
+    std::vector<unsigned short> m_count;
+    double m_pooledVar;              // frame-wide noise floor for sigma clipping
+    std::vector<unsigned short> m_pending[2];
+    unsigned int m_groups;
+    unsigned int m_rejected;
+
+    void SeedSigmaClip(const unsigned short *px);
+    void AddSigmaClip(const unsigned short *px);
+    void AddMedian(const unsigned short *px);
+    void FinishPending(unsigned short *dst) const;
+
+public:
+    DarkStacker(DARK_COMBINE_METHOD method, double clipSigma);
+
+    bool Add(const usImage& frame);   // returns true on error (frame size mismatch)
+    bool Finish(usImage& master);     // returns true on error (no frames)
+    unsigned int Frames() const { return m_frames; }
+    unsigned int Rejected() const { return m_rejected; }
+};
+
+enum DARK_BUILD_TARGET
+{
+    DARK_BUILD_LIBRARY,       // master darks for the dark library
+    DARK_BUILD_DEFECT_MAP,    // master and filtered darks for building a defect map
+};
+
+struct DarkBuildRequest
+{
+    DARK_BUILD_TARGET target;
+    std::vector<int> exposures;   // exposure durations (ms), one master dark each
+    int frameCount;               // frames per master dark
+    DARK_COMBINE_METHOD combine;
+    double clipSigma;
+    bool newLibrary;              // replace the dark library instead of adding to it
+    wxString notes;
+
+    DarkBuildRequest();
+};
+
+enum DARK_BUILD_STATE
+{
+    DARK_BUILD_IDLE,
+    DARK_BUILD_RUNNING,
+    DARK_BUILD_SUCCEEDED,
+    DARK_BUILD_FAILED,
+    DARK_BUILD_CANCELLED,
+};
+
+struct DarkBuildStatus
+{
+    DARK_BUILD_STATE state;
+    DARK_BUILD_TARGET target;
+    int exposureIndex;    // index of the master dark being built
+    int exposureCount;
+    int exposure;         // exposure duration (ms) of the master dark being built
+    int frame;            // frames captured for the master dark being built
+    int frameCount;
+    int progress;         // exposure time (ms) captured so far
+    int total;            // total exposure time (ms) of the build
+    wxString message;
+
+    DarkBuildStatus();
+};
+
+wxDECLARE_EVENT(DARK_BUILD_DONE_EVENT, wxThreadEvent);
+
+// Builds master darks on a background thread. Frames are captured and
+// stacked on the builder thread and the result is written to the dark
+// library or the defect map darks from there too; the main thread is only
+// involved at the end, when MyFrame receives DARK_BUILD_DONE_EVENT and calls
+// OnBuildDone() to load the new library. Only one build can run at a time.
+class DarkBuilder
+{
+public:
+    static bool Start(const DarkBuildRequest& req, wxString *error);  // returns true on error
+    static void Cancel(void);
+    static bool IsActive(void);        // running or not yet finalized
+    static DarkBuildStatus GetStatus(void);
+    static void OnBuildDone(void);
+    static void Shutdown(void);        // cancel and wait for the builder thread
+
+    static wxString CombineMethodName(DARK_COMBINE_METHOD method);
+    static bool ParseCombineMethod(const wxString& name, DARK_COMBINE_METHOD *method);  // returns true on error
+};
+
+#endif
@@ -0,0 +1,354 @@
+/*
+ *  dark_model.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <atomic>
+
+// cache key of the darks of an earlier fit, never looked up
+static const int STALE_EXPOSURE = INT_MIN;
+
+class DarkInterpolationThread : public wxThread
+{
+public:
+    const usImage *m_lo;
+    const usImage *m_hi;
+    unsigned int m_weight;      // share of m_hi, see InterpolatePixels
+    int m_exposure;
+    usImage *m_dark;            // the result, NULL if it could not be allocated
+    std::atomic<bool> m_done;
+
+    DarkInterpolationThread(const usImage *lo, const usImage *hi, unsigned int weight, int exposure)
+        : wxThread(wxTHREAD_JOINABLE),
+          m_lo(lo),
+          m_hi(hi),
+          m_weight(weight),
+          m_exposure(exposure),
+          m_dark(NULL),
+          m_done(false)
+    {
+    }
+
+    static usImage *Interpolate(const usImage& lo, const usImage& hi, unsigned int weight, int exposure);
+
+protected:
+    ExitCode Entry();
+};
+
+usImage *DarkInterpolationThread::Interpolate(const usImage& lo, const usImage& hi, unsigned int weight, int exposure)
+{
+    usImage *dark = new usImage();
+    if (dark->Init(lo.Size))
+    {
+        delete dark;
+        return NULL;
+    }
+
+    InterpolatePixels(dark->ImageData, lo.ImageData, hi.ImageData, weight, dark->NPixels);
+    dark->ImgExpDur = exposure;
+    dark->BitsPerPixel = lo.BitsPerPixel;
+    return dark;
+}
+
+wxThread::ExitCode DarkInterpolationThread::Entry()
+{
+    m_dark = Interpolate(*m_lo, *m_hi, m_weight, m_exposure);
+    m_done = true;
+
+    // the frame selects the dark again now that it is ready
+    if (pFrame)
+        pFrame->CallAfter(&MyFrame::OnDarkInterpolated);
+
+    return 0;
+}
+
+DarkModel::DarkModel()
+    : m_stale(true),
+      m_fitted(false),
+      m_valid(false),
+      m_minExp(0),
+      m_maxExp(0),
+      m_bitsPerPixel(16),
+      m_pending(NULL)
+{
+}
+
+DarkModel::~DarkModel()
+{
+    Clear();
+}
+
+// drop the darks of an earlier library; they stay in the cache until Trim
+// since the camera may still be using one
+void DarkModel::Refresh(void)
+{
+    if (m_stale)
+    {
+        m_stale = false;
+        m_fitted = false;
+        m_valid = false;
+        for (size_t i = 0; i < m_cache.size(); i++)
+            m_cache[i].first = STALE_EXPOSURE;
+    }
+}
+
+usImage *DarkModel::Cached(int exposureDuration) const
+{
+    for (size_t i = 0; i < m_cache.size(); i++)
+        if (m_cache[i].first == exposureDuration)
+            return m_cache[i].second;
+    return NULL;
+}
+
+// Least squares fit of value = bias + rate * exposure for every pixel. The
+// sums over the exposures are the same for all pixels, so only the sums of
+// the values and of the values times the exposures are accumulated per pixel.
+bool DarkModel::Fit(const ExposureImgMap& darks)
+{
+    m_valid = false;
+    m_bias.clear();
+    m_rate.clear();
+
+    if (darks.size() < 2)
+        return false;
+
+    const usImage *first = darks.begin()->second;
+    for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
+    {
+        if (it->second->Size != first->Size || !it->second->ImageData)
+        {
+            Debug.Write("DarkModel: the library darks differ in size, not modelling\n");
+            return false;
+        }
+    }
+
+    unsigned int const npix = first->NPixels;
+    double const n = (double) darks.size();
+    double st = 0.0, stt = 0.0;
+    for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
+    {
+        double const t = it->first / 1000.0;
+        st += t;
+        stt += t * t;
+    }
+    double const denom = n * stt - st * st;
+    if (denom <= 0.0)
+        return false;
+
+    std::vector<float> sv(npix, 0.0f), stv(npix, 0.0f);
+    for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
+    {
+        float const t = (float)(it->first / 1000.0);
+        const unsigned short *p = it->second->ImageData;
+        for (unsigned int i = 0; i < npix; i++)
+        {
+            sv[i] += p[i];
+            stv[i] += t * p[i];
+        }
+    }
+
+    m_bias.resize(npix);
+    m_rate.resize(npix);
+    for (unsigned int i = 0; i < npix; i++)
+    {
+        double const rate = (n * stv[i] - st * sv[i]) / denom;
+        m_rate[i] = (float) rate;
+        m_bias[i] = (float)((sv[i] - rate * st) / n);
+    }
+
+    m_size = first->Size;
+    m_minExp = darks.begin()->first;
+    m_maxExp = darks.rbegin()->first;
+    m_bitsPerPixel = first->BitsPerPixel;
+    m_valid = true;
+
+    Debug.Write(wxString::Format("DarkModel: fitted %u darks of %dx%d, %d-%d ms\n", (unsigned int) darks.size(),
+        m_size.GetWidth(), m_size.GetHeight(), m_minExp, m_maxExp));
+    return true;
+}
+
+usImage *DarkModel::GetDark(const ExposureImgMap& darks, int exposureDuration)
+{
+    assert(wxThread::IsMain());
+
+    Refresh();
+    if (!m_fitted)
+    {
+        m_fitted = true;
+        Fit(darks);
+    }
+
+    if (!m_valid)
+        return NULL;
+
+    usImage *dark = Cached(exposureDuration);
+    if (dark)
+        return dark;
+
+    dark = new usImage();
+    if (dark->Init(m_size))
+    {
+        delete dark;
+        return NULL;
+    }
+
+    if (exposureDuration < m_minExp || exposureDuration > m_maxExp)
+        Debug.Write(wxString::Format("DarkModel: extrapolating to %d ms from %d-%d ms\n", exposureDuration, m_minExp, m_maxExp));
+
+    float const t = (float)(exposureDuration / 1000.0);
+    float const maxval = m_bitsPerPixel > 8 ? 65535.0f : 255.0f;
+    unsigned short *p = dark->ImageData;
+    for (unsigned int i = 0, n = dark->NPixels; i < n; i++)
+    {
+        float v = m_bias[i] + m_rate[i] * t + 0.5f;
+        p[i] = v <= 0.0f ? 0 : v >= maxval ? (unsigned short) maxval : (unsigned short) v;
+    }
+    dark->ImgExpDur = exposureDuration;
+    dark->BitsPerPixel = m_bitsPerPixel;
+
+    m_cache.push_back(std::make_pair(exposureDuration, dark));
+
+    Debug.Write(wxString::Format("DarkModel: synthesized a %d ms dark\n", exposureDuration));
+    return dark;
+}
+
+// take the result of a finished interpolation into the cache
+void DarkModel::Collect(bool wait)
+{
+    if (!m_pending || (!wait && !m_pending->m_done))
+        return;
+
+    m_pending->Wait();
+    if (m_pending->m_dark)
+    {
+        m_cache.push_back(std::make_pair(m_pending->m_exposure, m_pending->m_dark));
+        Debug.Write(wxString::Format("DarkModel: interpolated a %d ms dark\n", m_pending->m_exposure));
+    }
+    delete m_pending;
+    m_pending = NULL;
+}
+
+usImage *DarkModel::GetInterpolatedDark(const ExposureImgMap& darks, int exposureDuration, bool *bracketed)
+{
+    assert(wxThread::IsMain());
+
+    *bracketed = false;
+
+    ExposureImgMap::const_iterator hi = darks.lower_bound(exposureDuration);
+    if (hi == darks.end() || hi == darks.begin() || hi->first == exposureDuration)
+        return NULL;
+    ExposureImgMap::const_iterator lo = hi;
+    --lo;
+    if (lo->second->Size != hi->second->Size || !lo->second->ImageData || !hi->second->ImageData)
+        return NULL;
+
+    *bracketed = true;
+
+    Collect(false);
+    Refresh();
+
+    int const span = hi->first - lo->first;
+    int const step = ((exposureDuration - lo->first) * INTERPOLATION_STEPS + span / 2) / span;
+    if (step == 0)
+        return lo->second;
+    if (step == INTERPOLATION_STEPS)
+        return hi->second;
+
+    int const exposure = lo->first + (span * step + INTERPOLATION_STEPS / 2) / INTERPOLATION_STEPS;
+    usImage *dark = Cached(exposure);
+    if (dark)
+        return dark;
+
+    // one at a time; when it is done the frame selects the dark again, which
+    // starts the next one if the exposure has changed meanwhile
+    if (m_pending)
+        return NULL;
+
+    unsigned int const weight = step * INTERPOLATE_ONE / INTERPOLATION_STEPS;
+    DarkInterpolationThread *thread = new DarkInterpolationThread(lo->second, hi->second, weight, exposure);
+    if (thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR)
+    {
+        m_pending = thread;
+        return NULL;
+    }
+
+    Debug.Write("DarkModel: could not start the interpolation thread, interpolating in place\n");
+    delete thread;
+    dark = DarkInterpolationThread::Interpolate(*lo->second, *hi->second, weight, exposure);
+    if (dark)
+        m_cache.push_back(std::make_pair(exposure, dark));
+    return dark;
+}
+
+void DarkModel::Cancel(void)
+{
+    if (m_pending)
+    {
+        m_pending->Wait();
+        delete m_pending->m_dark;
+        delete m_pending;
+        m_pending = NULL;
+    }
+}
+
+void DarkModel::Trim(const usImage *keep)
+{
+    size_t current = 0;
+    for (size_t i = 0; i < m_cache.size(); i++)
+        if (m_cache[i].first != STALE_EXPOSURE)
+            ++current;
+
+    std::vector<std::pair<int, usImage *> >::iterator it = m_cache.begin();
+    while (it != m_cache.end())
+    {
+        bool const stale = it->first == STALE_EXPOSURE;
+        if (it->second != keep && (stale || current > MAX_CACHED))
+        {
+            if (!stale)
+                --current;
+            delete it->second;
+            it = m_cache.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void DarkModel::Clear(void)
+{
+    Cancel();
+    for (size_t i = 0; i < m_cache.size(); i++)
+        delete m_cache[i].second;
+    m_cache.clear();
+    m_stale = true;
+}
@@ -0,0 +1,101 @@
+/*
+ *  dark_model.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DARK_MODEL_INCLUDED
+#define DARK_MODEL_INCLUDED
+
+// A dark frame for any exposure, from a per-pixel linear fit of the dark
+// library: a bias and a thermal rate for each pixel. With it a library of a
+// few exposures spanning the range in use serves every exposure, and auto
+// exposure no longer subtracts the dark of a different exposure.
+//
+// An exposure between two library darks can instead be interpolated
+// pixel by pixel from the two, which follows a library whose darks are not
+// quite linear in exposure. The interpolation is done on a background thread
+// so that auto exposure changing the exposure does not hold up the main
+// thread; until it is done the library dark is used, and MyFrame is told to
+// select the dark again when it is ready. Interpolated exposures are rounded
+// to INTERPOLATION_STEPS steps between the two darks so that small changes
+// of exposure reuse the cached dark.
+//
+// The model is fitted on first use after the library changes, and the
+// synthesized darks are cached per exposure, MAX_CACHED at most. Like the
+// library it is only used on the main thread; the darks it returns are read
+// by the camera worker thread under DarkFrameLock, which must be held to
+// call Trim. Cancel must be called before a library dark is freed, since the
+// interpolation thread reads them.
+class DarkInterpolationThread;
+
+class DarkModel
+{
+    enum { MAX_CACHED = 4 };
+    enum { INTERPOLATION_STEPS = 16 };
+
+    bool m_stale;
+    bool m_fitted;
+    bool m_valid;
+    wxSize m_size;
+    int m_minExp, m_maxExp;
+    wxByte m_bitsPerPixel;
+    std::vector<float> m_bias;
+    std::vector<float> m_rate;      // ADU per second
+    std::vector<std::pair<int, usImage *> > m_cache;   // oldest first
+    DarkInterpolationThread *m_pending;                 // interpolating, NULL if idle
+
+    void Refresh(void);
+    bool Fit(const ExposureImgMap& darks);
+    usImage *Cached(int exposureDuration) const;
+    void Collect(bool wait);
+
+public:
+    DarkModel();
+    ~DarkModel();
+
+    void Invalidate(void) { m_stale = true; }
+    // the dark for the exposure, NULL if the library cannot be modelled
+    // (fewer than two exposures or mixed frame sizes)
+    usImage *GetDark(const ExposureImgMap& darks, int exposureDuration);
+    // the dark interpolated between the library darks bracketing the
+    // exposure, NULL while it is being interpolated or if the exposure is not
+    // bracketed (*bracketed = false)
+    usImage *GetInterpolatedDark(const ExposureImgMap& darks, int exposureDuration, bool *bracketed);
+    // wait for the interpolation thread and drop its result
+    void Cancel(void);
+    // free the cached darks beyond MAX_CACHED and those of an earlier fit,
+    // except keep
+    void Trim(const usImage *keep);
+    // free all cached darks
+    void Clear(void);
+};
+
+#endif
@@ -0,0 +1,501 @@
+/*
+ *  darklib_cache.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <wx/filename.h>
+
+#ifndef __WINDOWS__
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+enum
+{
+    CACHE_VERSION = 1,
+    DATA_ALIGNMENT = 64,
+};
+
+static const char DARKS_MAGIC[8] = { 'P', 'H', 'D', '2', 'D', 'R', 'K', 'C' };
+static const char DEFECTS_MAGIC[8] = { 'P', 'H', 'D', '2', 'D', 'F', 'M', 'C' };
+
+// all fields are in native byte order; the magic and version catch a cache
+// copied from another kind of machine
+struct CacheHeader
+{
+    char     magic[8];
+    wxUint32 version;
+    wxUint32 count;            // number of darks or defects
+    wxUint64 sourceSize;
+    wxInt64  sourceMtime;      // seconds since the epoch
+    wxUint32 sourceChecksum;   // Adler-32 of the source file
+    wxUint32 reserved;
+};
+
+struct CachedDark
+{
+    wxInt32  expDur;
+    wxInt32  width;
+    wxInt32  height;
+    wxInt32  stackCnt;
+    wxInt32  min;
+    wxInt32  max;
+    wxInt32  filtMin;
+    wxInt32  filtMax;
+    wxUint64 dataOffset;       // from the start of the file, DATA_ALIGNMENT aligned
+};
+
+struct CachedDefect
+{
+    wxInt32 x;
+    wxInt32 y;
+};
+
+MappedFileBuffer::MappedFileBuffer()
+    :
+#ifdef __WINDOWS__
+      m_file(INVALID_HANDLE_VALUE),
+      m_mapping(NULL),
+#else
+      m_fd(-1),
+#endif
+      m_base(0),
+      m_size(0)
+{
+}
+
+MappedFileBuffer::~MappedFileBuffer()
+{
+#ifdef __WINDOWS__
+    if (m_base)
+        UnmapViewOfFile(m_base);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+#else
+    if (m_base)
+        munmap(m_base, m_size);
+    if (m_fd != -1)
+        close(m_fd);
+#endif
+}
+
+static size_t PageSize()
+{
+#ifdef __WINDOWS__
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwPageSize;
+#else
+    return (size_t) sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void MappedFileBuffer::Evict(const void *p, size_t len)
+{
+    static size_t const page = PageSize();
+    uintptr_t const begin = ((uintptr_t) p + page - 1) & ~(uintptr_t) (page - 1);
+    uintptr_t const end = ((uintptr_t) p + len) & ~(uintptr_t) (page - 1);
+    if (end <= begin)
+        return;
+
+#ifdef __WINDOWS__
+    // unlocking pages that are not locked removes them from the working set
+    VirtualUnlock((void *) begin, end - begin);
+#elif defined(MADV_PAGEOUT)
+    // not MADV_DONTNEED, which would discard the pages of a private mapping
+    // that were written to
+    madvise((void *) begin, end - begin, MADV_PAGEOUT);
+#else
+    // no way to page out without losing written pages, the kernel will
+    // reclaim them under memory pressure
+    POSSIBLY_UNUSED(begin);
+#endif
+}
+
+// returns true on error
+bool MappedFileBuffer::Open(const wxString& filename)
+{
+#ifdef __WINDOWS__
+    m_file = CreateFileW(filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return true;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        return true;
+    m_size = (size_t) size.QuadPart;
+
+    m_mapping = CreateFileMappingW(m_file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (!m_mapping)
+        return true;
+
+    m_base = MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+    return m_base == NULL;
+#else
+    m_fd = open(filename.fn_str(), O_RDONLY);
+    if (m_fd == -1)
+        return true;
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size == 0)
+        return true;
+    m_size = (size_t) st.st_size;
+
+    void *p = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+    if (p == MAP_FAILED)
+        return true;
+    m_base = p;
+    return false;
+#endif
+}
+
+static wxUint32 Adler32(const wxString& filename)
+{
+    enum { MOD_ADLER = 65521, CHUNK = 64 * 1024 };
+
+    wxFFile file(filename, "rb");
+    if (!file.IsOpened())
+        return 0;
+
+    wxUint32 a = 1, b = 0;
+    std::vector<unsigned char> buf(CHUNK);
+    size_t n;
+    while ((n = file.Read(&buf[0], CHUNK)) > 0)
+    {
+        // 5552 is the largest n for which b cannot overflow before the modulo
+        for (size_t i = 0; i < n; )
+        {
+            size_t end = wxMin(n, i + 5552);
+            for (; i < end; i++)
+            {
+                a += buf[i];
+                b += a;
+            }
+            a %= MOD_ADLER;
+            b %= MOD_ADLER;
+        }
+    }
+
+    return (b << 16) | a;
+}
+
+// returns true on error
+static bool GetSourceInfo(const wxString& sourceFile, wxUint64 *size, wxInt64 *mtime)
+{
+    wxFileName fn(sourceFile);
+    if (!fn.FileExists())
+        return true;
+
+    wxULongLong sz = fn.GetSize();
+    if (sz == wxInvalidSize)
+        return true;
+
+    wxDateTime mod = fn.GetModificationTime();
+    if (!mod.IsValid())
+        return true;
+
+    *size = sz.GetValue();
+    *mtime = mod.GetTicks();
+    return false;
+}
+
+static bool InitHeader(CacheHeader *hdr, const char magic[8], unsigned int count, const wxString& sourceFile)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, magic, sizeof(hdr->magic));
+    hdr->version = CACHE_VERSION;
+    hdr->count = count;
+    if (GetSourceInfo(sourceFile, &hdr->sourceSize, &hdr->sourceMtime))
+        return true;
+    hdr->sourceChecksum = Adler32(sourceFile);
+    return false;
+}
+
+static bool CheckHeader(const CacheHeader& hdr, const char magic[8], const wxString& sourceFile)
+{
+    if (memcmp(hdr.magic, magic, sizeof(hdr.magic)) != 0 || hdr.version != CACHE_VERSION)
+    {
+        Debug.Write(wxString::Format("DarkLibCache: unrecognized cache for %s\n", sourceFile));
+        return true;
+    }
+
+    wxUint64 size;
+    wxInt64 mtime;
+    if (GetSourceInfo(sourceFile, &size, &mtime) || size != hdr.sourceSize || mtime != hdr.sourceMtime)
+    {
+        Debug.Write(wxString::Format("DarkLibCache: cache is stale for %s\n", sourceFile));
+        return true;
+    }
+
+    return false;
+}
+
+// write to a temporary file and rename it into place so that another instance
+// never maps a partially written cache; returns true on error
+static bool WriteCacheFile(const wxString& cacheFile, const std::vector<char>& buf)
+{
+    wxString tmpFile = wxString::Format("%s.%lu.tmp", cacheFile, wxGetProcessId());
+
+    {
+        wxFFile file(tmpFile, "wb");
+        if (!file.IsOpened() || file.Write(&buf[0], buf.size()) != buf.size() || !file.Close())
+        {
+            wxRemoveFile(tmpFile);
+            return true;
+        }
+    }
+
+    if (!wxRenameFile(tmpFile, cacheFile, true))
+    {
+        wxRemoveFile(tmpFile);
+        return true;
+    }
+
+    return false;
+}
+
+wxString DarkLibCache::CacheFileName(const wxString& sourceFile)
+{
+    wxFileName fn(sourceFile);
+    fn.SetExt("phdcache");
+    return fn.GetFullPath();
+}
+
+bool DarkLibCache::SaveDarks(const ExposureImgMap& darks, const wxString& darkLibFile)
+{
+    wxString cacheFile = CacheFileName(darkLibFile);
+
+    CacheHeader hdr;
+    if (darks.empty() || InitHeader(&hdr, DARKS_MAGIC, darks.size(), darkLibFile))
+    {
+        Remove(darkLibFile);
+        return true;
+    }
+
+    size_t const dirEnd = sizeof(CacheHeader) + darks.size() * sizeof(CachedDark);
+    size_t offset = (dirEnd + DATA_ALIGNMENT - 1) & ~(size_t)(DATA_ALIGNMENT - 1);
+
+    std::vector<CachedDark> dir;
+    for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it)
+    {
+        const usImage *img = it->second;
+        CachedDark d;
+        d.expDur = img->ImgExpDur;
+        d.width = img->Size.GetWidth();
+        d.height = img->Size.GetHeight();
+        d.stackCnt = img->ImgStackCnt;
+        d.min = img->Min;
+        d.max = img->Max;
+        d.filtMin = img->FiltMin;
+        d.filtMax = img->FiltMax;
+        d.dataOffset = offset;
+        dir.push_back(d);
+        offset += (img->NPixels * sizeof(unsigned short) + DATA_ALIGNMENT - 1) & ~(size_t)(DATA_ALIGNMENT - 1);
+    }
+
+    std::vector<char> buf;
+    try
+    {
+        buf.resize(offset);
+    }
+    catch (const std::bad_alloc&)
+    {
+        Debug.Write("DarkLibCache: not enough memory to write dark cache\n");
+        return true;
+    }
+
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+    memcpy(&buf[sizeof(hdr)], &dir[0], dir.size() * sizeof(CachedDark));
+    unsigned int i = 0;
+    for (ExposureImgMap::const_iterator it = darks.begin(); it != darks.end(); ++it, ++i)
+    {
+        const usImage *img = it->second;
+        memcpy(&buf[(size_t) dir[i].dataOffset], img->ImageData, img->NPixels * sizeof(unsigned short));
+    }
+
+    if (WriteCacheFile(cacheFile, buf))
+    {
+        Debug.Write(wxString::Format("DarkLibCache: failed to write %s\n", cacheFile));
+        return true;
+    }
+
+    Debug.Write(wxString::Format("DarkLibCache: wrote %u darks to %s\n", hdr.count, cacheFile));
+    return false;
+}
+
+bool DarkLibCache::LoadDarks(GuideCamera *camera, const wxString& darkLibFile)
+{
+    wxString cacheFile = CacheFileName(darkLibFile);
+    if (!wxFileExists(cacheFile))
+        return true;
+
+    MappedFileBuffer *map = new MappedFileBuffer();
+    bool err = true;
+
+    try
+    {
+        if (map->Open(cacheFile))
+            throw ERROR_INFO("could not map dark cache file");
+
+        if (map->Size() < sizeof(CacheHeader))
+            throw ERROR_INFO("dark cache file truncated");
+
+        CacheHeader hdr;
+        memcpy(&hdr, map->Base(), sizeof(hdr));
+        if (CheckHeader(hdr, DARKS_MAGIC, darkLibFile))
+            throw ERROR_INFO("dark cache invalid");
+
+        size_t const dirEnd = sizeof(CacheHeader) + (size_t) hdr.count * sizeof(CachedDark);
+        if (hdr.count == 0 || map->Size() < dirEnd)
+            throw ERROR_INFO("dark cache file truncated");
+
+        const CachedDark *dir = reinterpret_cast<const CachedDark *>(map->Base() + sizeof(CacheHeader));
+
+        // validate the whole directory before handing any darks to the camera
+        for (unsigned int i = 0; i < hdr.count; i++)
+        {
+            const CachedDark& d = dir[i];
+            wxUint64 bytes = (wxUint64) d.width * d.height * sizeof(unsigned short);
+            if (d.width <= 0 || d.height <= 0 || (d.dataOffset % DATA_ALIGNMENT) != 0 ||
+                d.dataOffset < dirEnd || d.dataOffset + bytes > map->Size())
+            {
+                throw ERROR_INFO("dark cache directory is corrupt");
+            }
+        }
+
+        for (unsigned int i = 0; i < hdr.count; i++)
+        {
+            const CachedDark& d = dir[i];
+            usImage *img = new usImage();
+            img->AttachImageData(reinterpret_cast<unsigned short *>(map->MutableBase() + d.dataOffset),
+                wxSize(d.width, d.height), map);
+            img->ImgExpDur = d.expDur;
+            img->ImgStackCnt = d.stackCnt;
+            img->Min = d.min;
+            img->Max = d.max;
+            img->FiltMin = d.filtMin;
+            img->FiltMax = d.filtMax;
+            Debug.Write(wxString::Format("loaded cached dark frame exposure = %d\n", img->ImgExpDur));
+            camera->AddDark(img);
+        }
+
+        Debug.Write(wxString::Format("DarkLibCache: mapped %u darks from %s\n", hdr.count, cacheFile));
+        err = false;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+    }
+
+    map->Release(); // the darks hold their own references
+
+    return err;
+}
+
+bool DarkLibCache::SaveDefects(const DefectMap& defectMap, const wxString& defectMapFile)
+{
+    CacheHeader hdr;
+    if (InitHeader(&hdr, DEFECTS_MAGIC, defectMap.size(), defectMapFile))
+        return true;
+
+    std::vector<char> buf(sizeof(hdr) + defectMap.size() * sizeof(CachedDefect));
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+    CachedDefect *p = reinterpret_cast<CachedDefect *>(&buf[sizeof(hdr)]);
+    for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it, ++p)
+    {
+        p->x = it->x;
+        p->y = it->y;
+    }
+
+    wxString cacheFile = CacheFileName(defectMapFile);
+    if (WriteCacheFile(cacheFile, buf))
+    {
+        Debug.Write(wxString::Format("DarkLibCache: failed to write %s\n", cacheFile));
+        return true;
+    }
+
+    return false;
+}
+
+bool DarkLibCache::LoadDefects(DefectMap *defectMap, const wxString& defectMapFile)
+{
+    wxString cacheFile = CacheFileName(defectMapFile);
+    if (!wxFileExists(cacheFile))
+        return true;
+
+    wxFFile file(cacheFile, "rb");
+    if (!file.IsOpened())
+        return true;
+
+    CacheHeader hdr;
+    if (file.Read(&hdr, sizeof(hdr)) != sizeof(hdr) || CheckHeader(hdr, DEFECTS_MAGIC, defectMapFile))
+        return true;
+
+    std::vector<CachedDefect> defects(hdr.count);
+    if (hdr.count && file.Read(&defects[0], hdr.count * sizeof(CachedDefect)) != hdr.count * sizeof(CachedDefect))
+        return true;
+
+    defectMap->clear();
+    defectMap->reserve(hdr.count);
+    for (std::vector<CachedDefect>::const_iterator it = defects.begin(); it != defects.end(); ++it)
+        defectMap->push_back(wxPoint(it->x, it->y));
+
+    return false;
+}
+
+bool DarkLibCache::IsMapped(const usImage& dark)
+{
+    return dark.ImageData && dynamic_cast<MappedFileBuffer *>(dark.BufferOwner) != NULL;
+}
+
+void DarkLibCache::Evict(const usImage& dark)
+{
+    MappedFileBuffer *map = dark.ImageData ? dynamic_cast<MappedFileBuffer *>(dark.BufferOwner) : NULL;
+    if (map)
+        map->Evict(dark.ImageData, dark.NPixels * sizeof(unsigned short));
+}
+
+void DarkLibCache::Remove(const wxString& sourceFile)
+{
+    wxString cacheFile = CacheFileName(sourceFile);
+    if (wxFileExists(cacheFile))
+    {
+        Debug.Write(wxString::Format("Removing cache file: %s\n", cacheFile));
+        wxRemoveFile(cacheFile);
+    }
+}
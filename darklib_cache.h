@@ -0,0 +1,93 @@
+/*
+ *  darklib_cache.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DARKLIB_CACHE_INCLUDED
+#define DARKLIB_CACHE_INCLUDED
+
+class DefectMap;
+
+// A read-only file mapped copy-on-write: the pages are shared with every other
+// process mapping the file until somebody writes to them. Release it rather
+// than delete it.
+class MappedFileBuffer : public ImageBufferOwner
+{
+#ifdef __WINDOWS__
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_fd;
+#endif
+    void *m_base;
+    size_t m_size;
+
+    ~MappedFileBuffer();
+
+public:
+    MappedFileBuffer();
+    bool Open(const wxString& filename);    // returns true on error
+    const char *Base() const { return static_cast<const char *>(m_base); }
+    char *MutableBase() { return static_cast<char *>(m_base); }
+    size_t Size() const { return m_size; }
+    // take the whole pages of [p, p + len) out of the process's working set;
+    // they keep their contents and are paged in again when next touched
+    void Evict(const void *p, size_t len);
+};
+
+// Binary caches kept next to the FITS dark library and the text defect map.
+// A cache records the size, modification time and Adler-32 checksum of the
+// file it was built from, and is ignored once that file changes. Cached darks
+// are memory-mapped copy-on-write, so frames are paged in only when used and
+// the pages are shared by all PHD2 instances using the same library.
+class DarkLibCache
+{
+public:
+    static wxString CacheFileName(const wxString& sourceFile);
+
+    // load all darks from the cache for darkLibFile; returns true on error,
+    // including a missing or stale cache
+    static bool LoadDarks(GuideCamera *camera, const wxString& darkLibFile);
+    static bool SaveDarks(const ExposureImgMap& darks, const wxString& darkLibFile);
+
+    // load defects from the cache for defectMapFile; returns true on error
+    static bool LoadDefects(DefectMap *defectMap, const wxString& defectMapFile);
+    static bool SaveDefects(const DefectMap& defectMap, const wxString& defectMapFile);
+
+    static void Remove(const wxString& sourceFile);
+
+    // a dark mapped from a cache, rather than on the heap
+    static bool IsMapped(const usImage& dark);
+    // page out a mapped dark; does nothing for a dark on the heap
+    static void Evict(const usImage& dark);
+};
+
+#endif
@@ -36,7 +36,6 @@
 #include "phd.h"
 #include "darks_dialog.h"
 #include "wx/valnum.h"
-#include <sstream>
 
 static const int DefMinExpTime = 1;
 static const int DefMaxExpTime = 10;
@@ -46,6 +45,7 @@ static const int DefDMExpTime = 15;
 static const int DefDMCount = 25;
 
 static const bool DefCreateDMap = true;
+static const int DefCombine = DARK_COMBINE_MEAN;
 static const int MaxNoteLength = 65;            // For now
 
 // Utility function to add the <label, input> pairs to a flexgrid
@@ -197,6 +197,21 @@ DarksDialog::DarksDialog(wxWindow *parent, bool darkLib) :
     phSizer->Add(pNoteLabel, wxSizerFlags().Border(wxALL, 5));
     phSizer->Add(m_pNotes, wxSizerFlags().Border(wxALL, 5));
     pvSizer->Add(phSizer, wxSizerFlags().Border(wxALL, 5));
+
+    phSizer = new wxBoxSizer(wxHORIZONTAL);
+    wxStaticText *pCombineLabel = new wxStaticText(this, wxID_ANY, _("Stacking: "), wxPoint(-1, -1), wxSize(-1, -1));
+    wxArrayString combineChoices;
+    combineChoices.Add(_("Mean"));
+    combineChoices.Add(_("Sigma clip"));
+    combineChoices.Add(_("Median"));
+    m_pCombine = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, combineChoices);
+    m_pCombine->SetToolTip(_("How the dark frames are combined. Sigma clip and Median reject cosmic ray hits and other "
+        "transient outliers; Median works best with a multiple of 3 frames."));
+    int combine = pConfig->Profile.GetInt("/camera/darks_combine", DefCombine);
+    m_pCombine->SetSelection(combine >= 0 && combine < (int) combineChoices.GetCount() ? combine : DefCombine);
+    phSizer->Add(pCombineLabel, wxSizerFlags().Border(wxALL, 5));
+    phSizer->Add(m_pCombine, wxSizerFlags().Border(wxALL, 5));
+    pvSizer->Add(phSizer, wxSizerFlags().Border(wxALL, 5));
     phSizer = new wxBoxSizer(wxHORIZONTAL);
     m_pProgress = new wxGauge(this, wxID_ANY, 100, wxDefaultPosition, wxSize(width * 38, -1));
     m_pProgress->Enable(false);
@@ -239,132 +254,89 @@ DarksDialog::DarksDialog(wxWindow *parent, bool darkLib) :
 
     m_cancelling = false;
     m_started = false;
+
+    m_timer.SetOwner(this);
+    Bind(wxEVT_TIMER, &DarksDialog::OnTimer, this);
 }
 
 void DarksDialog::OnStart(wxCommandEvent& evt)
 {
     SaveProfileInfo();
 
-    m_pStartBtn->Enable(false);
-    m_pResetBtn->Enable(false);
-    m_pStopBtn->SetLabel(_("Stop"));
-    m_pStopBtn->Refresh();
-    m_started = true;
-    wxYield();
-
-    if (!pCamera->HasShutter)
-        wxMessageBox(_("Cover guide scope"));
-    pCamera->ShutterClosed = true;
-
-    m_pProgress->SetValue(0);
-
-    wxString wrapupMsg;
-
-    bool err = false;
+    DarkBuildRequest req;
+    req.combine = (DARK_COMBINE_METHOD) m_pCombine->GetSelection();
+    req.clipSigma = pConfig->Profile.GetDouble("/camera/darks_clip_sigma", 3.0);
+    req.notes = m_pNotes->GetValue();
 
     if (buildDarkLib)
     {
-        int darkFrameCount = m_pDarkCount->GetValue();
+        req.target = DARK_BUILD_LIBRARY;
+        req.frameCount = m_pDarkCount->GetValue();
+        req.newLibrary = m_rbNewDarkLib->GetValue();    // User rebuilding from scratch
+
         int minExpInx = m_pDarkMinExpTime->GetSelection();
         int maxExpInx = m_pDarkMaxExpTime->GetSelection();
 
         std::vector<int> exposureDurations;
         GetExposureDurations(&exposureDurations);
 
-        int tot_dur = 0;
         for (int i = minExpInx; i <= maxExpInx; i++)
-            tot_dur += exposureDurations[i] * darkFrameCount;
-
-        m_pProgress->SetRange(tot_dur);
-        if (m_rbNewDarkLib->GetValue())           // User rebuilding from scratch
-            pCamera->ClearDarks();
-
-        for (int inx = minExpInx; inx <= maxExpInx; inx++)
-        {
-            int darkExpTime = exposureDurations[inx];
-            if (darkExpTime >= 1000)
-                ShowStatus (wxString::Format(_("Building master dark at %.1f sec:"), (double)darkExpTime / 1000.0), false);
-            else
-                ShowStatus (wxString::Format(_("Building master dark at %d mSec:"), darkExpTime), false);
-            usImage *newDark = new usImage();
-            err = CreateMasterDarkFrame(*newDark, exposureDurations[inx], darkFrameCount);
-            wxYield();
-            if (m_cancelling || err)
-            {
-                delete newDark;
-                break;
-            }
-            else
-            {
-                pCamera->AddDark(newDark);
-            }
-        }
-
-        if (m_cancelling || err)
-        {
-            ShowStatus(m_cancelling ? _("Operation cancelled - no changes have been made") : _("Operation failed - no changes have been made"), false);
-            if (pFrame->DarkLibExists(pConfig->GetCurrentProfileId(), false))
-            {
-                if (pFrame->LoadDarkHandler(true))
-                    Debug.AddLine("Dark library abort, dark library restored.");
-                else
-                    Debug.AddLine("Dark library abort, dark library still invalid.");
-            }
-        }
-        else
-        {
-            pFrame->SaveDarkLibrary(m_pNotes->GetValue());
-            pFrame->LoadDarkHandler(true);          // Put it to use, including selection of matching dark frame
-            wrapupMsg = _("dark library built");
-            if (m_rbNewDarkLib)
-                Debug.AddLine("Dark library - new dark lib created from scratch.");
-            else
-                Debug.AddLine("Dark library - dark lib modified/extended.");
-            ShowStatus(wrapupMsg, false);
-        }
+            req.exposures.push_back(exposureDurations[i]);
     }
     else
     {
         // Start by computing master dark frame with longish exposure times
-        ShowStatus(_("Taking darks to compute defect map: "),  false);
+        req.target = DARK_BUILD_DEFECT_MAP;
+        req.frameCount = m_pNumDefExposures->GetValue();
+        req.exposures.push_back(m_pDefectExpTime->GetValue() * 1000);
+    }
 
-        int defectFrameCount = m_pNumDefExposures->GetValue();
-        int defectExpTime = m_pDefectExpTime->GetValue() * 1000;
+    if (!pCamera->HasShutter)
+        wxMessageBox(_("Cover guide scope"));
 
-        m_pProgress->SetRange(defectFrameCount * defectExpTime);
-        m_pProgress->SetValue(0);
+    wxString err;
+    if (DarkBuilder::Start(req, &err))
+    {
+        ShowStatus(err, false);
+        return;
+    }
 
-        DefectMapDarks darks;
-        err = CreateMasterDarkFrame(darks.masterDark, defectExpTime, defectFrameCount);
+    m_pStartBtn->Enable(false);
+    m_pResetBtn->Enable(false);
+    m_pStopBtn->SetLabel(_("Stop"));
+    m_pStopBtn->Refresh();
+    m_started = true;
 
-        if (m_cancelling)
-        {
-            ShowStatus(_("Operation cancelled"), false);
-        }
-        else if (!err)
-        {
-            // Our role here is to build the dark-related files needed for defect map building
-            ShowStatus(_("Analyzing master dark..."), false);
+    m_pProgress->SetRange(DarkBuilder::GetStatus().total);
+    m_pProgress->SetValue(0);
 
-            // create a median-filtered dark
-            Debug.AddLine("Starting construction of filtered master dark file");
-            darks.BuildFilteredDark();
-            Debug.AddLine("Completed construction of filtered master dark file");
+    // the frames are captured and stacked on the dark builder thread; poll it
+    // for progress so the dialog stays responsive
+    enum { POLL_INTERVAL_MS = 250 };
+    m_timer.Start(POLL_INTERVAL_MS);
+}
 
-            // save the master dark and the median filtered dark
-            darks.SaveDarks(m_pNotes->GetValue());
+void DarksDialog::OnTimer(wxTimerEvent& evt)
+{
+    DarkBuildStatus st = DarkBuilder::GetStatus();
 
-            ShowStatus(_("Master dark data files built"), false);
+    m_pProgress->SetValue(std::min(st.progress, m_pProgress->GetRange()));
+    ShowStatus(st.message, false);
 
-            wrapupMsg = _("Master dark data files built");
-        }
+    // the build is not finished until the main thread has loaded the results
+    if (st.state != DARK_BUILD_RUNNING)
+    {
+        m_timer.Stop();
+        BuildFinished(st);
     }
+}
 
+void DarksDialog::BuildFinished(const DarkBuildStatus& st)
+{
     m_pStartBtn->Enable(true);
     m_pResetBtn->Enable(true);
-    pFrame->SetDarkMenuState();         // Hard to know where we are at this point
 
-    if (m_cancelling || err)
+    if (st.state != DARK_BUILD_SUCCEEDED)
     {
         m_pProgress->SetValue(0);
         m_cancelling = false;
@@ -374,7 +346,7 @@ void DarksDialog::OnStart(wxCommandEvent& evt)
     else
     {
         // Put up a message showing results and maybe notice to uncover the scope; then close the dialog
-        pCamera->ShutterClosed = false; // Lights
+        wxString wrapupMsg = st.message;
         if (!pCamera->HasShutter)
             wrapupMsg = _("Uncover guide scope") + wxT("\n\n") + wrapupMsg;   // Results will appear in smaller font
         wxMessageBox(wxString::Format(_("Operation complete: %s"), wrapupMsg));
@@ -388,6 +360,7 @@ void DarksDialog::OnStop(wxCommandEvent& evt)
     if (m_started)
     {
         m_cancelling = true;
+        DarkBuilder::Cancel();
         ShowStatus(_("Cancelling..."), false);
     }
     else
@@ -408,6 +381,7 @@ void DarksDialog::OnReset(wxCommandEvent& evt)
         m_pNumDefExposures->SetValue(DefDMCount);
         m_pNotes->SetValue("");
     }
+    m_pCombine->SetSelection(DefCombine);
 }
 
 void DarksDialog::ShowStatus(const wxString msg, bool appending)
@@ -437,121 +411,13 @@ void DarksDialog::SaveProfileInfo()
         pConfig->Profile.SetInt("/camera/dmap_num_frames", m_pNumDefExposures->GetValue());
     }
     pConfig->Profile.SetString("/camera/darks_note", m_pNotes->GetValue());
-}
-
-struct Histogram
-{
-    unsigned long val[256];
-    unsigned int median;
-    double mean;
-
-    Histogram(const usImage& img)
-    {
-        memset(&val[0], 0, sizeof(val));
-        mean = 0.0;
-        for (int i = 0; i < img.NPixels; i++)
-        {
-            unsigned short v = img.ImageData[i];
-            mean += v;
-            v >>= (img.BitsPerPixel - 8);
-            if (v > 255)
-                v = 255;  // should never happen if BitsPerPixel is valid
-            ++val[v];
-        }
-        mean /= img.NPixels;
-        // median (approx)
-        unsigned long sum = 0;
-        int i;
-        for (i = 0; i < 256; i++)
-        {
-            sum += val[i];
-            if (sum > img.NPixels / 2)
-                break;
-        }
-        median = i << (img.BitsPerPixel - 8);
-    }
-
-    void Dump()
-    {
-        Debug.Write(wxString::Format("mean = %.f  median(approx) = %u\n", mean, median));
-        int i = 0;
-        for (int l = 0; l < 4; l++)
-        {
-            std::ostringstream os;
-            os << "histo[" << (l * 64) << ".." << ((l + 1) * 64 - 1) << "]";
-            for (int j = 0; j < 64; j++, i++)
-                os << ' ' << val[i];
-            os << "\n";
-            Debug.Write(os.str());
-        }
-    }
-};
-
-bool DarksDialog::CreateMasterDarkFrame(usImage& darkFrame, int expTime, int frameCount)
-{
-    bool err = false;
-
-    pCamera->InitCapture();
-    darkFrame.ImgExpDur = expTime;
-    darkFrame.ImgStackCnt = frameCount;
-
-    unsigned int *avgimg = 0;
-
-    for (int j = 1; j <= frameCount; j++)
-    {
-        wxYield();
-        if (m_cancelling)
-            break;
-        ShowStatus(wxString::Format(_("Taking dark frame %d/%d"), j, frameCount), true);
-
-        Debug.Write(wxString::Format("Capture dark frame %d/%d exp=%d\n", j, frameCount, expTime));
-        err = GuideCamera::Capture(pCamera, expTime, darkFrame, CAPTURE_DARK);
-        if (err)
-        {
-            ShowStatus(wxString::Format(_("%.1f s dark FAILED"), (double)expTime / 1000.0), true);
-            pCamera->ShutterClosed = false;
-            break;
-        }
-
-        m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
-        wxYield();
-
-        darkFrame.CalcStats();
-        Debug.Write(wxString::Format("dark frame stats: bpp %u min %u max %u filtmin %u filtmax %u\n",
-            darkFrame.BitsPerPixel, darkFrame.Min, darkFrame.Max, darkFrame.FiltMin, darkFrame.FiltMax));
-        Histogram h(darkFrame);
-        h.Dump();
-        wxYield();
-
-        if (!avgimg)
-        {
-            avgimg = new unsigned int[darkFrame.NPixels];
-            memset(avgimg, 0, darkFrame.NPixels * sizeof(*avgimg));
-        }
-
-        unsigned int *iptr = avgimg;
-        const unsigned short *usptr = darkFrame.ImageData;
-        for (int i = 0; i < darkFrame.NPixels; i++)
-            *iptr++ += *usptr++;
-    }
-
-    if (!m_cancelling && !err)
-    {
-        ShowStatus(_("Dark frames complete"), true);
-        const unsigned int *iptr = avgimg;
-        unsigned short *usptr = darkFrame.ImageData;
-        for (int i = 0; i < darkFrame.NPixels; i++)
-            *usptr++ = (unsigned short)(*iptr++ / frameCount);
-    }
-
-    m_pProgress->SetValue(m_pProgress->GetValue() + expTime);
-    wxYield();
-
-    delete[] avgimg;
-
-    return err;
+    pConfig->Profile.SetInt("/camera/darks_combine", m_pCombine->GetSelection());
 }
 
 DarksDialog::~DarksDialog(void)
 {
+    // the dialog can be closed while a build is running; the build is
+    // finalized by the frame either way
+    if (m_started && DarkBuilder::IsActive())
+        DarkBuilder::Cancel();
 }
@@ -50,18 +50,21 @@ private:
     wxRadioButton *m_rbModifyDarkLib;
     wxRadioButton *m_rbNewDarkLib;
     wxTextCtrl *m_pNotes;
+    wxChoice *m_pCombine;
     wxGauge *m_pProgress;
     wxButton *m_pStartBtn;
     wxButton *m_pResetBtn;
     wxStatusBar *m_pStatusBar;
     wxButton *m_pStopBtn;
     wxArrayString m_expStrings;
+    wxTimer m_timer;
     void OnStart(wxCommandEvent& evt);
     void OnStop(wxCommandEvent& evt);
     void OnReset(wxCommandEvent& evt);
     void SaveProfileInfo();
     void ShowStatus(const wxString msg, bool appending);
-    bool CreateMasterDarkFrame(usImage& dark, int expTime, int frameCount);
+    void OnTimer(wxTimerEvent& evt);
+    void BuildFinished(const DarkBuildStatus& status);
 
 public:
     DarksDialog(wxWindow *parent, bool darkLibrary);
@@ -38,10 +38,86 @@
 #define ALWAYS_FLUSH_DEBUGLOG
 const int RetentionPeriod = 30;
 
+enum
+{
+    MAX_QUEUED_BYTES = 8 * 1024 * 1024,
+    WRITER_INTERVAL_MS = 100,
+};
+
+class DebugLogWriter : public wxThread
+{
+    DebugLog *m_log;
+    wxSemaphore m_wake;
+    volatile bool m_stop;
+
+public:
+    DebugLogWriter(DebugLog *log) : wxThread(wxTHREAD_JOINABLE), m_log(log), m_stop(false) { }
+
+    void Wake() { m_wake.Post(); }
+    void Stop() { m_stop = true; m_wake.Post(); }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("debug log");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "debug log");
+
+        while (!m_stop)
+        {
+            m_wake.WaitTimeout(WRITER_INTERVAL_MS);
+            m_log->DrainQueue();
+        }
+        m_log->DrainQueue();
+        return 0;
+    }
+};
+
 void DebugLog::InitVars(void)
 {
     m_bEnabled = false;
     m_lastWriteTime = wxDateTime::UNow();
+    m_queuedBytes = 0;
+    m_dropped = 0;
+    m_writer = 0;
+    m_levelCap = DBGLOG_VERBOSE;
+
+    for (int i = 0; i < DBGLOG_NUM_SUBSYSTEMS; i++)
+        m_level[i] = DefaultLevel((DebugLogSubsystem) i);
+}
+
+DebugLogLevel DebugLog::DefaultLevel(DebugLogSubsystem subsys)
+{
+    // every setting read used to be logged; that is too much to have on by default
+    return subsys == DBGLOG_CONFIG ? DBGLOG_INFO : DBGLOG_VERBOSE;
+}
+
+const char *DebugLog::SubsystemName(DebugLogSubsystem subsys)
+{
+    static const char *const s_names[DBGLOG_NUM_SUBSYSTEMS] = {
+        "general", "camera", "mount", "guider", "star", "worker", "server", "config",
+    };
+
+    return s_names[subsys];
+}
+
+void DebugLog::LoadLevels(void)
+{
+    for (int i = 0; i < DBGLOG_NUM_SUBSYSTEMS; i++)
+    {
+        DebugLogSubsystem subsys = (DebugLogSubsystem) i;
+        int level = pConfig->Global.GetInt(wxString("/debuglog/level/") + SubsystemName(subsys), DefaultLevel(subsys));
+        if (level < DBGLOG_OFF)
+            level = DBGLOG_OFF;
+        if (level > DBGLOG_VERBOSE)
+            level = DBGLOG_VERBOSE;
+        m_level[i] = (unsigned char) level;
+    }
+}
+
+void DebugLog::SetLevel(DebugLogSubsystem subsys, DebugLogLevel level)
+{
+    m_level[subsys] = (unsigned char) level;
+    if (pConfig)
+        pConfig->Global.SetInt(wxString("/debuglog/level/") + SubsystemName(subsys), level);
 }
 
 DebugLog::DebugLog(void)
@@ -57,6 +133,9 @@ DebugLog::DebugLog(const wxString& name, bool bEnabled = true)
 
 DebugLog::~DebugLog(void)
 {
+    // the writer thread should have been stopped by Shutdown(); if not, do not
+    // wait for it this late, just write what is queued
+    DrainQueue();
     wxFFile::Flush();
     wxFFile::Close();
 }
@@ -72,6 +151,9 @@ bool DebugLog::Enable(bool bEnabled)
 
 bool DebugLog::Init(const wxString& name, bool bEnable, bool bForceOpen)
 {
+    // anything queued belongs in the current file
+    DrainQueue();
+
     wxCriticalSectionLocker lock(m_criticalSection);
 
     if (m_bEnabled)
@@ -96,9 +178,54 @@ bool DebugLog::Init(const wxString& name, bool bEnable, bool bForceOpen)
 
     m_bEnabled = bEnable;
 
+    if (pConfig)
+        LoadLevels();
+
+    if (m_bEnabled && !m_writer)
+    {
+        DebugLogWriter *writer = new DebugLogWriter(this);
+        if (writer->Create() == wxTHREAD_NO_ERROR && writer->Run() == wxTHREAD_NO_ERROR)
+            m_writer = writer;
+        else
+            delete writer;  // lines will be written synchronously
+    }
+
     return m_bEnabled;
 }
 
+void DebugLog::Shutdown(void)
+{
+    if (m_writer)
+    {
+        DebugLogWriter *writer = m_writer;
+        m_writer = 0;   // from now on lines are written synchronously
+        writer->Stop();
+        writer->Wait();
+        delete writer;
+    }
+
+    Flush();
+}
+
+void DebugLog::EmergencyFlush(void)
+{
+    // called when the process is crashing: the crashing thread may hold either
+    // lock, so give up rather than wait for them
+    if (!m_criticalSection.TryEnter())
+        return;
+
+    if (m_queueLock.TryEnter())
+    {
+        WriteRecords(m_queue, m_dropped);
+        m_queue.clear();
+        m_dropped = 0;
+        m_queueLock.Leave();
+    }
+
+    wxFFile::Flush();
+    m_criticalSection.Leave();
+}
+
 bool DebugLog::ChangeDirLog(const wxString& newdir)
 {
     bool bEnabled = IsEnabled();
@@ -116,7 +243,8 @@ bool DebugLog::ChangeDirLog(const wxString& newdir)
 
 void DebugLog::RemoveOldFiles()
 {
-    Logger::RemoveMatchingFiles("PHD2_DebugLog*.txt", RetentionPeriod);
+    Logger::RemoveMatchingFiles("PHD2_DebugLog*.txt*", RetentionPeriod);
+    Logger::CompressMatchingFiles("PHD2_DebugLog*.txt", m_pPathName);
 }
 
 wxString DebugLog::AddLine(const wxString& str)
@@ -141,6 +269,8 @@ bool DebugLog::Flush(void)
 {
     bool bReturn = true;
 
+    DrainQueue();
+
     if (m_bEnabled)
     {
         wxCriticalSectionLocker lock(m_criticalSection);
@@ -151,27 +281,93 @@ bool DebugLog::Flush(void)
     return bReturn;
 }
 
-wxString DebugLog::Write(const wxString& str)
+void DebugLog::DrainQueue(void)
 {
-    if (m_bEnabled)
+    ALLOC_TAG(ALLOC_TAG_DEBUG_LOG);
+
+    // the file lock is taken first so that batches taken by different threads
+    // are written in the order they were queued
+    wxCriticalSectionLocker lock(m_criticalSection);
+
+    std::vector<Record> records;
+    unsigned int dropped;
     {
-        wxCriticalSectionLocker lock(m_criticalSection);
+        wxCriticalSectionLocker qlock(m_queueLock);
+        if (m_queue.empty() && !m_dropped)
+            return;
+        records.swap(m_queue);
+        m_queuedBytes = 0;
+        dropped = m_dropped;
+        m_dropped = 0;
+    }
 
-        wxDateTime now = wxDateTime::UNow();
-        wxTimeSpan deltaTime = now - m_lastWriteTime;
-        m_lastWriteTime = now;
-        wxString outputLine = wxString::Format("%s %s %lu %s", now.Format("%H:%M:%S.%l"),
-                                                              deltaTime.Format("%S.%l"),
-                                                              (unsigned long) wxThread::GetCurrentId(),
-                                                              str);
+    WriteRecords(records, dropped);
+}
 
-        wxFFile::Write(outputLine);
-#if defined(ALWAYS_FLUSH_DEBUGLOG)
-        wxFFile::Flush();
-#endif
+// call with m_criticalSection held
+void DebugLog::WriteRecords(const std::vector<Record>& records, unsigned int dropped)
+{
+    if (!IsOpened())
+        return;
+
+    wxString batch;
+
+    for (std::vector<Record>::const_iterator it = records.begin(); it != records.end(); ++it)
+    {
+        wxTimeSpan deltaTime = it->time - m_lastWriteTime;
+        m_lastWriteTime = it->time;
+        wxString outputLine = wxString::Format("%s %s %lu %s", it->time.Format("%H:%M:%S.%l"),
+                                                              deltaTime.Format("%S.%l"),
+                                                              it->threadId,
+                                                              it->str);
 #if defined(__WINDOWS__) && defined(_DEBUG)
         OutputDebugString(outputLine.c_str());
 #endif
+        batch += outputLine;
+    }
+
+    if (dropped)
+    {
+        batch += wxString::Format("%s 0.000 %lu debug log queue full, %u lines dropped\n",
+            m_lastWriteTime.Format("%H:%M:%S.%l"), (unsigned long) wxThread::GetCurrentId(), dropped);
+    }
+
+    wxFFile::Write(batch);
+#if defined(ALWAYS_FLUSH_DEBUGLOG)
+    wxFFile::Flush();
+#endif
+}
+
+wxString DebugLog::Write(const wxString& str)
+{
+    ALLOC_TAG(ALLOC_TAG_DEBUG_LOG);
+
+    if (m_bEnabled)
+    {
+        Record rec;
+        rec.time = wxDateTime::UNow();
+        rec.threadId = (unsigned long) wxThread::GetCurrentId();
+        rec.str = str;
+
+        bool wake;
+        {
+            wxCriticalSectionLocker lock(m_queueLock);
+
+            if (m_queuedBytes + str.length() > MAX_QUEUED_BYTES)
+            {
+                ++m_dropped;
+                return str;
+            }
+
+            wake = m_queue.empty();
+            m_queue.push_back(rec);
+            m_queuedBytes += str.length();
+        }
+
+        if (!m_writer)
+            DrainQueue();
+        else if (wake)
+            m_writer->Wake();
     }
 
     return str;
@@ -38,15 +38,73 @@
 
 #include "logger.h"
 
+class DebugLogWriter;
+
+// Subsystems and levels for the DEBUG_LOG macro. Each subsystem has its own
+// level, read from /debuglog/level/<subsystem> in the global profile; the
+// defaults log everything, as before, except for config reads.
+enum DebugLogSubsystem
+{
+    DBGLOG_GENERAL,
+    DBGLOG_CAMERA,
+    DBGLOG_MOUNT,
+    DBGLOG_GUIDER,
+    DBGLOG_STAR,
+    DBGLOG_WORKER,
+    DBGLOG_SERVER,
+    DBGLOG_CONFIG,
+    DBGLOG_NUM_SUBSYSTEMS,
+};
+
+enum DebugLogLevel
+{
+    DBGLOG_OFF,
+    DBGLOG_INFO,
+    DBGLOG_VERBOSE,
+};
+
+// Logs a formatted line only when the subsystem is enabled at the given level.
+// The arguments are not evaluated and nothing is formatted otherwise, so this
+// is the form to use on per-frame paths.
+#define DEBUG_LOG(subsys, level, ...) \
+    do { \
+        if (Debug.IsEnabled(subsys, level)) \
+            Debug.Write(wxString::Format(__VA_ARGS__)); \
+    } while (0)
+
+// Lines are queued by the calling thread with only a brief lock, then
+// timestamped, formatted and written in batches by a background writer
+// thread, so logging never waits on the disk. The queue is bounded; lines
+// logged while it is full are counted and dropped.
 class DebugLog : public wxFFile, public Logger
 {
+public:
+    struct Record
+    {
+        wxDateTime time;
+        unsigned long threadId;
+        wxString str;
+    };
+
 private:
     bool m_bEnabled;
-    wxCriticalSection m_criticalSection;
+    unsigned char m_level[DBGLOG_NUM_SUBSYSTEMS];
+    volatile unsigned char m_levelCap;      // no subsystem logs above this, not saved
+    wxCriticalSection m_criticalSection;    // protects the file
     wxDateTime m_lastWriteTime;
     wxString m_pPathName;
 
+    wxCriticalSection m_queueLock;          // protects the queue
+    std::vector<Record> m_queue;
+    size_t m_queuedBytes;
+    unsigned int m_dropped;
+    DebugLogWriter *m_writer;
+
     void InitVars(void);
+    void LoadLevels(void);
+    void WriteRecords(const std::vector<Record>& records, unsigned int dropped);
+
+    friend class DebugLogWriter;
 
 public:
     DebugLog(void);
@@ -55,11 +113,20 @@ public:
 
     bool Enable(bool bEnabled);
     bool IsEnabled(void);
+    const wxString& GetLogFileName(void) const { return m_pPathName; }
+    bool IsEnabled(DebugLogSubsystem subsys, DebugLogLevel level);
+    void SetLevel(DebugLogSubsystem subsys, DebugLogLevel level);
+    void SetLevelCap(DebugLogLevel cap) { m_levelCap = (unsigned char) cap; }
+    static const char *SubsystemName(DebugLogSubsystem subsys);
+    static DebugLogLevel DefaultLevel(DebugLogSubsystem subsys);
     bool Init(const wxString& name, bool bEnable, bool bForceOpen = false);
     wxString AddLine(const wxString& str); // adds a newline
     wxString AddBytes(const wxString& str, const unsigned char *pBytes, unsigned count);
     wxString Write(const wxString& str);
-    bool Flush(void);
+    bool Flush(void);               // write out everything queued, in the calling thread
+    void Shutdown(void);            // flush and stop the writer thread
+    void EmergencyFlush(void);      // best-effort flush from a fatal exception handler
+    void DrainQueue(void);
 
     bool ChangeDirLog(const wxString& newdir);
     void RemoveOldFiles();
@@ -75,6 +142,11 @@ inline bool DebugLog::IsEnabled(void)
     return m_bEnabled;
 }
 
+inline bool DebugLog::IsEnabled(DebugLogSubsystem subsys, DebugLogLevel level)
+{
+    return m_bEnabled && level <= m_level[subsys] && level <= m_levelCap;
+}
+
 extern DebugLog Debug;
 
 #endif
@@ -0,0 +1,341 @@
+/*
+ *  defect_learner.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+DefectLearner DefectLearning;
+
+enum
+{
+    NOISE_SAMPLE_STEP = 7,          // every 7th pixel for the noise estimate
+    MIN_THRESHOLD = 3,              // ADU, for frames with almost no noise
+};
+
+class DefectLearnerThread : public wxThread
+{
+    DefectLearner *m_learner;
+    wxSemaphore m_wake;
+    volatile bool m_stop;
+
+public:
+    DefectLearnerThread(DefectLearner *learner) : wxThread(wxTHREAD_JOINABLE), m_learner(learner), m_stop(false) { }
+
+    void Wake() { m_wake.Post(); }
+    void Stop() { m_stop = true; m_wake.Post(); }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("defect learner");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "defect learner");
+
+        while (!m_stop)
+        {
+            m_wake.Wait();
+            PHD_Point pos;
+            while (usImage *img = m_learner->PopSample(&pos))
+            {
+                m_learner->Learn(*img, pos);
+                delete img;
+            }
+        }
+        return 0;
+    }
+};
+
+DefectLearner::DefectLearner()
+    : m_enabled(false),
+      m_apply(true),
+      m_intervalMs(10000),
+      m_sample(0),
+      m_lastSample(0),
+      m_resetPending(false),
+      m_observations(0),
+      m_frames(0),
+      m_map(0),
+      m_mapObservations(0),
+      m_thread(0)
+{
+}
+
+DefectLearner::~DefectLearner()
+{
+    // the thread should have been stopped by Shutdown()
+    delete m_sample;
+    delete m_map;
+}
+
+void DefectLearner::LoadProfileSettings(void)
+{
+    bool enabled = pConfig->Profile.GetBoolean("/DefectLearner/Enabled", false);
+    m_apply = pConfig->Profile.GetBoolean("/DefectLearner/Apply", true);
+    m_intervalMs = wxMax(1, pConfig->Profile.GetInt("/DefectLearner/Interval", 10)) * 1000;
+
+    if (!m_map)
+    {
+        wxCriticalSectionLocker lck(m_mapLock);
+        m_map = new DefectMap();
+    }
+
+    // the defects of another profile's camera do not apply
+    Reset();
+    m_enabled = enabled;
+
+    Debug.Write(wxString::Format("DefectLearner: enabled %d, interval %d s, apply %d\n", enabled, m_intervalMs / 1000, m_apply));
+}
+
+void DefectLearner::NotifyStarPosition(const PHD_Point& pos)
+{
+    wxCriticalSectionLocker lck(m_posLock);
+    m_starPos = pos;
+}
+
+void DefectLearner::ProcessFrame(usImage& img)
+{
+    if (!m_enabled || !img.ImageData)
+        return;
+
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+
+    if (img.Subframe.IsEmpty() && now - m_lastSample >= m_intervalMs)
+    {
+        PHD_Point pos;
+        {
+            wxCriticalSectionLocker lck(m_posLock);
+            pos = m_starPos;
+        }
+
+        // without a star there is no telling whether the field moved
+        if (pos.IsValid())
+        {
+            usImage *copy = new usImage();
+            if (!copy->Init(img.Size))
+            {
+                memcpy(copy->ImageData, img.ImageData, img.NPixels * sizeof(unsigned short));
+                m_lastSample = now;
+
+                bool start;
+                {
+                    wxCriticalSectionLocker lck(m_sampleLock);
+                    delete m_sample;        // not picked up yet, the newer frame replaces it
+                    m_sample = copy;
+                    m_sampleStarPos = pos;
+                    copy = 0;
+                    start = !m_thread;
+                }
+
+                if (start)
+                {
+                    DefectLearnerThread *thread = new DefectLearnerThread(this);
+                    if (thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR)
+                        m_thread = thread;
+                    else
+                    {
+                        delete thread;
+                        Debug.AddLine("DefectLearner: could not start thread");
+                        m_enabled = false;
+                    }
+                }
+                if (m_thread)
+                    m_thread->Wake();
+            }
+            delete copy;
+        }
+    }
+
+    if (m_apply && pCamera && !pCamera->CurrentDefectMap)
+    {
+        wxCriticalSectionLocker lck(m_mapLock);
+        if (m_map && !m_map->empty())
+            RemoveDefects(img, *m_map);
+    }
+}
+
+usImage *DefectLearner::PopSample(PHD_Point *starPos)
+{
+    wxCriticalSectionLocker lck(m_sampleLock);
+    usImage *img = m_sample;
+    m_sample = 0;
+    *starPos = m_sampleStarPos;
+    return img;
+}
+
+// noise of a frame from the differences of horizontally adjacent pixels,
+// which are insensitive to gradients and to the few stars and defects
+static double frame_noise(const usImage& img)
+{
+    int const width = img.Size.GetWidth();
+    int const height = img.Size.GetHeight();
+
+    std::vector<unsigned short> diffs;
+    diffs.reserve(img.NPixels / (NOISE_SAMPLE_STEP * NOISE_SAMPLE_STEP) + 1);
+    for (int y = 0; y < height; y += NOISE_SAMPLE_STEP)
+    {
+        const unsigned short *row = &img.ImageData[y * width];
+        for (int x = 0; x + 1 < width; x += NOISE_SAMPLE_STEP)
+            diffs.push_back((unsigned short) abs((int) row[x + 1] - (int) row[x]));
+    }
+    if (diffs.empty())
+        return 0.0;
+
+    std::vector<unsigned short>::iterator mid = diffs.begin() + diffs.size() / 2;
+    std::nth_element(diffs.begin(), mid, diffs.end());
+
+    // MAD to sigma, and the difference of two pixels has sqrt(2) times the noise
+    return 1.4826 * *mid / sqrt(2.0);
+}
+
+void DefectLearner::Learn(const usImage& img, const PHD_Point& starPos)
+{
+    if (m_resetPending || img.Size != m_size)
+    {
+        m_resetPending = false;
+        m_size = img.Size;
+        m_hits.assign(img.NPixels, 0);
+        m_observations = 0;
+        m_frames = 0;
+        m_lastObservedPos.Invalidate();
+    }
+
+    ++m_frames;
+
+    if (m_lastObservedPos.IsValid() && m_lastObservedPos.Distance(starPos) < MIN_SHIFT)
+        return;
+    m_lastObservedPos = starPos;
+
+    int const width = img.Size.GetWidth();
+    int const height = img.Size.GetHeight();
+    int const threshold = wxMax((int) MIN_THRESHOLD, (int)(NOISE_SIGMAS * frame_noise(img) + 0.5));
+
+    for (int y = 1; y < height - 1; y++)
+    {
+        const unsigned short *row = &img.ImageData[y * width];
+        unsigned char *hits = &m_hits[y * width];
+        for (int x = 1; x < width - 1; x++)
+        {
+            int const p = row[x];
+            int const up = row[x - width], down = row[x + width], left = row[x - 1], right = row[x + 1];
+            int const hi = wxMax(wxMax(up, down), wxMax(left, right));
+            int const lo = wxMin(wxMin(up, down), wxMin(left, right));
+            if ((p > hi + threshold || p + threshold < lo) && hits[x] < 255)
+                ++hits[x];
+        }
+    }
+
+    if (++m_observations >= MAX_OBSERVATIONS)
+    {
+        for (std::vector<unsigned char>::iterator it = m_hits.begin(); it != m_hits.end(); ++it)
+            *it >>= 1;
+        m_observations >>= 1;
+    }
+
+    Publish();
+}
+
+void DefectLearner::Publish(void)
+{
+    std::vector<wxPoint> defects;
+    std::vector<double> confidence;
+
+    if (m_observations >= MIN_OBSERVATIONS)
+    {
+        int const width = m_size.GetWidth();
+        unsigned int const minHits = (m_observations * CONFIDENCE_PCT + 99) / 100;
+        for (size_t i = 0; i < m_hits.size(); i++)
+        {
+            if (m_hits[i] >= minHits)
+            {
+                defects.push_back(wxPoint((int)(i % width), (int)(i / width)));
+                confidence.push_back(wxMin(1.0, (double) m_hits[i] / m_observations));
+            }
+        }
+    }
+    size_t prev;
+    {
+        wxCriticalSectionLocker lck(m_mapLock);
+        if (m_resetPending || !m_map)
+            return;
+        prev = m_map->size();
+        // the scan is in row order, which is the order BuildIndex sorts to
+        m_map->assign(defects.begin(), defects.end());
+        m_map->BuildIndex();
+        m_confidence.swap(confidence);
+        m_mapObservations = m_observations;
+    }
+
+    if (defects.size() != prev)
+        Debug.Write(wxString::Format("DefectLearner: %u defects after %u observations of %u frames\n",
+            (unsigned int) defects.size(), m_observations, m_frames));
+}
+
+void DefectLearner::Reset(void)
+{
+    m_resetPending = true;
+
+    wxCriticalSectionLocker lck(m_mapLock);
+    if (m_map)
+    {
+        m_map->clear();
+        m_map->BuildIndex();
+    }
+    m_confidence.clear();
+    m_mapObservations = 0;
+}
+
+void DefectLearner::GetDefects(std::vector<LearnedDefect> *defects, unsigned int *observations)
+{
+    wxCriticalSectionLocker lck(m_mapLock);
+
+    defects->clear();
+    *observations = m_mapObservations;
+    if (!m_map)
+        return;
+    defects->reserve(m_map->size());
+    for (size_t i = 0; i < m_map->size(); i++)
+    {
+        LearnedDefect d;
+        d.pt = (*m_map)[i];
+        d.confidence = m_confidence[i];
+        defects->push_back(d);
+    }
+}
+
+void DefectLearner::Shutdown(void)
+{
+    if (m_thread)
+    {
+        m_thread->Stop();
+        m_thread->Wait();
+        delete m_thread;
+        m_thread = 0;
+    }
+}
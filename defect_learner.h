@@ -0,0 +1,133 @@
+/*
+ *  defect_learner.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DEFECT_LEARNER_INCLUDED
+#define DEFECT_LEARNER_INCLUDED
+
+class DefectLearnerThread;
+
+struct LearnedDefect
+{
+    wxPoint pt;
+    double confidence;      // fraction of the observations where the pixel stood out
+};
+
+// Learns hot and cold pixels from the guide frames, without capping the
+// scope. The camera worker thread hands it a copy of a full frame every
+// few seconds, before noise reduction; a background thread flags the pixels
+// that stand out from their four neighbours by several times the frame
+// noise. A frame only counts as an observation if the guide star has moved
+// by at least MIN_SHIFT pixels since the last one, which dithering does, so
+// that stars do not stay on the same pixels. A pixel flagged in at least
+// CONFIDENCE_PCT percent of MIN_OBSERVATIONS or more observations is a
+// defect. Each pixel has a single byte counter: the observation count is
+// shared, and all counters are halved when it reaches MAX_OBSERVATIONS, so
+// older frames weigh less and pixels that heal drop out of the map.
+//
+// The learned defects are removed from the guide frames, like a defect map,
+// unless a defect map is in use.
+//
+// Profile settings: /DefectLearner/Enabled (default false),
+// /DefectLearner/Interval seconds between frames (default 10),
+// /DefectLearner/Apply remove the learned defects (default true).
+class DefectLearner
+{
+public:
+    enum
+    {
+        MIN_SHIFT = 3,
+        MIN_OBSERVATIONS = 10,
+        MAX_OBSERVATIONS = 250,
+        CONFIDENCE_PCT = 80,
+        NOISE_SIGMAS = 6,
+    };
+
+private:
+    volatile bool m_enabled;
+    bool m_apply;
+    int m_intervalMs;
+
+    // written by the main thread, read by the camera worker thread
+    wxCriticalSection m_posLock;
+    PHD_Point m_starPos;
+
+    // the sampled frame, handed from the camera worker thread to the learner thread
+    wxCriticalSection m_sampleLock;
+    usImage *m_sample;
+    PHD_Point m_sampleStarPos;
+    wxLongLong_t m_lastSample;      // ms
+
+    volatile bool m_resetPending;
+
+    // learner thread only
+    wxSize m_size;
+    std::vector<unsigned char> m_hits;
+    unsigned int m_observations;
+    unsigned int m_frames;          // frames examined, observed or not
+    PHD_Point m_lastObservedPos;
+
+    // the learned defects, read by the camera worker thread and the server
+    wxCriticalSection m_mapLock;
+    DefectMap *m_map;       // created with the profile settings, a DefectMap needs pConfig
+    std::vector<double> m_confidence;       // in the order of m_map
+    unsigned int m_mapObservations;
+
+    DefectLearnerThread *m_thread;
+
+    friend class DefectLearnerThread;
+
+    usImage *PopSample(PHD_Point *starPos);
+    void Learn(const usImage& img, const PHD_Point& starPos);
+    void Publish(void);
+
+public:
+    DefectLearner();
+    ~DefectLearner();
+
+    void LoadProfileSettings(void);
+    bool IsEnabled(void) const { return m_enabled; }
+
+    // on the main thread, for each frame with a star
+    void NotifyStarPosition(const PHD_Point& pos);
+    // on the camera worker thread, for each light frame before noise reduction;
+    // may take a sample, then removes the learned defects
+    void ProcessFrame(usImage& img);
+
+    void Reset(void);
+    void GetDefects(std::vector<LearnedDefect> *defects, unsigned int *observations);
+    void Shutdown(void);
+};
+
+extern DefectLearner DefectLearning;
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ *  device_lists.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+wxDEFINE_EVENT(DEVICE_LIST_READY_EVENT, wxThreadEvent);
+
+enum DeviceFamily
+{
+    FAMILY_CAMERA,
+    FAMILY_MOUNT,       // the mount and aux mount lists, both from the ASCOM telescopes
+    FAMILY_AO,
+    FAMILY_ROTATOR,
+    NUM_DEVICE_FAMILIES,
+};
+
+static DeviceFamily FamilyOf(DeviceListKind kind)
+{
+    switch (kind) {
+    case DEVICES_CAMERA:    return FAMILY_CAMERA;
+    case DEVICES_AO:        return FAMILY_AO;
+    case DEVICES_ROTATOR:   return FAMILY_ROTATOR;
+    default:                return FAMILY_MOUNT;
+    }
+}
+
+class DeviceEnumThread : public wxThread
+{
+    DeviceFamily m_family;
+
+public:
+    DeviceEnumThread(DeviceFamily family) : wxThread(wxTHREAD_JOINABLE), m_family(family) { }
+    ExitCode Entry();
+};
+
+struct DeviceListsImpl
+{
+    wxMutex lock;
+    wxCondition cond;           // signalled when a family has been enumerated
+    wxArrayString lists[NUM_DEVICE_LISTS];
+    bool valid[NUM_DEVICE_LISTS];
+    DeviceEnumThread *thread[NUM_DEVICE_FAMILIES];
+    bool running[NUM_DEVICE_FAMILIES];
+    wxEvtHandler *handler;
+
+    DeviceListsImpl() : cond(lock), handler(0)
+    {
+        for (int i = 0; i < NUM_DEVICE_LISTS; i++)
+            valid[i] = false;
+        for (int i = 0; i < NUM_DEVICE_FAMILIES; i++)
+        {
+            thread[i] = 0;
+            running[i] = false;
+        }
+    }
+
+    void Start(DeviceFamily family);
+};
+
+static DeviceListsImpl& s_lists = *new DeviceListsImpl();
+
+// lock must be held
+void DeviceListsImpl::Start(DeviceFamily family)
+{
+    if (running[family])
+        return;
+
+    if (thread[family])
+    {
+        // finished; reap it
+        thread[family]->Wait();
+        delete thread[family];
+        thread[family] = 0;
+    }
+
+    DeviceEnumThread *t = new DeviceEnumThread(family);
+    if (t->Create() != wxTHREAD_NO_ERROR || t->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.Write(wxString::Format("DeviceLists: could not start enumeration thread for family %d\n", family));
+        delete t;
+        return;
+    }
+
+    thread[family] = t;
+    running[family] = true;
+}
+
+wxThread::ExitCode DeviceEnumThread::Entry()
+{
+    PerfTrace::SetThreadName("device enum");
+    ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "device enum");
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+    Debug.Write(wxString::Format("device enumeration CoInitializeEx returns %x\n", hr));
+#endif
+
+    wxStopWatch swatch;
+
+    DeviceListKind kinds[2];
+    wxArrayString lists[2];
+    int count = 0;
+
+    switch (m_family) {
+    case FAMILY_CAMERA:
+        kinds[count] = DEVICES_CAMERA;
+        lists[count++] = GuideCamera::List();
+        break;
+    case FAMILY_MOUNT:
+        kinds[count] = DEVICES_MOUNT;
+        lists[count++] = Scope::List();
+        kinds[count] = DEVICES_AUX_MOUNT;
+        lists[count++] = Scope::AuxMountList();
+        break;
+    case FAMILY_AO:
+        kinds[count] = DEVICES_AO;
+        lists[count++] = StepGuider::List();
+        break;
+    case FAMILY_ROTATOR:
+        kinds[count] = DEVICES_ROTATOR;
+        lists[count++] = Rotator::List();
+        break;
+    default:
+        break;
+    }
+
+    Debug.Write(wxString::Format("DeviceLists: family %d enumerated in %ld ms\n", m_family, swatch.Time()));
+
+    {
+        wxMutexLocker lck(s_lists.lock);
+
+        for (int i = 0; i < count; i++)
+        {
+            // the strings live on after this thread, so do not share their buffers
+            s_lists.lists[kinds[i]].Clear();
+            for (size_t j = 0; j < lists[i].size(); j++)
+                s_lists.lists[kinds[i]].Add(lists[i][j].Clone());
+            s_lists.valid[kinds[i]] = true;
+
+            if (s_lists.handler)
+            {
+                wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, DEVICE_LIST_READY_EVENT);
+                event->SetInt(kinds[i]);
+                wxQueueEvent(s_lists.handler, event);
+            }
+        }
+
+        s_lists.running[m_family] = false;
+        s_lists.cond.Broadcast();
+    }
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    return 0;
+}
+
+void DeviceLists::Refresh(wxEvtHandler *handler)
+{
+    wxMutexLocker lck(s_lists.lock);
+
+    s_lists.handler = handler;
+
+    for (int i = 0; i < NUM_DEVICE_FAMILIES; i++)
+        s_lists.Start((DeviceFamily) i);
+}
+
+bool DeviceLists::Get(DeviceListKind kind, wxArrayString *list)
+{
+    wxMutexLocker lck(s_lists.lock);
+
+    if (!s_lists.valid[kind])
+        return false;
+
+    list->Clear();
+    for (size_t i = 0; i < s_lists.lists[kind].size(); i++)
+        list->Add(s_lists.lists[kind][i].Clone());
+
+    return true;
+}
+
+wxArrayString DeviceLists::Wait(DeviceListKind kind)
+{
+    DeviceFamily family = FamilyOf(kind);
+
+    {
+        wxMutexLocker lck(s_lists.lock);
+
+        if (!s_lists.valid[kind])
+        {
+            s_lists.Start(family);
+
+            while (!s_lists.valid[kind] && s_lists.running[family])
+                s_lists.cond.Wait();
+        }
+    }
+
+    wxArrayString list;
+    if (!Get(kind, &list))
+    {
+        // the thread could not be started
+        switch (kind) {
+        case DEVICES_CAMERA:    list = GuideCamera::List(); break;
+        case DEVICES_MOUNT:     list = Scope::List(); break;
+        case DEVICES_AUX_MOUNT: list = Scope::AuxMountList(); break;
+        case DEVICES_AO:        list = StepGuider::List(); break;
+        case DEVICES_ROTATOR:   list = Rotator::List(); break;
+        default: break;
+        }
+    }
+
+    return list;
+}
+
+void DeviceLists::Shutdown(void)
+{
+    DeviceEnumThread *threads[NUM_DEVICE_FAMILIES];
+
+    {
+        wxMutexLocker lck(s_lists.lock);
+
+        s_lists.handler = 0;
+
+        for (int i = 0; i < NUM_DEVICE_FAMILIES; i++)
+        {
+            threads[i] = s_lists.thread[i];
+            s_lists.thread[i] = 0;
+        }
+    }
+
+    for (int i = 0; i < NUM_DEVICE_FAMILIES; i++)
+    {
+        if (threads[i])
+        {
+            threads[i]->Wait();
+            delete threads[i];
+        }
+    }
+
+    wxMutexLocker lck(s_lists.lock);
+    for (int i = 0; i < NUM_DEVICE_FAMILIES; i++)
+        s_lists.running[i] = false;
+}
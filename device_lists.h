@@ -0,0 +1,71 @@
+/*
+ *  device_lists.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef DEVICE_LISTS_INCLUDED
+#define DEVICE_LISTS_INCLUDED
+
+enum DeviceListKind
+{
+    DEVICES_CAMERA,
+    DEVICES_MOUNT,
+    DEVICES_AUX_MOUNT,
+    DEVICES_AO,
+    DEVICES_ROTATOR,
+    NUM_DEVICE_LISTS,
+};
+
+// queued to the handler passed to DeviceLists::Refresh when a list has been
+// enumerated; GetInt() is the DeviceListKind
+wxDECLARE_EVENT(DEVICE_LIST_READY_EVENT, wxThreadEvent);
+
+// The choices for the gear dialog and the profile wizard. Building them
+// means querying the ASCOM profile for each device type, which can take
+// seconds, so each family of lists (cameras, mounts, AO, rotators) is
+// enumerated on its own background thread and the results are kept until
+// the next refresh.
+class DeviceLists
+{
+public:
+    // start enumerating every family that is not already being enumerated;
+    // the previous lists stay available until the new ones are ready
+    static void Refresh(wxEvtHandler *handler);
+    // the most recent list, returns false if none has been enumerated yet
+    static bool Get(DeviceListKind kind, wxArrayString *list);
+    // the most recent list, waiting for it to be enumerated if there is none
+    static wxArrayString Wait(DeviceListKind kind);
+    // stop notifying the handler and wait for the enumerations in progress
+    static void Shutdown(void);
+};
+
+#endif
@@ -59,8 +59,62 @@ enum CtrlIds
     ID_ADJUST,
     ID_PHASE,
     ID_TIMER,
+    ID_AUTOSTOP,
 };
 
+// a drift stops on its own once the alignment error is known to within
+// the larger of these
+static const double AUTOSTOP_MIN_SIGMA = 0.5;       // arc-min
+static const double AUTOSTOP_REL_SIGMA = 0.15;      // of the error
+static const double AUTOSTOP_MIN_DURATION = 60.0;   // seconds
+static const unsigned int AUTOSTOP_MIN_SAMPLES = 20;
+
+void DriftFit::Reset()
+{
+    m_n = 0;
+    m_t0 = m_y0 = m_tlast = 0.0;
+    m_st = m_sy = m_stt = m_sty = m_syy = 0.0;
+}
+
+void DriftFit::AddSample(double t, double dec)
+{
+    if (m_n == 0)
+    {
+        m_t0 = t;
+        m_y0 = dec;
+    }
+
+    double const x = (t - m_t0) / 60.0;
+    double const y = dec - m_y0;
+
+    ++m_n;
+    m_st += x;
+    m_sy += y;
+    m_stt += x * x;
+    m_sty += x * y;
+    m_syy += y * y;
+    m_tlast = t;
+}
+
+bool DriftFit::Rate(double *rate, double *sigma) const
+{
+    if (m_n < 3)
+        return false;
+
+    double const n = (double) m_n;
+    double const sxx = m_stt - m_st * m_st / n;
+    if (sxx <= 0.0)
+        return false;
+
+    double const sxy = m_sty - m_st * m_sy / n;
+    double const syy = m_syy - m_sy * m_sy / n;
+
+    *rate = sxy / sxx;
+    double const resid = wxMax(0.0, syy - *rate * sxy);
+    *sigma = sqrt(resid / (n - 2.0) / sxx);
+    return true;
+}
+
 struct DriftToolWin : public wxFrame
 {
     DriftToolWin();
@@ -68,6 +122,8 @@ struct DriftToolWin : public wxFrame
 
     void UpdatePhaseState();
     void UpdateModeState();
+    void OnGuideStep(const GuideStepInfo& info);
+    bool AlignmentError(double *err, double *sigma) const;
 
     Phase m_phase;
     Mode m_mode;
@@ -83,6 +139,7 @@ struct DriftToolWin : public wxFrame
     bool m_can_slew;
     bool m_slewing;
     PHD_Point m_siteLatLong;
+    DriftFit m_fit;
 
     wxStaticBitmap *m_bmp;
     wxBitmap *m_azArrowBmp;
@@ -99,6 +156,7 @@ struct DriftToolWin : public wxFrame
     wxButton *m_drift;
     wxButton *m_adjust;
     wxButton *m_phaseBtn;
+    wxCheckBox *m_autoStop;
     wxStatusBar *m_statusBar;
     wxTimer *m_timer;
 
@@ -110,6 +168,7 @@ struct DriftToolWin : public wxFrame
     void OnDrift(wxCommandEvent& evt);
     void OnAdjust(wxCommandEvent& evt);
     void OnPhase(wxCommandEvent& evt);
+    void OnAutoStop(wxCommandEvent& evt);
     void OnAppStateNotify(wxCommandEvent& evt);
     void OnClose(wxCloseEvent& evt);
     void OnTimer(wxTimerEvent& evt);
@@ -125,6 +184,7 @@ BEGIN_EVENT_TABLE(DriftToolWin, wxFrame)
     EVT_BUTTON(ID_DRIFT, DriftToolWin::OnDrift)
     EVT_BUTTON(ID_ADJUST, DriftToolWin::OnAdjust)
     EVT_BUTTON(ID_PHASE, DriftToolWin::OnPhase)
+    EVT_CHECKBOX(ID_AUTOSTOP, DriftToolWin::OnAutoStop)
     EVT_COMMAND(wxID_ANY, APPSTATE_NOTIFY_EVENT, DriftToolWin::OnAppStateNotify)
     EVT_CLOSE(DriftToolWin::OnClose)
     EVT_TIMER(ID_TIMER, DriftToolWin::OnTimer)
@@ -231,6 +291,12 @@ DriftToolWin::DriftToolWin()
     topSizer->Add(m_notes, 0, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 5);
     m_notes->Bind(wxEVT_COMMAND_TEXT_UPDATED, &DriftToolWin::OnNotesText, this);
 
+    m_autoStop = new wxCheckBox(this, ID_AUTOSTOP, _("Stop drifting when the error is measured"));
+    m_autoStop->SetToolTip(_("End each drift as soon as the fitted drift rate gives the alignment error to within 15% (or 0.5 arc-min), "
+        "instead of waiting for you to click Adjust."));
+    m_autoStop->SetValue(pConfig->Global.GetBoolean("/DriftTool/AutoStop", true));
+    topSizer->Add(m_autoStop, 0, wxLEFT | wxRIGHT | wxTOP, 8);
+
     // horizontal sizer for the buttons
     wxBoxSizer *hSizer = new wxBoxSizer(wxHORIZONTAL);
 
@@ -470,6 +536,7 @@ repeat:
                 SetStatusText(_("Drifting... click Adjust when done drifting"));
                 pFrame->pGraphLog->OnButtonClear(dummy);
                 pFrame->pGraphLog->EnableTrendLines(true);
+                m_fit.Reset();
                 m_drifting = true;
                 return;
             case STATE_STOP:
@@ -656,6 +723,71 @@ void DriftToolWin::OnPhase(wxCommandEvent& evt)
     }
 }
 
+void DriftToolWin::OnAutoStop(wxCommandEvent& evt)
+{
+    pConfig->Global.SetBoolean("/DriftTool/AutoStop", m_autoStop->GetValue());
+}
+
+// The alignment error in arc-min from the fitted Dec drift rate (Barrett,
+// as in GuideAnalysis::PolarAlignmentError), scaled as the polar align circle
+// is for where the scope points
+bool DriftToolWin::AlignmentError(double *err, double *sigma) const
+{
+    double rate, rateSigma;
+    if (!m_fit.Rate(&rate, &rateSigma))
+        return false;
+
+    double scale = 3.8197 * pFrame->GetCameraPixelScale();
+
+    double ra_hrs, dec_deg, st_hrs;
+    if (!PointingCache::GetCoordinates(&ra_hrs, &dec_deg, &st_hrs))
+    {
+        double const dec_r = radians(dec_deg);
+        if (fabs(dec_r) < Scope::DEC_COMP_LIMIT)
+            scale /= cos(dec_r);
+
+        if (m_phase == PHASE_ADJUST_ALT)
+        {
+            double const ha_r = radians((st_hrs - ra_hrs) * (360.0 / 24.0));
+            double const sin_ha = fabs(sin(ha_r));
+            if (sin_ha > sin(radians(15.0)))
+                scale /= sin_ha;
+        }
+    }
+
+    *err = rate * scale;
+    *sigma = rateSigma * scale;
+    return true;
+}
+
+void DriftToolWin::OnGuideStep(const GuideStepInfo& info)
+{
+    if (m_mode != MODE_DRIFT || !m_drifting || info.mount != pMount)
+        return;
+
+    m_fit.AddSample(info.time, info.mountOffset.Y);
+
+    double err, sigma;
+    if (!AlignmentError(&err, &sigma))
+        return;
+
+    wxString axis = m_phase == PHASE_ADJUST_AZ ? _("Azimuth") : _("Altitude");
+    SetStatusText(wxString::Format(_("Drifting... %s error %.1f +/- %.1f arc-min"), axis, fabs(err), sigma));
+
+    bool converged = m_fit.Count() >= AUTOSTOP_MIN_SAMPLES && m_fit.Duration() >= AUTOSTOP_MIN_DURATION &&
+        sigma <= wxMax(AUTOSTOP_MIN_SIGMA, AUTOSTOP_REL_SIGMA * fabs(err));
+
+    if (converged && m_autoStop->GetValue())
+    {
+        Debug.AddLine(wxString::Format("Drift tool: %s error %.2f +/- %.2f arc-min after %.0fs, %u samples",
+            m_phase == PHASE_ADJUST_AZ ? "azimuth" : "altitude", err, sigma, m_fit.Duration(), m_fit.Count()));
+        m_mode = MODE_ADJUST;
+        UpdateModeState();
+        SetStatusText(wxString::Format(_("%s error %.1f +/- %.1f arc-min. Adjust %s, click Drift when done"),
+            axis, fabs(err), sigma, m_phase == PHASE_ADJUST_AZ ? _("azimuth") : _("altitude")));
+    }
+}
+
 void DriftToolWin::OnAppStateNotify(wxCommandEvent& evt)
 {
     UpdateModeState();
@@ -710,7 +842,7 @@ void DriftToolWin::UpdateScopeCoordinates(void)
         return;
 
     double ra_hrs, dec_deg, st_hrs;
-    if (pPointingSource->GetCoordinates(&ra_hrs, &dec_deg, &st_hrs))
+    if (PointingCache::GetCoordinates(&ra_hrs, &dec_deg, &st_hrs))
         return; // error
     double ra_ofs_deg = (ra_hrs - st_hrs) * (360.0 / 24.0);
     if (ra_ofs_deg > 180.0)
@@ -791,6 +923,12 @@ void DriftToolWin::OnTimer(wxTimerEvent& evt)
     }
 }
 
+void DriftTool::NotifyGuideStep(const GuideStepInfo& info)
+{
+    if (pFrame && pFrame->pDriftTool)
+        static_cast<DriftToolWin *>(pFrame->pDriftTool)->OnGuideStep(info);
+}
+
 wxWindow *DriftTool::CreateDriftToolWindow()
 {
     if (!pCamera)
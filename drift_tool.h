@@ -34,11 +34,36 @@
 #ifndef DRIFT_TOOL_H
 #define DRIFT_TOOL_H
 
+// Least-squares fit of the Dec drift over a drift alignment run, kept as
+// running sums so that each guide step costs the same however long the run
+class DriftFit
+{
+    unsigned int m_n;
+    double m_t0;            // first sample, taken out to keep the sums well conditioned
+    double m_y0;
+    double m_st;
+    double m_sy;
+    double m_stt;
+    double m_sty;
+    double m_syy;
+    double m_tlast;
+
+public:
+    DriftFit() { Reset(); }
+    void Reset();
+    void AddSample(double t, double dec);           // seconds, px
+    unsigned int Count() const { return m_n; }
+    double Duration() const { return m_n ? m_tlast - m_t0 : 0.0; }
+    // drift rate and its standard error in px/min, false if there are too few samples
+    bool Rate(double *rate, double *sigma) const;
+};
+
 class DriftTool
 {
     DriftTool(); // not implemented
 public:
     static wxWindow *CreateDriftToolWindow();
+    static void NotifyGuideStep(const GuideStepInfo& info);
 };
 
 #endif
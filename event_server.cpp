@@ -37,12 +37,17 @@
 #include <wx/sstream.h>
 #include <wx/sckstrm.h>
 #include <sstream>
+#include <deque>
+#include <unordered_map>
 
 EventServer EvtServer;
 
 BEGIN_EVENT_TABLE(EventServer, wxEvtHandler)
     EVT_SOCKET(EVENT_SERVER_ID, EventServer::OnEventServerEvent)
+    EVT_SOCKET(EVENT_SERVER_WS_ID, EventServer::OnEventServerEvent)
     EVT_SOCKET(EVENT_SERVER_CLIENT_ID, EventServer::OnEventServerClientEvent)
+    EVT_SOCKET(EVENT_SERVER_RELAY_ID, EventServer::OnRelayEvent)
+    EVT_TIMER(EVENT_SERVER_RELAY_TIMER_ID, EventServer::OnRelayTimer)
 END_EVENT_TABLE()
 
 enum
@@ -71,6 +76,10 @@ static wxString state_name(EXPOSED_STATE st)
 
 static wxString json_escape(const wxString& s)
 {
+    // most strings need no escaping; avoid the copy and the Replace scans
+    if (s.find_first_of("\\\"") == wxString::npos)
+        return s;
+
     wxString t(s);
     static const wxString BACKSLASH("\\");
     static const wxString BACKSLASHBACKSLASH("\\\\");
@@ -81,13 +90,56 @@ static wxString json_escape(const wxString& s)
     return t;
 }
 
+// number formatting for the JSON writers, bypassing the wxString::Format
+// vararg machinery which dominates the cost of building an event
+
+#if defined (__WINDOWS__)
+// MSVC-ism _snprintf returns a negative number if there is not enough space in the buffer
+# define json_snprintf _snprintf
+#else
+# define json_snprintf snprintf
+#endif
+
+static wxString json_int(int i)
+{
+    char buf[16];
+    char *p = &buf[sizeof(buf)];
+    unsigned int u = i < 0 ? 0U - (unsigned int) i : (unsigned int) i;
+    do
+    {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (i < 0)
+        *--p = '-';
+    return wxString(p, &buf[sizeof(buf)] - p);
+}
+
+static wxString json_double(double d)
+{
+    char buf[32];
+    int n = json_snprintf(buf, sizeof(buf), "%g", d);
+    if (n < 0 || n >= (int) sizeof(buf))
+        return wxString::Format("%g", d);
+    return wxString(buf, n);
+}
+
+static wxString json_double(double d, int prec)
+{
+    char buf[64];
+    int n = json_snprintf(buf, sizeof(buf), "%.*f", prec, d);
+    if (n < 0 || n >= (int) sizeof(buf))
+        return wxString::Format("%.*f", prec, d);
+    return wxString(buf, n);
+}
+
 template<char LDELIM, char RDELIM>
 struct JSeq
 {
     wxString m_s;
     bool m_first;
     bool m_closed;
-    JSeq() : m_first(true), m_closed(false) { m_s << LDELIM; }
+    JSeq() : m_first(true), m_closed(false) { m_s.reserve(256); m_s << LDELIM; }
     void close() { m_s << RDELIM; m_closed = true; }
     wxString str() { if (!m_closed) close(); return m_s; }
 };
@@ -107,12 +159,12 @@ static JAry& operator<<(JAry& a, const wxString& str)
 
 static JAry& operator<<(JAry& a, double d)
 {
-    return a << wxString::Format("%.2f", d);
+    return a << json_double(d, 2);
 }
 
 static JAry& operator<<(JAry& a, int i)
 {
-    return a << wxString::Format("%d", i);
+    return a << json_int(i);
 }
 
 static wxString json_format(const json_value *j)
@@ -152,8 +204,8 @@ static wxString json_format(const json_value *j)
         return ret;
     }
     case JSON_STRING: return '"' + json_escape(j->string_value) + '"';
-    case JSON_INT:    return wxString::Format("%d", j->int_value);
-    case JSON_FLOAT:  return wxString::Format("%g", (double) j->float_value);
+    case JSON_INT:    return json_int(j->int_value);
+    case JSON_FLOAT:  return json_double(j->float_value);
     case JSON_BOOL:   return j->int_value ? literal_true : literal_false;
     }
 }
@@ -168,9 +220,9 @@ struct NV
     NV(const wxString& n_, const wxString& v_) : n(n_), v('"' + json_escape(v_) + '"') { }
     NV(const wxString& n_, const char *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
     NV(const wxString& n_, const wchar_t *v_) : n(n_), v('"' + json_escape(v_) + '"') { }
-    NV(const wxString& n_, int v_) : n(n_), v(wxString::Format("%d", v_)) { }
-    NV(const wxString& n_, double v_) : n(n_), v(wxString::Format("%g", v_)) { }
-    NV(const wxString& n_, double v_, int prec) : n(n_), v(wxString::Format("%.*f", prec, v_)) { }
+    NV(const wxString& n_, int v_) : n(n_), v(json_int(v_)) { }
+    NV(const wxString& n_, double v_) : n(n_), v(json_double(v_)) { }
+    NV(const wxString& n_, double v_, int prec) : n(n_), v(json_double(v_, prec)) { }
     NV(const wxString& n_, bool v_) : n(n_), v(v_ ? literal_true : literal_false) { }
     template<typename T>
     NV(const wxString& n_, const std::vector<T>& vec);
@@ -208,6 +260,14 @@ static JObj& operator<<(JObj& j, const NV& nv)
     return j;
 }
 
+// a value that is already JSON
+static NV NVJson(const wxString& n, const wxString& json)
+{
+    NV nv(n, NULL_VALUE);
+    nv.v = json;
+    return nv;
+}
+
 static NV NVMount(const Mount *mount)
 {
     return NV("Mount", mount->Name());
@@ -223,14 +283,24 @@ static JAry& operator<<(JAry& a, JObj& j)
     return a << j.str();
 }
 
+// the host name is fixed for the life of the process, and looking it up is a
+// system call
+static const wxString& host_name()
+{
+    static wxString s_host = wxGetHostName();
+    return s_host;
+}
+
 struct Ev : public JObj
 {
-    Ev(const wxString& event)
+    wxString m_name;
+
+    Ev(const wxString& event) : m_name(event)
     {
         double const now = ::wxGetUTCTimeMillis().ToDouble() / 1000.0;
         *this << NV("Event", event)
             << NV("Timestamp", now, 3)
-            << NV("Host", wxGetHostName())
+            << NV("Host", host_name())
             << NV("Inst", pFrame->GetInstanceNumber());
     }
 };
@@ -295,7 +365,7 @@ static Ev ev_app_state(EXPOSED_STATE st = Guider::GetExposedState())
     return ev;
 }
 
-static Ev ev_settling(double distance, double time, double settleTime)
+static Ev ev_settling(double distance, double time, double settleTime, const SettleEstimate *est)
 {
     Ev ev("Settling");
 
@@ -303,6 +373,12 @@ static Ev ev_settling(double distance, double time, double settleTime)
        << NV("Time", time, 1)
        << NV("SettleTime", settleTime, 1);
 
+    if (est)
+    {
+        ev << NV("PredictedDistance", est->distance, 2)
+           << NV("PredictedUpper", est->upperBound, 2);
+    }
+
     return ev;
 }
 
@@ -322,15 +398,84 @@ static Ev ev_settle_done(const wxString& errorMsg)
     return ev;
 }
 
+// Input accumulates across socket reads until a complete line is available;
+// the buffer grows as needed up to MAX_SIZE and is kept for the life of the
+// client. The bytes already scanned for end of line are not scanned again.
 struct ClientReadBuf
 {
-    enum { SIZE = 1024 };
-    char buf[SIZE];
-    char *dest;
+    enum { READ_SIZE = 4096, MAX_SIZE = 1024 * 1024 };
+    std::vector<char> buf;
+    size_t len;
+    size_t scanned;
+
+    ClientReadBuf() : len(0), scanned(0) { }
+    void reset() { len = scanned = 0; }
+    char *reserve(size_t n)
+    {
+        if (buf.size() < len + n)
+            buf.resize(len + n);
+        return &buf[len];
+    }
+    void consume(size_t n)
+    {
+        memmove(buf.data(), buf.data() + n, len - n);
+        len -= n;
+    }
+};
+
+// Output that could not be written immediately is held in a bounded
+// per-client queue and flushed when the socket becomes writable, so a slow
+// client never stalls the notifier
+struct ClientWriteQueue
+{
+    std::deque<wxCharBuffer> bufs;
+    size_t ofs;          // bytes of the front buffer already written
+    size_t bytes;        // total unwritten bytes
+    unsigned int dropped;
+    bool overflowed;     // queue limit exceeded with the disconnect policy
+    bool corked;         // hold output so replies to pipelined requests go out in one write
 
-    ClientReadBuf() { reset(); }
-    size_t avail() const { return &buf[SIZE] - dest; }
-    void reset() { dest = &buf[0]; }
+    ClientWriteQueue() : ofs(0), bytes(0), dropped(0), overflowed(false), corked(false) { }
+};
+
+// the events a client has subscribed to with set_event_filter
+struct ClientEventFilter
+{
+    bool all;                   // no filter, the client gets every event
+    std::set<wxString> events;
+    int guideStepIntervalMs;    // minimum time between GuideStep events, 0 for every step
+    wxLongLong lastGuideStep;
+    unsigned int instances;     // other instances whose events are relayed, bit n-1 for instance n
+
+    ClientEventFilter() : all(true), guideStepIntervalMs(0), lastGuideStep(0), instances(0) { }
+
+    bool Wants(const wxString& ev) const { return all || events.find(ev) != events.end(); }
+    bool GuideStepDue(const wxLongLong& now) const
+    {
+        return guideStepIntervalMs <= 0 || now - lastGuideStep >= guideStepIntervalMs;
+    }
+};
+
+// A client of the WebSocket endpoint. Until the opening handshake is done
+// it gets no events; afterwards every event and reply is a text frame, and
+// guide frames it subscribes to arrive as binary frames in the coding of
+// frame_codec.h.
+struct WsClient
+{
+    bool open;                  // handshake done
+    bool closed;                // closing or refused, input is ignored
+    bool deflate;               // permessage-deflate negotiated
+    std::string msg;            // the message being received, across its fragments
+    int msgOpcode;              // of that message, OP_CONTINUATION when there is none
+    bool msgCompressed;
+
+    int imageSize;              // guide frames: 0 none, -1 the whole frame, or a star cutout of this size
+    int imageIntervalMs;
+    wxLongLong lastImage;
+
+    WsClient()
+        : open(false), closed(false), deflate(false), msgOpcode(WebSocket::OP_CONTINUATION), msgCompressed(false),
+        imageSize(0), imageIntervalMs(0), lastImage(0) { }
 };
 
 struct ClientData
@@ -338,9 +483,15 @@ struct ClientData
     wxSocketClient *cli;
     int refcnt;
     ClientReadBuf rdbuf;
+    JsonParser parser;          // per-client, so its arena is reused from one request to the next
+    bool reading;
     wxMutex wrlock;
+    ClientWriteQueue wrq;
+    ClientEventFilter filter;
+    WsClient *ws;               // null for a line-protocol client
 
-    ClientData(wxSocketClient *cli_) : cli(cli_), refcnt(1) { }
+    ClientData(wxSocketClient *cli_) : cli(cli_), refcnt(1), reading(false), ws(0) { }
+    ~ClientData() { delete ws; }
     void AddRef() { ++refcnt; }
     void RemoveRef()
     {
@@ -360,46 +511,216 @@ struct ClientDataGuard
     ClientData *operator->() const { return cd; }
 };
 
-inline static wxMutex *client_wrlock(wxSocketClient *cli)
+inline static ClientData *client_data(wxSocketClient *cli)
+{
+    return (ClientData *) cli->GetClientData();
+}
+
+// limit on the unwritten output held for a client, and what to do when an
+// event would exceed it: drop the event, or disconnect the client
+static size_t s_wrqLimit = 1024 * 1024;
+static bool s_wrqDisconnect = false;
+
+// bytes written to all client sockets since startup; clients are flushed
+// under their own locks, from any thread
+static std::atomic<long long> s_bytesSent(0);
+
+// write as much of the queued output as the socket will take without blocking;
+// call with the client's wrlock held
+static void flush_queue(wxSocketClient *client, ClientWriteQueue& q)
+{
+    while (!q.bufs.empty())
+    {
+        const wxCharBuffer& buf = q.bufs.front();
+        size_t len = buf.length() - q.ofs;
+
+        client->Write(buf.data() + q.ofs, len);
+        size_t n = client->LastWriteCount();
+
+        q.ofs += n;
+        q.bytes -= n;
+        s_bytesSent.fetch_add((long long) n, std::memory_order_relaxed);
+
+        if (n < len)
+            break;
+
+        q.bufs.pop_front();
+        q.ofs = 0;
+    }
+}
+
+// replies to a client's own requests are never dropped; broadcast events are
+// subject to the queue limit
+static void send_buf(wxSocketClient *client, const wxCharBuffer& buf, bool droppable)
+{
+    ClientData *cd = client_data(client);
+    wxMutexLocker lock(cd->wrlock);
+    ClientWriteQueue& q = cd->wrq;
+
+    if (q.overflowed)
+        return;
+
+    if (droppable && q.bytes + buf.length() > s_wrqLimit)
+    {
+        if (s_wrqDisconnect)
+        {
+            Debug.Write(wxString::Format("evsrv: cli %p output queue full (%u bytes), disconnecting\n",
+                client, (unsigned int) q.bytes));
+            q.overflowed = true;
+            cd->AddRef();
+            EvtServer.CallAfter(&EventServer::DisconnectClient, client);
+        }
+        else
+        {
+            ++s_droppedEvents;
+            if (q.dropped++ == 0)
+            {
+                Debug.Write(wxString::Format("evsrv: cli %p output queue full (%u bytes), dropping events\n",
+                    client, (unsigned int) q.bytes));
+            }
+        }
+        return;
+    }
+
+    if (q.dropped)
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p dropped %u events\n", client, q.dropped));
+        q.dropped = 0;
+    }
+
+    q.bufs.push_back(buf);
+    q.bytes += buf.length();
+
+    // if output was already pending, the socket is not writable and the
+    // queue will be flushed by the next output event
+    if (q.bufs.size() == 1 && !q.corked)
+        flush_queue(client, q);
+}
+
+static void cork_output(ClientData *cd)
 {
-    return &((ClientData *) cli->GetClientData())->wrlock;
+    wxMutexLocker lock(cd->wrlock);
+    cd->wrq.corked = true;
 }
 
-static void send_buf(wxSocketClient *client, const wxCharBuffer& buf)
+static void uncork_output(ClientData *cd)
+{
+    wxMutexLocker lock(cd->wrlock);
+    cd->wrq.corked = false;
+    flush_queue(cd->cli, cd->wrq);
+}
+
+// events dropped for clients whose output queue was full, since startup
+static unsigned int s_droppedEvents;
+
+// An event line as a client receives it: the line itself, or for a
+// WebSocket client a text frame without the line ending. Each kind of frame
+// is built at most once per event however many clients get it.
+struct ClientBytes
 {
-    wxMutexLocker lock(*client_wrlock(client));
-    client->Write(buf.data(), buf.length());
-    if (client->LastWriteCount() != buf.length())
+    const wxCharBuffer& line;
+    wxCharBuffer frame[2];      // plain, deflated
+    bool framed[2];
+
+    ClientBytes(const wxCharBuffer& line_) : line(line_) { framed[0] = framed[1] = false; }
+
+    const wxCharBuffer& For(const ClientData *cd)
     {
-        Debug.Write(wxString::Format("evsrv: cli %p short write %u/%u\n",
-            client, client->LastWriteCount(), (unsigned int) buf.length()));
+        if (!cd->ws)
+            return line;
+        int const i = cd->ws->deflate ? 1 : 0;
+        if (!framed[i])
+        {
+            frame[i] = WebSocket::Frame(WebSocket::OP_TEXT, line.data(), line.length() - 2, cd->ws->deflate);
+            framed[i] = true;
+        }
+        return frame[i];
     }
+};
+
+static void do_notify1(wxSocketClient *client, const wxCharBuffer& line)
+{
+    ClientBytes bytes(line);
+    send_buf(client, bytes.For(client_data(client)), false);
 }
 
 static void do_notify1(wxSocketClient *client, const JAry& ary)
 {
-    send_buf(client, (JAry(ary).str() + "\r\n").ToUTF8());
+    do_notify1(client, (JAry(ary).str() + "\r\n").ToUTF8());
 }
 
 static void do_notify1(wxSocketClient *client, const JObj& j)
 {
-    send_buf(client, (JObj(j).str() + "\r\n").ToUTF8());
+    do_notify1(client, (JObj(j).str() + "\r\n").ToUTF8());
+}
+
+static const wxString EV_GUIDE_STEP("GuideStep");
+
+static bool client_wants(const ClientData *cd, const wxString& name, const wxLongLong& now)
+{
+    if (cd->ws && (!cd->ws->open || cd->ws->closed))
+        return false;
+    if (!cd->filter.Wants(name))
+        return false;
+    return name != EV_GUIDE_STEP || cd->filter.GuideStepDue(now);
+}
+
+// true if any client would receive the named event, so that events nobody
+// is subscribed to are not built at all
+static bool any_client_wants(const EventServer::CliSockSet& cli, const wxString& name)
+{
+    if (cli.empty())
+        return false;
+
+    wxLongLong now = ::wxGetUTCTimeMillis();
+
+    for (EventServer::CliSockSet::const_iterator it = cli.begin();
+        it != cli.end(); ++it)
+    {
+        if (client_wants(client_data(*it), name, now))
+            return true;
+    }
+
+    return false;
 }
 
-static void do_notify(const EventServer::CliSockSet& cli, const JObj& jj)
+// the event is serialized once; wxCharBuffer is reference counted so every
+// client's output queue shares the same bytes
+static void do_notify(const EventServer::CliSockSet& cli, const Ev& ev)
 {
-    wxCharBuffer buf = (JObj(jj).str() + "\r\n").ToUTF8();
+    // guide steps still queued go out first
+    if (ev.m_name != EV_GUIDE_STEP)
+        StepFanOut.Drain(GuideStepFanOut::CONSUMER_EVENTS);
+
+    wxCharBuffer buf;
+    ClientBytes bytes(buf);
+    bool serialized = false;
+    wxLongLong now = ::wxGetUTCTimeMillis();
 
     for (EventServer::CliSockSet::const_iterator it = cli.begin();
         it != cli.end(); ++it)
     {
-        send_buf(*it, buf);
+        ClientData *cd = client_data(*it);
+
+        if (!client_wants(cd, ev.m_name, now))
+            continue;
+
+        if (ev.m_name == EV_GUIDE_STEP)
+            cd->filter.lastGuideStep = now;
+
+        if (!serialized)
+        {
+            buf = (JObj(ev).str() + "\r\n").ToUTF8();
+            serialized = true;
+        }
+
+        send_buf(*it, bytes.For(cd), true);
     }
 }
 
 inline static void simple_notify(const EventServer::CliSockSet& cli, const wxString& ev)
 {
-    if (!cli.empty())
+    if (any_client_wants(cli, ev))
         do_notify(cli, Ev(ev));
 }
 
@@ -412,47 +733,144 @@ inline static void simple_notify_ev(const EventServer::CliSockSet& cli, const Ev
 #define SIMPLE_NOTIFY(s) simple_notify(m_eventServerClients, s)
 #define SIMPLE_NOTIFY_EV(ev) simple_notify_ev(m_eventServerClients, ev)
 
-static void send_catchup_events(wxSocketClient *cli)
+// The catch-up events a client gets on connecting, kept serialized: the
+// snapshot is rebuilt only on the first connect after a change to the state
+// it describes, and each kind of client gets it as one buffer, so a burst
+// of reconnects costs a single queued write per client. The notifiers that
+// change the state mark it stale; the fingerprint catches changes that
+// come without a notification, such as a calibration cleared from the UI.
+// The star position and the timestamps are those at the time of the rebuild.
+struct CatchupSnapshot
 {
-    EXPOSED_STATE st = Guider::GetExposedState();
+    struct Fingerprint
+    {
+        EXPOSED_STATE state;
+        const Mount *mount;
+        const Mount *secondaryMount;
+        bool mountCalibrated;
+        bool secondaryCalibrated;
+        bool lockPos;
+        bool starPos;
+
+        bool operator==(const Fingerprint& o) const
+        {
+            return state == o.state && mount == o.mount && secondaryMount == o.secondaryMount &&
+                mountCalibrated == o.mountCalibrated && secondaryCalibrated == o.secondaryCalibrated &&
+                lockPos == o.lockPos && starPos == o.starPos;
+        }
+    };
+
+    bool stale;
+    Fingerprint fp;
+    std::vector<wxCharBuffer> lines;
+    wxCharBuffer bytes[3];      // line protocol, WebSocket, WebSocket deflated
+    bool built[3];
 
-    do_notify1(cli, ev_message_version());
+    CatchupSnapshot() : stale(true) { built[0] = built[1] = built[2] = false; }
 
-    if (pFrame->pGuider)
+    static Fingerprint Current()
     {
-        if (pFrame->pGuider->LockPosition().IsValid())
-            do_notify1(cli, ev_set_lock_position(pFrame->pGuider->LockPosition()));
+        Fingerprint f;
+        f.state = Guider::GetExposedState();
+        f.mount = pMount;
+        f.secondaryMount = pSecondaryMount;
+        f.mountCalibrated = pMount && pMount->IsCalibrated();
+        f.secondaryCalibrated = pSecondaryMount && pSecondaryMount->IsCalibrated();
+        f.lockPos = pFrame->pGuider && pFrame->pGuider->LockPosition().IsValid();
+        f.starPos = pFrame->pGuider && pFrame->pGuider->CurrentPosition().IsValid();
+        return f;
+    }
 
-        if (pFrame->pGuider->CurrentPosition().IsValid())
-            do_notify1(cli, ev_star_selected(pFrame->pGuider->CurrentPosition()));
+    void Add(const JObj& j)
+    {
+        lines.push_back((JObj(j).str() + "\r\n").ToUTF8());
     }
 
-    if (pMount && pMount->IsCalibrated())
-        do_notify1(cli, ev_calibration_complete(pMount));
+    void Rebuild(const Fingerprint& f)
+    {
+        lines.clear();
+        built[0] = built[1] = built[2] = false;
+        fp = f;
+        stale = false;
 
-    if (pSecondaryMount && pSecondaryMount->IsCalibrated())
-        do_notify1(cli, ev_calibration_complete(pSecondaryMount));
+        Add(ev_message_version());
 
-    if (st == EXPOSED_STATE_GUIDING_LOCKED)
-    {
-        do_notify1(cli, ev_start_guiding());
+        if (pFrame->pGuider)
+        {
+            if (pFrame->pGuider->LockPosition().IsValid())
+                Add(ev_set_lock_position(pFrame->pGuider->LockPosition()));
+
+            if (pFrame->pGuider->CurrentPosition().IsValid())
+                Add(ev_star_selected(pFrame->pGuider->CurrentPosition()));
+        }
+
+        if (pMount && pMount->IsCalibrated())
+            Add(ev_calibration_complete(pMount));
+
+        if (pSecondaryMount && pSecondaryMount->IsCalibrated())
+            Add(ev_calibration_complete(pSecondaryMount));
+
+        if (f.state == EXPOSED_STATE_GUIDING_LOCKED)
+        {
+            Add(ev_start_guiding());
+        }
+        else if (f.state == EXPOSED_STATE_CALIBRATING)
+        {
+            Mount *mount = pMount;
+            if (pFrame->pGuider->GetState() == STATE_CALIBRATING_SECONDARY)
+                mount = pSecondaryMount;
+            Add(ev_start_calibration(mount));
+        }
+        else if (f.state == EXPOSED_STATE_PAUSED)
+        {
+            Add(ev_paused());
+        }
+
+        Add(ev_app_state(f.state));
     }
-    else if (st == EXPOSED_STATE_CALIBRATING)
+
+    const wxCharBuffer& For(const ClientData *cd)
     {
-        Mount *mount = pMount;
-        if (pFrame->pGuider->GetState() == STATE_CALIBRATING_SECONDARY)
-            mount = pSecondaryMount;
-        do_notify1(cli, ev_start_calibration(mount));
-    }
-    else if (st == EXPOSED_STATE_PAUSED) {
-        do_notify1(cli, ev_paused());
+        int const kind = !cd->ws ? 0 : cd->ws->deflate ? 2 : 1;
+        if (!built[kind])
+        {
+            std::string all;
+            for (size_t i = 0; i < lines.size(); i++)
+            {
+                ClientBytes b(lines[i]);
+                const wxCharBuffer& buf = b.For(cd);
+                all.append(buf.data(), buf.length());
+            }
+            bytes[kind] = wxCharBuffer(all.size());
+            memcpy(bytes[kind].data(), all.data(), all.size());
+            built[kind] = true;
+        }
+        return bytes[kind];
     }
+};
+
+static CatchupSnapshot s_catchup;
+
+inline static void catchup_changed()
+{
+    s_catchup.stale = true;
+}
+
+static void send_catchup_events(wxSocketClient *cli)
+{
+    CatchupSnapshot::Fingerprint const fp = CatchupSnapshot::Current();
+
+    if (s_catchup.stale || !(fp == s_catchup.fp))
+        s_catchup.Rebuild(fp);
 
-    do_notify1(cli, ev_app_state());
+    send_buf(cli, s_catchup.For(client_data(cli)), false);
 }
 
+static void relay_forget(wxSocketClient *cli);
+
 static void destroy_client(wxSocketClient *cli)
 {
+    relay_forget(cli);
     ClientData *buf = (ClientData *) cli->GetClientData();
     buf->RemoveRef();
 }
@@ -467,18 +885,15 @@ static void drain_input(wxSocketInputStream& sis)
     }
 }
 
-static bool find_eol(char *p, size_t len)
+// offset of the first end of line character in p[0..len), or len if none
+static size_t find_eol(const char *p, size_t len)
 {
-    const char *end = p + len;
-    for (; p < end; p++)
+    for (size_t i = 0; i < len; i++)
     {
-        if (*p == '\r' || *p == '\n')
-        {
-            *p = 0;
-            return true;
-        }
+        if (p[i] == '\r' || p[i] == '\n')
+            return i;
     }
-    return false;
+    return len;
 }
 
 enum {
@@ -889,10 +1304,241 @@ static void stop_capture(JObj& response, const json_value *params)
     response << jrpc_result(0);
 }
 
+// Long-running methods called with "async":true answer at once with a job
+// id. The outcome is reported by a JobComplete event and by get_job_status;
+// without async the methods answer once the work is done, as before.
+struct RpcJob
+{
+    enum State { RUNNING, SUCCEEDED, FAILED };
+
+    int id;
+    wxString method;
+    State state;
+    wxString key;               // identifies the job when its work completes, e.g. the file name
+    wxString result;            // JSON, once succeeded
+    wxString error;             // once failed
+    wxLongLong started;
+    wxLongLong finished;
+    wxThread *thread;           // the job's own worker thread, if it has one
+};
+
+// the running jobs and the most recent finished ones, oldest first
+static std::deque<RpcJob> s_jobs;
+static int s_lastJobId;
+enum { MAX_FINISHED_JOBS = 32 };
+
+static RpcJob& start_job(const wxString& method, const wxString& key = wxEmptyString)
+{
+    unsigned int finished = 0;
+    for (std::deque<RpcJob>::const_iterator it = s_jobs.begin(); it != s_jobs.end(); ++it)
+        if (it->state != RpcJob::RUNNING)
+            ++finished;
+
+    for (std::deque<RpcJob>::iterator it = s_jobs.begin(); finished >= MAX_FINISHED_JOBS && it != s_jobs.end(); )
+    {
+        if (it->state != RpcJob::RUNNING)
+        {
+            it = s_jobs.erase(it);
+            --finished;
+        }
+        else
+            ++it;
+    }
+
+    RpcJob job;
+    job.id = ++s_lastJobId;
+    job.method = method;
+    job.state = RpcJob::RUNNING;
+    job.key = key;
+    job.started = ::wxGetUTCTimeMillis();
+    job.finished = 0;
+    job.thread = 0;
+    s_jobs.push_back(job);
+
+    Debug.Write(wxString::Format("evsrv: job %d %s started\n", job.id, method));
+
+    return s_jobs.back();
+}
+
+static RpcJob *find_job(int id)
+{
+    for (std::deque<RpcJob>::iterator it = s_jobs.begin(); it != s_jobs.end(); ++it)
+        if (it->id == id)
+            return &*it;
+    return 0;
+}
+
+static RpcJob *find_running_job(const wxString& method, const wxString& key = wxEmptyString)
+{
+    for (std::deque<RpcJob>::iterator it = s_jobs.begin(); it != s_jobs.end(); ++it)
+        if (it->state == RpcJob::RUNNING && it->method == method && it->key == key)
+            return &*it;
+    return 0;
+}
+
+static void finish_job(const EventServer::CliSockSet& cli, RpcJob *job, const wxString& result, const wxString& error)
+{
+    job->state = error.empty() ? RpcJob::SUCCEEDED : RpcJob::FAILED;
+    job->result = result;
+    job->error = error;
+    job->finished = ::wxGetUTCTimeMillis();
+    job->thread = 0;
+
+    Debug.Write(wxString::Format("evsrv: job %d %s %s\n", job->id, job->method,
+        error.empty() ? wxString("succeeded") : "failed: " + error));
+
+    if (!any_client_wants(cli, "JobComplete"))
+        return;
+
+    Ev ev("JobComplete");
+    ev << NV("Job", job->id) << NV("Method", job->method) << NV("Success", error.empty());
+    if (error.empty())
+        ev << NVJson("Result", result);
+    else
+        ev << NV("Error", error);
+
+    do_notify(cli, ev);
+}
+
+static const char *job_state_name(RpcJob::State st)
+{
+    switch (st)
+    {
+    case RpcJob::RUNNING:   return "running";
+    case RpcJob::SUCCEEDED: return "succeeded";
+    default:
+    case RpcJob::FAILED:    return "failed";
+    }
+}
+
+static void get_job_status(JObj& response, const json_value *params)
+{
+    Params p("job", params);
+    const json_value *jv = p.param("job");
+    if (!jv || jv->type != JSON_INT)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected job id param");
+        return;
+    }
+
+    const RpcJob *job = find_job(jv->int_value);
+    if (!job)
+    {
+        response << jrpc_error(1, "no such job");
+        return;
+    }
+
+    wxLongLong const end = job->state == RpcJob::RUNNING ? ::wxGetUTCTimeMillis() : job->finished;
+
+    JObj rslt;
+    rslt << NV("job", job->id)
+         << NV("method", job->method)
+         << NV("state", job_state_name(job->state))
+         << NV("elapsed", (end - job->started).ToDouble() / 1000.0, 3);
+    if (job->state == RpcJob::SUCCEEDED)
+        rslt << NVJson("result", job->result);
+    else if (job->state == RpcJob::FAILED)
+        rslt << NV("error", job->error);
+
+    response << jrpc_result(rslt);
+}
+
+// the full frame search of find_star, on a copy of the current image
+class FindStarThread : public wxThread
+{
+public:
+    int m_job;
+    usImage m_img;
+    int m_edgeAllowance;
+    int m_searchRegion;
+    bool m_found;
+    PHD_Point m_pos;
+
+    FindStarThread(int job, int edgeAllowance, int searchRegion)
+        : wxThread(wxTHREAD_JOINABLE), m_job(job), m_edgeAllowance(edgeAllowance), m_searchRegion(searchRegion),
+          m_found(false) { }
+
+protected:
+    ExitCode Entry()
+    {
+        Star star;
+        m_found = star.AutoFind(m_img, m_edgeAllowance, m_searchRegion);
+        if (m_found)
+            m_pos.SetXY(star.X, star.Y);
+
+        // the star is selected on the main thread
+        EvtServer.CallAfter(&EventServer::FindStarDone, m_job);
+
+        return 0;
+    }
+};
+
+// waits for a job's worker thread, which has finished or is about to
+static void join_job_thread(RpcJob *job)
+{
+    if (job->thread)
+    {
+        job->thread->Wait();
+        delete job->thread;
+        job->thread = 0;
+    }
+}
+
+static void find_star_async(JObj& response)
+{
+    if (find_running_job("find_star"))
+    {
+        response << jrpc_error(3, "find_star is already running");
+        return;
+    }
+
+    usImage *img = pFrame->pGuider->CurrentImage();
+    if (!img || !img->ImageData)
+    {
+        response << jrpc_error(2, "no image available");
+        return;
+    }
+
+    WorkerThread::CompleteLazyROI(*img);
+
+    RpcJob& job = start_job("find_star");
+
+    FindStarThread *thread = new FindStarThread(job.id, Guider::AutoFindEdgeAllowance(), pFrame->pGuider->GetSearchRegion());
+    if (thread->m_img.CopyFrom(*img) || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        job.state = RpcJob::FAILED;
+        job.error = "could not start the search";
+        job.finished = ::wxGetUTCTimeMillis();
+        response << jrpc_error(1, job.error);
+        return;
+    }
+    job.thread = thread;
+
+    JObj rslt;
+    rslt << NV("job", job.id);
+    response << jrpc_result(rslt);
+}
+
 static void find_star(JObj& response, const json_value *params)
 {
     VERIFY_GUIDER(response);
 
+    Params p("async", params);
+    bool async = false;
+    const json_value *jv = p.param("async");
+    if (jv && !bool_param(jv, &async))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected boolean async param");
+        return;
+    }
+
+    if (async)
+    {
+        find_star_async(response);
+        return;
+    }
+
     bool error = pFrame->pGuider->AutoSelect();
 
     if (!error)
@@ -1063,9 +1709,32 @@ static void set_lock_shift_enabled(JObj& response, const json_value *params)
     response << jrpc_result(0);
 }
 
-static void get_lock_shift_params(JObj& response, const json_value *params)
+static void polar_align_fields(JObj& j, const PolarDriftEstimate& est)
 {
-    VERIFY_GUIDER(response);
+    j << NV("PolarAlignError", est.polarAlignError, 1)
+      << NV("DecDriftRate", est.decDriftRate, 3)
+      << NV("Span", est.span, 1);
+    if (est.haveCoords)
+        j << NV("Dec", est.declination, 1) << NV("HourAngle", est.hourAngle, 2);
+}
+
+static void get_polar_alignment_estimate(JObj& response, const json_value *params)
+{
+    PolarDriftEstimate est;
+    if (!PolarDrift::GetEstimate(&est))
+    {
+        response << jrpc_error(1, "no polar alignment estimate yet");
+        return;
+    }
+
+    JObj rslt;
+    polar_align_fields(rslt, est);
+    response << jrpc_result(rslt);
+}
+
+static void get_lock_shift_params(JObj& response, const json_value *params)
+{
+    VERIFY_GUIDER(response);
     const LockPosShiftParams& lockShift = pFrame->pGuider->GetLockPosShiftParams();
     JObj rslt;
     rslt << NV("enabled", lockShift.shiftEnabled);
@@ -1074,6 +1743,8 @@ static void get_lock_shift_params(JObj& response, const json_value *params)
         rslt << NV("rate", lockShift.shiftRate)
              << NV("units", lockShift.shiftUnits == UNIT_ARCSEC ? "arcsec/hr" : "pixels/hr")
              << NV("axes", lockShift.shiftIsMountCoords ? "RA/Dec" : "X/Y");
+        if (!lockShift.rateTable.empty())
+            rslt << NV("table_rows", (int) lockShift.rateTable.size());
     }
     response << jrpc_result(rslt);
 }
@@ -1110,28 +1781,9 @@ static bool parse_point(PHD_Point *pt, const json_value *j)
     return true;
 }
 
-static bool parse_lock_shift_params(LockPosShiftParams *shift, const json_value *params, wxString *error)
+static bool parse_lock_shift_units(LockPosShiftParams *shift, const Params& p, wxString *error)
 {
-    // "params":[{"rate":[3.3,1.1],"units":"arcsec/hr","axes":"RA/Dec"}]
-    // or
-    // "params":{"rate":[3.3,1.1],"units":"arcsec/hr","axes":"RA/Dec"}
-
-    if (params && params->type == JSON_ARRAY)
-        params = params->first_child;
-
-    Params p("rate", "units", "axes", params);
-
-    shift->shiftUnits = UNIT_ARCSEC;
-    shift->shiftIsMountCoords = true;
-
     const json_value *j;
-    
-    j = p.param("rate");
-    if (!j || !parse_point(&shift->shiftRate, j))
-    {
-        *error = "expected rate value array";
-        return false;
-    }
 
     j = p.param("units");
     const char *units = j ? string_val(j) : "";
@@ -1171,6 +1823,32 @@ static bool parse_lock_shift_params(LockPosShiftParams *shift, const json_value
     return true;
 }
 
+static bool parse_lock_shift_params(LockPosShiftParams *shift, const json_value *params, wxString *error)
+{
+    // "params":[{"rate":[3.3,1.1],"units":"arcsec/hr","axes":"RA/Dec"}]
+    // or
+    // "params":{"rate":[3.3,1.1],"units":"arcsec/hr","axes":"RA/Dec"}
+
+    if (params && params->type == JSON_ARRAY)
+        params = params->first_child;
+
+    Params p("rate", "units", "axes", params);
+
+    shift->shiftUnits = UNIT_ARCSEC;
+    shift->shiftIsMountCoords = true;
+
+    const json_value *j;
+    
+    j = p.param("rate");
+    if (!j || !parse_point(&shift->shiftRate, j))
+    {
+        *error = "expected rate value array";
+        return false;
+    }
+
+    return parse_lock_shift_units(shift, p, error);
+}
+
 static void set_lock_shift_params(JObj& response, const json_value *params)
 {
     wxString err;
@@ -1188,10 +1866,100 @@ static void set_lock_shift_params(JObj& response, const json_value *params)
     response << jrpc_result(0);
 }
 
+// A lock shift rate that changes with time, for fast-moving objects:
+// "params":{"epoch":1700000000,"rates":[[0,3.3,1.1],[600,3.9,1.4],...],"units":"arcsec/hr","axes":"RA/Dec"}
+// Each row is [seconds after epoch, rate, rate], in increasing time order. The
+// rate is interpolated between rows and holds before the first and after the
+// last. epoch is in Unix seconds, the time of the call if omitted. An empty
+// rates list clears the table and the shift rate.
+static void set_lock_shift_table(JObj& response, const json_value *params)
+{
+    if (params && params->type == JSON_ARRAY)
+        params = params->first_child;
+
+    Params p("epoch", "rates", "units", "axes", params);
+
+    LockPosShiftParams shift;
+    wxString err;
+    if (!parse_lock_shift_units(&shift, p, &err))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, err);
+        return;
+    }
+
+    wxLongLong_t epoch = ::wxGetUTCTimeMillis().GetValue();
+    const json_value *j = p.param("epoch");
+    if (j)
+    {
+        if (j->type != JSON_INT)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected epoch integer param");
+            return;
+        }
+        epoch = (wxLongLong_t) j->int_value * 1000;
+    }
+
+    j = p.param("rates");
+    if (!j || j->type != JSON_ARRAY)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected rates array param");
+        return;
+    }
+
+    std::vector<LockPosShiftRate> table;
+    json_for_each(row, j)
+    {
+        const json_value *jt = row->type == JSON_ARRAY ? row->first_child : 0;
+        const json_value *jx = jt ? jt->next_sibling : 0;
+        const json_value *jy = jx ? jx->next_sibling : 0;
+        double t, x, y;
+        if (!jy || jy->next_sibling || !get_double(&t, jt) || !get_double(&x, jx) || !get_double(&y, jy))
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected rates rows [time, rate, rate]");
+            return;
+        }
+        LockPosShiftRate entry;
+        entry.time = epoch + (wxLongLong_t) floor(t * 1000.0 + 0.5);
+        entry.rate.SetXY(x, y);
+        if (!table.empty() && entry.time <= table.back().time)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "rates times must increase");
+            return;
+        }
+        table.push_back(entry);
+    }
+
+    VERIFY_GUIDER(response);
+
+    pFrame->pGuider->SetLockPosShiftTable(table, shift.shiftUnits, shift.shiftIsMountCoords);
+
+    response << jrpc_result(0);
+}
+
+// With async=true the image is queued for the FITS writer and the reply
+// comes straight away; an ImageSaved event follows when the file is
+// complete. compress selects Rice tile compression, by default the global
+// /fits/tile_compression setting.
 static void save_image(JObj& response, const json_value *params)
 {
     VERIFY_GUIDER(response);
 
+    Params p("async", "compress", params);
+    bool async = false;
+    const json_value *jv = p.param("async");
+    if (jv && !bool_param(jv, &async))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected boolean async param");
+        return;
+    }
+    bool compress = FitsWriter::CompressByDefault();
+    jv = p.param("compress");
+    if (jv && !bool_param(jv, &compress))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected boolean compress param");
+        return;
+    }
+
     if (!pFrame->pGuider->CurrentImage()->ImageData)
     {
         response << jrpc_error(2, "no image available");
@@ -1200,7 +1968,24 @@ static void save_image(JObj& response, const json_value *params)
 
     wxString fname = wxFileName::CreateTempFileName(MyFrame::GetDefaultFileDir() + PATHSEPSTR + "save_image_");
 
-    if (pFrame->pGuider->SaveCurrentImage(fname))
+    if (async)
+    {
+        if (pFrame->pGuider->SaveCurrentImageAsync(fname, compress, FITS_NOTIFY_EVENT_SERVER))
+        {
+            ::wxRemove(fname);
+            response << jrpc_error(4, "image save queue is full");
+            return;
+        }
+
+        RpcJob& job = start_job("save_image", fname);
+
+        JObj rslt;
+        rslt << NV("filename", fname) << NV("job", job.id);
+        response << jrpc_result(rslt);
+        return;
+    }
+
+    if (pFrame->pGuider->SaveCurrentImage(fname, compress))
     {
         ::wxRemove(fname);
         response << jrpc_error(3, "error saving image");
@@ -1275,6 +2060,44 @@ struct B64Encode
 };
 const char *const B64Encode::E = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+// the encodings of the current star cutout that clients asked for, so
+// clients polling the same frame do not each encode it again
+struct StarImageCache
+{
+    struct Entry
+    {
+        wxRect rect;
+        std::string pixels;
+    };
+    unsigned int generation;
+    std::vector<Entry> entries;
+
+    StarImageCache() : generation(0) { }
+
+    const std::string& Get(const StarCutout& cut, const wxRect& rect)
+    {
+        if (cut.Generation() != generation)
+        {
+            entries.clear();
+            generation = cut.Generation();
+        }
+
+        for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+            if (it->rect == rect)
+                return it->pixels;
+
+        B64Encode enc;
+        for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
+            enc.append(cut.Pixel(rect.GetLeft(), y), rect.GetWidth() * sizeof(unsigned short));
+
+        entries.push_back(Entry());
+        entries.back().rect = rect;
+        entries.back().pixels = enc.finish();
+        return entries.back().pixels;
+    }
+};
+static StarImageCache s_starImageCache;
+
 static void get_star_image(JObj& response, const json_value *params)
 {
     int reqsize = 15;
@@ -1293,14 +2116,15 @@ static void get_star_image(JObj& response, const json_value *params)
 
     Guider *guider = pFrame->pGuider;
     const usImage *img = guider->CurrentImage();
-    const PHD_Point& star = guider->CurrentPosition();
+    const StarCutout& cut = guider->CurrentStarCutout();
 
-    if (guider->GetState() < GUIDER_STATE::STATE_SELECTED || !img->ImageData || !star.IsValid())
+    if (guider->GetState() < GUIDER_STATE::STATE_SELECTED || !cut.IsValid())
     {
         response << jrpc_error(2, "no star selected");
         return;
     }
 
+    const PHD_Point& star = cut.Star();
     int const halfw = wxMin((reqsize - 1) / 2, 31);
     int const fullw = 2 * halfw + 1;
     int const sx = (int) rint(star.X);
@@ -1310,16 +2134,7 @@ static void get_star_image(JObj& response, const json_value *params)
         rect.Intersect(wxRect(img->Size));
     else
         rect.Intersect(img->Subframe);
-
-    int width = rect.GetWidth();
-    size_t size = width * rect.GetHeight() * sizeof(unsigned short);
-
-    B64Encode enc;
-    for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
-    {
-        const unsigned short *p = img->ImageData + y * img->Size.GetWidth() + rect.GetLeft();
-        enc.append(p, rect.GetWidth() * sizeof(unsigned short));
-    }
+    rect.Intersect(cut.Rect());
 
     PHD_Point pos(star);
     pos.X -= rect.GetLeft();
@@ -1330,7 +2145,7 @@ static void get_star_image(JObj& response, const json_value *params)
         << NV("width", rect.GetWidth())
         << NV("height", rect.GetHeight())
         << NV("star_pos", pos)
-        << NV("pixels", enc.finish());
+        << NV("pixels", s_starImageCache.Get(cut, rect));
 
     response << jrpc_result(rslt);
 }
@@ -1339,6 +2154,8 @@ static bool parse_settle(SettleParams *settle, const json_value *j, wxString *er
 {
     bool found_pixels = false, found_time = false, found_timeout = false;
 
+    settle->predictive = false;
+
     json_for_each (t, j)
     {
         if (float_param("pixels", t, &settle->tolerancePx))
@@ -1359,6 +2176,8 @@ static bool parse_settle(SettleParams *settle, const json_value *j, wxString *er
             found_timeout = true;
             continue;
         }
+        if (strcmp(t->name, "predictive") == 0 && bool_param(t, &settle->predictive))
+            continue;
     }
 
     settle->frames = 99999;
@@ -1379,6 +2198,7 @@ static void guide(JObj& response, const json_value *params)
     //     frames [integer]
     //     time [integer]
     //     timeout [integer]
+    //     predictive [boolean] (optional)
     //   recalibrate: boolean
     //
     // {"method": "guide", "params": [{"pixels": 0.5, "time": 6, "timeout": 30}, false], "id": 42}
@@ -1514,153 +2334,1622 @@ static void get_camera_binning(JObj& response, const json_value *params)
 {
     if (pCamera && pCamera->Connected)
     {
-        int binning = pCamera->Binning;
+        int binning = pCamera->EffectiveBinning();
         response << jrpc_result(binning);
     }
     else
         response << jrpc_error(1, "camera not connected");
 }
 
-static void get_guide_output_enabled(JObj& response, const json_value *params)
+static NV NVCaptureLatency(const wxString& name, const CaptureLatency& lat)
 {
-    if (pMount)
-        response << jrpc_result(pMount->GetGuidingEnabled());
-    else
-        response << jrpc_error(1, "mount not defined");
+    JObj t;
+    t << NV("count", (int) lat.count)
+      << NV("last", lat.lastMs, 1)
+      << NV("mean", lat.MeanMs(), 1)
+      << NV("p50", lat.PercentileMs(50.0), 1)
+      << NV("p95", lat.PercentileMs(95.0), 1)
+      << NV("max", lat.maxMs, 1);
+    return NV(name, t);
 }
 
-static void set_guide_output_enabled(JObj& response, const json_value *params)
+static NV NVWorkerLatency(const wxString& name, const WorkerThreadLatency& lat)
 {
-    Params p("enabled", params);
-    const json_value *val = p.param("enabled");
-    bool enable;
-    if (!val || !bool_param(val, &enable))
-    {
-        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected enabled boolean param");
-        return;
-    }
-
-    if (pMount)
-    {
-        pMount->SetGuidingEnabled(enable);
-        response << jrpc_result(0);
-    }
-    else
-        response << jrpc_error(1, "mount not defined");
+    JObj t;
+    t << NV("count", (int) lat.count)
+      << NV("last", lat.lastMs, 1)
+      << NV("mean", lat.MeanMs(), 1)
+      << NV("max", lat.maxMs, 1);
+    return NV(name, t);
 }
 
-static void dump_request(const wxSocketClient *cli, const json_value *req)
+static NV NVPerfSummary(const wxString& name, const PerfSummary& s)
 {
-    Debug.Write(wxString::Format("evsrv: cli %p request: %s\n", cli, json_format(req)));
+    JObj t;
+    t << NV("count", (int) s.count)
+      << NV("mean", s.meanMs, 2)
+      << NV("p50", s.p50Ms, 2)
+      << NV("p95", s.p95Ms, 2)
+      << NV("p99", s.p99Ms, 2)
+      << NV("max", s.maxMs, 2);
+    return NV(name, t);
 }
 
-static void dump_response(const wxSocketClient *cli, const JRpcResponse& resp)
+static JObj CycleTiming()
 {
-    Debug.Write(wxString::Format("evsrv: cli %p response: %s\n", cli, const_cast<JRpcResponse&>(resp).str()));
+    JObj session, window;
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+    {
+        PerfStage stage = static_cast<PerfStage>(i);
+        PerfSummary s;
+        PerfStats::GetSession(stage, &s);
+        session << NVPerfSummary(PerfStats::StageName(stage), s);
+        PerfStats::GetWindow(stage, &s);
+        window << NVPerfSummary(PerfStats::StageName(stage), s);
+    }
+
+    JObj t;
+    t << NV("cycles", (int) PerfStats::Cycles())
+      << NV("slow_cycles", (int) PerfStats::SlowCycles())
+      << NV("slow_cycle_fraction", PerfStats::SlowCycleFraction(), 2)
+      << NV("window_minutes", PerfStats::WindowMinutes())
+      << NV("session", session)
+      << NV("window", window);
+    return t;
 }
 
-static bool handle_request(const wxSocketClient *cli, JObj& response, const json_value *req)
+// Guide history from the session telemetry (GuideTelemetry), oldest first,
+// in columns. Times are in seconds since the epoch: t0 is the first step and
+// t holds millisecond offsets from t0. The store is only written on the main
+// thread, the same thread that handles requests, so reading it needs no lock.
+static void get_guide_history(JObj& response, const json_value *params)
 {
-    const json_value *method;
-    const json_value *params;
-    const json_value *id;
-
-    dump_request(cli, req);
-
-    parse_request(req, &method, &params, &id);
+    Params p("start", "end", "max", "stats", params);
 
-    if (!method)
+    double start = 0.0, end = 0.0;
+    const json_value *jv = p.param("start");
+    if (jv && !float_param(jv, &start))
     {
-        response << jrpc_error(JSONRPC_INVALID_REQUEST, "invalid request") << jrpc_id(0);
-        return true;
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected start time param");
+        return;
     }
-
-    static struct {
-        const char *name;
-        void (*fn)(JObj& response, const json_value *params);
-    } methods[] = {
-        { "clear_calibration", &clear_calibration, },
-        { "deselect_star", &deselect_star, },
-        { "get_exposure", &get_exposure, },
-        { "set_exposure", &set_exposure, },
-        { "get_exposure_durations", &get_exposure_durations, },
-        { "get_profiles", &get_profiles, },
-        { "get_profile", &get_profile, },
-        { "set_profile", &set_profile, },
-        { "get_connected", &get_connected, },
-        { "set_connected", &set_connected, },
-        { "get_calibrated", &get_calibrated, },
-        { "get_paused", &get_paused, },
-        { "set_paused", &set_paused, },
-        { "get_lock_position", &get_lock_position, },
-        { "set_lock_position", &set_lock_position, },
-        { "loop", &loop, },
-        { "stop_capture", &stop_capture, },
-        { "guide", &guide, },
-        { "dither", &dither, },
-        { "find_star", &find_star, },
-        { "get_pixel_scale", &get_pixel_scale, },
-        { "get_app_state", &get_app_state, },
-        { "flip_calibration", &flip_calibration, },
-        { "get_lock_shift_enabled", &get_lock_shift_enabled, },
-        { "set_lock_shift_enabled", &set_lock_shift_enabled, },
-        { "get_lock_shift_params", &get_lock_shift_params, },
-        { "set_lock_shift_params", &set_lock_shift_params, },
-        { "save_image", &save_image, },
-        { "get_star_image", &get_star_image, },
-        { "get_use_subframes", &get_use_subframes, },
-        { "get_search_region", &get_search_region, },
-        { "shutdown", &shutdown, },
-        { "get_camera_binning", &get_camera_binning, },
-        { "get_current_equipment", &get_current_equipment, },
-        { "get_guide_output_enabled", &get_guide_output_enabled, },
-        { "set_guide_output_enabled", &set_guide_output_enabled, },
-    };
-
-    for (unsigned int i = 0; i < WXSIZEOF(methods); i++)
+    jv = p.param("end");
+    if (jv && !float_param(jv, &end))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected end time param");
+        return;
+    }
+    int max = 0;
+    jv = p.param("max");
+    if (jv)
     {
-        if (strcmp(method->string_value, methods[i].name) == 0)
+        if (jv->type != JSON_INT || jv->int_value < 0)
         {
-            (*methods[i].fn)(response, params);
-            if (id)
-            {
-                response << jrpc_id(id);
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected non-negative integer max param");
+            return;
         }
+        max = jv->int_value;
+    }
+    bool stats = false;
+    jv = p.param("stats");
+    if (jv && !bool_param(jv, &stats))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected boolean stats param");
+        return;
     }
 
-    if (id)
+    const circular_buffer<wxLongLong_t>& ts = Telemetry.Timestamps();
+    wxLongLong_t const tstart = (wxLongLong_t)(start * 1000.0);
+    wxLongLong_t const tend = end > 0.0 ? (wxLongLong_t)(end * 1000.0) : 0;
+
+    // select the range [first, last)
+    unsigned int first = 0;
+    unsigned int last = ts.size();
+    while (first < last && ts[first] < tstart)
+        ++first;
+    if (tend)
+        while (last > first && ts[last - 1] > tend)
+            --last;
+    if (max > 0 && last - first > (unsigned int) max)
+        first = last - max;     // keep the most recent
+
+    unsigned int const n = last - first;
+    wxLongLong_t const t0 = n ? ts[first] : 0;
+
+    std::vector<int> t, raDur, decDur, limited;
+    std::vector<double> dx, dy, ra, dec, snr, mass;
+    t.reserve(n); raDur.reserve(n); decDur.reserve(n); limited.reserve(n);
+    dx.reserve(n); dy.reserve(n); ra.reserve(n); dec.reserve(n); snr.reserve(n); mass.reserve(n);
+
+    // column by column, each is already in the layout sent
+    for (unsigned int i = first; i < last; i++)
+        t.push_back((int)(ts[i] - t0));
+    for (unsigned int i = first; i < last; i++)
+        dx.push_back(Telemetry.Dx()[i]);
+    for (unsigned int i = first; i < last; i++)
+        dy.push_back(Telemetry.Dy()[i]);
+    for (unsigned int i = first; i < last; i++)
+        ra.push_back(Telemetry.Ra()[i]);
+    for (unsigned int i = first; i < last; i++)
+        dec.push_back(Telemetry.Dec()[i]);
+    for (unsigned int i = first; i < last; i++)
+        raDur.push_back(Telemetry.RaDuration()[i]);
+    for (unsigned int i = first; i < last; i++)
+        decDur.push_back(Telemetry.DecDuration()[i]);
+    for (unsigned int i = first; i < last; i++)
+        snr.push_back(Telemetry.SNR()[i]);
+    for (unsigned int i = first; i < last; i++)
+        mass.push_back(Telemetry.Mass()[i]);
+    for (unsigned int i = first; i < last; i++)
+        limited.push_back(Telemetry.Flags()[i]);
+
+    JObj rslt;
+    rslt << NV("count", (int) n)
+         << NV("t0", (double) t0 / 1000.0, 3)
+         << NV("t", t)
+         << NV("dx", dx)
+         << NV("dy", dy)
+         << NV("ra", ra)
+         << NV("dec", dec)
+         << NV("ra_duration", raDur)
+         << NV("dec_duration", decDur)
+         << NV("snr", snr)
+         << NV("mass", mass)
+         << NV("limited", limited);     // bit 0 RA, bit 1 Dec
+
+    std::vector<int> dt;
+    std::vector<double> dra, ddec;
+    const std::deque<DitherInfo>& dithers = Telemetry.Dithers();
+    for (std::deque<DitherInfo>::const_iterator it = dithers.begin(); it != dithers.end(); ++it)
     {
-        response << jrpc_error(JSONRPC_METHOD_NOT_FOUND, "method not found") << jrpc_id(id);
-        return true;
+        if (it->timestamp < tstart || (tend && it->timestamp > tend))
+            continue;
+        dt.push_back((int)(it->timestamp - t0));
+        dra.push_back(it->dRa);
+        ddec.push_back(it->dDec);
     }
-    else
+    JObj d;
+    d << NV("t", dt) << NV("ra", dra) << NV("dec", ddec);
+    rslt << NV("dithers", d);
+
+    if (stats)
     {
-        return false;
+        JObj s;
+        if (n)
+        {
+            TelemetryMoments mra, mdec;
+            GuideTelemetry::Accumulate(Telemetry.Ra(), first, last, &mra);
+            GuideTelemetry::Accumulate(Telemetry.Dec(), first, last, &mdec);
+            s << NV("rms_ra", mra.Rms(), 3)
+              << NV("rms_dec", mdec.Rms(), 3)
+              << NV("rms_tot", hypot(mra.Rms(), mdec.Rms()), 3)
+              << NV("peak_ra", mra.peak, 3)
+              << NV("peak_dec", mdec.peak, 3);
+        }
+
+        // extremes over what the graph window shows, kept by the graph as
+        // samples arrive
+        GraphWindowPeaks gp = pFrame->pGraphLog->GetPeaks();
+        JObj w;
+        w << NV("count", (int) pFrame->pGraphLog->GetHistoryItemCount())
+          << NV("peak_ra", gp.ra, 3)
+          << NV("peak_dec", gp.dec, 3)
+          << NV("max_duration", gp.duration)
+          << NV("max_mass", gp.starMass, 0)
+          << NV("max_snr", gp.starSNR, 2);
+        s << NV("graph_window", w);
+
+        rslt << NV("stats", s);
     }
+
+    response << jrpc_result(rslt);
 }
 
-static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonParser& parser)
+// The hot and cold pixels learned from the guide frames so far, see
+// DefectLearner. Confidence is the fraction of the observations in which the
+// pixel stood out.
+static void get_learned_defects(JObj& response, const json_value *params)
 {
-    if (!parser.Parse(input))
+    std::vector<LearnedDefect> defects;
+    unsigned int observations;
+    DefectLearning.GetDefects(&defects, &observations);
+
+    std::vector<int> x, y;
+    std::vector<double> confidence;
+    for (size_t i = 0; i < defects.size(); i++)
     {
-        JRpcResponse response;
-        response << jrpc_error(JSONRPC_PARSE_ERROR, parser_error(parser)) << jrpc_id(0);
-        dump_response(cli, response);
-        do_notify1(cli, response);
-        return;
+        x.push_back(defects[i].pt.x);
+        y.push_back(defects[i].pt.y);
+        confidence.push_back(defects[i].confidence);
     }
 
-    const json_value *root = parser.Root();
+    JObj rslt;
+    rslt << NV("enabled", DefectLearning.IsEnabled())
+         << NV("observations", (int) observations)
+         << NV("count", (int) defects.size())
+         << NV("x", x)
+         << NV("y", y)
+         << NV("confidence", confidence);
 
-    if (root->type == JSON_ARRAY)
-    {
-        // a batch request
+    response << jrpc_result(rslt);
+}
+
+// Everything the guide loop measures about itself in one call, for monitoring
+// headless installations. Latencies are in ms with log-spaced histograms
+// summarized as percentiles.
+static void get_metrics(JObj& response, const json_value *params)
+{
+    JObj rslt;
+
+    if (pCamera && pCamera->Connected)
+    {
+        CaptureTimingStats st = pCamera->GetCaptureTiming();
+        JObj cam;
+        cam << NVCaptureLatency("exposure", st.exposure)
+            << NVCaptureLatency("download", st.transfer)
+            << NVCaptureLatency("readout", st.readout)
+            << NVCaptureLatency("processing", st.processing)
+            << NVCaptureLatency("total", st.total);
+        rslt << NV("capture", cam);
+    }
+
+    GuideLoopStats gs = GuideMetrics.GetStats();
+    JObj guide;
+    guide << NV("frames", (int) gs.frames)
+          << NV("star_lost", (int) gs.starLost)
+          << NV("dropped_frames", (int) gs.droppedFrames)
+          << NVCaptureLatency("star_find", gs.starFind)
+          << NVCaptureLatency("algorithm", gs.algorithm);
+    rslt << NV("guide", guide);
+
+    WorkerThreadStats ws = pFrame->GetCaptureThreadStats();
+    JObj wt;
+    wt << NVWorkerLatency("expose_queue", ws.exposeQueue)
+       << NVWorkerLatency("move_wait", ws.exposeHandoff)
+       << NVWorkerLatency("move_queue", ws.moveQueue)
+       << NVWorkerLatency("move", ws.moveService);
+    rslt << NV("worker", wt);
+
+    unsigned int clients, dropped;
+    size_t queued;
+    EvtServer.GetOutputQueueStats(&clients, &queued, &dropped);
+    JObj srv;
+    srv << NV("clients", (int) clients)
+        << NV("queued_bytes", (double) queued, 0)
+        << NV("bytes_sent", (double) EvtServer.BytesSent(), 0)
+        << NV("dropped_events", (int) dropped);
+    rslt << NV("event_server", srv);
+
+    JObj cycle = CycleTiming();
+    rslt << NV("cycle", cycle);
+
+    rslt << NV("memory", GuideLoopMetrics::ProcessMemory().ToDouble(), 0);
+
+    // the guide steps retained for the session, see get_guide_history
+    TelemetryMoments mra, mdec;
+    GuideTelemetry::Accumulate(Telemetry.Ra(), 0, Telemetry.Size(), &mra);
+    GuideTelemetry::Accumulate(Telemetry.Dec(), 0, Telemetry.Size(), &mdec);
+    JObj tel;
+    tel << NV("steps", (int) Telemetry.Size())
+        << NV("total_steps", (double) Telemetry.End(), 0)
+        << NV("retention", (int) Telemetry.Retention())
+        << NV("bytes", (double) Telemetry.MemoryBytes(), 0)
+        << NV("rms_ra", mra.Rms(), 3)
+        << NV("rms_dec", mdec.Rms(), 3);
+    rslt << NV("telemetry", tel);
+
+    // the scheduling asked for and granted, see ThreadPriority
+    ThreadPriorityStatus tp = ThreadPriority::GetStatus();
+    JAry tpThreads;
+    for (size_t i = 0; i < tp.threads.size(); i++)
+    {
+        const ThreadPriorityThread& t = tp.threads[i];
+        JObj o;
+        o << NV("name", t.name)
+          << NV("class", t.cls == THREAD_CLASS_GUIDE ? "guide" : "background")
+          << NV("granted", t.granted)
+          << NV("detail", t.detail);
+        tpThreads << o;
+    }
+    JObj thr;
+    thr << NV("realtime", tp.realtime)
+        << NV("policy", tp.policy)
+        << NV("affinity", tp.affinity)
+        << NV("lower_background", tp.lowerBackground)
+        << NV("threads", tpThreads);
+    rslt << NV("threads", thr);
+
+    PowerSaverStatus ps = PowerSaver::GetStatus();
+    JObj pwr;
+    pwr << NV("mode", ps.mode == POWER_SAVER_ON ? "on" : ps.mode == POWER_SAVER_AUTO ? "auto" : "off")
+        << NV("engaged", ps.engaged)
+        << NV("on_battery", ps.onBattery);
+    if (ps.cpuLoad >= 0.0)
+        pwr << NV("cpu_load", ps.cpuLoad, 1);
+    rslt << NV("power_saver", pwr);
+
+    LoadShedderStatus ls = LoadShedder::GetStatus();
+    static const char *const shedNames[NUM_SHED_LEVELS] = {
+        "none", "display", "image_log", "windows", "debug_log", "autofind",
+    };
+    JObj shed;
+    for (int i = SHED_DISPLAY; i < NUM_SHED_LEVELS; i++)
+        shed << NV(shedNames[i], (int) ls.shed[i]);
+    JObj ovl;
+    ovl << NV("enabled", ls.enabled)
+        << NV("budget_pct", ls.budgetPct)
+        << NV("level", ls.level)
+        << NV("level_name", shedNames[ls.level])
+        << NV("level_changes", (int) ls.levelChanges)
+        << NV("shed", shed);
+    if (ls.load >= 0.0)
+        ovl << NV("load_pct", ls.load * 100.0, 1);
+    rslt << NV("overload", ovl);
+
+    // only in builds that count allocations, see AllocTrack
+    if (AllocTrack::IsEnabled())
+    {
+        AllocCounts all, last;
+        AllocTrack::GetCounts(&all);
+        AllocTrack::GetLastCycle(&last);
+        JObj tags;
+        for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+        {
+            if (all.tag[i])
+            {
+                JObj t;
+                t << NV("total", (double) all.tag[i], 0) << NV("last_cycle", (double) last.tag[i], 0);
+                tags << NV(AllocTrack::TagName(i), t);
+            }
+        }
+        JObj alloc;
+        alloc << NV("total", (double) all.total, 0)
+              << NV("last_cycle", (double) last.total, 0)
+              << NV("by_stage", tags);
+        rslt << NV("allocations", alloc);
+    }
+
+    response << jrpc_result(rslt);
+}
+
+// Per-stage latency percentiles in ms for the session and the rolling
+// window; reset=true clears the session histograms after reporting them
+static void get_cycle_timing(JObj& response, const json_value *params)
+{
+    Params p("reset", params);
+    bool reset = false;
+    const json_value *jv = p.param("reset");
+    if (jv && !bool_param(jv, &reset))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected boolean reset param");
+        return;
+    }
+
+    JObj rslt = CycleTiming();
+    response << jrpc_result(rslt);
+
+    if (reset)
+        PerfStats::ResetSession();
+}
+
+static void start_trace(JObj& response, const json_value *params)
+{
+    PerfTrace::Start();
+    response << jrpc_result(0);
+}
+
+static void export_trace(JObj& response, const json_value *params)
+{
+    wxString fileName;
+    if (PerfTrace::Export(&fileName))
+    {
+        response << jrpc_error(1, "could not write trace file");
+        return;
+    }
+
+    JObj rslt;
+    rslt << NV("filename", fileName);
+    response << jrpc_result(rslt);
+}
+
+static void stop_trace(JObj& response, const json_value *params)
+{
+    PerfTrace::Stop();
+    export_trace(response, params);
+}
+
+static void set_profiler_markers(JObj& response, const json_value *params)
+{
+    // params:
+    //   enabled [bool] - send the trace spans to the system tracer as markers
+    //
+    // {"method": "set_profiler_markers", "params": {"enabled": true}, "id": 1}
+
+    Params p("enabled", params);
+    bool enable;
+    if (!p.param("enabled") || !bool_param(p.param("enabled"), &enable))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool value for enabled");
+        return;
+    }
+
+    if (PerfTrace::SetMarkers(enable))
+    {
+        response << jrpc_error(1, "profiler markers are not available");
+        return;
+    }
+
+    response << jrpc_result(PerfTrace::MarkersEnabled());
+}
+
+static void get_capture_timing(JObj& response, const json_value *params)
+{
+    if (!pCamera || !pCamera->Connected)
+    {
+        response << jrpc_error(1, "camera not connected");
+        return;
+    }
+
+    CaptureTimingStats st = pCamera->GetCaptureTiming();
+
+    JObj t;
+    t << NVCaptureLatency("exposure", st.exposure)
+      << NVCaptureLatency("readout", st.readout)
+      << NVCaptureLatency("transfer", st.transfer)
+      << NVCaptureLatency("acquire", st.acquire)
+      << NVCaptureLatency("processing", st.processing)
+      << NVCaptureLatency("total", st.total);
+
+    int cadence = pFrame->GetCadence();
+    if (cadence)
+    {
+        WorkerThreadStats ws = pFrame->GetCaptureThreadStats();
+        JObj c;
+        c << NV("interval", cadence)
+          << NVWorkerLatency("jitter", ws.cadenceJitter)
+          << NVWorkerLatency("overrun", ws.cadenceOverrun);
+        t << NV("cadence", c);
+    }
+
+    response << jrpc_result(t);
+}
+
+static void get_auto_exposure(JObj& response, const json_value *params)
+{
+    const AutoExposureCfg& cfg = pFrame->GetAutoExposureCfg();
+    const AutoExposureModel& model = pFrame->GetAutoExposureModel();
+    double exposure = (double) pFrame->RequestedExposureDuration();
+
+    JObj m;
+    m << NV("valid", model.IsValid())
+      << NV("samples", (int) model.Samples())
+      << NV("overhead", model.OverheadMs(), 0)
+      << NV("snr", model.SNR(exposure), 2)
+      << NV("centroid_noise", model.CentroidNoise(exposure), 3)
+      << NV("wander_rate", model.WanderRate(), 4)
+      << NV("drift_rate", model.DriftRate(), 4)
+      << NV("predicted_error", model.PredictedError(exposure), 3);
+    if (model.IsValid())
+    {
+        int best = model.BestExposure(cfg.minExposure, cfg.maxExposure, cfg.targetSNR);
+        m << NV("best_exposure", best)
+          << NV("best_predicted_error", model.PredictedError(best), 3);
+    }
+
+    JObj t;
+    t << NV("enabled", cfg.enabled)
+      << NV("min", cfg.minExposure)
+      << NV("max", cfg.maxExposure)
+      << NV("target_snr", cfg.targetSNR, 2)
+      << NV("minimize_error", cfg.minimizeError)
+      << NV("exposure", (int) exposure)
+      << NV("model", m);
+
+    response << jrpc_result(t);
+}
+
+static void get_guide_output_enabled(JObj& response, const json_value *params)
+{
+    if (pMount)
+        response << jrpc_result(pMount->GetGuidingEnabled());
+    else
+        response << jrpc_error(1, "mount not defined");
+}
+
+static void set_guide_output_enabled(JObj& response, const json_value *params)
+{
+    Params p("enabled", params);
+    const json_value *val = p.param("enabled");
+    bool enable;
+    if (!val || !bool_param(val, &enable))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected enabled boolean param");
+        return;
+    }
+
+    if (pMount)
+    {
+        pMount->SetGuidingEnabled(enable);
+        response << jrpc_result(0);
+    }
+    else
+        response << jrpc_error(1, "mount not defined");
+}
+
+static const char *dark_build_state_name(DARK_BUILD_STATE st)
+{
+    switch (st)
+    {
+    case DARK_BUILD_IDLE: default: return "Idle";
+    case DARK_BUILD_RUNNING: return "Running";
+    case DARK_BUILD_SUCCEEDED: return "Succeeded";
+    case DARK_BUILD_FAILED: return "Failed";
+    case DARK_BUILD_CANCELLED: return "Cancelled";
+    }
+}
+
+static void start_dark_build(JObj& response, const json_value *params)
+{
+    // params:
+    //   exposures [array of integer] - exposure durations (ms); default: all exposure durations
+    //   frames [integer] - frames for each exposure; default 5
+    //   combine [string] - "mean", "sigma" or "median"; default "mean"
+    //   rebuild [bool] - true to replace the dark library, false to add to it; default false
+    //
+    // {"method": "start_dark_build", "params": {"exposures": [1000, 2000], "frames": 10, "combine": "sigma"}, "id": 1}
+
+    Params p("exposures", "frames", "combine", "rebuild", params);
+
+    DarkBuildRequest req;
+    req.clipSigma = pConfig->Profile.GetDouble("/camera/darks_clip_sigma", 3.0);
+    req.notes = pConfig->Profile.GetString("/camera/darks_note", "");
+
+    const json_value *jv = p.param("exposures");
+    if (jv)
+    {
+        if (jv->type != JSON_ARRAY)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected exposures array param");
+            return;
+        }
+        json_for_each (t, jv)
+        {
+            if (t->type != JSON_INT || t->int_value <= 0)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "invalid exposure duration");
+                return;
+            }
+            req.exposures.push_back(t->int_value);
+        }
+    }
+    else
+    {
+        pFrame->GetExposureDurations(&req.exposures);
+        req.exposures.erase(req.exposures.begin()); // remove "Auto"
+    }
+
+    jv = p.param("frames");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer frames param");
+            return;
+        }
+        req.frameCount = jv->int_value;
+    }
+
+    jv = p.param("combine");
+    if (jv)
+    {
+        if (jv->type != JSON_STRING || DarkBuilder::ParseCombineMethod(jv->string_value, &req.combine))
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected combine param: mean, sigma, or median");
+            return;
+        }
+    }
+
+    jv = p.param("rebuild");
+    if (jv && !bool_param(jv, &req.newLibrary))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool value for rebuild");
+        return;
+    }
+
+    wxString err;
+    if (DarkBuilder::Start(req, &err))
+        response << jrpc_error(1, err);
+    else
+        response << jrpc_result(0);
+}
+
+static void get_dark_build_status(JObj& response, const json_value *params)
+{
+    DarkBuildStatus st = DarkBuilder::GetStatus();
+
+    JObj t;
+    t << NV("state", dark_build_state_name(st.state))
+      << NV("exposure", st.exposure)
+      << NV("exposure_index", st.exposureIndex)
+      << NV("exposure_count", st.exposureCount)
+      << NV("frame", st.frame)
+      << NV("frame_count", st.frameCount)
+      << NV("progress", st.total > 0 ? (double) st.progress / st.total : 0.0)
+      << NV("message", st.message);
+
+    response << jrpc_result(t);
+}
+
+static void stop_dark_build(JObj& response, const json_value *params)
+{
+    DarkBuilder::Cancel();
+    response << jrpc_result(0);
+}
+
+static bool int_array_param(const json_value *jv, int minval, std::vector<int> *vals)
+{
+    if (jv->type != JSON_ARRAY)
+        return false;
+    json_for_each (t, jv)
+    {
+        if (t->type != JSON_INT || t->int_value < minval)
+            return false;
+        vals->push_back(t->int_value);
+    }
+    return true;
+}
+
+static void start_camera_test(JObj& response, const json_value *params)
+{
+    // params:
+    //   exposures [array of integer] - exposure durations (ms); default: the current exposure duration
+    //   binning [array of integer] - binning values; default: the current binning
+    //   gain [array of integer] - gain values (percent); default: the current gain
+    //   subframes [bool] - also test a subframe at each setting; default true
+    //   subframe_size [integer] - subframe width and height (pixels); default 64
+    //   frames [integer] - frames at each setting; default 10
+    //
+    // {"method": "start_camera_test", "params": {"exposures": [100, 500, 2000], "binning": [1, 2], "frames": 20}, "id": 1}
+
+    Params p("exposures", "binning", "gain", "subframes", "subframe_size", "frames", params);
+
+    CameraTestRequest req;
+
+    const json_value *jv = p.param("exposures");
+    if (jv)
+    {
+        if (!int_array_param(jv, 1, &req.exposures))
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected exposures array param");
+            return;
+        }
+    }
+    else
+        req.exposures.push_back(wxMax(pFrame->RequestedExposureDuration(), 1));
+
+    jv = p.param("binning");
+    if (jv && !int_array_param(jv, 1, &req.binnings))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected binning array param");
+        return;
+    }
+
+    jv = p.param("gain");
+    if (jv && !int_array_param(jv, 1, &req.gains))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected gain array param");
+        return;
+    }
+
+    jv = p.param("subframes");
+    if (jv && !bool_param(jv, &req.subframes))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool value for subframes");
+        return;
+    }
+
+    jv = p.param("subframe_size");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 8)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer subframe_size param");
+            return;
+        }
+        req.subframeSize = jv->int_value;
+    }
+
+    jv = p.param("frames");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer frames param");
+            return;
+        }
+        req.frameCount = jv->int_value;
+    }
+
+    wxString err;
+    if (CameraTest::Start(req, &err))
+        response << jrpc_error(1, err);
+    else
+        response << jrpc_result(0);
+}
+
+static const char *camera_test_state_name(CAMERA_TEST_STATE st)
+{
+    switch (st)
+    {
+    case CAMERA_TEST_IDLE: default: return "Idle";
+    case CAMERA_TEST_RUNNING: return "Running";
+    case CAMERA_TEST_SUCCEEDED: return "Succeeded";
+    case CAMERA_TEST_FAILED: return "Failed";
+    case CAMERA_TEST_CANCELLED: return "Cancelled";
+    }
+}
+
+static void get_camera_test_status(JObj& response, const json_value *params)
+{
+    CameraTestStatus st = CameraTest::GetStatus();
+
+    JAry results;
+    for (size_t i = 0; i < st.results.size(); i++)
+    {
+        const CameraTestResult& r = st.results[i];
+        JObj t;
+        t << NV("exposure", r.exposure)
+          << NV("binning", r.binning)
+          << NV("gain", r.gain)
+          << NV("subframe", r.subframe)
+          << NV("width", r.size.GetWidth())
+          << NV("height", r.size.GetHeight())
+          << NV("frames", r.frames)
+          << NV("failed", r.failed)
+          << NV("stale", r.Stale())
+          << NV("readout_ms", r.readoutMs, 1)
+          << NV("transfer_ms", r.transferMs, 1)
+          << NV("overhead_ms", r.overheadMs, 1)
+          << NV("interval_ms", r.intervalMs, 1)
+          << NV("interval_p95_ms", r.intervalP95Ms, 1)
+          << NV("max_fps", r.maxFps, 2);
+        results << t;
+    }
+
+    JObj t;
+    t << NV("state", camera_test_state_name(st.state))
+      << NV("setting", st.setting)
+      << NV("setting_count", st.settingCount)
+      << NV("frame", st.frame)
+      << NV("frame_count", st.frameCount)
+      << NV("results", results)
+      << NV("filename", st.fileName)
+      << NV("message", st.message);
+
+    response << jrpc_result(t);
+}
+
+static void stop_camera_test(JObj& response, const json_value *params)
+{
+    CameraTest::Cancel();
+    response << jrpc_result(0);
+}
+
+static void start_pulse_profile(JObj& response, const json_value *params)
+{
+    // params:
+    //   durations [array of integer] - pulse durations (ms); default 50, 100, 200, 500, 1000
+    //   repeats [integer] - pulses of each duration in each direction; default 3
+    //   axes [string] - "ra", "dec" or "both"; default "both"
+    //   track [bool] - measure the star motion after each pulse; default true
+    //   exposure [integer] - exposure (ms) for the tracking frames; default: the current exposure duration
+    //   settle [integer] - wait (ms) after each pulse before the tracking frame; default 500
+    //
+    // {"method": "start_pulse_profile", "params": {"durations": [100, 500], "repeats": 5, "axes": "ra"}, "id": 1}
+
+    Params p("durations", "repeats", "axes", "track", "exposure", "settle", params);
+
+    PulseProfileRequest req;
+    req.exposure = wxMax(pFrame->RequestedExposureDuration(), 1);
+
+    const json_value *jv = p.param("durations");
+    if (jv)
+    {
+        req.durations.clear();
+        if (!int_array_param(jv, 1, &req.durations))
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected durations array param");
+            return;
+        }
+    }
+
+    jv = p.param("repeats");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer repeats param");
+            return;
+        }
+        req.repeats = jv->int_value;
+    }
+
+    jv = p.param("axes");
+    if (jv)
+    {
+        wxString axes = jv->type == JSON_STRING ? wxString(jv->string_value) : wxString();
+        if (axes.CmpNoCase("ra") == 0)
+            req.dec = false;
+        else if (axes.CmpNoCase("dec") == 0)
+            req.ra = false;
+        else if (axes.CmpNoCase("both") != 0)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected axes param: ra, dec, or both");
+            return;
+        }
+    }
+
+    jv = p.param("track");
+    if (jv && !bool_param(jv, &req.track))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected bool value for track");
+        return;
+    }
+
+    jv = p.param("exposure");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer exposure param");
+            return;
+        }
+        req.exposure = jv->int_value;
+    }
+
+    jv = p.param("settle");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 0)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer settle param");
+            return;
+        }
+        req.settle = jv->int_value;
+    }
+
+    wxString err;
+    if (PulseProfiler::Start(req, &err))
+        response << jrpc_error(1, err);
+    else
+        response << jrpc_result(0);
+}
+
+static const char *pulse_profile_state_name(PULSE_PROFILE_STATE st)
+{
+    switch (st)
+    {
+    case PULSE_PROFILE_IDLE: default: return "Idle";
+    case PULSE_PROFILE_RUNNING: return "Running";
+    case PULSE_PROFILE_SUCCEEDED: return "Succeeded";
+    case PULSE_PROFILE_FAILED: return "Failed";
+    case PULSE_PROFILE_CANCELLED: return "Cancelled";
+    }
+}
+
+static void get_pulse_profile_status(JObj& response, const json_value *params)
+{
+    PulseProfileStatus st = PulseProfiler::GetStatus();
+
+    JAry results;
+    for (size_t i = 0; i < st.results.size(); i++)
+    {
+        const PulseProfileResult& r = st.results[i];
+        JObj t;
+        t << NV("direction", pMount ? pMount->Mount::DirectionStr(r.direction) : "?")
+          << NV("duration", r.duration)
+          << NV("pulses", r.pulses)
+          << NV("failed", r.failed)
+          << NV("command_ms", r.commandMs, 1)
+          << NV("completion_ms", r.completionMs, 1)
+          << NV("completion_p95_ms", r.completionP95Ms, 1)
+          << NV("completion_max_ms", r.completionMaxMs, 1)
+          << NV("tracked", r.tracked)
+          << NV("motion_px", r.motionPx, 2)
+          << NV("cross_px", r.crossPx, 2)
+          << NV("expected_px", r.expectedPx, 2)
+          << NV("response", r.response, 2);
+        results << t;
+    }
+
+    JObj t;
+    t << NV("state", pulse_profile_state_name(st.state))
+      << NV("pulse", st.pulse)
+      << NV("pulse_count", st.pulseCount)
+      << NV("results", results)
+      << NV("filename", st.fileName)
+      << NV("message", st.message);
+
+    response << jrpc_result(t);
+}
+
+static void stop_pulse_profile(JObj& response, const json_value *params)
+{
+    PulseProfiler::Cancel();
+    response << jrpc_result(0);
+}
+
+static void start_ao_fast_loop(JObj& response, const json_value *params)
+{
+    // params:
+    //   exposure [integer] - exposure (ms); default 50
+    //   roi [integer] - half size (pixels) of the square captured around the star; default 16
+    //   gain [number] - fraction of the star offset corrected each frame, 0 < gain <= 1; default 0.7
+    //   bump_interval [integer] - ms between mount bump updates; default 1000
+    //
+    // {"method": "start_ao_fast_loop", "params": {"exposure": 20, "roi": 12}, "id": 1}
+
+    Params p("exposure", "roi", "gain", "bump_interval", params);
+
+    AOFastLoopRequest req;
+
+    const json_value *jv = p.param("exposure");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 1)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer exposure param");
+            return;
+        }
+        req.exposure = jv->int_value;
+    }
+
+    jv = p.param("roi");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 4)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer roi param");
+            return;
+        }
+        req.roiSize = jv->int_value;
+    }
+
+    jv = p.param("gain");
+    if (jv && !float_param(jv, &req.gain))
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected numeric gain param");
+        return;
+    }
+
+    jv = p.param("bump_interval");
+    if (jv)
+    {
+        if (jv->type != JSON_INT || jv->int_value < 100)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected integer bump_interval param");
+            return;
+        }
+        req.bumpInterval = jv->int_value;
+    }
+
+    wxString err;
+    if (AOFastLoop::Start(req, &err))
+        response << jrpc_error(1, err);
+    else
+        response << jrpc_result(0);
+}
+
+static const char *ao_fast_loop_state_name(AO_FAST_LOOP_STATE st)
+{
+    switch (st)
+    {
+    case AO_FAST_LOOP_IDLE: default: return "Idle";
+    case AO_FAST_LOOP_RUNNING: return "Running";
+    case AO_FAST_LOOP_STOPPED: return "Stopped";
+    case AO_FAST_LOOP_FAILED: return "Failed";
+    }
+}
+
+static void get_ao_fast_loop_status(JObj& response, const json_value *params)
+{
+    AOFastLoopStatus st = AOFastLoop::GetStatus();
+
+    JObj t;
+    t << NV("state", ao_fast_loop_state_name(st.state))
+      << NV("frames", st.frames)
+      << NV("lost", st.lost)
+      << NV("bumps", st.bumps)
+      << NV("rate_hz", st.rateHz, 1)
+      << NV("cycle_ms", st.cycleMs, 2)
+      << NV("rms_px", st.rmsPx, 3)
+      << NV("message", st.message);
+
+    response << jrpc_result(t);
+}
+
+static void stop_ao_fast_loop(JObj& response, const json_value *params)
+{
+    AOFastLoop::Stop();
+    response << jrpc_result(0);
+}
+
+static void dump_request(const wxSocketClient *cli, const json_value *req)
+{
+    Debug.Write(wxString::Format("evsrv: cli %p request: %s\n", cli, json_format(req)));
+}
+
+static void dump_response(const wxSocketClient *cli, const JRpcResponse& resp)
+{
+    Debug.Write(wxString::Format("evsrv: cli %p response: %s\n", cli, const_cast<JRpcResponse&>(resp).str()));
+}
+
+static void set_event_filter(wxSocketClient *cli, JObj& response, const json_value *params)
+{
+    Params p("events", "guide_step_interval", "instances", params);
+    ClientEventFilter filter;
+
+    const json_value *jv = p.param("events");
+    if (jv && jv->type != JSON_NULL)
+    {
+        if (jv->type != JSON_ARRAY)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected array of event names for events param");
+            return;
+        }
+
+        filter.all = false;
+
+        json_for_each (ev, jv)
+        {
+            if (ev->type != JSON_STRING)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected array of event names for events param");
+                return;
+            }
+            if (strcmp(ev->string_value, "*") == 0)
+                filter.all = true;
+            else
+                filter.events.insert(wxString::FromUTF8(ev->string_value));
+        }
+    }
+
+    jv = p.param("guide_step_interval");
+    if (jv)
+    {
+        double interval;
+        if (!float_param(jv, &interval) || interval < 0.0)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected non-negative guide_step_interval param (seconds)");
+            return;
+        }
+        filter.guideStepIntervalMs = (int)(interval * 1000.0);
+    }
+
+    jv = p.param("instances");
+    if (jv && jv->type != JSON_NULL)
+    {
+        if (jv->type != JSON_ARRAY)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected array of instance numbers for instances param");
+            return;
+        }
+
+        json_for_each (inst, jv)
+        {
+            if (inst->type != JSON_INT || inst->int_value < 1 || inst->int_value > 32)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected array of instance numbers for instances param");
+                return;
+            }
+            if (inst->int_value != pFrame->GetInstanceNumber())
+                filter.instances |= 1u << (inst->int_value - 1);
+        }
+    }
+
+    client_data(cli)->filter = filter;
+
+    Debug.Write(wxString::Format("evsrv: cli %p event filter: %s, GuideStep interval %d ms, relayed instances %#x\n", cli,
+        filter.all ? wxString("all") : wxString::Format("%u events", (unsigned int) filter.events.size()),
+        filter.guideStepIntervalMs, filter.instances));
+
+    response << jrpc_result(0);
+}
+
+// guide frames for a WebSocket client, as binary frames:
+// {"roi":"star"|"full"|null, "size":n, "interval":seconds}
+static void set_image_stream(wxSocketClient *cli, JObj& response, const json_value *params)
+{
+    WsClient *ws = client_data(cli)->ws;
+    if (!ws)
+    {
+        response << jrpc_error(1, "image streams are only for WebSocket clients");
+        return;
+    }
+
+    Params p("roi", "size", "interval", params);
+    int imageSize = 0;
+    int intervalMs = 0;
+
+    const json_value *jv = p.param("roi");
+    if (jv && jv->type == JSON_STRING && strcmp(jv->string_value, "full") == 0)
+        imageSize = -1;
+    else if (jv && jv->type == JSON_STRING && strcmp(jv->string_value, "star") == 0)
+    {
+        imageSize = 31;
+        const json_value *sz = p.param("size");
+        if (sz)
+        {
+            if (sz->type != JSON_INT || sz->int_value < 15 || sz->int_value > 511)
+            {
+                response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected size param 15 to 511");
+                return;
+            }
+            imageSize = sz->int_value;
+        }
+    }
+    else if (jv && jv->type != JSON_NULL)
+    {
+        response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected roi param \"star\", \"full\" or null");
+        return;
+    }
+
+    jv = p.param("interval");
+    if (jv)
+    {
+        double interval;
+        if (!float_param(jv, &interval) || interval < 0.0)
+        {
+            response << jrpc_error(JSONRPC_INVALID_PARAMS, "expected non-negative interval param (seconds)");
+            return;
+        }
+        intervalMs = (int)(interval * 1000.0);
+    }
+
+    ws->imageSize = imageSize;
+    ws->imageIntervalMs = intervalMs;
+
+    Debug.Write(wxString::Format("evsrv: cli %p image stream %d, interval %d ms\n", cli, imageSize, intervalMs));
+
+    response << jrpc_result(0);
+}
+
+typedef void (*RpcFn)(JObj& response, const json_value *params);
+typedef void (*CliRpcFn)(wxSocketClient *cli, JObj& response, const json_value *params);
+
+struct RpcMethod
+{
+    RpcFn fn;
+    CliRpcFn clifn;   // for methods that act on the requesting client's own connection
+    RpcMethod() : fn(0), clifn(0) { }
+};
+
+struct CStrHash
+{
+    size_t operator()(const char *s) const
+    {
+        // FNV-1a
+        size_t h = 2166136261U;
+        while (*s)
+            h = (h ^ (unsigned char) *s++) * 16777619U;
+        return h;
+    }
+};
+
+struct CStrEq
+{
+    bool operator()(const char *a, const char *b) const { return strcmp(a, b) == 0; }
+};
+
+typedef std::unordered_map<const char *, RpcMethod, CStrHash, CStrEq> RpcMethodMap;
+
+static bool handle_request(wxSocketClient *cli, JObj& response, const json_value *req)
+{
+    const json_value *method;
+    const json_value *params;
+    const json_value *id;
+
+    dump_request(cli, req);
+
+    parse_request(req, &method, &params, &id);
+
+    if (!method)
+    {
+        response << jrpc_error(JSONRPC_INVALID_REQUEST, "invalid request") << jrpc_id(0);
+        return true;
+    }
+
+    static const struct {
+        const char *name;
+        RpcFn fn;
+    } methods[] = {
+        { "clear_calibration", &clear_calibration, },
+        { "deselect_star", &deselect_star, },
+        { "get_exposure", &get_exposure, },
+        { "set_exposure", &set_exposure, },
+        { "get_exposure_durations", &get_exposure_durations, },
+        { "get_profiles", &get_profiles, },
+        { "get_profile", &get_profile, },
+        { "set_profile", &set_profile, },
+        { "get_connected", &get_connected, },
+        { "set_connected", &set_connected, },
+        { "get_calibrated", &get_calibrated, },
+        { "get_paused", &get_paused, },
+        { "set_paused", &set_paused, },
+        { "get_lock_position", &get_lock_position, },
+        { "set_lock_position", &set_lock_position, },
+        { "loop", &loop, },
+        { "stop_capture", &stop_capture, },
+        { "guide", &guide, },
+        { "dither", &dither, },
+        { "find_star", &find_star, },
+        { "get_job_status", &get_job_status, },
+        { "get_pixel_scale", &get_pixel_scale, },
+        { "get_app_state", &get_app_state, },
+        { "flip_calibration", &flip_calibration, },
+        { "get_lock_shift_enabled", &get_lock_shift_enabled, },
+        { "set_lock_shift_enabled", &set_lock_shift_enabled, },
+        { "get_lock_shift_params", &get_lock_shift_params, },
+        { "get_polar_alignment_estimate", &get_polar_alignment_estimate, },
+        { "set_lock_shift_params", &set_lock_shift_params, },
+        { "set_lock_shift_table", &set_lock_shift_table, },
+        { "save_image", &save_image, },
+        { "get_star_image", &get_star_image, },
+        { "get_use_subframes", &get_use_subframes, },
+        { "get_search_region", &get_search_region, },
+        { "shutdown", &shutdown, },
+        { "get_camera_binning", &get_camera_binning, },
+        { "get_capture_timing", &get_capture_timing, },
+        { "get_auto_exposure", &get_auto_exposure, },
+        { "get_guide_history", &get_guide_history, },
+        { "get_metrics", &get_metrics, },
+        { "get_learned_defects", &get_learned_defects, },
+        { "get_cycle_timing", &get_cycle_timing, },
+        { "start_trace", &start_trace, },
+        { "stop_trace", &stop_trace, },
+        { "export_trace", &export_trace, },
+        { "set_profiler_markers", &set_profiler_markers, },
+        { "get_current_equipment", &get_current_equipment, },
+        { "get_guide_output_enabled", &get_guide_output_enabled, },
+        { "set_guide_output_enabled", &set_guide_output_enabled, },
+        { "start_dark_build", &start_dark_build, },
+        { "get_dark_build_status", &get_dark_build_status, },
+        { "stop_dark_build", &stop_dark_build, },
+        { "start_camera_test", &start_camera_test, },
+        { "get_camera_test_status", &get_camera_test_status, },
+        { "stop_camera_test", &stop_camera_test, },
+        { "start_pulse_profile", &start_pulse_profile, },
+        { "get_pulse_profile_status", &get_pulse_profile_status, },
+        { "stop_pulse_profile", &stop_pulse_profile, },
+        { "start_ao_fast_loop", &start_ao_fast_loop, },
+        { "get_ao_fast_loop_status", &get_ao_fast_loop_status, },
+        { "stop_ao_fast_loop", &stop_ao_fast_loop, },
+    };
+
+    // methods that act on the requesting client's own connection
+    static const struct {
+        const char *name;
+        CliRpcFn fn;
+    } cli_methods[] = {
+        { "set_event_filter", &set_event_filter, },
+        { "set_image_stream", &set_image_stream, },
+    };
+
+    // hashed lookup, built on first use from the tables above
+    static RpcMethodMap s_methods;
+    if (s_methods.empty())
+    {
+        s_methods.reserve(WXSIZEOF(methods) + WXSIZEOF(cli_methods));
+        for (unsigned int i = 0; i < WXSIZEOF(methods); i++)
+            s_methods[methods[i].name].fn = methods[i].fn;
+        for (unsigned int i = 0; i < WXSIZEOF(cli_methods); i++)
+            s_methods[cli_methods[i].name].clifn = cli_methods[i].fn;
+    }
+
+    RpcMethodMap::const_iterator it = s_methods.find(method->string_value);
+
+    if (it != s_methods.end())
+    {
+        if (it->second.clifn)
+            (*it->second.clifn)(cli, response, params);
+        else
+            (*it->second.fn)(response, params);
+
+        if (id)
+        {
+            response << jrpc_id(id);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (id)
+    {
+        response << jrpc_error(JSONRPC_METHOD_NOT_FOUND, "method not found") << jrpc_id(id);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Other PHD2 instances on this host can be relayed through this server, so a
+// client watching several guide rigs needs only the one connection. A client
+// opts in to their events with the "instances" param of set_event_filter; the
+// events keep their own "Inst" field. A request carrying "inst":n is
+// forwarded to instance n and the reply comes back with the client's own id.
+struct RelayPeer
+{
+    unsigned int inst;
+    wxSocketClient *sock;
+    bool connected;
+    std::string rdbuf;
+    JsonParser parser;
+
+    RelayPeer(unsigned int inst_) : inst(inst_), sock(0), connected(false) { }
+};
+
+// a request forwarded to a peer, waiting for its reply
+struct RelayCall
+{
+    wxSocketClient *cli;
+    unsigned int inst;
+    wxString id;                // the client's id, as JSON
+};
+
+static std::vector<RelayPeer *> s_relayPeers;
+static std::map<int, RelayCall> s_relayCalls;
+static int s_relayNextId;
+
+static const json_value *member(const json_value *obj, const char *name)
+{
+    json_for_each (t, obj)
+    {
+        if (t->name && strcmp(t->name, name) == 0)
+            return t;
+    }
+    return 0;
+}
+
+static RelayPeer *relay_peer(unsigned int inst)
+{
+    for (std::vector<RelayPeer *>::const_iterator it = s_relayPeers.begin(); it != s_relayPeers.end(); ++it)
+    {
+        if ((*it)->inst == inst)
+            return *it;
+    }
+    return 0;
+}
+
+static void relay_connect(RelayPeer *peer, wxEvtHandler& handler)
+{
+    wxIPV4address addr;
+    addr.LocalHost();
+    addr.Service(4400 + peer->inst - 1);
+
+    peer->sock = new wxSocketClient(wxSOCKET_NOWAIT);
+    peer->sock->SetEventHandler(handler, EVENT_SERVER_RELAY_ID);
+    peer->sock->SetNotify(wxSOCKET_CONNECTION_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_LOST_FLAG);
+    peer->sock->Notify(true);
+    peer->sock->SetClientData(peer);
+    peer->sock->Connect(addr, false);
+}
+
+static void relay_reply_error(const RelayCall& call, const wxString& msg)
+{
+    JRpcResponse response;
+    response << jrpc_error(JSONRPC_INTERNAL_ERROR, msg) << NVJson("id", call.id);
+    do_notify1(call.cli, response);
+}
+
+static void relay_close(RelayPeer *peer)
+{
+    if (peer->connected)
+        Debug.Write(wxString::Format("evsrv: relay to instance %u disconnected\n", peer->inst));
+
+    if (peer->sock)
+    {
+        peer->sock->Destroy();
+        peer->sock = 0;
+    }
+    peer->connected = false;
+    peer->rdbuf.clear();
+
+    for (std::map<int, RelayCall>::iterator it = s_relayCalls.begin(); it != s_relayCalls.end(); )
+    {
+        if (it->second.inst == peer->inst)
+        {
+            relay_reply_error(it->second, wxString::Format("instance %u disconnected", peer->inst));
+            s_relayCalls.erase(it++);
+        }
+        else
+            ++it;
+    }
+}
+
+// a client is going away, drop its outstanding requests
+static void relay_forget(wxSocketClient *cli)
+{
+    for (std::map<int, RelayCall>::iterator it = s_relayCalls.begin(); it != s_relayCalls.end(); )
+    {
+        if (it->second.cli == cli)
+            s_relayCalls.erase(it++);
+        else
+            ++it;
+    }
+}
+
+static bool relay_wants(const ClientData *cd, unsigned int inst, const wxString& name)
+{
+    if (cd->ws && (!cd->ws->open || cd->ws->closed))
+        return false;
+    return inst <= 32 && (cd->filter.instances & (1u << (inst - 1))) != 0 && cd->filter.Wants(name);
+}
+
+// one line from a peer: one of its own events, or the reply to a request we forwarded
+static void relay_line(RelayPeer *peer, const char *line, size_t len, const EventServer::CliSockSet& cli)
+{
+    wxCharBuffer out(len + 2);
+    memcpy(out.data(), line, len);
+    memcpy(out.data() + len, "\r\n", 2);
+
+    std::string text(line, len);
+    if (!peer->parser.Parse(&text[0]) || peer->parser.Root()->type != JSON_OBJECT)
+        return;
+
+    const json_value *root = peer->parser.Root();
+    const json_value *ev = member(root, "Event");
+
+    if (ev && ev->type == JSON_STRING)
+    {
+        // only the peer's own events, so that instances relaying each other do not loop
+        const json_value *inst = member(root, "Inst");
+        if (!inst || inst->type != JSON_INT || (unsigned int) inst->int_value != peer->inst)
+            return;
+
+        wxString name(wxString::FromUTF8(ev->string_value));
+        if (name == "Version")
+            return;
+
+        ClientBytes bytes(out);
+        for (EventServer::CliSockSet::const_iterator it = cli.begin(); it != cli.end(); ++it)
+        {
+            ClientData *cd = client_data(*it);
+            if (relay_wants(cd, peer->inst, name))
+                send_buf(*it, bytes.For(cd), true);
+        }
+        return;
+    }
+
+    const json_value *id = member(root, "id");
+    if (!id || id->type != JSON_INT)
+        return;
+
+    std::map<int, RelayCall>::iterator it = s_relayCalls.find(id->int_value);
+    if (it == s_relayCalls.end())
+        return;
+
+    JObj response;
+    json_for_each (t, root)
+    {
+        if (!t->name)
+            continue;
+        if (strcmp(t->name, "id") == 0)
+            response << NVJson("id", it->second.id);
+        else
+            response << NV(t->name, t);
+    }
+
+    do_notify1(it->second.cli, response);
+    s_relayCalls.erase(it);
+}
+
+static void relay_input(RelayPeer *peer, const EventServer::CliSockSet& cli)
+{
+    char buf[4096];
+
+    while (true)
+    {
+        peer->sock->Read(buf, sizeof(buf));
+        size_t n = peer->sock->LastReadCount();
+        if (n == 0)
+            break;
+        peer->rdbuf.append(buf, n);
+    }
+
+    size_t start = 0;
+    while (true)
+    {
+        size_t eol = peer->rdbuf.find('\n', start);
+        if (eol == std::string::npos)
+            break;
+        size_t end = eol;
+        if (end > start && peer->rdbuf[end - 1] == '\r')
+            --end;
+        if (end > start)
+            relay_line(peer, peer->rdbuf.data() + start, end - start, cli);
+        start = eol + 1;
+    }
+    peer->rdbuf.erase(0, start);
+
+    if (peer->rdbuf.size() > ClientReadBuf::MAX_SIZE)
+    {
+        Debug.Write(wxString::Format("evsrv: relay from instance %u line too long, dropped\n", peer->inst));
+        peer->rdbuf.clear();
+    }
+}
+
+// forward a single request carrying "inst":n to instance n; false if the
+// request is for this instance
+static bool relay_request(wxSocketClient *cli, const json_value *req)
+{
+    const json_value *inst = member(req, "inst");
+    if (!inst || inst->type != JSON_INT || inst->int_value == pFrame->GetInstanceNumber())
+        return false;
+
+    const json_value *id = member(req, "id");
+
+    RelayPeer *peer = inst->int_value > 0 ? relay_peer(inst->int_value) : 0;
+    if (!peer || !peer->connected)
+    {
+        if (id)
+        {
+            RelayCall call = { cli, 0, json_format(id) };
+            relay_reply_error(call, wxString::Format("instance %d is not relayed", inst->int_value));
+        }
+        return true;
+    }
+
+    JObj fwd;
+    json_for_each (t, req)
+    {
+        if (t->name && strcmp(t->name, "inst") != 0 && strcmp(t->name, "id") != 0)
+            fwd << NV(t->name, t);
+    }
+    if (id)
+    {
+        int const relayId = ++s_relayNextId;
+        fwd << NV("id", relayId);
+        RelayCall call = { cli, peer->inst, json_format(id) };
+        s_relayCalls[relayId] = call;
+    }
+
+    wxCharBuffer line((fwd.str() + "\r\n").ToUTF8());
+    peer->sock->Write(line.data(), line.length());
+    if (peer->sock->LastWriteCount() != line.length())
+        Debug.Write(wxString::Format("evsrv: relay to instance %u short write\n", peer->inst));
+
+    return true;
+}
+
+static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonParser& parser)
+{
+    if (!parser.Parse(input))
+    {
+        JRpcResponse response;
+        response << jrpc_error(JSONRPC_PARSE_ERROR, parser_error(parser)) << jrpc_id(0);
+        dump_response(cli, response);
+        do_notify1(cli, response);
+        return;
+    }
+
+    const json_value *root = parser.Root();
+
+    if (root->type == JSON_ARRAY && !root->first_child)
+    {
+        // an empty batch is an invalid request per JSON-RPC 2.0
+        JRpcResponse response;
+        response << jrpc_error(JSONRPC_INVALID_REQUEST, "invalid request") << jrpc_id(0);
+        dump_response(cli, response);
+        do_notify1(cli, response);
+    }
+    else if (root->type == JSON_ARRAY)
+    {
+        // a batch request, answered with a single array in one write
 
         JAry ary;
 
@@ -1676,68 +3965,362 @@ static void handle_cli_input_complete(wxSocketClient *cli, char *input, JsonPars
             }
         }
 
-        if (found)
-            do_notify1(cli, ary);
+        if (found)
+            do_notify1(cli, ary);
+    }
+    else
+    {
+        // a single request
+
+        const json_value *const req = root;
+        if (req->type == JSON_OBJECT && relay_request(cli, req))
+            return;
+
+        JRpcResponse response;
+        if (handle_request(cli, response, req))
+        {
+            dump_response(cli, response);
+            do_notify1(cli, response);
+        }
+    }
+}
+
+// requests one per line
+static void handle_line_input(wxSocketClient *cli, ClientData *clidata)
+{
+    ClientReadBuf *rdbuf = &clidata->rdbuf;
+    wxSocketInputStream sis(*cli);
+
+    while (sis.CanRead())
+    {
+        char *dest = rdbuf->reserve(ClientReadBuf::READ_SIZE);
+        size_t n = sis.Read(dest, ClientReadBuf::READ_SIZE).LastRead();
+        if (n == 0)
+            break;
+        rdbuf->len += n;
+
+        // handle every complete request in the buffer
+        char *const buf = rdbuf->buf.data();
+        size_t start = 0;
+        while (true)
+        {
+            size_t const from = wxMax(start, rdbuf->scanned);
+            size_t const eol = from + find_eol(buf + from, rdbuf->len - from);
+            if (eol == rdbuf->len)
+                break;
+
+            buf[eol] = 0;
+            if (eol > start)
+                handle_cli_input_complete(cli, buf + start, clidata->parser);
+            start = eol + 1;
+        }
+
+        if (start)
+            rdbuf->consume(start);
+        rdbuf->scanned = rdbuf->len;
+
+        if (rdbuf->len > ClientReadBuf::MAX_SIZE)
+        {
+            drain_input(sis);
+
+            JRpcResponse response;
+            response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
+            do_notify1(cli, response);
+
+            rdbuf->reset();
+            break;
+        }
+    }
+}
+
+// sends a close frame and drops the connection once the output is flushed
+static void ws_drop(wxSocketClient *cli, const wxCharBuffer& last)
+{
+    ClientData *cd = client_data(cli);
+    send_buf(cli, last, false);
+    cd->ws->closed = true;
+    cd->AddRef();
+    EvtServer.CallAfter(&EventServer::DisconnectClient, cli);
+}
+
+static void ws_close(wxSocketClient *cli, int code)
+{
+    ws_drop(cli, WebSocket::CloseFrame(code));
+}
+
+static wxString url_decode(const wxString& s)
+{
+    wxCharBuffer in = s.ToUTF8();
+    std::string out;
+    for (const char *p = in.data(); *p; p++)
+    {
+        long v;
+        if (*p == '%' && p[1] && p[2] && wxString(p + 1, 2).ToLong(&v, 16))
+        {
+            out += (char) v;
+            p += 2;
+        }
+        else
+            out += *p == '+' ? ' ' : *p;
+    }
+    return wxString::FromUTF8(out.c_str());
+}
+
+// the subscription a browser can give in the URL, since it cannot send
+// anything before the connection is open:
+//
+//   ws://host:4700/?events=GuideStep,Alert&guide_step_interval=1&images=star:31&image_interval=1
+static void ws_subscribe(ClientData *cd, const wxString& query)
+{
+    wxArrayString args = wxSplit(query, '&', 0);
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        wxString name = url_decode(args[i].BeforeFirst('='));
+        wxString value = url_decode(args[i].AfterFirst('='));
+        double d;
+        long n;
+
+        if (name == "events")
+        {
+            cd->filter.all = false;
+            cd->filter.events.clear();
+            wxArrayString evs = wxSplit(value, ',', 0);
+            for (size_t j = 0; j < evs.size(); j++)
+            {
+                if (evs[j] == "*")
+                    cd->filter.all = true;
+                else if (!evs[j].empty())
+                    cd->filter.events.insert(evs[j]);
+            }
+        }
+        else if (name == "guide_step_interval" && value.ToCDouble(&d) && d >= 0.0)
+            cd->filter.guideStepIntervalMs = (int)(d * 1000.0);
+        else if (name == "images" && value == "full")
+            cd->ws->imageSize = -1;
+        else if (name == "images" && value.StartsWith("star:") && value.AfterFirst(':').ToLong(&n) && n >= 15)
+            cd->ws->imageSize = (int) wxMin(n, 511L);
+        else if (name == "image_interval" && value.ToCDouble(&d) && d >= 0.0)
+            cd->ws->imageIntervalMs = (int)(d * 1000.0);
+        else
+            Debug.Write(wxString::Format("evsrv: ignoring WebSocket URL parameter %s\n", args[i]));
+    }
+}
+
+// handles the opening handshake; returns true if the connection is refused
+static bool ws_open(wxSocketClient *cli, ClientData *cd, const char *req, size_t len)
+{
+    WebSocket::Handshake hs;
+    if (WebSocket::ParseHandshake(req, len, &hs))
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p bad WebSocket handshake\n", cli));
+        ws_drop(cli, WebSocket::ErrorResponse("400 Bad Request"));
+        return true;
+    }
+
+    ws_subscribe(cd, hs.query);
+
+    send_buf(cli, WebSocket::HandshakeResponse(hs), false);
+    cd->ws->deflate = hs.deflate;
+    cd->ws->open = true;
+
+    Debug.Write(wxString::Format("evsrv: cli %p WebSocket open %s%s\n", cli, hs.path,
+        hs.deflate ? ", permessage-deflate" : ""));
+
+    send_catchup_events(cli);
+
+    return false;
+}
+
+// handles a frame, a whole message once its last fragment is in; returns
+// true when the connection is closing
+static bool ws_frame(wxSocketClient *cli, ClientData *cd, const WebSocket::FrameHeader& hdr, const char *payload)
+{
+    WsClient *ws = cd->ws;
+
+    switch (hdr.opcode)
+    {
+    case WebSocket::OP_PING:
+        send_buf(cli, WebSocket::Frame(WebSocket::OP_PONG, payload, hdr.payloadSize, false), false);
+        return false;
+
+    case WebSocket::OP_PONG:
+        return false;
+
+    case WebSocket::OP_CLOSE:
+        ws_close(cli, WebSocket::CLOSE_NORMAL);
+        return true;
+
+    case WebSocket::OP_TEXT:
+    case WebSocket::OP_BINARY:
+        if (ws->msgOpcode != WebSocket::OP_CONTINUATION || (hdr.compressed && !ws->deflate))
+        {
+            ws_close(cli, WebSocket::CLOSE_PROTOCOL_ERROR);
+            return true;
+        }
+        ws->msgOpcode = hdr.opcode;
+        ws->msgCompressed = hdr.compressed;
+        ws->msg.assign(payload, hdr.payloadSize);
+        break;
+
+    case WebSocket::OP_CONTINUATION:
+        if (ws->msgOpcode == WebSocket::OP_CONTINUATION || hdr.compressed)
+        {
+            ws_close(cli, WebSocket::CLOSE_PROTOCOL_ERROR);
+            return true;
+        }
+        if (ws->msg.size() + hdr.payloadSize > ClientReadBuf::MAX_SIZE)
+        {
+            ws_close(cli, WebSocket::CLOSE_TOO_BIG);
+            return true;
+        }
+        ws->msg.append(payload, hdr.payloadSize);
+        break;
+
+    default:
+        ws_close(cli, WebSocket::CLOSE_PROTOCOL_ERROR);
+        return true;
     }
-    else
-    {
-        // a single request
 
-        const json_value *const req = root;
-        JRpcResponse response;
-        if (handle_request(cli, response, req))
+    if (!hdr.fin)
+        return false;
+
+    int const opcode = ws->msgOpcode;
+    ws->msgOpcode = WebSocket::OP_CONTINUATION;
+
+    if (ws->msgCompressed)
+    {
+        std::string plain;
+        if (WebSocket::Inflate(ws->msg.data(), ws->msg.size(), ClientReadBuf::MAX_SIZE, &plain))
         {
-            dump_response(cli, response);
-            do_notify1(cli, response);
+            ws_close(cli, WebSocket::CLOSE_PROTOCOL_ERROR);
+            return true;
         }
+        ws->msg.swap(plain);
     }
-}
 
-static void handle_cli_input(wxSocketClient *cli, JsonParser& parser)
-{
-    // Bump refcnt to protect against reentrancy.
-    //
-    // Some functions like set_connected can cause the event loop to run reentrantly. If the
-    // client disconnects before the response is sent and a socket disconnect event is
-    // dispatched the client data could be destroyed before we respond.
+    // requests come as text, one or more lines per message; nothing takes binary
+    if (opcode != WebSocket::OP_TEXT)
+        return false;
 
-    ClientDataGuard clidata(cli);
+    std::string msg;
+    msg.swap(ws->msg);
+    msg.push_back(0);
+    char *const buf = &msg[0];
+    size_t const len = msg.size() - 1;
+    size_t start = 0;
+    while (start < len)
+    {
+        size_t const eol = start + find_eol(buf + start, len - start);
+        buf[eol] = 0;
+        if (eol > start)
+            handle_cli_input_complete(cli, buf + start, cd->parser);
+        start = eol + 1;
+    }
 
-    ClientReadBuf *rdbuf = &clidata->rdbuf;
+    return false;
+}
 
+// the handshake, then frames
+static void handle_ws_input(wxSocketClient *cli, ClientData *cd)
+{
+    ClientReadBuf *rdbuf = &cd->rdbuf;
     wxSocketInputStream sis(*cli);
-    size_t avail = rdbuf->avail();
+
+    if (cd->ws->closed)
+    {
+        drain_input(sis);
+        return;
+    }
 
     while (sis.CanRead())
     {
-        if (avail == 0)
+        char *dest = rdbuf->reserve(ClientReadBuf::READ_SIZE);
+        size_t n = sis.Read(dest, ClientReadBuf::READ_SIZE).LastRead();
+        if (n == 0)
+            break;
+        rdbuf->len += n;
+
+        size_t start = 0;
+        bool closing = false;
+        while (!closing)
         {
-            drain_input(sis);
+            char *const buf = rdbuf->buf.data() + start;
+            size_t const avail = rdbuf->len - start;
 
-            JRpcResponse response;
-            response << jrpc_error(JSONRPC_INTERNAL_ERROR, "too big") << jrpc_id(0);
-            do_notify1(cli, response);
+            if (!cd->ws->open)
+            {
+                size_t reqlen = WebSocket::RequestSize(buf, avail);
+                if (reqlen == 0)
+                {
+                    if (avail > ClientReadBuf::READ_SIZE * 2)
+                    {
+                        ws_drop(cli, WebSocket::ErrorResponse("431 Request Header Fields Too Large"));
+                        closing = true;
+                    }
+                    break;
+                }
+                closing = ws_open(cli, cd, buf, reqlen);
+                start += reqlen;
+                continue;
+            }
 
-            rdbuf->reset();
-            break;
+            WebSocket::FrameHeader hdr;
+            int const r = WebSocket::ParseFrame(buf, avail, ClientReadBuf::MAX_SIZE, &hdr);
+            if (r == 0)
+                break;
+            if (r < 0 || !hdr.masked)
+            {
+                ws_close(cli, r < 0 ? WebSocket::CLOSE_TOO_BIG : WebSocket::CLOSE_PROTOCOL_ERROR);
+                closing = true;
+                break;
+            }
+
+            char *const payload = buf + hdr.headerSize;
+            WebSocket::Unmask(payload, hdr.payloadSize, hdr.mask);
+            start += hdr.headerSize + hdr.payloadSize;
+
+            closing = ws_frame(cli, cd, hdr, payload);
         }
-        size_t n = sis.Read(rdbuf->dest, avail).LastRead();
-        if (n == 0)
-            break;
 
-        if (find_eol(rdbuf->dest, n))
+        if (closing)
         {
             drain_input(sis);
-            handle_cli_input_complete(cli, &rdbuf->buf[0], parser);
             rdbuf->reset();
             break;
         }
 
-        rdbuf->dest += n;
-        avail -= n;
+        if (start)
+            rdbuf->consume(start);
     }
 }
 
+static void handle_cli_input(wxSocketClient *cli)
+{
+    // Bump refcnt to protect against reentrancy.
+    //
+    // Some functions like set_connected can cause the event loop to run reentrantly. If the
+    // client disconnects before the response is sent and a socket disconnect event is
+    // dispatched the client data could be destroyed before we respond.
+
+    ClientDataGuard clidata(cli);
+
+    // a request handler ran the event loop and more input arrived; the outer
+    // call keeps reading until the socket is drained, so leave it for that
+    if (clidata->reading)
+        return;
+
+    clidata->reading = true;
+    cork_output(clidata.cd);
+
+    if (clidata->ws)
+        handle_ws_input(cli, clidata.cd);
+    else
+        handle_line_input(cli, clidata.cd);
+
+    uncork_output(clidata.cd);
+    clidata->reading = false;
+}
+
 EventServer::EventServer()
 {
 }
@@ -1767,12 +4350,56 @@ bool EventServer::EventServerStart(unsigned int instanceId)
         return true;
     }
 
+    s_wrqLimit = (size_t) wxMax(16, pConfig->Global.GetInt("/server/output_queue_kb", 1024)) * 1024;
+    catchup_changed();
+    s_wrqDisconnect = pConfig->Global.GetBoolean("/server/output_queue_disconnect", false);
+
     m_serverSocket->SetEventHandler(*this, EVENT_SERVER_ID);
     m_serverSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
     m_serverSocket->Notify(true);
 
     Debug.Write(wxString::Format("event server started, listening on port %u\n", port));
 
+    // the same events for browsers, over WebSocket; the line protocol keeps
+    // working if this port is taken
+    if (pConfig->Global.GetBoolean("/server/websocket", true))
+    {
+        unsigned int wsPort = 4700 + instanceId - 1;
+        wxIPV4address wsAddr;
+        wsAddr.Service(wsPort);
+        m_wsServerSocket = new wxSocketServer(wsAddr);
+
+        if (m_wsServerSocket->Ok())
+        {
+            m_wsServerSocket->SetEventHandler(*this, EVENT_SERVER_WS_ID);
+            m_wsServerSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
+            m_wsServerSocket->Notify(true);
+
+            Debug.Write(wxString::Format("event server WebSocket endpoint listening on port %u\n", wsPort));
+        }
+        else
+        {
+            Debug.Write(wxString::Format("event server WebSocket endpoint could not listen at port %u\n", wsPort));
+            delete m_wsServerSocket;
+            m_wsServerSocket = NULL;
+        }
+    }
+
+    // the other instances 1..n on this host, relayed to clients that ask for them
+    int const relayCount = pConfig->Global.GetInt("/server/relay_instance_count", 0);
+    for (int inst = 1; inst <= wxMin(relayCount, 32); inst++)
+    {
+        if ((unsigned int) inst != instanceId)
+            s_relayPeers.push_back(new RelayPeer(inst));
+    }
+    if (!s_relayPeers.empty())
+    {
+        m_relayTimer = new wxTimer(this, EVENT_SERVER_RELAY_TIMER_ID);
+        m_relayTimer->Start(5000);
+        wxTimerEvent dummy;
+        OnRelayTimer(dummy);
+    }
+
     return false;
 }
 
@@ -1791,6 +4418,24 @@ void EventServer::EventServerStop()
     delete m_serverSocket;
     m_serverSocket = NULL;
 
+    delete m_wsServerSocket;
+    m_wsServerSocket = NULL;
+
+    delete m_relayTimer;
+    m_relayTimer = NULL;
+
+    // a job finishing after this is not reported
+    for (std::deque<RpcJob>::iterator it = s_jobs.begin(); it != s_jobs.end(); ++it)
+        join_job_thread(&*it);
+    s_jobs.clear();
+    for (std::vector<RelayPeer *>::iterator it = s_relayPeers.begin(); it != s_relayPeers.end(); ++it)
+    {
+        relay_close(*it);
+        delete *it;
+    }
+    s_relayPeers.clear();
+    s_relayCalls.clear();
+
     Debug.AddLine("event server stopped");
 }
 
@@ -1806,15 +4451,22 @@ void EventServer::OnEventServerEvent(wxSocketEvent& event)
     if (!client)
         return;
 
-    Debug.Write(wxString::Format("evsrv: cli %p connect\n", client));
+    bool const ws = server == m_wsServerSocket;
+
+    Debug.Write(wxString::Format("evsrv: cli %p connect%s\n", client, ws ? " (WebSocket)" : ""));
 
     client->SetEventHandler(*this, EVENT_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
     client->SetFlags(wxSOCKET_NOWAIT);
     client->Notify(true);
-    client->SetClientData(new ClientData(client));
+    ClientData *cd = new ClientData(client);
+    client->SetClientData(cd);
 
-    send_catchup_events(client);
+    // a WebSocket client gets the catch-up events once its handshake is done
+    if (ws)
+        cd->ws = new WsClient();
+    else
+        send_catchup_events(client);
 
     m_eventServerClients.insert(client);
 }
@@ -1835,7 +4487,13 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     }
     else if (event.GetSocketEvent() == wxSOCKET_INPUT)
     {
-        handle_cli_input(cli, m_parser);
+        handle_cli_input(cli);
+    }
+    else if (event.GetSocketEvent() == wxSOCKET_OUTPUT)
+    {
+        ClientData *cd = client_data(cli);
+        wxMutexLocker lock(cd->wrlock);
+        flush_queue(cli, cd->wrq);
     }
     else
     {
@@ -1843,14 +4501,114 @@ void EventServer::OnEventServerClientEvent(wxSocketEvent& event)
     }
 }
 
+void EventServer::OnRelayTimer(wxTimerEvent& evt)
+{
+    for (std::vector<RelayPeer *>::const_iterator it = s_relayPeers.begin(); it != s_relayPeers.end(); ++it)
+    {
+        if (!(*it)->sock)
+            relay_connect(*it, *this);
+    }
+}
+
+void EventServer::OnRelayEvent(wxSocketEvent& event)
+{
+    RelayPeer *peer = static_cast<RelayPeer *>(event.GetSocket()->GetClientData());
+
+    switch (event.GetSocketEvent())
+    {
+    case wxSOCKET_CONNECTION:
+        peer->connected = true;
+        Debug.Write(wxString::Format("evsrv: relaying instance %u\n", peer->inst));
+        break;
+    case wxSOCKET_INPUT:
+        relay_input(peer, m_eventServerClients);
+        break;
+    case wxSOCKET_LOST:
+        // also a failed connect; the timer tries again
+        relay_close(peer);
+        break;
+    default:
+        break;
+    }
+}
+
+void EventServer::FindStarDone(int jobId)
+{
+    RpcJob *job = find_job(jobId);
+    if (!job || job->state != RpcJob::RUNNING)
+        return;     // abandoned by EventServerStop
+
+    FindStarThread *thread = static_cast<FindStarThread *>(job->thread);
+    thread->Wait();
+    bool const found = thread->m_found;
+    PHD_Point const pos = thread->m_pos;
+    delete thread;
+    job->thread = 0;
+
+    if (!found)
+    {
+        finish_job(m_eventServerClients, job, wxEmptyString, "could not find star");
+        return;
+    }
+
+    if (!pFrame || !pFrame->pGuider || pFrame->pGuider->SelectAutoFoundStar(pos))
+    {
+        finish_job(m_eventServerClients, job, wxEmptyString, "could not select star");
+        return;
+    }
+
+    JAry lockPos;
+    lockPos << pFrame->pGuider->LockPosition().X << pFrame->pGuider->LockPosition().Y;
+    finish_job(m_eventServerClients, job, lockPos.str(), wxEmptyString);
+}
+
+void EventServer::GetOutputQueueStats(unsigned int *clients, size_t *queuedBytes, unsigned int *droppedEvents) const
+{
+    *clients = m_eventServerClients.size();
+    *queuedBytes = 0;
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        ClientData *cd = client_data(*it);
+        wxMutexLocker lock(cd->wrlock);
+        *queuedBytes += cd->wrq.bytes;
+    }
+    *droppedEvents = s_droppedEvents;
+}
+
+long long EventServer::BytesSent() const
+{
+    return s_bytesSent.load(std::memory_order_relaxed);
+}
+
+void EventServer::DisconnectClient(wxSocketClient *cli)
+{
+    // the client may already have disconnected on its own; our reference
+    // keeps the socket alive until now
+    ClientData *cd = client_data(cli);
+
+    if (m_eventServerClients.erase(cli) == 1)
+    {
+        Debug.Write(wxString::Format("evsrv: cli %p disconnected\n", cli));
+        destroy_client(cli);
+    }
+
+    cd->RemoveRef();
+}
+
 void EventServer::NotifyStartCalibration(Mount *mount)
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY_EV(ev_start_calibration(mount));
 }
 
 void EventServer::NotifyCalibrationFailed(Mount *mount, const wxString& msg)
 {
-    if (m_eventServerClients.empty())
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
+    if (!any_client_wants(m_eventServerClients, "CalibrationFailed"))
         return;
 
     Ev ev("CalibrationFailed");
@@ -1861,6 +4619,9 @@ void EventServer::NotifyCalibrationFailed(Mount *mount, const wxString& msg)
 
 void EventServer::NotifyCalibrationComplete(Mount *mount)
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     if (m_eventServerClients.empty())
         return;
 
@@ -1869,7 +4630,8 @@ void EventServer::NotifyCalibrationComplete(Mount *mount)
 
 void EventServer::NotifyCalibrationDataFlipped(Mount *mount)
 {
-    if (m_eventServerClients.empty())
+    catchup_changed();
+    if (!any_client_wants(m_eventServerClients, "CalibrationDataFlipped"))
         return;
 
     Ev ev("CalibrationDataFlipped");
@@ -1880,7 +4642,9 @@ void EventServer::NotifyCalibrationDataFlipped(Mount *mount)
 
 void EventServer::NotifyLooping(unsigned int exposure)
 {
-    if (m_eventServerClients.empty())
+    TelemetryFeed.CheckAppState();
+
+    if (!any_client_wants(m_eventServerClients, "LoopingExposures"))
         return;
 
     Ev ev("LoopingExposures");
@@ -1891,17 +4655,26 @@ void EventServer::NotifyLooping(unsigned int exposure)
 
 void EventServer::NotifyLoopingStopped()
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY("LoopingExposuresStopped");
 }
 
 void EventServer::NotifyStarSelected(const PHD_Point& pt)
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY_EV(ev_star_selected(pt));
 }
 
 void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 {
-    if (m_eventServerClients.empty())
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
+    if (!any_client_wants(m_eventServerClients, "StarLost"))
         return;
 
     Ev ev("StarLost");
@@ -1923,30 +4696,44 @@ void EventServer::NotifyStarLost(const FrameDroppedInfo& info)
 
 void EventServer::NotifyStartGuiding()
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY_EV(ev_start_guiding());
 }
 
 void EventServer::NotifyGuidingStopped()
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY("GuidingStopped");
 }
 
 void EventServer::NotifyPaused()
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY_EV(ev_paused());
 }
 
 void EventServer::NotifyResumed()
 {
+    catchup_changed();
+    TelemetryFeed.CheckAppState();
+
     SIMPLE_NOTIFY("Resumed");
 }
 
 void EventServer::NotifyGuideStep(const GuideStepInfo& step)
 {
-    if (m_eventServerClients.empty())
+    PERF_STAGE(PERF_STAGE_NOTIFY);
+
+    if (!any_client_wants(m_eventServerClients, EV_GUIDE_STEP))
         return;
 
-    Ev ev("GuideStep");
+    Ev ev(EV_GUIDE_STEP);
 
     ev << NV("Frame", step.frameNumber)
        << NV("Time", step.time, 3)
@@ -1991,9 +4778,79 @@ void EventServer::NotifyGuideStep(const GuideStepInfo& step)
     do_notify(m_eventServerClients, ev);
 }
 
+bool EventServer::HasImageClients() const
+{
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        const WsClient *ws = client_data(*it)->ws;
+        if (ws && ws->open && !ws->closed && ws->imageSize != 0)
+            return true;
+    }
+    return false;
+}
+
+// Each subscribed WebSocket client gets the frame as a binary frame in the
+// packed coding of frame_codec.h. A frame is skipped for a client that has
+// output still unsent, so a slow link sees fewer frames rather than stale ones.
+void EventServer::NotifyFrame(const usImage *img, const PHD_Point& star)
+{
+    if (!img || !img->ImageData)
+        return;
+
+    wxRect const valid = img->Subframe.IsEmpty() ? wxRect(img->Size) : img->Subframe;
+    wxLongLong const now = ::wxGetUTCTimeMillis();
+
+    // clients asking for the same pixels share one coding
+    wxRect codedRect;
+    wxCharBuffer coded;
+    bool haveCoded = false;
+
+    for (CliSockSet::const_iterator it = m_eventServerClients.begin(); it != m_eventServerClients.end(); ++it)
+    {
+        ClientData *cd = client_data(*it);
+        WsClient *ws = cd->ws;
+        if (!ws || !ws->open || ws->closed || ws->imageSize == 0)
+            continue;
+
+        if (ws->imageIntervalMs > 0 && now - ws->lastImage < ws->imageIntervalMs)
+            continue;
+
+        {
+            wxMutexLocker lock(cd->wrlock);
+            if (cd->wrq.bytes > 0)
+                continue;
+        }
+
+        wxRect rect = valid;
+        if (ws->imageSize > 0)
+        {
+            if (!star.IsValid())
+                continue;
+            int const halfw = (ws->imageSize - 1) / 2;
+            rect = wxRect((int) floor(star.X + 0.5) - halfw, (int) floor(star.Y + 0.5) - halfw,
+                2 * halfw + 1, 2 * halfw + 1);
+            rect.Intersect(valid);
+            if (rect.IsEmpty())
+                continue;
+        }
+
+        if (!haveCoded || rect != codedRect)
+        {
+            std::vector<unsigned char> out;
+            FrameCodec::Encode(*img, rect, FRAME_CODEC_PACKED, &out);
+            coded = WebSocket::Frame(WebSocket::OP_BINARY, (const char *) out.data(), out.size(), false);
+            codedRect = rect;
+            haveCoded = true;
+        }
+
+        ws->lastImage = now;
+        send_buf(*it, coded, true);
+    }
+}
+
 void EventServer::NotifyGuidingDithered(double dx, double dy)
 {
-    if (m_eventServerClients.empty())
+    if (!any_client_wants(m_eventServerClients, "GuidingDithered"))
         return;
 
     Ev ev("GuidingDithered");
@@ -2004,6 +4861,7 @@ void EventServer::NotifyGuidingDithered(double dx, double dy)
 
 void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 {
+    catchup_changed();
     if (m_eventServerClients.empty())
         return;
 
@@ -2012,23 +4870,27 @@ void EventServer::NotifySetLockPosition(const PHD_Point& xy)
 
 void EventServer::NotifyLockPositionLost()
 {
+    catchup_changed();
     SIMPLE_NOTIFY("LockPositionLost");
 }
 
 void EventServer::NotifyAppState()
 {
+    catchup_changed();
     if (m_eventServerClients.empty())
         return;
 
     do_notify(m_eventServerClients, ev_app_state());
 }
 
-void EventServer::NotifySettling(double distance, double time, double settleTime)
+void EventServer::NotifySettling(double distance, double time, double settleTime, const SettleEstimate *est)
 {
-    if (m_eventServerClients.empty())
+    TelemetryFeed.PublishSettling(distance, time, settleTime);
+
+    if (!any_client_wants(m_eventServerClients, "Settling"))
         return;
 
-    Ev ev(ev_settling(distance, time, settleTime));
+    Ev ev(ev_settling(distance, time, settleTime, est));
 
     Debug.Write(wxString::Format("evsrv: %s\n", ev.str()));
 
@@ -2037,6 +4899,8 @@ void EventServer::NotifySettling(double distance, double time, double settleTime
 
 void EventServer::NotifySettleDone(const wxString& errorMsg)
 {
+    TelemetryFeed.PublishSettleDone(errorMsg);
+
     if (m_eventServerClients.empty())
         return;
 
@@ -2047,9 +4911,162 @@ void EventServer::NotifySettleDone(const wxString& errorMsg)
     do_notify(m_eventServerClients, ev);
 }
 
+void EventServer::NotifyDarkBuildComplete(bool darkLibrary, bool success, const wxString& error)
+{
+    if (!any_client_wants(m_eventServerClients, "DarkBuildComplete"))
+        return;
+
+    Ev ev("DarkBuildComplete");
+    ev << NV("Target", darkLibrary ? "DarkLibrary" : "DefectMap") << NV("Success", success);
+    if (!success)
+        ev << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+void EventServer::NotifyCameraTestComplete(bool success, const wxString& fileName, const wxString& error)
+{
+    if (!any_client_wants(m_eventServerClients, "CameraTestComplete"))
+        return;
+
+    Ev ev("CameraTestComplete");
+    ev << NV("Success", success);
+    if (!fileName.empty())
+        ev << NV("Filename", fileName);
+    if (!success)
+        ev << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+void EventServer::NotifyPulseProfileComplete(bool success, const wxString& fileName, const wxString& error)
+{
+    if (!any_client_wants(m_eventServerClients, "PulseProfileComplete"))
+        return;
+
+    Ev ev("PulseProfileComplete");
+    ev << NV("Success", success);
+    if (!fileName.empty())
+        ev << NV("Filename", fileName);
+    if (!success)
+        ev << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+void EventServer::NotifyAOFastLoopStopped(bool success, const wxString& error)
+{
+    if (!any_client_wants(m_eventServerClients, "AOFastLoopStopped"))
+        return;
+
+    Ev ev("AOFastLoopStopped");
+    ev << NV("Success", success);
+    if (!success)
+        ev << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+void EventServer::NotifyImageSaved(const wxString& fileName, const wxString& error)
+{
+    RpcJob *job = find_running_job("save_image", fileName);
+    if (job)
+    {
+        JObj rslt;
+        rslt << NV("filename", fileName);
+        finish_job(m_eventServerClients, job, rslt.str(), error);
+    }
+
+    if (!any_client_wants(m_eventServerClients, "ImageSaved"))
+        return;
+
+    Ev ev("ImageSaved");
+    ev << NV("Filename", fileName) << NV("Success", error.empty());
+    if (!error.empty())
+        ev << NV("Error", error);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+// the running polar alignment estimate from the guide data was updated
+void EventServer::NotifyPolarAlignEstimate(const PolarDriftEstimate& est)
+{
+    if (!any_client_wants(m_eventServerClients, "PolarAlignment"))
+        return;
+
+    Ev ev("PolarAlignment");
+    polar_align_fields(ev, est);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+// summary of the instrumentation for the guiding run that just ended
+void EventServer::NotifyGuidingPerformance(const GuidingPerfReport& report)
+{
+    if (!any_client_wants(m_eventServerClients, "GuidingPerformance"))
+        return;
+
+    JObj stages;
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+    {
+        if (report.stage[i].count)
+            stages << NVPerfSummary(PerfStats::StageName((PerfStage) i), report.stage[i]);
+    }
+
+    JObj cpu;
+    if (report.processCpu >= 0.0)
+        cpu << NV("process", report.processCpu, 2);
+    for (std::vector<ThreadCpuTime>::const_iterator it = report.threads.begin(); it != report.threads.end(); ++it)
+    {
+        if (it->seconds >= 0.0)
+            cpu << NV(it->name, it->seconds, 2);
+    }
+
+    Ev ev("GuidingPerformance");
+    ev << NV("Duration", report.duration, 1)
+       << NV("Frames", (int) report.frames)
+       << NV("StarLost", (int) report.starLost)
+       << NV("DroppedFrames", (int) report.droppedFrames)
+       << NV("StaleFrames", (int) report.staleFrames)
+       << NV("Cycles", (int) report.cycles)
+       << NV("SlowCycles", (int) report.slowCycles)
+       << NV("Stages", stages)
+       << NV("EventBytesSent", (double) report.eventBytes, 0)
+       << NV("DroppedEvents", (int) report.droppedEvents)
+       << NV("Memory", report.memory.ToDouble(), 0)
+       << NV("PeakMemory", report.peakMemory.ToDouble(), 0)
+       << NV("CpuTime", cpu);
+
+    do_notify(m_eventServerClients, ev);
+}
+
+void EventServer::NotifyGPHyperparameters(const GPHyperparameterFitInfo& info)
+{
+    if (!any_client_wants(m_eventServerClients, "GaussianProcessOptimized"))
+        return;
+
+    Ev ev("GaussianProcessOptimized");
+    ev << NV("Axis", info.axis)
+       << NV("Converged", info.converged)
+       << NV("Iterations", info.iterations)
+       << NV("Time", info.elapsedMs, 1)
+       << NV("Points", info.points)
+       << NV("NLL", info.nll, 3)
+       << NV("Period", info.period, 2)
+       << NV("PeriodicSD", info.periodicSD, 4)
+       << NV("PeriodicLength", info.periodicLength, 4)
+       << NV("DriftSD", info.driftSD, 4)
+       << NV("DriftLength", info.driftLength, 2)
+       << NV("NoiseSD", info.noiseSD, 4);
+
+    do_notify(m_eventServerClients, ev);
+}
+
 void EventServer::NotifyAlert(const wxString& msg, int type)
 {
-    if (m_eventServerClients.empty())
+    TelemetryFeed.PublishAlert(msg, type);
+
+    if (!any_client_wants(m_eventServerClients, "Alert"))
         return;
 
     Ev ev("Alert");
@@ -2081,7 +5098,7 @@ void EventServer::NotifyAlert(const wxString& msg, int type)
 template<typename T>
 static void NotifyGuidingParam(const EventServer::CliSockSet& clients, const wxString& name, T val)
 {
-    if (clients.empty())
+    if (!any_client_wants(clients, "GuideParamChange"))
         return;
 
     Ev ev("GuideParamChange");
@@ -38,15 +38,37 @@
 #include <set>
 #include "json_parser.h"
 
+struct GuidingPerfReport;
+struct SettleEstimate;
+struct PolarDriftEstimate;
+
+// a background fit of the GP guider's hyperparameters
+struct GPHyperparameterFitInfo
+{
+    wxString axis;
+    bool converged;
+    int iterations;
+    double elapsedMs;
+    int points;
+    double nll;
+    double period;
+    double periodicSD;
+    double periodicLength;
+    double driftSD;
+    double driftLength;
+    double noiseSD;
+};
+
 class EventServer : public wxEvtHandler
 {
 public:
     typedef std::set<wxSocketClient *> CliSockSet;
 
 private:
-    JsonParser m_parser;
     wxSocketServer *m_serverSocket;
+    wxSocketServer *m_wsServerSocket;  // WebSocket endpoint, on port 4700 + instance - 1
     CliSockSet m_eventServerClients;
+    wxTimer *m_relayTimer;             // reconnects to the relayed instances, see /server/relay_instance_count
 
 public:
     EventServer();
@@ -68,21 +90,38 @@ public:
     void NotifyPaused();
     void NotifyResumed();
     void NotifyGuideStep(const GuideStepInfo& info);
+    bool HasImageClients() const;
+    void NotifyFrame(const usImage *img, const PHD_Point& star);
     void NotifyGuidingDithered(double dx, double dy);
     void NotifySetLockPosition(const PHD_Point& xy);
     void NotifyLockPositionLost();
     void NotifyAppState();
-    void NotifySettling(double distance, double time, double settleTime);
+    void NotifySettling(double distance, double time, double settleTime, const SettleEstimate *est = 0);
     void NotifySettleDone(const wxString& errorMsg);
+    void NotifyPolarAlignEstimate(const PolarDriftEstimate& est);
     void NotifyAlert(const wxString& msg, int type);
+    void NotifyDarkBuildComplete(bool darkLibrary, bool success, const wxString& error);
+    void NotifyCameraTestComplete(bool success, const wxString& fileName, const wxString& error);
+    void NotifyPulseProfileComplete(bool success, const wxString& fileName, const wxString& error);
+    void NotifyAOFastLoopStopped(bool success, const wxString& error);
+    void NotifyImageSaved(const wxString& fileName, const wxString& error);
+    void NotifyGuidingPerformance(const GuidingPerfReport& report);
+    void NotifyGPHyperparameters(const GPHyperparameterFitInfo& info);
     void NotifyGuidingParam(const wxString& name, double val);
     void NotifyGuidingParam(const wxString& name, int val);
     void NotifyGuidingParam(const wxString& name, bool val);
     void NotifyGuidingParam(const wxString& name, const wxString& val);
 
+    void DisconnectClient(wxSocketClient *cli);
+    void FindStarDone(int jobId);
+    void GetOutputQueueStats(unsigned int *clients, size_t *queuedBytes, unsigned int *droppedEvents) const;
+    long long BytesSent() const;
+
 private:
     void OnEventServerEvent(wxSocketEvent& evt);
     void OnEventServerClientEvent(wxSocketEvent& evt);
+    void OnRelayEvent(wxSocketEvent& evt);
+    void OnRelayTimer(wxTimerEvent& evt);
 
     wxDECLARE_EVENT_TABLE();
 };
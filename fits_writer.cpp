@@ -0,0 +1,231 @@
+/*
+ *  fits_writer.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+FitsWriter FitsWrite;
+
+enum
+{
+    WRITER_INTERVAL_MS = 1000,
+};
+
+class FitsWriterThread : public wxThread
+{
+    FitsWriter *m_writer;
+    wxSemaphore m_wake;
+    volatile bool m_stop;
+
+public:
+    FitsWriterThread(FitsWriter *writer) : wxThread(wxTHREAD_JOINABLE), m_writer(writer), m_stop(false) { }
+
+    void Wake() { m_wake.Post(); }
+    void Stop() { m_stop = true; m_wake.Post(); }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("fits writer");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "fits writer");
+
+        while (true)
+        {
+            FitsWriter::Job *job = m_writer->Pop();
+            if (job)
+            {
+                m_writer->WriteJob(job);
+                continue;
+            }
+            if (m_stop)
+                break;
+            m_wake.WaitTimeout(WRITER_INTERVAL_MS);
+        }
+        return 0;
+    }
+};
+
+FitsWriter::FitsWriter()
+    : m_queuedBytes(0), m_written(0), m_failed(0), m_refused(0), m_shutdown(false), m_thread(0)
+{
+}
+
+FitsWriter::~FitsWriter()
+{
+    // the thread should have been stopped by Shutdown(); do not wait for it this late
+    for (std::deque<Job *>::iterator it = m_queue.begin(); it != m_queue.end(); ++it)
+        delete *it;
+}
+
+bool FitsWriter::CompressByDefault()
+{
+    return pConfig->Global.GetBoolean("/fits/tile_compression", false);
+}
+
+bool FitsWriter::Save(const usImage& img, const wxString& fileName, const wxString& hdrNote, bool compress, FitsSaveNotify notify)
+{
+    size_t const bytes = img.NPixels * sizeof(unsigned short);
+
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        // one image is always accepted, however large
+        if (!m_queue.empty() && m_queuedBytes + bytes > MAX_QUEUED_BYTES)
+        {
+            ++m_refused;
+            Debug.Write(wxString::Format("FitsWriter: queue full (%u images), not saving %s\n",
+                (unsigned int) m_queue.size(), fileName));
+            return true;
+        }
+    }
+
+    Job *job = new Job();
+    if (job->img.CopyFrom(img))
+    {
+        delete job;
+        return true;
+    }
+    img.GetFitsHeader(&job->hdr, hdrNote);
+    job->fileName = fileName;
+    job->compress = compress;
+    job->notify = notify;
+
+    bool start = false;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        m_queue.push_back(job);
+        m_queuedBytes += bytes;
+        start = !m_thread;
+    }
+
+    if (start)
+    {
+        FitsWriterThread *thread = new FitsWriterThread(this);
+        if (thread->Create() == wxTHREAD_NO_ERROR)
+        {
+            thread->SetPriority(WXTHREAD_MIN_PRIORITY);
+            if (thread->Run() == wxTHREAD_NO_ERROR)
+            {
+                m_thread = thread;
+                return false;
+            }
+        }
+        // no thread, write synchronously
+        delete thread;
+        Debug.AddLine("FitsWriter: could not start writer thread");
+        while (Job *p = Pop())
+            WriteJob(p);
+    }
+    else
+        m_thread->Wake();
+
+    return false;
+}
+
+FitsWriter::Job *FitsWriter::Pop()
+{
+    wxCriticalSectionLocker lck(m_lock);
+
+    if (m_queue.empty())
+        return 0;
+
+    Job *job = m_queue.front();
+    m_queue.pop_front();
+    m_queuedBytes -= job->img.NPixels * sizeof(unsigned short);
+    return job;
+}
+
+void FitsWriter::WriteJob(Job *job)
+{
+    wxStopWatch swatch;
+    bool err = job->img.WriteFits(job->fileName, job->hdr, job->compress);
+
+    Debug.Write(wxString::Format("FitsWriter: %s %s%s in %ld ms\n", err ? "failed to write" : "wrote", job->fileName,
+        job->compress ? " (compressed)" : "", swatch.Time()));
+
+    bool shutdown;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        if (err)
+            ++m_failed;
+        else
+            ++m_written;
+        shutdown = m_shutdown;
+    }
+
+    // the windows and the event server may be gone when writing out the
+    // queue at shutdown
+    if (!shutdown)
+    {
+        wxString error = err ? wxString::Format(_("The image could not be saved to %s"), job->fileName) : wxString();
+        switch (job->notify)
+        {
+        case FITS_NOTIFY_FRAME:
+            pFrame->CallAfter(&MyFrame::OnFitsSaved, job->fileName, error);
+            break;
+        case FITS_NOTIFY_EVENT_SERVER:
+            EvtServer.CallAfter(&EventServer::NotifyImageSaved, job->fileName, error);
+            break;
+        case FITS_NOTIFY_NONE:
+            break;
+        }
+    }
+
+    delete job;
+}
+
+void FitsWriter::Shutdown()
+{
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        m_shutdown = true;
+    }
+
+    if (m_thread)
+    {
+        m_thread->Stop();
+        m_thread->Wait();
+        delete m_thread;
+        m_thread = 0;
+    }
+
+    wxCriticalSectionLocker lck(m_lock);
+    if (m_failed || m_refused)
+        Debug.Write(wxString::Format("FitsWriter: %u images written, %u failed, %u refused\n", m_written, m_failed, m_refused));
+}
+
+void FitsWriter::GetStats(unsigned int *written, unsigned int *failed, unsigned int *refused, unsigned int *queued)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    *written = m_written;
+    *failed = m_failed;
+    *refused = m_refused;
+    *queued = m_queue.size();
+}
@@ -0,0 +1,103 @@
+/*
+ *  fits_writer.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FITS_WRITER_INCLUDED
+#define FITS_WRITER_INCLUDED
+
+#include <deque>
+
+class FitsWriterThread;
+
+// who hears about a queued save when it has been written
+enum FitsSaveNotify
+{
+    FITS_NOTIFY_NONE,
+    FITS_NOTIFY_FRAME,          // status bar message, or an alert if it failed
+    FITS_NOTIFY_EVENT_SERVER,   // ImageSaved event
+};
+
+// Saves images as FITS files on a background thread, optionally with
+// lossless Rice tile compression. The header is captured and the pixels are
+// copied when the save is queued, so the caller can carry on with the image.
+// The queue is bounded by the size of the pixels waiting to be written;
+// a save that does not fit is refused rather than making the caller wait.
+// Completion is reported on the main thread.
+//
+// The dark library and defect map are read back as soon as they are saved
+// and are still written synchronously with usImage::Save.
+class FitsWriter
+{
+public:
+    enum { MAX_QUEUED_BYTES = 64 * 1024 * 1024 };
+
+    struct Job
+    {
+        usImage img;
+        FITSHeader hdr;
+        wxString fileName;
+        bool compress;
+        FitsSaveNotify notify;
+    };
+
+private:
+    wxCriticalSection m_lock;       // protects the queue and the counters
+    std::deque<Job *> m_queue;
+    size_t m_queuedBytes;
+    unsigned int m_written;
+    unsigned int m_failed;
+    unsigned int m_refused;
+    bool m_shutdown;
+    FitsWriterThread *m_thread;
+
+    friend class FitsWriterThread;
+
+    Job *Pop();
+    void WriteJob(Job *job);
+
+public:
+    FitsWriter();
+    ~FitsWriter();
+
+    // global setting /fits/tile_compression, off by default
+    static bool CompressByDefault();
+
+    // queue a copy of img to be written to fileName; returns true if the
+    // queue is full and nothing was queued
+    bool Save(const usImage& img, const wxString& fileName, const wxString& hdrNote, bool compress, FitsSaveNotify notify);
+    void Shutdown();                // write out what is queued and stop the thread
+    void GetStats(unsigned int *written, unsigned int *failed, unsigned int *refused, unsigned int *queued);
+};
+
+extern FitsWriter FitsWrite;
+
+#endif
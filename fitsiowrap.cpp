@@ -120,3 +120,57 @@ void PHD_fits_close_file(fitsfile *fptr)
     int status = 0;
     fits_close_file(fptr, &status);
 }
+
+FITSHeader::Card& FITSHeader::Add(const char *key, int type, const char *comment)
+{
+    m_cards.push_back(Card());
+    Card& card = m_cards.back();
+    card.key = key;
+    card.type = type;
+    card.hasComment = comment != 0;
+    if (comment)
+        card.comment = comment;
+    return card;
+}
+
+void FITSHeader::write(const char *key, float val, const char *comment)
+{
+    Add(key, TFLOAT, comment).fval = val;
+}
+
+void FITSHeader::write(const char *key, unsigned int val, const char *comment)
+{
+    Add(key, TUINT, comment).uval = val;
+}
+
+void FITSHeader::write(const char *key, const char *val, const char *comment)
+{
+    Add(key, TSTRING, comment).sval = val;
+}
+
+void FITSHeader::WriteTo(fitsfile *fptr, int *status) const
+{
+    for (std::vector<Card>::const_iterator it = m_cards.begin(); it != m_cards.end(); ++it)
+    {
+        char *key = const_cast<char *>(it->key.c_str());
+        char *comment = it->hasComment ? const_cast<char *>(it->comment.c_str()) : 0;
+        switch (it->type)
+        {
+        case TFLOAT:
+        {
+            float val = it->fval;
+            fits_write_key(fptr, TFLOAT, key, &val, comment, status);
+            break;
+        }
+        case TUINT:
+        {
+            unsigned int val = it->uval;
+            fits_write_key(fptr, TUINT, key, &val, comment, status);
+            break;
+        }
+        default:
+            fits_write_key(fptr, TSTRING, key, const_cast<char *>(it->sval.c_str()), comment, status);
+            break;
+        }
+    }
+}
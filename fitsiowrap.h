@@ -40,4 +40,35 @@ extern int PHD_fits_open_diskfile(fitsfile **fptr, const wxString& filename, int
 extern int PHD_fits_create_file(fitsfile **fptr, const wxString& filename, bool clobber, int *status);
 extern void PHD_fits_close_file(fitsfile *fptr);
 
+#include <string>
+#include <vector>
+
+// Header keywords collected for a FITS file and written when the file is.
+// Values that come from the equipment are read when a save is requested, on
+// the main thread, and go with the pixels to the thread that writes them.
+class FITSHeader
+{
+    struct Card
+    {
+        std::string key;
+        int type;               // TFLOAT, TUINT or TSTRING
+        float fval;
+        unsigned int uval;
+        std::string sval;
+        std::string comment;
+        bool hasComment;
+    };
+
+    std::vector<Card> m_cards;
+
+    Card& Add(const char *key, int type, const char *comment);
+
+public:
+    void write(const char *key, float val, const char *comment);
+    void write(const char *key, unsigned int val, const char *comment);
+    void write(const char *key, const char *val, const char *comment);
+
+    void WriteTo(fitsfile *fptr, int *status) const;
+};
+
 #endif
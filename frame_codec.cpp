@@ -0,0 +1,449 @@
+/*
+ *  frame_codec.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define HAVE_SSE2_INTRINSICS
+#endif
+
+enum
+{
+    BLOCK_SIZE = 32,
+    PACKED_PADDING = 3,     // bytes after the last block so that it can be read a word at a time
+};
+
+// residual v - pred folded so that small negative and positive values are
+// small: 0, -1, 1, -2, ... map to 0, 1, 2, 3, ...
+inline static unsigned int zigzag(unsigned short v, unsigned short pred)
+{
+    unsigned int const d = (unsigned short)(v - pred);
+    return ((d << 1) ^ (0U - (d >> 15))) & 0xffff;
+}
+
+// little-endian unaligned access, the pixel data is read and written a
+// word at a time
+inline static wxUint32 load32(const unsigned char *p)
+{
+#if wxBYTE_ORDER == wxLITTLE_ENDIAN
+    wxUint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+#else
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((wxUint32) p[3] << 24);
+#endif
+}
+
+inline static void store32(unsigned char *p, wxUint32 v)
+{
+#if wxBYTE_ORDER == wxLITTLE_ENDIAN
+    memcpy(p, &v, sizeof(v));
+#else
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+#endif
+}
+
+inline static unsigned int bit_width(unsigned int v)
+{
+    unsigned int n = 0;
+    while (v)
+    {
+        v >>= 1;
+        ++n;
+    }
+    return n;
+}
+
+// zigzagged prediction residuals of row, the first pixel predicted by pred0
+static void row_residuals(unsigned short *res, const unsigned short *row, int n, unsigned short pred0)
+{
+    int x = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+    if (!ImageMathReference() && n > 8)
+    {
+        res[0] = (unsigned short) zigzag(row[0], pred0);
+        for (x = 1; x + 8 <= n; x += 8)
+        {
+            __m128i cur = _mm_loadu_si128((const __m128i *)(row + x));
+            __m128i prev = _mm_loadu_si128((const __m128i *)(row + x - 1));
+            __m128i d = _mm_sub_epi16(cur, prev);
+            __m128i zz = _mm_xor_si128(_mm_slli_epi16(d, 1), _mm_srai_epi16(d, 15));
+            _mm_storeu_si128((__m128i *)(res + x), zz);
+        }
+    }
+#endif
+
+    for (; x < n; x++)
+        res[x] = (unsigned short) zigzag(row[x], x ? row[x - 1] : pred0);
+}
+
+// OR of the block, for its bit width
+static unsigned int block_or(const unsigned short *res, int n)
+{
+    int i = 0;
+    unsigned int acc = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+    if (!ImageMathReference() && n == BLOCK_SIZE)
+    {
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i *) res), _mm_loadu_si128((const __m128i *)(res + 8))),
+                                 _mm_or_si128(_mm_loadu_si128((const __m128i *)(res + 16)), _mm_loadu_si128((const __m128i *)(res + 24))));
+        v = _mm_or_si128(v, _mm_srli_si128(v, 8));
+        v = _mm_or_si128(v, _mm_srli_si128(v, 4));
+        v = _mm_or_si128(v, _mm_srli_si128(v, 2));
+        return _mm_cvtsi128_si32(v) & 0xffff;
+    }
+#endif
+
+    for (; i < n; i++)
+        acc |= res[i];
+    return acc;
+}
+
+// Packs BLOCK_SIZE values of B bits into 4 * B bytes, and unpacks them
+// into pixels given the pixel before the block. The bit width is a template
+// parameter so the loops unroll with constant shifts.
+template<unsigned int B>
+static unsigned char *pack_block(unsigned char *p, const unsigned short *res)
+{
+    wxUint64 acc = 0;
+    unsigned int bits = 0;
+
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        acc |= (wxUint64) res[i] << bits;
+        bits += B;
+        if (bits >= 32)
+        {
+            store32(p, (wxUint32) acc);
+            p += 4;
+            acc >>= 32;
+            bits -= 32;
+        }
+    }
+    // 32 * B bits is a whole number of words
+    return p;
+}
+
+// each value is within the 32 bit word starting at its first byte
+template<unsigned int B>
+static void unpack_block(unsigned short *res, const unsigned char *p)
+{
+    wxUint32 const mask = (1U << B) - 1;
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        unsigned int const pos = i * B;
+        res[i] = (unsigned short)((load32(p + (pos >> 3)) >> (pos & 7)) & mask);
+    }
+}
+
+template<>
+unsigned char *pack_block<0>(unsigned char *p, const unsigned short *)
+{
+    return p;
+}
+
+template<>
+void unpack_block<0>(unsigned short *res, const unsigned char *)
+{
+    memset(res, 0, BLOCK_SIZE * sizeof(unsigned short));
+}
+
+typedef unsigned char *(*PackFunc)(unsigned char *, const unsigned short *);
+typedef void (*UnpackFunc)(unsigned short *, const unsigned char *);
+
+#define BIT_WIDTHS(F) \
+    F<0>, F<1>, F<2>, F<3>, F<4>, F<5>, F<6>, F<7>, F<8>, \
+    F<9>, F<10>, F<11>, F<12>, F<13>, F<14>, F<15>, F<16>
+
+static const PackFunc s_pack[] = { BIT_WIDTHS(pack_block) };
+static const UnpackFunc s_unpack[] = { BIT_WIDTHS(unpack_block) };
+
+// pixels from n zigzagged residuals, the inverse of row_residuals; returns
+// the last pixel
+static unsigned short undo_residuals(unsigned short *px, const unsigned short *res, int n, unsigned short prev)
+{
+    int i = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+    if (!ImageMathReference())
+    {
+        // a running sum across the lanes in three shift-and-add steps, plus
+        // the last pixel of the previous group in every lane
+        __m128i const one = _mm_set1_epi16(1);
+        __m128i last = _mm_set1_epi16((short) prev);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i zz = _mm_loadu_si128((const __m128i *)(res + i));
+            __m128i d = _mm_xor_si128(_mm_srli_epi16(zz, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(zz, one)));
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+            d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+            d = _mm_add_epi16(d, last);
+            _mm_storeu_si128((__m128i *)(px + i), d);
+            last = _mm_shufflehi_epi16(d, 0xff);
+            last = _mm_unpackhi_epi64(last, last);
+        }
+        if (i > 0)
+            prev = px[i - 1];
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        unsigned int const zz = res[i];
+        prev = (unsigned short)(prev + ((zz >> 1) ^ (0U - (zz & 1))));
+        px[i] = prev;
+    }
+    return prev;
+}
+
+static void encode_packed(const usImage& img, const wxRect& rect, std::vector<unsigned char> *out)
+{
+    int const w = rect.width;
+    int const blocksPerRow = (w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    size_t const maxBytes = (size_t) rect.height * blocksPerRow * (1 + BLOCK_SIZE * 2) + PACKED_PADDING;
+
+    size_t const start = out->size();
+    out->resize(start + maxBytes);
+    unsigned char *p = &(*out)[start];
+
+    // a short last block is padded with zeros
+    std::vector<unsigned short> res(blocksPerRow * BLOCK_SIZE, 0);
+
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        const unsigned short *row = &img.Pixel(rect.x, y);
+        unsigned short const pred0 = y > rect.y ? img.Pixel(rect.x, y - 1) : 0;
+        row_residuals(&res[0], row, w, pred0);
+
+        for (int x = 0; x < w; x += BLOCK_SIZE)
+        {
+            int const n = wxMin((int) BLOCK_SIZE, w - x);
+            unsigned int const b = bit_width(block_or(&res[x], n));
+            *p++ = (unsigned char) b;
+            p = s_pack[b](p, &res[x]);
+        }
+    }
+
+    memset(p, 0, PACKED_PADDING);
+    p += PACKED_PADDING;
+    out->resize(p - &(*out)[0]);
+}
+
+static bool decode_packed(const unsigned char *data, size_t len, const wxRect& rect, usImage *img)
+{
+    if (len < PACKED_PADDING)
+        return true;
+
+    int const w = rect.width;
+    const unsigned char *p = data;
+    const unsigned char *const end = data + len - PACKED_PADDING;
+
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        unsigned short *row = &img->Pixel(rect.x, y);
+        unsigned short prev = y > rect.y ? img->Pixel(rect.x, y - 1) : 0;
+
+        for (int x = 0; x < w; x += BLOCK_SIZE)
+        {
+            if (p >= end)
+                return true;
+            unsigned int const b = *p++;
+            if (b > 16 || (size_t)(end - p) < 4 * b)
+                return true;
+
+            // the padding keeps the words of the last block inside the payload
+            unsigned short res[BLOCK_SIZE];
+            s_unpack[b](res, p);
+            prev = undo_residuals(row + x, res, wxMin((int) BLOCK_SIZE, w - x), prev);
+            p += 4 * b;
+        }
+    }
+
+    return p != end;
+}
+
+static void encode_raw(const usImage& img, const wxRect& rect, std::vector<unsigned char> *out)
+{
+    size_t pos = out->size();
+    out->resize(pos + (size_t) rect.width * rect.height * 2);
+    unsigned char *p = &(*out)[pos];
+
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        const unsigned short *row = &img.Pixel(rect.x, y);
+        for (int x = 0; x < rect.width; x++)
+        {
+            *p++ = (unsigned char)(row[x] & 0xff);
+            *p++ = (unsigned char)(row[x] >> 8);
+        }
+    }
+}
+
+static bool decode_raw(const unsigned char *data, size_t len, const wxRect& rect, usImage *img)
+{
+    if (len != (size_t) rect.width * rect.height * 2)
+        return true;
+
+    const unsigned char *p = data;
+    for (int y = rect.y; y < rect.y + rect.height; y++)
+    {
+        unsigned short *row = &img->Pixel(rect.x, y);
+        for (int x = 0; x < rect.width; x++, p += 2)
+            row[x] = (unsigned short)(p[0] | (p[1] << 8));
+    }
+    return false;
+}
+
+void FrameCodec::EncodePixels(const usImage& img, const wxRect& rect, FrameCodecMethod method, std::vector<unsigned char> *out)
+{
+    if (rect.IsEmpty())
+        return;
+    if (method == FRAME_CODEC_PACKED)
+        encode_packed(img, rect, out);
+    else
+        encode_raw(img, rect, out);
+}
+
+bool FrameCodec::DecodePixels(const unsigned char *data, size_t len, const wxRect& rect, FrameCodecMethod method, usImage *img)
+{
+    if (rect.x < 0 || rect.y < 0 || rect.GetRight() >= img->Size.GetWidth() || rect.GetBottom() >= img->Size.GetHeight())
+        return true;
+    if (rect.IsEmpty())
+        return len != 0;
+
+    switch (method)
+    {
+    case FRAME_CODEC_RAW: return decode_raw(data, len, rect, img);
+    case FRAME_CODEC_PACKED: return decode_packed(data, len, rect, img);
+    }
+    return true;
+}
+
+inline static void put16(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+inline static void put32(unsigned char *p, unsigned int v)
+{
+    put16(p, v & 0xffff);
+    put16(p + 2, v >> 16);
+}
+
+inline static unsigned int get16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+inline static unsigned int get32(const unsigned char *p)
+{
+    return get16(p) | (get16(p + 2) << 16);
+}
+
+void FrameCodec::Encode(const usImage& img, const wxRect& rect_, FrameCodecMethod method, std::vector<unsigned char> *out)
+{
+    wxRect rect = rect_.IsEmpty() ? wxRect(img.Size) : rect_;
+    rect.Intersect(img.DataRect);
+
+    size_t const hdr = out->size();
+    out->resize(hdr + HEADER_SIZE);
+    EncodePixels(img, rect, method, out);
+
+    unsigned char *p = &(*out)[hdr];
+    memset(p, 0, HEADER_SIZE);
+    memcpy(p, "PHDC", 4);
+    put16(p + 4, VERSION);
+    put16(p + 6, HEADER_SIZE);
+    put16(p + 8, img.Size.GetWidth());
+    put16(p + 10, img.Size.GetHeight());
+    put16(p + 12, rect.x);
+    put16(p + 14, rect.y);
+    put16(p + 16, rect.width);
+    put16(p + 18, rect.height);
+    put32(p + 20, (unsigned int) wxMax(img.ImgExpDur, 0));
+    put16(p + 24, wxMin(img.ImgStackCnt, 65535));
+    put16(p + 26, img.Pedestal);
+    p[28] = img.BitsPerPixel;
+    p[29] = (unsigned char) method;
+    double const t = (double) img.ImgStartTime;
+    wxUint64 u;
+    memcpy(&u, &t, sizeof(u));
+    put32(p + 32, (unsigned int)(u & 0xffffffffU));
+    put32(p + 36, (unsigned int)(u >> 32));
+    put32(p + 40, (unsigned int)(out->size() - hdr - HEADER_SIZE));
+}
+
+bool FrameCodec::Decode(const unsigned char *data, size_t len, usImage *img, size_t *used)
+{
+    if (len < HEADER_SIZE || memcmp(data, "PHDC", 4) != 0 || get16(data + 4) != VERSION)
+        return true;
+
+    unsigned int const hdrSize = get16(data + 6);
+    size_t const payload = get32(data + 40);
+    if (hdrSize < HEADER_SIZE || hdrSize > len || payload > len - hdrSize)
+        return true;
+
+    wxSize const size(get16(data + 8), get16(data + 10));
+    wxRect const rect(get16(data + 12), get16(data + 14), get16(data + 16), get16(data + 18));
+
+    // a subframe is held on its own, without the rest of the frame
+    bool const full = rect == wxRect(size);
+    if (full ? img->Init(size) : (img->InitROI(size, rect) || img->DataRect != rect))
+        return true;
+
+    if (DecodePixels(data + hdrSize, payload, rect, (FrameCodecMethod) data[29], img))
+        return true;
+
+    img->Subframe = full ? wxRect() : rect;
+    img->ImgExpDur = (int) get32(data + 20);
+    img->ImgStackCnt = get16(data + 24);
+    img->Pedestal = (unsigned short) get16(data + 26);
+    img->BitsPerPixel = data[28];
+    wxUint64 u = get32(data + 32) | ((wxUint64) get32(data + 36) << 32);
+    double t;
+    memcpy(&t, &u, sizeof(t));
+    img->ImgStartTime = (time_t) t;
+
+    if (used)
+        *used = hdrSize + payload;
+
+    return false;
+}
@@ -0,0 +1,98 @@
+/*
+ *  frame_codec.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FRAME_CODEC_INCLUDED
+#define FRAME_CODEC_INCLUDED
+
+// Lossless coding of 16-bit guide frames, for moving frames between
+// processes and over the network. Guide frames are mostly dark sky, so
+// each pixel is predicted from its left neighbor (the first pixel of a row
+// from the pixel above), and the residuals are bit packed in blocks of 32
+// at the width of the largest residual in the block. Noise-limited frames
+// typically code to 35-50% of their raw size, and both directions run at
+// memory-copy-like rates of over 1 GB/s.
+//
+// A frame is a 48 byte little-endian header followed by the coded pixels:
+//
+//   char[4]  magic "PHDC"
+//   uint16   version (1)
+//   uint16   header size (48)
+//   uint16   full frame width, height
+//   uint16   subframe x, y, width, height (the coded pixels)
+//   uint32   exposure duration, ms
+//   uint16   stack count
+//   uint16   pedestal
+//   uint8    bits per pixel
+//   uint8    method (0 raw, 1 packed)
+//   uint16   reserved
+//   double   image start time, seconds since the epoch
+//   uint32   payload size in bytes
+//   uint32   reserved
+//
+// Raw payloads are rows of 16-bit little-endian pixels. A packed payload
+// codes each row as blocks of 32 residuals, the last block of a row padded
+// with zeros. The residuals are zigzagged (0, -1, 1, -2, ... become
+// 0, 1, 2, 3, ...) and a block is one byte holding the bit width b, 0 to 16,
+// followed by 4 * b bytes: the 32 residuals of b bits each, packed least
+// significant bit first into little-endian 32-bit words. Three zero bytes
+// end the payload.
+
+enum FrameCodecMethod
+{
+    FRAME_CODEC_RAW = 0,
+    FRAME_CODEC_PACKED = 1,
+};
+
+struct FrameCodec
+{
+    enum
+    {
+        VERSION = 1,
+        HEADER_SIZE = 48,
+    };
+
+    // appends the header and the pixels of rect, the whole frame if rect is
+    // empty, to *out
+    static void Encode(const usImage& img, const wxRect& rect, FrameCodecMethod method, std::vector<unsigned char> *out);
+
+    // decodes a frame into *img, allocated at the full frame size with the
+    // coded pixels as its subframe; *used, if given, is set to the frame's
+    // size in bytes. Returns true on error.
+    static bool Decode(const unsigned char *data, size_t len, usImage *img, size_t *used = 0);
+
+    // just the pixels, for streams that have their own header
+    static void EncodePixels(const usImage& img, const wxRect& rect, FrameCodecMethod method, std::vector<unsigned char> *out);
+    static bool DecodePixels(const unsigned char *data, size_t len, const wxRect& rect, FrameCodecMethod method, usImage *img);
+};
+
+#endif
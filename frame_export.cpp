@@ -0,0 +1,239 @@
+/*
+ *  frame_export.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <atomic>
+
+#if defined(__WINDOWS__)
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <errno.h>
+#endif
+
+SharedFrameExport FrameExport;
+
+enum
+{
+    FRAME_EXPORT_VERSION = 1,
+    DEFAULT_SLOT_COUNT = 4,
+    SLOT_ALIGN = 64 * 1024,
+};
+
+struct SharedFrameExport::Mapping
+{
+#if defined(__WINDOWS__)
+    HANDLE handle;
+#else
+    int fd;
+    std::string name;
+#endif
+    void *base;
+    size_t size;
+
+    FrameExportHeader *Header() const { return (FrameExportHeader *) base; }
+    FrameExportSlot *Slot(unsigned int i) const
+    {
+        return (FrameExportSlot *)((char *) base + sizeof(FrameExportHeader) + (size_t) i * Header()->slotSize);
+    }
+};
+
+SharedFrameExport::SharedFrameExport()
+    : m_map(0), m_instance(0), m_published(0), m_failed(false)
+{
+}
+
+SharedFrameExport::~SharedFrameExport()
+{
+    Close();
+}
+
+bool SharedFrameExport::IsEnabled()
+{
+    return pConfig->Global.GetBoolean("/server/frame_export", false);
+}
+
+bool SharedFrameExport::Open(size_t slotSize)
+{
+    unsigned int slots = (unsigned int) wxMax(2, pConfig->Global.GetInt("/server/frame_export_slots", DEFAULT_SLOT_COUNT));
+    size_t size = sizeof(FrameExportHeader) + slots * slotSize;
+    m_instance = pFrame->GetInstanceNumber();
+
+    Mapping *map = new Mapping();
+    map->size = size;
+
+#if defined(__WINDOWS__)
+    wxString name = wxString::Format("Local\\PHD2Frames%u", m_instance);
+    map->handle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)((unsigned long long) size >> 32), (DWORD)(size & 0xffffffff), name.wc_str());
+    if (!map->handle)
+    {
+        Debug.Write(wxString::Format("frame export: CreateFileMapping failed, err %lu\n", GetLastError()));
+        delete map;
+        return true;
+    }
+    map->base = MapViewOfFile(map->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!map->base)
+    {
+        Debug.Write(wxString::Format("frame export: MapViewOfFile failed, err %lu\n", GetLastError()));
+        CloseHandle(map->handle);
+        delete map;
+        return true;
+    }
+#else
+    wxString name = wxString::Format("/PHD2Frames%u", m_instance);
+    map->name = std::string(name.mb_str());
+    shm_unlink(map->name.c_str());  // discard any stale mapping from an earlier run
+    map->fd = shm_open(map->name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (map->fd == -1 || ftruncate(map->fd, size) != 0)
+    {
+        Debug.Write(wxString::Format("frame export: shm_open %s failed, errno %d\n", name, errno));
+        if (map->fd != -1)
+        {
+            close(map->fd);
+            shm_unlink(map->name.c_str());
+        }
+        delete map;
+        return true;
+    }
+    map->base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+    if (map->base == MAP_FAILED)
+    {
+        Debug.Write(wxString::Format("frame export: mmap failed, errno %d\n", errno));
+        close(map->fd);
+        shm_unlink(map->name.c_str());
+        delete map;
+        return true;
+    }
+#endif
+
+    memset(map->base, 0, size);
+    FrameExportHeader *hdr = map->Header();
+    memcpy(hdr->magic, "PHD2FRM", 8);
+    hdr->version = FRAME_EXPORT_VERSION;
+    hdr->headerSize = sizeof(FrameExportHeader);
+    hdr->slotCount = slots;
+    hdr->slotSize = (unsigned int) slotSize;
+
+    m_map = map;
+    m_published = 0;
+
+    Debug.Write(wxString::Format("frame export: opened %s, %u slots of %u bytes\n", name, slots, (unsigned int) slotSize));
+
+    return false;
+}
+
+void SharedFrameExport::Close()
+{
+    m_failed = false;
+
+    if (!m_map)
+        return;
+
+    m_map->Header()->stale = 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+#if defined(__WINDOWS__)
+    UnmapViewOfFile(m_map->base);
+    CloseHandle(m_map->handle);
+#else
+    munmap(m_map->base, m_map->size);
+    close(m_map->fd);
+    shm_unlink(m_map->name.c_str());
+#endif
+
+    delete m_map;
+    m_map = 0;
+
+    Debug.AddLine("frame export: closed");
+}
+
+void SharedFrameExport::Publish(const usImage *img, unsigned int frameNumber, const PHD_Point& star)
+{
+    if (!img || !img->ImageData || m_failed)
+        return;
+
+    // the slot always holds the full frame
+    usImage scratch;
+    const usImage *full = img->FullFrame(&scratch);
+    if (!full)
+        return;
+
+    size_t dataSize = (size_t) full->NPixels * sizeof(unsigned short);
+    size_t need = sizeof(FrameExportSlot) + dataSize;
+
+    if (m_map && need > m_map->Header()->slotSize)
+        Close();
+
+    if (!m_map)
+    {
+        size_t slotSize = (need + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+        if (Open(slotSize))
+        {
+            m_failed = true;
+            return;
+        }
+    }
+
+    FrameExportHeader *hdr = m_map->Header();
+    unsigned int const k = ++m_published;
+    FrameExportSlot *slot = m_map->Slot((k - 1) % hdr->slotCount);
+
+    slot->seq = 2 * k - 1;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frameNumber = frameNumber;
+    slot->exposureMs = img->ImgExpDur;
+    slot->timestamp = (double) img->ImgStartTime;
+    slot->width = img->Size.GetWidth();
+    slot->height = img->Size.GetHeight();
+    slot->subX = img->Subframe.x;
+    slot->subY = img->Subframe.y;
+    slot->subW = img->Subframe.width;
+    slot->subH = img->Subframe.height;
+    slot->starX = star.IsValid() ? star.X : -1.0;
+    slot->starY = star.IsValid() ? star.Y : -1.0;
+    slot->pedestal = img->Pedestal;
+    slot->bitsPerPixel = img->BitsPerPixel;
+    slot->dataSize = (unsigned int) dataSize;
+    memcpy(slot + 1, full->ImageData, dataSize);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->seq = 2 * k;
+    hdr->latest = 2 * k;
+}
@@ -0,0 +1,110 @@
+/*
+ *  frame_export.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef FRAME_EXPORT_INCLUDED
+#define FRAME_EXPORT_INCLUDED
+
+// Optional export of recent guide frames through shared memory, for imaging and
+// plate-solving software on the same machine. Enabled by the global setting
+// /server/frame_export.
+//
+// The mapping is named "PHD2Frames<instance>" ("Local\PHD2Frames<n>" on Windows,
+// "/PHD2Frames<n>" with shm_open elsewhere) and holds a FrameExportHeader
+// followed by slotCount slots of slotSize bytes. Each slot is a FrameExportSlot
+// followed by the pixels, 16-bit native byte order, row-major, Size.x wide.
+//
+// Each slot is guarded by a sequence number: odd while the slot is being written,
+// and the frame's publication number (always even) when complete. A reader
+// takes a slot's seq, reads the frame, then checks seq is unchanged. The
+// header's latest field is the seq of the most recently completed frame
+// (slot = (latest / 2 - 1) % slotCount). If the frame size grows beyond the
+// slot size the mapping is recreated; the old one is marked stale first, so
+// readers should check stale and remap.
+
+#pragma pack(push, 4)
+
+struct FrameExportHeader
+{
+    char magic[8];              // "PHD2FRM"
+    unsigned int version;       // 1
+    unsigned int headerSize;    // sizeof(FrameExportHeader)
+    unsigned int slotCount;
+    unsigned int slotSize;      // bytes per slot, including the slot header
+    volatile unsigned int stale;
+    unsigned int reserved;
+    volatile unsigned int latest;
+    unsigned int reserved2;
+};
+
+struct FrameExportSlot
+{
+    volatile unsigned int seq;      // 32 bits so that updates are atomic on every platform
+    unsigned int frameNumber;
+    unsigned int exposureMs;
+    double timestamp;           // exposure start, seconds since the epoch
+    int width, height;          // full image dimensions
+    int subX, subY, subW, subH; // valid subframe, all zero for a full frame
+    double starX, starY;        // guide star, full frame coordinates; -1 if none
+    unsigned int pedestal;
+    unsigned int bitsPerPixel;
+    unsigned int dataSize;      // bytes of pixel data following the slot header
+    unsigned int reserved;
+};
+
+#pragma pack(pop)
+
+class SharedFrameExport
+{
+    struct Mapping;
+    Mapping *m_map;
+    unsigned int m_instance;
+    unsigned int m_published;
+    bool m_failed;
+
+public:
+    SharedFrameExport();
+    ~SharedFrameExport();
+
+    static bool IsEnabled();
+
+    void Publish(const usImage *img, unsigned int frameNumber, const PHD_Point& star);
+    void Close();
+
+private:
+    bool Open(size_t slotSize);     // true on error
+};
+
+extern SharedFrameExport FrameExport;
+
+#endif
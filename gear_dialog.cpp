@@ -82,8 +82,87 @@ BEGIN_EVENT_TABLE(GearDialog, wxDialog)
     EVT_TOGGLEBUTTON(GEAR_BUTTON_DISCONNECT_ROTATOR, GearDialog::OnButtonDisconnectRotator)
 
     EVT_CHAR_HOOK(GearDialog::OnChar)
+    EVT_THREAD(DEVICE_LIST_READY_EVENT, GearDialog::OnDeviceListReady)
 END_EVENT_TABLE()
 
+// Connect All runs the connect of each device that can connect off the main
+// thread, and does not need other gear connected first, on a thread of its
+// own, so that the slow driver connects overlap. The main thread goes through
+// the devices in the usual order and picks up each result when it gets there.
+// connects, or at shutdown disconnects, one device off the main thread
+class GearConnectThread : public wxThread
+{
+    GuideCamera *m_camera;
+    wxString m_cameraId;
+    Mount *m_mount;
+    Rotator *m_rotator;
+    bool m_disconnect;
+
+public:
+    volatile bool done;
+    bool err;
+    long elapsedMs;
+
+    GearConnectThread(GuideCamera *camera, const wxString& cameraId, Mount *mount, Rotator *rotator, bool disconnect = false)
+        : wxThread(wxTHREAD_JOINABLE), m_camera(camera), m_cameraId(cameraId), m_mount(mount), m_rotator(rotator),
+        m_disconnect(disconnect), done(false), err(true), elapsedMs(0) { }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName(m_disconnect ? "gear disconnect" : "gear connect");
+
+#if defined(__WINDOWS__)
+        HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+        Debug.Write(wxString::Format("gear connect thread CoInitializeEx returns %x\n", hr));
+#endif
+
+        wxStopWatch swatch;
+
+        if (m_disconnect)
+        {
+            if (m_camera)
+                err = m_camera->Disconnect();
+            else if (m_mount)
+                err = m_mount->Disconnect();
+            else if (m_rotator)
+                err = m_rotator->Disconnect();
+        }
+        else if (m_camera)
+            err = m_camera->Connect(m_cameraId);
+        else if (m_mount)
+            err = m_mount->Connect();
+        else if (m_rotator)
+            err = m_rotator->Connect();
+
+        elapsedMs = swatch.Time();
+
+#if defined(__WINDOWS__)
+        CoUninitialize();
+#endif
+
+        done = true;
+        return 0;
+    }
+};
+
+static wxString GearName(DeviceListKind kind)
+{
+    switch (kind) {
+    case DEVICES_CAMERA:    return _("Camera");
+    case DEVICES_MOUNT:     return _("Mount");
+    case DEVICES_AUX_MOUNT: return _("Aux Mount");
+    case DEVICES_AO:        return _("AO");
+    case DEVICES_ROTATOR:   return _("Rotator");
+    default:                return wxEmptyString;
+    }
+}
+
+static bool ConnectsInBackground(Scope *scope)
+{
+    return scope && !scope->IsConnected() && scope->CanConnectInBackground() &&
+        !scope->RequiresCamera() && !scope->RequiresStepGuider();
+}
+
 /*
  * The Gear Dialog allows the user to select and connect to their hardware.
  *
@@ -130,6 +209,12 @@ GearDialog::GearDialog(wxWindow *pParent) :
     m_pStepGuider = NULL;
     m_pRotator = NULL;
 
+    for (int i = 0; i < NUM_DEVICE_LISTS; i++)
+    {
+        m_connectThread[i] = NULL;
+        m_abandoned[i] = false;
+    }
+
     m_pCameras             = NULL;
     m_pScopes              = NULL;
     m_pAuxScopes           = NULL;
@@ -156,13 +241,30 @@ GearDialog::GearDialog(wxWindow *pParent) :
 
 GearDialog::~GearDialog(void)
 {
-    delete m_pCamera;
-    delete m_pScope;
-    if (m_pAuxScope != m_pScope)
+    WaitForBackgroundConnects();
+    DeviceLists::Shutdown();
+    PointingCache::Stop();
+
+    // the UI is gone by now, so the dark library is freed on a thread of its
+    // own while the exit goes on
+    if (m_pCamera && !m_abandoned[DEVICES_CAMERA])
+    {
+        std::vector<usImage *> darks;
+        m_pCamera->DetachDarks(&darks);
+        ImageRelease::Start(darks);
+    }
+
+    if (!m_abandoned[DEVICES_CAMERA])
+        delete m_pCamera;
+    if (!m_abandoned[DEVICES_MOUNT])
+        delete m_pScope;
+    if (m_pAuxScope != m_pScope && !m_abandoned[DEVICES_AUX_MOUNT])
         delete m_pAuxScope;
 
-    delete m_pStepGuider;
-    delete m_pRotator;
+    if (!m_abandoned[DEVICES_AO])
+        delete m_pStepGuider;
+    if (!m_abandoned[DEVICES_ROTATOR])
+        delete m_pRotator;
 
     // prevent double frees
     pCamera         = NULL;
@@ -183,6 +285,10 @@ void GearDialog::Initialize(void)
 
     wxBoxSizer *pTopLevelSizer = new wxBoxSizer(wxVERTICAL);
 
+    // the choices start with whatever lists we have and are filled in as
+    // the enumerations finish
+    DeviceLists::Refresh(this);
+
     wxBoxSizer *profilesSizer = new wxBoxSizer(wxHORIZONTAL);
     profilesSizer->Add(new wxStaticText(this, wxID_ANY, _("Equipment profile")), sizerLabelFlags);
     m_profiles = new wxChoice(this, GEAR_PROFILES, wxDefaultPosition, wxDefaultSize, pConfig->ProfileNames());
@@ -224,7 +330,7 @@ void GearDialog::Initialize(void)
     // Camera
     m_gearSizer->Add(new wxStaticText(this, wxID_ANY, _("Camera"), wxDefaultPosition, wxDefaultSize), wxGBPosition(0, 0), wxGBSpan(1, 1), wxALL | wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL, 5);
     m_pCameras = new wxChoice(this, GEAR_CHOICE_CAMERA, wxDefaultPosition, wxDefaultSize,
-                              GuideCamera::List(), 0, wxDefaultValidator, _("Camera"));
+                              InitialList(DEVICES_CAMERA), 0, wxDefaultValidator, _("Camera"));
     m_gearSizer->Add(m_pCameras, wxGBPosition(0, 1), wxGBSpan(1, 1), wxALL | wxEXPAND | wxALIGN_CENTER_VERTICAL, 5);
 
 #   include "icons/select.png.h"
@@ -250,7 +356,7 @@ void GearDialog::Initialize(void)
     // mount
     m_gearSizer->Add(new wxStaticText(this, wxID_ANY, _("Mount"), wxDefaultPosition, wxDefaultSize), wxGBPosition(1, 0), wxGBSpan(1, 1), wxALL | wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL, 5);
     m_pScopes = new wxChoice(this, GEAR_CHOICE_SCOPE, wxDefaultPosition, wxDefaultSize,
-                             Scope::List(), 0, wxDefaultValidator, _("Mount"));
+                             InitialList(DEVICES_MOUNT), 0, wxDefaultValidator, _("Mount"));
     m_gearSizer->Add(m_pScopes, wxGBPosition(1, 1), wxGBSpan(1, 1), wxALL | wxEXPAND | wxALIGN_CENTER_VERTICAL, 5);
     m_pSetupScopeButton = new wxBitmapButton(this, GEAR_BUTTON_SETUP_SCOPE, setup_bmp);
     m_pSetupScopeButton->SetToolTip(_("Mount Setup"));
@@ -263,7 +369,7 @@ void GearDialog::Initialize(void)
     // aux mount - used for position/state information when not guiding through ASCOM interface
     m_gearSizer->Add(new wxStaticText(this, wxID_ANY, _("Aux Mount"), wxDefaultPosition, wxDefaultSize), wxGBPosition(2, 0), wxGBSpan(1, 1), wxALL | wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL, 5);
     m_pAuxScopes = new wxChoice(this, GEAR_CHOICE_AUXSCOPE, wxDefaultPosition, wxDefaultSize,
-        Scope::AuxMountList(), 0, wxDefaultValidator, _("Aux Mount"));
+        InitialList(DEVICES_AUX_MOUNT), 0, wxDefaultValidator, _("Aux Mount"));
 
 #if defined(GUIDE_ASCOM) || defined(GUIDE_INDI)
 #ifdef GUIDE_ASCOM
@@ -291,7 +397,7 @@ void GearDialog::Initialize(void)
     // ao
     m_gearSizer->Add(new wxStaticText(this, wxID_ANY, _("AO"), wxDefaultPosition, wxDefaultSize), wxGBPosition(4, 0), wxGBSpan(1, 1), wxALL | wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL, 5);
     m_pStepGuiders = new wxChoice(this, GEAR_CHOICE_STEPGUIDER, wxDefaultPosition, wxDefaultSize,
-                                  StepGuider::List(), 0, wxDefaultValidator, _("AO"));
+                                  InitialList(DEVICES_AO), 0, wxDefaultValidator, _("AO"));
     m_gearSizer->Add(m_pStepGuiders, wxGBPosition(4, 1), wxGBSpan(1, 1), wxALL | wxEXPAND | wxALIGN_CENTER_VERTICAL, 5);
     m_pSetupStepGuiderButton = new wxBitmapButton(this, GEAR_BUTTON_SETUP_STEPGUIDER, setup_bmp);
     m_pSetupStepGuiderButton->SetToolTip(_("AO Setup"));
@@ -303,7 +409,7 @@ void GearDialog::Initialize(void)
 
     // rotator
     m_gearSizer->Add(new wxStaticText(this, wxID_ANY, _("Rotator"), wxDefaultPosition, wxDefaultSize), wxGBPosition(5, 0), wxGBSpan(1, 1), wxALL | wxALIGN_RIGHT | wxALIGN_CENTER_VERTICAL, 5);
-    m_pRotators = new wxChoice(this, GEAR_CHOICE_ROTATOR, wxDefaultPosition, wxDefaultSize, Rotator::List(), 0, wxDefaultValidator, _("Rotator"));
+    m_pRotators = new wxChoice(this, GEAR_CHOICE_ROTATOR, wxDefaultPosition, wxDefaultSize, InitialList(DEVICES_ROTATOR), 0, wxDefaultValidator, _("Rotator"));
     m_gearSizer->Add(m_pRotators, wxGBPosition(5, 1), wxGBSpan(1, 1), wxALL | wxEXPAND | wxALIGN_CENTER_VERTICAL, 5);
     m_pSetupRotatorButton = new wxBitmapButton(this, GEAR_BUTTON_SETUP_ROTATOR, setup_bmp);
     m_pSetupRotatorButton->SetToolTip(_("Rotator Setup"));
@@ -341,28 +447,129 @@ void GearDialog::Initialize(void)
     UpdateAdvancedDialog(false);
 }
 
-void GearDialog::LoadGearChoices(void)
+wxArrayString GearDialog::InitialList(DeviceListKind kind)
+{
+    wxArrayString list;
+    m_listPending[kind] = !DeviceLists::Get(kind, &list);
+    if (m_listPending[kind])
+        list.Add(_("None"));
+    return list;
+}
+
+void GearDialog::SelectChoice(wxChoice *choice, DeviceListKind kind, const wxString& sel)
+{
+    if (!choice->SetStringSelection(sel) && m_listPending[kind] && !sel.IsEmpty())
+    {
+        // keep the profile's choice until the list arrives and we can tell if it is still there
+        choice->Append(sel);
+        choice->SetStringSelection(sel);
+    }
+}
+
+void GearDialog::OnDeviceListReady(wxThreadEvent& event)
+{
+    DeviceListKind kind = (DeviceListKind) event.GetInt();
+
+    wxArrayString list;
+    if (!DeviceLists::Get(kind, &list))
+        return;
+
+    wxChoice *choice;
+    bool connected;
+    void (GearDialog::*onChoice)(wxCommandEvent&);
+
+    switch (kind) {
+    case DEVICES_CAMERA:
+        choice = m_pCameras;
+        connected = m_pCamera && m_pCamera->Connected;
+        onChoice = &GearDialog::OnChoiceCamera;
+        break;
+    case DEVICES_MOUNT:
+        choice = m_pScopes;
+        connected = m_pScope && m_pScope->IsConnected();
+        onChoice = &GearDialog::OnChoiceScope;
+        break;
+    case DEVICES_AUX_MOUNT:
+        choice = m_pAuxScopes;
+        connected = m_pAuxScope && m_pAuxScope->IsConnected();
+        onChoice = &GearDialog::OnChoiceAuxScope;
+        break;
+    case DEVICES_AO:
+        choice = m_pStepGuiders;
+        connected = m_pStepGuider && m_pStepGuider->IsConnected();
+        onChoice = &GearDialog::OnChoiceStepGuider;
+        break;
+    case DEVICES_ROTATOR:
+        choice = m_pRotators;
+        connected = m_pRotator && m_pRotator->IsConnected();
+        onChoice = &GearDialog::OnChoiceRotator;
+        break;
+    default:
+        return;
+    }
+
+    m_listPending[kind] = false;
+
+    if (choice->GetStrings() == list)
+        return;
+
+    Debug.Write(wxString::Format("GearDialog: device list %d updated, %u entries\n", kind, (unsigned int) list.size()));
+
+    wxString sel = choice->GetStringSelection();
+    choice->Set(list);
+
+    if (!sel.IsEmpty() && !choice->SetStringSelection(sel))
+    {
+        if (connected)
+        {
+            // still in use, leave it until it is disconnected
+            choice->Append(sel);
+            choice->SetStringSelection(sel);
+        }
+        else
+        {
+            // the device is gone, as if the profile had been loaded without it
+            wxCommandEvent dummyEvent;
+            (this->*onChoice)(dummyEvent);
+        }
+    }
+
+    if (IsShown())
+    {
+        UpdateButtonState();
+        GetSizer()->Fit(this);
+    }
+}
+
+// With keepConnected, devices that are connected are left in place; the
+// caller has checked that the profile selects the same devices for them
+void GearDialog::LoadGearChoices(bool keepConnected)
 {
     wxCommandEvent dummyEvent;
     m_lastCamera = pConfig->Profile.GetString("/camera/LastMenuchoice", _("None"));
-    m_pCameras->SetStringSelection(m_lastCamera);
-    OnChoiceCamera(dummyEvent);
+    SelectChoice(m_pCameras, DEVICES_CAMERA, m_lastCamera);
+    if (!keepConnected || !m_pCamera || !m_pCamera->Connected)
+        OnChoiceCamera(dummyEvent);
 
     wxString lastScope = pConfig->Profile.GetString("/scope/LastMenuChoice", _("None"));
-    m_pScopes->SetStringSelection(lastScope);
-    OnChoiceScope(dummyEvent);
+    SelectChoice(m_pScopes, DEVICES_MOUNT, lastScope);
+    if (!keepConnected || !m_pScope || !m_pScope->IsConnected())
+        OnChoiceScope(dummyEvent);
 
     wxString lastAuxScope = pConfig->Profile.GetString("/scope/LastAuxMenuChoice", _("None"));
-    m_pAuxScopes->SetStringSelection(lastAuxScope);
-    OnChoiceAuxScope(dummyEvent);
+    SelectChoice(m_pAuxScopes, DEVICES_AUX_MOUNT, lastAuxScope);
+    if (!keepConnected || !m_pAuxScope || !m_pAuxScope->IsConnected())
+        OnChoiceAuxScope(dummyEvent);
 
     wxString lastStepGuider = pConfig->Profile.GetString("/stepguider/LastMenuChoice", _("None"));
-    m_pStepGuiders->SetStringSelection(lastStepGuider);
-    OnChoiceStepGuider(dummyEvent);
+    SelectChoice(m_pStepGuiders, DEVICES_AO, lastStepGuider);
+    if (!keepConnected || !m_pStepGuider || !m_pStepGuider->IsConnected())
+        OnChoiceStepGuider(dummyEvent);
 
     wxString lastRotator = pConfig->Profile.GetString("/rotator/LastMenuChoice", _("None"));
-    m_pRotators->SetStringSelection(lastRotator);
-    OnChoiceRotator(dummyEvent);
+    SelectChoice(m_pRotators, DEVICES_ROTATOR, lastRotator);
+    if (!keepConnected || !m_pRotator || !m_pRotator->IsConnected())
+        OnChoiceRotator(dummyEvent);
 
 }
 
@@ -403,6 +610,9 @@ int GearDialog::ShowGearDialog(bool autoConnect)
 
     if (callSuper)
     {
+        // pick up drivers installed or devices plugged in since the lists were made
+        DeviceLists::Refresh(this);
+
         UpdateButtonState();
 
         GetSizer()->Fit(this);
@@ -580,7 +790,10 @@ void GearDialog::UpdateAuxScopeButtonState(void)
         m_pConnectAuxScopeButton->Enable(false);
 
         if (m_pAuxScope && m_pAuxScope != m_pScope)
+        {
+            PointingCache::Stop();
             delete m_pAuxScope;
+        }
         m_pAuxScope = NULL;
     }
     else
@@ -747,11 +960,117 @@ void GearDialog::UpdateButtonState(void)
     UpdateDisconnectAllButtonState();
 }
 
+static wxString SelectedCameraId(const GuideCamera *camera);
+
+void GearDialog::StartBackgroundConnect(DeviceListKind kind, GearConnectThread *thread)
+{
+    if (m_connectThread[kind] ||
+        thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        // it will be connected on the main thread
+        delete thread;
+        return;
+    }
+
+    Debug.Write(wxString::Format("GearDialog: connecting %s in the background\n", GearName(kind)));
+    m_connectThread[kind] = thread;
+}
+
+void GearDialog::StartBackgroundConnects(void)
+{
+    if (m_pCamera && !m_pCamera->Connected && m_pCamera->CanConnectInBackground())
+        StartBackgroundConnect(DEVICES_CAMERA, new GearConnectThread(m_pCamera, SelectedCameraId(m_pCamera), NULL, NULL));
+
+    if (m_pStepGuider && !m_pStepGuider->IsConnected() && m_pStepGuider->CanConnectInBackground())
+        StartBackgroundConnect(DEVICES_AO, new GearConnectThread(NULL, wxEmptyString, m_pStepGuider, NULL));
+
+    if (ConnectsInBackground(m_pScope))
+        StartBackgroundConnect(DEVICES_MOUNT, new GearConnectThread(NULL, wxEmptyString, m_pScope, NULL));
+
+    if (m_pAuxScope != m_pScope && ConnectsInBackground(m_pAuxScope))
+        StartBackgroundConnect(DEVICES_AUX_MOUNT, new GearConnectThread(NULL, wxEmptyString, m_pAuxScope, NULL));
+
+    if (m_pRotator && !m_pRotator->IsConnected() && m_pRotator->CanConnectInBackground())
+        StartBackgroundConnect(DEVICES_ROTATOR, new GearConnectThread(NULL, wxEmptyString, NULL, m_pRotator));
+}
+
+// Waits for the background connect of the device, if there is one, and
+// returns true with its result in err; returns false if there is none and
+// the device should be connected here
+bool GearDialog::FinishBackgroundConnect(DeviceListKind kind, bool *err)
+{
+    GearConnectThread *thread = m_connectThread[kind];
+    if (!thread)
+        return false;
+
+    if (!thread->done)
+    {
+        wxBusyCursor busy;
+#ifndef __APPLE__
+        // this makes the progress window inaccessible on OSX
+        wxWindowDisabler wd;
+#endif // __APPLE__
+
+        // the drivers may need the main thread, for message boxes and alerts
+        wxString shown;
+        while (!thread->done)
+        {
+            wxString pending;
+            for (int i = 0; i < NUM_DEVICE_LISTS; i++)
+            {
+                if (m_connectThread[i] && !m_connectThread[i]->done)
+                {
+                    if (!pending.IsEmpty())
+                        pending += ", ";
+                    pending += GearName((DeviceListKind) i);
+                }
+            }
+            if (pending != shown)
+            {
+                pFrame->StatusMsgNoTimeout(wxString::Format(_("Connecting to %s ..."), pending));
+                shown = pending;
+            }
+
+            wxYield();
+            wxMilliSleep(20);
+        }
+    }
+
+    thread->Wait();
+    *err = thread->err;
+
+    Debug.Write(wxString::Format("GearDialog: %s background connect %s after %ld ms\n", GearName(kind),
+        thread->err ? "failed" : "completed", thread->elapsedMs));
+
+    delete thread;
+    m_connectThread[kind] = NULL;
+
+    return true;
+}
+
+void GearDialog::WaitForBackgroundConnects(void)
+{
+    for (int i = 0; i < NUM_DEVICE_LISTS; i++)
+    {
+        bool err;
+        FinishBackgroundConnect((DeviceListKind) i, &err);
+    }
+}
+
 void GearDialog::OnButtonConnectAll(wxCommandEvent& event)
 {
+    // settle a camera change before anything starts connecting
+    if (m_pCamera && !m_pCamera->Connected && CameraChangeCanceled())
+        return;
+
+    StartBackgroundConnects();
+
     bool canceled = DoConnectCamera();
     if (canceled)
+    {
+        WaitForBackgroundConnects();
         return;
+    }
     OnButtonConnectStepGuider(event);
     OnButtonConnectScope(event);
     OnButtonConnectAuxScope(event);
@@ -918,54 +1237,70 @@ void GearDialog::OnButtonSetupCamera(wxCommandEvent& event)
     m_pCamera->ShowPropertyDialog();
 }
 
+// Warns about changing the camera in a profile that has darks or a defect
+// map; returns true, and puts back the previous camera, if the user cancels
+bool GearDialog::CameraChangeCanceled(void)
+{
+    wxString newCam = m_pCameras->GetStringSelection();
+    if (!m_camWarningIssued && m_lastCamera != _("None") && newCam != _("None") && m_lastCamera != newCam)
+    {
+        int currProfileId = pConfig->GetCurrentProfileId();
+        wxString darkName = MyFrame::DarkLibFileName(currProfileId);
+        wxString bpmName = DefectMap::DefectMapFileName(currProfileId);
+
+        // Can't use standard checks because we don't want to consider sensor-size
+        if (wxFileExists(darkName) || wxFileExists(bpmName))
+        {
+            wxString msg = _("By changing cameras in this profile, you won't be able to use the existing dark library or bad-pixel maps. You should consider"
+                " creating a new profile for this set-up.  Do you want to proceed with changes to this profile?");
+            if (wxMessageBox(msg, _("Camera Change Warning"), wxYES_NO, this) == wxYES)
+            {
+                m_camWarningIssued = true;
+                m_lastCamera = newCam;          // make consistent with what's in the UI
+            }
+            else
+            {
+                m_pCameras->SetStringSelection(m_lastCamera);
+                wxCommandEvent dummy;
+                OnChoiceCamera(dummy);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 bool GearDialog::DoConnectCamera(void)
 {
     bool canceled = false;
 
     try
     {
+        bool bgErr;
+        bool inBg = FinishBackgroundConnect(DEVICES_CAMERA, &bgErr);
+
         if (m_pCamera == NULL)
         {
             throw ERROR_INFO("DoConnectCamera called with m_pCamera == NULL");
         }
 
-        if (m_pCamera->Connected)
+        if (!inBg && m_pCamera->Connected)
         {
             throw THROW_INFO("DoConnectCamera: called when connected");
         }
 
-        wxString newCam = m_pCameras->GetStringSelection();
-        if (!m_camWarningIssued && m_lastCamera != _("None") && newCam != _("None") && m_lastCamera != newCam)
+        if (!inBg && CameraChangeCanceled())
         {
-            int currProfileId = pConfig->GetCurrentProfileId();
-            wxString darkName = MyFrame::DarkLibFileName(currProfileId);
-            wxString bpmName = DefectMap::DefectMapFileName(currProfileId);
-
-            // Can't use standard checks because we don't want to consider sensor-size
-            if (wxFileExists(darkName) || wxFileExists(bpmName))
-            {
-                wxString msg = _("By changing cameras in this profile, you won't be able to use the existing dark library or bad-pixel maps. You should consider"
-                    " creating a new profile for this set-up.  Do you want to proceed with changes to this profile?");
-                if (wxMessageBox(msg, _("Camera Change Warning"), wxYES_NO, this) == wxYES)
-                {
-                    m_camWarningIssued = true;
-                    m_lastCamera = newCam;          // make consistent with what's in the UI
-                }
-                else
-                {
-                    m_pCameras->SetStringSelection(m_lastCamera);
-                    wxCommandEvent dummy;
-                    OnChoiceCamera(dummy);
-                    canceled = true;
-                    throw THROW_INFO("DoConnectCamera: user cancelled after camera-change warning");
-                }
-            }
+            canceled = true;
+            throw THROW_INFO("DoConnectCamera: user cancelled after camera-change warning");
         }
+
         pFrame->StatusMsgNoTimeout(_("Connecting to Camera ..."));
 
         wxString cameraId = SelectedCameraId(m_pCamera);
         Debug.Write(wxString::Format("Connecting to camera id = [%s]\n", cameraId));
-        if (m_pCamera->Connect(cameraId))
+        if (inBg ? bgErr : m_pCamera->Connect(cameraId))
         {
             throw THROW_INFO("DoConnectCamera: connect failed");
         }
@@ -1032,6 +1367,38 @@ bool GearDialog::ReconnectCamera()
     return err;
 }
 
+// Reconnects the camera after the capture watchdog dropped it. The darks and
+// defect map are kept, there is no camera-change check, and cameras that can
+// connect in the background do so while the main thread keeps handling
+// events.
+bool GearDialog::QuickReconnectCamera()
+{
+    if (!m_pCamera)
+        return true;
+
+    if (m_pCamera->Connected)
+        return false;
+
+    wxString cameraId = SelectedCameraId(m_pCamera);
+    Debug.Write(wxString::Format("Quick reconnect to camera id = [%s]\n", cameraId));
+
+    bool err;
+    if (m_pCamera->CanConnectInBackground())
+        StartBackgroundConnect(DEVICES_CAMERA, new GearConnectThread(m_pCamera, cameraId, NULL, NULL));
+    if (!FinishBackgroundConnect(DEVICES_CAMERA, &err))
+        err = m_pCamera->Connect(cameraId);
+
+    if (!err)
+    {
+        pFrame->StatusMsg(_("Camera Connected"));
+        pFrame->UpdateStateLabels();
+    }
+
+    UpdateButtonState();
+
+    return err;
+}
+
 void GearDialog::OnButtonDisconnectCamera(wxCommandEvent& event)
 {
     try
@@ -1082,6 +1449,7 @@ void GearDialog::UpdateGearPointers(void)
 
     pPointingSource = m_pScope && (!m_pAuxScope || m_pScope->CanReportPosition()) ?
         m_pScope : m_pAuxScope;
+    PointingCache::Start(pPointingSource);
 
     pRotator = m_pRotator;
 }
@@ -1092,6 +1460,7 @@ void GearDialog::OnChoiceScope(wxCommandEvent& event)
     {
         wxString choice = m_pScopes->GetStringSelection();
 
+        PointingCache::Stop();
         delete m_pScope;
         m_pScope = NULL;
         UpdateGearPointers();
@@ -1124,6 +1493,7 @@ void GearDialog::OnChoiceAuxScope(wxCommandEvent& event)
     {
         wxString choice = m_pAuxScopes->GetStringSelection();
 
+        PointingCache::Stop();
         if (m_pAuxScope != m_pScope)
             delete m_pAuxScope;
         m_pAuxScope = NULL;
@@ -1163,7 +1533,10 @@ void GearDialog::OnButtonConnectScope(wxCommandEvent& event)
     {
         // m_pScope is NULL when scope selection is "None"
 
-        if (m_pScope && m_pScope->IsConnected())
+        bool bgErr;
+        bool inBg = FinishBackgroundConnect(DEVICES_MOUNT, &bgErr);
+
+        if (!inBg && m_pScope && m_pScope->IsConnected())
         {
             throw THROW_INFO("OnButtonConnectScope: called when connected");
         }
@@ -1172,7 +1545,7 @@ void GearDialog::OnButtonConnectScope(wxCommandEvent& event)
         {
             pFrame->StatusMsgNoTimeout(_("Connecting to Mount ..."));
 
-            if (m_pScope->Connect())
+            if (inBg ? bgErr : m_pScope->Connect())
             {
                 throw THROW_INFO("OnButtonConnectScope: connect failed");
             }
@@ -1210,7 +1583,10 @@ void GearDialog::OnButtonConnectAuxScope(wxCommandEvent& event)
     {
         // m_pAuxScope is NULL when scope selection is "None"
 
-        if (m_pAuxScope && m_pAuxScope->IsConnected())
+        bool bgErr;
+        bool inBg = FinishBackgroundConnect(DEVICES_AUX_MOUNT, &bgErr);
+
+        if (!inBg && m_pAuxScope && m_pAuxScope->IsConnected())
         {
             throw THROW_INFO("OnButtonConnectAuxScope: called when connected");
         }
@@ -1219,7 +1595,7 @@ void GearDialog::OnButtonConnectAuxScope(wxCommandEvent& event)
         {
             pFrame->StatusMsgNoTimeout(_("Connecting to Aux Mount ..."));
 
-            if (m_pAuxScope->Connect())
+            if (inBg ? bgErr : m_pAuxScope->Connect())
             {
                 throw THROW_INFO("OnButtonConnectAuxScope: connect failed");
             }
@@ -1252,6 +1628,7 @@ void GearDialog::OnButtonDisconnectScope(wxCommandEvent& event)
             throw THROW_INFO("OnButtonDisconnectScope: called when not connected");
         }
 
+        PointingCache::Stop();
         m_pScope->Disconnect();
         pFrame->StatusMsg(_("Mount Disconnected"));
         pFrame->UpdateStateLabels();
@@ -1283,6 +1660,7 @@ void GearDialog::OnButtonDisconnectAuxScope(wxCommandEvent& event)
             throw THROW_INFO("OnButtonDisconnectAuxScope: called when not connected");
         }
 
+        PointingCache::Stop();
         m_pAuxScope->Disconnect();
         pFrame->StatusMsg(_("Aux Mount Disconnected"));
     }
@@ -1359,7 +1737,10 @@ void GearDialog::OnButtonConnectStepGuider(wxCommandEvent& event)
     {
         // m_pStepGuider is NULL when stepguider selection is "None"
 
-        if (m_pStepGuider && m_pStepGuider->IsConnected())
+        bool bgErr;
+        bool inBg = FinishBackgroundConnect(DEVICES_AO, &bgErr);
+
+        if (!inBg && m_pStepGuider && m_pStepGuider->IsConnected())
         {
             throw THROW_INFO("OnButtonConnectStepGuider: called when connected");
         }
@@ -1368,7 +1749,7 @@ void GearDialog::OnButtonConnectStepGuider(wxCommandEvent& event)
         {
             pFrame->StatusMsgNoTimeout(_("Connecting to AO ..."));
 
-            if (m_pStepGuider->Connect())
+            if (inBg ? bgErr : m_pStepGuider->Connect())
             {
                 throw THROW_INFO("OnButtonConnectStepGuider: connect failed");
             }
@@ -1474,7 +1855,10 @@ void GearDialog::OnButtonConnectRotator(wxCommandEvent& event)
     {
         // m_pRotator is NULL when stepguider selection is "None"
 
-        if (m_pRotator && m_pRotator->IsConnected())
+        bool bgErr;
+        bool inBg = FinishBackgroundConnect(DEVICES_ROTATOR, &bgErr);
+
+        if (!inBg && m_pRotator && m_pRotator->IsConnected())
         {
             throw THROW_INFO("OnButtonConnectRotator: called when connected");
         }
@@ -1483,7 +1867,7 @@ void GearDialog::OnButtonConnectRotator(wxCommandEvent& event)
         {
             pFrame->StatusMsgNoTimeout(_("Connecting to Rotator ..."));
 
-            if (m_pRotator->Connect())
+            if (inBg ? bgErr : m_pRotator->Connect())
             {
                 throw THROW_INFO("OnButtonConnectRotator: connect failed");
             }
@@ -1617,6 +2001,129 @@ void GearDialog::OnProfileChoice(wxCommandEvent& event)
     pFrame->UpdateTitle();
 }
 
+static wxString ProfileString(int profileId, const wxString& name, const wxString& defaultValue)
+{
+    return pConfig->Global.GetString(wxString::Format("/profile/%d%s", profileId, name), defaultValue);
+}
+
+static bool SameInProfile(int profileId, const wxString& name, const wxString& defaultValue)
+{
+    return pConfig->Profile.GetString(name, defaultValue) == ProfileString(profileId, name, defaultValue);
+}
+
+// A profile can be switched to without disconnecting if it selects the same
+// device for everything that is connected
+bool GearDialog::CanHotSwitchProfile(int profileId)
+{
+    if (m_pCamera && m_pCamera->Connected)
+    {
+        if (!SameInProfile(profileId, "/camera/LastMenuchoice", _("None")) ||
+            !SameInProfile(profileId, CameraSelectionKey(m_pCamera), GuideCamera::DEFAULT_CAMERA_ID))
+        {
+            Debug.AddLine("profile switch: camera selection differs");
+            return false;
+        }
+    }
+    if (m_pScope && m_pScope->IsConnected() && !SameInProfile(profileId, "/scope/LastMenuChoice", _("None")))
+    {
+        Debug.AddLine("profile switch: mount selection differs");
+        return false;
+    }
+    if (m_pAuxScope && m_pAuxScope->IsConnected() && !SameInProfile(profileId, "/scope/LastAuxMenuChoice", _("None")))
+    {
+        Debug.AddLine("profile switch: aux mount selection differs");
+        return false;
+    }
+    if (m_pStepGuider && m_pStepGuider->IsConnected() && !SameInProfile(profileId, "/stepguider/LastMenuChoice", _("None")))
+    {
+        Debug.AddLine("profile switch: AO selection differs");
+        return false;
+    }
+    if (m_pRotator && m_pRotator->IsConnected() && !SameInProfile(profileId, "/rotator/LastMenuChoice", _("None")))
+    {
+        Debug.AddLine("profile switch: rotator selection differs");
+        return false;
+    }
+    return true;
+}
+
+// Switch to a profile while equipment stays connected. The connected devices
+// re-read their settings, the dark library stays loaded when the new profile
+// has one and the camera binning is unchanged, and everything else is loaded
+// the same way as for a regular profile change.
+void GearDialog::HotSwitchProfile(const wxString& profile)
+{
+    Debug.AddLine("Switching to profile " + profile + " with equipment connected");
+
+    bool cameraConnected = m_pCamera && m_pCamera->Connected;
+    int prevBinning = cameraConnected ? m_pCamera->EffectiveBinning() : 0;
+    wxSize prevDarkSize = cameraConnected ? m_pCamera->DarkFrameSize() : UNDEFINED_FRAME_SIZE;
+
+    pConfig->SetCurrentProfile(profile);
+    LoadGearChoices(true);
+
+    if (cameraConnected)
+    {
+        m_pCamera->LoadProfileSettings();
+
+        double pixelSize;
+        if (!m_pCamera->GetDevicePixelSize(&pixelSize))
+            m_pCamera->SetCameraPixelSize(pixelSize);
+
+        m_cameraUpdated = true;
+    }
+    if (m_pScope && m_pScope->IsConnected())
+    {
+        m_pScope->LoadProfileSettings();
+        m_mountUpdated = true;
+    }
+    if (m_pAuxScope && m_pAuxScope->IsConnected())
+        m_pAuxScope->LoadProfileSettings();
+    if (m_pStepGuider && m_pStepGuider->IsConnected())
+    {
+        m_pStepGuider->LoadProfileSettings();
+        m_stepGuiderUpdated = true;
+    }
+    if (m_pRotator && m_pRotator->IsConnected())
+    {
+        m_pRotator->LoadProfileSettings();
+        m_rotatorUpdated = true;
+    }
+
+    pFrame->LoadProfileSettings();
+    pFrame->pGuider->LoadProfileSettings();
+    pFrame->UpdateTitle();
+
+    if (cameraConnected)
+    {
+        int profileId = pConfig->GetCurrentProfileId();
+        bool sameGeometry = m_pCamera->EffectiveBinning() == prevBinning &&
+            m_pCamera->DarkFrameSize() == prevDarkSize;
+        bool keep = sameGeometry &&
+            ((m_pCamera->CurrentDarkFrame && pConfig->Profile.GetBoolean("/camera/AutoLoadDarks", true) &&
+              pFrame->DarkLibExists(profileId, false)) ||
+             (m_pCamera->CurrentDefectMap && pConfig->Profile.GetBoolean("/camera/AutoLoadDefectMap", true) &&
+              DefectMap::DefectMapExists(profileId, false)));
+
+        if (keep)
+        {
+            Debug.AddLine("profile switch: camera geometry unchanged, keeping dark library / defect map");
+        }
+        else
+        {
+            pFrame->UnloadDarks();
+            AutoLoadDefectMap();
+            if (!m_pCamera->CurrentDefectMap)
+            {
+                AutoLoadDarks();
+            }
+        }
+        pFrame->SetDarkMenuState();
+    }
+
+    UpdateButtonState();
+}
+
 bool GearDialog::SetProfile(int profileId, wxString *error)
 {
     if (profileId == pConfig->GetCurrentProfileId())
@@ -1629,20 +2136,30 @@ bool GearDialog::SetProfile(int profileId, wxString *error)
         return true;
     }
 
-    if ((m_pCamera && m_pCamera->Connected) ||
-        (m_pScope && m_pScope->IsConnected()) ||
-        (m_pAuxScope && m_pAuxScope->IsConnected()) ||
-        (m_pStepGuider && m_pStepGuider->IsConnected()) ||
-        (m_pRotator && m_pRotator->IsConnected()))
+    if (!pConfig->ProfileExists(profileId))
     {
-        *error = "cannot set profile when equipment is connected";
+        *error = "invalid profile id";
         return true;
     }
 
-    if (!pConfig->ProfileExists(profileId))
+    bool connected = (m_pCamera && m_pCamera->Connected) ||
+        (m_pScope && m_pScope->IsConnected()) ||
+        (m_pAuxScope && m_pAuxScope->IsConnected()) ||
+        (m_pStepGuider && m_pStepGuider->IsConnected()) ||
+        (m_pRotator && m_pRotator->IsConnected());
+
+    if (connected)
     {
-        *error = "invalid profile id";
-        return true;
+        if (pFrame->CaptureActive)
+        {
+            *error = "cannot set profile while capture is active";
+            return true;
+        }
+        if (!CanHotSwitchProfile(profileId))
+        {
+            *error = "cannot set profile when equipment is connected and the profile selects different equipment";
+            return true;
+        }
     }
 
     wxString profile = pConfig->GetProfileName(profileId);
@@ -1653,9 +2170,16 @@ bool GearDialog::SetProfile(int profileId, wxString *error)
         return true;
     }
 
-    // need the side-effects for making the selection
-    wxCommandEvent dummy;
-    OnProfileChoice(dummy);
+    if (connected)
+    {
+        HotSwitchProfile(profile);
+    }
+    else
+    {
+        // need the side-effects for making the selection
+        wxCommandEvent dummy;
+        OnProfileChoice(dummy);
+    }
 
     // need the side-effects of closing the dialog
     EndModal(0);
@@ -1675,7 +2199,8 @@ bool GearDialog::ConnectAll(wxString *error)
         return false;
     }
 
-    if (pFrame->CaptureActive)
+    if (pFrame->CaptureActive || DarkBuilder::IsActive() || CameraTest::IsActive() || PulseProfiler::IsActive() ||
+        AOFastLoop::IsActive() || CaptureNode::IsRunning())
     {
         // these error messages are internal to the event server and are not translated
         *error = "cannot connect equipment when capture is active";
@@ -1729,7 +2254,8 @@ bool GearDialog::DisconnectAll(wxString *error)
         return false;
     }
 
-    if (pFrame->CaptureActive)
+    if (pFrame->CaptureActive || DarkBuilder::IsActive() || CameraTest::IsActive() || PulseProfiler::IsActive() ||
+        AOFastLoop::IsActive() || CaptureNode::IsRunning())
     {
         // these error messages are internal to the event server and are not translated
         *error = "cannot disconnect equipment while capture active";
@@ -1750,41 +2276,112 @@ bool GearDialog::DisconnectAll(wxString *error)
     return false;
 }
 
+static GearConnectThread *StartBackgroundDisconnect(DeviceListKind kind, GearConnectThread *thread)
+{
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        // it will be disconnected on the main thread
+        delete thread;
+        return NULL;
+    }
+
+    Debug.Write(wxString::Format("Shutdown: disconnecting %s in the background\n", GearName(kind)));
+    return thread;
+}
+
+// Devices that can connect in the background are disconnected the same way,
+// all at once, while the rest are disconnected here one at a time; a mount
+// that guides through the camera or AO goes first. The wait for the
+// background disconnects is bounded, so a driver that hangs can not hold up
+// the exit: a device still disconnecting then is left alone and not deleted.
 void GearDialog::Shutdown(bool forced)
 {
+    enum { DISCONNECT_TIMEOUT_MS = 10000 };
+
     Debug.Write(wxString::Format("Shutdown: forced=%d\n", forced));
 
-    if (!forced && m_pScope && m_pScope->IsConnected())
+    PointingCache::Stop();
+
+    wxStopWatch swatch;
+
+    bool scope = !forced && m_pScope && m_pScope->IsConnected();
+    bool auxScope = m_pAuxScope && m_pAuxScope->IsConnected() && !(m_pAuxScope == m_pScope && scope);
+    bool camera = !forced && m_pCamera && m_pCamera->Connected;
+    bool stepGuider = !forced && m_pStepGuider && m_pStepGuider->IsConnected();
+    bool rotator = m_pRotator && m_pRotator->IsConnected();
+
+    if (scope && (m_pScope->RequiresCamera() || m_pScope->RequiresStepGuider()))
     {
         Debug.AddLine("Shutdown: disconnect scope");
         m_pScope->Disconnect();
+        scope = false;
     }
 
-    if (m_pAuxScope && m_pAuxScope->IsConnected())
+    GearConnectThread *thread[NUM_DEVICE_LISTS] = { NULL };
+
+    if (scope && m_pScope->CanConnectInBackground())
+        thread[DEVICES_MOUNT] = StartBackgroundDisconnect(DEVICES_MOUNT, new GearConnectThread(NULL, wxEmptyString, m_pScope, NULL, true));
+    if (auxScope && m_pAuxScope->CanConnectInBackground())
+        thread[DEVICES_AUX_MOUNT] = StartBackgroundDisconnect(DEVICES_AUX_MOUNT, new GearConnectThread(NULL, wxEmptyString, m_pAuxScope, NULL, true));
+    if (camera && m_pCamera->CanConnectInBackground())
+        thread[DEVICES_CAMERA] = StartBackgroundDisconnect(DEVICES_CAMERA, new GearConnectThread(m_pCamera, wxEmptyString, NULL, NULL, true));
+    if (stepGuider && m_pStepGuider->CanConnectInBackground())
+        thread[DEVICES_AO] = StartBackgroundDisconnect(DEVICES_AO, new GearConnectThread(NULL, wxEmptyString, m_pStepGuider, NULL, true));
+    if (rotator && m_pRotator->CanConnectInBackground())
+        thread[DEVICES_ROTATOR] = StartBackgroundDisconnect(DEVICES_ROTATOR, new GearConnectThread(NULL, wxEmptyString, NULL, m_pRotator, true));
+
+    if (scope && !thread[DEVICES_MOUNT])
+    {
+        Debug.AddLine("Shutdown: disconnect scope");
+        m_pScope->Disconnect();
+    }
+
+    if (auxScope && !thread[DEVICES_AUX_MOUNT])
     {
         Debug.AddLine("Shutdown: disconnect aux scope");
         m_pAuxScope->Disconnect();
     }
 
-    if (!forced && m_pCamera && m_pCamera->Connected)
+    if (camera && !thread[DEVICES_CAMERA])
     {
         Debug.AddLine("Shutdown: disconnect camera");
         m_pCamera->Disconnect();
     }
 
-    if (!forced && m_pStepGuider && m_pStepGuider->IsConnected())
+    if (stepGuider && !thread[DEVICES_AO])
     {
         Debug.AddLine("Shutdown: disconnect stepguider");
         m_pStepGuider->Disconnect();
     }
 
-    if (m_pRotator && m_pRotator->IsConnected())
+    if (rotator && !thread[DEVICES_ROTATOR])
     {
         Debug.AddLine("Shutdown: disconnect rotator");
         m_pRotator->Disconnect();
     }
 
-    Debug.AddLine("Shutdown complete");
+    for (int i = 0; i < NUM_DEVICE_LISTS; i++)
+    {
+        if (!thread[i])
+            continue;
+
+        while (!thread[i]->done && swatch.Time() < DISCONNECT_TIMEOUT_MS)
+            wxMilliSleep(10);
+
+        if (!thread[i]->done)
+        {
+            // the thread is leaked along with the device
+            Debug.Write(wxString::Format("Shutdown: gave up waiting for the %s to disconnect\n", GearName((DeviceListKind) i)));
+            m_abandoned[i] = true;
+            continue;
+        }
+
+        thread[i]->Wait();
+        Debug.Write(wxString::Format("Shutdown: %s disconnected in %ld ms\n", GearName((DeviceListKind) i), thread[i]->elapsedMs));
+        delete thread[i];
+    }
+
+    Debug.Write(wxString::Format("Shutdown complete after %ld ms\n", swatch.Time()));
 }
 
 struct NewProfileDialog : public wxDialog
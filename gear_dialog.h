@@ -36,6 +36,7 @@
 #define GEAR_DIALOG_H_INCLUDED
 
 class wxGridBagSizer;
+class GearConnectThread;
 
 class GearDialog : public wxDialog
 {
@@ -54,6 +55,9 @@ class GearDialog : public wxDialog
     wxString m_lastCamera;
     bool m_camWarningIssued;
     wxArrayString m_cameraIds;
+    bool m_listPending[NUM_DEVICE_LISTS];   // choices are provisional until the device list arrives
+    GearConnectThread *m_connectThread[NUM_DEVICE_LISTS];   // Connect All connects in progress off the main thread
+    bool m_abandoned[NUM_DEVICE_LISTS];     // still disconnecting when shutdown gave up waiting, so not deleted
 
     wxGridBagSizer *m_gearSizer;
 
@@ -104,10 +108,16 @@ public:
     void Shutdown(bool forced);
     bool IsEmptyProfile();
     bool ReconnectCamera();
+    bool QuickReconnectCamera();
     Scope *AuxScope() const;
 
 private:
-    void LoadGearChoices(void);
+    wxArrayString InitialList(DeviceListKind kind);
+    void SelectChoice(wxChoice *choice, DeviceListKind kind, const wxString& sel);
+    void OnDeviceListReady(wxThreadEvent& event);
+    void LoadGearChoices(bool keepConnected = false);
+    bool CanHotSwitchProfile(int profileId);
+    void HotSwitchProfile(const wxString& profile);
     void UpdateGearPointers(void);
 
     void UpdateCameraButtonState(void);
@@ -129,6 +139,11 @@ private:
     void OnProfileSave(wxCommandEvent& event);
     void OnAdvanced(wxCommandEvent& event);
 
+    void StartBackgroundConnect(DeviceListKind kind, GearConnectThread *thread);
+    void StartBackgroundConnects(void);
+    bool FinishBackgroundConnect(DeviceListKind kind, bool *err);
+    void WaitForBackgroundConnects(void);
+
     void OnButtonConnectAll(wxCommandEvent& event);
     void OnButtonDisconnectAll(wxCommandEvent& event);
     void OnChar(wxKeyEvent& event);
@@ -138,6 +153,7 @@ private:
     void OnMenuSelectCamera(wxCommandEvent& evt);
 
     void OnButtonSetupCamera(wxCommandEvent& event);
+    bool CameraChangeCanceled(void);
     bool DoConnectCamera(void);
     void OnButtonConnectCamera(wxCommandEvent& event);
     void OnButtonDisconnectCamera(wxCommandEvent& event);
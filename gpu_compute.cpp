@@ -0,0 +1,546 @@
+/*
+ *  gpu_compute.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#if defined(PHD_OPENCL)
+
+#include "phd.h"
+#include "gpu_compute.h"
+
+#if !defined(CL_TARGET_OPENCL_VERSION)
+# define CL_TARGET_OPENCL_VERSION 120
+#endif
+#if defined(__APPLE__)
+# include <OpenCL/opencl.h>
+#else
+# include <CL/cl.h>
+#endif
+
+// below this the transfers cost more than the kernels save
+enum { MIN_OFFLOAD_PIXELS = 4 * 1024 * 1024 };
+
+// the kernels mirror subtract_dark_row, median3_line, recon_line and
+// MedianFilterHisto in image_math.cpp, edge handling included
+static const char *s_source =
+"__kernel void subtract_dark(__global const ushort *src, __global const ushort *below,\n"
+"    __global const ushort *above, __global ushort *dst, uint n)\n"
+"{\n"
+"    uint i = get_global_id(0);\n"
+"    if (i >= n)\n"
+"        return;\n"
+"    uint v = min((uint) src[i] + below[i], 65535u);\n"
+"    dst[i] = (ushort) (v > above[i] ? v - above[i] : 0);\n"
+"}\n"
+"\n"
+"// the window is clipped at the edges; the two middle values of an even\n"
+"// count are averaged, as median4 and median6 do\n"
+"__kernel void median3(__global const ushort *src, __global ushort *dst, int W, int H)\n"
+"{\n"
+"    int x = get_global_id(0), y = get_global_id(1);\n"
+"    if (x >= W || y >= H)\n"
+"        return;\n"
+"    ushort a[9];\n"
+"    int n = 0;\n"
+"    for (int j = max(y - 1, 0); j <= min(y + 1, H - 1); j++)\n"
+"        for (int i = max(x - 1, 0); i <= min(x + 1, W - 1); i++)\n"
+"        {\n"
+"            ushort v = src[j * W + i];\n"
+"            int k = n++;\n"
+"            while (k > 0 && a[k - 1] > v)\n"
+"            {\n"
+"                a[k] = a[k - 1];\n"
+"                --k;\n"
+"            }\n"
+"            a[k] = v;\n"
+"        }\n"
+"    dst[y * W + x] = (n & 1) ? a[n / 2] : (ushort) (((uint) a[n / 2 - 1] + a[n / 2]) / 2);\n"
+"}\n"
+"\n"
+"__kernel void recon(__global const ushort *src, __global ushort *dst, int W, int H)\n"
+"{\n"
+"    int x = get_global_id(0), y = get_global_id(1);\n"
+"    if (x >= W || y >= H)\n"
+"        return;\n"
+"    int o = y * W + x;\n"
+"    uint v;\n"
+"    if (y < H - 1)\n"
+"        v = x < W - 1 ? ((uint) src[o] + src[o + 1] + src[o + W] + src[o + W + 1]) >> 2 : ((uint) src[o] + src[o + W]) >> 1;\n"
+"    else\n"
+"        v = x < W - 1 ? ((uint) src[o] + src[o + 1]) >> 1 : src[o];\n"
+"    dst[o] = (ushort) v;\n"
+"}\n"
+"\n"
+"// min and max into out[2 * slot] and out[2 * slot + 1]; each work item\n"
+"// folds a run of pixels and then makes one atomic update\n"
+"__kernel void minmax(__global const ushort *src, uint n, __global int *out, int slot)\n"
+"{\n"
+"    int lo = 65535, hi = 0;\n"
+"    for (uint i = get_global_id(0); i < n; i += get_global_size(0))\n"
+"    {\n"
+"        int v = src[i];\n"
+"        lo = min(lo, v);\n"
+"        hi = max(hi, v);\n"
+"    }\n"
+"    atomic_min(&out[2 * slot], lo);\n"
+"    atomic_max(&out[2 * slot + 1], hi);\n"
+"}\n"
+"\n"
+"// the value at index n/2 of the n pixels of the clipped window, found bit\n"
+"// by bit as the largest v with no more than n/2 pixels below it\n"
+"__kernel void median_filter(__global const ushort *src, __global ushort *dst, int W, int H, int hw)\n"
+"{\n"
+"    int x = get_global_id(0), y = get_global_id(1);\n"
+"    if (x >= W || y >= H)\n"
+"        return;\n"
+"    int x0 = max(x - hw, 0), x1 = min(x + hw, W - 1);\n"
+"    int y0 = max(y - hw, 0), y1 = min(y + hw, H - 1);\n"
+"    uint k = (uint) ((x1 - x0 + 1) * (y1 - y0 + 1)) / 2;\n"
+"    uint res = 0;\n"
+"    for (int b = 15; b >= 0; b--)\n"
+"    {\n"
+"        uint cand = res | (1u << b);\n"
+"        uint cnt = 0;\n"
+"        for (int j = y0; j <= y1; j++)\n"
+"            for (int i = x0; i <= x1; i++)\n"
+"                cnt += src[j * W + i] < cand;\n"
+"        if (cnt <= k)\n"
+"            res = cand;\n"
+"    }\n"
+"    dst[y * W + x] = (ushort) res;\n"
+"}\n";
+
+static bool ClFailed(cl_int err, const char *what)
+{
+    if (err == CL_SUCCESS)
+        return false;
+    Debug.Write(wxString::Format("GpuCompute: %s failed, error %d\n", what, err));
+    return true;
+}
+
+struct GpuCompute::Impl
+{
+    enum { K_SUBTRACT, K_MEDIAN3, K_RECON, K_MINMAX, K_MEDIAN_FILTER, K_COUNT };
+    enum { MINMAX_WORK_ITEMS = 16384 };
+
+    cl_context ctx;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernels[K_COUNT];
+
+    // three frames, the input and two for the stages to ping-pong between
+    cl_mem frames[3];
+    size_t capacity;            // pixels
+    cl_mem below, above;
+    const PreparedDark *dark;   // the dark in below and above, referenced
+    cl_mem stats;
+
+    Impl() : ctx(0), queue(0), program(0), capacity(0), below(0), above(0), dark(0), stats(0)
+    {
+        for (int i = 0; i < K_COUNT; i++)
+            kernels[i] = 0;
+        for (int i = 0; i < 3; i++)
+            frames[i] = 0;
+    }
+
+    ~Impl()
+    {
+        ReleaseFrames();
+        ReleaseDark();
+        if (stats)
+            clReleaseMemObject(stats);
+        for (int i = 0; i < K_COUNT; i++)
+            if (kernels[i])
+                clReleaseKernel(kernels[i]);
+        if (program)
+            clReleaseProgram(program);
+        if (queue)
+            clReleaseCommandQueue(queue);
+        if (ctx)
+            clReleaseContext(ctx);
+    }
+
+    bool Init();
+    bool Reserve(size_t npixels);
+    bool LoadDark(const PreparedDark *pd, const unsigned short *pbelow, const unsigned short *pabove, size_t n);
+    bool Run2D(int k, cl_mem src, cl_mem dst, int W, int H, int extra = -1);
+    bool MinMax(cl_mem src, unsigned int n, int slot);
+
+    void ReleaseFrames()
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (frames[i])
+                clReleaseMemObject(frames[i]);
+            frames[i] = 0;
+        }
+        capacity = 0;
+    }
+
+    void ReleaseDark()
+    {
+        if (below)
+            clReleaseMemObject(below);
+        if (above)
+            clReleaseMemObject(above);
+        below = above = 0;
+        if (dark)
+            const_cast<PreparedDark *>(dark)->Release();
+        dark = 0;
+    }
+};
+
+// the first GPU device of any platform
+bool GpuCompute::Impl::Init()
+{
+    cl_uint nplatforms = 0;
+    if (ClFailed(clGetPlatformIDs(0, NULL, &nplatforms), "clGetPlatformIDs") || nplatforms == 0)
+        return true;
+
+    std::vector<cl_platform_id> platforms(nplatforms);
+    clGetPlatformIDs(nplatforms, &platforms[0], NULL);
+
+    cl_device_id device = 0;
+    for (cl_uint i = 0; i < nplatforms && !device; i++)
+    {
+        cl_uint ndev = 0;
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_GPU, 1, &device, &ndev) != CL_SUCCESS || ndev == 0)
+            device = 0;
+    }
+    if (!device)
+    {
+        Debug.Write("GpuCompute: no OpenCL GPU device\n");
+        return true;
+    }
+
+    char name[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+
+    cl_int err;
+    ctx = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if (ClFailed(err, "clCreateContext"))
+        return true;
+    queue = clCreateCommandQueue(ctx, device, 0, &err);
+    if (ClFailed(err, "clCreateCommandQueue"))
+        return true;
+
+    program = clCreateProgramWithSource(ctx, 1, &s_source, NULL, &err);
+    if (ClFailed(err, "clCreateProgramWithSource"))
+        return true;
+    if (ClFailed(clBuildProgram(program, 1, &device, "", NULL, NULL), "clBuildProgram"))
+    {
+        char log[4096] = "";
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, sizeof(log) - 1, log, NULL);
+        Debug.Write(wxString::Format("GpuCompute: build log: %s\n", log));
+        return true;
+    }
+
+    static const char *names[K_COUNT] = { "subtract_dark", "median3", "recon", "minmax", "median_filter" };
+    for (int i = 0; i < K_COUNT; i++)
+    {
+        kernels[i] = clCreateKernel(program, names[i], &err);
+        if (ClFailed(err, names[i]))
+            return true;
+    }
+
+    stats = clCreateBuffer(ctx, CL_MEM_READ_WRITE, 4 * sizeof(cl_int), NULL, &err);
+    if (ClFailed(err, "clCreateBuffer"))
+        return true;
+
+    Debug.Write(wxString::Format("GpuCompute: using %s\n", name));
+    return false;
+}
+
+bool GpuCompute::Impl::Reserve(size_t npixels)
+{
+    if (npixels <= capacity)
+        return false;
+
+    ReleaseFrames();
+    for (int i = 0; i < 3; i++)
+    {
+        cl_int err;
+        frames[i] = clCreateBuffer(ctx, CL_MEM_READ_WRITE, npixels * sizeof(unsigned short), NULL, &err);
+        if (ClFailed(err, "clCreateBuffer"))
+        {
+            ReleaseFrames();
+            return true;
+        }
+    }
+    capacity = npixels;
+    return false;
+}
+
+// the dark is uploaded once and kept until another one comes; the
+// reference keeps its address from being reused by a new dark meanwhile
+bool GpuCompute::Impl::LoadDark(const PreparedDark *pd, const unsigned short *pbelow, const unsigned short *pabove, size_t n)
+{
+    if (pd == dark)
+        return false;
+
+    ReleaseDark();
+
+    size_t const bytes = n * sizeof(unsigned short);
+    cl_int err;
+    below = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, const_cast<unsigned short *>(pbelow), &err);
+    if (ClFailed(err, "clCreateBuffer"))
+    {
+        ReleaseDark();
+        return true;
+    }
+    above = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, bytes, const_cast<unsigned short *>(pabove), &err);
+    if (ClFailed(err, "clCreateBuffer"))
+    {
+        ReleaseDark();
+        return true;
+    }
+
+    const_cast<PreparedDark *>(pd)->AddRef();
+    dark = pd;
+    return false;
+}
+
+// a kernel over the W x H frame with arguments (src, dst, W, H[, extra])
+bool GpuCompute::Impl::Run2D(int k, cl_mem src, cl_mem dst, int W, int H, int extra)
+{
+    cl_kernel kernel = kernels[k];
+    cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &src);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &dst);
+    err |= clSetKernelArg(kernel, 2, sizeof(int), &W);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &H);
+    if (extra >= 0)
+        err |= clSetKernelArg(kernel, 4, sizeof(int), &extra);
+    if (ClFailed(err, "clSetKernelArg"))
+        return true;
+
+    // rounded up so that the runtime can pick a tidy work group size; the
+    // kernels skip the items outside the frame
+    enum { ROUND_TO = 16 };
+    size_t const global[2] = { (size_t) (W + ROUND_TO - 1) / ROUND_TO * ROUND_TO, (size_t) (H + ROUND_TO - 1) / ROUND_TO * ROUND_TO };
+    return ClFailed(clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL), "clEnqueueNDRangeKernel");
+}
+
+bool GpuCompute::Impl::MinMax(cl_mem src, unsigned int n, int slot)
+{
+    cl_kernel kernel = kernels[K_MINMAX];
+    cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &src);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &n);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &stats);
+    err |= clSetKernelArg(kernel, 3, sizeof(int), &slot);
+    if (ClFailed(err, "clSetKernelArg"))
+        return true;
+
+    size_t const global = MINMAX_WORK_ITEMS;
+    return ClFailed(clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL), "clEnqueueNDRangeKernel");
+}
+
+static GpuCompute *s_instance;
+static bool s_initDone;
+static wxCriticalSection s_initLock;
+
+GpuCompute::GpuCompute(Impl *impl)
+    : m_impl(impl)
+{
+}
+
+GpuCompute::~GpuCompute()
+{
+    delete m_impl;
+}
+
+GpuCompute *GpuCompute::Get(int npixels)
+{
+    if (npixels < MIN_OFFLOAD_PIXELS)
+        return NULL;
+
+    wxCriticalSectionLocker lck(s_initLock);
+
+    if (!s_initDone)
+    {
+        s_initDone = true;
+        if (pConfig->Global.GetBoolean("/GpuCompute", true))
+        {
+            Impl *impl = new Impl();
+            if (impl->Init())
+            {
+                Debug.Write("GpuCompute: not available, using the CPU\n");
+                delete impl;
+            }
+            else
+                s_instance = new GpuCompute(impl);
+        }
+    }
+
+    return s_instance;
+}
+
+void GpuCompute::Destroy()
+{
+    wxCriticalSectionLocker lck(s_initLock);
+    delete s_instance;
+    s_instance = NULL;
+    s_initDone = false;
+}
+
+bool GpuCompute::CalibrateFrame(usImage& img, const PreparedDark *dark, int noiseReduction, bool stats)
+{
+    if (!img.ImageData || !img.Subframe.IsEmpty())
+        return true;
+
+    int const W = img.Size.GetWidth();
+    int const H = img.Size.GetHeight();
+    if (W < 3 || H < 3)
+        return true;
+    if (dark && (dark->m_below.empty() || dark->m_size != img.Size))
+        return true;
+
+    wxMutexLocker lck(m_lock);
+    Impl *p = m_impl;
+
+    unsigned int const n = img.NPixels;
+    size_t const bytes = (size_t) n * sizeof(unsigned short);
+    if (p->Reserve(n))
+        return true;
+    if (dark && p->LoadDark(dark, &dark->m_below[0], &dark->m_above[0], dark->m_below.size()))
+        return true;
+
+    if (ClFailed(clEnqueueWriteBuffer(p->queue, p->frames[0], CL_FALSE, 0, bytes, img.ImageData, 0, NULL, NULL), "clEnqueueWriteBuffer"))
+        return true;
+
+    int cur = 0;
+
+    if (dark)
+    {
+        cl_kernel kernel = p->kernels[Impl::K_SUBTRACT];
+        cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &p->frames[0]);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &p->below);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &p->above);
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &p->frames[1]);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_uint), &n);
+        size_t const global = ((size_t) n + 255) / 256 * 256;
+        if (ClFailed(err, "clSetKernelArg") ||
+            ClFailed(clEnqueueNDRangeKernel(p->queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL), "clEnqueueNDRangeKernel"))
+        {
+            return true;
+        }
+        cur = 1;
+    }
+
+    if (noiseReduction == NR_3x3MEDIAN || noiseReduction == NR_2x2MEAN)
+    {
+        int const next = cur == 1 ? 2 : 1;
+        if (p->Run2D(noiseReduction == NR_3x3MEDIAN ? Impl::K_MEDIAN3 : Impl::K_RECON, p->frames[cur], p->frames[next], W, H))
+            return true;
+        cur = next;
+    }
+
+    cl_int st[4] = { 65535, 0, 65535, 0 };
+    if (stats)
+    {
+        // the filtered frame is only needed for its range, it is not read back
+        int const filt = cur == 1 ? 2 : 1;
+        if (ClFailed(clEnqueueWriteBuffer(p->queue, p->stats, CL_FALSE, 0, sizeof(st), st, 0, NULL, NULL), "clEnqueueWriteBuffer") ||
+            p->MinMax(p->frames[cur], n, 0) ||
+            p->Run2D(Impl::K_MEDIAN3, p->frames[cur], p->frames[filt], W, H) ||
+            p->MinMax(p->frames[filt], n, 1) ||
+            ClFailed(clEnqueueReadBuffer(p->queue, p->stats, CL_FALSE, 0, sizeof(st), st, 0, NULL, NULL), "clEnqueueReadBuffer"))
+        {
+            clFinish(p->queue);
+            return true;
+        }
+    }
+
+    // read the finished frame into a new buffer so that img is untouched if
+    // anything fails
+    usImage tmp;
+    bool const output = cur != 0;
+    if (output && tmp.Init(img.Size))
+    {
+        clFinish(p->queue);
+        return true;
+    }
+    if (output && ClFailed(clEnqueueReadBuffer(p->queue, p->frames[cur], CL_FALSE, 0, bytes, tmp.ImageData, 0, NULL, NULL), "clEnqueueReadBuffer"))
+    {
+        clFinish(p->queue);
+        return true;
+    }
+    if (ClFailed(clFinish(p->queue), "clFinish"))
+        return true;
+
+    if (output)
+        img.SwapImageData(tmp);
+    if (dark)
+        img.Pedestal = dark->Pedestal();
+    if (stats)
+    {
+        img.Min = st[0];
+        img.Max = st[1];
+        img.FiltMin = st[2];
+        img.FiltMax = st[3];
+    }
+
+    return false;
+}
+
+bool GpuCompute::MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+{
+    if (!src.ImageData || halfWidth < 0)
+        return true;
+
+    int const W = src.Size.GetWidth();
+    int const H = src.Size.GetHeight();
+
+    wxMutexLocker lck(m_lock);
+    Impl *p = m_impl;
+
+    unsigned int const n = src.NPixels;
+    size_t const bytes = (size_t) n * sizeof(unsigned short);
+    if (p->Reserve(n))
+        return true;
+
+    usImage out;
+    if (out.Init(src.Size))
+        return true;
+
+    if (ClFailed(clEnqueueWriteBuffer(p->queue, p->frames[0], CL_FALSE, 0, bytes, src.ImageData, 0, NULL, NULL), "clEnqueueWriteBuffer") ||
+        p->Run2D(Impl::K_MEDIAN_FILTER, p->frames[0], p->frames[1], W, H, halfWidth) ||
+        ClFailed(clEnqueueReadBuffer(p->queue, p->frames[1], CL_TRUE, 0, bytes, out.ImageData, 0, NULL, NULL), "clEnqueueReadBuffer"))
+    {
+        clFinish(p->queue);
+        return true;
+    }
+
+    dst.Init(src.Size);
+    dst.SwapImageData(out);
+    return false;
+}
+
+#endif // PHD_OPENCL
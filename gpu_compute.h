@@ -0,0 +1,70 @@
+/*
+ *  gpu_compute.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GPU_COMPUTE_INCLUDED
+#define GPU_COMPUTE_INCLUDED
+
+#if defined(PHD_OPENCL)
+
+// OpenCL versions of the full-frame kernels for large guide sensors:
+// CalibrateFrame (dark subtraction, noise reduction and frame statistics)
+// and the MedianFilter of the defect map dark. The kernels give the same
+// results, bit for bit, as the CPU code. The prepared dark stays on the
+// device until it changes and the intermediate frames never leave it; only
+// the finished frame and the four statistics are read back. Every call
+// returns true, with its output untouched, when the device cannot be used,
+// and the caller falls back to the CPU code. Enabled by the /GpuCompute
+// setting in builds configured with PHD2_OPENCL.
+class GpuCompute
+{
+public:
+    // the shared instance, NULL if there is no usable device, the setting is
+    // off, or the frame is too small to be worth the transfers
+    static GpuCompute *Get(int npixels);
+    static void Destroy();
+
+    bool CalibrateFrame(usImage& img, const PreparedDark *dark, int noiseReduction, bool stats);
+    bool MedianFilter(usImage& dst, const usImage& src, int halfWidth);
+
+private:
+    struct Impl;
+    Impl *m_impl;
+    wxMutex m_lock;     // the guide thread and the defect map builder may both call in
+
+    GpuCompute(Impl *impl);
+    ~GpuCompute();
+};
+
+#endif // PHD_OPENCL
+
+#endif // GPU_COMPUTE_INCLUDED
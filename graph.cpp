@@ -538,7 +538,7 @@ void GraphLogWindow::AppendData(const GuideStepInfo& step)
 
     if (m_visible)
     {
-        Refresh();
+        pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_GRAPH);
     }
 }
 
@@ -547,11 +547,6 @@ void GraphLogWindow::AppendData(const FrameDroppedInfo& info)
     m_pClient->AppendData(info);
 }
 
-void GraphLogWindow::AppendData(const DitherInfo& info)
-{
-    m_pClient->AppendData(info);
-}
-
 void GraphLogWindow::UpdateControls()
 {
     if (m_pXControlPane != NULL)
@@ -713,8 +708,11 @@ wxEND_EVENT_TABLE()
 
 GraphLogClientWindow::GraphLogClientWindow(wxWindow *parent) :
     wxWindow(parent, wxID_ANY, wxDefaultPosition, wxSize(401,200), wxFULL_REPAINT_ON_RESIZE),
+    m_history(Telemetry, GraphLogWindow::DefaultMaxLength),
     m_line1(0),
-    m_line2(0)
+    m_line2(0),
+    m_plotValid(false),
+    m_sampleCount(0)
 {
     SetBackgroundStyle(wxBG_STYLE_PAINT);
 
@@ -773,14 +771,21 @@ static void reset_trend_accums(TrendLineAccum accums[4])
 void GraphLogClientWindow::ResetData(void)
 {
     m_history.clear();
+    m_sampleCount = 0;
+    m_peakRa.clear();
+    m_peakDec.clear();
+    m_peakDuration.clear();
+    m_peakMass.clear();
+    m_peakSNR.clear();
+    m_plotValid = false;
     reset_trend_accums(m_trendLineAccum);
     m_raSameSides = 0;
     UpdateStats(0, 0);
     m_stats.ra_peak = m_stats.dec_peak = 0.0;
     m_stats.star_lost_cnt = 0;
     m_stats.ra_limit_cnt = m_stats.dec_limit_cnt = 0;
-    if (pFrame && pFrame->pStatsWin)
-        pFrame->pStatsWin->UpdateStats();
+    if (pFrame)
+        pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_STATS);
 }
 
 bool GraphLogClientWindow::SetMinLength(unsigned int minLength)
@@ -826,6 +831,7 @@ bool GraphLogClientWindow::SetMaxLength(unsigned int maxLength)
     }
 
     m_history.resize(maxLength);
+    m_plotValid = false;
 
     delete [] m_line1;
     m_line1 = new wxPoint[maxLength];
@@ -946,30 +952,27 @@ void GraphLogClientWindow::UpdateStats(unsigned int nr, const S_HISTORY *cur)
     }
 }
 
-static double peak_ra(const circular_buffer<S_HISTORY> &history, unsigned int nr)
+void GraphLogClientWindow::PushPeaks(const S_HISTORY& h)
 {
-    double peak = 0.0;
-    const int end = history.size();
-    const int begin = end - nr;
-    for (int i = begin; i < end; i++) {
-        double val = fabs(history[i].ra);
-        if (val > peak)
-            peak = val;
-    }
-    return peak;
+    m_peakRa.push(fabs(h.ra), m_length);
+    m_peakDec.push(fabs(h.dec), m_length);
+    m_peakDuration.push(wxMax(abs(h.raDur), abs(h.decDur)), m_length);
+    m_peakMass.push(h.starMass, m_length);
+    m_peakSNR.push(h.starSNR, m_length);
+
+    m_stats.ra_peak = m_peakRa.max(0.0);
+    m_stats.dec_peak = m_peakDec.max(0.0);
 }
 
-static double peak_dec(const circular_buffer<S_HISTORY> &history, unsigned int nr)
+GraphWindowPeaks GraphLogClientWindow::GetPeaks() const
 {
-    double peak = 0.0;
-    const int end = history.size();
-    const int begin = end - nr;
-    for (int i = begin; i < end; i++) {
-        double val = fabs(history[i].dec);
-        if (val > peak)
-            peak = val;
-    }
-    return peak;
+    GraphWindowPeaks p;
+    p.ra = m_peakRa.max(0.0);
+    p.dec = m_peakDec.max(0.0);
+    p.duration = m_peakDuration.max(0);
+    p.starMass = m_peakMass.max(0.0);
+    p.starSNR = m_peakSNR.max(0.0);
+    return p;
 }
 
 void GraphLogClientWindow::AppendData(const GuideStepInfo& step)
@@ -1000,47 +1003,23 @@ void GraphLogClientWindow::AppendData(const GuideStepInfo& step)
     m_stats.ra_limit_cnt += (step.raLimited ? 1 : 0) - ((trend_items >= m_length && oldest.raLimited) ? 1 : 0);
     m_stats.dec_limit_cnt += (step.decLimited ? 1 : 0) - ((trend_items >= m_length && oldest.decLimited) ? 1 : 0);
 
-    S_HISTORY cur(step);
-    m_history.push_front(cur);
-
-    // remove any dither history entries older than the first guide step history entry
-    wxLongLong_t t0 = m_history[0].timestamp;
-    while (m_dithers.size() > 0)
-    {
-        const DitherInfo& info = m_dithers.front();
-        if (info.timestamp < t0)
-            m_dithers.pop_front();
-        else
-            break;
-    }
+    // the mount has added the step to the session telemetry
+    m_history.Advance();
+    const S_HISTORY cur = m_history[m_history.size() - 1];
+    ++m_sampleCount;
 
     unsigned int new_nr = GetItemCount();
     UpdateStats(new_nr, &cur);
 
-    double ax = fabs(step.mountOffset.X);
-    if (ax > m_stats.ra_peak)
-        m_stats.ra_peak = ax;
-    else if (fabs(oldest.ra) == m_stats.ra_peak)
-        m_stats.ra_peak = peak_ra(m_history, new_nr);
-
-    double ay = fabs(step.mountOffset.Y);
-    if (ay > m_stats.dec_peak)
-        m_stats.dec_peak = ay;
-    else if (fabs(oldest.dec) == m_stats.dec_peak)
-        m_stats.dec_peak = peak_dec(m_history, new_nr);
+    PushPeaks(cur);
 
-    pFrame->pStatsWin->UpdateStats();
+    pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_STATS);
 }
 
 void GraphLogClientWindow::AppendData(const FrameDroppedInfo& info)
 {
     ++m_stats.star_lost_cnt;
-    pFrame->pStatsWin->UpdateStats();
-}
-
-void GraphLogClientWindow::AppendData(const DitherInfo& info)
-{
-    m_dithers.push_back(info);
+    pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_STATS);
 }
 
 void GraphLogClientWindow::RecalculateTrendLines(void)
@@ -1070,8 +1049,15 @@ void GraphLogClientWindow::RecalculateTrendLines(void)
         }
     }
 
-    m_stats.ra_peak = peak_ra(m_history, trend_items);
-    m_stats.dec_peak = peak_dec(m_history, trend_items);
+    // the window may have grown, so the maxima are rebuilt
+    m_peakRa.clear();
+    m_peakDec.clear();
+    m_peakDuration.clear();
+    m_peakMass.clear();
+    m_peakSNR.clear();
+    m_stats.ra_peak = m_stats.dec_peak = 0.0;
+    for (unsigned int i = begin; i < m_history.size(); i++)
+        PushPeaks(m_history[i]);
 
     {
         unsigned int raLimitedCnt = 0;
@@ -1089,12 +1075,15 @@ void GraphLogClientWindow::RecalculateTrendLines(void)
         m_stats.dec_limit_cnt = decLimitedCnt;
     }
 
-    const S_HISTORY *latest = 0;
     if (m_history.size() > 0)
-        latest = &m_history[m_history.size() - 1];
-    UpdateStats(trend_items, latest);
+    {
+        const S_HISTORY latest = m_history[m_history.size() - 1];
+        UpdateStats(trend_items, &latest);
+    }
+    else
+        UpdateStats(trend_items, 0);
 
-    pFrame->pStatsWin->UpdateStats();
+    pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_STATS);
 }
 
 // trendline - calculate the the trendline slope and intercept. We can do this
@@ -1136,47 +1125,176 @@ static wxString rms_label(double rms, double sampling)
         return wxString::Format("%4.2f", rms);
 }
 
-static int GetMaxDuration(const circular_buffer<S_HISTORY>& history, int start_item)
+enum { GRAPH_BORDER = 5 };
+
+static const wxFont& GraphSmallFont()
 {
-    int maxdur = 1; // always return at least 1 to protect against divide-by-zero
-    for (unsigned int i = start_item; i < history.size(); i++)
-    {
-        const S_HISTORY& h = history[i];
-        int d = abs(h.raDur);
-        if (d > maxdur)
-            maxdur = d;
-        d = abs(h.decDur);
-        if (d > maxdur)
-            maxdur = d;
-    }
-    return maxdur;
+#if defined(__WXOSX__)
+    return *wxSMALL_FONT;
+#else
+    return *wxSWISS_FONT;
+#endif
 }
 
-static double GetMaxStarMass(const circular_buffer<S_HISTORY>& history, int start_item)
+// Positions on the plot are counted from the sample number rather than from
+// the left edge, so that once the plot is scrolled by a whole number of
+// pixels the samples already drawn are exactly where a full redraw would
+// put them.
+struct PlotX
 {
-    double maxMass = 0.0;
-    for (unsigned int i = start_item; i < history.size(); i++)
-    {
-        const S_HISTORY& h = history[i];
-        if (h.starMass > maxMass)
-            maxMass = h.starMass;
-    }
-    return maxMass;
+    double m_xmag;
+    int m_x0;
+    PlotX(double xmag, long long first) : m_xmag(xmag), m_x0((int) floor(first * xmag)) { }
+    int x(double n) const { return (int) floor(n * m_xmag) - m_x0; }
+};
+
+bool GraphLogClientWindow::PlotKey::operator==(const PlotKey& rhs) const
+{
+    return size == rhs.size && xmag == rhs.xmag && ymag == rhs.ymag && mode == rhs.mode &&
+        showCorrections == rhs.showCorrections && showStarMass == rhs.showStarMass && showStarSNR == rhs.showStarSNR &&
+        raOrDxColor == rhs.raOrDxColor && decOrDyColor == rhs.decOrDyColor &&
+        maxDur == rhs.maxDur && maxMass == rhs.maxMass && maxSNR == rhs.maxSNR;
 }
 
-static double GetMaxStarSNR(const circular_buffer<S_HISTORY>& history, int start_item)
+// Draw the background, the horizontal axis and the history from item begin
+// onwards, where the sample number of the left edge is first. Only the part
+// of the plot right of clipLeft is touched.
+void GraphLogClientWindow::DrawPlot(wxDC& dc, const PlotKey& key, long long first, unsigned int begin, int clipLeft)
 {
-    double maxSNR = 0.0;
-    for (unsigned int i = start_item; i < history.size(); i++)
+    const wxSize& size = key.size;
+    const int leftEdge = 0;
+    const int rightEdge = size.x - GRAPH_BORDER;
+    const int topEdge = GRAPH_BORDER;
+    const int yorig = size.y / 2;
+
+    if (clipLeft > 0)
+        dc.SetClippingRegion(clipLeft, 0, size.x - clipLeft, size.y);
+
+    dc.SetPen(*wxBLACK_PEN);
+    dc.SetBrush(*wxBLACK_BRUSH);
+    dc.DrawRectangle(clipLeft, 0, size.x - clipLeft, size.y);
+
+    dc.SetPen(*wxGREY_PEN);
+    dc.DrawLine(leftEdge, yorig, rightEdge, yorig);
+
+    unsigned int const end = m_history.size();
+    if (begin < end)
     {
-        const S_HISTORY& h = history[i];
-        if (h.starSNR > maxSNR)
-            maxSNR = h.starSNR;
+        long long const base = m_sampleCount - m_history.size();   // sample number of m_history[0]
+        PlotX px(key.xmag, first);
+        unsigned int const n = end - begin;
+
+        if (key.showCorrections)
+        {
+            const double ymag = (size.y - 10) * 0.5 / (double) key.maxDur;
+
+            dc.SetBrush(*wxTRANSPARENT_BRUSH);
+            dc.SetPen(wxPen(key.raOrDxColor.ChangeLightness(60)));
+
+            for (unsigned int i = begin; i < end; i++)
+            {
+                const S_HISTORY& h = m_history[i];
+
+                if (h.raDur != 0)
+                {
+                    // West corrections => Up on graph
+                    const int raDur = h.ra > 0.0 ? -h.raDur : h.raDur;
+                    wxPoint pt(px.x(base + i), yorig + (int)(raDur * ymag));
+                    if (raDur < 0)
+                        dc.DrawRectangle(pt, wxSize(4, yorig - pt.y));
+                    else
+                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
+                }
+            }
+
+            dc.SetPen(wxPen(key.decOrDyColor.ChangeLightness(60)));
+
+            for (unsigned int i = begin; i < end; i++)
+            {
+                const S_HISTORY& h = m_history[i];
+
+                if (h.decDur != 0)
+                {
+                    // North Corrections => Up on graph
+                    const int decDur = h.dec > 0.0 ? h.decDur : -h.decDur;
+                    wxPoint pt(px.x(base + i) + 5, yorig + (int)(decDur * ymag));
+                    if (decDur < 0)
+                        dc.DrawRectangle(pt,wxSize(4, yorig - pt.y));
+                    else
+                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
+                }
+            }
+        }
+
+        if (key.showStarMass)
+        {
+            const double ymag = (size.y - 10) * 0.5 / key.maxMass;
+
+            for (unsigned int i = begin; i < end; i++)
+                m_line1[i - begin] = wxPoint(px.x(base + i), yorig + (int)(m_history[i].starMass * -ymag));
+
+            dc.SetPen(*wxYELLOW_PEN);
+            dc.DrawLines(n, m_line1);
+        }
+
+        if (key.showStarSNR)
+        {
+            const double ymag = (size.y - 10) * 0.5 / key.maxSNR;
+
+            for (unsigned int i = begin; i < end; i++)
+                m_line1[i - begin] = wxPoint(px.x(base + i), yorig + (int)(m_history[i].starSNR * -ymag));
+
+            dc.SetPen(*wxWHITE_PEN);
+            dc.DrawLines(n, m_line1);
+        }
+
+        dc.SetTextForeground(*wxLIGHT_GREY);
+        dc.SetFont(GraphSmallFont());
+
+        // a dither is labelled at the first sample after it
+        const std::deque<DitherInfo>& dithers = Telemetry.Dithers();
+        std::deque<DitherInfo>::const_iterator it = dithers.begin();
+        {
+            const S_HISTORY& h = m_history[begin > 0 ? begin - 1 : 0];
+            while (it != dithers.end() && it->timestamp < h.timestamp)
+                ++it;
+        }
+
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const S_HISTORY& h = m_history[i];
+
+            if (it != dithers.end() && it->timestamp < h.timestamp)
+            {
+                wxPoint pt(px.x((double)(base + i) - 0.5), topEdge + 6);
+                dc.DrawText(_("Dither"), pt);
+                ++it;
+            }
+
+            int const x = px.x(base + i);
+            switch (key.mode)
+            {
+            case MODE_RADEC:
+                m_line1[i - begin] = wxPoint(x, yorig + (int)(h.ra * key.ymag));
+                m_line2[i - begin] = wxPoint(x, yorig + (int)(-h.dec * key.ymag)); // North corrections Up, North offsets down
+                break;
+            case MODE_DXDY:
+                m_line1[i - begin] = wxPoint(x, yorig + (int)(h.dx * key.ymag));
+                m_line2[i - begin] = wxPoint(x, yorig + (int)(h.dy * key.ymag));
+                break;
+            }
+        }
+
+        dc.SetPen(wxPen(key.raOrDxColor, 2));
+        dc.DrawLines(n, m_line1);
+
+        dc.SetPen(wxPen(key.decOrDyColor, 2));
+        dc.DrawLines(n, m_line2);
     }
-    return maxSNR;
-}
 
-enum { GRAPH_BORDER = 5 };
+    if (clipLeft > 0)
+        dc.DestroyClippingRegion();
+}
 
 void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
 {
@@ -1185,6 +1303,9 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
     wxSize size(GetClientSize());
     wxSize center(size.x / 2, size.y / 2);
 
+    if (size.x < 1 || size.y < 1)
+        return;
+
     const int leftEdge = 0;
     const int rightEdge = size.x - GRAPH_BORDER;
 
@@ -1206,15 +1327,92 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
         units = UNIT_PIXELS;
     }
 
-    dc.SetBackground(*wxBLACK_BRUSH);
-    dc.Clear();
+    const double xmag = size.x / (double) m_length;
+    const double ymag = yPixelsPerDivision * (double)(m_yDivisions + 1) / (double)m_height * (units == UNIT_ARCSEC ? sampling : 1.0);
+
+    ScaleAndTranslate sctr(xorig, yorig, xmag, ymag);
+
+    unsigned int plot_length = GetItemCount();
+    unsigned int start_item = m_history.size() - plot_length;
+    long long const first = m_sampleCount - plot_length;
+
+    PlotKey key;
+    key.size = size;
+    key.xmag = xmag;
+    key.ymag = ymag;
+    key.mode = m_mode;
+    key.showCorrections = m_showCorrections;
+    key.showStarMass = m_showStarMass;
+    key.showStarSNR = m_showStarSNR;
+    key.raOrDxColor = m_raOrDxColor;
+    key.decOrDyColor = m_decOrDyColor;
+    GraphWindowPeaks peaks = GetPeaks();
+    key.maxDur = m_showCorrections ? wxMax(peaks.duration, 1) : 1;     // at least 1 to protect against divide-by-zero
+    key.maxMass = m_showStarMass ? peaks.starMass : 0.0;
+    key.maxSNR = m_showStarSNR ? peaks.starSNR : 0.0;
+
+    if (!m_plot.IsOk() || m_plot.GetWidth() != size.x || m_plot.GetHeight() != size.y)
+    {
+        m_plot.Create(size.x, size.y);
+        m_plotScratch.Create(size.x, size.y);
+        m_plotValid = false;
+    }
+
+    // when only new samples were added, scroll the cached plot left and
+    // draw just the part right of the last sample already on it
+    bool scrolled = false;
+    if (m_plotValid && key == m_plotKey && plot_length > 0 && first >= m_plotFirst &&
+        m_sampleCount > m_plotSamples && m_sampleCount - m_plotSamples < (long long) plot_length)
+    {
+        PlotX px(xmag, first);
+        int const dx = px.m_x0 - PlotX(xmag, m_plotFirst).m_x0;
+        int const clipLeft = px.x(m_plotSamples - 1) + 1;
+
+        if (dx < size.x && clipLeft > 0)
+        {
+            wxMemoryDC src(m_plot);
+            wxMemoryDC dst(m_plotScratch);
+            dst.SetFont(GraphSmallFont());
+
+            // the first sample whose line, correction bars or dither label
+            // can reach the redrawn part
+            int const margin = dst.GetTextExtent(_("Dither")).GetWidth() + 10;
+            long long const base = m_sampleCount - m_history.size();
+            unsigned int begin = m_history.size() - 1;
+            while (begin > start_item && px.x(base + begin) >= clipLeft - margin)
+                --begin;
+
+            dst.Blit(0, 0, size.x - dx, size.y, &src, dx, 0);
+            DrawPlot(dst, key, first, begin, clipLeft);
+            scrolled = true;
+        }
+
+        if (scrolled)
+        {
+            wxBitmap tmp = m_plot;
+            m_plot = m_plotScratch;
+            m_plotScratch = tmp;
+        }
+    }
+
+    if (!scrolled)
+    {
+        wxMemoryDC mdc(m_plot);
+        DrawPlot(mdc, key, first, start_item, 0);
+    }
+
+    m_plotKey = key;
+    m_plotValid = true;
+    m_plotFirst = first;
+    m_plotSamples = m_sampleCount;
+
+    dc.DrawBitmap(m_plot, 0, 0, false);
 
     wxPen GreyDashPen(wxColour(200,200,200),1, wxDOT);
 
     // Draw axes
     dc.SetPen(*wxGREY_PEN);
     dc.DrawLine(center.x,topEdge,center.x,bottomEdge);
-    dc.DrawLine(leftEdge,center.y,rightEdge,center.y);
 
     // draw a box around the client area
     dc.DrawLine(leftEdge, topEdge, rightEdge, topEdge);
@@ -1225,12 +1423,7 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
     // Draw horiz rule (scale is 1 pixel error per 25 pixels) + scale labels
     dc.SetPen(GreyDashPen);
     dc.SetTextForeground(*wxLIGHT_GREY);
-    const wxFont& SmallFont =
-#if defined(__WXOSX__)
-        *wxSMALL_FONT;
-#else
-        *wxSWISS_FONT;
-#endif
+    const wxFont& SmallFont = GraphSmallFont();
     dc.SetFont(SmallFont);
 
     for (int i = 1; i <= m_yDivisions; i++)
@@ -1250,11 +1443,6 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
         dc.DrawLine(center.x + i * xPixelsPerDivision, topEdge, center.x + i * xPixelsPerDivision, bottomEdge);
     }
 
-    const double xmag = size.x / (double) m_length;
-    const double ymag = yPixelsPerDivision * (double)(m_yDivisions + 1) / (double)m_height * (units == UNIT_ARCSEC ? sampling : 1.0);
-
-    ScaleAndTranslate sctr(xorig, yorig, xmag, ymag);
-
     if (m_showCorrections && !(pMount && pMount->IsStepGuider()))
     {
         wxString lblN(_("GuideNorth"));
@@ -1274,131 +1462,10 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
         dc.SetFont(SmallFont);
     }
 
-    // Draw data
     if (m_history.size() > 0)
     {
-        unsigned int plot_length = GetItemCount();
-        unsigned int start_item = m_history.size() - plot_length;
-
-        if (m_showCorrections)
-        {
-            int maxDur = GetMaxDuration(m_history, start_item);
-
-            const double ymag = (size.y - 10) * 0.5 / (double) maxDur;
-            ScaleAndTranslate sctr(xorig, yorig, xmag, ymag);
-
-            dc.SetBrush(*wxTRANSPARENT_BRUSH);
-            dc.SetPen(wxPen(m_raOrDxColor.ChangeLightness(60)));
-
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-
-                if (h.raDur != 0)
-                {
-                    // West corrections => Up on graph
-                    const int raDur = h.ra > 0.0 ? -h.raDur : h.raDur;
-                    wxPoint pt(sctr.pt(j, raDur));
-                    if (raDur < 0)
-                        dc.DrawRectangle(pt, wxSize(4, yorig - pt.y));
-                    else
-                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
-                }
-            }
-
-            dc.SetPen(wxPen(m_decOrDyColor.ChangeLightness(60)));
-
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-
-                if (h.decDur != 0)
-                {
-                    // North Corrections => Up on graph
-                    const int decDur = h.dec > 0.0 ? h.decDur : -h.decDur;
-                    wxPoint pt(sctr.pt(j, decDur));
-                    pt.x += 5;
-                    if (decDur < 0)
-                        dc.DrawRectangle(pt,wxSize(4, yorig - pt.y));
-                    else
-                        dc.DrawRectangle(wxPoint(pt.x, yorig), wxSize(4, pt.y - yorig));
-                }
-            }
-        }
-
-        if (m_showStarMass)
-        {
-            double maxMass = GetMaxStarMass(m_history, start_item);
-
-            const double ymag = (size.y - 10) * 0.5 / maxMass;
-            ScaleAndTranslate sctr(xorig, yorig, xmag, -ymag);
-
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-                m_line1[j] = sctr.pt(j, h.starMass);
-            }
-
-            dc.SetPen(*wxYELLOW_PEN);
-            dc.DrawLines(plot_length, m_line1);
-        }
-
-        if (m_showStarSNR)
-        {
-            double maxSNR = GetMaxStarSNR(m_history, start_item);
-
-            const double ymag = (size.y - 10) * 0.5 / maxSNR;
-            ScaleAndTranslate sctr(xorig, yorig, xmag, -ymag);
-
-            for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-            {
-                const S_HISTORY& h = m_history[i];
-                m_line1[j] = sctr.pt(j, h.starSNR);
-            }
-
-            dc.SetPen(*wxWHITE_PEN);
-            dc.DrawLines(plot_length, m_line1);
-        }
-
-        std::deque<DitherInfo>::const_iterator it = m_dithers.begin();
-        { // advance to the first dither that will show on the plot
-            const S_HISTORY& h = m_history[start_item];
-            while (it != m_dithers.end() && it->timestamp < h.timestamp)
-                ++it;
-        }
-
-        for (unsigned int i = start_item, j = 0; i < m_history.size(); i++, j++)
-        {
-            const S_HISTORY& h = m_history[i];
-
-            if (it != m_dithers.end() && it->timestamp < h.timestamp)
-            {
-                wxPoint pt(sctr.pt((double) j - 0.5, 0.0));
-                pt.y = topEdge + 6;
-                dc.DrawText(_("Dither"), pt);
-                ++it;
-            }
-
-            switch (m_mode)
-            {
-            case MODE_RADEC:
-                m_line1[j] = sctr.pt(j, h.ra);
-                m_line2[j] = sctr.pt(j, -h.dec); // North corrections Up, North offsets down
-                break;
-            case MODE_DXDY:
-                m_line1[j] = sctr.pt(j, h.dx);
-                m_line2[j] = sctr.pt(j, h.dy);
-                break;
-            }
-        }
-
         wxPen raOrDxPen(m_raOrDxColor, 2);
-        dc.SetPen(raOrDxPen);
-        dc.DrawLines(plot_length, m_line1);
-
         wxPen decOrDyPen(m_decOrDyColor, 2);
-        dc.SetPen(decOrDyPen);
-        dc.DrawLines(plot_length, m_line2);
 
         // draw trend lines
         double polarAlignCircleRadius = 0.0;
@@ -1439,7 +1506,7 @@ void GraphLogClientWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
             // show polar alignment error
             if (m_mode == MODE_RADEC && sampling != 1.0 && pMount && pMount->IsDecDrifting())
             {
-                double declination = pPointingSource->GetDeclination();
+                double declination = PointingCache::Declination();
                 if (declination == UNKNOWN_DECLINATION) // assume declination 0
                     declination = 0.0;
 
@@ -1507,6 +1574,7 @@ void GraphLogClientWindow::OnLeftBtnDown(wxMouseEvent& evt)
             if (i < m_history.size())
             {
                 m_history.pop_back(i);
+                m_plotValid = false;
                 RecalculateTrendLines();
                 Refresh();
             }
@@ -53,34 +53,6 @@ struct TrendLineAccum
     double sum_y2;
 };
 
-struct S_HISTORY
-{
-    wxLongLong_t timestamp;
-    double dx;
-    double dy;
-    double ra;
-    double dec;
-    int raDur;
-    int decDur;
-    double starSNR;
-    double starMass;
-    bool raLimited;
-    bool decLimited;
-    S_HISTORY() { }
-    S_HISTORY(const GuideStepInfo& step)
-        : timestamp(::wxGetUTCTimeMillis().GetValue()),
-        dx(step.cameraOffset.X), dy(step.cameraOffset.Y), ra(step.mountOffset.X), dec(step.mountOffset.Y),
-        raDur(step.durationRA), decDur(step.durationDec), starSNR(step.starSNR), starMass(step.starMass),
-        raLimited(step.raLimited), decLimited(step.decLimited) { }
-};
-
-struct DitherInfo
-{
-    wxLongLong_t timestamp;
-    double dRa;
-    double dDec;
-};
-
 struct SummaryStats
 {
     S_HISTORY cur;
@@ -96,6 +68,16 @@ struct SummaryStats
     unsigned int dec_limit_cnt;
 };
 
+// extremes over the samples shown on the graph
+struct GraphWindowPeaks
+{
+    double ra;                  // largest RA offset, absolute value, pixels
+    double dec;
+    int duration;               // longest RA or Dec correction, ms
+    double starMass;
+    double starSNR;
+};
+
 class GraphLogClientWindow : public wxWindow
 {
 public:
@@ -117,8 +99,7 @@ private:
     unsigned int m_minHeight;
     unsigned int m_maxHeight;
 
-    circular_buffer<S_HISTORY> m_history;
-    std::deque<DitherInfo> m_dithers;
+    TelemetryView m_history;    // the session telemetry shown on the graph
 
     wxPoint *m_line1;
     wxPoint *m_line2;
@@ -127,6 +108,13 @@ private:
     int m_raSameSides; // accumulator for RA osc index
     SummaryStats m_stats;
 
+    // sliding window maxima over the last m_length samples
+    sliding_max<double> m_peakRa;
+    sliding_max<double> m_peakDec;
+    sliding_max<int> m_peakDuration;
+    sliding_max<double> m_peakMass;
+    sliding_max<double> m_peakSNR;
+
     GRAPH_MODE m_mode;
 
     unsigned int m_length;
@@ -138,6 +126,36 @@ private:
     bool m_showStarMass;
     bool m_showStarSNR;
 
+    // The plotted data and the horizontal rules under it are kept in a bitmap
+    // that is scrolled left and extended for new samples; the rest of the
+    // graph is drawn over it on each paint. Anything else that changes the
+    // plot means a full redraw.
+    struct PlotKey
+    {
+        wxSize size;
+        double xmag;
+        double ymag;
+        GRAPH_MODE mode;
+        bool showCorrections;
+        bool showStarMass;
+        bool showStarSNR;
+        wxColour raOrDxColor;
+        wxColour decOrDyColor;
+        int maxDur;
+        double maxMass;
+        double maxSNR;
+
+        bool operator==(const PlotKey& rhs) const;
+    };
+
+    wxBitmap m_plot;
+    wxBitmap m_plotScratch;
+    PlotKey m_plotKey;
+    bool m_plotValid;
+    long long m_plotFirst;      // sample number of the first sample on the cached plot
+    long long m_plotSamples;    // m_sampleCount when the plot was last drawn
+    long long m_sampleCount;    // guide steps appended since the data was reset
+
     friend class GraphLogWindow;
 
 public:
@@ -151,16 +169,18 @@ public:
 
     void AppendData(const GuideStepInfo& step);
     void AppendData(const FrameDroppedInfo& info);
-    void AppendData(const DitherInfo& info);
 
     unsigned int GetItemCount() const;
+    GraphWindowPeaks GetPeaks() const;
 
     void ResetData(void);
 
 private:
     void RecalculateTrendLines(void);
+    void PushPeaks(const S_HISTORY& h);
     void UpdateStats(unsigned int nr, const S_HISTORY *cur);
 
+    void DrawPlot(wxDC& dc, const PlotKey& key, long long first, unsigned int begin, int clipLeft);
     void OnPaint(wxPaintEvent& evt);
     void OnLeftBtnDown(wxMouseEvent& evt);
 
@@ -211,7 +231,6 @@ public:
 
     void AppendData(const GuideStepInfo& step);
     void AppendData(const FrameDroppedInfo& info);
-    void AppendData(const DitherInfo& info);
 
     void UpdateControls(void);
     void SetState(bool is_active);
@@ -248,6 +267,7 @@ public:
     const wxColor& GetDecOrDyColor(void);
 
     const SummaryStats& Stats(void) const { return m_pClient->m_stats; }
+    GraphWindowPeaks GetPeaks(void) const { return m_pClient->GetPeaks(); }
 
     DECLARE_EVENT_TABLE()
 };
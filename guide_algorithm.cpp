@@ -41,7 +41,10 @@
 
 wxString GuideAlgorithm::GetConfigPath()
 {
-    return "/" + m_pMount->GetMountClassName() + "/GuideAlgorithm/" +
+    // an algorithm without a mount (see backtest.cpp) keeps its settings
+    // apart from the real ones
+    wxString mountClass = m_pMount ? m_pMount->GetMountClassName() : wxString("backtest");
+    return "/" + mountClass + "/GuideAlgorithm/" +
         (m_guideAxis == GUIDE_X ? "X/" : "Y/") + GetGuideAlgorithmClassName();
 }
 
@@ -68,7 +71,7 @@ double GuideAlgorithm::SmartDefaultMinMove()
         double focalLength = pFrame->GetFocalLength();
         if (focalLength != 0)
         {
-            double imageScale = MyFrame::GetPixelScale(pCamera->GetCameraPixelSize(), focalLength, pCamera->Binning);
+            double imageScale = MyFrame::GetPixelScale(pCamera->GetCameraPixelSize(), focalLength, pCamera->EffectiveBinning());
             // Following based on empirical data using a range of image scales - same as profile wizard
             return wxMax(0.1515 + 0.1548 / imageScale, 0.15);
         }
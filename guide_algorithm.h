@@ -96,6 +96,21 @@ public:
     virtual wxString GetGuideAlgorithmClassName(void) const = 0;
     virtual double GetMinMove(void) { return -1.0; };
     virtual bool SetMinMove(double minMove) { return true; };       // true indicates error
+
+    // Named access to the settings, for callers that drive an algorithm without
+    // its config dialog. Unlike the setters above, GetParam() and SetParam()
+    // return true on success, false for an unknown name or a rejected value.
+    virtual void GetParamNames(wxArrayString& names) const { }
+    virtual bool GetParam(const wxString& name, double *val) { return false; }
+    virtual bool SetParam(const wxString& name, double val) { return false; }
+
+    // What the algorithm has learned while guiding, for a session snapshot.
+    // Empty for an algorithm with nothing worth keeping. RestoreState takes
+    // the string back along with when it was saved (UTC ms) and returns true
+    // on error; the state must not be applied before guiding starts.
+    virtual wxString SaveState(void) { return wxEmptyString; }
+    virtual bool RestoreState(const wxString& state, wxLongLong_t savedAtMs) { return !state.IsEmpty(); }
+
     wxString GetConfigPath();
     wxString GetAxis();
     virtual void ResetParams();     // Override if fine-tuned logic is needed by a particular algo
@@ -0,0 +1,150 @@
+/*
+ *  guide_algorithm_chain.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+static const char *DefaultSpec = "hysteresis > limit";
+
+GuideAlgorithmChain::GuideAlgorithmChain(Mount *pMount, GuideAxis axis)
+    : GuideAlgorithm(pMount, axis)
+{
+    wxString spec = pConfig->Profile.GetString(GetConfigPath() + "/spec", DefaultSpec);
+    wxString err;
+    if (SetSpec(spec, &err))
+    {
+        Debug.Write(wxString::Format("GuideAlgorithmChain: bad spec '%s' (%s), using default\n", spec, err));
+        SetSpec(DefaultSpec, &err);
+    }
+}
+
+GuideAlgorithmChain::~GuideAlgorithmChain(void)
+{
+}
+
+GUIDE_ALGORITHM GuideAlgorithmChain::Algorithm(void)
+{
+    return GUIDE_ALGORITHM_CHAIN;
+}
+
+void GuideAlgorithmChain::reset(void)
+{
+    m_chain.Reset();
+}
+
+double GuideAlgorithmChain::result(double input)
+{
+    double dReturn = m_chain.Step(input);
+
+    Debug.Write(wxString::Format("GuideAlgorithmChain::Result() returns %.2f from input %.2f\n", dReturn, input));
+
+    return dReturn;
+}
+
+bool GuideAlgorithmChain::SetSpec(const wxString& spec, wxString *errorMsg)
+{
+    if (m_chain.Parse(spec, errorMsg))
+        return true;
+
+    pConfig->Profile.SetString(GetConfigPath() + "/spec", m_chain.Format());
+
+    return false;
+}
+
+wxString GuideAlgorithmChain::GetSettingsSummary()
+{
+    // return a loggable summary of current mount settings
+    return wxString::Format("Chain = %s\n", m_chain.Format());
+}
+
+void GuideAlgorithmChain::GetParamNames(wxArrayString& names) const
+{
+    m_chain.GetParamNames(names);
+}
+
+bool GuideAlgorithmChain::GetParam(const wxString& name, double *val)
+{
+    return m_chain.GetParam(name, val);
+}
+
+bool GuideAlgorithmChain::SetParam(const wxString& name, double val)
+{
+    if (!m_chain.SetParam(name, val))
+        return false;
+    pConfig->Profile.SetString(GetConfigPath() + "/spec", m_chain.Format());
+    return true;
+}
+
+ConfigDialogPane *GuideAlgorithmChain::GetConfigDialogPane(wxWindow *pParent)
+{
+    return new GuideAlgorithmChainConfigDialogPane(pParent, this);
+}
+
+GuideAlgorithmChain::
+    GuideAlgorithmChainConfigDialogPane::
+    GuideAlgorithmChainConfigDialogPane(wxWindow *pParent, GuideAlgorithmChain *pGuideAlgorithm)
+    : ConfigDialogPane(_("Guide Algorithm Chain"), pParent)
+{
+    m_pGuideAlgorithm = pGuideAlgorithm;
+
+    m_pSpec = new wxTextCtrl(pParent, wxID_ANY, wxEmptyString, wxDefaultPosition,
+        wxSize(StringWidth(_T("hysteresis(minMove=0.20) > resistswitch > limit(max=5)")), -1));
+
+    DoAdd(_("Stages"), m_pSpec,
+        _("The stages the correction passes through, separated by >, each with optional settings, e.g.\n"
+        "hysteresis(minMove=0.2,hysteresis=0.1,aggression=0.7) > resistswitch(fastSwitch=1) > lowpass(slopeWeight=5) > limit(max=3,dir=1)"));
+}
+
+GuideAlgorithmChain::
+    GuideAlgorithmChainConfigDialogPane::
+    ~GuideAlgorithmChainConfigDialogPane(void)
+{
+}
+
+void GuideAlgorithmChain::
+    GuideAlgorithmChainConfigDialogPane::
+    LoadValues(void)
+{
+    m_pSpec->SetValue(m_pGuideAlgorithm->GetSpec());
+}
+
+void GuideAlgorithmChain::
+    GuideAlgorithmChainConfigDialogPane::
+    UnloadValues(void)
+{
+    wxString err;
+    if (m_pGuideAlgorithm->SetSpec(m_pSpec->GetValue(), &err))
+    {
+        wxMessageBox(wxString::Format(_("The guide algorithm chain was not changed: %s"), err), _("Guide Algorithm Chain"),
+            wxOK | wxICON_ERROR);
+    }
+}
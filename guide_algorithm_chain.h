@@ -0,0 +1,82 @@
+/*
+ *  guide_algorithm_chain.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_ALGORITHM_CHAIN_H_INCLUDED
+#define GUIDE_ALGORITHM_CHAIN_H_INCLUDED
+
+// A guide algorithm made of a GuideChain of stages, so hysteresis, resist
+// switch, lowpass and a limit can be stacked without a class per combination.
+// The spec is kept in the profile; see guide_chain.h for its syntax.
+class GuideAlgorithmChain : public GuideAlgorithm
+{
+    GuideChain m_chain;
+
+protected:
+    class GuideAlgorithmChainConfigDialogPane : public ConfigDialogPane
+    {
+        GuideAlgorithmChain *m_pGuideAlgorithm;
+        wxTextCtrl *m_pSpec;
+
+    public:
+        GuideAlgorithmChainConfigDialogPane(wxWindow *pParent, GuideAlgorithmChain *pGuideAlgorithm);
+        virtual ~GuideAlgorithmChainConfigDialogPane(void);
+
+        virtual void LoadValues(void);
+        virtual void UnloadValues(void);
+    };
+
+    friend class GuideAlgorithmChainConfigDialogPane;
+
+public:
+    GuideAlgorithmChain(Mount *pMount, GuideAxis axis);
+    virtual ~GuideAlgorithmChain(void);
+
+    virtual GUIDE_ALGORITHM Algorithm(void);
+
+    virtual void reset(void);
+    virtual double result(double input);
+    virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
+    virtual wxString GetSettingsSummary();
+    virtual void GetParamNames(wxArrayString& names) const;
+    virtual bool GetParam(const wxString& name, double *val);
+    virtual bool SetParam(const wxString& name, double val);
+    virtual wxString GetGuideAlgorithmClassName(void) const { return "Chain"; }
+
+    // returns true on error, leaving the chain unchanged
+    bool SetSpec(const wxString& spec, wxString *errorMsg);
+    wxString GetSpec(void) const { return m_chain.Format(); }
+
+    const GuideChain& Chain(void) const { return m_chain; }
+};
+
+#endif /* GUIDE_ALGORITHM_CHAIN_H_INCLUDED */
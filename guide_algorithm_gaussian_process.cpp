@@ -36,11 +36,15 @@
 
 #include "UDPGuidingInteraction.h"
 #include "tools/circular_buffer.h"
+#include "gaussian_process/gp_optimizer.h"
+#include "gaussian_process/incremental_gp.h"
+#include "gaussian_process/sparse_gp.h"
 
 #include "guide_algorithm_gaussian_process.h"
 #include <wx/stopwatch.h>
-#include "tools/math_tools.h"
-#include "UDPGuidingInteraction.h"
+#include <wx/tokenzr.h>
+
+#include <cmath>
 
 
 class GuideGaussianProcess::GuideGaussianProcessDialogPane : public ConfigDialogPane
@@ -90,40 +94,304 @@ public:
 
 
 
+// Fits the GP hyperparameters on a background thread. The guide thread hands
+// over a snapshot of the samples with Submit() when a fit is due and picks up
+// the fitted hyperparameters with TakeResult(), so the worker never touches
+// the GP and a fit never delays a guide step. The CPU a fit may use is capped
+// by an iteration limit and a time limit, and the worker runs at the lowest
+// thread priority.
+class GPHyperparameterOptimizer
+{
+    class Worker : public wxThread
+    {
+        GPHyperparameterOptimizer& m_optimizer;
+    public:
+        Worker(GPHyperparameterOptimizer& optimizer) : wxThread(wxTHREAD_JOINABLE), m_optimizer(optimizer) { }
+        ExitCode Entry() { PerfTrace::SetThreadName("gp optimizer"); ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "gp optimizer"); m_optimizer.WorkerLoop(); return (ExitCode) 0; }
+    };
+
+public:
+    struct Fit
+    {
+        gp_optimizer::Result result;
+        int points;
+        double elapsed_ms;
+    };
+
+private:
+    wxMutex m_lock;
+    wxCondition m_workCond;
+    Worker *m_worker;
+    volatile bool m_cancel;         // ends a fit in progress
+
+    // protected by m_lock
+    bool m_stop;
+    bool m_busy;                    // a snapshot is waiting or being fitted
+    bool m_haveFit;
+    Eigen::VectorXd m_x;
+    Eigen::VectorXd m_y;
+    gp_optimizer::Hyperparameters m_start;
+    Fit m_fit;
+
+    int m_maxIterations;
+    int m_maxMs;
+    Eigen::VectorXi m_fixed;
+
+    void WorkerLoop(void);
+
+public:
+    GPHyperparameterOptimizer(int maxIterations, int maxMs, bool fitPeriod);
+    ~GPHyperparameterOptimizer();
+
+    bool Start(void);
+    bool Busy(void);
+    void Submit(const Eigen::VectorXd& x, const Eigen::VectorXd& y, const gp_optimizer::Hyperparameters& start);
+    bool TakeResult(Fit *fit);
+};
+
+GPHyperparameterOptimizer::GPHyperparameterOptimizer(int maxIterations, int maxMs, bool fitPeriod)
+    : m_workCond(m_lock),
+      m_worker(0),
+      m_cancel(false),
+      m_stop(false),
+      m_busy(false),
+      m_haveFit(false),
+      m_maxIterations(maxIterations),
+      m_maxMs(maxMs),
+      m_fixed(Eigen::VectorXi::Zero(gp_optimizer::NUM_HYPERPARAMETERS))
+{
+    // the period is usually known from the mount's gearing
+    if (!fitPeriod)
+        m_fixed[4] = 1;
+}
+
+GPHyperparameterOptimizer::~GPHyperparameterOptimizer()
+{
+    {
+        wxMutexLocker lck(m_lock);
+        m_stop = true;
+        m_cancel = true;
+        m_workCond.Broadcast();
+    }
+
+    if (m_worker)
+    {
+        m_worker->Wait();
+        delete m_worker;
+    }
+}
+
+bool GPHyperparameterOptimizer::Start(void)
+{
+    Worker *worker = new Worker(*this);
+    if (worker->Create() != wxTHREAD_NO_ERROR)
+    {
+        delete worker;
+        return true;
+    }
+    worker->SetPriority(WXTHREAD_MIN_PRIORITY);
+    if (worker->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete worker;
+        return true;
+    }
+    m_worker = worker;
+    return false;
+}
+
+bool GPHyperparameterOptimizer::Busy(void)
+{
+    wxMutexLocker lck(m_lock);
+    return m_busy;
+}
+
+void GPHyperparameterOptimizer::Submit(const Eigen::VectorXd& x, const Eigen::VectorXd& y, const gp_optimizer::Hyperparameters& start)
+{
+    wxMutexLocker lck(m_lock);
+    if (m_busy)
+        return;
+    m_x = x;
+    m_y = y;
+    m_start = start;
+    m_busy = true;
+    m_workCond.Signal();
+}
+
+bool GPHyperparameterOptimizer::TakeResult(Fit *fit)
+{
+    wxMutexLocker lck(m_lock);
+    if (!m_haveFit)
+        return false;
+    *fit = m_fit;
+    m_haveFit = false;
+    return true;
+}
+
+void GPHyperparameterOptimizer::WorkerLoop(void)
+{
+    wxMutexLocker lck(m_lock);
+
+    while (true)
+    {
+        while (!m_stop && !m_busy)
+            m_workCond.Wait();
+        if (m_stop)
+            break;
+
+        Eigen::VectorXd x(m_x);
+        Eigen::VectorXd y(m_y);
+        gp_optimizer::Hyperparameters start(m_start);
+
+        m_lock.Unlock();
+
+        wxStopWatch swatch;
+        int const maxMs = m_maxMs;
+        volatile bool *cancel = &m_cancel;
+        Fit fit;
+        // the prior keeps the fit within about a factor e of the starting
+        // values unless the data insist
+        fit.result = gp_optimizer::optimize(start, x, y, m_fixed, 1.0, m_maxIterations,
+            [&swatch, maxMs, cancel]() { return !*cancel && swatch.Time() < maxMs; });
+        fit.points = (int) x.size();
+        fit.elapsed_ms = swatch.TimeInMicro().ToDouble() / 1000.0;
+
+        m_lock.Lock();
+
+        m_fit = fit;
+        m_haveFit = true;
+        m_busy = false;
+    }
+}
+
 // parameters of the GP guiding algorithm
+//
+// The GP models the drift rate the mount would show without guiding, as a
+// function of time. Each measurement after the first gives one sample: the
+// distance the star moved over the interval, less the correction applied at
+// its start, divided by the length of the interval, at the middle of the
+// interval. The correction for the next interval is the proportional
+// correction of the current error plus the drift the GP predicts for it.
+//
+// The exact GP keeps its Cholesky factor from step to step, so a sample costs
+// O(n^2) in the length of its window. For hours of history the sparse mode
+// instead models only the periodic error, through inducing points spread over
+// one period, at a cost per sample that does not depend on the window.
 struct GuideGaussianProcess::gp_guide_parameters
 {
     UDPGuidingInteraction udpInteraction;
-    CircularDoubleBuffer timestamps_;
+    CircularDoubleBuffer timestamps_;               // interval mid-points, ms, for the UDP debug mode
     CircularDoubleBuffer measurements_;
-    CircularDoubleBuffer modified_measurements_;
+    CircularDoubleBuffer modified_measurements_;    // uncorrected drift rate over each interval, px/s
     wxStopWatch timer_;
-    double control_signal_;
+    double control_signal_;                         // correction returned for the previous measurement
     int number_of_measurements_;
     double control_gain_;
     double elapsed_time_ms_;
-
-    gp_guide_parameters() :
+    double delta_measurement_time_ms_;
+    bool udp_debug_;                                // send the data to an external process instead of running the GP
+    gp_optimizer::Hyperparameters hyper_;          // in use by the GPs
+    IncrementalGP gp_;                              // exact GP over the latest samples
+    SparseGP *sparse_gp_;                           // replaces gp_ in sparse mode
+    int inducing_points_;
+    GPHyperparameterOptimizer *optimizer_;          // fits hyper_ in the background, if enabled
+    int optimize_interval_ms_;
+    int fit_points_;                                // samples in each fit
+    double last_fit_ms_;                            // on timer_, when the last snapshot was submitted
+    wxLongLong_t first_exposure_us_;                // mid-exposure time of the first measurement, 0 if not known
+    std::vector<double> restored_x_;                // samples from RestoreState, s before restored_at_ms_,
+    std::vector<double> restored_y_;                //   added to the GP with the first measurement
+    wxLongLong_t restored_at_ms_;
+
+    gp_guide_parameters(const gp_optimizer::Hyperparameters& hyper, int window, int sparse_window, int inducing_points) :
       udpInteraction(_T("localhost"), _T("1308"), _T("1309")),
-      timestamps_(100),
-      measurements_(100),
-      modified_measurements_(100),
+      timestamps_(MAX_POINTS),
+      measurements_(MAX_POINTS),
+      modified_measurements_(MAX_POINTS),
       timer_(),
       control_signal_(0.0),
       number_of_measurements_(0),
-      elapsed_time_ms_(0.0)
+      control_gain_(0.0),
+      elapsed_time_ms_(0.0),
+      delta_measurement_time_ms_(0.0),
+      udp_debug_(false),
+      hyper_(hyper),
+      gp_(covariance_functions::PeriodicSquareExponential(hyper.covariance), hyper.noise_sd * hyper.noise_sd, window),
+      sparse_gp_(0),
+      inducing_points_(inducing_points),
+      optimizer_(0),
+      optimize_interval_ms_(0),
+      fit_points_(0),
+      last_fit_ms_(0.0),
+      first_exposure_us_(0),
+      restored_at_ms_(0)
+    {
+        if (sparse_window > 0)
+        {
+            sparse_gp_ = new SparseGP(SparseCovariance(), hyper_.noise_sd * hyper_.noise_sd, SparseInducing(),
+                                      sparse_window);
+        }
+    }
+
+    ~gp_guide_parameters()
+    {
+        delete optimizer_;
+        delete sparse_gp_;
+    }
+
+    // the sparse mode's covariance is the periodic part of hyper_, with the
+    // inducing points spread over one period
+    covariance_functions::PeriodicSquareExponential SparseCovariance() const
+    {
+        covariance_functions::PeriodicSquareExponential::Parameters p = hyper_.covariance;
+        p.se_sd = 0.0;
+        return covariance_functions::PeriodicSquareExponential(p);
+    }
+
+    Eigen::VectorXd SparseInducing() const
+    {
+        Eigen::VectorXd inducing(inducing_points_);
+        for (int i = 0; i < inducing_points_; i++)
+            inducing[i] = i * hyper_.covariance.period / inducing_points_;
+        return inducing;
+    }
+
+    void SetHyperparameters(const gp_optimizer::Hyperparameters& hyper)
     {
+        hyper_ = hyper;
+        double const noise_var = hyper_.noise_sd * hyper_.noise_sd;
+        if (sparse_gp_)
+            sparse_gp_->setCovariance(SparseCovariance(), noise_var, SparseInducing());
+        else
+            gp_.setCovariance(covariance_functions::PeriodicSquareExponential(hyper_.covariance), noise_var);
+    }
 
+    int Size() const
+    {
+        return sparse_gp_ ? sparse_gp_->size() : gp_.size();
     }
 
+    // samples sent to the external process in the UDP debug mode
+    enum { MAX_POINTS = 100 };
 
+    // fewer samples than this and the correction is purely proportional
+    enum { MIN_POINTS = 5 };
 
     void clear()
     {
         timestamps_.clear();
         measurements_.clear();
         modified_measurements_.clear();
+        control_signal_ = 0.0;
         number_of_measurements_ = 0;
+        elapsed_time_ms_ = 0.0;
+        delta_measurement_time_ms_ = 0.0;
+        last_fit_ms_ = 0.0;
+        first_exposure_us_ = 0;
+        restored_x_.clear();
+        restored_y_.clear();
+        gp_.clear();
+        if (sparse_gp_)
+            sparse_gp_->clear();
     }
 
 };
@@ -133,12 +401,99 @@ struct GuideGaussianProcess::gp_guide_parameters
 
 static const double DefaultControlGain = 1.0;
 
+// GP hyperparameters: drift rates are in pixels per second and times in
+// seconds, the default period is that of a typical worm gear
+static const double DefaultPeriod = 480.0;
+static const double DefaultPeriodicSD = 0.2;
+static const double DefaultPeriodicLength = 1.0;
+static const double DefaultDriftSD = 0.1;
+static const double DefaultDriftLength = 600.0;
+static const double DefaultNoiseSD = 0.2;
+
+// samples in the exact GP's window, and in the sparse mode's window (two
+// hours at two seconds per frame) with its number of inducing points
+static const int DefaultWindowPoints = 200;
+static const int MaxWindowPoints = 2000;
+static const int DefaultSparseWindowPoints = 3600;
+static const int MaxSparseWindowPoints = 100000;
+static const int DefaultInducingPoints = 32;
+static const int MaxInducingPoints = 200;
+
+// background hyperparameter fits: how often, on how many samples, and the CPU
+// each may use
+static const int DefaultOptimizeInterval = 300;  // seconds, 0 = never
+static const int DefaultFitPoints = 300;
+static const int MaxFitPoints = 1000;
+static const int MinFitPoints = 30;
+static const int DefaultOptimizerMaxIterations = 50;
+static const int DefaultOptimizerMaxMs = 1000;
+
+static gp_optimizer::Hyperparameters LoadHyperparameters(const wxString& configPath)
+{
+    gp_optimizer::Hyperparameters hyper;
+    covariance_functions::PeriodicSquareExponential::Parameters& p = hyper.covariance;
+    p.period = pConfig->Profile.GetDouble(configPath + "/period", DefaultPeriod);
+    p.per_sd = pConfig->Profile.GetDouble(configPath + "/periodicSD", DefaultPeriodicSD);
+    p.per_length = pConfig->Profile.GetDouble(configPath + "/periodicLength", DefaultPeriodicLength);
+    p.se_sd = pConfig->Profile.GetDouble(configPath + "/driftSD", DefaultDriftSD);
+    p.se_length = pConfig->Profile.GetDouble(configPath + "/driftLength", DefaultDriftLength);
+
+    if (p.period <= 0.0)
+        p.period = DefaultPeriod;
+    if (p.per_length <= 0.0)
+        p.per_length = DefaultPeriodicLength;
+    if (p.se_length <= 0.0)
+        p.se_length = DefaultDriftLength;
+
+    // the log-space optimizer needs all of them positive
+    if (p.per_sd <= 0.0)
+        p.per_sd = DefaultPeriodicSD;
+    if (p.se_sd <= 0.0)
+        p.se_sd = DefaultDriftSD;
+
+    hyper.noise_sd = pConfig->Profile.GetDouble(configPath + "/noiseSD", DefaultNoiseSD);
+    if (hyper.noise_sd <= 0.0)
+        hyper.noise_sd = DefaultNoiseSD;
+
+    return hyper;
+}
+
 GuideGaussianProcess::GuideGaussianProcess(Mount *pMount, GuideAxis axis)
     : GuideAlgorithm(pMount, axis),
       parameters(0)
 {
-    parameters = new gp_guide_parameters();
     wxString configPath = GetConfigPath();
+    int window = pConfig->Profile.GetInt(configPath + "/windowPoints", DefaultWindowPoints);
+    window = wxMax((int) gp_guide_parameters::MIN_POINTS, wxMin(window, MaxWindowPoints));
+    int sparse_window = 0;
+    int inducing_points = 0;
+    if (pConfig->Profile.GetBoolean(configPath + "/sparse", false))
+    {
+        sparse_window = pConfig->Profile.GetInt(configPath + "/sparseWindowPoints", DefaultSparseWindowPoints);
+        sparse_window = wxMax((int) gp_guide_parameters::MIN_POINTS, wxMin(sparse_window, MaxSparseWindowPoints));
+        inducing_points = pConfig->Profile.GetInt(configPath + "/inducingPoints", DefaultInducingPoints);
+        inducing_points = wxMax(4, wxMin(inducing_points, MaxInducingPoints));
+    }
+    parameters = new gp_guide_parameters(LoadHyperparameters(configPath), window, sparse_window, inducing_points);
+    parameters->udp_debug_ = pConfig->Profile.GetBoolean(configPath + "/udpDebug", false);
+
+    int optimize_interval = pConfig->Profile.GetInt(configPath + "/optimizeInterval", DefaultOptimizeInterval);
+    if (optimize_interval > 0 && !parameters->udp_debug_)
+    {
+        int max_iterations = pConfig->Profile.GetInt(configPath + "/optimizerMaxIterations", DefaultOptimizerMaxIterations);
+        int max_ms = pConfig->Profile.GetInt(configPath + "/optimizerMaxMs", DefaultOptimizerMaxMs);
+        bool fit_period = pConfig->Profile.GetBoolean(configPath + "/optimizePeriod", false);
+        parameters->optimizer_ = new GPHyperparameterOptimizer(wxMax(1, max_iterations), wxMax(10, max_ms), fit_period);
+        if (parameters->optimizer_->Start())
+        {
+            Debug.Write("GP guider: could not start the hyperparameter optimizer thread\n");
+            delete parameters->optimizer_;
+            parameters->optimizer_ = 0;
+        }
+        parameters->optimize_interval_ms_ = optimize_interval * 1000;
+        int fit_points = pConfig->Profile.GetInt(configPath + "/fitPoints", DefaultFitPoints);
+        parameters->fit_points_ = wxMax(MinFitPoints, wxMin(fit_points, MaxFitPoints));
+    }
     double control_gain = pConfig->Profile.GetDouble(configPath + "/controlGain", DefaultControlGain);
     SetControlGain(control_gain);
 
@@ -190,7 +545,16 @@ double GuideGaussianProcess::GetControlGain()
 
 wxString GuideGaussianProcess::GetSettingsSummary()
 {
-    return wxString::Format("Control Gain = %.3f\n", GetControlGain());
+    wxString mode;
+    if (parameters->udp_debug_)
+        mode = ", UDP debug mode";
+    else if (parameters->sparse_gp_)
+        mode = wxString::Format(", sparse, window = %d", parameters->sparse_gp_->capacity());
+    else
+        mode = wxString::Format(", window = %d", parameters->gp_.capacity());
+    if (parameters->optimizer_)
+        mode += wxString::Format(", hyperparameter fit every %d s", parameters->optimize_interval_ms_ / 1000);
+    return wxString::Format("Control Gain = %.3f%s\n", GetControlGain(), mode);
 }
 
 
@@ -200,16 +564,38 @@ GUIDE_ALGORITHM GuideGaussianProcess::Algorithm(void)
     return GUIDE_ALGORITHM_GAUSSIAN_PROCESS;
 }
 
+// the middle of the exposure of the frame being guided on
+static bool FrameMidTime(wxLongLong_t *us)
+{
+    const usImage *img = pFrame && pFrame->pGuider ? pFrame->pGuider->CurrentImage() : NULL;
+    return img && img->GetExposureMidTime(us);
+}
+
+// A measurement is dated by the middle of its frame's exposure when the
+// frame has exposure times, and otherwise by when it is handed in.
 void GuideGaussianProcess::HandleTimestamps()
 {
+    wxLongLong_t mid_us;
+    bool const timed = FrameMidTime(&mid_us);
+
     if (parameters->number_of_measurements_ == 0)
     {
         parameters->timer_.Start();
+        parameters->elapsed_time_ms_ = 0.0;
+        parameters->first_exposure_us_ = timed ? mid_us : 0;
+        return;
     }
     double time_now = parameters->timer_.Time();
-    double delta_measurement_time_ms = time_now - parameters->elapsed_time_ms_;
+    if (timed && parameters->first_exposure_us_)
+    {
+        double const t = (double) (mid_us - parameters->first_exposure_us_) / 1000.0;
+        // a frame timed out of order is dated by its arrival instead
+        if (t > parameters->elapsed_time_ms_)
+            time_now = t;
+    }
+    parameters->delta_measurement_time_ms_ = time_now - parameters->elapsed_time_ms_;
     parameters->elapsed_time_ms_ = time_now;
-    parameters->timestamps_.append(parameters->elapsed_time_ms_ - delta_measurement_time_ms / 2);
+    parameters->timestamps_.append(parameters->elapsed_time_ms_ - parameters->delta_measurement_time_ms_ / 2);
 }
 
 void GuideGaussianProcess::HandleMeasurements(double input)
@@ -219,117 +605,189 @@ void GuideGaussianProcess::HandleMeasurements(double input)
 
 void GuideGaussianProcess::HandleModifiedMeasurements(double input)
 {
-    // If there is no previous measurement, a random one is generated.
-    if(parameters->number_of_measurements_ == 0)
-    {
-        //The daytime indoor measurement noise SD is 0.25-0.35
-        double indoor_noise_standard_deviation = 0.25;
-        double first_random_measurement = indoor_noise_standard_deviation *
-            math_tools::generate_normal_random_double();
-        double new_modified_measurement =
-            parameters->control_signal_ +
-            first_random_measurement * (1 - parameters->control_gain_) -
-            input;
-        parameters->modified_measurements_.append(new_modified_measurement);
-    }
-    else
-    {
-        double new_modified_measurement =
-            parameters->control_signal_ +
-            parameters->measurements_.getSecondLastElement() * (1 - parameters->control_gain_) -
-            parameters->measurements_.getLastElement();
-        parameters->modified_measurements_.append(new_modified_measurement);
-    }
+    // the first measurement only starts the clock
+    if (parameters->number_of_measurements_ == 0)
+        return;
+
+    // the star moved from where the previous correction left it to input
+    double drift = input - (parameters->measurements_.getSecondLastElement() - parameters->control_signal_);
+    double interval_s = wxMax(parameters->delta_measurement_time_ms_, 1.0) / 1000.0;
+    parameters->modified_measurements_.append(drift / interval_s);
 }
 
-double GuideGaussianProcess::result(double input)
+// The former way of running the GP: the data is sent to an external process,
+// e.g. Matlab, which replies with the control signal. Each exchange waits
+// 100 ms, so this is only for debugging the algorithm.
+double GuideGaussianProcess::UDPResult(double input)
 {
-    HandleTimestamps();
-    HandleMeasurements(input);
-    HandleModifiedMeasurements(input);
-    parameters->number_of_measurements_++;
-
-    /*
-     * Need to read this value here because it is not loaded at the construction
-     * time of this object.
-     * 
-     *
-     * Not used when testing the Code with Matlab, will be used in the actual GP
-     */
-    double delta_controller_time_ms = pFrame->RequestedExposureDuration();
-
-
-
-    // This is the Code sending the circular buffers to Matlab:
-
-    double* timestamp_data = parameters->timestamps_.getEigenVector()->data();
-    double* modified_measurement_data = parameters->modified_measurements_.getEigenVector()->data();
-    double result;
+    // views of the buffers, nothing is copied
+    CircularDoubleBuffer::ConstView timestamps = parameters->timestamps_.getView();
+    CircularDoubleBuffer::ConstView modified_measurements = parameters->modified_measurements_.getView();
+    double result = 0.0;
     double wait_time = 100;
 
-    bool sent = false;
-    bool received = false;
-
     // Send the input
     double input_buf[] = { input };
-    sent = parameters->udpInteraction.SendToUDPPort(input_buf, 8);
-    received = parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
+    parameters->udpInteraction.SendToUDPPort(input_buf, 8);
+    parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
     wxMilliSleep(wait_time);
 
     // Send the size of the buffer
-    double size = parameters->timestamps_.getEigenVector()->size();
+    double size = timestamps.size();
     double size_buf[] = { size };
-    sent = parameters->udpInteraction.SendToUDPPort(size_buf, 8);
-    received = parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
+    parameters->udpInteraction.SendToUDPPort(size_buf, 8);
+    parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
     wxMilliSleep(wait_time);
 
     // Send modified measurements
-    sent = parameters->udpInteraction.SendToUDPPort(modified_measurement_data, size * 8);
-    received = parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
+    parameters->udpInteraction.SendToUDPPort(modified_measurements.data(), size * 8);
+    parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
     wxMilliSleep(wait_time);
 
     // Send timestamps
-    sent = parameters->udpInteraction.SendToUDPPort(timestamp_data, size * 8);
+    parameters->udpInteraction.SendToUDPPort(timestamps.data(), size * 8);
     // Receive the final control signal
-    received = parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
+    parameters->udpInteraction.ReceiveFromUDPPort(&result, 8);
 
     return result;
+}
 
+// Picks up a finished background fit, and hands the optimizer a snapshot of
+// the latest samples once the interval has passed. The snapshot starts from
+// the hyperparameters in use, so successive fits refine each other.
+void GuideGaussianProcess::OptimizeHyperparameters()
+{
+    GPHyperparameterOptimizer::Fit fit;
+    if (parameters->optimizer_->TakeResult(&fit))
+    {
+        const gp_optimizer::Hyperparameters& h = fit.result.hyperparameters;
+        const covariance_functions::PeriodicSquareExponential::Parameters& c = h.covariance;
 
-    /*
-     * This is the code running the actual GP
-     *
-     * TODO: 
-     * - Let GP class be a member of this Guiding Class
-     * - Call the GP´s BFGS Optimizer every once in a while (how often?)
-     *
-     */
-
+        Debug.Write(wxString::Format("GP guider: hyperparameter fit %s after %d iterations, %.1f ms, %d points, nll = %.3f: "
+            "period = %.2f periodicSD = %.4f periodicLength = %.4f driftSD = %.4f driftLength = %.2f noiseSD = %.4f\n",
+            fit.result.converged ? "converged" : "stopped early",
+            fit.result.iterations, fit.elapsed_ms, fit.points, fit.result.negative_log_likelihood,
+            c.period, c.per_sd, c.per_length, c.se_sd, c.se_length, h.noise_sd));
 
-    /*
+        if (std::isfinite(fit.result.negative_log_likelihood))
+        {
+            parameters->SetHyperparameters(h);
+
+            GPHyperparameterFitInfo info;
+            info.axis = m_guideAxis == GUIDE_RA ? "RA" : "Dec";
+            info.converged = fit.result.converged;
+            info.iterations = fit.result.iterations;
+            info.elapsedMs = fit.elapsed_ms;
+            info.points = fit.points;
+            info.nll = fit.result.negative_log_likelihood;
+            info.period = c.period;
+            info.periodicSD = c.per_sd;
+            info.periodicLength = c.per_length;
+            info.driftSD = c.se_sd;
+            info.driftLength = c.se_length;
+            info.noiseSD = h.noise_sd;
+            // the guide algorithms run on the worker thread, the event server on the main thread
+            EvtServer.CallAfter(&EventServer::NotifyGPHyperparameters, info);
+        }
+    }
 
-    if (number_of_measurements_ > 5)
+    double const now = parameters->timer_.Time();
+    if (now - parameters->last_fit_ms_ < parameters->optimize_interval_ms_ ||
+        parameters->Size() < MinFitPoints || parameters->optimizer_->Busy())
     {
+        return;
+    }
 
-        // Inference
-        gp_->infer(*timestamps_.getEigenVector(),
-                   *modified_measurements_.getEigenVector());
-        // Prediction of new control_signal_
-        Eigen::VectorXd prediction =
-            gp_->predict(elapsed_time_ms_ + delta_controller_time_ms / 2) -
-            control_gain_ * input / delta_controller_time_ms;
-        control_signal_ = prediction(0);
+    Eigen::VectorXd x, y;
+    if (parameters->sparse_gp_)
+        parameters->sparse_gp_->latest(parameters->fit_points_, &x, &y);
+    else
+        parameters->gp_.latest(parameters->fit_points_, &x, &y);
 
+    parameters->optimizer_->Submit(x, y, parameters->hyper_);
+    parameters->last_fit_ms_ = now;
+}
+
+// The samples of a restored state go in with the first measurement, shifted
+// back by the time since they were saved so that the periodic part stays in
+// phase with the worm.
+void GuideGaussianProcess::AddRestoredSamples()
+{
+    double const gap_s = (double) (wxGetUTCTimeMillis().GetValue() - parameters->restored_at_ms_) / 1000.0;
+    for (size_t i = 0; i < parameters->restored_x_.size(); i++)
+    {
+        double const x = parameters->restored_x_[i] - gap_s;
+        if (parameters->sparse_gp_)
+            parameters->sparse_gp_->append(x, parameters->restored_y_[i]);
+        else
+            parameters->gp_.append(x, parameters->restored_y_[i]);
     }
-    else
+    Debug.Write(wxString::Format("GP guider: added %u restored samples, saved %.0f s ago\n",
+        (unsigned int) parameters->restored_x_.size(), gap_s));
+    parameters->restored_x_.clear();
+    parameters->restored_y_.clear();
+}
+
+double GuideGaussianProcess::result(double input)
+{
+    bool const new_sample = parameters->number_of_measurements_ > 0;
+
+    if (!new_sample && !parameters->restored_x_.empty())
+        AddRestoredSamples();
+
+    HandleTimestamps();
+    HandleMeasurements(input);
+    HandleModifiedMeasurements(input);
+    parameters->number_of_measurements_++;
+
+    if (parameters->udp_debug_)
     {
-        // Simpler prediction when there are not enough data points for the GP
-        control_signal_ = -input / delta_controller_time_ms;
+        parameters->control_signal_ = UDPResult(input);
+        return parameters->control_signal_;
     }
 
-    return control_signal_;
+    double control_signal = parameters->control_gain_ * input;
+
+    if (new_sample)
+    {
+        wxStopWatch swatch;
+
+        double const t = parameters->timestamps_.getLastElement() / 1000.0;
+        double const rate = parameters->modified_measurements_.getLastElement();
+
+        // the next interval is taken to be as long as the last one
+        double interval_ms = parameters->delta_measurement_time_ms_;
+        if (interval_ms <= 0.0)
+            interval_ms = pFrame->RequestedExposureDuration();
+        double const next_s = (parameters->elapsed_time_ms_ + interval_ms / 2) / 1000.0;
+
+        int points;
+        double predicted;
+        if (parameters->sparse_gp_)
+        {
+            parameters->sparse_gp_->append(t, rate);
+            points = parameters->sparse_gp_->size();
+            predicted = parameters->sparse_gp_->predict(next_s);
+        }
+        else
+        {
+            parameters->gp_.append(t, rate);
+            points = parameters->gp_.size();
+            predicted = parameters->gp_.predict(next_s);
+        }
+
+        if (points >= gp_guide_parameters::MIN_POINTS)
+            control_signal += predicted * interval_ms / 1000.0;
+
+        Debug.Write(wxString::Format("GP guider: %d points, step took %.3f ms\n", points,
+            swatch.TimeInMicro().ToDouble() / 1000.0));
+
+        if (parameters->optimizer_)
+            OptimizeHyperparameters();
+    }
 
-     */
+    parameters->control_signal_ = control_signal;
+    return control_signal;
 }
 
 
@@ -338,3 +796,74 @@ void GuideGaussianProcess::reset()
     parameters->clear();
     return;
 }
+
+// "gp1", the hyperparameters in use, then the samples in the GP window with
+// their times in seconds before now
+wxString GuideGaussianProcess::SaveState()
+{
+    if (parameters->udp_debug_ || parameters->number_of_measurements_ == 0)
+        return wxEmptyString;
+
+    Eigen::VectorXd x, y;
+    if (parameters->sparse_gp_)
+        parameters->sparse_gp_->latest(parameters->sparse_gp_->size(), &x, &y);
+    else
+        parameters->gp_.latest(parameters->gp_.size(), &x, &y);
+
+    const gp_optimizer::Hyperparameters& h = parameters->hyper_;
+    const covariance_functions::PeriodicSquareExponential::Parameters& c = h.covariance;
+    wxString s = wxString::Format("gp1 %.9g %.9g %.9g %.9g %.9g %.9g %d", c.period, c.per_sd, c.per_length,
+        c.se_sd, c.se_length, h.noise_sd, (int) x.size());
+
+    double const now_s = parameters->timer_.Time() / 1000.0;
+    for (int i = 0; i < x.size(); i++)
+        s += wxString::Format(" %.9g %.9g", x[i] - now_s, y[i]);
+
+    return s;
+}
+
+bool GuideGaussianProcess::RestoreState(const wxString& state, wxLongLong_t savedAtMs)
+{
+    wxStringTokenizer tok(state, " ");
+    if (tok.GetNextToken() != "gp1")
+        return true;
+
+    double v[7];
+    for (int i = 0; i < 7; i++)
+    {
+        if (!tok.GetNextToken().ToCDouble(&v[i]))
+            return true;
+    }
+    int const n = (int) v[6];
+    if (n < 0)
+        return true;
+
+    std::vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; i++)
+    {
+        if (!tok.GetNextToken().ToCDouble(&xs[i]) || !tok.GetNextToken().ToCDouble(&ys[i]))
+            return true;
+    }
+
+    reset();
+
+    // fitted hyperparameters carry over; configured ones are already in use
+    if (parameters->optimizer_ && v[0] > 0.0 && v[1] > 0.0 && v[2] > 0.0 && v[3] > 0.0 && v[4] > 0.0 && v[5] > 0.0)
+    {
+        gp_optimizer::Hyperparameters h = parameters->hyper_;
+        h.covariance.period = v[0];
+        h.covariance.per_sd = v[1];
+        h.covariance.per_length = v[2];
+        h.covariance.se_sd = v[3];
+        h.covariance.se_length = v[4];
+        h.noise_sd = v[5];
+        parameters->SetHyperparameters(h);
+    }
+
+    parameters->restored_x_.swap(xs);
+    parameters->restored_y_.swap(ys);
+    parameters->restored_at_ms_ = savedAtMs;
+
+    Debug.Write(wxString::Format("GP guider: restored %d samples\n", n));
+    return false;
+}
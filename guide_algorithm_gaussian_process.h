@@ -50,6 +50,9 @@ private:
     void HandleTimestamps();
     void HandleMeasurements(double input);
     void HandleModifiedMeasurements(double input);
+    double UDPResult(double input);
+    void OptimizeHyperparameters();
+    void AddRestoredSamples();
 
 protected:
 
@@ -66,6 +69,8 @@ public:
     virtual void reset();
     virtual wxString GetSettingsSummary();
     virtual wxString GetGuideAlgorithmClassName(void) const { return "Gaussian Process"; }
+    virtual wxString SaveState(void);
+    virtual bool RestoreState(const wxString& state, wxLongLong_t savedAtMs);
     
 };
 
@@ -197,6 +197,44 @@ wxString GuideAlgorithmHysteresis::GetSettingsSummary()
         );
 }
 
+void GuideAlgorithmHysteresis::GetParamNames(wxArrayString& names) const
+{
+    names.push_back("minMove");
+    names.push_back("hysteresis");
+    names.push_back("aggression");
+}
+
+bool GuideAlgorithmHysteresis::GetParam(const wxString& name, double *val)
+{
+    if (name == "minMove")
+    {
+        *val = GetMinMove();
+        return true;
+    }
+    if (name == "hysteresis")
+    {
+        *val = GetHysteresis();
+        return true;
+    }
+    if (name == "aggression")
+    {
+        *val = GetAggression();
+        return true;
+    }
+    return false;
+}
+
+bool GuideAlgorithmHysteresis::SetParam(const wxString& name, double val)
+{
+    if (name == "minMove")
+        return !SetMinMove(val);
+    if (name == "hysteresis")
+        return !SetHysteresis(val);
+    if (name == "aggression")
+        return !SetAggression(val);
+    return false;
+}
+
 ConfigDialogPane *GuideAlgorithmHysteresis::GetConfigDialogPane(wxWindow *pParent)
 {
     return new GuideAlgorithmHysteresisConfigDialogPane(pParent, this);
@@ -179,6 +179,36 @@ wxString GuideAlgorithmLowpass::GetSettingsSummary()
         );
 }
 
+void GuideAlgorithmLowpass::GetParamNames(wxArrayString& names) const
+{
+    names.push_back("minMove");
+    names.push_back("slopeWeight");
+}
+
+bool GuideAlgorithmLowpass::GetParam(const wxString& name, double *val)
+{
+    if (name == "minMove")
+    {
+        *val = GetMinMove();
+        return true;
+    }
+    if (name == "slopeWeight")
+    {
+        *val = GetSlopeWeight();
+        return true;
+    }
+    return false;
+}
+
+bool GuideAlgorithmLowpass::SetParam(const wxString& name, double val)
+{
+    if (name == "minMove")
+        return !SetMinMove(val);
+    if (name == "slopeWeight")
+        return !SetSlopeWeight(val);
+    return false;
+}
+
 ConfigDialogPane *GuideAlgorithmLowpass::GetConfigDialogPane(wxWindow *pParent)
 {
     return new GuideAlgorithmLowpassConfigDialogPane(pParent, this);
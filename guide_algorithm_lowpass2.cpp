@@ -43,7 +43,8 @@ static const double DefaultMinMove = 0.2;
 static const double DefaultAggressiveness = 80.0;
 
 GuideAlgorithmLowpass2::GuideAlgorithmLowpass2(Mount *pMount, GuideAxis axis)
-    : GuideAlgorithm(pMount, axis)
+    : GuideAlgorithm(pMount, axis),
+      m_history(HISTORY_SIZE)
 {
     double minMove = pConfig->Profile.GetDouble(GetConfigPath() + "/minMove", DefaultMinMove);
     SetMinMove(minMove);
@@ -65,7 +66,7 @@ GUIDE_ALGORITHM GuideAlgorithmLowpass2::Algorithm(void)
 
 void GuideAlgorithmLowpass2::reset(void)
 {
-    m_history.Empty();
+    m_history.Clear();
     m_rejects = 0;
 }
 
@@ -88,12 +89,9 @@ double GuideAlgorithmLowpass2::result(double input)
             Debug.Write("Lowpass2 history cleared, outlier deflection\n");
         }
         else
-            dReturn = CalcSlope(m_history) * (double) numpts * attenuation;
+            dReturn = m_history.Slope() * (double) numpts * attenuation;
     }
 
-    if (numpts == HISTORY_SIZE)                 // History is fully populated
-        m_history.RemoveAt(0);
-
     if (fabs(dReturn) > fabs(input))            // Keep guide pulses below magnitude of last deflection
     {
         Debug.Write(wxString::Format("GuideAlgorithmLowpass2::Result() input %.2f is < calculated value %.2f, using input\n", input, dReturn));
@@ -176,6 +174,36 @@ bool GuideAlgorithmLowpass2::SetAggressiveness(double aggressiveness)
     return bError;
 }
 
+void GuideAlgorithmLowpass2::GetParamNames(wxArrayString& names) const
+{
+    names.push_back("minMove");
+    names.push_back("aggressiveness");
+}
+
+bool GuideAlgorithmLowpass2::GetParam(const wxString& name, double *val)
+{
+    if (name == "minMove")
+    {
+        *val = GetMinMove();
+        return true;
+    }
+    if (name == "aggressiveness")
+    {
+        *val = GetAggressiveness();
+        return true;
+    }
+    return false;
+}
+
+bool GuideAlgorithmLowpass2::SetParam(const wxString& name, double val)
+{
+    if (name == "minMove")
+        return !SetMinMove(val);
+    if (name == "aggressiveness")
+        return !SetAggressiveness(val);
+    return false;
+}
+
 ConfigDialogPane *GuideAlgorithmLowpass2::GetConfigDialogPane(wxWindow *pParent)
 {
     return new GuideAlgorithmLowpass2ConfigDialogPane(pParent, this);
@@ -44,7 +44,7 @@ class GuideAlgorithmLowpass2 : public GuideAlgorithm
 {
     static const unsigned int HISTORY_SIZE = 10;
 
-    ArrayOfDbl m_history;
+    GuideHistory m_history;
     double m_aggressiveness;
     double m_minMove;
     int m_rejects;
@@ -92,6 +92,9 @@ public:
     virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
     virtual GraphControlPane *GetGraphControlPane(wxWindow *pParent, const wxString& label);
     virtual wxString GetSettingsSummary();
+    virtual void GetParamNames(wxArrayString& names) const;
+    virtual bool GetParam(const wxString& name, double *val);
+    virtual bool SetParam(const wxString& name, double val);
     virtual wxString GetGuideAlgorithmClassName(void) const { return "Lowpass2"; }
     virtual double GetMinMove(void);
     virtual bool SetMinMove(double minMove);
@@ -0,0 +1,458 @@
+/*
+ *  guide_algorithm_predictive_pec.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+#include "periodic_error_model.h"
+
+#include <wx/stopwatch.h>
+
+static const double DefaultPeriod = 0.0;        // measure it
+static const int DefaultHarmonics = 3;
+static const double DefaultGain = 0.8;
+
+// range of worm periods the periodogram searches, seconds
+static const double MinPeriod = 60.0;
+static const double MaxPeriod = 1200.0;
+
+// the fit forgets data older than a few periods, so a slowly changing
+// periodic error is followed
+static const double ModelMemoryPeriods = 3.0;
+
+// samples kept for the periodogram; one per second at most covers more than an hour
+static const size_t EstimatorSamples = 4096;
+static const double EstimatorSpacing = 1.0;
+
+// a new period estimate is only taken up if it differs by more than this
+static const double PeriodChangeTolerance = 0.01;
+
+struct GuideAlgorithmPredictivePEC::PECState
+{
+    PeriodicErrorModel model;
+    PeriodEstimator estimator;
+    wxStopWatch timer;
+    bool started;
+    double lastTime;            // seconds since the first step
+    double applied;             // sum of the corrections made, pixels
+    double bias;                // keeps the rebuilt position continuous across dithers and pauses
+    double lastPosition;
+    bool resync;
+
+    PECState()
+        : estimator(EstimatorSamples, EstimatorSpacing, MinPeriod, MaxPeriod)
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        estimator.Clear();
+        started = false;
+        lastTime = 0.0;
+        applied = 0.0;
+        bias = 0.0;
+        lastPosition = 0.0;
+        resync = false;
+    }
+};
+
+GuideAlgorithmPredictivePEC::GuideAlgorithmPredictivePEC(Mount *pMount, GuideAxis axis)
+    : GuideAlgorithm(pMount, axis),
+      m_inner(new GuideAlgorithmHysteresis(pMount, axis)),
+      m_state(new PECState()),
+      m_period(DefaultPeriod),
+      m_harmonics(DefaultHarmonics),
+      m_gain(DefaultGain)
+{
+    wxString configPath = GetConfigPath();
+
+    int harmonics = pConfig->Profile.GetInt(configPath + "/harmonics", DefaultHarmonics);
+    SetHarmonics(harmonics);
+
+    double gain = pConfig->Profile.GetDouble(configPath + "/gain", DefaultGain);
+    SetGain(gain);
+
+    double period = pConfig->Profile.GetDouble(configPath + "/period", DefaultPeriod);
+    SetPeriod(period);
+
+    reset();
+}
+
+GuideAlgorithmPredictivePEC::~GuideAlgorithmPredictivePEC(void)
+{
+    delete m_state;
+    delete m_inner;
+}
+
+GUIDE_ALGORITHM GuideAlgorithmPredictivePEC::Algorithm(void)
+{
+    return GUIDE_ALGORITHM_PREDICTIVE_PEC;
+}
+
+void GuideAlgorithmPredictivePEC::reset(void)
+{
+    m_inner->reset();
+    m_state->Clear();
+    SetModelPeriod(m_period);
+}
+
+void GuideAlgorithmPredictivePEC::Resync(void)
+{
+    // the lock position moved or guiding was paused: keep the model, but
+    // re-anchor the rebuilt position at the next step
+    m_state->resync = m_state->started;
+}
+
+void GuideAlgorithmPredictivePEC::GuidingResumed(void)
+{
+    m_inner->GuidingResumed();
+    Resync();
+}
+
+void GuideAlgorithmPredictivePEC::GuidingDithered(double amt)
+{
+    m_inner->GuidingDithered(amt);
+    Resync();
+}
+
+void GuideAlgorithmPredictivePEC::SetModelPeriod(double period)
+{
+    PECState& st = *m_state;
+    double const memory = ModelMemoryPeriods * period;
+    st.model.Init(period, m_harmonics, memory);
+
+    if (period <= 0.0 || st.estimator.Count() == 0)
+        return;
+
+    // refit from the samples the forgetting would not already have discounted
+    double tLast, g;
+    st.estimator.Get(st.estimator.Count() - 1, &tLast, &g);
+    for (size_t i = 0; i < st.estimator.Count(); i++)
+    {
+        double t;
+        st.estimator.Get(i, &t, &g);
+        if (t >= tLast - 2.0 * memory)
+            st.model.Add(t, g);
+    }
+}
+
+double GuideAlgorithmPredictivePEC::result(double input)
+{
+    PECState& st = *m_state;
+
+    if (!st.started)
+    {
+        st.timer.Start();
+        st.started = true;
+    }
+
+    double const now = st.timer.Time() / 1000.0;
+    double const dt = now - st.lastTime;
+    st.lastTime = now;
+
+    // the offset was measured, on average, in the middle of the last cycle;
+    // the star would be at position g there without the corrections made
+    double const tMeas = now - dt / 2.0;
+    if (st.resync)
+    {
+        double expected = st.model.IsValid() ? st.model.Predict(tMeas) : st.lastPosition;
+        st.bias = expected - (input + st.applied);
+        st.resync = false;
+    }
+    double const g = input + st.applied + st.bias;
+    st.lastPosition = g;
+
+    st.estimator.Add(tMeas, g);
+
+    if (m_period <= 0.0 && st.estimator.Step())
+    {
+        double const estimate = st.estimator.Period();
+        double const current = st.model.Period();
+        if (current <= 0.0 || fabs(estimate - current) > PeriodChangeTolerance * estimate)
+        {
+            Debug.Write(wxString::Format("PredictivePEC: worm period estimate %.1f s (peak %.1f x mean)\n",
+                estimate, st.estimator.Strength()));
+            SetModelPeriod(estimate);       // includes this sample
+        }
+        else
+            st.model.Add(tMeas, g);
+    }
+    else
+        st.model.Add(tMeas, g);
+
+    double const reactive = m_inner->result(input);
+
+    // what the periodic error will do between the middle of the exposure just
+    // measured and the middle of the next one, assuming the same cadence
+    double feedForward = 0.0;
+    if (st.model.IsValid() && dt > 0.0)
+        feedForward = m_gain * (st.model.Periodic(now + dt / 2.0) - st.model.Periodic(tMeas));
+
+    double dReturn = reactive + feedForward;
+    st.applied += dReturn;
+
+    Debug.Write(wxString::Format("GuideAlgorithmPredictivePEC::Result() returns %.2f (%.2f + %.2f feed-forward) from input %.2f, period %.1f\n",
+        dReturn, reactive, feedForward, input, st.model.Period()));
+
+    return dReturn;
+}
+
+double GuideAlgorithmPredictivePEC::GetMinMove(void)
+{
+    return m_inner->GetMinMove();
+}
+
+bool GuideAlgorithmPredictivePEC::SetMinMove(double minMove)
+{
+    return m_inner->SetMinMove(minMove);
+}
+
+double GuideAlgorithmPredictivePEC::GetPeriod(void) const
+{
+    return m_period;
+}
+
+bool GuideAlgorithmPredictivePEC::SetPeriod(double period)
+{
+    bool bError = false;
+
+    try
+    {
+        if (period != 0.0 && (period < MinPeriod || period > MaxPeriod))
+        {
+            throw ERROR_INFO("invalid period");
+        }
+
+        m_period = period;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_period = DefaultPeriod;
+    }
+
+    SetModelPeriod(m_period);
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/period", m_period);
+
+    return bError;
+}
+
+int GuideAlgorithmPredictivePEC::GetHarmonics(void) const
+{
+    return m_harmonics;
+}
+
+bool GuideAlgorithmPredictivePEC::SetHarmonics(int harmonics)
+{
+    bool bError = false;
+
+    try
+    {
+        if (harmonics < 1 || harmonics > PeriodicErrorModel::MAX_HARMONICS)
+        {
+            throw ERROR_INFO("invalid harmonics");
+        }
+
+        m_harmonics = harmonics;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_harmonics = DefaultHarmonics;
+    }
+
+    // refit with the new number of terms
+    SetModelPeriod(m_state->model.Period());
+
+    pConfig->Profile.SetInt(GetConfigPath() + "/harmonics", m_harmonics);
+
+    return bError;
+}
+
+double GuideAlgorithmPredictivePEC::GetGain(void) const
+{
+    return m_gain;
+}
+
+bool GuideAlgorithmPredictivePEC::SetGain(double gain)
+{
+    bool bError = false;
+
+    try
+    {
+        if (gain < 0.0 || gain > 1.0)
+        {
+            throw ERROR_INFO("invalid gain");
+        }
+
+        m_gain = gain;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+        m_gain = DefaultGain;
+    }
+
+    pConfig->Profile.SetDouble(GetConfigPath() + "/gain", m_gain);
+
+    return bError;
+}
+
+void GuideAlgorithmPredictivePEC::ResetParams(void)
+{
+    m_inner->ResetParams();
+    GuideAlgorithm::ResetParams();
+}
+
+void GuideAlgorithmPredictivePEC::GetParamNames(wxArrayString& names) const
+{
+    m_inner->GetParamNames(names);
+    names.push_back("period");
+    names.push_back("harmonics");
+    names.push_back("gain");
+}
+
+bool GuideAlgorithmPredictivePEC::GetParam(const wxString& name, double *val)
+{
+    if (name == "period")
+    {
+        *val = GetPeriod();
+        return true;
+    }
+    if (name == "harmonics")
+    {
+        *val = GetHarmonics();
+        return true;
+    }
+    if (name == "gain")
+    {
+        *val = GetGain();
+        return true;
+    }
+    return m_inner->GetParam(name, val);
+}
+
+bool GuideAlgorithmPredictivePEC::SetParam(const wxString& name, double val)
+{
+    if (name == "period")
+        return !SetPeriod(val);
+    if (name == "harmonics")
+        return !SetHarmonics((int) floor(val + 0.5));
+    if (name == "gain")
+        return !SetGain(val);
+    return m_inner->SetParam(name, val);
+}
+
+wxString GuideAlgorithmPredictivePEC::GetSettingsSummary()
+{
+    // return a loggable summary of current mount settings
+    wxString period = m_period > 0.0 ? wxString::Format("%.1f s", m_period) : wxString("auto");
+    return m_inner->GetSettingsSummary() +
+        wxString::Format("Period = %s, Harmonics = %d, Feed-forward gain = %.2f\n", period, m_harmonics, m_gain);
+}
+
+ConfigDialogPane *GuideAlgorithmPredictivePEC::GetConfigDialogPane(wxWindow *pParent)
+{
+    return new GuideAlgorithmPredictivePECConfigDialogPane(pParent, this);
+}
+
+GraphControlPane *GuideAlgorithmPredictivePEC::GetGraphControlPane(wxWindow *pParent, const wxString& label)
+{
+    return m_inner->GetGraphControlPane(pParent, label);
+}
+
+GuideAlgorithmPredictivePEC::
+GuideAlgorithmPredictivePECConfigDialogPane::
+GuideAlgorithmPredictivePECConfigDialogPane(wxWindow *pParent, GuideAlgorithmPredictivePEC *pGuideAlgorithm)
+    : ConfigDialogPane(_("Predictive PEC Guide Algorithm"), pParent)
+{
+    int width;
+
+    m_pGuideAlgorithm = pGuideAlgorithm;
+
+    m_pInnerPane = m_pGuideAlgorithm->m_inner->GetConfigDialogPane(pParent);
+    DoAdd(m_pInnerPane);
+
+    width = StringWidth(_T("0000.0"));
+    m_pPeriod = new wxSpinCtrlDouble(pParent, wxID_ANY, _T(""), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, MaxPeriod, 0.0, 1.0, _T("Period"));
+    m_pPeriod->SetDigits(1);
+
+    DoAdd(_("Worm period (s)"), m_pPeriod,
+        wxString::Format(_("Period of the RA worm in seconds, %.f to %.f, or 0 to measure it while guiding"), MinPeriod, MaxPeriod));
+
+    width = StringWidth(_T("00"));
+    m_pHarmonics = new wxSpinCtrl(pParent, wxID_ANY, wxEmptyString, wxDefaultPosition,
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 1, PeriodicErrorModel::MAX_HARMONICS, DefaultHarmonics);
+
+    DoAdd(_("Harmonics"), m_pHarmonics,
+        wxString::Format(_("How many harmonics of the worm period to model. Default = %d"), DefaultHarmonics));
+
+    width = StringWidth(_T("000"));
+    m_pGain = new wxSpinCtrlDouble(pParent, wxID_ANY, _T(""), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 0.0, 100.0, 0.0, 5.0, _T("Gain"));
+    m_pGain->SetDigits(0);
+
+    DoAdd(_("Feed-forward (%)"), m_pGain,
+        wxString::Format(_("What percent of the predicted periodic error should be corrected ahead of time? Default = %.f%%"), DefaultGain * 100.0));
+}
+
+GuideAlgorithmPredictivePEC::
+GuideAlgorithmPredictivePECConfigDialogPane::
+~GuideAlgorithmPredictivePECConfigDialogPane(void)
+{
+}
+
+void GuideAlgorithmPredictivePEC::
+GuideAlgorithmPredictivePECConfigDialogPane::
+LoadValues(void)
+{
+    m_pInnerPane->LoadValues();
+    m_pPeriod->SetValue(m_pGuideAlgorithm->GetPeriod());
+    m_pHarmonics->SetValue(m_pGuideAlgorithm->GetHarmonics());
+    m_pGain->SetValue(100.0 * m_pGuideAlgorithm->GetGain());
+}
+
+void GuideAlgorithmPredictivePEC::
+GuideAlgorithmPredictivePECConfigDialogPane::
+UnloadValues(void)
+{
+    m_pInnerPane->UnloadValues();
+    m_pGuideAlgorithm->SetPeriod(m_pPeriod->GetValue());
+    m_pGuideAlgorithm->SetHarmonics(m_pHarmonics->GetValue());
+    m_pGuideAlgorithm->SetGain(m_pGain->GetValue() / 100.0);
+}
@@ -0,0 +1,104 @@
+/*
+ *  guide_algorithm_predictive_pec.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_ALGORITHM_PREDICTIVE_PEC_H_INCLUDED
+#define GUIDE_ALGORITHM_PREDICTIVE_PEC_H_INCLUDED
+
+// Hysteresis guiding plus a feed-forward of the periodic error. The
+// uncorrected RA position is rebuilt from the offsets and the corrections
+// made, the worm period is found from its periodogram (or taken from the
+// settings) and its harmonics are tracked by recursive least squares. Each
+// correction adds the motion the model predicts between the middle of the
+// exposure just measured and the middle of the next one, so the periodic
+// error is corrected as it happens rather than one frame late.
+class GuideAlgorithmPredictivePEC : public GuideAlgorithm
+{
+    struct PECState;
+
+    GuideAlgorithmHysteresis *m_inner;      // the reactive part
+    PECState *m_state;
+    double m_period;                        // seconds, 0 = estimate it
+    int m_harmonics;
+    double m_gain;
+
+    void Resync(void);
+    void SetModelPeriod(double period);
+
+protected:
+    class GuideAlgorithmPredictivePECConfigDialogPane : public ConfigDialogPane
+    {
+        GuideAlgorithmPredictivePEC *m_pGuideAlgorithm;
+        ConfigDialogPane *m_pInnerPane;
+        wxSpinCtrlDouble *m_pPeriod;
+        wxSpinCtrl *m_pHarmonics;
+        wxSpinCtrlDouble *m_pGain;
+
+    public:
+        GuideAlgorithmPredictivePECConfigDialogPane(wxWindow *pParent, GuideAlgorithmPredictivePEC *pGuideAlgorithm);
+        virtual ~GuideAlgorithmPredictivePECConfigDialogPane(void);
+
+        virtual void LoadValues(void);
+        virtual void UnloadValues(void);
+    };
+
+    double GetPeriod(void) const;
+    bool SetPeriod(double period);
+    int GetHarmonics(void) const;
+    bool SetHarmonics(int harmonics);
+    double GetGain(void) const;
+    bool SetGain(double gain);
+
+    friend class GuideAlgorithmPredictivePECConfigDialogPane;
+
+public:
+    GuideAlgorithmPredictivePEC(Mount *pMount, GuideAxis axis);
+    virtual ~GuideAlgorithmPredictivePEC(void);
+    virtual GUIDE_ALGORITHM Algorithm(void);
+
+    virtual void reset(void);
+    virtual double result(double input);
+    virtual void GuidingResumed(void);
+    virtual void GuidingDithered(double amt);
+    virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
+    virtual GraphControlPane *GetGraphControlPane(wxWindow *pParent, const wxString& label);
+    virtual wxString GetSettingsSummary();
+    virtual wxString GetGuideAlgorithmClassName(void) const { return "PredictivePEC"; }
+    virtual double GetMinMove(void);
+    virtual bool SetMinMove(double minMove);
+    virtual void ResetParams(void);
+    virtual void GetParamNames(wxArrayString& names) const;
+    virtual bool GetParam(const wxString& name, double *val);
+    virtual bool SetParam(const wxString& name, double val);
+};
+
+#endif /* GUIDE_ALGORITHM_PREDICTIVE_PEC_H_INCLUDED */
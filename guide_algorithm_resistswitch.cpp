@@ -43,7 +43,8 @@ static const double DefaultMinMove = 0.2;
 static const double DefaultAggression = 1.0;
 
 GuideAlgorithmResistSwitch::GuideAlgorithmResistSwitch(Mount *pMount, GuideAxis axis)
-    : GuideAlgorithm(pMount, axis)
+    : GuideAlgorithm(pMount, axis),
+      m_history(HISTORY_SIZE)
 {
     double minMove  = pConfig->Profile.GetDouble(GetConfigPath() + "/minMove", DefaultMinMove);
     SetMinMove(minMove);
@@ -68,7 +69,7 @@ GUIDE_ALGORITHM GuideAlgorithmResistSwitch::Algorithm(void)
 
 void GuideAlgorithmResistSwitch::reset(void)
 {
-    m_history.Empty();
+    m_history.Clear();
 
     while (m_history.GetCount() < HISTORY_SIZE)
     {
@@ -99,7 +100,6 @@ double GuideAlgorithmResistSwitch::result(double input)
     double dReturn = input;
 
     m_history.Add(input);
-    m_history.RemoveAt(0);
 
     try
     {
@@ -118,21 +118,13 @@ double GuideAlgorithmResistSwitch::result(double input)
                 m_currentSide = 0;
                 unsigned int i;
                 for (i = 0; i < HISTORY_SIZE - 3; i++)
-                    m_history[i] = 0.0;
+                    m_history.Set(i, 0.0);
                 for (; i < HISTORY_SIZE; i++)
-                    m_history[i] = input;
+                    m_history.Set(i, input);
             }
         }
 
-        int decHistory = 0;
-
-        for (unsigned int i = 0; i < m_history.GetCount(); i++)
-        {
-            if (fabs(m_history[i]) > m_minMove)
-            {
-                decHistory += sign(m_history[i]);
-            }
-        }
+        int decHistory = m_history.SignSum();
 
         if (m_currentSide == 0 || sign(m_currentSide) == -sign(decHistory))
         {
@@ -197,6 +189,8 @@ bool GuideAlgorithmResistSwitch::SetMinMove(double minMove)
         m_minMove = DefaultMinMove;
     }
 
+    m_history.SetSignThreshold(m_minMove);
+
     pConfig->Profile.SetDouble(GetConfigPath() + "/minMove", m_minMove);
 
     Debug.Write(wxString::Format("GuideAlgorithmResistSwitch::SetMinMove() returns %d, m_minMove=%.2f\n", bError, m_minMove));
@@ -245,6 +239,47 @@ wxString GuideAlgorithmResistSwitch::GetSettingsSummary()
         GetMinMove(), GetAggression() * 100.0, GetFastSwitchEnabled() ? "enabled" : "disabled");
 }
 
+void GuideAlgorithmResistSwitch::GetParamNames(wxArrayString& names) const
+{
+    names.push_back("minMove");
+    names.push_back("aggression");
+    names.push_back("fastSwitch");
+}
+
+bool GuideAlgorithmResistSwitch::GetParam(const wxString& name, double *val)
+{
+    if (name == "minMove")
+    {
+        *val = GetMinMove();
+        return true;
+    }
+    if (name == "aggression")
+    {
+        *val = GetAggression();
+        return true;
+    }
+    if (name == "fastSwitch")
+    {
+        *val = GetFastSwitchEnabled() ? 1.0 : 0.0;
+        return true;
+    }
+    return false;
+}
+
+bool GuideAlgorithmResistSwitch::SetParam(const wxString& name, double val)
+{
+    if (name == "minMove")
+        return !SetMinMove(val);
+    if (name == "aggression")
+        return !SetAggression(val);
+    if (name == "fastSwitch")
+    {
+        SetFastSwitchEnabled(val != 0.0);
+        return true;
+    }
+    return false;
+}
+
 ConfigDialogPane *GuideAlgorithmResistSwitch::GetConfigDialogPane(wxWindow *pParent)
 {
     return new GuideAlgorithmResistSwitchConfigDialogPane(pParent, this);
@@ -52,15 +52,21 @@ enum GUIDE_ALGORITHM
 #if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
     GUIDE_ALGORITHM_GAUSSIAN_PROCESS,
 #endif
+    GUIDE_ALGORITHM_PREDICTIVE_PEC,
+    GUIDE_ALGORITHM_CHAIN,
 
 };
 
+#include "guide_history.h"
 #include "guide_algorithm.h"
 #include "guide_algorithm_identity.h"
 #include "guide_algorithm_hysteresis.h"
 #include "guide_algorithm_lowpass.h"
 #include "guide_algorithm_lowpass2.h"
 #include "guide_algorithm_resistswitch.h"
+#include "guide_algorithm_predictive_pec.h"
+#include "guide_chain.h"
+#include "guide_algorithm_chain.h"
 
 #if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
   #include "guide_algorithm_gaussian_process.h"
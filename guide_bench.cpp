@@ -0,0 +1,328 @@
+/*
+ *  guide_bench.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "guide_bench.h"
+
+#include <wx/ffile.h>
+#include <wx/tokenzr.h>
+
+static const char *BENCH_PROFILE = "PHD2 guide benchmark";
+static const int START_TIMEOUT_SEC = 300;   // to calibrate and start guiding
+
+struct GuideBenchSpec
+{
+    int frames;
+    int width;
+    int height;
+    int stars;
+    bool subframes;
+    bool ao;
+
+    GuideBenchSpec() : frames(2000), width(1280), height(960), stars(20), subframes(false), ao(false) { }
+};
+
+static bool ParseSpec(const wxString& spec, GuideBenchSpec *s, wxString *error)
+{
+    wxStringTokenizer tok(spec, ",");
+    while (tok.HasMoreTokens())
+    {
+        wxString item = tok.GetNextToken().Trim(true).Trim(false);
+        if (item.empty())
+            continue;
+        wxString name = item.BeforeFirst('=');
+        long val;
+        if (!item.AfterFirst('=').ToLong(&val) || val < 0)
+        {
+            *error = wxString::Format("invalid benchmark setting %s", item);
+            return true;
+        }
+        if (name == "frames")
+            s->frames = (int) val;
+        else if (name == "width")
+            s->width = (int) val;
+        else if (name == "height")
+            s->height = (int) val;
+        else if (name == "stars")
+            s->stars = (int) val;
+        else if (name == "subframes")
+            s->subframes = val != 0;
+        else if (name == "ao")
+            s->ao = val != 0;
+        else
+        {
+            *error = wxString::Format("unknown benchmark setting %s", name);
+            return true;
+        }
+    }
+    if (s->frames < 1 || s->width < 64 || s->height < 64)
+    {
+        *error = "benchmark needs frames >= 1 and a frame size of at least 64x64";
+        return true;
+    }
+    return false;
+}
+
+class GuideBenchRunner : public wxEvtHandler
+{
+    enum State
+    {
+        STATE_WAIT_GUIDING,
+        STATE_RUNNING,
+        STATE_STOPPING,
+    };
+
+    GuideBenchSpec m_spec;
+    wxString m_outFile;
+    State m_state;
+    wxTimer m_timer;
+    wxStopWatch m_watch;        // since the start, then since guiding started
+    unsigned int m_startFrame;
+    AllocCounts m_startAllocs;
+    double m_elapsed;
+    unsigned int m_frames;
+    AllocCounts m_allocs;
+
+    void OnTimer(wxTimerEvent& evt);
+    void Finish(const wxString& error);
+
+public:
+    GuideBenchRunner(const GuideBenchSpec& spec, const wxString& outFile);
+    bool Start(wxString *error);
+    void Report(const GuidingPerfReport& report);
+};
+
+static GuideBenchRunner *s_bench;
+
+GuideBenchRunner::GuideBenchRunner(const GuideBenchSpec& spec, const wxString& outFile)
+    : m_spec(spec), m_outFile(outFile), m_state(STATE_WAIT_GUIDING), m_timer(this),
+    m_startFrame(0), m_elapsed(0.0), m_frames(0)
+{
+    memset(&m_startAllocs, 0, sizeof(m_startAllocs));
+    memset(&m_allocs, 0, sizeof(m_allocs));
+    Bind(wxEVT_TIMER, &GuideBenchRunner::OnTimer, this);
+}
+
+static void SetProfileValue(int profileId, const wxString& name, const wxString& val)
+{
+    pConfig->Global.SetString(wxString::Format("/profile/%d%s", profileId, name), val);
+}
+
+static void SetProfileValue(int profileId, const wxString& name, long val)
+{
+    pConfig->Global.SetInt(wxString::Format("/profile/%d%s", profileId, name), val);
+}
+
+bool GuideBenchRunner::Start(wxString *error)
+{
+    if (pConfig->GetProfileId(BENCH_PROFILE) <= 0 && pConfig->CreateProfile(BENCH_PROFILE))
+    {
+        *error = "could not create the benchmark profile";
+        return true;
+    }
+    int id = pConfig->GetProfileId(BENCH_PROFILE);
+
+    SetProfileValue(id, "/camera/LastMenuchoice", _T("Simulator"));
+    SetProfileValue(id, "/scope/LastMenuChoice", _T("On-camera"));
+    SetProfileValue(id, "/scope/LastAuxMenuChoice", _("None"));
+    SetProfileValue(id, "/stepguider/LastMenuChoice", m_spec.ao ? wxString(_T("Simulator")) : _("None"));
+    SetProfileValue(id, "/rotator/LastMenuChoice", _("None"));
+    SetProfileValue(id, "/camera/UseSubframes", (long) m_spec.subframes);
+    SetProfileValue(id, "/ExposureDuration", _T("1.0 s"));
+    SetProfileValue(id, "/SimCam/frame_width", m_spec.width);
+    SetProfileValue(id, "/SimCam/frame_height", m_spec.height);
+    SetProfileValue(id, "/SimCam/nr_stars", m_spec.stars);
+    SetProfileValue(id, "/SimCam/no_wait", 1L);
+
+    if (pFrame->pGearDialog->SetProfile(id, error))
+        return true;
+    if (pFrame->pGearDialog->ConnectAll(error))
+        return true;
+
+    SettleParams settle;
+    settle.tolerancePx = 99.;
+    settle.settleTimeSec = 0;
+    settle.timeoutSec = START_TIMEOUT_SEC;
+    settle.frames = 99999;
+    settle.predictive = false;
+    if (!PhdController::Guide(true, settle, error))
+        return true;
+
+    Debug.Write(wxString::Format("GuideBench: started, %d frames %dx%d, %d stars, subframes %d, AO %d\n",
+        m_spec.frames, m_spec.width, m_spec.height, m_spec.stars, m_spec.subframes, m_spec.ao));
+
+    m_watch.Start();
+    m_timer.Start(100);
+    return false;
+}
+
+void GuideBenchRunner::OnTimer(wxTimerEvent& evt)
+{
+    switch (m_state)
+    {
+    case STATE_WAIT_GUIDING:
+        if (pFrame->pGuider->IsGuiding())
+        {
+            m_startFrame = pFrame->m_frameCounter;
+            AllocTrack::GetCounts(&m_startAllocs);
+            m_watch.Start();
+            m_state = STATE_RUNNING;
+        }
+        else if (m_watch.Time() / 1000 >= START_TIMEOUT_SEC)
+            Finish("timed out waiting for guiding to start");
+        break;
+
+    case STATE_RUNNING:
+        if (!pFrame->pGuider->IsGuiding())
+        {
+            Finish("guiding stopped");
+            break;
+        }
+        if (pFrame->m_frameCounter - m_startFrame >= (unsigned int) m_spec.frames)
+        {
+            m_elapsed = m_watch.Time() / 1000.0;
+            m_frames = pFrame->m_frameCounter - m_startFrame;
+            AllocTrack::GetCounts(&m_allocs);
+            m_allocs.total -= m_startAllocs.total;
+            for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+                m_allocs.tag[i] -= m_startAllocs.tag[i];
+            m_state = STATE_STOPPING;
+            m_timer.Stop();
+            // the perf report follows when guiding has stopped
+            pFrame->StopCapturing();
+        }
+        break;
+
+    case STATE_STOPPING:
+        break;
+    }
+}
+
+void GuideBenchRunner::Report(const GuidingPerfReport& report)
+{
+    if (m_state != STATE_STOPPING)
+        return;
+
+    wxFFile f(m_outFile, "w");
+    if (!f.IsOpened())
+    {
+        Finish(wxString::Format("cannot write %s", m_outFile));
+        return;
+    }
+
+    f.Write(wxString::Format("# PHD2 %s guide loop benchmark, %s, %d cpus\n", FULLVER, wxDateTime::Now().FormatISOCombined(' '),
+        wxThread::GetCPUCount()));
+    f.Write(wxString::Format("# frames=%d,width=%d,height=%d,stars=%d,subframes=%d,ao=%d\n",
+        m_spec.frames, m_spec.width, m_spec.height, m_spec.stars, m_spec.subframes, m_spec.ao));
+    f.Write("key,value\n");
+    f.Write(wxString::Format("frames,%u\n", m_frames));
+    f.Write(wxString::Format("seconds,%.3f\n", m_elapsed));
+    f.Write(wxString::Format("cycles_per_sec,%.2f\n", m_elapsed > 0.0 ? m_frames / m_elapsed : 0.0));
+    f.Write(wxString::Format("cycle_us,%.1f\n", m_frames ? m_elapsed * 1e6 / m_frames : 0.0));
+    if (AllocTrack::IsEnabled() && m_frames)
+    {
+        f.Write(wxString::Format("allocs_per_cycle,%.1f\n", (double) m_allocs.total / m_frames));
+        for (int i = 0; i < NUM_ALLOC_TAGS; i++)
+        {
+            if (m_allocs.tag[i])
+                f.Write(wxString::Format("allocs.%s_per_cycle,%.1f\n", AllocTrack::TagName(i), (double) m_allocs.tag[i] / m_frames));
+        }
+    }
+    f.Write(wxString::Format("star_lost,%u\n", report.starLost));
+    f.Write(wxString::Format("dropped_frames,%u\n", report.droppedFrames));
+    f.Write(wxString::Format("slow_cycles,%u\n", report.slowCycles));
+
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+    {
+        const PerfSummary& p = report.stage[i];
+        if (!p.count)
+            continue;
+        const char *name = PerfStats::StageName((PerfStage) i);
+        f.Write(wxString::Format("%s.count,%u\n", name, p.count));
+        f.Write(wxString::Format("%s.mean_ms,%.3f\n", name, p.meanMs));
+        f.Write(wxString::Format("%s.p50_ms,%.3f\n", name, p.p50Ms));
+        f.Write(wxString::Format("%s.p95_ms,%.3f\n", name, p.p95Ms));
+        f.Write(wxString::Format("%s.p99_ms,%.3f\n", name, p.p99Ms));
+        f.Write(wxString::Format("%s.max_ms,%.3f\n", name, p.maxMs));
+    }
+
+    f.Write(wxString::Format("peak_memory_mb,%.1f\n", report.peakMemory.ToDouble() / (1024.0 * 1024.0)));
+    if (report.processCpu >= 0.0)
+        f.Write(wxString::Format("process_cpu_sec,%.2f\n", report.processCpu));
+    f.Close();
+
+    Finish(wxEmptyString);
+}
+
+void GuideBenchRunner::Finish(const wxString& error)
+{
+    m_timer.Stop();
+
+    if (error.empty())
+        wxMessageOutput::Get()->Printf("Guide loop benchmark results written to %s", m_outFile);
+    else
+        wxMessageOutput::Get()->Printf("Guide loop benchmark failed: %s", error);
+    Debug.Write(wxString::Format("GuideBench: finished %s\n", error.empty() ? wxString("ok") : error));
+
+    // close the frame the way the event server shutdown method does
+    wxCloseEvent *evt = new wxCloseEvent(wxEVT_CLOSE_WINDOW);
+    evt->SetCanVeto(false);
+    wxQueueEvent(pFrame, evt);
+}
+
+bool GuideBench::Start(const wxString& spec, const wxString& outFile, wxString *error)
+{
+    GuideBenchSpec s;
+    if (ParseSpec(spec, &s, error))
+        return true;
+
+    s_bench = new GuideBenchRunner(s, outFile);
+    if (s_bench->Start(error))
+    {
+        delete s_bench;
+        s_bench = 0;
+        return true;
+    }
+    return false;
+}
+
+bool GuideBench::IsRunning()
+{
+    return s_bench != 0;
+}
+
+void GuideBench::NotifyGuidingPerformance(const GuidingPerfReport& report)
+{
+    if (s_bench)
+        s_bench->Report(report);
+}
@@ -0,0 +1,62 @@
+/*
+ *  guide_bench.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_BENCH_INCLUDED
+#define GUIDE_BENCH_INCLUDED
+
+struct GuidingPerfReport;
+
+// End-to-end benchmark of the guide loop: PHD2 runs headless with the
+// simulator camera, its on-camera mount and optionally the simulated AO,
+// calibrates and guides for a number of frames as fast as it can, then
+// writes the throughput and the per-stage latencies to a CSV file and exits.
+// The simulator renders each frame as a 1 s exposure but does not wait out
+// exposures or guide pulses.
+//
+// The spec is a comma separated list of settings, all optional:
+//
+//   frames=2000,width=1280,height=960,stars=20,subframes=1,ao=0
+//
+// The run uses its own profile, "PHD2 guide benchmark". Allocations per
+// cycle, in total and by subsystem, are reported by builds that count them
+// (see AllocTrack).
+struct GuideBench
+{
+    // returns true on error
+    static bool Start(const wxString& spec, const wxString& outFile, wxString *error);
+    static bool IsRunning();
+    // the perf report of the guiding run, called when guiding stops
+    static void NotifyGuidingPerformance(const GuidingPerfReport& report);
+};
+
+#endif
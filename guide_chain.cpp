@@ -0,0 +1,253 @@
+/*
+ *  guide_chain.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <wx/tokenzr.h>
+
+#include <stddef.h>
+
+namespace
+{
+
+struct ChainParam
+{
+    const char *name;
+    size_t offset;          // within GuideChainStageData
+    double lo, hi;          // accepted values
+};
+
+struct ChainStageDef
+{
+    GUIDE_CHAIN_STAGE type;
+    const char *name;
+    ChainParam params[4];   // ended by a null name
+};
+
+}
+
+#define CHAIN_PARAM(stage, member, lo, hi) { #member, offsetof(stage, member), lo, hi }
+
+static const ChainStageDef StageDefs[GUIDE_CHAIN_STAGE_COUNT] =
+{
+    { GUIDE_CHAIN_HYSTERESIS, "hysteresis",
+        { CHAIN_PARAM(HysteresisStage, minMove, 0.0, 20.0),
+          CHAIN_PARAM(HysteresisStage, hysteresis, 0.0, 0.99),
+          CHAIN_PARAM(HysteresisStage, aggression, 0.0, 2.0),
+          { 0 } } },
+    { GUIDE_CHAIN_RESIST_SWITCH, "resistswitch",
+        { CHAIN_PARAM(ResistSwitchStage, minMove, 0.001, 20.0),
+          CHAIN_PARAM(ResistSwitchStage, aggression, 0.0, 2.0),
+          CHAIN_PARAM(ResistSwitchStage, fastSwitch, 0.0, 1.0),
+          { 0 } } },
+    { GUIDE_CHAIN_LOWPASS, "lowpass",
+        { CHAIN_PARAM(LowpassStage, minMove, 0.0, 20.0),
+          CHAIN_PARAM(LowpassStage, slopeWeight, 0.0, 20.0),
+          { 0 } } },
+    { GUIDE_CHAIN_LIMIT, "limit",
+        { CHAIN_PARAM(LimitStage, max, 0.0, 1000.0),
+          CHAIN_PARAM(LimitStage, dir, -1.0, 1.0),
+          { 0 } } },
+};
+
+#undef CHAIN_PARAM
+
+static double& ParamRef(GuideChainStage& stage, const ChainParam& param)
+{
+    return *reinterpret_cast<double *>(reinterpret_cast<char *>(&stage.u) + param.offset);
+}
+
+static double ParamVal(const GuideChainStage& stage, const ChainParam& param)
+{
+    return *reinterpret_cast<const double *>(reinterpret_cast<const char *>(&stage.u) + param.offset);
+}
+
+static const ChainParam *FindParam(GUIDE_CHAIN_STAGE type, const wxString& name)
+{
+    for (const ChainParam *p = StageDefs[type].params; p->name; p++)
+        if (name == p->name)
+            return p;
+    return 0;
+}
+
+static void SetStageDefaults(GuideChainStage& stage)
+{
+    switch (stage.type)
+    {
+    case GUIDE_CHAIN_HYSTERESIS: stage.u.hysteresis.SetDefaults(); break;
+    case GUIDE_CHAIN_RESIST_SWITCH: stage.u.resistSwitch.SetDefaults(); break;
+    case GUIDE_CHAIN_LOWPASS: stage.u.lowpass.SetDefaults(); break;
+    case GUIDE_CHAIN_LIMIT: stage.u.limit.SetDefaults(); break;
+    default: break;
+    }
+}
+
+bool GuideChain::Parse(const wxString& spec, wxString *errorMsg)
+{
+    std::vector<GuideChainStage> stages;
+
+    wxArrayString items = wxSplit(spec, '>', 0);
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        wxString item = items[i].Strip(wxString::both);
+        if (item.empty())
+            continue;
+
+        wxString name = item.BeforeFirst('(').Strip(wxString::both).Lower();
+        wxString args;
+        if (item.Find('(') != wxNOT_FOUND)
+        {
+            if (!item.EndsWith(")"))
+            {
+                *errorMsg = wxString::Format("missing ) after %s", name);
+                return true;
+            }
+            args = item.AfterFirst('(').BeforeLast(')');
+        }
+
+        GuideChainStage stage;
+        memset(&stage, 0, sizeof(stage));
+        int type;
+        for (type = 0; type < GUIDE_CHAIN_STAGE_COUNT; type++)
+            if (name == StageDefs[type].name)
+                break;
+        if (type == GUIDE_CHAIN_STAGE_COUNT)
+        {
+            *errorMsg = wxString::Format("unknown stage %s", name);
+            return true;
+        }
+        stage.type = (GUIDE_CHAIN_STAGE) type;
+        SetStageDefaults(stage);
+
+        wxArrayString settings = wxStringTokenize(args, ", ", wxTOKEN_STRTOK);
+        for (size_t j = 0; j < settings.size(); j++)
+        {
+            wxString key = settings[j].BeforeFirst('=');
+            const ChainParam *param = FindParam(stage.type, key);
+            double val;
+            if (!param || !settings[j].AfterFirst('=').ToCDouble(&val) || val < param->lo || val > param->hi)
+            {
+                *errorMsg = wxString::Format("bad setting %s for %s", settings[j], name);
+                return true;
+            }
+            ParamRef(stage, *param) = val;
+        }
+
+        stages.push_back(stage);
+    }
+
+    m_stages.swap(stages);
+    Reset();
+    return false;
+}
+
+wxString GuideChain::Format(void) const
+{
+    wxString spec;
+    for (size_t i = 0; i < m_stages.size(); i++)
+    {
+        const GuideChainStage& stage = m_stages[i];
+        const ChainStageDef& def = StageDefs[stage.type];
+        if (i > 0)
+            spec += " > ";
+        spec += def.name;
+        spec += "(";
+        for (const ChainParam *p = def.params; p->name; p++)
+        {
+            if (p != def.params)
+                spec += ",";
+            spec += wxString::Format("%s=%s", p->name, wxString::FromCDouble(ParamVal(stage, *p)));
+        }
+        spec += ")";
+    }
+    return spec;
+}
+
+// the stage a stage.param name refers to, m_stages.size() if none
+static size_t FindStage(const std::vector<GuideChainStage>& stages, const wxString& name, wxString *param)
+{
+    wxString which = name.BeforeFirst('.');
+    *param = name.AfterFirst('.');
+
+    long n;
+    if (which.ToLong(&n))
+        return n >= 1 && (size_t) n <= stages.size() ? (size_t) n - 1 : stages.size();
+
+    for (size_t i = 0; i < stages.size(); i++)
+        if (which == StageDefs[stages[i].type].name)
+            return i;
+    return stages.size();
+}
+
+void GuideChain::GetParamNames(wxArrayString& names) const
+{
+    for (size_t i = 0; i < m_stages.size(); i++)
+    {
+        const ChainStageDef& def = StageDefs[m_stages[i].type];
+
+        bool first = true;
+        for (size_t j = 0; j < i; j++)
+            if (m_stages[j].type == m_stages[i].type)
+                first = false;
+        wxString prefix = first ? wxString(def.name) : wxString::Format("%u", (unsigned int) i + 1);
+
+        for (const ChainParam *p = def.params; p->name; p++)
+            names.push_back(prefix + "." + p->name);
+    }
+}
+
+bool GuideChain::GetParam(const wxString& name, double *val) const
+{
+    wxString key;
+    size_t i = FindStage(m_stages, name, &key);
+    if (i == m_stages.size())
+        return false;
+    const ChainParam *param = FindParam(m_stages[i].type, key);
+    if (!param)
+        return false;
+    *val = ParamVal(m_stages[i], *param);
+    return true;
+}
+
+bool GuideChain::SetParam(const wxString& name, double val)
+{
+    wxString key;
+    size_t i = FindStage(m_stages, name, &key);
+    if (i == m_stages.size())
+        return false;
+    const ChainParam *param = FindParam(m_stages[i].type, key);
+    if (!param || val < param->lo || val > param->hi)
+        return false;
+    ParamRef(m_stages[i], *param) = val;
+    return true;
+}
@@ -0,0 +1,385 @@
+/*
+ *  guide_chain.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_CHAIN_H_INCLUDED
+#define GUIDE_CHAIN_H_INCLUDED
+
+#include <algorithm>
+#include <stdlib.h>
+#include <vector>
+
+// A guide chain computes the correction for one axis by passing the offset
+// through a fixed sequence of filter stages. Each stage is a plain struct
+// holding its settings and its state side by side, with an inline Step(), so
+// a chain runs without virtual calls, allocation or logging.
+//
+// ChainOf<A, B, ...> fuses stages known at compile time into one inlined
+// Step(); GuideChain is the same sequence built at run time from a spec
+//
+//   hysteresis(minMove=0.2,aggression=0.7) > resistswitch > limit(max=3)
+//
+// and dispatches on the stage type over a contiguous array of stages. Its
+// Run() hands the built-in combinations below to their fused ChainOf.
+//
+// The Hysteresis, ResistSwitch and Lowpass stages compute exactly what the
+// guide algorithms of the same names do.
+
+enum GUIDE_CHAIN_STAGE
+{
+    GUIDE_CHAIN_HYSTERESIS,
+    GUIDE_CHAIN_RESIST_SWITCH,
+    GUIDE_CHAIN_LOWPASS,
+    GUIDE_CHAIN_LIMIT,
+    GUIDE_CHAIN_STAGE_COUNT
+};
+
+struct HysteresisStage
+{
+    enum { TYPE = GUIDE_CHAIN_HYSTERESIS };
+
+    double minMove;
+    double hysteresis;
+    double aggression;
+
+    double lastMove;
+
+    void SetDefaults() { minMove = 0.2; hysteresis = 0.1; aggression = 0.7; Reset(); }
+    void Reset() { lastMove = 0.0; }
+
+    double Step(double input)
+    {
+        double ret = ((1.0 - hysteresis) * input + hysteresis * lastMove) * aggression;
+        if (fabs(input) < minMove)
+            ret = 0.0;
+        lastMove = ret;
+        return ret;
+    }
+};
+
+struct ResistSwitchStage
+{
+    enum { TYPE = GUIDE_CHAIN_RESIST_SWITCH };
+    enum { HISTORY = 10 };
+
+    double minMove;
+    double aggression;
+    double fastSwitch;          // non-zero to follow large excursions at once
+
+    double history[HISTORY];    // ring, history[next] is the oldest
+    int next;
+    int currentSide;
+
+    void SetDefaults() { minMove = 0.2; aggression = 1.0; fastSwitch = 1.0; Reset(); }
+
+    void Reset()
+    {
+        for (int i = 0; i < HISTORY; i++)
+            history[i] = 0.0;
+        next = 0;
+        currentSide = 0;
+    }
+
+    static int Sign(double x) { return x > 0.0 ? 1 : x < 0.0 ? -1 : 0; }
+
+    double At(int i) const { return history[(next + i) % HISTORY]; }
+
+    double Step(double input)
+    {
+        history[next] = input;
+        next = (next + 1) % HISTORY;
+
+        if (fabs(input) < minMove)
+            return 0.0;
+
+        int side = Sign(input);
+
+        if (fastSwitch != 0.0 && side != currentSide && fabs(input) > 3.0 * minMove)
+        {
+            currentSide = 0;
+            for (int i = 0; i < HISTORY; i++)
+                history[(next + i) % HISTORY] = i < HISTORY - 3 ? 0.0 : input;
+        }
+
+        int signSum = 0;
+        for (int i = 0; i < HISTORY; i++)
+            if (fabs(history[i]) > minMove)
+                signSum += Sign(history[i]);
+
+        if (currentSide == 0 || currentSide == -Sign(signSum))
+        {
+            if (abs(signSum) < 3)
+                return 0.0;
+
+            double oldest = At(0) + At(1) + At(2);
+            double newest = At(HISTORY - 1) + At(HISTORY - 2) + At(HISTORY - 3);
+            if (fabs(newest) <= fabs(oldest))
+                return 0.0;
+
+            currentSide = Sign(signSum);
+        }
+
+        if (currentSide != side)
+            return 0.0;
+
+        return input * aggression;
+    }
+};
+
+struct LowpassStage
+{
+    enum { TYPE = GUIDE_CHAIN_LOWPASS };
+    enum { HISTORY = 10 };
+
+    double minMove;
+    double slopeWeight;
+
+    double history[HISTORY];    // ring, history[next] is the oldest
+    int next;
+
+    void SetDefaults() { minMove = 0.2; slopeWeight = 5.0; Reset(); }
+
+    void Reset()
+    {
+        for (int i = 0; i < HISTORY; i++)
+            history[i] = 0.0;
+        next = 0;
+    }
+
+    double Step(double input)
+    {
+        // median of the history and the input, then the oldest is dropped
+        double window[HISTORY + 1];
+        for (int i = 0; i < HISTORY; i++)
+            window[i] = history[i];
+        window[HISTORY] = input;
+        std::nth_element(window, window + HISTORY / 2, window + HISTORY + 1);
+        double median = window[HISTORY / 2];
+
+        history[next] = input;
+        next = (next + 1) % HISTORY;
+
+        // least-squares slope against 1 .. HISTORY, as CalcSlope()
+        double sxy = 0.0, sy = 0.0;
+        for (int i = 0; i < HISTORY; i++)
+        {
+            double y = history[(next + i) % HISTORY];
+            sxy += (i + 1) * y;
+            sy += y;
+        }
+        const double n = HISTORY;
+        const double sx = n * (n + 1.0) / 2.0;
+        const double sxx = sx * (2.0 * n + 1.0) / 3.0;
+        double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+
+        double ret = median + slopeWeight * slope;
+        if (fabs(ret) > fabs(input))
+            ret = input;
+        if (fabs(input) < minMove)
+            ret = 0.0;
+        return ret;
+    }
+};
+
+// Clamps the correction, the chain's counterpart of the mount's max move
+// and Dec guide mode: max is the largest correction in pixels, 0 for no
+// limit, and dir +1 or -1 passes only corrections of that sign.
+struct LimitStage
+{
+    enum { TYPE = GUIDE_CHAIN_LIMIT };
+
+    double max;
+    double dir;
+
+    void SetDefaults() { max = 0.0; dir = 0.0; }
+    void Reset() { }
+
+    double Step(double input)
+    {
+        if (input * dir < 0.0)
+            return 0.0;
+        if (max > 0.0)
+        {
+            if (input > max)
+                return max;
+            if (input < -max)
+                return -max;
+        }
+        return input;
+    }
+};
+
+union GuideChainStageData
+{
+    HysteresisStage hysteresis;
+    ResistSwitchStage resistSwitch;
+    LowpassStage lowpass;
+    LimitStage limit;
+};
+
+struct GuideChainStage
+{
+    GUIDE_CHAIN_STAGE type;
+    GuideChainStageData u;
+};
+
+template<class S> struct GuideChainStageAccess;
+template<> struct GuideChainStageAccess<HysteresisStage>
+{ static const HysteresisStage& Get(const GuideChainStage& s) { return s.u.hysteresis; } };
+template<> struct GuideChainStageAccess<ResistSwitchStage>
+{ static const ResistSwitchStage& Get(const GuideChainStage& s) { return s.u.resistSwitch; } };
+template<> struct GuideChainStageAccess<LowpassStage>
+{ static const LowpassStage& Get(const GuideChainStage& s) { return s.u.lowpass; } };
+template<> struct GuideChainStageAccess<LimitStage>
+{ static const LimitStage& Get(const GuideChainStage& s) { return s.u.limit; } };
+
+template<typename... Stages> struct ChainOf;
+
+template<> struct ChainOf<>
+{
+    void Reset() { }
+    double Step(double input) { return input; }
+    static bool Matches(const GuideChainStage *, size_t n) { return n == 0; }
+    void Load(const GuideChainStage *) { }
+};
+
+template<typename S, typename... Rest> struct ChainOf<S, Rest...>
+{
+    S first;
+    ChainOf<Rest...> rest;
+
+    void Reset() { first.Reset(); rest.Reset(); }
+    double Step(double input) { return rest.Step(first.Step(input)); }
+
+    // whether a run-time chain has exactly these stages
+    static bool Matches(const GuideChainStage *s, size_t n)
+    {
+        return n > 0 && s->type == (GUIDE_CHAIN_STAGE) S::TYPE && ChainOf<Rest...>::Matches(s + 1, n - 1);
+    }
+
+    // copies the settings and state of a matching run-time chain
+    void Load(const GuideChainStage *s)
+    {
+        first = GuideChainStageAccess<S>::Get(*s);
+        rest.Load(s + 1);
+    }
+};
+
+// the combinations GuideChain::Run() fuses
+typedef ChainOf<HysteresisStage> HysteresisChain;
+typedef ChainOf<HysteresisStage, LimitStage> HysteresisLimitChain;
+typedef ChainOf<ResistSwitchStage> ResistSwitchChain;
+typedef ChainOf<ResistSwitchStage, LimitStage> ResistSwitchLimitChain;
+typedef ChainOf<LowpassStage> LowpassChain;
+typedef ChainOf<LowpassStage, LimitStage> LowpassLimitChain;
+typedef ChainOf<HysteresisStage, ResistSwitchStage, LowpassStage, LimitStage> FullChain;
+
+class GuideChain
+{
+    std::vector<GuideChainStage> m_stages;
+
+    template<class Chain, class Loop>
+    bool TryFused(Loop& loop) const
+    {
+        if (!Chain::Matches(m_stages.empty() ? 0 : &m_stages[0], m_stages.size()))
+            return false;
+        Chain chain;
+        chain.Load(&m_stages[0]);
+        loop(chain);
+        return true;
+    }
+
+public:
+    // returns true on error, leaving the chain unchanged
+    bool Parse(const wxString& spec, wxString *errorMsg);
+    wxString Format(void) const;
+
+    size_t Size(void) const { return m_stages.size(); }
+
+    void Reset(void)
+    {
+        for (size_t i = 0; i < m_stages.size(); i++)
+        {
+            GuideChainStage& s = m_stages[i];
+            switch (s.type)
+            {
+            case GUIDE_CHAIN_HYSTERESIS: s.u.hysteresis.Reset(); break;
+            case GUIDE_CHAIN_RESIST_SWITCH: s.u.resistSwitch.Reset(); break;
+            case GUIDE_CHAIN_LOWPASS: s.u.lowpass.Reset(); break;
+            case GUIDE_CHAIN_LIMIT: s.u.limit.Reset(); break;
+            default: break;
+            }
+        }
+    }
+
+    double Step(double input)
+    {
+        for (size_t i = 0; i < m_stages.size(); i++)
+        {
+            GuideChainStage& s = m_stages[i];
+            switch (s.type)
+            {
+            case GUIDE_CHAIN_HYSTERESIS: input = s.u.hysteresis.Step(input); break;
+            case GUIDE_CHAIN_RESIST_SWITCH: input = s.u.resistSwitch.Step(input); break;
+            case GUIDE_CHAIN_LOWPASS: input = s.u.lowpass.Step(input); break;
+            case GUIDE_CHAIN_LIMIT: input = s.u.limit.Step(input); break;
+            default: break;
+            }
+        }
+        return input;
+    }
+
+    // Calls loop(chain) with a copy of this chain, fused into its ChainOf
+    // when it is one of the built-in combinations. For long replays; this
+    // chain's own state is not advanced.
+    template<class Loop>
+    void Run(Loop& loop) const
+    {
+        if (TryFused<HysteresisChain>(loop) || TryFused<HysteresisLimitChain>(loop) ||
+            TryFused<ResistSwitchChain>(loop) || TryFused<ResistSwitchLimitChain>(loop) ||
+            TryFused<LowpassChain>(loop) || TryFused<LowpassLimitChain>(loop) ||
+            TryFused<FullChain>(loop))
+        {
+            return;
+        }
+        GuideChain chain(*this);
+        loop(chain);
+    }
+
+    // settings are named stage.param, e.g. hysteresis.minMove, for the
+    // first stage of that kind, or 2.minMove for the second stage
+    void GetParamNames(wxArrayString& names) const;
+    bool GetParam(const wxString& name, double *val) const;
+    bool SetParam(const wxString& name, double val);
+};
+
+#endif // GUIDE_CHAIN_H_INCLUDED
@@ -0,0 +1,136 @@
+/*
+ *  guide_history.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+GuideHistory::GuideHistory(unsigned int capacity)
+    : m_values(capacity),
+    m_sumY(0.0),
+    m_sumXY(0.0),
+    m_threshold(0.0),
+    m_signSum(0),
+    m_addsSinceRebuild(0)
+{
+}
+
+int GuideHistory::Tally(double value) const
+{
+    if (fabs(value) <= m_threshold)
+        return 0;
+    return value > 0.0 ? 1 : -1;
+}
+
+void GuideHistory::Rebuild(void)
+{
+    m_sumY = 0.0;
+    m_sumXY = 0.0;
+    m_signSum = 0;
+
+    circular_buffer<double>::span seg[2];
+    m_values.segments(&seg[0], &seg[1]);
+
+    unsigned int x = 0;
+    for (int s = 0; s < 2; s++)
+    {
+        const double *y = seg[s].data;
+        for (unsigned int i = 0; i < seg[s].size; i++)
+        {
+            ++x;
+            m_sumY += y[i];
+            m_sumXY += (double) x * y[i];
+            m_signSum += Tally(y[i]);
+        }
+    }
+
+    m_addsSinceRebuild = 0;
+}
+
+void GuideHistory::Clear(void)
+{
+    m_values.clear();
+    Rebuild();
+}
+
+void GuideHistory::Add(double value)
+{
+    unsigned int const n = m_values.size();
+
+    if (n == m_values.capacity())
+    {
+        // dropping the oldest shifts every weight down by one
+        double const oldest = m_values[0];
+        m_sumXY += (double) n * value - m_sumY;
+        m_sumY += value - oldest;
+        m_signSum += Tally(value) - Tally(oldest);
+    }
+    else
+    {
+        m_sumXY += (double)(n + 1) * value;
+        m_sumY += value;
+        m_signSum += Tally(value);
+    }
+
+    m_values.push_front(value);
+
+    if (++m_addsSinceRebuild >= m_values.capacity())
+        Rebuild();
+}
+
+void GuideHistory::Set(unsigned int n, double value)
+{
+    double const prev = m_values[n];
+    m_values[n] = value;
+    m_sumY += value - prev;
+    m_sumXY += (double)(n + 1) * (value - prev);
+    m_signSum += Tally(value) - Tally(prev);
+}
+
+double GuideHistory::Slope(void) const
+{
+    unsigned int const nn = m_values.size();
+
+    if (nn < 2)
+        return 0.;
+
+    double const n = (double) nn;
+    double const s_x = n * (n + 1.0) / 2.0;
+    double const s_xx = s_x * (2.0 * n + 1.0) / 3.0;
+    return (n * m_sumXY - s_x * m_sumY) / (n * s_xx - s_x * s_x);
+}
+
+void GuideHistory::SetSignThreshold(double threshold)
+{
+    m_threshold = threshold;
+    Rebuild();
+}
@@ -0,0 +1,72 @@
+/*
+ *  guide_history.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_HISTORY_INCLUDED
+#define GUIDE_HISTORY_INCLUDED
+
+// The latest inputs of a guide algorithm, oldest first, in a fixed-capacity
+// ring. Running sums make the least-squares slope and the sign tally O(1)
+// per step whatever the capacity; the sums are rebuilt once per capacity
+// inputs so rounding errors cannot accumulate.
+class GuideHistory
+{
+    circular_buffer<double> m_values;
+    double m_sumY;          // sum of the values
+    double m_sumXY;         // sum of (i + 1) * value, i counted from the oldest
+    double m_threshold;     // values no larger than this are left out of the tally
+    int m_signSum;          // sum of the signs of the values beyond the threshold
+    unsigned int m_addsSinceRebuild;
+
+    int Tally(double value) const;
+    void Rebuild(void);
+
+public:
+    GuideHistory(unsigned int capacity);
+
+    void Clear(void);
+    void Add(double value);
+    void Set(unsigned int n, double value);
+
+    double operator[](unsigned int n) const { return m_values[n]; }
+    unsigned int GetCount(void) const { return m_values.size(); }
+    unsigned int GetCapacity(void) const { return m_values.capacity(); }
+
+    // slope of the values against 1, 2, ... n, as CalcSlope()
+    double Slope(void) const;
+
+    // the sum of sign(value) over the values whose magnitude exceeds the threshold
+    int SignSum(void) const { return m_signSum; }
+    void SetSignThreshold(double threshold);
+};
+
+#endif
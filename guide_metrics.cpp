@@ -0,0 +1,187 @@
+/*
+ *  guide_metrics.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#if defined(__WINDOWS__)
+# include <psapi.h>
+# pragma comment(lib, "psapi.lib")
+#elif defined(__APPLE__)
+# include <mach/mach.h>
+# include <pthread.h>
+# include <sys/resource.h>
+#else
+# include <pthread.h>
+# include <sys/resource.h>
+# include <time.h>
+# include <unistd.h>
+#endif
+
+GuideLoopMetrics GuideMetrics;
+
+void GuideLoopMetrics::AddFrame(double starFindMs)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    ++m_stats.frames;
+    m_stats.starFind.Add(starFindMs);
+}
+
+void GuideLoopMetrics::AddStarLost(bool guiding)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    ++m_stats.starLost;
+    if (guiding)
+        ++m_stats.droppedFrames;
+}
+
+void GuideLoopMetrics::AddAlgorithm(double ms)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    m_stats.algorithm.Add(ms);
+}
+
+void GuideLoopMetrics::AddStaleFrames(unsigned int count)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    m_stats.staleFrames += count;
+}
+
+GuideLoopStats GuideLoopMetrics::GetStats(void)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    return m_stats;
+}
+
+void GuideLoopMetrics::Reset(void)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    m_stats = GuideLoopStats();
+}
+
+wxLongLong GuideLoopMetrics::ProcessMemory(void)
+{
+#if defined(__WINDOWS__)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return wxLongLong((wxLongLong_t) pmc.WorkingSetSize);
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) == KERN_SUCCESS)
+        return wxLongLong((wxLongLong_t) info.resident_size);
+    return 0;
+#else
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    int n = fscanf(fp, "%ld %ld", &pages, &resident);
+    fclose(fp);
+    if (n != 2)
+        return 0;
+    return wxLongLong((wxLongLong_t) resident * sysconf(_SC_PAGESIZE));
+#endif
+}
+
+wxLongLong GuideLoopMetrics::PeakProcessMemory(void)
+{
+#if defined(__WINDOWS__)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return wxLongLong((wxLongLong_t) pmc.PeakWorkingSetSize);
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+# if defined(__APPLE__)
+    return wxLongLong((wxLongLong_t) ru.ru_maxrss);             // bytes
+# else
+    return wxLongLong((wxLongLong_t) ru.ru_maxrss * 1024);      // kilobytes
+# endif
+#endif
+}
+
+#if defined(__WINDOWS__)
+static double FileTimeSeconds(const FILETIME& ft)
+{
+    ULARGE_INTEGER t;
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    return (double) t.QuadPart * 1e-7;      // 100 ns units
+}
+#endif
+
+double GuideLoopMetrics::ProcessCpuTime(void)
+{
+#if defined(__WINDOWS__)
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+        return -1.0;
+    return FileTimeSeconds(kernel) + FileTimeSeconds(user);
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return -1.0;
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+#endif
+}
+
+double GuideLoopMetrics::ThreadCpuTime(wxThreadIdType threadId)
+{
+#if defined(__WINDOWS__)
+    HANDLE h = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, (DWORD) threadId);
+    if (!h)
+        return -1.0;
+    FILETIME created, exited, kernel, user;
+    BOOL ok = GetThreadTimes(h, &created, &exited, &kernel, &user);
+    CloseHandle(h);
+    return ok ? FileTimeSeconds(kernel) + FileTimeSeconds(user) : -1.0;
+#elif defined(__APPLE__)
+    mach_port_t port = pthread_mach_thread_np((pthread_t) threadId);
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(port, THREAD_BASIC_INFO, (thread_info_t) &info, &count) != KERN_SUCCESS)
+        return -1.0;
+    return info.user_time.seconds + info.user_time.microseconds * 1e-6 +
+        info.system_time.seconds + info.system_time.microseconds * 1e-6;
+#else
+    clockid_t cid;
+    struct timespec ts;
+    if (pthread_getcpuclockid((pthread_t) threadId, &cid) != 0 || clock_gettime(cid, &ts) != 0)
+        return -1.0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
@@ -0,0 +1,78 @@
+/*
+ *  guide_metrics.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDE_METRICS_INCLUDED
+#define GUIDE_METRICS_INCLUDED
+
+// Guide loop counters and latency histograms that are not already kept by the
+// camera (CaptureTimingStats) or the worker threads (WorkerThreadStats); together
+// they are reported by the get_metrics server method
+struct GuideLoopStats
+{
+    CaptureLatency starFind;        // locating the guide star in a frame
+    CaptureLatency algorithm;       // guide algorithms computing a correction
+    unsigned int frames;            // frames processed by the guider
+    unsigned int starLost;          // frames where a selected star was not found
+    unsigned int droppedFrames;     // frames dropped while guiding
+    unsigned int staleFrames;       // buffered frames the camera discarded as older than the exposure
+
+    GuideLoopStats() : frames(0), starLost(0), droppedFrames(0), staleFrames(0) { }
+};
+
+class GuideLoopMetrics
+{
+    wxCriticalSection m_lock;       // star finding runs in the main thread, the algorithms in the mount thread
+    GuideLoopStats m_stats;
+
+public:
+    void AddFrame(double starFindMs);
+    void AddStarLost(bool guiding);
+    void AddAlgorithm(double ms);
+    void AddStaleFrames(unsigned int count);
+
+    GuideLoopStats GetStats(void);
+    void Reset(void);
+
+    // resident memory of the process in bytes, 0 if unknown
+    static wxLongLong ProcessMemory(void);
+    // largest resident memory of the process since it started, 0 if unknown
+    static wxLongLong PeakProcessMemory(void);
+    // CPU time (user + system) in seconds, negative if unknown
+    static double ProcessCpuTime(void);
+    static double ThreadCpuTime(wxThreadIdType threadId);
+};
+
+extern GuideLoopMetrics GuideMetrics;
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ *  guide_telemetry.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+GuideTelemetry Telemetry;
+
+double TelemetryMoments::Rms() const
+{
+    if (n == 0)
+        return 0.0;
+    return sqrt(wxMax(0.0, n * sum2 - sum * sum)) / n;
+}
+
+GuideTelemetry::GuideTelemetry()
+    :
+    m_appended(0)
+{
+}
+
+void GuideTelemetry::Init()
+{
+    int retention = pConfig->Global.GetInt("/telemetry/retention", DefaultRetention);
+    if (retention < MinRetention)
+        retention = MinRetention;
+
+    m_timestamp.resize(retention);
+    m_dx.resize(retention);
+    m_dy.resize(retention);
+    m_ra.resize(retention);
+    m_dec.resize(retention);
+    m_raDur.resize(retention);
+    m_decDur.resize(retention);
+    m_snr.resize(retention);
+    m_mass.resize(retention);
+    m_flags.resize(retention);
+
+    Debug.Write(wxString::Format("Telemetry: retention %d steps, %.1f MB\n", retention,
+        (double) MemoryBytes() / (1024.0 * 1024.0)));
+}
+
+void GuideTelemetry::Append(const GuideStepInfo& step)
+{
+    m_timestamp.push_front(::wxGetUTCTimeMillis().GetValue());
+    m_dx.push_front(step.cameraOffset.X);
+    m_dy.push_front(step.cameraOffset.Y);
+    m_ra.push_front(step.mountOffset.X);
+    m_dec.push_front(step.mountOffset.Y);
+    m_raDur.push_front(step.durationRA);
+    m_decDur.push_front(step.durationDec);
+    m_snr.push_front(step.starSNR);
+    m_mass.push_front(step.starMass);
+    m_flags.push_front((step.raLimited ? FLAG_RA_LIMITED : 0) | (step.decLimited ? FLAG_DEC_LIMITED : 0));
+    ++m_appended;
+
+    wxLongLong_t const t0 = m_timestamp[0];
+    while (!m_dithers.empty() && m_dithers.front().timestamp < t0)
+        m_dithers.pop_front();
+}
+
+void GuideTelemetry::AppendDither(const DitherInfo& info)
+{
+    m_dithers.push_back(info);
+}
+
+size_t GuideTelemetry::MemoryBytes() const
+{
+    size_t const perStep = sizeof(wxLongLong_t) + 6 * sizeof(double) + 2 * sizeof(int) + sizeof(unsigned char);
+    return perStep * Retention();
+}
+
+S_HISTORY GuideTelemetry::Row(long long seq) const
+{
+    assert(seq >= Begin() && seq < End());
+    unsigned int const n = (unsigned int)(seq - Begin());
+
+    S_HISTORY h;
+    h.timestamp = m_timestamp[n];
+    h.dx = m_dx[n];
+    h.dy = m_dy[n];
+    h.ra = m_ra[n];
+    h.dec = m_dec[n];
+    h.raDur = m_raDur[n];
+    h.decDur = m_decDur[n];
+    h.starSNR = m_snr[n];
+    h.starMass = m_mass[n];
+    h.raLimited = (m_flags[n] & FLAG_RA_LIMITED) != 0;
+    h.decLimited = (m_flags[n] & FLAG_DEC_LIMITED) != 0;
+    return h;
+}
+
+// a plain loop over contiguous values, for the compiler to vectorize
+static void AccumulateRun(const double *p, unsigned int n, TelemetryMoments *m)
+{
+    double sum = 0.0, sum2 = 0.0, peak = m->peak;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double const v = p[i];
+        sum += v;
+        sum2 += v * v;
+        double const a = fabs(v);
+        peak = a > peak ? a : peak;
+    }
+    m->n += n;
+    m->sum += sum;
+    m->sum2 += sum2;
+    m->peak = peak;
+}
+
+void GuideTelemetry::Accumulate(const circular_buffer<double>& column, unsigned int first, unsigned int last,
+                                TelemetryMoments *m)
+{
+    assert(first <= last && last <= column.size());
+
+    circular_buffer<double>::span a, b;
+    column.segments(&a, &b);
+
+    if (first < a.size)
+        AccumulateRun(a.data + first, wxMin(last, a.size) - first, m);
+    if (last > a.size)
+    {
+        unsigned int const start = first > a.size ? first - a.size : 0;
+        AccumulateRun(b.data + start, last - a.size - start, m);
+    }
+}
+
+TelemetryView::TelemetryView(const GuideTelemetry& store, unsigned int capacity)
+    :
+    m_store(store),
+    m_begin(store.End()),
+    m_end(store.End()),
+    m_capacity(capacity)
+{
+}
+
+void TelemetryView::resize(unsigned int capacity)
+{
+    m_capacity = capacity;
+    if (m_end - m_begin > (long long) m_capacity)
+        m_begin = m_end - m_capacity;
+}
+
+void TelemetryView::pop_back(unsigned int n)
+{
+    assert(n <= size());
+    m_begin = First() + n;
+}
+
+void TelemetryView::Advance()
+{
+    assert(m_end < m_store.End());
+    ++m_end;
+    if (m_end - m_begin > (long long) m_capacity)
+        m_begin = m_end - m_capacity;
+}
@@ -0,0 +1,183 @@
+/*
+ *  guide_telemetry.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDE_TELEMETRY_INCLUDED
+#define GUIDE_TELEMETRY_INCLUDED
+
+#include <deque>
+
+// one guide step, as the views read it back from the telemetry store
+struct S_HISTORY
+{
+    wxLongLong_t timestamp;
+    double dx;
+    double dy;
+    double ra;
+    double dec;
+    int raDur;
+    int decDur;
+    double starSNR;
+    double starMass;
+    bool raLimited;
+    bool decLimited;
+    S_HISTORY() { }
+};
+
+struct DitherInfo
+{
+    wxLongLong_t timestamp;
+    double dRa;
+    double dDec;
+};
+
+// sums over a run of one telemetry column
+struct TelemetryMoments
+{
+    unsigned int n;
+    double sum;
+    double sum2;
+    double peak;                // largest absolute value
+
+    TelemetryMoments() : n(0), sum(0.0), sum2(0.0), peak(0.0) { }
+    double Mean() const { return n ? sum / n : 0.0; }
+    // RMS about the mean, as the graph window reports it
+    double Rms() const;
+};
+
+// The guide steps of the whole session, every step the mount took since
+// PHD2 started up to the retention limit, stored one column per field.
+// The graph and target windows show views of the latest steps (see
+// TelemetryView), and the event server's history and metrics methods read
+// the columns directly. The dithers made while the steps were taken are
+// kept with them. A step has a sequence number, counting from 0 at
+// startup; the steps retained are Begin() to End() - 1.
+//
+// The retention, in steps, is the /telemetry/retention setting and is
+// applied at startup. The store is written and read on the main thread only.
+class GuideTelemetry
+{
+public:
+    enum
+    {
+        FLAG_RA_LIMITED = 1,
+        FLAG_DEC_LIMITED = 2,
+    };
+
+    enum
+    {
+        DefaultRetention = 43200,   // 12 hours at one step per second
+        MinRetention = 400,         // the most the target window shows
+    };
+
+private:
+    circular_buffer<wxLongLong_t> m_timestamp;  // ms since the epoch
+    circular_buffer<double> m_dx;               // camera coordinates, pixels
+    circular_buffer<double> m_dy;
+    circular_buffer<double> m_ra;               // mount coordinates, pixels
+    circular_buffer<double> m_dec;
+    circular_buffer<int> m_raDur;               // ms
+    circular_buffer<int> m_decDur;
+    circular_buffer<double> m_snr;
+    circular_buffer<double> m_mass;
+    circular_buffer<unsigned char> m_flags;
+    std::deque<DitherInfo> m_dithers;           // none older than the oldest step
+    long long m_appended;       // steps ever appended, the sequence number of the next step
+
+public:
+    GuideTelemetry();
+
+    void Init();
+    void Append(const GuideStepInfo& step);
+    void AppendDither(const DitherInfo& info);
+
+    unsigned int Size() const { return m_ra.size(); }
+    unsigned int Retention() const { return m_ra.capacity(); }
+    long long Begin() const { return m_appended - m_ra.size(); }
+    long long End() const { return m_appended; }
+    size_t MemoryBytes() const;
+
+    // the step with sequence number seq, Begin() <= seq < End()
+    S_HISTORY Row(long long seq) const;
+
+    // the columns, oldest first: column[seq - Begin()]
+    const circular_buffer<wxLongLong_t>& Timestamps() const { return m_timestamp; }
+    const circular_buffer<double>& Dx() const { return m_dx; }
+    const circular_buffer<double>& Dy() const { return m_dy; }
+    const circular_buffer<double>& Ra() const { return m_ra; }
+    const circular_buffer<double>& Dec() const { return m_dec; }
+    const circular_buffer<int>& RaDuration() const { return m_raDur; }
+    const circular_buffer<int>& DecDuration() const { return m_decDur; }
+    const circular_buffer<double>& SNR() const { return m_snr; }
+    const circular_buffer<double>& Mass() const { return m_mass; }
+    const circular_buffer<unsigned char>& Flags() const { return m_flags; }
+    const std::deque<DitherInfo>& Dithers() const { return m_dithers; }
+
+    // adds the elements first to last - 1 of the column, in its two
+    // contiguous runs, to *m
+    static void Accumulate(const circular_buffer<double>& column, unsigned int first, unsigned int last,
+                           TelemetryMoments *m);
+};
+
+extern GuideTelemetry Telemetry;
+
+// A window's share of the store: the latest capacity() steps it has taken
+// with Advance(). A view can be cleared or trimmed without touching the
+// store, and a window sees a new step only when it advances, so it can
+// update its running sums from the oldest step before taking the new one.
+// The element access follows circular_buffer, oldest first.
+class TelemetryView
+{
+    const GuideTelemetry& m_store;
+    long long m_begin;          // sequence numbers of the steps in the view
+    long long m_end;
+    unsigned int m_capacity;
+
+    long long First() const { return m_begin > m_store.Begin() ? m_begin : m_store.Begin(); }
+
+public:
+    TelemetryView(const GuideTelemetry& store, unsigned int capacity);
+
+    void resize(unsigned int capacity);
+    unsigned int capacity() const { return m_capacity; }
+    unsigned int size() const { return (unsigned int)(m_end - First()); }
+    void clear() { m_begin = m_end; }
+    void pop_back(unsigned int n = 1);
+
+    // take the next step appended to the store
+    void Advance();
+
+    long long Seq(unsigned int n) const { return First() + n; }
+    S_HISTORY operator[](unsigned int n) const { return m_store.Row(Seq(n)); }
+};
+
+#endif
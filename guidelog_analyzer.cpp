@@ -0,0 +1,970 @@
+/*
+ *  guidelog_analyzer.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "guiding_assistant.h"
+#include "guidelog_analyzer.h"
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/stopwatch.h>
+#include <wx/wfstream.h>
+#include <wx/zstream.h>
+
+#include <algorithm>
+#include <string>
+#include <string.h>
+
+#if defined(__WINDOWS__)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+static const char *CACHE_FILE = "PHD2_GuideLogAnalysis.cache";
+static const char *CACHE_VERSION = "PHD2 guide log analysis 1";
+
+namespace
+{
+
+// read-only file that is mapped a window at a time by MappedSource
+class MappedFile
+{
+public:
+#if defined(__WINDOWS__)
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_fd;
+#endif
+    long long m_size;
+
+    MappedFile();
+    ~MappedFile();
+    bool Open(const wxString& path);    // true on error
+};
+
+MappedFile::MappedFile()
+    : m_size(0)
+{
+#if defined(__WINDOWS__)
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+#else
+    m_fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__WINDOWS__)
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+#else
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+}
+
+bool MappedFile::Open(const wxString& path)
+{
+#if defined(__WINDOWS__)
+    // the current guide log is still being written
+    m_file = CreateFileW(path.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return true;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+        return true;
+    m_size = size.QuadPart;
+    if (m_size == 0)
+        return false;           // an empty file cannot be mapped, and has nothing to map
+    m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, size.HighPart, size.LowPart, NULL);
+    return m_mapping == NULL;
+#else
+    m_fd = open(path.fn_str(), O_RDONLY);
+    if (m_fd < 0)
+        return true;
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        return true;
+    m_size = st.st_size;
+    return false;
+#endif
+}
+
+// supplies the bytes of a file, or of part of it, in chunks; a chunk stays
+// valid until the next call
+struct ChunkSource
+{
+    long long m_offset;         // file offset of the next chunk
+
+    ChunkSource() : m_offset(0) { }
+    virtual ~ChunkSource() { }
+    // false at the end or on error
+    virtual bool NextChunk(const char **data, size_t *len) = 0;
+};
+
+class MappedSource : public ChunkSource
+{
+    const MappedFile& m_file;
+    long long m_end;
+    void *m_view;
+    size_t m_viewLen;
+
+    void Unmap();
+
+public:
+    bool m_error;
+
+    MappedSource(const MappedFile& file, long long begin, long long end)
+        : m_file(file), m_end(end), m_view(0), m_viewLen(0), m_error(false)
+    {
+        m_offset = begin;
+    }
+    ~MappedSource() { Unmap(); }
+    bool NextChunk(const char **data, size_t *len);
+};
+
+void MappedSource::Unmap()
+{
+    if (!m_view)
+        return;
+#if defined(__WINDOWS__)
+    UnmapViewOfFile(m_view);
+#else
+    munmap(m_view, m_viewLen);
+#endif
+    m_view = 0;
+}
+
+bool MappedSource::NextChunk(const char **data, size_t *len)
+{
+    Unmap();
+
+    if (m_offset >= m_end || m_error)
+        return false;
+
+    // views must start on a boundary of the allocation granularity
+#if defined(__WINDOWS__)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    long long const gran = si.dwAllocationGranularity;
+#else
+    long long const gran = sysconf(_SC_PAGESIZE);
+#endif
+    long long const base = m_offset - m_offset % gran;
+    long long const chunkEnd = std::min(m_end, m_offset + (long long) GuideLogAnalyzer::CHUNK_BYTES);
+    m_viewLen = (size_t)(chunkEnd - base);
+
+#if defined(__WINDOWS__)
+    m_view = MapViewOfFile(m_file.m_mapping, FILE_MAP_READ, (DWORD)(base >> 32), (DWORD)(base & 0xffffffff), m_viewLen);
+#else
+    m_view = mmap(NULL, m_viewLen, PROT_READ, MAP_PRIVATE, m_file.m_fd, (off_t) base);
+    if (m_view == MAP_FAILED)
+        m_view = 0;
+#endif
+    if (!m_view)
+    {
+        m_error = true;
+        return false;
+    }
+
+    *data = static_cast<const char *>(m_view) + (m_offset - base);
+    *len = (size_t)(chunkEnd - m_offset);
+    m_offset = chunkEnd;
+    return true;
+}
+
+class GzipSource : public ChunkSource
+{
+    wxFFileInputStream m_file;
+    wxZlibInputStream m_zlib;
+    std::vector<char> m_buf;
+
+public:
+    GzipSource(const wxString& path)
+        : m_file(path), m_zlib(m_file, wxZLIB_GZIP), m_buf(1024 * 1024) { }
+    bool IsOk() const { return m_file.IsOk(); }
+    bool NextChunk(const char **data, size_t *len);
+};
+
+bool GzipSource::NextChunk(const char **data, size_t *len)
+{
+    m_zlib.Read(&m_buf[0], m_buf.size());
+    size_t n = m_zlib.LastRead();
+    if (n == 0)
+        return false;
+    *data = &m_buf[0];
+    *len = n;
+    m_offset += n;
+    return true;
+}
+
+// splits the chunks into lines without copying, except for lines that
+// straddle two chunks
+class LineReader
+{
+    ChunkSource& m_src;
+    const char *m_p;
+    const char *m_end;
+    long long m_chunkOffset;    // file offset of the start of the current chunk
+    const char *m_chunk;
+    std::string m_carry;
+
+public:
+    LineReader(ChunkSource& src)
+        : m_src(src), m_p(0), m_end(0), m_chunkOffset(src.m_offset), m_chunk(0) { }
+
+    // file offset of the start of the next line
+    long long Offset() const { return m_chunkOffset + (m_p - m_chunk); }
+    // the next line without its end of line, valid until the next call
+    bool Next(const char **begin, const char **end);
+};
+
+bool LineReader::Next(const char **begin, const char **end)
+{
+    bool carrying = false;
+    m_carry.clear();
+
+    while (true)
+    {
+        if (m_p == m_end)
+        {
+            m_chunkOffset += m_end - m_chunk;
+            size_t len;
+            if (!m_src.NextChunk(&m_chunk, &len))
+            {
+                m_chunk = m_p = m_end = 0;
+                if (!carrying)
+                    return false;
+                *begin = m_carry.data();
+                *end = *begin + m_carry.size();
+                break;
+            }
+            m_p = m_chunk;
+            m_end = m_chunk + len;
+        }
+
+        const char *nl = static_cast<const char *>(memchr(m_p, '\n', m_end - m_p));
+        if (!nl)
+        {
+            m_carry.append(m_p, m_end);
+            carrying = true;
+            m_p = m_end;
+            continue;
+        }
+
+        if (carrying)
+        {
+            m_carry.append(m_p, nl);
+            *begin = m_carry.data();
+            *end = *begin + m_carry.size();
+        }
+        else
+        {
+            *begin = m_p;
+            *end = nl;
+        }
+        m_p = nl + 1;
+        break;
+    }
+
+    if (*end > *begin && (*end)[-1] == '\r')
+        --*end;
+    return true;
+}
+
+inline static bool StartsWith(const char *begin, const char *end, const char *prefix, const char **rest = 0)
+{
+    size_t n = strlen(prefix);
+    if ((size_t)(end - begin) < n || memcmp(begin, prefix, n) != 0)
+        return false;
+    if (rest)
+        *rest = begin + n;
+    return true;
+}
+
+// builds sessions from the lines of a log, and from binary log steps
+class SessionParser
+{
+    std::vector<GuideLogSession>& m_sessions;
+    std::string m_line;         // the line being parsed, terminated for strtod
+    bool m_active;
+    GuideLogSession m_cur;
+    GuideAnalysis m_analysis;
+    unsigned int m_steps;
+    double m_firstTime;
+    double m_firstSNR;
+    double m_firstMass;
+    double m_lastTime;
+    bool m_rebase;                  // a dither or lock position change came before the next step
+    double m_shift[2];              // added to the offsets to stitch out lock position moves
+    double m_last[2];               // last stitched offset
+    double m_delivered[2];          // sum of the corrections sent so far
+    double m_unguidedStart[2];
+    double m_unguidedLast[2];
+
+public:
+    SessionParser(std::vector<GuideLogSession>& sessions) : m_sessions(sessions), m_active(false) { }
+    void Line(const char *begin, const char *end);
+    void Step(double time, const double raw[2], const double guide[2], double snr, double mass);
+    void Finish();
+};
+
+void SessionParser::Line(const char *begin, const char *end)
+{
+    const char *rest;
+
+    if (begin == end)
+        return;
+
+    if (*begin >= '0' && *begin <= '9')
+    {
+        if (!m_active)
+            return;
+
+        // Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,
+        // RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode
+        // only mount steps are wanted, so look at the third field before parsing the rest
+        const char *fields[17];
+        int n = 0;
+        fields[n++] = begin;
+        for (const char *p = begin; p < end && n < 17; p++)
+            if (*p == ',')
+                fields[n++] = p + 1;
+        if (n < 17 || !StartsWith(fields[2], end, "\"Mount\""))
+            return;
+
+        m_line.assign(begin, end);
+        const char *base = m_line.c_str();
+        double v[17];
+        static const int wanted[] = { 1, 5, 6, 7, 8, 15, 16 };
+        for (size_t i = 0; i < WXSIZEOF(wanted); i++)
+        {
+            const char *s = base + (fields[wanted[i]] - begin);
+            char *e;
+            v[wanted[i]] = strtod(s, &e);
+            if (e == s)
+                v[wanted[i]] = 0.0;     // StarMass and SNR are empty for some steps
+        }
+        if (fields[5][0] == ',' || fields[6][0] == ',')
+            return;                     // no offsets
+
+        double const raw[2] = { v[5], v[6] };
+        double const guide[2] = { v[7], v[8] };
+        Step(v[1], raw, guide, v[15], v[16]);
+        return;
+    }
+
+    if (StartsWith(begin, end, "Guiding Begins at ", &rest))
+    {
+        Finish();
+        m_active = true;
+        m_cur = GuideLogSession();
+        m_cur.start = wxString(rest, wxConvUTF8, end - rest);
+        m_cur.exposure = 0.0;
+        m_cur.pixelScale = 1.0;
+        m_cur.declination = UNKNOWN_DECLINATION;
+        m_cur.guided = false;
+        m_steps = 0;
+        m_rebase = false;
+        for (int i = 0; i < 2; i++)
+            m_shift[i] = m_delivered[i] = 0.0;
+        return;
+    }
+
+    if (!m_active)
+        return;
+
+    if (StartsWith(begin, end, "Guiding Ends"))
+    {
+        Finish();
+        return;
+    }
+
+    double val;
+    char *e;
+
+    if (StartsWith(begin, end, "Pixel scale = ", &rest))
+    {
+        m_line.assign(rest, end);
+        val = strtod(m_line.c_str(), &e);
+        if (e != m_line.c_str() && val > 0.0)
+            m_cur.pixelScale = val;
+    }
+    else if (StartsWith(begin, end, "Exposure = ", &rest))
+    {
+        // "Auto (...)" leaves the exposure to be worked out from the step times
+        m_line.assign(rest, end);
+        val = strtod(m_line.c_str(), &e);
+        if (e != m_line.c_str() && val > 0.0)
+            m_cur.exposure = val / 1000.0;
+    }
+    else if (StartsWith(begin, end, "Dec = ", &rest))
+    {
+        m_line.assign(rest, end);
+        val = strtod(m_line.c_str(), &e);
+        if (e != m_line.c_str())
+            m_cur.declination = radians(val);
+    }
+    else if (StartsWith(begin, end, "INFO: DITHER") || StartsWith(begin, end, "INFO: SET LOCK POSITION"))
+        m_rebase = true;
+}
+
+void SessionParser::Step(double time, const double raw[2], const double guide[2], double snr, double mass)
+{
+    if (!m_active)
+        return;
+
+    if (m_steps == 0)
+    {
+        // without a fixed exposure the first interval stands in for it; the
+        // first step is held back until the filters can be set up
+        m_firstTime = time;
+        m_firstSNR = snr;
+        m_firstMass = mass;
+        m_rebase = false;
+        for (int i = 0; i < 2; i++)
+        {
+            m_last[i] = raw[i];
+            m_unguidedStart[i] = m_unguidedLast[i] = raw[i];
+        }
+        if (m_cur.exposure > 0.0)
+        {
+            m_analysis.Init(m_cur.exposure);
+            m_analysis.AddSample(time, PHD_Point(raw[0], raw[1]), snr, mass);
+        }
+    }
+    else
+    {
+        if (m_steps == 1 && m_cur.exposure <= 0.0)
+        {
+            m_analysis.Init(std::max(time - m_firstTime, 0.0));
+            m_analysis.AddSample(m_firstTime, PHD_Point(m_last[0], m_last[1]), m_firstSNR, m_firstMass);
+        }
+
+        double pos[2];
+        for (int i = 0; i < 2; i++)
+        {
+            if (m_rebase)
+                m_shift[i] = m_last[i] - raw[i];
+            pos[i] = raw[i] + m_shift[i];
+            m_last[i] = pos[i];
+            m_unguidedLast[i] = pos[i] + m_delivered[i];
+        }
+        m_rebase = false;
+
+        m_analysis.AddSample(time, PHD_Point(pos[0], pos[1]), snr, mass);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        m_delivered[i] += guide[i];
+        if (guide[i] != 0.0)
+            m_cur.guided = true;
+    }
+
+    m_lastTime = time;
+    ++m_steps;
+}
+
+void SessionParser::Finish()
+{
+    if (!m_active)
+        return;
+    m_active = false;
+
+    if (m_steps < 2)
+        return;
+
+    m_cur.duration = m_lastTime - m_firstTime;
+    m_analysis.GetResult(m_cur.duration, m_cur.pixelScale, m_cur.declination, &m_cur.result);
+
+    if (m_cur.guided && m_cur.duration > 0.0)
+    {
+        m_cur.result.raDriftRate = (m_unguidedLast[0] - m_unguidedStart[0]) / m_cur.duration * 60.0;
+        m_cur.result.decDriftRate = (m_unguidedLast[1] - m_unguidedStart[1]) / m_cur.duration * 60.0;
+        m_cur.result.polarAlignError = GuideAnalysis::PolarAlignmentError(m_cur.result.decDriftRate, m_cur.pixelScale,
+                                                                          m_cur.declination);
+    }
+
+    m_sessions.push_back(m_cur);
+}
+
+// a unit of work: one session of a text log, or a whole log
+struct WorkItem
+{
+    size_t log;                 // index into the results
+    long long begin;            // byte range of a session; begin < 0 for a whole log
+    long long end;
+    std::vector<GuideLogSession> sessions;
+    wxString error;
+};
+
+// sessions differ a lot in length, so rather than take a fixed strip of the
+// items each thread takes the next item not yet started
+struct AnalyzeJob : public ImageStripJob
+{
+    const std::vector<GuideLogAnalysis>& m_logs;
+    const std::vector<MappedFile *>& m_files;
+    std::vector<WorkItem>& m_items;
+    std::atomic<int> m_next;
+
+    AnalyzeJob(const std::vector<GuideLogAnalysis>& logs, const std::vector<MappedFile *>& files, std::vector<WorkItem>& items)
+        : m_logs(logs), m_files(files), m_items(items), m_next(0) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        int i;
+        while ((i = m_next.fetch_add(1)) < (int) m_items.size())
+            Process(m_items[i]);
+    }
+
+    void Process(WorkItem& item);
+};
+
+}
+
+void AnalyzeJob::Process(WorkItem& item)
+{
+    const wxString& fileName = m_logs[item.log].fileName;
+    SessionParser parser(item.sessions);
+    const char *b, *e;
+
+    if (item.begin >= 0)
+    {
+        MappedSource src(*m_files[item.log], item.begin, item.end);
+        LineReader rdr(src);
+        while (rdr.Next(&b, &e))
+            parser.Line(b, e);
+        if (src.m_error)
+            item.error = "cannot map " + fileName;
+    }
+    else if (GuideLogBinaryReader::IsBinaryLog(fileName))
+    {
+        GuideLogBinaryReader reader;
+        if (reader.Open(fileName, &item.error))
+            return;
+
+        GuideLogBinRecord rec;
+        while (reader.Next(&rec))
+        {
+            if (rec.type == GLB_REC_EVENT)
+            {
+                // the event text is what the text log has for it
+                wxArrayString lines = wxSplit(rec.text, '\n', 0);
+                for (size_t i = 0; i < lines.size(); i++)
+                {
+                    wxScopedCharBuffer utf8 = lines[i].utf8_str();
+                    parser.Line(utf8.data(), utf8.data() + utf8.length());
+                }
+            }
+            else if (rec.type == GLB_REC_STEP && rec.step.kind == GLB_STEP_MOUNT)
+            {
+                double const raw[2] = { rec.step.raRaw, rec.step.decRaw };
+                double const guide[2] = { rec.step.raGuide, rec.step.decGuide };
+                parser.Step(rec.step.time, raw, guide, rec.step.starSNR, rec.step.starMass);
+            }
+        }
+    }
+    else
+    {
+        GzipSource src(fileName);
+        if (!src.IsOk())
+        {
+            item.error = "cannot open " + fileName;
+            return;
+        }
+        LineReader rdr(src);
+        while (rdr.Next(&b, &e))
+            parser.Line(b, e);
+    }
+
+    parser.Finish();
+}
+
+// the byte ranges of the sessions in a text log
+static void FindSessions(const MappedFile& file, const wxString& fileName, size_t log, std::vector<WorkItem> *items, wxString *error)
+{
+    MappedSource src(file, 0, file.m_size);
+    LineReader rdr(src);
+    const char *b, *e;
+    long long start = -1;
+
+    while (true)
+    {
+        long long offset = rdr.Offset();
+        if (!rdr.Next(&b, &e))
+            break;
+        if (b == e || *b != 'G')
+            continue;
+        bool begins = StartsWith(b, e, "Guiding Begins");
+        if (start >= 0 && (begins || StartsWith(b, e, "Guiding Ends")))
+        {
+            WorkItem item;
+            item.log = log;
+            item.begin = start;
+            item.end = begins ? offset : rdr.Offset();
+            items->push_back(item);
+            start = -1;
+        }
+        if (begins)
+            start = offset;
+    }
+
+    if (start >= 0)
+    {
+        WorkItem item;
+        item.log = log;
+        item.begin = start;
+        item.end = file.m_size;
+        items->push_back(item);
+    }
+
+    if (src.m_error)
+        *error = "cannot map " + fileName;
+}
+
+namespace
+{
+struct CacheEntry
+{
+    wxString stamp;
+    std::vector<GuideLogSession> sessions;
+};
+
+typedef std::map<wxString, CacheEntry> Cache;     // by log file name, without the directory
+}
+
+// size and modification time, to tell whether a cached result is current
+static wxString FileStamp(const wxString& path)
+{
+    wxULongLong size = wxFileName::GetSize(path);
+    return wxString::Format("%s\t%lld", size.ToString(), (long long) wxFileModificationTime(path));
+}
+
+static void LoadCache(const wxString& dir, Cache *cache)
+{
+    wxTextFile file;
+    wxString path = dir + PATHSEPSTR + CACHE_FILE;
+    if (!wxFileExists(path) || !file.Open(path) || file.GetLineCount() == 0 || file[0] != CACHE_VERSION)
+        return;
+
+    CacheEntry *entry = 0;
+
+    for (size_t i = 1; i < file.GetLineCount(); i++)
+    {
+        wxArrayString f = wxSplit(file[i], '\t', 0);
+
+        if (f.size() == 4 && f[0] == "F")
+        {
+            entry = &(*cache)[f[1]];
+            entry->stamp = f[2] + "\t" + f[3];
+            entry->sessions.clear();
+            continue;
+        }
+
+        enum { SESSION_FIELDS = 20 };
+        if (!entry || f.size() != SESSION_FIELDS || f[0] != "S")
+        {
+            // damaged; whatever is not in the cache is read again
+            Debug.Write(wxString::Format("GuideLogAnalyzer: ignoring %s from line %u\n", path, (unsigned int) i + 1));
+            cache->clear();
+            return;
+        }
+
+        GuideLogSession s;
+        double v[SESSION_FIELDS];
+        for (int j = 2; j < SESSION_FIELDS; j++)
+            f[j].ToCDouble(&v[j]);
+        s.start = f[1];
+        s.duration = v[2];
+        s.exposure = v[3];
+        s.pixelScale = v[4];
+        s.declination = v[5];
+        s.guided = v[6] != 0.0;
+        GuideAnalysisResult& r = s.result;
+        r.samples = (unsigned int) v[7];
+        r.raRms = v[8];
+        r.decRms = v[9];
+        r.totalRms = v[10];
+        r.raPeak = v[11];
+        r.decPeak = v[12];
+        r.raPeakPeak = v[13];
+        r.raDriftRate = v[14];
+        r.decDriftRate = v[15];
+        r.raMaxRate = v[16];
+        r.meanSNR = v[17];
+        r.meanMass = v[18];
+        r.polarAlignError = v[19];
+        entry->sessions.push_back(s);
+    }
+}
+
+static void SaveCache(const wxString& dir, const Cache& cache)
+{
+    wxString path = dir + PATHSEPSTR + CACHE_FILE;
+    wxFFile file;
+    if (!file.Open(path, "w"))
+    {
+        Debug.Write(wxString::Format("GuideLogAnalyzer: cannot write %s\n", path));
+        return;
+    }
+
+    file.Write(wxString(CACHE_VERSION) + "\n");
+
+    for (Cache::const_iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        file.Write(wxString::Format("F\t%s\t%s\n", it->first, it->second.stamp));
+        for (size_t i = 0; i < it->second.sessions.size(); i++)
+        {
+            const GuideLogSession& s = it->second.sessions[i];
+            const GuideAnalysisResult& r = s.result;
+            file.Write(wxString::Format("S\t%s\t%.3f\t%g\t%g\t%.6g\t%d\t%u\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\t%.6g\n",
+                s.start, s.duration, s.exposure, s.pixelScale, s.declination, s.guided ? 1 : 0, r.samples,
+                r.raRms, r.decRms, r.totalRms, r.raPeak, r.decPeak, r.raPeakPeak, r.raDriftRate, r.decDriftRate,
+                r.raMaxRate, r.meanSNR, r.meanMass, r.polarAlignError));
+        }
+    }
+
+    file.Close();
+}
+
+void GuideLogAnalyzer::Analyze(const wxArrayString& logFiles, std::vector<GuideLogAnalysis> *results)
+{
+    wxStopWatch swatch;
+
+    results->clear();
+    results->resize(logFiles.size());
+
+    std::map<wxString, Cache> caches;       // by directory
+    std::vector<wxString> stamps(logFiles.size());
+    std::vector<MappedFile *> files(logFiles.size(), 0);
+    std::vector<WorkItem> items;
+    unsigned int cached = 0;
+
+    for (size_t i = 0; i < logFiles.size(); i++)
+    {
+        GuideLogAnalysis& log = (*results)[i];
+        log.fileName = logFiles[i];
+        log.cached = false;
+
+        wxFileName fn(logFiles[i]);
+        wxString dir = fn.GetPath();
+        if (caches.find(dir) == caches.end())
+            LoadCache(dir, &caches[dir]);
+
+        stamps[i] = FileStamp(logFiles[i]);
+        Cache& cache = caches[dir];
+        Cache::const_iterator it = cache.find(fn.GetFullName());
+        if (it != cache.end() && it->second.stamp == stamps[i])
+        {
+            log.sessions = it->second.sessions;
+            log.cached = true;
+            ++cached;
+            continue;
+        }
+
+        if (fn.GetExt().CmpNoCase("gz") == 0)
+        {
+            if (wxFileName(fn.GetName()).GetExt().CmpNoCase("bin") == 0)
+            {
+                log.error = "compressed binary guide logs cannot be read";
+                continue;
+            }
+        }
+        else if (!GuideLogBinaryReader::IsBinaryLog(logFiles[i]))
+        {
+            // a plain text log: split it into sessions
+            MappedFile *file = new MappedFile();
+            if (file->Open(logFiles[i]))
+            {
+                log.error = "cannot open " + logFiles[i];
+                delete file;
+                continue;
+            }
+            files[i] = file;
+            FindSessions(*file, logFiles[i], i, &items, &log.error);
+            continue;
+        }
+
+        WorkItem item;
+        item.log = i;
+        item.begin = item.end = -1;
+        items.push_back(item);
+    }
+
+    if (!items.empty())
+    {
+        AnalyzeJob job(*results, files, items);
+        int n = (int) items.size();
+        RunImageStrips(job, ImageStripCount(n, 1), n);
+    }
+
+    // the items of a log are in the order of its sessions
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        GuideLogAnalysis& log = (*results)[items[i].log];
+        log.sessions.insert(log.sessions.end(), items[i].sessions.begin(), items[i].sessions.end());
+        if (log.error.empty())
+            log.error = items[i].error;
+    }
+
+    unsigned int sessions = 0;
+    std::map<wxString, bool> changed;
+    for (size_t i = 0; i < results->size(); i++)
+    {
+        delete files[i];
+
+        const GuideLogAnalysis& log = (*results)[i];
+        sessions += log.sessions.size();
+        if (log.cached)
+            continue;
+        if (!log.error.empty())
+        {
+            Debug.Write(wxString::Format("GuideLogAnalyzer: %s\n", log.error));
+            continue;
+        }
+
+        wxFileName fn(log.fileName);
+        CacheEntry& entry = caches[fn.GetPath()][fn.GetFullName()];
+        entry.stamp = stamps[i];
+        entry.sessions = log.sessions;
+        changed[fn.GetPath()] = true;
+    }
+
+    for (std::map<wxString, bool>::const_iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+        // forget logs that have been removed or compressed
+        Cache& cache = caches[it->first];
+        for (Cache::iterator c = cache.begin(); c != cache.end(); )
+        {
+            if (!wxFileExists(it->first + PATHSEPSTR + c->first))
+                cache.erase(c++);
+            else
+                ++c;
+        }
+        SaveCache(it->first, cache);
+    }
+
+    Debug.Write(wxString::Format("GuideLogAnalyzer: %u logs (%u cached), %u sessions, %u items in %ld ms\n",
+        (unsigned int) results->size(), cached, sessions, (unsigned int) items.size(), swatch.Time()));
+}
+
+static bool IsGuideLog(const wxString& name)
+{
+    return name.StartsWith("PHD2_GuideLog") &&
+        (name.EndsWith(".txt") || name.EndsWith(".txt.gz") || name.EndsWith(".bin"));
+}
+
+bool GuideLogAnalyzer::Run(const wxString& path, const wxString& outFile, wxString *errorMsg)
+{
+    wxArrayString logs;
+
+    if (wxDirExists(path))
+    {
+        wxArrayString all;
+        wxDir::GetAllFiles(path, &all, "PHD2_GuideLog*", wxDIR_FILES);
+        for (size_t i = 0; i < all.size(); i++)
+            if (IsGuideLog(wxFileName(all[i]).GetFullName()))
+                logs.push_back(all[i]);
+        logs.Sort();
+        if (logs.empty())
+        {
+            *errorMsg = wxString::Format("no guide logs in %s", path);
+            return true;
+        }
+    }
+    else if (wxFileExists(path))
+        logs.push_back(path);
+    else
+    {
+        *errorMsg = wxString::Format("cannot find %s", path);
+        return true;
+    }
+
+    std::vector<GuideLogAnalysis> results;
+    Analyze(logs, &results);
+
+    wxFFile file;
+    if (!file.Open(outFile, "w"))
+    {
+        *errorMsg = wxString::Format("cannot create %s", outFile);
+        return true;
+    }
+
+    file.Write("Log,Guiding Begins,Duration (s),Samples,Exposure (s),Pixel scale,Dec (deg),Guided,"
+        "RA RMS (px),Dec RMS (px),Total RMS (px),Total RMS (arc-sec),RA peak (px),Dec peak (px),RA peak-peak (px),"
+        "RA drift (px/min),RA max rate (px/s),Dec drift (px/min),Polar alignment error (arc-min),SNR,Star mass\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const GuideLogAnalysis& log = results[i];
+        wxString name = wxFileName(log.fileName).GetFullName();
+
+        if (!log.error.empty())
+        {
+            file.Write(wxString::Format("%s,error: %s\n", name, log.error));
+            continue;
+        }
+
+        for (size_t j = 0; j < log.sessions.size(); j++)
+        {
+            const GuideLogSession& s = log.sessions[j];
+            const GuideAnalysisResult& r = s.result;
+            file.Write(wxString::Format("%s,%s,%.0f,%u,%s,%.2f,%s,%d,%.3f,%.3f,%.3f,%.2f,%.3f,%.3f,%.3f,%.3f,%.4f,%.3f,%.1f,%.1f,%.0f\n",
+                name, s.start, s.duration, r.samples,
+                s.exposure > 0.0 ? wxString::Format("%g", s.exposure) : wxString("auto"),
+                s.pixelScale,
+                s.declination == UNKNOWN_DECLINATION ? wxString("") : wxString::Format("%.1f", degrees(s.declination)),
+                s.guided ? 1 : 0,
+                r.raRms, r.decRms, r.totalRms, r.totalRms * s.pixelScale, r.raPeak, r.decPeak, r.raPeakPeak,
+                r.raDriftRate, r.raMaxRate, r.decDriftRate, r.polarAlignError, r.meanSNR, r.meanMass));
+        }
+    }
+
+    if (!file.Close())
+    {
+        *errorMsg = wxString::Format("error writing %s", outFile);
+        return true;
+    }
+
+    return false;
+}
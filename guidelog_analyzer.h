@@ -0,0 +1,92 @@
+/*
+ *  guidelog_analyzer.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDELOG_ANALYZER_INCLUDED
+#define GUIDELOG_ANALYZER_INCLUDED
+
+#include <vector>
+
+// The Guiding Assistant's analysis (GuideAnalysis, see guiding_assistant.h)
+// of every guiding session in a set of guide logs, for looking back over
+// many nights at once.
+//
+// Text logs are read through memory-mapped windows of CHUNK_BYTES, so a log
+// of any size is read in fixed memory. A first pass over a log only finds
+// where each session begins and ends; the sessions of all the logs are then
+// analyzed concurrently. Of the session text only the header lines the
+// analysis needs and the "Mount" step lines are parsed. Compressed logs (see
+// log_maintenance.h) and binary logs (see guidelog_binary.h) cannot be split
+// and are read from start to end, one log per thread.
+//
+// Results are cached by log file name, size and modification time in
+// PHD2_GuideLogAnalysis.cache in the directory holding the logs, so only new
+// or changed logs are read again.
+//
+// For guided sessions the RMS, peaks and RA peak rate describe the guided
+// residuals. The drift rates and polar alignment error are taken from the
+// track the star would have followed without guiding: the logged offsets
+// plus the corrections sent before each step, assuming the mount delivered
+// them in full. Dithers and lock position moves are stitched out of the
+// track.
+
+struct GuideLogSession
+{
+    wxString start;             // "Guiding Begins at" time as logged
+    double duration;            // seconds
+    double exposure;            // seconds, 0 if not known (auto exposure)
+    double pixelScale;          // arc-sec/px, 1.0 if not known
+    double declination;         // radians, or UNKNOWN_DECLINATION
+    bool guided;                // corrections were sent during the session
+    GuideAnalysisResult result;
+};
+
+struct GuideLogAnalysis
+{
+    wxString fileName;
+    bool cached;
+    wxString error;             // empty if the log was read
+    std::vector<GuideLogSession> sessions;
+};
+
+struct GuideLogAnalyzer
+{
+    enum { CHUNK_BYTES = 16 * 1024 * 1024 };
+
+    static void Analyze(const wxArrayString& logFiles, std::vector<GuideLogAnalysis> *results);
+
+    // analyze a guide log, or every guide log in a directory, and write one
+    // CSV row per session to outFile; returns true on error
+    static bool Run(const wxString& path, const wxString& outFile, wxString *errorMsg);
+};
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ *  guidelog_binary.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <algorithm>
+
+static const char HEADER_MAGIC[8] = "PHD2GLB";
+static const char TRAILER_MAGIC[8] = "PHD2GLE";
+
+static void SplitOffset(wxFileOffset ofs, unsigned int *lo, unsigned int *hi)
+{
+    *lo = (unsigned int)(ofs & 0xffffffff);
+    *hi = (unsigned int)((wxUint64) ofs >> 32);
+}
+
+static wxFileOffset JoinOffset(unsigned int lo, unsigned int hi)
+{
+    return (wxFileOffset)(((wxUint64) hi << 32) | lo);
+}
+
+static double WallClock(const wxDateTime& t)
+{
+    return t.GetValue().ToDouble() / 1000.0;
+}
+
+GuideLogBinaryWriter::GuideLogBinaryWriter()
+    : m_lastIndex(0),
+    m_steps(0),
+    m_guidingStarted(0.0)
+{
+}
+
+GuideLogBinaryWriter::~GuideLogBinaryWriter()
+{
+    Close();
+}
+
+bool GuideLogBinaryWriter::Open(const wxString& fileName)
+{
+    Close();
+
+    if (!m_file.Open(fileName, "wb"))
+        return true;
+
+    GuideLogBinHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HEADER_MAGIC, sizeof(hdr.magic));
+    hdr.version = GLB_VERSION;
+    m_file.Write(&hdr, sizeof(hdr));
+
+    m_index.clear();
+    m_lastIndex = 0;
+    m_steps = 0;
+    m_guidingStarted = 0.0;
+
+    return false;
+}
+
+void GuideLogBinaryWriter::Close()
+{
+    if (!m_file.IsOpened())
+        return;
+
+    WriteIndex();
+
+    GuideLogBinTrailer trailer;
+    SplitOffset(m_lastIndex, &trailer.indexLo, &trailer.indexHi);
+    memcpy(trailer.magic, TRAILER_MAGIC, sizeof(trailer.magic));
+    m_file.Write(&trailer, sizeof(trailer));
+
+    m_file.Close();
+}
+
+void GuideLogBinaryWriter::WriteRecord(unsigned char type, unsigned char tag, const void *data1, size_t len1,
+    const void *data2, size_t len2)
+{
+    // the payload length is 16 bits; only over-long text can run into that
+    if (len1 + len2 > 0xffff)
+        len2 = 0xffff - len1;
+
+    GuideLogBinRecHdr hdr;
+    hdr.type = type;
+    hdr.tag = tag;
+    hdr.length = (unsigned short)(len1 + len2);
+
+    m_file.Write(&hdr, sizeof(hdr));
+    m_file.Write(data1, len1);
+    if (len2)
+        m_file.Write(data2, len2);
+}
+
+void GuideLogBinaryWriter::Event(GuideLogBinEvent ev, const wxString& text)
+{
+    if (!m_file.IsOpened())
+        return;
+
+    // guide step times are relative to the time in the guiding begins event
+    double timestamp = ev == GLB_EV_GUIDING_BEGINS ? m_guidingStarted : WallClock(wxDateTime::UNow());
+    wxCharBuffer utf8 = text.utf8_str();
+
+    WriteRecord(GLB_REC_EVENT, (unsigned char) ev, &timestamp, sizeof(timestamp), utf8.data(), utf8.length());
+}
+
+void GuideLogBinaryWriter::Step(const GuideLogBinStep& step, const wxString& status)
+{
+    if (!m_file.IsOpened())
+        return;
+
+    bool indexed = m_steps++ % GLB_INDEX_INTERVAL == 0;
+    if (indexed)
+    {
+        GuideLogBinIndexEntry entry;
+        entry.timestamp = m_guidingStarted + step.time;
+        entry.sessionStart = m_guidingStarted;
+        SplitOffset(m_file.Tell(), &entry.offsetLo, &entry.offsetHi);
+        m_index.push_back(entry);
+    }
+
+    if (status.IsEmpty())
+        WriteRecord(GLB_REC_STEP, 0, &step, sizeof(step));
+    else
+    {
+        wxCharBuffer utf8 = status.utf8_str();
+        WriteRecord(GLB_REC_STEP, 0, &step, sizeof(step), utf8.data(), utf8.length());
+    }
+
+    if (m_index.size() >= GLB_INDEX_BLOCK)
+        WriteIndex();
+}
+
+void GuideLogBinaryWriter::WriteIndex()
+{
+    if (m_index.empty())
+        return;
+
+    GuideLogBinIndexHdr hdr;
+    SplitOffset(m_lastIndex, &hdr.prevLo, &hdr.prevHi);
+    hdr.count = m_index.size();
+
+    m_lastIndex = m_file.Tell();
+    WriteRecord(GLB_REC_INDEX, 0, &hdr, sizeof(hdr), &m_index[0], m_index.size() * sizeof(GuideLogBinIndexEntry));
+
+    m_index.clear();
+}
+
+GuideLogBinaryReader::GuideLogBinaryReader()
+    : m_end(0),
+    m_lastIndex(0),
+    m_indexLoaded(false),
+    m_guidingStarted(0.0)
+{
+}
+
+bool GuideLogBinaryReader::IsBinaryLog(const wxString& fileName)
+{
+    wxFFile file(fileName, "rb");
+    char magic[8];
+    return file.IsOpened() && file.Read(magic, sizeof(magic)) == sizeof(magic) &&
+        memcmp(magic, HEADER_MAGIC, sizeof(magic)) == 0;
+}
+
+bool GuideLogBinaryReader::Open(const wxString& fileName, wxString *errorMsg)
+{
+    m_file.Close();
+    m_index.clear();
+    m_indexLoaded = false;
+    m_guidingStarted = 0.0;
+
+    if (!m_file.Open(fileName, "rb"))
+    {
+        *errorMsg = wxString::Format("cannot open guide log %s", fileName);
+        return true;
+    }
+
+    GuideLogBinHeader hdr;
+    if (m_file.Read(&hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr.magic, HEADER_MAGIC, sizeof(hdr.magic)) != 0)
+    {
+        *errorMsg = wxString::Format("%s is not a binary guide log", fileName);
+        m_file.Close();
+        return true;
+    }
+    if (hdr.version > GLB_VERSION)
+    {
+        *errorMsg = wxString::Format("%s has unsupported version %u", fileName, hdr.version);
+        m_file.Close();
+        return true;
+    }
+
+    // a file that was closed cleanly ends with a trailer
+    m_end = m_file.Length();
+    m_lastIndex = 0;
+    GuideLogBinTrailer trailer;
+    if (m_end >= (wxFileOffset)(sizeof(hdr) + sizeof(trailer)) &&
+        m_file.Seek(m_end - sizeof(trailer)) &&
+        m_file.Read(&trailer, sizeof(trailer)) == sizeof(trailer) &&
+        memcmp(trailer.magic, TRAILER_MAGIC, sizeof(trailer.magic)) == 0)
+    {
+        m_end -= sizeof(trailer);
+        m_lastIndex = JoinOffset(trailer.indexLo, trailer.indexHi);
+    }
+
+    m_file.Seek(sizeof(hdr));
+
+    return false;
+}
+
+bool GuideLogBinaryReader::ReadRecord(GuideLogBinRecHdr *hdr)
+{
+    wxFileOffset pos = m_file.Tell();
+
+    if (pos + (wxFileOffset) sizeof(*hdr) > m_end || m_file.Read(hdr, sizeof(*hdr)) != sizeof(*hdr))
+        return false;
+    // a record cut short by a crash ends the file
+    if (pos + (wxFileOffset)(sizeof(*hdr) + hdr->length) > m_end)
+        return false;
+
+    m_buf.resize(hdr->length);
+    return hdr->length == 0 || m_file.Read(&m_buf[0], hdr->length) == hdr->length;
+}
+
+bool GuideLogBinaryReader::Next(GuideLogBinRecord *rec)
+{
+    while (true)
+    {
+        GuideLogBinRecHdr hdr;
+        rec->offset = m_file.Tell();
+
+        if (!ReadRecord(&hdr))
+            return false;
+
+        if (hdr.type == GLB_REC_STEP && hdr.length >= sizeof(GuideLogBinStep))
+        {
+            rec->type = GLB_REC_STEP;
+            memcpy(&rec->step, &m_buf[0], sizeof(GuideLogBinStep));
+            rec->timestamp = m_guidingStarted + rec->step.time;
+            rec->text = wxString::FromUTF8(&m_buf[0] + sizeof(GuideLogBinStep), hdr.length - sizeof(GuideLogBinStep));
+            return true;
+        }
+
+        if (hdr.type == GLB_REC_EVENT && hdr.length >= sizeof(double))
+        {
+            rec->type = GLB_REC_EVENT;
+            rec->event = (GuideLogBinEvent) hdr.tag;
+            memcpy(&rec->timestamp, &m_buf[0], sizeof(double));
+            rec->text = wxString::FromUTF8(&m_buf[0] + sizeof(double), hdr.length - sizeof(double));
+            if (rec->event == GLB_EV_GUIDING_BEGINS)
+                m_guidingStarted = rec->timestamp;
+            return true;
+        }
+
+        // index records, and records from a later version, are skipped
+    }
+}
+
+void GuideLogBinaryReader::LoadIndex()
+{
+    m_indexLoaded = true;
+    m_index.clear();
+
+    wxFileOffset pos = m_file.Tell();
+    GuideLogBinRecHdr hdr;
+
+    if (m_lastIndex)
+    {
+        // follow the chain back from the trailer
+        std::vector<std::vector<GuideLogBinIndexEntry> > blocks;
+        wxFileOffset ofs = m_lastIndex;
+        while (ofs && m_file.Seek(ofs) && ReadRecord(&hdr) && hdr.type == GLB_REC_INDEX &&
+            hdr.length >= sizeof(GuideLogBinIndexHdr))
+        {
+            GuideLogBinIndexHdr ih;
+            memcpy(&ih, &m_buf[0], sizeof(ih));
+            unsigned int count = wxMin(ih.count, (unsigned int)((hdr.length - sizeof(ih)) / sizeof(GuideLogBinIndexEntry)));
+            const GuideLogBinIndexEntry *entries = (const GuideLogBinIndexEntry *) (&m_buf[0] + sizeof(ih));
+            blocks.push_back(std::vector<GuideLogBinIndexEntry>(entries, entries + count));
+            wxFileOffset prev = JoinOffset(ih.prevLo, ih.prevHi);
+            if (prev >= ofs)
+                break;  // corrupt chain
+            ofs = prev;
+        }
+        for (size_t i = blocks.size(); i > 0; i--)
+            m_index.insert(m_index.end(), blocks[i - 1].begin(), blocks[i - 1].end());
+    }
+    else
+    {
+        // no trailer: walk the records, reading only the index records
+        m_file.Seek(sizeof(GuideLogBinHeader));
+        while (true)
+        {
+            wxFileOffset ofs = m_file.Tell();
+            if (ofs + (wxFileOffset) sizeof(hdr) > m_end || m_file.Read(&hdr, sizeof(hdr)) != sizeof(hdr))
+                break;
+            if (ofs + (wxFileOffset)(sizeof(hdr) + hdr.length) > m_end)
+                break;
+            if (hdr.type != GLB_REC_INDEX || hdr.length < sizeof(GuideLogBinIndexHdr))
+            {
+                m_file.Seek(hdr.length, wxFromCurrent);
+                continue;
+            }
+            m_buf.resize(hdr.length);
+            if (m_file.Read(&m_buf[0], hdr.length) != hdr.length)
+                break;
+            GuideLogBinIndexHdr ih;
+            memcpy(&ih, &m_buf[0], sizeof(ih));
+            unsigned int count = wxMin(ih.count, (unsigned int)((hdr.length - sizeof(ih)) / sizeof(GuideLogBinIndexEntry)));
+            const GuideLogBinIndexEntry *entries = (const GuideLogBinIndexEntry *) (&m_buf[0] + sizeof(ih));
+            m_index.insert(m_index.end(), entries, entries + count);
+        }
+    }
+
+    m_file.Seek(pos);
+}
+
+static bool EntryBefore(double timestamp, const GuideLogBinIndexEntry& entry)
+{
+    return timestamp < entry.timestamp;
+}
+
+bool GuideLogBinaryReader::SeekTime(double timestamp)
+{
+    if (!m_indexLoaded)
+        LoadIndex();
+
+    std::vector<GuideLogBinIndexEntry>::const_iterator it =
+        std::upper_bound(m_index.begin(), m_index.end(), timestamp, EntryBefore);
+
+    if (it == m_index.begin())
+    {
+        m_guidingStarted = 0.0;
+        return !m_file.Seek(sizeof(GuideLogBinHeader));
+    }
+
+    --it;
+    m_guidingStarted = it->sessionStart;
+    return !m_file.Seek(JoinOffset(it->offsetLo, it->offsetHi));
+}
+
+wxString GuideLogBinaryReader::FormatStep(const GuideLogBinStep& step, const wxString& status)
+{
+    if (step.kind == GLB_STEP_DROPPED)
+    {
+        return wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n",
+            step.frame, step.time, step.starMass, step.starSNR, step.starError, status);
+    }
+
+    wxString line = wxString::Format("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
+        step.frame, step.time,
+        step.kind == GLB_STEP_AO ? "AO" : "Mount",
+        step.dx, step.dy,
+        step.raRaw, step.decRaw,
+        step.raGuide, step.decGuide);
+
+    if (step.kind == GLB_STEP_AO)
+    {
+        line += wxString::Format(",,,,%d,%d,", step.raDuration, step.decDuration);
+    }
+    else
+    {
+        char raDir[2] = { step.raDir, 0 };
+        char decDir[2] = { step.decDir, 0 };
+        line += wxString::Format("%d,%s,%d,%s,,,", step.raDuration, raDir, step.decDuration, decDir);
+    }
+
+    line += wxString::Format("%.f,%.2f,%d\n", step.starMass, step.starSNR, step.starError);
+
+    return line;
+}
+
+bool GuideLogBinaryReader::ConvertToText(const wxString& binFile, const wxString& textFile, wxString *errorMsg)
+{
+    GuideLogBinaryReader reader;
+    if (reader.Open(binFile, errorMsg))
+        return true;
+
+    wxFFile out;
+    if (!out.Open(textFile, "w"))
+    {
+        *errorMsg = wxString::Format("cannot create %s", textFile);
+        return true;
+    }
+
+    GuideLogBinRecord rec;
+    while (reader.Next(&rec))
+    {
+        if (rec.type == GLB_REC_STEP)
+            out.Write(FormatStep(rec.step, rec.text));
+        else
+            out.Write(rec.text);
+    }
+
+    if (!out.Close())
+    {
+        *errorMsg = wxString::Format("error writing %s", textFile);
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,226 @@
+/*
+ *  guidelog_binary.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDELOG_BINARY_INCLUDED
+#define GUIDELOG_BINARY_INCLUDED
+
+#include <vector>
+
+// Compact binary guide log, written next to the text guide log when the
+// global setting /GuideLogBinary is on, and the reader used to query, replay
+// (see backtest.h) or convert it back to the text format.
+//
+// The file (PHD2_GuideLog_<date>_<time>.bin, little-endian) starts with a
+// 16-byte GuideLogBinHeader followed by records. Each record is a 4-byte
+// GuideLogBinRecHdr (type, tag, payload length) followed by the payload:
+//
+//   GLB_REC_STEP   a GuideLogBinStep, for dropped frames followed by the
+//                  status text (UTF-8)
+//   GLB_REC_EVENT  tag is a GuideLogBinEvent; a double, the wall clock time
+//                  in seconds since the epoch, followed by the event's text
+//                  exactly as it appears in the text log (UTF-8)
+//   GLB_REC_INDEX  a GuideLogBinIndexHdr followed by count GuideLogBinIndexEntry
+//
+// Every GLB_INDEX_INTERVAL guide steps the writer notes the time and file
+// offset of a step; a block of these is written as an index record every
+// GLB_INDEX_BLOCK entries and when the file is closed. Each index record
+// points back at the previous one, and a closed file ends with a
+// GuideLogBinTrailer pointing at the last, so a reader can find any time in
+// the file without reading the records in between. Files that were not
+// closed cleanly have no trailer and are read sequentially.
+
+#pragma pack(push, 4)
+
+struct GuideLogBinHeader
+{
+    char magic[8];              // "PHD2GLB"
+    unsigned int version;       // 1
+    unsigned int reserved;
+};
+
+struct GuideLogBinRecHdr
+{
+    unsigned char type;
+    unsigned char tag;
+    unsigned short length;      // payload bytes
+};
+
+enum GuideLogBinRecType
+{
+    GLB_REC_STEP = 1,
+    GLB_REC_EVENT = 2,
+    GLB_REC_INDEX = 3,
+};
+
+enum GuideLogBinEvent
+{
+    GLB_EV_TEXT,                // header and settings lines
+    GLB_EV_LOG_ENABLED,
+    GLB_EV_LOG_DISABLED,
+    GLB_EV_LOG_CLOSED,
+    GLB_EV_CALIBRATION_BEGINS,
+    GLB_EV_CALIBRATION_STEP,
+    GLB_EV_CALIBRATION_END,     // direction complete, complete or failed
+    GLB_EV_GUIDING_BEGINS,
+    GLB_EV_GUIDING_ENDS,
+    GLB_EV_DITHER,
+    GLB_EV_LOCK_POSITION,
+    GLB_EV_LOCK_SHIFT,
+    GLB_EV_SETTLING,
+    GLB_EV_SERVER_COMMAND,
+    GLB_EV_PARAM_CHANGE,
+    GLB_EV_POLAR_ALIGN,
+};
+
+enum GuideLogBinStepKind
+{
+    GLB_STEP_MOUNT,
+    GLB_STEP_AO,
+    GLB_STEP_DROPPED,
+};
+
+struct GuideLogBinStep
+{
+    double time;                // seconds since guiding began
+    int frame;
+    unsigned char kind;         // GuideLogBinStepKind
+    unsigned char reserved;
+    char raDir, decDir;         // direction letter, 0 if no pulse
+    float dx, dy;               // camera offset
+    float raRaw, decRaw;        // mount offset
+    float raGuide, decGuide;    // guide distance
+    int raDuration, decDuration;    // ms, or AO steps signed by direction
+    float starMass, starSNR, avgDist;
+    int starError;
+};
+
+struct GuideLogBinIndexHdr
+{
+    unsigned int prevLo, prevHi;    // offset of the previous index record, 0 for the first
+    unsigned int count;
+};
+
+struct GuideLogBinIndexEntry
+{
+    double timestamp;           // wall clock time of the step, seconds since the epoch
+    double sessionStart;        // wall clock time guiding began
+    unsigned int offsetLo, offsetHi;
+};
+
+struct GuideLogBinTrailer
+{
+    unsigned int indexLo, indexHi;  // offset of the last index record
+    char magic[8];              // "PHD2GLE"
+};
+
+#pragma pack(pop)
+
+enum
+{
+    GLB_VERSION = 1,
+    GLB_INDEX_INTERVAL = 64,
+    GLB_INDEX_BLOCK = 64,
+};
+
+class GuideLogBinaryWriter
+{
+    wxFFile m_file;
+    std::vector<GuideLogBinIndexEntry> m_index;
+    wxFileOffset m_lastIndex;
+    unsigned int m_steps;
+    double m_guidingStarted;    // wall clock time of the current guiding session
+
+    void WriteRecord(unsigned char type, unsigned char tag, const void *data1, size_t len1,
+        const void *data2 = 0, size_t len2 = 0);
+    void WriteIndex();
+
+public:
+    GuideLogBinaryWriter();
+    ~GuideLogBinaryWriter();
+
+    bool Open(const wxString& fileName);    // true on error
+    bool IsOpened() const { return m_file.IsOpened(); }
+    void Close();
+    void Flush() { m_file.Flush(); }
+
+    void Event(GuideLogBinEvent ev, const wxString& text);
+    void GuidingStarted(const wxDateTime& start) { m_guidingStarted = start.GetValue().ToDouble() / 1000.0; }
+    void Step(const GuideLogBinStep& step, const wxString& status = wxEmptyString);
+};
+
+struct GuideLogBinRecord
+{
+    GuideLogBinRecType type;
+    GuideLogBinEvent event;     // GLB_REC_EVENT
+    double timestamp;           // wall clock, seconds since the epoch
+    GuideLogBinStep step;       // GLB_REC_STEP
+    wxString text;              // event text, or dropped frame status
+    wxFileOffset offset;        // where the record starts
+};
+
+class GuideLogBinaryReader
+{
+    wxFFile m_file;
+    wxFileOffset m_end;         // end of the records
+    wxFileOffset m_lastIndex;   // from the trailer, 0 if there is none
+    std::vector<GuideLogBinIndexEntry> m_index;
+    bool m_indexLoaded;
+    double m_guidingStarted;
+    std::vector<char> m_buf;
+
+public:
+    GuideLogBinaryReader();
+
+    static bool IsBinaryLog(const wxString& fileName);
+
+    bool Open(const wxString& fileName, wxString *errorMsg);    // true on error
+    void Close() { m_file.Close(); }
+
+    // the next record, false at the end of the file
+    bool Next(GuideLogBinRecord *rec);
+    // position at the last indexed step at or before the given time, or at the
+    // start of the file; Next() then returns the records from there on.
+    // Returns true on error.
+    bool SeekTime(double timestamp);
+
+    // write the log out in the text guide log format; true on error
+    static bool ConvertToText(const wxString& binFile, const wxString& textFile, wxString *errorMsg);
+    static wxString FormatStep(const GuideLogBinStep& step, const wxString& status = wxEmptyString);
+
+private:
+    bool ReadRecord(GuideLogBinRecHdr *hdr);
+    void LoadIndex();
+};
+
+#endif
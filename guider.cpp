@@ -35,6 +35,7 @@
 #include "nudge_lock.h"
 #include "comet_tool.h"
 #include "guiding_assistant.h"
+#include "guider_glview.h"
 
 // un-comment to log star deflections to a file
 //#define CAPTURE_DEFLECTIONS
@@ -102,14 +103,24 @@ BEGIN_EVENT_TABLE(Guider, wxWindow)
     EVT_PAINT(Guider::OnPaint)
     EVT_CLOSE(Guider::OnClose)
     EVT_ERASE_BACKGROUND(Guider::OnErase)
+    EVT_SIZE(Guider::OnSize)
 END_EVENT_TABLE()
 
 Guider::Guider(wxWindow *parent, int xSize, int ySize) :
     wxWindow(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxFULL_REPAINT_ON_RESIZE)
 {
     m_state = STATE_UNINITIALIZED;
+    m_concurrentCal = NULL;
     m_scaleFactor = 1.0;
     m_displayedImage = new wxImage(XWinSize,YWinSize,true);
+    m_displayValid = false;
+    m_levelsValid = false;
+    m_levelBlack = m_levelWhite = 0;
+    m_displayGamma = 0.0;
+    m_displayScaleImage = false;
+    m_displayPeak = pConfig->Global.GetBoolean("/guider/DisplayPeakDownsample", true);
+    m_displayFrame = 0;
+    m_glView = NULL;
     m_paused = PAUSE_NONE;
     m_starFoundTimestamp = 0;
     m_avgDistanceNeedReset = false;
@@ -120,6 +131,7 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize) :
     m_lockPosIsSticky = false;
     m_forceFullFrame = false;
     m_measurementMode = false;
+    m_moveShift.SetXY(0.0, 0.0);
     m_searchRegion = 0;
     m_pCurrentImage = new usImage(); // so we always have one
 
@@ -142,6 +154,11 @@ Guider::Guider(wxWindow *parent, int xSize, int ySize) :
     SetBackgroundStyle(wxBG_STYLE_CUSTOM);
     SetBackgroundColour(wxColour((unsigned char) 30, (unsigned char) 30,(unsigned char) 30));
 
+#if defined(PHD_OPENGL_VIEW)
+    if (pConfig->Global.GetBoolean("/guider/OpenGLView", false) && !wxGetApp().IsHeadless())
+        m_glView = GuiderGLView::Create(this);
+#endif
+
     s_deflectionLogger.Init();
 }
 
@@ -149,6 +166,7 @@ Guider::~Guider(void)
 {
     delete m_displayedImage;
     delete m_pCurrentImage;
+    delete m_concurrentCal;
 
     s_deflectionLogger.Uninit();
 }
@@ -250,6 +268,14 @@ void Guider::EnableMeasurementMode(bool enable)
         m_measurementMode = false;
 }
 
+void Guider::NotifyGuideMove(const PHD_Point& starShift)
+{
+    if (!starShift.IsValid())
+        return;
+    wxCriticalSectionLocker lck(m_moveShiftLock);
+    m_moveShift += starShift;
+}
+
 void Guider::SetOverlaySlitCoords(const wxPoint& center, const wxSize& size, int angle)
 {
     m_overlaySlitCoords.center = center;
@@ -348,292 +374,383 @@ void Guider::OnClose(wxCloseEvent& evt)
     Destroy();
 }
 
-bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
+void Guider::OnSize(wxSizeEvent& evt)
 {
-    bool bError = false;
+    if (m_glView)
+        m_glView->SetSize(GetClientSize());
+    evt.Skip();
+}
 
-    try
-    {
-        GUIDER_STATE state = GetState();
-        GetSize(&XWinSize, &YWinSize);
+// the OpenGL view is a child window, so repaint requests are passed on
+void Guider::Refresh(bool eraseBackground, const wxRect *rect)
+{
+    wxWindow::Refresh(eraseBackground, rect);
+    if (m_glView)
+        m_glView->Refresh(false);
+}
 
-        if (m_pCurrentImage->ImageData)
-        {
-            int blevel = m_pCurrentImage->FiltMin;
-            int wlevel = m_pCurrentImage->FiltMax;
-            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, pFrame->Stretch_gamma);
-        }
+void Guider::Update(void)
+{
+    wxWindow::Update();
+    if (m_glView)
+        m_glView->Update();
+}
 
-        int imageWidth   = m_displayedImage->GetWidth();
-        int imageHeight  = m_displayedImage->GetHeight();
+// go back to drawing with PaintHelper, used when the OpenGL view cannot
+// show the image
+void Guider::CloseGLView(void)
+{
+    if (!m_glView)
+        return;
 
-        // scale the image if necessary
+    Debug.Write("Guider: closing the OpenGL image view\n");
+    m_glView->Destroy();
+    m_glView = NULL;
+    InvalidateDisplay();
+    Refresh();
+}
 
-        if (imageWidth != XWinSize || imageHeight != YWinSize)
-        {
-            // The image is not the exact right size -- figure out what to do.
-            double xScaleFactor = imageWidth / (double)XWinSize;
-            double yScaleFactor = imageHeight / (double)YWinSize;
-            int newWidth = imageWidth;
-            int newHeight = imageHeight;
-
-            double newScaleFactor = (xScaleFactor > yScaleFactor) ?
-                                    xScaleFactor :
-                                    yScaleFactor;
-
-//            Debug.Write(wxString::Format("xScaleFactor=%.2f, yScaleFactor=%.2f, newScaleFactor=%.2f\n", xScaleFactor,
-//                    yScaleFactor, newScaleFactor));
-
-            // we rescale the image if:
-            // - The image is either too big
-            // - The image is so small that at least one dimension is less
-            //   than half the width of the window or
-            // - The user has requsted rescaling
-
-            if (xScaleFactor > 1.0 || yScaleFactor > 1.0 ||
-                xScaleFactor < 0.45 || yScaleFactor < 0.45 || m_scaleImage)
-            {
+// the size at which an image is shown in the XWinSize x YWinSize window,
+// returns the scale factor from image to display coordinates
+double Guider::DisplayGeometry(const wxSize& imageSize, wxSize *displaySize) const
+{
+    int imageWidth = imageSize.GetWidth();
+    int imageHeight = imageSize.GetHeight();
 
-                newWidth /= newScaleFactor;
-                newHeight /= newScaleFactor;
+    double xScaleFactor = imageWidth / (double)XWinSize;
+    double yScaleFactor = imageHeight / (double)YWinSize;
+    double newScaleFactor = (xScaleFactor > yScaleFactor) ?
+                            xScaleFactor :
+                            yScaleFactor;
 
-                newScaleFactor = 1.0 / newScaleFactor;
+    // we rescale the image if:
+    // - The image is either too big
+    // - The image is so small that at least one dimension is less
+    //   than half the width of the window or
+    // - The user has requsted rescaling
 
-                m_scaleFactor = newScaleFactor;
+    bool rescale = (imageWidth != XWinSize || imageHeight != YWinSize) &&
+        (xScaleFactor > 1.0 || yScaleFactor > 1.0 ||
+         xScaleFactor < 0.45 || yScaleFactor < 0.45 || m_scaleImage);
 
-                Debug.Write(wxString::Format("Resizing image to %d,%d\n", newWidth, newHeight));
+    int newWidth = imageWidth / newScaleFactor;
+    int newHeight = imageHeight / newScaleFactor;
 
-                if (newWidth > 0 && newHeight > 0)
-                {
-                    m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_HIGH);
-                }
+    if (rescale && newWidth > 0 && newHeight > 0)
+    {
+        *displaySize = wxSize(newWidth, newHeight);
+        return 1.0 / newScaleFactor;
+    }
+
+    *displaySize = imageSize;
+    return 1.0;
+}
+
+// the stretch levels of the current frame, estimated the first time the frame
+// is rendered (see usImage::CalcDisplayLevels) so frames that are never shown
+// cost nothing
+void Guider::DisplayLevels(int *blevel, int *wlevel)
+{
+    if (!m_levelsValid)
+    {
+        WorkerThread::CompleteLazyROI(*m_pCurrentImage);
+        m_pCurrentImage->CalcDisplayLevels(&m_levelBlack, &m_levelWhite);
+        m_levelsValid = true;
+    }
+
+    *blevel = m_levelBlack;
+    *wlevel = m_levelWhite;
+}
+
+// stretch the current image to the display size and make the bitmap that
+// PaintHelper draws
+void Guider::RenderDisplayedImage(void)
+{
+    if (m_pCurrentImage->ImageData)
+    {
+        WorkerThread::CompleteLazyROI(*m_pCurrentImage);
+        int blevel, wlevel;
+        DisplayLevels(&blevel, &wlevel);
+        double gamma = pFrame->Stretch_gamma;
+
+        wxSize displaySize;
+        m_scaleFactor = DisplayGeometry(m_pCurrentImage->Size, &displaySize);
+
+        if (m_scaleFactor != 1.0)
+        {
+            int newWidth = displaySize.GetWidth();
+            int newHeight = displaySize.GetHeight();
+
+            Debug.Write(wxString::Format("Resizing image to %d,%d\n", newWidth, newHeight));
+
+            if (m_scaleFactor < 1.0)
+            {
+                // shrinking: stretch only the pixels that will be shown, starting
+                // from the smallest reduction of the frame that is large enough
+                const usImage& level = m_pyramid.Level(*m_pCurrentImage, newWidth, newHeight, m_displayPeak);
+                level.CopyToImageScaled(&m_displayedImage, newWidth, newHeight, blevel, wlevel, gamma, m_displayPeak);
             }
             else
             {
-                m_scaleFactor = 1.0;
+                m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, gamma);
+                m_displayedImage->Rescale(newWidth, newHeight, wxIMAGE_QUALITY_HIGH);
             }
         }
+        else
+        {
+            m_pCurrentImage->CopyToImage(&m_displayedImage, blevel, wlevel, gamma);
+        }
 
-        // important to provide explicit color for r,g,b, optional args to Size().
-        // If default args are provided wxWidgets performs some expensive histogram
-        // operations.
-        wxBitmap DisplayedBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
-        memDC.SelectObject(DisplayedBitmap);
+        m_displayGamma = gamma;
+    }
 
-        dc.Blit(0, 0, DisplayedBitmap.GetWidth(), DisplayedBitmap.GetHeight(), &memDC, 0, 0, wxCOPY, false);
+    // important to provide explicit color for r,g,b, optional args to Size().
+    // If default args are provided wxWidgets performs some expensive histogram
+    // operations.
+    m_displayedBitmap = wxBitmap(m_displayedImage->Size(wxSize(XWinSize, YWinSize), wxPoint(0, 0), 0, 0, 0));
 
-        int XImgSize = m_displayedImage->GetWidth();
-        int YImgSize = m_displayedImage->GetHeight();
+    m_displayWinSize = wxSize(XWinSize, YWinSize);
+    m_displayScaleImage = m_scaleImage;
+    m_displayValid = true;
+}
 
-        if (m_overlayMode)
+bool Guider::PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC)
+{
+    PERF_STAGE(PERF_STAGE_PAINT);
+
+    bool bError = false;
+
+    try
+    {
+        GetSize(&XWinSize, &YWinSize);
+
+        // the stretched bitmap only changes with the frame, the stretch or the
+        // window size; otherwise repainting the overlays reuses it
+        if (!m_displayValid ||
+            m_displayWinSize != wxSize(XWinSize, YWinSize) ||
+            m_displayScaleImage != m_scaleImage ||
+            (m_pCurrentImage->ImageData && m_displayGamma != pFrame->Stretch_gamma))
         {
-            dc.SetPen(wxPen(wxColor(200,50,50)));
-            dc.SetBrush(*wxTRANSPARENT_BRUSH);
+            RenderDisplayedImage();
+        }
+
+        memDC.SelectObject(m_displayedBitmap);
+        dc.Blit(0, 0, m_displayedBitmap.GetWidth(), m_displayedBitmap.GetHeight(), &memDC, 0, 0, wxCOPY, false);
+        memDC.SelectObject(wxNullBitmap);
 
-            switch (m_overlayMode)
+        GuiderDCPainter painter(dc);
+        DrawOverlays(painter, m_displayedImage->GetSize());
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+// lines step apart across the image, rotated by angle about the image center
+static void DrawAxisGrid(GuiderPainter& dc, int width, int height, double step, double angle)
+{
+    double cx = width / 2.0;
+    double cy = height / 2.0;
+    double c = cos(angle);
+    double s = sin(angle);
+
+    for (int i = -2; i < 12; i++)
+    {
+        double y = step * i - cy;
+        double x1 = -cx;
+        double x2 = width - cx;
+        dc.DrawLine(cx + x1 * c - y * s, cy + x1 * s + y * c, cx + x2 * c - y * s, cy + x2 * s + y * c);
+    }
+}
+
+// draw the overlays on top of the displayed image; displaySize is the size
+// of the image as shown
+void Guider::DrawOverlays(GuiderPainter& dc, const wxSize& displaySize)
+{
+    int XImgSize = displaySize.GetWidth();
+    int YImgSize = displaySize.GetHeight();
+    GUIDER_STATE state = GetState();
+
+    if (m_overlayMode)
+    {
+        dc.SetPen(wxPen(wxColor(200,50,50)));
+
+        switch (m_overlayMode)
+        {
+            case OVERLAY_BULLSEYE:
             {
-                case OVERLAY_BULLSEYE:
-                {
-                    int cx = XImgSize / 2;
-                    int cy = YImgSize / 2;
-                    dc.DrawCircle(cx,cy,25);
-                    dc.DrawCircle(cx,cy,50);
-                    dc.DrawCircle(cx,cy,100);
-                    dc.DrawLine(0, cy, XImgSize, cy);
-                    dc.DrawLine(cx, 0, cx, YImgSize);
-                    break;
-                }
-                case OVERLAY_GRID_FINE:
-                case OVERLAY_GRID_COARSE:
-                {
-                    int i;
-                    int size = (m_overlayMode - 1) * 20;
-                    for (i=size; i<XImgSize; i+=size)
-                        dc.DrawLine(i,0,i,YImgSize);
-                    for (i=size; i<YImgSize; i+=size)
-                        dc.DrawLine(0,i,XImgSize,i);
-                    break;
-                }
-                case OVERLAY_RADEC:
+                int cx = XImgSize / 2;
+                int cy = YImgSize / 2;
+                dc.DrawCircle(cx,cy,25);
+                dc.DrawCircle(cx,cy,50);
+                dc.DrawCircle(cx,cy,100);
+                dc.DrawLine(0, cy, XImgSize, cy);
+                dc.DrawLine(cx, 0, cx, YImgSize);
+                break;
+            }
+            case OVERLAY_GRID_FINE:
+            case OVERLAY_GRID_COARSE:
+            {
+                int i;
+                int size = (m_overlayMode - 1) * 20;
+                for (i=size; i<XImgSize; i+=size)
+                    dc.DrawLine(i,0,i,YImgSize);
+                for (i=size; i<YImgSize; i+=size)
+                    dc.DrawLine(0,i,XImgSize,i);
+                break;
+            }
+            case OVERLAY_RADEC:
+            {
+                if (!pMount)
+                    Debug.Write("No mount specified for View/RA_Dec overlay\n");        // Soft error
+                else
                 {
-                    if (!pMount)
-                        Debug.Write("No mount specified for View/RA_Dec overlay\n");        // Soft error
-                    else
-                    {
-                        double StarX = CurrentPosition().X;
-                        double StarY = CurrentPosition().Y;
+                    double StarX = CurrentPosition().X;
+                    double StarY = CurrentPosition().Y;
 
-                        double r = 15.0;
-                        double rlabel = r + 9.0;
+                    double r = 15.0;
+                    double rlabel = r + 9.0;
 
-                        double wAngle = pMount->IsCalibrated() ? pMount->xAngle() : 0.0;
-                        double eAngle = wAngle + M_PI;
-                        GuideParity raParity = pMount->RAParity();
-                        if (raParity == GUIDE_PARITY_ODD)
-                        {
-                            // odd parity => West calibration pulses move scope East
-                            //   => star moves West
-                            //   => East vector is opposite direction from X calibration vector (West calibration direction)
-                            eAngle += M_PI;
-                        }
-                        double cos_eangle = cos(eAngle);
-                        double sin_eangle = sin(eAngle);
-                        dc.SetPen(wxPen(pFrame->pGraphLog->GetRaOrDxColor(), 2, wxPENSTYLE_DOT));
-                        dc.DrawLine(ROUND(StarX * m_scaleFactor + r * cos_eangle), ROUND(StarY * m_scaleFactor + r * sin_eangle),
-                            ROUND(StarX * m_scaleFactor - r * cos_eangle), ROUND(StarY * m_scaleFactor - r * sin_eangle));
-                        if (raParity != GUIDE_PARITY_UNKNOWN)
-                        {
-                            dc.SetTextForeground(pFrame->pGraphLog->GetRaOrDxColor());
-                            dc.DrawText(_("E"),
-                                ROUND(StarX * m_scaleFactor + rlabel * cos_eangle) - 4, ROUND(StarY * m_scaleFactor + rlabel * sin_eangle) - 6);
-                        }
+                    double wAngle = pMount->IsCalibrated() ? pMount->xAngle() : 0.0;
+                    double eAngle = wAngle + M_PI;
+                    GuideParity raParity = pMount->RAParity();
+                    if (raParity == GUIDE_PARITY_ODD)
+                    {
+                        // odd parity => West calibration pulses move scope East
+                        //   => star moves West
+                        //   => East vector is opposite direction from X calibration vector (West calibration direction)
+                        eAngle += M_PI;
+                    }
+                    double cos_eangle = cos(eAngle);
+                    double sin_eangle = sin(eAngle);
+                    dc.SetPen(wxPen(pFrame->pGraphLog->GetRaOrDxColor(), 2, wxPENSTYLE_DOT));
+                    dc.DrawLine(ROUND(StarX * m_scaleFactor + r * cos_eangle), ROUND(StarY * m_scaleFactor + r * sin_eangle),
+                        ROUND(StarX * m_scaleFactor - r * cos_eangle), ROUND(StarY * m_scaleFactor - r * sin_eangle));
+                    if (raParity != GUIDE_PARITY_UNKNOWN)
+                    {
+                        dc.SetTextForeground(pFrame->pGraphLog->GetRaOrDxColor());
+                        dc.DrawText(_("E"),
+                            ROUND(StarX * m_scaleFactor + rlabel * cos_eangle) - 4, ROUND(StarY * m_scaleFactor + rlabel * sin_eangle) - 6);
+                    }
 
-                        double nAngle = pMount->IsCalibrated() ? pMount->yAngle() : M_PI / 2.0;
-                        GuideParity decParity = pMount->DecParity();
-                        if (decParity == GUIDE_PARITY_EVEN)
-                        {
-                            // even parity => North calibration pulses move scope North
-                            //   => star moves South
-                            //   => North vector is opposite direction from Y calibration vector (North calibration direction)
-                            nAngle += M_PI;
-                        }
-                        double cos_nangle = cos(nAngle);
-                        double sin_nangle = sin(nAngle);
-                        dc.SetPen(wxPen(pFrame->pGraphLog->GetDecOrDyColor(), 2, wxPENSTYLE_DOT));
-                        dc.DrawLine(ROUND(StarX * m_scaleFactor + r * cos_nangle), ROUND(StarY * m_scaleFactor + r * sin_nangle),
-                            ROUND(StarX * m_scaleFactor - r * cos_nangle), ROUND(StarY * m_scaleFactor - r * sin_nangle));
-                        if (decParity != GUIDE_PARITY_UNKNOWN)
-                        {
-                            dc.SetTextForeground(pFrame->pGraphLog->GetDecOrDyColor());
-                            dc.DrawText(_("N"),
-                                ROUND(StarX * m_scaleFactor + rlabel * cos_nangle) - 4, ROUND(StarY * m_scaleFactor + rlabel * sin_nangle) - 6);
-                        }
+                    double nAngle = pMount->IsCalibrated() ? pMount->yAngle() : M_PI / 2.0;
+                    GuideParity decParity = pMount->DecParity();
+                    if (decParity == GUIDE_PARITY_EVEN)
+                    {
+                        // even parity => North calibration pulses move scope North
+                        //   => star moves South
+                        //   => North vector is opposite direction from Y calibration vector (North calibration direction)
+                        nAngle += M_PI;
+                    }
+                    double cos_nangle = cos(nAngle);
+                    double sin_nangle = sin(nAngle);
+                    dc.SetPen(wxPen(pFrame->pGraphLog->GetDecOrDyColor(), 2, wxPENSTYLE_DOT));
+                    dc.DrawLine(ROUND(StarX * m_scaleFactor + r * cos_nangle), ROUND(StarY * m_scaleFactor + r * sin_nangle),
+                        ROUND(StarX * m_scaleFactor - r * cos_nangle), ROUND(StarY * m_scaleFactor - r * sin_nangle));
+                    if (decParity != GUIDE_PARITY_UNKNOWN)
+                    {
+                        dc.SetTextForeground(pFrame->pGraphLog->GetDecOrDyColor());
+                        dc.DrawText(_("N"),
+                            ROUND(StarX * m_scaleFactor + rlabel * cos_nangle) - 4, ROUND(StarY * m_scaleFactor + rlabel * sin_nangle) - 6);
+                    }
 
-                        wxGraphicsContext *gc = wxGraphicsContext::Create(dc);
-                        gc->SetPen(wxPen(pFrame->pGraphLog->GetRaOrDxColor(), 1, wxPENSTYLE_DOT));
-                        double step = (double) YImgSize / 10.0;
-
-                        double MidX = (double) XImgSize / 2.0;
-                        double MidY = (double) YImgSize / 2.0;
-                        gc->Rotate(eAngle);
-                        gc->GetTransform().TransformPoint(&MidX, &MidY);
-                        gc->Rotate(-eAngle);
-                        gc->Translate((double) XImgSize / 2.0 - MidX, (double) YImgSize / 2.0 - MidY);
-                        gc->Rotate(eAngle);
-                        for (int i = -2; i < 12; i++) {
-                            gc->StrokeLine(0.0,step * (double) i,
-                                (double) XImgSize, step * (double) i);
-                        }
+                    double step = (double) YImgSize / 10.0;
 
-                        MidX = (double) XImgSize / 2.0;
-                        MidY = (double) YImgSize / 2.0;
-                        gc->Rotate(-eAngle);
-                        gc->Rotate(nAngle);
-                        gc->GetTransform().TransformPoint(&MidX, &MidY);
-                        gc->Rotate(-nAngle);
-                        gc->Translate((double) XImgSize / 2.0 - MidX, (double) YImgSize / 2.0 - MidY);
-                        gc->Rotate(nAngle);
-                        gc->SetPen(wxPen(pFrame->pGraphLog->GetDecOrDyColor(),1,wxPENSTYLE_DOT));
-                        for (int i = -2; i < 12; i++) {
-                            gc->StrokeLine(0.0,step * (double) i,
-                                (double) XImgSize, step * (double) i);
-                        }
-                        delete gc;
-                    }
-                    break;
+                    dc.SetPen(wxPen(pFrame->pGraphLog->GetRaOrDxColor(), 1, wxPENSTYLE_DOT));
+                    DrawAxisGrid(dc, XImgSize, YImgSize, step, eAngle);
+
+                    dc.SetPen(wxPen(pFrame->pGraphLog->GetDecOrDyColor(), 1, wxPENSTYLE_DOT));
+                    DrawAxisGrid(dc, XImgSize, YImgSize, step, nAngle);
                 }
+                break;
+            }
 
-                case OVERLAY_SLIT:
-                    if (m_overlaySlitCoords.size.GetWidth() > 0 && m_overlaySlitCoords.size.GetHeight() > 0)
+            case OVERLAY_SLIT:
+                if (m_overlaySlitCoords.size.GetWidth() > 0 && m_overlaySlitCoords.size.GetHeight() > 0)
+                {
+                    if (m_scaleFactor == 1.0)
                     {
-                        if (m_scaleFactor == 1.0)
-                        {
-                            dc.DrawLines(5, m_overlaySlitCoords.corners);
-                        }
-                        else
+                        dc.DrawLines(5, m_overlaySlitCoords.corners);
+                    }
+                    else
+                    {
+                        wxPoint pt[5];
+                        for (int i = 0; i < 5; i++)
                         {
-                            wxPoint pt[5];
-                            for (int i = 0; i < 5; i++)
-                            {
-                                pt[i].x = (int) floor(m_overlaySlitCoords.corners[i].x * m_scaleFactor);
-                                pt[i].y = (int) floor(m_overlaySlitCoords.corners[i].y * m_scaleFactor);
-                            }
-                            dc.DrawLines(5, pt);
+                            pt[i].x = (int) floor(m_overlaySlitCoords.corners[i].x * m_scaleFactor);
+                            pt[i].y = (int) floor(m_overlaySlitCoords.corners[i].y * m_scaleFactor);
                         }
+                        dc.DrawLines(5, pt);
                     }
-                    break;
+                }
+                break;
 
-                case OVERLAY_NONE:
-                    break;
-            }
+            case OVERLAY_NONE:
+                break;
         }
+    }
 
-        if (m_defectMapPreview)
+    if (m_defectMapPreview)
+    {
+        dc.SetPen(wxPen(wxColor(255, 0, 0), 1, wxSOLID));
+        for (DefectMap::const_iterator it = m_defectMapPreview->begin(); it != m_defectMapPreview->end(); ++it)
         {
-            dc.SetPen(wxPen(wxColor(255, 0, 0), 1, wxSOLID));
-            for (DefectMap::const_iterator it = m_defectMapPreview->begin(); it != m_defectMapPreview->end(); ++it)
-            {
-                const wxPoint& pt = *it;
-                dc.DrawPoint((int)(pt.x * m_scaleFactor), (int)(pt.y * m_scaleFactor));
-            }
+            const wxPoint& pt = *it;
+            dc.DrawPoint((int)(pt.x * m_scaleFactor), (int)(pt.y * m_scaleFactor));
         }
+    }
 
-        // draw the lockpoint of there is one
-        if (state > STATE_SELECTED)
-        {
-            double LockX = LockPosition().X;
-            double LockY = LockPosition().Y;
-
-            switch (state)
-            {
-                case STATE_UNINITIALIZED:
-                case STATE_SELECTING:
-                case STATE_SELECTED:
-                case STATE_STOP:
-                    break;
-                case STATE_CALIBRATING_PRIMARY:
-                case STATE_CALIBRATING_SECONDARY:
-                    dc.SetPen(wxPen(wxColor(255,255,0),1, wxDOT));
-                    break;
-                case STATE_CALIBRATED:
-                case STATE_GUIDING:
-                    dc.SetPen(wxPen(wxColor(0,255,0)));
-                    break;
-            }
-
-            dc.DrawLine(0, int(LockY * m_scaleFactor), XImgSize, int(LockY * m_scaleFactor));
-            dc.DrawLine(int(LockX * m_scaleFactor), 0, int(LockX * m_scaleFactor), YImgSize);
-        }
+    // draw the lockpoint of there is one
+    if (state > STATE_SELECTED)
+    {
+        double LockX = LockPosition().X;
+        double LockY = LockPosition().Y;
 
-        // draw a polar alignment circle
-        if (m_polarAlignCircleRadius)
+        switch (state)
         {
-            dc.SetBrush(*wxTRANSPARENT_BRUSH);
-            wxPenStyle penStyle = m_polarAlignCircleCorrection == 1.0 ? wxPENSTYLE_DOT : wxPENSTYLE_SOLID;
-            dc.SetPen(wxPen(wxColor(255,0,255), 1, penStyle));
-            int radius = ROUND(m_polarAlignCircleRadius * m_polarAlignCircleCorrection * m_scaleFactor);
-            dc.DrawCircle(m_polarAlignCircleCenter.X * m_scaleFactor,
-                m_polarAlignCircleCenter.Y * m_scaleFactor, radius);
+            case STATE_UNINITIALIZED:
+            case STATE_SELECTING:
+            case STATE_SELECTED:
+            case STATE_STOP:
+                break;
+            case STATE_CALIBRATING_PRIMARY:
+            case STATE_CALIBRATING_SECONDARY:
+                dc.SetPen(wxPen(wxColor(255,255,0),1, wxDOT));
+                break;
+            case STATE_CALIBRATED:
+            case STATE_GUIDING:
+                dc.SetPen(wxPen(wxColor(0,255,0)));
+                break;
         }
 
-        if (GetPauseType() != PAUSE_NONE)
-        {
-            dc.SetTextForeground(*wxYELLOW);
-            dc.DrawText(_("PAUSED"), 10, YWinSize - 20);
-        }
-        else if (pMount && !pMount->GetGuidingEnabled())
-        {
-            dc.SetTextForeground(*wxYELLOW);
-            dc.DrawText(_("Guide output DISABLED"), 10, YWinSize - 20);
-        }
+        dc.DrawLine(0, int(LockY * m_scaleFactor), XImgSize, int(LockY * m_scaleFactor));
+        dc.DrawLine(int(LockX * m_scaleFactor), 0, int(LockX * m_scaleFactor), YImgSize);
     }
-    catch (const wxString& Msg)
+
+    // draw a polar alignment circle
+    if (m_polarAlignCircleRadius)
     {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
+        wxPenStyle penStyle = m_polarAlignCircleCorrection == 1.0 ? wxPENSTYLE_DOT : wxPENSTYLE_SOLID;
+        dc.SetPen(wxPen(wxColor(255,0,255), 1, penStyle));
+        int radius = ROUND(m_polarAlignCircleRadius * m_polarAlignCircleCorrection * m_scaleFactor);
+        dc.DrawCircle(m_polarAlignCircleCenter.X * m_scaleFactor,
+            m_polarAlignCircleCenter.Y * m_scaleFactor, radius);
     }
 
-    return bError;
+    if (GetPauseType() != PAUSE_NONE)
+    {
+        dc.SetTextForeground(*wxYELLOW);
+        dc.DrawText(_("PAUSED"), 10, YWinSize - 20);
+    }
+    else if (pMount && !pMount->GetGuidingEnabled())
+    {
+        dc.SetTextForeground(*wxYELLOW);
+        dc.DrawText(_("Guide output DISABLED"), 10, YWinSize - 20);
+    }
 }
 
 void Guider::UpdateImageDisplay(usImage *pImage)
@@ -643,11 +760,14 @@ void Guider::UpdateImageDisplay(usImage *pImage)
         pImage = m_pCurrentImage;
     }
 
-    Debug.Write(wxString::Format("UpdateImageDisplay: Size=(%d,%d) min=%d, max=%d, FiltMin=%d, FiltMax=%d\n",
-        pImage->Size.x, pImage->Size.y, pImage->Min, pImage->Max, pImage->FiltMin, pImage->FiltMax));
+    DEBUG_LOG(DBGLOG_GUIDER, DBGLOG_VERBOSE, "UpdateImageDisplay: Size=(%d,%d) min=%d, max=%d, FiltMin=%d, FiltMax=%d\n",
+        pImage->Size.x, pImage->Size.y, pImage->Min, pImage->Max, pImage->FiltMin, pImage->FiltMax);
 
-    Refresh();
-    Update();
+    if (pFrame->IsHeadless())
+        return;
+
+    InvalidateDisplay();
+    pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_IMAGE);
 }
 
 void Guider::SetDefectMapPreview(const DefectMap *defectMap)
@@ -657,9 +777,31 @@ void Guider::SetDefectMapPreview(const DefectMap *defectMap)
     Update();
 }
 
-bool Guider::SaveCurrentImage(const wxString& fileName)
+bool Guider::SaveCurrentImage(const wxString& fileName, bool compress)
+{
+    WorkerThread::CompleteLazyROI(*m_pCurrentImage);
+    FITSHeader hdr;
+    m_pCurrentImage->GetFitsHeader(&hdr, wxEmptyString);
+    return m_pCurrentImage->WriteFits(fileName, hdr, compress);
+}
+
+// returns true if the image could not be queued
+bool Guider::SaveCurrentImageAsync(const wxString& fileName, bool compress, FitsSaveNotify notify)
 {
-    return m_pCurrentImage->Save(fileName);
+    WorkerThread::CompleteLazyROI(*m_pCurrentImage);
+    return FitsWrite.Save(*m_pCurrentImage, fileName, wxEmptyString, compress, notify);
+}
+
+// If a mount is not calibrated AutoFind must choose a star a bit farther
+// from the edge to allow for the motion of the star during calibration
+int Guider::AutoFindEdgeAllowance(void)
+{
+    int edgeAllowance = 0;
+    if (pMount && pMount->IsConnected() && !pMount->IsCalibrated())
+        edgeAllowance = wxMax(edgeAllowance, pMount->CalibrationTotDistance());
+    if (pSecondaryMount && pSecondaryMount->IsConnected() && !pSecondaryMount->IsCalibrated())
+        edgeAllowance = wxMax(edgeAllowance, pSecondaryMount->CalibrationTotDistance());
+    return edgeAllowance;
 }
 
 void Guider::InvalidateLockPosition(void)
@@ -761,18 +903,23 @@ bool Guider::MoveLockPosition(const PHD_Point& mountDeltaArg)
         PHD_Point cameraDelta, mountDelta;
         double dbest;
 
+        PHD_Point mountReflections[4], cameraReflections[4];
         for (int q = 0; q < 4; q++)
         {
             int sx = 1 - ((q & 1) << 1);
             int sy = 1 - (q & 2);
+            mountReflections[q].SetXY(mountDeltaArg.X * sx, mountDeltaArg.Y * sy);
+        }
 
-            PHD_Point tmpMount(mountDeltaArg.X * sx, mountDeltaArg.Y * sy);
-            PHD_Point tmpCamera;
+        if (pMount->TransformMountCoordinatesToCameraCoordinates(mountReflections, cameraReflections, 4))
+        {
+            throw ERROR_INFO("Transform failed");
+        }
 
-            if (pMount->TransformMountCoordinatesToCameraCoordinates(tmpMount, tmpCamera))
-            {
-                throw ERROR_INFO("Transform failed");
-            }
+        for (int q = 0; q < 4; q++)
+        {
+            const PHD_Point& tmpMount = mountReflections[q];
+            const PHD_Point& tmpCamera = cameraReflections[q];
 
             PHD_Point tmpLockPosition = m_lockPosition + tmpCamera;
 
@@ -867,6 +1014,12 @@ void Guider::SetState(GUIDER_STATE newState)
 
         GUIDER_STATE requestedState = newState;
 
+        if (m_concurrentCal && requestedState != STATE_CALIBRATING_PRIMARY)
+        {
+            delete m_concurrentCal;
+            m_concurrentCal = NULL;
+        }
+
         switch (requestedState)
         {
             case STATE_UNINITIALIZED:
@@ -877,6 +1030,18 @@ void Guider::SetState(GUIDER_STATE newState)
             case STATE_SELECTED:
                 break;
             case STATE_CALIBRATING_PRIMARY:
+                if (ConcurrentCalibration::Wanted(pMount, pSecondaryMount))
+                {
+                    m_concurrentCal = new ConcurrentCalibration(static_cast<StepGuider *>(pMount), pSecondaryMount);
+                    if (m_concurrentCal->Begin(CurrentPosition()))
+                    {
+                        delete m_concurrentCal;
+                        m_concurrentCal = NULL;
+                        newState = STATE_UNINITIALIZED;
+                        Debug.Write(ERROR_INFO("concurrent calibration Begin failed"));
+                    }
+                    break;
+                }
                 if (!pMount->IsCalibrated())
                 {
                     pMount->ResetErrorCount();
@@ -1053,12 +1218,14 @@ void Guider::Reset(bool fullReset)
 
 void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 {
+    PerfStageScope perf(PERF_STAGE_GUIDE_STATE);
+
     wxString statusMessage;
     bool someException = false;
 
     try
     {
-        Debug.Write(wxString::Format("UpdateGuideState(): m_state=%d\n", m_state));
+        DEBUG_LOG(DBGLOG_GUIDER, DBGLOG_INFO, "UpdateGuideState(): m_state=%d\n", m_state);
 
         if (pImage)
         {
@@ -1067,6 +1234,7 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             usImage *pPrevImage = m_pCurrentImage;
             m_pCurrentImage = pImage;
             delete pPrevImage;
+            InvalidateDisplay();
         }
         else
         {
@@ -1082,6 +1250,8 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
         assert(!pMount || !pMount->IsBusy());
 
+        PHD_Point const prevLockPos = LockPosition();
+
         // shift lock position
         if (LockPosShiftEnabled() && IsGuiding())
         {
@@ -1093,9 +1263,30 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
             NudgeLockTool::UpdateNudgeLockControls();
         }
 
+        // Where the star should be now: the guide moves made since the last
+        // frame take it toward the lock position, and with the lock position
+        // shifting the guided object moves along with the lock position
+        // without any correction
+        {
+            wxCriticalSectionLocker lck(m_moveShiftLock);
+            m_predictedShift = m_moveShift;
+            m_moveShift.SetXY(0.0, 0.0);
+        }
+        if (IsGuiding())
+        {
+            if (LockPosShiftEnabled() && prevLockPos.IsValid() && LockPosition().IsValid())
+                m_predictedShift += LockPosition() - prevLockPos;
+        }
+        else
+            m_predictedShift.Invalidate();
+
         FrameDroppedInfo info;
 
-        if (UpdateCurrentPosition(pImage, &info))           // true means error
+        wxStopWatch findTimer;
+        bool const lost = UpdateCurrentPosition(pImage, &info);   // true means error
+        GuideMetrics.AddFrame(findTimer.TimeInMicro().ToDouble() / 1000.0);
+
+        if (lost)
         {
             info.frameNumber = pFrame->m_frameCounter;
             info.time = pFrame->TimeSinceGuidingStarted();
@@ -1110,17 +1301,20 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 case STATE_SELECTED:
                     // we had a current position and lost it
                     SetState(STATE_UNINITIALIZED);
+                    GuideMetrics.AddStarLost(false);
                     EvtServer.NotifyStarLost(info);
                     break;
                 case STATE_CALIBRATING_PRIMARY:
                 case STATE_CALIBRATING_SECONDARY:
                     Debug.Write("Star lost during calibration... blundering on\n");
+                    GuideMetrics.AddStarLost(false);
                     EvtServer.NotifyStarLost(info);
                     pFrame->StatusMsg(_("star lost"));
                     break;
                 case STATE_GUIDING:
                 {
                     GuideLog.FrameDropped(info);
+                    GuideMetrics.AddStarLost(true);
                     EvtServer.NotifyStarLost(info);
                     GuidingAssistant::NotifyFrameDropped(info);
                     pFrame->pGraphLog->AppendData(info);
@@ -1189,7 +1383,22 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 // nothing to do but wait
                 break;
             case STATE_CALIBRATING_PRIMARY:
-                if (!pMount->IsCalibrated())
+                if (m_concurrentCal)
+                {
+                    // the AO and the mount calibrate in the same frames
+                    if (m_concurrentCal->Update(CurrentPosition()))
+                    {
+                        SetState(STATE_UNINITIALIZED);
+                        statusMessage = _("calibration failed");
+                        throw ERROR_INFO("Calibration failed");
+                    }
+
+                    if (!m_concurrentCal->IsComplete())
+                    {
+                        break;
+                    }
+                }
+                else if (!pMount->IsCalibrated())
                 {
                     if (pMount->UpdateCalibrationState(CurrentPosition()))
                     {
@@ -1256,6 +1465,8 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
                 pFrame->m_frameCounter = 0;
                 GuideLog.StartGuiding();
                 EvtServer.NotifyStartGuiding();
+                GuidingPerfStats.Start();
+                PolarDrift::Reset();
                 break;
             case STATE_GUIDING:
                 if (m_ditherRecenterRemaining.IsValid())
@@ -1324,6 +1535,32 @@ void Guider::UpdateGuideState(usImage *pImage, bool bStopping)
 
     UpdateImageDisplay(pImage);
 
+    // cut out once for everything that wants the star pixels of this frame
+    if (m_state >= STATE_SELECTED)
+        m_starCutout.Update(pImage, CurrentPosition());
+    else
+        m_starCutout.Invalidate();
+
+    if (m_starCutout.IsValid() && pFrame->IsImageLoggingEnabled() && !LoadShedder::Shed(SHED_IMAGE_LOG))
+        StarImageLogger.Post(m_starCutout, LockPosition(), pFrame->GetLoggedImageFormat());
+
+    if (ImgStream.HasClients())
+        ImgStream.NotifyFrame(pImage, pFrame->m_frameCounter, CurrentPosition());
+
+    if (EvtServer.HasImageClients())
+        EvtServer.NotifyFrame(pImage, CurrentPosition());
+
+    if (SharedFrameExport::IsEnabled())
+        FrameExport.Publish(pImage, pFrame->m_frameCounter, CurrentPosition());
+    else
+        FrameExport.Close();
+
+    if (DefectLearning.IsEnabled() && m_state >= STATE_SELECTED)
+        DefectLearning.NotifyStarPosition(CurrentPosition());
+
+    if (pImage)
+        PerfStats::CycleDone(perf.ElapsedUs());
+
     Debug.AddLine("UpdateGuideState exits: " + statusMessage);
 }
 
@@ -1344,6 +1581,34 @@ void Guider::SetLockPosShiftRate(const PHD_Point& rate, GRAPH_UNITS units, bool
     m_lockPosShift.shiftRate = rate;
     m_lockPosShift.shiftUnits = units;
     m_lockPosShift.shiftIsMountCoords = isMountCoords;
+    m_lockPosShift.rateTable.clear();
+
+    CometTool::UpdateCometToolControls();
+
+    if (m_state == STATE_CALIBRATED || m_state == STATE_GUIDING)
+    {
+        UpdateLockPosShiftCameraCoords();
+        if (LockPosShiftEnabled())
+        {
+            GuideLog.NotifyLockShiftParams(m_lockPosShift, m_lockPosition.ShiftRate());
+        }
+    }
+}
+
+// The table replaces any constant rate; the first rate stands in for it in
+// the comet tool and the guide log
+void Guider::SetLockPosShiftTable(const std::vector<LockPosShiftRate>& table, GRAPH_UNITS units, bool isMountCoords)
+{
+    Debug.Write(wxString::Format("SetLockPosShiftTable: %u rates units = %d isMountCoords = %d\n",
+        (unsigned int) table.size(), units, isMountCoords));
+
+    m_lockPosShift.rateTable = table;
+    m_lockPosShift.shiftUnits = units;
+    m_lockPosShift.shiftIsMountCoords = isMountCoords;
+    if (table.empty())
+        m_lockPosShift.shiftRate.Invalidate();
+    else
+        m_lockPosShift.shiftRate = table[0].rate;
 
     CometTool::UpdateCometToolControls();
 
@@ -1385,26 +1650,53 @@ void Guider::UpdateLockPosShiftCameraCoords(void)
         return;
     }
 
+    if (!m_lockPosShift.rateTable.empty())
+    {
+        // convert the whole table now, so each frame only interpolates
+        std::vector<wxLongLong_t> times;
+        std::vector<PHD_Point> rates;
+        times.reserve(m_lockPosShift.rateTable.size());
+        rates.reserve(m_lockPosShift.rateTable.size());
+        for (auto it = m_lockPosShift.rateTable.begin(); it != m_lockPosShift.rateTable.end(); ++it)
+        {
+            times.push_back(it->time);
+            rates.push_back(LockPosShiftCameraRate(it->rate));
+        }
+        Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: %u rates, first %.2g,%.2g px/sec\n",
+            (unsigned int) rates.size(), rates[0].X, rates[0].Y));
+        m_lockPosition.SetShiftTable(times, rates);
+        return;
+    }
+
+    Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: shift rate %s coords = %.2f,%.2f %s/hr\n",
+        m_lockPosShift.shiftIsMountCoords ? "mount" : "camera", m_lockPosShift.shiftRate.X, m_lockPosShift.shiftRate.Y,
+        m_lockPosShift.shiftUnits == UNIT_ARCSEC ? "arcsec" : "pixels"));
+
+    PHD_Point rate = LockPosShiftCameraRate(m_lockPosShift.shiftRate);
+
+    Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: shift rate %.2g,%.2g px/sec\n",
+        rate.X, rate.Y));
+
+    m_lockPosition.SetShiftRate(rate.X, rate.Y);
+}
+
+// a shift rate in the configured units and axes as camera px/sec
+PHD_Point Guider::LockPosShiftCameraRate(const PHD_Point& shiftRate) const
+{
     PHD_Point rate(0., 0.);
 
     // convert shift rate to camera coordinates
     if (m_lockPosShift.shiftIsMountCoords)
     {
-        Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: shift rate mount coords = %.2f,%.2f\n",
-            m_lockPosShift.shiftRate.X, m_lockPosShift.shiftRate.Y));
-
         Mount *scope = TheScope();
         if (scope)
-            scope->TransformMountCoordinatesToCameraCoordinates(m_lockPosShift.shiftRate, rate);
+            scope->TransformMountCoordinatesToCameraCoordinates(shiftRate, rate);
     }
     else
     {
-        rate = m_lockPosShift.shiftRate;
+        rate = shiftRate;
     }
 
-    Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: shift rate camera coords = %.2f,%.2f %s/hr\n",
-                  rate.X, rate.Y, m_lockPosShift.shiftUnits == UNIT_ARCSEC ? "arcsec" : "pixels"));
-
     // convert arc-seconds to pixels
     if (m_lockPosShift.shiftUnits == UNIT_ARCSEC)
     {
@@ -1412,10 +1704,7 @@ void Guider::UpdateLockPosShiftCameraCoords(void)
     }
     rate /= 3600.0;  // per hour => per second
 
-    Debug.Write(wxString::Format("UpdateLockPosShiftCameraCoords: shift rate %.2g,%.2g px/sec\n",
-        rate.X, rate.Y));
-
-    m_lockPosition.SetShiftRate(rate.X, rate.Y);
+    return rate;
 }
 
 wxString Guider::GetSettingsSummary()
@@ -1442,7 +1731,7 @@ void Guider::GuiderConfigDialogPane::LayoutControls(Guider *pGuider, BrainCtrlId
     wxStaticBoxSizer *pStarTrack = new wxStaticBoxSizer(wxVERTICAL, m_pParent, _("Guide star tracking"));
     wxStaticBoxSizer *pCalib = new wxStaticBoxSizer(wxVERTICAL, m_pParent, _("Calibration"));
     wxStaticBoxSizer *pShared = new wxStaticBoxSizer(wxVERTICAL, m_pParent, _("Shared Parameters"));
-    wxFlexGridSizer *pCalibSizer = new wxFlexGridSizer(3, 2, 10, 10);
+    wxFlexGridSizer *pCalibSizer = new wxFlexGridSizer(4, 2, 10, 10);
     wxFlexGridSizer *pSharedSizer = new wxFlexGridSizer(2, 2, 10, 10);
 
     pStarTrack->Add(GetSizerCtrl(CtrlMap, AD_szStarTracking), def_flags);
@@ -1454,6 +1743,8 @@ void Guider::GuiderConfigDialogPane::LayoutControls(Guider *pGuider, BrainCtrlId
     pCalibSizer->Add(GetSingleCtrl(CtrlMap, AD_cbAssumeOrthogonal), wxSizerFlags(0).Border(wxLEFT, 90));
     CondAddCtrl(pCalibSizer, CtrlMap, AD_cbClearCalibration);
     CondAddCtrl(pCalibSizer, CtrlMap, AD_cbUseDecComp, wxSizerFlags(0).Border(wxLEFT, 90));
+    CondAddCtrl(pCalibSizer, CtrlMap, AD_cbFastCalibration);
+    CondAddCtrl(pCalibSizer, CtrlMap, AD_cbShortCalExposures, wxSizerFlags(0).Border(wxLEFT, 90));
     pCalib->Add(pCalibSizer, def_flags);
     pCalib->Layout();
 
@@ -104,15 +104,24 @@ enum PauseType
     PAUSE_FULL,     // pause guide corrections and pause looping exposures
 };
 
+struct LockPosShiftRate
+{
+    wxLongLong_t time;          // UTC ms
+    PHD_Point rate;
+};
+
 struct LockPosShiftParams
 {
     bool shiftEnabled;
     PHD_Point shiftRate;
     GRAPH_UNITS shiftUnits;
     bool shiftIsMountCoords;
+    std::vector<LockPosShiftRate> rateTable;    // if not empty the rate follows this, e.g. from an ephemeris
 };
 
 class DefectMap;
+class GuiderGLView;
+class ConcurrentCalibration;
 
 /*
  * The Guider class is responsible for running the state machine
@@ -142,6 +151,19 @@ class Guider : public wxWindow
     // Private member data.
 
     wxImage *m_displayedImage;
+    wxBitmap m_displayedBitmap;     // m_displayedImage padded to the window, reused until something below changes
+    bool m_displayValid;            // cleared for a new frame
+    double m_displayGamma;
+    bool m_levelsValid;             // m_levelBlack and m_levelWhite are for the current frame
+    int m_levelBlack;
+    int m_levelWhite;
+    wxSize m_displayWinSize;
+    bool m_displayScaleImage;
+    bool m_displayPeak;             // downsample keeping the brightest pixel, see usImage::CopyToImageScaled
+    ImagePyramid m_pyramid;         // reductions of the current frame, shared by every rendering of it
+    StarCutout m_starCutout;        // the guide star of the current frame, see StarCutout
+    unsigned int m_displayFrame;    // counts InvalidateDisplay calls, tells the OpenGL view to upload the image
+    GuiderGLView *m_glView;         // draws the image and overlays instead of PaintHelper if enabled
     OVERLAY_MODE m_overlayMode;
     OverlaySlitCoords m_overlaySlitCoords;
     const DefectMap *m_defectMapPreview;
@@ -157,15 +179,19 @@ class Guider : public wxWindow
     double m_avgDistance;         // averaged distance for distance reporting
     bool m_avgDistanceNeedReset;
     GUIDER_STATE m_state;
+    ConcurrentCalibration *m_concurrentCal;   // AO and mount calibrating together, in STATE_CALIBRATING_PRIMARY
     usImage *m_pCurrentImage;
     bool m_scaleImage;
     bool m_lockPosIsSticky;
     bool m_fastRecenterEnabled;
     LockPosShiftParams m_lockPosShift;
     bool m_measurementMode;
+    wxCriticalSection m_moveShiftLock;
+    PHD_Point m_moveShift;          // star motion expected from the moves issued since the last frame, protected by m_moveShiftLock
 
 protected:
     int m_searchRegion; // how far u/d/l/r do we do the initial search for a star
+    PHD_Point m_predictedShift; // expected motion of the star since the previous frame, invalid when not guiding
     bool m_forceFullFrame;
     double m_scaleFactor;
     bool m_showBookmarks;
@@ -200,6 +226,8 @@ protected:
     virtual ~Guider(void);
 
     bool PaintHelper(wxAutoBufferedPaintDCBase& dc, wxMemoryDC& memDC);
+    void RenderDisplayedImage(void);
+    bool IsGLView(void) const;
     void SetState(GUIDER_STATE newState);
     void UpdateCurrentDistance(double distance);
 
@@ -216,6 +244,13 @@ public:
     void OnClose(wxCloseEvent& evt);
     void OnErase(wxEraseEvent& evt);
     void UpdateImageDisplay(usImage *pImage=NULL);
+    void InvalidateDisplay(void);
+    double DisplayGeometry(const wxSize& imageSize, wxSize *displaySize) const;
+    void DisplayLevels(int *blevel, int *wlevel);
+    virtual void DrawOverlays(GuiderPainter& dc, const wxSize& displaySize);
+    void CloseGLView(void);
+    void Refresh(bool eraseBackground = true, const wxRect *rect = NULL);
+    void Update(void);
 
     bool MoveLockPosition(const PHD_Point& mountDelta);
     bool SetLockPosition(const PHD_Point& position);
@@ -223,6 +258,7 @@ public:
     bool ShiftLockPosition(void);
     void EnableLockPosShift(bool enable);
     void SetLockPosShiftRate(const PHD_Point& rate, GRAPH_UNITS units, bool isMountCoords);
+    void SetLockPosShiftTable(const std::vector<LockPosShiftRate>& table, GRAPH_UNITS units, bool isMountCoords);
     bool LockPosShiftEnabled(void) const { return m_lockPosShift.shiftEnabled; }
     void SetLockPosIsSticky(bool isSticky) { m_lockPosIsSticky = isSticky; }
     bool LockPosIsSticky(void) const { return m_lockPosIsSticky; }
@@ -237,7 +273,8 @@ public:
     void SetPolarAlignCircle(const PHD_Point& center, double radius);
     void SetPolarAlignCircleCorrection(double val);
     double GetPolarAlignCircleCorrection(void);
-    bool SaveCurrentImage(const wxString& fileName);
+    bool SaveCurrentImage(const wxString& fileName, bool compress = false);
+    bool SaveCurrentImageAsync(const wxString& fileName, bool compress, FitsSaveNotify notify);
 
     void StartGuiding(void);
     void StopGuiding(void);
@@ -247,6 +284,7 @@ public:
     bool GetScaleImage(void);
 
     int GetSearchRegion(void) const;
+    static int AutoFindEdgeAllowance(void);
     double CurrentError(void);
 
     bool GetBookmarksShown(void);
@@ -259,6 +297,10 @@ public:
     void Reset(bool fullReset);
     void EnableMeasurementMode(bool enabled);
 
+    // called, from any thread, with the motion of the guide star expected
+    // from a guide move that was just made
+    void NotifyGuideMove(const PHD_Point& starShift);
+
     // virtual functions -- these CAN be overridden by a subclass, which should
     // consider whether they need to call the base class functions as part of
     // their operation
@@ -280,6 +322,9 @@ public:
 
     virtual bool IsLocked(void) = 0;
     virtual bool AutoSelect(void) = 0;
+    // select the star Star::AutoFind found at pos, for a search run away
+    // from the current image (see find_star in the event server)
+    virtual bool SelectAutoFoundStar(const PHD_Point& pos) = 0;
 
     virtual const PHD_Point& CurrentPosition(void) = 0;
     virtual wxRect GetBoundingBox(void) = 0;
@@ -291,6 +336,7 @@ public:
     virtual int StarError(void) = 0;
 
     usImage *CurrentImage(void);
+    const StarCutout& CurrentStarCutout(void) const { return m_starCutout; }
     virtual wxImage *DisplayedImage(void);
     virtual double ScaleFactor(void);
 
@@ -301,6 +347,9 @@ public:
 
 private:
     void UpdateLockPosShiftCameraCoords(void);
+    PHD_Point LockPosShiftCameraRate(const PHD_Point& rate) const;
+    void OnSize(wxSizeEvent& evt);
+    friend class GuiderGLView;
     DECLARE_EVENT_TABLE()
 };
 
@@ -364,9 +413,23 @@ inline usImage *Guider::CurrentImage(void)
     return m_pCurrentImage;
 }
 
+inline void Guider::InvalidateDisplay(void)
+{
+    m_displayValid = false;
+    m_levelsValid = false;
+    m_pyramid.Invalidate();
+    ++m_displayFrame;
+}
+
+inline bool Guider::IsGLView(void) const
+{
+    return m_glView != NULL;
+}
+
 inline wxImage *Guider::DisplayedImage(void)
 {
-    return m_displayedImage;
+    // the OpenGL view keeps the stretched image on the GPU only
+    return m_glView ? NULL : m_displayedImage;
 }
 
 inline double Guider::ScaleFactor(void)
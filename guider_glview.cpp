@@ -0,0 +1,608 @@
+/*
+ *  guider_glview.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#if defined(PHD_OPENGL_VIEW)
+
+// the OpenGL 2.0 shader functions are exported by the GL library except on
+// Windows, where they must be looked up at run time
+#if !defined(__WINDOWS__) && !defined(__APPLE__)
+# define GL_GLEXT_PROTOTYPES
+#endif
+
+#include "guider_glview.h"
+
+#if defined(__APPLE__)
+# include <OpenGL/gl.h>
+#else
+# include <GL/gl.h>
+# if !defined(__WINDOWS__)
+#  include <GL/glext.h>
+# endif
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+# define GL_CLAMP_TO_EDGE 0x812F
+#endif
+#ifndef GL_FRAGMENT_SHADER
+# define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_COMPILE_STATUS
+# define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+# define GL_LINK_STATUS 0x8B82
+#endif
+
+#if defined(__WINDOWS__)
+
+typedef char GLchar;
+
+#define GL_SHADER_FUNCS(X) \
+    X(GLuint, glCreateShader, (GLenum type)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar **string, const GLint *length)) \
+    X(void, glCompileShader, (GLuint shader)) \
+    X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint *params)) \
+    X(void, glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog)) \
+    X(void, glDeleteShader, (GLuint shader)) \
+    X(GLuint, glCreateProgram, (void)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader)) \
+    X(void, glLinkProgram, (GLuint program)) \
+    X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint *params)) \
+    X(void, glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog)) \
+    X(void, glUseProgram, (GLuint program)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name)) \
+    X(void, glUniform1i, (GLint location, GLint v0)) \
+    X(void, glUniform1f, (GLint location, GLfloat v0)) \
+    X(void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1))
+
+#define DECLARE_GL_FUNC(ret, name, args) \
+    typedef ret (APIENTRY *name##_fn) args; \
+    static name##_fn p_##name;
+GL_SHADER_FUNCS(DECLARE_GL_FUNC)
+
+# define GLFN(name) p_##name
+
+#else
+
+# define GLFN(name) name
+
+#endif
+
+// returns true if the shader functions are not available
+static bool LoadShaderFuncs(void)
+{
+#if defined(__WINDOWS__)
+# define LOAD_GL_FUNC(ret, name, args) \
+    if ((p_##name = (name##_fn) wglGetProcAddress(#name)) == NULL) \
+        return true;
+    GL_SHADER_FUNCS(LOAD_GL_FUNC)
+#endif
+    return false;
+}
+
+// The same stretch as the lookup table of usImage::CopyToImage. When the
+// frame is shrunk the brightest of a grid of samples over each displayed
+// pixel is kept, like usImage::CopyToImageScaled does, so faint stars stay
+// visible.
+static const char *FragmentShader =
+    "uniform sampler2D image;\n"
+    "uniform vec2 texel;\n"         // a frame pixel in texture coordinates
+    "uniform float box;\n"          // frame pixels per displayed pixel, 1 for no peak sampling
+    "uniform float black;\n"
+    "uniform float range;\n"
+    "uniform float power;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 tc = gl_TexCoord[0].st;\n"
+    "    float v = texture2D(image, tc).r;\n"
+    "    if (box > 1.0)\n"
+    "    {\n"
+    "        vec2 origin = tc - 0.5 * box * texel;\n"
+    "        for (int i = 0; i < 4; i++)\n"
+    "            for (int j = 0; j < 4; j++)\n"
+    "                v = max(v, texture2D(image, origin + (vec2(float(i), float(j)) + 0.5) * 0.25 * box * texel).r);\n"
+    "    }\n"
+    "    v = clamp((v * 65535.0 - black) / range, 0.0, 1.0);\n"
+    "    gl_FragColor = vec4(vec3(pow(v, power)), 1.0);\n"
+    "}\n";
+
+// draws the guider overlays with GL lines and points, offset by half a
+// pixel so one pixel wide lines land on the pixels the wxDC would draw
+class GLGuiderPainter : public GuiderPainter
+{
+    GuiderGLView *m_view;
+    wxColour m_penColour;
+    wxColour m_textColour;
+    bool m_stipple;
+
+public:
+    GLGuiderPainter(GuiderGLView *view)
+        : m_view(view), m_penColour(*wxBLACK), m_textColour(*wxBLACK), m_stipple(false)
+    {
+        glLineWidth(1.f);
+    }
+
+    ~GLGuiderPainter()
+    {
+        if (m_stipple)
+            glDisable(GL_LINE_STIPPLE);
+    }
+
+    void SetPen(const wxPen& pen)
+    {
+        m_penColour = pen.GetColour();
+        glColor3ub(m_penColour.Red(), m_penColour.Green(), m_penColour.Blue());
+        glLineWidth((GLfloat) wxMax(1, pen.GetWidth()));
+
+        m_stipple = pen.GetStyle() != wxPENSTYLE_SOLID;
+        if (m_stipple)
+        {
+            glLineStipple(1, pen.GetStyle() == wxPENSTYLE_DOT ? 0x5555 : 0x0F0F);
+            glEnable(GL_LINE_STIPPLE);
+        }
+        else
+            glDisable(GL_LINE_STIPPLE);
+    }
+
+    void SetTextForeground(const wxColour& colour)
+    {
+        m_textColour = colour;
+    }
+
+    void DrawLine(double x1, double y1, double x2, double y2)
+    {
+        glBegin(GL_LINES);
+        glVertex2d(x1 + 0.5, y1 + 0.5);
+        glVertex2d(x2 + 0.5, y2 + 0.5);
+        glEnd();
+    }
+
+    void DrawLines(int n, const wxPoint points[])
+    {
+        glBegin(GL_LINE_STRIP);
+        for (int i = 0; i < n; i++)
+            glVertex2d(points[i].x + 0.5, points[i].y + 0.5);
+        glEnd();
+    }
+
+    void DrawCircle(double x, double y, double radius)
+    {
+        int n = wxMax(24, wxMin(360, (int)(radius * 2.0)));
+        glBegin(GL_LINE_LOOP);
+        for (int i = 0; i < n; i++)
+        {
+            double a = 2.0 * M_PI * i / n;
+            glVertex2d(x + 0.5 + radius * cos(a), y + 0.5 + radius * sin(a));
+        }
+        glEnd();
+    }
+
+    void DrawRectangle(double x, double y, double width, double height)
+    {
+        glBegin(GL_LINE_LOOP);
+        glVertex2d(x + 0.5, y + 0.5);
+        glVertex2d(x + width - 0.5, y + 0.5);
+        glVertex2d(x + width - 0.5, y + height - 0.5);
+        glVertex2d(x + 0.5, y + height - 0.5);
+        glEnd();
+    }
+
+    void DrawPoint(double x, double y)
+    {
+        glBegin(GL_POINTS);
+        glVertex2d(x + 0.5, y + 0.5);
+        glEnd();
+    }
+
+    void DrawText(const wxString& text, int x, int y)
+    {
+        if (m_stipple)
+            glDisable(GL_LINE_STIPPLE);
+
+        m_view->DrawText(text, x, y, m_textColour);
+
+        glColor3ub(m_penColour.Red(), m_penColour.Green(), m_penColour.Blue());
+        if (m_stipple)
+            glEnable(GL_LINE_STIPPLE);
+    }
+};
+
+BEGIN_EVENT_TABLE(GuiderGLView, wxGLCanvas)
+    EVT_PAINT(GuiderGLView::OnPaint)
+    EVT_ERASE_BACKGROUND(GuiderGLView::OnErase)
+    EVT_MOUSE_EVENTS(GuiderGLView::OnMouse)
+END_EVENT_TABLE()
+
+GuiderGLView *GuiderGLView::Create(Guider *guider)
+{
+    static const int attribs[] = { WX_GL_RGBA, WX_GL_DOUBLEBUFFER, 0 };
+
+    if (!wxGLCanvas::IsDisplaySupported(attribs))
+    {
+        Debug.Write("Guider: OpenGL is not supported by the display, the OpenGL image view is not used\n");
+        return NULL;
+    }
+
+    Debug.Write("Guider: using the OpenGL image view\n");
+    return new GuiderGLView(guider, attribs);
+}
+
+GuiderGLView::GuiderGLView(Guider *guider, const int *attribs)
+    : wxGLCanvas(guider, wxID_ANY, attribs, wxPoint(0, 0), guider->GetClientSize(), wxFULL_REPAINT_ON_RESIZE),
+      m_guider(guider),
+      m_context(NULL),
+      m_initialized(false),
+      m_failed(false),
+      m_program(0),
+      m_uImage(-1), m_uTexel(-1), m_uBox(-1), m_uBlack(-1), m_uRange(-1), m_uPower(-1),
+      m_texture(0),
+      m_maxTextureSize(0),
+      m_uploadedFrame(0),
+      m_haveImage(false)
+{
+    SetBackgroundStyle(wxBG_STYLE_CUSTOM);
+}
+
+GuiderGLView::~GuiderGLView()
+{
+    // the program and the textures are freed with the context
+    delete m_context;
+}
+
+void GuiderGLView::Fail(const wxString& why)
+{
+    Debug.Write(wxString::Format("Guider: OpenGL image view failed: %s\n", why));
+    m_failed = true;
+    m_guider->CallAfter(&Guider::CloseGLView);
+}
+
+bool GuiderGLView::InitGL(void)
+{
+    m_initialized = true;
+
+    const char *version = (const char *) glGetString(GL_VERSION);
+    const char *renderer = (const char *) glGetString(GL_RENDERER);
+    Debug.Write(wxString::Format("Guider: OpenGL version %s, renderer %s\n", version ? version : "?", renderer ? renderer : "?"));
+
+    if (!version || atoi(version) < 2)
+    {
+        Fail("OpenGL 2.0 is required");
+        return true;
+    }
+
+    if (LoadShaderFuncs())
+    {
+        Fail("the shader functions are not available");
+        return true;
+    }
+
+    GLuint shader = GLFN(glCreateShader)(GL_FRAGMENT_SHADER);
+    const GLchar *src = FragmentShader;
+    GLFN(glShaderSource)(shader, 1, &src, NULL);
+    GLFN(glCompileShader)(shader);
+
+    GLint ok = 0;
+    GLFN(glGetShaderiv)(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+        GLchar log[1024] = "";
+        GLFN(glGetShaderInfoLog)(shader, sizeof(log), NULL, log);
+        GLFN(glDeleteShader)(shader);
+        Fail(wxString::Format("shader compile error %s", log));
+        return true;
+    }
+
+    m_program = GLFN(glCreateProgram)();
+    GLFN(glAttachShader)(m_program, shader);
+    GLFN(glLinkProgram)(m_program);
+    GLFN(glDeleteShader)(shader);       // freed with the program
+
+    GLFN(glGetProgramiv)(m_program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        GLchar log[1024] = "";
+        GLFN(glGetProgramInfoLog)(m_program, sizeof(log), NULL, log);
+        Fail(wxString::Format("shader link error %s", log));
+        return true;
+    }
+
+    m_uImage = GLFN(glGetUniformLocation)(m_program, "image");
+    m_uTexel = GLFN(glGetUniformLocation)(m_program, "texel");
+    m_uBox = GLFN(glGetUniformLocation)(m_program, "box");
+    m_uBlack = GLFN(glGetUniformLocation)(m_program, "black");
+    m_uRange = GLFN(glGetUniformLocation)(m_program, "range");
+    m_uPower = GLFN(glGetUniformLocation)(m_program, "power");
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    m_maxTextureSize = maxSize;
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return false;
+}
+
+bool GuiderGLView::UploadImage(usImage *img)
+{
+    WorkerThread::CompleteLazyROI(*img);
+
+    int width = img->Size.GetWidth();
+    int height = img->Size.GetHeight();
+
+    if (width > m_maxTextureSize || height > m_maxTextureSize)
+    {
+        Fail(wxString::Format("the %dx%d frame is larger than the maximum texture size %d", width, height, m_maxTextureSize));
+        return true;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+
+    bool const incremental = m_haveImage && img->Size == m_textureSize && !img->Subframe.IsEmpty() && !m_lastSubframe.IsEmpty();
+
+    // an image holding only its subframe is uploaded in full from a full
+    // frame copy, or else as the subframe with the last subframe cleared
+    usImage scratch;
+    const usImage *full = incremental ? img : img->FullFrame(&scratch);
+    if (!full)
+        return true;
+
+    if (incremental && img->IsROIOnly())
+    {
+        std::vector<unsigned short> zeros((size_t) m_lastSubframe.GetWidth() * m_lastSubframe.GetHeight(), 0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, m_lastSubframe.GetLeft(), m_lastSubframe.GetTop(), m_lastSubframe.GetWidth(),
+            m_lastSubframe.GetHeight(), GL_LUMINANCE, GL_UNSIGNED_SHORT, &zeros[0]);
+
+        const wxRect& rect = img->DataRect;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.GetLeft(), rect.GetTop(), rect.GetWidth(), rect.GetHeight(),
+            GL_LUMINANCE, GL_UNSIGNED_SHORT, img->ImageData);
+    }
+    else if (incremental)
+    {
+        // a subframe following a subframe: outside the two subframes the
+        // texture already holds the cleared frame
+        wxRect rect(img->Subframe);
+        rect.Union(m_lastSubframe);
+        rect.Intersect(wxRect(img->Size));
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.GetLeft());
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.GetTop());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.GetLeft(), rect.GetTop(), rect.GetWidth(), rect.GetHeight(),
+            GL_LUMINANCE, GL_UNSIGNED_SHORT, img->ImageData);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+    else if (m_haveImage && img->Size == m_textureSize)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_SHORT, full->ImageData);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE16, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_SHORT, full->ImageData);
+        m_textureSize = img->Size;
+    }
+
+    m_lastSubframe = img->Subframe;
+    m_haveImage = true;
+
+    return false;
+}
+
+void GuiderGLView::DrawImage(const wxSize& displaySize, const usImage *img)
+{
+    int blevel, wlevel;
+    m_guider->DisplayLevels(&blevel, &wlevel);
+    double power = pFrame->Stretch_gamma;
+
+    float black, range, gamma;
+    if (power == 1.0 || blevel >= wlevel)
+    {
+        black = 0.f;
+        range = (float) wxMax(1, wlevel);
+        gamma = 1.f;
+    }
+    else
+    {
+        black = (float) blevel;
+        range = (float) (wlevel - blevel);
+        gamma = (float) power;
+    }
+
+    double scale = m_guider->m_scaleFactor;
+    float box = m_guider->m_displayPeak && scale < 1.0 ? (float)(1.0 / scale) : 1.f;
+
+    GLFN(glUseProgram)(m_program);
+    GLFN(glUniform1i)(m_uImage, 0);
+    GLFN(glUniform2f)(m_uTexel, 1.f / m_textureSize.GetWidth(), 1.f / m_textureSize.GetHeight());
+    GLFN(glUniform1f)(m_uBox, box);
+    GLFN(glUniform1f)(m_uBlack, black);
+    GLFN(glUniform1f)(m_uRange, range);
+    GLFN(glUniform1f)(m_uPower, gamma);
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    int w = displaySize.GetWidth();
+    int h = displaySize.GetHeight();
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.f, 0.f); glVertex2i(0, 0);
+    glTexCoord2f(1.f, 0.f); glVertex2i(w, 0);
+    glTexCoord2f(1.f, 1.f); glVertex2i(w, h);
+    glTexCoord2f(0.f, 1.f); glVertex2i(0, h);
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
+    GLFN(glUseProgram)(0);
+}
+
+void GuiderGLView::DrawText(const wxString& text, int x, int y, const wxColour& colour)
+{
+    std::map<wxString, TextTexture>::iterator it = m_text.find(text);
+
+    if (it == m_text.end())
+    {
+        // the overlays use a few fixed labels, each is rendered to a
+        // texture once
+        wxSize size = GetTextExtent(text);
+        if (size.x <= 0 || size.y <= 0)
+            return;
+
+        wxBitmap bmp(size.x, size.y, 24);
+        wxMemoryDC mdc(bmp);
+        mdc.SetFont(GetFont());
+        mdc.SetBackground(*wxBLACK_BRUSH);
+        mdc.Clear();
+        mdc.SetTextForeground(*wxWHITE);
+        mdc.DrawText(text, 0, 0);
+        mdc.SelectObject(wxNullBitmap);
+
+        wxImage image = bmp.ConvertToImage();
+        const unsigned char *src = image.GetData();
+        std::vector<unsigned char> rgba(size.x * size.y * 4);
+        for (int i = 0; i < size.x * size.y; i++)
+        {
+            rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 255;
+            rgba[i * 4 + 3] = src[i * 3];
+        }
+
+        TextTexture tt;
+        tt.size = size;
+        glGenTextures(1, &tt.tex);
+        glBindTexture(GL_TEXTURE_2D, tt.tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+
+        it = m_text.insert(std::make_pair(text, tt)).first;
+    }
+
+    const wxSize& size = it->second.size;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, it->second.tex);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glColor3ub(colour.Red(), colour.Green(), colour.Blue());
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.f, 0.f); glVertex2i(x, y);
+    glTexCoord2f(1.f, 0.f); glVertex2i(x + size.x, y);
+    glTexCoord2f(1.f, 1.f); glVertex2i(x + size.x, y + size.y);
+    glTexCoord2f(0.f, 1.f); glVertex2i(x, y + size.y);
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+}
+
+void GuiderGLView::OnPaint(wxPaintEvent& evt)
+{
+    PERF_STAGE(PERF_STAGE_PAINT);
+
+    wxPaintDC dc(this);
+
+    if (m_failed)
+        return;
+
+    if (!m_context)
+        m_context = new wxGLContext(this);
+    SetCurrent(*m_context);
+
+    if (!m_initialized && InitGL())
+        return;
+
+    // the window size globals are kept up to date like PaintHelper does
+    m_guider->GetSize(&XWinSize, &YWinSize);
+
+    glViewport(0, 0, XWinSize, YWinSize);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, XWinSize, YWinSize, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    wxSize displaySize(XWinSize, YWinSize);
+    usImage *img = m_guider->CurrentImage();
+
+    if (img->ImageData)
+    {
+        if (!m_haveImage || m_uploadedFrame != m_guider->m_displayFrame)
+        {
+            if (UploadImage(img))
+                return;
+            m_uploadedFrame = m_guider->m_displayFrame;
+        }
+
+        m_guider->m_scaleFactor = m_guider->DisplayGeometry(img->Size, &displaySize);
+        DrawImage(displaySize, img);
+    }
+
+    {
+        GLGuiderPainter painter(this);
+        m_guider->DrawOverlays(painter, displaySize);
+    }
+
+    SwapBuffers();
+}
+
+void GuiderGLView::OnErase(wxEraseEvent& evt)
+{
+    // OnPaint clears the whole view
+}
+
+void GuiderGLView::OnMouse(wxMouseEvent& evt)
+{
+    // the view covers the guider window, which handles the clicks
+    wxMouseEvent guiderEvt(evt);
+    guiderEvt.SetEventObject(m_guider);
+    guiderEvt.SetId(m_guider->GetId());
+    m_guider->GetEventHandler()->ProcessEvent(guiderEvt);
+}
+
+#endif // PHD_OPENGL_VIEW
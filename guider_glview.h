@@ -0,0 +1,98 @@
+/*
+ *  guider_glview.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDER_GLVIEW_INCLUDED
+#define GUIDER_GLVIEW_INCLUDED
+
+#if defined(PHD_OPENGL_VIEW)
+
+#include <wx/glcanvas.h>
+
+// An alternative to Guider::PaintHelper that covers the guider window. The
+// 16-bit frame is uploaded as a texture, only the subframe when the frame
+// is a subframe of the same size as the last one, and the stretch, gamma
+// and zoom are applied by a fragment shader. The guider overlays are drawn
+// as GL lines and points through GuiderPainter. Enabled by the
+// /guider/OpenGLView setting in builds configured with GUIDER_OPENGL_VIEW.
+class GuiderGLView : public wxGLCanvas
+{
+    struct TextTexture
+    {
+        unsigned int tex;
+        wxSize size;
+    };
+
+    Guider *m_guider;
+    wxGLContext *m_context;
+    bool m_initialized;
+    bool m_failed;
+    unsigned int m_program;
+    int m_uImage;
+    int m_uTexel;
+    int m_uBox;
+    int m_uBlack;
+    int m_uRange;
+    int m_uPower;
+    unsigned int m_texture;
+    int m_maxTextureSize;
+    wxSize m_textureSize;
+    wxRect m_lastSubframe;          // subframe of the last upload, empty for a full frame
+    unsigned int m_uploadedFrame;
+    bool m_haveImage;
+    std::map<wxString, TextTexture> m_text;
+
+    GuiderGLView(Guider *guider, const int *attribs);
+
+public:
+    // returns NULL if OpenGL is not available
+    static GuiderGLView *Create(Guider *guider);
+    ~GuiderGLView();
+
+    void DrawText(const wxString& text, int x, int y, const wxColour& colour);
+
+private:
+    bool InitGL(void);
+    bool UploadImage(usImage *img);
+    void DrawImage(const wxSize& displaySize, const usImage *img);
+    void Fail(const wxString& why);
+    void OnPaint(wxPaintEvent& evt);
+    void OnErase(wxEraseEvent& evt);
+    void OnMouse(wxMouseEvent& evt);
+
+    DECLARE_EVENT_TABLE()
+};
+
+#endif // PHD_OPENGL_VIEW
+
+#endif
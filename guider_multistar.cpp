@@ -0,0 +1,768 @@
+/*
+ *  guider_multistar.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include <algorithm>
+
+enum {
+    DEFAULT_MAX_STARS = 9,
+    MAX_MAX_STARS = 24,
+    MIN_STARS_FOR_AVERAGE = 3,  // guide star included; fewer than this and the guide star is used alone
+    BACKUP_STARS = 3,           // stars tracked for star-lost recovery with multi-star guiding disabled
+    BACKUP_RANGE = 6,           // ... within this many search regions of the guide star, to keep the subframe small
+};
+
+// Stars brighter than this are treated as seeing-limited and get equal weight.
+// Fainter stars are weighted down in proportion to their photon noise.
+static const double SEEING_LIMITED_SNR = 25.0;
+// An estimate of the guide star position is rejected when it is further than
+// OUTLIER_SCALE times the median distance from the median estimate, but never
+// when it is within OUTLIER_MIN_PX of the median.
+static const double OUTLIER_SCALE = 3.0;
+static const double OUTLIER_MIN_PX = 0.25;
+
+// A fixed set of worker threads that run Star::Find on a batch of stars.
+// Start() hands a batch to the workers and returns immediately; Wait() helps
+// with whatever part of the batch has not been picked up yet and returns
+// when the whole batch is done.
+class StarFindPool
+{
+    class Worker : public wxThread
+    {
+        StarFindPool& m_pool;
+    public:
+        Worker(StarFindPool& pool) : wxThread(wxTHREAD_JOINABLE), m_pool(pool) { }
+        ExitCode Entry() { PerfTrace::SetThreadName("star finder"); ThreadPriorityScope priority(THREAD_CLASS_GUIDE, "star finder"); m_pool.WorkerLoop(); return (ExitCode) 0; }
+    };
+
+    enum { MAX_WORKERS = 7 };
+
+    wxMutex m_lock;
+    wxCondition m_workCond;
+    wxCondition m_doneCond;
+    std::vector<Worker *> m_workers;
+    bool m_started;
+    bool m_stop;
+
+    // current batch, protected by m_lock
+    const usImage *m_image;
+    Star *m_stars;
+    unsigned int m_count;
+    unsigned int m_next;
+    unsigned int m_pending;
+    int m_searchRegion;
+    Star::FindMode m_mode;
+
+    void StartWorkers(void);
+    void WorkerLoop(void);
+    void FindNext(void);
+
+public:
+    StarFindPool();
+    ~StarFindPool();
+
+    void Start(const usImage *pImage, std::vector<Star>& stars, int searchRegion, Star::FindMode mode);
+    void Wait(void);
+};
+
+StarFindPool::StarFindPool()
+    : m_workCond(m_lock),
+      m_doneCond(m_lock),
+      m_started(false),
+      m_stop(false),
+      m_image(0),
+      m_stars(0),
+      m_count(0),
+      m_next(0),
+      m_pending(0),
+      m_searchRegion(0),
+      m_mode(Star::FIND_CENTROID)
+{
+}
+
+StarFindPool::~StarFindPool()
+{
+    {
+        wxMutexLocker lck(m_lock);
+        m_stop = true;
+        m_workCond.Broadcast();
+    }
+
+    for (std::vector<Worker *>::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+    {
+        (*it)->Wait();
+        delete *it;
+    }
+}
+
+void StarFindPool::StartWorkers(void)
+{
+    m_started = true;
+
+    // the thread calling Wait() does its share of the work
+    int nworkers = std::min(wxThread::GetCPUCount() - 1, (int) MAX_WORKERS);
+
+    for (int i = 0; i < nworkers; i++)
+    {
+        Worker *worker = new Worker(*this);
+        if (worker->Create() != wxTHREAD_NO_ERROR || worker->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete worker;
+            break;
+        }
+        m_workers.push_back(worker);
+    }
+
+    Debug.Write(wxString::Format("StarFindPool: started %u worker threads\n", (unsigned int) m_workers.size()));
+}
+
+// called with m_lock held
+void StarFindPool::FindNext(void)
+{
+    Star& star = m_stars[m_next++];
+    const usImage *pImage = m_image;
+    int searchRegion = m_searchRegion;
+    Star::FindMode mode = m_mode;
+
+    m_lock.Unlock();
+    star.Find(pImage, searchRegion, mode);
+    m_lock.Lock();
+
+    if (--m_pending == 0)
+        m_doneCond.Broadcast();
+}
+
+void StarFindPool::WorkerLoop(void)
+{
+    wxMutexLocker lck(m_lock);
+
+    while (true)
+    {
+        while (!m_stop && m_next >= m_count)
+            m_workCond.Wait();
+
+        if (m_stop)
+            break;
+
+        FindNext();
+    }
+}
+
+void StarFindPool::Start(const usImage *pImage, std::vector<Star>& stars, int searchRegion, Star::FindMode mode)
+{
+    if (!m_started)
+        StartWorkers();
+
+    wxMutexLocker lck(m_lock);
+
+    assert(m_pending == 0);
+
+    m_image = pImage;
+    m_stars = stars.empty() ? 0 : &stars[0];
+    m_count = stars.size();
+    m_next = 0;
+    m_pending = m_count;
+    m_searchRegion = searchRegion;
+    m_mode = mode;
+
+    if (m_count > 0)
+        m_workCond.Broadcast();
+}
+
+void StarFindPool::Wait(void)
+{
+    wxMutexLocker lck(m_lock);
+
+    while (m_next < m_count)
+        FindNext();
+
+    while (m_pending > 0)
+        m_doneCond.Wait();
+
+    m_stars = 0;
+    m_count = m_next = 0;
+}
+
+GuiderMultiStar::GuiderMultiStar(wxWindow *parent)
+    : GuiderOneStar(parent),
+      m_starsUsed(0),
+      m_pool(new StarFindPool()),
+      m_multiStarEnabled(false),
+      m_backupStars(true),
+      m_maxStars(DEFAULT_MAX_STARS)
+{
+}
+
+GuiderMultiStar::~GuiderMultiStar()
+{
+    delete m_pool;
+}
+
+void GuiderMultiStar::LoadProfileSettings(void)
+{
+    GuiderOneStar::LoadProfileSettings();
+
+    bool enable = pConfig->Profile.GetBoolean("/guider/multistar/enabled", false);
+    SetMultiStarEnabled(enable);
+
+    int maxStars = pConfig->Profile.GetInt("/guider/multistar/MaxStars", DEFAULT_MAX_STARS);
+    SetMaxStars(maxStars);
+
+    SetBackupStarsEnabled(pConfig->Profile.GetBoolean("/guider/multistar/BackupStars", true));
+}
+
+void GuiderMultiStar::SetBackupStarsEnabled(bool enable)
+{
+    if (!enable && !m_multiStarEnabled)
+        ClearSecondaryStars();
+
+    m_backupStars = enable;
+    pConfig->Profile.SetBoolean("/guider/multistar/BackupStars", enable);
+}
+
+void GuiderMultiStar::SetMultiStarEnabled(bool enable)
+{
+    if (!enable && !m_backupStars)
+        ClearSecondaryStars();
+
+    m_multiStarEnabled = enable;
+    pConfig->Profile.SetBoolean("/guider/multistar/enabled", enable);
+}
+
+bool GuiderMultiStar::SetMaxStars(int maxStars)
+{
+    bool bError = false;
+
+    try
+    {
+        if (maxStars < 1)
+        {
+            m_maxStars = 1;
+            throw ERROR_INFO("maxStars < 1");
+        }
+        else if (maxStars > MAX_MAX_STARS)
+        {
+            m_maxStars = MAX_MAX_STARS;
+            throw ERROR_INFO("maxStars > MAX_MAX_STARS");
+        }
+        m_maxStars = maxStars;
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    if (m_secondaries.size() > m_maxStars)
+        m_secondaries.resize(m_maxStars);
+
+    pConfig->Profile.SetInt("/guider/multistar/MaxStars", m_maxStars);
+
+    return bError;
+}
+
+void GuiderMultiStar::ClearSecondaryStars(void)
+{
+    m_secondaries.clear();
+    m_guidePos.Invalidate();
+    m_starsUsed = 0;
+}
+
+void GuiderMultiStar::SelectSecondaryStars(const usImage *pImage)
+{
+    ClearSecondaryStars();
+
+    if ((!m_multiStarEnabled && !m_backupStars) || !m_star.IsValid())
+        return;
+
+    // without multi-star guiding only a few nearby stars are kept as backups
+    unsigned int const maxStars = m_multiStarEnabled ? m_maxStars : BACKUP_STARS;
+    double const maxDist = m_multiStarEnabled ? 1e9 : (double) BACKUP_RANGE * m_searchRegion;
+
+    std::vector<Star> candidates;
+    Star best;
+    if (!best.AutoFind(*pImage, 0, m_searchRegion, &candidates))
+        return;
+
+    // when the guide star was selected by hand the star AutoFind would have
+    // picked is a candidate too
+    Star tmp;
+    if (tmp.Find(pImage, m_searchRegion, ROUND(best.X), ROUND(best.Y), Star::FIND_CENTROID) &&
+        tmp.GetError() != Star::STAR_SATURATED)
+    {
+        candidates.insert(candidates.begin(), tmp);
+    }
+
+    // AutoFind rejects stars whose search regions would overlap, but the guide
+    // star is not necessarily one of the AutoFind stars so check against it too
+    double const minDist = 2.0 * m_searchRegion + 1.0;
+
+    for (std::vector<Star>::const_iterator it = candidates.begin(); it != candidates.end() && m_secondaries.size() < maxStars; ++it)
+    {
+        if (it->Distance(m_star) < minDist || it->Distance(m_star) > maxDist)
+            continue;
+
+        SecondaryStar sec;
+        sec.star = *it;
+        sec.offset = *it - m_star;
+        m_secondaries.push_back(sec);
+    }
+
+    Debug.Write(wxString::Format("MultiStar: selected %u %s stars\n", (unsigned int) m_secondaries.size(),
+        m_multiStarEnabled ? "secondary" : "backup"));
+}
+
+bool GuiderMultiStar::AutoSelect(void)
+{
+    ClearSecondaryStars();
+
+    return GuiderOneStar::AutoSelect();
+}
+
+bool GuiderMultiStar::SelectAutoFoundStar(const PHD_Point& pos)
+{
+    ClearSecondaryStars();
+
+    bool bError = GuiderOneStar::SelectAutoFoundStar(pos);
+
+    if (!bError && (m_multiStarEnabled || m_backupStars))
+    {
+        SelectSecondaryStars(CurrentImage());
+        Refresh();
+    }
+
+    return bError;
+}
+
+bool GuiderMultiStar::SetCurrentPosition(usImage *pImage, const PHD_Point& position)
+{
+    ClearSecondaryStars();
+
+    bool bError = GuiderOneStar::SetCurrentPosition(pImage, position);
+
+    if (!bError)
+        SelectSecondaryStars(pImage);
+
+    return bError;
+}
+
+void GuiderMultiStar::InvalidateCurrentPosition(bool fullReset)
+{
+    GuiderOneStar::InvalidateCurrentPosition(fullReset);
+
+    m_guidePos.Invalidate();
+    m_starsUsed = 0;
+
+    if (fullReset)
+        ClearSecondaryStars();
+}
+
+const PHD_Point& GuiderMultiStar::CurrentPosition(void)
+{
+    if (m_guidePos.IsValid())
+        return m_guidePos;
+    return m_star;
+}
+
+bool GuiderMultiStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo)
+{
+    m_guidePos.Invalidate();
+    m_starsUsed = 0;
+
+    if (m_secondaries.empty())
+        return GuiderOneStar::UpdateCurrentPosition(pImage, errorInfo);
+
+    // look for the secondary stars on the worker threads while the guide
+    // star is found and checked on this thread
+    m_found.resize(m_secondaries.size());
+    for (unsigned int i = 0; i < m_secondaries.size(); i++)
+    {
+        m_found[i] = m_secondaries[i].star;
+        // the guide moves take the secondary stars along with the guide star
+        if (m_predictedSearch && m_predictedShift.IsValid())
+        {
+            m_found[i].X += m_predictedShift.X;
+            m_found[i].Y += m_predictedShift.Y;
+        }
+    }
+
+    m_pool->Start(pImage, m_found, m_searchRegion, pFrame->GetStarFindMode());
+
+    bool bError = GuiderOneStar::UpdateCurrentPosition(pImage, errorInfo);
+
+    // OnStarFound has already waited for the batch unless the guide star was
+    // not found, in which case the secondary stars keep their last positions
+    m_pool->Wait();
+
+    if (bError && IsGuiding())
+        bError = RecoverGuideStar(pImage, errorInfo);
+
+    return bError;
+}
+
+struct StarEstimate
+{
+    double x;
+    double y;
+    double weight;
+    double dist;
+};
+
+static double median(std::vector<double>& v)
+{
+    size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    return v[mid];
+}
+
+inline static double StarWeight(double snr)
+{
+    double const s2 = snr * snr;
+    return s2 / (s2 + SEEING_LIMITED_SNR * SEEING_LIMITED_SNR);
+}
+
+// Called when the guide star was lost while guiding. The secondary stars
+// found in the same frame say where the guide star should be: if it is there
+// it is taken up again, otherwise the best secondary star becomes the guide
+// star and the lock position moves by its offset, so the mount keeps
+// pointing at the same place. Returns true if the frame is still lost.
+bool GuiderMultiStar::RecoverGuideStar(usImage *pImage, FrameDroppedInfo *errorInfo)
+{
+    std::vector<double> xs, ys;
+    int best = -1;
+    for (unsigned int i = 0; i < m_secondaries.size(); i++)
+    {
+        Star& s = m_found[i];
+        if (!s.WasFound())
+            continue;
+        xs.push_back(s.X - m_secondaries[i].offset.X);
+        ys.push_back(s.Y - m_secondaries[i].offset.Y);
+        if (s.GetError() != Star::STAR_SATURATED && (best < 0 || s.SNR > m_found[best].SNR))
+            best = i;
+    }
+
+    if (xs.empty())
+        return true;
+
+    Star::FindMode const mode = pFrame->GetStarFindMode();
+    StarProfile profile;
+
+    // the guide star where the other stars say it is
+    PHD_Point const expected(median(xs), median(ys));
+    Star star(m_star);
+    star.SetXY(expected.X, expected.Y);
+    if (star.Find(pImage, wxMax(m_searchRegion / 2, 3), mode, WantedProfile(&profile)) && !MassChangeRejects(star.Mass))
+    {
+        Debug.Write(wxString::Format("MultiStar: guide star recovered at (%.2f, %.2f) from %u other stars\n",
+            star.X, star.Y, (unsigned int) xs.size()));
+        AcceptStar(pImage, star, profile, errorInfo);
+        return false;
+    }
+
+    if (best < 0)
+        return true;
+
+    star = m_found[best];
+    if (!star.Find(pImage, wxMax(m_searchRegion / 2, 3), mode, WantedProfile(&profile)))
+        return true;
+
+    PHD_Point const offset = m_secondaries[best].offset;
+    PHD_Point const lockPos = LockPosition();
+    if (!lockPos.IsValid() || !IsValidLockPosition(lockPos + offset))
+        return true;
+
+    Debug.Write(wxString::Format("MultiStar: guide star lost, switching to star at (%.2f, %.2f), lock position moves by (%.2f, %.2f)\n",
+        star.X, star.Y, offset.X, offset.Y));
+
+    // the offsets are now from the new guide star, and the old guide star is
+    // looked for where it should be in case it comes back
+    std::vector<SecondaryStar> secondaries;
+    std::vector<Star> found;
+    for (unsigned int i = 0; i < m_secondaries.size(); i++)
+    {
+        if ((int) i == best)
+            continue;
+        SecondaryStar sec(m_secondaries[i]);
+        sec.star = m_found[i];
+        sec.offset = m_secondaries[i].offset - offset;
+        secondaries.push_back(sec);
+        found.push_back(sec.star);
+    }
+    SecondaryStar old;
+    old.star = m_star;
+    old.star.SetXY(expected.X, expected.Y);
+    old.star.SetError(Star::STAR_ERROR);
+    old.offset = PHD_Point(0.0, 0.0) - offset;
+    secondaries.push_back(old);
+    found.push_back(old.star);
+
+    m_secondaries.swap(secondaries);
+    m_found.swap(found);
+
+    ResetMassChecker();
+    SetLockPosition(lockPos + offset);
+    AcceptStar(pImage, star, profile, errorInfo);
+    pFrame->StatusMsg(_("Guide star lost, switched to another star"));
+
+    return false;
+}
+
+void GuiderMultiStar::OnStarFound(usImage *pImage)
+{
+    m_pool->Wait();
+
+    // every star that was found gives an estimate of the guide star position;
+    // index 0 is the guide star itself and index i + 1 is secondary star i
+    std::vector<StarEstimate> est(m_secondaries.size() + 1);
+    std::vector<double> tmp;
+    tmp.reserve(est.size());
+
+    est[0].x = m_star.X;
+    est[0].y = m_star.Y;
+    est[0].weight = StarWeight(m_star.SNR);
+    unsigned int nfound = 1;
+
+    for (unsigned int i = 0; i < m_secondaries.size(); i++)
+    {
+        StarEstimate& e = est[i + 1];
+        if (m_found[i].WasFound())
+        {
+            e.x = m_found[i].X - m_secondaries[i].offset.X;
+            e.y = m_found[i].Y - m_secondaries[i].offset.Y;
+            e.weight = StarWeight(m_found[i].SNR);
+            ++nfound;
+        }
+        else
+            e.weight = 0.0;
+    }
+
+    double cx = m_star.X;
+    double cy = m_star.Y;
+    double thresh = 0.0;
+
+    if (m_multiStarEnabled && nfound >= MIN_STARS_FOR_AVERAGE)
+    {
+        // reject estimates far from the median estimate
+        tmp.clear();
+        for (std::vector<StarEstimate>::const_iterator it = est.begin(); it != est.end(); ++it)
+            if (it->weight > 0.0)
+                tmp.push_back(it->x);
+        double const mx = median(tmp);
+
+        tmp.clear();
+        for (std::vector<StarEstimate>::const_iterator it = est.begin(); it != est.end(); ++it)
+            if (it->weight > 0.0)
+                tmp.push_back(it->y);
+        double const my = median(tmp);
+
+        tmp.clear();
+        for (std::vector<StarEstimate>::iterator it = est.begin(); it != est.end(); ++it)
+        {
+            if (it->weight > 0.0)
+            {
+                it->dist = hypot(it->x - mx, it->y - my);
+                tmp.push_back(it->dist);
+            }
+        }
+        thresh = std::max(OUTLIER_SCALE * median(tmp), OUTLIER_MIN_PX);
+
+        double sx = 0.0, sy = 0.0, sw = 0.0;
+        for (std::vector<StarEstimate>::iterator it = est.begin(); it != est.end(); ++it)
+        {
+            if (it->weight > 0.0 && it->dist > thresh)
+                it->weight = 0.0;
+            if (it->weight > 0.0)
+            {
+                sx += it->weight * it->x;
+                sy += it->weight * it->y;
+                sw += it->weight;
+                ++m_starsUsed;
+            }
+        }
+
+        if (m_starsUsed >= MIN_STARS_FOR_AVERAGE && sw > 0.0)
+        {
+            cx = sx / sw;
+            cy = sy / sw;
+            m_guidePos.SetXY(cx, cy);
+        }
+        else
+            m_starsUsed = 0;
+    }
+
+    // secondary stars that were lost or rejected are looked for next time
+    // where the guide star says they should be, so that they do not wander
+    // off onto a neighbouring star
+    for (unsigned int i = 0; i < m_secondaries.size(); i++)
+    {
+        Star& star = m_secondaries[i].star;
+        star = m_found[i];
+        bool lost;
+        if (m_multiStarEnabled)
+            lost = m_starsUsed == 0 || est[i + 1].weight == 0.0;
+        else
+            lost = est[i + 1].weight == 0.0 || hypot(est[i + 1].x - cx, est[i + 1].y - cy) > m_searchRegion / 2.0;
+        if (lost)
+        {
+            star.SetXY(cx + m_secondaries[i].offset.X, cy + m_secondaries[i].offset.Y);
+            star.SetError(Star::STAR_ERROR);
+        }
+    }
+
+    if (Debug.IsEnabled())
+    {
+        Debug.Write(wxString::Format("MultiStar: found %u of %u stars, used %u, thresh %.2f, star (%.2f, %.2f) guide (%.2f, %.2f)\n",
+            nfound, (unsigned int) est.size(), m_starsUsed, thresh, m_star.X, m_star.Y, cx, cy));
+    }
+}
+
+inline static wxRect SubframeRect(const PHD_Point& pos, int halfwidth)
+{
+    return wxRect(ROUND(pos.X) - halfwidth,
+                  ROUND(pos.Y) - halfwidth,
+                  2 * halfwidth + 1,
+                  2 * halfwidth + 1);
+}
+
+wxRect GuiderMultiStar::GetBoundingBox(void)
+{
+    wxRect box = GuiderOneStar::GetBoundingBox();
+
+    if (box.IsEmpty() || m_secondaries.empty())
+        return box;
+
+    // the subframe must take in the secondary stars too
+    for (std::vector<SecondaryStar>::const_iterator it = m_secondaries.begin(); it != m_secondaries.end(); ++it)
+        box.Union(SubframeRect(it->star, m_searchRegion));
+
+    box.Intersect(wxRect(pCamera->FrameSize()));
+    return box;
+}
+
+void GuiderMultiStar::DrawSelection(GuiderPainter& dc, GUIDER_STATE state)
+{
+    GuiderOneStar::DrawSelection(dc, state);
+
+    if (state < STATE_SELECTED || state > STATE_GUIDING)
+        return;
+
+    for (std::vector<SecondaryStar>::iterator it = m_secondaries.begin(); it != m_secondaries.end(); ++it)
+    {
+        if (it->star.WasFound())
+            dc.SetPen(wxPen(wxColour(0,160,255), 1, wxSOLID));
+        else
+            dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
+
+        double w = ROUND((m_searchRegion * 2 + 1) * m_scaleFactor);
+        dc.DrawRectangle(int((it->star.X - m_searchRegion) * m_scaleFactor), int((it->star.Y - m_searchRegion) * m_scaleFactor), w, w);
+    }
+}
+
+wxString GuiderMultiStar::GetSettingsSummary()
+{
+    wxString s = GuiderOneStar::GetSettingsSummary();
+
+    if (m_multiStarEnabled)
+        s += wxString::Format(_T("Multi-star guiding = enabled, max secondary stars = %u\n"), m_maxStars);
+    else
+        s += _T("Multi-star guiding = disabled\n");
+    s += wxString::Format(_T("Backup stars = %s\n"), m_backupStars ? _T("enabled") : _T("disabled"));
+
+    return s;
+}
+
+GuiderConfigDialogCtrlSet *GuiderMultiStar::GetConfigDialogCtrlSet(wxWindow *pParent, Guider *pGuider, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap)
+{
+    return new GuiderMultiStarConfigDialogCtrlSet(pParent, pGuider, pAdvancedDialog, CtrlMap);
+}
+
+GuiderMultiStarConfigDialogCtrlSet::GuiderMultiStarConfigDialogCtrlSet(wxWindow *pParent, Guider *pGuider, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap)
+    : GuiderOneStarConfigDialogCtrlSet(pParent, pGuider, pAdvancedDialog, CtrlMap)
+{
+    m_pGuiderMultiStar = (GuiderMultiStar *) pGuider;
+    wxWindow *parent = GetParentWindow(AD_szStarTracking);
+
+    wxStaticBoxSizer *pMultiStar = new wxStaticBoxSizer(wxHORIZONTAL, parent, _("Multi-star Guiding"));
+    m_pEnableMultiStar = new wxCheckBox(parent, wxID_ANY, _("Enable"));
+    m_pEnableMultiStar->SetToolTip(_("Check to track additional stars along with the guide star. The guide star "
+        "position is then taken from the average of all the stars that agree with each other, which reduces the effect of seeing."));
+    m_pEnableMultiStar->Bind(wxEVT_COMMAND_CHECKBOX_CLICKED, &GuiderMultiStarConfigDialogCtrlSet::OnMultiStarEnableChecked, this);
+
+    int width = StringWidth(_T("00"));
+    m_pMaxStars = new wxSpinCtrl(parent, wxID_ANY, _T("foo2"), wxPoint(-1, -1),
+        wxSize(width + 30, -1), wxSP_ARROW_KEYS, 1, MAX_MAX_STARS, DEFAULT_MAX_STARS, _T("MaxStars"));
+    wxSizer *pMaxStars = MakeLabeledControl(AD_szStarTracking, _("Additional stars"), m_pMaxStars,
+        wxString::Format(_("Maximum number of stars to track in addition to the guide star. Default = %d"), (int) DEFAULT_MAX_STARS));
+
+    m_pBackupStars = new wxCheckBox(parent, wxID_ANY, _("Backup stars"));
+    m_pBackupStars->SetToolTip(_("Check to keep track of a few stars near the guide star even with multi-star guiding disabled. "
+        "If the guide star is lost while guiding, guiding continues on one of them without a new star selection."));
+
+    pMultiStar->Add(m_pEnableMultiStar, wxSizerFlags(0).Border(wxTOP, 3));
+    pMultiStar->Add(pMaxStars, wxSizerFlags(0).Border(wxLEFT, 40));
+    pMultiStar->Add(m_pBackupStars, wxSizerFlags(0).Border(wxLEFT, 20));
+
+    // add the multi-star settings below the single star tracking settings
+    wxBoxSizer *pTracking = new wxBoxSizer(wxVERTICAL);
+    pTracking->Add(static_cast<wxSizer *>(CtrlMap[AD_szStarTracking].panelCtrl));
+    pTracking->Add(pMultiStar, wxSizerFlags(0).Border(wxTOP, 10));
+
+    AddGroup(CtrlMap, AD_szStarTracking, pTracking);
+}
+
+GuiderMultiStarConfigDialogCtrlSet::~GuiderMultiStarConfigDialogCtrlSet()
+{
+}
+
+void GuiderMultiStarConfigDialogCtrlSet::LoadValues()
+{
+    bool enabled = m_pGuiderMultiStar->GetMultiStarEnabled();
+    m_pEnableMultiStar->SetValue(enabled);
+    m_pMaxStars->Enable(enabled);
+    m_pMaxStars->SetValue(m_pGuiderMultiStar->GetMaxStars());
+    m_pBackupStars->SetValue(m_pGuiderMultiStar->GetBackupStarsEnabled());
+    GuiderOneStarConfigDialogCtrlSet::LoadValues();
+}
+
+void GuiderMultiStarConfigDialogCtrlSet::UnloadValues()
+{
+    m_pGuiderMultiStar->SetMultiStarEnabled(m_pEnableMultiStar->GetValue());
+    m_pGuiderMultiStar->SetMaxStars(m_pMaxStars->GetValue());
+    m_pGuiderMultiStar->SetBackupStarsEnabled(m_pBackupStars->GetValue());
+    GuiderOneStarConfigDialogCtrlSet::UnloadValues();
+}
+
+void GuiderMultiStarConfigDialogCtrlSet::OnMultiStarEnableChecked(wxCommandEvent& event)
+{
+    m_pMaxStars->Enable(event.IsChecked());
+}
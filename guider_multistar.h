@@ -0,0 +1,143 @@
+/*
+ *  guider_multistar.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef GUIDER_MULTISTAR_H_INCLUDED
+#define GUIDER_MULTISTAR_H_INCLUDED
+
+class GuiderMultiStar;
+class StarFindPool;
+
+class GuiderMultiStarConfigDialogCtrlSet : public GuiderOneStarConfigDialogCtrlSet
+{
+    GuiderMultiStar *m_pGuiderMultiStar;
+    wxCheckBox *m_pEnableMultiStar;
+    wxSpinCtrl *m_pMaxStars;
+    wxCheckBox *m_pBackupStars;
+
+    void OnMultiStarEnableChecked(wxCommandEvent& event);
+
+public:
+    GuiderMultiStarConfigDialogCtrlSet(wxWindow *pParent, Guider *pGuider, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
+    virtual ~GuiderMultiStarConfigDialogCtrlSet();
+
+    virtual void LoadValues(void);
+    virtual void UnloadValues(void);
+};
+
+/*
+ * GuiderMultiStar tracks the guide star selected by GuiderOneStar plus up to
+ * GetMaxStars() secondary stars picked from the AutoFind candidates. Each
+ * secondary star is remembered by its offset from the guide star at selection
+ * time, so every star that is found gives an estimate of where the guide star
+ * is. Estimates that disagree with the median are rejected and the rest are
+ * averaged to give the position reported by CurrentPosition().
+ *
+ * The secondary stars are located on a pool of worker threads while the
+ * guide star is located on the calling thread. With multi-star guiding
+ * disabled, or when too few secondary stars are found, the guide star
+ * position is that of GuiderOneStar.
+ *
+ * When the guide star is lost while guiding, the secondary stars found in
+ * the same frame are used to take it up again or to switch to one of them,
+ * see RecoverGuideStar. With multi-star guiding disabled a few nearby
+ * stars are still tracked as backups for this.
+ */
+class GuiderMultiStar : public GuiderOneStar
+{
+    struct SecondaryStar
+    {
+        Star star;
+        PHD_Point offset; // offset from the guide star at selection time
+    };
+
+    std::vector<SecondaryStar> m_secondaries;
+    std::vector<Star> m_found;      // working copies of the secondary stars for the finder threads
+    PHD_Point m_guidePos;           // combined position, invalid when not available
+    unsigned int m_starsUsed;
+    StarFindPool *m_pool;
+
+    // parameters
+    bool m_multiStarEnabled;
+    bool m_backupStars;
+    unsigned int m_maxStars;
+
+    void SelectSecondaryStars(const usImage *pImage);
+    void ClearSecondaryStars(void);
+    bool RecoverGuideStar(usImage *pImage, FrameDroppedInfo *errorInfo);
+
+public:
+    GuiderMultiStar(wxWindow *parent);
+    virtual ~GuiderMultiStar(void);
+
+    bool GetMultiStarEnabled(void) const;
+    void SetMultiStarEnabled(bool enable);
+    bool GetBackupStarsEnabled(void) const { return m_backupStars; }
+    void SetBackupStarsEnabled(bool enable);
+    unsigned int GetMaxStars(void) const;
+    bool SetMaxStars(int maxStars);
+    unsigned int StarsUsed(void) const;
+
+    bool AutoSelect(void);
+    bool SelectAutoFoundStar(const PHD_Point& pos);
+    const PHD_Point& CurrentPosition(void);
+    wxRect GetBoundingBox(void);
+    wxString GetSettingsSummary();
+
+    GuiderConfigDialogCtrlSet *GetConfigDialogCtrlSet(wxWindow *pParent, Guider *pGuider, AdvancedDialog *pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
+
+    void LoadProfileSettings(void);
+
+protected:
+    void InvalidateCurrentPosition(bool fullReset = false);
+    bool UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo);
+    bool SetCurrentPosition(usImage *pImage, const PHD_Point& position);
+    void OnStarFound(usImage *pImage);
+    void DrawSelection(GuiderPainter& dc, GUIDER_STATE state);
+};
+
+inline bool GuiderMultiStar::GetMultiStarEnabled(void) const
+{
+    return m_multiStarEnabled;
+}
+
+inline unsigned int GuiderMultiStar::GetMaxStars(void) const
+{
+    return m_maxStars;
+}
+
+inline unsigned int GuiderMultiStar::StarsUsed(void) const
+{
+    return m_starsUsed;
+}
+
+#endif /* GUIDER_MULTISTAR_H_INCLUDED */
@@ -48,33 +48,18 @@ class MassChecker
 {
     enum { DefaultTimeWindowMs = 15000 };
 
-    struct Entry
-    {
-        wxLongLong_t time;
-        double mass;
-    };
-
-    std::deque<Entry> m_data;
+    sliding_median<double> m_data;      // keyed by time, ms
     unsigned long m_timeWindow;
-    double *m_tmp;
-    size_t m_tmpSize;
     int m_lastExposure;
 
 public:
 
     MassChecker()
-        : m_tmp(0),
-          m_tmpSize(0),
-          m_lastExposure(0)
+        : m_lastExposure(0)
     {
         SetTimeWindow(DefaultTimeWindowMs);
     }
 
-    ~MassChecker()
-    {
-        delete[] m_tmp;
-    }
-
     void SetTimeWindow(unsigned int milliseconds)
     {
         // an abrupt change in mass will affect the median after approx m_timeWindow/2
@@ -93,15 +78,9 @@ public:
     void AppendData(double mass)
     {
         wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
-        wxLongLong_t oldest = now - m_timeWindow;
 
-        while (m_data.size() > 0 && m_data.front().time < oldest)
-            m_data.pop_front();
-
-        Entry entry;
-        entry.time = now;
-        entry.mass = mass;
-        m_data.push_back(entry);
+        m_data.expire(now - m_timeWindow);
+        m_data.push(now, mass);
     }
 
     bool CheckMass(double mass, double threshold, double limits[3])
@@ -109,22 +88,7 @@ public:
         if (m_data.size() < 3)
             return false;
 
-        if (m_tmpSize < m_data.size())
-        {
-            delete[] m_tmp;
-            m_tmpSize = m_data.size() + 10;
-            m_tmp = new double[m_tmpSize];
-        }
-
-        std::deque<Entry>::const_iterator it = m_data.begin();
-        std::deque<Entry>::const_iterator end = m_data.end();
-        double *p = &m_tmp[0];
-        for (; it != end; ++it)
-            *p++ = it->mass;
-
-        size_t mid = m_data.size() / 2;
-        std::nth_element(&m_tmp[0], &m_tmp[mid], &m_tmp[m_data.size()]);
-        double med = m_tmp[mid];
+        double med = m_data.median(0.0);
 
         limits[0] = med * (1. - threshold);
         limits[1] = med;
@@ -155,7 +119,10 @@ END_EVENT_TABLE()
 // Define a constructor for the guide canvas
 GuiderOneStar::GuiderOneStar(wxWindow *parent)
     : Guider(parent, XWinSize, YWinSize),
-      m_massChecker(new MassChecker())
+      m_massChecker(new MassChecker()),
+      m_predictedSearch(true),
+      m_predictionError(-1.0),
+      m_temporalBackground(false)
 {
     SetState(STATE_UNINITIALIZED);
 }
@@ -178,6 +145,23 @@ void GuiderOneStar::LoadProfileSettings(void)
 
     int searchRegion = pConfig->Profile.GetInt("/guider/onestar/SearchRegion", DEFAULT_SEARCH_REGION);
     SetSearchRegion(searchRegion);
+
+    SetPredictedSearch(pConfig->Profile.GetBoolean("/guider/onestar/PredictedSearch", true));
+    SetTemporalBackground(pConfig->Profile.GetBoolean("/guider/onestar/TemporalBackground", false));
+}
+
+void GuiderOneStar::SetPredictedSearch(bool enable)
+{
+    m_predictedSearch = enable;
+    m_predictionError = -1.0;
+    pConfig->Profile.SetBoolean("/guider/onestar/PredictedSearch", enable);
+}
+
+void GuiderOneStar::SetTemporalBackground(bool enable)
+{
+    m_temporalBackground = enable;
+    m_background.Reset();
+    pConfig->Profile.SetBoolean("/guider/onestar/TemporalBackground", enable);
 }
 
 bool GuiderOneStar::GetMassChangeThresholdEnabled(void)
@@ -278,7 +262,8 @@ bool GuiderOneStar::SetCurrentPosition(usImage *pImage, const PHD_Point& positio
         }
 
         m_massChecker->Reset();
-        bError = !m_star.Find(pImage, m_searchRegion, x, y, pFrame->GetStarFindMode());
+        m_background.Reset();
+        bError = !m_star.Find(pImage, m_searchRegion, x, y, pFrame->GetStarFindMode(), WantedProfile(&m_profile));
     }
     catch (const wxString& Msg)
     {
@@ -333,7 +318,7 @@ static void SaveAutoSelectFailedImg(usImage *pImage)
 
     Debug.AddLine("GuiderOneStar::AutoSelect failed. Saving image to " + filename);
 
-    pImage->Save(wxFileName(Debug.GetLogDir(), filename).GetFullPath());
+    FitsWrite.Save(*pImage, wxFileName(Debug.GetLogDir(), filename).GetFullPath(), wxEmptyString, false, FITS_NOTIFY_NONE);
 }
 
 static wxString StarStatusStr(const Star& star)
@@ -387,25 +372,53 @@ bool GuiderOneStar::AutoSelect(void)
             throw ERROR_INFO("No Current Image");
         }
 
-        // If mount is not calibrated, we need to chose a star a bit farther
-        // from the egde to allow for the motion of the star during
-        // calibration
-        //
-        int edgeAllowance = 0;
-        if (pMount && pMount->IsConnected() && !pMount->IsCalibrated())
-            edgeAllowance = wxMax(edgeAllowance, pMount->CalibrationTotDistance());
-        if (pSecondaryMount && pSecondaryMount->IsConnected() && !pSecondaryMount->IsCalibrated())
-            edgeAllowance = wxMax(edgeAllowance, pSecondaryMount->CalibrationTotDistance());
+        // the search covers the whole frame
+        WorkerThread::CompleteLazyROI(*pImage);
+
+        // here rather than in AutoFind, which also runs on worker threads
+        wxBusyCursor busy;
 
         Star newStar;
-        if (!newStar.AutoFind(*pImage, edgeAllowance, m_searchRegion))
+        if (!newStar.AutoFind(*pImage, AutoFindEdgeAllowance(), m_searchRegion))
         {
             throw ERROR_INFO("Unable to AutoFind");
         }
 
+        if (SelectAutoFoundStar(newStar))
+        {
+            throw ERROR_INFO("Unable to select star");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        if (pImage && pImage->ImageData)
+        {
+            SaveAutoSelectFailedImg(pImage);
+        }
+
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool GuiderOneStar::SelectAutoFoundStar(const PHD_Point& pos)
+{
+    bool bError = false;
+
+    usImage *pImage = CurrentImage();
+
+    try
+    {
+        if (!pImage || !pImage->ImageData)
+        {
+            throw ERROR_INFO("No Current Image");
+        }
+
         m_massChecker->Reset();
 
-        if (!m_star.Find(pImage, m_searchRegion, newStar.X, newStar.Y, Star::FIND_CENTROID))
+        if (!m_star.Find(pImage, m_searchRegion, pos.X, pos.Y, Star::FIND_CENTROID, WantedProfile(&m_profile)))
         {
             throw ERROR_INFO("Unable to find");
         }
@@ -428,15 +441,10 @@ bool GuiderOneStar::AutoSelect(void)
         UpdateImageDisplay();
         pFrame->StatusMsg(wxString::Format(_("Auto-selected star at (%.1f, %.1f)"), m_star.X, m_star.Y));
         pFrame->UpdateStarInfo(m_star.SNR, m_star.GetError() == Star::STAR_SATURATED);
-        pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
+        pFrame->pProfile->UpdateData(m_profile);
     }
     catch (const wxString& Msg)
     {
-        if (pImage && pImage->ImageData)
-        {
-            SaveAutoSelectFailedImg(pImage);
-        }
-
         POSSIBLY_UNUSED(Msg);
         bError = true;
     }
@@ -501,7 +509,7 @@ wxRect GuiderOneStar::GetBoundingBox(void)
     if (subframe)
     {
         wxRect box(SubframeRect(pos, m_searchRegion + SUBFRAME_BOUNDARY_PX));
-        box.Intersect(wxRect(0, 0, pCamera->FullSize.x, pCamera->FullSize.y));
+        box.Intersect(wxRect(pCamera->FrameSize()));
         return box;
     }
     else
@@ -543,11 +551,70 @@ int GuiderOneStar::StarError(void)
 void GuiderOneStar::InvalidateCurrentPosition(bool fullReset)
 {
     m_star.Invalidate();
+    m_predictionError = -1.0;
 
     if (fullReset)
     {
         m_star.X = m_star.Y = 0.0;
+        m_background.Reset();
+    }
+}
+
+// While guiding, the star is first looked for around where the guide moves
+// since the last frame should have taken it, in a region sized from how
+// far off the recent predictions were. If it is not there the full search
+// region is tried around the prediction, then around the last position.
+bool GuiderOneStar::FindGuideStar(usImage *pImage, Star& star, StarProfile *profile)
+{
+    Star::FindMode const mode = pFrame->GetStarFindMode();
+
+    // bring the background model up to date with this frame first, leaving
+    // out the star where it is expected to be
+    const StarBackground *background = 0;
+    if (m_temporalBackground)
+    {
+        if (m_star.IsValid())
+        {
+            PHD_Point expected(m_star);
+            if (m_predictedSearch && m_predictedShift.IsValid())
+                expected += m_predictedShift;
+            m_background.Update(pImage, expected, m_searchRegion);
+        }
+        background = &m_background;
+    }
+
+    if (!m_predictedSearch || !m_predictedShift.IsValid() || !m_star.IsValid())
+        return star.Find(pImage, m_searchRegion, mode, profile, background);
+
+    // margin for the star's own motion, seeing and centroid noise
+    enum { PREDICTION_MARGIN = 4 };
+
+    PHD_Point const predicted(m_star.X + m_predictedShift.X, m_star.Y + m_predictedShift.Y);
+    double const err = m_predictionError >= 0.0 ? m_predictionError : m_searchRegion / 3.0;
+    int const narrow = wxMax((int) MIN_SEARCH_REGION, wxMin(m_searchRegion, ROUND(3.0 * err) + PREDICTION_MARGIN));
+
+    int regions[2] = { narrow, m_searchRegion };
+    for (int i = 0; i < 2; i++)
+    {
+        if (i > 0 && regions[i] == regions[i - 1])
+            continue;
+        Star s(m_star);
+        s.X = predicted.X;
+        s.Y = predicted.Y;
+        if (s.Find(pImage, regions[i], mode, profile, background))
+        {
+            double const dist = s.Distance(predicted);
+            m_predictionError = m_predictionError >= 0.0 ? m_predictionError + 0.2 * (dist - m_predictionError) : dist;
+            DEBUG_LOG(DBGLOG_GUIDER, DBGLOG_VERBOSE, "Star found %.2f px from the predicted position, search region %d\n", dist, regions[i]);
+            star = s;
+            return true;
+        }
     }
+
+    Debug.Write(wxString::Format("Star not found around the predicted position (%.1f,%.1f), searching around the last position\n",
+        predicted.X, predicted.Y));
+    m_predictionError = -1.0;
+    return star.Find(pImage, m_searchRegion, mode, profile, background);
 }
 
 bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo)
@@ -567,8 +634,9 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
     try
     {
         Star newStar(m_star);
+        StarProfile profile;
 
-        if (!newStar.Find(pImage, m_searchRegion, pFrame->GetStarFindMode()))
+        if (!FindGuideStar(pImage, newStar, WantedProfile(&profile)))
         {
             errorInfo->starError = newStar.GetError();
             errorInfo->starMass = 0.0;
@@ -597,22 +665,7 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
             throw THROW_INFO("massChangeThreshold error");
         }
 
-        // update the star position, mass, etc.
-        m_star = newStar;
-        m_massChecker->AppendData(newStar.Mass);
-
-        const PHD_Point& lockPos = LockPosition();
-        if (lockPos.IsValid())
-        {
-            double distance = newStar.Distance(lockPos);
-            UpdateCurrentDistance(distance);
-        }
-
-        pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
-
-        pFrame->AdjustAutoExposure(m_star.SNR);
-        pFrame->UpdateStarInfo(m_star.SNR, m_star.GetError() == Star::STAR_SATURATED);
-        errorInfo->status = StarStatus(m_star);
+        AcceptStar(pImage, newStar, profile, errorInfo);
     }
     catch (const wxString& Msg)
     {
@@ -624,6 +677,47 @@ bool GuiderOneStar::UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *err
     return bError;
 }
 
+// make newStar the guide star for this frame
+void GuiderOneStar::AcceptStar(usImage *pImage, const Star& newStar, const StarProfile& profile, FrameDroppedInfo *errorInfo)
+{
+    // update the star position, mass, etc.
+    m_star = newStar;
+    m_profile = profile;
+    m_massChecker->AppendData(newStar.Mass);
+
+    OnStarFound(pImage);
+
+    const PHD_Point& lockPos = LockPosition();
+    PHD_Point offset;
+    if (lockPos.IsValid())
+    {
+        double distance = CurrentPosition().Distance(lockPos);
+        UpdateCurrentDistance(distance);
+        if (IsGuiding())
+            offset = CurrentPosition() - lockPos;
+    }
+
+    pFrame->pProfile->UpdateData(m_profile);
+
+    pFrame->AdjustAutoExposure(m_star.SNR, m_star.HFD, offset);
+    pFrame->AdjustCalibrationExposure(m_star.SNR);
+    pFrame->UpdateStarInfo(m_star.SNR, m_star.GetError() == Star::STAR_SATURATED);
+    errorInfo->status = StarStatus(m_star);
+}
+
+// true if the star mass change check is enabled and would reject a star of
+// the given mass
+bool GuiderOneStar::MassChangeRejects(double mass)
+{
+    double limits[3];
+    return m_massChangeThresholdEnabled && m_massChecker->CheckMass(mass, m_massChangeThreshold, limits);
+}
+
+void GuiderOneStar::ResetMassChecker(void)
+{
+    m_massChecker->Reset();
+}
+
 bool GuiderOneStar::IsValidLockPosition(const PHD_Point& pt)
 {
     const usImage *pImage = CurrentImage();
@@ -698,7 +792,7 @@ void GuiderOneStar::OnLClick(wxMouseEvent &mevent)
                 EvtServer.NotifyStarSelected(CurrentPosition());
                 SetState(STATE_SELECTED);
                 pFrame->UpdateButtonsStatus();
-                pFrame->pProfile->UpdateData(pImage, m_star.X, m_star.Y);
+                pFrame->pProfile->UpdateData(m_profile);
             }
 
             Refresh();
@@ -711,13 +805,46 @@ void GuiderOneStar::OnLClick(wxMouseEvent &mevent)
     }
 }
 
-inline static void DrawBox(wxDC& dc, const PHD_Point& star, int halfW, double scale)
+StarProfile *GuiderOneStar::WantedProfile(StarProfile *profile) const
+{
+    return pFrame && pFrame->pProfile && pFrame->pProfile->IsActive() ? profile : 0;
+}
+
+inline static void DrawBox(GuiderPainter& dc, const PHD_Point& star, int halfW, double scale)
 {
-    dc.SetBrush(*wxTRANSPARENT_BRUSH);
     double w = ROUND((halfW * 2 + 1) * scale);
     dc.DrawRectangle(int((star.X - halfW) * scale), int((star.Y - halfW) * scale), w, w);
 }
 
+void GuiderOneStar::DrawSelection(GuiderPainter& dc, GUIDER_STATE state)
+{
+    bool FoundStar = m_star.WasFound();
+
+    if (state == STATE_SELECTED)
+    {
+        if (FoundStar)
+            dc.SetPen(wxPen(wxColour(100,255,90), 1, wxSOLID));  // Draw the box around the star
+        else
+            dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
+        DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
+    }
+    else if (state == STATE_CALIBRATING_PRIMARY || state == STATE_CALIBRATING_SECONDARY)
+    {
+        // in the calibration process
+        dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
+        DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
+    }
+    else if (state == STATE_CALIBRATED || state == STATE_GUIDING)
+    {
+        // locked and guiding
+        if (FoundStar)
+            dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
+        else
+            dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
+        DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
+    }
+}
+
 // Define the repainting behaviour
 void GuiderOneStar::OnPaint(wxPaintEvent& event)
 {
@@ -726,96 +853,15 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
 
     try
     {
+        // the OpenGL view covers the window and draws everything itself
+        if (IsGLView())
+            return;
+
+        // PaintHelper draws the image and the overlays, see DrawOverlays
         if (PaintHelper(dc, memDC))
         {
             throw ERROR_INFO("PaintHelper failed");
         }
-        // PaintHelper drew the image and any overlays
-        // now decorate the image to show the selection
-
-        // display bookmarks
-        if (m_showBookmarks && m_bookmarks.size() > 0)
-        {
-            dc.SetPen(wxPen(wxColour(0,255,255),1,wxSOLID));
-            dc.SetBrush(*wxTRANSPARENT_BRUSH);
-
-            for (std::vector<wxRealPoint>::const_iterator it = m_bookmarks.begin();
-                 it != m_bookmarks.end(); ++it)
-            {
-                wxPoint p((int)(it->x * m_scaleFactor), (int)(it->y * m_scaleFactor));
-                dc.DrawCircle(p, 3);
-                dc.DrawCircle(p, 6);
-                dc.DrawCircle(p, 12);
-            }
-        }
-
-        GUIDER_STATE state = GetState();
-        bool FoundStar = m_star.WasFound();
-
-        if (state == STATE_SELECTED)
-        {
-            if (FoundStar)
-                dc.SetPen(wxPen(wxColour(100,255,90), 1, wxSOLID));  // Draw the box around the star
-            else
-                dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
-        }
-        else if (state == STATE_CALIBRATING_PRIMARY || state == STATE_CALIBRATING_SECONDARY)
-        {
-            // in the calibration process
-            dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
-        }
-        else if (state == STATE_CALIBRATED || state == STATE_GUIDING)
-        {
-            // locked and guiding
-            if (FoundStar)
-                dc.SetPen(wxPen(wxColour(32,196,32), 1, wxSOLID));  // Draw the box around the star
-            else
-                dc.SetPen(wxPen(wxColour(230,130,30), 1, wxDOT));
-            DrawBox(dc, m_star, m_searchRegion, m_scaleFactor);
-        }
-
-        // Image logging
-        if (state >= STATE_SELECTED && pFrame->IsImageLoggingEnabled() && pFrame->m_frameCounter != pFrame->m_loggedImageFrame)
-        {
-            // only log each image frame once
-            pFrame->m_loggedImageFrame = pFrame->m_frameCounter;
-
-            if (pFrame->GetLoggedImageFormat() == LIF_RAW_FITS) // Save star image as a FITS
-            {
-                SaveStarFITS();
-            }
-            else  // Save star image as a JPEG
-            {
-                double LockX = LockPosition().X;
-                double LockY = LockPosition().Y;
-
-                wxBitmap SubBmp(60,60,-1);
-                wxMemoryDC tmpMdc;
-                tmpMdc.SelectObject(SubBmp);
-                memDC.SetPen(wxPen(wxColor(0,255,0),1,wxDOT));
-                memDC.DrawLine(0, LockY * m_scaleFactor, XWinSize, LockY * m_scaleFactor);
-                memDC.DrawLine(LockX * m_scaleFactor, 0, LockX * m_scaleFactor, YWinSize);
-    #ifdef __APPLEX__
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X*m_scaleFactor)-30,Displayed_Image->GetHeight() - ROUND(m_star.Y*m_scaleFactor)-30,wxCOPY,false);
-    #else
-                tmpMdc.Blit(0,0,60,60,&memDC,ROUND(m_star.X * m_scaleFactor) - 30,ROUND(m_star.Y * m_scaleFactor) - 30,wxCOPY,false);
-    #endif
-                //          tmpMdc.Blit(0,0,200,200,&Cdc,0,0,wxCOPY);
-
-                wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".jpg";
-                wxImage subImg = SubBmp.ConvertToImage();
-                // subImg.Rescale(120, 120);  zoom up (not now)
-                if (pFrame->GetLoggedImageFormat() == LIF_HI_Q_JPEG)
-                {
-                    // set high(ish) JPEG quality
-                    subImg.SetOption(wxIMAGE_OPTION_QUALITY, 100);
-                }
-                subImg.SaveFile(fname, wxBITMAP_TYPE_JPEG);
-                tmpMdc.SelectObject(wxNullBitmap);
-            }
-        }
     }
     catch (const wxString& Msg)
     {
@@ -823,84 +869,30 @@ void GuiderOneStar::OnPaint(wxPaintEvent& event)
     }
 }
 
-void GuiderOneStar::SaveStarFITS()
+void GuiderOneStar::DrawOverlays(GuiderPainter& dc, const wxSize& displaySize)
 {
-    double StarX = m_star.X;
-    double StarY = m_star.Y;
-    usImage *pImage = CurrentImage();
-    usImage tmpimg;
-
-    tmpimg.Init(60,60);
-    int start_x = ROUND(StarX)-30;
-    int start_y = ROUND(StarY)-30;
-    if ((start_x + 60) > pImage->Size.GetWidth())
-        start_x = pImage->Size.GetWidth() - 60;
-    if ((start_y + 60) > pImage->Size.GetHeight())
-        start_y = pImage->Size.GetHeight() - 60;
-    int x,y, width;
-    width = pImage->Size.GetWidth();
-    unsigned short *usptr = tmpimg.ImageData;
-    for (y=0; y<60; y++)
-        for (x=0; x<60; x++, usptr++)
-            *usptr = *(pImage->ImageData + (y+start_y)*width + (x+start_x));
-
-    wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + wxDateTime::Now().Format(_T("_%j_%H%M%S")) + ".fit";
-
-    fitsfile *fptr;  // FITS file pointer
-    int status = 0;  // CFITSIO status value MUST be initialized to zero!
-    long fpixel[3] = {1,1,1};
-    long fsize[3];
-    char keyname[9]; // was 9
-    char keycomment[100];
-    char keystring[100];
-    int output_format=USHORT_IMG;
-
-    fsize[0] = 60;
-    fsize[1] = 60;
-    fsize[2] = 0;
-    PHD_fits_create_file(&fptr, fname, false, &status);
-    if (!status)
-    {
-        fits_create_img(fptr,output_format, 2, fsize, &status);
-
-        time_t now = wxDateTime::GetTimeNow();
-        struct tm *timestruct = gmtime(&now);
-        sprintf(keyname,"DATE");
-        sprintf(keycomment,"UTC date that FITS file was created");
-        sprintf(keystring,"%.4d-%.2d-%.2d %.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"DATE-OBS");
-        sprintf(keycomment,"YYYY-MM-DDThh:mm:ss observation start, UT");
-        sprintf(keystring,"%s", (const char *) pImage->GetImgStartTime().c_str());
-        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
-
-        sprintf(keyname,"EXPOSURE");
-        sprintf(keycomment,"Exposure time [s]");
-        float dur = (float) pImage->ImgExpDur / 1000.0;
-        if (!status) fits_write_key(fptr, TFLOAT, keyname, &dur, keycomment, &status);
-
-        unsigned int tmp = 1;
-        sprintf(keyname,"XBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YBINNING");
-        sprintf(keycomment,"Camera binning mode");
-        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
-
-        sprintf(keyname,"XORGSUB");
-        sprintf(keycomment,"Subframe x position in binned pixels");
-        tmp = start_x;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-        sprintf(keyname,"YORGSUB");
-        sprintf(keycomment,"Subframe y position in binned pixels");
-        tmp = start_y;
-        fits_write_key(fptr, TINT, keyname, &tmp, keycomment, &status);
-
-        if (!status) fits_write_pix(fptr,TUSHORT,fpixel,tmpimg.NPixels,tmpimg.ImageData,&status);
-
-    }
-    PHD_fits_close_file(fptr);
+    Guider::DrawOverlays(dc, displaySize);
+
+    // now decorate the image to show the selection
+
+    // display bookmarks
+    if (m_showBookmarks && m_bookmarks.size() > 0)
+    {
+        dc.SetPen(wxPen(wxColour(0,255,255),1,wxSOLID));
+
+        for (std::vector<wxRealPoint>::const_iterator it = m_bookmarks.begin();
+             it != m_bookmarks.end(); ++it)
+        {
+            wxPoint p((int)(it->x * m_scaleFactor), (int)(it->y * m_scaleFactor));
+            dc.DrawCircle(p.x, p.y, 3);
+            dc.DrawCircle(p.x, p.y, 6);
+            dc.DrawCircle(p.x, p.y, 12);
+        }
+    }
+
+    GUIDER_STATE state = GetState();
+
+    DrawSelection(dc, state);
 }
 
 wxString GuiderOneStar::GetSettingsSummary()
@@ -63,13 +63,18 @@ public:
 
 class GuiderOneStar : public Guider
 {
-private:
+protected:
     Star m_star;
+    StarProfile m_profile;      // profile of m_star while the profile window is shown
     MassChecker *m_massChecker;
 
     // parameters
     bool m_massChangeThresholdEnabled;
     double m_massChangeThreshold;
+    bool m_predictedSearch;         // search around the position predicted from the guide moves first
+    double m_predictionError;       // running average distance of the star from its predicted position, px
+    bool m_temporalBackground;      // judge the star against a background model kept over the frames
+    StarBackground m_background;
 
 public:
     class GuiderOneStarConfigDialogPane : public GuiderConfigDialogPane
@@ -90,6 +95,10 @@ public:
     double GetMassChangeThreshold(void);
     bool SetMassChangeThreshold(double starMassChangeThreshold);
     bool SetSearchRegion(int searchRegion);
+    bool GetPredictedSearch(void) const { return m_predictedSearch; }
+    void SetPredictedSearch(bool enable);
+    bool GetTemporalBackground(void) const { return m_temporalBackground; }
+    void SetTemporalBackground(bool enable);
 
     friend class GuiderOneStarConfigDialogPane;
     friend class GuiderOneStarConfigDialogCtrlSet;
@@ -102,6 +111,7 @@ public:
 
     bool IsLocked(void);
     bool AutoSelect(void);
+    bool SelectAutoFoundStar(const PHD_Point& pos);
     const PHD_Point& CurrentPosition(void);
     wxRect GetBoundingBox(void);
     int GetMaxMovePixels(void);
@@ -117,15 +127,29 @@ public:
 
     void LoadProfileSettings(void);
 
-private:
+protected:
     bool IsValidLockPosition(const PHD_Point& pt);
     void InvalidateCurrentPosition(bool fullReset = false);
     bool UpdateCurrentPosition(usImage *pImage, FrameDroppedInfo *errorInfo);
     bool SetCurrentPosition(usImage *pImage, const PHD_Point& position);
+    bool FindGuideStar(usImage *pImage, Star& star, StarProfile *profile);
+    void AcceptStar(usImage *pImage, const Star& newStar, const StarProfile& profile, FrameDroppedInfo *errorInfo);
+    bool MassChangeRejects(double mass);
+    void ResetMassChecker(void);
+
+    // called by UpdateCurrentPosition after the guide star has been found
+    // and accepted, before the guide star distance is updated
+    virtual void OnStarFound(usImage *pImage) { }
+    void DrawOverlays(GuiderPainter& dc, const wxSize& displaySize);
+    // draw the selection boxes for the current guider state
+    virtual void DrawSelection(GuiderPainter& dc, GUIDER_STATE state);
+    // where Star::Find puts the profile of the guide star, NULL if the
+    // profile window is not shown
+    StarProfile *WantedProfile(StarProfile *profile) const;
 
+private:
     void OnLClick(wxMouseEvent& evt);
 
-    void SaveStarFITS();
 
     DECLARE_EVENT_TABLE()
 };
@@ -0,0 +1,73 @@
+/*
+ *  guider_painter.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDER_PAINTER_INCLUDED
+#define GUIDER_PAINTER_INCLUDED
+
+// The drawing operations used by the guider overlays (lock position, star
+// boxes, bookmarks, grids ...), so the same overlay code can draw on a wxDC
+// or in the OpenGL image view. Shapes are drawn in outline only.
+class GuiderPainter
+{
+public:
+    virtual ~GuiderPainter() { }
+
+    virtual void SetPen(const wxPen& pen) = 0;
+    virtual void SetTextForeground(const wxColour& colour) = 0;
+    virtual void DrawLine(double x1, double y1, double x2, double y2) = 0;
+    virtual void DrawLines(int n, const wxPoint points[]) = 0;
+    virtual void DrawCircle(double x, double y, double radius) = 0;
+    virtual void DrawRectangle(double x, double y, double width, double height) = 0;
+    virtual void DrawPoint(double x, double y) = 0;
+    virtual void DrawText(const wxString& text, int x, int y) = 0;
+};
+
+class GuiderDCPainter : public GuiderPainter
+{
+    wxDC& m_dc;
+
+public:
+    GuiderDCPainter(wxDC& dc) : m_dc(dc) { m_dc.SetBrush(*wxTRANSPARENT_BRUSH); }
+
+    void SetPen(const wxPen& pen) { m_dc.SetPen(pen); }
+    void SetTextForeground(const wxColour& colour) { m_dc.SetTextForeground(colour); }
+    void DrawLine(double x1, double y1, double x2, double y2) { m_dc.DrawLine((int) x1, (int) y1, (int) x2, (int) y2); }
+    void DrawLines(int n, const wxPoint points[]) { m_dc.DrawLines(n, points); }
+    void DrawCircle(double x, double y, double radius) { m_dc.DrawCircle((int) x, (int) y, (int) radius); }
+    void DrawRectangle(double x, double y, double width, double height) { m_dc.DrawRectangle((int) x, (int) y, (int) width, (int) height); }
+    void DrawPoint(double x, double y) { m_dc.DrawPoint((int) x, (int) y); }
+    void DrawText(const wxString& text, int x, int y) { m_dc.DrawText(text, x, y); }
+};
+
+#endif
@@ -38,5 +38,6 @@
 
 #include "guider.h"
 #include "guider_onestar.h"
+#include "guider_multistar.h"
 
 #endif /* GUIDERS_H_INCLUDED */
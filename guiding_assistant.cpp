@@ -36,79 +36,276 @@
 #include "guiding_assistant.h"
 #include "backlash_comp.h"
 
-struct Stats
+#include <algorithm>
+
+void GuideAxisStats::InitStats(double hpfCutoffPeriod, double lpfCutoffPeriod, double samplePeriod)
+{
+    alpha_hp = hpfCutoffPeriod / (hpfCutoffPeriod + wxMax(1.0, samplePeriod));
+    alpha_lp = 1.0 - (lpfCutoffPeriod / (lpfCutoffPeriod + wxMax(1.0, samplePeriod)));
+    Reset();
+}
+
+void GuideAxisStats::Reset()
 {
-    double alpha_lp;
-    double alpha_hp;
-    unsigned int n;
-    double sum;
-    double a;
-    double q;
-    double hpf;
-    double lpf;
-    double xprev;
-    double peakRawDx;
-
-    void InitStats(double hpfCutoffPeriod, double lpfCutoffPeriod, double samplePeriod)
+    n = 0;
+    sum = 0.0;
+    a = 0.0;
+    q = 0.0;
+    peakRawDx = 0.0;
+}
+
+void GuideAxisStats::AddSample(double x)
+{
+    if (n == 0)
     {
-        alpha_hp = hpfCutoffPeriod / (hpfCutoffPeriod + wxMax(1.0, samplePeriod));
-        alpha_lp = 1.0 - (lpfCutoffPeriod / (lpfCutoffPeriod + wxMax(1.0, samplePeriod)));
-        Reset();
+        // first point
+        hpf = lpf = x;
+    }
+    else
+    {
+        hpf = alpha_hp * (hpf + x - xprev);
+        lpf += alpha_lp * (x - lpf);
     }
 
-    void Reset()
+    if (n >= 1)
     {
-        n = 0;
-        sum = 0.0;
-        a = 0.0;
-        q = 0.0;
-        peakRawDx = 0.0;
+        double const dx = fabs(x - xprev);
+        if (dx > peakRawDx)
+            peakRawDx = dx;
     }
 
-    void AddSample(double x)
+    xprev = x;
+
+    x = hpf;
+    ++n;
+    sum += x;
+    double const k = (double) n;
+    double const a0 = a;
+    a += (x - a) / k;
+    q += (x - a0) * (x - a);
+}
+
+void GuideAxisStats::GetMeanAndStdev(double *mean, double *stdev) const
+{
+    if (n == 0)
     {
-        if (n == 0)
-        {
-            // first point
-            hpf = lpf = x;
-        }
-        else
-        {
-            hpf = alpha_hp * (hpf + x - xprev);
-            lpf += alpha_lp * (x - lpf);
-        }
+        *mean = *stdev = 0.0;
+        return;
+    }
 
-        if (n >= 1)
-        {
-            double const dx = fabs(x - xprev);
-            if (dx > peakRawDx)
-                peakRawDx = dx;
-        }
+    double const nn = (double) n;
+    *mean = sum / nn;
+    *stdev = sqrt(q / nn);
+}
+
+void GuideAxisSpectrum::Init(double minPeriod, double maxPeriod)
+{
+    for (int i = 0; i < BINS; i++)
+        period[i] = minPeriod * pow(maxPeriod / minPeriod, (double) i / (BINS - 1));
+    Reset();
+}
+
+void GuideAxisSpectrum::Reset()
+{
+    n = 0;
+    for (int i = 0; i < BINS; i++)
+        re[i] = im[i] = cre[i] = cim[i] = span[i] = 0.0;
+}
+
+void GuideAxisSpectrum::AddSample(double t, double x)
+{
+    if (n++ == 0)
+    {
+        t0 = tprev = t;
+        x0 = xprev = x;
+        return;
+    }
 
+    double const dt = t - tprev;
+    if (dt <= 0.0)
+    {
         xprev = x;
+        return;
+    }
+
+    double const v = (x - xprev) / dt;
+    double const tm = tprev + dt / 2.0;
 
-        x = hpf;
-        ++n;
-        sum += x;
-        double const k = (double) n;
-        double const a0 = a;
-        a += (x - a) / k;
-        q += (x - a0) * (x - a);
+    for (int i = 0; i < BINS; i++)
+    {
+        // forget over three periods, making each bin about as wide as the
+        // bin spacing so a period falling between bins still shows
+        double const decay = exp(-dt / (3.0 * period[i]));
+        double const w = 2.0 * M_PI / period[i];
+        double const c = dt * cos(w * tm);
+        double const s = dt * sin(w * tm);
+        re[i] = decay * re[i] + v * c;
+        im[i] = decay * im[i] - v * s;
+        cre[i] = decay * cre[i] + c;
+        cim[i] = decay * cim[i] - s;
+        span[i] = decay * span[i] + dt;
     }
 
-    void GetMeanAndStdev(double *mean, double *stdev)
+    tprev = t;
+    xprev = x;
+}
+
+double GuideAxisSpectrum::Amplitude(int bin) const
+{
+    if (span[bin] <= 0.0 || tprev <= t0)
+        return 0.0;
+    // a slow drift would otherwise leak into the long periods
+    double const drift = (xprev - x0) / (tprev - t0);
+    double const vre = re[bin] - drift * cre[bin];
+    double const vim = im[bin] - drift * cim[bin];
+    // velocity amplitude over the angular frequency gives the displacement amplitude
+    return 2.0 * hypot(vre, vim) / span[bin] * period[bin] / (2.0 * M_PI);
+}
+
+bool GuideAxisSpectrum::DominantPeriod(double *pPeriod, double *pAmplitude) const
+{
+    *pPeriod = *pAmplitude = 0.0;
+
+    if (n < 2)
+        return false;
+
+    double const elapsed = tprev - t0;
+    int nbins = 0;
+    double amp[BINS];
+    while (nbins < BINS && 2.0 * period[nbins] <= elapsed)
+    {
+        amp[nbins] = Amplitude(nbins);
+        ++nbins;
+    }
+    if (nbins < 5)
+        return false;
+
+    int best = -1;
+    for (int i = 0; i < nbins; i++)
+    {
+        if ((i > 0 && amp[i] <= amp[i - 1]) || (i < nbins - 1 && amp[i] < amp[i + 1]))
+            continue;
+        if (best < 0 || amp[i] > amp[best])
+            best = i;
+    }
+    if (best < 0)
+        return false;
+
+    // a peak must stand well clear of the noise floor, taken as the median bin
+    std::vector<double> sorted(amp, amp + nbins);
+    std::nth_element(sorted.begin(), sorted.begin() + nbins / 2, sorted.end());
+    if (amp[best] < 4.0 * sorted[nbins / 2])
+        return false;
+
+    // the bins are coarse against a short run; refine the peak with a parabola
+    // through its neighbours on the log-period scale
+    double offset = 0.0;
+    if (best > 0 && best < nbins - 1)
+    {
+        double const d = amp[best - 1] - 2.0 * amp[best] + amp[best + 1];
+        if (d < 0.0)
+            offset = 0.5 * (amp[best - 1] - amp[best + 1]) / d;
+    }
+    *pPeriod = period[best] * pow(period[1] / period[0], offset);
+    *pAmplitude = amp[best];
+    return true;
+}
+
+void GuideAnalysis::Init(double exposure)
+{
+    double lp_cutoff = wxMax(6.0, 3.0 * exposure);
+    m_hpCutoff = 1.0;
+    ra.InitStats(m_hpCutoff, lp_cutoff, exposure);
+    dec.InitStats(m_hpCutoff, lp_cutoff, exposure);
+
+    // from about twice the sampling period to the longest worm periods
+    double const minPeriod = wxMax(2.0, 3.0 * exposure);
+    raSpectrum.Init(minPeriod, 1200.0);
+    decSpectrum.Init(minPeriod, 1200.0);
+
+    m_minRA = m_maxRA = m_maxRateRA = 0.0;
+    m_sumSNR = m_sumMass = 0.0;
+}
+
+void GuideAnalysis::AddSample(double time, const PHD_Point& mountOffset, double snr, double mass)
+{
+    double const raOffset = mountOffset.X;
+    double prevRAlpf = ra.lpf;
+
+    ra.AddSample(raOffset);
+    dec.AddSample(mountOffset.Y);
+    raSpectrum.AddSample(time, raOffset);
+    decSpectrum.AddSample(time, mountOffset.Y);
+
+    if (ra.n == 1)
+    {
+        m_minRA = m_maxRA = raOffset;
+        m_startPos = mountOffset;
+        m_maxRateRA = 0.0;
+    }
+    else
     {
-        if (n == 0)
+        if (raOffset < m_minRA)
+            m_minRA = raOffset;
+        if (raOffset > m_maxRA)
+            m_maxRA = raOffset;
+
+        double dt = time - m_lastTime;
+        if (dt > 0.0001)
         {
-            *mean = *stdev = 0.0;
-            return;
+            double raRate = fabs(ra.lpf - prevRAlpf) / dt;
+            if (raRate > m_maxRateRA)
+                m_maxRateRA = raRate;
         }
+    }
+
+    m_lastPos = mountOffset;
+    m_lastTime = time;
+    m_sumSNR += snr;
+    m_sumMass += mass;
+}
 
-        double const nn = (double) n;
-        *mean = sum / nn;
-        *stdev = sqrt(q / nn);
+void GuideAnalysis::GetResult(double elapsed, double pxscale, double declination, GuideAnalysisResult *result) const
+{
+    double ramean, decmean;
+    ra.GetMeanAndStdev(&ramean, &result->raRms);
+    dec.GetMeanAndStdev(&decmean, &result->decRms);
+
+    double const n = (double) ra.n;
+
+    result->samples = ra.n;
+    result->totalRms = hypot(result->raRms, result->decRms);
+    result->raPeak = ra.peakRawDx;
+    result->decPeak = dec.peakRawDx;
+    result->raPeakPeak = ra.n ? m_maxRA - m_minRA : 0.0;
+    result->raMaxRate = ra.n ? m_maxRateRA : 0.0;
+    raSpectrum.DominantPeriod(&result->raPeriod, &result->raPeriodAmp);
+    decSpectrum.DominantPeriod(&result->decPeriod, &result->decPeriodAmp);
+    result->meanSNR = ra.n ? m_sumSNR / n : 0.0;
+    result->meanMass = ra.n ? m_sumMass / n : 0.0;
+
+    if (ra.n && elapsed > 0.0)
+    {
+        result->raDriftRate = (m_lastPos.X - m_startPos.X) / elapsed * 60.0;
+        result->decDriftRate = (m_lastPos.Y - m_startPos.Y) / elapsed * 60.0;
     }
-};
+    else
+        result->raDriftRate = result->decDriftRate = 0.0;
+
+    result->polarAlignError = PolarAlignmentError(result->decDriftRate, pxscale, declination);
+}
+
+double GuideAnalysis::PolarAlignmentError(double decDriftRate, double pxscale, double declination)
+{
+    double cosdec;
+    if (declination == UNKNOWN_DECLINATION)
+        cosdec = 1.0; // assume declination 0
+    else
+        cosdec = cos(declination);
+    // polar alignment error from Barrett:
+    // http://celestialwonders.com/articles/polaralignment/PolarAlignmentAccuracy.pdf
+    return 3.8197 * fabs(decDriftRate) * pxscale / cosdec;
+}
 
 inline static void StartRow(int& row, int& column)
 {
@@ -143,6 +340,7 @@ struct GuidingAsstWin : public wxDialog
     wxBoxSizer *m_hResultsSizer;
     wxStaticBoxSizer *m_recommend_group;
     wxCheckBox *m_backlashCB;
+    wxCheckBox *m_fastBacklashCB;
     wxStaticText *m_backlashInfo;
     wxButton *m_graphBtn;
 
@@ -165,9 +363,12 @@ struct GuidingAsstWin : public wxDialog
     wxGridCellCoords m_pae_loc;
     wxGridCellCoords m_ra_peak_drift_loc;
     wxGridCellCoords m_backlash_loc;
+    wxGridCellCoords m_ra_period_loc;
+    wxGridCellCoords m_dec_period_loc;
     wxButton *m_raMinMoveButton;
     wxButton *m_decMinMoveButton;
     wxButton *m_decBacklashButton;
+    wxButton *m_pecPeriodButton;
     wxStaticText *m_ra_msg;
     wxStaticText *m_dec_msg;
     wxStaticText *m_snr_msg;
@@ -175,25 +376,20 @@ struct GuidingAsstWin : public wxDialog
     wxStaticText *m_backlash_msg;
     wxStaticText *m_exposure_msg;
     wxStaticText *m_calibration_msg;
+    wxStaticText *m_pec_msg;
+    wxStaticText *m_oscillation_msg;
     double m_ra_val_rec;  // recommended value
     double m_dec_val_rec; // recommended value
+    double m_pec_period_rec;
     double m_min_exp_rec;
     double m_max_exp_rec;
 
     DialogState m_dlgState;
     bool m_measuring;
     wxLongLong_t m_startTime;
-    PHD_Point m_startPos;
     wxString startStr;
     double m_freqThresh;
-    Stats m_statsRA;
-    Stats m_statsDec;
-    double sumSNR;
-    double sumMass;
-    double minRA;
-    double maxRA;
-    double m_lastTime;
-    double maxRateRA; // arc-sec per second
+    GuideAnalysis m_analysis;
     double alignmentError; // arc-minutes
 
     bool m_guideOutputDisabled;
@@ -219,6 +415,7 @@ struct GuidingAsstWin : public wxDialog
     void OnRAMinMove(wxCommandEvent& event);
     void OnDecMinMove(wxCommandEvent& event);
     void OnDecBacklash(wxCommandEvent& event);
+    void OnPECPeriod(wxCommandEvent& event);
     void OnGraph(wxCommandEvent& event);
 
     wxStaticText *AddRecommendationEntry(const wxString& msg, wxObjectEventFunction handler, wxButton **ppButton);
@@ -340,7 +537,7 @@ GuidingAsstWin::GuidingAsstWin()
     // Start of "Other" (peak and drift) group
     wxStaticBoxSizer *other_group = new wxStaticBoxSizer(wxVERTICAL, this, _("Other Star Motion"));
     m_othergrid = new wxGrid(this, wxID_ANY);
-    m_othergrid->CreateGrid(9, 2);
+    m_othergrid->CreateGrid(11, 2);
     m_othergrid->GetGridWindow()->Bind(wxEVT_MOTION, &GuidingAsstWin::OnMouseMove, this, wxID_ANY, wxID_ANY, new GridTooltipInfo(m_othergrid, 3));
     m_othergrid->SetRowLabelSize(1);
     m_othergrid->SetColLabelSize(1);
@@ -384,6 +581,14 @@ GuidingAsstWin::GuidingAsstWin()
     m_othergrid->SetCellValue(row, col++, _("Polar Alignment Error"));
     m_pae_loc.Set(row, col++);
 
+    StartRow(row, col);
+    m_othergrid->SetCellValue(row, col++, _("Right ascension Dominant Period"));
+    m_ra_period_loc.Set(row, col++);
+
+    StartRow(row, col);
+    m_othergrid->SetCellValue(row, col++, _("Declination Dominant Period"));
+    m_dec_period_loc.Set(row, col++);
+
     other_group->Add(m_othergrid);
     m_vResultsSizer->Add(other_group, wxSizerFlags(0).Border(wxALL, 8));
     // End of peak and drift group
@@ -399,6 +604,8 @@ GuidingAsstWin::GuidingAsstWin()
     m_pae_msg = NULL;
     m_exposure_msg = NULL;
     m_calibration_msg = NULL;
+    m_pec_msg = NULL;
+    m_oscillation_msg = NULL;
 
     m_recommend_group->Add(m_recommendgrid, wxSizerFlags(1).Expand());
     // Put the recommendation block at the bottom so it can be hidden/shown
@@ -424,9 +631,15 @@ GuidingAsstWin::GuidingAsstWin()
         m_backlashCB->SetValue(false);
         m_backlashCB->Enable(false);
     }
+    m_fastBacklashCB = new wxCheckBox(this, wxID_ANY, _("Fast"));
+    m_fastBacklashCB->SetToolTip(_("Size the moves from the calibration and the measured seeing, and end each leg as soon as the mount is seen moving. "
+        "The backlash is fitted from the South moves and applied as the backlash compensation amount."));
+    m_fastBacklashCB->SetValue(pConfig->Global.GetBoolean("/BacklashTool/Adaptive", true));
+    m_fastBacklashCB->Enable(m_backlashCB->IsEnabled());
     m_graphBtn = new wxButton(this, wxID_ANY, _("Show Graph"));
     m_graphBtn->SetToolTip(_("Show graph of backlash measurement points"));
     bl_group->Add(m_backlashCB, wxSizerFlags(0).Border(wxALL, 8));
+    bl_group->Add(m_fastBacklashCB, wxSizerFlags(0).Border(wxALL, 8));
     bl_group->Add(m_graphBtn, wxSizerFlags(0).Border(wxLEFT, 30));
     m_graphBtn->Connect(wxEVT_COMMAND_BUTTON_CLICKED, wxCommandEventHandler(GuidingAsstWin::OnGraph), NULL, this);
     m_vSizer->Add(bl_group, wxSizerFlags(0).Border(wxALL, 8).Center());
@@ -521,6 +734,8 @@ static bool GetGridToolTip(int gridNum, const wxGridCellCoords& coords, wxString
         case 306: *s = _("Estimated overall drift rate in declination."); break;
         case 307: *s = _("Estimate of declination backlash if backlash testing was completed successfully"); break;
         case 308: *s = _("Estimate of polar alignment error. If the scope declination is unknown, the value displayed is a lower bound and the actual error may be larger."); break;
+        case 309: *s = _("Period and amplitude of the strongest periodic motion in right ascension, such as the mount's periodic error."); break;
+        case 310: *s = _("Period and amplitude of the strongest periodic motion in declination."); break;
 
         default: return false;
     }
@@ -587,8 +802,11 @@ void GuidingAsstWin::BacklashStep(const PHD_Point& camLoc)
             if (qual != BacklashTool::MEASUREMENT_INVALID)
             {
                 wxString preamble = qual == BacklashTool::MEASUREMENT_IMPAIRED ? ">=" : "";
-                m_othergrid->SetCellValue(m_backlash_loc, wxString::Format("%s% .1f %s ( %d %s)", 
-                    preamble, m_backlashTool->GetBacklashResultPx(), _("px"), m_backlashTool->GetBacklashResultMs(), _("ms")));
+                wxString ms = wxString::Format("%d", m_backlashTool->GetBacklashResultMs());
+                if (m_backlashTool->GetBacklashSigmaMs() > 0)
+                    ms += wxString::Format(" +/- %d", m_backlashTool->GetBacklashSigmaMs());
+                m_othergrid->SetCellValue(m_backlash_loc, wxString::Format("%s% .1f %s ( %s %s)", 
+                    preamble, m_backlashTool->GetBacklashResultPx(), _("px"), ms, _("ms")));
                 HighlightCell(m_othergrid, m_backlash_loc);
                 m_graphBtn->Enable(true);
             }
@@ -662,6 +880,24 @@ void GuidingAsstWin::OnDecBacklash(wxCommandEvent& event)
     m_decBacklashButton->Enable(false);
 }
 
+void GuidingAsstWin::OnPECPeriod(wxCommandEvent& event)
+{
+    GuideAlgorithm *raAlgo = pMount->GetXGuideAlgorithm();
+
+    if (!raAlgo)
+        return;
+
+    if (raAlgo->SetParam("period", m_pec_period_rec))
+    {
+        Debug.Write(wxString::Format("GuideAssistant changed RA PEC period to %.0f\n", m_pec_period_rec));
+        pFrame->pGraphLog->UpdateControls();
+        pFrame->NotifyGuidingParam("RA " + raAlgo->GetGuideAlgorithmClassName() + " Period ", m_pec_period_rec);
+        m_pecPeriodButton->Enable(false);
+    }
+    else
+        Debug.Write("GuideAssistant could not change RA PEC period\n");
+}
+
 void GuidingAsstWin::OnGraph(wxCommandEvent& event)
 {
     m_backlashTool->ShowGraph(this);
@@ -715,6 +951,8 @@ void GuidingAsstWin::LogResults()
     Debug.Write(wxString::Format("Dec Drift Rate=%s, Dec Peak=%s, PA Error=%s\n",
         m_othergrid->GetCellValue(m_dec_drift_loc), m_othergrid->GetCellValue(m_dec_peak_loc),
         m_othergrid->GetCellValue(m_pae_loc)));
+    Debug.Write(wxString::Format("RA Dominant Period=%s, Dec Dominant Period=%s\n",
+        m_othergrid->GetCellValue(m_ra_period_loc), m_othergrid->GetCellValue(m_dec_period_loc)));
 
     if (m_backlashTool->GetBacklashResultPx() > 0)
     {
@@ -735,12 +973,12 @@ void GuidingAsstWin::MakeRecommendations()
 {
     double rarms;
     double ramean;
-    m_statsRA.GetMeanAndStdev(&ramean, &rarms);
+    m_analysis.ra.GetMeanAndStdev(&ramean, &rarms);
 
     double decrms;
     double decmean;
     bool largeBL = false;
-    m_statsDec.GetMeanAndStdev(&decmean, &decrms);
+    m_analysis.dec.GetMeanAndStdev(&decmean, &decrms);
 
     double multiplier_ra  = 1.28;  // 80% prediction interval
     double multiplier_dec = 1.64;  // 90% prediction interval
@@ -770,11 +1008,26 @@ void GuidingAsstWin::MakeRecommendations()
     // Need to apply some constraints on the relative ratios because the ra_rms stat can be affected by large PE or drift
     m_ra_val_rec = wxMin(wxMax(m_ra_val_rec, 0.8 * m_dec_val_rec), 1.2 * m_dec_val_rec);        // within 20% of dec recommendation
 
+    // A periodic motion too fast for the guide loop to follow only gets chased, so keep min-move
+    // above it. Slower periodic error in RA is what the predictive PEC algorithm corrects.
+    double exposure = wxMax(1.0, (double) pFrame->RequestedExposureDuration() / 1000.0);
+    double raPeriod, raPeriodAmp, decPeriod, decPeriodAmp;
+    bool raPeriodic = m_analysis.raSpectrum.DominantPeriod(&raPeriod, &raPeriodAmp);
+    bool decPeriodic = m_analysis.decSpectrum.DominantPeriod(&decPeriod, &decPeriodAmp);
+    bool raFast = raPeriodic && raPeriod < 10.0 * exposure && raPeriodAmp > m_ra_val_rec;
+    bool decFast = decPeriodic && decPeriod < 10.0 * exposure && decPeriodAmp > m_dec_val_rec;
+    if (raFast)
+        m_ra_val_rec = round(raPeriodAmp / unit + 0.5) * unit;
+    if (decFast)
+        m_dec_val_rec = round(decPeriodAmp / unit + 0.5) * unit;
+    bool raPE = raPeriodic && raPeriod >= 60.0 && raPeriodAmp > rounded_rarms;
+    m_pec_period_rec = raPE ? round(raPeriod) : 0.0;
+
     LogResults();               // Dump the raw statistics
   
     // Clump the no-button messages at the top
 
-    double drift_exp = round(rarms * multiplier_ra / maxRateRA + 0.4);
+    double drift_exp = round(rarms * multiplier_ra / m_analysis.MaxRateRA() + 0.4);
     m_min_exp_rec = std::max(1.0, std::min(drift_exp, min_rec_exposure));
     if (drift_exp > m_min_exp_rec)
     {
@@ -808,7 +1061,7 @@ void GuidingAsstWin::MakeRecommendations()
         Debug.Write(wxString::Format("Recommendation: %s\n", m_calibration_msg->GetLabelText()));
     }
 
-    if ((sumSNR / (double)m_statsRA.n) < 5.0)
+    if (m_analysis.MeanSNR() < 5.0)
     {
         wxString msg(_("Consider using a brighter star for the test or increasing the exposure time"));
         if (!m_snr_msg)
@@ -843,6 +1096,25 @@ void GuidingAsstWin::MakeRecommendations()
             m_pae_msg->SetLabel(wxEmptyString);
     }
 
+    if (raFast || decFast)
+    {
+        wxString msg;
+        if (raFast)
+            msg = wxString::Format(_("The star oscillates with a %.1fs period in RA; check for wind or mount vibration"), raPeriod);
+        else
+            msg = wxString::Format(_("The star oscillates with a %.1fs period in Dec; check for wind or mount vibration"), decPeriod);
+        if (!m_oscillation_msg)
+            m_oscillation_msg = AddRecommendationEntry(SizedMsg(msg));
+        else
+            m_oscillation_msg->SetLabel(SizedMsg(msg));
+        Debug.Write(wxString::Format("Recommendation: %s\n", m_oscillation_msg->GetLabelText()));
+    }
+    else
+    {
+        if (m_oscillation_msg)
+            m_oscillation_msg->SetLabel(wxEmptyString);
+    }
+
     if (pMount->GetXGuideAlgorithm() && pMount->GetXGuideAlgorithm()->GetMinMove() >= 0.0)
     {
         if (!m_ra_msg)
@@ -873,6 +1145,38 @@ void GuidingAsstWin::MakeRecommendations()
         Debug.Write(wxString::Format("Recommendation: %s\n", m_dec_msg->GetLabelText()));
     }
 
+    GuideAlgorithm *raAlgo = pMount->GetXGuideAlgorithm();
+    if (raPE && raAlgo && raAlgo->Algorithm() == GUIDE_ALGORITHM_PREDICTIVE_PEC)
+    {
+        wxString msg = SizedMsg(wxString::Format(_("Try setting the RA predictive PEC period to %.0fs"), m_pec_period_rec));
+        if (!m_pec_msg)
+        {
+            m_pec_msg = AddRecommendationEntry(msg, wxCommandEventHandler(GuidingAsstWin::OnPECPeriod), &m_pecPeriodButton);
+        }
+        else
+        {
+            m_pec_msg->SetLabel(msg);
+            m_pecPeriodButton->Enable(true);
+        }
+        Debug.Write(wxString::Format("Recommendation: %s\n", m_pec_msg->GetLabelText()));
+    }
+    else if (raPE && raAlgo)
+    {
+        // no Apply button here: the algorithm has to be chosen in the Advanced Settings first
+        wxString msg = SizedMsg(wxString::Format(_("RA shows a %.1f px periodic error over %.0fs; the Predictive PEC algorithm could correct it"),
+            raPeriodAmp, m_pec_period_rec));
+        if (!m_pec_msg)
+            m_pec_msg = AddRecommendationEntry(msg);
+        else
+            m_pec_msg->SetLabel(msg);
+        Debug.Write(wxString::Format("Recommendation: %s\n", m_pec_msg->GetLabelText()));
+    }
+    else
+    {
+        if (m_pec_msg)
+            m_pec_msg->SetLabel(wxEmptyString);
+    }
+
     if (m_backlashTool->GetBacklashResultMs() >= 100)
     {
         bool largeBL = m_backlashTool->GetBacklashResultMs() > MAX_BACKLASH_COMP;
@@ -913,13 +1217,8 @@ void GuidingAsstWin::OnStart(wxCommandEvent& event)
         return;
 
     double exposure = (double) pFrame->RequestedExposureDuration() / 1000.0;
-    double lp_cutoff = wxMax(6.0, 3.0 * exposure);
-    double hp_cutoff = 1.0;
-    m_freqThresh = 1.0 / hp_cutoff;
-    m_statsRA.InitStats(hp_cutoff, lp_cutoff, exposure);
-    m_statsDec.InitStats(hp_cutoff, lp_cutoff, exposure);
-
-    sumSNR = sumMass = 0.0;
+    m_analysis.Init(exposure);
+    m_freqThresh = 1.0 / m_analysis.HighPassCutoff();
 
     m_start->Enable(false);
     m_stop->Enable(true);
@@ -993,6 +1292,7 @@ void GuidingAsstWin::EndBacklashTest(bool normal)
 
     m_measuringBacklash = false;
     m_backlashCB->Enable(true);
+    m_fastBacklashCB->Enable(true);
     m_backlashInfo->Show(false);
     Layout();
     GetSizer()->Fit(this);
@@ -1026,7 +1326,13 @@ void GuidingAsstWin::OnStop(wxCommandEvent& event)
             Layout();
             GetSizer()->Fit(this);
             m_backlashCB->Enable(false);                        // Don't let user turn it off once we've started
+            m_fastBacklashCB->Enable(false);
             m_measuring = false;
+            double decMean, decRms;
+            m_analysis.dec.GetMeanAndStdev(&decMean, &decRms);
+            if (decRms > 0.0)
+                m_backlashTool->SetSeeingNoise(decRms);
+            m_backlashTool->SetAdaptive(m_fastBacklashCB->IsChecked());
             m_backlashTool->StartMeasurement();
             m_instructions->SetLabel(_("Measuring backlash... "));
         }
@@ -1086,66 +1392,18 @@ void GuidingAsstWin::FillResultCell(wxGrid *pGrid, const wxGridCellCoords& loc,
 
 void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
 {
-    double ra = info.mountOffset.X;
-    double dec = info.mountOffset.Y;
-    double prevRAlpf = m_statsRA.lpf;
-
-    m_statsRA.AddSample(ra);
-    m_statsDec.AddSample(dec);
-
-    if (m_statsRA.n == 1)
-    {
-        minRA = maxRA = ra;
-        m_startPos = info.mountOffset;
-        maxRateRA = 0.0;
-    }
-    else
-    {
-        if (ra < minRA)
-            minRA = ra;
-        if (ra > maxRA)
-            maxRA = ra;
-
-        double dt = info.time - m_lastTime;
-        if (dt > 0.0001)
-        {
-            double raRate = fabs(m_statsRA.lpf - prevRAlpf) / dt;
-            if (raRate > maxRateRA)
-                maxRateRA = raRate;
-        }
-    }
-    double rangeRA = maxRA - minRA;
-    double driftRA = ra - m_startPos.X;
-    double driftDec = dec - m_startPos.Y;
-
-    m_lastTime = info.time;
-    sumSNR += info.starSNR;
-    sumMass += info.starMass;
+    m_analysis.AddSample(info.time, info.mountOffset, info.starSNR, info.starMass);
 
-    double ramean, rarms;
-    double decmean, decrms;
     double pxscale = pFrame->GetCameraPixelScale();
 
-    m_statsRA.GetMeanAndStdev(&ramean, &rarms);
-    m_statsDec.GetMeanAndStdev(&decmean, &decrms);
-
-    double n = (double) m_statsRA.n;
-    double combined = hypot(rarms, decrms);
-
     wxLongLong_t elapsedms = ::wxGetUTCTimeMillis().GetValue() - m_startTime;
     double elapsed = (double) elapsedms / 1000.0;
 
-    double raDriftRate = driftRA / elapsed * 60.0;
-    double decDriftRate = driftDec / elapsed * 60.0;
-    double declination = pPointingSource->GetDeclination();
-    double cosdec;
-    if (declination == UNKNOWN_DECLINATION)
-        cosdec = 1.0; // assume declination 0
-    else
-        cosdec = cos(declination);
-    // polar alignment error from Barrett:
-    // http://celestialwonders.com/articles/polaralignment/PolarAlignmentAccuracy.pdf
-    alignmentError = 3.8197 * fabs(decDriftRate) * pxscale / cosdec;
+    double declination = PointingCache::Declination();
+
+    GuideAnalysisResult r;
+    m_analysis.GetResult(elapsed, pxscale, declination, &r);
+    alignmentError = r.polarAlignError;
 
     wxString SEC(_("s"));
     wxString PX(_("px"));
@@ -1159,24 +1417,28 @@ void GuidingAsstWin::UpdateInfo(const GuideStepInfo& info)
 
     m_statusgrid->SetCellValue(m_timestamp_loc, startStr);
     m_statusgrid->SetCellValue(m_exposuretime_loc, wxString::Format("%g%s", (double)pFrame->RequestedExposureDuration() / 1000.0, SEC));
-    m_statusgrid->SetCellValue(m_snr_loc, wxString::Format("%.1f", sumSNR / n));
-    m_statusgrid->SetCellValue(m_starmass_loc, wxString::Format("%.1f", sumMass / n));
+    m_statusgrid->SetCellValue(m_snr_loc, wxString::Format("%.1f", r.meanSNR));
+    m_statusgrid->SetCellValue(m_starmass_loc, wxString::Format("%.1f", r.meanMass));
     m_statusgrid->SetCellValue(m_elapsedtime_loc, wxString::Format("%u%s", (unsigned int)(elapsedms / 1000), SEC));
-    m_statusgrid->SetCellValue(m_samplecount_loc, wxString::Format("%.0f", n));
-
-    FillResultCell(m_displacementgrid, m_ra_rms_loc, rarms, rarms * pxscale, PX, ARCSEC);
-    FillResultCell(m_displacementgrid, m_dec_rms_loc, decrms, decrms * pxscale, PX, ARCSEC);
-    FillResultCell(m_displacementgrid, m_total_rms_loc, combined, combined * pxscale, PX, ARCSEC);
-
-    FillResultCell(m_othergrid, m_ra_peak_loc, m_statsRA.peakRawDx, m_statsRA.peakRawDx * pxscale, PX, ARCSEC);
-    FillResultCell(m_othergrid, m_dec_peak_loc, m_statsDec.peakRawDx, m_statsDec.peakRawDx * pxscale, PX, ARCSEC);
-    FillResultCell(m_othergrid, m_ra_peakpeak_loc, rangeRA, rangeRA * pxscale, PX, ARCSEC);
-    FillResultCell(m_othergrid, m_ra_drift_loc, raDriftRate, raDriftRate * pxscale, PXPERMIN, ARCSECPERMIN);
-    FillResultCell(m_othergrid, m_ra_peak_drift_loc, maxRateRA, maxRateRA * pxscale, PXPERSEC, ARCSECPERSEC);
-    m_othergrid->SetCellValue(m_ra_drift_exp_loc, maxRateRA <= 0.0 ? _(" ") :
-        wxString::Format("%6.1f %s ",  1.3 * rarms / maxRateRA, SEC));
-    FillResultCell(m_othergrid, m_dec_drift_loc, decDriftRate, decDriftRate * pxscale, PXPERMIN, ARCSECPERMIN);
+    m_statusgrid->SetCellValue(m_samplecount_loc, wxString::Format("%u", r.samples));
+
+    FillResultCell(m_displacementgrid, m_ra_rms_loc, r.raRms, r.raRms * pxscale, PX, ARCSEC);
+    FillResultCell(m_displacementgrid, m_dec_rms_loc, r.decRms, r.decRms * pxscale, PX, ARCSEC);
+    FillResultCell(m_displacementgrid, m_total_rms_loc, r.totalRms, r.totalRms * pxscale, PX, ARCSEC);
+
+    FillResultCell(m_othergrid, m_ra_peak_loc, r.raPeak, r.raPeak * pxscale, PX, ARCSEC);
+    FillResultCell(m_othergrid, m_dec_peak_loc, r.decPeak, r.decPeak * pxscale, PX, ARCSEC);
+    FillResultCell(m_othergrid, m_ra_peakpeak_loc, r.raPeakPeak, r.raPeakPeak * pxscale, PX, ARCSEC);
+    FillResultCell(m_othergrid, m_ra_drift_loc, r.raDriftRate, r.raDriftRate * pxscale, PXPERMIN, ARCSECPERMIN);
+    FillResultCell(m_othergrid, m_ra_peak_drift_loc, r.raMaxRate, r.raMaxRate * pxscale, PXPERSEC, ARCSECPERSEC);
+    m_othergrid->SetCellValue(m_ra_drift_exp_loc, r.raMaxRate <= 0.0 ? _(" ") :
+        wxString::Format("%6.1f %s ",  1.3 * r.raRms / r.raMaxRate, SEC));
+    FillResultCell(m_othergrid, m_dec_drift_loc, r.decDriftRate, r.decDriftRate * pxscale, PXPERMIN, ARCSECPERMIN);
     m_othergrid->SetCellValue(m_pae_loc, wxString::Format("%s %.1f %s", declination == UNKNOWN_DECLINATION ? "> " : "", alignmentError, ARCMIN));
+    m_othergrid->SetCellValue(m_ra_period_loc, r.raPeriod <= 0.0 ? _(" ") :
+        wxString::Format("%.0f %s, %.2f %s (%.2f %s)", r.raPeriod, SEC, r.raPeriodAmp, PX, r.raPeriodAmp * pxscale, ARCSEC));
+    m_othergrid->SetCellValue(m_dec_period_loc, r.decPeriod <= 0.0 ? _(" ") :
+        wxString::Format("%.0f %s, %.2f %s (%.2f %s)", r.decPeriod, SEC, r.decPeriodAmp, PX, r.decPeriodAmp * pxscale, ARCSEC));
 }
 
 wxWindow *GuidingAssistant::CreateDialogBox()
@@ -35,6 +35,114 @@
 #ifndef GUIDING_ASSISTANT_INCLUDED
 #define GUIDING_ASSISTANT_INCLUDED
 
+// Running statistics of one axis: mean and standard deviation of the
+// high-pass filtered offsets, a low-pass filtered offset for rate
+// measurements, and the largest move between samples
+struct GuideAxisStats
+{
+    double alpha_lp;
+    double alpha_hp;
+    unsigned int n;
+    double sum;
+    double a;
+    double q;
+    double hpf;
+    double lpf;
+    double xprev;
+    double peakRawDx;
+
+    void InitStats(double hpfCutoffPeriod, double lpfCutoffPeriod, double samplePeriod);
+    void Reset();
+    void AddSample(double x);
+    void GetMeanAndStdev(double *mean, double *stdev) const;
+};
+
+// Running amplitude spectrum of one axis over a fixed bank of log-spaced
+// periods. Each bin is an exponentially weighted DFT term of the star's
+// velocity evaluated at the actual sample times, so a sample costs the same
+// however long the measurement runs. The mean drift is taken out when the
+// spectrum is read, using the same DFT of a constant
+struct GuideAxisSpectrum
+{
+    enum { BINS = 96 };
+
+    double period[BINS];        // seconds
+    double re[BINS];
+    double im[BINS];
+    double cre[BINS];           // DFT of a unit velocity
+    double cim[BINS];
+    double span[BINS];          // weighted time seen by each bin, seconds
+    unsigned int n;
+    double t0;
+    double x0;
+    double tprev;
+    double xprev;
+
+    void Init(double minPeriod, double maxPeriod);
+    void Reset();
+    void AddSample(double t, double x);
+    double Amplitude(int bin) const;    // px
+    // the strongest peak seen at least twice standing out from the rest of
+    // the spectrum; false if there is none
+    bool DominantPeriod(double *period, double *amplitude) const;
+};
+
+struct GuideAnalysisResult
+{
+    unsigned int samples;
+    double raRms;               // px, high-pass filtered
+    double decRms;
+    double totalRms;
+    double raPeak;              // px, largest move between samples
+    double decPeak;
+    double raPeakPeak;          // px
+    double raDriftRate;         // px/min
+    double decDriftRate;
+    double raPeriod;            // sec, dominant periodic motion, 0 if none
+    double raPeriodAmp;         // px
+    double decPeriod;
+    double decPeriodAmp;
+    double raMaxRate;           // px/sec, from the low-pass filtered RA offset
+    double meanSNR;
+    double meanMass;
+    double polarAlignError;     // arc-min, from the Dec drift rate
+};
+
+// The Guiding Assistant's measurements over a run of guide steps, shared by
+// the live measurement and by the guide log analyzer (guidelog_analyzer.h)
+class GuideAnalysis
+{
+public:
+    GuideAxisStats ra;
+    GuideAxisStats dec;
+    GuideAxisSpectrum raSpectrum;
+    GuideAxisSpectrum decSpectrum;
+
+private:
+    double m_hpCutoff;
+    PHD_Point m_startPos;
+    PHD_Point m_lastPos;
+    double m_minRA;
+    double m_maxRA;
+    double m_maxRateRA;         // px/sec
+    double m_lastTime;
+    double m_sumSNR;
+    double m_sumMass;
+
+public:
+    void Init(double exposure);     // seconds
+    void AddSample(double time, const PHD_Point& mountOffset, double snr, double mass);
+    // elapsed in seconds, declination in radians or UNKNOWN_DECLINATION
+    void GetResult(double elapsed, double pxscale, double declination, GuideAnalysisResult *result) const;
+
+    unsigned int Count() const { return ra.n; }
+    double HighPassCutoff() const { return m_hpCutoff; }
+    double MaxRateRA() const { return m_maxRateRA; }
+    double MeanSNR() const { return ra.n ? m_sumSNR / ra.n : 0.0; }
+
+    static double PolarAlignmentError(double decDriftRate, double pxscale, double declination);
+};
+
 class GuidingAssistant
 {
     GuidingAssistant(); // not implemented
@@ -0,0 +1,145 @@
+/*
+ *  guiding_perf.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+GuidingPerf GuidingPerfStats;
+
+void GuidingPerf::Start()
+{
+    m_startTime = ::wxGetUTCTimeMillis();
+    PerfStats::Mark(&m_perf);
+    m_guide = GuideMetrics.GetStats();
+    m_eventBytes = EvtServer.BytesSent();
+    unsigned int clients;
+    size_t queued;
+    EvtServer.GetOutputQueueStats(&clients, &queued, &m_droppedEvents);
+    m_processCpu = GuideLoopMetrics::ProcessCpuTime();
+    m_threads.clear();
+    pFrame->GetThreadCpuTimes(&m_threads);
+    m_active = true;
+}
+
+// the counters may have been reset during the run, leaving them below what
+// they were at the start; then all of the current count belongs to the run
+inline static unsigned int Since(unsigned int now, unsigned int start)
+{
+    return now >= start ? now - start : now;
+}
+
+inline static double Since(double now, double start)
+{
+    if (now < 0.0 || start < 0.0)
+        return -1.0;
+    return now >= start ? now - start : now;
+}
+
+bool GuidingPerf::Finish(GuidingPerfReport *report)
+{
+    if (!m_active)
+        return true;
+    m_active = false;
+
+    report->duration = (::wxGetUTCTimeMillis() - m_startTime).ToDouble() / 1000.0;
+
+    GuideLoopStats gs = GuideMetrics.GetStats();
+    report->frames = Since(gs.frames, m_guide.frames);
+    report->starLost = Since(gs.starLost, m_guide.starLost);
+    report->droppedFrames = Since(gs.droppedFrames, m_guide.droppedFrames);
+    report->staleFrames = Since(gs.staleFrames, m_guide.staleFrames);
+
+    report->cycles = Since(PerfStats::Cycles(), m_perf.cycles);
+    report->slowCycles = Since(PerfStats::SlowCycles(), m_perf.slowCycles);
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+        PerfStats::GetSince(m_perf, (PerfStage) i, &report->stage[i]);
+
+    report->eventBytes = EvtServer.BytesSent() - m_eventBytes;
+    unsigned int clients, dropped;
+    size_t queued;
+    EvtServer.GetOutputQueueStats(&clients, &queued, &dropped);
+    report->droppedEvents = Since(dropped, m_droppedEvents);
+
+    report->memory = GuideLoopMetrics::ProcessMemory();
+    report->peakMemory = GuideLoopMetrics::PeakProcessMemory();
+    report->processCpu = Since(GuideLoopMetrics::ProcessCpuTime(), m_processCpu);
+
+    // a worker thread restarted during the run (e.g. on reconnecting the
+    // gear) is reported from its own start
+    report->threads.clear();
+    pFrame->GetThreadCpuTimes(&report->threads);
+    for (std::vector<ThreadCpuTime>::iterator it = report->threads.begin(); it != report->threads.end(); ++it)
+    {
+        for (std::vector<ThreadCpuTime>::const_iterator st = m_threads.begin(); st != m_threads.end(); ++st)
+        {
+            if (st->name == it->name)
+            {
+                it->seconds = Since(it->seconds, st->seconds);
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+wxString GuidingPerfReport::Format() const
+{
+    wxString s = wxString::Format("Performance: guided %.0f s, frames = %u, star lost = %u, dropped = %u, stale = %u, "
+        "cycles = %u, slow cycles = %u\n", duration, frames, starLost, droppedFrames, staleFrames, cycles, slowCycles);
+
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+    {
+        const PerfSummary& p = stage[i];
+        if (!p.count)
+            continue;
+        s += wxString::Format("Performance: %s n = %u, mean = %.2f ms, p50 = %.2f ms, p95 = %.2f ms, p99 = %.2f ms, max = %.2f ms\n",
+            PerfStats::StageName((PerfStage) i), p.count, p.meanMs, p.p50Ms, p.p95Ms, p.p99Ms, p.maxMs);
+    }
+
+    s += wxString::Format("Performance: event server sent %.0f KB, dropped %u events\n", eventBytes / 1024.0, droppedEvents);
+    s += wxString::Format("Performance: memory = %.1f MB, peak = %.1f MB\n",
+        memory.ToDouble() / (1024.0 * 1024.0), peakMemory.ToDouble() / (1024.0 * 1024.0));
+
+    wxString cpu = "Performance: CPU";
+    if (processCpu >= 0.0)
+        cpu += wxString::Format(" process = %.1f s", processCpu);
+    for (std::vector<ThreadCpuTime>::const_iterator it = threads.begin(); it != threads.end(); ++it)
+    {
+        if (it->seconds >= 0.0)
+            cpu += wxString::Format(", %s = %.1f s", it->name, it->seconds);
+    }
+    s += cpu + "\n";
+
+    return s;
+}
@@ -0,0 +1,87 @@
+/*
+ *  guiding_perf.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef GUIDING_PERF_INCLUDED
+#define GUIDING_PERF_INCLUDED
+
+struct ThreadCpuTime
+{
+    wxString name;
+    double seconds;
+};
+
+// What the guide loop instrumentation recorded during one guiding run, from
+// guiding start to guiding stop
+struct GuidingPerfReport
+{
+    double duration;                    // seconds
+    unsigned int frames;                // frames processed by the guider
+    unsigned int starLost;
+    unsigned int droppedFrames;
+    unsigned int staleFrames;
+    unsigned int cycles;                // see PerfStats::CycleDone
+    unsigned int slowCycles;
+    PerfSummary stage[NUM_PERF_STAGES];
+    long long eventBytes;               // sent to event server clients
+    unsigned int droppedEvents;
+    wxLongLong memory;                  // resident memory at the stop
+    wxLongLong peakMemory;              // since the process started
+    double processCpu;                  // seconds, negative if unknown
+    std::vector<ThreadCpuTime> threads; // seconds used by each thread during the run
+
+    wxString Format() const;            // lines for the guide log
+};
+
+class GuidingPerf
+{
+    bool m_active;
+    wxLongLong m_startTime;
+    PerfMark m_perf;
+    GuideLoopStats m_guide;
+    long long m_eventBytes;
+    unsigned int m_droppedEvents;
+    double m_processCpu;
+    std::vector<ThreadCpuTime> m_threads;
+
+public:
+    GuidingPerf() : m_active(false) { }
+
+    void Start();
+    // true if there is no run to report (guiding was not started)
+    bool Finish(GuidingPerfReport *report);
+};
+
+extern GuidingPerf GuidingPerfStats;
+
+#endif
@@ -35,19 +35,159 @@
 
 #include "phd.h"
 
+#ifdef __WINDOWS__
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
 #define GUIDELOG_VERSION _T("2.5")
 
 const int RetentionPeriod = 60;
 
+enum
+{
+    DEFAULT_FLUSH_INTERVAL_SEC = 5,
+    DEFAULT_FLUSH_BYTES = 64 * 1024,
+};
+
+class GuideLogWriter : public wxThread
+{
+    GuidingLog *m_log;
+    wxSemaphore m_wake;
+    volatile bool m_stop;
+    int m_intervalMs;
+
+public:
+    GuideLogWriter(GuidingLog *log, int intervalMs)
+        : wxThread(wxTHREAD_JOINABLE), m_log(log), m_stop(false), m_intervalMs(intervalMs) { }
+
+    void Wake() { m_wake.Post(); }
+    void Stop() { m_stop = true; m_wake.Post(); }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("guide log");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "guide log");
+
+        while (!m_stop)
+        {
+            m_wake.WaitTimeout(m_intervalMs);
+            m_log->WriteBuffer();
+        }
+        return 0;
+    }
+};
+
+// commit the file to the disk rather than just to the OS
+static void SyncToDisk(wxFFile& file)
+{
+    file.Flush();
+#ifdef __WINDOWS__
+    _commit(_fileno(file.fp()));
+#else
+    fsync(fileno(file.fp()));
+#endif
+}
+
 GuidingLog::GuidingLog(void)
     : m_enabled(false),
     m_keepFile(false),
-    m_isGuiding(false)
+    m_isGuiding(false),
+    m_writeErrors(0),
+    m_writer(NULL),
+    m_flushPolicy(GUIDELOG_FLUSH_EVENTS),
+    m_flushIntervalMs(DEFAULT_FLUSH_INTERVAL_SEC * 1000),
+    m_flushBytes(DEFAULT_FLUSH_BYTES),
+    m_fsyncOnClose(true)
 {
 }
 
 GuidingLog::~GuidingLog(void)
 {
+    StopWriter();
+}
+
+void GuidingLog::StartWriter(void)
+{
+    int policy = pConfig->Global.GetInt("/GuideLog/FlushPolicy", GUIDELOG_FLUSH_EVENTS);
+    if (policy < GUIDELOG_FLUSH_ALWAYS || policy > GUIDELOG_FLUSH_EVENTS)
+        policy = GUIDELOG_FLUSH_EVENTS;
+    m_flushPolicy = (GuideLogFlushPolicy) policy;
+    m_flushIntervalMs = wxMax(1, pConfig->Global.GetInt("/GuideLog/FlushIntervalSec", DEFAULT_FLUSH_INTERVAL_SEC)) * 1000;
+    m_flushBytes = (size_t) wxMax(1024, pConfig->Global.GetInt("/GuideLog/FlushBytes", DEFAULT_FLUSH_BYTES));
+    m_fsyncOnClose = pConfig->Global.GetBoolean("/GuideLog/FsyncOnClose", true);
+
+    Debug.Write(wxString::Format("GuideLog: flush policy %d, interval %d ms, %u bytes, fsync on close %d\n",
+        m_flushPolicy, m_flushIntervalMs, (unsigned int) m_flushBytes, m_fsyncOnClose));
+
+    GuideLogWriter *writer = new GuideLogWriter(this, m_flushIntervalMs);
+    if (writer->Create() == wxTHREAD_NO_ERROR && writer->Run() == wxTHREAD_NO_ERROR)
+        m_writer = writer;
+    else
+    {
+        delete writer;  // lines will be written synchronously
+        Debug.AddLine("GuideLog: unable to start the writer thread");
+    }
+}
+
+void GuidingLog::StopWriter(void)
+{
+    if (!m_writer)
+        return;
+
+    GuideLogWriter *writer = m_writer;
+    m_writer = NULL;    // from now on lines are written synchronously
+    writer->Stop();
+    writer->Wait();
+    delete writer;
+}
+
+void GuidingLog::Append(const wxString& str)
+{
+    bool full;
+    {
+        wxCriticalSectionLocker lock(m_bufLock);
+        m_buf += str;
+        full = m_buf.length() >= m_flushBytes;
+    }
+
+    if (full && m_writer)
+        m_writer->Wake();
+}
+
+// after a guide step or dropped frame, which is not an event boundary
+void GuidingLog::StepLogged(void)
+{
+    if (!m_writer)
+        WriteBuffer();
+    else if (m_flushPolicy == GUIDELOG_FLUSH_ALWAYS)
+        m_writer->Wake();
+}
+
+// write out and flush the buffered lines, in the writer thread or the
+// caller's; true on error
+bool GuidingLog::WriteBuffer(void)
+{
+    // the file lock is taken first so that lines taken by different threads
+    // are written in the order they were buffered
+    wxCriticalSectionLocker lock(m_fileLock);
+
+    wxString buf;
+    {
+        wxCriticalSectionLocker blk(m_bufLock);
+        if (m_buf.empty())
+            return false;
+        buf.swap(m_buf);
+    }
+
+    if (!m_file.IsOpened())
+        return false;
+
+    bool err = !m_file.Write(buf) || !m_file.Flush();
+    if (err && m_writeErrors++ == 0)
+        Debug.Write(wxString::Format("GuideLog: unable to write %s\n", m_fileName));
+    return err;
 }
 
 bool GuidingLog::EnableLogging(void)
@@ -70,11 +210,23 @@ bool GuidingLog::EnableLogging(void)
                 throw ERROR_INFO("unable to open file");
             }
             m_keepFile = false;             // Don't keep it until something meaningful is logged
+            m_writeErrors = 0;
+
+            if (pConfig->Global.GetBoolean("/GuideLogBinary", false))
+            {
+                wxFileName fn(m_fileName);
+                fn.SetExt("bin");
+                if (m_binFile.Open(fn.GetFullPath()))
+                    Debug.AddLine("GuideLog: unable to open binary log " + fn.GetFullPath());
+            }
         }
 
         assert(m_file.IsOpened());
 
-        m_file.Write(_T("PHD2 version ") FULLVER _T(", Log version ") GUIDELOG_VERSION _T(". Log enabled at ") +
+        if (!m_writer)
+            StartWriter();
+
+        Write(GLB_EV_LOG_ENABLED, _T("PHD2 version ") FULLVER _T(", Log version ") GUIDELOG_VERSION _T(". Log enabled at ") +
             now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
         Flush();
 
@@ -113,9 +265,8 @@ void GuidingLog::DisableLogging(void)
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Log disabled at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
-    Flush();
+    Write(GLB_EV_LOG_DISABLED, "\nLog disabled at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Sync();
     m_enabled = false;
 
     // persist state
@@ -146,7 +297,18 @@ bool GuidingLog::ChangeDirLog(const wxString& newdir)
 
 void GuidingLog::RemoveOldFiles()
 {
-    Logger::RemoveMatchingFiles("PHD2_GuideLog*.txt", RetentionPeriod);
+    Logger::RemoveMatchingFiles("PHD2_GuideLog*.txt*", RetentionPeriod);
+    Logger::RemoveMatchingFiles("PHD2_GuideLog*.bin*", RetentionPeriod);
+
+    wxString binFile;
+    if (m_file.IsOpened())
+    {
+        wxFileName fn(m_fileName);
+        fn.SetExt("bin");
+        binFile = fn.GetFullPath();
+    }
+    Logger::CompressMatchingFiles("PHD2_GuideLog*.txt", m_file.IsOpened() ? m_fileName : wxString());
+    Logger::CompressMatchingFiles("PHD2_GuideLog*.bin", binFile);
 }
 
 bool GuidingLog::Flush(void)
@@ -154,46 +316,93 @@ bool GuidingLog::Flush(void)
     if (!m_enabled)
         return false;
 
-    bool bError = false;
+    assert(m_file.IsOpened());
 
-    try
-    {
-        assert(m_file.IsOpened());
+    m_binFile.Flush();
+
+    if (!m_writer)
+        return WriteBuffer();
+
+    if (m_flushPolicy != GUIDELOG_FLUSH_INTERVAL)
+        m_writer->Wake();
+
+    return false;
+}
 
-        if (!m_file.Flush())
+bool GuidingLog::Sync(void)
+{
+    if (!m_file.IsOpened())
+        return false;
+
+    m_binFile.Flush();
+    return WriteBuffer();
+}
+
+void GuidingLog::EmergencyFlush(void)
+{
+    // called when the process is crashing: the crashing thread may hold either
+    // lock, so give up rather than wait for them
+    if (!m_fileLock.TryEnter())
+        return;
+
+    if (m_bufLock.TryEnter())
+    {
+        if (m_file.IsOpened())
         {
-            throw ERROR_INFO("unable to flush file");
+            m_file.Write(m_buf);
+            m_file.Flush();
         }
-    }
-    catch (wxString Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
+        m_buf.clear();
+        m_bufLock.Leave();
     }
 
-    return bError;
+    m_fileLock.Leave();
 }
 
 void GuidingLog::Close(void)
 {
     if (!m_enabled)
+    {
+        StopWriter();
+        Sync();
         return;
+    }
 
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Log closed at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
-    Flush();
+    Write(GLB_EV_LOG_CLOSED, "\nLog closed at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    StopWriter();
+    Sync();
+    if (m_fsyncOnClose)
+        SyncToDisk(m_file);
     m_file.Close();
     m_enabled = false;
 
+    bool binary = m_binFile.IsOpened();
+    m_binFile.Close();
+
     if (!m_keepFile)            // Delete the file if nothing useful was logged
     {
         wxRemove(m_fileName);
+        if (binary)
+        {
+            wxFileName fn(m_fileName);
+            fn.SetExt("bin");
+            wxRemove(fn.GetFullPath());
+        }
     }
 }
 
+void GuidingLog::Write(GuideLogBinEvent ev, const wxString& str)
+{
+    // guide steps still queued come first
+    StepFanOut.Drain(GuideStepFanOut::CONSUMER_LOG);
+
+    Append(str);
+    m_binFile.Event(ev, str);
+}
+
 static wxString PierSideStr(PierSide p)
 {
     switch (p)
@@ -233,10 +442,10 @@ static wxString RotatorPosStr(void)
 static wxString PointingInfo()
 {
     double cur_ra, cur_dec, cur_st;
-    if (pPointingSource && !pPointingSource->GetCoordinates(&cur_ra, &cur_dec, &cur_st))
+    if (pPointingSource && !PointingCache::GetCoordinates(&cur_ra, &cur_dec, &cur_st))
     {
         return wxString::Format("Dec = %0.1f deg, Hour angle = %0.2f hr, Pier side = %s, Rotator pos = %s",
-            cur_dec, HourAngle(cur_ra, cur_st), PierSideStr(pPointingSource->SideOfPier()), RotatorPosStr());
+            cur_dec, HourAngle(cur_ra, cur_st), PierSideStr(PointingCache::SideOfPier()), RotatorPosStr());
     }
     else
     {
@@ -254,35 +463,34 @@ void GuidingLog::StartCalibration(Mount *pCalibrationMount)
     assert(m_file.IsOpened());
     wxDateTime now = wxDateTime::Now();
 
-    m_file.Write("\n");
-    m_file.Write("Calibration Begins at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
-    m_file.Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
+    Write(GLB_EV_CALIBRATION_BEGINS, "\nCalibration Begins at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write(GLB_EV_TEXT, "Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
 
     assert(pCalibrationMount && pCalibrationMount->IsConnected());
 
     if (pCamera)
     {
         // phdlab v0.5.3 expects camera name on a line by itself
-        m_file.Write(wxString::Format("Camera = %s\nExposure = %s\n",
+        Write(GLB_EV_TEXT, wxString::Format("Camera = %s\nExposure = %s\n",
             pCamera->Name, pFrame->ExposureDurationSummary()));
     }
-    m_file.Write(pFrame->PixelScaleSummary() + "\n");
+    Write(GLB_EV_TEXT, pFrame->PixelScaleSummary() + "\n");
 
-    m_file.Write("Mount = " + pCalibrationMount->Name());
+    Write(GLB_EV_TEXT, "Mount = " + pCalibrationMount->Name());
     wxString calSettings = pCalibrationMount->CalibrationSettingsSummary();
     if (!calSettings.IsEmpty())
-        m_file.Write(", " + calSettings);
-    m_file.Write("\n");
+        Write(GLB_EV_TEXT, ", " + calSettings);
+    Write(GLB_EV_TEXT, "\n");
 
-    m_file.Write(wxString::Format("%s\n", PointingInfo()));
+    Write(GLB_EV_TEXT, wxString::Format("%s\n", PointingInfo()));
 
-    m_file.Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f, HFD = %.2f px\n",
+    Write(GLB_EV_TEXT, wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f, HFD = %.2f px\n",
                 pFrame->pGuider->LockPosition().X,
                 pFrame->pGuider->LockPosition().Y,
                 pFrame->pGuider->CurrentPosition().X,
                 pFrame->pGuider->CurrentPosition().Y, 
                 pFrame->pGuider->HFD()));
-    m_file.Write("Direction,Step,dx,dy,x,y,Dist\n");
+    Write(GLB_EV_TEXT, "Direction,Step,dx,dy,x,y,Dist\n");
     Flush();
 
     m_keepFile = true;
@@ -296,7 +504,7 @@ void GuidingLog::CalibrationFailed(Mount *pCalibrationMount, const wxString& msg
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(msg); m_file.Write("\n");
+    Write(GLB_EV_CALIBRATION_END, msg + "\n");
     Flush();
 }
 
@@ -308,7 +516,7 @@ void GuidingLog::CalibrationStep(Mount *pCalibrationMount, const wxString& direc
 
     assert(m_file.IsOpened());
     // Direction,Step,dx,dy,x,y,Dist
-    m_file.Write(wxString::Format("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+    Write(GLB_EV_CALIBRATION_STEP, wxString::Format("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
         direction,
         steps,
         dx, dy,
@@ -323,7 +531,7 @@ void GuidingLog::CalibrationDirectComplete(Mount *pCalibrationMount, const wxStr
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(wxString::Format("%s calibration complete. Angle = %.1f deg, Rate = %.3f px/sec, Parity = %s\n",
+    Write(GLB_EV_CALIBRATION_END, wxString::Format("%s calibration complete. Angle = %.1f deg, Rate = %.3f px/sec, Parity = %s\n",
         direction, degrees(angle), rate * 1000.0, ParityStr(parity)));
     Flush();
 }
@@ -336,7 +544,7 @@ void GuidingLog::CalibrationComplete(Mount *pCalibrationMount)
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write(wxString::Format("Calibration complete, mount = %s.\n", pCalibrationMount->Name()));
+    Write(GLB_EV_CALIBRATION_END, wxString::Format("Calibration complete, mount = %s.\n", pCalibrationMount->Name()));
     Flush();
 }
 
@@ -349,8 +557,8 @@ void GuidingLog::StartGuiding()
 
     assert(m_file.IsOpened());
 
-    m_file.Write("\n");
-    m_file.Write("Guiding Begins at " + pFrame->m_guidingStarted.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    m_binFile.GuidingStarted(pFrame->m_guidingStarted);
+    Write(GLB_EV_GUIDING_BEGINS, "\nGuiding Begins at " + pFrame->m_guidingStarted.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
     m_keepFile = true;
 
     // add common guiding header
@@ -365,39 +573,50 @@ void GuidingLog::StopGuiding(void)
         return;
 
     assert(m_file.IsOpened());
-    m_file.Write("Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    Write(GLB_EV_GUIDING_ENDS, "Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+}
+
+// written after the end of guiding, from GuidingPerfReport::Format
+void GuidingLog::PerformanceSummary(const wxString& lines)
+{
+    if (!m_enabled)
+        return;
+
+    assert(m_file.IsOpened());
+    Write(GLB_EV_TEXT, lines);
+    Flush();
 }
 
 void GuidingLog::GuidingHeader(void)
     // output guiding header to log file
 {
-    m_file.Write(pFrame->GetSettingsSummary());
-    m_file.Write(pFrame->pGuider->GetSettingsSummary());
+    Write(GLB_EV_TEXT, pFrame->GetSettingsSummary());
+    Write(GLB_EV_TEXT, pFrame->pGuider->GetSettingsSummary());
 
-    m_file.Write("Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
+    Write(GLB_EV_TEXT, "Equipment Profile = " + pConfig->GetCurrentProfile() + "\n");
 
     if (pCamera)
     {
-        m_file.Write(pCamera->GetSettingsSummary());
-        m_file.Write("Exposure = " + pFrame->ExposureDurationSummary() + "\n");
+        Write(GLB_EV_TEXT, pCamera->GetSettingsSummary());
+        Write(GLB_EV_TEXT, "Exposure = " + pFrame->ExposureDurationSummary() + "\n");
     }
 
     if (pMount)
-        m_file.Write(pMount->GetSettingsSummary());
+        Write(GLB_EV_TEXT, pMount->GetSettingsSummary());
 
     if (pSecondaryMount)
-        m_file.Write(pSecondaryMount->GetSettingsSummary());
+        Write(GLB_EV_TEXT, pSecondaryMount->GetSettingsSummary());
 
-    m_file.Write(wxString::Format("%s\n", PointingInfo()));
+    Write(GLB_EV_TEXT, wxString::Format("%s\n", PointingInfo()));
 
-    m_file.Write(wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f, HFD = %.2f px\n",
+    Write(GLB_EV_TEXT, wxString::Format("Lock position = %.3f, %.3f, Star position = %.3f, %.3f, HFD = %.2f px\n",
                 pFrame->pGuider->LockPosition().X,
                 pFrame->pGuider->LockPosition().Y,
                 pFrame->pGuider->CurrentPosition().X,
                 pFrame->pGuider->CurrentPosition().Y,
                 pFrame->pGuider->HFD()));
 
-    m_file.Write("Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n");
+    Write(GLB_EV_TEXT, "Frame,Time,mount,dx,dy,RARawDistance,DECRawDistance,RAGuideDistance,DECGuideDistance,RADuration,RADirection,DECDuration,DECDirection,XStep,YStep,StarMass,SNR,ErrorCode\n");
 
     Flush();
 }
@@ -409,30 +628,62 @@ void GuidingLog::GuideStep(const GuideStepInfo& step)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
+    Append(wxString::Format("%d,%.3f,\"%s\",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,",
         step.frameNumber, step.time,
         step.mount->IsStepGuider() ? "AO" : "Mount",
         step.cameraOffset.X, step.cameraOffset.Y,
         step.mountOffset.X, step.mountOffset.Y,
         step.guideDistanceRA, step.guideDistanceDec));
 
+    GuideLogBinStep rec;
+    memset(&rec, 0, sizeof(rec));
+
     if (step.mount->IsStepGuider())
     {
         int xSteps = step.directionRA == LEFT ? -step.durationRA : step.durationRA;
         int ySteps = step.directionDec == DOWN ? -step.durationDec : step.durationDec;
-        m_file.Write(wxString::Format(",,,,%d,%d,", xSteps, ySteps));
+        Append(wxString::Format(",,,,%d,%d,", xSteps, ySteps));
+
+        rec.kind = GLB_STEP_AO;
+        rec.raDuration = xSteps;
+        rec.decDuration = ySteps;
     }
     else
     {
-        m_file.Write(wxString::Format("%d,%s,%d,%s,,,",
+        Append(wxString::Format("%d,%s,%d,%s,,,",
             step.durationRA, step.durationRA > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION)step.directionRA) : "",
             step.durationDec, step.durationDec > 0 ? step.mount->DirectionChar((GUIDE_DIRECTION)step.directionDec): ""));
+
+        rec.kind = GLB_STEP_MOUNT;
+        rec.raDuration = step.durationRA;
+        rec.decDuration = step.durationDec;
+        if (step.durationRA > 0)
+            rec.raDir = step.mount->DirectionChar((GUIDE_DIRECTION)step.directionRA)[0];
+        if (step.durationDec > 0)
+            rec.decDir = step.mount->DirectionChar((GUIDE_DIRECTION)step.directionDec)[0];
     }
 
-    m_file.Write(wxString::Format("%.f,%.2f,%d\n",
+    Append(wxString::Format("%.f,%.2f,%d\n",
             step.starMass, step.starSNR, step.starError));
 
-    Flush();
+    if (m_binFile.IsOpened())
+    {
+        rec.time = step.time;
+        rec.frame = step.frameNumber;
+        rec.dx = step.cameraOffset.X;
+        rec.dy = step.cameraOffset.Y;
+        rec.raRaw = step.mountOffset.X;
+        rec.decRaw = step.mountOffset.Y;
+        rec.raGuide = step.guideDistanceRA;
+        rec.decGuide = step.guideDistanceDec;
+        rec.starMass = step.starMass;
+        rec.starSNR = step.starSNR;
+        rec.avgDist = step.avgDist;
+        rec.starError = step.starError;
+        m_binFile.Step(rec);
+    }
+
+    StepLogged();
 }
 
 void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
@@ -442,10 +693,26 @@ void GuidingLog::FrameDropped(const FrameDroppedInfo& info)
 
     assert(m_file.IsOpened());
 
-    m_file.Write(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n",
+    StepFanOut.Drain(GuideStepFanOut::CONSUMER_LOG);
+
+    Append(wxString::Format("%d,%.3f,\"DROP\",,,,,,,,,,,,,%.f,%.2f,%d,\"%s\"\n",
         info.frameNumber, info.time, info.starMass, info.starSNR, info.starError, info.status));
 
-    Flush();
+    if (m_binFile.IsOpened())
+    {
+        GuideLogBinStep rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.kind = GLB_STEP_DROPPED;
+        rec.time = info.time;
+        rec.frame = info.frameNumber;
+        rec.starMass = info.starMass;
+        rec.starSNR = info.starSNR;
+        rec.avgDist = info.avgDist;
+        rec.starError = info.starError;
+        m_binFile.Step(rec, info.status);
+    }
+
+    StepLogged();
 }
 
 void GuidingLog::NotifyGuidingDithered(Guider *guider, double dx, double dy)
@@ -453,14 +720,27 @@ void GuidingLog::NotifyGuidingDithered(Guider *guider, double dx, double dy)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: DITHER by %.3f, %.3f, new lock pos = %.3f, %.3f\n",
+    Write(GLB_EV_DITHER, wxString::Format("INFO: DITHER by %.3f, %.3f, new lock pos = %.3f, %.3f\n",
         dx, dy, guider->LockPosition().X, guider->LockPosition().Y));
     Flush();
 }
 
 void GuidingLog::NotifySettlingStateChange(const wxString& msg)
 {
-    m_file.Write(wxString::Format("INFO: SETTLING STATE CHANGE, %s\n", msg));
+    Write(GLB_EV_SETTLING, wxString::Format("INFO: SETTLING STATE CHANGE, %s\n", msg));
+    Flush();
+}
+
+void GuidingLog::NotifyPolarAlignEstimate(const PolarDriftEstimate& est)
+{
+    if (!m_enabled || !m_isGuiding)
+        return;
+
+    wxString pointing;
+    if (est.haveCoords)
+        pointing = wxString::Format(", Dec = %.1f deg, HA = %.2f hr", est.declination, est.hourAngle);
+    Write(GLB_EV_POLAR_ALIGN, wxString::Format("INFO: POLAR ALIGNMENT ESTIMATE, error = %.1f arc-min, Dec drift = %.3f px/min over %.1f min%s\n",
+        est.polarAlignError, est.decDriftRate, est.span, pointing));
     Flush();
 }
 
@@ -469,7 +749,7 @@ void GuidingLog::NotifySetLockPosition(Guider *guider)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: SET LOCK POSITION, new lock pos = %.3f, %.3f\n",
+    Write(GLB_EV_LOCK_POSITION, wxString::Format("INFO: SET LOCK POSITION, new lock pos = %.3f, %.3f\n",
         guider->LockPosition().X, guider->LockPosition().Y));
     m_keepFile = true;
     Flush();
@@ -491,7 +771,7 @@ void GuidingLog::NotifyLockShiftParams(const LockPosShiftParams& shiftParams, co
                                     cameraRate.IsValid() ? cameraRate.X * 3600.0 : 0.0,
                                     cameraRate.IsValid() ? cameraRate.Y * 3600.0 : 0.0);
     }
-    m_file.Write(wxString::Format("INFO: LOCK SHIFT, enabled = %d %s\n", shiftParams.shiftEnabled, details));
+    Write(GLB_EV_LOCK_SHIFT, wxString::Format("INFO: LOCK SHIFT, enabled = %d %s\n", shiftParams.shiftEnabled, details));
     m_keepFile = true;
     Flush();
 }
@@ -501,7 +781,7 @@ void GuidingLog::ServerCommand(Guider *guider, const wxString& cmd)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Server received %s\n", cmd));
+    Write(GLB_EV_SERVER_COMMAND, wxString::Format("INFO: Server received %s\n", cmd));
     m_keepFile = true;
     Flush();
 }
@@ -526,7 +806,7 @@ void GuidingLog::SetGuidingParam(const wxString& name, const wxString& val)
     if (!m_enabled || !m_isGuiding)
         return;
 
-    m_file.Write(wxString::Format("INFO: Guiding parameter change, %s = %s\n", name, val));
+    Write(GLB_EV_PARAM_CHANGE, wxString::Format("INFO: Guiding parameter change, %s = %s\n", name, val));
     m_keepFile = true;
     Flush();
 }
@@ -41,6 +41,7 @@
 class Mount;
 class Guider;
 struct LockPosShiftParams;
+struct PolarDriftEstimate;
 
 struct GuideStepInfo
 {
@@ -78,16 +79,58 @@ struct FrameDroppedInfo
     wxString status;
 };
 
+class GuideLogWriter;
+
+// When to write the text log to the disk. The lines are collected in memory
+// and written by a background writer thread so the guide thread never waits
+// on the disk; the policy decides when the writer runs:
+//
+//   GUIDELOG_FLUSH_ALWAYS    after every line, as soon as the writer can
+//   GUIDELOG_FLUSH_INTERVAL  every /GuideLog/FlushIntervalSec seconds
+//   GUIDELOG_FLUSH_EVENTS    every interval and after every logged event
+//                            (calibration, dither, settling, ...) but not
+//                            after each guide step
+//
+// With any policy the buffer is written once it holds /GuideLog/FlushBytes,
+// and synchronously on alerts and fatal exceptions. /GuideLog/FsyncOnClose
+// also commits the file to the disk when it is closed.
+enum GuideLogFlushPolicy
+{
+    GUIDELOG_FLUSH_ALWAYS,
+    GUIDELOG_FLUSH_INTERVAL,
+    GUIDELOG_FLUSH_EVENTS,
+};
+
 class GuidingLog : public Logger
 {
     bool m_enabled;
     wxFFile m_file;
     wxString m_fileName;
+    GuideLogBinaryWriter m_binFile;     // optional, see guidelog_binary.h
     bool m_keepFile;
     bool m_isGuiding;
 
+    wxCriticalSection m_fileLock;       // protects m_file
+    wxCriticalSection m_bufLock;        // protects m_buf
+    wxString m_buf;                     // lines not yet written to m_file
+    unsigned int m_writeErrors;
+    GuideLogWriter *m_writer;           // NULL: lines are written synchronously
+    GuideLogFlushPolicy m_flushPolicy;
+    int m_flushIntervalMs;
+    size_t m_flushBytes;
+    bool m_fsyncOnClose;
+
+    void StartWriter(void);
+    void StopWriter(void);
+    void Append(const wxString& str);
+    void StepLogged(void);
+    bool WriteBuffer(void);
+
+    friend class GuideLogWriter;
+
 protected:
     void GuidingHeader(void);
+    void Write(GuideLogBinEvent ev, const wxString& str);   // to both logs
 
 public:
     GuidingLog(void);
@@ -97,7 +140,9 @@ public:
     bool EnableLogging(bool enabled);
     void DisableLogging(void);
     bool IsEnabled(void) const;
-    bool Flush(void);
+    bool Flush(void);               // an event boundary, see GuideLogFlushPolicy
+    bool Sync(void);                // write out everything buffered, in the calling thread
+    void EmergencyFlush(void);      // best-effort flush from a fatal exception handler
     void Close(void);
 
     void StartCalibration(Mount *pCalibrationMount);
@@ -110,12 +155,14 @@ public:
     void StopGuiding();
     void GuideStep(const GuideStepInfo& info);
     void FrameDropped(const FrameDroppedInfo& info);
+    void PerformanceSummary(const wxString& lines);
 
     void ServerCommand(Guider *guider, const wxString& cmd);
     void NotifyGuidingDithered(Guider *guider, double dx, double dy);
     void NotifySetLockPosition(Guider *guider);
     void NotifyLockShiftParams(const LockPosShiftParams& shiftParams, const PHD_Point& cameraRate);
     void NotifySettlingStateChange(const wxString& msg);
+    void NotifyPolarAlignEstimate(const PolarDriftEstimate& est);
 
     void SetGuidingParam(const wxString& name, double val);
     void SetGuidingParam(const wxString& name, int val);
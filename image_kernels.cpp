@@ -0,0 +1,163 @@
+/*
+ *  image_kernels.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+# define CPU_X86
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# else
+#  include <cpuid.h>
+# endif
+#elif defined(__arm__) && defined(__linux__)
+# include <sys/auxv.h>
+#endif
+
+#if defined(CPU_X86)
+
+static void cpuid(unsigned int leaf, unsigned int r[4])
+{
+#if defined(_MSC_VER)
+    int v[4];
+    __cpuidex(v, (int) leaf, 0);
+    for (int i = 0; i < 4; i++)
+        r[i] = (unsigned int) v[i];
+#else
+    __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// the register state the OS saves on a context switch
+static unsigned long long xcr0(void)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0)); // xgetbv
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+#endif
+
+unsigned int DetectCpuFeatures(void)
+{
+    unsigned int features = 0;
+
+#if defined(CPU_X86)
+    unsigned int r[4];
+    cpuid(0, r);
+    unsigned int const maxLeaf = r[0];
+
+    cpuid(1, r);
+    unsigned int const ecx1 = r[2], edx1 = r[3];
+    if (edx1 & (1 << 26))
+        features |= CPU_SSE2;
+    if (ecx1 & (1 << 9))
+        features |= CPU_SSSE3;
+    if (ecx1 & (1 << 19))
+        features |= CPU_SSE41;
+
+    // the AVX registers are only usable if the OS saves them (OSXSAVE, then
+    // the YMM state in XCR0; for AVX-512 also the opmask and ZMM state)
+    if ((ecx1 & (1 << 27)) && (ecx1 & (1 << 28)) && maxLeaf >= 7)
+    {
+        unsigned long long const xcr = xcr0();
+        cpuid(7, r);
+        unsigned int const ebx7 = r[1];
+        if ((xcr & 0x6) == 0x6 && (ebx7 & (1 << 5)))
+            features |= CPU_AVX2;
+        if ((xcr & 0xe6) == 0xe6 && (ebx7 & (1 << 16)) && (ebx7 & (1 << 30)))
+            features |= CPU_AVX512;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    features |= CPU_NEON;
+#elif defined(__arm__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & (1 << 12))    // HWCAP_NEON
+        features |= CPU_NEON;
+#endif
+
+    return features;
+}
+
+static wxString FeatureNames(unsigned int features)
+{
+    static const struct { unsigned int feature; const char *name; } names[] =
+    {
+        { CPU_SSE2, "SSE2" },
+        { CPU_SSSE3, "SSSE3" },
+        { CPU_SSE41, "SSE4.1" },
+        { CPU_AVX2, "AVX2" },
+        { CPU_AVX512, "AVX-512" },
+        { CPU_NEON, "NEON" },
+    };
+
+    wxString s;
+    for (size_t i = 0; i < WXSIZEOF(names); i++)
+        if (features & names[i].feature)
+            s += wxString(" ") + names[i].name;
+    return s.empty() ? wxString(" none") : s;
+}
+
+void SelectImageKernels(const wxString& choice)
+{
+    unsigned int const features = DetectCpuFeatures();
+
+    // the sets this CPU can run, best first
+    std::vector<ImageKernels> sets;
+    ImageKernels k;
+    if (GetAVX2ImageKernels(&k) && (features & CPU_AVX2))
+        sets.push_back(k);
+    if (GetNEONImageKernels(&k) && (features & CPU_NEON))
+        sets.push_back(k);
+    GetBaselineImageKernels(&k);
+    sets.push_back(k);
+
+    size_t pick = 0;
+    if (!choice.IsSameAs("auto", false))
+    {
+        while (pick < sets.size() && !choice.IsSameAs(sets[pick].isa, false))
+            ++pick;
+        if (pick == sets.size())
+        {
+            Debug.AddLine(wxString::Format("   image kernels %s requested but not available", choice));
+            pick = 0;
+        }
+    }
+
+    Kernels = sets[pick];
+
+    Debug.AddLine(wxString::Format("   image kernels %s, CPU features:%s", Kernels.isa, FeatureNames(features)));
+}
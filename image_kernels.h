@@ -0,0 +1,83 @@
+/*
+ *  image_kernels.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_KERNELS_INCLUDED
+#define IMAGE_KERNELS_INCLUDED
+
+// The image kernels with vector loops are built for the instruction set the
+// compiler targets and, in separate translation units, for AVX2 on x86 and
+// NEON on 32-bit ARM. SelectImageKernels detects the CPU's features at
+// startup and binds Kernels to the best set the CPU can run, so the same
+// binary uses AVX2 on a desktop and SSE2 on an Atom tablet. The choice can
+// be overridden with the ImageKernels setting for testing.
+//
+// This header is included by the kernel translation units, which are built
+// without phd.h, and must not depend on anything.
+
+enum { INTERPOLATE_BITS = 14, INTERPOLATE_ONE = 1 << INTERPOLATE_BITS };
+
+struct ImageKernels
+{
+    const char *isa;
+    void (*reconRow)(unsigned short *out, const unsigned short *r0, const unsigned short *r1, int n);
+    void (*median3Row)(unsigned short *out, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n);
+    void (*subtractDarkRow8)(unsigned short *pl, const unsigned char *src, const unsigned short *below, const unsigned short *above, unsigned int n);
+    void (*subtractDarkRow16)(unsigned short *pl, const unsigned short *src, const unsigned short *below, const unsigned short *above, unsigned int n);
+    void (*widenPixels)(unsigned short *dst, const unsigned char *src, unsigned int n);
+    unsigned long long (*accumulatePixels)(unsigned short *dst, const unsigned char *src, unsigned int n);
+    void (*narrowPixels)(unsigned short *dst, const int *src, unsigned int n);
+    void (*interpolatePixels)(unsigned short *dst, const unsigned short *a, const unsigned short *b, unsigned int weight, unsigned int n);
+    void (*stretchToRGB)(unsigned char *dst, const unsigned short *src, int n, const unsigned char *lut);
+};
+
+enum CPU_FEATURE
+{
+    CPU_SSE2 = 1 << 0,
+    CPU_SSSE3 = 1 << 1,
+    CPU_SSE41 = 1 << 2,
+    CPU_AVX2 = 1 << 3,
+    CPU_AVX512 = 1 << 4,    // AVX-512 F and BW, detected and reported but no kernels use it
+    CPU_NEON = 1 << 5,
+};
+
+// the kernels in use
+extern ImageKernels Kernels;
+
+// each returns false if that set was not built for this target
+extern bool GetBaselineImageKernels(ImageKernels *k);
+extern bool GetAVX2ImageKernels(ImageKernels *k);
+extern bool GetNEONImageKernels(ImageKernels *k);
+
+extern unsigned int DetectCpuFeatures(void);
+
+#endif
@@ -0,0 +1,585 @@
+/*
+ *  image_kernels_impl.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// The image kernels with vector loops. This file is compiled once for each
+// instruction set the kernels are built for: by image_math.cpp for the one
+// the compiler targets, and by image_kernels_<isa>.cpp for the newer ones
+// that are only used if the CPU has them (see image_kernels.h). It has no
+// include guard and everything in it has internal linkage, so each of those
+// translation units gets its own copy.
+//
+// Nothing here may use a function with external linkage other than
+// ImageMathReference: an inline function from a library header compiled with
+// AVX2 enabled could be the copy the linker keeps for the whole program.
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define HAVE_SSE2_INTRINSICS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+#endif
+#if defined(__SSSE3__) && !defined(__AVX2__)
+# include <tmmintrin.h>
+#endif
+#include <string.h>
+
+#if defined(__AVX2__)
+# define IMAGE_KERNELS_ISA "AVX2"
+#elif defined(HAVE_SSE2_INTRINSICS)
+# define IMAGE_KERNELS_ISA "SSE2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define IMAGE_KERNELS_ISA "NEON"
+#else
+# define IMAGE_KERNELS_ISA "scalar"
+#endif
+
+extern bool ImageMathReference();
+
+// Vector helpers for the 3x3 median and the luminance reconstruction, which
+// work on 16 bit unsigned lanes. Each kernel also has a scalar loop that
+// handles the tail of a row and serves as the reference implementation.
+#if defined(__AVX2__)
+
+# define HAVE_VEC16_INTRINSICS
+typedef __m256i vec16;
+enum { VEC16_LANES = 16 };
+inline static vec16 v16_load(const unsigned short *p) { return _mm256_loadu_si256((const __m256i *) p); }
+inline static void v16_store(unsigned short *p, vec16 v) { _mm256_storeu_si256((__m256i *) p, v); }
+inline static vec16 v16_min(vec16 a, vec16 b) { return _mm256_min_epu16(a, b); }
+inline static vec16 v16_max(vec16 a, vec16 b) { return _mm256_max_epu16(a, b); }
+// min/max ordered values need no adjustment
+inline static vec16 v16_load_ord(const unsigned short *p) { return v16_load(p); }
+inline static void v16_store_ord(unsigned short *p, vec16 v) { v16_store(p, v); }
+inline static vec16 v16_add(vec16 a, vec16 b) { return _mm256_add_epi16(a, b); }
+inline static vec16 v16_shr2(vec16 a) { return _mm256_srli_epi16(a, 2); }
+inline static vec16 v16_low2(vec16 a) { return _mm256_and_si256(a, _mm256_set1_epi16(3)); }
+
+#elif defined(HAVE_SSE2_INTRINSICS)
+
+# define HAVE_VEC16_INTRINSICS
+typedef __m128i vec16;
+enum { VEC16_LANES = 8 };
+inline static vec16 v16_load(const unsigned short *p) { return _mm_loadu_si128((const __m128i *) p); }
+inline static void v16_store(unsigned short *p, vec16 v) { _mm_storeu_si128((__m128i *) p, v); }
+// SSE2 only has signed 16 bit min/max, so values are offset by 0x8000 while
+// they are being ordered
+inline static vec16 v16_min(vec16 a, vec16 b) { return _mm_min_epi16(a, b); }
+inline static vec16 v16_max(vec16 a, vec16 b) { return _mm_max_epi16(a, b); }
+inline static vec16 v16_load_ord(const unsigned short *p) { return _mm_xor_si128(v16_load(p), _mm_set1_epi16((short) 0x8000)); }
+inline static void v16_store_ord(unsigned short *p, vec16 v) { v16_store(p, _mm_xor_si128(v, _mm_set1_epi16((short) 0x8000))); }
+inline static vec16 v16_add(vec16 a, vec16 b) { return _mm_add_epi16(a, b); }
+inline static vec16 v16_shr2(vec16 a) { return _mm_srli_epi16(a, 2); }
+inline static vec16 v16_low2(vec16 a) { return _mm_and_si128(a, _mm_set1_epi16(3)); }
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+# define HAVE_VEC16_INTRINSICS
+typedef uint16x8_t vec16;
+enum { VEC16_LANES = 8 };
+inline static vec16 v16_load(const unsigned short *p) { return vld1q_u16(p); }
+inline static void v16_store(unsigned short *p, vec16 v) { vst1q_u16(p, v); }
+inline static vec16 v16_min(vec16 a, vec16 b) { return vminq_u16(a, b); }
+inline static vec16 v16_max(vec16 a, vec16 b) { return vmaxq_u16(a, b); }
+inline static vec16 v16_load_ord(const unsigned short *p) { return v16_load(p); }
+inline static void v16_store_ord(unsigned short *p, vec16 v) { v16_store(p, v); }
+inline static vec16 v16_add(vec16 a, vec16 b) { return vaddq_u16(a, b); }
+inline static vec16 v16_shr2(vec16 a) { return vshrq_n_u16(a, 2); }
+inline static vec16 v16_low2(vec16 a) { return vandq_u16(a, vdupq_n_u16(3)); }
+
+#endif
+
+// out[i] = (r0[i] + r0[i + 1] + r1[i] + r1[i + 1]) / 4 for i in [0, n)
+static void recon_row(unsigned short *out, const unsigned short *r0, const unsigned short *r1, int n)
+{
+    int i = 0;
+
+#if defined(HAVE_VEC16_INTRINSICS)
+    int const nvec = ImageMathReference() ? 0 : n;
+    // the sum of four 16 bit values does not fit in a 16 bit lane, so the
+    // quarters and the remainders are summed separately; the result is exact
+    for (; i + VEC16_LANES <= nvec; i += VEC16_LANES)
+    {
+        vec16 a = v16_load(r0 + i);
+        vec16 b = v16_load(r0 + i + 1);
+        vec16 c = v16_load(r1 + i);
+        vec16 d = v16_load(r1 + i + 1);
+        vec16 q = v16_add(v16_add(v16_shr2(a), v16_shr2(b)), v16_add(v16_shr2(c), v16_shr2(d)));
+        vec16 r = v16_add(v16_add(v16_low2(a), v16_low2(b)), v16_add(v16_low2(c), v16_low2(d)));
+        v16_store(out + i, v16_add(q, v16_shr2(r)));
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        unsigned int t = r0[i];
+        t += r0[i + 1];
+        t += r1[i];
+        t += r1[i + 1];
+        out[i] = (unsigned short)(t >> 2);
+    }
+}
+
+inline static void swap(unsigned short& a, unsigned short& b)
+{
+    unsigned short const t = a;
+    a = b;
+    b = t;
+}
+
+inline static unsigned short median9(const unsigned short l[9])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
+    unsigned short x;
+    x = l[5];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+    x = l[6];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+    x = l[7];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+    x = l[8];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+
+    if (l1 > l0) l0 = l1;
+    if (l2 > l0) l0 = l2;
+    if (l3 > l0) l0 = l3;
+    if (l4 > l0) l0 = l4;
+
+    return l0;
+}
+
+#if defined(HAVE_VEC16_INTRINSICS)
+
+inline static void v16_sort2(vec16& a, vec16& b)
+{
+    vec16 const t = v16_min(a, b);
+    b = v16_max(a, b);
+    a = t;
+}
+
+inline static vec16 v16_med3(vec16 a, vec16 b, vec16 c)
+{
+    return v16_max(v16_min(a, b), v16_min(v16_max(a, b), c));
+}
+
+#endif
+
+// out[i] = median of the 3x3 neighborhood centered on column i + 1 of row r1,
+// for i in [0, n). With each column of three sorted into lo <= mid <= hi, the
+// median of the nine values is med3(max of the lo's, med3 of the mid's, min
+// of the hi's), which the vector loop computes for a full register of pixels
+// at once.
+static void median3_row(unsigned short *out, const unsigned short *r0, const unsigned short *r1, const unsigned short *r2, int n)
+{
+    int i = 0;
+
+#if defined(HAVE_VEC16_INTRINSICS)
+    int const nvec = ImageMathReference() ? 0 : n;
+    for (; i + VEC16_LANES <= nvec; i += VEC16_LANES)
+    {
+        vec16 lo[3], mid[3], hi[3];
+        for (int c = 0; c < 3; c++)
+        {
+            lo[c] = v16_load_ord(r0 + i + c);
+            mid[c] = v16_load_ord(r1 + i + c);
+            hi[c] = v16_load_ord(r2 + i + c);
+            v16_sort2(lo[c], mid[c]);
+            v16_sort2(mid[c], hi[c]);
+            v16_sort2(lo[c], mid[c]);
+        }
+        vec16 const maxLo = v16_max(v16_max(lo[0], lo[1]), lo[2]);
+        vec16 const minHi = v16_min(v16_min(hi[0], hi[1]), hi[2]);
+        vec16 const medMid = v16_med3(mid[0], mid[1], mid[2]);
+        v16_store_ord(out + i, v16_med3(maxLo, medMid, minHi));
+    }
+#endif
+
+    unsigned short a[9];
+    for (; i < n; i++)
+    {
+        a[0] = r0[i];
+        a[1] = r0[i + 1];
+        a[2] = r0[i + 2];
+        a[3] = r1[i];
+        a[4] = r1[i + 1];
+        a[5] = r1[i + 2];
+        a[6] = r2[i];
+        a[7] = r2[i + 1];
+        a[8] = r2[i + 2];
+        out[i] = median9(a);
+    }
+}
+
+// light = clamp(light - dark + pedestal, 0, 65535) for n pixels; at most one of
+// below[i] and above[i] is non-zero, so the two saturating steps are exact
+// 8-bit frames are widened to 16 bits as they are read, either on their own
+// or fused with dark subtraction so that an 8-bit frame makes one pass over
+// memory rather than two. The source may be the upper half of the
+// destination buffer: the pixels are converted front to back, and pixel i is
+// written to bytes 2i and 2i+1 only after byte N + i has been read.
+
+static void widen_pixels(unsigned short *dst, const unsigned char *src, unsigned int n)
+{
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= nvec; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i))));
+#elif defined(HAVE_SSE2_INTRINSICS)
+    __m128i const zero = _mm_setzero_si128();
+    for (; i + 8 <= nvec; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + i)), zero));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= nvec; i += 8)
+        vst1q_u16(dst + i, vmovl_u8(vld1_u8(src + i)));
+#endif
+
+    for (; i < n; i++)
+        dst[i] = src[i];
+}
+
+// Webcam drivers stack 8-bit video frames by adding each one into the 16-bit
+// guide frame as it arrives. The sum of the source pixels is returned so the
+// caller can skip black frames without a second pass.
+
+static unsigned long long accumulate_pixels(unsigned short *dst, const unsigned char *src, unsigned int n)
+{
+    unsigned long long sum = 0;
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    __m256i vsum = _mm256_setzero_si256();
+    for (; i + 32 <= nvec; i += 32)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        vsum = _mm256_add_epi64(vsum, _mm256_sad_epu8(s, _mm256_setzero_si256()));
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(s));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(s, 1));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epu16(lo, _mm256_loadu_si256((const __m256i *)(dst + i))));
+        _mm256_storeu_si256((__m256i *)(dst + i + 16), _mm256_adds_epu16(hi, _mm256_loadu_si256((const __m256i *)(dst + i + 16))));
+    }
+    unsigned long long lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, vsum);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(HAVE_SSE2_INTRINSICS)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i vsum = zero;
+    for (; i + 16 <= nvec; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        vsum = _mm_add_epi64(vsum, _mm_sad_epu8(s, zero));
+        __m128i lo = _mm_unpacklo_epi8(s, zero);
+        __m128i hi = _mm_unpackhi_epi8(s, zero);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu16(lo, _mm_loadu_si128((const __m128i *)(dst + i))));
+        _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_adds_epu16(hi, _mm_loadu_si128((const __m128i *)(dst + i + 8))));
+    }
+    unsigned long long lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, vsum);
+    sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint32x4_t vsum = vdupq_n_u32(0);
+    for (; i + 16 <= nvec; i += 16)
+    {
+        uint8x16_t s = vld1q_u8(src + i);
+        vsum = vpadalq_u16(vsum, vpaddlq_u8(s));
+        vst1q_u16(dst + i, vqaddq_u16(vmovl_u8(vget_low_u8(s)), vld1q_u16(dst + i)));
+        vst1q_u16(dst + i + 8, vqaddq_u16(vmovl_u8(vget_high_u8(s)), vld1q_u16(dst + i + 8)));
+    }
+    uint64x2_t vsum2 = vpaddlq_u32(vsum);
+    sum = vgetq_lane_u64(vsum2, 0) + vgetq_lane_u64(vsum2, 1);
+#endif
+
+    for (; i < n; i++)
+    {
+        unsigned int v = (unsigned int) dst[i] + src[i];
+        dst[i] = (unsigned short)(v > 65535 ? 65535 : v);
+        sum += src[i];
+    }
+
+    return sum;
+}
+
+// Drivers that deliver 32-bit pixels (the ASCOM ImageArray) narrow them into
+// the 16-bit guide frame. Each value keeps its low 16 bits, as a plain cast
+// would; the vector paths sign-extend the low half so that the saturating
+// pack never clamps.
+
+static void narrow_pixels(unsigned short *dst, const int *src, unsigned int n)
+{
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= nvec; i += 16)
+    {
+        __m256i a = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)(src + i)), 16), 16);
+        __m256i b = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)(src + i + 8)), 16), 16);
+        // the pack works within 128-bit lanes, put the quarters back in order
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8));
+    }
+#elif defined(HAVE_SSE2_INTRINSICS)
+    for (; i + 8 <= nvec; i += 8)
+    {
+        __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i *)(src + i)), 16), 16);
+        __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((const __m128i *)(src + i + 4)), 16), 16);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= nvec; i += 8)
+    {
+        uint16x4_t lo = vmovn_u32(vreinterpretq_u32_s32(vld1q_s32(src + i)));
+        uint16x4_t hi = vmovn_u32(vreinterpretq_u32_s32(vld1q_s32(src + i + 4)));
+        vst1q_u16(dst + i, vcombine_u16(lo, hi));
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = (unsigned short) src[i];
+}
+
+// dst = a + (b - a) * weight / INTERPOLATE_ONE, rounded. The vector loops work
+// on the values offset by 0x8000 so that the products fit the signed 16 bit
+// multiply-add; the offset comes out of the sum unchanged because the two
+// weights add up to INTERPOLATE_ONE.
+
+static void interpolate_pixels(unsigned short *dst, const unsigned short *a, const unsigned short *b, unsigned int weight, unsigned int n)
+{
+    unsigned int const wb = weight < INTERPOLATE_ONE ? weight : (unsigned int) INTERPOLATE_ONE;
+    unsigned int const wa = INTERPOLATE_ONE - wb;
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    __m256i const w = _mm256_set1_epi32((int)((wb << 16) | wa));
+    __m256i const bias = _mm256_set1_epi16((short) 0x8000);
+    __m256i const round = _mm256_set1_epi32(INTERPOLATE_ONE / 2);
+    for (; i + 16 <= nvec; i += 16)
+    {
+        __m256i va = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)), bias);
+        __m256i vb = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(b + i)), bias);
+        // unpack and pack both work within 128-bit lanes, so the order is kept
+        __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(va, vb), w), round), INTERPOLATE_BITS);
+        __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(va, vb), w), round), INTERPOLATE_BITS);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(_mm256_packs_epi32(lo, hi), bias));
+    }
+#elif defined(HAVE_SSE2_INTRINSICS)
+    __m128i const w = _mm_set1_epi32((int)((wb << 16) | wa));
+    __m128i const bias = _mm_set1_epi16((short) 0x8000);
+    __m128i const round = _mm_set1_epi32(INTERPOLATE_ONE / 2);
+    for (; i + 8 <= nvec; i += 8)
+    {
+        __m128i va = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)), bias);
+        __m128i vb = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(b + i)), bias);
+        __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(va, vb), w), round), INTERPOLATE_BITS);
+        __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(va, vb), w), round), INTERPOLATE_BITS);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(_mm_packs_epi32(lo, hi), bias));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint16x4_t const va4 = vdup_n_u16((unsigned short) wa);
+    uint16x4_t const vb4 = vdup_n_u16((unsigned short) wb);
+    for (; i + 8 <= nvec; i += 8)
+    {
+        uint16x8_t va = vld1q_u16(a + i);
+        uint16x8_t vb = vld1q_u16(b + i);
+        uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(va), va4), vget_low_u16(vb), vb4);
+        uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(va), va4), vget_high_u16(vb), vb4);
+        vst1q_u16(dst + i, vcombine_u16(vrshrn_n_u32(lo, INTERPOLATE_BITS), vrshrn_n_u32(hi, INTERPOLATE_BITS)));
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = (unsigned short)((a[i] * wa + b[i] * wb + INTERPOLATE_ONE / 2) >> INTERPOLATE_BITS);
+}
+
+static void subtract_dark_row(unsigned short *pl, const unsigned char *src, const unsigned short *below, const unsigned short *above, unsigned int n)
+{
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= nvec; i += 16)
+    {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + i)));
+        v = _mm256_adds_epu16(v, _mm256_loadu_si256((const __m256i *)(below + i)));
+        v = _mm256_subs_epu16(v, _mm256_loadu_si256((const __m256i *)(above + i)));
+        _mm256_storeu_si256((__m256i *)(pl + i), v);
+    }
+#elif defined(HAVE_SSE2_INTRINSICS)
+    __m128i const zero = _mm_setzero_si128();
+    for (; i + 8 <= nvec; i += 8)
+    {
+        __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + i)), zero);
+        v = _mm_adds_epu16(v, _mm_loadu_si128((const __m128i *)(below + i)));
+        v = _mm_subs_epu16(v, _mm_loadu_si128((const __m128i *)(above + i)));
+        _mm_storeu_si128((__m128i *)(pl + i), v);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= nvec; i += 8)
+    {
+        uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+        v = vqaddq_u16(v, vld1q_u16(below + i));
+        v = vqsubq_u16(v, vld1q_u16(above + i));
+        vst1q_u16(pl + i, v);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        unsigned int v = (unsigned int) src[i] + below[i];
+        if (v > 65535)
+            v = 65535;
+        pl[i] = (unsigned short)(v > above[i] ? v - above[i] : 0);
+    }
+}
+
+static void subtract_dark_row(unsigned short *pl, const unsigned short *src, const unsigned short *below, const unsigned short *above, unsigned int n)
+{
+    // src may be pl, for subtraction in place
+    unsigned int i = 0;
+    unsigned int const nvec = ImageMathReference() ? 0 : n;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= nvec; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        v = _mm256_adds_epu16(v, _mm256_loadu_si256((const __m256i *)(below + i)));
+        v = _mm256_subs_epu16(v, _mm256_loadu_si256((const __m256i *)(above + i)));
+        _mm256_storeu_si256((__m256i *)(pl + i), v);
+    }
+#elif defined(HAVE_SSE2_INTRINSICS)
+    for (; i + 8 <= nvec; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        v = _mm_adds_epu16(v, _mm_loadu_si128((const __m128i *)(below + i)));
+        v = _mm_subs_epu16(v, _mm_loadu_si128((const __m128i *)(above + i)));
+        _mm_storeu_si128((__m128i *)(pl + i), v);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 8 <= nvec; i += 8)
+    {
+        uint16x8_t v = vld1q_u16(src + i);
+        v = vqaddq_u16(v, vld1q_u16(below + i));
+        v = vqsubq_u16(v, vld1q_u16(above + i));
+        vst1q_u16(pl + i, v);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+        unsigned int v = (unsigned int) src[i] + below[i];
+        if (v > 65535)
+            v = 65535;
+        pl[i] = (unsigned short)(v > above[i] ? v - above[i] : 0);
+    }
+}
+
+// stretch n pixels through the lookup table, replicating each result into
+// the R, G and B bytes of dst
+static void stretch_to_rgb(unsigned char *dst, const unsigned short *src, int n, const unsigned char *lut)
+{
+    int i = 0;
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+    const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+    for (; i + 16 <= n; i += 16, src += 16, dst += 48)
+    {
+        unsigned char g[16];
+        for (int j = 0; j < 16; j++)
+            g[j] = lut[src[j]];
+        __m128i v = _mm_loadu_si128((const __m128i *) g);
+        _mm_storeu_si128((__m128i *) dst, _mm_shuffle_epi8(v, m0));
+        _mm_storeu_si128((__m128i *) (dst + 16), _mm_shuffle_epi8(v, m1));
+        _mm_storeu_si128((__m128i *) (dst + 32), _mm_shuffle_epi8(v, m2));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16, src += 16, dst += 48)
+    {
+        unsigned char g[16];
+        for (int j = 0; j < 16; j++)
+            g[j] = lut[src[j]];
+        uint8x16x3_t rgb;
+        rgb.val[0] = rgb.val[1] = rgb.val[2] = vld1q_u8(g);
+        vst3q_u8(dst, rgb);
+    }
+#endif
+
+    // SSE2 has no byte shuffle; instead write each pixel as a replicated 32-bit
+    // word and advance by 3 bytes, the next store overwriting the extra byte
+    for (; i < n - 1; i++, src++, dst += 3)
+    {
+        unsigned int w = (unsigned int) lut[*src] * 0x01010101U;
+        memcpy(dst, &w, 4);
+    }
+
+    if (i < n)
+    {
+        unsigned char d = lut[*src];
+        dst[0] = dst[1] = dst[2] = d;
+    }
+}
+
+static void GetImageKernels(ImageKernels *k)
+{
+    k->isa = IMAGE_KERNELS_ISA;
+    k->reconRow = recon_row;
+    k->median3Row = median3_row;
+    k->subtractDarkRow8 = subtract_dark_row;
+    k->subtractDarkRow16 = subtract_dark_row;
+    k->widenPixels = widen_pixels;
+    k->accumulatePixels = accumulate_pixels;
+    k->narrowPixels = narrow_pixels;
+    k->interpolatePixels = interpolate_pixels;
+    k->stretchToRGB = stretch_to_rgb;
+}
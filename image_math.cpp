@@ -1,1287 +1,2753 @@
-/*
- *  image_math.cpp
- *  PHD Guiding
- *
- *  Created by Craig Stark.
- *  Copyright (c) 2006-2010 Craig Stark.
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#include "phd.h"
-#include "image_math.h"
-
-#include <wx/wfstream.h>
-#include <wx/txtstrm.h>
-#include <wx/tokenzr.h>
-
-#include <algorithm>
-
-int dbl_sort_func (double *first, double *second)
-{
-    if (*first < *second)
-        return -1;
-    else if (*first > *second)
-        return 1;
-    return 0;
-}
-
-double CalcSlope(const ArrayOfDbl& y)
-{
-    // Does a linear regression to calculate the slope
-
-    int nn = (int) y.GetCount();
-
-    if (nn < 2)
-        return 0.;
-
-    double s_xy = 0.0;
-    double s_y = 0.0;
-
-    for (int x = 0; x < nn; x++)
-    {
-        s_xy += (double)(x + 1) * y[x];
-        s_y += y[x];
-    }
-
-    int sx = (nn * (nn + 1)) / 2;
-    int sxx = sx * (2 * nn + 1) / 3;
-    double s_x = (double) sx;
-    double s_xx = (double) sxx;
-    double n = (double) nn;
-    return (n * s_xy - (s_x * s_y)) / (n * s_xx - (s_x * s_x));
-}
-
-bool QuickLRecon(usImage& img)
-{
-    // Does a simple debayer of luminance data only -- sliding 2x2 window
-    usImage tmp;
-    if (tmp.Init(img.Size))
-    {
-        pFrame->Alert(_("Memory allocation error"));
-        return true;
-    }
-
-    int const W = img.Size.GetWidth();
-    int RX, RY, RW, RH;
-    if (img.Subframe.IsEmpty())
-    {
-        RX = RY = 0;
-        RW = img.Size.GetWidth();
-        RH = img.Size.GetHeight();
-    }
-    else
-    {
-        RX = img.Subframe.GetX();
-        RY = img.Subframe.GetY();
-        RW = img.Subframe.GetWidth();
-        RH = img.Subframe.GetHeight();
-        tmp.Clear();
-    }
-
-#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
-
-    unsigned short *d;
-    unsigned int t;
-
-    for (int y = 0; y <= RH - 2; y++)
-    {
-        d = &tmp.ImageData[IX(0, y)];
-
-        for (int x = 0; x <= RW - 2; x++)
-        {
-            t  = img.ImageData[IX(x    , y    )];
-            t += img.ImageData[IX(x + 1, y    )];
-            t += img.ImageData[IX(x    , y + 1)];
-            t += img.ImageData[IX(x + 1, y + 1)];
-            *d++ = (unsigned short)(t >> 2);
-        }
-
-        // last col
-        t  = img.ImageData[IX(RW - 1, y    )];
-        t += img.ImageData[IX(RW - 1, y + 1)];
-        *d = (unsigned short)(t >> 1);
-    }
-
-    // last row
-
-    d = &tmp.ImageData[IX(0, RH - 1)];
-
-    for (int x = 0; x <= RW - 2; x++)
-    {
-        t  = img.ImageData[IX(x    , RH - 1)];
-        t += img.ImageData[IX(x + 1, RH - 1)];
-        *d++ = (unsigned short)(t >> 1);
-    }
-
-    // bottom-right pixel
-    *d = img.ImageData[IX(RW - 1, RH - 1)];
-
-#undef IX
-
-    img.SwapImageData(tmp);
-    return false;
-}
-
-bool Median3(usImage& img)
-{
-    usImage tmp;
-    tmp.Init(img.Size);
-
-    bool err;
-
-    if (img.Subframe.IsEmpty())
-    {
-        err = Median3(tmp.ImageData, img.ImageData, img.Size, wxRect(img.Size));
-    }
-    else
-    {
-        tmp.Clear();
-        err = Median3(tmp.ImageData, img.ImageData, img.Size, img.Subframe);
-    }
-
-    img.SwapImageData(tmp);
-    return err;
-}
-
-inline static void swap(unsigned short& a, unsigned short& b)
-{
-    unsigned short const t = a;
-    a = b;
-    b = t;
-}
-
-inline static unsigned short median9(const unsigned short l[9])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
-    unsigned short x;
-    x = l[5];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-    x = l[6];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-    x = l[7];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-    x = l[8];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-
-    if (l1 > l0) l0 = l1;
-    if (l2 > l0) l0 = l2;
-    if (l3 > l0) l0 = l3;
-    if (l4 > l0) l0 = l4;
-
-    return l0;
-}
-
-inline static unsigned short median8(const unsigned short l[8])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
-    unsigned short x;
-
-    x = l[5];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-    x = l[6];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-    x = l[7];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    if (x < l4) swap(x, l4);
-
-    if (l2 > l0) swap(l2, l0);
-    if (l2 > l1) swap(l2, l1);
-
-    if (l3 > l0) swap(l3, l0);
-    if (l3 > l1) swap(l3, l1);
-
-    if (l4 > l0) swap(l4, l0);
-    if (l4 > l1) swap(l4, l1);
-
-    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median6(const unsigned short l[6])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
-    unsigned short x;
-
-    x = l[4];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-    x = l[5];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    if (x < l3) swap(x, l3);
-
-    if (l2 > l0) swap(l2, l0);
-    if (l2 > l1) swap(l2, l1);
-
-    if (l3 > l0) swap(l3, l0);
-    if (l3 > l1) swap(l3, l1);
-
-    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median5(const unsigned short l[5])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    unsigned short x;
-    x = l[3];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-    x = l[4];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-
-    if (l1 > l0) l0 = l1;
-    if (l2 > l0) l0 = l2;
-
-    return l0;
-}
-
-inline static unsigned short median4(const unsigned short l[4])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    unsigned short x;
-    x = l[3];
-    if (x < l0) swap(x, l0);
-    if (x < l1) swap(x, l1);
-    if (x < l2) swap(x, l2);
-
-    if (l2 > l0) swap(l2, l0);
-    if (l2 > l1) swap(l2, l1);
-
-    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
-}
-
-inline static unsigned short median3(const unsigned short l[3])
-{
-    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
-    if (l2 < l0) swap(l2, l0);
-    if (l2 < l1) swap(l2, l1);
-    if (l1 > l0) l0 = l1;
-    return l0;
-}
-
-bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
-{
-    int const W = size.GetWidth();
-    int const RX = rect.GetX();
-    int const RY = rect.GetY();
-    int const RW = rect.GetWidth();
-    int const RH = rect.GetHeight();
-
-    unsigned short a[9];
-    unsigned short *d;
-
-#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
-
-    // top row
-    d = &dst[IX(0, 0)];
-
-    // top-left corner
-    a[0] = src[IX(0, 0)];
-    a[1] = src[IX(1, 0)];
-    a[2] = src[IX(0, 1)];
-    a[3] = src[IX(1, 1)];
-    *d++ = median4(a);
-
-    // top row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, 0)];
-        a[1] = src[IX(x,     0)];
-        a[2] = src[IX(x + 1, 0)];
-        a[3] = src[IX(x - 1, 1)];
-        a[4] = src[IX(x,     1)];
-        a[5] = src[IX(x + 1, 1)];
-        *d++ = median6(a);
-    }
-
-    // top-right corner
-    a[0] = src[IX(RW - 2, 0)];
-    a[1] = src[IX(RW - 1, 0)];
-    a[2] = src[IX(RW - 2, 1)];
-    a[3] = src[IX(RW - 1, 1)];
-    *d = median4(a);
-
-    for (int y = 1; y <= RH - 2; y++)
-    {
-        d = &dst[IX(0, y)];
-
-        // leftmost pixel
-        a[0] = src[IX(0, y - 1)];
-        a[1] = src[IX(1, y - 1)];
-        a[2] = src[IX(0, y    )];
-        a[3] = src[IX(1, y    )];
-        a[4] = src[IX(0, y + 1)];
-        a[5] = src[IX(1, y + 1)];
-        *d++ = median6(a);
-
-        for (int x = 1; x <= RW - 2; x++)
-        {
-            a[0] = src[IX(x - 1, y - 1)];
-            a[1] = src[IX(x    , y - 1)];
-            a[2] = src[IX(x + 1, y - 1)];
-            a[3] = src[IX(x - 1, y    )];
-            a[4] = src[IX(x    , y    )];
-            a[5] = src[IX(x + 1, y    )];
-            a[6] = src[IX(x - 1, y + 1)];
-            a[7] = src[IX(x    , y + 1)];
-            a[8] = src[IX(x + 1, y + 1)];
-            *d++ = median9(a);
-        }
-
-        // rightmost pixel
-        a[0] = src[IX(RW - 2, y - 1)];
-        a[1] = src[IX(RW - 1, y - 1)];
-        a[2] = src[IX(RW - 2, y    )];
-        a[3] = src[IX(RW - 1, y    )];
-        a[4] = src[IX(RW - 2, y + 1)];
-        a[5] = src[IX(RW - 1, y + 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom row
-    d = &dst[IX(0, RH - 1)];
-
-    // bottom-left corner
-    a[0] = src[IX(0, RH - 2)];
-    a[1] = src[IX(1, RH - 2)];
-    a[2] = src[IX(0, RH - 1)];
-    a[3] = src[IX(1, RH - 1)];
-    *d++ = median4(a);
-
-    // bottom row middle pixels
-    for (int x = 1; x <= RW - 2; x++)
-    {
-        a[0] = src[IX(x - 1, RH - 2)];
-        a[1] = src[IX(x    , RH - 2)];
-        a[2] = src[IX(x + 1, RH - 2)];
-        a[3] = src[IX(x - 1, RH - 1)];
-        a[4] = src[IX(x    , RH - 1)];
-        a[5] = src[IX(x + 1, RH - 1)];
-        *d++ = median6(a);
-    }
-
-    // bottom-right corner
-    a[0] = src[IX(RW - 2, RH - 2)];
-    a[1] = src[IX(RW - 1, RH - 2)];
-    a[2] = src[IX(RW - 2, RH - 1)];
-    a[3] = src[IX(RW - 1, RH - 1)];
-    *d = median4(a);
-
-#undef IX
-
-    return false;
-}
-
-static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
-{
-    unsigned short array[8];
-    int const xsize = img.Size.GetWidth();
-    int const ysize = img.Size.GetHeight();
-
-    if (x > 0 && y > 0 && x < xsize - 1 && y < ysize - 1)
-    {
-        array[0] = img.ImageData[(x-1) + (y-1) * xsize];
-        array[1] = img.ImageData[(x)   + (y-1) * xsize];
-        array[2] = img.ImageData[(x+1) + (y-1) * xsize];
-        array[3] = img.ImageData[(x-1) + (y)   * xsize];
-        array[4] = img.ImageData[(x+1) + (y)   * xsize];
-        array[5] = img.ImageData[(x-1) + (y+1) * xsize];
-        array[6] = img.ImageData[(x)   + (y+1) * xsize];
-        array[7] = img.ImageData[(x+1) + (y+1) * xsize];
-        return median8(array);
-    }
-
-    if (x == 0 && y > 0 && y < ysize - 1)
-    {
-        // On left edge
-        array[0] = img.ImageData[(x)     + (y - 1) * xsize];
-        array[1] = img.ImageData[(x)     + (y + 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y)     * xsize];
-        array[4] = img.ImageData[(x + 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (x == xsize - 1 && y > 0 && y < ysize - 1)
-    {
-        // On right edge
-        array[0] = img.ImageData[(x)     + (y - 1) * xsize];
-        array[1] = img.ImageData[(x)     + (y + 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y - 1) * xsize];
-        array[3] = img.ImageData[(x - 1) + (y)     * xsize];
-        array[4] = img.ImageData[(x - 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (y == 0 && x > 0 && x < xsize - 1)
-    {
-        // On bottom edge
-        array[0] = img.ImageData[(x - 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x - 1) + (y + 1) * xsize];
-        array[2] = img.ImageData[(x)     + (y + 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y)     * xsize];
-        array[4] = img.ImageData[(x + 1) + (y + 1) * xsize];
-        return median5(array);
-    }
-
-    if (y == ysize - 1 && x > 0 && x < xsize - 1)
-    {
-        // On top edge
-        array[0] = img.ImageData[(x - 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x - 1) + (y - 1) * xsize];
-        array[2] = img.ImageData[(x)     + (y - 1) * xsize];
-        array[3] = img.ImageData[(x + 1) + (y)     * xsize];
-        array[4] = img.ImageData[(x + 1) + (y - 1) * xsize];
-        return median5(array);
-    }
-
-    if (x == 0 && y == 0)
-    {
-        // At lower left corner
-        array[0] = img.ImageData[(x + 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x)     + (y + 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y + 1) * xsize];
-    }
-    else if (x == 0 && y == ysize - 1)
-    {
-        // At upper left corner
-        array[0] = img.ImageData[(x + 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x)     + (y - 1) * xsize];
-        array[2] = img.ImageData[(x + 1) + (y - 1) * xsize];
-    }
-    else if (x == xsize - 1 && y == ysize - 1)
-    {
-        // At upper right corner
-        array[0] = img.ImageData[(x - 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x)     + (y - 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y - 1) * xsize];
-    }
-    else if (x == xsize - 1 && y == 0)
-    {
-        // At lower right corner
-        array[0] = img.ImageData[(x - 1) + (y)     * xsize];
-        array[1] = img.ImageData[(x)     + (y + 1) * xsize];
-        array[2] = img.ImageData[(x - 1) + (y + 1) * xsize];
-    }
-    else
-    {
-        // unreachable
-        return 0;
-    }
-
-    return median3(array);
-}
-
-bool SquarePixels(usImage& img, float xsize, float ysize)
-{
-    // Stretches one dimension to square up pixels
-    if (!img.ImageData)
-        return true;
-
-    if (xsize <= ysize)
-        return false;
-
-    // Move the existing data to a temp image
-    usImage tempimg;
-    if (tempimg.Init(img.Size))
-    {
-        pFrame->Alert(_("Memory allocation error"));
-        return true;
-    }
-    tempimg.SwapImageData(img);
-
-    // if X > Y, when viewing stock, Y is unnaturally stretched, so stretch X to match
-    double ratio = ysize / xsize;
-    int newsize = ROUND((double) tempimg.Size.GetWidth() / ratio);  // make new image correct size
-    img.Init(newsize,tempimg.Size.GetHeight());
-    unsigned short *optr = img.ImageData;
-    int linesize = tempimg.Size.GetWidth();  // size of an original line
-    for (int y = 0; y < img.Size.GetHeight(); y++)
-    {
-        for (int x = 0; x < newsize; x++, optr++)
-        {
-            double oldposition = x * ratio;
-            int ind1 = (unsigned int) floor(oldposition);
-            int ind2 = (unsigned int) ceil(oldposition);
-            if (ind2 > (tempimg.Size.GetWidth() - 1))
-                ind2 = tempimg.Size.GetWidth() - 1;
-            double weight = ceil(oldposition) - oldposition;
-            *optr = (unsigned short) (((float) *(tempimg.ImageData + y*linesize + ind1) * weight) + ((float) *(tempimg.ImageData + y*linesize + ind1) * (1.0 - weight)));
-        }
-    }
-
-    return false;
-}
-
-bool Subtract(usImage& light, const usImage& dark)
-{
-    if (!light.ImageData || !dark.ImageData)
-        return true;
-    if (light.Size != dark.Size)
-        return true;
-
-    unsigned int left, top, width, height;
-    if (!light.Subframe.IsEmpty())
-    {
-        left = light.Subframe.GetLeft();
-        width = light.Subframe.GetWidth();
-        top = light.Subframe.GetTop();
-        height = light.Subframe.GetHeight();
-    }
-    else
-    {
-        left = top = 0;
-        width = light.Size.GetWidth();
-        height = light.Size.GetHeight();
-    }
-
-    int mindiff = 65535;
-
-    unsigned short *pl0 = &light.Pixel(left, top);
-    const unsigned short *pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int diff = (int) *pl - (int) *pd;
-            if (diff < mindiff)
-                mindiff = diff;
-        }
-    }
-
-    int offset = 0;
-    if (mindiff < 0) // dark was lighter than light
-    {
-        offset = -mindiff;
-        light.Pedestal = (unsigned short) offset;
-    }
-
-    pl0 = &light.Pixel(left, top);
-    pd0 = &dark.Pixel(left, top);
-    for (unsigned int r = 0; r < height;
-         r++, pl0 += light.Size.GetWidth(), pd0 += light.Size.GetWidth())
-    {
-        unsigned short *const endl = pl0 + width;
-        unsigned short *pl;
-        const unsigned short *pd;
-        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
-        {
-            int newval = (int) *pl - (int) *pd + offset;
-            if (newval < 0) newval = 0; // shouldn't hit this...
-            else if (newval > 65535) newval = 65535;
-            *pl = (unsigned short) newval;
-        }
-    }
-
-    return false;
-}
-
-inline static unsigned short histo_median(unsigned short histo1[256], unsigned short histo2[65536], int n)
-{
-    n /= 2;
-    unsigned int i;
-    for (i = 0; i < 256; i++)
-    {
-        if (histo1[i] > n)
-            break;
-        n -= histo1[i];
-    }
-    for (i <<= 8; i < 65536; i++)
-    {
-        if (histo2[i] > n)
-            break;
-        n -= histo2[i];
-    }
-    return i;
-}
-
-static void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
-{
-    dst.Init(src.Size);
-    unsigned short *d = &dst.ImageData[0];
-
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
-
-    for (int y = 0; y < height; y++)
-    {
-        int top = std::max(0, y - halfWidth);
-        int bot = std::min(y + halfWidth, height - 1);
-        int left = 0;
-        int right = halfWidth;
-
-        // TODO: we initialize the histogram at the start of each row, but we could make this faster
-        // if we scan left to right, move down, scan right to left, move down so we never need to
-        // reinitialize the histogram
-
-        // initialize 2-level histogram
-        unsigned short histo1[256];
-        unsigned short histo2[65536];
-        memset(&histo1[0], 0, sizeof(histo1));
-        memset(&histo2[0], 0, sizeof(histo2));
-
-        for (int j = top; j <= bot; j++)
-        {
-            const unsigned short *p = &src.Pixel(left, j);
-            for (int i = left; i <= right; i++, p++)
-            {
-                ++histo1[*p >> 8];
-                ++histo2[*p];
-            }
-        }
-        unsigned int n = (right - left + 1) * (bot - top + 1);
-
-        // read off first value for this row
-        *d++ = histo_median(histo1, histo2, n);
-
-        // loop across remaining columns for this row
-        for (int i = 1; i < width; i++)
-        {
-            left = std::max(0, i - halfWidth);
-            right = std::min(i + halfWidth, width - 1);
-
-            // remove leftmost column
-            if (left > 0)
-            {
-                const unsigned short *p = &src.Pixel(left - 1, top);
-                for (int j = top; j <= bot; j++, p += width)
-                {
-                    --histo1[*p >> 8];
-                    --histo2[*p];
-                }
-                n -= (bot - top + 1);
-            }
-
-            // add new column on right
-            if (i + halfWidth <= width - 1)
-            {
-                const unsigned short *p = &src.Pixel(right, top);
-                for (int j = top; j <= bot; j++, p += width)
-                {
-                    ++histo1[*p >> 8];
-                    ++histo2[*p];
-                }
-                n += (bot - top + 1);
-            }
-
-            *d++ = histo_median(histo1, histo2, n);
-        }
-    }
-}
-
-struct ImageStatsWork
-{
-    ImageStats stats;
-    usImage temp;
-};
-
-static void GetImageStats(ImageStatsWork& w, const usImage& img, const wxRect& win)
-{
-    w.temp.Init(img.Size);
-
-    // Determine the mean and standard deviation
-    double sum = 0.0;
-    double a = 0.0;
-    double q = 0.0;
-    double k = 1.0;
-    double km1 = 0.0;
-
-    const unsigned short *p0 = &img.Pixel(win.GetLeft(), win.GetTop());
-    unsigned short *dst = &w.temp.ImageData[0];
-    for (int y = 0; y < win.GetHeight(); y++)
-    {
-        const unsigned short *end = p0 + win.GetWidth();
-        for (const unsigned short *p = p0; p < end; p++)
-        {
-            *dst++ = *p;
-            double const x = (double) *p;
-            sum += x;
-            double const a0 = a;
-            a += (x - a) / k;
-            q += (x - a0) * (x - a);
-            km1 = k;
-            k += 1.0;
-        }
-        p0 += img.Size.GetWidth();
-    }
-
-    w.stats.mean = sum / km1;
-    w.stats.stdev = sqrt(q / km1);
-
-    int winPixels = win.GetWidth() * win.GetHeight();
-    unsigned short *tmp = &w.temp.ImageData[0];
-    std::nth_element(tmp, tmp + winPixels / 2, tmp + winPixels);
-
-    w.stats.median = tmp[winPixels / 2];
-
-    // replace each pixel with the absolute deviation from the median
-    unsigned short *p = tmp;
-    for (int i = 0; i < winPixels; i++)
-    {
-        unsigned short ad = (unsigned short) std::abs((int) *p - (int) w.stats.median);
-        *p++ = ad;
-    }
-    std::nth_element(tmp, tmp + winPixels / 2, tmp + winPixels);
-    w.stats.mad = tmp[winPixels / 2];
-}
-
-void DefectMapDarks::BuildFilteredDark()
-{
-    enum { WINDOW = 15 };
-    filteredDark.Init(masterDark.Size);
-    MedianFilter(filteredDark, masterDark, WINDOW);
-}
-
-static wxString DefectMapMasterPath(int profileId)
-{
-    int inst = pFrame->GetInstanceNumber();
-    return MyFrame::GetDarksDir() + PATHSEPSTR +
-        wxString::Format("PHD2_defect_map_master%s_%d.fit", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
-}
-static wxString DefectMapMasterPath()
-{
-    return DefectMapMasterPath(pConfig->GetCurrentProfileId());
-}
-
-static wxString DefectMapFilterPath(int profileId)
-{
-    int inst = pFrame->GetInstanceNumber();
-    return MyFrame::GetDarksDir() + PATHSEPSTR +
-        wxString::Format("PHD2_defect_map_master_filt%s_%d.fit", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
-}
-static wxString DefectMapFilterPath()
-{
-    return DefectMapFilterPath(pConfig->GetCurrentProfileId());
-}
-
-void DefectMapDarks::SaveDarks(const wxString& notes)
-{
-    masterDark.Save(DefectMapMasterPath(), notes);
-    filteredDark.Save(DefectMapFilterPath());
-}
-
-void DefectMapDarks::LoadDarks()
-{
-    masterDark.Load(DefectMapMasterPath());
-    filteredDark.Load(DefectMapFilterPath());
-}
-
-struct BadPx
-{
-    unsigned short x;
-    unsigned short y;
-    int v;
-
-    BadPx();
-    BadPx(int x_, int y_, int v_) : x(x_), y(y_), v(v_) { }
-    bool operator<(const BadPx& rhs) const { return v < rhs.v; }
-};
-
-typedef std::set<BadPx> BadPxSet;
-
-struct DefectMapBuilderImpl
-{
-    DefectMapDarks *darks;
-    ImageStatsWork w;
-    wxArrayString mapInfo;
-    int aggrCold;
-    int aggrHot;
-    BadPxSet coldPx;
-    BadPxSet hotPx;
-    BadPxSet::const_iterator coldPxThresh;
-    BadPxSet::const_iterator hotPxThresh;
-    unsigned int coldPxSelected;
-    unsigned int hotPxSelected;
-    bool threshValid;
-
-    DefectMapBuilderImpl()
-        :
-        darks(0),
-        aggrCold(100),
-        aggrHot(100),
-        threshValid(false)
-    { }
-};
-
-DefectMapBuilder::DefectMapBuilder()
-    : m_impl(new DefectMapBuilderImpl())
-{
-}
-
-DefectMapBuilder::~DefectMapBuilder()
-{
-    delete m_impl;
-}
-
-inline static double AggrToSigma(int val)
-{
-    // Aggressiveness of 0 to 100 maps to signma factor from 8.0 to 0.125
-    return exp2(3.0 - (6.0 / 100.0) * (double)val);
-}
-
-void DefectMapBuilder::Init(DefectMapDarks& darks)
-{
-    m_impl->darks = &darks;
-
-    Debug.AddLine("DefectMapBuilder: Init");
-
-    ::GetImageStats(m_impl->w, darks.masterDark,
-        wxRect(0, 0, darks.masterDark.Size.GetWidth(), darks.masterDark.Size.GetHeight()));
-
-    const ImageStats& stats = m_impl->w.stats;
-
-    Debug.Write(wxString::Format("DefectMapBuilder: Dark N = %d Mean = %.f Median = %d Standard Deviation = %.f MAD=%d\n",
-                                 darks.masterDark.NPixels, stats.mean, stats.median, stats.stdev, stats.mad));
-
-    // load potential defects
-
-    int thresh = (int)(AggrToSigma(100) * stats.stdev);
-
-    Debug.Write(wxString::Format("DefectMapBuilder: load potential defects thresh = %d\n", thresh));
-
-    usImage& dark = m_impl->darks->masterDark;
-    usImage& medianFilt = m_impl->darks->filteredDark;
-
-    m_impl->coldPx.clear();
-    m_impl->hotPx.clear();
-
-    for (int y = 0; y < dark.Size.GetHeight(); y++)
-    {
-        for (int x = 0; x < dark.Size.GetWidth(); x++)
-        {
-            int filt = (int) medianFilt.Pixel(x, y);
-            int val = (int) dark.Pixel(x, y);
-            int v = val - filt;
-            if (v > thresh)
-            {
-                m_impl->hotPx.insert(BadPx(x, y, v));
-            }
-            else if (-v > thresh)
-            {
-                m_impl->coldPx.insert(BadPx(x, y, -v));
-            }
-        }
-    }
-
-    Debug.Write(wxString::Format("DefectMapBuilder: Loaded %d cold %d hot\n", m_impl->coldPx.size(), m_impl->hotPx.size()));
-}
-
-const ImageStats& DefectMapBuilder::GetImageStats() const
-{
-    return m_impl->w.stats;
-}
-
-void DefectMapBuilder::SetAggressiveness(int aggrCold, int aggrHot)
-{
-    m_impl->aggrCold = std::max(0, std::min(100, aggrCold));
-    m_impl->aggrHot = std::max(0, std::min(100, aggrHot));
-    m_impl->threshValid = false;
-}
-
-static void FindThresh(DefectMapBuilderImpl *impl)
-{
-    if (impl->threshValid)
-        return;
-
-    double multCold = AggrToSigma(impl->aggrCold);
-    double multHot = AggrToSigma(impl->aggrHot);
-
-    int coldThresh = (int) (multCold * impl->w.stats.stdev);
-    int hotThresh = (int) (multHot * impl->w.stats.stdev);
-
-    Debug.Write(wxString::Format("DefectMap: find thresholds aggr:(%d,%d) sigma:(%.1f,%.1f) px:(%+d,%+d)\n",
-                                 impl->aggrCold, impl->aggrHot, multCold, multHot, -coldThresh, hotThresh));
-
-    impl->coldPxThresh = impl->coldPx.lower_bound(BadPx(0, 0, coldThresh));
-    impl->hotPxThresh = impl->hotPx.lower_bound(BadPx(0, 0, hotThresh));
-
-    impl->coldPxSelected = std::distance(impl->coldPxThresh, impl->coldPx.end());
-    impl->hotPxSelected = std::distance(impl->hotPxThresh, impl->hotPx.end());
-
-    Debug.Write(wxString::Format("DefectMap: find thresholds found (%d,%d)\n", impl->coldPxSelected, impl->hotPxSelected));
-
-    impl->threshValid = true;
-}
-
-int DefectMapBuilder::GetColdPixelCnt() const
-{
-    FindThresh(m_impl);
-    return m_impl->coldPxSelected;
-}
-
-int DefectMapBuilder::GetHotPixelCnt() const
-{
-    FindThresh(m_impl);
-    return m_impl->hotPxSelected;
-}
-
-inline static unsigned int emit_defects(DefectMap& defectMap, BadPxSet::const_iterator p0, BadPxSet::const_iterator p1, double stdev, int sign, bool verbose)
-{
-    unsigned int cnt = 0;
-    for (BadPxSet::const_iterator it = p0; it != p1; ++it, ++cnt)
-    {
-        if (verbose)
-        {
-            int v = sign * it->v;
-            Debug.Write(wxString::Format("DefectMap: defect @ (%d, %d) val = %d (%+.1f sigma)\n", it->x, it->y, v, stdev > 0.1 ? (double)v / stdev : 0.0));
-        }
-        defectMap.push_back(wxPoint(it->x, it->y));
-    }
-    return cnt;
-}
-
-void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
-{
-    wxArrayString& info = m_impl->mapInfo;
-
-    double multCold = AggrToSigma(m_impl->aggrCold);
-    double multHot = AggrToSigma(m_impl->aggrHot);
-    const ImageStats& stats = m_impl->w.stats;
-
-    info.Clear();
-    info.push_back(wxString::Format("Generated: %s", wxDateTime::UNow().FormatISOCombined(' ')));
-    info.push_back(wxString::Format("Camera: %s", pCamera->Name));
-    info.push_back(wxString::Format("Dark Exposure Time: %d ms", m_impl->darks->masterDark.ImgExpDur));
-    info.push_back(wxString::Format("Dark Frame Count: %d", m_impl->darks->masterDark.ImgStackCnt));
-    info.push_back(wxString::Format("Aggressiveness, cold: %d", m_impl->aggrCold));
-    info.push_back(wxString::Format("Aggressiveness, hot: %d", m_impl->aggrHot));
-    info.push_back(wxString::Format("Sigma Thresh, cold: %.2f", multCold));
-    info.push_back(wxString::Format("Sigma Thresh, hot: %.2f", multHot));
-    info.push_back(wxString::Format("Mean: %.f", stats.mean));
-    info.push_back(wxString::Format("Stdev: %.f", stats.stdev));
-    info.push_back(wxString::Format("Median: %d", stats.median));
-    info.push_back(wxString::Format("MAD: %d", stats.mad));
-
-    int deltaCold = (int)(multCold * stats.stdev);
-    int deltaHot = (int)(multHot * stats.stdev);
-
-    info.push_back(wxString::Format("DeltaCold: %+d", -deltaCold));
-    info.push_back(wxString::Format("DeltaHot: %+d", deltaHot));
-
-    if (verbose) Debug.Write(wxString::Format("DefectMap: deltaCold = %+d deltaHot = %+d\n", -deltaCold, deltaHot));
-
-    FindThresh(m_impl);
-
-    defectMap.clear();
-    unsigned int nr_cold = emit_defects(defectMap, m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
-    unsigned int nr_hot = emit_defects(defectMap, m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
-
-    if (verbose) Debug.Write(wxString::Format("New defect map created, count=%d (cold=%d, hot=%d)\n", defectMap.size(), nr_cold, nr_hot));
-}
-
-const wxArrayString& DefectMapBuilder::GetMapInfo() const
-{
-    return m_impl->mapInfo;
-}
-
-bool RemoveDefects(usImage& light, const DefectMap& defectMap)
-{
-    // Check to make sure the light frame is valid
-    if (!light.ImageData)
-        return true;
-
-    if (!light.Subframe.IsEmpty())
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            const wxPoint& pt = *it;
-            // Check to see if we are within the subframe before correcting the defect
-            if (light.Subframe.Contains(pt))
-            {
-                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y);
-            }
-        }
-    }
-    else
-    {
-        // Step over each defect and replace the light value
-        // with the median of the surrounding pixels
-        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
-        {
-            int const x = it->x;
-            int const y = it->y;
-
-            if (x >= 0 && x < light.Size.GetWidth() && y >= 0 && y < light.Size.GetHeight())
-            {
-                light.Pixel(x, y) = MedianBorderingPixels(light, x, y);
-            }
-        }
-    }
-
-    return false;
-}
-
-wxString DefectMap::DefectMapFileName(int profileId)
-{
-    int inst = pFrame->GetInstanceNumber();
-    return MyFrame::GetDarksDir() + PATHSEPSTR +
-        wxString::Format("PHD2_defect_map%s_%d.txt", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
-}
-
-bool DefectMap::ImportFromProfile(int srcId, int destId)
-{
-    wxString sourceName;
-    wxString destName;
-    int rslt;
-
-    sourceName = DefectMapFileName(srcId);
-    destName = DefectMapFileName(destId);
-    rslt = wxCopyFile(sourceName, destName, true);
-    if (rslt != 1)
-    {
-        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map copy of %s to %s\n", sourceName, destName));
-        return false;
-    }
-    sourceName = DefectMapMasterPath(srcId);
-    destName = DefectMapMasterPath(destId);
-    rslt = wxCopyFile(sourceName, destName, true);
-    if (rslt != 1)
-    {
-        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map master dark copy of %s to %s\n", sourceName, destName));
-        return false;
-    }
-    sourceName = DefectMapFilterPath(srcId);
-    destName = DefectMapFilterPath(destId);
-    rslt = wxCopyFile(sourceName, destName, true);
-    if (rslt != 1)
-    {
-        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map master filtered dark copy of %s to %s\n", sourceName, destName));
-        return false;
-    }
-    return (true);
-}
-
-bool DefectMap::DefectMapExists(int profileId, bool showAlert)
-{
-    bool bOk = false;
-
-    if (wxFileExists(DefectMapFileName(profileId)))
-    {
-        wxString fName = DefectMapMasterPath(profileId);
-        const wxSize& sensorSize = pCamera->DarkFrameSize();
-        if (sensorSize == UNDEFINED_FRAME_SIZE)
-        {
-            bOk = true;
-            Debug.AddLine("BPM check: undefined frame size for current camera");
-        }
-        else
-        {
-            fitsfile *fptr;
-            int status = 0;  // CFITSIO status value MUST be initialized to zero!
-
-            if (PHD_fits_open_diskfile(&fptr, fName, READONLY, &status) == 0)
-            {
-                long fsize[2];
-                fits_get_img_size(fptr, 2, fsize, &status);
-                if (status == 0 && fsize[0] == sensorSize.x && fsize[1] == sensorSize.y)
-                    bOk = true;
-                else
-                {
-                    Debug.AddLine(wxString::Format("BPM check: failed geometry check - fits status = %d, cam dimensions = {%d,%d}, "
-                        " BPM dimensions = {%d,%d}", status, sensorSize.x, sensorSize.y, fsize[0], fsize[1]));
-                    if (showAlert)
-                        pFrame->Alert(_("Bad-pixel map does not match the camera in this profile - it needs to be replaced."));
-                }
-
-                PHD_fits_close_file(fptr);
-            }
-            else
-                Debug.AddLine(wxString::Format("BPM check: fitsio error on open_diskfile = %d", status));
-        }
-    }
-
-    return bOk;
-}
-
-void DefectMap::Save(const wxArrayString& info) const
-{
-    wxString filename = DefectMapFileName(m_profileId);
-    wxFileOutputStream oStream(filename);
-    wxTextOutputStream outText(oStream);
-
-    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
-    {
-        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
-        return;
-    }
-
-    outText << "# PHD2 Defect Map v1\n";
-
-    for (wxArrayString::const_iterator it = info.begin(); it != info.end(); ++it)
-    {
-        outText << "# " << *it << "\n";
-    }
-    outText << "# Defect count: " << ((unsigned int) size()) << "\n";
-
-    for (const_iterator it = begin(); it != end(); ++it)
-    {
-        outText << it->x << " " << it->y << "\n";
-    }
-
-    oStream.Close();
-    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
-}
-
-DefectMap::DefectMap()
-    : m_profileId(pConfig->GetCurrentProfileId())
-{
-}
-
-DefectMap::DefectMap(int profileId)
-    : m_profileId(profileId)
-{
-}
-
-bool DefectMap::FindDefect(const wxPoint& pt) const
-{
-    return std::find(begin(), end(), pt) != end();
-}
-
-void DefectMap::AddDefect(const wxPoint& pt)
-{
-    // first add the point
-    push_back(pt);
-
-    wxString filename = DefectMapFileName(m_profileId);
-    wxFile file(filename, wxFile::write_append);
-    wxFileOutputStream oStream(file);
-    wxTextOutputStream outText(oStream);
-
-    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
-    {
-        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
-        return;
-    }
-
-    outText << pt.x << " " << pt.y << "\n";
-
-    oStream.Close();
-    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
-}
-
-DefectMap *DefectMap::LoadDefectMap(int profileId)
-{
-    wxString filename = DefectMapFileName(profileId);
-    Debug.AddLine(wxString::Format("Loading defect map file %s", filename));
-
-    if (!wxFileExists(filename))
-    {
-        Debug.AddLine(wxString::Format("Defect map file not found: %s", filename));
-        return 0;
-    }
-
-    wxFileInputStream iStream(filename);
-    wxTextInputStream inText(iStream);
-
-    // Re-initialize the defect map and parse the defect map file
-    if (iStream.GetLastError() != wxSTREAM_NO_ERROR)
-    {
-        Debug.AddLine(wxString::Format("Unexpected eof on defect map file %s", filename));
-        return 0;
-    }
-
-    DefectMap *defectMap = new DefectMap(profileId);
-
-    int linenum = 0;
-    while (!inText.GetInputStream().Eof())
-    {
-        wxString line = inText.ReadLine();
-        ++linenum;
-        line.Trim(false); // trim leading whitespace
-        if (line.IsEmpty())
-            continue;
-        if (line.StartsWith("#"))
-            continue;
-
-        wxStringTokenizer tok(line);
-        wxString s1 = tok.GetNextToken();
-        wxString s2 = tok.GetNextToken();
-        long x, y;
-        if (s1.ToLong(&x) && s2.ToLong(&y))
-        {
-            defectMap->push_back(wxPoint(x, y));
-        }
-        else
-        {
-            Debug.AddLine(wxString::Format("DefectMap: ignore junk on line %d: %s", linenum, line));
-        }
-    }
-
-    Debug.AddLine(wxString::Format("Loaded %d defects", defectMap->size()));
-    return defectMap;
-}
-
-void DefectMap::DeleteDefectMap(int profileId)
-{
-    wxString filename = DefectMapFileName(profileId);
-    if (wxFileExists(filename))
-    {
-        Debug.AddLine("Removing defect map file: " + filename);
-        wxRemoveFile(filename);
-    }
-}
-
-
+/*
+ *  image_math.cpp
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark.
+ *  Copyright (c) 2006-2010 Craig Stark.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "image_math.h"
+#include "gpu_compute.h"
+
+#include <wx/wfstream.h>
+#include <wx/txtstrm.h>
+#include <wx/tokenzr.h>
+
+#include <algorithm>
+
+#include "image_kernels_impl.h"
+
+// until SelectImageKernels runs, the kernels built for the instruction set the
+// compiler targets
+ImageKernels Kernels =
+{
+    IMAGE_KERNELS_ISA,
+    recon_row,
+    median3_row,
+    subtract_dark_row,
+    subtract_dark_row,
+    widen_pixels,
+    accumulate_pixels,
+    narrow_pixels,
+    interpolate_pixels,
+    stretch_to_rgb,
+};
+
+bool GetBaselineImageKernels(ImageKernels *k)
+{
+    GetImageKernels(k);
+    return true;
+}
+
+int dbl_sort_func (double *first, double *second)
+{
+    if (*first < *second)
+        return -1;
+    else if (*first > *second)
+        return 1;
+    return 0;
+}
+
+double CalcSlope(const ArrayOfDbl& y)
+{
+    // Does a linear regression to calculate the slope
+
+    int nn = (int) y.GetCount();
+
+    if (nn < 2)
+        return 0.;
+
+    double s_xy = 0.0;
+    double s_y = 0.0;
+
+    for (int x = 0; x < nn; x++)
+    {
+        s_xy += (double)(x + 1) * y[x];
+        s_y += y[x];
+    }
+
+    int sx = (nn * (nn + 1)) / 2;
+    int sxx = sx * (2 * nn + 1) / 3;
+    double s_x = (double) sx;
+    double s_xx = (double) sxx;
+    double n = (double) nn;
+    return (n * s_xy - (s_x * s_y)) / (n * s_xx - (s_x * s_x));
+}
+
+
+struct QuickLReconJob : public ImageStripJob
+{
+    const usImage& src;
+    usImage& dst;
+    int RX, RY, RW, RH;
+
+    QuickLReconJob(const usImage& src_, usImage& dst_) : src(src_), dst(dst_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void QuickLReconJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const W = src.DataRect.GetWidth();
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    unsigned short *d;
+    unsigned int t;
+
+    for (int y = rowBegin; y < rowEnd && y <= RH - 2; y++)
+    {
+        d = &dst.ImageData[IX(0, y)];
+
+        Kernels.reconRow(d, &src.ImageData[IX(0, y)], &src.ImageData[IX(0, y + 1)], RW - 1);
+        d += RW - 1;
+
+        // last col
+        t  = src.ImageData[IX(RW - 1, y    )];
+        t += src.ImageData[IX(RW - 1, y + 1)];
+        *d = (unsigned short)(t >> 1);
+    }
+
+    if (rowEnd == RH)
+    {
+        // last row
+
+        d = &dst.ImageData[IX(0, RH - 1)];
+
+        for (int x = 0; x <= RW - 2; x++)
+        {
+            t  = src.ImageData[IX(x    , RH - 1)];
+            t += src.ImageData[IX(x + 1, RH - 1)];
+            *d++ = (unsigned short)(t >> 1);
+        }
+
+        // bottom-right pixel
+        *d = src.ImageData[IX(RW - 1, RH - 1)];
+    }
+
+#undef IX
+}
+
+bool QuickLRecon(usImage& img)
+{
+    // Does a simple debayer of luminance data only -- sliding 2x2 window
+    usImage tmp;
+    if (img.IsROIOnly() ? tmp.InitROI(img.Size, img.DataRect) : tmp.Init(img.Size))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    QuickLReconJob job(img, tmp);
+
+    if (img.Subframe.IsEmpty())
+    {
+        job.RX = job.RY = 0;
+        job.RW = img.Size.GetWidth();
+        job.RH = img.Size.GetHeight();
+    }
+    else
+    {
+        // RX and RY are relative to the pixels held
+        job.RX = img.Subframe.GetX() - img.DataRect.GetX();
+        job.RY = img.Subframe.GetY() - img.DataRect.GetY();
+        job.RW = img.Subframe.GetWidth();
+        job.RH = img.Subframe.GetHeight();
+        tmp.Clear();
+    }
+
+    RunImageStrips(job, ImageStripCount(job.RH, 256), job.RH);
+
+    img.SwapImageData(tmp);
+    return false;
+}
+
+bool Median3(usImage& img)
+{
+    usImage tmp;
+    if (img.IsROIOnly() ? tmp.InitROI(img.Size, img.DataRect) : tmp.Init(img.Size))
+        return true;
+
+    bool err;
+
+    if (img.Subframe.IsEmpty())
+    {
+        err = Median3(tmp.ImageData, img.ImageData, img.Size, wxRect(img.Size));
+    }
+    else
+    {
+        tmp.Clear();
+        wxRect rect(img.Subframe);
+        rect.Offset(-img.DataRect.GetPosition());
+        err = Median3(tmp.ImageData, img.ImageData, img.DataRect.GetSize(), rect);
+    }
+
+    img.SwapImageData(tmp);
+    return err;
+}
+
+// The region versions filter only the pixels inside rect and leave the rest of
+// the image unchanged, so a lazy ROI frame can be completed a region at a time.
+// The filter runs over rect and a one pixel border so that the pixels at the
+// edges of rect are filtered with their real neighbors.
+
+static void CopyRect(usImage& dst, const usImage& src, const wxRect& rect)
+{
+    int const width = dst.Size.GetWidth();
+    for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
+    {
+        size_t const ofs = (size_t) y * width + rect.GetLeft();
+        memcpy(dst.ImageData + ofs, src.ImageData + ofs, rect.GetWidth() * sizeof(unsigned short));
+    }
+}
+
+bool QuickLRecon(usImage& img, const wxRect& rect)
+{
+    usImage tmp;
+    if (tmp.Init(img.Size))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    wxRect area(rect);
+    area.Inflate(1);
+    area.Intersect(wxRect(img.Size));
+
+    QuickLReconJob job(img, tmp);
+    job.RX = area.GetX();
+    job.RY = area.GetY();
+    job.RW = area.GetWidth();
+    job.RH = area.GetHeight();
+
+    RunImageStrips(job, ImageStripCount(job.RH, 256), job.RH);
+
+    CopyRect(img, tmp, rect);
+    return false;
+}
+
+bool Median3(usImage& img, const wxRect& rect)
+{
+    usImage tmp;
+    if (tmp.Init(img.Size))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    wxRect area(rect);
+    area.Inflate(1);
+    area.Intersect(wxRect(img.Size));
+
+    bool err = Median3(tmp.ImageData, img.ImageData, img.Size, area);
+
+    CopyRect(img, tmp, rect);
+    return err;
+}
+
+class ImageStripThread : public wxThread
+{
+    ImageStripJob& m_job;
+    int m_strip;
+    int m_rowBegin;
+    int m_rowEnd;
+
+public:
+    ImageStripThread(ImageStripJob& job, int strip, int rowBegin, int rowEnd)
+        : wxThread(wxTHREAD_JOINABLE), m_job(job), m_strip(strip), m_rowBegin(rowBegin), m_rowEnd(rowEnd) { }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("image strip");
+        ThreadPriorityScope priority(THREAD_CLASS_GUIDE, "image strip");
+
+        m_job.ProcessRows(m_strip, m_rowBegin, m_rowEnd);
+        return (ExitCode) 0;
+    }
+};
+
+inline static int StripBegin(int strip, int nstrips, int height)
+{
+    return (int)((long long) height * strip / nstrips);
+}
+
+void RunImageStrips(ImageStripJob& job, int nstrips, int height)
+{
+    std::vector<ImageStripThread *> threads;
+
+    // the calling thread processes the last strip
+    for (int i = 0; i < nstrips - 1; i++)
+    {
+        int rowBegin = StripBegin(i, nstrips, height);
+        int rowEnd = StripBegin(i + 1, nstrips, height);
+
+        ImageStripThread *thread = new ImageStripThread(job, i, rowBegin, rowEnd);
+        if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            // could not start a thread, process the strip here
+            delete thread;
+            job.ProcessRows(i, rowBegin, rowEnd);
+            continue;
+        }
+        threads.push_back(thread);
+    }
+
+    job.ProcessRows(nstrips - 1, StripBegin(nstrips - 1, nstrips, height), height);
+
+    for (std::vector<ImageStripThread *>::iterator it = threads.begin(); it != threads.end(); ++it)
+    {
+        (*it)->Wait();
+        delete *it;
+    }
+}
+
+static bool s_reference;
+
+void SetImageMathReference(bool reference)
+{
+    s_reference = reference;
+}
+
+bool ImageMathReference()
+{
+    return s_reference;
+}
+
+int ImageStripCount(int height, int minRows)
+{
+    enum { MAX_STRIPS = 16 };
+
+    if (s_reference)
+        return 1;
+
+    int ncpu = wxThread::GetCPUCount();
+    if (ncpu < 1)
+        ncpu = 1;
+
+    int nstrips = std::min(ncpu, (int) MAX_STRIPS);
+    nstrips = std::min(nstrips, height / minRows);
+
+    return std::max(nstrips, 1);
+}
+
+
+inline static unsigned short median8(const unsigned short l[8])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3], l4 = l[4];
+    unsigned short x;
+
+    x = l[5];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+    x = l[6];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+    x = l[7];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    if (x < l4) swap(x, l4);
+
+    if (l2 > l0) swap(l2, l0);
+    if (l2 > l1) swap(l2, l1);
+
+    if (l3 > l0) swap(l3, l0);
+    if (l3 > l1) swap(l3, l1);
+
+    if (l4 > l0) swap(l4, l0);
+    if (l4 > l1) swap(l4, l1);
+
+    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median6(const unsigned short l[6])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2], l3 = l[3];
+    unsigned short x;
+
+    x = l[4];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+    x = l[5];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    if (x < l3) swap(x, l3);
+
+    if (l2 > l0) swap(l2, l0);
+    if (l2 > l1) swap(l2, l1);
+
+    if (l3 > l0) swap(l3, l0);
+    if (l3 > l1) swap(l3, l1);
+
+    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median5(const unsigned short l[5])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+    x = l[4];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+
+    if (l1 > l0) l0 = l1;
+    if (l2 > l0) l0 = l2;
+
+    return l0;
+}
+
+inline static unsigned short median4(const unsigned short l[4])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    unsigned short x;
+    x = l[3];
+    if (x < l0) swap(x, l0);
+    if (x < l1) swap(x, l1);
+    if (x < l2) swap(x, l2);
+
+    if (l2 > l0) swap(l2, l0);
+    if (l2 > l1) swap(l2, l1);
+
+    return (unsigned short)(((unsigned int) l0 + (unsigned int) l1) / 2);
+}
+
+inline static unsigned short median3(const unsigned short l[3])
+{
+    unsigned short l0 = l[0], l1 = l[1], l2 = l[2];
+    if (l2 < l0) swap(l2, l0);
+    if (l2 < l1) swap(l2, l1);
+    if (l1 > l0) l0 = l1;
+    return l0;
+}
+
+
+// Computes rows [rowBegin, rowEnd) of the 3x3 median of rect, reading at most
+// one row of rect above and below the range so that disjoint row ranges can be
+// filtered concurrently. The filtered pixels are passed to the sink in raster
+// order, which lets callers consume them without storing a filtered image.
+template<typename Sink>
+static void median3_rows(Sink& out, const unsigned short *src, const wxSize& size, const wxRect& rect, int rowBegin, int rowEnd)
+{
+    int const W = size.GetWidth();
+    int const RX = rect.GetX();
+    int const RY = rect.GetY();
+    int const RW = rect.GetWidth();
+    int const RH = rect.GetHeight();
+
+    unsigned short a[9];
+    std::vector<unsigned short> row(std::max(RW - 2, 1));
+
+#define IX(x_, y_) ((RY + (y_)) * W + RX + (x_))
+
+    if (rowBegin == 0)
+    {
+        // top row
+        out.BeginRow(0);
+
+        // top-left corner
+        a[0] = src[IX(0, 0)];
+        a[1] = src[IX(1, 0)];
+        a[2] = src[IX(0, 1)];
+        a[3] = src[IX(1, 1)];
+        out.Put(median4(a));
+
+        // top row middle pixels
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, 0)];
+            a[1] = src[IX(x,     0)];
+            a[2] = src[IX(x + 1, 0)];
+            a[3] = src[IX(x - 1, 1)];
+            a[4] = src[IX(x,     1)];
+            a[5] = src[IX(x + 1, 1)];
+            out.Put(median6(a));
+        }
+
+        // top-right corner
+        a[0] = src[IX(RW - 2, 0)];
+        a[1] = src[IX(RW - 1, 0)];
+        a[2] = src[IX(RW - 2, 1)];
+        a[3] = src[IX(RW - 1, 1)];
+        out.Put(median4(a));
+    }
+
+    int const y0 = std::max(1, rowBegin);
+    int const y1 = std::min(RH - 2, rowEnd - 1);
+
+    for (int y = y0; y <= y1; y++)
+    {
+        out.BeginRow(y);
+
+        // leftmost pixel
+        a[0] = src[IX(0, y - 1)];
+        a[1] = src[IX(1, y - 1)];
+        a[2] = src[IX(0, y    )];
+        a[3] = src[IX(1, y    )];
+        a[4] = src[IX(0, y + 1)];
+        a[5] = src[IX(1, y + 1)];
+        out.Put(median6(a));
+
+        Kernels.median3Row(&row[0], &src[IX(0, y - 1)], &src[IX(0, y)], &src[IX(0, y + 1)], RW - 2);
+        out.PutRow(&row[0], RW - 2);
+
+        // rightmost pixel
+        a[0] = src[IX(RW - 2, y - 1)];
+        a[1] = src[IX(RW - 1, y - 1)];
+        a[2] = src[IX(RW - 2, y    )];
+        a[3] = src[IX(RW - 1, y    )];
+        a[4] = src[IX(RW - 2, y + 1)];
+        a[5] = src[IX(RW - 1, y + 1)];
+        out.Put(median6(a));
+    }
+
+    if (rowEnd == RH)
+    {
+        // bottom row
+        out.BeginRow(RH - 1);
+
+        // bottom-left corner
+        a[0] = src[IX(0, RH - 2)];
+        a[1] = src[IX(1, RH - 2)];
+        a[2] = src[IX(0, RH - 1)];
+        a[3] = src[IX(1, RH - 1)];
+        out.Put(median4(a));
+
+        // bottom row middle pixels
+        for (int x = 1; x <= RW - 2; x++)
+        {
+            a[0] = src[IX(x - 1, RH - 2)];
+            a[1] = src[IX(x    , RH - 2)];
+            a[2] = src[IX(x + 1, RH - 2)];
+            a[3] = src[IX(x - 1, RH - 1)];
+            a[4] = src[IX(x    , RH - 1)];
+            a[5] = src[IX(x + 1, RH - 1)];
+            out.Put(median6(a));
+        }
+
+        // bottom-right corner
+        a[0] = src[IX(RW - 2, RH - 2)];
+        a[1] = src[IX(RW - 1, RH - 2)];
+        a[2] = src[IX(RW - 2, RH - 1)];
+        a[3] = src[IX(RW - 1, RH - 1)];
+        out.Put(median4(a));
+    }
+
+#undef IX
+}
+
+struct Median3Writer
+{
+    unsigned short *dst;
+    unsigned short *d;
+    int W;
+    const wxRect& rect;
+
+    Median3Writer(unsigned short *dst_, const wxSize& size, const wxRect& rect_) : dst(dst_), d(0), W(size.GetWidth()), rect(rect_) { }
+    void BeginRow(int y) { d = &dst[(rect.GetY() + y) * W + rect.GetX()]; }
+    void Put(unsigned short v) { *d++ = v; }
+    void PutRow(const unsigned short *v, int n) { memcpy(d, v, n * sizeof(unsigned short)); d += n; }
+};
+
+void Median3Rows(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect, int rowBegin, int rowEnd)
+{
+    Median3Writer out(dst, size, rect);
+    median3_rows(out, src, size, rect, rowBegin, rowEnd);
+}
+
+// min and max of the raw and filtered pixels; the raw row is scanned when the
+// filter starts each row, while the row is still in cache
+struct Median3MinMaxSink
+{
+    const unsigned short *src;
+    int W;
+    const wxRect& rect;
+    int min, max, filtMin, filtMax;
+
+    Median3MinMaxSink(const unsigned short *src_, const wxSize& size, const wxRect& rect_)
+        : src(src_), W(size.GetWidth()), rect(rect_), min(65535), max(0), filtMin(65535), filtMax(0) { }
+
+    void BeginRow(int y)
+    {
+        const unsigned short *p = &src[(rect.GetY() + y) * W + rect.GetX()];
+        const unsigned short *const end = p + rect.GetWidth();
+        for (; p < end; p++)
+        {
+            int d = (int) *p;
+            if (d < min) min = d;
+            if (d > max) max = d;
+        }
+    }
+    void Put(unsigned short v)
+    {
+        int d = (int) v;
+        if (d < filtMin) filtMin = d;
+        if (d > filtMax) filtMax = d;
+    }
+    void PutRow(const unsigned short *v, int n)
+    {
+        for (int i = 0; i < n; i++)
+            Put(v[i]);
+    }
+};
+
+void Median3MinMax(const usImage& img, const wxRect& rect, int *min, int *max, int *filtMin, int *filtMax)
+{
+    // rect in the coordinates of the pixels held
+    wxRect r(rect);
+    r.Offset(-img.DataRect.GetPosition());
+    wxSize const held = img.DataRect.GetSize();
+
+    Median3MinMaxSink out(img.ImageData, held, r);
+    median3_rows(out, img.ImageData, held, r, 0, r.GetHeight());
+    *min = out.min;
+    *max = out.max;
+    *filtMin = out.filtMin;
+    *filtMax = out.filtMax;
+}
+
+struct Median3Job : public ImageStripJob
+{
+    unsigned short *dst;
+    const unsigned short *src;
+    const wxSize& size;
+    const wxRect& rect;
+
+    Median3Job(unsigned short *dst_, const unsigned short *src_, const wxSize& size_, const wxRect& rect_)
+        : dst(dst_), src(src_), size(size_), rect(rect_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        Median3Rows(dst, src, size, rect, rowBegin, rowEnd);
+    }
+};
+
+bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect)
+{
+    Median3Job job(dst, src, size, rect);
+    RunImageStrips(job, ImageStripCount(rect.GetHeight(), 128), rect.GetHeight());
+    return false;
+}
+
+// median of the neighbors of (x, y) among the pixels the image holds, which
+// are the whole frame unless the image holds only its subframe
+static unsigned short MedianBorderingPixels(const usImage& img, int x, int y)
+{
+    unsigned short array[8];
+    unsigned int n = 0;
+    const wxRect& r = img.DataRect;
+
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if ((dx || dy) && r.Contains(x + dx, y + dy))
+                array[n++] = img.Pixel(x + dx, y + dy);
+        }
+    }
+
+    switch (n)
+    {
+    case 8: return median8(array);  // inside
+    case 5: return median5(array);  // on an edge
+    case 3: return median3(array);  // at a corner
+    default: return n ? array[0] : img.Pixel(x, y);
+    }
+}
+
+// SquarePixels stretches the rows of the image so that its pixels become
+// square. Each output pixel is interpolated between two adjacent input pixels
+// of its row, and the column indices and 16 bit fixed-point weights of the
+// interpolation only depend on the frame width and the pixel aspect ratio,
+// which are fixed for a camera. They are computed for the first frame and
+// cached, so each frame is just a branch-free pass over the rows.
+
+struct SquarePixelsMap
+{
+    int srcWidth;
+    float xsize, ysize;
+    std::vector<int> left;              // first input column of each output column
+    std::vector<int> right;             // second input column, left + 1 except at the right edge
+    std::vector<unsigned int> weight;   // weight of the right column, 0..65535; 65536 - weight for the left one
+
+    SquarePixelsMap() : srcWidth(0), xsize(0.f), ysize(0.f) { }
+    bool Matches(int width, float x, float y) const { return width == srcWidth && x == xsize && y == ysize; }
+    void Build(int width, float x, float y);
+};
+
+void SquarePixelsMap::Build(int width, float x, float y)
+{
+    srcWidth = width;
+    xsize = x;
+    ysize = y;
+
+    double const ratio = ysize / xsize;
+    int const newsize = ROUND((double) width / ratio);
+
+    left.resize(newsize);
+    right.resize(newsize);
+    weight.resize(newsize);
+
+    for (int i = 0; i < newsize; i++)
+    {
+        double const pos = i * ratio;
+        int i1 = (int) floor(pos);
+        unsigned int w = (unsigned int) ROUND((pos - i1) * 65536.0);
+        if (w >= 65536)
+        {
+            ++i1;
+            w = 0;
+        }
+        if (i1 > width - 1)
+        {
+            i1 = width - 1;
+            w = 0;
+        }
+        left[i] = i1;
+        right[i] = std::min(i1 + 1, width - 1);
+        weight[i] = w;
+    }
+
+    Debug.Write(wxString::Format("SquarePixels: map for width %d pixel size %.2fx%.2f -> width %d\n", width, xsize, ysize, newsize));
+}
+
+// the map for the connected camera; SquarePixels holds the lock while it
+// resamples so the map cannot change under the strips
+static wxCriticalSection s_squareLock;
+static SquarePixelsMap s_squareMap;
+
+struct SquarePixelsJob : public ImageStripJob
+{
+    const SquarePixelsMap& map;
+    const usImage& src;
+    usImage& dst;
+    wxRect rect;    // output pixels to compute
+
+    SquarePixelsJob(const SquarePixelsMap& map_, const usImage& src_, usImage& dst_, const wxRect& rect_)
+        : map(map_), src(src_), dst(dst_), rect(rect_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void SquarePixelsJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const x0 = rect.GetLeft();
+    int const n = rect.GetWidth();
+    int const sw = src.Size.GetWidth();
+    int const dw = dst.Size.GetWidth();
+    const int *left = &map.left[x0];
+    const int *right = &map.right[x0];
+    const unsigned int *weight = &map.weight[x0];
+
+    for (int y = rect.GetTop() + rowBegin; y < rect.GetTop() + rowEnd; y++)
+    {
+        const unsigned short *s = src.ImageData + (size_t) y * sw;
+        unsigned short *d = dst.ImageData + (size_t) y * dw + x0;
+        for (int i = 0; i < n; i++)
+        {
+            unsigned int const w = weight[i];
+            d[i] = (unsigned short)((s[left[i]] * (65536U - w) + s[right[i]] * w + 32768U) >> 16);
+        }
+    }
+}
+
+bool SquarePixels(usImage& img, float xsize, float ysize)
+{
+    // Stretches one dimension to square up pixels. With a subframe only the
+    // output columns interpolated entirely from inside it are computed, and
+    // the rest of the image is cleared.
+    if (!img.ImageData)
+        return true;
+
+    if (xsize <= ysize)
+        return false;
+
+    if (img.ExpandToFullFrame())
+        return true;
+
+    wxCriticalSectionLocker lck(s_squareLock);
+
+    // if X > Y, when viewing stock, Y is unnaturally stretched, so stretch X to match
+    int const width = img.Size.GetWidth();
+    int const height = img.Size.GetHeight();
+    if (!s_squareMap.Matches(width, xsize, ysize))
+        s_squareMap.Build(width, xsize, ysize);
+    const SquarePixelsMap& map = s_squareMap;
+    int const newsize = map.left.size();
+
+    usImage squared;
+    if (squared.Init(newsize, height))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    wxRect rect(0, 0, newsize, height);
+    if (!img.Subframe.IsEmpty())
+    {
+        int x0 = 0;
+        while (x0 < newsize && map.left[x0] < img.Subframe.GetLeft())
+            ++x0;
+        int x1 = newsize - 1;
+        while (x1 >= x0 && map.right[x1] > img.Subframe.GetRight())
+            --x1;
+        rect = wxRect(x0, img.Subframe.GetTop(), std::max(x1 - x0 + 1, 0), img.Subframe.GetHeight());
+        squared.Clear();
+    }
+
+    if (!rect.IsEmpty())
+    {
+        SquarePixelsJob job(map, img, squared, rect);
+        RunImageStrips(job, ImageStripCount(rect.GetHeight(), 64), rect.GetHeight());
+    }
+
+    img.SwapImageData(squared);
+    img.Size = squared.Size;
+    img.Subframe = img.Subframe.IsEmpty() ? wxRect(0, 0, 0, 0) : rect;
+    img.Min = img.Max = img.FiltMin = img.FiltMax = 0;
+
+    return false;
+}
+
+// Software binning sums factor x factor blocks of pixels into a row of 32-bit
+// accumulators, one source row at a time, which keeps the inner loops simple
+// enough for the compiler to vectorize. The block width is a template
+// parameter so that the horizontal sum is unrolled for the common factors.
+
+template<int F>
+static void bin_accum_row(unsigned int *acc, const unsigned short *s, int n)
+{
+    for (int i = 0; i < n; i++, s += F)
+    {
+        unsigned int t = s[0];
+        for (int j = 1; j < F; j++)
+            t += s[j];
+        acc[i] += t;
+    }
+}
+
+static void bin_accum_row(unsigned int *acc, const unsigned short *s, int n, int factor)
+{
+    switch (factor)
+    {
+    case 2: bin_accum_row<2>(acc, s, n); break;
+    case 3: bin_accum_row<3>(acc, s, n); break;
+    case 4: bin_accum_row<4>(acc, s, n); break;
+    default:
+        for (int i = 0; i < n; i++, s += factor)
+        {
+            unsigned int t = 0;
+            for (int j = 0; j < factor; j++)
+                t += s[j];
+            acc[i] += t;
+        }
+        break;
+    }
+}
+
+struct SoftwareBinJob : public ImageStripJob
+{
+    const usImage& src;
+    usImage& dst;
+    wxRect rect;    // binned pixels to compute, in destination coordinates
+    int factor;
+    bool sum;
+
+    SoftwareBinJob(const usImage& src_, usImage& dst_, const wxRect& rect_, int factor_, bool sum_)
+        : src(src_), dst(dst_), rect(rect_), factor(factor_), sum(sum_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void SoftwareBinJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const n = rect.GetWidth();
+    int const sw = src.Size.GetWidth();
+    int const dw = dst.Size.GetWidth();
+    unsigned int const cnt = factor * factor;
+    unsigned int const half = cnt / 2;
+
+    std::vector<unsigned int> acc(n);
+
+    for (int y = rect.GetTop() + rowBegin; y < rect.GetTop() + rowEnd; y++)
+    {
+        std::fill(acc.begin(), acc.end(), 0);
+
+        const unsigned short *s = src.ImageData + (size_t) y * factor * sw + rect.GetLeft() * factor;
+        for (int k = 0; k < factor; k++, s += sw)
+            bin_accum_row(&acc[0], s, n, factor);
+
+        unsigned short *d = dst.ImageData + (size_t) y * dw + rect.GetLeft();
+        if (sum)
+        {
+            for (int i = 0; i < n; i++)
+                d[i] = (unsigned short) std::min(acc[i], 65535U);
+        }
+        else
+        {
+            for (int i = 0; i < n; i++)
+                d[i] = (unsigned short)((acc[i] + half) / cnt);
+        }
+    }
+}
+
+bool SoftwareBin(usImage& img, int factor, bool sum)
+{
+    // Bins the image in place by an integer factor; rows and columns left
+    // over at the right and bottom edges are dropped. A subframe is reduced to
+    // the binned pixels lying entirely inside it, and the rest of the binned
+    // image cleared.
+
+    if (!img.ImageData || factor <= 1)
+        return false;
+
+    if (img.ExpandToFullFrame())
+        return true;
+
+    int const dw = img.Size.GetWidth() / factor;
+    int const dh = img.Size.GetHeight() / factor;
+    if (dw < 1 || dh < 1)
+        return true;
+
+    usImage binned;
+    if (binned.Init(dw, dh))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    wxRect rect(0, 0, dw, dh);
+    if (!img.Subframe.IsEmpty())
+    {
+        int const x0 = (img.Subframe.GetLeft() + factor - 1) / factor;
+        int const y0 = (img.Subframe.GetTop() + factor - 1) / factor;
+        int const x1 = std::min((img.Subframe.GetRight() + 1) / factor, dw);
+        int const y1 = std::min((img.Subframe.GetBottom() + 1) / factor, dh);
+        rect = wxRect(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+        binned.Clear();
+    }
+
+    if (!rect.IsEmpty())
+    {
+        SoftwareBinJob job(img, binned, rect, factor, sum);
+        RunImageStrips(job, ImageStripCount(rect.GetHeight(), 64), rect.GetHeight());
+    }
+
+    img.SwapImageData(binned);
+    img.Size = binned.Size;
+    img.Subframe = img.Subframe.IsEmpty() ? wxRect(0, 0, 0, 0) : rect;
+    img.Min = img.Max = img.FiltMin = img.FiltMax = 0;
+
+    if (sum)
+    {
+        // the sum of factor^2 pixels needs up to 2 log2(factor) more bits
+        unsigned int bpp = img.BitsPerPixel;
+        for (int n = 1; n < factor * factor; n <<= 1)
+            ++bpp;
+        img.BitsPerPixel = (wxByte) std::min(bpp, 16U);
+        img.Pedestal = (unsigned short) std::min((unsigned int) img.Pedestal * factor * factor, 65535U);
+    }
+
+    return false;
+}
+
+struct GreenSuperpixelJob : public ImageStripJob
+{
+    const usImage& src;
+    usImage& dst;
+    wxRect rect;    // superpixels to compute, in destination coordinates
+    int top, bottom;    // column offsets of the green pixels in the top and bottom rows of a cell
+
+    GreenSuperpixelJob(const usImage& src_, usImage& dst_, const wxRect& rect_, BAYER_GREEN green)
+        : src(src_), dst(dst_), rect(rect_), top(green == BAYER_GREEN_DIAGONAL ? 0 : 1), bottom(1 - top) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void GreenSuperpixelJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const n = rect.GetWidth();
+    int const sw = src.Size.GetWidth();
+    int const dw = dst.Size.GetWidth();
+
+    for (int y = rect.GetTop() + rowBegin; y < rect.GetTop() + rowEnd; y++)
+    {
+        const unsigned short *r0 = src.ImageData + (size_t) y * 2 * sw + rect.GetLeft() * 2 + top;
+        const unsigned short *r1 = src.ImageData + (size_t) (y * 2 + 1) * sw + rect.GetLeft() * 2 + bottom;
+        unsigned short *d = dst.ImageData + (size_t) y * dw + rect.GetLeft();
+        for (int i = 0; i < n; i++)
+            d[i] = (unsigned short)(((unsigned int) r0[2 * i] + r1[2 * i] + 1) >> 1);
+    }
+}
+
+bool GreenSuperpixel(usImage& img, BAYER_GREEN green)
+{
+    // Only the green pixels are read, half of the frame, and a quarter of the
+    // pixels are written, so this is much cheaper than a luminance
+    // reconstruction. Green carries most of the signal of a star and is
+    // sampled twice per cell, so the lost resolution matters little for
+    // guiding.
+
+    if (!img.ImageData || green == BAYER_GREEN_NONE)
+        return false;
+
+    if (img.ExpandToFullFrame())
+        return true;
+
+    int const dw = img.Size.GetWidth() / 2;
+    int const dh = img.Size.GetHeight() / 2;
+    if (dw < 1 || dh < 1)
+        return true;
+
+    usImage reduced;
+    if (reduced.Init(dw, dh))
+    {
+        pFrame->Alert(_("Memory allocation error"));
+        return true;
+    }
+
+    wxRect rect(0, 0, dw, dh);
+    if (!img.Subframe.IsEmpty())
+    {
+        int const x0 = (img.Subframe.GetLeft() + 1) / 2;
+        int const y0 = (img.Subframe.GetTop() + 1) / 2;
+        int const x1 = std::min((img.Subframe.GetRight() + 1) / 2, dw);
+        int const y1 = std::min((img.Subframe.GetBottom() + 1) / 2, dh);
+        rect = wxRect(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+        reduced.Clear();
+    }
+
+    if (!rect.IsEmpty())
+    {
+        GreenSuperpixelJob job(img, reduced, rect, green);
+        RunImageStrips(job, ImageStripCount(rect.GetHeight(), 64), rect.GetHeight());
+    }
+
+    img.SwapImageData(reduced);
+    img.Size = reduced.Size;
+    img.Subframe = img.Subframe.IsEmpty() ? wxRect(0, 0, 0, 0) : rect;
+    img.Min = img.Max = img.FiltMin = img.FiltMax = 0;
+
+    return false;
+}
+
+void ImageStack::Init(const usImage& first)
+{
+    m_size = first.Size;
+    m_rect = first.Subframe.IsEmpty() ? wxRect(first.Size) : first.Subframe;
+    m_bpp = first.BitsPerPixel;
+    m_pedestal = first.Pedestal;
+    m_count = 0;
+    m_sum.assign((size_t) m_rect.GetWidth() * m_rect.GetHeight(), 0);
+    Add(first);
+}
+
+bool ImageStack::Add(const usImage& img)
+{
+    if (img.Size != m_size || (!img.Subframe.IsEmpty() && !img.Subframe.Contains(m_rect)))
+        return true;
+
+    int const w = m_rect.GetWidth();
+    unsigned int *sum = &m_sum[0];
+    for (int y = m_rect.GetTop(); y <= m_rect.GetBottom(); y++, sum += w)
+    {
+        const unsigned short *p = &img.Pixel(m_rect.GetLeft(), y);
+        for (int x = 0; x < w; x++)
+            sum[x] += p[x];
+    }
+
+    ++m_count;
+    return false;
+}
+
+void ImageStack::Get(usImage& img) const
+{
+    // bits needed for the sum, and the shift that brings them into 16
+    unsigned int bpp = m_bpp ? m_bpp : 16;
+    for (int n = 1; n < m_count; n <<= 1)
+        ++bpp;
+    int const shift = bpp > 16 ? bpp - 16 : 0;
+    unsigned int const round = shift ? 1U << (shift - 1) : 0;
+
+    int const w = m_rect.GetWidth();
+    const unsigned int *sum = &m_sum[0];
+    for (int y = m_rect.GetTop(); y <= m_rect.GetBottom(); y++, sum += w)
+    {
+        unsigned short *p = &img.Pixel(m_rect.GetLeft(), y);
+        for (int x = 0; x < w; x++)
+            p[x] = (unsigned short) std::min((sum[x] + round) >> shift, 65535U);
+    }
+
+    img.BitsPerPixel = (wxByte) std::min(bpp, 16U);
+    img.Pedestal = (unsigned short) std::min(((unsigned int) m_pedestal * m_count + round) >> shift, 65535U);
+    img.ImgStackCnt = m_count;
+    img.Min = img.Max = img.FiltMin = img.FiltMax = 0;
+}
+
+bool Subtract(usImage& light, const usImage& dark)
+{
+    if (!light.ImageData || !dark.ImageData)
+        return true;
+    if (light.Size != dark.Size)
+        return true;
+
+    unsigned int left, top, width, height;
+    if (!light.Subframe.IsEmpty())
+    {
+        left = light.Subframe.GetLeft();
+        width = light.Subframe.GetWidth();
+        top = light.Subframe.GetTop();
+        height = light.Subframe.GetHeight();
+    }
+    else
+    {
+        left = top = 0;
+        width = light.Size.GetWidth();
+        height = light.Size.GetHeight();
+    }
+
+    // either image may hold only its subframe
+    unsigned int const lstride = light.DataRect.GetWidth();
+    unsigned int const dstride = dark.DataRect.GetWidth();
+    if (!light.DataRect.Contains(wxRect(left, top, width, height)) || !dark.DataRect.Contains(wxRect(left, top, width, height)))
+        return true;
+
+    int mindiff = 65535;
+
+    unsigned short *pl0 = &light.Pixel(left, top);
+    const unsigned short *pd0 = &dark.Pixel(left, top);
+    for (unsigned int r = 0; r < height;
+         r++, pl0 += lstride, pd0 += dstride)
+    {
+        unsigned short *const endl = pl0 + width;
+        unsigned short *pl;
+        const unsigned short *pd;
+        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        {
+            int diff = (int) *pl - (int) *pd;
+            if (diff < mindiff)
+                mindiff = diff;
+        }
+    }
+
+    int offset = 0;
+    if (mindiff < 0) // dark was lighter than light
+    {
+        offset = -mindiff;
+        light.Pedestal = (unsigned short) offset;
+    }
+
+    pl0 = &light.Pixel(left, top);
+    pd0 = &dark.Pixel(left, top);
+    for (unsigned int r = 0; r < height;
+         r++, pl0 += lstride, pd0 += dstride)
+    {
+        unsigned short *const endl = pl0 + width;
+        unsigned short *pl;
+        const unsigned short *pd;
+        for (pl = pl0, pd = pd0; pl < endl; pl++, pd++)
+        {
+            int newval = (int) *pl - (int) *pd + offset;
+            if (newval < 0) newval = 0; // shouldn't hit this...
+            else if (newval > 65535) newval = 65535;
+            *pl = (unsigned short) newval;
+        }
+    }
+
+    return false;
+}
+
+PreparedDark::PreparedDark(const usImage& dark)
+    : m_size(dark.Size), m_pedestal(0), m_refcnt(1)
+{
+    if (!dark.ImageData || dark.NPixels <= 0)
+        return;
+
+    ImageHistogram histo;
+    histo.Build(dark, wxRect(dark.Size));
+    m_pedestal = histo.Median();
+
+    m_below.resize(dark.NPixels);
+    m_above.resize(dark.NPixels);
+    for (int i = 0; i < dark.NPixels; i++)
+    {
+        unsigned short d = dark.ImageData[i];
+        m_below[i] = d < m_pedestal ? m_pedestal - d : 0;
+        m_above[i] = d > m_pedestal ? d - m_pedestal : 0;
+    }
+
+    Debug.Write(wxString::Format("Prepared dark %dx%d exp=%d pedestal=%u\n", m_size.GetWidth(), m_size.GetHeight(),
+        dark.ImgExpDur, m_pedestal));
+}
+
+void WidenPixels(unsigned short *dst, const unsigned char *src, unsigned int n)
+{
+    Kernels.widenPixels(dst, src, n);
+}
+
+unsigned long long AccumulatePixels(unsigned short *dst, const unsigned char *src, unsigned int n)
+{
+    return Kernels.accumulatePixels(dst, src, n);
+}
+
+void NarrowPixels(unsigned short *dst, const int *src, unsigned int n)
+{
+    Kernels.narrowPixels(dst, src, n);
+}
+
+void InterpolatePixels(unsigned short *dst, const unsigned short *a, const unsigned short *b, unsigned int weight, unsigned int n)
+{
+    Kernels.interpolatePixels(dst, a, b, weight, n);
+}
+
+inline static void dark_row_kernel(unsigned short *pl, const unsigned char *src, const unsigned short *below, const unsigned short *above, unsigned int n)
+{
+    Kernels.subtractDarkRow8(pl, src, below, above, n);
+}
+
+inline static void dark_row_kernel(unsigned short *pl, const unsigned short *src, const unsigned short *below, const unsigned short *above, unsigned int n)
+{
+    Kernels.subtractDarkRow16(pl, src, below, above, n);
+}
+
+bool PreparedDark::Subtract(usImage& light) const
+{
+    return SubtractFrom(light, light.ImageData);
+}
+
+bool PreparedDark::Subtract(usImage& light, const unsigned char *src) const
+{
+    if (!light.Subframe.IsEmpty())
+        return true;
+    return SubtractFrom(light, src);
+}
+
+template<typename T>
+bool PreparedDark::SubtractFrom(usImage& light, const T *src) const
+{
+    if (!light.ImageData || m_below.empty())
+        return true;
+    if (light.Size != m_size)
+        return true;
+
+    unsigned int left, top, width, height;
+    if (!light.Subframe.IsEmpty())
+    {
+        left = light.Subframe.GetLeft();
+        width = light.Subframe.GetWidth();
+        top = light.Subframe.GetTop();
+        height = light.Subframe.GetHeight();
+    }
+    else
+    {
+        left = top = 0;
+        width = light.Size.GetWidth();
+        height = light.Size.GetHeight();
+    }
+
+    // the dark is full frame, the light may hold only its subframe
+    unsigned int const stride = m_size.GetWidth();
+    unsigned int const lstride = light.DataRect.GetWidth();
+    unsigned int ofs = top * stride + left;
+    unsigned int lofs = (top - light.DataRect.GetTop()) * lstride + (left - light.DataRect.GetLeft());
+    for (unsigned int r = 0; r < height; r++, ofs += stride, lofs += lstride)
+        dark_row_kernel(light.ImageData + lofs, src + lofs, &m_below[ofs], &m_above[ofs], width);
+
+    light.Pedestal = m_pedestal;
+
+    return false;
+}
+
+// 3x3 median of one row of a full frame, with the edge handling of
+// median3_rows: above is NULL for the top row and below for the bottom row
+static void median3_line(unsigned short *out, const unsigned short *above, const unsigned short *row, const unsigned short *below, int W)
+{
+    unsigned short a[6];
+
+    if (!above || !below)
+    {
+        // top or bottom row, the two rows are the edge row and its neighbor
+        const unsigned short *r0 = above ? above : row;
+        const unsigned short *r1 = above ? row : below;
+
+        a[0] = r0[0]; a[1] = r0[1]; a[2] = r1[0]; a[3] = r1[1];
+        out[0] = median4(a);
+        for (int x = 1; x <= W - 2; x++)
+        {
+            a[0] = r0[x - 1]; a[1] = r0[x]; a[2] = r0[x + 1];
+            a[3] = r1[x - 1]; a[4] = r1[x]; a[5] = r1[x + 1];
+            out[x] = median6(a);
+        }
+        a[0] = r0[W - 2]; a[1] = r0[W - 1]; a[2] = r1[W - 2]; a[3] = r1[W - 1];
+        out[W - 1] = median4(a);
+        return;
+    }
+
+    a[0] = above[0]; a[1] = above[1]; a[2] = row[0]; a[3] = row[1]; a[4] = below[0]; a[5] = below[1];
+    out[0] = median6(a);
+    Kernels.median3Row(out + 1, above, row, below, W - 2);
+    a[0] = above[W - 2]; a[1] = above[W - 1]; a[2] = row[W - 2]; a[3] = row[W - 1]; a[4] = below[W - 2]; a[5] = below[W - 1];
+    out[W - 1] = median6(a);
+}
+
+// One row of QuickLRecon over a full frame; next is NULL for the bottom row
+static void recon_line(unsigned short *out, const unsigned short *row, const unsigned short *next, int W)
+{
+    if (next)
+    {
+        Kernels.reconRow(out, row, next, W - 1);
+        out[W - 1] = (unsigned short)(((unsigned int) row[W - 1] + next[W - 1]) >> 1);
+        return;
+    }
+
+    for (int x = 0; x <= W - 2; x++)
+        out[x] = (unsigned short)(((unsigned int) row[x] + row[x + 1]) >> 1);
+    out[W - 1] = row[W - 1];
+}
+
+// The fused calibration pass, see CalibrateFrame. Each strip streams its rows
+// through small rings of rows: the dark subtracted rows, which noise
+// reduction reads three at a time, and the noise reduced rows, which the
+// statistics filter reads three at a time. Only the rows of the strip itself
+// are written to dst; the rows the strip needs beyond its edges are computed
+// privately, so the strips share no intermediate results.
+struct CalibrateStats
+{
+    int min, max, filtMin, filtMax;
+};
+
+struct CalibrateJob : public ImageStripJob
+{
+    const unsigned short *src;
+    unsigned short *dst;            // NULL for statistics only
+    int W, H;
+    const PreparedDark *dark;
+    int nr;
+    bool stats;
+    std::vector<CalibrateStats> stripStats;
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+class CalibrateStrip
+{
+    enum { RING = 4 };
+
+    struct Ring
+    {
+        std::vector<unsigned short> buf;
+        int row[RING];
+
+        Ring(int W) : buf(RING * W) { for (int i = 0; i < RING; i++) row[i] = -1; }
+    };
+
+    const CalibrateJob& m_job;
+    int m_begin, m_end;
+    int m_darkDone, m_nrDone;       // the strip's rows below these are in dst
+    Ring m_dark, m_nr;
+
+public:
+    CalibrateStrip(const CalibrateJob& job, int rowBegin, int rowEnd)
+        : m_job(job), m_begin(rowBegin), m_end(rowEnd), m_darkDone(rowBegin), m_nrDone(rowBegin), m_dark(job.W), m_nr(job.W) { }
+
+    const unsigned short *DarkRow(int r);
+    const unsigned short *NoiseReducedRow(int r);
+};
+
+// rows are asked for at most one ahead of the strip's last row
+const unsigned short *CalibrateStrip::DarkRow(int r)
+{
+    int const W = m_job.W;
+    size_t const ofs = (size_t) r * W;
+    const PreparedDark *dark = m_job.dark;
+    if (!dark)
+        return m_job.src + ofs;
+
+    unsigned short *p;
+    if (m_job.nr == NR_NONE && r >= m_begin && r < m_end)
+    {
+        // without noise reduction the strip's own rows are the output
+        p = m_job.dst + ofs;
+        if (r < m_darkDone)
+            return p;
+        assert(r == m_darkDone);
+        m_darkDone = r + 1;
+    }
+    else
+    {
+        int const slot = r & (RING - 1);
+        p = &m_dark.buf[slot * W];
+        if (m_dark.row[slot] == r)
+            return p;
+        m_dark.row[slot] = r;
+    }
+
+    dark_row_kernel(p, m_job.src + ofs, &dark->m_below[ofs], &dark->m_above[ofs], W);
+    return p;
+}
+
+const unsigned short *CalibrateStrip::NoiseReducedRow(int r)
+{
+    if (m_job.nr == NR_NONE)
+        return DarkRow(r);
+
+    int const W = m_job.W;
+    int const H = m_job.H;
+    unsigned short *p;
+    if (r >= m_begin && r < m_end)
+    {
+        p = m_job.dst + (size_t) r * W;
+        if (r < m_nrDone)
+            return p;
+        assert(r == m_nrDone);
+        m_nrDone = r + 1;
+    }
+    else
+    {
+        int const slot = r & (RING - 1);
+        p = &m_nr.buf[slot * W];
+        if (m_nr.row[slot] == r)
+            return p;
+        m_nr.row[slot] = r;
+    }
+
+    if (m_job.nr == NR_3x3MEDIAN)
+        median3_line(p, r > 0 ? DarkRow(r - 1) : NULL, DarkRow(r), r < H - 1 ? DarkRow(r + 1) : NULL, W);
+    else
+        recon_line(p, DarkRow(r), r < H - 1 ? DarkRow(r + 1) : NULL, W);
+    return p;
+}
+
+void CalibrateJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    CalibrateStrip cs(*this, rowBegin, rowEnd);
+
+    CalibrateStats st = { 65535, 0, 65535, 0 };
+    std::vector<unsigned short> filt(stats ? W : 0);
+
+    for (int r = rowBegin; r < rowEnd; r++)
+    {
+        const unsigned short *row = cs.NoiseReducedRow(r);
+        if (!stats)
+            continue;
+
+        for (int x = 0; x < W; x++)
+        {
+            int const d = row[x];
+            if (d < st.min) st.min = d;
+            if (d > st.max) st.max = d;
+        }
+
+        median3_line(&filt[0], r > 0 ? cs.NoiseReducedRow(r - 1) : NULL, row, r < H - 1 ? cs.NoiseReducedRow(r + 1) : NULL, W);
+        for (int x = 0; x < W; x++)
+        {
+            int const d = filt[x];
+            if (d < st.filtMin) st.filtMin = d;
+            if (d > st.filtMax) st.filtMax = d;
+        }
+    }
+
+    stripStats[strip] = st;
+}
+
+bool CalibrateFrame(usImage& img, const PreparedDark *dark, int noiseReduction, bool stats)
+{
+    if (!img.ImageData || !img.Subframe.IsEmpty())
+        return true;
+
+    int const W = img.Size.GetWidth();
+    int const H = img.Size.GetHeight();
+    if (W < 3 || H < 3)
+        return true;
+    if (dark && (dark->m_below.empty() || dark->m_size != img.Size))
+        return true;
+
+#if defined(PHD_OPENCL)
+    if (!ImageMathReference())
+    {
+        GpuCompute *gpu = GpuCompute::Get(img.NPixels);
+        if (gpu && !gpu->CalibrateFrame(img, dark, noiseReduction, stats))
+            return false;
+    }
+#endif
+
+    usImage tmp;
+    bool const output = dark || noiseReduction != NR_NONE;
+    if (output && tmp.Init(img.Size))
+        return true;
+
+    CalibrateJob job;
+    job.src = img.ImageData;
+    job.dst = output ? tmp.ImageData : NULL;
+    job.W = W;
+    job.H = H;
+    job.dark = dark;
+    job.nr = noiseReduction;
+    job.stats = stats;
+
+    int const nstrips = ImageStripCount(H, 128);
+    job.stripStats.resize(nstrips);
+    RunImageStrips(job, nstrips, H);
+
+    if (output)
+        img.SwapImageData(tmp);
+    if (dark)
+        img.Pedestal = dark->Pedestal();
+
+    if (stats)
+    {
+        img.Min = img.FiltMin = 65535;
+        img.Max = img.FiltMax = 0;
+        for (int i = 0; i < nstrips; i++)
+        {
+            const CalibrateStats& st = job.stripStats[i];
+            img.Min = wxMin(img.Min, st.min);
+            img.Max = wxMax(img.Max, st.max);
+            img.FiltMin = wxMin(img.FiltMin, st.filtMin);
+            img.FiltMax = wxMax(img.FiltMax, st.filtMax);
+        }
+    }
+
+    return false;
+}
+
+// Sliding-window median used to build the filtered dark for the defect map.
+// The window is moved in snake order (left to right, down one row, right to
+// left, ...) so that each step adds and removes a single column or row of the
+// window and the histogram never needs to be rebuilt. The histogram is split
+// into coarse and fine levels sized to the bit depth of the image, and each
+// lookup starts from the previous median, so finding the median costs a few
+// bin visits. Each strip of rows is filtered independently on its own thread.
+class MedianFilterHisto
+{
+    unsigned int m_shift;
+    std::vector<unsigned short> m_coarse;
+    std::vector<unsigned short> m_fine;
+    unsigned int m_med;  // median of the window at the previous lookup
+    unsigned int m_lt;   // number of pixels in the window less than m_med
+
+public:
+    MedianFilterHisto(unsigned int bits)
+        : m_shift(bits / 2), m_coarse(1U << (bits - bits / 2)), m_fine(1U << bits), m_med(0), m_lt(0) { }
+
+    void Add(unsigned short v)
+    {
+        ++m_coarse[v >> m_shift];
+        ++m_fine[v];
+        if (v < m_med)
+            ++m_lt;
+    }
+
+    void Remove(unsigned short v)
+    {
+        --m_coarse[v >> m_shift];
+        --m_fine[v];
+        if (v < m_med)
+            --m_lt;
+    }
+
+    void AddColumn(const unsigned short *p, int width, int rows)
+    {
+        for (int j = 0; j < rows; j++, p += width)
+            Add(*p);
+    }
+
+    void RemoveColumn(const unsigned short *p, int width, int rows)
+    {
+        for (int j = 0; j < rows; j++, p += width)
+            Remove(*p);
+    }
+
+    void AddRow(const unsigned short *p, int cols)
+    {
+        for (int i = 0; i < cols; i++)
+            Add(p[i]);
+    }
+
+    void RemoveRow(const unsigned short *p, int cols)
+    {
+        for (int i = 0; i < cols; i++)
+            Remove(p[i]);
+    }
+
+    // the value at index n/2 of the n pixels in the window; the search starts
+    // from the previous median, which is usually close, and steps over whole
+    // coarse bins when it can
+    unsigned short Median(unsigned int n)
+    {
+        unsigned int const k = n / 2;
+        unsigned int const binSize = 1U << m_shift;
+
+        while (m_lt > k)
+        {
+            // move down
+            if ((m_med & (binSize - 1)) == 0 && m_lt - m_coarse[(m_med >> m_shift) - 1] > k)
+            {
+                m_lt -= m_coarse[(m_med >> m_shift) - 1];
+                m_med -= binSize;
+            }
+            else
+                m_lt -= m_fine[--m_med];
+        }
+
+        while (m_lt + m_fine[m_med] <= k)
+        {
+            // move up
+            if ((m_med & (binSize - 1)) == 0 && m_lt + m_coarse[m_med >> m_shift] <= k)
+            {
+                m_lt += m_coarse[m_med >> m_shift];
+                m_med += binSize;
+            }
+            else
+                m_lt += m_fine[m_med++];
+        }
+
+        return (unsigned short) m_med;
+    }
+};
+
+struct MedianFilterJob : public ImageStripJob
+{
+    usImage& dst;
+    const usImage& src;
+    int halfWidth;
+    unsigned int bits;
+
+    MedianFilterJob(usImage& dst_, const usImage& src_, int halfWidth_, unsigned int bits_)
+        : dst(dst_), src(src_), halfWidth(halfWidth_), bits(bits_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void MedianFilterJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const width = src.Size.GetWidth();
+    int const height = src.Size.GetHeight();
+    const unsigned short *const s = src.ImageData;
+    unsigned short *const d = dst.ImageData;
+
+    MedianFilterHisto histo(bits);
+
+    int top = std::max(0, rowBegin - halfWidth);
+    int bot = std::min(rowBegin + halfWidth, height - 1);
+    int left = 0;
+    int right = std::min(halfWidth, width - 1);
+
+    for (int j = top; j <= bot; j++)
+        histo.AddRow(&s[j * width], right + 1);
+
+    int x = 0;
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        if (y > rowBegin)
+        {
+            // move the window down one row at column x
+            if (y - halfWidth - 1 >= 0)
+            {
+                histo.RemoveRow(&s[top * width + left], right - left + 1);
+                ++top;
+            }
+            if (y + halfWidth <= height - 1)
+            {
+                ++bot;
+                histo.AddRow(&s[bot * width + left], right - left + 1);
+            }
+        }
+
+        int const rows = bot - top + 1;
+        unsigned short *dr = &d[y * width];
+
+        dr[x] = histo.Median((right - left + 1) * rows);
+
+        if (((y - rowBegin) & 1) == 0)
+        {
+            // left to right
+            for (++x; x < width; x++)
+            {
+                if (x - halfWidth - 1 >= 0)
+                {
+                    histo.RemoveColumn(&s[top * width + left], width, rows);
+                    ++left;
+                }
+                if (x + halfWidth <= width - 1)
+                {
+                    ++right;
+                    histo.AddColumn(&s[top * width + right], width, rows);
+                }
+                dr[x] = histo.Median((right - left + 1) * rows);
+            }
+            x = width - 1;
+        }
+        else
+        {
+            // right to left
+            for (--x; x >= 0; x--)
+            {
+                if (x + halfWidth + 1 <= width - 1)
+                {
+                    histo.RemoveColumn(&s[top * width + right], width, rows);
+                    --right;
+                }
+                if (x - halfWidth >= 0)
+                {
+                    --left;
+                    histo.AddColumn(&s[top * width + left], width, rows);
+                }
+                dr[x] = histo.Median((right - left + 1) * rows);
+            }
+            x = 0;
+        }
+    }
+}
+
+void MedianFilter(usImage& dst, const usImage& src, int halfWidth)
+{
+#if defined(PHD_OPENCL)
+    if (!ImageMathReference())
+    {
+        GpuCompute *gpu = GpuCompute::Get(src.NPixels);
+        if (gpu && !gpu->MedianFilter(dst, src, halfWidth))
+            return;
+    }
+#endif
+
+    dst.Init(src.Size);
+
+    // size the histogram to the range of the data
+    unsigned short maxval = 0;
+    for (unsigned int i = 0; i < src.NPixels; i++)
+        if (src.ImageData[i] > maxval)
+            maxval = src.ImageData[i];
+    unsigned int bits = 1;
+    while (bits < 16 && (maxval >> bits) != 0)
+        ++bits;
+
+    MedianFilterJob job(dst, src, halfWidth, bits);
+
+    enum { MIN_STRIP_ROWS = 64 };
+    int const height = src.Size.GetHeight();
+    RunImageStrips(job, ImageStripCount(height, MIN_STRIP_ROWS), height);
+}
+
+ImageHistogram::ImageHistogram()
+    : m_bins(65536, 0U), m_count(0)
+{
+}
+
+void ImageHistogram::Clear()
+{
+    std::fill(m_bins.begin(), m_bins.end(), 0U);
+    m_count = 0;
+}
+
+// Count n pixels into bins. Successive pixels go to two separate tables so
+// that a run of equal values does not serialize on a single counter.
+static void count_pixels(unsigned int *bins, unsigned int *bins2, const unsigned short *px, unsigned int n)
+{
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        ++bins[px[i]];
+        ++bins2[px[i + 1]];
+        ++bins[px[i + 2]];
+        ++bins2[px[i + 3]];
+    }
+    for (; i < n; i++)
+        ++bins[px[i]];
+}
+
+struct HistogramJob : public ImageStripJob
+{
+    const usImage& img;
+    const wxRect& rect;
+    std::vector<std::vector<unsigned int> > bins;   // two tables per strip
+
+    HistogramJob(const usImage& img_, const wxRect& rect_, int nstrips)
+        : img(img_), rect(rect_), bins(2 * nstrips) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        std::vector<unsigned int>& b0 = bins[2 * strip];
+        std::vector<unsigned int>& b1 = bins[2 * strip + 1];
+        b0.assign(65536, 0U);
+        b1.assign(65536, 0U);
+
+        for (int y = rowBegin; y < rowEnd; y++)
+            count_pixels(&b0[0], &b1[0], &img.Pixel(rect.GetLeft(), rect.GetTop() + y), rect.GetWidth());
+    }
+};
+
+void ImageHistogram::Build(const unsigned short *px, unsigned int n)
+{
+    std::vector<unsigned int> bins2(65536, 0U);
+    Clear();
+    count_pixels(&m_bins[0], &bins2[0], px, n);
+    for (unsigned int v = 0; v < 65536; v++)
+        m_bins[v] += bins2[v];
+    m_count = n;
+}
+
+void ImageHistogram::Build(const usImage& img, const wxRect& rect)
+{
+    Clear();
+
+    wxRect r(rect);
+    r.Intersect(img.DataRect);
+    if (r.IsEmpty() || !img.ImageData)
+        return;
+
+    // merging costs a pass over the bins per strip, so only split large windows
+    enum { MIN_STRIP_ROWS = 256 };
+    int const nstrips = ImageStripCount(r.GetHeight(), MIN_STRIP_ROWS);
+
+    HistogramJob job(img, r, nstrips);
+    RunImageStrips(job, nstrips, r.GetHeight());
+
+    for (size_t i = 0; i < job.bins.size(); i++)
+    {
+        const unsigned int *b = &job.bins[i][0];
+        for (unsigned int v = 0; v < 65536; v++)
+            m_bins[v] += b[v];
+    }
+    m_count = (unsigned int) r.GetWidth() * (unsigned int) r.GetHeight();
+}
+
+unsigned short ImageHistogram::Min() const
+{
+    unsigned int v = 0;
+    while (v < 65535 && !m_bins[v])
+        ++v;
+    return (unsigned short) v;
+}
+
+unsigned short ImageHistogram::Max() const
+{
+    unsigned int v = 65535;
+    while (v > 0 && !m_bins[v])
+        --v;
+    return (unsigned short) v;
+}
+
+double ImageHistogram::Mean() const
+{
+    if (!m_count)
+        return 0.0;
+
+    double sum = 0.0;
+    for (unsigned int v = Min(), end = Max(); v <= end; v++)
+        sum += (double) m_bins[v] * (double) v;
+    return sum / (double) m_count;
+}
+
+double ImageHistogram::Stdev() const
+{
+    if (!m_count)
+        return 0.0;
+
+    double const mean = Mean();
+    double q = 0.0;
+    for (unsigned int v = Min(), end = Max(); v <= end; v++)
+    {
+        double const d = (double) v - mean;
+        q += (double) m_bins[v] * d * d;
+    }
+    return sqrt(q / (double) m_count);
+}
+
+unsigned short ImageHistogram::Rank(unsigned int rank) const
+{
+    unsigned int cnt = 0;
+    unsigned int v = 0;
+    for (; v < 65535; v++)
+    {
+        cnt += m_bins[v];
+        if (cnt > rank)
+            break;
+    }
+    return (unsigned short) v;
+}
+
+unsigned short ImageHistogram::MAD() const
+{
+    if (!m_count)
+        return 0;
+
+    // widen a window around the median until it holds more than half of the
+    // pixels; the absolute deviations inside the window are all <= d
+    int const med = Median();
+    unsigned int const rank = m_count / 2;
+    unsigned int cnt = m_bins[med];
+    int d = 0;
+    while (cnt <= rank && d < 65535)
+    {
+        ++d;
+        if (med - d >= 0)
+            cnt += m_bins[med - d];
+        if (med + d <= 65535)
+            cnt += m_bins[med + d];
+    }
+    return (unsigned short) d;
+}
+
+void ImageHistogram::GetStats(ImageStats *stats) const
+{
+    stats->mean = Mean();
+    stats->stdev = Stdev();
+    stats->median = Median();
+    stats->mad = MAD();
+}
+
+void DefectMapDarks::BuildFilteredDark()
+{
+    enum { WINDOW = 15 };
+    filteredDark.Init(masterDark.Size);
+    MedianFilter(filteredDark, masterDark, WINDOW);
+}
+
+static wxString DefectMapMasterPath(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDarksDir() + PATHSEPSTR +
+        wxString::Format("PHD2_defect_map_master%s_%d.fit", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+static wxString DefectMapMasterPath()
+{
+    return DefectMapMasterPath(pConfig->GetCurrentProfileId());
+}
+
+static wxString DefectMapFilterPath(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDarksDir() + PATHSEPSTR +
+        wxString::Format("PHD2_defect_map_master_filt%s_%d.fit", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+static wxString DefectMapFilterPath()
+{
+    return DefectMapFilterPath(pConfig->GetCurrentProfileId());
+}
+
+void DefectMapDarks::SaveDarks(const wxString& notes)
+{
+    masterDark.Save(DefectMapMasterPath(), notes);
+    filteredDark.Save(DefectMapFilterPath());
+}
+
+void DefectMapDarks::LoadDarks()
+{
+    masterDark.Load(DefectMapMasterPath());
+    filteredDark.Load(DefectMapFilterPath());
+}
+
+struct BadPx
+{
+    unsigned short x;
+    unsigned short y;
+    int v;
+
+    BadPx() { }
+    BadPx(int x_, int y_, int v_) : x(x_), y(y_), v(v_) { }
+    bool operator<(const BadPx& rhs) const { return v < rhs.v; }
+};
+
+// candidate defects sorted by deviation, ties in scan order
+typedef std::vector<BadPx> BadPxList;
+
+struct DefectMapBuilderImpl
+{
+    DefectMapDarks *darks;
+    ImageStats stats;
+    wxArrayString mapInfo;
+    int aggrCold;
+    int aggrHot;
+    BadPxList coldPx;
+    BadPxList hotPx;
+    size_t coldPxThresh;    // index of the first selected candidate
+    size_t hotPxThresh;
+    unsigned int coldPxSelected;
+    unsigned int hotPxSelected;
+    bool threshValid;
+
+    DefectMapBuilderImpl()
+        :
+        darks(0),
+        aggrCold(100),
+        aggrHot(100),
+        coldPxThresh(0),
+        hotPxThresh(0),
+        threshValid(false)
+    { }
+};
+
+DefectMapBuilder::DefectMapBuilder()
+    : m_impl(new DefectMapBuilderImpl())
+{
+}
+
+DefectMapBuilder::~DefectMapBuilder()
+{
+    delete m_impl;
+}
+
+inline static double AggrToSigma(int val)
+{
+    // Aggressiveness of 0 to 100 maps to signma factor from 8.0 to 0.125
+    return exp2(3.0 - (6.0 / 100.0) * (double)val);
+}
+
+// Collects the pixels deviating from the median filtered dark by more than
+// thresh, each strip into its own lists, in scan order
+struct DefectCandidateJob : public ImageStripJob
+{
+    const usImage& dark;
+    const usImage& filt;
+    int thresh;
+    std::vector<BadPxList> hot;
+    std::vector<BadPxList> cold;
+
+    DefectCandidateJob(const usImage& dark_, const usImage& filt_, int thresh_, int nstrips)
+        : dark(dark_), filt(filt_), thresh(thresh_), hot(nstrips), cold(nstrips) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        int const width = dark.Size.GetWidth();
+        BadPxList& h = hot[strip];
+        BadPxList& c = cold[strip];
+        for (int y = rowBegin; y < rowEnd; y++)
+        {
+            const unsigned short *d = dark.ImageData + (size_t) y * width;
+            const unsigned short *f = filt.ImageData + (size_t) y * width;
+            for (int x = 0; x < width; x++)
+            {
+                int v = (int) d[x] - (int) f[x];
+                if (v > thresh)
+                    h.push_back(BadPx(x, y, v));
+                else if (-v > thresh)
+                    c.push_back(BadPx(x, y, -v));
+            }
+        }
+    }
+};
+
+// Stable LSD radix sort on the deviation, which is in 1..65535, so ties stay
+// in scan order
+static void sort_by_deviation(BadPxList& px)
+{
+    BadPxList tmp(px.size());
+    for (int shift = 0; shift < 16; shift += 8)
+    {
+        size_t pos[257] = { 0 };
+        for (BadPxList::const_iterator it = px.begin(); it != px.end(); ++it)
+            ++pos[((it->v >> shift) & 0xff) + 1];
+        for (int i = 1; i < 257; i++)
+            pos[i] += pos[i - 1];
+        for (BadPxList::const_iterator it = px.begin(); it != px.end(); ++it)
+            tmp[pos[(it->v >> shift) & 0xff]++] = *it;
+        px.swap(tmp);
+    }
+}
+
+static void gather_candidates(BadPxList *dst, std::vector<BadPxList>& strips)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < strips.size(); i++)
+        n += strips[i].size();
+    dst->clear();
+    dst->reserve(n);
+    for (size_t i = 0; i < strips.size(); i++)
+    {
+        dst->insert(dst->end(), strips[i].begin(), strips[i].end());
+        BadPxList().swap(strips[i]);
+    }
+    sort_by_deviation(*dst);
+}
+
+void DefectMapBuilder::Init(DefectMapDarks& darks)
+{
+    m_impl->darks = &darks;
+
+    Debug.AddLine("DefectMapBuilder: Init");
+
+    {
+        ImageHistogram histo;
+        histo.Build(darks.masterDark, wxRect(darks.masterDark.Size));
+        histo.GetStats(&m_impl->stats);
+    }
+
+    const ImageStats& stats = m_impl->stats;
+
+    Debug.Write(wxString::Format("DefectMapBuilder: Dark N = %d Mean = %.f Median = %d Standard Deviation = %.f MAD=%d\n",
+                                 darks.masterDark.NPixels, stats.mean, stats.median, stats.stdev, stats.mad));
+
+    // load potential defects
+
+    int thresh = (int)(AggrToSigma(100) * stats.stdev);
+
+    Debug.Write(wxString::Format("DefectMapBuilder: load potential defects thresh = %d\n", thresh));
+
+    usImage& dark = m_impl->darks->masterDark;
+    usImage& medianFilt = m_impl->darks->filteredDark;
+
+    m_impl->coldPx.clear();
+    m_impl->hotPx.clear();
+    m_impl->threshValid = false;
+
+    if (dark.ImageData && medianFilt.ImageData && dark.Size == medianFilt.Size)
+    {
+        int const height = dark.Size.GetHeight();
+        int const nstrips = ImageStripCount(height, 64);
+        DefectCandidateJob job(dark, medianFilt, thresh, nstrips);
+        RunImageStrips(job, nstrips, height);
+        gather_candidates(&m_impl->hotPx, job.hot);
+        gather_candidates(&m_impl->coldPx, job.cold);
+    }
+
+    Debug.Write(wxString::Format("DefectMapBuilder: Loaded %d cold %d hot\n", m_impl->coldPx.size(), m_impl->hotPx.size()));
+}
+
+const ImageStats& DefectMapBuilder::GetImageStats() const
+{
+    return m_impl->stats;
+}
+
+void DefectMapBuilder::SetAggressiveness(int aggrCold, int aggrHot)
+{
+    m_impl->aggrCold = std::max(0, std::min(100, aggrCold));
+    m_impl->aggrHot = std::max(0, std::min(100, aggrHot));
+    m_impl->threshValid = false;
+}
+
+static void FindThresh(DefectMapBuilderImpl *impl)
+{
+    if (impl->threshValid)
+        return;
+
+    double multCold = AggrToSigma(impl->aggrCold);
+    double multHot = AggrToSigma(impl->aggrHot);
+
+    int coldThresh = (int) (multCold * impl->stats.stdev);
+    int hotThresh = (int) (multHot * impl->stats.stdev);
+
+    Debug.Write(wxString::Format("DefectMap: find thresholds aggr:(%d,%d) sigma:(%.1f,%.1f) px:(%+d,%+d)\n",
+                                 impl->aggrCold, impl->aggrHot, multCold, multHot, -coldThresh, hotThresh));
+
+    impl->coldPxThresh = std::lower_bound(impl->coldPx.begin(), impl->coldPx.end(), BadPx(0, 0, coldThresh)) - impl->coldPx.begin();
+    impl->hotPxThresh = std::lower_bound(impl->hotPx.begin(), impl->hotPx.end(), BadPx(0, 0, hotThresh)) - impl->hotPx.begin();
+
+    impl->coldPxSelected = impl->coldPx.size() - impl->coldPxThresh;
+    impl->hotPxSelected = impl->hotPx.size() - impl->hotPxThresh;
+
+    Debug.Write(wxString::Format("DefectMap: find thresholds found (%d,%d)\n", impl->coldPxSelected, impl->hotPxSelected));
+
+    impl->threshValid = true;
+}
+
+int DefectMapBuilder::GetColdPixelCnt() const
+{
+    FindThresh(m_impl);
+    return m_impl->coldPxSelected;
+}
+
+int DefectMapBuilder::GetHotPixelCnt() const
+{
+    FindThresh(m_impl);
+    return m_impl->hotPxSelected;
+}
+
+inline static unsigned int emit_defects(DefectMap& defectMap, BadPxList::const_iterator p0, BadPxList::const_iterator p1, double stdev, int sign, bool verbose)
+{
+    unsigned int cnt = 0;
+    for (BadPxList::const_iterator it = p0; it != p1; ++it, ++cnt)
+    {
+        if (verbose)
+        {
+            int v = sign * it->v;
+            Debug.Write(wxString::Format("DefectMap: defect @ (%d, %d) val = %d (%+.1f sigma)\n", it->x, it->y, v, stdev > 0.1 ? (double)v / stdev : 0.0));
+        }
+        defectMap.push_back(wxPoint(it->x, it->y));
+    }
+    return cnt;
+}
+
+void DefectMapBuilder::BuildDefectMap(DefectMap& defectMap, bool verbose) const
+{
+    wxArrayString& info = m_impl->mapInfo;
+
+    double multCold = AggrToSigma(m_impl->aggrCold);
+    double multHot = AggrToSigma(m_impl->aggrHot);
+    const ImageStats& stats = m_impl->stats;
+
+    info.Clear();
+    info.push_back(wxString::Format("Generated: %s", wxDateTime::UNow().FormatISOCombined(' ')));
+    info.push_back(wxString::Format("Camera: %s", pCamera->Name));
+    info.push_back(wxString::Format("Dark Exposure Time: %d ms", m_impl->darks->masterDark.ImgExpDur));
+    info.push_back(wxString::Format("Dark Frame Count: %d", m_impl->darks->masterDark.ImgStackCnt));
+    info.push_back(wxString::Format("Aggressiveness, cold: %d", m_impl->aggrCold));
+    info.push_back(wxString::Format("Aggressiveness, hot: %d", m_impl->aggrHot));
+    info.push_back(wxString::Format("Sigma Thresh, cold: %.2f", multCold));
+    info.push_back(wxString::Format("Sigma Thresh, hot: %.2f", multHot));
+    info.push_back(wxString::Format("Mean: %.f", stats.mean));
+    info.push_back(wxString::Format("Stdev: %.f", stats.stdev));
+    info.push_back(wxString::Format("Median: %d", stats.median));
+    info.push_back(wxString::Format("MAD: %d", stats.mad));
+
+    int deltaCold = (int)(multCold * stats.stdev);
+    int deltaHot = (int)(multHot * stats.stdev);
+
+    info.push_back(wxString::Format("DeltaCold: %+d", -deltaCold));
+    info.push_back(wxString::Format("DeltaHot: %+d", deltaHot));
+
+    if (verbose) Debug.Write(wxString::Format("DefectMap: deltaCold = %+d deltaHot = %+d\n", -deltaCold, deltaHot));
+
+    FindThresh(m_impl);
+
+    defectMap.clear();
+    defectMap.reserve(m_impl->coldPxSelected + m_impl->hotPxSelected);
+    unsigned int nr_cold = emit_defects(defectMap, m_impl->coldPx.begin() + m_impl->coldPxThresh, m_impl->coldPx.end(), stats.stdev, -1, verbose);
+    unsigned int nr_hot = emit_defects(defectMap, m_impl->hotPx.begin() + m_impl->hotPxThresh, m_impl->hotPx.end(), stats.stdev, +1, verbose);
+    defectMap.BuildIndex();
+
+    if (verbose) Debug.Write(wxString::Format("New defect map created, count=%d (cold=%d, hot=%d)\n", defectMap.size(), nr_cold, nr_hot));
+}
+
+const wxArrayString& DefectMapBuilder::GetMapInfo() const
+{
+    return m_impl->mapInfo;
+}
+
+// Repairs a run of defects from the precomputed tables of a DefectMap. The
+// defects with good neighbors only read pixels that are not defects, so they
+// can be repaired in any order, and in parallel; the "rows" of the strips are
+// defects.
+struct RemoveDefectsJob : public ImageStripJob
+{
+    typedef DefectMap::Repair Repair;
+
+    unsigned short *px;
+    const Repair *repairs;
+
+    RemoveDefectsJob(unsigned short *px_, const Repair *repairs_) : px(px_), repairs(repairs_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        Apply(px, repairs + rowBegin, repairs + rowEnd);
+    }
+
+    static unsigned short Median(unsigned short *l, unsigned int n)
+    {
+        switch (n)
+        {
+        case 1: return l[0];
+        case 2: return (unsigned short)(((unsigned int) l[0] + (unsigned int) l[1]) / 2);
+        case 3: return median3(l);
+        case 4: return median4(l);
+        case 5: return median5(l);
+        case 6: return median6(l);
+        case 7: std::nth_element(l, l + 3, l + 7); return l[3];
+        default: return median8(l);
+        }
+    }
+
+    static void Apply(unsigned short *px, const Repair *first, const Repair *last)
+    {
+        unsigned short l[8];
+        for (const Repair *r = first; r != last; ++r)
+        {
+            for (unsigned int i = 0; i < r->count; i++)
+                l[i] = px[r->nbr[i]];
+            px[r->pixel] = Median(l, r->count);
+        }
+    }
+
+    struct PixelLess
+    {
+        bool operator()(const Repair& a, unsigned int b) const { return a.pixel < b; }
+        bool operator()(unsigned int a, const Repair& b) const { return a < b.pixel; }
+        bool operator()(const Repair& a, const Repair& b) const { return a.pixel < b.pixel; }
+    };
+
+    // repair the defects of the table inside rect
+    static void ApplyRect(unsigned short *px, const std::vector<Repair>& table, const wxRect& rect, int width)
+    {
+        if (table.empty())
+            return;
+        const Repair *begin = &table[0];
+        const Repair *end = begin + table.size();
+        for (int y = rect.GetTop(); y <= rect.GetBottom(); y++)
+        {
+            unsigned int const row = (unsigned int) y * width;
+            const Repair *first = std::lower_bound(begin, end, row + rect.GetLeft(), PixelLess());
+            const Repair *last = std::upper_bound(first, end, row + rect.GetRight(), PixelLess());
+            Apply(px, first, last);
+        }
+    }
+};
+
+bool RemoveDefects(usImage& light, const DefectMap& defectMap)
+{
+    PERF_STAGE(PERF_STAGE_DEFECTS);
+
+    // Check to make sure the light frame is valid
+    if (!light.ImageData)
+        return true;
+
+    // the repair tables index the full frame, an ROI-only image has its
+    // defects repaired one at a time
+    if (defectMap.IsIndexed() && !light.IsROIOnly())
+    {
+        if (defectMap.m_repairSize != light.Size)
+            defectMap.PrepareRepairs(light.Size);
+
+        const std::vector<DefectMap::Repair>& repairs = defectMap.m_repairs;
+        const std::vector<DefectMap::Repair>& clustered = defectMap.m_clustered;
+
+        if (light.Subframe.IsEmpty())
+        {
+            if (!repairs.empty())
+            {
+                RemoveDefectsJob job(light.ImageData, &repairs[0]);
+                int const n = (int) repairs.size();
+                RunImageStrips(job, ImageStripCount(n, 4096), n);
+            }
+            if (!clustered.empty())
+                RemoveDefectsJob::Apply(light.ImageData, &clustered[0], &clustered[0] + clustered.size());
+        }
+        else
+        {
+            // only visit the defects inside the subframe
+            wxRect rect(light.Subframe);
+            rect.Intersect(wxRect(light.Size));
+            RemoveDefectsJob::ApplyRect(light.ImageData, repairs, rect, light.Size.GetWidth());
+            RemoveDefectsJob::ApplyRect(light.ImageData, clustered, rect, light.Size.GetWidth());
+        }
+    }
+    else if (!light.Subframe.IsEmpty())
+    {
+        // Step over each defect and replace the light value
+        // with the median of the surrounding pixels
+        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
+        {
+            const wxPoint& pt = *it;
+            // Check to see if we are within the subframe before correcting the defect
+            if (light.Subframe.Contains(pt))
+            {
+                light.Pixel(pt.x, pt.y) = MedianBorderingPixels(light, pt.x, pt.y);
+            }
+        }
+    }
+    else
+    {
+        // Step over each defect and replace the light value
+        // with the median of the surrounding pixels
+        for (DefectMap::const_iterator it = defectMap.begin(); it != defectMap.end(); ++it)
+        {
+            int const x = it->x;
+            int const y = it->y;
+
+            if (x >= 0 && x < light.Size.GetWidth() && y >= 0 && y < light.Size.GetHeight())
+            {
+                light.Pixel(x, y) = MedianBorderingPixels(light, x, y);
+            }
+        }
+    }
+
+    return false;
+}
+
+wxString DefectMap::DefectMapFileName(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDarksDir() + PATHSEPSTR +
+        wxString::Format("PHD2_defect_map%s_%d.txt", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+
+bool DefectMap::ImportFromProfile(int srcId, int destId)
+{
+    wxString sourceName;
+    wxString destName;
+    int rslt;
+
+    sourceName = DefectMapFileName(srcId);
+    destName = DefectMapFileName(destId);
+    DarkLibCache::Remove(destName); // the copy may keep the source timestamp
+    rslt = wxCopyFile(sourceName, destName, true);
+    if (rslt != 1)
+    {
+        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map copy of %s to %s\n", sourceName, destName));
+        return false;
+    }
+    sourceName = DefectMapMasterPath(srcId);
+    destName = DefectMapMasterPath(destId);
+    rslt = wxCopyFile(sourceName, destName, true);
+    if (rslt != 1)
+    {
+        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map master dark copy of %s to %s\n", sourceName, destName));
+        return false;
+    }
+    sourceName = DefectMapFilterPath(srcId);
+    destName = DefectMapFilterPath(destId);
+    rslt = wxCopyFile(sourceName, destName, true);
+    if (rslt != 1)
+    {
+        Debug.Write(wxString::Format("DefectMap::ImportFromProfile failed on defect map master filtered dark copy of %s to %s\n", sourceName, destName));
+        return false;
+    }
+    return (true);
+}
+
+bool DefectMap::DefectMapExists(int profileId, bool showAlert)
+{
+    bool bOk = false;
+
+    if (wxFileExists(DefectMapFileName(profileId)))
+    {
+        wxString fName = DefectMapMasterPath(profileId);
+        const wxSize& sensorSize = pCamera->DarkFrameSize();
+        if (sensorSize == UNDEFINED_FRAME_SIZE)
+        {
+            bOk = true;
+            Debug.AddLine("BPM check: undefined frame size for current camera");
+        }
+        else
+        {
+            fitsfile *fptr;
+            int status = 0;  // CFITSIO status value MUST be initialized to zero!
+
+            if (PHD_fits_open_diskfile(&fptr, fName, READONLY, &status) == 0)
+            {
+                long fsize[2];
+                fits_get_img_size(fptr, 2, fsize, &status);
+                if (status == 0 && fsize[0] == sensorSize.x && fsize[1] == sensorSize.y)
+                    bOk = true;
+                else
+                {
+                    Debug.AddLine(wxString::Format("BPM check: failed geometry check - fits status = %d, cam dimensions = {%d,%d}, "
+                        " BPM dimensions = {%d,%d}", status, sensorSize.x, sensorSize.y, fsize[0], fsize[1]));
+                    if (showAlert)
+                        pFrame->Alert(_("Bad-pixel map does not match the camera in this profile - it needs to be replaced."));
+                }
+
+                PHD_fits_close_file(fptr);
+            }
+            else
+                Debug.AddLine(wxString::Format("BPM check: fitsio error on open_diskfile = %d", status));
+        }
+    }
+
+    return bOk;
+}
+
+void DefectMap::Save(const wxArrayString& info) const
+{
+    wxString filename = DefectMapFileName(m_profileId);
+    DarkLibCache::Remove(filename);
+    wxFileOutputStream oStream(filename);
+    wxTextOutputStream outText(oStream);
+
+    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
+    {
+        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
+        return;
+    }
+
+    outText << "# PHD2 Defect Map v1\n";
+
+    for (wxArrayString::const_iterator it = info.begin(); it != info.end(); ++it)
+    {
+        outText << "# " << *it << "\n";
+    }
+    outText << "# Defect count: " << ((unsigned int) size()) << "\n";
+
+    for (const_iterator it = begin(); it != end(); ++it)
+    {
+        outText << it->x << " " << it->y << "\n";
+    }
+
+    oStream.Close();
+    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+}
+
+DefectMap::DefectMap()
+    : m_profileId(pConfig->GetCurrentProfileId()),
+      m_indexedSize(0),
+      m_indexed(false),
+      m_repairSize(0, 0)
+{
+}
+
+DefectMap::DefectMap(int profileId)
+    : m_profileId(profileId),
+      m_indexedSize(0),
+      m_indexed(false),
+      m_repairSize(0, 0)
+{
+}
+
+inline static bool defect_less(const wxPoint& a, const wxPoint& b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+void DefectMap::BuildIndex()
+{
+    std::sort(begin(), end(), defect_less);
+
+    m_rowStart.clear();
+    m_indexed = false;
+
+    m_repairs.clear();
+    m_clustered.clear();
+    m_repairSize = wxSize(0, 0);
+
+    int const maxY = empty() ? -1 : back().y;
+    if (maxY > MAX_INDEXED_ROW)
+    {
+        // junk in the map file, leave the map sorted but unindexed
+        Debug.AddLine(wxString::Format("DefectMap: not indexing, defect row %d out of range", maxY));
+        return;
+    }
+
+    if (maxY >= 0)
+    {
+        m_rowStart.resize(maxY + 2);
+        unsigned int i = 0;
+        for (int y = 0; y <= maxY + 1; y++)
+        {
+            while (i < size() && (*this)[i].y < y)
+                ++i;
+            m_rowStart[y] = i;
+        }
+    }
+
+    m_indexedSize = size();
+    m_indexed = true;
+}
+
+// get the defects in row y with x0 <= x <= x1
+void DefectMap::RowRange(int y, int x0, int x1, const_iterator *first, const_iterator *last) const
+{
+    assert(IsIndexed());
+
+    if (y < 0 || y + 1 >= (int) m_rowStart.size())
+    {
+        *first = *last = end();
+        return;
+    }
+
+    const_iterator row0 = begin() + m_rowStart[y];
+    const_iterator row1 = begin() + m_rowStart[y + 1];
+    *first = std::lower_bound(row0, row1, wxPoint(x0, y), defect_less);
+    *last = std::upper_bound(*first, row1, wxPoint(x1, y), defect_less);
+}
+
+bool DefectMap::FindDefect(const wxPoint& pt) const
+{
+    if (IsIndexed())
+        return std::binary_search(begin(), end(), pt, defect_less);
+    return std::find(begin(), end(), pt) != end();
+}
+
+void DefectMap::PrepareRepairs(const wxSize& frameSize) const
+{
+    m_repairs.clear();
+    m_clustered.clear();
+    m_repairSize = wxSize(0, 0);
+
+    if (!IsIndexed())
+        return;
+
+    int const width = frameSize.GetWidth();
+    int const height = frameSize.GetHeight();
+
+    // the defects inside the frame, by pixel index; the map is sorted by
+    // row then column, so this is sorted too
+    std::vector<unsigned int> defects;
+    defects.reserve(size());
+    for (const_iterator it = begin(); it != end(); ++it)
+    {
+        if (it->x >= 0 && it->x < width && it->y >= 0 && it->y < height)
+        {
+            unsigned int const px = (unsigned int) it->y * width + it->x;
+            if (defects.empty() || defects.back() != px)
+                defects.push_back(px);
+        }
+    }
+
+    m_repairs.reserve(defects.size());
+
+    for (std::vector<unsigned int>::const_iterator it = defects.begin(); it != defects.end(); ++it)
+    {
+        int const x = *it % width;
+        int const y = *it / width;
+
+        Repair good, all;
+        good.pixel = all.pixel = *it;
+        good.count = all.count = 0;
+
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= width || y + dy < 0 || y + dy >= height)
+                    continue;
+                unsigned int const px = (unsigned int) (y + dy) * width + x + dx;
+                all.nbr[all.count++] = px;
+                if (!std::binary_search(defects.begin(), defects.end(), px))
+                    good.nbr[good.count++] = px;
+            }
+        }
+
+        if (good.count > 0)
+            m_repairs.push_back(good);
+        else if (all.count > 0)
+            m_clustered.push_back(all);
+    }
+
+    m_repairSize = frameSize;
+
+    Debug.Write(wxString::Format("DefectMap: repair tables for %dx%d, %u defects, %u clustered\n",
+        width, height, (unsigned int) m_repairs.size(), (unsigned int) m_clustered.size()));
+}
+
+void DefectMap::AddDefect(const wxPoint& pt)
+{
+    // first add the point, keeping the map sorted
+    if (IsIndexed())
+    {
+        insert(std::upper_bound(begin(), end(), pt, defect_less), pt);
+        BuildIndex();
+    }
+    else
+        push_back(pt);
+
+    wxString filename = DefectMapFileName(m_profileId);
+    wxFile file(filename, wxFile::write_append);
+    wxFileOutputStream oStream(file);
+    wxTextOutputStream outText(oStream);
+
+    if (oStream.GetLastError() != wxSTREAM_NO_ERROR)
+    {
+        Debug.AddLine(wxString::Format("Failed to save defect map to %s", filename));
+        return;
+    }
+
+    outText << pt.x << " " << pt.y << "\n";
+
+    oStream.Close();
+    Debug.AddLine(wxString::Format("Saved defect map to %s", filename));
+}
+
+DefectMap *DefectMap::LoadDefectMap(int profileId)
+{
+    wxString filename = DefectMapFileName(profileId);
+    Debug.AddLine(wxString::Format("Loading defect map file %s", filename));
+
+    if (!wxFileExists(filename))
+    {
+        Debug.AddLine(wxString::Format("Defect map file not found: %s", filename));
+        return 0;
+    }
+
+    wxFileInputStream iStream(filename);
+    wxTextInputStream inText(iStream);
+
+    // Re-initialize the defect map and parse the defect map file
+    if (iStream.GetLastError() != wxSTREAM_NO_ERROR)
+    {
+        Debug.AddLine(wxString::Format("Unexpected eof on defect map file %s", filename));
+        return 0;
+    }
+
+    DefectMap *defectMap = new DefectMap(profileId);
+
+    if (!DarkLibCache::LoadDefects(defectMap, filename))
+    {
+        defectMap->BuildIndex();
+        Debug.AddLine(wxString::Format("Loaded %d defects from cache", defectMap->size()));
+        return defectMap;
+    }
+
+    int linenum = 0;
+    while (!inText.GetInputStream().Eof())
+    {
+        wxString line = inText.ReadLine();
+        ++linenum;
+        line.Trim(false); // trim leading whitespace
+        if (line.IsEmpty())
+            continue;
+        if (line.StartsWith("#"))
+            continue;
+
+        wxStringTokenizer tok(line);
+        wxString s1 = tok.GetNextToken();
+        wxString s2 = tok.GetNextToken();
+        long x, y;
+        if (s1.ToLong(&x) && s2.ToLong(&y))
+        {
+            defectMap->push_back(wxPoint(x, y));
+        }
+        else
+        {
+            Debug.AddLine(wxString::Format("DefectMap: ignore junk on line %d: %s", linenum, line));
+        }
+    }
+
+    defectMap->BuildIndex();
+    DarkLibCache::SaveDefects(*defectMap, filename);
+
+    Debug.AddLine(wxString::Format("Loaded %d defects", defectMap->size()));
+    return defectMap;
+}
+
+void DefectMap::DeleteDefectMap(int profileId)
+{
+    wxString filename = DefectMapFileName(profileId);
+    if (wxFileExists(filename))
+    {
+        Debug.AddLine("Removing defect map file: " + filename);
+        wxRemoveFile(filename);
+    }
+    DarkLibCache::Remove(filename);
+}
+
+
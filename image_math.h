@@ -1,125 +1,300 @@
-/*
- *  image_math.h
- *  PHD Guiding
- *
- *  Created by Craig Stark.
- *  Copyright (c) 2006-2010 Craig Stark.
- *  Copyright (c) 2015 Andy Galasso
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#ifndef IMAGE_MATH_INCLUDED
-#define IMAGE_MATH_INCLUDED
-
-class DefectMap : public std::vector<wxPoint>
-{
-    int m_profileId;
-    DefectMap(int profileId);
-public:
-    static void DeleteDefectMap(int profileId);
-    static bool DefectMapExists(int profileId, bool showAlert = true);
-    static DefectMap *LoadDefectMap(int profileId);
-    static wxString DefectMapFileName(int profileId);
-    static bool ImportFromProfile(int sourceId, int destId);
-    DefectMap();
-    void Save(const wxArrayString& mapInfo) const;
-    bool FindDefect(const wxPoint& pt) const;
-    void AddDefect(const wxPoint& pt);
-
-};
-
-extern bool QuickLRecon(usImage& img);
-extern bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect);
-extern bool Median3(usImage& img);
-extern bool SquarePixels(usImage& img, float xsize, float ysize);
-extern int dbl_sort_func(double *first, double *second);
-extern bool Subtract(usImage& light, const usImage& dark);
-extern double CalcSlope(const ArrayOfDbl& y);
-extern bool RemoveDefects(usImage& light, const DefectMap& defectMap);
-
-struct DefectMapBuilderImpl;
-
-struct DefectMapDarks
-{
-    usImage masterDark;
-    usImage filteredDark;
-
-    void BuildFilteredDark();
-    void SaveDarks(const wxString& notes);
-    void LoadDarks();
-};
-
-struct ImageStats
-{
-    double mean;
-    double stdev;
-    unsigned short median;
-    unsigned short mad;
-};
-
-class DefectMapBuilder
-{
-    DefectMapBuilderImpl *m_impl;
-
-public:
-
-    DefectMapBuilder();
-    ~DefectMapBuilder();
-
-    void Init(DefectMapDarks& darks);
-    const ImageStats& GetImageStats() const;
-    void SetAggressiveness(int aggrCold, int aggrHot);
-    int GetColdPixelCnt() const;
-    int GetHotPixelCnt() const;
-    void BuildDefectMap(DefectMap& defectMap, bool verbose) const;
-    const wxArrayString& GetMapInfo() const;
-};
-
-inline static double norm(double val, double start, double end)
-{
-    double const range = end - start;
-    double const ofs = val - start;
-    return val - floor(ofs / range) * range;
-}
-
-inline static double norm_angle(double val)
-{
-    return norm(val, -M_PI, M_PI);
-}
-
-inline static double degrees(double radians)
-{
-    return radians * 180. / M_PI;
-}
-
-inline static double radians(double degrees)
-{
-    return degrees * M_PI / 180.;
-}
-
-#endif
+/*
+ *  image_math.h
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark.
+ *  Copyright (c) 2006-2010 Craig Stark.
+ *  Copyright (c) 2015 Andy Galasso
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef IMAGE_MATH_INCLUDED
+#define IMAGE_MATH_INCLUDED
+
+// Defects are kept sorted by row, then column, with a per-row index, once
+// BuildIndex() has been called. Lookups fall back to a linear scan if the
+// vector has been modified directly since the index was built.
+//
+// An indexed map also keeps, for one frame size, the neighbors each defect is
+// repaired from, so RemoveDefects only has to gather and median them. The
+// neighbors are the bordering pixels that are not defects themselves; a
+// defect surrounded by defects is repaired from all its bordering pixels
+// after the others have been repaired.
+class DefectMap : public std::vector<wxPoint>
+{
+    struct Repair
+    {
+        unsigned int pixel;         // index of the defect in the frame
+        unsigned int nbr[8];        // indexes of the pixels it is repaired from
+        unsigned int count;         // number of neighbors, selects the median network
+    };
+
+    int m_profileId;
+    std::vector<unsigned int> m_rowStart; // m_rowStart[y] = index of the first defect with row >= y
+    size_t m_indexedSize;
+    bool m_indexed;
+    mutable std::vector<Repair> m_repairs;   // defects with good neighbors, by pixel index
+    mutable std::vector<Repair> m_clustered; // defects without, by pixel index
+    mutable wxSize m_repairSize;             // frame size of the repair tables, 0x0 if there are none
+    enum { MAX_INDEXED_ROW = 65535 };
+    DefectMap(int profileId);
+
+    friend bool RemoveDefects(usImage& light, const DefectMap& defectMap);
+    friend struct RemoveDefectsJob;
+public:
+    static void DeleteDefectMap(int profileId);
+    static bool DefectMapExists(int profileId, bool showAlert = true);
+    static DefectMap *LoadDefectMap(int profileId);
+    static wxString DefectMapFileName(int profileId);
+    static bool ImportFromProfile(int sourceId, int destId);
+    DefectMap();
+    void Save(const wxArrayString& mapInfo) const;
+    bool FindDefect(const wxPoint& pt) const;
+    void AddDefect(const wxPoint& pt);
+    void BuildIndex();
+    bool IsIndexed() const { return m_indexed && m_indexedSize == size(); }
+    void RowRange(int y, int x0, int x1, const_iterator *first, const_iterator *last) const;
+    // build the repair tables for frames of the given size; they are built
+    // by the first RemoveDefects call that needs them otherwise
+    void PrepareRepairs(const wxSize& frameSize) const;
+
+};
+
+extern bool QuickLRecon(usImage& img);
+extern void Median3Rows(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect, int rowBegin, int rowEnd);
+extern bool Median3(unsigned short *dst, const unsigned short *src, const wxSize& size, const wxRect& rect);
+extern bool Median3(usImage& img);
+extern bool QuickLRecon(usImage& img, const wxRect& rect);
+extern bool Median3(usImage& img, const wxRect& rect);
+extern void Median3MinMax(const usImage& img, const wxRect& rect, int *min, int *max, int *filtMin, int *filtMax);
+extern bool SquarePixels(usImage& img, float xsize, float ysize);
+extern bool SoftwareBin(usImage& img, int factor, bool sum);
+
+// Where the two green pixels of each 2x2 Bayer cell are
+enum BAYER_GREEN
+{
+    BAYER_GREEN_NONE,           // not a color sensor
+    BAYER_GREEN_ANTIDIAGONAL,   // top right and bottom left: RGGB, BGGR
+    BAYER_GREEN_DIAGONAL,       // top left and bottom right: GRBG, GBRG
+};
+
+// Superpixel reduction of a raw color frame for guiding: halves the frame in
+// both dimensions, each output pixel the mean of the two green pixels of its
+// Bayer cell. The subframe is handled like SoftwareBin's.
+extern bool GreenSuperpixel(usImage& img, BAYER_GREEN green);
+extern void WidenPixels(unsigned short *dst, const unsigned char *src, unsigned int n);
+extern void NarrowPixels(unsigned short *dst, const int *src, unsigned int n);
+// Per-pixel linear interpolation of two frames, weight is the share of b in
+// units of 1/INTERPOLATE_ONE
+extern void InterpolatePixels(unsigned short *dst, const unsigned short *a, const unsigned short *b, unsigned int weight, unsigned int n);
+extern unsigned long long AccumulatePixels(unsigned short *dst, const unsigned char *src, unsigned int n);
+extern int dbl_sort_func(double *first, double *second);
+extern bool Subtract(usImage& light, const usImage& dark);
+extern double CalcSlope(const ArrayOfDbl& y);
+extern bool RemoveDefects(usImage& light, const DefectMap& defectMap);
+extern void MedianFilter(usImage& dst, const usImage& src, int halfWidth);
+
+// Work that can be split into horizontal strips of rows. RunImageStrips
+// processes the strips concurrently and returns when all of them are done.
+struct ImageStripJob
+{
+    virtual ~ImageStripJob() { }
+    virtual void ProcessRows(int strip, int rowBegin, int rowEnd) = 0;
+};
+
+extern int ImageStripCount(int height, int minRows);
+extern void RunImageStrips(ImageStripJob& job, int nstrips, int height);
+
+// Reference mode runs the kernels on the calling thread with their scalar
+// loops only. It is the baseline the corpus runner (see corpus.h) checks the
+// vector and strip-parallel paths against, and is not for normal operation.
+extern void SetImageMathReference(bool reference);
+extern bool ImageMathReference();
+
+// Binds Kernels for this CPU and logs the choice. choice is "auto" or the
+// isa of a kernel set to use if the CPU can run it, see image_kernels.h
+extern void SelectImageKernels(const wxString& choice);
+
+// A dark frame prepared for single-pass subtraction. The pedestal is taken from
+// the dark's median when the dark is prepared, and the dark is split into the
+// amounts above and below the pedestal, so that subtraction reduces to a
+// saturating add and a saturating subtract per pixel. The object is reference
+// counted so the camera worker thread can pin it and release DarkFrameLock
+// before subtracting.
+class PreparedDark
+{
+    wxSize m_size;
+    unsigned short m_pedestal;
+    std::vector<unsigned short> m_below;  // pedestal - dark where the dark is below the pedestal, else 0
+    std::vector<unsigned short> m_above;  // dark - pedestal where the dark is above the pedestal, else 0
+    wxAtomicInt m_refcnt;
+
+    ~PreparedDark() { }
+
+    template<typename T>
+    bool SubtractFrom(usImage& light, const T *src) const;
+
+    friend class CalibrateStrip;
+    friend class GpuCompute;
+    friend bool CalibrateFrame(usImage& img, const PreparedDark *dark, int noiseReduction, bool stats);
+
+public:
+    PreparedDark(const usImage& dark);
+
+    void AddRef() { wxAtomicInc(m_refcnt); }
+    void Release() { if (wxAtomicDec(m_refcnt) == 0) delete this; }
+
+    unsigned short Pedestal() const { return m_pedestal; }
+    bool Subtract(usImage& light) const;
+    // widen a full frame of 8-bit pixels into light and subtract in the same
+    // pass; src may be the upper half of light's buffer
+    bool Subtract(usImage& light, const unsigned char *src) const;
+};
+
+// Dark subtraction, noise reduction (an NR_* method) and CalcStats of a full
+// frame in a single strip-parallel pass that reads each pixel once and
+// writes it once; the intermediate rows stay in cache. The results are the
+// same, bit for bit, as PreparedDark::Subtract, then QuickLRecon or Median3,
+// then CalcStats. dark may be NULL; without stats the statistics are left
+// alone. Returns true, with the image unchanged, for a subframe, a frame
+// smaller than 3x3 or a dark of another size.
+extern bool CalibrateFrame(usImage& img, const PreparedDark *dark, int noiseReduction, bool stats);
+
+// Sum of a run of frames of the same size, accumulated over the first frame's
+// subframe, or the whole frame if it has none. Get returns the sum when it
+// fits in the 16 bits per pixel of a usImage, and otherwise the sum scaled
+// down by the smallest power of 2 that makes it fit.
+class ImageStack
+{
+    std::vector<unsigned int> m_sum;
+    wxSize m_size;
+    wxRect m_rect;
+    wxByte m_bpp;
+    unsigned short m_pedestal;
+    int m_count;
+
+public:
+    ImageStack() : m_bpp(0), m_pedestal(0), m_count(0) { }
+
+    void Init(const usImage& first);
+    bool Add(const usImage& img);       // returns true if img does not match the first frame
+    int Count() const { return m_count; }
+    void Get(usImage& img) const;
+};
+
+struct ImageStats
+{
+    double mean;
+    double stdev;
+    unsigned short median;
+    unsigned short mad;
+};
+
+// Histogram of a 16-bit image or of a window of one. Building it is the only
+// pass over the pixels; the extremes, the moments, the median and the median
+// absolute deviation are all read off the 65536 bins afterwards, so they cost
+// O(65536) rather than a copy and a selection per statistic.
+class ImageHistogram
+{
+    std::vector<unsigned int> m_bins;
+    unsigned int m_count;
+
+public:
+    ImageHistogram();
+
+    void Clear();
+    void Add(unsigned short val) { ++m_bins[val]; ++m_count; }
+    void Build(const unsigned short *px, unsigned int n);
+    void Build(const usImage& img, const wxRect& rect);
+
+    unsigned int Count() const { return m_count; }
+    const std::vector<unsigned int>& Bins() const { return m_bins; }
+
+    unsigned short Min() const;
+    unsigned short Max() const;
+    double Mean() const;
+    double Stdev() const;                           // population standard deviation
+    unsigned short Rank(unsigned int rank) const;   // the value at position rank in sorted order
+    unsigned short Median() const { return Rank(m_count / 2); }
+    unsigned short MAD() const;                     // median absolute deviation from the median
+    void GetStats(ImageStats *stats) const;
+};
+
+struct DefectMapBuilderImpl;
+
+struct DefectMapDarks
+{
+    usImage masterDark;
+    usImage filteredDark;
+
+    void BuildFilteredDark();
+    void SaveDarks(const wxString& notes);
+    void LoadDarks();
+};
+
+class DefectMapBuilder
+{
+    DefectMapBuilderImpl *m_impl;
+
+public:
+
+    DefectMapBuilder();
+    ~DefectMapBuilder();
+
+    void Init(DefectMapDarks& darks);
+    const ImageStats& GetImageStats() const;
+    void SetAggressiveness(int aggrCold, int aggrHot);
+    int GetColdPixelCnt() const;
+    int GetHotPixelCnt() const;
+    void BuildDefectMap(DefectMap& defectMap, bool verbose) const;
+    const wxArrayString& GetMapInfo() const;
+};
+
+inline static double norm(double val, double start, double end)
+{
+    double const range = end - start;
+    double const ofs = val - start;
+    return val - floor(ofs / range) * range;
+}
+
+inline static double norm_angle(double val)
+{
+    return norm(val, -M_PI, M_PI);
+}
+
+inline static double degrees(double radians)
+{
+    return radians * 180. / M_PI;
+}
+
+inline static double radians(double degrees)
+{
+    return degrees * M_PI / 180.;
+}
+
+#endif
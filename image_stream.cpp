@@ -0,0 +1,533 @@
+/*
+ *  image_stream.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <limits>
+#include <math.h>
+
+ImageStreamServer ImgStream;
+
+wxBEGIN_EVENT_TABLE(ImageStreamServer, wxEvtHandler)
+    EVT_SOCKET(IMAGE_STREAM_SERVER_ID, ImageStreamServer::OnServerEvent)
+    EVT_SOCKET(IMAGE_STREAM_CLIENT_ID, ImageStreamServer::OnClientEvent)
+wxEND_EVENT_TABLE()
+
+enum
+{
+    STREAM_VERSION = 1,
+    STREAM_HEADER_SIZE = 56,
+    MAX_REQUEST_SIZE = 1024,
+};
+
+enum StreamCompression
+{
+    COMPRESS_NONE = 0,
+    COMPRESS_DELTA = 1,
+    COMPRESS_PACKED = 2,
+};
+
+struct ImageStreamServer::Client
+{
+    wxSocketClient *sock;
+
+    // subscription
+    wxRect roi;                 // empty for the full frame
+    int starSize;               // > 0 for a cutout centered on the star
+    int decimate;
+    int every;
+    StreamCompression compression;
+    bool subscribed;
+
+    std::string inbuf;
+    std::vector<unsigned char> outbuf;
+    size_t outOfs;
+    unsigned int frameCount;
+    unsigned int dropped;
+
+    Client(wxSocketClient *s)
+        : sock(s), starSize(0), decimate(1), every(1), compression(COMPRESS_NONE),
+          subscribed(false), outOfs(0), frameCount(0), dropped(0)
+    {
+    }
+
+    bool Busy() const { return outOfs < outbuf.size(); }
+
+    void Flush()
+    {
+        if (!Busy())
+            return;
+
+        sock->Write(&outbuf[outOfs], outbuf.size() - outOfs);
+        outOfs += sock->LastWriteCount();
+
+        if (!Busy())
+        {
+            outbuf.clear();
+            outOfs = 0;
+        }
+    }
+};
+
+inline static ImageStreamServer::Client *client_of(wxSocketClient *cli)
+{
+    return (ImageStreamServer::Client *) cli->GetClientData();
+}
+
+ImageStreamServer::ImageStreamServer()
+    : m_serverSocket(0)
+{
+}
+
+ImageStreamServer::~ImageStreamServer()
+{
+}
+
+bool ImageStreamServer::Start(unsigned int instanceId)
+{
+    if (m_serverSocket)
+    {
+        Debug.AddLine("attempt to start image stream server when it is already started?");
+        return false;
+    }
+
+    unsigned int port = 4500 + instanceId - 1;
+    wxIPV4address addr;
+    addr.Service(port);
+    m_serverSocket = new wxSocketServer(addr);
+
+    if (!m_serverSocket->Ok())
+    {
+        Debug.Write(wxString::Format("Image stream server failed to start - Could not listen at port %u\n", port));
+        delete m_serverSocket;
+        m_serverSocket = NULL;
+        return true;
+    }
+
+    m_serverSocket->SetEventHandler(*this, IMAGE_STREAM_SERVER_ID);
+    m_serverSocket->SetNotify(wxSOCKET_CONNECTION_FLAG);
+    m_serverSocket->Notify(true);
+
+    Debug.Write(wxString::Format("image stream server started, listening on port %u\n", port));
+
+    return false;
+}
+
+void ImageStreamServer::Stop()
+{
+    if (!m_serverSocket)
+        return;
+
+    while (!m_clients.empty())
+        DestroyClient(*m_clients.begin());
+
+    delete m_serverSocket;
+    m_serverSocket = NULL;
+
+    Debug.AddLine("image stream server stopped");
+}
+
+void ImageStreamServer::DestroyClient(wxSocketClient *cli)
+{
+    Client *c = client_of(cli);
+    if (c->dropped)
+        Debug.Write(wxString::Format("imgstrm: cli %p dropped %u frames\n", cli, c->dropped));
+    m_clients.erase(cli);
+    delete c;
+    cli->Destroy();
+}
+
+void ImageStreamServer::OnServerEvent(wxSocketEvent& event)
+{
+    wxSocketServer *server = static_cast<wxSocketServer *>(event.GetSocket());
+
+    if (event.GetSocketEvent() != wxSOCKET_CONNECTION)
+        return;
+
+    wxSocketClient *client = static_cast<wxSocketClient *>(server->Accept(false));
+
+    if (!client)
+        return;
+
+    Debug.Write(wxString::Format("imgstrm: cli %p connect\n", client));
+
+    client->SetEventHandler(*this, IMAGE_STREAM_CLIENT_ID);
+    client->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG);
+    client->SetFlags(wxSOCKET_NOWAIT);
+    client->Notify(true);
+    client->SetClientData(new Client(client));
+
+    m_clients.insert(client);
+}
+
+static int int_value(const json_value *jv, int dflt)
+{
+    if (jv->type == JSON_INT)
+        return jv->int_value;
+    if (jv->type == JSON_FLOAT)
+        return (int) jv->float_value;
+    return dflt;
+}
+
+// apply a subscription request; true on error
+static bool parse_subscription(ImageStreamServer::Client *c, char *line, wxString *err)
+{
+    JsonParser parser;
+
+    if (!parser.Parse(line) || parser.Root()->type != JSON_OBJECT)
+    {
+        *err = "expected a JSON object";
+        return true;
+    }
+
+    wxRect roi;
+    int starSize = 0;
+    int decimate = 1;
+    int every = 1;
+    StreamCompression compression = COMPRESS_NONE;
+
+    json_for_each (jv, parser.Root())
+    {
+        if (strcmp(jv->name, "roi") == 0)
+        {
+            if (jv->type == JSON_OBJECT && jv->first_child && strcmp(jv->first_child->name, "star") == 0)
+            {
+                starSize = int_value(jv->first_child, 0);
+                if (starSize < 1)
+                {
+                    *err = "invalid star cutout size";
+                    return true;
+                }
+            }
+            else if (jv->type == JSON_ARRAY)
+            {
+                int v[4];
+                int n = 0;
+                json_for_each (e, jv)
+                {
+                    if (n < 4)
+                        v[n] = int_value(e, -1);
+                    ++n;
+                }
+                if (n != 4 || v[0] < 0 || v[1] < 0 || v[2] < 1 || v[3] < 1)
+                {
+                    *err = "expected roi [x,y,w,h]";
+                    return true;
+                }
+                roi = wxRect(v[0], v[1], v[2], v[3]);
+            }
+            else if (jv->type != JSON_NULL)
+            {
+                *err = "expected roi [x,y,w,h] or {\"star\":size}";
+                return true;
+            }
+        }
+        else if (strcmp(jv->name, "decimate") == 0)
+        {
+            decimate = int_value(jv, 0);
+            if (decimate < 1 || decimate > 16)
+            {
+                *err = "decimate must be 1..16";
+                return true;
+            }
+        }
+        else if (strcmp(jv->name, "every") == 0)
+        {
+            every = int_value(jv, 0);
+            if (every < 1)
+            {
+                *err = "every must be >= 1";
+                return true;
+            }
+        }
+        else if (strcmp(jv->name, "compression") == 0)
+        {
+            if (jv->type == JSON_STRING && strcmp(jv->string_value, "delta") == 0)
+                compression = COMPRESS_DELTA;
+            else if (jv->type == JSON_STRING && strcmp(jv->string_value, "packed") == 0)
+                compression = COMPRESS_PACKED;
+            else if (jv->type == JSON_STRING && strcmp(jv->string_value, "none") == 0)
+                compression = COMPRESS_NONE;
+            else
+            {
+                *err = "compression must be \"none\", \"delta\" or \"packed\"";
+                return true;
+            }
+        }
+    }
+
+    c->roi = roi;
+    c->starSize = starSize;
+    c->decimate = decimate;
+    c->every = every;
+    c->compression = compression;
+    c->subscribed = true;
+    c->frameCount = 0;
+
+    return false;
+}
+
+void ImageStreamServer::OnClientEvent(wxSocketEvent& event)
+{
+    wxSocketClient *cli = static_cast<wxSocketClient *>(event.GetSocket());
+    Client *c = client_of(cli);
+
+    switch (event.GetSocketEvent())
+    {
+    case wxSOCKET_LOST:
+        Debug.Write(wxString::Format("imgstrm: cli %p disconnect\n", cli));
+        DestroyClient(cli);
+        break;
+
+    case wxSOCKET_OUTPUT:
+        c->Flush();
+        break;
+
+    case wxSOCKET_INPUT: {
+        char buf[256];
+        while (true)
+        {
+            cli->Read(buf, sizeof(buf));
+            size_t n = cli->LastReadCount();
+            if (n == 0)
+                break;
+            c->inbuf.append(buf, n);
+        }
+
+        size_t eol;
+        while ((eol = c->inbuf.find_first_of("\r\n")) != std::string::npos)
+        {
+            std::string line(c->inbuf, 0, eol);
+            c->inbuf.erase(0, eol + 1);
+            if (line.empty())
+                continue;
+
+            wxString err;
+            if (parse_subscription(c, &line[0], &err))
+                Debug.Write(wxString::Format("imgstrm: cli %p bad request: %s\n", cli, err));
+            else
+                Debug.Write(wxString::Format("imgstrm: cli %p subscribe %s\n", cli, line));
+        }
+
+        if (c->inbuf.size() > MAX_REQUEST_SIZE)
+        {
+            Debug.Write(wxString::Format("imgstrm: cli %p request too big, disconnecting\n", cli));
+            DestroyClient(cli);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+inline static void put16(std::vector<unsigned char>& b, unsigned int v)
+{
+    b.push_back((unsigned char)(v & 0xff));
+    b.push_back((unsigned char)((v >> 8) & 0xff));
+}
+
+inline static void put32(std::vector<unsigned char>& b, unsigned int v)
+{
+    put16(b, v & 0xffff);
+    put16(b, v >> 16);
+}
+
+inline static void put_float(std::vector<unsigned char>& b, float f)
+{
+    unsigned int u;
+    memcpy(&u, &f, sizeof(u));
+    put32(b, u);
+}
+
+inline static void put_double(std::vector<unsigned char>& b, double d)
+{
+    unsigned long long u;
+    memcpy(&u, &d, sizeof(u));
+    put32(b, (unsigned int)(u & 0xffffffffULL));
+    put32(b, (unsigned int)(u >> 32));
+}
+
+inline static void put_delta(std::vector<unsigned char>& b, unsigned short v, unsigned short *prev)
+{
+    short d = (short)(unsigned short)(v - *prev);
+    unsigned int zz = ((unsigned int)(unsigned short)(d << 1)) ^ (unsigned int)(unsigned short)(d >> 15);
+    *prev = v;
+
+    while (zz >= 0x80)
+    {
+        b.push_back((unsigned char)(zz | 0x80));
+        zz >>= 7;
+    }
+    b.push_back((unsigned char) zz);
+}
+
+// mean of the d x d block at (x, y)
+inline static unsigned short block_mean(const usImage *img, int x, int y, int d)
+{
+    unsigned int sum = 0;
+    for (int j = 0; j < d; j++)
+    {
+        const unsigned short *p = &img->Pixel(x, y + j);
+        for (int i = 0; i < d; i++)
+            sum += p[i];
+    }
+    return (unsigned short)(sum / (d * d));
+}
+
+static void encode_frame(const ImageStreamServer::Client *c, const usImage *img, unsigned int frameNumber,
+                         const PHD_Point& star, const wxRect& rect, std::vector<unsigned char>& b)
+{
+    int const d = c->decimate;
+    int const ow = rect.width / d;
+    int const oh = rect.height / d;
+
+    b.reserve(STREAM_HEADER_SIZE + ow * oh * sizeof(unsigned short));
+
+    b.push_back('P'); b.push_back('H'); b.push_back('D'); b.push_back('I');
+    put16(b, STREAM_VERSION);
+    put16(b, STREAM_HEADER_SIZE);
+    put32(b, frameNumber);
+    put32(b, c->compression);
+    put_double(b, (double) img->ImgStartTime);
+    put16(b, img->Size.GetWidth());
+    put16(b, img->Size.GetHeight());
+    put16(b, rect.x);
+    put16(b, rect.y);
+    put16(b, rect.width);
+    put16(b, rect.height);
+    put16(b, d);
+    put16(b, ow);
+    put16(b, oh);
+    put16(b, wxMin(img->ImgExpDur, 65535));
+    float const nan = std::numeric_limits<float>::quiet_NaN();
+    put_float(b, star.IsValid() ? (float) star.X : nan);
+    put_float(b, star.IsValid() ? (float) star.Y : nan);
+    size_t const sizePos = b.size();
+    put32(b, 0);
+
+    size_t const start = b.size();
+
+    if (c->compression == COMPRESS_PACKED)
+    {
+        if (d == 1)
+            FrameCodec::EncodePixels(*img, rect, FRAME_CODEC_PACKED, &b);
+        else
+        {
+            usImage dec;
+            if (!dec.Init(ow, oh))
+            {
+                for (int y = 0; y < oh; y++)
+                    for (int x = 0; x < ow; x++)
+                        dec.Pixel(x, y) = block_mean(img, rect.x + x * d, rect.y + y * d, d);
+                FrameCodec::EncodePixels(dec, wxRect(0, 0, ow, oh), FRAME_CODEC_PACKED, &b);
+            }
+        }
+    }
+    else
+    {
+        for (int y = 0; y < oh; y++)
+        {
+            int const sy = rect.y + y * d;
+            const unsigned short *row = &img->Pixel(rect.x, sy);
+            unsigned short prev = 0;
+
+            for (int x = 0; x < ow; x++)
+            {
+                unsigned short v = d == 1 ? row[x] : block_mean(img, rect.x + x * d, sy, d);
+                if (c->compression == COMPRESS_DELTA)
+                    put_delta(b, v, &prev);
+                else
+                    put16(b, v);
+            }
+        }
+    }
+
+    unsigned int const payload = (unsigned int)(b.size() - start);
+    b[sizePos] = (unsigned char)(payload & 0xff);
+    b[sizePos + 1] = (unsigned char)((payload >> 8) & 0xff);
+    b[sizePos + 2] = (unsigned char)((payload >> 16) & 0xff);
+    b[sizePos + 3] = (unsigned char)((payload >> 24) & 0xff);
+}
+
+// Pixels are read straight from the guider's current image into each client's
+// socket buffer; the image itself is not copied
+void ImageStreamServer::NotifyFrame(const usImage *img, unsigned int frameNumber, const PHD_Point& star)
+{
+    if (m_clients.empty() || !img || !img->ImageData)
+        return;
+
+    wxRect valid = img->Subframe.IsEmpty() ? wxRect(img->Size) : img->Subframe;
+
+    for (CliSockSet::const_iterator it = m_clients.begin(); it != m_clients.end(); ++it)
+    {
+        Client *c = client_of(*it);
+
+        if (!c->subscribed)
+            continue;
+
+        if (c->frameCount++ % c->every != 0)
+            continue;
+
+        if (c->Busy())
+        {
+            ++c->dropped;
+            continue;
+        }
+
+        wxRect rect;
+        if (c->starSize > 0)
+        {
+            if (!star.IsValid())
+                continue;
+            int const halfw = (c->starSize - 1) / 2;
+            rect = wxRect((int) floor(star.X + 0.5) - halfw, (int) floor(star.Y + 0.5) - halfw,
+                          2 * halfw + 1, 2 * halfw + 1);
+        }
+        else if (!c->roi.IsEmpty())
+            rect = c->roi;
+        else
+            rect = valid;
+
+        rect.Intersect(valid);
+
+        if (rect.width < c->decimate || rect.height < c->decimate)
+            continue;
+
+        encode_frame(c, img, frameNumber, star, rect, c->outbuf);
+        c->outOfs = 0;
+        c->Flush();
+    }
+}
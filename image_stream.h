@@ -0,0 +1,103 @@
+/*
+ *  image_stream.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef IMAGE_STREAM_INCLUDED
+#define IMAGE_STREAM_INCLUDED
+
+// Binary guide frame stream for remote monitoring, on port 4500 + instance - 1.
+//
+// A client subscribes by sending a single line of JSON, and may send another line
+// at any time to change the subscription:
+//
+//   {"roi":[x,y,w,h], "decimate":n, "every":n, "compression":"delta"}
+//
+//   roi          region of the full frame to send; omitted for the whole frame, or
+//                "star":size for a square cutout centered on the guide star
+//   decimate     n x n pixel binning (mean), default 1
+//   every        send every nth frame, default 1
+//   compression  "none" (default), "delta", a lossless row delta + zigzag +
+//                varint coding that is usually well under half the raw size,
+//                or "packed", the pixel coding of frame_codec.h, which is
+//                usually smaller than delta and much faster
+//
+// Each frame is sent as a 56 byte little-endian header followed by the payload:
+//
+//   char[4]  magic "PHDI"
+//   uint16   version (1)
+//   uint16   header size (56)
+//   uint32   frame number
+//   uint32   compression (0 none, 1 delta, 2 packed)
+//   double   image start time, seconds since the epoch
+//   uint16   full frame width, height
+//   uint16   roi x, y, width, height (full frame coordinates)
+//   uint16   decimation
+//   uint16   payload image width, height
+//   uint16   exposure duration, ms (saturated at 65535)
+//   float    star x, y (full frame coordinates, NaN if no star)
+//   uint32   payload size in bytes
+//
+// Uncompressed payloads are rows of 16-bit little-endian pixels. Frames are
+// dropped for a client that still has a frame's worth of output unsent.
+
+class ImageStreamServer : public wxEvtHandler
+{
+public:
+    struct Client;
+    typedef std::set<wxSocketClient *> CliSockSet;
+
+private:
+    wxSocketServer *m_serverSocket;
+    CliSockSet m_clients;
+
+public:
+    ImageStreamServer();
+    ~ImageStreamServer();
+
+    bool Start(unsigned int instanceId);
+    void Stop();
+
+    bool HasClients() const { return !m_clients.empty(); }
+    void NotifyFrame(const usImage *img, unsigned int frameNumber, const PHD_Point& star);
+
+private:
+    void OnServerEvent(wxSocketEvent& evt);
+    void OnClientEvent(wxSocketEvent& evt);
+    void DestroyClient(wxSocketClient *cli);
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+extern ImageStreamServer ImgStream;
+
+#endif
@@ -86,7 +86,8 @@ public:
     // allocate memory
     void *malloc(size_t size);
 
-    // reset to empty state, keeping one allocated block
+    // reset to empty state, keeping one allocated block large enough
+    // for everything allocated since the last reset
     void reset();
 
     // free all allocated blocks
@@ -111,13 +112,22 @@ void block_allocator::reset()
 {
     if (m_head)
     {
-        block *b = m_head->next;
-        m_head->next = 0;
-        while (b)
+        if (m_head->next)
         {
-            block *t = b->next;
-            ::free(b);
-            b = t;
+            // the last message overflowed into more than one block; replace
+            // them with a single block of the combined size so that a
+            // similar message next time needs no allocations
+            size_t total = 0;
+            for (block *b = m_head; b; )
+            {
+                block *t = b->next;
+                total += b->size;
+                ::free(b);
+                b = t;
+            }
+            m_head = (block *)::malloc(total);
+            m_head->size = total;
+            m_head->next = 0;
         }
         m_head->used = sizeof(block);
     }
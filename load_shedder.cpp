@@ -0,0 +1,155 @@
+/*
+ *  load_shedder.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <atomic>
+
+volatile int LoadShedder::s_level;
+
+static bool s_enabled;
+static int s_budgetPct = 80;
+static double s_load = -1.0;
+static unsigned int s_over;             // consecutive cycles over the budget
+static unsigned int s_under;            // consecutive cycles under the release threshold
+static unsigned int s_levelChanges;
+static std::atomic<unsigned int> s_shed[NUM_SHED_LEVELS];
+
+static const char *const s_levelNames[NUM_SHED_LEVELS] = {
+    "none", "display", "image log", "windows", "debug log", "AutoFind resolution",
+};
+
+void LoadShedder::SetLevel(ShedLevel level, double load)
+{
+    ShedLevel const prev = Level();
+    if (level == prev)
+        return;
+
+    ++s_levelChanges;
+
+    Debug.Write(wxString::Format("LoadShedder: level %d -> %d (%s), load %.0f%% of the exposure\n",
+        prev, level, s_levelNames[level], load * 100.0));
+
+    // as with PowerSaver the debug log is capped last on the way in and
+    // released first on the way out, so that both changes are logged
+    if (prev >= SHED_DEBUG && level < SHED_DEBUG && !PowerSaver::IsEngaged())
+        Debug.SetLevelCap(DBGLOG_VERBOSE);
+
+    s_level = level;
+
+    if (prev < SHED_DEBUG && level >= SHED_DEBUG)
+        Debug.SetLevelCap(DBGLOG_INFO);
+}
+
+void LoadShedder::Init(void)
+{
+    s_enabled = pConfig->Global.GetBoolean("/overload/enable", true);
+    s_budgetPct = wxMax(10, wxMin(100, pConfig->Global.GetInt("/overload/budget_pct", 80)));
+
+    Debug.Write(wxString::Format("LoadShedder: %s, budget %d%% of the exposure\n", s_enabled ? "enabled" : "disabled", s_budgetPct));
+}
+
+void LoadShedder::CycleDone(long long processingUs, int exposureMs)
+{
+    assert(wxThread::IsMain());
+
+    if (!s_enabled || exposureMs <= 0)
+        return;
+
+    double const load = (double) processingUs / ((double) exposureMs * 1000.0);
+    s_load = s_load < 0.0 ? load : 0.7 * s_load + 0.3 * load;
+
+    double const budget = s_budgetPct / 100.0;
+    ShedLevel const level = Level();
+
+    if (s_load > budget)
+    {
+        s_under = 0;
+        if (++s_over >= STEP_CYCLES && level < NUM_SHED_LEVELS - 1)
+        {
+            s_over = 0;
+            SetLevel((ShedLevel)(level + 1), s_load);
+        }
+    }
+    else if (s_load < budget / 2.0)
+    {
+        s_over = 0;
+        if (++s_under >= RELEASE_CYCLES && level > SHED_NONE)
+        {
+            s_under = 0;
+            SetLevel((ShedLevel)(level - 1), s_load);
+        }
+    }
+    else
+    {
+        s_over = s_under = 0;
+    }
+
+    // the debug log level applies to every cycle rather than to a single
+    // action, so it is counted by the cycle
+    if (Sheds(SHED_DEBUG))
+        Count(SHED_DEBUG);
+}
+
+void LoadShedder::Count(ShedLevel level)
+{
+    s_shed[level]++;
+}
+
+bool LoadShedder::Shed(ShedLevel level)
+{
+    if (!Sheds(level))
+        return false;
+    Count(level);
+    return true;
+}
+
+int LoadShedder::DisplayIntervalMs(int intervalMs)
+{
+    if (!Sheds(SHED_DISPLAY))
+        return intervalMs;
+    return wxMax(intervalMs, 1000 / SHED_DISPLAY_RATE);
+}
+
+LoadShedderStatus LoadShedder::GetStatus(void)
+{
+    LoadShedderStatus st;
+    st.enabled = s_enabled;
+    st.budgetPct = s_budgetPct;
+    st.level = Level();
+    st.load = s_load;
+    st.levelChanges = s_levelChanges;
+    for (int i = 0; i < NUM_SHED_LEVELS; i++)
+        st.shed[i] = s_shed[i].load();
+    return st;
+}
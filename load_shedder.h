@@ -0,0 +1,108 @@
+/*
+ *  load_shedder.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOAD_SHEDDER_INCLUDED
+#define LOAD_SHEDDER_INCLUDED
+
+// Sheds work in a fixed order when the guide cycle cannot keep up with the
+// exposures. The load is the processing time of a cycle (see
+// PerfStats::CycleDone) as a fraction of its exposure, smoothed over a few
+// cycles. While it stays above the budget one more level is shed every
+// STEP_CYCLES cycles; once it falls below half the budget the levels come
+// back one at a time, every RELEASE_CYCLES cycles. At each level the work of
+// the levels below it is shed too:
+//
+//   SHED_DISPLAY    the display is refreshed at most SHED_DISPLAY_RATE times a second
+//   SHED_IMAGE_LOG  no star images are logged
+//   SHED_WINDOWS    the graph, target, profile and stats windows are not repainted
+//   SHED_DEBUG      the debug log keeps only DBGLOG_INFO lines
+//   SHED_AUTOFIND   AutoFind searches a frame binned one step further than usual
+//
+// Star finding, the guide algorithms and the mount moves are never shed.
+// Every action is counted for get_metrics.
+//
+// The Global setting /overload/enable turns the policy on or off (on by
+// default), and /overload/budget_pct sets the budget as a percentage of the
+// exposure (80 by default).
+enum ShedLevel
+{
+    SHED_NONE,
+    SHED_DISPLAY,
+    SHED_IMAGE_LOG,
+    SHED_WINDOWS,
+    SHED_DEBUG,
+    SHED_AUTOFIND,
+    NUM_SHED_LEVELS
+};
+
+struct LoadShedderStatus
+{
+    bool enabled;
+    int budgetPct;
+    ShedLevel level;
+    double load;                            // smoothed processing time / exposure, < 0 before the first cycle
+    unsigned int levelChanges;
+    unsigned int shed[NUM_SHED_LEVELS];     // actions skipped or reduced at each level, or cycles for the debug log level
+};
+
+class LoadShedder
+{
+    static volatile int s_level;        // read by the worker threads
+
+    static void SetLevel(ShedLevel level, double load);
+
+public:
+    enum
+    {
+        SHED_DISPLAY_RATE = 1,
+        STEP_CYCLES = 3,
+        RELEASE_CYCLES = 10,
+    };
+
+    static void Init(void);
+    // on the main thread, after each cycle with the processing time and the exposure
+    static void CycleDone(long long processingUs, int exposureMs);
+
+    static ShedLevel Level(void) { return (ShedLevel) s_level; }
+    static bool Sheds(ShedLevel level) { return level != SHED_NONE && s_level >= level; }
+    // Sheds(level), and counts the action when it does
+    static bool Shed(ShedLevel level);
+    static void Count(ShedLevel level);
+
+    // the display interval to use in place of intervalMs
+    static int DisplayIntervalMs(int intervalMs);
+
+    static LoadShedderStatus GetStatus(void);
+};
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ *  log_maintenance.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#include <wx/dir.h>
+#include <wx/wfstream.h>
+#include <wx/zstream.h>
+
+#include <algorithm>
+
+LogMaintenance LogMaint;
+
+enum
+{
+    COMPRESS_CHUNK = 64 * 1024,
+    IDLE_WAIT_MS = 1000,
+};
+
+class LogMaintenanceThread : public wxThread
+{
+    LogMaintenance *m_maint;
+
+public:
+    wxSemaphore m_wake;
+
+    LogMaintenanceThread(LogMaintenance *maint) : wxThread(wxTHREAD_JOINABLE), m_maint(maint) { }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("log maintenance");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "log maintenance");
+
+        while (!m_maint->m_stop)
+        {
+            LogMaintenance::Job job;
+            if (m_maint->Pop(&job))
+                m_maint->Run(job);
+            else
+                m_wake.WaitTimeout(IDLE_WAIT_MS);
+        }
+        return 0;
+    }
+};
+
+LogMaintenance::LogMaintenance()
+    : m_thread(0),
+    m_stop(false)
+{
+}
+
+LogMaintenance::~LogMaintenance()
+{
+    // the thread should have been stopped by Shutdown(); do not wait for it this late
+}
+
+void LogMaintenance::Queue(const Job& job)
+{
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        m_jobs.push_back(job);
+    }
+
+    if (m_thread)
+    {
+        m_thread->m_wake.Post();
+        return;
+    }
+
+    m_stop = false;
+
+    LogMaintenanceThread *thread = new LogMaintenanceThread(this);
+    if (thread->Create() == wxTHREAD_NO_ERROR)
+    {
+        thread->SetPriority(WXTHREAD_MIN_PRIORITY);
+        if (thread->Run() == wxTHREAD_NO_ERROR)
+        {
+            m_thread = thread;
+            return;
+        }
+    }
+
+    // no thread: the files are left for the next start
+    delete thread;
+    Debug.AddLine("LogMaintenance: could not start thread");
+    wxCriticalSectionLocker lck(m_lock);
+    m_jobs.clear();
+}
+
+bool LogMaintenance::Pop(Job *job)
+{
+    wxCriticalSectionLocker lck(m_lock);
+
+    if (m_jobs.empty())
+        return false;
+
+    *job = m_jobs.front();
+    m_jobs.pop_front();
+    return true;
+}
+
+void LogMaintenance::Shutdown()
+{
+    if (!m_thread)
+        return;
+
+    m_stop = true;
+    m_thread->m_wake.Post();
+    m_thread->Wait();
+    delete m_thread;
+    m_thread = 0;
+
+    wxCriticalSectionLocker lck(m_lock);
+    m_jobs.clear();
+}
+
+void LogMaintenance::Prune(const wxString& dir, const wxString& pattern, int daysOld)
+{
+    Job job;
+    job.type = JOB_PRUNE;
+    job.dir = dir;
+    job.patterns.Add(pattern);
+    job.days = daysOld;
+    Queue(job);
+}
+
+void LogMaintenance::Compress(const wxString& dir, const wxString& pattern, int daysOld, const wxArrayString& exclude)
+{
+    Job job;
+    job.type = JOB_COMPRESS;
+    job.dir = dir;
+    job.patterns.Add(pattern);
+    job.exclude = exclude;
+    job.days = daysOld;
+    Queue(job);
+}
+
+void LogMaintenance::LimitSize(const wxString& dir, const wxArrayString& patterns, unsigned int maxMB, const wxArrayString& exclude)
+{
+    Job job;
+    job.type = JOB_LIMIT_SIZE;
+    job.dir = dir;
+    job.patterns = patterns;
+    job.exclude = exclude;
+    job.days = 0;
+    job.maxBytes = wxULongLong(maxMB) * 1024 * 1024;
+    Queue(job);
+}
+
+void LogMaintenance::Run(const Job& job)
+{
+    switch (job.type)
+    {
+    case JOB_PRUNE:      DoPrune(job);     break;
+    case JOB_COMPRESS:   DoCompress(job);  break;
+    case JOB_LIMIT_SIZE: DoLimitSize(job); break;
+    }
+}
+
+static void ListFiles(const LogMaintenance::Job& job, wxArrayString *files)
+{
+    for (size_t i = 0; i < job.patterns.size(); i++)
+        wxDir::GetAllFiles(job.dir, files, job.patterns[i], wxDIR_FILES);      // No sub-directories, just files
+}
+
+void LogMaintenance::DoPrune(const Job& job)
+{
+    wxDateTime oldestDate = wxDateTime::UNow() + wxDateSpan::Days(-job.days);
+    wxArrayString files;
+    int hitCount = 0;
+
+    ListFiles(job, &files);
+
+    for (size_t i = 0; i < files.size() && !m_stop; i++)
+    {
+        wxDateTime stamp = wxFileModificationTime(files[i]);
+        if (stamp < oldestDate)
+        {
+            if (wxRemoveFile(files[i]))
+                ++hitCount;
+            else
+                Debug.Write(wxString::Format("Error cleaning up old log file %s\n", files[i]));
+        }
+    }
+
+    if (hitCount > 0)
+        Debug.Write(wxString::Format("Removed %d files of pattern: %s\n", hitCount, wxJoin(job.patterns, ' ')));
+}
+
+void LogMaintenance::DoCompress(const Job& job)
+{
+    wxDateTime newestDate = wxDateTime::UNow() + wxDateSpan::Days(-job.days);
+    wxArrayString files;
+    int hitCount = 0;
+
+    ListFiles(job, &files);
+
+    for (size_t i = 0; i < files.size() && !m_stop; i++)
+    {
+        const wxString& path = files[i];
+
+        // another instance may still be writing a recent file, so only files
+        // left alone for a while are compressed
+        if (path.EndsWith(".gz") || job.exclude.Index(path) != wxNOT_FOUND ||
+            wxDateTime(wxFileModificationTime(path)) >= newestDate)
+        {
+            continue;
+        }
+
+        if (!CompressFile(path))
+            ++hitCount;
+    }
+
+    if (hitCount > 0)
+        Debug.Write(wxString::Format("Compressed %d files of pattern: %s\n", hitCount, wxJoin(job.patterns, ' ')));
+}
+
+bool LogMaintenance::CompressFile(const wxString& path)
+{
+    wxString gzPath = path + ".gz";
+    bool err = false;
+
+    {
+        wxFFile in(path, "rb");
+        wxFileOutputStream file(gzPath);
+        if (!in.IsOpened() || !file.IsOk())
+            return true;
+
+        wxZlibOutputStream zout(file, wxZ_BEST_COMPRESSION, wxZLIB_GZIP);
+        std::vector<char> buf(COMPRESS_CHUNK);
+
+        while (!in.Eof() && !m_stop)
+        {
+            size_t n = in.Read(&buf[0], buf.size());
+            if (in.Error() || (n && !zout.Write(&buf[0], n).IsOk()))
+            {
+                err = true;
+                break;
+            }
+            if (!n)
+                break;
+        }
+
+        err = err || m_stop || !zout.Close() || !file.Close();
+    }
+
+    if (err)
+    {
+        if (!m_stop)
+            Debug.Write(wxString::Format("LogMaintenance: could not compress %s\n", path));
+        wxRemoveFile(gzPath);
+        return true;
+    }
+
+    // keep the original time so that age-based pruning still applies
+    wxDateTime mtime = wxFileModificationTime(path);
+    wxFileName(gzPath).SetTimes(0, &mtime, 0);
+
+    wxRemoveFile(path);
+    return false;
+}
+
+namespace
+{
+struct FileInfo
+{
+    wxString path;
+    time_t mtime;
+    wxULongLong size;
+};
+}
+
+static bool OlderFirst(const FileInfo& a, const FileInfo& b)
+{
+    return a.mtime < b.mtime;
+}
+
+void LogMaintenance::DoLimitSize(const Job& job)
+{
+    wxArrayString files;
+    ListFiles(job, &files);
+
+    std::vector<FileInfo> infos;
+    wxULongLong total = 0;
+
+    for (size_t i = 0; i < files.size() && !m_stop; i++)
+    {
+        FileInfo info;
+        info.path = files[i];
+        info.mtime = wxFileModificationTime(files[i]);
+        info.size = wxFileName::GetSize(files[i]);
+        if (info.size == wxInvalidSize)
+            continue;
+        total += info.size;
+        if (job.exclude.Index(info.path) == wxNOT_FOUND)
+            infos.push_back(info);
+    }
+
+    std::sort(infos.begin(), infos.end(), OlderFirst);
+
+    int hitCount = 0;
+    for (size_t i = 0; i < infos.size() && total > job.maxBytes && !m_stop; i++)
+    {
+        if (wxRemoveFile(infos[i].path))
+        {
+            total -= infos[i].size;
+            ++hitCount;
+        }
+    }
+
+    if (hitCount > 0)
+        Debug.Write(wxString::Format("Removed %d files to keep the log folder under %s MB\n", hitCount,
+            (job.maxBytes / (1024 * 1024)).ToString()));
+}
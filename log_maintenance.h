@@ -0,0 +1,95 @@
+/*
+ *  log_maintenance.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef LOG_MAINTENANCE_INCLUDED
+#define LOG_MAINTENANCE_INCLUDED
+
+class LogMaintenanceThread;
+
+// Housekeeping of the log directory: pruning old logs, compressing closed
+// ones and keeping the directory under a size limit. The work is queued and
+// done by a low-priority background thread, so that a directory with
+// thousands of files does not hold up startup or the guide loop.
+class LogMaintenance
+{
+public:
+    enum JobType
+    {
+        JOB_PRUNE,          // remove files older than days
+        JOB_COMPRESS,       // gzip files not modified for days
+        JOB_LIMIT_SIZE,     // remove the oldest files until the total is under maxBytes
+    };
+
+    struct Job
+    {
+        JobType type;
+        wxString dir;
+        wxArrayString patterns;
+        wxArrayString exclude;  // full paths of files still being written
+        int days;
+        wxULongLong maxBytes;
+    };
+
+private:
+    wxCriticalSection m_lock;       // protects the queue
+    std::deque<Job> m_jobs;
+    LogMaintenanceThread *m_thread;
+    volatile bool m_stop;
+
+    friend class LogMaintenanceThread;
+
+    void Queue(const Job& job);
+    bool Pop(Job *job);
+    void Run(const Job& job);
+    void DoPrune(const Job& job);
+    void DoCompress(const Job& job);
+    void DoLimitSize(const Job& job);
+    bool CompressFile(const wxString& path);    // true on error
+
+public:
+    LogMaintenance();
+    ~LogMaintenance();
+
+    void Prune(const wxString& dir, const wxString& pattern, int daysOld);
+    void Compress(const wxString& dir, const wxString& pattern, int daysOld, const wxArrayString& exclude);
+    void LimitSize(const wxString& dir, const wxArrayString& patterns, unsigned int maxMB, const wxArrayString& exclude);
+
+    // abandon the queued work and stop the thread; a file being compressed is
+    // left as it was
+    void Shutdown();
+};
+
+extern LogMaintenance LogMaint;
+
+#endif
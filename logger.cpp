@@ -131,37 +131,23 @@ bool Logger::SetLogDir(const wxString& dir)
     return bOk;
 }
 
-// Clean up old log files in the directory.  Caller gives us the file glob - like PHD2_DebugLog*.txt - and the retention
-// period.  Files older than that are removed.
+// Clean up old log files in the directory.  Caller gives us the file glob - like PHD2_DebugLog*.txt* - and the retention
+// period.  Files older than that are removed by the log maintenance thread.
 void Logger::RemoveMatchingFiles(const wxString& filePattern, int DaysOld)
 {
-    wxString dirName = GetLogDir();
-    wxArrayString results;
-    int numFiles;
-    int hitCount = 0;
-    wxDateTime oldestDate = wxDateTime::UNow() + wxDateSpan::Days(-DaysOld);
-    wxString lastFile = "<None>";
-
-    try
-    {
-        numFiles = wxDir::GetAllFiles(dirName, &results, filePattern, wxDIR_FILES);      // No sub-directories, just files
-
-        for (int inx = 0; inx < numFiles; inx++)
-        {
-            wxDateTime stamp = wxFileModificationTime(results[inx]);
-            if (stamp < oldestDate)
-            {
-                ++hitCount;
-                lastFile = results[inx];            // For error logging
-                wxRemoveFile(lastFile);
-            }
-        }
-    }
-    catch (const wxString& Msg)            // Eat the errors and press ahead, no place for UI here
-    {
-        Debug.Write(wxString::Format("Error cleaning up old log file %s: %s\n", lastFile, Msg));
-    }
+    LogMaint.Prune(GetLogDir(), filePattern, DaysOld);
+}
 
-    if (hitCount > 0)
-        Debug.Write(wxString::Format("Removed %d files of pattern: %s\n", hitCount, filePattern));
+// Compress closed log files matching the glob which have not been written for /logs/compress_days days (0 = never).
+// currentFile is the file this logger has open.
+void Logger::CompressMatchingFiles(const wxString& filePattern, const wxString& currentFile)
+{
+    int days = pConfig->Global.GetInt("/logs/compress_days", 1);
+    if (days <= 0)
+        return;
+
+    wxArrayString exclude;
+    if (!currentFile.IsEmpty())
+        exclude.Add(currentFile);
+    LogMaint.Compress(GetLogDir(), filePattern, days, exclude);
 }
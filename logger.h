@@ -51,6 +51,7 @@ public:
     ~Logger(void);
     wxString GetLogDir(void);
     virtual void RemoveMatchingFiles(const wxString& filePattern, int DaysOld);
+    void CompressMatchingFiles(const wxString& filePattern, const wxString& currentFile);
 };
 
 #endif
@@ -35,6 +35,7 @@
 
 #include "phd.h"
 #include "backlash_comp.h"
+#include "drift_tool.h"
 #include "guiding_assistant.h"
 
 #include <wx/tokenzr.h>
@@ -134,6 +135,7 @@ void Mount::MountConfigDialogPane::LayoutControls(wxPanel *pParent, BrainCtrlIdM
 #if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
             _("Gaussian Process"),
 #endif
+            _("Predictive PEC"), _("Chain"),
         };
 
         width = StringArrayWidth(xAlgorithms, WXSIZEOF(xAlgorithms));
@@ -173,6 +175,7 @@ void Mount::MountConfigDialogPane::LayoutControls(wxPanel *pParent, BrainCtrlIdM
 #if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
             _("Gaussian Process"),
 #endif
+            _("Predictive PEC"), _("Chain"),
         };
         width = StringArrayWidth(yAlgorithms, WXSIZEOF(yAlgorithms));
         m_pYGuideAlgorithmChoice = new wxChoice(m_pParent, wxID_ANY, wxPoint(-1, -1),
@@ -405,6 +408,8 @@ void MountConfigDialogCtrlSet::UnloadValues()
         if (m_pClearCalibration->IsChecked())
         {
             m_pMount->ClearCalibration();
+            // the user does not trust the calibration, so do not bring back an older one either
+            CalibrationStore::Clear(m_pMount);
             Debug.Write(wxString::Format("User cleared %s calibration\n", m_pMount->IsStepGuider() ? "AO" : "Mount"));
         }
 
@@ -486,6 +491,8 @@ bool Mount::CreateGuideAlgorithm(int guideAlgorithm, Mount *mount, GuideAxis axi
 #if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)            
             case GUIDE_ALGORITHM_GAUSSIAN_PROCESS:
 #endif
+            case GUIDE_ALGORITHM_PREDICTIVE_PEC:
+            case GUIDE_ALGORITHM_CHAIN:
                 break;
             case GUIDE_ALGORITHM_NONE:
             default:
@@ -523,6 +530,12 @@ bool Mount::CreateGuideAlgorithm(int guideAlgorithm, Mount *mount, GuideAxis axi
             *ppAlgorithm = new GuideGaussianProcess(mount, axis);
             break;
 #endif
+        case GUIDE_ALGORITHM_PREDICTIVE_PEC:
+            *ppAlgorithm = new GuideAlgorithmPredictivePEC(mount, axis);
+            break;
+        case GUIDE_ALGORITHM_CHAIN:
+            *ppAlgorithm = new GuideAlgorithmChain(mount, axis);
+            break;
 
         case GUIDE_ALGORITHM_NONE:
         default:
@@ -643,6 +656,10 @@ Mount::Mount(void)
     m_lastStep.mount = this;
     m_lastStep.frameNumber = -1; // invalidate
 
+    m_cal.xAngle = 0.0;
+    m_yAngleError = 0.0;
+    UpdateTransform();
+
     ClearCalibration();
 
 #ifdef TEST_TRANSFORMS
@@ -698,6 +715,25 @@ bool Mount::FlipCalibration(void)
         double origX = xAngle();
         double origY = yAngle();
 
+        // a calibration measured on the other side of the pier beats one
+        // derived by flipping
+        Calibration stored;
+        if (OppositeSide(m_cal.pierSide) != PIER_SIDE_UNKNOWN &&
+            !CalibrationStore::Find(this, m_cal.binning, m_cal.rotatorAngle, OppositeSide(m_cal.pierSide), &stored))
+        {
+            Debug.Write(wxString::Format("FlipCalibration: using the calibration measured on the %s side of the pier at %s\n",
+                ::PierSideStr(stored.pierSide), stored.timestamp));
+
+            PierSide priorPierSide = m_cal.pierSide;
+            SetCalibration(stored);
+
+            pFrame->StatusMsg(wxString::Format(_("CAL: %s(%.f,%.f)->%s(%.f,%.f)"),
+                ::PierSideStr(priorPierSide, wxEmptyString), degrees(origX), degrees(origY),
+                ::PierSideStr(stored.pierSide, wxEmptyString), degrees(xAngle()), degrees(yAngle())));
+
+            return false;
+        }
+
         bool decFlipRequired = CalibrationFlipRequiresDecFlip();
 
         Debug.Write(wxString::Format("FlipCalibration before: x=%.1f, y=%.1f decFlipRequired=%d sideOfPier=%s rotAngle=%s parity=%s/%s\n",
@@ -755,22 +791,24 @@ void Mount::LogGuideStepInfo()
     if (m_lastStep.frameNumber < 0)
         return;
 
-    pFrame->UpdateGuiderInfo(m_lastStep);
-    GuideLog.GuideStep(m_lastStep);
-    EvtServer.NotifyGuideStep(m_lastStep);
-
+    long long seq = -1;
     if (m_lastStep.moveType != MOVETYPE_DIRECT)
     {
-        pFrame->pGraphLog->AppendData(m_lastStep);
-        pFrame->pTarget->AppendData(m_lastStep);
-        GuidingAssistant::NotifyGuideStep(m_lastStep);
+        Telemetry.Append(m_lastStep);
+        seq = Telemetry.End() - 1;
     }
 
+    // the log, the event server and the windows take the step from here,
+    // off the guide path
+    StepFanOut.Publish(m_lastStep, seq);
+
     m_lastStep.frameNumber = -1; // invalidate
 }
 
 Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveType moveType)
 {
+    PERF_STAGE(PERF_STAGE_MOVE);
+
     MOVE_RESULT result = MOVE_OK;
 
     try
@@ -805,10 +843,13 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
 
             if (moveType == MOVETYPE_ALGO)
             {
+                wxStopWatch algoTimer;
+
                 // Feed the raw distances to the guide algorithms
                 if (m_pXGuideAlgorithm)
                 {
-                    xDistance = m_pXGuideAlgorithm->result(xDistance);
+                    PERF_STAGE(PERF_STAGE_ALGO_RA);
+                    xDistance = pFrame->DitherRecoveryCorrection(mountVectorEndpoint.X, m_pXGuideAlgorithm->result(xDistance));
                 }
 
                 // Let BLC track the raw offsets in Dec
@@ -817,8 +858,11 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
 
                 if (m_pYGuideAlgorithm)
                 {
-                    yDistance = m_pYGuideAlgorithm->result(yDistance);
+                    PERF_STAGE(PERF_STAGE_ALGO_DEC);
+                    yDistance = pFrame->DitherRecoveryCorrection(mountVectorEndpoint.Y, m_pYGuideAlgorithm->result(yDistance));
                 }
+
+                GuideMetrics.AddAlgorithm(algoTimer.TimeInMicro().ToDouble() / 1000.0);
             }
             else
             {
@@ -832,20 +876,16 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
         GUIDE_DIRECTION yDirection = yDistance > 0.0 ? DOWN : UP;
 
         int requestedXAmount = (int) floor(fabs(xDistance / m_xRate) + 0.5);
-        MoveResultInfo xMoveResult;
-        result = Move(xDirection, requestedXAmount, moveType, &xMoveResult);
-
-        MoveResultInfo yMoveResult;
-        if (result == MOVE_OK || result == MOVE_ERROR)
+        int requestedYAmount = (int) floor(fabs(yDistance / m_cal.yRate) + 0.5);
+        if (requestedYAmount > 0 && !IsStepGuider() && moveType != MOVETYPE_DIRECT && GetGuidingEnabled())
         {
-            int requestedYAmount = (int) floor(fabs(yDistance / m_cal.yRate) + 0.5);
-            if (requestedYAmount > 0 && !IsStepGuider() && moveType != MOVETYPE_DIRECT && GetGuidingEnabled())
-            {
-                m_backlashComp->ApplyBacklashComp(yDirection, yDistance, &requestedYAmount);
-            }
-            result = Move(yDirection, requestedYAmount, moveType, &yMoveResult);
+            m_backlashComp->ApplyBacklashComp(yDirection, yDistance, &requestedYAmount);
         }
 
+        MoveResultInfo xMoveResult;
+        MoveResultInfo yMoveResult;
+        result = MoveAxes(xDirection, requestedXAmount, yDirection, requestedYAmount, moveType, &xMoveResult, &yMoveResult);
+
         // Record the info about the guide step. The info will be picked up back in the main UI thread.
         // We don't want to do anything with the info here in the worker thread since UI operations are
         // not allowed outside the main UI thread.
@@ -870,6 +910,20 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
         info.starSNR = pFrame->pGuider->SNR();
         info.avgDist = pFrame->pGuider->CurrentError();
         info.starError = pFrame->pGuider->StarError();
+
+        // Tell the guider how far the moves will take the star, so it can
+        // look for the star where it should be in the next frame. Any
+        // backlash compensation only takes up slack. Mount bumps by the AO's
+        // secondary mount are offset by the AO and do not move the star.
+        if (this == pMount)
+        {
+            double const xMoved = wxMin(fabs(xDistance), xMoveResult.amountMoved * m_xRate);
+            double const yMoved = wxMin(fabs(yDistance), yMoveResult.amountMoved * m_cal.yRate);
+            PHD_Point mountMove(xDistance < 0.0 ? -xMoved : xMoved, yDistance < 0.0 ? -yMoved : yMoved);
+            PHD_Point cameraMove;
+            if ((xMoved != 0.0 || yMoved != 0.0) && !TransformMountCoordinatesToCameraCoordinates(mountMove, cameraMove))
+                pFrame->pGuider->NotifyGuideMove(PHD_Point(-cameraMove.X, -cameraMove.Y));
+        }
     }
     catch (const wxString& errMsg)
     {
@@ -880,6 +934,19 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
     return result;
 }
 
+Mount::MOVE_RESULT Mount::MoveAxes(GUIDE_DIRECTION xDirection, int xAmount, GUIDE_DIRECTION yDirection, int yAmount,
+                                   MountMoveType moveType, MoveResultInfo *xMoveResult, MoveResultInfo *yMoveResult)
+{
+    MOVE_RESULT result = Move(xDirection, xAmount, moveType, xMoveResult);
+
+    if (result == MOVE_OK || result == MOVE_ERROR)
+    {
+        result = Move(yDirection, yAmount, moveType, yMoveResult);
+    }
+
+    return result;
+}
+
 /*
  * The transform code has proven really tricky to get right.  For future generations
  * (and for me the next time I try to work on it), I'm going to put some notes here.
@@ -926,6 +993,44 @@ Mount::MOVE_RESULT Mount::Move(const PHD_Point& cameraVectorEndpoint, MountMoveT
  *
  */
 
+/*
+ * Both transforms are precomputed from the calibration by UpdateTransform(),
+ * so a conversion is a matrix multiply.
+ *
+ * Camera to mount: the x component is the projection of the camera vector onto
+ * the x axis direction (m_xAngle), the y component its projection onto the
+ * direction perpendicular to the y axis error angle (m_xAngle + m_yAngleError):
+ *
+ *     mountX =  cos(xAngle) * cameraX + sin(xAngle) * cameraY
+ *     mountY = -sin(yAngle) * cameraX + cos(yAngle) * cameraY
+ *
+ * Mount to camera: a rotation by m_xAngle, after reflecting the y axis if the
+ * y axis was reversed during calibration (|m_yAngleError| > 90 degrees).
+ */
+void Mount::UpdateTransform(void)
+{
+    double const xAngle = m_cal.xAngle;
+    double const yAngle = m_cal.xAngle + m_yAngleError;
+
+    m_cameraToMount[0][0] = cos(xAngle);
+    m_cameraToMount[0][1] = sin(xAngle);
+    m_cameraToMount[1][0] = -sin(yAngle);
+    m_cameraToMount[1][1] = cos(yAngle);
+
+    double const ySign = fabs(m_yAngleError) > M_PI / 2. ? -1.0 : 1.0;
+
+    m_mountToCamera[0][0] = cos(xAngle);
+    m_mountToCamera[0][1] = -sin(xAngle) * ySign;
+    m_mountToCamera[1][0] = sin(xAngle);
+    m_mountToCamera[1][1] = cos(xAngle) * ySign;
+}
+
+static inline void ApplyTransform(const double m[2][2], const PHD_Point& in, PHD_Point& out)
+{
+    out.SetXY(m[0][0] * in.X + m[0][1] * in.Y,
+              m[1][0] * in.X + m[1][1] * in.Y);
+}
+
 bool Mount::TransformCameraCoordinatesToMountCoordinates(const PHD_Point& cameraVectorEndpoint,
                                                          PHD_Point& mountVectorEndpoint)
 {
@@ -938,26 +1043,11 @@ bool Mount::TransformCameraCoordinatesToMountCoordinates(const PHD_Point& camera
             throw ERROR_INFO("invalid cameraVectorEndPoint");
         }
 
-        double hyp   = cameraVectorEndpoint.Distance();
-        double cameraTheta = cameraVectorEndpoint.Angle();
-
-        double xAngle = cameraTheta - m_cal.xAngle;
-        double yAngle = cameraTheta - (m_cal.xAngle + m_yAngleError);
+        ApplyTransform(m_cameraToMount, cameraVectorEndpoint, mountVectorEndpoint);
 
-        // Convert theta and hyp into X and Y
-
-        mountVectorEndpoint.SetXY(
-            cos(xAngle) * hyp,
-            sin(yAngle) * hyp
-            );
-
-        Debug.Write(wxString::Format("CameraToMount -- cameraTheta (%.2f) - m_xAngle (%.2f) = xAngle (%.2f = %.2f)\n",
-                cameraTheta, m_cal.xAngle, xAngle, norm_angle(xAngle)));
-        Debug.Write(wxString::Format("CameraToMount -- cameraTheta (%.2f) - (m_xAngle (%.2f) + m_yAngleError (%.2f)) = yAngle (%.2f = %.2f)\n",
-                cameraTheta, m_cal.xAngle, m_yAngleError, yAngle, norm_angle(yAngle)));
-        Debug.Write(wxString::Format("CameraToMount -- cameraX=%.2f cameraY=%.2f hyp=%.2f cameraTheta=%.2f mountX=%.2f mountY=%.2f, mountTheta=%.2f\n",
-                cameraVectorEndpoint.X, cameraVectorEndpoint.Y, hyp, cameraTheta, mountVectorEndpoint.X, mountVectorEndpoint.Y,
-                mountVectorEndpoint.Angle()));
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE, "CameraToMount -- cameraX=%.2f cameraY=%.2f mountX=%.2f mountY=%.2f (xAngle=%.2f yAngleError=%.2f)\n",
+            cameraVectorEndpoint.X, cameraVectorEndpoint.Y, mountVectorEndpoint.X, mountVectorEndpoint.Y,
+            m_cal.xAngle, m_yAngleError);
     }
     catch (const wxString& Msg)
     {
@@ -981,26 +1071,11 @@ bool Mount::TransformMountCoordinatesToCameraCoordinates(const PHD_Point& mountV
             throw ERROR_INFO("invalid mountVectorEndPoint");
         }
 
-        double hyp = mountVectorEndpoint.Distance();
-        double mountTheta = mountVectorEndpoint.Angle();
+        ApplyTransform(m_mountToCamera, mountVectorEndpoint, cameraVectorEndpoint);
 
-        if (fabs(m_yAngleError) > M_PI / 2.)
-        {
-            mountTheta = -mountTheta;
-        }
-
-        double xAngle = mountTheta + m_cal.xAngle;
-
-        cameraVectorEndpoint.SetXY(
-                cos(xAngle) * hyp,
-                sin(xAngle) * hyp
-                );
-
-        Debug.Write(wxString::Format("MountToCamera -- mountTheta (%.2f) + m_xAngle (%.2f) = xAngle (%.2f = %.2f)\n",
-                                     mountTheta, m_cal.xAngle, xAngle, norm_angle(xAngle)));
-        Debug.Write(wxString::Format("MountToCamera -- mountX=%.2f mountY=%.2f hyp=%.2f mountTheta=%.2f cameraX=%.2f, cameraY=%.2f cameraTheta=%.2f\n",
-                                     mountVectorEndpoint.X, mountVectorEndpoint.Y, hyp, mountTheta, cameraVectorEndpoint.X, cameraVectorEndpoint.Y,
-                                     cameraVectorEndpoint.Angle()));
+        DEBUG_LOG(DBGLOG_MOUNT, DBGLOG_VERBOSE, "MountToCamera -- mountX=%.2f mountY=%.2f cameraX=%.2f cameraY=%.2f (xAngle=%.2f yAngleError=%.2f)\n",
+            mountVectorEndpoint.X, mountVectorEndpoint.Y, cameraVectorEndpoint.X, cameraVectorEndpoint.Y,
+            m_cal.xAngle, m_yAngleError);
     }
     catch (const wxString& Msg)
     {
@@ -1012,6 +1087,36 @@ bool Mount::TransformMountCoordinatesToCameraCoordinates(const PHD_Point& mountV
     return bError;
 }
 
+static bool ApplyTransform(const double m[2][2], const PHD_Point *in, PHD_Point *out, unsigned int count)
+{
+    bool bError = false;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (in[i].IsValid())
+            ApplyTransform(m, in[i], out[i]);
+        else
+        {
+            out[i].Invalidate();
+            bError = true;
+        }
+    }
+
+    return bError;
+}
+
+bool Mount::TransformCameraCoordinatesToMountCoordinates(const PHD_Point *cameraVectorEndpoints,
+                                                         PHD_Point *mountVectorEndpoints, unsigned int count)
+{
+    return ApplyTransform(m_cameraToMount, cameraVectorEndpoints, mountVectorEndpoints, count);
+}
+
+bool Mount::TransformMountCoordinatesToCameraCoordinates(const PHD_Point *mountVectorEndpoints,
+                                                         PHD_Point *cameraVectorEndpoints, unsigned int count)
+{
+    return ApplyTransform(m_mountToCamera, mountVectorEndpoints, cameraVectorEndpoints, count);
+}
+
 GraphControlPane *Mount::GetXGuideAlgorithmControlPane(wxWindow *pParent)
 {
     return m_pXGuideAlgorithm->GetGraphControlPane(pParent, _("RA:"));
@@ -1042,10 +1147,11 @@ bool Mount::DecCompensationEnabled(void) const
  */
 void Mount::AdjustCalibrationForScopePointing(void)
 {
-    double newDeclination = pPointingSource->GetDeclination();
-    PierSide newPierSide = pPointingSource->SideOfPier();
+    double newDeclination;
+    PierSide newPierSide;
+    PointingCache::GetCurrent(&newDeclination, &newPierSide);
     double newRotatorAngle = Rotator::RotatorPosition();
-    unsigned short binning = pCamera->Binning;
+    unsigned short binning = pCamera->EffectiveBinning();
 
     Debug.AddLine(wxString::Format("AdjustCalibrationForScopePointing (%s): current dec=%s pierSide=%d, cal dec=%s pierSide=%d rotAngle=%s bin=%hu",
         GetMountClassName(), DeclinationStr(newDeclination), newPierSide, DeclinationStr(m_cal.declination), m_cal.pierSide,
@@ -1063,6 +1169,16 @@ void Mount::AdjustCalibrationForScopePointing(void)
         pCamera->SetCameraPixelSize(pCamera->GetCameraPixelSize());
     }
 
+    // prefer a calibration measured under the current conditions to one derived below
+    Calibration stored;
+    if (!(m_cal.binning == binning && m_cal.pierSide == newPierSide && m_cal.rotatorAngle == newRotatorAngle) &&
+        !CalibrationStore::Find(this, binning, newRotatorAngle, newPierSide, &stored))
+    {
+        Debug.Write(wxString::Format("Using the calibration measured for bin=%hu pierSide=%d rotAngle=%s at %s\n",
+            binning, newPierSide, RotAngleStr(newRotatorAngle), stored.timestamp));
+        SetCalibration(stored);
+    }
+
     if (binning != m_cal.binning)
     {
         Calibration cal(m_cal);
@@ -1249,6 +1365,19 @@ void Mount::ClearCalibration(void)
     if (pFrame) pFrame->UpdateCalibrationStatus();
 }
 
+void Mount::LoadProfileSettings(void)
+{
+    // the guide algorithms read their parameters when they are created, the
+    // subclass creates them again
+    delete m_pXGuideAlgorithm;
+    m_pXGuideAlgorithm = NULL;
+    delete m_pYGuideAlgorithm;
+    m_pYGuideAlgorithm = NULL;
+
+    // the calibration belongs to the old profile, auto-restore loads the new one
+    ClearCalibration();
+}
+
 void Mount::SetCalibration(const Calibration& cal)
 {
     Debug.Write(wxString::Format("Mount::SetCalibration (%s) -- xAngle=%.1f yAngle=%.1f xRate=%.3f yRate=%.3f bin=%hu dec=%s pierSide=%d par=%s/%s rotAng=%s\n",
@@ -1275,6 +1404,7 @@ void Mount::SetCalibration(const Calibration& cal)
     m_cal.xAngle = cal.xAngle;
     m_cal.yAngle = cal.yAngle;
     m_yAngleError = norm_angle(cal.xAngle - cal.yAngle + M_PI / 2.);
+    UpdateTransform();
 
     Debug.AddLine(wxString::Format("Mount::SetCalibration (%s) -- sets m_xAngle=%.1f m_yAngleError=%.1f",
         GetMountClassName(), degrees(m_cal.xAngle), degrees(m_yAngleError)));
@@ -1296,6 +1426,8 @@ void Mount::SetCalibration(const Calibration& cal)
     pConfig->Profile.SetInt(prefix + "raGuideParity", m_cal.raGuideParity);
     pConfig->Profile.SetInt(prefix + "decGuideParity", m_cal.decGuideParity);
     pConfig->Profile.SetDouble(prefix + "rotatorAngle", m_cal.rotatorAngle);
+    if (pCamera)
+        pConfig->Profile.SetString(prefix + "camera", pCamera->Name);
 }
 
 void Mount::SetCalibrationDetails(const CalibrationDetails& calDetails)
@@ -1386,6 +1518,8 @@ void Mount::NotifyGuidingDithered(double dx, double dy)
 {
     Debug.Write(wxString::Format("Mount: notify guiding dithered (%.1f, %.1f)\n", dx, dy));
 
+    PolarDrift::NotifyGuidingDithered();
+
     if (m_pXGuideAlgorithm)
         m_pXGuideAlgorithm->GuidingDithered(dx);
 
@@ -1490,7 +1624,11 @@ bool Mount::Connect(void)
 
     if (pFrame)
     {
-        pFrame->UpdateCalibrationStatus();
+        // the gear dialog may connect some mounts on a background thread
+        if (wxThread::IsMain())
+            pFrame->UpdateCalibrationStatus();
+        else
+            pFrame->CallAfter(&MyFrame::UpdateCalibrationStatus);
     }
 
     return false;
@@ -1508,7 +1646,11 @@ wxString Mount::GetSettingsSummary()
 {
     // return a loggable summary of current mount settings
     wxString algorithms[] = {
-        _T("None"),_T("Hysteresis"),_T("Lowpass"),_T("Lowpass2"), _T("Resist Switch")
+        _T("None"),_T("Hysteresis"),_T("Lowpass"),_T("Lowpass2"), _T("Resist Switch"),
+#if defined(MPIIS_GAUSSIAN_PROCESS_GUIDING_ENABLED__)
+        _T("Gaussian Process"),
+#endif
+        _T("Predictive PEC"), _T("Chain"),
     };
     wxString auxMountStr = wxEmptyString;
     if (m_Name == _("On Camera") && pPointingSource && pPointingSource->IsConnected() && pPointingSource->CanReportPosition())
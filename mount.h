@@ -154,6 +154,10 @@ class Mount : public wxMessageBoxProxy
     Calibration m_cal;
     double m_xRate;         // rate adjusted for declination
     double m_yAngleError;
+    double m_cameraToMount[2][2];   // m_cal.xAngle and m_yAngleError as a matrix
+    double m_mountToCamera[2][2];
+
+    void UpdateTransform(void);
 
 protected:
     bool m_guidingEnabled;
@@ -248,6 +252,12 @@ public:
     bool TransformMountCoordinatesToCameraCoordinates(const PHD_Point& mountVectorEndpoint,
                                                      PHD_Point& cameraVectorEndpoint);
 
+    // batch versions, return true if any of the points were invalid
+    bool TransformCameraCoordinatesToMountCoordinates(const PHD_Point *cameraVectorEndpoints,
+                                                      PHD_Point *mountVectorEndpoints, unsigned int count);
+    bool TransformMountCoordinatesToCameraCoordinates(const PHD_Point *mountVectorEndpoints,
+                                                      PHD_Point *cameraVectorEndpoints, unsigned int count);
+
     void LogGuideStepInfo(void);
 
     GraphControlPane *GetXGuideAlgorithmControlPane(wxWindow *pParent);
@@ -280,6 +290,10 @@ public:
     virtual bool BeginCalibration(const PHD_Point &currentLocation) = 0;
     virtual bool UpdateCalibrationState(const PHD_Point &currentLocation) = 0;
 
+    // move both axes; the default moves x then y, a subclass may move them at once
+    virtual MOVE_RESULT MoveAxes(GUIDE_DIRECTION xDirection, int xAmount, GUIDE_DIRECTION yDirection, int yAmount,
+                                 MountMoveType moveType, MoveResultInfo *xMoveResultInfo, MoveResultInfo *yMoveResultInfo);
+
     virtual void NotifyGuidingStopped(void);
     virtual void NotifyGuidingPaused(void);
     virtual void NotifyGuidingResumed(void);
@@ -317,6 +331,9 @@ public:
 
     virtual bool IsCalibrated(void);
     virtual void ClearCalibration(void);
+    // re-read the profile settings of a mount that is kept connected across
+    // a profile switch
+    virtual void LoadProfileSettings(void);
     virtual void SetCalibration(const Calibration& cal);
     virtual void SetCalibrationDetails(const CalibrationDetails& calDetails);
     void GetCalibrationDetails(CalibrationDetails *calDetails);
@@ -324,6 +341,9 @@ public:
     virtual bool IsConnected(void) const;
     virtual bool Connect(void);
     virtual bool Disconnect(void);
+    // True if Connect can be called on a thread other than the main thread.
+    // Only for mounts that do not need other gear to be connected first.
+    virtual bool CanConnectInBackground(void) const { return false; }
 
     virtual wxString GetSettingsSummary();
     virtual wxString CalibrationSettingsSummary() { return wxEmptyString; }
@@ -38,6 +38,8 @@
 #define MYFRAME_H_INCLUDED
 
 class WorkerThread;
+struct WorkerThreadStats;
+struct ThreadCpuTime;
 class MyFrame;
 class RefineDefMap;
 struct alert_params;
@@ -54,9 +56,20 @@ wxDECLARE_EVENT(REQUEST_MOUNT_MOVE_EVENT, wxCommandEvent);
 wxDECLARE_EVENT(WXMESSAGEBOX_PROXY_EVENT, wxCommandEvent);
 wxDECLARE_EVENT(STATUSBAR_ENQUEUE_EVENT, wxCommandEvent);
 wxDECLARE_EVENT(STATUSBAR_TIMER_EVENT, wxTimerEvent);
+wxDECLARE_EVENT(DISPLAY_TIMER_EVENT, wxTimerEvent);
 wxDECLARE_EVENT(SET_STATUS_TEXT_EVENT, wxThreadEvent);
 wxDECLARE_EVENT(ALERT_FROM_THREAD_EVENT, wxThreadEvent);
 
+// windows repainted by MyFrame::ScheduleDisplayUpdate
+enum DISPLAY_UPDATE
+{
+    DISPLAY_UPDATE_IMAGE = 1 << 0,
+    DISPLAY_UPDATE_GRAPH = 1 << 1,
+    DISPLAY_UPDATE_TARGET = 1 << 2,
+    DISPLAY_UPDATE_PROFILE = 1 << 3,
+    DISPLAY_UPDATE_STATS = 1 << 4,
+};
+
 enum NOISE_REDUCTION_METHOD
 {
     NR_NONE,
@@ -68,7 +81,8 @@ enum LOGGED_IMAGE_FORMAT
 {
     LIF_LOW_Q_JPEG,
     LIF_HI_Q_JPEG,
-    LIF_RAW_FITS
+    LIF_RAW_FITS,
+    LIF_COMPRESSED_FITS
 };
 
 struct AutoExposureCfg
@@ -77,6 +91,7 @@ struct AutoExposureCfg
     int minExposure;
     int maxExposure;
     double targetSNR;
+    bool minimizeError;     // choose the exposure from the AutoExposureModel
 };
 
 typedef void alert_fn(long);
@@ -119,8 +134,10 @@ class MyFrameConfigDialogCtrlSet : public ConfigDialogCtrlSet
     wxRadioButton *m_ditherSpiral;
     wxSpinCtrlDouble *m_ditherScaleFactor;
     wxCheckBox *m_ditherRaOnly;
+    wxCheckBox *m_ditherRecovery;
     wxChoice *m_pNoiseReduction;
     wxSpinCtrl *m_pTimeLapse;
+    wxSpinCtrl *m_pCadence;
     wxTextCtrl *m_pFocalLength;
     wxChoice* m_pLanguage;
     wxArrayInt m_LanguageIDs;
@@ -128,9 +145,12 @@ class MyFrameConfigDialogCtrlSet : public ConfigDialogCtrlSet
     wxTextCtrl *m_pLogDir;
     wxButton *m_pSelectDir;
     wxCheckBox *m_pAutoLoadCalibration;
+    wxCheckBox *m_pPipelinedCapture;
+    wxCheckBox *m_pLazyROI;
     wxComboBox *m_autoExpDurationMin;
     wxComboBox *m_autoExpDurationMax;
     wxSpinCtrlDouble *m_autoExpSNR;
+    wxCheckBox *m_autoExpMinimizeError;
     void OnDirSelect(wxCommandEvent& evt);
 
 public:
@@ -154,6 +174,7 @@ protected:
 
     bool SetTimeLapse(int timeLapse);
     int GetTimeLapse(void);
+    bool SetCadence(int cadence);
 
     bool SetFocalLength(int focalLength);
 
@@ -161,6 +182,11 @@ protected:
 
     void SetAutoLoadCalibration(bool val);
 
+    void SetPipelinedCapture(bool val);
+    void SetLazyROI(bool val);
+    void SetFusedCalibration(bool val);
+    void SetGaussianCentroid(bool val);
+
     friend class MyFrameConfigDialogPane;
     friend class MyFrameConfigDialogCtrlSet;
     friend class WorkerThread;
@@ -172,12 +198,20 @@ private:
     DitherMode m_ditherMode;
     double m_ditherScaleFactor;
     bool m_ditherRaOnly;
+    bool m_ditherRecovery;          // use the recovery profile after each dither
+    bool m_ditherRecoveryActive;    // dithered and not yet settled
+    int m_calExposure;              // shortened exposure while a mount calibrates, 0 for the guide exposure
     DitherSpiral m_ditherSpiral;
     bool m_serverMode;
     int  m_timeLapse;       // Delay between frames (useful for vid cameras)
+    int  m_cadence;         // Interval between exposure starts, ms, or 0 to start each as soon as possible
     int  m_focalLength;
     double m_sampling;
     bool m_autoLoadCalibration;
+    bool m_pipelinedCapture;  // allow the next exposure to start before the current frame is processed
+    bool m_lazyROI;           // calibrate and filter full frames only around the guide star until they are needed in full
+    bool m_fusedCalibration;  // dark subtract, filter and measure full frames in a single pass
+    bool m_gaussianCentroid;  // refine the guide star centroid with a Gaussian fit
     int m_instanceNumber;
 
     wxAuiManager m_mgr;
@@ -205,7 +239,8 @@ public:
     wxInfoBar *m_infoBar;
     wxComboBox    *Dur_Choice;
     wxCheckBox *HotPixel_Checkbox;
-    wxHtmlHelpController *help;
+    wxHtmlHelpController *help;     // created on first use, see DisplayHelp
+    wxString m_helpFile;
     wxSlider *Gamma_Slider;
     AdvancedDialog *pAdvancedDialog;
     GraphLogWindow *pGraphLog;
@@ -227,7 +262,6 @@ public:
     double Stretch_gamma;
     wxLocale *m_pLocale;
     unsigned int m_frameCounter;
-    unsigned int m_loggedImageFrame;
     wxDateTime m_guidingStarted;
     Star::FindMode m_starFindMode;
     bool m_rawImageMode;
@@ -243,6 +277,8 @@ public:
     void OnOverlaySlitCoords(wxCommandEvent& evt);
     void OnInstructions(wxCommandEvent& evt);
     void OnSave(wxCommandEvent& evt);
+    void OnFitsSaved(const wxString& fileName, const wxString& error);
+    void OnDarkInterpolated(void);
     void OnSettings(wxCommandEvent& evt);
     void OnLog(wxCommandEvent& evt);
     void OnSelectGear(wxCommandEvent& evt);
@@ -266,6 +302,8 @@ public:
     void OnSockServerEvent(wxSocketEvent& evt);
     void OnSockServerClientEvent(wxSocketEvent& evt);
     void HandleSockServerInput(wxSocketBase *sock);
+    void ProcessSockServerCommand(wxSocketBase *sock);
+    unsigned char HandleSockServerCommand(const unsigned char *cmd);
     void OnServerMenu(wxCommandEvent& evt);
     void OnCharHook(wxKeyEvent& evt);
     void OnTextControlSetFocus(wxFocusEvent& evt);
@@ -306,13 +344,21 @@ public:
     void GetExposureInfo(int *currExpMs, bool *autoExp);
     bool SetExposureDuration(int val);
     const AutoExposureCfg& GetAutoExposureCfg(void) const { return m_autoExp; }
-    void SetAutoExposureCfg(int minExp, int maxExp, double targetSNR);
+    void SetAutoExposureCfg(int minExp, int maxExp, double targetSNR, bool minimizeError);
+    const AutoExposureModel& GetAutoExposureModel(void) const { return m_autoExpModel; }
     void ResetAutoExposure(void);
-    void AdjustAutoExposure(double curSNR);
+    void AdjustAutoExposure(double curSNR, double hfd, const PHD_Point& offset);
+    void AdjustCalibrationExposure(double curSNR);
+    bool ShortCalibrationActive(void) const;
     double GetDitherScaleFactor(void);
     bool SetDitherScaleFactor(double ditherScaleFactor);
     bool GetDitherRaOnly(void);
     bool SetDitherRaOnly(bool ditherRaOnly);
+    bool GetDitherRecovery(void) const { return m_ditherRecovery; }
+    void SetDitherRecovery(bool enable);
+    bool InDitherRecovery(void) const { return m_ditherRecoveryActive; }
+    void EndDitherRecovery(void);
+    double DitherRecoveryCorrection(double rawDistance, double algoDistance) const;
     double GetDitherAmount(int ditherType);
     void EnableImageLogging(bool enable);
     bool IsImageLoggingEnabled(void);
@@ -329,6 +375,11 @@ public:
     int GetFocalLength(void);
     int GetLanguage(void);
     bool GetAutoLoadCalibration(void);
+    bool GetPipelinedCapture(void);
+    bool PipelinedCaptureAllowed(void);
+    bool GetLazyROI(void);
+    bool GetFusedCalibration(void);
+    bool GetGaussianCentroid(void);
     void LoadCalibration(void);
     int GetInstanceNumber() const { return m_instanceNumber; }
     static wxString GetDefaultFileDir();
@@ -336,16 +387,20 @@ public:
     bool DarkLibExists(int profileId, bool showAlert);
     bool LoadDarkLibrary();
     void SaveDarkLibrary(const wxString& note);
+    static bool SaveDarkLibraryFile(const ExposureImgMap& darks, const wxString& filename, const wxString& note);
     void DeleteDarkLibraryFiles(int profileID);
     static wxString DarkLibFileName(int profileId);
     void SetDarkMenuState();
     bool LoadDarkHandler(bool checkIt);         // Use to also set menu item states
     void LoadDefectMapHandler(bool checkIt);
+    void UnloadDarks(void);                     // unlike the handlers, leaves the auto-load settings alone
     void CheckDarkFrameGeometry();
     void UpdateStateLabels();
     void UpdateStarInfo(double SNR, bool Saturated);
     void UpdateGuiderInfo(const GuideStepInfo& info);
     void ClearGuiderInfo();
+    void ScheduleDisplayUpdate(unsigned int what);
+    bool IsHeadless(void) const { return m_headless; }
     static void PlaceWindowOnScreen(wxWindow *window, int x, int y);
 
     MyFrameConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
@@ -383,9 +438,12 @@ public:
     wxString GetSettingsSummary();
     wxString ExposureDurationSummary(void) const;
     wxString PixelScaleSummary(void) const;
-    void TryReconnect(void);
+    void TryReconnect(bool quick = false);
 
     double TimeSinceGuidingStarted(void) const;
+    WorkerThreadStats GetCaptureThreadStats(void);
+    void GetThreadCpuTimes(std::vector<ThreadCpuTime> *threads);
+    int GetCadence(void);
     void NotifyGuidingStopped(void);
 
     void SetDitherMode(DitherMode mode);
@@ -401,13 +459,28 @@ public:
 private:
     wxCriticalSection m_CSpWorkerThread;
     WorkerThread *m_pPrimaryWorkerThread;
+    WorkerThread *m_pMountWorkerThread;
     WorkerThread *m_pSecondaryWorkerThread;
 
     wxSocketServer *SocketServer;
     wxTimer m_statusbarTimer;
+    wxTimer m_displayTimer;
+    unsigned int m_pendingDisplay;      // DISPLAY_UPDATE bits
+    wxLongLong_t m_lastDisplayUpdate;
+    int m_displayIntervalMs;
+    bool m_headless;                    // no windows shown, nothing is rendered
+
+    // status bar updates and alerts from other threads, merged until the
+    // main thread handles the one event queued for them
+    wxCriticalSection m_threadMsgLock;
+    unsigned int m_threadMsgPending;    // StatusbarThreadMsgType bits
+    wxString m_threadMsgText;
+    bool m_threadMsgTimeout;
+    std::vector<wxString> m_threadAlerts;   // alerts queued and not yet shown
 
     int m_exposureDuration;
     AutoExposureCfg m_autoExp;
+    AutoExposureModel m_autoExpModel;
 
     alert_fn *m_alertDontShowFn;
     alert_fn *m_alertSpecialFn;
@@ -416,25 +489,34 @@ private:
 
     std::vector<time_t> m_cameraReconnectAttempts; // for rate-limiting camera reconnect attempts
 
-    bool StartWorkerThread(WorkerThread*& pWorkerThread);
+    bool StartWorkerThread(WorkerThread*& pWorkerThread, const char *name);
     bool StopWorkerThread(WorkerThread*& pWorkerThread);
+    void LogWorkerThreadStats(void);
+    void QueueThreadStatusMsg(unsigned int what, const wxString& text = wxEmptyString, bool withTimeout = false);
     void OnStatusMsg(wxThreadEvent& event);
     void DoAlert(const alert_params& params);
     void OnAlertButton(wxCommandEvent& evt);
     void OnAlertHelp(wxCommandEvent& evt);
     void OnAlertFromThread(wxThreadEvent& event);
     void OnReconnectCameraFromThread(wxThreadEvent& event);
+    void OnDarkBuildDone(wxThreadEvent& event);
+    void OnCameraTestDone(wxThreadEvent& event);
+    void OnPulseProfileDone(wxThreadEvent& event);
+    void OnAOFastLoopDone(wxThreadEvent& event);
     void OnStatusbarTimerEvent(wxTimerEvent& evt);
+    void OnDisplayTimerEvent(wxTimerEvent& evt);
+    void RunDisplayUpdates(void);
     void OnMessageBoxProxy(wxCommandEvent& evt);
     void SetupMenuBar(void);
     void SetupStatusBar(void);
     void SetupToolBar();
     void SetupKeyboardShortcuts(void);
     void SetupHelpFile(void);
+    void DisplayHelp(const wxString& topic);
     int GetTextWidth(wxControl *pControl, const wxString& string);
     void SetComboBoxWidth(wxComboBox *pComboBox, unsigned int extra);
     void FinishStop(void);
-    void DoTryReconnect(void);
+    void DoTryReconnect(bool quick);
 
     // and of course, an event table
     DECLARE_EVENT_TABLE()
@@ -602,6 +684,11 @@ enum {
     SOCK_SERVER_CLIENT_ID,
     EVENT_SERVER_ID,
     EVENT_SERVER_CLIENT_ID,
+    EVENT_SERVER_WS_ID,
+    EVENT_SERVER_RELAY_ID,
+    EVENT_SERVER_RELAY_TIMER_ID,
+    IMAGE_STREAM_SERVER_ID,
+    IMAGE_STREAM_CLIENT_ID,
 };
 
 wxDECLARE_EVENT(APPSTATE_NOTIFY_EVENT, wxCommandEvent);
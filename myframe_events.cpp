@@ -113,7 +113,7 @@ problems, read the help files! ")),_("Instructions"));
 
 void MyFrame::OnHelp(wxCommandEvent& WXUNUSED(event))
 {
-    help->Display(_("Introduction"));
+    DisplayHelp(_("Introduction"));
 }
 
 void MyFrame::OnAbout(wxCommandEvent& WXUNUSED(event))
@@ -250,14 +250,26 @@ void MyFrame::OnSave(wxCommandEvent& WXUNUSED(event))
     if (fname.IsEmpty())
         return;  // Check for canceled dialog
 
-    if (pGuider->SaveCurrentImage(fname))
+    // the result comes back in OnFitsSaved
+    if (pGuider->SaveCurrentImageAsync(fname, FitsWriter::CompressByDefault(), FITS_NOTIFY_FRAME))
     {
         Alert(wxString::Format(_("The image could not be saved to %s"), fname));
     }
+}
+
+void MyFrame::OnFitsSaved(const wxString& fileName, const wxString& error)
+{
+    if (!error.empty())
+        Alert(error);
     else
-    {
-        pFrame->StatusMsg(wxString::Format(_("%s saved"), wxFileName(fname).GetFullName()));
-    }
+        StatusMsg(wxString::Format(_("%s saved"), wxFileName(fileName).GetFullName()));
+}
+
+// see DarkModel::GetInterpolatedDark
+void MyFrame::OnDarkInterpolated(void)
+{
+    if (pCamera && pCamera->Connected)
+        pCamera->SelectDark(m_exposureDuration);
 }
 
 void MyFrame::OnIdle(wxIdleEvent& WXUNUSED(event))
@@ -290,6 +302,11 @@ void MyFrame::OnLoopExposure(wxCommandEvent& WXUNUSED(event))
 void MyFrame::FinishStop(void)
 {
     assert(!CaptureActive);
+    {
+        wxCriticalSectionLocker lock(m_CSpWorkerThread);
+        if (m_pPrimaryWorkerThread)
+            m_pPrimaryWorkerThread->EnqueueWorkerThreadStopStreamRequest();
+    }
     EvtServer.NotifyLoopingStopped();
     // when looping resumes, start with at least one full frame. This enables applications
     // controlling PHD to auto-select a new star if the star is lost while looping was stopped.
@@ -312,7 +329,7 @@ static void SuppressRawModeWarning(long)
 
 static void WarnRawImageMode(void)
 {
-    if (pCamera->FullSize != pCamera->DarkFrameSize())
+    if (pCamera->FrameSize() != pCamera->DarkFrameSize())
     {
         pFrame->SuppressableAlert(RawModeWarningKey(), _("For refining the Bad-pixel Map PHD2 is now displaying raw camera data frames, which are a different size from ordinary guide frames for this camera."),
             SuppressRawModeWarning, 0);
@@ -386,6 +403,16 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
             CheckDarkFrameGeometry();
         }
 
+        // In pipelined mode the next exposure is started before this frame is
+        // processed, so the guide correction computed below is applied while
+        // the camera is already integrating the next frame.
+        bool pipelined = PipelinedCaptureAllowed();
+        if (pipelined)
+        {
+            Debug.Write("OnExposeComplete: pipelined, scheduling next exposure before processing frame\n");
+            ScheduleExposure();
+        }
+
         pGuider->UpdateGuideState(pNewFrame, !m_continueCapturing);
         pNewFrame = NULL; // the guider owns it now
 
@@ -394,6 +421,13 @@ void MyFrame::OnExposeComplete(usImage *pNewFrame, bool err)
         Debug.Write(wxString::Format("OnExposeComplete: CaptureActive=%d m_continueCapturing=%d\n",
             CaptureActive, m_continueCapturing));
 
+        if (pipelined)
+        {
+            // the next exposure is already pending; a stop request during
+            // processing is delivered to it by StopCapturing
+            return;
+        }
+
         CaptureActive = m_continueCapturing;
 
         if (CaptureActive)
@@ -431,6 +465,9 @@ void MyFrame::OnMoveComplete(wxThreadEvent& event)
 
         mount->LogGuideStepInfo();
 
+        if (pGuider->IsGuiding())
+            SessionSnapshot::NotifyGuideStep();
+
         // deliver the outstanding GuidingStopped notification if this is a late-arriving
         // move completion event
         if (!pGuider->IsCalibratingOrGuiding() &&
@@ -481,6 +518,12 @@ void MyFrame::OnDark(wxCommandEvent& WXUNUSED(event))
         return;
     }
 
+    if (DarkBuilder::IsActive())
+    {
+        wxMessageBox(_("A dark build is already in progress"), _("Info"));
+        return;
+    }
+
     DarksDialog dlg(this, true);
     dlg.ShowModal();
 
@@ -570,6 +613,17 @@ void MyFrame::LoadDefectMapHandler(bool checkIt)
     }
 }
 
+void MyFrame::UnloadDarks(void)
+{
+    if (pCamera)
+    {
+        pCamera->ClearDarks();
+        pCamera->ClearDefectMap();
+    }
+    m_useDarksMenuItem->Check(false);
+    m_useDefectMapMenuItem->Check(false);
+}
+
 void MyFrame::OnLoadDefectMap(wxCommandEvent& evt)
 {
     LoadDefectMapHandler(evt.IsChecked());
@@ -945,6 +999,36 @@ void MyFrame::OnSelectGear(wxCommandEvent& evt)
             throw ERROR_INFO("OnSelectGear called while CaptureActive");
         }
 
+        if (DarkBuilder::IsActive())
+        {
+            wxMessageBox(_("Please wait for the dark build to finish"), _("Info"));
+            return;
+        }
+
+        if (CameraTest::IsActive())
+        {
+            wxMessageBox(_("Please wait for the camera test to finish"), _("Info"));
+            return;
+        }
+
+        if (PulseProfiler::IsActive())
+        {
+            wxMessageBox(_("Please wait for the mount profile to finish"), _("Info"));
+            return;
+        }
+
+        if (AOFastLoop::IsActive())
+        {
+            wxMessageBox(_("Please stop the AO fast loop first"), _("Info"));
+            return;
+        }
+
+        if (CaptureNode::IsRunning())
+        {
+            wxMessageBox(_("The equipment cannot be changed while PHD2 is running as a capture node"), _("Info"));
+            return;
+        }
+
         if (pConfig->NumProfiles() == 1 && pGearDialog->IsEmptyProfile())
         {
             if (ConfirmDialog::Confirm(
@@ -0,0 +1,626 @@
+/*
+ *  perf_trace.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+#if defined(__WINDOWS__)
+# include <windows.h>
+#elif defined(__APPLE__)
+# include <mach/mach_time.h>
+# include <pthread.h>
+#else
+# include <time.h>
+#endif
+
+#if defined(__linux__)
+# include <fcntl.h>
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+# define PHD_THREAD_LOCAL __declspec(thread)
+#else
+# define PHD_THREAD_LOCAL __thread
+#endif
+
+std::atomic<bool> PerfTrace::s_enabled(false);
+
+static std::atomic<bool> s_recording(false);
+static std::atomic<bool> s_markers(false);
+
+#if defined(__linux__)
+// opened the first time markers are turned on and kept open, so that a span
+// ending while they are turned off never writes to a closed descriptor
+static int s_markerFd = -1;
+static int s_markerPid;
+#endif
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name;
+    long long start;
+    long long dur;
+};
+
+struct TraceBuffer
+{
+    TraceEvent events[PerfTrace::BUFFER_EVENTS];
+    std::atomic<unsigned int> head;     // number of events ever recorded; written by the owning thread only
+    std::atomic<unsigned int> base;     // events before this were discarded by Start()
+    unsigned int tid;                   // small number for the trace file
+    wxString threadName;
+};
+}
+
+static PHD_THREAD_LOCAL TraceBuffer *t_buffer;
+static PHD_THREAD_LOCAL const char *t_threadName;
+
+static wxCriticalSection s_buffersLock;     // protects s_buffers
+static std::vector<TraceBuffer *> s_buffers;
+
+// buffers are never freed: a thread that records once usually runs for the
+// whole session, and the exporter may still be reading the buffer of a
+// thread that has exited
+static TraceBuffer *ThreadBuffer()
+{
+    TraceBuffer *buf = new TraceBuffer();
+    buf->head.store(0);
+    buf->base.store(0);
+    if (wxThread::IsMain())
+        buf->threadName = "main";
+    else if (t_threadName)
+        buf->threadName = t_threadName;
+    else
+        buf->threadName = wxString::Format("thread %lu", (unsigned long) wxThread::GetCurrentId());
+
+    wxCriticalSectionLocker lck(s_buffersLock);
+    s_buffers.push_back(buf);
+    buf->tid = s_buffers.size();
+    return buf;
+}
+
+long long PerfTrace::Now()
+{
+#if defined(__WINDOWS__)
+    static LARGE_INTEGER s_freq;
+    if (!s_freq.QuadPart)
+        QueryPerformanceFrequency(&s_freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (long long)((double) now.QuadPart * 1e6 / (double) s_freq.QuadPart);
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t s_timebase;
+    if (!s_timebase.denom)
+        mach_timebase_info(&s_timebase);
+    return (long long)(mach_absolute_time() * s_timebase.numer / s_timebase.denom / 1000);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void UpdateEnabled()
+{
+    PerfTrace::s_enabled.store(s_recording.load() || s_markers.load());
+}
+
+void PerfTrace::Begin(const char *name)
+{
+#if defined(__linux__)
+    if (s_markers.load(std::memory_order_relaxed))
+    {
+        char buf[128];
+        int n = snprintf(buf, sizeof(buf), "B|%d|%s", s_markerPid, name);
+        if (n > 0 && write(s_markerFd, buf, wxMin(n, (int) sizeof(buf) - 1)) < 0)
+        {
+            // nothing to be done, the marker is lost
+        }
+    }
+#endif
+}
+
+void PerfTrace::Record(const char *name, long long startUs, long long endUs)
+{
+#if defined(__linux__)
+    if (s_markers.load(std::memory_order_relaxed))
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "E|%d", s_markerPid);
+        if (n > 0 && write(s_markerFd, buf, n) < 0)
+        {
+            // nothing to be done, the marker is lost
+        }
+    }
+#endif
+
+    if (!s_recording.load(std::memory_order_relaxed))
+        return;
+
+    TraceBuffer *buf = t_buffer;
+    if (!buf)
+        t_buffer = buf = ThreadBuffer();
+
+    unsigned int h = buf->head.load(std::memory_order_relaxed);
+    TraceEvent& ev = buf->events[h % BUFFER_EVENTS];
+    ev.name = name;
+    ev.start = startUs;
+    ev.dur = endUs - startUs;
+    buf->head.store(h + 1, std::memory_order_release);
+}
+
+void PerfTrace::Start()
+{
+    {
+        wxCriticalSectionLocker lck(s_buffersLock);
+        for (size_t i = 0; i < s_buffers.size(); i++)
+            s_buffers[i]->base.store(s_buffers[i]->head.load(std::memory_order_acquire));
+    }
+
+    s_recording.store(true);
+    UpdateEnabled();
+    Debug.AddLine("PerfTrace: started");
+}
+
+void PerfTrace::Stop()
+{
+    s_recording.store(false);
+    UpdateEnabled();
+    Debug.AddLine("PerfTrace: stopped");
+}
+
+bool PerfTrace::IsRecording()
+{
+    return s_recording.load(std::memory_order_relaxed);
+}
+
+bool PerfTrace::SetMarkers(bool enable)
+{
+#if defined(__linux__)
+    if (enable && s_markerFd < 0)
+    {
+        static const char *const paths[] = { "/sys/kernel/tracing/trace_marker", "/sys/kernel/debug/tracing/trace_marker" };
+        for (size_t i = 0; i < WXSIZEOF(paths) && s_markerFd < 0; i++)
+            s_markerFd = open(paths[i], O_WRONLY | O_CLOEXEC);
+        if (s_markerFd < 0)
+        {
+            Debug.AddLine("PerfTrace: cannot open the ftrace trace_marker file, profiler markers not enabled");
+            return true;
+        }
+        s_markerPid = getpid();
+    }
+
+    s_markers.store(enable);
+    UpdateEnabled();
+    Debug.Write(wxString::Format("PerfTrace: profiler markers %s\n", enable ? "on" : "off"));
+    return false;
+#else
+    if (enable)
+    {
+        Debug.AddLine("PerfTrace: profiler markers are not supported on this platform");
+        return true;
+    }
+    return false;
+#endif
+}
+
+bool PerfTrace::MarkersEnabled()
+{
+    return s_markers.load(std::memory_order_relaxed);
+}
+
+void PerfTrace::SetThreadName(const char *name)
+{
+    t_threadName = name;
+
+    if (wxThread::IsMain())
+        return;
+
+#if defined(__WINDOWS__)
+    // SetThreadDescription is only there on Windows 10 1607 and later
+    typedef HRESULT (WINAPI *SetThreadDescriptionFn)(HANDLE, PCWSTR);
+    static SetThreadDescriptionFn s_setDescription =
+        (SetThreadDescriptionFn) GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+    if (s_setDescription)
+        s_setDescription(GetCurrentThread(), wxString(name).wc_str());
+#elif defined(__APPLE__)
+    pthread_setname_np(name);
+#elif defined(__linux__)
+    char buf[16];
+    strncpy(buf, name, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    pthread_setname_np(pthread_self(), buf);
+#endif
+}
+
+bool PerfTrace::Export(wxString *fileName)
+{
+    std::vector<TraceBuffer *> buffers;
+    {
+        wxCriticalSectionLocker lck(s_buffersLock);
+        buffers = s_buffers;
+    }
+
+    wxDateTime now = wxDateTime::Now();
+    *fileName = Debug.GetLogDir() + PATHSEPSTR + "PHD2_Trace" + now.Format(_T("_%Y-%m-%d")) + now.Format(_T("_%H%M%S")) + ".json";
+
+    wxFFile file;
+    if (!file.Open(*fileName, "w"))
+        return true;
+
+    file.Write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    unsigned int count = 0;
+    std::vector<TraceEvent> events;
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        TraceBuffer *buf = buffers[i];
+
+        file.Write(wxString::Format("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", buf->tid, buf->threadName));
+        first = false;
+
+        // the owning thread may still be recording; copy the ring, then drop
+        // whatever it overwrote while we were copying
+        unsigned int head = buf->head.load(std::memory_order_acquire);
+        unsigned int n = head - buf->base.load(std::memory_order_relaxed);
+        if (n > BUFFER_EVENTS)
+            n = BUFFER_EVENTS;
+        events.resize(n);
+        for (unsigned int j = 0; j < n; j++)
+            events[j] = buf->events[(head - n + j) % BUFFER_EVENTS];
+        unsigned int after = buf->head.load(std::memory_order_acquire);
+        unsigned int overwritten = after - head;
+        unsigned int skip = overwritten < n ? overwritten : n;
+
+        wxString chunk;
+        for (unsigned int j = skip; j < n; j++)
+        {
+            const TraceEvent& ev = events[j];
+            chunk += wxString::Format(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}",
+                ev.name, buf->tid, ev.start, ev.dur);
+            if (chunk.length() > 64 * 1024)
+            {
+                file.Write(chunk);
+                chunk.clear();
+            }
+        }
+        file.Write(chunk);
+        count += n - skip;
+    }
+
+    file.Write("\n]}\n");
+
+    bool err = !file.Close();
+    Debug.Write(wxString::Format("PerfTrace: exported %u spans to %s\n", count, *fileName));
+
+    return err;
+}
+
+void PerfHistogram::Clear()
+{
+    for (int i = 0; i < NUM_BINS; i++)
+        bins[i].store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    maxUs.store(0, std::memory_order_relaxed);
+    totalUs.store(0, std::memory_order_relaxed);
+}
+
+void PerfHistogram::Add(long long us)
+{
+    unsigned int const v = us < 0 ? 0 : us > 0xffffffffLL ? 0xffffffffU : (unsigned int) us;
+
+    bins[BinIndex(v)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalUs.fetch_add(v, std::memory_order_relaxed);
+
+    unsigned int prev = maxUs.load(std::memory_order_relaxed);
+    while (v > prev && !maxUs.compare_exchange_weak(prev, v, std::memory_order_relaxed))
+        ;
+}
+
+int PerfHistogram::BinIndex(unsigned int us)
+{
+    if (us < SUB_BINS)
+        return us;
+
+    int msb = 2;
+    while (msb < 31 && (us >> (msb + 1)) != 0)
+        ++msb;
+
+    return SUB_BINS + (msb - 2) * SUB_BINS + ((us >> (msb - 2)) & (SUB_BINS - 1));
+}
+
+double PerfHistogram::BinUpperUs(int bin)
+{
+    if (bin < SUB_BINS)
+        return bin + 1;
+
+    int const octave = (bin - SUB_BINS) / SUB_BINS;
+    int const sub = (bin - SUB_BINS) % SUB_BINS;
+    return ldexp((double)(SUB_BINS + sub + 1), octave);
+}
+
+namespace
+{
+struct WindowSlice
+{
+    std::atomic<long long> epoch;       // slice number from the start of the clock
+    PerfHistogram stage[NUM_PERF_STAGES];
+};
+}
+
+static PerfHistogram s_session[NUM_PERF_STAGES];
+static WindowSlice s_window[PerfStats::WINDOW_SLICES];
+static long long s_sliceUs = 60 * 1000000LL;
+static double s_slowFraction = 0.5;
+
+// overhead of the last capture, waiting for CycleDone; -1 when there is none
+static std::atomic<long long> s_pendingOverheadUs(-1);
+static std::atomic<int> s_pendingExposureMs(0);
+static std::atomic<unsigned int> s_cycles(0);
+static std::atomic<unsigned int> s_slowCycles(0);
+
+static const char *const s_stageNames[NUM_PERF_STAGES][2] =
+{
+    { "expose",         "WorkerThread::HandleExpose" },
+    { "capture",        "GuideCamera::Capture" },
+    { "dark",           "SubtractDark" },
+    { "defects",        "RemoveDefects" },
+    { "star_find",      "Star::Find" },
+    { "guide_state",    "Guider::UpdateGuideState" },
+    { "paint",          "Guider::PaintHelper" },
+    { "move",           "Mount::Move" },
+    { "algorithm_ra",   "GuideAlgorithm::result RA" },
+    { "algorithm_dec",  "GuideAlgorithm::result Dec" },
+    { "notify",         "EventServer::NotifyGuideStep" },
+    { "cycle",          "GuideCycle" },
+};
+
+void PerfStats::Init()
+{
+    int minutes = pConfig->Global.GetInt("/perf/window_minutes", 10);
+    if (minutes < 1)
+        minutes = 1;
+    s_sliceUs = (long long) minutes * 60 * 1000000 / WINDOW_SLICES;
+
+    s_slowFraction = pConfig->Global.GetDouble("/perf/slow_cycle_fraction", 0.5);
+
+    if (pConfig->Global.GetBoolean("/perf/profiler_markers", false))
+        PerfTrace::SetMarkers(true);
+
+    for (int i = 0; i < WINDOW_SLICES; i++)
+        s_window[i].epoch.store(-1);
+
+    Debug.Write(wxString::Format("PerfStats: window %d min, slow cycle fraction %.2f\n", minutes, s_slowFraction));
+}
+
+void PerfStats::Add(PerfStage stage, long long us)
+{
+    s_session[stage].Add(us);
+
+    long long const epoch = PerfTrace::Now() / s_sliceUs;
+    WindowSlice& slice = s_window[epoch % WINDOW_SLICES];
+    long long prev = slice.epoch.load(std::memory_order_acquire);
+    if (prev != epoch && slice.epoch.compare_exchange_strong(prev, epoch))
+    {
+        // first sample of a new slice: what is there is a full window old
+        for (int i = 0; i < NUM_PERF_STAGES; i++)
+            slice.stage[i].Clear();
+    }
+    slice.stage[stage].Add(us);
+}
+
+void PerfStats::CaptureDone(long long startUs, long long endUs, int exposureMs)
+{
+    long long overhead = endUs - startUs - (long long) exposureMs * 1000;
+    if (overhead < 0)
+        overhead = 0;
+    s_pendingExposureMs.store(exposureMs, std::memory_order_relaxed);
+    s_pendingOverheadUs.store(overhead, std::memory_order_release);
+}
+
+void PerfStats::CycleDone(long long guideStateUs)
+{
+    long long const overhead = s_pendingOverheadUs.exchange(-1, std::memory_order_acquire);
+    if (overhead < 0)
+        return;                 // no capture to pair with (e.g. a loaded image)
+
+    int const exposureMs = s_pendingExposureMs.load(std::memory_order_relaxed);
+    long long const processing = overhead + guideStateUs;
+
+    Add(PERF_STAGE_CYCLE, processing);
+    s_cycles.fetch_add(1, std::memory_order_relaxed);
+    AllocTrack::CycleDone();
+    LoadShedder::CycleDone(processing, exposureMs);
+
+    if (exposureMs > 0 && processing > s_slowFraction * exposureMs * 1000.0)
+    {
+        unsigned int n = s_slowCycles.fetch_add(1, std::memory_order_relaxed) + 1;
+        Debug.Write(wxString::Format("PerfStats: slow cycle %u: processing %.1f ms (capture %.1f, update %.1f) for %d ms exposure\n",
+            n, processing / 1000.0, overhead / 1000.0, guideStateUs / 1000.0, exposureMs));
+    }
+}
+
+static void Summarize(const unsigned int *bins, unsigned int count, long long totalUs, unsigned int maxUs, PerfSummary *summary)
+{
+    summary->count = count;
+    summary->meanMs = count ? totalUs / 1000.0 / count : 0.0;
+    summary->maxMs = maxUs / 1000.0;
+
+    double const pct[3] = { 50.0, 95.0, 99.0 };
+    double *const out[3] = { &summary->p50Ms, &summary->p95Ms, &summary->p99Ms };
+
+    unsigned int cum = 0;
+    int bin = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        *out[i] = 0.0;
+        if (!count)
+            continue;
+        unsigned int const target = (unsigned int) ceil(count * pct[i] / 100.0);
+        while (bin < PerfHistogram::NUM_BINS && cum + bins[bin] < target)
+            cum += bins[bin++];
+        *out[i] = PerfHistogram::BinUpperUs(bin) / 1000.0;
+        // the largest duration is known exactly; a bin edge above it says less
+        if (*out[i] > summary->maxMs)
+            *out[i] = summary->maxMs;
+    }
+}
+
+void PerfStats::GetSession(PerfStage stage, PerfSummary *summary)
+{
+    const PerfHistogram& h = s_session[stage];
+    unsigned int bins[PerfHistogram::NUM_BINS];
+    for (int i = 0; i < PerfHistogram::NUM_BINS; i++)
+        bins[i] = h.bins[i].load(std::memory_order_relaxed);
+
+    Summarize(bins, h.count.load(std::memory_order_relaxed), h.totalUs.load(std::memory_order_relaxed),
+              h.maxUs.load(std::memory_order_relaxed), summary);
+}
+
+void PerfStats::GetWindow(PerfStage stage, PerfSummary *summary)
+{
+    unsigned int bins[PerfHistogram::NUM_BINS] = { 0 };
+    unsigned int count = 0, maxUs = 0;
+    long long totalUs = 0;
+
+    long long const epoch = PerfTrace::Now() / s_sliceUs;
+    for (int i = 0; i < WINDOW_SLICES; i++)
+    {
+        const WindowSlice& slice = s_window[i];
+        if (slice.epoch.load(std::memory_order_acquire) <= epoch - WINDOW_SLICES)
+            continue;           // unused or expired
+        const PerfHistogram& h = slice.stage[stage];
+        for (int j = 0; j < PerfHistogram::NUM_BINS; j++)
+            bins[j] += h.bins[j].load(std::memory_order_relaxed);
+        count += h.count.load(std::memory_order_relaxed);
+        totalUs += h.totalUs.load(std::memory_order_relaxed);
+        unsigned int m = h.maxUs.load(std::memory_order_relaxed);
+        if (m > maxUs)
+            maxUs = m;
+    }
+
+    Summarize(bins, count, totalUs, maxUs, summary);
+}
+
+void PerfStats::Mark(PerfMark *mark)
+{
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+    {
+        const PerfHistogram& h = s_session[i];
+        for (int j = 0; j < PerfHistogram::NUM_BINS; j++)
+            mark->bins[i][j] = h.bins[j].load(std::memory_order_relaxed);
+        mark->count[i] = h.count.load(std::memory_order_relaxed);
+        mark->totalUs[i] = h.totalUs.load(std::memory_order_relaxed);
+    }
+    mark->cycles = s_cycles.load(std::memory_order_relaxed);
+    mark->slowCycles = s_slowCycles.load(std::memory_order_relaxed);
+}
+
+void PerfStats::GetSince(const PerfMark& mark, PerfStage stage, PerfSummary *summary)
+{
+    const PerfHistogram& h = s_session[stage];
+    unsigned int count = h.count.load(std::memory_order_relaxed);
+    long long totalUs = h.totalUs.load(std::memory_order_relaxed);
+    unsigned int const maxUs = h.maxUs.load(std::memory_order_relaxed);
+
+    // a reset since the mark leaves fewer samples than it had; everything
+    // there now is newer than the mark
+    bool const reset = count < mark.count[stage];
+    if (!reset)
+    {
+        count -= mark.count[stage];
+        totalUs -= mark.totalUs[stage];
+    }
+
+    unsigned int bins[PerfHistogram::NUM_BINS];
+    int top = -1;
+    for (int i = 0; i < PerfHistogram::NUM_BINS; i++)
+    {
+        unsigned int n = h.bins[i].load(std::memory_order_relaxed);
+        if (!reset)
+            n = n > mark.bins[stage][i] ? n - mark.bins[stage][i] : 0;
+        bins[i] = n;
+        if (n)
+            top = i;
+    }
+
+    unsigned int topUs = top < 0 ? 0 : (unsigned int) PerfHistogram::BinUpperUs(top);
+    Summarize(bins, count, totalUs, wxMin(topUs, maxUs), summary);
+}
+
+void PerfStats::ResetSession()
+{
+    for (int i = 0; i < NUM_PERF_STAGES; i++)
+        s_session[i].Clear();
+    s_cycles.store(0);
+    s_slowCycles.store(0);
+    Debug.AddLine("PerfStats: session histograms reset");
+}
+
+unsigned int PerfStats::SlowCycles()
+{
+    return s_slowCycles.load(std::memory_order_relaxed);
+}
+
+unsigned int PerfStats::Cycles()
+{
+    return s_cycles.load(std::memory_order_relaxed);
+}
+
+int PerfStats::WindowMinutes()
+{
+    return (int)(s_sliceUs * WINDOW_SLICES / (60 * 1000000LL));
+}
+
+double PerfStats::SlowCycleFraction()
+{
+    return s_slowFraction;
+}
+
+const char *PerfStats::StageName(PerfStage stage)
+{
+    return s_stageNames[stage][0];
+}
+
+const char *PerfStats::TraceName(PerfStage stage)
+{
+    return s_stageNames[stage][1];
+}
@@ -0,0 +1,312 @@
+/*
+ *  perf_trace.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef PERF_TRACE_INCLUDED
+#define PERF_TRACE_INCLUDED
+
+#include <atomic>
+
+// Scoped timing of the stages of the guide cycle. When tracing is on, each
+// PERF_SCOPE records its name, start time and duration in a buffer belonging
+// to the calling thread, so recording takes no lock. The buffers are rings
+// holding the last PerfTrace::BUFFER_EVENTS spans of each thread; Export()
+// writes them as a Chrome trace event file that can be loaded in
+// chrome://tracing or ui.perfetto.dev.
+//
+// Tracing is off by default and is controlled by the start_trace, stop_trace
+// and export_trace event server methods. When off, a PERF_SCOPE costs one
+// relaxed atomic load.
+//
+// Names must be string literals: only the pointer is kept.
+//
+// The regular stages of the guide cycle use PERF_STAGE instead, which also
+// adds the duration to the latency histograms kept by PerfStats whether or
+// not tracing is on.
+//
+// For sampling profilers the same spans can also be sent to the system
+// tracer as begin/end markers (set_profiler_markers, or the
+// /perf/profiler_markers setting at startup). On Linux they are written to
+// the ftrace trace_marker file in the systrace format, so perf (ftrace:print),
+// trace-cmd and Perfetto show them beside the samples; elsewhere markers are
+// not supported. Threads are named with SetThreadName, which the profilers
+// show too.
+
+class PerfTrace
+{
+public:
+    enum { BUFFER_EVENTS = 1 << 16 };
+
+    static std::atomic<bool> s_enabled;         // recording or sending markers
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void Start();        // discard what was recorded and start recording
+    static void Stop();
+    static bool IsRecording();
+    // write the recorded spans to a file in the log directory; true on error
+    static bool Export(wxString *fileName);
+
+    // microseconds from a monotonic clock
+    static long long Now();
+    static void Begin(const char *name);    // a span starts; only needed for the markers
+    static void Record(const char *name, long long startUs, long long endUs);
+
+    // true on error: markers are not supported here or the trace marker file
+    // cannot be opened
+    static bool SetMarkers(bool enable);
+    static bool MarkersEnabled();
+
+    // names the calling thread for the OS, and so for debuggers and
+    // profilers, and for the trace file. The main thread keeps its OS name,
+    // which is the process name on Linux. Names longer than 15 characters
+    // are cut short on Linux.
+    static void SetThreadName(const char *name);
+};
+
+class PerfScope
+{
+    const char *m_name;
+    long long m_start;
+
+public:
+    PerfScope(const char *name)
+    {
+        if (PerfTrace::IsEnabled())
+        {
+            m_name = name;
+            m_start = PerfTrace::Now();
+            PerfTrace::Begin(name);
+        }
+        else
+            m_name = 0;
+    }
+    ~PerfScope()
+    {
+        if (m_name)
+            PerfTrace::Record(m_name, m_start, PerfTrace::Now());
+    }
+};
+
+#define PERF_SCOPE_CAT2(a, b) a##b
+#define PERF_SCOPE_CAT(a, b) PERF_SCOPE_CAT2(a, b)
+#define PERF_SCOPE(name) PerfScope PERF_SCOPE_CAT(_perfScope, __LINE__)(name)
+
+enum PerfStage
+{
+    PERF_STAGE_EXPOSE,          // WorkerThread::HandleExpose
+    PERF_STAGE_CAPTURE,         // GuideCamera::Capture
+    PERF_STAGE_DARK,            // dark subtraction
+    PERF_STAGE_DEFECTS,         // defect map
+    PERF_STAGE_STAR_FIND,
+    PERF_STAGE_GUIDE_STATE,     // Guider::UpdateGuideState
+    PERF_STAGE_PAINT,
+    PERF_STAGE_MOVE,            // Mount::Move
+    PERF_STAGE_ALGO_RA,
+    PERF_STAGE_ALGO_DEC,
+    PERF_STAGE_NOTIFY,          // event server guide step notification
+    PERF_STAGE_CYCLE,           // processing time of a whole cycle, see PerfStats::CycleDone
+
+    NUM_PERF_STAGES
+};
+
+// Histogram of durations with 4 bins per doubling, exact below 4 us and up
+// to about 70 minutes. Add() only does relaxed atomic increments, so any
+// thread may record while another reads; a reader racing with Clear() may see
+// a partly cleared histogram, which only costs one slice of the rolling
+// window a few samples.
+struct PerfHistogram
+{
+    enum { SUB_BINS = 4, NUM_BINS = SUB_BINS + 30 * SUB_BINS };
+
+    std::atomic<unsigned int> bins[NUM_BINS];
+    std::atomic<unsigned int> count;
+    std::atomic<unsigned int> maxUs;
+    std::atomic<long long> totalUs;
+
+    void Clear();
+    void Add(long long us);
+
+    static int BinIndex(unsigned int us);
+    static double BinUpperUs(int bin);
+};
+
+struct PerfSummary
+{
+    unsigned int count;
+    double meanMs;
+    double p50Ms;               // percentiles are the upper edge of the bin holding them
+    double p95Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+// Counts of the session histograms at some moment, so that what was recorded
+// after it (e.g. during one guiding run) can be summarized on its own
+struct PerfMark
+{
+    unsigned int bins[NUM_PERF_STAGES][PerfHistogram::NUM_BINS];
+    unsigned int count[NUM_PERF_STAGES];
+    long long totalUs[NUM_PERF_STAGES];
+    unsigned int cycles;
+    unsigned int slowCycles;
+};
+
+// Per-stage latency histograms for the whole session and for a rolling
+// window of the last few minutes, plus the count of slow guide cycles. A
+// cycle is slow when the time spent outside the exposure itself (download,
+// calibration, star finding and the guide state update) is more than a set
+// fraction of the exposure, i.e. when the processing is eating into the
+// cadence.
+//
+// Memory is fixed: the window is WINDOW_SLICES histograms, each covering
+// 1/WINDOW_SLICES of it, reused in turn.
+class PerfStats
+{
+public:
+    enum { WINDOW_SLICES = 10 };
+
+    static void Init();         // load the window length and slow cycle threshold
+    static void Add(PerfStage stage, long long us);
+
+    // the worker thread finished a capture: start and end of the part of
+    // HandleExpose that is not waiting for the time lapse or cadence
+    static void CaptureDone(long long startUs, long long endUs, int exposureMs);
+    // the guider has finished with the image from the last capture
+    static void CycleDone(long long guideStateUs);
+
+    static void GetSession(PerfStage stage, PerfSummary *summary);
+    static void GetWindow(PerfStage stage, PerfSummary *summary);
+    static void ResetSession();
+
+    static void Mark(PerfMark *mark);
+    // summary of what the session histograms recorded since the mark; the
+    // maximum is the upper edge of the highest bin used, as the exact value is
+    // only kept for the whole session
+    static void GetSince(const PerfMark& mark, PerfStage stage, PerfSummary *summary);
+
+    static unsigned int SlowCycles();
+    static unsigned int Cycles();
+    static int WindowMinutes();
+    static double SlowCycleFraction();
+
+    static const char *StageName(PerfStage stage);     // short name for reports
+    static const char *TraceName(PerfStage stage);     // span name in trace files
+};
+
+// Heap allocation counts by subsystem, compiled in only with
+// PHD_COUNT_ALLOCATIONS (the PHD2_COUNT_ALLOCATIONS CMake option), which
+// replaces the global operator new. An allocation is charged to the innermost
+// PERF_STAGE (or ALLOC_TAG) active on the allocating thread, or to
+// ALLOC_TAG_OTHER. The aim is a guide cycle that allocates nothing once it has
+// reached its steady state.
+enum AllocTag
+{
+    // tags below NUM_PERF_STAGES are the stages of the guide cycle
+    ALLOC_TAG_DEBUG_LOG = NUM_PERF_STAGES,
+    ALLOC_TAG_OTHER,
+
+    NUM_ALLOC_TAGS
+};
+
+struct AllocCounts
+{
+    long long total;
+    long long tag[NUM_ALLOC_TAGS];
+};
+
+class AllocTrack
+{
+public:
+    static bool IsEnabled();    // true when the counting is compiled in
+    static void GetCounts(AllocCounts *counts);     // since the process started
+    // allocations between the last two guide cycles (PerfStats::CycleDone)
+    static void GetLastCycle(AllocCounts *counts);
+    static void CycleDone();
+
+    // make tag current on this thread; returns the tag it replaces
+    static int EnterTag(int tag);
+    static void LeaveTag(int prev);
+
+    static const char *TagName(int tag);
+};
+
+class AllocTagScope
+{
+    int m_prev;
+
+public:
+    AllocTagScope(int tag) : m_prev(AllocTrack::EnterTag(tag)) { }
+    ~AllocTagScope() { AllocTrack::LeaveTag(m_prev); }
+};
+
+#ifdef PHD_COUNT_ALLOCATIONS
+# define ALLOC_TAG(tag) AllocTagScope PERF_SCOPE_CAT(_allocTag, __LINE__)(tag)
+#else
+# define ALLOC_TAG(tag)
+#endif
+
+class PerfStageScope
+{
+    PerfStage m_stage;
+    bool m_trace;
+    long long m_start;
+#ifdef PHD_COUNT_ALLOCATIONS
+    int m_allocPrev;
+#endif
+
+public:
+    PerfStageScope(PerfStage stage)
+        : m_stage(stage), m_trace(PerfTrace::IsEnabled()), m_start(PerfTrace::Now())
+    {
+#ifdef PHD_COUNT_ALLOCATIONS
+        m_allocPrev = AllocTrack::EnterTag(stage);
+#endif
+        if (m_trace)
+            PerfTrace::Begin(PerfStats::TraceName(stage));
+    }
+    ~PerfStageScope()
+    {
+#ifdef PHD_COUNT_ALLOCATIONS
+        AllocTrack::LeaveTag(m_allocPrev);
+#endif
+        long long end = PerfTrace::Now();
+        PerfStats::Add(m_stage, end - m_start);
+        if (m_trace)
+            PerfTrace::Record(PerfStats::TraceName(m_stage), m_start, end);
+    }
+    long long ElapsedUs() const { return PerfTrace::Now() - m_start; }
+};
+
+#define PERF_STAGE(stage) PerfStageScope PERF_SCOPE_CAT(_perfStage, __LINE__)(stage)
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ *  periodic_error_model.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+#include "periodic_error_model.h"
+
+static const double kPi = 3.14159265358979323846;
+
+// covariance of a parameter about which nothing is known yet, px^2
+static const double InitialCovariance = 1e4;
+
+PeriodicErrorModel::PeriodicErrorModel()
+{
+    Init(0.0, 1, 1.0);
+}
+
+void PeriodicErrorModel::Init(double period, int harmonics, double memory)
+{
+    m_harmonics = wxMax(1, wxMin(harmonics, (int) MAX_HARMONICS));
+    m_nparams = 2 + 2 * m_harmonics;
+    m_period = period;
+    m_memory = memory;
+    m_t0 = m_tLast = 0.0;
+    m_samples = 0;
+
+    for (int i = 0; i < MAX_PARAMS; i++)
+    {
+        m_theta[i] = 0.0;
+        for (int j = 0; j < MAX_PARAMS; j++)
+            m_P[i][j] = i == j ? InitialCovariance : 0.0;
+    }
+}
+
+void PeriodicErrorModel::Basis(double t, double *phi) const
+{
+    // the drift is in units of one period so that all the terms are of
+    // similar size
+    double const tau = (t - m_t0) / m_period;
+    phi[0] = 1.0;
+    phi[1] = tau;
+
+    // sin/cos of the harmonics by the angle addition recurrence
+    double const w = 2.0 * kPi * tau;
+    double const c1 = cos(w), s1 = sin(w);
+    double c = c1, s = s1;
+    for (int h = 0; h < m_harmonics; h++)
+    {
+        phi[2 + 2 * h] = c;
+        phi[3 + 2 * h] = s;
+        double const cn = c * c1 - s * s1;
+        s = s * c1 + c * s1;
+        c = cn;
+    }
+}
+
+void PeriodicErrorModel::Add(double t, double g)
+{
+    if (m_period <= 0.0)
+        return;
+
+    if (m_samples == 0)
+        m_t0 = t;
+
+    double const lambda = m_samples ? exp(-(t - m_tLast) / m_memory) : 1.0;
+    m_tLast = t;
+    ++m_samples;
+
+    int const n = m_nparams;
+    double phi[MAX_PARAMS];
+    Basis(t, phi);
+
+    double Pphi[MAX_PARAMS];
+    double denom = lambda;
+    double err = g;
+    for (int i = 0; i < n; i++)
+    {
+        double s = 0.0;
+        for (int j = 0; j < n; j++)
+            s += m_P[i][j] * phi[j];
+        Pphi[i] = s;
+        denom += phi[i] * s;
+        err -= m_theta[i] * phi[i];
+    }
+
+    for (int i = 0; i < n; i++)
+        m_theta[i] += Pphi[i] * err / denom;
+
+    // P = (P - P phi phi' P / denom) / lambda, kept symmetric. Every term of
+    // the basis keeps varying, so P cannot wind up
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = i; j < n; j++)
+        {
+            double v = (m_P[i][j] - Pphi[i] * Pphi[j] / denom) / lambda;
+            m_P[i][j] = m_P[j][i] = v;
+        }
+    }
+}
+
+bool PeriodicErrorModel::IsValid() const
+{
+    return m_period > 0.0 && m_samples > 2 * m_nparams && Span() >= m_period;
+}
+
+double PeriodicErrorModel::Periodic(double t) const
+{
+    double phi[MAX_PARAMS];
+    Basis(t, phi);
+    double v = 0.0;
+    for (int i = 2; i < m_nparams; i++)
+        v += m_theta[i] * phi[i];
+    return v;
+}
+
+double PeriodicErrorModel::Predict(double t) const
+{
+    double phi[MAX_PARAMS];
+    Basis(t, phi);
+    double v = 0.0;
+    for (int i = 0; i < m_nparams; i++)
+        v += m_theta[i] * phi[i];
+    return v;
+}
+
+// a scan samples the periodogram at this many points per 1/span, so that a
+// peak cannot fall between them
+static const int ScanOversampling = 4;
+static const int MaxScanPoints = 400;
+
+// how far the peak must stand out from the mean power
+static const double MinPeakStrength = 8.0;
+
+PeriodEstimator::PeriodEstimator(size_t capacity, double minSpacing, double minPeriod, double maxPeriod)
+    : m_head(0),
+    m_capacity(capacity),
+    m_minSpacing(minSpacing),
+    m_minPeriod(minPeriod),
+    m_maxPeriod(maxPeriod)
+{
+    m_samples.reserve(capacity);
+    Clear();
+}
+
+void PeriodEstimator::Clear()
+{
+    m_samples.clear();
+    m_head = 0;
+    m_scanNext = m_scanCount = 0;
+    m_period = 0.0;
+    m_strength = 0.0;
+}
+
+const PeriodEstimator::Sample& PeriodEstimator::At(size_t i) const
+{
+    return m_samples[(m_head + i) % m_samples.size()];
+}
+
+void PeriodEstimator::Get(size_t i, double *t, double *g) const
+{
+    const Sample& s = At(i);
+    *t = s.t;
+    *g = s.g;
+}
+
+void PeriodEstimator::Add(double t, double g)
+{
+    if (!m_samples.empty() && t - At(m_samples.size() - 1).t < m_minSpacing)
+        return;
+
+    Sample s = { t, g };
+    if (m_samples.size() < m_capacity)
+        m_samples.push_back(s);
+    else
+    {
+        m_samples[m_head] = s;
+        m_head = (m_head + 1) % m_capacity;
+    }
+}
+
+void PeriodEstimator::StartScan()
+{
+    m_scanNext = m_scanCount = 0;
+
+    size_t const n = m_samples.size();
+    if (n < 16)
+        return;
+
+    double const span = At(n - 1).t - At(0).t;
+    double const maxPeriod = wxMin(m_maxPeriod, span / 2.0);
+    if (maxPeriod <= m_minPeriod)
+        return;
+
+    // the least-squares line through the samples is taken out first, the
+    // drift would swamp the low frequencies
+    m_trendT0 = At(0).t;
+    double st = 0.0, sg = 0.0, stt = 0.0, stg = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const Sample& s = At(i);
+        double const t = s.t - m_trendT0;
+        st += t;
+        sg += s.g;
+        stt += t * t;
+        stg += t * s.g;
+    }
+    double const det = n * stt - st * st;
+    m_trendB = det > 0.0 ? (n * stg - st * sg) / det : 0.0;
+    m_trendA = (sg - m_trendB * st) / n;
+
+    double const f0 = 1.0 / maxPeriod;
+    double const f1 = 1.0 / m_minPeriod;
+    double df = 1.0 / (ScanOversampling * span);
+    int count = (int) ceil((f1 - f0) / df) + 1;
+    if (count > MaxScanPoints)
+    {
+        count = MaxScanPoints;
+        df = (f1 - f0) / (count - 1);
+    }
+
+    m_scanF0 = f0;
+    m_scanDf = df;
+    m_scanCount = count;
+    m_power.assign(count, 0.0);
+}
+
+double PeriodEstimator::Power(double f) const
+{
+    double sc = 0.0, ss = 0.0;
+    double const w = 2.0 * kPi * f;
+    for (size_t i = 0; i < m_samples.size(); i++)
+    {
+        const Sample& s = At(i);
+        double const t = s.t - m_trendT0;
+        double const y = s.g - (m_trendA + m_trendB * t);
+        sc += y * cos(w * t);
+        ss += y * sin(w * t);
+    }
+    return (sc * sc + ss * ss) / m_samples.size();
+}
+
+void PeriodEstimator::FinishScan()
+{
+    int best = 0;
+    double sum = 0.0;
+    for (int i = 0; i < m_scanCount; i++)
+    {
+        sum += m_power[i];
+        if (m_power[i] > m_power[best])
+            best = i;
+    }
+    double const mean = sum / m_scanCount;
+
+    m_scanNext = m_scanCount = 0;
+
+    // a peak at the end of the range is probably the edge of something outside it
+    if (best == 0 || best == (int) m_power.size() - 1 || mean <= 0.0)
+        return;
+
+    double const strength = m_power[best] / mean;
+    if (strength < MinPeakStrength)
+        return;
+
+    // parabolic interpolation between the neighbouring frequencies
+    double const p0 = m_power[best - 1], p1 = m_power[best], p2 = m_power[best + 1];
+    double const d = p0 - 2.0 * p1 + p2;
+    double const offset = d < 0.0 ? 0.5 * (p0 - p2) / d : 0.0;
+    double const f = m_scanF0 + (best + offset) * m_scanDf;
+
+    m_period = 1.0 / f;
+    m_strength = strength;
+}
+
+bool PeriodEstimator::Step()
+{
+    if (m_scanCount == 0)
+    {
+        StartScan();
+        return false;
+    }
+
+    m_power[m_scanNext] = Power(m_scanF0 + m_scanNext * m_scanDf);
+    if (++m_scanNext < m_scanCount)
+        return false;
+
+    double const prev = m_period;
+    FinishScan();
+    return m_period != prev;
+}
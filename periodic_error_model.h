@@ -0,0 +1,137 @@
+/*
+ *  periodic_error_model.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PERIODIC_ERROR_MODEL_INCLUDED
+#define PERIODIC_ERROR_MODEL_INCLUDED
+
+#include <vector>
+
+// The uncorrected RA position of the star, modelled as drift plus the
+// harmonics of the worm period:
+//
+//   g(t) = a + b t + sum over h of (c_h cos(h w t) + s_h sin(h w t))
+//
+// and fitted by recursive least squares with exponential forgetting, so
+// the cost of each sample is fixed.
+class PeriodicErrorModel
+{
+public:
+    enum { MAX_HARMONICS = 5, MAX_PARAMS = 2 + 2 * MAX_HARMONICS };
+
+private:
+    int m_harmonics;
+    int m_nparams;
+    double m_period;            // seconds, 0 = no model
+    double m_memory;            // seconds, time constant of the forgetting
+    double m_t0;                // time of the first sample
+    double m_tLast;
+    int m_samples;
+    double m_theta[MAX_PARAMS];
+    double m_P[MAX_PARAMS][MAX_PARAMS];
+
+    void Basis(double t, double *phi) const;
+
+public:
+    PeriodicErrorModel();
+
+    void Init(double period, int harmonics, double memory);
+    void Add(double t, double g);
+
+    double Period() const { return m_period; }
+    double Span() const { return m_samples ? m_tLast - m_t0 : 0.0; }
+    int Samples() const { return m_samples; }
+
+    // true once the model has seen a full period
+    bool IsValid() const;
+
+    // the periodic part of the model, without the drift, and the whole model
+    double Periodic(double t) const;
+    double Predict(double t) const;
+};
+
+// Estimates the worm period from the latest samples with a periodogram. The
+// scan evaluates one trial frequency per Step(), so its cost is spread over
+// many guide steps.
+class PeriodEstimator
+{
+    struct Sample
+    {
+        double t;
+        double g;
+    };
+
+    std::vector<Sample> m_samples;      // ring, m_head is the oldest once full
+    size_t m_head;
+    size_t m_capacity;
+    double m_minSpacing;
+    double m_minPeriod;
+    double m_maxPeriod;
+
+    // the scan in progress
+    int m_scanNext;
+    int m_scanCount;
+    double m_scanF0;
+    double m_scanDf;
+    double m_trendA;
+    double m_trendB;
+    double m_trendT0;
+    std::vector<double> m_power;
+
+    double m_period;
+    double m_strength;
+
+    const Sample& At(size_t i) const;
+    void StartScan();
+    double Power(double f) const;
+    void FinishScan();
+
+public:
+    PeriodEstimator(size_t capacity, double minSpacing, double minPeriod, double maxPeriod);
+
+    void Clear();
+    void Add(double t, double g);
+
+    // advances the scan; returns true when it has finished with a new estimate
+    bool Step();
+
+    // seconds, 0 until a clear peak has been found
+    double Period() const { return m_period; }
+    // the peak power relative to the mean over the scan
+    double Strength() const { return m_strength; }
+
+    size_t Count() const { return m_samples.size(); }
+    // the samples, oldest first
+    void Get(size_t i, double *t, double *g) const;
+};
+
+#endif
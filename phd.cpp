@@ -33,8 +33,12 @@
  */
 
 #include "phd.h"
+#include "guiding_assistant.h"
+#include "guidelog_analyzer.h"
+#include "gpu_compute.h"
 
 #include <wx/cmdline.h>
+#include <wx/filename.h>
 #include <wx/snglinst.h>
 
 #ifdef  __linux__
@@ -62,6 +66,39 @@ static const wxCmdLineEntryDesc cmdLineDesc[] =
 {
     { wxCMD_LINE_OPTION, "i", "instanceNumber", "sets the PHD2 instance number (default = 1)", wxCMD_LINE_VAL_NUMBER, wxCMD_LINE_PARAM_OPTIONAL},
     { wxCMD_LINE_SWITCH, "R", "Reset", "Reset all PHD2 settings to default values"},
+    { wxCMD_LINE_OPTION, "b", "backtest", "replay a guide log through the guide algorithm settings in the -g grid file, "
+      "write the results to <log>_backtest.csv and exit", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "g", "grid", "guide algorithm settings to backtest, see backtest.h", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "c", "convert", "convert a binary guide log to the text format, write it to <log>_converted.txt and exit",
+      wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "a", "analyze", "run the Guiding Assistant analysis over the sessions in a guide log, or in every guide log "
+      "in a directory, write the results to <log>_analysis.csv or <dir>/PHD2_GuideLogAnalysis.csv and exit",
+      wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "m", "benchmark", "time the image processing and star finding steps on synthetic frames and the --benchdata "
+      "frames, write the results to the given CSV file and exit", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "benchdata", "a FITS file or a directory of FITS files for --benchmark", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "algobench", "time every guide algorithm guiding long synthetic error sequences and the --algolog "
+      "guide log, write the results to the given CSV file and exit", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "algolog", "a guide log to replay for --algobench", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "algobudget", "per-call budget for --algobench, percent of the exposure (default 1)",
+      wxCMD_LINE_VAL_DOUBLE, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "corpus", "check the vector and parallel image kernels against the scalar reference on the frames in "
+      "the given corpus directory, see corpus.h, and exit", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_SWITCH, "", "corpusrecord", "with --corpus, write the reference results as the expected results" },
+    { wxCMD_LINE_OPTION, "", "track", "measure the star in every FITS frame in the given directory, write the results to --trackout "
+      "and exit, see star_track.h", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "trackout", "a .csv or .bin file for --track (default <dir>/PHD2_StarTrack.csv)", wxCMD_LINE_VAL_STRING,
+      wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "trackdark", "a dark frame to subtract from the --track frames", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_SWITCH, "", "trackdefects", "with --track, remove the profile's defect map from the frames" },
+    { wxCMD_LINE_OPTION, "", "tracksearch", "star search region for --track, pixels (default 15)", wxCMD_LINE_VAL_NUMBER,
+      wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "guidebench", "run headless with the simulator, calibrate and guide as fast as possible, write the guide "
+      "loop timings to the given CSV file and exit", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_OPTION, "", "benchspec", "settings for --guidebench, see guide_bench.h", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL },
+    { wxCMD_LINE_SWITCH, "", "capturenode", "run headless and serve the profile's camera to the PHD2 Capture Node camera of another "
+      "PHD2 instance, see capture_node.h" },
+    { wxCMD_LINE_SWITCH, "H", "headless", "run without showing any windows, for control over the event server only"},
     { wxCMD_LINE_NONE }
 };
 
@@ -90,6 +127,10 @@ static void DisableOSXAppNap(void)
 PhdApp::PhdApp(void)
 {
     m_resetConfig = false;
+    m_headless = false;
+    m_captureNode = false;
+    m_corpusRecord = false;
+    m_algoBenchBudget = 1.0;
     m_instanceNumber = 1;
 #ifdef  __linux__
     XInitThreads();
@@ -130,6 +171,9 @@ bool PhdApp::OnInit()
 
     Debug.Init("debug", true);
 
+    // write out any queued debug log lines if we crash
+    wxHandleFatalExceptions();
+
     Debug.AddLine(wxString::Format("PHD2 version %s begins execution with:", FULLVER));
     Debug.AddLine(wxString::Format("   %s", wxVERSION_STRING));
     float dummy;
@@ -137,6 +181,7 @@ bool PhdApp::OnInit()
 #if defined(CV_VERSION)
     Debug.AddLine(wxString::Format("   opencv %s", CV_VERSION));
 #endif
+    SelectImageKernels(pConfig->Global.GetString("/ImageKernels", "auto"));
 
 #if defined(__WINDOWS__)
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
@@ -150,6 +195,12 @@ bool PhdApp::OnInit()
         pConfig->DeleteAll();
     }
 
+    PerfStats::Init();
+    Telemetry.Init();
+    ThreadPriority::Init();
+    PowerSaver::Init();
+    LoadShedder::Init();
+
     wxString ldir = wxStandardPaths::Get().GetResourcesDir() + PATHSEPSTR "locale";
     if (!wxDirExists(ldir))
     {
@@ -168,24 +219,225 @@ bool PhdApp::OnInit()
     }
     wxSetlocale(LC_NUMERIC, "C");
 
+    pConfig->InitializeProfile();
+
+    if (!m_convertLog.empty())
+    {
+        wxFileName fn(m_convertLog);
+        fn.SetName(fn.GetName() + "_converted");
+        fn.SetExt("txt");
+
+        wxString err;
+        if (GuideLogBinaryReader::ConvertToText(m_convertLog, fn.GetFullPath(), &err))
+            wxMessageOutput::Get()->Printf("Conversion failed: %s", err);
+        else
+            wxMessageOutput::Get()->Printf("Guide log written to %s", fn.GetFullPath());
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_analyzePath.empty())
+    {
+        wxString outFile;
+        if (wxDirExists(m_analyzePath))
+            outFile = m_analyzePath + PATHSEPSTR + "PHD2_GuideLogAnalysis.csv";
+        else
+        {
+            wxFileName fn(m_analyzePath);
+            if (fn.GetExt().CmpNoCase("gz") == 0)
+                fn.ClearExt();
+            fn.SetName(fn.GetName() + "_analysis");
+            fn.SetExt("csv");
+            outFile = fn.GetFullPath();
+        }
+
+        wxString err;
+        if (GuideLogAnalyzer::Run(m_analyzePath, outFile, &err))
+            wxMessageOutput::Get()->Printf("Analysis failed: %s", err);
+        else
+            wxMessageOutput::Get()->Printf("Analysis written to %s", outFile);
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_backtestLog.empty())
+    {
+        wxFileName fn(m_backtestLog);
+        fn.SetName(fn.GetName() + "_backtest");
+        fn.SetExt("csv");
+
+        wxString err;
+        if (Backtest::Run(m_backtestLog, m_backtestGrid, fn.GetFullPath(), &err))
+            wxMessageOutput::Get()->Printf("Backtest failed: %s", err);
+        else
+            wxMessageOutput::Get()->Printf("Backtest results written to %s", fn.GetFullPath());
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_benchmarkFile.empty())
+    {
+        wxString err;
+        if (Benchmark::Run(m_benchmarkData, m_benchmarkFile, &err))
+            wxMessageOutput::Get()->Printf("Benchmark failed: %s", err);
+        else
+            wxMessageOutput::Get()->Printf("Benchmark results written to %s", m_benchmarkFile);
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_algoBenchFile.empty())
+    {
+        wxString err;
+        int overBudget;
+        if (Benchmark::RunGuideAlgorithms(m_algoBenchLog, m_algoBenchBudget, m_algoBenchFile, &overBudget, &err))
+            wxMessageOutput::Get()->Printf("Guide algorithm benchmark failed: %s", err);
+        else if (overBudget)
+            wxMessageOutput::Get()->Printf("Guide algorithm benchmark: %d runs OVER BUDGET, see %s", overBudget, m_algoBenchFile);
+        else
+            wxMessageOutput::Get()->Printf("Guide algorithm benchmark: all within budget, results written to %s", m_algoBenchFile);
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_corpusDir.empty())
+    {
+        wxString err;
+        int failures;
+        if (Corpus::Run(m_corpusDir, m_corpusRecord, &failures, &err))
+            wxMessageOutput::Get()->Printf("Corpus check failed: %s", err);
+        else if (failures)
+            wxMessageOutput::Get()->Printf("Corpus check: %d checks FAILED, see the debug log", failures);
+        else
+            wxMessageOutput::Get()->Printf("Corpus check: all checks passed");
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    if (!m_track.dir.empty())
+    {
+        wxString err;
+        int frames, found;
+        if (StarTrack::Run(m_track, &frames, &found, &err))
+            wxMessageOutput::Get()->Printf("Star track failed: %s", err);
+        else
+            wxMessageOutput::Get()->Printf("Star track: star found in %d of %d frames", found, frames);
+
+        // OnExit() won't be called since we return false
+        delete pConfig;
+        pConfig = NULL;
+        delete m_instanceChecker;
+        m_instanceChecker = 0;
+        Debug.Shutdown();
+        return false;
+    }
+
+    // log folder housekeeping runs in the background
     Debug.RemoveOldFiles();
     GuideLog.RemoveOldFiles();
-
-    pConfig->InitializeProfile();
+    int maxLogMB = pConfig->Global.GetInt("/logs/max_total_mb", 0);
+    if (maxLogMB > 0)
+    {
+        wxArrayString patterns;
+        patterns.Add("PHD2_DebugLog*");
+        patterns.Add("PHD2_GuideLog*");
+        patterns.Add("PHD_GuideStar*");
+        wxArrayString exclude;
+        exclude.Add(Debug.GetLogFileName());
+        LogMaint.LimitSize(Debug.GetLogDir(), patterns, maxLogMB, exclude);
+    }
 
     PhdController::OnAppInit();
 
     wxImage::AddHandler(new wxJPEGHandler);
     wxImage::AddHandler(new wxPNGHandler);
 
+    // headless mode can also be set in the profile so a sequencer can start
+    // PHD2 without knowing about the command line switch
+    if (!m_headless)
+        m_headless = pConfig->Profile.GetBoolean("/Headless", false);
+    if (m_headless)
+        Debug.AddLine("Running headless, the main window will not be shown");
+
     pFrame = new MyFrame(m_instanceNumber, &m_locale);
 
+    if (!m_guideBenchFile.empty())
+    {
+        wxString err;
+        if (GuideBench::Start(m_guideBenchSpec, m_guideBenchFile, &err))
+        {
+            wxMessageOutput::Get()->Printf("Guide loop benchmark failed: %s", err);
+            wxCloseEvent *evt = new wxCloseEvent(wxEVT_CLOSE_WINDOW);
+            evt->SetCanVeto(false);
+            wxQueueEvent(pFrame, evt);
+        }
+    }
+
+    if (m_captureNode)
+    {
+        wxString err;
+        if (CaptureNode::Start(m_instanceNumber, &err))
+        {
+            wxMessageOutput::Get()->Printf("Capture node failed: %s", err);
+            wxCloseEvent *evt = new wxCloseEvent(wxEVT_CLOSE_WINDOW);
+            evt->SetCanVeto(false);
+            wxQueueEvent(pFrame, evt);
+        }
+        else
+            wxMessageOutput::Get()->Printf("Capture node serving %s on port %u", pCamera->Name, CaptureNode::Port());
+    }
+
+    // with nothing shown the servers are the only way to drive PHD2, MyFrame
+    // starts them regardless of the server mode setting
+    if (m_headless)
+        return true;
+
     pFrame->Show(true);
 
     if (pConfig->IsNewInstance() || (pConfig->NumProfiles() == 1 && pFrame->pGearDialog->IsEmptyProfile()))
     {
         pFrame->pGearDialog->ShowProfileWizard();               // First-light version of profile wizard
     }
+    else
+    {
+        SessionSnapshot::OfferResume();
+    }
 
     return true;
 }
@@ -198,15 +450,32 @@ int PhdApp::OnExit(void)
 
     PhdController::OnAppExit();
 
+    ImageRelease::Finish();
+    ImageBufferPool::Clear();
+
+#if defined(PHD_OPENCL)
+    GpuCompute::Destroy();
+#endif
+
+    LogMaint.Shutdown();
+
     delete pConfig;
     pConfig = NULL;
 
     delete m_instanceChecker; // OnExit() won't be called if we return false
     m_instanceChecker = 0;
 
+    Debug.Shutdown();
+
     return wxApp::OnExit();
 }
 
+void PhdApp::OnFatalException(void)
+{
+    GuideLog.EmergencyFlush();
+    Debug.EmergencyFlush();
+}
+
 void PhdApp::OnInitCmdLine(wxCmdLineParser& parser)
 {
     parser.SetDesc(cmdLineDesc);
@@ -220,6 +489,37 @@ bool PhdApp::OnCmdLineParsed(wxCmdLineParser& parser)
     (void)parser.Found("i", &m_instanceNumber);
 
     m_resetConfig = parser.Found("R");
+    m_headless = parser.Found("H");
+
+    (void)parser.Found("c", &m_convertLog);
+    (void)parser.Found("a", &m_analyzePath);
+    (void)parser.Found("m", &m_benchmarkFile);
+    (void)parser.Found("benchdata", &m_benchmarkData);
+    (void)parser.Found("algobench", &m_algoBenchFile);
+    (void)parser.Found("algolog", &m_algoBenchLog);
+    (void)parser.Found("algobudget", &m_algoBenchBudget);
+    (void)parser.Found("corpus", &m_corpusDir);
+    m_corpusRecord = parser.Found("corpusrecord");
+    (void)parser.Found("track", &m_track.dir);
+    (void)parser.Found("trackout", &m_track.outFile);
+    (void)parser.Found("trackdark", &m_track.darkFile);
+    m_track.defects = parser.Found("trackdefects");
+    long search;
+    if (parser.Found("tracksearch", &search))
+        m_track.searchRegion = (int) wxMax(search, 5L);
+    (void)parser.Found("guidebench", &m_guideBenchFile);
+    (void)parser.Found("benchspec", &m_guideBenchSpec);
+    if (!m_guideBenchFile.empty())
+        m_headless = true;
+    m_captureNode = parser.Found("capturenode");
+    if (m_captureNode)
+        m_headless = true;
+
+    if (parser.Found("b", &m_backtestLog) && !parser.Found("g", &m_backtestGrid))
+    {
+        wxMessageOutput::Get()->Printf("--backtest needs a --grid file");
+        bReturn = false;
+    }
 
     return bReturn;
 }
@@ -36,6 +36,7 @@
 #define PHD_H_INCLUDED
 
 #include <wx/wx.h>
+#include <wx/atomic.h>
 #include <wx/aui/aui.h>
 #include <wx/bitmap.h>
 #include <wx/bmpbuttn.h>
@@ -66,6 +67,7 @@
 #include <map>
 #include <math.h>
 #include <stdarg.h>
+#include <vector>
 
 #define APPNAME _T("PHD2 Guiding")
 #define PHDVERSION _T("2.6.2")
@@ -146,16 +148,24 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "configdialog.h"
 #include "optionsbutton.h"
 #include "usImage.h"
+#include "fitsiowrap.h"
+#include "fits_writer.h"
 #include "point.h"
 #include "star.h"
+#include "star_cutout.h"
 #include "circbuf.h"
+#include "sliding_max.h"
+#include "sliding_median.h"
+#include "guidelog_binary.h"
 #include "guidinglog.h"
+#include "guide_telemetry.h"
 #include "graph.h"
 #include "statswindow.h"
 #include "star_profile.h"
 #include "target.h"
 #include "graph-stepguider.h"
 #include "guide_algorithms.h"
+#include "guider_painter.h"
 #include "guiders.h"
 #include "messagebox_proxy.h"
 #include "serialports.h"
@@ -164,21 +174,56 @@ WX_DEFINE_ARRAY_DOUBLE(double, ArrayOfDbl);
 #include "cameras.h"
 #include "camera.h"
 #include "mount.h"
+#include "calibration_fit.h"
+#include "calibration_store.h"
 #include "scopes.h"
+#include "pointing_cache.h"
 #include "stepguiders.h"
+#include "concurrent_calibration.h"
 #include "rotators.h"
+#include "image_kernels.h"
 #include "image_math.h"
+#include "dark_model.h"
 #include "testguide.h"
 #include "advanced_dialog.h"
+#include "device_lists.h"
 #include "gear_dialog.h"
+#include "auto_exposure.h"
 #include "myframe.h"
 #include "debuglog.h"
+#include "log_maintenance.h"
 #include "worker_thread.h"
+#include "guide_metrics.h"
+#include "perf_trace.h"
+#include "thread_priority.h"
+#include "power_saver.h"
+#include "load_shedder.h"
+#include "defect_learner.h"
+#include "websocket.h"
 #include "event_server.h"
+#include "guiding_perf.h"
+#include "polar_drift.h"
+#include "frame_codec.h"
+#include "image_stream.h"
+#include "telemetry_multicast.h"
+#include "step_fanout.h"
+#include "frame_export.h"
+#include "star_image_log.h"
 #include "confirm_dialog.h"
 #include "phdcontrol.h"
+#include "session_snapshot.h"
 #include "runinbg.h"
-#include "fitsiowrap.h"
+#include "darklib_cache.h"
+#include "dark_builder.h"
+#include "camera_test.h"
+#include "pulse_profile.h"
+#include "ao_fast_loop.h"
+#include "capture_node.h"
+#include "backtest.h"
+#include "benchmark.h"
+#include "corpus.h"
+#include "star_track.h"
+#include "guide_bench.h"
 
 class wxSingleInstanceChecker;
 
@@ -206,6 +251,22 @@ class PhdApp : public wxApp
     wxSingleInstanceChecker *m_instanceChecker;
     long m_instanceNumber;
     bool m_resetConfig;
+    bool m_headless;
+    wxString m_backtestLog;
+    wxString m_backtestGrid;
+    wxString m_convertLog;
+    wxString m_analyzePath;
+    wxString m_benchmarkFile;
+    wxString m_benchmarkData;
+    wxString m_algoBenchFile;
+    wxString m_algoBenchLog;
+    double m_algoBenchBudget;
+    wxString m_corpusDir;
+    bool m_corpusRecord;
+    StarTrackOptions m_track;
+    wxString m_guideBenchFile;
+    wxString m_guideBenchSpec;
+    bool m_captureNode;
     wxString m_localeDir;
 
 protected:
@@ -217,10 +278,12 @@ public:
     PhdApp(void);
     bool OnInit(void);
     int OnExit(void);
+    void OnFatalException(void);
     void OnInitCmdLine(wxCmdLineParser& parser);
     bool OnCmdLineParsed(wxCmdLineParser & parser);
     virtual bool Yield(bool onlyIfNeeded=false);
     wxString GetLocaleDir() const { return m_localeDir; }
+    bool IsHeadless() const { return m_headless; }
 };
 
 wxDECLARE_APP(PhdApp);
@@ -45,8 +45,413 @@ wxString PhdConfig::DefaultProfileName = wxTRANSLATE("My Equipment");
 
 #define PROFILE_STREAM_VERSION "1"
 
+// I thought wxConfigPathChanger would do this, but it didn't quite
+struct AutoConfigPath
+{
+    wxConfigBase *m_cfg;
+    wxString m_savePath;
+
+    AutoConfigPath(wxConfigBase *cfg, const wxString& path)
+        : m_cfg(cfg)
+    {
+        m_savePath = cfg->GetPath();
+        cfg->SetPath(path);
+    }
+    ~AutoConfigPath()
+    {
+        m_cfg->SetPath(m_savePath);
+    }
+};
+
+/*
+ * The whole configuration is read from wxConfig in one pass when it is
+ * opened and kept in memory, so reading a setting does not go to the
+ * registry or the config file. Changes are made to the in-memory copy at
+ * once and queued, and a background thread writes the queued changes to
+ * wxConfig every few seconds. Anything that uses the wxConfig directly
+ * holds a ConfigSync, which writes out the queued changes first and keeps
+ * the background thread out.
+ */
+
+struct ConfigValue
+{
+    wxConfigBase::EntryType type;   // Type_String, Type_Integer or Type_Float
+    wxString s;
+    long l;
+    double d;
+};
+
+struct ConfigOp
+{
+    enum Kind { WRITE, DELETE_ENTRY, DELETE_GROUP };
+
+    Kind kind;
+    wxString path;
+    ConfigValue val;
+};
+
+class ConfigWriterThread;
+
+class ConfigCache
+{
+    wxConfig *m_config;
+    wxCriticalSection m_lock;                   // protects m_values and m_pending
+    std::map<wxString, ConfigValue> m_values;   // by MapKey of the full path
+    std::vector<ConfigOp> m_pending;            // changes not yet written to m_config, in order
+    ConfigWriterThread *m_writer;
+
+    void LoadGroup(const wxString& group);
+    static wxString MapKey(const wxString& path);
+
+public:
+    wxCriticalSection ConfigLock;               // held while m_config is used
+
+    ConfigCache(wxConfig *config);
+    ~ConfigCache(void);
+
+    static wxString Key(const wxString& path);
+
+    // ConfigLock must be held for these
+    void Load(void);
+    void Apply(void);
+    void Clear(void);
+
+    bool Find(const wxString& path, ConfigValue *val);
+    bool HasEntry(const wxString& path);
+    void Write(const wxString& path, const ConfigValue& val);
+    void Delete(const wxString& path, bool group);
+};
+
+class ConfigWriterThread : public wxThread
+{
+    ConfigCache *m_cache;
+    wxMutex m_mutex;
+    wxCondition m_cond;
+    bool m_stop;
+
+public:
+    enum { WRITE_INTERVAL_MS = 2000 };
+
+    ConfigWriterThread(ConfigCache *cache)
+        : wxThread(wxTHREAD_JOINABLE), m_cache(cache), m_cond(m_mutex), m_stop(false) { }
+
+    void Stop(void)
+    {
+        {
+            wxMutexLocker lck(m_mutex);
+            m_stop = true;
+            m_cond.Signal();
+        }
+        Wait();
+    }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("config writer");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "config writer");
+
+        wxMutexLocker lck(m_mutex);
+        while (!m_stop)
+        {
+            m_cond.WaitTimeout(WRITE_INTERVAL_MS);
+            wxCriticalSectionLocker cfg(m_cache->ConfigLock);
+            m_cache->Apply();
+        }
+        return 0;
+    }
+};
+
+// Hold while using the wxConfig directly
+class ConfigSync
+{
+    ConfigCache *m_cache;
+
+public:
+    ConfigSync(ConfigCache *cache) : m_cache(cache)
+    {
+        if (m_cache)
+        {
+            m_cache->ConfigLock.Enter();
+            m_cache->Apply();
+        }
+    }
+    ~ConfigSync()
+    {
+        if (m_cache)
+            m_cache->ConfigLock.Leave();
+    }
+};
+
+ConfigCache::ConfigCache(wxConfig *config)
+    : m_config(config), m_writer(0)
+{
+    {
+        wxCriticalSectionLocker cfg(ConfigLock);
+        Load();
+    }
+
+    ConfigWriterThread *writer = new ConfigWriterThread(this);
+    if (writer->Create() != wxTHREAD_NO_ERROR || writer->Run() != wxTHREAD_NO_ERROR)
+    {
+        // changes will be written by the next ConfigSync and on exit
+        delete writer;
+        writer = 0;
+    }
+    m_writer = writer;
+}
+
+ConfigCache::~ConfigCache(void)
+{
+    if (m_writer)
+    {
+        m_writer->Stop();
+        delete m_writer;
+    }
+
+    wxCriticalSectionLocker cfg(ConfigLock);
+    Apply();
+}
+
+wxString ConfigCache::Key(const wxString& path)
+{
+    // names are relative to the root, which is where the wxConfig path stays
+    return path.StartsWith("/") ? path : "/" + path;
+}
+
+wxString ConfigCache::MapKey(const wxString& path)
+{
+#if defined(__WINDOWS__)
+    // the registry and wxFileConfig on Windows ignore case in names
+    return path.Lower();
+#else
+    return path;
+#endif
+}
+
+void ConfigCache::LoadGroup(const wxString& group)
+{
+    wxString str;
+    long cookie;
+
+    std::vector<wxString> groups;
+    std::vector<wxString> entries;
+
+    {
+        AutoConfigPath changer(m_config, group.IsEmpty() ? wxString("/") : group);
+
+        bool more = m_config->GetFirstGroup(str, cookie);
+        while (more)
+        {
+            groups.push_back(str);
+            more = m_config->GetNextGroup(str, cookie);
+        }
+
+        more = m_config->GetFirstEntry(str, cookie);
+        while (more)
+        {
+            entries.push_back(str);
+            more = m_config->GetNextEntry(str, cookie);
+        }
+    }
+
+    for (std::vector<wxString>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        wxString path = group + "/" + *it;
+        ConfigValue val;
+        val.l = 0;
+        val.d = 0.0;
+
+        switch (m_config->GetEntryType(path)) {
+        case wxConfigBase::Type_Boolean:
+        case wxConfigBase::Type_Integer:
+            val.type = wxConfigBase::Type_Integer;
+            m_config->Read(path, &val.l);
+            break;
+        case wxConfigBase::Type_Float:
+            val.type = wxConfigBase::Type_Float;
+            m_config->Read(path, &val.d);
+            break;
+        default:
+            val.type = wxConfigBase::Type_String;
+            m_config->Read(path, &val.s);
+            break;
+        }
+
+        m_values[MapKey(path)] = val;
+    }
+
+    for (std::vector<wxString>::const_iterator it = groups.begin(); it != groups.end(); ++it)
+        LoadGroup(group + "/" + *it);
+}
+
+void ConfigCache::Load(void)
+{
+    wxStopWatch swatch;
+
+    wxCriticalSectionLocker lck(m_lock);
+    m_values.clear();
+    LoadGroup(wxEmptyString);
+
+    Debug.Write(wxString::Format("Config: loaded %u entries in %ld ms\n", (unsigned int) m_values.size(), swatch.Time()));
+}
+
+void ConfigCache::Clear(void)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    m_values.clear();
+    m_pending.clear();
+}
+
+void ConfigCache::Apply(void)
+{
+    std::vector<ConfigOp> ops;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        ops.swap(m_pending);
+    }
+
+    if (ops.empty())
+        return;
+
+    for (std::vector<ConfigOp>::const_iterator it = ops.begin(); it != ops.end(); ++it)
+    {
+        switch (it->kind) {
+        case ConfigOp::WRITE:
+            switch (it->val.type) {
+            case wxConfigBase::Type_Integer:
+                m_config->Write(it->path, it->val.l);
+                break;
+            case wxConfigBase::Type_Float:
+                m_config->Write(it->path, it->val.d);
+                break;
+            default:
+                m_config->Write(it->path, it->val.s);
+                break;
+            }
+            break;
+        case ConfigOp::DELETE_ENTRY:
+            m_config->DeleteEntry(it->path);
+            break;
+        case ConfigOp::DELETE_GROUP:
+            m_config->DeleteGroup(it->path);
+            break;
+        }
+    }
+
+    m_config->Flush();
+
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "Config: wrote %u changes\n", (unsigned int) ops.size());
+}
+
+bool ConfigCache::Find(const wxString& path, ConfigValue *val)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    std::map<wxString, ConfigValue>::const_iterator it = m_values.find(MapKey(path));
+    if (it == m_values.end())
+        return false;
+    *val = it->second;
+    val->s = it->second.s.Clone();     // the value may be used on another thread
+    return true;
+}
+
+bool ConfigCache::HasEntry(const wxString& path)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    return m_values.find(MapKey(path)) != m_values.end();
+}
+
+void ConfigCache::Write(const wxString& path, const ConfigValue& val)
+{
+    wxCriticalSectionLocker lck(m_lock);
+
+    wxString key = MapKey(path);
+    ConfigValue& v = m_values[key];
+    v = val;
+    v.s = val.s.Clone();
+
+    // a queued write of the same setting, not followed by a delete, is replaced
+    for (std::vector<ConfigOp>::reverse_iterator it = m_pending.rbegin(); it != m_pending.rend(); ++it)
+    {
+        if (it->kind != ConfigOp::WRITE)
+            break;
+        if (MapKey(it->path) == key)
+        {
+            it->val = v;
+            return;
+        }
+    }
+
+    ConfigOp op;
+    op.kind = ConfigOp::WRITE;
+    op.path = path.Clone();
+    op.val = v;
+    m_pending.push_back(op);
+}
+
+void ConfigCache::Delete(const wxString& path, bool group)
+{
+    wxCriticalSectionLocker lck(m_lock);
+
+    if (group)
+    {
+        wxString prefix = MapKey(path) + "/";
+        std::map<wxString, ConfigValue>::iterator it = m_values.lower_bound(prefix);
+        while (it != m_values.end() && it->first.StartsWith(prefix))
+            m_values.erase(it++);
+    }
+    else
+        m_values.erase(MapKey(path));
+
+    ConfigOp op;
+    op.kind = group ? ConfigOp::DELETE_GROUP : ConfigOp::DELETE_ENTRY;
+    op.path = path.Clone();
+    op.val.type = wxConfigBase::Type_Unknown;
+    m_pending.push_back(op);
+}
+
+// conversions between the stored types, as wxConfig reads them
+
+static bool ValueToLong(const ConfigValue& val, long *l)
+{
+    switch (val.type) {
+    case wxConfigBase::Type_Integer:
+        *l = val.l;
+        return true;
+    case wxConfigBase::Type_Float:
+        return false;
+    default:
+        return val.s.ToLong(l);
+    }
+}
+
+static bool ValueToDouble(const ConfigValue& val, double *d)
+{
+    switch (val.type) {
+    case wxConfigBase::Type_Integer:
+        *d = (double) val.l;
+        return true;
+    case wxConfigBase::Type_Float:
+        *d = val.d;
+        return true;
+    default:
+        return val.s.ToCDouble(d) || val.s.ToDouble(d);
+    }
+}
+
+static wxString ValueToString(const ConfigValue& val)
+{
+    switch (val.type) {
+    case wxConfigBase::Type_Integer:
+        return wxString::Format("%ld", val.l);
+    case wxConfigBase::Type_Float:
+        return wxString::FromCDouble(val.d);
+    default:
+        return val.s;
+    }
+}
+
 ConfigSection::ConfigSection(void)
-    : m_pConfig(NULL)
+    : m_pConfig(NULL), m_cache(NULL)
 {
 }
 
@@ -62,14 +467,14 @@ void ConfigSection::SelectProfile(int profileId)
 bool ConfigSection::GetBoolean(const wxString& name, bool defaultValue)
 {
     bool bReturn = defaultValue;
-    wxString path = m_prefix + name;
+    wxString path = ConfigCache::Key(m_prefix + name);
 
-    if (m_pConfig)
-    {
-        m_pConfig->Read(path, &bReturn, defaultValue);
-    }
+    ConfigValue val;
+    long l;
+    if (m_cache && m_cache->Find(path, &val) && ValueToLong(val, &l))
+        bReturn = l != 0;
 
-    Debug.AddLine(wxString::Format("GetBoolean(\"%s\", %d) returns %d", path, defaultValue, bReturn));
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "GetBoolean(\"%s\", %d) returns %d\n", path, defaultValue, bReturn);
 
     return bReturn;
 }
@@ -77,14 +482,13 @@ bool ConfigSection::GetBoolean(const wxString& name, bool defaultValue)
 wxString ConfigSection::GetString(const wxString& name, const wxString& defaultValue)
 {
     wxString sReturn = defaultValue;
-    wxString path = m_prefix + name;
+    wxString path = ConfigCache::Key(m_prefix + name);
 
-    if (m_pConfig)
-    {
-        m_pConfig->Read(path, &sReturn, defaultValue);
-    }
+    ConfigValue val;
+    if (m_cache && m_cache->Find(path, &val))
+        sReturn = ValueToString(val);
 
-    Debug.AddLine(wxString::Format("GetString(\"%s\", \"%s\") returns \"%s\"", path, defaultValue, sReturn));
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "GetString(\"%s\", \"%s\") returns \"%s\"\n", path, defaultValue, sReturn);
 
     return sReturn;
 }
@@ -92,14 +496,14 @@ wxString ConfigSection::GetString(const wxString& name, const wxString& defaultV
 double ConfigSection::GetDouble(const wxString& name, double defaultValue)
 {
     double dReturn = defaultValue;
-    wxString path = m_prefix + name;
+    wxString path = ConfigCache::Key(m_prefix + name);
 
-    if (m_pConfig)
-    {
-        m_pConfig->Read(path, &dReturn, defaultValue);
-    }
+    ConfigValue val;
+    double d;
+    if (m_cache && m_cache->Find(path, &val) && ValueToDouble(val, &d))
+        dReturn = d;
 
-    Debug.AddLine(wxString::Format("GetDouble(\"%s\", %lf) returns %lf", path, defaultValue, dReturn));
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "GetDouble(\"%s\", %lf) returns %lf\n", path, defaultValue, dReturn);
 
     return dReturn;
 }
@@ -107,14 +511,14 @@ double ConfigSection::GetDouble(const wxString& name, double defaultValue)
 long ConfigSection::GetLong(const wxString& name, long defaultValue)
 {
     long lReturn = defaultValue;
-    wxString path = m_prefix + name;
+    wxString path = ConfigCache::Key(m_prefix + name);
 
-    if (m_pConfig)
-    {
-        m_pConfig->Read(path, &lReturn, defaultValue);
-    }
+    ConfigValue val;
+    long l;
+    if (m_cache && m_cache->Find(path, &val) && ValueToLong(val, &l))
+        lReturn = l;
 
-    Debug.AddLine(wxString::Format("GetLong(\"%s\", %ld) returns %ld", path, defaultValue, lReturn));
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "GetLong(\"%s\", %ld) returns %ld\n", path, defaultValue, lReturn);
 
     return lReturn;
 }
@@ -122,47 +526,57 @@ long ConfigSection::GetLong(const wxString& name, long defaultValue)
 int ConfigSection::GetInt(const wxString& name, int defaultValue)
 {
     long lReturn = defaultValue;
-    wxString path = m_prefix + name;
+    wxString path = ConfigCache::Key(m_prefix + name);
 
-    if (m_pConfig)
-    {
-        m_pConfig->Read(path, &lReturn, defaultValue);
-    }
+    ConfigValue val;
+    long l;
+    if (m_cache && m_cache->Find(path, &val) && ValueToLong(val, &l))
+        lReturn = l;
 
-    Debug.AddLine(wxString::Format("GetInt(\"%s\", %d) returns %d", path, defaultValue, (int)lReturn));
+    DEBUG_LOG(DBGLOG_CONFIG, DBGLOG_VERBOSE, "GetInt(\"%s\", %d) returns %d\n", path, defaultValue, (int)lReturn);
 
     return (int)lReturn;
 }
 
 void ConfigSection::SetBoolean(const wxString& name, bool value)
 {
-    if (m_pConfig)
-    {
-        m_pConfig->Write(m_prefix + name, value);
-    }
+    SetLong(name, value ? 1 : 0);
 }
 
 void ConfigSection::SetString(const wxString& name, const wxString& value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + name, value);
+        ConfigValue val;
+        val.type = wxConfigBase::Type_String;
+        val.s = value;
+        val.l = 0;
+        val.d = 0.0;
+        m_cache->Write(ConfigCache::Key(m_prefix + name), val);
     }
 }
 
 void ConfigSection::SetDouble(const wxString& name, double value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + name, value);
+        ConfigValue val;
+        val.type = wxConfigBase::Type_Float;
+        val.l = 0;
+        val.d = value;
+        m_cache->Write(ConfigCache::Key(m_prefix + name), val);
     }
 }
 
 void ConfigSection::SetLong(const wxString& name, long value)
 {
-    if (m_pConfig)
+    if (m_cache)
     {
-        m_pConfig->Write(m_prefix + name, value);
+        ConfigValue val;
+        val.type = wxConfigBase::Type_Integer;
+        val.l = value;
+        val.d = 0.0;
+        m_cache->Write(ConfigCache::Key(m_prefix + name), val);
     }
 }
 
@@ -173,53 +587,40 @@ void ConfigSection::SetInt(const wxString& name, int value)
 
 bool ConfigSection::HasEntry(const wxString& name) const
 {
-    return m_pConfig && m_pConfig->HasEntry(m_prefix + name);
+    return m_cache && m_cache->HasEntry(ConfigCache::Key(m_prefix + name));
 }
 
 void ConfigSection::DeleteEntry(const wxString& name)
 {
-    m_pConfig->DeleteEntry(m_prefix + name);
+    m_cache->Delete(ConfigCache::Key(m_prefix + name), false);
 }
 
 void ConfigSection::DeleteGroup(const wxString& name)
 {
-    m_pConfig->DeleteGroup(m_prefix + name);
+    m_cache->Delete(ConfigCache::Key(m_prefix + name), true);
 }
 
 PhdConfig::PhdConfig(void)
+    : m_cache(NULL)
 {
 }
 
 PhdConfig::PhdConfig(const wxString& baseConfigName, int instance)
+    : m_cache(NULL)
 {
     Initialize(baseConfigName, instance);
 }
 
 PhdConfig::~PhdConfig(void)
 {
+    // writes out any queued changes
+    delete m_cache;
     delete Global.m_pConfig;
 }
 
-// I thought wxConfigPathChanger would do this, but it didn't quite
-struct AutoConfigPath
-{
-    wxConfigBase *m_cfg;
-    wxString m_savePath;
-
-    AutoConfigPath(wxConfigBase *cfg, const wxString& path)
-        : m_cfg(cfg)
-    {
-        m_savePath = cfg->GetPath();
-        cfg->SetPath(path);
-    }
-    ~AutoConfigPath()
-    {
-        m_cfg->SetPath(m_savePath);
-    }
-};
-
 int PhdConfig::FirstProfile(void)
 {
+    ConfigSync sync(m_cache);
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     long id = 0;
@@ -251,6 +652,9 @@ void PhdConfig::Initialize(const wxString& baseConfigName, int instance)
     wxConfig *config = new wxConfig(configName);
     Global.m_pConfig = Profile.m_pConfig = config;
 
+    m_cache = new ConfigCache(config);
+    Global.m_cache = Profile.m_cache = m_cache;
+
     m_isNewInstance = false;
 
     m_configVersion = Global.GetLong("ConfigVersion", 0);
@@ -290,7 +694,11 @@ void PhdConfig::DeleteAll(void)
         for (unsigned int i = 0; i < NumProfiles(); i++)
             pFrame->DeleteDarkLibraryFiles(i);
 
-        Global.m_pConfig->DeleteAll();
+        {
+            ConfigSync sync(m_cache);
+            Global.m_pConfig->DeleteAll();
+            m_cache->Clear();
+        }
         InitializeProfile();
     }
     m_isNewInstance = true;
@@ -327,6 +735,7 @@ bool PhdConfig::SetCurrentProfile(const wxString& name)
 
 int PhdConfig::GetProfileId(const wxString& name)
 {
+    ConfigSync sync(m_cache);
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     int ret = 0;
@@ -376,13 +785,16 @@ bool PhdConfig::CreateProfile(const wxString& name)
         return true;
     }
 
-    AutoConfigPath changer(Profile.m_pConfig, "/profile");
+    {
+        ConfigSync sync(m_cache);
+        AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
-    // find the first available id
-    for (id = 1; Profile.m_pConfig->HasGroup(wxString::Format("%d", id)); id++)
-        ;
+        // find the first available id
+        for (id = 1; Profile.m_pConfig->HasGroup(wxString::Format("%d", id)); id++)
+            ;
+    }
 
-    Profile.m_pConfig->Write(wxString::Format("/profile/%d/name", id), name);
+    Global.SetString(wxString::Format("/profile/%d/name", id), name);
 
     return false;
 }
@@ -468,7 +880,11 @@ bool PhdConfig::CloneProfile(const wxString& dest, const wxString& source)
     {
         return true; // ??? should never happen
     }
-    CopyGroup(Global.m_pConfig, wxString::Format("/profile/%d", srcId), wxString::Format("/profile/%d", dstId));
+    {
+        ConfigSync sync(m_cache);
+        CopyGroup(Global.m_pConfig, wxString::Format("/profile/%d", srcId), wxString::Format("/profile/%d", dstId));
+        m_cache->Load();
+    }
     // name was overwritten by copy
     Global.SetString(wxString::Format("/profile/%d/name", dstId), dest);
 
@@ -483,7 +899,7 @@ void PhdConfig::DeleteProfile(const wxString& name)
     if (id <= 0)
         return;
 
-    Global.m_pConfig->DeleteGroup(wxString::Format("/profile/%d", id));
+    Global.DeleteGroup(wxString::Format("/profile/%d", id));
 
     if (NumProfiles() == 0)
     {
@@ -512,7 +928,7 @@ bool PhdConfig::RenameProfile(const wxString& oldname, const wxString& newname)
         return true;
     }
 
-    Profile.m_pConfig->Write(wxString::Format("/profile/%d/name", id), newname);
+    Global.SetString(wxString::Format("/profile/%d/name", id), newname);
     return false;
 }
 
@@ -542,7 +958,7 @@ bool PhdConfig::ReadProfile(const wxString& filename)
     int id = GetProfileId(profileName);
     if (id > 0)
     {
-        Global.m_pConfig->DeleteGroup(wxString::Format("/profile/%d", id));
+        Global.DeleteGroup(wxString::Format("/profile/%d", id));
     }
 
     CreateProfile(profileName);
@@ -686,6 +1102,7 @@ bool PhdConfig::WriteProfile(const wxString& filename)
 
     tos.WriteString("PHD Profile " PROFILE_STREAM_VERSION "\n");
     wxString profile = wxString::Format("/profile/%d", m_currentProfileId);
+    ConfigSync sync(m_cache);
     WriteGroup(tos, Profile.m_pConfig, profile, profile);
 
     return false;
@@ -693,6 +1110,7 @@ bool PhdConfig::WriteProfile(const wxString& filename)
 
 wxArrayString PhdConfig::ProfileNames(void)
 {
+    ConfigSync sync(m_cache);
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     wxArrayString ary;
@@ -717,6 +1135,7 @@ wxArrayString PhdConfig::ProfileNames(void)
 
 unsigned int PhdConfig::NumProfiles(void)
 {
+    ConfigSync sync(m_cache);
     AutoConfigPath changer(Profile.m_pConfig, "/profile");
 
     unsigned int count = 0;
@@ -63,13 +63,18 @@
  * the configuration values for thier classes, and dialogs that modify them
  * write the values immediately.
  *
+ * The values are held in memory once the config is opened, so reads are
+ * cheap; changes are written back to wxConfig in the background.
+ *
  */
 
 class PhdConfig;
+class ConfigCache;
 
 class ConfigSection
 {
     wxConfig *m_pConfig;
+    ConfigCache *m_cache;
     wxString m_prefix;
 
     friend class PhdConfig;
@@ -105,6 +110,7 @@ class PhdConfig
     long m_configVersion;
     bool m_isNewInstance;
     int m_currentProfileId;
+    ConfigCache *m_cache;
 
     void Initialize(const wxString& baseConfigName, int instance);
 
@@ -34,6 +34,8 @@
 
 #include "phd.h"
 
+#include <algorithm>
+
 enum State
 {
     STATE_IDLE = 0,
@@ -49,6 +51,12 @@ enum State
     STATE_FINISH,
 };
 
+struct SettleSample
+{
+    double t;   // seconds since settling began
+    double dist;
+};
+
 enum SettleOp
 {
     OP_DITHER,
@@ -69,6 +77,11 @@ struct ControllerState
     wxStopWatch *settleTimeout;
     wxStopWatch *settleInRange;
     int settleFrameCount;
+    int settleInRangeFrames;
+    std::vector<SettleSample> settleSamples;
+    PHD_Point resumeStar;           // where to look for the star before AutoFind, for Resume
+    PHD_Point resumeLock;
+    bool resumeSticky;              // lock position made sticky until guiding starts, saveSticky to restore
     bool succeeded;
     wxString errorMsg;
 };
@@ -117,8 +130,40 @@ bool PhdController::Guide(bool recalibrate, const SettleParams& settle, wxString
     return true;
 }
 
+bool PhdController::Resume(const PHD_Point& starPos, const PHD_Point& lockPos, const SettleParams& settle, wxString *error)
+{
+    if (ctrl.state != STATE_IDLE)
+    {
+        Debug.Write(wxString::Format("PhdController::Resume reentrancy state = %d op = %d\n", ctrl.state, ctrl.settleOp));
+        *error = ReentrancyError("guide");
+        return false;
+    }
+
+    Debug.AddLine(wxString::Format("PhdController::Resume begins, star (%.2f, %.2f) lock (%.2f, %.2f)",
+                                   starPos.X, starPos.Y, lockPos.X, lockPos.Y));
+    ctrl.forceCalibration = false;
+    ctrl.settleOp = OP_GUIDE;
+    ctrl.settle = settle;
+    ctrl.resumeStar = starPos;
+    ctrl.resumeLock = lockPos;
+    SETSTATE(STATE_SETUP);
+    UpdateControllerState();
+    return true;
+}
+
+static void end_resume(void)
+{
+    ctrl.resumeStar.Invalidate();
+    if (ctrl.resumeSticky)
+    {
+        pFrame->pGuider->SetLockPosIsSticky(ctrl.saveSticky);
+        ctrl.resumeSticky = false;
+    }
+}
+
 static void do_fail(const wxString& msg)
 {
+    end_resume();
     Debug.AddLine(wxString::Format("PhdController failed: %s", msg));
     ctrl.succeeded = false;
     ctrl.errorMsg = msg;
@@ -160,6 +205,7 @@ bool PhdController::Dither(double pixels, bool raOnly, int settleFrames, wxStrin
     settle.settleTimeSec = 9999;
     settle.timeoutSec = 9999;
     settle.frames = settleFrames;
+    settle.predictive = false;
 
     return Dither(pixels, raOnly, settle, errMsg);
 }
@@ -189,6 +235,73 @@ static bool all_gear_connected(void)
         (!pSecondaryMount || pSecondaryMount->IsConnected());
 }
 
+// Predictive settling: after a dither the distance decays roughly
+// exponentially toward the seeing floor. Fit ln(distance) against time from
+// the peak distance onward, and extrapolate to time t along with a one-sided
+// 95% upper confidence bound.
+static bool predict_settle(const std::vector<SettleSample>& samples, double t, SettleEstimate *est)
+{
+    enum { MIN_SAMPLES = 4 };
+    static const double MIN_DIST = 0.05; // keep the log finite, pixels
+
+    est->valid = false;
+
+    if (samples.size() < MIN_SAMPLES)
+        return false;
+
+    size_t peak = 0;
+    for (size_t i = 1; i < samples.size(); i++)
+        if (samples[i].dist >= samples[peak].dist)
+            peak = i;
+
+    size_t n = samples.size() - peak;
+    if (n < MIN_SAMPLES)
+        return false;
+
+    double sx = 0., sy = 0.;
+    for (size_t i = peak; i < samples.size(); i++)
+    {
+        sx += samples[i].t;
+        sy += log(std::max(samples[i].dist, MIN_DIST));
+    }
+    double xm = sx / n;
+    double ym = sy / n;
+
+    double sxx = 0., sxy = 0.;
+    for (size_t i = peak; i < samples.size(); i++)
+    {
+        double dx = samples[i].t - xm;
+        sxx += dx * dx;
+        sxy += dx * (log(std::max(samples[i].dist, MIN_DIST)) - ym);
+    }
+    if (sxx <= 0.)
+        return false;
+
+    double b = sxy / sxx;
+    double a = ym - b * xm;
+
+    double ss = 0.;
+    for (size_t i = peak; i < samples.size(); i++)
+    {
+        double r = log(std::max(samples[i].dist, MIN_DIST)) - (a + b * samples[i].t);
+        ss += r * r;
+    }
+    size_t df = n - 2;
+    double se = sqrt(ss / df * (1. / n + (t - xm) * (t - xm) / sxx));
+
+    // one-sided 95% Student t quantiles
+    static const double T95[] = { 0., 6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812 };
+    double tq = df < WXSIZEOF(T95) ? T95[df] : 1.645 + 1.7 / df;
+
+    double y = a + b * t;
+    est->valid = true;
+    est->distance = exp(y);
+    est->upperBound = exp(y + tq * se);
+    est->timeConstant = b < 0. ? -1. / b : 0.;
+
+    return true;
+}
+
 static void do_notify(void)
 {
     if (ctrl.succeeded)
@@ -204,6 +317,8 @@ static void do_notify(void)
         GuideLog.NotifySettlingStateChange("Settling failed");
     }
 
+    pFrame->EndDitherRecovery();
+
     if (pMount)
         pMount->NotifyGuidingDitherSettleDone(ctrl.succeeded);
 }
@@ -258,6 +373,7 @@ void PhdController::UpdateControllerState(void)
         case STATE_SETUP:
             Debug.AddLine("PhdController: setup");
             ctrl.haveSaveSticky = false;
+            ctrl.resumeSticky = false;
             ctrl.autoFindAttemptsRemaining = 3;
             SETSTATE(STATE_ATTEMPT_START);
             break;
@@ -317,6 +433,29 @@ void PhdController::UpdateControllerState(void)
         }
 
         case STATE_SELECT_STAR: {
+            if (ctrl.resumeStar.IsValid())
+            {
+                // the star is most likely still where it was, no need for AutoFind
+                PHD_Point star = ctrl.resumeStar;
+                ctrl.resumeStar.Invalidate();
+                const usImage *img = pFrame->pGuider->CurrentImage();
+                if (img && img->ImageData && !pFrame->pGuider->SetLockPosToStarAtPosition(star) &&
+                    !pFrame->pGuider->SetLockPosition(ctrl.resumeLock))
+                {
+                    Debug.Write(wxString::Format("PhdController: resumed on the star at (%.2f, %.2f)\n",
+                                                 pFrame->pGuider->CurrentPosition().X, pFrame->pGuider->CurrentPosition().Y));
+                    // the lock position must survive the start of guiding
+                    ctrl.saveSticky = pFrame->pGuider->LockPosIsSticky();
+                    ctrl.resumeSticky = true;
+                    pFrame->pGuider->SetLockPosIsSticky(true);
+                    SETSTATE(STATE_WAIT_SELECTED);
+                    ctrl.waitSelectedRemaining = 3;
+                    done = true;
+                    break;
+                }
+                Debug.Write("PhdController: no star at the resume position, auto-selecting\n");
+            }
+
             bool error = pFrame->pGuider->AutoSelect();
             if (error)
             {
@@ -418,6 +557,8 @@ void PhdController::UpdateControllerState(void)
         case STATE_SETTLE_BEGIN:
             ctrl.settlePriorFrameInRange = false;
             ctrl.settleFrameCount = 0;
+            ctrl.settleInRangeFrames = 0;
+            ctrl.settleSamples.clear();
             ctrl.settleTimeout->Start();
             SETSTATE(STATE_SETTLE_WAIT);
             GuideLog.NotifySettlingStateChange("Settling started");
@@ -430,9 +571,15 @@ void PhdController::UpdateControllerState(void)
             bool inRange = lockedOnStar && currentError <= ctrl.settle.tolerancePx;
             bool aoBumpInProgress = IsAoBumpInProgress();
             long timeInRange = 0;
+            double elapsed = (double) ctrl.settleTimeout->Time() / 1000.;
+            SettleEstimate est;
+            est.valid = false;
 
             ++ctrl.settleFrameCount;
 
+            if (ctrl.resumeSticky && pFrame->pGuider->IsGuiding())
+                end_resume();
+
             Debug.Write(wxString::Format("PhdController: settling, locked = %d, distance = %.2f (%.2f) aobump = %d frame = %d / %d\n",
                                          lockedOnStar, currentError, ctrl.settle.tolerancePx, aoBumpInProgress, ctrl.settleFrameCount,
                                          ctrl.settle.frames));
@@ -444,8 +591,17 @@ void PhdController::UpdateControllerState(void)
                 break;
             }
 
+            if (lockedOnStar)
+            {
+                SettleSample s;
+                s.t = elapsed;
+                s.dist = currentError;
+                ctrl.settleSamples.push_back(s);
+            }
+
             if (inRange)
             {
+                ++ctrl.settleInRangeFrames;
                 if (!ctrl.settlePriorFrameInRange)
                 {
                     // first frame
@@ -456,6 +612,7 @@ void PhdController::UpdateControllerState(void)
                         break;
                     }
                     ctrl.settleInRange->Start();
+                    ctrl.settleInRangeFrames = 1;
                 }
                 else if (((timeInRange = ctrl.settleInRange->Time()) / 1000) >= ctrl.settle.settleTimeSec && !aoBumpInProgress)
                 {
@@ -463,19 +620,39 @@ void PhdController::UpdateControllerState(void)
                     SETSTATE(STATE_FINISH);
                     break;
                 }
+                else if (ctrl.settle.predictive)
+                {
+                    // predict the distance at the time the settle window would end
+                    enum { MIN_IN_RANGE_FRAMES = 3 };
+                    double windowEnd = elapsed + ctrl.settle.settleTimeSec - (double) timeInRange / 1000.;
+                    if (predict_settle(ctrl.settleSamples, windowEnd, &est))
+                    {
+                        Debug.Write(wxString::Format("PhdController: settle prediction %.2f (< %.2f) tau = %.1f\n",
+                                                     est.distance, est.upperBound, est.timeConstant));
+                        if (ctrl.settleInRangeFrames >= MIN_IN_RANGE_FRAMES && !aoBumpInProgress &&
+                            est.timeConstant > 0. && est.upperBound <= ctrl.settle.tolerancePx)
+                        {
+                            Debug.Write(wxString::Format("PhdController: settled early after %.1fs in range\n", (double) timeInRange / 1000.));
+                            ctrl.succeeded = true;
+                            SETSTATE(STATE_FINISH);
+                            break;
+                        }
+                    }
+                }
             }
             if ((ctrl.settleTimeout->Time() / 1000) >= ctrl.settle.timeoutSec)
             {
                 do_fail(_T("timed-out waiting for guider to settle"));
                 break;
             }
-            EvtServer.NotifySettling(currentError, (double) timeInRange / 1000., ctrl.settle.settleTimeSec);
+            EvtServer.NotifySettling(currentError, (double) timeInRange / 1000., ctrl.settle.settleTimeSec, est.valid ? &est : 0);
             ctrl.settlePriorFrameInRange = inRange;
             done = true;
             break;
         }
 
         case STATE_FINISH:
+            end_resume();
             do_notify();
             SETSTATE(STATE_IDLE);
             done = true;
@@ -41,6 +41,17 @@ struct SettleParams
     int settleTimeSec;   // time to be within tolerance
     int timeoutSec;      // timeout value
     int frames;          // number of frames
+    bool predictive;     // allow an early exit when the error decay predicts settling
+};
+
+// fit of the distance decay since the start of settling, used for
+// predictive settling
+struct SettleEstimate
+{
+    bool valid;          // enough samples for a fit
+    double distance;     // predicted distance at the end of the settle window, pixels
+    double upperBound;   // one-sided 95% upper bound on that distance, pixels
+    double timeConstant; // decay time constant, seconds, 0 if not decaying
 };
 
 class PhdController
@@ -49,6 +60,9 @@ public:
 
     static bool CanGuide(wxString *error);
     static bool Guide(bool recalibrate, const SettleParams& settle, wxString *error);
+    // Guide, for a warm restart: look for the star at starPos before falling
+    // back to auto-selecting one, and keep lockPos as the lock position
+    static bool Resume(const PHD_Point& starPos, const PHD_Point& lockPos, const SettleParams& settle, wxString *error);
     static bool Dither(double pixels, bool raOnly, const SettleParams& settle, wxString *error);
     static bool Dither(double pixels, bool raOnly, int settleFrames, wxString *error);
     static bool DitherCompat(double pixels, bool raOnly, wxString *error);
@@ -219,16 +219,73 @@ class ShiftPoint : public PHD_Point
     double m_y0;    // initial y position
     wxLongLong_t m_t0;      // initial time (seconds)
 
+    // A rate that varies with time: rates at UTC times in ms, interpolated
+    // linearly, the end rates holding outside the table. The shift is
+    // integrated on from the last update, so each update only looks at the
+    // table segments passed since then.
+    std::vector<wxLongLong_t> m_tableTimes;
+    std::vector<PHD_Point> m_tableRates;
+    size_t m_tableIndex;    // segment holding m_tlast
+    wxLongLong_t m_tlast;
+    double m_sx;            // shift integrated up to m_tlast
+    double m_sy;
+
+    PHD_Point TableRate(wxLongLong_t t) const
+    {
+        size_t const i = m_tableIndex;
+        if (t <= m_tableTimes[0] || i + 1 >= m_tableTimes.size())
+            return t <= m_tableTimes[0] ? m_tableRates[0] : m_tableRates[i];
+        double const f = (double)(t - m_tableTimes[i]) / (double)(m_tableTimes[i + 1] - m_tableTimes[i]);
+        return m_tableRates[i] + (m_tableRates[i + 1] - m_tableRates[i]) * f;
+    }
+
+    void IntegrateTable(wxLongLong_t t1)
+    {
+        size_t const n = m_tableTimes.size();
+        wxLongLong_t t = m_tlast;
+        while (t < t1)
+        {
+            while (m_tableIndex + 1 < n && m_tableTimes[m_tableIndex + 1] <= t)
+                ++m_tableIndex;
+            wxLongLong_t end = t1;
+            if (t < m_tableTimes[0])
+                end = wxMin(end, m_tableTimes[0]);
+            else if (m_tableIndex + 1 < n)
+                end = wxMin(end, m_tableTimes[m_tableIndex + 1]);
+            // the rate is linear between breaks so the trapezoid is exact
+            PHD_Point const r = (TableRate(t) + TableRate(end)) * 0.5;
+            double const dt = (double)(end - t) / 1000.;
+            m_sx += r.X * dt;
+            m_sy += r.Y * dt;
+            t = end;
+        }
+        m_tlast = t1;
+        m_rate = TableRate(t1);
+    }
+
 public:
 
     ShiftPoint() { }
 
     void SetShiftRate(double xrate, double yrate)
     {
+        m_tableTimes.clear();
+        m_tableRates.clear();
         m_rate.SetXY(xrate, yrate);
         BeginShift();
     }
 
+    // times are UTC in ms, increasing, rates per second
+    void SetShiftTable(const std::vector<wxLongLong_t>& times, const std::vector<PHD_Point>& rates)
+    {
+        m_tableTimes = times;
+        m_tableRates = rates;
+        m_rate = rates[0];
+        BeginShift();
+    }
+
+    bool HasShiftTable(void) const { return !m_tableTimes.empty(); }
+
     void BeginShift()
     {
         if (IsValid())
@@ -236,19 +293,32 @@ public:
             m_x0 = X;
             m_y0 = Y;
             m_t0 = ::wxGetUTCTimeMillis().GetValue();
+            m_tlast = m_t0;
+            m_tableIndex = 0;
+            m_sx = m_sy = 0.;
         }
     }
 
     void DisableShift()
     {
         m_rate.Invalidate();
+        m_tableTimes.clear();
+        m_tableRates.clear();
     }
 
     void UpdateShift()
     {
         if (IsValid() && m_rate.IsValid())
         {
-            double dt = (double)(::wxGetUTCTimeMillis().GetValue() - m_t0) / 1000.;
+            wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+            if (HasShiftTable())
+            {
+                IntegrateTable(now);
+                X = m_x0 + m_sx;
+                Y = m_y0 + m_sy;
+                return;
+            }
+            double dt = (double)(now - m_t0) / 1000.;
             X = m_x0 + m_rate.X * dt;
             Y = m_y0 + m_rate.Y * dt;
         }
@@ -0,0 +1,281 @@
+/*
+ *  pointing_cache.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+enum { DefaultPollIntervalMs = 2000, MinPollIntervalMs = 250 };
+
+class PointingPoller : public wxThread
+{
+    Scope *m_scope;
+
+public:
+    PointingPoller(Scope *scope) : wxThread(wxTHREAD_JOINABLE), m_scope(scope) { }
+    Scope *GetScope() const { return m_scope; }
+    ExitCode Entry();
+};
+
+struct PointingCacheImpl
+{
+    wxMutex lock;
+    wxCondition cond;           // wakes the poller for a read or to stop, and readers waiting for a read
+    PointingPoller *thread;
+    bool stop;
+    bool refresh;
+    unsigned int reads;
+    MountPointing info;
+    int intervalMs;
+
+    PointingCacheImpl() : cond(lock), thread(0), stop(false), refresh(false), reads(0), intervalMs(DefaultPollIntervalMs)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        info.coordsValid = false;
+        info.ra = info.dec = info.lst = 0.0;
+        info.declination = UNKNOWN_DECLINATION;
+        info.pierSide = PIER_SIDE_UNKNOWN;
+        info.slewing = false;
+        info.timestamp = 0;
+    }
+};
+
+static PointingCacheImpl& s_cache = *new PointingCacheImpl();
+
+static void ReadPointing(Scope *scope, MountPointing *info)
+{
+    double ra, dec, lst;
+    info->coordsValid = !scope->GetCoordinates(&ra, &dec, &lst);
+    if (info->coordsValid)
+    {
+        info->ra = ra;
+        info->dec = dec;
+        info->lst = lst;
+    }
+    info->declination = scope->GetDeclination();
+    info->pierSide = scope->SideOfPier();
+    info->slewing = scope->CanCheckSlewing() && scope->Slewing();
+    info->timestamp = ::wxGetUTCTimeMillis().GetValue();
+}
+
+wxThread::ExitCode PointingPoller::Entry()
+{
+    PerfTrace::SetThreadName("pointing poller");
+    ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "pointing poller");
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("pointing poller CoInitializeEx returns %x\n", hr));
+#endif
+
+    s_cache.lock.Lock();
+
+    while (!s_cache.stop)
+    {
+        s_cache.refresh = false;
+        s_cache.lock.Unlock();
+
+        MountPointing info;
+        ReadPointing(m_scope, &info);
+
+        s_cache.lock.Lock();
+        s_cache.info = info;
+        ++s_cache.reads;
+        s_cache.cond.Broadcast();
+
+        while (!s_cache.stop && !s_cache.refresh)
+        {
+            if (s_cache.cond.WaitTimeout(s_cache.intervalMs) == wxCOND_TIMEOUT)
+                break;
+        }
+    }
+
+    s_cache.lock.Unlock();
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    return 0;
+}
+
+void PointingCache::Start(Scope *scope)
+{
+    assert(wxThread::IsMain());
+
+    bool const canPoll = scope && scope->IsConnected() && scope->CanReportPosition();
+
+    if (canPoll && s_cache.thread && s_cache.thread->GetScope() == scope)
+        return;
+
+    Stop();
+
+    if (!canPoll)
+        return;
+
+    int intervalMs = pConfig->Profile.GetInt("/scope/PointingPollInterval", DefaultPollIntervalMs);
+
+    {
+        wxMutexLocker lck(s_cache.lock);
+        s_cache.Reset();
+        s_cache.intervalMs = wxMax(intervalMs, (int) MinPollIntervalMs);
+    }
+
+    PointingPoller *thread = new PointingPoller(scope);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        Debug.Write("PointingCache: could not start the poller thread\n");
+        delete thread;
+        return;
+    }
+
+    s_cache.thread = thread;
+    Debug.Write(wxString::Format("PointingCache: polling %s every %d ms\n", scope->Name(), s_cache.intervalMs));
+}
+
+void PointingCache::Stop(void)
+{
+    assert(wxThread::IsMain());
+
+    if (!s_cache.thread)
+        return;
+
+    {
+        wxMutexLocker lck(s_cache.lock);
+        s_cache.stop = true;
+        s_cache.cond.Broadcast();
+    }
+
+    // waits for any driver call in progress to return
+    s_cache.thread->Wait();
+    delete s_cache.thread;
+    s_cache.thread = 0;
+
+    wxMutexLocker lck(s_cache.lock);
+    s_cache.stop = false;
+    s_cache.Reset();
+
+    Debug.Write("PointingCache: stopped\n");
+}
+
+bool PointingCache::IsActive(void)
+{
+    return s_cache.thread != 0;
+}
+
+bool PointingCache::Get(MountPointing *info)
+{
+    wxMutexLocker lck(s_cache.lock);
+    *info = s_cache.info;
+    return info->timestamp != 0;
+}
+
+bool PointingCache::Refresh(MountPointing *info, int timeoutMs)
+{
+    if (!IsActive())
+        return false;
+
+    wxStopWatch swatch;
+
+    wxMutexLocker lck(s_cache.lock);
+
+    // a read that is in progress may have started before the request, so
+    // wait for the one after that
+    unsigned int const reads = s_cache.reads;
+    s_cache.refresh = true;
+    s_cache.cond.Broadcast();
+
+    while (s_cache.reads - reads < 2 && !(s_cache.reads != reads && !s_cache.refresh))
+    {
+        long remaining = timeoutMs - swatch.Time();
+        if (remaining <= 0 || s_cache.cond.WaitTimeout(remaining) == wxCOND_TIMEOUT)
+            break;
+    }
+
+    *info = s_cache.info;
+    return s_cache.reads != reads;
+}
+
+void PointingCache::GetCurrent(double *declination, PierSide *pierSide)
+{
+    MountPointing info;
+    if (Refresh(&info))
+    {
+        *declination = info.declination;
+        *pierSide = info.pierSide;
+    }
+    else if (pPointingSource)
+    {
+        *declination = pPointingSource->GetDeclination();
+        *pierSide = pPointingSource->SideOfPier();
+    }
+    else
+    {
+        *declination = UNKNOWN_DECLINATION;
+        *pierSide = PIER_SIDE_UNKNOWN;
+    }
+}
+
+double PointingCache::Declination(void)
+{
+    MountPointing info;
+    if (Get(&info))
+        return info.declination;
+    return pPointingSource ? pPointingSource->GetDeclination() : UNKNOWN_DECLINATION;
+}
+
+PierSide PointingCache::SideOfPier(void)
+{
+    MountPointing info;
+    if (Get(&info))
+        return info.pierSide;
+    return pPointingSource ? pPointingSource->SideOfPier() : PIER_SIDE_UNKNOWN;
+}
+
+bool PointingCache::GetCoordinates(double *ra, double *dec, double *lst)
+{
+    MountPointing info;
+    if (Get(&info))
+    {
+        if (!info.coordsValid)
+            return true;
+        *ra = info.ra;
+        *dec = info.dec;
+        *lst = info.lst;
+        return false;
+    }
+    return pPointingSource ? pPointingSource->GetCoordinates(ra, dec, lst) : true;
+}
@@ -0,0 +1,80 @@
+/*
+ *  pointing_cache.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef POINTING_CACHE_INCLUDED
+#define POINTING_CACHE_INCLUDED
+
+// the mount position as last read by the PointingCache
+struct MountPointing
+{
+    bool coordsValid;           // ra, dec and lst were read
+    double ra;                  // hours
+    double dec;                 // degrees
+    double lst;                 // hours
+    double declination;         // radians, or UNKNOWN_DECLINATION
+    PierSide pierSide;
+    bool slewing;
+    wxLongLong_t timestamp;     // wxGetUTCTimeMillis of the read, 0 if there has been none
+};
+
+// Polls the pointing source on a background thread, so that paint handlers,
+// logs and tools can show the mount position without a round trip to the
+// mount driver. The gear dialog starts the poller whenever the pointing
+// source changes, and stops it before a scope is disconnected. The poll
+// interval is the profile setting /scope/PointingPollInterval, in ms.
+class PointingCache
+{
+public:
+    // stops any running poller; starts one for scope if it can report its position
+    static void Start(Scope *scope);
+    static void Stop(void);
+    static bool IsActive(void);
+
+    // the last values read, returns false if there are none
+    static bool Get(MountPointing *info);
+    // ask the poller for a read and wait up to timeoutMs for it, for callers
+    // that need a current position; returns false if no new values were read
+    static bool Refresh(MountPointing *info, int timeoutMs = 5000);
+
+    // a fresh read for decisions such as adjusting the calibration, through
+    // the poller if it is running, otherwise from pPointingSource
+    static void GetCurrent(double *declination, PierSide *pierSide);
+
+    // from the cache if the poller is running, otherwise from pPointingSource
+    static double Declination(void);
+    static PierSide SideOfPier(void);
+    static bool GetCoordinates(double *ra, double *dec, double *lst);   // true on error
+};
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ *  polar_drift.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "polar_drift.h"
+#include "guiding_assistant.h"
+
+#include <algorithm>
+
+static const double BUCKET_SEC = 10.0;      // frames are averaged over this interval
+static const double WINDOW_SEC = 1800.0;
+static const double MIN_PAIR_SEC = 60.0;    // shorter pairs mostly measure seeing
+static const double MIN_SPAN_SEC = 600.0;
+static const double UPDATE_SEC = 120.0;
+enum { MIN_PAIRS = 20 };
+
+struct DriftPoint
+{
+    double t;   // seconds since guiding started
+    double y;   // px, Dec offset plus the corrections so far
+    int segment;
+};
+
+struct PolarDriftState
+{
+    std::vector<DriftPoint> points;
+    int segment;
+    double corrections;     // px, sum of the applied Dec corrections in this segment
+    double bucketT;
+    double bucketY;
+    int bucketN;
+    double lastUpdate;
+    bool valid;
+    PolarDriftEstimate est;
+
+    void Reset()
+    {
+        points.clear();
+        segment = 0;
+        corrections = 0.0;
+        bucketN = 0;
+        lastUpdate = 0.0;
+        valid = false;
+    }
+
+    void NewSegment()
+    {
+        Flush();
+        ++segment;
+        corrections = 0.0;
+    }
+
+    void Flush()
+    {
+        if (bucketN)
+        {
+            DriftPoint p;
+            p.t = bucketT / bucketN;
+            p.y = bucketY / bucketN;
+            p.segment = segment;
+            points.push_back(p);
+            bucketN = 0;
+        }
+    }
+
+    void Update(double now);
+};
+
+static PolarDriftState s_drift;
+
+// Theil-Sen slope over pairs of points within a segment
+void PolarDriftState::Update(double now)
+{
+    lastUpdate = now;
+
+    size_t drop = 0;
+    while (drop < points.size() && points[drop].t < now - WINDOW_SEC)
+        ++drop;
+    points.erase(points.begin(), points.begin() + drop);
+
+    std::vector<double> slopes;
+    double span = 0.0;
+    size_t first = 0;
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        if (points[i].segment != points[first].segment)
+        {
+            span += points[i - 1].t - points[first].t;
+            first = i;
+        }
+        for (size_t j = first; j < i; j++)
+        {
+            double dt = points[i].t - points[j].t;
+            if (dt >= MIN_PAIR_SEC)
+                slopes.push_back((points[i].y - points[j].y) / dt);
+        }
+    }
+    if (!points.empty())
+        span += points.back().t - points[first].t;
+
+    if (span < MIN_SPAN_SEC || slopes.size() < MIN_PAIRS)
+        return;
+
+    std::nth_element(slopes.begin(), slopes.begin() + slopes.size() / 2, slopes.end());
+    double rate = slopes[slopes.size() / 2] * 60.0;
+
+    est.decDriftRate = rate;
+    est.span = span / 60.0;
+    est.points = (int) points.size();
+
+    double ra_hrs, dec_deg, st_hrs;
+    est.haveCoords = !PointingCache::GetCoordinates(&ra_hrs, &dec_deg, &st_hrs);
+    double declination = UNKNOWN_DECLINATION;
+    if (est.haveCoords)
+    {
+        est.declination = dec_deg;
+        est.hourAngle = norm(st_hrs - ra_hrs, -12.0, 12.0);
+        if (fabs(radians(dec_deg)) < Scope::DEC_COMP_LIMIT)
+            declination = radians(dec_deg);
+    }
+    est.polarAlignError = GuideAnalysis::PolarAlignmentError(rate, pFrame->GetCameraPixelScale(), declination);
+    valid = true;
+
+    Debug.Write(wxString::Format("PolarDrift: Dec drift %.3f px/min over %.1f min (%d points), polar alignment error %.1f arc-min\n",
+        rate, est.span, est.points, est.polarAlignError));
+
+    GuideLog.NotifyPolarAlignEstimate(est);
+    EvtServer.NotifyPolarAlignEstimate(est);
+}
+
+void PolarDrift::Reset()
+{
+    s_drift.Reset();
+}
+
+void PolarDrift::NotifyGuidingDithered()
+{
+    s_drift.NewSegment();
+}
+
+void PolarDrift::NotifyGuideStep(const GuideStepInfo& info)
+{
+    // with an AO the Dec offsets are the AO's and the mount only bumps
+    if (!info.mount || info.mount->IsStepGuider() || pSecondaryMount)
+        return;
+
+    // direct moves and a shifting lock position move the star without being drift
+    if (info.moveType == MOVETYPE_DIRECT || pFrame->pGuider->GetLockPosShiftParams().shiftEnabled)
+    {
+        s_drift.NewSegment();
+        return;
+    }
+
+    if (info.starError || !info.mountOffset.IsValid())
+        return;
+
+    PolarDriftState& d = s_drift;
+
+    if (d.bucketN && info.time - d.bucketT / d.bucketN >= BUCKET_SEC)
+        d.Flush();
+    if (!d.bucketN)
+        d.bucketT = d.bucketY = 0.0;
+    d.bucketT += info.time;
+    d.bucketY += info.mountOffset.Y + d.corrections;
+    ++d.bucketN;
+
+    // this frame's correction removes that much of the offset from the next one
+    if (info.durationDec > 0)
+    {
+        double c = info.guideDistanceDec;
+        if (info.decLimited)
+            c = c < 0.0 ? -wxMin(-c, info.durationDec * info.mount->yRate()) : wxMin(c, info.durationDec * info.mount->yRate());
+        d.corrections += c;
+    }
+
+    if (info.time - d.lastUpdate >= UPDATE_SEC)
+        d.Update(info.time);
+}
+
+bool PolarDrift::GetEstimate(PolarDriftEstimate *est)
+{
+    if (!s_drift.valid)
+        return false;
+    *est = s_drift.est;
+    return true;
+}
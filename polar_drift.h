@@ -0,0 +1,67 @@
+/*
+ *  polar_drift.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef POLAR_DRIFT_H_INCLUDED
+#define POLAR_DRIFT_H_INCLUDED
+
+struct GuideStepInfo;
+
+struct PolarDriftEstimate
+{
+    double decDriftRate;        // px/min, uncorrected Dec drift
+    double polarAlignError;     // arc-min, lower bound as in the Guiding Assistant
+    bool haveCoords;            // declination and hourAngle are valid
+    double declination;         // degrees
+    double hourAngle;           // hours, -12 to 12
+    double span;                // minutes of guiding the fit covers
+    int points;
+};
+
+// Keeps a running estimate of the polar alignment error from normal guiding,
+// so a mount that has shifted shows up without running the Guiding Assistant
+// or the Drift Align tool. The Dec corrections are added back to the Dec
+// offsets to recover the uncorrected drift, and the drift rate is a
+// Theil-Sen fit over the last half hour. Dithers and direct moves start a
+// new segment, and pairs are only taken within a segment so that lock
+// position moves do not count as drift.
+class PolarDrift
+{
+public:
+    static void Reset();
+    static void NotifyGuideStep(const GuideStepInfo& info);
+    static void NotifyGuidingDithered();
+    // returns false if there is no estimate yet
+    static bool GetEstimate(PolarDriftEstimate *est);
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ *  power_saver.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <wx/power.h>
+
+volatile bool PowerSaver::s_engaged;
+
+static PowerSaverMode s_mode;
+static bool s_onBattery;
+static double s_cpuLoad = -1.0;
+static wxLongLong_t s_windowStart;      // ms
+static double s_windowCpu;              // process CPU seconds at s_windowStart
+
+void PowerSaver::Engage(bool engage, const wxString& why)
+{
+    if (engage == s_engaged)
+        return;
+
+    Debug.Write(wxString::Format("PowerSaver: %s (%s)\n", engage ? "engaged" : "released", why));
+
+    // the debug log is capped last on the way in and first on the way out so
+    // that both transitions are logged
+    if (!engage && !LoadShedder::Sheds(SHED_DEBUG))
+        Debug.SetLevelCap(DBGLOG_VERBOSE);
+
+    s_engaged = engage;
+
+    if (engage)
+        Debug.SetLevelCap(DBGLOG_INFO);
+}
+
+void PowerSaver::Init(void)
+{
+    int mode = pConfig->Global.GetInt("/PowerSaver", POWER_SAVER_OFF);
+    s_mode = mode >= POWER_SAVER_OFF && mode <= POWER_SAVER_AUTO ? (PowerSaverMode) mode : POWER_SAVER_OFF;
+
+    s_windowStart = ::wxGetUTCTimeMillis().GetValue();
+    s_windowCpu = GuideLoopMetrics::ProcessCpuTime();
+
+    Debug.Write(wxString::Format("PowerSaver: mode %d\n", s_mode));
+
+    if (s_mode == POWER_SAVER_ON)
+        Engage(true, "always on");
+}
+
+void PowerSaver::Update(void)
+{
+    assert(wxThread::IsMain());
+
+    if (s_mode != POWER_SAVER_AUTO)
+        return;
+
+    wxLongLong_t now = ::wxGetUTCTimeMillis().GetValue();
+    if (now - s_windowStart < LOAD_WINDOW_SEC * 1000)
+        return;
+
+    double cpu = GuideLoopMetrics::ProcessCpuTime();
+    if (cpu >= 0.0 && s_windowCpu >= 0.0)
+        s_cpuLoad = 100.0 * (cpu - s_windowCpu) / ((double)(now - s_windowStart) / 1000.0);
+    s_windowStart = now;
+    s_windowCpu = cpu;
+
+    s_onBattery = wxGetPowerType() == wxPOWER_BATTERY;
+
+    if (s_onBattery)
+        Engage(true, "on battery");
+    else if (s_cpuLoad >= LOAD_ENGAGE_PCT)
+        Engage(true, wxString::Format("CPU load %.0f%%", s_cpuLoad));
+    else if (s_cpuLoad >= 0.0 && s_cpuLoad < LOAD_RELEASE_PCT)
+        Engage(false, wxString::Format("on mains power, CPU load %.0f%%", s_cpuLoad));
+}
+
+PowerSaverStatus PowerSaver::GetStatus(void)
+{
+    PowerSaverStatus st;
+    st.mode = s_mode;
+    st.engaged = s_engaged;
+    st.onBattery = s_onBattery;
+    st.cpuLoad = s_cpuLoad;
+    return st;
+}
+
+int PowerSaver::DisplayIntervalMs(int intervalMs)
+{
+    if (!s_engaged)
+        return intervalMs;
+    return wxMax(intervalMs, 1000 / SAVER_DISPLAY_RATE);
+}
+
+int PowerSaver::PollIntervalMs(int intervalMs)
+{
+    if (!s_engaged)
+        return intervalMs;
+    return wxMax(intervalMs, (int) SAVER_POLL_INTERVAL_MS);
+}
@@ -0,0 +1,93 @@
+/*
+ *  power_saver.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef POWER_SAVER_INCLUDED
+#define POWER_SAVER_INCLUDED
+
+// Trades display responsiveness and diagnostics for CPU time on rigs running
+// from batteries. While it is engaged:
+//
+//   - the display is refreshed at most SAVER_DISPLAY_RATE times a second
+//   - the debug log keeps only DBGLOG_INFO lines
+//   - AutoFind searches a frame binned one step further than usual
+//   - waits for exposures sleep in longer intervals instead of polling
+//
+// The Global setting /PowerSaver selects off (0, the default), always on (1)
+// or automatic (2). Automatic engages while the computer runs on battery, or
+// while PHD2 uses more than LOAD_ENGAGE_PCT percent of a core averaged over
+// LOAD_WINDOW_SEC seconds, and disengages when neither holds.
+enum PowerSaverMode
+{
+    POWER_SAVER_OFF,
+    POWER_SAVER_ON,
+    POWER_SAVER_AUTO,
+};
+
+struct PowerSaverStatus
+{
+    PowerSaverMode mode;
+    bool engaged;
+    bool onBattery;
+    double cpuLoad;         // percent of one core over the last window, < 0 if not measured yet
+};
+
+class PowerSaver
+{
+    static volatile bool s_engaged;     // read by the worker threads
+
+    static void Engage(bool engage, const wxString& why);
+
+public:
+    enum
+    {
+        SAVER_DISPLAY_RATE = 2,
+        SAVER_POLL_INTERVAL_MS = 100,
+        LOAD_WINDOW_SEC = 30,
+        LOAD_ENGAGE_PCT = 50,
+        LOAD_RELEASE_PCT = 30,
+    };
+
+    static void Init(void);
+    // measure the load and engage or disengage; on the main thread, as often
+    // as convenient, it does nothing until the next window is complete
+    static void Update(void);
+    static bool IsEngaged(void) { return s_engaged; }
+    static PowerSaverStatus GetStatus(void);
+
+    // the display interval to use in place of intervalMs (0 for no limit)
+    static int DisplayIntervalMs(int intervalMs);
+    // the longest exposure poll interval to use in place of intervalMs
+    static int PollIntervalMs(int intervalMs);
+};
+
+#endif
@@ -35,6 +35,7 @@
 #include "phd.h"
 #include "profile_wizard.h"
 #include "calstep_dialog.h"
+#include "benchmark.h"
 
 wxBEGIN_EVENT_TABLE(ProfileWizard, wxDialog)
 EVT_BUTTON(ID_NEXT, ProfileWizard::OnNext)
@@ -121,7 +122,7 @@ ProfileWizard::ProfileWizard(wxWindow *parent, bool firstLight) :
     m_pGearGrid = new wxFlexGridSizer(1, 2, 5, 15);
     m_pGearLabel = new wxStaticText(this, wxID_ANY, "Temp:", wxDefaultPosition, wxDefaultSize);
     m_pGearChoice = new wxChoice(this, ID_COMBO, wxDefaultPosition, wxDefaultSize,
-                              GuideCamera::List(), 0, wxDefaultValidator, _("Gear"));
+                              DeviceLists::Wait(DEVICES_CAMERA), 0, wxDefaultValidator, _("Gear"));
     m_pGearGrid->Add(m_pGearLabel, 1, wxALL, 5);
     m_pGearGrid->Add(m_pGearChoice, 1, wxLEFT, 10);
     m_pvSizer->Add(m_pGearGrid, wxSizerFlags().Center().Border(wxALL, 5));
@@ -160,13 +161,19 @@ ProfileWizard::ProfileWizard(wxWindow *parent, bool firstLight) :
     m_pvSizer->Add(m_pUserProperties, wxSizerFlags().Center().Border(wxALL, 5));
 
     // Wrapup panel
-    m_pWrapUp = new wxFlexGridSizer(2, 2, 5, 15);
+    m_pWrapUp = new wxFlexGridSizer(3, 2, 5, 15);
     m_pProfileName = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(250,-1));
     m_pLaunchDarks = new wxCheckBox(this, wxID_ANY, _("Build dark library"));
     m_pLaunchDarks->SetValue(m_launchDarks);
     m_pLaunchDarks->SetToolTip(_("Check this to automatically start the process of building a dark library for this profile."));
     AddTableEntryPair(this, m_pWrapUp, _("Profile Name"), m_pProfileName);
     m_pWrapUp->Add(m_pLaunchDarks, wxSizerFlags().Border(wxTOP, 5).Border(wxLEFT, 10));
+    m_pWrapUp->AddSpacer(0);
+    m_pTuneHost = new wxCheckBox(this, wxID_ANY, _("Tune image processing for this computer"));
+    m_pTuneHost->SetValue(false);
+    m_pTuneHost->SetToolTip(_("Check this to time the image processing on this computer and get recommended settings "
+        "that leave enough time for guiding. Takes a few seconds."));
+    m_pWrapUp->Add(m_pTuneHost, wxSizerFlags().Border(wxLEFT, 10));
     m_pvSizer->Add(m_pWrapUp, wxSizerFlags().Border(wxALL, 10).Expand().Center());
 
     // Row of buttons for prev, help, next
@@ -354,7 +361,7 @@ void ProfileWizard::UpdateState(const int change)
             m_pPrevBtn->Enable(true);
             m_pGearLabel->SetLabel(_("Guide Camera:"));
             m_pGearChoice->Clear();
-            m_pGearChoice->Append(GuideCamera::List());
+            m_pGearChoice->Append(DeviceLists::Wait(DEVICES_CAMERA));
             if (m_SelectedCamera.length() > 0)
                 m_pGearChoice->SetStringSelection(m_SelectedCamera);
             m_pGearLabel->Show(true);
@@ -371,7 +378,7 @@ void ProfileWizard::UpdateState(const int change)
             m_pPrevBtn->Enable(true);
             m_pGearLabel->SetLabel(_("Mount:"));
             m_pGearChoice->Clear();
-            m_pGearChoice->Append(Scope::List());
+            m_pGearChoice->Append(DeviceLists::Wait(DEVICES_MOUNT));
             if (m_SelectedMount.length() > 0)
                 m_pGearChoice->SetStringSelection(m_SelectedMount);
             m_pUserProperties->Show(false);
@@ -387,7 +394,7 @@ void ProfileWizard::UpdateState(const int change)
                 SetTitle(TitlePrefix + _("Choose an Auxiliary Mount Connection (optional)"));
                 m_pGearLabel->SetLabel(_("Aux Mount:"));
                 m_pGearChoice->Clear();
-                m_pGearChoice->Append(Scope::AuxMountList());
+                m_pGearChoice->Append(DeviceLists::Wait(DEVICES_AUX_MOUNT));
                 m_pGearChoice->SetStringSelection(m_SelectedAuxMount);      // SelectedAuxMount is never null
                 m_pInstructions->SetLabel(_("Since your primary mount connection does not report pointing position, you may want to choose an 'Aux Mount' connection"));
             }
@@ -396,7 +403,7 @@ void ProfileWizard::UpdateState(const int change)
             SetTitle(TitlePrefix + _("Choose an Adaptive Optics Device (optional)"));
             m_pGearLabel->SetLabel(_("AO:"));
             m_pGearChoice->Clear();
-            m_pGearChoice->Append(StepGuider::List());
+            m_pGearChoice->Append(DeviceLists::Wait(DEVICES_AO));
             m_pGearChoice->SetStringSelection(m_SelectedAO);            // SelectedAO is never null
             m_pInstructions->SetLabel(_("Specify your adaptive optics device if desired"));
             if (change == -1)                   // User is backing up in wizard dialog
@@ -482,9 +489,55 @@ void ProfileWizard::WrapUp()
     // Construct a good baseline set of guiding parameters based on image scale
     SetGuideAlgoParams(m_PixelSize, m_FocalLength, binning);
 
+    if (m_pTuneHost->GetValue())
+        TuneHost();
+
     EndModal(wxOK);
 }
 
+// Time the image processing on a frame the size of the sensor and offer the
+// settings that keep it under a quarter of the guide cycle
+void ProfileWizard::TuneHost()
+{
+    static const double BudgetFraction = 0.25;
+    wxSize frameSize = m_SensorSize.GetWidth() > 0 ? m_SensorSize : wxSize(1280, 960);
+
+    HostTuning t;
+    {
+        wxBusyCursor busy;
+        ShowStatus(_("Measuring image processing speed..."));
+        Benchmark::TuneHost(frameSize, BudgetFraction, &t);
+        ShowStatus(wxEmptyString);
+    }
+
+    const wxString NrNames[] = { _("None"), _("2x2 mean"), _("3x3 median") };
+    wxString msg = wxString::Format(_("Recommended settings for a %dx%d camera on this computer:\n\n"), frameSize.GetWidth(), frameSize.GetHeight());
+    msg += wxString::Format(_("Noise reduction: %s\n"), NrNames[t.noiseReduction]);
+    msg += wxString::Format(_("Use subframes: %s\n"), t.useSubframes ? _("Yes") : _("No"));
+    msg += wxString::Format(_("Maximum display updates per second: %d\n"), t.maxDisplayRate);
+    if (t.autoFindDownsample > 0)
+        msg += wxString::Format(_("Star auto-select downsampling: %d\n"), t.autoFindDownsample);
+    msg += wxString::Format(_("Shortest practical exposure: %d ms\n\n"), t.minExposureMs);
+    msg += _("Apply these settings to the new profile?");
+
+    if (wxMessageBox(msg, _("Tune Image Processing"), wxYES_NO | wxICON_QUESTION, this) != wxYES)
+    {
+        Debug.AddLine("Profile Wiz: host tuning not applied");
+        return;
+    }
+
+    pConfig->Profile.SetInt("/NoiseReductionMethod", t.noiseReduction);
+    pConfig->Profile.SetBoolean("/camera/UseSubframes", t.useSubframes);
+    pConfig->Profile.SetInt("/StarAutoFind/Downsample", t.autoFindDownsample);
+    if (t.minExposureMs > 1000)
+        pConfig->Profile.SetInt("/auto_exp/exposure_min", t.minExposureMs);
+    // the display rate is a global setting, not per profile
+    pConfig->Global.SetInt("/MaxDisplayRate", t.maxDisplayRate);
+
+    Debug.AddLine(wxString::Format("Profile Wiz: host tuning applied, NR=%d, Subframes=%d, MaxDisplayRate=%d, AutoFindDownsample=%d, MinExposure=%d",
+                                   t.noiseReduction, t.useSubframes, t.maxDisplayRate, t.autoFindDownsample, t.minExposureMs));
+}
+
 // Event handlers below
 void ProfileWizard::OnGearChoice(wxCommandEvent& evt)
 {
@@ -537,6 +590,8 @@ void ProfileWizard::OnDetectPixelSize(wxCommandEvent& evt)
         ShowStatus(wxEmptyString);
         if (err)
             throw _("Could not connect to camera");
+        if (camera->FullSize.GetWidth() > 0 && camera->FullSize.GetHeight() > 0)
+            m_SensorSize = camera->FullSize;
         if (camera->GetDevicePixelSize(&devPixelSize) || devPixelSize == 0)
             throw (_("Camera driver cannot report pixel size"));
         m_pPixelSize->SetValue(devPixelSize);
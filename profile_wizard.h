@@ -80,6 +80,7 @@ private:
     wxFlexGridSizer *m_pWrapUp;
     wxTextCtrl *m_pProfileName;
     wxCheckBox *m_pLaunchDarks;
+    wxCheckBox *m_pTuneHost;
     wxStatusBar *m_pStatusBar;
 
     wxString m_SelectedCamera;
@@ -90,6 +91,7 @@ private:
     int m_FocalLength;
     double m_GuideSpeed;
     double m_PixelSize;
+    wxSize m_SensorSize;
     wxString m_ProfileName;
     wxBitmap *m_bitmaps[NUM_PAGES];
 
@@ -105,6 +107,7 @@ private:
     bool SemanticCheck(DialogState state, int change);
     void ShowHelp(DialogState state);
     void WrapUp();
+    void TuneHost();
 
     DialogState m_State;
 
@@ -0,0 +1,485 @@
+/*
+ *  pulse_profile.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+wxDEFINE_EVENT(PULSE_PROFILE_DONE_EVENT, wxThreadEvent);
+
+PulseProfileRequest::PulseProfileRequest()
+    : repeats(3),
+    ra(true),
+    dec(true),
+    track(true),
+    exposure(1000),
+    settle(500)
+{
+    static const int DefaultDurations[] = { 50, 100, 200, 500, 1000 };
+    durations.assign(DefaultDurations, DefaultDurations + WXSIZEOF(DefaultDurations));
+}
+
+PulseProfileResult::PulseProfileResult()
+    : direction(NONE),
+    duration(0),
+    pulses(0),
+    failed(0),
+    commandMs(-1.0),
+    commandMaxMs(-1.0),
+    completionMs(0.0),
+    completionP95Ms(0.0),
+    completionMaxMs(0.0),
+    tracked(0),
+    motionPx(0.0),
+    crossPx(0.0),
+    expectedPx(0.0),
+    response(0.0)
+{
+}
+
+PulseProfileStatus::PulseProfileStatus()
+    : state(PULSE_PROFILE_IDLE),
+    pulse(0),
+    pulseCount(0)
+{
+}
+
+class PulseProfileThread : public wxThread
+{
+    PulseProfileRequest m_req;
+    Scope *m_scope;
+    int m_searchRegion;
+
+    bool Locate(const PHD_Point *prev, int searchRegion, PHD_Point *pos);
+    bool ProfileDirection(GUIDE_DIRECTION direction, int duration, PHD_Point *pos, PulseProfileResult *result);
+    bool WriteResults(const std::vector<PulseProfileResult>& results, wxString *fileName);
+
+public:
+    PulseProfileThread(const PulseProfileRequest& req, Scope *scope, int searchRegion)
+        : wxThread(wxTHREAD_JOINABLE), m_req(req), m_scope(scope), m_searchRegion(searchRegion) { }
+
+    ExitCode Entry();
+};
+
+// s_status is shared with the profile thread and protected by s_lock; the
+// remaining state is only touched in the main thread
+static wxCriticalSection s_lock;
+static PulseProfileStatus s_status;
+static PULSE_PROFILE_STATE s_result;
+static volatile bool s_cancel;
+static PulseProfileThread *s_thread;
+
+static Scope *ProfiledScope(void)
+{
+    Mount *mount = pMount && pMount->IsStepGuider() ? pSecondaryMount : pMount;
+    return dynamic_cast<Scope *>(mount);
+}
+
+// captures a tracking frame and finds the star near prev, or the best star
+// in the frame if there is no previous position; returns true if the star
+// was not found
+bool PulseProfileThread::Locate(const PHD_Point *prev, int searchRegion, PHD_Point *pos)
+{
+    usImage img;
+    if (GuideCamera::Capture(pCamera, m_req.exposure, img, CAPTURE_LIGHT))
+        return true;
+
+    Star star;
+    bool found;
+    if (prev && prev->IsValid())
+        found = star.Find(&img, searchRegion, ROUND(prev->X), ROUND(prev->Y), Star::FIND_CENTROID);
+    else
+        found = star.AutoFind(img, 0, searchRegion);
+
+    if (!found)
+        return true;
+
+    pos->SetXY(star.X, star.Y);
+    return false;
+}
+
+bool PulseProfileThread::ProfileDirection(GUIDE_DIRECTION direction, int duration, PHD_Point *pos, PulseProfileResult *result)
+{
+    GuideAxis const axis = direction == NORTH || direction == SOUTH ? GUIDE_DEC : GUIDE_RA;
+    bool const calibrated = m_scope->IsCalibrated();
+    double const rate = axis == GUIDE_RA ? m_scope->xRate() : m_scope->yRate();
+
+    result->direction = direction;
+    result->duration = duration;
+    if (calibrated)
+        result->expectedPx = rate * duration;
+
+    // allow for the expected motion, or the calibration being off by 2x
+    int const searchRegion = m_searchRegion + (int) ceil(2.0 * result->expectedPx);
+
+    std::vector<double> completion;
+    double commandTotal = 0.0;
+    int commandCount = 0;
+    double motionTotal = 0.0;
+    double crossTotal = 0.0;
+
+    for (int i = 0; i < m_req.repeats && !s_cancel; i++)
+    {
+        long long const t0 = PerfTrace::Now();
+        MoveResultInfo info;
+        Mount::MOVE_RESULT res = static_cast<Mount *>(m_scope)->Move(direction, duration, MOVETYPE_DIRECT, &info);
+        double const ms = (double)(PerfTrace::Now() - t0) / 1000.0;
+
+        {
+            wxCriticalSectionLocker lck(s_lock);
+            ++s_status.pulse;
+        }
+
+        if (res != Mount::MOVE_OK)
+        {
+            Debug.Write(wxString::Format("PulseProfile: %s %d ms failed (%d)\n", m_scope->DirectionStr(direction), duration, res));
+            ++result->failed;
+            if (res == Mount::MOVE_STOP_GUIDING)
+                return true;
+            continue;
+        }
+
+        ++result->pulses;
+        completion.push_back(ms - info.amountMoved);
+        double const cmd = m_scope->LastPulseCommandMs();
+        if (cmd >= 0.0)
+        {
+            commandTotal += cmd;
+            ++commandCount;
+            result->commandMaxMs = wxMax(result->commandMaxMs, cmd);
+        }
+
+        if (!pos->IsValid())
+            continue;
+
+        if (m_req.settle > 0)
+            wxMilliSleep(m_req.settle);
+
+        PHD_Point prev = *pos;
+        if (Locate(&prev, searchRegion, pos))
+        {
+            Debug.Write("PulseProfile: star lost, tracking stopped\n");
+            pos->Invalidate();
+            continue;
+        }
+
+        // the first pulse after a reversal takes up any backlash
+        if (i == 0)
+            continue;
+
+        PHD_Point camera(pos->X - prev.X, pos->Y - prev.Y);
+        double along, across;
+        PHD_Point mount;
+        if (calibrated && !m_scope->TransformCameraCoordinatesToMountCoordinates(camera, mount))
+        {
+            along = axis == GUIDE_RA ? mount.X : mount.Y;
+            across = axis == GUIDE_RA ? mount.Y : mount.X;
+        }
+        else
+        {
+            along = camera.Distance();
+            across = 0.0;
+        }
+        motionTotal += fabs(along);
+        crossTotal += fabs(across);
+        ++result->tracked;
+    }
+
+    if (commandCount)
+        result->commandMs = commandTotal / commandCount;
+    if (!completion.empty())
+    {
+        std::sort(completion.begin(), completion.end());
+        double total = 0.0;
+        for (size_t i = 0; i < completion.size(); i++)
+            total += completion[i];
+        result->completionMs = total / completion.size();
+        result->completionP95Ms = completion[wxMin((size_t)(completion.size() * 0.95), completion.size() - 1)];
+        result->completionMaxMs = completion.back();
+    }
+    if (result->tracked)
+    {
+        result->motionPx = motionTotal / result->tracked;
+        result->crossPx = crossTotal / result->tracked;
+        if (result->expectedPx > 0.0)
+            result->response = result->motionPx / result->expectedPx;
+    }
+
+    Debug.Write(wxString::Format("PulseProfile: %s %d ms pulses=%d failed=%d command=%.1f completion=%.1f p95=%.1f max=%.1f "
+        "tracked=%d motion=%.2f cross=%.2f expected=%.2f response=%.2f\n",
+        m_scope->DirectionStr(direction), duration, result->pulses, result->failed, result->commandMs,
+        result->completionMs, result->completionP95Ms, result->completionMaxMs, result->tracked,
+        result->motionPx, result->crossPx, result->expectedPx, result->response));
+
+    return false;
+}
+
+bool PulseProfileThread::WriteResults(const std::vector<PulseProfileResult>& results, wxString *fileName)
+{
+    *fileName = Debug.GetLogDir() + PATHSEPSTR + "PHD2_PulseProfile_" + wxDateTime::Now().Format("%Y-%m-%d_%H%M%S") + ".csv";
+
+    wxFFile file(*fileName, "w");
+    if (!file.IsOpened())
+        return true;
+
+    file.Write(wxString::Format("# mount %s (%s), concurrent axes %s, calibrated %s\n", m_scope->Name(),
+        m_scope->GetMountClassName(), m_scope->CanGuideConcurrently() ? "yes" : "no",
+        m_scope->IsCalibrated() ? "yes" : "no"));
+    file.Write("direction,duration_ms,pulses,failed,command_ms,command_max_ms,completion_ms,completion_p95_ms,"
+        "completion_max_ms,tracked,motion_px,cross_px,expected_px,response\n");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const PulseProfileResult& r = results[i];
+        file.Write(wxString::Format("%s,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%d,%.2f,%.2f,%.2f,%.2f\n",
+            m_scope->DirectionStr(r.direction), r.duration, r.pulses, r.failed, r.commandMs, r.commandMaxMs,
+            r.completionMs, r.completionP95Ms, r.completionMaxMs, r.tracked, r.motionPx, r.crossPx,
+            r.expectedPx, r.response));
+    }
+
+    return !file.Close();
+}
+
+wxThread::ExitCode PulseProfileThread::Entry()
+{
+    PerfTrace::SetThreadName("pulse profile");
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, "pulse profile");
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("pulse profile CoInitializeEx returns %x\n", hr));
+#endif
+
+    Debug.Write(wxString::Format("PulseProfile: start mount=%s durations=%u repeats=%d ra=%d dec=%d track=%d exposure=%d settle=%d\n",
+        m_scope->Name(), (unsigned int) m_req.durations.size(), m_req.repeats, m_req.ra, m_req.dec, m_req.track,
+        m_req.exposure, m_req.settle));
+
+    wxString errMsg;
+    PHD_Point pos;
+    if (m_req.track)
+    {
+        pCamera->InitCapture();
+        if (Locate(NULL, m_searchRegion, &pos))
+        {
+            Debug.Write("PulseProfile: no star found, profiling without tracking\n");
+            errMsg = _("No star found, the on-sky response was not measured");
+        }
+    }
+
+    std::vector<GUIDE_DIRECTION> directions;
+    if (m_req.ra)
+    {
+        directions.push_back(WEST);
+        directions.push_back(EAST);
+    }
+    if (m_req.dec)
+    {
+        directions.push_back(NORTH);
+        directions.push_back(SOUTH);
+    }
+
+    std::vector<PulseProfileResult> results;
+    bool err = false;
+
+    for (size_t i = 0; i < m_req.durations.size() && !err && !s_cancel; i++)
+    {
+        for (size_t j = 0; j < directions.size() && !err && !s_cancel; j++)
+        {
+            PulseProfileResult result;
+            err = ProfileDirection(directions[j], m_req.durations[i], &pos, &result);
+            if (err)
+                errMsg = _("The mount stopped guiding");
+            if (result.pulses > 0)
+            {
+                results.push_back(result);
+                wxCriticalSectionLocker lck(s_lock);
+                s_status.results = results;
+            }
+        }
+    }
+
+    wxString fileName;
+    if (!results.empty() && WriteResults(results, &fileName))
+    {
+        if (!err)
+            errMsg = _("Error writing pulse profile results ") + fileName;
+        fileName.clear();
+        err = true;
+    }
+
+    PULSE_PROFILE_STATE result;
+    if (s_cancel)
+    {
+        result = PULSE_PROFILE_CANCELLED;
+        errMsg = _("Pulse profile cancelled");
+    }
+    else if (err || results.empty())
+        result = PULSE_PROFILE_FAILED;
+    else
+        result = PULSE_PROFILE_SUCCEEDED;
+
+    Debug.Write(wxString::Format("PulseProfile: done result=%d results=%u %s %s\n", result,
+        (unsigned int) results.size(), fileName, errMsg));
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_result = result;
+        s_status.fileName = fileName;
+        s_status.message = errMsg;
+    }
+
+#if defined(__WINDOWS__)
+    CoUninitialize();
+#endif
+
+    wxQueueEvent(pFrame, new wxThreadEvent(wxEVT_THREAD, PULSE_PROFILE_DONE_EVENT));
+
+    return (ExitCode) 0;
+}
+
+bool PulseProfiler::Start(const PulseProfileRequest& req, wxString *error)
+{
+    if (s_thread)
+    {
+        *error = _("A pulse profile is already in progress");
+        return true;
+    }
+    Scope *scope = ProfiledScope();
+    if (!scope || !scope->IsConnected())
+    {
+        *error = _("Please connect to a mount first");
+        return true;
+    }
+    if (req.track && (!pCamera || !pCamera->Connected))
+    {
+        *error = _("Please connect to a camera first");
+        return true;
+    }
+    if (pFrame->CaptureActive || DarkBuilder::IsActive() || CameraTest::IsActive() || AOFastLoop::IsActive() ||
+        CaptureNode::IsRunning())
+    {
+        *error = _("Cannot profile the mount while capture is active");
+        return true;
+    }
+    if (req.durations.empty() || req.repeats < 1 || req.exposure < 1 || req.settle < 0 || (!req.ra && !req.dec))
+    {
+        *error = _("Invalid pulse profile parameters");
+        return true;
+    }
+    for (size_t i = 0; i < req.durations.size(); i++)
+    {
+        if (req.durations[i] <= 0)
+        {
+            *error = _("Invalid pulse profile parameters");
+            return true;
+        }
+    }
+
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status = PulseProfileStatus();
+        s_status.state = PULSE_PROFILE_RUNNING;
+        s_status.pulseCount = req.durations.size() * ((req.ra ? 2 : 0) + (req.dec ? 2 : 0)) * req.repeats;
+        s_result = PULSE_PROFILE_RUNNING;
+    }
+    s_cancel = false;
+
+    PulseProfileThread *thread = new PulseProfileThread(req, scope, pFrame->pGuider->GetSearchRegion());
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = PULSE_PROFILE_IDLE;
+        *error = _("Could not start the pulse profile thread");
+        return true;
+    }
+
+    s_thread = thread;
+
+    return false;
+}
+
+void PulseProfiler::Cancel(void)
+{
+    if (s_thread)
+    {
+        Debug.AddLine("PulseProfile: cancel requested");
+        s_cancel = true;
+    }
+}
+
+bool PulseProfiler::IsActive(void)
+{
+    return s_thread != NULL;
+}
+
+PulseProfileStatus PulseProfiler::GetStatus(void)
+{
+    wxCriticalSectionLocker lck(s_lock);
+    return s_status;
+}
+
+void PulseProfiler::OnProfileDone(void)
+{
+    if (!s_thread)
+        return;
+
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+
+    PULSE_PROFILE_STATE result;
+    wxString fileName;
+    wxString msg;
+    {
+        wxCriticalSectionLocker lck(s_lock);
+        s_status.state = result = s_result;
+        fileName = s_status.fileName;
+        msg = s_status.message;
+    }
+
+    EvtServer.NotifyPulseProfileComplete(result == PULSE_PROFILE_SUCCEEDED, fileName,
+        result == PULSE_PROFILE_SUCCEEDED ? wxString() : msg);
+}
+
+void PulseProfiler::Shutdown(void)
+{
+    if (!s_thread)
+        return;
+
+    Debug.AddLine("PulseProfile: waiting for profile thread to exit");
+    s_cancel = true;
+    s_thread->Wait();
+    delete s_thread;
+    s_thread = NULL;
+}
@@ -0,0 +1,115 @@
+/*
+ *  pulse_profile.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PULSE_PROFILE_INCLUDED
+#define PULSE_PROFILE_INCLUDED
+
+struct PulseProfileRequest
+{
+    std::vector<int> durations;   // pulse durations (ms)
+    int repeats;                  // pulses of each duration in each direction
+    bool ra;                      // profile the RA axis
+    bool dec;                     // profile the Dec axis
+    bool track;                   // measure the star motion after each pulse
+    int exposure;                 // exposure (ms) for the tracking frames
+    int settle;                   // wait (ms) after a pulse before the tracking frame
+
+    PulseProfileRequest();
+};
+
+// measurements for the pulses of one duration in one direction
+struct PulseProfileResult
+{
+    GUIDE_DIRECTION direction;
+    int duration;                 // requested pulse duration (ms)
+    int pulses;                   // pulses that completed
+    int failed;                   // pulses the mount returned an error for
+    double commandMs;             // mean time until the driver took the command, -1 if not reported
+    double commandMaxMs;
+    double completionMs;          // mean time from the command until Guide() returned, less the duration
+    double completionP95Ms;
+    double completionMaxMs;
+    int tracked;                  // pulses with a star position before and after, not counting
+                                  // the first pulse after a reversal, which includes any backlash
+    double motionPx;              // mean star motion along the axis
+    double crossPx;               // mean star motion across the axis
+    double expectedPx;            // motion expected from the calibration rate, 0 if not calibrated
+    double response;              // motionPx / expectedPx, 0 if not calibrated
+
+    PulseProfileResult();
+};
+
+enum PULSE_PROFILE_STATE
+{
+    PULSE_PROFILE_IDLE,
+    PULSE_PROFILE_RUNNING,
+    PULSE_PROFILE_SUCCEEDED,
+    PULSE_PROFILE_FAILED,
+    PULSE_PROFILE_CANCELLED,
+};
+
+struct PulseProfileStatus
+{
+    PULSE_PROFILE_STATE state;
+    int pulse;            // pulses issued so far
+    int pulseCount;       // total pulses in the profile
+    std::vector<PulseProfileResult> results;
+    wxString fileName;    // results file, written when the profile finishes
+    wxString message;
+
+    PulseProfileStatus();
+};
+
+wxDECLARE_EVENT(PULSE_PROFILE_DONE_EVENT, wxThreadEvent);
+
+// Issues trains of pulses of known duration through Mount::Move on a
+// background thread and measures, for each duration and axis, how long the
+// driver takes to accept the command, how much longer than the pulse the
+// move takes to complete, and, from the guide star position in frames taken
+// before and after each pulse, how far the mount actually moved compared with
+// what the calibration predicts. Each duration is pulsed the same number of
+// times in one direction and then the other, so the star ends up about where
+// it started. The results go to PHD2_PulseProfile_<timestamp>.csv in
+// the log directory.
+class PulseProfiler
+{
+public:
+    static bool Start(const PulseProfileRequest& req, wxString *error);  // returns true on error
+    static void Cancel(void);
+    static bool IsActive(void);        // running or not yet finalized
+    static PulseProfileStatus GetStatus(void);
+    static void OnProfileDone(void);
+    static void Shutdown(void);        // cancel and wait for the profile thread
+};
+
+#endif
@@ -142,6 +142,12 @@ void Rotator::SetReversed(bool val)
     Debug.Write(wxString::Format("Rotator:SetReversed: isReversed = %d\n", m_isReversed));
 }
 
+void Rotator::LoadProfileSettings(void)
+{
+    m_isReversed = pConfig->Profile.GetBoolean("/rotator/isReversed", false);
+    Debug.Write(wxString::Format("Rotator:LoadProfileSettings: isReversed = %d\n", m_isReversed));
+}
+
 RotatorConfigDialogPane::RotatorConfigDialogPane(wxWindow *parent, Rotator *rotator)
     : ConfigDialogPane(_("Rotator Settings"), parent), m_rotator(rotator)
 {
@@ -84,6 +84,8 @@ public:
     virtual bool Connect(void);
     virtual bool Disconnect(void);
     virtual bool IsConnected(void) const;
+    // True if Connect can be called on a thread other than the main thread
+    virtual bool CanConnectInBackground(void) const { return false; }
 
     virtual ConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
     RotatorConfigDialogCtrlSet *GetConfigDlgCtrlSet(wxWindow *pParent, Rotator* pRotator, AdvancedDialog* pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
@@ -97,6 +99,10 @@ public:
 
     bool IsReversed(void) const;
     void SetReversed(bool val);
+
+    // re-read the profile settings of a rotator that is kept connected
+    // across a profile switch
+    virtual void LoadProfileSettings(void);
 };
 
 extern Rotator *pRotator;
@@ -67,6 +67,15 @@ static wxString displayName(const wxString& ascomName)
 
 // map descriptive name to progid
 static std::map<wxString, wxString> s_progid;
+// the device lists are enumerated on a background thread
+static wxCriticalSection s_progidLock;
+
+static wxString ProgId(const wxString& choice)
+{
+    wxCriticalSectionLocker lck(s_progidLock);
+    std::map<wxString, wxString>::const_iterator it = s_progid.find(choice);
+    return it != s_progid.end() ? it->second : wxString();
+}
 
 wxArrayString RotatorAscom::EnumAscomRotators(void)
 {
@@ -104,7 +113,10 @@ wxArrayString RotatorAscom::EnumAscomRotators(void)
                     wxString ascomName = vval.bstrVal;
                     wxString displName = displayName(ascomName);
                     wxString progid = vkey.bstrVal;
-                    s_progid[displName] = progid;
+                    {
+                        wxCriticalSectionLocker lck(s_progidLock);
+                        s_progid[displName] = progid;
+                    }
                     list.Add(displName);
                 }
             }
@@ -127,7 +139,14 @@ bool AscomRotatorImpl::Create(DispatchObj *obj, DispatchClass *cls)
         return true;
     }
 
-    wxBasicString progid(s_progid[m_choice]);
+    wxString id = ProgId(m_choice);
+    if (id.IsEmpty())
+    {
+        // the choice was made before the device list was enumerated
+        RotatorAscom::EnumAscomRotators();
+        id = ProgId(m_choice);
+    }
+    wxBasicString progid(id);
 
     if (!obj->Create(progid))
     {
@@ -52,6 +52,7 @@ public:
 
     virtual bool Connect(void);
     virtual bool Disconnect(void);
+    virtual bool CanConnectInBackground(void) const { return true; }
 
     virtual void ShowPropertyDialog(void);
 
@@ -148,6 +148,8 @@ struct RunInBgImpl : public wxTimer, public wxThreadHelper
 
     wxThread::ExitCode Entry()
     {
+        PerfTrace::SetThreadName("background job");
+
         bool err = m_bg->Entry();
         m_done = true;
         return (wxThread::ExitCode) err;
@@ -171,6 +173,11 @@ void RunInBg::SetPopupDelay(unsigned int millis)
 
 bool RunInBg::Run(void)
 {
+    // a device being connected on a background thread is already off the
+    // main thread, and there is no event loop here for the progress window
+    if (!wxThread::IsMain())
+        return Entry();
+
     return m_impl->Run();
 }
 
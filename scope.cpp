@@ -53,6 +53,14 @@ static const GUIDE_ALGORITHM DefaultDecGuideAlgorithm = GUIDE_ALGORITHM_RESIST_S
 static const double DEC_BACKLASH_DISTANCE = 3.0;
 static const int MAX_CALIBRATION_STEPS = 60;
 static const double MAX_CALIBRATION_DISTANCE = 25.0;
+
+// Fast calibration ends a leg early once the 95% confidence intervals of the
+// fitted rate and angle are within these limits
+static const int FAST_CAL_MIN_SAMPLES = 5;
+static const double FAST_CAL_MIN_DISTANCE = 0.4;       // fraction of the calibration distance
+static const double FAST_CAL_RATE_TOLERANCE = 0.05;    // fraction of the rate
+static const double FAST_CAL_ANGLE_TOLERANCE = 2.0;    // degrees
+static const int DEFAULT_SHORT_CAL_SETTLE_MS = 250;
 static const int CAL_ALERT_MINSTEPS = 4;
 static const double CAL_ALERT_ORTHOGONALITY_TOLERANCE = 12.5;               // Degrees
 static const double CAL_ALERT_DECRATE_DIFFERENCE = 0.20;                    // Ratio tolerance
@@ -70,11 +78,29 @@ Scope::Scope(void)
     : m_raLimitReachedDirection(NONE),
       m_raLimitReachedCount(0),
       m_decLimitReachedDirection(NONE),
-      m_decLimitReachedCount(0)
+      m_decLimitReachedCount(0),
+      m_pulseStartUs(-1),
+      m_pulseCommandUs(-1)
 {
     m_calibrationSteps = 0;
+    m_calibrationSampleTime = 0.0;
     m_graphControlPane = NULL;
 
+    LoadSettings();
+
+    m_backlashComp = new BacklashComp(this);
+}
+
+Scope::~Scope(void)
+{
+    if (m_graphControlPane)
+    {
+        m_graphControlPane->m_pScope = NULL;
+    }
+}
+
+void Scope::LoadSettings(void)
+{
     wxString prefix = "/" + GetMountClassName();
     int calibrationDuration = pConfig->Profile.GetInt(prefix + "/CalibrationDuration", DefaultCalibrationDuration);
     SetCalibrationDuration(calibrationDuration);
@@ -100,18 +126,27 @@ Scope::Scope(void)
     val = pConfig->Profile.GetBoolean(prefix + "/AssumeOrthogonal", false);
     SetAssumeOrthogonal(val);
 
+    val = pConfig->Profile.GetBoolean(prefix + "/FastCalibration", false);
+    SetFastCalibration(val);
+
+    val = pConfig->Profile.GetBoolean(prefix + "/ShortCalibrationExposures", false);
+    SetShortCalibrationExposures(val);
+    m_shortCalSettleMs = wxMax(0, pConfig->Profile.GetInt(prefix + "/ShortCalibrationSettleMs", DEFAULT_SHORT_CAL_SETTLE_MS));
+
     val = pConfig->Profile.GetBoolean(prefix + "/UseDecComp", true);
     EnableDecCompensation(val);
-
-    m_backlashComp = new BacklashComp(this);
 }
 
-Scope::~Scope(void)
+void Scope::LoadProfileSettings(void)
 {
-    if (m_graphControlPane)
-    {
-        m_graphControlPane->m_pScope = NULL;
-    }
+    Mount::LoadProfileSettings();
+
+    LoadSettings();
+
+    delete m_backlashComp;
+    m_backlashComp = new BacklashComp(this);
+
+    EnableStopGuidingWhenSlewing(pConfig->Profile.GetBoolean("/scope/StopGuidingWhenSlewing", CanCheckSlewing()));
 }
 
 bool Scope::SetCalibrationDuration(int calibrationDuration)
@@ -440,6 +475,18 @@ void Scope::SetAssumeOrthogonal(bool val)
     pConfig->Profile.SetBoolean("/scope/AssumeOrthogonal", val);
 }
 
+void Scope::SetFastCalibration(bool val)
+{
+    m_fastCalibration = val;
+    pConfig->Profile.SetBoolean("/scope/FastCalibration", val);
+}
+
+void Scope::SetShortCalibrationExposures(bool val)
+{
+    m_shortCalExposures = val;
+    pConfig->Profile.SetBoolean("/scope/ShortCalibrationExposures", val);
+}
+
 void Scope::EnableStopGuidingWhenSlewing(bool enable)
 {
     if (enable)
@@ -546,95 +593,105 @@ void Scope::AlertLimitReached(int duration, GuideAxis axis)
     }
 }
 
-Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, MountMoveType moveType, MoveResultInfo *moveResult)
+// Apply the guide mode and max duration settings to a guide pulse
+void Scope::LimitGuideDuration(GUIDE_DIRECTION direction, int *pDuration, MountMoveType moveType, bool *pLimitReached)
 {
-    MOVE_RESULT result = MOVE_OK;
-    bool limitReached = false;
+    int& duration = *pDuration;
+    bool& limitReached = *pLimitReached;
 
-    try
+    switch (direction)
     {
-        Debug.Write(wxString::Format("Move(%d, %d, %d)\n", direction, duration, moveType));
+        case NORTH:
+        case SOUTH:
 
-        if (!m_guidingEnabled)
-        {
-            throw THROW_INFO("Guiding disabled");
-        }
-
-        // Compute the actual guide durations
-
-        switch (direction)
-        {
-            case NORTH:
-            case SOUTH:
+            // Do not enforce dec guiding mode and max dec duration for direct moves
+            if (moveType != MOVETYPE_DIRECT)
+            {
+                if ((m_decGuideMode == DEC_NONE) ||
+                    (direction == SOUTH && m_decGuideMode == DEC_NORTH) ||
+                    (direction == NORTH && m_decGuideMode == DEC_SOUTH))
+                {
+                    duration = 0;
+                    Debug.AddLine("duration set to 0 by GuideMode");
+                }
 
-                // Do not enforce dec guiding mode and max dec duration for direct moves
-                if (moveType != MOVETYPE_DIRECT)
+                if (duration > m_maxDecDuration)
                 {
-                    if ((m_decGuideMode == DEC_NONE) ||
-                        (direction == SOUTH && m_decGuideMode == DEC_NORTH) ||
-                        (direction == NORTH && m_decGuideMode == DEC_SOUTH))
-                    {
-                        duration = 0;
-                        Debug.AddLine("duration set to 0 by GuideMode");
-                    }
+                    duration = m_maxDecDuration;
+                    Debug.Write(wxString::Format("duration set to %d by maxDecDuration\n", duration));
+                    limitReached = true;
+                }
 
-                    if (duration > m_maxDecDuration)
-                    {
-                        duration = m_maxDecDuration;
-                        Debug.Write(wxString::Format("duration set to %d by maxDecDuration\n", duration));
-                        limitReached = true;
-                    }
+                if (limitReached && direction == m_decLimitReachedDirection)
+                {
+                    if (++m_decLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
+                        AlertLimitReached(duration, GUIDE_DEC);
+                }
+                else
+                    m_decLimitReachedCount = 0;
 
-                    if (limitReached && direction == m_decLimitReachedDirection)
-                    {
-                        if (++m_decLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
-                            AlertLimitReached(duration, GUIDE_DEC);
-                    }
-                    else
-                        m_decLimitReachedCount = 0;
+                if (limitReached)
+                    m_decLimitReachedDirection = direction;
+                else
+                    m_decLimitReachedDirection = NONE;
+            }
+            break;
+        case EAST:
+        case WEST:
 
-                    if (limitReached)
-                        m_decLimitReachedDirection = direction;
-                    else
-                        m_decLimitReachedDirection = NONE;
+            // Do not enforce max dec duration for direct moves
+            if (moveType != MOVETYPE_DIRECT)
+            {
+                if (duration > m_maxRaDuration)
+                {
+                    duration = m_maxRaDuration;
+                    Debug.Write(wxString::Format("duration set to %d by maxRaDuration\n", duration));
+                    limitReached = true;
                 }
-                break;
-            case EAST:
-            case WEST:
 
-                // Do not enforce max dec duration for direct moves
-                if (moveType != MOVETYPE_DIRECT)
+                if (limitReached && direction == m_raLimitReachedDirection)
                 {
-                    if (duration > m_maxRaDuration)
-                    {
-                        duration = m_maxRaDuration;
-                        Debug.Write(wxString::Format("duration set to %d by maxRaDuration\n", duration));
-                        limitReached = true;
-                    }
+                    if (++m_raLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
+                        AlertLimitReached(duration, GUIDE_RA);
+                }
+                else
+                    m_raLimitReachedCount = 0;
 
-                    if (limitReached && direction == m_raLimitReachedDirection)
-                    {
-                        if (++m_raLimitReachedCount >= LIMIT_REACHED_WARN_COUNT)
-                            AlertLimitReached(duration, GUIDE_RA);
-                    }
-                    else
-                        m_raLimitReachedCount = 0;
+                if (limitReached)
+                    m_raLimitReachedDirection = direction;
+                else
+                    m_raLimitReachedDirection = NONE;
+            }
+            break;
 
-                    if (limitReached)
-                        m_raLimitReachedDirection = direction;
-                    else
-                        m_raLimitReachedDirection = NONE;
-                }
-                break;
+        case NONE:
+            break;
+    }
+}
 
-            case NONE:
-                break;
+Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, MountMoveType moveType, MoveResultInfo *moveResult)
+{
+    MOVE_RESULT result = MOVE_OK;
+    bool limitReached = false;
+
+    try
+    {
+        Debug.Write(wxString::Format("Move(%d, %d, %d)\n", direction, duration, moveType));
+
+        if (!m_guidingEnabled)
+        {
+            throw THROW_INFO("Guiding disabled");
         }
 
+        // Compute the actual guide durations
+        LimitGuideDuration(direction, &duration, moveType, &limitReached);
+
         // Actually do the guide
         assert(duration >= 0);
         if (duration > 0)
         {
+            m_pulseStartUs = PerfTrace::Now();
+            m_pulseCommandUs = -1;
             result = Guide(direction, duration);
             if (result != MOVE_OK)
             {
@@ -661,6 +718,96 @@ Mount::MOVE_RESULT Scope::Move(GUIDE_DIRECTION direction, int duration, MountMov
     return result;
 }
 
+Mount::MOVE_RESULT Scope::MoveAxes(GUIDE_DIRECTION xDirection, int xDuration, GUIDE_DIRECTION yDirection, int yDuration,
+                                   MountMoveType moveType, MoveResultInfo *xMoveResult, MoveResultInfo *yMoveResult)
+{
+    if (!CanGuideConcurrently())
+        return Mount::MoveAxes(xDirection, xDuration, yDirection, yDuration, moveType, xMoveResult, yMoveResult);
+
+    MOVE_RESULT result = MOVE_OK;
+    bool xLimitReached = false;
+    bool yLimitReached = false;
+
+    try
+    {
+        Debug.Write(wxString::Format("MoveAxes(%d, %d, %d, %d, %d)\n", xDirection, xDuration, yDirection, yDuration, moveType));
+
+        if (!m_guidingEnabled)
+        {
+            throw THROW_INFO("Guiding disabled");
+        }
+
+        LimitGuideDuration(xDirection, &xDuration, moveType, &xLimitReached);
+        LimitGuideDuration(yDirection, &yDuration, moveType, &yLimitReached);
+
+        // Both pulses at once, so the move takes as long as the longer of them
+        assert(xDuration >= 0 && yDuration >= 0);
+        if (xDuration > 0 || yDuration > 0)
+        {
+            m_pulseStartUs = PerfTrace::Now();
+            m_pulseCommandUs = -1;
+            result = GuideAxes(xDirection, xDuration, yDirection, yDuration);
+            if (result != MOVE_OK)
+            {
+                throw ERROR_INFO("guide failed");
+            }
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        if (result == MOVE_OK)
+            result = MOVE_ERROR;
+        xDuration = yDuration = 0;
+    }
+
+    Debug.Write(wxString::Format("MoveAxes returns status %d, amounts %d, %d\n", result, xDuration, yDuration));
+
+    if (xMoveResult)
+    {
+        xMoveResult->amountMoved = xDuration;
+        xMoveResult->limited = xLimitReached;
+    }
+    if (yMoveResult)
+    {
+        yMoveResult->amountMoved = yDuration;
+        yMoveResult->limited = yLimitReached;
+    }
+
+    return result;
+}
+
+bool Scope::CanGuideConcurrently(void)
+{
+    return false;
+}
+
+void Scope::MarkPulseCommandAccepted(void)
+{
+    if (m_pulseCommandUs < 0)
+        m_pulseCommandUs = PerfTrace::Now();
+}
+
+double Scope::LastPulseCommandMs(void) const
+{
+    if (m_pulseStartUs < 0 || m_pulseCommandUs < 0)
+        return -1.0;
+    return (double)(m_pulseCommandUs - m_pulseStartUs) / 1000.0;
+}
+
+Mount::MOVE_RESULT Scope::GuideAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration)
+{
+    MOVE_RESULT result = MOVE_OK;
+
+    if (raDuration > 0)
+        result = Guide(raDirection, raDuration);
+
+    if (result == MOVE_OK && decDuration > 0)
+        result = Guide(decDirection, decDuration);
+
+    return result;
+}
+
 static wxString CalibrationWarningKey(CalibrationIssueType etype)
 {
     wxString qual;
@@ -854,6 +1001,7 @@ bool Scope::BeginCalibration(const PHD_Point& currentLocation)
         m_calibrationDetails.raSteps.clear();
         m_calibrationDetails.decSteps.clear();
         m_calibrationDetails.lastIssue = CI_None;
+        m_calibrationFit.Reset();
     }
     catch (const wxString& Msg)
     {
@@ -935,7 +1083,7 @@ bool Scope::DecCompensationActive(void) const
 
 static double CalibrationDistance(void)
 {
-    return wxMin(pCamera->FullSize.GetHeight() * 0.05, MAX_CALIBRATION_DISTANCE);
+    return wxMin(pCamera->FrameSize().GetHeight() * 0.05, MAX_CALIBRATION_DISTANCE);
 }
 
 int Scope::CalibrationTotDistance(void)
@@ -943,6 +1091,48 @@ int Scope::CalibrationTotDistance(void)
     return (int) ceil(CalibrationDistance());
 }
 
+static bool FitIsTight(const CalibrationFit::Result& fit)
+{
+    return 2.0 * fit.rateErr <= FAST_CAL_RATE_TOLERANCE * fit.rate &&
+        2.0 * fit.angleErr <= radians(FAST_CAL_ANGLE_TOLERANCE);
+}
+
+// true when fast calibration has measured the current leg well enough to stop it
+static bool FitConverged(const CalibrationFit& calFit, double dist, double dist_crit, CalibrationFit::Result *fit)
+{
+    if (calFit.SampleCount() < FAST_CAL_MIN_SAMPLES || dist < dist_crit * FAST_CAL_MIN_DISTANCE)
+        return false;
+
+    return !calFit.FitForward(fit) && FitIsTight(*fit);
+}
+
+static void LogCalibrationFit(const char *leg, const CalibrationFit::Result& fit)
+{
+    Debug.Write(wxString::Format("Calibration fit %s: samples=%d rate=%.3f +/- %.3f angle=%.1f +/- %.1f\n",
+        leg, fit.samples, fit.rate * 1000.0, fit.rateErr * 1000.0, degrees(fit.angle), degrees(fit.angleErr)));
+}
+
+// Set the Dec axis from the measured angle (relative to South, see the North
+// calibration) and rate, honoring the assume-orthogonal option
+void Scope::SetMeasuredDecAxis(double yAngle, double yRate)
+{
+    if (m_assumeOrthogonal)
+    {
+        double a1 = norm_angle(m_calibration.xAngle + M_PI / 2.);
+        double a2 = norm_angle(m_calibration.xAngle - M_PI / 2.);
+        m_calibration.yAngle = fabs(norm_angle(a1 - yAngle)) < fabs(norm_angle(a2 - yAngle)) ? a1 : a2;
+        m_calibration.yRate = yRate * cos(yAngle - m_calibration.yAngle);
+
+        Debug.Write(wxString::Format("Assuming orthogonal axes: measured Y angle = %.1f, X angle = %.1f, orthogonal = %.1f, %.1f, best = %.1f, rate = %.3f, dec rate = %.3f\n",
+            degrees(yAngle), degrees(m_calibration.xAngle), degrees(a1), degrees(a2), degrees(m_calibration.yAngle), yRate * 1000.0, m_calibration.yRate * 1000.0));
+    }
+    else
+    {
+        m_calibration.yAngle = yAngle;
+        m_calibration.yRate = yRate;
+    }
+}
+
 // Convert camera coords to mount coords
 static PHD_Point MountCoords(const PHD_Point& cameraVector, double xCalibAngle, double yCalibAngle)
 {
@@ -957,7 +1147,7 @@ static PHD_Point MountCoords(const PHD_Point& cameraVector, double xCalibAngle,
 static void GetRADecCoordinates(PHD_Point *coords)
 {
     double ra, dec, lst;
-    bool err = pPointingSource->GetCoordinates(&ra, &dec, &lst);
+    bool err = PointingCache::GetCoordinates(&ra, &dec, &lst);
     if (err)
         coords->Invalidate();
     else
@@ -985,6 +1175,10 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
         double dY = m_calibrationStartingLocation.dY(currentLocation);
         double dist = m_calibrationStartingLocation.Distance(currentLocation);
         double dist_crit = CalibrationDistance();
+        double now = ::wxGetUTCTimeMillis().ToDouble();
+        double prevSampleTime = m_calibrationSampleTime;
+        CalibrationFit::Result fit;
+        m_calibrationSampleTime = now;
         double blDelta;
         double blCumDelta;
         double nudge_amt;
@@ -1004,8 +1198,9 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 // step number in the log is the step that just finished
                 GuideLog.CalibrationStep(this, "West", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.raSteps.push_back(wxRealPoint(dX, dY));
+                m_calibrationFit.AddSample(PHD_Point(dX, dY), m_calibrationSteps * m_calibrationDuration, now, false);
 
-                if (dist < dist_crit)
+                if (dist < dist_crit && !(m_fastCalibration && FitConverged(m_calibrationFit, dist, dist_crit, &fit)))
                 {
                     if (m_calibrationSteps++ > MAX_CALIBRATION_STEPS)
                     {
@@ -1026,6 +1221,13 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 m_calibration.xAngle = m_calibrationStartingLocation.Angle(currentLocation);
                 m_calibration.xRate = dist / (m_calibrationSteps * m_calibrationDuration);
 
+                if (m_fastCalibration && !m_calibrationFit.FitForward(&fit))
+                {
+                    LogCalibrationFit("West", fit);
+                    m_calibration.xAngle = fit.angle;
+                    m_calibration.xRate = fit.rate;
+                }
+
                 m_calibration.raGuideParity = GUIDE_PARITY_UNKNOWN;
                 if (m_calibrationStartingCoords.IsValid())
                 {
@@ -1076,6 +1278,9 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
 
                 GuideLog.CalibrationStep(this, "East", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.raSteps.push_back(wxRealPoint(dX, dY));
+                // the turning point is already the last West sample
+                if (m_recenterRemaining < m_raSteps * m_calibrationDuration)
+                    m_calibrationFit.AddSample(PHD_Point(dX, dY), m_recenterRemaining, now, true);
 
                 if (m_recenterRemaining > 0)
                 {
@@ -1093,6 +1298,16 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                     break;
                 }
 
+                // the return leg measures the rate again, and lets the fit
+                // separate the rate from any drift of the mount
+                if (m_fastCalibration && !m_calibrationFit.FitBothLegs(&fit) && FitIsTight(fit))
+                {
+                    LogCalibrationFit("West+East", fit);
+                    m_calibration.xAngle = fit.angle;
+                    m_calibration.xRate = fit.rate;
+                }
+                m_calibrationFit.Reset();
+
                 // setup for clear backlash
 
                 m_calibrationSteps = 0;
@@ -1216,6 +1431,7 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                     // log the starting point
                     GuideLog.CalibrationStep(this, "North", 0, 0.0, 0.0, m_blMarkerPoint, 0.0);
                     m_calibrationDetails.decSteps.push_back(wxRealPoint(0.0, 0.0));
+                    m_calibrationFit.AddSample(PHD_Point(0.0, 0.0), 0.0, prevSampleTime, false);
 
                     m_calibrationSteps = 1;
                     m_calibrationStartingLocation = m_blMarkerPoint;
@@ -1240,8 +1456,9 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
 
                 GuideLog.CalibrationStep(this, "North", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.decSteps.push_back(wxRealPoint(dX, dY));
+                m_calibrationFit.AddSample(PHD_Point(dX, dY), m_calibrationSteps * m_calibrationDuration, now, false);
 
-                if (dist < dist_crit)
+                if (dist < dist_crit && !(m_fastCalibration && FitConverged(m_calibrationFit, dist, dist_crit, &fit)))
                 {
                     if (m_calibrationSteps++ > MAX_CALIBRATION_STEPS)
                     {
@@ -1260,22 +1477,15 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 // note: this calculation is reversed from the ra calculation, because
                 // that one was calibrating WEST, but the angle is really relative
                 // to EAST
-                if (m_assumeOrthogonal)
+                if (m_fastCalibration && !m_calibrationFit.FitForward(&fit))
                 {
-                    double a1 = norm_angle(m_calibration.xAngle + M_PI / 2.);
-                    double a2 = norm_angle(m_calibration.xAngle - M_PI / 2.);
-                    double yAngle = currentLocation.Angle(m_calibrationStartingLocation);
-                    m_calibration.yAngle = fabs(norm_angle(a1 - yAngle)) < fabs(norm_angle(a2 - yAngle)) ? a1 : a2;
-                    double dec_dist = dist * cos(yAngle - m_calibration.yAngle);
-                    m_calibration.yRate = dec_dist / (m_calibrationSteps * m_calibrationDuration);
-
-                    Debug.Write(wxString::Format("Assuming orthogonal axes: measured Y angle = %.1f, X angle = %.1f, orthogonal = %.1f, %.1f, best = %.1f, dist = %.2f, dec_dist = %.2f\n",
-                        degrees(yAngle), degrees(m_calibration.xAngle), degrees(a1), degrees(a2), degrees(m_calibration.yAngle), dist, dec_dist));
+                    LogCalibrationFit("North", fit);
+                    SetMeasuredDecAxis(norm_angle(fit.angle + M_PI), fit.rate);
                 }
                 else
                 {
-                    m_calibration.yAngle = currentLocation.Angle(m_calibrationStartingLocation);
-                    m_calibration.yRate = dist / (m_calibrationSteps * m_calibrationDuration);
+                    SetMeasuredDecAxis(currentLocation.Angle(m_calibrationStartingLocation),
+                        dist / (m_calibrationSteps * m_calibrationDuration));
                 }
 
                 m_decSteps = m_calibrationSteps;
@@ -1329,6 +1539,8 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
 
                 GuideLog.CalibrationStep(this, "South", m_calibrationSteps, dX, dY, currentLocation, dist);
                 m_calibrationDetails.decSteps.push_back(wxRealPoint(dX, dY));
+                if (m_recenterRemaining < m_decSteps * m_calibrationDuration)
+                    m_calibrationFit.AddSample(PHD_Point(dX, dY), m_recenterRemaining, now, true);
 
                 if (m_recenterRemaining > 0)
                 {
@@ -1344,6 +1556,15 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                     pFrame->ScheduleCalibrationMove(this, SOUTH, duration);
                     break;
                 }
+
+                // the return-leg offset of the fit absorbs the Dec backlash at the reversal
+                if (m_fastCalibration && !m_calibrationFit.FitBothLegs(&fit) && FitIsTight(fit))
+                {
+                    LogCalibrationFit("North+South", fit);
+                    SetMeasuredDecAxis(norm_angle(fit.angle + M_PI), fit.rate);
+                }
+                m_calibrationFit.Reset();
+
                 m_lastLocation = currentLocation;
                 // Compute the vector for the north moves we made - use it to make sure any nudging is going in the correct direction
                 // These are the direction cosines of the vector
@@ -1410,14 +1631,14 @@ bool Scope::UpdateCalibrationState(const PHD_Point& currentLocation)
                 GetLastCalibration(&m_prevCalibration);
                 GetCalibrationDetails(&m_prevCalibrationDetails);
                 Calibration cal(m_calibration);
-                cal.declination = pPointingSource->GetDeclination();
-                cal.pierSide = pPointingSource->SideOfPier();
+                PointingCache::GetCurrent(&cal.declination, &cal.pierSide);
                 cal.rotatorAngle = Rotator::RotatorPosition();
-                cal.binning = pCamera->Binning;
+                cal.binning = pCamera->EffectiveBinning();
                 SetCalibration(cal);
+                CalibrationStore::Record(this, cal);
                 m_calibrationDetails.raStepCount = m_raSteps;
                 m_calibrationDetails.decStepCount = m_decSteps;
-                SetCalibrationDetails(m_calibrationDetails, m_calibration.xAngle, m_calibration.yAngle, pCamera->Binning);
+                SetCalibrationDetails(m_calibrationDetails, m_calibration.xAngle, m_calibration.yAngle, pCamera->EffectiveBinning());
                 if (SANITY_CHECKING_ACTIVE)
                     SanityCheckCalibration(m_prevCalibration, m_prevCalibrationDetails);  // method gets "new" info itself
                 pFrame->StatusMsg(_("Calibration complete"));
@@ -1551,8 +1772,8 @@ wxString Scope::GetSettingsSummary()
 
 wxString Scope::CalibrationSettingsSummary()
 {
-    return wxString::Format("Calibration Step = %d ms, Assume orthogonal axes = %s", GetCalibrationDuration(),
-        IsAssumeOrthogonal() ? "yes" : "no");
+    return wxString::Format("Calibration Step = %d ms, Assume orthogonal axes = %s, Fast calibration = %s, Short exposures = %s", GetCalibrationDuration(),
+        IsAssumeOrthogonal() ? "yes" : "no", IsFastCalibration() ? "yes" : "no", IsShortCalibrationExposures() ? "yes" : "no");
 }
 
 wxString Scope::GetMountClassName() const
@@ -1639,6 +1860,16 @@ ScopeConfigDialogCtrlSet::ScopeConfigDialogCtrlSet(wxWindow *pParent, Scope *pSc
     AddCtrl(CtrlMap, AD_cbAssumeOrthogonal, m_assumeOrthogonal,
         _("Assume Dec axis is perpendicular to RA axis, regardless of calibration. Prevents RA periodic error from affecting Dec calibration. Option takes effect when calibrating DEC."));
 
+    m_fastCalibration = new wxCheckBox(GetParentWindow(AD_cbFastCalibration), wxID_ANY, _("Fast calibration"));
+    m_fastCalibration->Enable(enableCtrls);
+    AddCtrl(CtrlMap, AD_cbFastCalibration, m_fastCalibration,
+        _("Fit the calibration to every step and stop each direction as soon as the rate and angle are known precisely, instead of always moving the full calibration distance. The return moves are used as measurements too."));
+
+    m_shortCalExposures = new wxCheckBox(GetParentWindow(AD_cbShortCalExposures), wxID_ANY, _("Short exposures"));
+    m_shortCalExposures->Enable(enableCtrls);
+    AddCtrl(CtrlMap, AD_cbShortCalExposures, m_shortCalExposures,
+        _("While calibrating, use the shortest exposure that keeps the star above the auto-exposure SNR target instead of the guide exposure. Calibration only needs the star position."));
+
     if (pScope && !usingAO)
     {
         m_pUseBacklashComp = new wxCheckBox(GetParentWindow(AD_cbDecComp), wxID_ANY, _("Use backlash comp"));
@@ -1679,6 +1910,8 @@ void ScopeConfigDialogCtrlSet::LoadValues()
     if (m_pStopGuidingWhenSlewing)
         m_pStopGuidingWhenSlewing->SetValue(m_pScope->IsStopGuidingWhenSlewingEnabled());
     m_assumeOrthogonal->SetValue(m_pScope->IsAssumeOrthogonal());
+    m_fastCalibration->SetValue(m_pScope->IsFastCalibration());
+    m_shortCalExposures->SetValue(m_pScope->IsShortCalibrationExposures());
     bool usingAO = TheAO() != NULL;
     if (!usingAO)
     {
@@ -1698,6 +1931,8 @@ void ScopeConfigDialogCtrlSet::UnloadValues()
     if (m_pStopGuidingWhenSlewing)
         m_pScope->EnableStopGuidingWhenSlewing(m_pStopGuidingWhenSlewing->GetValue());
     m_pScope->SetAssumeOrthogonal(m_assumeOrthogonal->GetValue());
+    m_pScope->SetFastCalibration(m_fastCalibration->GetValue());
+    m_pScope->SetShortCalibrationExposures(m_shortCalExposures->GetValue());
     bool usingAO = TheAO() != NULL;
     if (!usingAO)
     {
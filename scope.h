@@ -47,6 +47,8 @@ class ScopeConfigDialogCtrlSet : public MountConfigDialogCtrlSet
     wxCheckBox *m_pNeedFlipDec;
     wxCheckBox *m_pStopGuidingWhenSlewing;
     wxCheckBox *m_assumeOrthogonal;
+    wxCheckBox *m_fastCalibration;
+    wxCheckBox *m_shortCalExposures;
     wxSpinCtrl *m_pMaxRaDuration;
     wxSpinCtrl *m_pMaxDecDuration;
     wxChoice   *m_pDecMode;
@@ -106,6 +108,16 @@ class Scope : public Mount
     int m_raSteps;
     int m_decSteps;
 
+    // fast calibration fits every step instead of using the end points
+    bool m_fastCalibration;
+    CalibrationFit m_calibrationFit;
+    double m_calibrationSampleTime;   // time of the previous calibration step, ms
+
+    // calibration frames are exposed only as long as the star position
+    // needs, see MyFrame::AdjustCalibrationExposure
+    bool m_shortCalExposures;
+    int m_shortCalSettleMs;           // wait after each calibration pulse before a short exposure
+
     bool m_calibrationFlipRequiresDecFlip;
     bool m_stopGuidingWhenSlewing;
     Calibration m_prevCalibration;
@@ -114,6 +126,11 @@ class Scope : public Mount
 
     bool m_useDecCompensation;
 
+    // when the current pulse started and when its command was accepted,
+    // PerfTrace::Now() microseconds, -1 if not marked
+    long long m_pulseStartUs;
+    long long m_pulseCommandUs;
+
     enum CALIBRATION_STATE
     {
         CALIBRATION_STATE_CLEARED,
@@ -183,6 +200,7 @@ public:
     virtual wxString GetSettingsSummary();
     virtual wxString CalibrationSettingsSummary();
     virtual wxString GetMountClassName() const;
+    virtual void LoadProfileSettings(void);
 
     static wxArrayString List(void);
     static wxArrayString AuxMountList(void);
@@ -211,6 +229,11 @@ public:
     bool IsStopGuidingWhenSlewingEnabled(void) const;
     void SetAssumeOrthogonal(bool val);
     bool IsAssumeOrthogonal(void) const;
+    void SetFastCalibration(bool val);
+    bool IsFastCalibration(void) const;
+    void SetShortCalibrationExposures(bool val);
+    bool IsShortCalibrationExposures(void) const;
+    int ShortCalibrationSettleMs(void) const;
     void HandleSanityCheckDialog();
     void SetCalibrationWarning(CalibrationIssueType etype, bool val);
 
@@ -231,6 +254,12 @@ public:
     // Does not get called unless guiding was started interactively (by clicking the guide button)
     virtual bool PreparePositionInteractive(void);
     virtual bool CanPulseGuide(void);
+    // can pulse both axes at the same time with GuideAxes
+    virtual bool CanGuideConcurrently(void);
+
+    // time from the start of the last pulse until the driver reported the
+    // command accepted, -1 if the driver does not report it
+    double LastPulseCommandMs(void) const;
 
     virtual void StartDecDrift(void);
     virtual void EndDecDrift(void);
@@ -240,6 +269,9 @@ private:
     // functions with an implemenation in Scope that cannot be over-ridden
     // by a subclass
     MOVE_RESULT Move(GUIDE_DIRECTION direction, int durationMs, MountMoveType moveType, MoveResultInfo *moveResultInfo);
+    MOVE_RESULT MoveAxes(GUIDE_DIRECTION xDirection, int xDurationMs, GUIDE_DIRECTION yDirection, int yDurationMs,
+                         MountMoveType moveType, MoveResultInfo *xMoveResultInfo, MoveResultInfo *yMoveResultInfo);
+    void LimitGuideDuration(GUIDE_DIRECTION direction, int *durationMs, MountMoveType moveType, bool *limitReached);
     MOVE_RESULT CalibrationMove(GUIDE_DIRECTION direction, int duration);
     int CalibrationMoveSize(void);
     int CalibrationTotDistance(void);
@@ -249,10 +281,21 @@ private:
     void SanityCheckCalibration(const Calibration& oldCal, const CalibrationDetails& oldDetails);
 
     void AlertLimitReached(int duration, GuideAxis axis);
+    void LoadSettings(void);
+    void SetMeasuredDecAxis(double yAngle, double yRate);
 
 // these MUST be supplied by a subclass
 private:
     virtual MOVE_RESULT Guide(GUIDE_DIRECTION direction, int durationMs) = 0;
+
+// a subclass that can pulse both axes at once overrides this along with
+// CanGuideConcurrently; the default guides RA then Dec
+protected:
+    virtual MOVE_RESULT GuideAxes(GUIDE_DIRECTION raDirection, int raDurationMs, GUIDE_DIRECTION decDirection, int decDurationMs);
+
+    // a driver whose Guide() only returns when the pulse is over calls this
+    // once the mount has taken the command
+    void MarkPulseCommandAccepted(void);
 };
 
 inline bool Scope::IsStopGuidingWhenSlewingEnabled(void) const
@@ -265,6 +308,21 @@ inline bool Scope::IsAssumeOrthogonal(void) const
     return m_assumeOrthogonal;
 }
 
+inline bool Scope::IsFastCalibration(void) const
+{
+    return m_fastCalibration;
+}
+
+inline bool Scope::IsShortCalibrationExposures(void) const
+{
+    return m_shortCalExposures;
+}
+
+inline int Scope::ShortCalibrationSettleMs(void) const
+{
+    return m_shortCalSettleMs;
+}
+
 inline bool Scope::DecCompensationEnabled() const
 {
     return m_useDecCompensation;
@@ -46,7 +46,11 @@
 #endif  
 
 ScopeINDI::ScopeINDI() 
+    : m_pulseCond(m_pulseLock)
 {
+    m_pulseNS.pending = m_pulseNS.sawBusy = false;
+    m_pulseEW.pending = m_pulseEW.sawBusy = false;
+    m_pulseEvents = false;
     ClearStatus();
     // load the values from the current profile
     INDIhost = pConfig->Profile.GetString("/indi/INDIhost", _T("localhost"));
@@ -258,6 +262,80 @@ void ScopeINDI::newNumber(INumberVectorProperty *nvp)
 {
     // we go here every time a Number value change
     //printf("Mount Receving Number: %s = %g\n", nvp->name, nvp->np->value);
+    if (nvp == pulseGuideNS_prop)
+        PulseUpdate(&m_pulseNS, nvp);
+    else if (nvp == pulseGuideEW_prop)
+        PulseUpdate(&m_pulseEW, nvp);
+}
+
+void ScopeINDI::StartPulse(PulseState *pulse)
+{
+    wxMutexLocker lck(m_pulseLock);
+    pulse->pending = true;
+    pulse->sawBusy = false;
+}
+
+void ScopeINDI::PulseUpdate(PulseState *pulse, INumberVectorProperty *nvp)
+{
+    wxMutexLocker lck(m_pulseLock);
+
+    if (!pulse->pending)
+        return;
+
+    // the first update is the driver's answer to the command
+    MarkPulseCommandAccepted();
+
+    if (nvp->s == IPS_BUSY)
+    {
+        pulse->sawBusy = true;
+        return;
+    }
+
+    // an ok without a busy first is only the driver accepting the command
+    if (nvp->s == IPS_ALERT || pulse->sawBusy)
+    {
+        pulse->pending = false;
+        if (pulse->sawBusy && !m_pulseEvents)
+        {
+            Debug.Write("INDI Mount: driver reports pulse completion\n");
+            m_pulseEvents = true;
+        }
+        m_pulseCond.Broadcast();
+    }
+}
+
+void ScopeINDI::WaitForPulses(int durationMs)
+{
+    enum { PULSE_GRACE_MS = 1000 };
+
+    wxMutexLocker lck(m_pulseLock);
+
+    if (m_pulseEvents)
+    {
+        // returns as soon as the driver ends the pulse, which may also be
+        // later than the requested duration
+        wxStopWatch swatch;
+        while (m_pulseNS.pending || m_pulseEW.pending)
+        {
+            long remaining = durationMs + PULSE_GRACE_MS - swatch.Time();
+            if (remaining <= 0 || m_pulseCond.WaitTimeout(remaining) == wxCOND_TIMEOUT)
+            {
+                Debug.Write(wxString::Format("INDI Mount: no pulse completion after %ld ms\n", swatch.Time()));
+                break;
+            }
+        }
+    }
+    else
+    {
+        // until the driver has shown it reports completion, just wait out
+        // the pulse; updates that arrive meanwhile are still tracked
+        m_pulseLock.Unlock();
+        wxMilliSleep(durationMs);
+        m_pulseLock.Lock();
+    }
+
+    m_pulseNS.pending = false;
+    m_pulseEW.pending = false;
 }
 
 void ScopeINDI::newText(ITextVectorProperty *tvp)
@@ -356,28 +434,32 @@ Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration)
         case EAST:
 	    pulseE_prop->value = duration;
 	    pulseW_prop->value = 0;
+	    StartPulse(&m_pulseEW);
 	    sendNewNumber(pulseGuideEW_prop);
             break;
         case WEST:
 	    pulseE_prop->value = 0;
 	    pulseW_prop->value = duration;
+	    StartPulse(&m_pulseEW);
 	    sendNewNumber(pulseGuideEW_prop);
             break;
         case NORTH:
 	    pulseN_prop->value = duration;
 	    pulseS_prop->value = 0;
+	    StartPulse(&m_pulseNS);
 	    sendNewNumber(pulseGuideNS_prop);
             break;
         case SOUTH:
 	    pulseN_prop->value = 0;
 	    pulseS_prop->value = duration;
+	    StartPulse(&m_pulseNS);
 	    sendNewNumber(pulseGuideNS_prop);
             break;
         case NONE:
 	    printf("error ScopeINDI::Guide NONE\n");
             break;
     }
-    wxMilliSleep(duration);
+    WaitForPulses(duration);
     return MOVE_OK;
   }
   // guide using motion rate and telescope motion
@@ -431,6 +513,26 @@ Mount::MOVE_RESULT ScopeINDI::Guide(GUIDE_DIRECTION direction, int duration)
   else return MOVE_ERROR;
 }
 
+Mount::MOVE_RESULT ScopeINDI::GuideAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration)
+{
+    // the driver times each pulse, so both axes can be sent before waiting
+    if (raDuration <= 0 || decDuration <= 0 || !CanPulseGuide())
+        return Scope::GuideAxes(raDirection, raDuration, decDirection, decDuration);
+
+    pulseE_prop->value = raDirection == EAST ? raDuration : 0;
+    pulseW_prop->value = raDirection == WEST ? raDuration : 0;
+    StartPulse(&m_pulseEW);
+    sendNewNumber(pulseGuideEW_prop);
+
+    pulseN_prop->value = decDirection == NORTH ? decDuration : 0;
+    pulseS_prop->value = decDirection == SOUTH ? decDuration : 0;
+    StartPulse(&m_pulseNS);
+    sendNewNumber(pulseGuideNS_prop);
+
+    WaitForPulses(wxMax(raDuration, decDuration));
+    return MOVE_OK;
+}
+
 double ScopeINDI::GetDeclination(void)
 {
     if (coord_prop) {
@@ -76,6 +76,24 @@ private:
     bool     modal;
     bool     ready;
     bool     eod_coord;
+
+    // Timed pulses are tracked through the driver's updates of the pulse
+    // properties, which arrive on the INDI client thread. A pulse is done
+    // when its property goes busy and then back to idle or ok.
+    struct PulseState
+    {
+        bool pending;       // sent, completion not seen yet
+        bool sawBusy;       // the driver has reported the pulse running
+    };
+    wxMutex     m_pulseLock;
+    wxCondition m_pulseCond;
+    PulseState  m_pulseNS;
+    PulseState  m_pulseEW;
+    bool        m_pulseEvents;  // the driver reports pulse completion, so Guide waits for it
+    void     StartPulse(PulseState *pulse);
+    void     PulseUpdate(PulseState *pulse, INumberVectorProperty *nvp);
+    void     WaitForPulses(int durationMs);
+
     void     ClearStatus();
     void     CheckState();
     
@@ -103,8 +121,10 @@ public:
     void     SetupDialog();
 
     MOVE_RESULT Guide(GUIDE_DIRECTION direction, int duration);
+    MOVE_RESULT GuideAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration);
 
     bool   CanPulseGuide() { return (pulseGuideNS_prop && pulseGuideEW_prop);}
+    bool   CanGuideConcurrently(void) { return CanPulseGuide(); }
     bool   CanReportPosition(void) { return (coord_prop); }
     bool   CanSlew(void) { return (coord_prop);}
     bool   CanSlewAsync(void);
@@ -55,6 +55,8 @@ ScopeASCOM::ScopeASCOM(const wxString& choice)
 {
     m_choice = choice;
     m_canPulseGuide = false;                           // will get updated in Connect()
+    m_asyncPulseGuide = false;
+    m_concurrentGuideFailed = false;
 
     dispid_connected = DISPID_UNKNOWN;
     dispid_ispulseguiding = DISPID_UNKNOWN;
@@ -85,6 +87,15 @@ static wxString displayName(const wxString& ascomName)
 
 // map descriptive name to progid
 static std::map<wxString, wxString> s_progid;
+// the device lists are enumerated on a background thread
+static wxCriticalSection s_progidLock;
+
+static wxString ProgId(const wxString& choice)
+{
+    wxCriticalSectionLocker lck(s_progidLock);
+    std::map<wxString, wxString>::const_iterator it = s_progid.find(choice);
+    return it != s_progid.end() ? it->second : wxString();
+}
 
 wxArrayString ScopeASCOM::EnumAscomScopes()
 {
@@ -122,7 +133,10 @@ wxArrayString ScopeASCOM::EnumAscomScopes()
                     wxString ascomName = vval.bstrVal;
                     wxString displName = displayName(ascomName);
                     wxString progid = vkey.bstrVal;
-                    s_progid[displName] = progid;
+                    {
+                        wxCriticalSectionLocker lck(s_progidLock);
+                        s_progid[displName] = progid;
+                    }
                     list.Add(displName);
                 }
             }
@@ -148,7 +162,14 @@ bool ScopeASCOM::Create(DispatchObj& obj)
             return true;
         }
 
-        wxBasicString progid(s_progid[m_choice]);
+        wxString id = ProgId(m_choice);
+        if (id.IsEmpty())
+        {
+            // the choice was made before the device list was enumerated
+            EnumAscomScopes();
+            id = ProgId(m_choice);
+        }
+        wxBasicString progid(id);
 
         if (!obj.Create(progid))
         {
@@ -362,6 +383,10 @@ bool ScopeASCOM::Connect(void)
             m_canPulseGuide = false;
         }
 
+        // learned from the first pulses
+        m_asyncPulseGuide = false;
+        m_concurrentGuideFailed = false;
+
         // see if scope can slew
         m_canSlewAsync = false;
         if (m_canSlew)
@@ -471,6 +496,151 @@ static void SuppressPulseGuideFailedAlert(long)
     pConfig->Global.SetBoolean(PulseGuideFailedAlertEnabledKey(), false);
 }
 
+// wait for a pulse still running from a previous move to complete
+void ScopeASCOM::WaitForPulseGuideIdle(DispatchObj *scope, MOVE_RESULT *result)
+{
+    if (IsGuiding(scope))
+    {
+        Debug.Write("Entered PulseGuideScope while moving\n");
+        int i;
+        for (i = 0; i < 20; i++)
+        {
+            wxMilliSleep(50);
+
+            CheckSlewing(scope, result);
+
+            if (!IsGuiding(scope))
+                break;
+
+            Debug.Write("Still moving\n");
+        }
+        if (i == 20)
+        {
+            Debug.Write("Still moving after 1s - aborting\n");
+            throw ERROR_INFO("ASCOM Scope: scope is still moving after 1 second");
+        }
+        else
+        {
+            Debug.Write("Movement stopped - continuing\n");
+        }
+    }
+}
+
+void ScopeASCOM::PulseGuide(DispatchObj *scope, GUIDE_DIRECTION direction, int duration)
+{
+    VARIANTARG rgvarg[2];
+    rgvarg[1].vt = VT_I2;
+    rgvarg[1].iVal = direction;
+    rgvarg[0].vt = VT_I4;
+    rgvarg[0].lVal = (long) duration;
+
+    DISPPARAMS dispParms;
+    dispParms.cArgs = 2;
+    dispParms.rgvarg = rgvarg;
+    dispParms.cNamedArgs = 0;
+    dispParms.rgdispidNamedArgs = NULL;
+
+    HRESULT hr;
+    EXCEPINFO excep;
+    Variant vRes;
+
+    if (FAILED(hr = scope->IDisp()->Invoke(dispid_pulseguide, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD,
+        &dispParms, &vRes, &excep, NULL)))
+    {
+        Debug.Write(wxString::Format("pulseguide: [%x] %s\n", hr, _com_error(hr).ErrorMessage()));
+
+        // Make sure nothing got by us and the mount can really handle pulse guide - HIGHLY unlikely
+        if (scope->GetProp(&vRes, L"CanPulseGuide") && vRes.boolVal != VARIANT_TRUE)
+        {
+            Debug.Write("Tried to guide mount that has no PulseGuide support\n");
+            // This will trigger a nice alert the next time through Guide
+            m_canPulseGuide = false;
+        }
+        throw ERROR_INFO("ASCOM Scope: pulseguide command failed: " + ExcepMsg(excep));
+    }
+}
+
+// wait until duration ms after swatch was started, then for the driver to
+// report that the pulses are done
+void ScopeASCOM::WaitForPulseGuideComplete(DispatchObj *scope, const wxStopWatch& swatch, int duration, MOVE_RESULT *result)
+{
+    long elapsed = swatch.Time();
+    if (elapsed < (long)duration)
+    {
+        unsigned long rem = (unsigned long)((long)duration - elapsed);
+
+        Debug.Write(wxString::Format("PulseGuide returned control before completion, sleep %lu\n", rem + 10));
+
+        if (WorkerThread::MilliSleep(rem + 10))
+            throw ERROR_INFO("ASCOM Scope: thread terminate requested");
+    }
+
+    if (IsGuiding(scope))
+    {
+        Debug.Write("scope still moving after pulse duration time elapsed\n");
+
+        // try waiting a little longer. If scope does not stop moving after 1 second, try doing AbortSlew
+        // if it still does not stop after 2 seconds, bail out with an error
+
+        enum { GRACE_PERIOD_MS = 1000,
+               TIMEOUT_MS = GRACE_PERIOD_MS + 1000, };
+
+        bool timeoutExceeded = false;
+        bool didAbortSlew = false;
+
+        while (true)
+        {
+            ::wxMilliSleep(20);
+
+            if (WorkerThread::InterruptRequested())
+                throw ERROR_INFO("ASCOM Scope: thread interrupt requested");
+
+            CheckSlewing(scope, result);
+
+            if (!IsGuiding(scope))
+            {
+                Debug.Write(wxString::Format("scope move finished after %ld + %ld ms\n", (long)duration, swatch.Time() - (long)duration));
+                break;
+            }
+
+            long now = swatch.Time();
+
+            if (!didAbortSlew && now > duration + GRACE_PERIOD_MS && m_abortSlewWhenGuidingStuck)
+            {
+                Debug.Write(wxString::Format("scope still moving after %ld + %ld ms, try aborting slew\n", (long)duration, now - (long)duration));
+                AbortSlew(scope);
+                didAbortSlew = true;
+                continue;
+            }
+
+            if (now > duration + TIMEOUT_MS)
+            {
+                timeoutExceeded = true;
+                break;
+            }
+        }
+
+        if (timeoutExceeded && IsGuiding(scope))
+        {
+            throw ERROR_INFO("timeout exceeded waiting for guiding pulse to complete");
+        }
+    }
+}
+
+void ScopeASCOM::ReportGuideError(MOVE_RESULT *result)
+{
+    if (*result == MOVE_OK)
+    {
+        *result = MOVE_ERROR;
+
+        if (!WorkerThread::InterruptRequested())
+        {
+            pFrame->SuppressableAlert(PulseGuideFailedAlertEnabledKey(), _("PulseGuide command to mount has failed - guiding is likely to be ineffective."),
+                SuppressPulseGuideFailedAlert, 0);
+        }
+    }
+}
+
 Mount::MOVE_RESULT ScopeASCOM::Guide(GUIDE_DIRECTION direction, int duration)
 {
     MOVE_RESULT result = MOVE_OK;
@@ -497,143 +667,99 @@ Mount::MOVE_RESULT ScopeASCOM::Guide(GUIDE_DIRECTION direction, int duration)
 
         CheckSlewing(&scope, &result);
 
-        if (IsGuiding(&scope))
-        {
-            Debug.Write("Entered PulseGuideScope while moving\n");
-            int i;
-            for (i = 0; i < 20; i++)
-            {
-                wxMilliSleep(50);
-
-                CheckSlewing(&scope, &result);
-
-                if (!IsGuiding(&scope))
-                    break;
-
-                Debug.Write("Still moving\n");
-            }
-            if (i == 20)
-            {
-                Debug.Write("Still moving after 1s - aborting\n");
-                throw ERROR_INFO("ASCOM Scope: scope is still moving after 1 second");
-            }
-            else
-            {
-                Debug.Write("Movement stopped - continuing\n");
-            }
-        }
+        WaitForPulseGuideIdle(&scope, &result);
 
         // Do the move
 
-        VARIANTARG rgvarg[2];
-        rgvarg[1].vt = VT_I2;
-        rgvarg[1].iVal = direction;
-        rgvarg[0].vt = VT_I4;
-        rgvarg[0].lVal = (long) duration;
-
-        DISPPARAMS dispParms;
-        dispParms.cArgs = 2;
-        dispParms.rgvarg = rgvarg;
-        dispParms.cNamedArgs = 0;
-        dispParms.rgdispidNamedArgs = NULL;
-
         wxStopWatch swatch;
 
-        HRESULT hr;
-        EXCEPINFO excep;
-        Variant vRes;
+        PulseGuide(&scope, direction, duration);
 
-        if (FAILED(hr = scope.IDisp()->Invoke(dispid_pulseguide, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD,
-            &dispParms, &vRes, &excep, NULL)))
-        {
-            Debug.Write(wxString::Format("pulseguide: [%x] %s\n", hr, _com_error(hr).ErrorMessage()));
+        if (m_asyncPulseGuide)
+            MarkPulseCommandAccepted();
 
-            // Make sure nothing got by us and the mount can really handle pulse guide - HIGHLY unlikely
-            if (scope.GetProp(&vRes, L"CanPulseGuide") && vRes.boolVal != VARIANT_TRUE)
+        // a driver that returns before the pulse is over can be given the
+        // other axis while this one is still moving
+        if (duration >= 100 && m_canCheckPulseGuiding)
+        {
+            bool async = swatch.Time() < duration / 2;
+            if (async != m_asyncPulseGuide)
             {
-                Debug.Write("Tried to guide mount that has no PulseGuide support\n");
-                // This will trigger a nice alert the next time through Guide
-                m_canPulseGuide = false;
+                Debug.Write(wxString::Format("ASCOM Scope: PulseGuide is %s\n", async ? "asynchronous" : "synchronous"));
+                m_asyncPulseGuide = async;
             }
-            throw ERROR_INFO("ASCOM Scope: pulseguide command failed: " + ExcepMsg(excep));
         }
 
-        long elapsed = swatch.Time();
-        if (elapsed < (long)duration)
-        {
-            unsigned long rem = (unsigned long)((long)duration - elapsed);
+        WaitForPulseGuideComplete(&scope, swatch, duration, &result);
+    }
+    catch (const wxString& msg)
+    {
+        POSSIBLY_UNUSED(msg);
+        ReportGuideError(&result);
+    }
 
-            Debug.Write(wxString::Format("PulseGuide returned control before completion, sleep %lu\n", rem + 10));
+    if (result == MOVE_STOP_GUIDING)
+    {
+        pFrame->SuppressableAlert(SlewWarningEnabledKey(), _("Guiding stopped: the scope started slewing."),
+            SuppressSlewAlert, 0);
+    }
 
-            if (WorkerThread::MilliSleep(rem + 10))
-                throw ERROR_INFO("ASCOM Scope: thread terminate requested");
-        }
+    return result;
+}
 
-        if (IsGuiding(&scope))
-        {
-            Debug.Write("scope still moving after pulse duration time elapsed\n");
+bool ScopeASCOM::CanGuideConcurrently(void)
+{
+    return m_canPulseGuide && m_canCheckPulseGuiding && m_asyncPulseGuide && !m_concurrentGuideFailed;
+}
 
-            // try waiting a little longer. If scope does not stop moving after 1 second, try doing AbortSlew
-            // if it still does not stop after 2 seconds, bail out with an error
+Mount::MOVE_RESULT ScopeASCOM::GuideAxes(GUIDE_DIRECTION raDirection, int raDuration, GUIDE_DIRECTION decDirection, int decDuration)
+{
+    if (raDuration <= 0 || decDuration <= 0 || !CanGuideConcurrently() || !IsConnected())
+        return Scope::GuideAxes(raDirection, raDuration, decDirection, decDuration);
 
-            enum { GRACE_PERIOD_MS = 1000,
-                   TIMEOUT_MS = GRACE_PERIOD_MS + 1000, };
+    MOVE_RESULT result = MOVE_OK;
 
-            bool timeoutExceeded = false;
-            bool didAbortSlew = false;
+    try
+    {
+        Debug.Write(wxString::Format("Guiding  Dir = %d, Dur = %d and Dir = %d, Dur = %d\n", raDirection, raDuration,
+            decDirection, decDuration));
 
-            while (true)
-            {
-                ::wxMilliSleep(20);
+        GITObjRef scope(m_gitEntry);
 
-                if (WorkerThread::InterruptRequested())
-                    throw ERROR_INFO("ASCOM Scope: thread interrupt requested");
+        CheckSlewing(&scope, &result);
 
-                CheckSlewing(&scope, &result);
+        WaitForPulseGuideIdle(&scope, &result);
 
-                if (!IsGuiding(&scope))
-                {
-                    Debug.Write(wxString::Format("scope move finished after %ld + %ld ms\n", (long)duration, swatch.Time() - (long)duration));
-                    break;
-                }
+        wxStopWatch swatch;
 
-                long now = swatch.Time();
+        PulseGuide(&scope, raDirection, raDuration);
 
-                if (!didAbortSlew && now > duration + GRACE_PERIOD_MS && m_abortSlewWhenGuidingStuck)
-                {
-                    Debug.Write(wxString::Format("scope still moving after %ld + %ld ms, try aborting slew\n", (long)duration, now - (long)duration));
-                    AbortSlew(&scope);
-                    didAbortSlew = true;
-                    continue;
-                }
+        int duration = wxMax(raDuration, decDuration);
 
-                if (now > duration + TIMEOUT_MS)
-                {
-                    timeoutExceeded = true;
-                    break;
-                }
-            }
+        try
+        {
+            PulseGuide(&scope, decDirection, decDuration);
+        }
+        catch (const wxString& msg)
+        {
+            POSSIBLY_UNUSED(msg);
 
-            if (timeoutExceeded && IsGuiding(&scope))
-            {
-                throw ERROR_INFO("timeout exceeded waiting for guiding pulse to complete");
-            }
+            // the driver would not take a pulse on the second axis while the
+            // first was moving; finish the RA pulse and send Dec on its own
+            Debug.Write("ASCOM Scope: concurrent PulseGuide rejected, guiding the axes one at a time from now on\n");
+            m_concurrentGuideFailed = true;
+            WaitForPulseGuideComplete(&scope, swatch, raDuration, &result);
+            swatch.Start();
+            PulseGuide(&scope, decDirection, decDuration);
+            duration = decDuration;
         }
+
+        WaitForPulseGuideComplete(&scope, swatch, duration, &result);
     }
     catch (const wxString& msg)
     {
         POSSIBLY_UNUSED(msg);
-
-        if (result == MOVE_OK)
-        {
-            result = MOVE_ERROR;
-
-            if (!WorkerThread::InterruptRequested())
-            {
-                pFrame->SuppressableAlert(PulseGuideFailedAlertEnabledKey(), _("PulseGuide command to mount has failed - guiding is likely to be ineffective."),
-                    SuppressPulseGuideFailedAlert, 0);
-            }
-        }
+        ReportGuideError(&result);
     }
 
     if (result == MOVE_STOP_GUIDING)
@@ -71,6 +71,8 @@ class ScopeASCOM : public Scope
     bool m_canSlew;
     bool m_canSlewAsync;
     bool m_canPulseGuide;
+    bool m_asyncPulseGuide;         // PulseGuide returns before the pulse is over
+    bool m_concurrentGuideFailed;   // the driver rejected a pulse on one axis while the other was moving
 
     bool m_abortSlewWhenGuidingStuck;
 
@@ -81,6 +83,10 @@ class ScopeASCOM : public Scope
     bool IsGuiding(DispatchObj *pScopeDriver);
     bool IsSlewing(DispatchObj *pScopeDriver);
     void AbortSlew(DispatchObj *pScopeDriver);
+    void WaitForPulseGuideIdle(DispatchObj *pScopeDriver, MOVE_RESULT *result);
+    void PulseGuide(DispatchObj *pScopeDriver, GUIDE_DIRECTION direction, int duration);
+    void WaitForPulseGuideComplete(DispatchObj *pScopeDriver, const wxStopWatch& swatch, int duration, MOVE_RESULT *result);
+    void ReportGuideError(MOVE_RESULT *result);
 
 public:
     ScopeASCOM(const wxString& choice);
@@ -89,6 +95,7 @@ public:
 
     bool Connect(void);
     bool Disconnect(void);
+    bool CanConnectInBackground(void) const { return true; }
 
     bool HasSetupDialog(void) const;
     void SetupDialog(void);
@@ -96,6 +103,8 @@ public:
     bool HasNonGuiMove(void);
 
     MOVE_RESULT Guide(GUIDE_DIRECTION direction, int durationMs);
+    MOVE_RESULT GuideAxes(GUIDE_DIRECTION raDirection, int raDurationMs, GUIDE_DIRECTION decDirection, int decDurationMs);
+    bool CanGuideConcurrently(void);
 
     double GetDeclination(void);
     bool GetGuideRates(double *pRAGuideRate, double *pDecGuideRate);
@@ -555,6 +555,7 @@ Mount::MOVE_RESULT ScopeGpUsb::Guide(GUIDE_DIRECTION direction, int duration)
         case WEST: GPUSB_RAPAssert(); break;
         case NONE: break;
     }
+    MarkPulseCommandAccepted();
     WorkerThread::MilliSleep(duration, WorkerThread::INT_ANY);
     GPUSB_AllDirDeassert();
     GPUSB_LEDRed();
@@ -39,6 +39,7 @@
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <errno.h>
 
 wxArrayString SerialPortPosix::GetSerialPortList(void)
@@ -58,6 +59,7 @@ wxArrayString SerialPortPosix::GetSerialPortList(void)
 SerialPortPosix::SerialPortPosix(void)
 {
     m_fd = -1;
+    m_timeoutMs = 0;
 }
 
 SerialPortPosix::~SerialPortPosix(void)
@@ -133,6 +135,8 @@ bool SerialPortPosix::Connect(const wxString& portName, int baud, int dataBits,
         attr.c_lflag &= ~ICANON; // Do not wait for a line delimiter. Work in noncanonical mode.
         attr.c_lflag &= ~( ECHO | ECHOE | ISIG | IEXTEN | NOFLSH | TOSTOP); // local modes
         attr.c_lflag |=  NOFLSH;
+        // reads never block in the driver, Receive waits in poll() so that
+        // timeouts have millisecond rather than decisecond resolution
         attr.c_cc[VTIME] = (uint8_t)0; // timeout in deciseconds
         attr.c_cc[VMIN]  = (uint8_t)0; // minimum number of characters for noncanonical read
 
@@ -214,16 +218,12 @@ bool SerialPortPosix::SetReceiveTimeout(int timeoutMilliSeconds)
 
     Debug.AddLine(wxString::Format("SerialPortPosix::SetReceiveTimeout %d ms", timeoutMilliSeconds));
     try {
-        struct termios attr;
-
-        if (tcgetattr(m_fd, &attr) < 0 ) {
-            throw ERROR_INFO("tcgetattr failed");
-        }
-        int timeoutDeciSeconds = (timeoutMilliSeconds + 99) / 100;
-        attr.c_cc[VTIME] = (uint8_t)timeoutDeciSeconds;
-        if (tcsetattr(m_fd, TCSAFLUSH, &attr) < 0 ) {
-            throw ERROR_INFO("tcsetattr failed");
+        // callers rely on a timeout change discarding unread input, as the
+        // TCSAFLUSH attribute change used to
+        if (tcdrain(m_fd) < 0 || tcflush(m_fd, TCIFLUSH) < 0) {
+            throw ERROR_INFO("tcflush failed");
         }
+        m_timeoutMs = timeoutMilliSeconds;
     } catch (wxString Msg) {
         POSSIBLY_UNUSED(Msg);
         bError = true;
@@ -266,8 +266,25 @@ bool SerialPortPosix::Receive(unsigned char *pData, unsigned count)
         const unsigned int originalCount = count;
         
         do {
+            struct pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            int ready = poll(&pfd, 1, m_timeoutMs);
+            if (ready == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw ERROR_INFO("SerialPortPosix: poll failed");
+            }
+            if (ready == 0) {
+                break; // timed out
+            }
+
             const ssize_t receiveCount = read(m_fd, pData, count);
             if (receiveCount == -1){
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
                 throw ERROR_INFO("SerialPortPosix: read Failed");
             }
             if (receiveCount == 0){
@@ -279,7 +296,7 @@ bool SerialPortPosix::Receive(unsigned char *pData, unsigned count)
         } while(count > 0);
         
         if (count > 0){
-            throw ERROR_INFO("SerialPortPosix: " + wxString::Format(wxT("%i"),count) + " remaining bytes to read at eof " + ", expected total of " + wxString::Format(wxT("%i"),originalCount));
+            throw ERROR_INFO("SerialPortPosix: " + wxString::Format(wxT("%i"),count) + " remaining bytes to read at eof or timeout " + ", expected total of " + wxString::Format(wxT("%i"),originalCount));
         }
         
     } catch (wxString Msg) {
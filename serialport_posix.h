@@ -42,6 +42,7 @@
 class SerialPortPosix : public SerialPort
 {
     int m_fd;
+    int m_timeoutMs;        // how long Receive waits for each chunk of data
 #if defined (__APPLE__)
     struct termios m_originalAttrs;
 #endif 
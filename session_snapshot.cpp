@@ -0,0 +1,401 @@
+/*
+ *  session_snapshot.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <wx/ffile.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
+static const int DefaultInterval = 60;     // seconds
+static const int DefaultMaxAge = 240;      // minutes
+
+// what a snapshot holds, one line each in the file:
+//
+//   time <UTC ms>
+//   exposure <ms>
+//   lock <x> <y> <sticky>
+//   star <x> <y>
+//   darks <0|1>
+//   defects <0|1>
+//   cal<m> <mount class> <xRate> <yRate> <xAngle> <yAngle> <declination> <rotatorAngle> <binning> <pierSide> <raParity> <decParity>
+//   algo<m> <axis> <GUIDE_ALGORITHM> <algorithm state>
+//   blc<m> <backlash state>
+//
+// where <m> is 0 for the primary mount and 1 for the secondary
+struct SessionState
+{
+    wxLongLong_t time;
+    int exposure;
+    PHD_Point lock;
+    bool sticky;
+    PHD_Point star;
+    bool darks;
+    bool defects;
+    wxString mountClass[2];
+    Calibration cal[2];
+    int algorithm[2][2];        // [mount][axis]
+    wxString algoState[2][2];
+    wxString blcState[2];
+
+    SessionState() : time(0), exposure(0), sticky(false), darks(false), defects(false)
+    {
+        for (int m = 0; m < 2; m++)
+            for (int a = 0; a < 2; a++)
+                algorithm[m][a] = -1;
+    }
+};
+
+static wxLongLong_t s_lastSaveMs;
+
+static wxString SnapshotFileName(int profileId)
+{
+    int inst = pFrame->GetInstanceNumber();
+    return MyFrame::GetDefaultFileDir() + PATHSEPSTR +
+        wxString::Format("PHD2_session%s_%d.txt", inst > 1 ? wxString::Format("_%d", inst) : "", profileId);
+}
+
+static Mount *SnapshotMount(int m)
+{
+    return m == 0 ? pMount : pSecondaryMount;
+}
+
+static bool MountsIdle(void)
+{
+    return (!pMount || !pMount->IsBusy()) && (!pSecondaryMount || !pSecondaryMount->IsBusy());
+}
+
+static void Collect(SessionState *s)
+{
+    Guider *guider = pFrame->pGuider;
+
+    s->time = wxGetUTCTimeMillis().GetValue();
+    s->exposure = pFrame->RequestedExposureDuration();
+    s->lock = guider->LockPosition();
+    s->sticky = guider->LockPosIsSticky();
+    s->star = guider->CurrentPosition();
+    s->darks = pCamera && pCamera->CurrentDarkFrame;
+    s->defects = pCamera && pCamera->CurrentDefectMap;
+
+    for (int m = 0; m < 2; m++)
+    {
+        Mount *mount = SnapshotMount(m);
+        if (!mount || !mount->IsCalibrated())
+            continue;
+        s->mountClass[m] = mount->GetMountClassName();
+        // as measured; the guider adjusts it for the pointing when guiding starts
+        mount->GetLastCalibration(&s->cal[m]);
+        if (!s->cal[m].isValid)
+        {
+            s->mountClass[m].clear();
+            continue;
+        }
+
+        GuideAlgorithm *algo[2] = { mount->GetXGuideAlgorithm(), mount->GetYGuideAlgorithm() };
+        for (int a = 0; a < 2; a++)
+        {
+            if (!algo[a])
+                continue;
+            s->algorithm[m][a] = algo[a]->Algorithm();
+            s->algoState[m][a] = algo[a]->SaveState();
+        }
+        if (mount->GetBacklashComp())
+            s->blcState[m] = mount->GetBacklashComp()->SaveState();
+    }
+}
+
+// returns true on error
+static bool Write(const wxString& fname, const SessionState& s)
+{
+    // written aside and renamed, so a crash while writing leaves the previous snapshot
+    wxString tmp = fname + ".tmp";
+    wxFFile f(tmp, "w");
+    if (!f.IsOpened())
+        return true;
+
+    f.Write(wxString::Format("# PHD2 %s session snapshot\n", FULLVER));
+    f.Write(wxString::Format("time %lld\n", (long long) s.time));
+    f.Write(wxString::Format("exposure %d\n", s.exposure));
+    if (s.lock.IsValid())
+        f.Write(wxString::Format("lock %.3f %.3f %d\n", s.lock.X, s.lock.Y, s.sticky));
+    if (s.star.IsValid())
+        f.Write(wxString::Format("star %.3f %.3f\n", s.star.X, s.star.Y));
+    f.Write(wxString::Format("darks %d\n", s.darks));
+    f.Write(wxString::Format("defects %d\n", s.defects));
+
+    for (int m = 0; m < 2; m++)
+    {
+        if (s.mountClass[m].IsEmpty())
+            continue;
+        const Calibration& c = s.cal[m];
+        f.Write(wxString::Format("cal%d %s %.9g %.9g %.9g %.9g %.9g %.9g %d %d %d %d\n", m, s.mountClass[m],
+            c.xRate, c.yRate, c.xAngle, c.yAngle, c.declination, c.rotatorAngle, c.binning, c.pierSide,
+            c.raGuideParity, c.decGuideParity));
+        for (int a = 0; a < 2; a++)
+        {
+            if (!s.algoState[m][a].IsEmpty())
+                f.Write(wxString::Format("algo%d %d %d %s\n", m, a, s.algorithm[m][a], s.algoState[m][a]));
+        }
+        if (!s.blcState[m].IsEmpty())
+            f.Write(wxString::Format("blc%d %s\n", m, s.blcState[m]));
+    }
+
+    if (!f.Close())
+        return true;
+    return !wxRenameFile(tmp, fname, true);
+}
+
+static GuideParity ToParity(long v)
+{
+    return v == GUIDE_PARITY_EVEN ? GUIDE_PARITY_EVEN : v == GUIDE_PARITY_ODD ? GUIDE_PARITY_ODD : GUIDE_PARITY_UNKNOWN;
+}
+
+static bool ParseCalibration(wxStringTokenizer& tok, wxString *mountClass, Calibration *c)
+{
+    *mountClass = tok.GetNextToken();
+    double v[6];
+    for (int i = 0; i < 6; i++)
+        if (!tok.GetNextToken().ToCDouble(&v[i]))
+            return true;
+    long n[4];
+    for (int i = 0; i < 4; i++)
+        if (!tok.GetNextToken().ToLong(&n[i]))
+            return true;
+
+    c->xRate = v[0];
+    c->yRate = v[1];
+    c->xAngle = v[2];
+    c->yAngle = v[3];
+    c->declination = v[4];
+    c->rotatorAngle = v[5];
+    c->binning = (unsigned short) wxMax(1L, n[0]);
+    c->pierSide = n[1] == PIER_SIDE_EAST ? PIER_SIDE_EAST : n[1] == PIER_SIDE_WEST ? PIER_SIDE_WEST : PIER_SIDE_UNKNOWN;
+    c->raGuideParity = ToParity(n[2]);
+    c->decGuideParity = ToParity(n[3]);
+    c->isValid = true;
+    return false;
+}
+
+// returns true on error
+static bool Read(const wxString& fname, SessionState *s)
+{
+    wxTextFile f;
+    if (!f.Open(fname))
+        return true;
+
+    for (wxString line = f.GetFirstLine(); !f.Eof(); line = f.GetNextLine())
+    {
+        line.Trim(true).Trim(false);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        wxStringTokenizer tok(line, " ");
+        wxString key = tok.GetNextToken();
+        double x, y;
+        long n;
+
+        if (key == "time")
+        {
+            wxLongLong_t t;
+            if (!tok.GetNextToken().ToLongLong(&t))
+                return true;
+            s->time = t;
+        }
+        else if (key == "exposure")
+        {
+            if (!tok.GetNextToken().ToLong(&n))
+                return true;
+            s->exposure = (int) n;
+        }
+        else if (key == "lock" || key == "star")
+        {
+            if (!tok.GetNextToken().ToCDouble(&x) || !tok.GetNextToken().ToCDouble(&y))
+                return true;
+            if (key == "lock")
+            {
+                s->lock.SetXY(x, y);
+                s->sticky = tok.GetNextToken() == "1";
+            }
+            else
+                s->star.SetXY(x, y);
+        }
+        else if (key == "darks")
+            s->darks = tok.GetNextToken() == "1";
+        else if (key == "defects")
+            s->defects = tok.GetNextToken() == "1";
+        else if (key == "cal0" || key == "cal1")
+        {
+            int m = key == "cal1";
+            if (ParseCalibration(tok, &s->mountClass[m], &s->cal[m]))
+                return true;
+        }
+        else if (key == "algo0" || key == "algo1")
+        {
+            int m = key == "algo1";
+            long axis, algo;
+            if (!tok.GetNextToken().ToLong(&axis) || !tok.GetNextToken().ToLong(&algo) || axis < 0 || axis > 1)
+                return true;
+            s->algorithm[m][axis] = (int) algo;
+            s->algoState[m][axis] = tok.GetString();
+        }
+        else if (key == "blc0" || key == "blc1")
+            s->blcState[key == "blc1"] = tok.GetString();
+    }
+
+    return s->time == 0;
+}
+
+void SessionSnapshot::Save(void)
+{
+    if (!pFrame->pGuider->IsGuiding() || !MountsIdle())
+        return;
+
+    SessionState s;
+    Collect(&s);
+    if (Write(SnapshotFileName(pConfig->GetCurrentProfileId()), s))
+        Debug.Write("SessionSnapshot: could not write the snapshot\n");
+    s_lastSaveMs = s.time;
+}
+
+void SessionSnapshot::NotifyGuideStep(void)
+{
+    int interval = pConfig->Profile.GetInt("/SessionSnapshot/Interval", DefaultInterval);
+    if (interval <= 0)
+        return;
+    if (wxGetUTCTimeMillis().GetValue() - s_lastSaveMs < interval * 1000LL)
+        return;
+
+    Save();
+}
+
+static void RestoreMounts(const SessionState& s)
+{
+    for (int m = 0; m < 2; m++)
+    {
+        Mount *mount = SnapshotMount(m);
+        if (!mount || s.mountClass[m] != mount->GetMountClassName())
+            continue;
+
+        if (!mount->IsCalibrated())
+        {
+            Debug.Write(wxString::Format("SessionSnapshot: restoring the %s calibration\n", s.mountClass[m]));
+            mount->SetCalibration(s.cal[m]);
+        }
+
+        GuideAlgorithm *algo[2] = { mount->GetXGuideAlgorithm(), mount->GetYGuideAlgorithm() };
+        for (int a = 0; a < 2; a++)
+        {
+            // the state only makes sense to the algorithm that saved it
+            if (algo[a] && !s.algoState[m][a].IsEmpty() && algo[a]->Algorithm() == s.algorithm[m][a] &&
+                algo[a]->RestoreState(s.algoState[m][a], s.time))
+            {
+                Debug.Write(wxString::Format("SessionSnapshot: could not restore the %s %s algorithm state\n",
+                    s.mountClass[m], a == 0 ? "X" : "Y"));
+            }
+        }
+
+        if (mount->GetBacklashComp() && !s.blcState[m].IsEmpty() && mount->GetBacklashComp()->RestoreState(s.blcState[m]))
+            Debug.Write("SessionSnapshot: could not restore the backlash model\n");
+    }
+}
+
+// returns true on error
+static bool Resume(const SessionState& s, wxString *error)
+{
+    if (pFrame->pGearDialog->ConnectAll(error))
+        return true;
+    if (!pCamera || !pCamera->Connected)
+    {
+        *error = _("The camera is not connected");
+        return true;
+    }
+
+    if (s.darks && !pCamera->CurrentDarkFrame)
+        pFrame->LoadDarkHandler(true);
+    if (s.defects && !pCamera->CurrentDefectMap)
+        pFrame->LoadDefectMapHandler(true);
+
+    if (s.exposure > 0)
+        pFrame->SetExposureDuration(s.exposure);
+
+    RestoreMounts(s);
+
+    SettleParams settle;
+    settle.tolerancePx = 1.5;
+    settle.settleTimeSec = 10;
+    settle.timeoutSec = 60;
+    settle.frames = 99999;
+    settle.predictive = false;
+
+    // without a lock position the star is the lock position
+    PHD_Point lock = s.lock.IsValid() ? s.lock : s.star;
+    pFrame->pGuider->SetLockPosIsSticky(s.sticky);
+    return !PhdController::Resume(s.star, lock, settle, error);
+}
+
+void SessionSnapshot::OfferResume(void)
+{
+    wxString fname = SnapshotFileName(pConfig->GetCurrentProfileId());
+    if (!wxFileExists(fname))
+        return;
+
+    SessionState s;
+    if (Read(fname, &s))
+    {
+        Debug.Write(wxString::Format("SessionSnapshot: ignoring unreadable snapshot %s\n", fname));
+        return;
+    }
+
+    double ageMin = (double) (wxGetUTCTimeMillis().GetValue() - s.time) / 60000.0;
+    int maxAge = pConfig->Profile.GetInt("/SessionSnapshot/MaxAge", DefaultMaxAge);
+    if (ageMin < 0.0 || ageMin > maxAge || !s.star.IsValid())
+        return;
+
+    Debug.Write(wxString::Format("SessionSnapshot: found a snapshot from %.0f minutes ago\n", ageMin));
+
+    if (wxMessageBox(wxString::Format(_("PHD2 was guiding %.0f minutes ago. Resume guiding where it left off?\n\n"
+            "The equipment will be connected, and the calibration and the guiding state restored."), ageMin),
+            _("Resume Guiding"), wxYES_NO | wxICON_QUESTION, pFrame) != wxYES)
+    {
+        Debug.Write("SessionSnapshot: resume declined\n");
+        wxRemoveFile(fname);
+        return;
+    }
+
+    wxString error;
+    if (Resume(s, &error))
+    {
+        Debug.Write(wxString::Format("SessionSnapshot: resume failed: %s\n", error));
+        wxMessageBox(wxString::Format(_("Could not resume guiding: %s"), error), _("Resume Guiding"), wxOK | wxICON_ERROR, pFrame);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ *  session_snapshot.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SESSION_SNAPSHOT_INCLUDED
+#define SESSION_SNAPSHOT_INCLUDED
+
+// Warm restart. While guiding, a compact snapshot of the session is written
+// every /SessionSnapshot/Interval seconds (profile setting, 0 = never): the
+// exposure, the lock and star positions, the calibrations, what the guide
+// algorithms and the backlash model have learned, and whether darks and a
+// defect map were in use. When PHD2 starts again, after a crash or a planned
+// restart, it offers to resume from a snapshot no older than
+// /SessionSnapshot/MaxAge minutes: the gear is connected, the state restored,
+// and guiding starts on the star at its saved position, with AutoFind only
+// if the star is not there.
+//
+// The snapshot file is PHD2_session[_<instance>]_<profile id>.txt in the
+// default file directory.
+class SessionSnapshot
+{
+public:
+    // main thread, after a guide move completed; saves a snapshot when one is due
+    static void NotifyGuideStep(void);
+    // save one now if guiding, before a planned shutdown
+    static void Save(void);
+    // offer to resume a recent session of the current profile
+    static void OfferResume(void);
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ *  sliding_max.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef SLIDING_MAX_INCLUDED
+#define SLIDING_MAX_INCLUDED
+
+#include <deque>
+
+// Maximum of the most recent values of a series, kept up to date as values
+// are added in amortized O(1). The deque holds, oldest first, only the
+// values that can still become the maximum, each one larger than all values
+// added after it; the front is the maximum of the window.
+//
+// The window can shrink at any time (expire) but not grow: values already
+// dropped cannot come back, so after growing the window rebuild it by
+// clearing and adding the values again.
+template<typename T>
+class sliding_max
+{
+    struct Entry
+    {
+        long long seq;
+        T val;
+    };
+    std::deque<Entry> m_q;
+    long long m_next;       // sequence number of the next value
+
+public:
+    sliding_max() : m_next(0) { }
+
+    void clear()
+    {
+        m_q.clear();
+        m_next = 0;
+    }
+
+    // add a value; the window is the last window values including this one
+    void push(const T& val, unsigned int window)
+    {
+        while (!m_q.empty() && !(val < m_q.back().val))
+            m_q.pop_back();
+        Entry e = { m_next++, val };
+        m_q.push_back(e);
+        expire(window);
+    }
+
+    void expire(unsigned int window)
+    {
+        while (!m_q.empty() && m_q.front().seq < m_next - (long long) window)
+            m_q.pop_front();
+    }
+
+    bool empty() const { return m_q.empty(); }
+    T max(const T& dflt) const { return m_q.empty() ? dflt : m_q.front().val; }
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ *  sliding_median.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef SLIDING_MEDIAN_INCLUDED
+#define SLIDING_MEDIAN_INCLUDED
+
+#include <cstddef>
+#include <deque>
+#include <set>
+
+// Median of the values of a series added since a given key (a time, a frame
+// number), kept up to date in O(log n) per value added or expired. The values
+// are split into a lower and an upper half, with all of the lower half no
+// larger than the upper half, so the median is the largest of the lower half.
+// The deque keeps the values in the order added, for the expiry.
+//
+// The median is the value at index size() / 2 of the sorted window, the
+// upper one of the middle two for an even size.
+template<typename T>
+class sliding_median
+{
+    struct Entry
+    {
+        long long key;
+        T val;
+    };
+    std::deque<Entry> m_q;
+    std::multiset<T> m_lo;
+    std::multiset<T> m_hi;
+
+    // size() / 2 + 1 values in the lower half
+    void balance()
+    {
+        size_t want = m_q.size() / 2 + 1;
+        while (m_lo.size() > want)
+        {
+            typename std::multiset<T>::iterator it = --m_lo.end();
+            m_hi.insert(*it);
+            m_lo.erase(it);
+        }
+        while (m_lo.size() < want && !m_hi.empty())
+        {
+            typename std::multiset<T>::iterator it = m_hi.begin();
+            m_lo.insert(*it);
+            m_hi.erase(it);
+        }
+    }
+
+public:
+    void clear()
+    {
+        m_q.clear();
+        m_lo.clear();
+        m_hi.clear();
+    }
+
+    // add a value; keys must not decrease
+    void push(long long key, const T& val)
+    {
+        Entry e = { key, val };
+        m_q.push_back(e);
+        if (m_lo.empty() || !(*m_lo.rbegin() < val))
+            m_lo.insert(val);
+        else
+            m_hi.insert(val);
+        balance();
+    }
+
+    // drop the values added with a key less than oldest
+    void expire(long long oldest)
+    {
+        while (!m_q.empty() && m_q.front().key < oldest)
+        {
+            const T& val = m_q.front().val;
+            // equal values are interchangeable, any copy will do
+            typename std::multiset<T>::iterator it = m_lo.find(val);
+            if (it != m_lo.end())
+                m_lo.erase(it);
+            else
+                m_hi.erase(m_hi.find(val));
+            m_q.pop_front();
+        }
+        balance();
+    }
+
+    size_t size() const { return m_q.size(); }
+    bool empty() const { return m_q.empty(); }
+    T median(const T& dflt) const { return m_lo.empty() ? dflt : *m_lo.rbegin(); }
+};
+
+#endif
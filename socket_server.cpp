@@ -45,6 +45,47 @@
 
 static std::set<wxSocketBase *> s_clients;
 
+// Client sockets are non-blocking. Input is buffered until a whole command has
+// arrived, and commands are run from the event loop one at a time rather than
+// inside the socket event, so a slow or stalled client cannot hold up the UI,
+// the guide loop or the other clients.
+struct SockClientData
+{
+    std::vector<unsigned char> in;
+    std::vector<unsigned char> out;
+    size_t outOfs;
+    bool scheduled;     // a command is queued for ProcessSockServerCommand
+
+    SockClientData() : outOfs(0), scheduled(false) { }
+};
+
+inline static SockClientData *sock_data(wxSocketBase *sock)
+{
+    return static_cast<SockClientData *>(sock->GetClientData());
+}
+
+static void destroy_sock(wxSocketBase *sock)
+{
+    delete sock_data(sock);
+    sock->SetClientData(0);
+    sock->Destroy();
+}
+
+static void flush_sock(wxSocketBase *sock)
+{
+    SockClientData *data = sock_data(sock);
+    if (data->outOfs < data->out.size())
+    {
+        sock->Write(&data->out[data->outOfs], data->out.size() - data->outOfs);
+        data->outOfs += sock->LastWriteCount();
+    }
+    if (data->outOfs == data->out.size())
+    {
+        data->out.clear();
+        data->outOfs = 0;
+    }
+}
+
 enum {
     MSG_PAUSE = 1,
     MSG_RESUME,
@@ -118,6 +159,10 @@ bool MyFrame::StartServer(bool state)
             return true;
         }
 
+        // the image stream is an optional extra, failing to start it is not fatal
+        ImgStream.Start(m_instanceNumber);
+        TelemetryFeed.Start(m_instanceNumber);
+
         Debug.AddLine(wxString::Format("Server started, listening on port %u", port));
         StatusMsg(_("Server started"));
     }
@@ -129,9 +174,11 @@ bool MyFrame::StartServer(bool state)
         }
 
         Debug.AddLine("stopping server");
-        std::for_each(s_clients.begin(), s_clients.end(), std::mem_fun(&wxSocketBase::Destroy));
-        s_clients.empty();
+        std::for_each(s_clients.begin(), s_clients.end(), destroy_sock);
+        s_clients.clear();
         EvtServer.EventServerStop();
+        ImgStream.Stop();
+        TelemetryFeed.Stop();
         delete SocketServer;
         SocketServer = NULL;
         StatusMsg(_("Server stopped"));
@@ -168,7 +215,9 @@ void MyFrame::OnSockServerEvent(wxSocketEvent& event)
     }
 
     client->SetEventHandler(*this, SOCK_SERVER_CLIENT_ID);
-    client->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_LOST_FLAG);
+    client->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG | wxSOCKET_LOST_FLAG);
+    client->SetFlags(wxSOCKET_NOWAIT);
+    client->SetClientData(new SockClientData());
     client->Notify(true);
 
     s_clients.insert(client);
@@ -186,20 +235,81 @@ double MyFrame::GetDitherAmount(int ditherType)
     return 1.0;
 }
 
+// bytes in a command, including the command byte
+static size_t command_length(unsigned char c)
+{
+    return c == MSG_SETLOCKPOSITION ? 5 : 1;
+}
+
 void MyFrame::HandleSockServerInput(wxSocketBase *sock)
+{
+    SockClientData *data = sock_data(sock);
+
+    unsigned char buf[256];
+    while (true)
+    {
+        sock->Read(buf, sizeof(buf));
+        size_t n = sock->LastReadCount();
+        if (n == 0)
+            break;
+        data->in.insert(data->in.end(), buf, buf + n);
+    }
+
+    if (!data->scheduled && !data->in.empty() && data->in.size() >= command_length(data->in[0]))
+    {
+        data->scheduled = true;
+        CallAfter(&MyFrame::ProcessSockServerCommand, sock);
+    }
+}
+
+void MyFrame::ProcessSockServerCommand(wxSocketBase *sock)
+{
+    // the client may have disconnected since the command was queued
+    if (s_clients.find(sock) == s_clients.end())
+        return;
+
+    SockClientData *data = sock_data(sock);
+    data->scheduled = false;
+
+    if (data->in.empty() || data->in.size() < command_length(data->in[0]))
+        return;
+
+    size_t const len = command_length(data->in[0]);
+    unsigned char cmd[5];
+    std::copy(data->in.begin(), data->in.begin() + len, cmd);
+
+    if (cmd[0] == MSG_SETLOCKPOSITION)
+        data->in.clear();  // clean out anything else, as the blocking protocol did
+    else
+        data->in.erase(data->in.begin(), data->in.begin() + len);
+
+    unsigned char rval = HandleSockServerCommand(cmd);
+
+    Debug.Write(wxString::Format("Sending socket response %d (0x%x)\n", rval, rval));
+
+    // a command may have run the event loop and the client could be gone
+    if (s_clients.find(sock) == s_clients.end())
+        return;
+
+    data->out.push_back(rval);
+    flush_sock(sock);
+
+    // one command per event loop pass, so other events are not held up
+    if (!data->in.empty() && data->in.size() >= command_length(data->in[0]))
+    {
+        data->scheduled = true;
+        CallAfter(&MyFrame::ProcessSockServerCommand, sock);
+    }
+}
+
+unsigned char MyFrame::HandleSockServerCommand(const unsigned char *cmd)
 {
     unsigned char rval = 0;
 
     try
     {
-        // We disable input events, so that the test doesn't trigger
-        // wxSocketEvent again.
-        sock->SetNotify(wxSOCKET_LOST_FLAG);
-
         // Which command is coming in?
-        unsigned char c;
-
-        sock->Read(&c, 1);
+        unsigned char c = cmd[0];
 
         Debug.Write(wxString::Format("read socket command %d\n", c));
 
@@ -291,9 +401,8 @@ void MyFrame::HandleSockServerInput(wxSocketBase *sock)
             {
                 // Sets LockX and LockY to be user-specified
                 unsigned short x,y;
-                sock->Read(&x, 2);
-                sock->Read(&y, 2);
-                sock->Discard();  // Clean out anything else
+                memcpy(&x, &cmd[1], 2);
+                memcpy(&y, &cmd[3], 2);
 
                 if (!pFrame->pGuider->SetLockPosToStarAtPosition(PHD_Point(x,y)))
                 {
@@ -405,13 +514,7 @@ void MyFrame::HandleSockServerInput(wxSocketBase *sock)
         POSSIBLY_UNUSED(Msg);
     }
 
-    Debug.Write(wxString::Format("Sending socket response %d (0x%x)\n", rval, rval));
-
-    // Send response
-    sock->Write(&rval,1);
-
-    // Enable input events again.
-    sock->SetNotify(wxSOCKET_LOST_FLAG | wxSOCKET_INPUT_FLAG);
+    return rval;
 }
 
 void MyFrame::OnSockServerClientEvent(wxSocketEvent& event)
@@ -431,12 +534,15 @@ void MyFrame::OnSockServerClientEvent(wxSocketEvent& event)
             case wxSOCKET_INPUT:
                 HandleSockServerInput(sock);
                 break;
+            case wxSOCKET_OUTPUT:
+                flush_sock(sock);
+                break;
             case wxSOCKET_LOST:
                 Debug.AddLine("SOCKSVR: Client disconnected, deleting socket");
                 size_t n;
                 n = s_clients.erase(sock);
                 assert(n > 0);
-                sock->Destroy();
+                destroy_sock(sock);
                 break;
             default:
                 break;
@@ -1,945 +1,1925 @@
-/*
- *  star.cpp
- *  PHD Guiding
- *
- *  Created by Craig Stark.
- *  Refactored by Bret McKee
- *  Copyright (c) 2006-2010 Craig Stark.
- *  Copyright (c) 2012 Bret McKee
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Bret McKee, Dad Dog Development,
- *     Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#include "phd.h"
-#include <algorithm>
-
-Star::Star(void)
-{
-    Invalidate();
-    // Star is a bit quirky in that we use X and Y after the star is Invalidate()ed.
-    X = Y = 0.0;
-}
-
-Star::~Star(void)
-{
-}
-
-bool Star::WasFound(FindResult result)
-{
-    bool bReturn = false;
-
-    if (IsValid() &&
-        (result == STAR_OK || result == STAR_SATURATED))
-    {
-        bReturn = true;
-    }
-
-    return bReturn;
-}
-
-bool Star::WasFound(void)
-{
-    return WasFound(m_lastFindResult);
-}
-
-void Star::Invalidate(void)
-{
-    Mass = 0.0;
-    SNR = 0.0;
-    HFD = 0.0;
-    m_lastFindResult = STAR_ERROR;
-    PHD_Point::Invalidate();
-}
-
-void Star::SetError(FindResult error)
-{
-    m_lastFindResult = error;
-}
-
-// helper struct for HFR calculation
-struct R2M
-{
-    double r2;
-    wxPoint p;
-    double m;
-    R2M() { }
-    R2M(int x, int y, double m_) : p(x, y), m(m_) { }
-    bool operator<(const R2M& rhs) const { return r2 < rhs.r2; }
-};
-
-static double hfr(std::vector<R2M>& vec, double cx, double cy, double mass)
-{
-    if (vec.size() == 1) // hot pixel?
-        return 0.25;
-
-    // compute Half Flux Radius (HFR)
-    for (auto it = vec.begin(); it != vec.end(); ++it)
-    {
-        double dx = (double) it->p.x - cx;
-        double dy = (double) it->p.y - cy;
-        it->r2 = dx * dx + dy * dy;
-    }
-    std::sort(vec.begin(), vec.end()); // sort by ascending radius^2
-
-    // find radius of half-mass
-    double r20, r21, m0, m1;
-    r20 = r21 = m0 = m1 = 0.0;
-    double halfm = 0.5 * mass;
-    for (auto it = vec.begin(); it != vec.end(); ++it)
-    {
-        const R2M& rm = *it;
-        r20 = r21;
-        m0 = m1;
-        r21 = rm.r2;
-        m1 += rm.m;
-        if (m1 > halfm)
-            break;
-    }
-
-    // interpolate
-    double hfr;
-    if (m1 > m0)
-    {
-        double r0 = sqrt(r20), r1 = sqrt(r21);
-        double s = (r1 - r0) / (m1 - m0);
-        hfr = r0 + s * (halfm - m0);
-    }
-    else
-        hfr = 0.25;
-
-    return hfr;
-}
-
-bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, FindMode mode)
-{
-    FindResult Result = STAR_OK;
-    double newX = base_x;
-    double newY = base_y;
-
-    try
-    {
-        Debug.Write(wxString::Format("Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d))\n", searchRegion, base_x, base_y, mode,
-            pImg->Subframe.x, pImg->Subframe.y, pImg->Subframe.width, pImg->Subframe.height));
-
-        if (base_x < 0 || base_y < 0)
-        {
-            throw ERROR_INFO("coordinates are invalid");
-        }
-
-        int minx, miny, maxx, maxy;
-
-        if (pImg->Subframe.IsEmpty())
-        {
-            minx = miny = 0;
-            maxx = pImg->Size.GetWidth() - 1;
-            maxy = pImg->Size.GetHeight() - 1;
-        }
-        else
-        {
-            minx = pImg->Subframe.GetLeft();
-            maxx = pImg->Subframe.GetRight();
-            miny = pImg->Subframe.GetTop();
-            maxy = pImg->Subframe.GetBottom();
-        }
-
-        // search region bounds
-        int start_x = wxMax(base_x - searchRegion, minx);
-        int end_x   = wxMin(base_x + searchRegion, maxx);
-        int start_y = wxMax(base_y - searchRegion, miny);
-        int end_y   = wxMin(base_y + searchRegion, maxy);
-
-        const unsigned short *imgdata = pImg->ImageData;
-        int rowsize = pImg->Size.GetWidth();
-
-        int peak_x = 0, peak_y = 0;
-        unsigned int peak_val = 0;
-        unsigned short max3[3] = { 0, 0, 0 };
-
-        if (mode == FIND_PEAK)
-        {
-            for (int y = start_y; y <= end_y; y++)
-            {
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    unsigned short val = imgdata[y * rowsize + x];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-                }
-            }
-
-            PeakVal = peak_val;
-        }
-        else
-        {
-            // find the peak value within the search region using a smoothing function
-            // also check for saturation
-
-            for (int y = start_y + 1; y <= end_y - 1; y++)
-            {
-                for (int x = start_x + 1; x <= end_x - 1; x++)
-                {
-                    unsigned short p = imgdata[y * rowsize + x];
-                    unsigned int val =
-                        4 * (unsigned int) p +
-                        imgdata[(y - 1) * rowsize + (x - 1)] +
-                        imgdata[(y - 1) * rowsize + (x + 1)] +
-                        imgdata[(y + 1) * rowsize + (x - 1)] +
-                        imgdata[(y + 1) * rowsize + (x + 1)] +
-                        2 * imgdata[(y - 1) * rowsize + (x + 0)] +
-                        2 * imgdata[(y + 0) * rowsize + (x - 1)] +
-                        2 * imgdata[(y + 0) * rowsize + (x + 1)] +
-                        2 * imgdata[(y + 1) * rowsize + (x + 0)];
-
-                    if (val > peak_val)
-                    {
-                        peak_val = val;
-                        peak_x = x;
-                        peak_y = y;
-                    }
-
-                    if (p > max3[0])
-                        std::swap(p, max3[0]);
-                    if (p > max3[1])
-                        std::swap(p, max3[1]);
-                    if (p > max3[2])
-                        std::swap(p, max3[2]);
-                }
-            }
-
-            PeakVal = max3[0];   // raw peak val
-            peak_val /= 16; // smoothed peak value
-        }
-
-        // meaure noise in the annulus with inner radius A and outer radius B
-        int const A = 7;   // inner radius
-        int const B = 12;  // outer radius
-        int const A2 = A * A;
-        int const B2 = B * B;
-
-        // center window around peak value
-        start_x = wxMax(peak_x - B, minx);
-        end_x = wxMin(peak_x + B, maxx);
-        start_y = wxMax(peak_y - B, miny);
-        end_y = wxMin(peak_y + B, maxy);
-
-        // find the mean and stdev of the background
-
-        double sum = 0.0;
-        double a = 0.0;
-        double q = 0.0;
-        unsigned int nbg = 0;
-
-        const unsigned short *row = imgdata + rowsize * start_y;
-        for (int y = start_y; y <= end_y; y++, row += rowsize)
-        {
-            int dy = y - peak_y;
-            int dy2 = dy * dy;
-            for (int x = start_x; x <= end_x; x++)
-            {
-                int dx = x - peak_x;
-                int r2 = dx * dx + dy2;
-
-                // exclude points not in annulus
-                if (r2 <= A2 || r2 > B2)
-                    continue;
-
-                double const val = (double) row[x];
-                sum += val;
-                ++nbg;
-                double const k = (double) nbg;
-                double const a0 = a;
-                a += (val - a) / k;
-                q += (val - a0) * (val - a);
-            }
-        }
-
-        double const mean_bg = sum / (double) nbg;
-        double const sigma2_bg = q / (double) (nbg - 1);
-        double const sigma_bg = sqrt(sigma2_bg);
-        unsigned short thresh;
-
-        double cx = 0.0;
-        double cy = 0.0;
-        double mass = 0.0;
-        unsigned int n;
-
-        std::vector<R2M> hfrvec;
-
-        if (mode == FIND_PEAK)
-        {
-            mass = peak_val;
-            n = 1;
-            thresh = 0;
-        }
-        else
-        {
-            thresh = (unsigned short)(mean_bg + 3.0 * sigma_bg + 0.5);
-
-            // find pixels over threshold within aperture; compute mass and centroid
-
-            start_x = wxMax(peak_x - A, minx);
-            end_x = wxMin(peak_x + A, maxx);
-            start_y = wxMax(peak_y - A, miny);
-            end_y = wxMin(peak_y + A, maxy);
-
-            n = 0;
-
-            row = imgdata + rowsize * start_y;
-            for (int y = start_y; y <= end_y; y++, row += rowsize)
-            {
-                int dy = y - peak_y;
-                int dy2 = dy * dy;
-                if (dy2 > A2)
-                    continue;
-
-                for (int x = start_x; x <= end_x; x++)
-                {
-                    int dx = x - peak_x;
-
-                    // exclude points outside aperture
-                    if (dx * dx + dy2 > A2)
-                        continue;
-
-                    // exclude points below threshold
-                    unsigned short val = row[x];
-                    if (val < thresh)
-                        continue;
-
-                    double const d = (double) val - mean_bg;
-
-                    cx += dx * d;
-                    cy += dy * d;
-                    mass += d;
-                    ++n;
-
-                    hfrvec.push_back(R2M(x, y, d));
-                }
-            }
-        }
-
-        Mass = mass;
-
-        // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004 January 8
-        //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
-        double const gain = .5; // electrons per ADU, nominal
-        SNR = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
-
-        double const LOW_SNR = 3.0;
-
-        // a few scattered pixels over threshold can give a false positive
-        // avoid this by requiring the smoothed peak value to be above the threshold
-        if (peak_val <= thresh && SNR >= LOW_SNR)
-        {
-            Debug.Write(wxString::Format("Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", n, nbg, mean_bg, sigma_bg, thresh, peak_val));
-            SNR = LOW_SNR - 0.1;
-        }
-
-        if (mass < 10.0)
-            Result = STAR_LOWMASS;
-        else if (SNR < LOW_SNR)
-            Result = STAR_LOWSNR;
-        else
-        {
-            newX = peak_x + cx / mass;
-            newY = peak_y + cy / mass;
-
-            HFD = 2.0 * hfr(hfrvec, newX, newY, mass);
-
-            // even at saturation, the max values may vary a bit due to noise
-            // Call it saturated if the the top three values are within 32 parts per 65535 of max for 16-bit cameras,
-            // or within 1 part per 191 for 8-bit cameras
-            unsigned int d = (unsigned int) (max3[0] - max3[2]);
-            unsigned int mx = (unsigned int) max3[0];
-
-            // remove pedestal
-            if (mx >= pImg->Pedestal)
-                mx -= pImg->Pedestal;
-            else
-                mx = 0; // unlikely
-
-            if (pImg->BitsPerPixel < 12)
-            {
-                if (d * 191U < 1U * mx)
-                    Result = STAR_SATURATED;
-            }
-            else
-            {
-                if (d * 65535U < 32U * mx)
-                    Result = STAR_SATURATED;
-            }
-        }
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-
-        if (Result == STAR_OK)
-        {
-            Result = STAR_ERROR;
-        }
-    }
-
-    // update state
-    SetXY(newX, newY);
-    m_lastFindResult = Result;
-
-    bool wasFound = WasFound(Result);
-
-    if (!IsValid() || Result == STAR_ERROR)
-    {
-        Mass = 0.0;
-        SNR = 0.0;
-        HFD = 0.0;
-    }
-
-    Debug.Write(wxString::Format("Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f, Peak=%hu HFD=%.1f\n",
-        wasFound, Result, newX, newY, Mass, SNR, PeakVal, HFD));
-
-    return wasFound;
-}
-
-bool Star::Find(const usImage *pImg, int searchRegion, FindMode mode)
-{
-    return Find(pImg, searchRegion, X, Y, mode);
-}
-
-struct FloatImg
-{
-    float *px;
-    wxSize Size;
-    int NPixels;
-
-    FloatImg() : px(0) { }
-    FloatImg(const wxSize& size) : px(0) { Init(size); }
-    FloatImg(const usImage& img) : px(0) {
-        Init(img.Size);
-        for (int i = 0; i < NPixels; i++)
-            px[i] = (float) img.ImageData[i];
-    }
-    ~FloatImg() { delete[] px; }
-    void Init(const wxSize& sz) { delete[] px;  Size = sz; NPixels = Size.GetWidth() * Size.GetHeight(); px = new float[NPixels]; }
-    void Swap(FloatImg& other) { std::swap(px, other.px); std::swap(Size, other.Size); std::swap(NPixels, other.NPixels); }
-};
-
-static void GetStats(double *mean, double *stdev, const FloatImg& img, const wxRect& win)
-{
-    // Determine the mean and standard deviation
-    double sum = 0.0;
-    double a = 0.0;
-    double q = 0.0;
-    double k = 1.0;
-    double km1 = 0.0;
-
-    const int width = img.Size.GetWidth();
-    const float *p0 = &img.px[win.GetTop() * width + win.GetLeft()];
-    for (int y = 0; y < win.GetHeight(); y++)
-    {
-        const float *end = p0 + win.GetWidth();
-        for (const float *p = p0; p < end; p++)
-        {
-            double const x = (double) *p;
-            sum += x;
-            double const a0 = a;
-            a += (x - a) / k;
-            q += (x - a0) * (x - a);
-            km1 = k;
-            k += 1.0;
-        }
-        p0 += width;
-    }
-
-    *mean = sum / km1;
-    *stdev = sqrt(q / km1);
-}
-
-// un-comment to save the intermediate autofind image
-//#define SAVE_AUTOFIND_IMG
-
-static void SaveImage(const FloatImg& img, const char *name)
-{
-#ifdef SAVE_AUTOFIND_IMG
-    float maxv = img.px[0];
-    float minv = img.px[0];
-
-    for (int i = 1; i < img.NPixels; i++)
-    {
-        if (img.px[i] > maxv)
-            maxv = img.px[i];
-        if (img.px[i] < minv)
-            minv = img.px[i];
-    }
-
-    usImage tmp;
-    tmp.Init(img.Size);
-    for (int i = 0; i < tmp.NPixels; i++)
-    {
-        tmp.ImageData[i] = (unsigned short)(((double) img.px[i] - minv) * 65535.0 / (maxv - minv));
-    }
-
-    tmp.Save(wxFileName(Debug.GetLogDir(), name).GetFullPath());
-#endif // SAVE_AUTOFIND_IMG
-}
-
-static void psf_conv(FloatImg& dst, const FloatImg& src)
-{
-    dst.Init(src.Size);
-
-    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
-    const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
-
-    int const width = src.Size.GetWidth();
-    int const height = src.Size.GetHeight();
-
-    memset(dst.px, 0, src.NPixels * sizeof(float));
-
-    /* PSF Grid is:
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D1 C1 B1 A  B1 C1 D1 D3
-    D3 D2 C2 B2 B1 B2 C2 D2 D3
-    D3 D3 C3 C2 C1 C2 C3 D3 D3
-    D3 D3 D3 D2 D1 D2 D3 D3 D3
-    D3 D3 D3 D3 D3 D3 D3 D3 D3
-
-    1@A
-    4@B1, B2, C1, C3, D1
-    8@C2, D2
-    44 * D3
-    */
-
-    int psf_size = 4;
-
-    for (int y = psf_size; y < height - psf_size; y++)
-    {
-        for (int x = psf_size; x < width - psf_size; x++)
-        {
-            float A, B1, B2, C1, C2, C3, D1, D2, D3;
-
-#define PX(dx, dy) *(src.px + width * (y + (dy)) + x + (dx))
-            A =  PX(+0, +0);
-            B1 = PX(+0, -1) + PX(+0, +1) + PX(+1, +0) + PX(-1, +0);
-            B2 = PX(-1, -1) + PX(+1, -1) + PX(-1, +1) + PX(+1, +1);
-            C1 = PX(+0, -2) + PX(-2, +0) + PX(+2, +0) + PX(+0, +2);
-            C2 = PX(-1, -2) + PX(+1, -2) + PX(-2, -1) + PX(+2, -1) + PX(-2, +1) + PX(+2, +1) + PX(-1, +2) + PX(+1, +2);
-            C3 = PX(-2, -2) + PX(+2, -2) + PX(-2, +2) + PX(+2, +2);
-            D1 = PX(+0, -3) + PX(-3, +0) + PX(+3, +0) + PX(+0, +3);
-            D2 = PX(-1, -3) + PX(+1, -3) + PX(-3, -1) + PX(+3, -1) + PX(-3, +1) + PX(+3, +1) + PX(-1, +3) + PX(+1, +3);
-            D3 = PX(-4, -2) + PX(-3, -2) + PX(+3, -2) + PX(+4, -2) + PX(-4, -1) + PX(+4, -1) + PX(-4, +0) + PX(+4, +0) + PX(-4, +1) + PX(+4, +1) + PX(-4, +2) + PX(-3, +2) + PX(+3, +2) + PX(+4, +2);
-#undef PX
-            int i;
-            const float *uptr;
-
-            uptr = src.px + width * (y - 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y - 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 3) + (x - 4);
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-            uptr += 3;
-            for (i = 0; i < 3; i++)
-                D3 += *uptr++;
-
-            uptr = src.px + width * (y + 4) + (x - 4);
-            for (i = 0; i < 9; i++)
-                D3 += *uptr++;
-
-            double mean = (A + B1 + B2 + C1 + C2 + C3 + D1 + D2 + D3) / 81.0;
-            double PSF_fit = PSF[0] * (A - mean) + PSF[1] * (B1 - 4.0 * mean) + PSF[2] * (B2 - 4.0 * mean) +
-                PSF[3] * (C1 - 4.0 * mean) + PSF[4] * (C2 - 8.0 * mean) + PSF[5] * (C3 - 4.0 * mean) +
-                PSF[6] * (D1 - 4.0 * mean) + PSF[7] * (D2 - 8.0 * mean) + PSF[8] * (D3 - 44.0 * mean);
-
-            dst.px[width * y + x] = (float) PSF_fit;
-        }
-    }
-}
-
-static void Downsample(FloatImg& dst, const FloatImg& src, int downsample)
-{
-    int width = src.Size.GetWidth();
-    int dw = src.Size.GetWidth() / downsample;
-    int dh = src.Size.GetHeight() / downsample;
-
-    dst.Init(wxSize(dw, dh));
-
-    for (int yy = 0; yy < dh; yy++)
-    {
-        for (int xx = 0; xx < dw; xx++)
-        {
-            float sum = 0.0;
-            for (int j = 0; j < downsample; j++)
-                for (int i = 0; i < downsample; i++)
-                    sum += src.px[(yy * downsample + j) * width + xx * downsample + i];
-            float val = sum / (downsample * downsample);
-            dst.px[yy * dw + xx] = val;
-        }
-    }
-}
-
-struct Peak
-{
-    int x;
-    int y;
-    float val;
-
-    Peak() { }
-    Peak(int x_, int y_, float val_) : x(x_), y(y_), val(val_) { }
-    bool operator<(const Peak& rhs) const { return val < rhs.val; }
-};
-
-static void RemoveItems(std::set<Peak>& stars, const std::set<int>& to_erase)
-{
-    int n = 0;
-    for (std::set<Peak>::iterator it = stars.begin(); it != stars.end(); n++)
-    {
-        if (to_erase.find(n) != to_erase.end())
-        {
-            std::set<Peak>::iterator next = it;
-            ++next;
-            stars.erase(it);
-            it = next;
-        }
-        else
-            ++it;
-    }
-}
-
-bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegion)
-{
-    if (!image.Subframe.IsEmpty())
-    {
-        Debug.AddLine("Autofind called on subframe, returning error");
-        return false; // not found
-    }
-
-    wxBusyCursor busy;
-
-    Debug.Write(wxString::Format("Star::AutoFind called with edgeAllowance = %d searchRegion = %d\n", extraEdgeAllowance, searchRegion));
-
-    // run a 3x3 median first to eliminate hot pixels
-    usImage smoothed;
-    smoothed.CopyFrom(image);
-    Median3(smoothed);
-
-    // convert to floating point
-    FloatImg conv(smoothed);
-
-    // downsample the source image
-    const int downsample = 1;
-    if (downsample > 1)
-    {
-        FloatImg tmp;
-        Downsample(tmp, conv, downsample);
-        conv.Swap(tmp);
-    }
-
-    // run the PSF convolution
-    {
-        FloatImg tmp;
-        psf_conv(tmp, conv);
-        conv.Swap(tmp);
-    }
-
-    enum { CONV_RADIUS = 4 };
-    int dw = conv.Size.GetWidth();      // width of the downsampled image
-    int dh = conv.Size.GetHeight();     // height of the downsampled image
-    wxRect convRect(CONV_RADIUS, CONV_RADIUS, dw - 2 * CONV_RADIUS, dh - 2 * CONV_RADIUS);  // region containing valid data
-
-    SaveImage(conv, "PHD2_AutoFind.fit");
-
-    enum { TOP_N = 100 };  // keep track of the brightest stars
-    std::set<Peak> stars;  // sorted by ascending intensity
-
-    double global_mean, global_stdev;
-    GetStats(&global_mean, &global_stdev, conv, convRect);
-
-    Debug.Write(wxString::Format("AutoFind: global mean = %.1f, stdev %.1f\n", global_mean, global_stdev));
-
-    const double threshold = 0.1;
-    Debug.Write(wxString::Format("AutoFind: using threshold = %.1f\n", threshold));
-
-    // find each local maximum
-    int srch = 4;
-    for (int y = convRect.GetTop() + srch; y <= convRect.GetBottom() - srch; y++)
-    {
-        for (int x = convRect.GetLeft() + srch; x <= convRect.GetRight() - srch; x++)
-        {
-            float val = conv.px[dw * y + x];
-            bool ismax = false;
-            if (val > 0.0)
-            {
-                ismax = true;
-                for (int j = -srch; j <= srch; j++)
-                {
-                    for (int i = -srch; i <= srch; i++)
-                    {
-                        if (i == 0 && j == 0)
-                            continue;
-                        if (conv.px[dw * (y + j) + (x + i)] > val)
-                        {
-                            ismax = false;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (!ismax)
-                continue;
-
-            // compare local maximum to mean value of surrounding pixels
-            const int local = 7;
-            double local_mean, local_stdev;
-            wxRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
-            localRect.Intersect(convRect);
-            GetStats(&local_mean, &local_stdev, conv, localRect);
-
-            // this is our measure of star intensity
-            double h = (val - local_mean) / global_stdev;
-
-            if (h < threshold)
-            {
-                //  Debug.Write(wxString::Format("AG: local max REJECT [%d, %d] PSF %.1f SNR %.1f\n", imgx, imgy, val, SNR));
-                continue;
-            }
-
-            // coordinates on the original image
-            int imgx = x * downsample + downsample / 2;
-            int imgy = y * downsample + downsample / 2;
-
-            stars.insert(Peak(imgx, imgy, h));
-            if (stars.size() > TOP_N)
-                stars.erase(stars.begin());
-        }
-    }
-
-    for (std::set<Peak>::const_reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
-        Debug.Write(wxString::Format("AutoFind: local max [%d, %d] %.1f\n", it->x, it->y, it->val));
-
-    // merge stars that are very close into a single star
-    {
-        const int minlimitsq = 5 * 5;
-    repeat:
-        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
-        {
-            std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
-            {
-                int dx = a->x - b->x;
-                int dy = a->y - b->y;
-                int d2 = dx * dx + dy * dy;
-                if (d2 < minlimitsq)
-                {
-                    // very close, treat as single star
-                    Debug.Write(wxString::Format("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
-                    // erase the dimmer one
-                    stars.erase(a);
-                    goto repeat;
-                }
-            }
-        }
-    }
-
-    // exclude stars that would fit within a single searchRegion box
-    {
-        // build a list of stars to be excluded
-        std::set<int> to_erase;
-        const int extra = 5; // extra safety margin
-        const int fullw = searchRegion + extra;
-        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
-        {
-            std::set<Peak>::const_iterator b = a;
-            ++b;
-            for (; b != stars.end(); ++b)
-            {
-                int dx = abs(a->x - b->x);
-                int dy = abs(a->y - b->y);
-                if (dx <= fullw && dy <= fullw)
-                {
-                    // stars closer than search region, exclude them both
-                    // but do not let a very dim star eliminate a very bright star
-                    if (b->val / a->val >= 5.0)
-                    {
-                        Debug.Write(wxString::Format("AutoFind: close dim-bright [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
-                    }
-                    else
-                    {
-                        Debug.Write(wxString::Format("AutoFind: too close [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
-                        to_erase.insert(std::distance(stars.begin(), a));
-                        to_erase.insert(std::distance(stars.begin(), b));
-                    }
-                }
-            }
-        }
-        RemoveItems(stars, to_erase);
-    }
-
-    // exclude stars too close to the edge
-    {
-        enum { MIN_EDGE_DIST = 40 };
-        int edgeDist = MIN_EDGE_DIST + extraEdgeAllowance;
-
-        std::set<Peak>::iterator it = stars.begin();
-        while (it != stars.end())
-        {
-            std::set<Peak>::iterator next = it;
-            ++next;
-            if (it->x <= edgeDist || it->x >= image.Size.GetWidth() - edgeDist ||
-                it->y <= edgeDist || it->y >= image.Size.GetHeight() - edgeDist)
-            {
-                Debug.Write(wxString::Format("AutoFind: too close to edge [%d, %d] %.1f\n", it->x, it->y, it->val));
-                stars.erase(it);
-            }
-            it = next;
-        }
-    }
-
-    // At first I tried running Star::Find on the survivors to find the best
-    // star. This had the unfortunate effect of locating hot pixels which
-    // the psf convolution so nicely avoids. So, don't do that!  -ag
-
-    // try to identify the saturation point
-
-    //  first, find the peak pixel overall
-    unsigned short maxVal = 0;
-    for (unsigned int i = 0; i < image.NPixels; i++)
-        if (image.ImageData[i] > maxVal)
-            maxVal = image.ImageData[i];
-
-    // next see if any of the stars has a flat-top
-    bool foundSaturated = false;
-    for (std::set<Peak>::reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
-    {
-        Star tmp;
-        tmp.Find(&image, searchRegion, it->x, it->y, FIND_CENTROID);
-        if (tmp.WasFound() && tmp.GetError() == STAR_SATURATED)
-        {
-            if ((maxVal - tmp.PeakVal) * 255U > maxVal)
-            {
-                // false positive saturation, flat top but below maxVal
-                Debug.Write(wxString::Format("AutoSelect: false positive saturation peak = %hu, max = %hu\n", tmp.PeakVal, maxVal));
-            }
-            else
-            {
-                // a saturated star was found
-                foundSaturated = true;
-                break;
-            }
-        }
-    }
-
-    unsigned int sat_level; // saturation level, including pedestal
-    if (foundSaturated)
-    {
-        // use the peak overall pixel value as the saturation limit
-        Debug.Write(wxString::Format("AutoSelect: using saturation level peakVal = %hu\n", maxVal));
-        sat_level = maxVal; // includes pedestal
-    }
-    else
-    {
-        // no staurated stars found, can't make any assumption about whether the max val is saturated
-
-        Debug.Write(wxString::Format("AutoSelect: using saturation level from BPP %u and pedestal %hu\n",
-            image.BitsPerPixel, image.Pedestal));
-
-        sat_level = ((1U << image.BitsPerPixel) - 1) + image.Pedestal;
-        if (sat_level > 65535)
-            sat_level = 65535;
-    }
-    unsigned int diff = sat_level > image.Pedestal ? sat_level - image.Pedestal : 0U;
-    // "near-saturation" threshold at 90% saturation
-    unsigned short sat_thresh = (unsigned short)((unsigned int) image.Pedestal + 9 * diff / 10);
-
-    Debug.Write(wxString::Format("AutoSelect: BPP = %u, saturation at %u, pedestal %hu, thresh = %hu\n",
-        image.BitsPerPixel, sat_level, image.Pedestal, sat_thresh));
-
-    // Final star selection
-    //   pass 1: find brightest star with peak value < 90% saturation AND SNR > 6
-    //       this pass will reject saturated and nearly-saturated stars
-    //   pass 2: find brightest non-saturated star
-    //   pass 3: find brightest star, even if saturated
-
-    for (int pass = 1; pass <= 3; pass++)
-    {
-        Debug.Write(wxString::Format("AutoSelect: finding best star pass %d\n", pass));
-
-        for (std::set<Peak>::reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
-        {
-            Star tmp;
-            tmp.Find(&image, searchRegion, it->x, it->y, FIND_CENTROID);
-            if (tmp.WasFound())
-            {
-                if (pass == 1)
-                {
-                    if (tmp.PeakVal > sat_thresh)
-                    {
-                        Debug.Write(wxString::Format("Autofind: near-saturated [%d, %d] %.1f Mass %.f SNR %.1f Peak %hu\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR, tmp.PeakVal));
-                        continue;
-                    }
-                    if (tmp.GetError() == STAR_SATURATED || tmp.SNR < 6.0)
-                        continue;
-                }
-                else if (pass == 2)
-                {
-                    if (tmp.GetError() == STAR_SATURATED)
-                    {
-                        Debug.Write(wxString::Format("Autofind: star saturated [%d, %d] %.1f Mass %.f SNR %.1f\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR));
-                        continue;
-                    }
-                }
-
-                // star accepted
-                SetXY(it->x, it->y);
-                Debug.Write(wxString::Format("Autofind returns star at [%d, %d] %.1f Mass %.f SNR %.1f\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR));
-                return true;
-            }
-        }
-
-        if (pass == 1)
-            Debug.Write("AutoFind: could not find a star on Pass 1\n");
-        else if (pass == 2)
-            Debug.Write("AutoFind: could not find a non-saturated star!\n");
-    }
-
-    Debug.Write("Autofind: no star found\n");
-    return false;
-}
+/*
+ *  star.cpp
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark.
+ *  Refactored by Bret McKee
+ *  Copyright (c) 2006-2010 Craig Stark.
+ *  Copyright (c) 2012 Bret McKee
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Bret McKee, Dad Dog Development,
+ *     Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include <algorithm>
+#include <functional>
+
+Star::Star(void)
+{
+    Invalidate();
+    // Star is a bit quirky in that we use X and Y after the star is Invalidate()ed.
+    X = Y = 0.0;
+}
+
+Star::~Star(void)
+{
+}
+
+bool Star::WasFound(FindResult result)
+{
+    bool bReturn = false;
+
+    if (IsValid() &&
+        (result == STAR_OK || result == STAR_SATURATED))
+    {
+        bReturn = true;
+    }
+
+    return bReturn;
+}
+
+bool Star::WasFound(void)
+{
+    return WasFound(m_lastFindResult);
+}
+
+void Star::Invalidate(void)
+{
+    Mass = 0.0;
+    SNR = 0.0;
+    HFD = 0.0;
+    m_lastFindResult = STAR_ERROR;
+    PHD_Point::Invalidate();
+}
+
+void Star::SetError(FindResult error)
+{
+    m_lastFindResult = error;
+}
+
+// helper struct for HFR calculation
+struct R2M
+{
+    double r2;
+    double m;
+    int x, y;
+    unsigned int seq;  // scan order, breaks ties in r2
+};
+
+inline static bool r2m_greater(const R2M& a, const R2M& b)
+{
+    return a.r2 > b.r2 || (a.r2 == b.r2 && a.seq > b.seq);
+}
+
+static double hfr(R2M *px, unsigned int n, double cx, double cy, double mass)
+{
+    if (n == 1) // hot pixel?
+        return 0.25;
+
+    // compute Half Flux Radius (HFR)
+    for (unsigned int i = 0; i < n; i++)
+    {
+        double dx = (double) px[i].x - cx;
+        double dy = (double) px[i].y - cy;
+        px[i].r2 = dx * dx + dy * dy;
+    }
+
+    // only the pixels inside the half-flux radius are needed in order of
+    // ascending radius, so pop them off a heap rather than sorting them all
+    std::make_heap(px, px + n, r2m_greater);
+
+    // find radius of half-mass
+    double r20, r21, m0, m1;
+    r20 = r21 = m0 = m1 = 0.0;
+    double halfm = 0.5 * mass;
+    for (R2M *end = px + n; end > px; --end)
+    {
+        std::pop_heap(px, end, r2m_greater);
+        const R2M& rm = end[-1];
+        r20 = r21;
+        m0 = m1;
+        r21 = rm.r2;
+        m1 += rm.m;
+        if (m1 > halfm)
+            break;
+    }
+
+    // interpolate
+    double hfr;
+    if (m1 > m0)
+    {
+        double r0 = sqrt(r20), r1 = sqrt(r21);
+        double s = (r1 - r0) / (m1 - m0);
+        hfr = r0 + s * (halfm - m0);
+    }
+    else
+        hfr = 0.25;
+
+    return hfr;
+}
+
+// largest h with h * h <= v, or -1 if v < 0
+inline static int isqrt_floor(int v)
+{
+    if (v < 0)
+        return -1;
+    int h = (int) sqrt((double) v);
+    while (h * h > v)
+        --h;
+    while ((h + 1) * (h + 1) <= v)
+        ++h;
+    return h;
+}
+
+// running background mean and variance; pixels must be added in the same
+// order as the original per-pixel scan so that the results are unchanged
+struct BgStats
+{
+    double sum;
+    double a;
+    double q;
+    unsigned int n;
+
+    BgStats() : sum(0.0), a(0.0), q(0.0), n(0) { }
+
+    void AddSpan(const unsigned short *row, int x0, int x1)
+    {
+        for (int x = x0; x <= x1; x++)
+        {
+            double const val = (double) row[x];
+            sum += val;
+            ++n;
+            double const k = (double) n;
+            double const a0 = a;
+            a += (val - a) / k;
+            q += (val - a0) * (val - a);
+        }
+    }
+};
+
+// solve the 4x4 system a x = b in place by elimination with partial pivoting,
+// false if it is singular
+static bool solve4(double a[4][4], double b[4])
+{
+    for (int k = 0; k < 4; k++)
+    {
+        int p = k;
+        for (int i = k + 1; i < 4; i++)
+            if (fabs(a[i][k]) > fabs(a[p][k]))
+                p = i;
+        if (a[p][k] == 0.0)
+            return false;
+        if (p != k)
+        {
+            for (int j = 0; j < 4; j++)
+                std::swap(a[k][j], a[p][j]);
+            std::swap(b[k], b[p]);
+        }
+        for (int i = k + 1; i < 4; i++)
+        {
+            double const f = a[i][k] / a[k][k];
+            for (int j = k; j < 4; j++)
+                a[i][j] -= f * a[k][j];
+            b[i] -= f * b[k];
+        }
+    }
+    for (int k = 3; k >= 0; k--)
+    {
+        for (int j = k + 1; j < 4; j++)
+            b[k] -= a[k][j] * b[j];
+        b[k] /= a[k][k];
+    }
+    return true;
+}
+
+// Fit a circular Gaussian amp * exp(-((x - x0)^2 + (y - y0)^2) / (2 s^2)) to
+// the background subtracted pixels of the box x0..x1, y0..y1, starting from
+// the centroid (*px, *py). The model is separable, so one iteration takes one
+// exp per row and per column of the box and the work per pixel is a few
+// multiply-adds. A fixed number of Gauss-Newton steps is taken; on success
+// the fitted center and FWHM are returned, otherwise the centroid is kept.
+static bool fit_gaussian(const usImage *pImg, int x0, int y0, int x1, int y1, double bg, double mass, double peak,
+                         double *px, double *py, double *pfwhm)
+{
+    enum { MAXW = 32, ITERATIONS = 6 };
+
+    int const w = x1 - x0 + 1;
+    int const h = y1 - y0 + 1;
+    if (w < 5 || h < 5 || w > MAXW || h > MAXW || peak <= 0.0 || mass <= 0.0)
+        return false;
+
+    double d[MAXW][MAXW];
+    for (int j = 0; j < h; j++)
+    {
+        const unsigned short *row = &pImg->Pixel(x0, y0 + j);
+        for (int i = 0; i < w; i++)
+            d[j][i] = (double) row[i] - bg;
+    }
+
+    // seeded from the flux and the peak, flux = 2 pi s^2 amp
+    double cx = *px, cy = *py;
+    double amp = peak;
+    double s = sqrt(mass / (2.0 * M_PI * peak));
+    s = wxMax(0.5, wxMin(s, 0.5 * (double) wxMin(w, h)));
+
+    for (int it = 0; it < ITERATIONS; it++)
+    {
+        double const inv = 1.0 / (s * s);
+        double ux[MAXW], gx[MAXW], uy[MAXW], gy[MAXW];
+        for (int i = 0; i < w; i++)
+        {
+            ux[i] = (double) (x0 + i) - cx;
+            gx[i] = exp(-0.5 * ux[i] * ux[i] * inv);
+        }
+        for (int j = 0; j < h; j++)
+        {
+            uy[j] = (double) (y0 + j) - cy;
+            gy[j] = exp(-0.5 * uy[j] * uy[j] * inv);
+        }
+
+        // normal equations for (amp, cx, cy, s)
+        double a[4][4] = { { 0.0 } };
+        double b[4] = { 0.0 };
+        for (int j = 0; j < h; j++)
+        {
+            for (int i = 0; i < w; i++)
+            {
+                double const g = gx[i] * gy[j];
+                double const m = amp * g;
+                double const r = d[j][i] - m;
+                double const mi = m * inv;
+                double const jac[4] = { g, mi * ux[i], mi * uy[j], mi * (ux[i] * ux[i] + uy[j] * uy[j]) / s };
+                for (int k = 0; k < 4; k++)
+                {
+                    b[k] += jac[k] * r;
+                    for (int l = k; l < 4; l++)
+                        a[k][l] += jac[k] * jac[l];
+                }
+            }
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            for (int l = 0; l < k; l++)
+                a[k][l] = a[l][k];
+            a[k][k] *= 1.0 + 1e-3;  // a little damping keeps the first steps sane
+        }
+
+        if (!solve4(a, b))
+            return false;
+
+        amp += b[0];
+        cx += b[1];
+        cy += b[2];
+        s += b[3];
+
+        if (!(amp > 0.0) || !(s > 0.3) || s > 0.5 * (double) wxMax(w, h))
+            return false;
+
+        if (fabs(b[1]) < 1e-4 && fabs(b[2]) < 1e-4)
+            break;
+    }
+
+    // a fit that walked away from the centroid fitted something else
+    if (fabs(cx - *px) > 1.5 || fabs(cy - *py) > 1.5)
+        return false;
+
+    *px = cx;
+    *py = cy;
+    *pfwhm = 2.0 * sqrt(2.0 * log(2.0)) * s;
+    return true;
+}
+
+// the profiles of the box around (cx, cy), moved inside the bounds if the
+// star is near the edge; the box overlaps the pixels Find just read
+static void FillProfile(StarProfile *profile, const usImage *pImg, int cx, int cy, int minx, int miny, int maxx, int maxy)
+{
+    int const W = StarProfile::FULLW;
+    int const H = StarProfile::HALFW;
+
+    if (maxx - minx + 1 < W || maxy - miny + 1 < W)
+        return;
+
+    int const x0 = wxMax(minx, wxMin(cx - H, maxx - W + 1));
+    int const y0 = wxMax(miny, wxMin(cy - H, maxy - W + 1));
+    int const rowsize = pImg->DataRect.GetWidth();
+
+    for (int i = 0; i < W; i++)
+        profile->horiz[i] = 0;
+
+    const unsigned short *row = &pImg->Pixel(x0, y0);
+    for (int y = 0; y < W; y++, row += rowsize)
+    {
+        int sum = 0;
+        for (int x = 0; x < W; x++)
+        {
+            profile->horiz[x] += row[x];
+            sum += row[x];
+        }
+        profile->vert[y] = sum;
+        if (y == H)
+        {
+            for (int x = 0; x < W; x++)
+                profile->midrow[x] = row[x];
+        }
+    }
+
+    profile->valid = true;
+}
+
+bool Star::Find(const usImage *pImg, int searchRegion, int base_x, int base_y, FindMode mode, StarProfile *profile,
+    const StarBackground *background)
+{
+    PERF_STAGE(PERF_STAGE_STAR_FIND);
+
+    FindResult Result = STAR_OK;
+    double newX = base_x;
+    double newY = base_y;
+
+    if (profile)
+        profile->valid = false;
+
+    try
+    {
+        DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE, "Star::Find(%d, %d, %d, %d, (%d,%d,%d,%d))\n", searchRegion, base_x, base_y, mode,
+            pImg->Subframe.x, pImg->Subframe.y, pImg->Subframe.width, pImg->Subframe.height);
+
+        if (base_x < 0 || base_y < 0)
+        {
+            throw ERROR_INFO("coordinates are invalid");
+        }
+
+        int minx, miny, maxx, maxy;
+
+        if (pImg->Subframe.IsEmpty())
+        {
+            minx = miny = 0;
+            maxx = pImg->Size.GetWidth() - 1;
+            maxy = pImg->Size.GetHeight() - 1;
+        }
+        else
+        {
+            minx = pImg->Subframe.GetLeft();
+            maxx = pImg->Subframe.GetRight();
+            miny = pImg->Subframe.GetTop();
+            maxy = pImg->Subframe.GetBottom();
+        }
+
+        // search region bounds
+        int start_x = wxMax(base_x - searchRegion, minx);
+        int end_x   = wxMin(base_x + searchRegion, maxx);
+        int start_y = wxMax(base_y - searchRegion, miny);
+        int end_y   = wxMin(base_y + searchRegion, maxy);
+
+        // rows are addressed from the left edge of the region being read,
+        // the image may hold only its subframe
+        int const rowsize = pImg->DataRect.GetWidth();
+
+        int peak_x = 0, peak_y = 0;
+        unsigned int peak_val = 0;
+        unsigned short max3[3] = { 0, 0, 0 };
+
+        if (mode == FIND_PEAK)
+        {
+            for (int y = start_y; y <= end_y; y++)
+            {
+                const unsigned short *row = &pImg->Pixel(start_x, y);
+                for (int x = start_x; x <= end_x; x++)
+                {
+                    unsigned short val = row[x - start_x];
+
+                    if (val > peak_val)
+                    {
+                        peak_val = val;
+                        peak_x = x;
+                        peak_y = y;
+                    }
+                }
+            }
+
+            PeakVal = peak_val;
+        }
+        else
+        {
+            // find the peak value within the search region using a smoothing function
+            // also check for saturation
+
+            for (int y = start_y + 1; y <= end_y - 1; y++)
+            {
+                const unsigned short *above = &pImg->Pixel(start_x, y - 1);
+                const unsigned short *row = above + rowsize;
+                const unsigned short *below = row + rowsize;
+                for (int x = start_x + 1; x <= end_x - 1; x++)
+                {
+                    int const i = x - start_x;
+                    unsigned short p = row[i];
+                    unsigned int val =
+                        4 * (unsigned int) p +
+                        above[i - 1] +
+                        above[i + 1] +
+                        below[i - 1] +
+                        below[i + 1] +
+                        2 * above[i] +
+                        2 * row[i - 1] +
+                        2 * row[i + 1] +
+                        2 * below[i];
+
+                    if (val > peak_val)
+                    {
+                        peak_val = val;
+                        peak_x = x;
+                        peak_y = y;
+                    }
+
+                    if (p > max3[0])
+                        std::swap(p, max3[0]);
+                    if (p > max3[1])
+                        std::swap(p, max3[1]);
+                    if (p > max3[2])
+                        std::swap(p, max3[2]);
+                }
+            }
+
+            PeakVal = max3[0];   // raw peak val
+            peak_val /= 16; // smoothed peak value
+        }
+
+        // meaure noise in the annulus with inner radius A and outer radius B
+        int const A = 7;   // inner radius
+        int const B = 12;  // outer radius
+        int const A2 = A * A;
+        int const B2 = B * B;
+
+        // center window around peak value
+        start_x = wxMax(peak_x - B, minx);
+        end_x = wxMin(peak_x + B, maxx);
+        start_y = wxMax(peak_y - B, miny);
+        end_y = wxMin(peak_y + B, maxy);
+
+        // find the mean and stdev of the background
+
+        BgStats bg;
+
+        const unsigned short *row = &pImg->Pixel(start_x, start_y);
+        for (int y = start_y; y <= end_y; y++, row += rowsize)
+        {
+            int dy = y - peak_y;
+            int dy2 = dy * dy;
+
+            // the row's part of the annulus is |dx| in [inner + 1, outer]
+            int const outer = isqrt_floor(B2 - dy2);
+            int const inner = isqrt_floor(A2 - dy2);   // -1 if the row misses the inner disk
+
+            if (inner < 0)
+                bg.AddSpan(row, wxMax(start_x, peak_x - outer) - start_x, wxMin(end_x, peak_x + outer) - start_x);
+            else
+            {
+                bg.AddSpan(row, wxMax(start_x, peak_x - outer) - start_x, wxMin(end_x, peak_x - inner - 1) - start_x);
+                bg.AddSpan(row, wxMax(start_x, peak_x + inner + 1) - start_x, wxMin(end_x, peak_x + outer) - start_x);
+            }
+        }
+
+        unsigned int const nbg = bg.n;
+        double const mean_bg = bg.sum / (double) nbg;
+        double sigma2_bg = bg.q / (double) (nbg - 1);
+
+        // the background level is still taken from this frame's annulus, it
+        // follows changes in the sky at once, but the noise comes from the
+        // running background model when there is one
+        double model_mean;
+        bool const modelled = mode != FIND_PEAK && background &&
+            background->Lookup(peak_x, peak_y, &model_mean, &sigma2_bg);
+
+        double const sigma_bg = sqrt(sigma2_bg);
+        unsigned short thresh;
+
+        double cx = 0.0;
+        double cy = 0.0;
+        double mass = 0.0;
+        unsigned int n;
+
+        // pixels within the aperture, for the HFD; the aperture is fixed at
+        // radius A around the peak whatever the search region is
+        R2M hfrpx[(2 * A + 1) * (2 * A + 1)];
+
+        if (mode == FIND_PEAK)
+        {
+            mass = peak_val;
+            n = 1;
+            thresh = 0;
+        }
+        else
+        {
+            thresh = (unsigned short)(mean_bg + 3.0 * sigma_bg + 0.5);
+
+            // find pixels over threshold within aperture; compute mass and centroid
+
+            start_x = wxMax(peak_x - A, minx);
+            end_x = wxMin(peak_x + A, maxx);
+            start_y = wxMax(peak_y - A, miny);
+            end_y = wxMin(peak_y + A, maxy);
+
+            n = 0;
+
+            row = &pImg->Pixel(start_x, start_y);
+            for (int y = start_y; y <= end_y; y++, row += rowsize)
+            {
+                int dy = y - peak_y;
+                int dy2 = dy * dy;
+
+                // points within the aperture
+                int const half = isqrt_floor(A2 - dy2);
+                int const x0 = wxMax(start_x, peak_x - half);
+                int const x1 = wxMin(end_x, peak_x + half);
+
+                for (int x = x0; x <= x1; x++)
+                {
+                    int dx = x - peak_x;
+
+                    // exclude points below threshold
+                    unsigned short val = row[x - start_x];
+                    if (val < thresh)
+                        continue;
+
+                    double const d = (double) val - mean_bg;
+
+                    R2M& rm = hfrpx[n];
+                    rm.x = x;
+                    rm.y = y;
+                    rm.m = d;
+                    rm.seq = n;
+
+                    cx += dx * d;
+                    cy += dy * d;
+                    mass += d;
+                    ++n;
+                }
+            }
+        }
+
+        Mass = mass;
+
+        // SNR estimate from: Measuring the Signal-to-Noise Ratio S/N of the CCD Image of a Star or Nebula, J.H.Simonetti, 2004 January 8
+        //     http://www.phys.vt.edu/~jhs/phys3154/snr20040108.pdf
+        double const gain = .5; // electrons per ADU, nominal
+        SNR = n > 0 ? mass / sqrt(mass / gain + sigma2_bg * (double) n * (1.0 + 1.0 / (double) nbg)) : 0.0;
+
+        double const LOW_SNR = 3.0;
+
+        // a few scattered pixels over threshold can give a false positive
+        // avoid this by requiring the smoothed peak value to be above the threshold.
+        // With a modelled noise the smoothed peak is instead required to be
+        // DETECT_SIGMA times the noise of the smoothed image above the
+        // background; the kernel weights sum to 16 and their squares to 36,
+        // so the smoothing scales the noise by 6/16
+        double const DETECT_SIGMA = 5.0;
+        bool const falseStar = modelled ?
+            (double) peak_val - mean_bg < DETECT_SIGMA * (6.0 / 16.0) * sigma_bg :
+            peak_val <= thresh;
+
+        if (falseStar && SNR >= LOW_SNR)
+        {
+            DEBUG_LOG(DBGLOG_STAR, DBGLOG_VERBOSE, "Star::Find false star n=%u nbg=%u bg=%.1f sigma=%.1f thresh=%u peak=%u\n", n, nbg, mean_bg, sigma_bg, thresh, peak_val);
+            SNR = LOW_SNR - 0.1;
+        }
+
+        if (mass < 10.0)
+            Result = STAR_LOWMASS;
+        else if (SNR < LOW_SNR)
+            Result = STAR_LOWSNR;
+        else
+        {
+            newX = peak_x + cx / mass;
+            newY = peak_y + cy / mass;
+
+            // for a Gaussian profile the HFD is the FWHM, which the fit
+            // gives anyway
+            double fwhm;
+            int const fx = ROUND(newX);
+            int const fy = ROUND(newY);
+            if (mode == FIND_GAUSSIAN &&
+                fit_gaussian(pImg, wxMax(fx - A, minx), wxMax(fy - A, miny), wxMin(fx + A, maxx), wxMin(fy + A, maxy),
+                             mean_bg, mass, (double) PeakVal - mean_bg, &newX, &newY, &fwhm))
+            {
+                HFD = fwhm;
+            }
+            else
+                HFD = 2.0 * hfr(hfrpx, n, newX, newY, mass);
+
+            if (profile)
+                FillProfile(profile, pImg, ROUND(newX), ROUND(newY), minx, miny, maxx, maxy);
+
+            // even at saturation, the max values may vary a bit due to noise
+            // Call it saturated if the the top three values are within 32 parts per 65535 of max for 16-bit cameras,
+            // or within 1 part per 191 for 8-bit cameras
+            unsigned int d = (unsigned int) (max3[0] - max3[2]);
+            unsigned int mx = (unsigned int) max3[0];
+
+            // remove pedestal
+            if (mx >= pImg->Pedestal)
+                mx -= pImg->Pedestal;
+            else
+                mx = 0; // unlikely
+
+            if (pImg->BitsPerPixel < 12)
+            {
+                if (d * 191U < 1U * mx)
+                    Result = STAR_SATURATED;
+            }
+            else
+            {
+                if (d * 65535U < 32U * mx)
+                    Result = STAR_SATURATED;
+            }
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+
+        if (Result == STAR_OK)
+        {
+            Result = STAR_ERROR;
+        }
+    }
+
+    // update state
+    SetXY(newX, newY);
+    m_lastFindResult = Result;
+
+    bool wasFound = WasFound(Result);
+
+    if (!IsValid() || Result == STAR_ERROR)
+    {
+        Mass = 0.0;
+        SNR = 0.0;
+        HFD = 0.0;
+    }
+
+    DEBUG_LOG(DBGLOG_STAR, DBGLOG_INFO, "Star::Find returns %d (%d), X=%.2f, Y=%.2f, Mass=%.f, SNR=%.1f, Peak=%hu HFD=%.1f\n",
+        wasFound, Result, newX, newY, Mass, SNR, PeakVal, HFD);
+
+    return wasFound;
+}
+
+bool Star::Find(const usImage *pImg, int searchRegion, FindMode mode, StarProfile *profile,
+    const StarBackground *background)
+{
+    return Find(pImg, searchRegion, X, Y, mode, profile, background);
+}
+
+StarBackground::StarBackground(void)
+    : m_tx0(0), m_ty0(0), m_cols(0), m_rows(0), m_exposure(0)
+{
+}
+
+void StarBackground::Reset(void)
+{
+    m_tx0 = m_ty0 = m_cols = m_rows = 0;
+    m_tiles.clear();
+}
+
+inline const StarBackground::Tile *StarBackground::At(int tx, int ty) const
+{
+    tx -= m_tx0;
+    ty -= m_ty0;
+    if (tx < 0 || ty < 0 || tx >= m_cols || ty >= m_rows)
+        return 0;
+    return &m_tiles[ty * m_cols + tx];
+}
+
+// move the kept tiles to cover tiles tx0..tx1, ty0..ty1, keeping the ones
+// in both; the tiles are fixed on the sensor so only the window moves
+void StarBackground::Relocate(int tx0, int ty0, int tx1, int ty1)
+{
+    int const cols = tx1 - tx0 + 1;
+    int const rows = ty1 - ty0 + 1;
+
+    std::vector<Tile> tiles(cols * rows);
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+            const Tile *t = At(tx, ty);
+            if (t)
+                tiles[(ty - ty0) * cols + (tx - tx0)] = *t;
+        }
+    }
+
+    m_tiles.swap(tiles);
+    m_tx0 = tx0;
+    m_ty0 = ty0;
+    m_cols = cols;
+    m_rows = rows;
+}
+
+void StarBackground::Update(const usImage *pImg, const PHD_Point& star, int searchRegion)
+{
+    // weight of the new frame, an effective memory of about 9 frames
+    double const ALPHA = 0.2;
+
+    if (!star.IsValid())
+        return;
+
+    // the background scales with the exposure, start over when it changes
+    if (pImg->Size != m_imageSize || pImg->ImgExpDur != m_exposure)
+    {
+        Reset();
+        m_imageSize = pImg->Size;
+        m_exposure = pImg->ImgExpDur;
+    }
+
+    int minx, miny, maxx, maxy;
+    if (pImg->Subframe.IsEmpty())
+    {
+        minx = miny = 0;
+        maxx = pImg->Size.GetWidth() - 1;
+        maxy = pImg->Size.GetHeight() - 1;
+    }
+    else
+    {
+        minx = pImg->Subframe.GetLeft();
+        maxx = pImg->Subframe.GetRight();
+        miny = pImg->Subframe.GetTop();
+        maxy = pImg->Subframe.GetBottom();
+    }
+
+    // cover the search region and the background annulus around it
+    int const cx = ROUND(star.X);
+    int const cy = ROUND(star.Y);
+    int const half = searchRegion + 13;
+    int const x0 = wxMax(cx - half, minx);
+    int const x1 = wxMin(cx + half, maxx);
+    int const y0 = wxMax(cy - half, miny);
+    int const y1 = wxMin(cy + half, maxy);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    int const tx0 = x0 / TILE, tx1 = x1 / TILE;
+    int const ty0 = y0 / TILE, ty1 = y1 / TILE;
+    if (tx0 != m_tx0 || ty0 != m_ty0 || tx1 - tx0 + 1 != m_cols || ty1 - ty0 + 1 != m_rows)
+        Relocate(tx0, ty0, tx1, ty1);
+
+    int const R2 = EXCLUDE_RADIUS * EXCLUDE_RADIUS;
+
+    for (int ty = ty0; ty <= ty1; ty++)
+    {
+        int const py0 = wxMax(ty * TILE, y0);
+        int const py1 = wxMin(ty * TILE + TILE - 1, y1);
+
+        for (int tx = tx0; tx <= tx1; tx++)
+        {
+            int const px0 = wxMax(tx * TILE, x0);
+            int const px1 = wxMin(tx * TILE + TILE - 1, x1);
+
+            Tile& tile = m_tiles[(ty - ty0) * m_cols + (tx - tx0)];
+
+            // pixels well above the background are other stars or hot
+            // pixels; without an estimate yet they are clipped against a
+            // first pass over the tile
+            double clip = tile.frames > 0 ? tile.mean + 5.0 * sqrt(tile.var) : 65536.0;
+            unsigned int n = 0;
+            double mean = 0.0, q = 0.0;
+
+            for (int pass = tile.frames > 0 ? 1 : 0; pass < 2; pass++)
+            {
+                n = 0;
+                mean = q = 0.0;
+
+                for (int y = py0; y <= py1; y++)
+                {
+                    const unsigned short *row = &pImg->Pixel(px0, y);
+                    int const dy = y - cy;
+                    for (int x = px0; x <= px1; x++)
+                    {
+                        int const dx = x - cx;
+                        if (dx * dx + dy * dy <= R2)
+                            continue;
+                        double const val = (double) row[x - px0];
+                        if (val > clip)
+                            continue;
+                        ++n;
+                        double const d = val - mean;
+                        mean += d / (double) n;
+                        q += d * (val - mean);
+                    }
+                }
+
+                if (pass == 0 && n > 1)
+                    clip = mean + 3.0 * sqrt(q / (double) (n - 1));
+            }
+
+            // too little of the tile left to measure
+            if (n < TILE * TILE / 4)
+                continue;
+
+            double const var = q / (double) (n - 1);
+            if (tile.frames == 0)
+            {
+                tile.mean = mean;
+                tile.var = var;
+            }
+            else
+            {
+                tile.mean += ALPHA * (mean - tile.mean);
+                tile.var += ALPHA * (var - tile.var);
+            }
+            ++tile.frames;
+        }
+    }
+}
+
+bool StarBackground::Lookup(int x, int y, double *mean, double *sigma2) const
+{
+    int const tx = x / TILE;
+    int const ty = y / TILE;
+
+    // the tile under the star may be left out of the updates while the star
+    // sits on it, fall back to the tiles around it
+    const Tile *t = At(tx, ty);
+    if (t && t->frames >= MIN_FRAMES)
+    {
+        *mean = t->mean;
+        *sigma2 = t->var;
+        return true;
+    }
+
+    double sm = 0.0, sv = 0.0;
+    int n = 0;
+    for (int j = ty - 1; j <= ty + 1; j++)
+    {
+        for (int i = tx - 1; i <= tx + 1; i++)
+        {
+            t = At(i, j);
+            if (t && t->frames >= MIN_FRAMES)
+            {
+                sm += t->mean;
+                sv += t->var;
+                ++n;
+            }
+        }
+    }
+
+    if (n == 0)
+        return false;
+
+    *mean = sm / n;
+    *sigma2 = sv / n;
+    return true;
+}
+
+struct FloatImg
+{
+    float *px;
+    wxSize Size;
+    int NPixels;
+
+    FloatImg() : px(0), NPixels(0) { }
+    FloatImg(const wxSize& size) : px(0) { Init(size); }
+    FloatImg(const usImage& img) : px(0) {
+        Init(img.Size);
+        for (int i = 0; i < NPixels; i++)
+            px[i] = (float) img.ImageData[i];
+    }
+    ~FloatImg() { delete[] px; }
+    void Init(const wxSize& sz) {
+        int n = sz.GetWidth() * sz.GetHeight();
+        if (!px || n != NPixels) { delete[] px; px = new float[n]; }
+        Size = sz; NPixels = n;
+    }
+    void Swap(FloatImg& other) { std::swap(px, other.px); std::swap(Size, other.Size); std::swap(NPixels, other.NPixels); }
+};
+
+static void GetStats(double *mean, double *stdev, const FloatImg& img, const wxRect& win)
+{
+    // Determine the mean and standard deviation
+    double sum = 0.0;
+    double a = 0.0;
+    double q = 0.0;
+    double k = 1.0;
+    double km1 = 0.0;
+
+    const int width = img.Size.GetWidth();
+    const float *p0 = &img.px[win.GetTop() * width + win.GetLeft()];
+    for (int y = 0; y < win.GetHeight(); y++)
+    {
+        const float *end = p0 + win.GetWidth();
+        for (const float *p = p0; p < end; p++)
+        {
+            double const x = (double) *p;
+            sum += x;
+            double const a0 = a;
+            a += (x - a) / k;
+            q += (x - a0) * (x - a);
+            km1 = k;
+            k += 1.0;
+        }
+        p0 += width;
+    }
+
+    *mean = sum / km1;
+    *stdev = sqrt(q / km1);
+}
+
+// un-comment to save the intermediate autofind image
+//#define SAVE_AUTOFIND_IMG
+
+static void SaveImage(const FloatImg& img, const char *name)
+{
+#ifdef SAVE_AUTOFIND_IMG
+    float maxv = img.px[0];
+    float minv = img.px[0];
+
+    for (int i = 1; i < img.NPixels; i++)
+    {
+        if (img.px[i] > maxv)
+            maxv = img.px[i];
+        if (img.px[i] < minv)
+            minv = img.px[i];
+    }
+
+    usImage tmp;
+    tmp.Init(img.Size);
+    for (int i = 0; i < tmp.NPixels; i++)
+    {
+        tmp.ImageData[i] = (unsigned short)(((double) img.px[i] - minv) * 65535.0 / (maxv - minv));
+    }
+
+    tmp.Save(wxFileName(Debug.GetLogDir(), name).GetFullPath());
+#endif // SAVE_AUTOFIND_IMG
+}
+
+// A square convolution kernel of radius R ((2R+1) x (2R+1) weights). The
+// evaluation method is chosen from the structure of the weights when the
+// kernel is built:
+//
+//   CONV_SEPARABLE  the weights are the outer product of a column and a row
+//                   vector: a vertical and a horizontal pass, 2(2R+1) MACs
+//                   per pixel
+//   CONV_SYMMETRIC  the weights are symmetric about both axes: rows and
+//                   columns the same distance from the center are added
+//                   before they are weighted, (R+1)^2 MACs per pixel
+//   CONV_DIRECT     anything else, (2R+1)^2 MACs per pixel
+//
+// All three run as unit-stride loops over a row so the compiler can vectorize
+// them. A transform-based convolution only pays off for kernels much larger
+// than the ones used here, so it is not implemented.
+class ConvKernel
+{
+public:
+    enum Method
+    {
+        CONV_DIRECT,
+        CONV_SYMMETRIC,
+        CONV_SEPARABLE,
+    };
+
+private:
+    int m_radius;
+    Method m_method;
+    std::vector<float> m_w;     // (2R+1)^2 weights, row major
+    std::vector<float> m_col;   // separable factors
+    std::vector<float> m_row;
+
+public:
+    ConvKernel(const double *weights, int radius);
+
+    int Radius() const { return m_radius; }
+    Method GetMethod() const { return m_method; }
+    static const char *MethodName(Method method);
+
+    template<typename RowSource>
+    void Convolve(FloatImg& dst, const RowSource& src, int rowBegin, int rowEnd) const;
+
+private:
+    float W(int dx, int dy) const { return m_w[(dy + m_radius) * (2 * m_radius + 1) + dx + m_radius]; }
+
+    // CONV_SYMMETRIC for a radius known at compile time: the taps unroll and
+    // each output pixel is accumulated in a register
+    template<int R>
+    void SymmetricRow(float *d, const float *const *fold, int x0, int x1) const
+    {
+        float w[R + 1][R + 1];
+        for (int j = 0; j <= R; j++)
+            for (int i = 0; i <= R; i++)
+                w[j][i] = W(i, j);
+
+        for (int x = x0; x < x1; x++)
+        {
+            float sum = 0.f;
+            for (int j = 0; j <= R; j++)
+            {
+                const float *const f = fold[j] + x;
+                sum += w[j][0] * f[0];
+                for (int i = 1; i <= R; i++)
+                    sum += w[j][i] * (f[-i] + f[i]);
+            }
+            d[x] = sum;
+        }
+    }
+};
+
+ConvKernel::ConvKernel(const double *weights, int radius)
+    : m_radius(radius)
+{
+    int const n = 2 * radius + 1;
+
+    m_w.resize(n * n);
+    double maxw = 0.0;
+    int pi = 0, pj = 0;
+    for (int j = 0; j < n; j++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            double w = weights[j * n + i];
+            m_w[j * n + i] = (float) w;
+            if (fabs(w) > maxw)
+            {
+                maxw = fabs(w);
+                pi = i;
+                pj = j;
+            }
+        }
+    }
+
+    // tolerance for the structure tests, relative to the largest weight
+    double const tol = 1e-6 * maxw;
+
+    // rank one: w[j][i] = w[j][pi] * w[pj][i] / w[pj][pi]
+    bool separable = maxw > 0.0;
+    for (int j = 0; separable && j < n; j++)
+        for (int i = 0; separable && i < n; i++)
+            if (fabs(weights[j * n + i] - weights[j * n + pi] * weights[pj * n + i] / weights[pj * n + pi]) > tol)
+                separable = false;
+
+    bool symmetric = true;
+    for (int j = 0; symmetric && j < n; j++)
+        for (int i = 0; symmetric && i < n; i++)
+            if (fabs(weights[j * n + i] - weights[j * n + (n - 1 - i)]) > tol ||
+                fabs(weights[j * n + i] - weights[(n - 1 - j) * n + i]) > tol)
+                symmetric = false;
+
+    if (separable)
+    {
+        m_method = CONV_SEPARABLE;
+        m_col.resize(n);
+        m_row.resize(n);
+        for (int k = 0; k < n; k++)
+        {
+            m_col[k] = (float) weights[k * n + pi];
+            m_row[k] = (float)(weights[pj * n + k] / weights[pj * n + pi]);
+        }
+    }
+    else if (symmetric)
+        m_method = CONV_SYMMETRIC;
+    else
+        m_method = CONV_DIRECT;
+}
+
+const char *ConvKernel::MethodName(Method method)
+{
+    switch (method)
+    {
+    case CONV_SEPARABLE: return "separable";
+    case CONV_SYMMETRIC: return "symmetric";
+    default:             return "direct";
+    }
+}
+
+// Computes rows [rowBegin, rowEnd) of the convolution of src into dst, which
+// must already be sized like src. Pixels closer than the kernel radius to the
+// edge are set to 0. The source rows are fetched into a ring of 2R+1 float
+// rows as they are needed, so the source itself is never copied; RowSource
+// provides Size() and GetRow(y, float *row).
+template<typename RowSource>
+void ConvKernel::Convolve(FloatImg& dst, const RowSource& src, int rowBegin, int rowEnd) const
+{
+    int const R = m_radius;
+    int const n = 2 * R + 1;
+    int const width = src.Size().GetWidth();
+    int const height = src.Size().GetHeight();
+
+    // rows and columns with a complete neighborhood
+    int const y0 = std::max(rowBegin, R);
+    int const y1 = std::min(rowEnd, height - R);
+    int const x0 = R;
+    int const x1 = width - R;
+
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        if (y < y0 || y >= y1 || x1 <= x0)
+        {
+            memset(dst.px + (size_t) y * width, 0, width * sizeof(float));
+            continue;
+        }
+        float *d = dst.px + (size_t) y * width;
+        for (int x = 0; x < x0; x++)
+            d[x] = 0.f;
+        for (int x = x1; x < width; x++)
+            d[x] = 0.f;
+    }
+
+    if (y1 <= y0 || x1 <= x0)
+        return;
+
+    std::vector<float> ringbuf(n * width);
+    std::vector<float> tmpbuf((R + 1) * width);
+    const float *rows[2 * 32 + 1];
+    assert(n <= (int) (sizeof(rows) / sizeof(rows[0])));
+
+    // source row yy lives in ring slot yy mod n
+    for (int yy = y0 - R; yy < y0 + R; yy++)
+        src.GetRow(yy, &ringbuf[(yy % n) * width]);
+
+    for (int y = y0; y < y1; y++)
+    {
+        src.GetRow(y + R, &ringbuf[((y + R) % n) * width]);
+        for (int k = 0; k < n; k++)
+            rows[k] = &ringbuf[((y - R + k) % n) * width];
+
+        float *const d = dst.px + (size_t) y * width;
+
+        switch (m_method)
+        {
+        case CONV_SEPARABLE:
+        {
+            float *const v = &tmpbuf[0];
+            for (int x = 0; x < width; x++)
+                v[x] = 0.f;
+            for (int k = 0; k < n; k++)
+            {
+                const float *const r = rows[k];
+                float const w = m_col[k];
+                for (int x = 0; x < width; x++)
+                    v[x] += w * r[x];
+            }
+            for (int x = x0; x < x1; x++)
+                d[x] = 0.f;
+            for (int k = 0; k < n; k++)
+            {
+                const float *const r = v + k - R;
+                float const w = m_row[k];
+                for (int x = x0; x < x1; x++)
+                    d[x] += w * r[x];
+            }
+            break;
+        }
+
+        case CONV_SYMMETRIC:
+        {
+            // fold[j] = row(y - j) + row(y + j)
+            const float *fold[32 + 1];
+            fold[0] = rows[R];
+            for (int j = 1; j <= R; j++)
+            {
+                float *const f = &tmpbuf[j * width];
+                const float *const a = rows[R - j];
+                const float *const b = rows[R + j];
+                for (int x = 0; x < width; x++)
+                    f[x] = a[x] + b[x];
+                fold[j] = f;
+            }
+            if (R == 4)
+                SymmetricRow<4>(d, fold, x0, x1);
+            else
+            {
+                for (int x = x0; x < x1; x++)
+                    d[x] = 0.f;
+                for (int j = 0; j <= R; j++)
+                {
+                    const float *const f = fold[j];
+                    float const w0 = W(0, j);
+                    for (int x = x0; x < x1; x++)
+                        d[x] += w0 * f[x];
+                    for (int i = 1; i <= R; i++)
+                    {
+                        float const w = W(i, j);
+                        const float *const fl = f - i;
+                        const float *const fr = f + i;
+                        for (int x = x0; x < x1; x++)
+                            d[x] += w * (fl[x] + fr[x]);
+                    }
+                }
+            }
+            break;
+        }
+
+        default:
+        {
+            for (int x = x0; x < x1; x++)
+                d[x] = 0.f;
+            for (int j = -R; j <= R; j++)
+            {
+                for (int i = -R; i <= R; i++)
+                {
+                    float const w = W(i, j);
+                    const float *const r = rows[j + R] + i;
+                    for (int x = x0; x < x1; x++)
+                        d[x] += w * r[x];
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+// The AutoFind PSF is a 9x9 stencil with weights that depend on the squared
+// distance from the center,
+//
+//    D3 D3 D3 D3 D3 D3 D3 D3 D3
+//    D3 D3 D3 D2 D1 D2 D3 D3 D3
+//    D3 D3 C3 C2 C1 C2 C3 D3 D3
+//    D3 D2 C2 B2 B1 B2 C2 D2 D3
+//    D3 D1 C1 B1 A  B1 C1 D1 D3
+//    D3 D2 C2 B2 B1 B2 C2 D2 D3
+//    D3 D3 C3 C2 C1 C2 C3 D3 D3
+//    D3 D3 D3 D2 D1 D2 D3 D3 D3
+//    D3 D3 D3 D3 D3 D3 D3 D3 D3
+//
+// applied after subtracting the mean of the 81 pixels. Subtracting the mean
+// is linear, so the whole thing is a single kernel of weights PSF[class] - c
+// where c = sum(PSF[class] * count[class]) / 81.
+static const ConvKernel& AutoFindPsfKernel()
+{
+    //                       A      B1     B2    C1     C2    C3     D1     D2     D3
+    static const double PSF[] = { 0.906, 0.584, 0.365, .117, .049, -0.05, -.064, -.074, -.094 };
+    enum { PSF_RADIUS = 4, PSF_SIZE = 2 * PSF_RADIUS + 1 };
+
+    static ConvKernel *s_kernel;
+
+    if (!s_kernel)
+    {
+        int cls[PSF_SIZE * PSF_SIZE];
+        double sum = 0.0;
+        for (int dy = -PSF_RADIUS; dy <= PSF_RADIUS; dy++)
+        {
+            for (int dx = -PSF_RADIUS; dx <= PSF_RADIUS; dx++)
+            {
+                int c;
+                switch (dx * dx + dy * dy)
+                {
+                case 0:  c = 0; break;  // A
+                case 1:  c = 1; break;  // B1
+                case 2:  c = 2; break;  // B2
+                case 4:  c = 3; break;  // C1
+                case 5:  c = 4; break;  // C2
+                case 8:  c = 5; break;  // C3
+                case 9:  c = 6; break;  // D1
+                case 10: c = 7; break;  // D2
+                default: c = 8; break;  // D3
+                }
+                cls[(dy + PSF_RADIUS) * PSF_SIZE + dx + PSF_RADIUS] = c;
+                sum += PSF[c];
+            }
+        }
+
+        double w[PSF_SIZE * PSF_SIZE];
+        for (int i = 0; i < PSF_SIZE * PSF_SIZE; i++)
+            w[i] = PSF[cls[i]] - sum / (PSF_SIZE * PSF_SIZE);
+
+        s_kernel = new ConvKernel(w, PSF_RADIUS);
+    }
+
+    return *s_kernel;
+}
+
+// AutoFind's convolution output is kept between calls so that repeated
+// searches on same-sized frames do not reallocate it
+static wxCriticalSection s_autoFindBufLock;
+static FloatImg s_autoFindBuf;
+
+// borrows the shared convolution buffer for the lifetime of the object
+struct AutoFindBuffer
+{
+    FloatImg img;
+
+    AutoFindBuffer()
+    {
+        wxCriticalSectionLocker lck(s_autoFindBufLock);
+        img.Swap(s_autoFindBuf);
+    }
+    ~AutoFindBuffer()
+    {
+        wxCriticalSectionLocker lck(s_autoFindBufLock);
+        if (!s_autoFindBuf.px)
+            img.Swap(s_autoFindBuf);
+    }
+};
+
+// source rows for ConvKernel::Convolve, converted from an unsigned short image
+struct UsImageRows
+{
+    const usImage& img;
+
+    UsImageRows(const usImage& img_) : img(img_) { }
+
+    const wxSize& Size() const { return img.Size; }
+
+    void GetRow(int y, float *row) const
+    {
+        int const width = img.Size.GetWidth();
+        const unsigned short *p = img.ImageData + (size_t) y * width;
+        for (int x = 0; x < width; x++)
+            row[x] = (float) p[x];
+    }
+};
+
+struct Peak
+{
+    int x;
+    int y;
+    float val;
+
+    Peak() { }
+    Peak(int x_, int y_, float val_) : x(x_), y(y_), val(val_) { }
+    bool operator<(const Peak& rhs) const { return val < rhs.val; }
+    bool operator>(const Peak& rhs) const { return val > rhs.val; }
+};
+
+static void RemoveItems(std::set<Peak>& stars, const std::set<int>& to_erase)
+{
+    int n = 0;
+    for (std::set<Peak>::iterator it = stars.begin(); it != stars.end(); n++)
+    {
+        if (to_erase.find(n) != to_erase.end())
+        {
+            std::set<Peak>::iterator next = it;
+            ++next;
+            stars.erase(it);
+            it = next;
+        }
+        else
+            ++it;
+    }
+}
+
+// AutoFind splits the frame into horizontal strips and processes the strips
+// concurrently. Each stage writes only the rows of its own strip but may read
+// neighboring rows of the previous stage's output, so the stages are separated
+// by joining all the strip threads (see RunImageStrips).
+
+static int AutoFindStripCount(int height)
+{
+    enum { MIN_STRIP_ROWS = 128 };
+    return ImageStripCount(height, MIN_STRIP_ROWS);
+}
+
+template<typename RowSource>
+struct PsfConvJob : public ImageStripJob
+{
+    const ConvKernel& kernel;
+    const RowSource& src;
+    FloatImg& dst;
+
+    PsfConvJob(FloatImg& dst_, const RowSource& src_, const ConvKernel& kernel_) : kernel(kernel_), src(src_), dst(dst_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        kernel.Convolve(dst, src, rowBegin, rowEnd);
+    }
+};
+
+// average downsample x downsample blocks of the source into dst; a partial
+// block at the right or bottom edge is dropped
+struct BinJob : public ImageStripJob
+{
+    usImage& dst;
+    const usImage& src;
+    int downsample;
+
+    BinJob(usImage& dst_, const usImage& src_, int downsample_) : dst(dst_), src(src_), downsample(downsample_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        int const width = src.Size.GetWidth();
+        int const dw = dst.Size.GetWidth();
+        unsigned int const n = downsample * downsample;
+        std::vector<unsigned int> sum(dw);
+
+        for (int yy = rowBegin; yy < rowEnd; yy++)
+        {
+            std::fill(sum.begin(), sum.end(), 0U);
+            for (int j = 0; j < downsample; j++)
+            {
+                const unsigned short *p = src.ImageData + (size_t)(yy * downsample + j) * width;
+                for (int xx = 0; xx < dw; xx++, p += downsample)
+                    for (int i = 0; i < downsample; i++)
+                        sum[xx] += p[i];
+            }
+            unsigned short *d = dst.ImageData + (size_t) yy * dw;
+            for (int xx = 0; xx < dw; xx++)
+                d[xx] = (unsigned short)((sum[xx] + n / 2) / n);
+        }
+    }
+};
+
+// AutoFind searches a binned copy of large frames and then refines the
+// candidates on the full frame. The factor comes from the profile; 0 (the
+// default) picks one from the frame area.
+static int AutoFindDownsample(const wxSize& size)
+{
+    int downsample = pConfig->Profile.GetInt("/StarAutoFind/Downsample", 0);
+
+    if (downsample <= 0)
+    {
+        double const mpix = (double) size.GetWidth() * (double) size.GetHeight() / 1.0e6;
+        downsample = mpix >= 16.0 ? 4 : mpix >= 4.0 ? 2 : 1;
+
+        // one step coarser to save CPU time, see PowerSaver and LoadShedder
+        if (PowerSaver::IsEngaged() || LoadShedder::Shed(SHED_AUTOFIND))
+            downsample = mpix >= 4.0 ? 4 : mpix >= 1.0 ? 2 : 1;
+    }
+
+    // the binned frame must still hold the PSF kernel and the local max search
+    enum { MIN_BINNED_SIZE = 64 };
+    while (downsample > 1 && (size.GetWidth() / downsample < MIN_BINNED_SIZE || size.GetHeight() / downsample < MIN_BINNED_SIZE))
+        --downsample;
+
+    return downsample;
+}
+
+// Running maximum over windows of 2r+1 values (van Herk / Gil-Werman). The
+// values are split into blocks of the window size, and any window is covered
+// by the tail of one block and the head of the next, so its maximum is the
+// larger of a suffix maximum and a prefix maximum whatever the radius. dst[i]
+// is the maximum of src[i-r..i+r] for r <= i < n-r; dst may be src.
+static void RunningMax(float *dst, const float *src, int n, int r, float *g, float *h)
+{
+    int const w = 2 * r + 1;
+    for (int i = 0; i < n; i++)
+        g[i] = i % w == 0 ? src[i] : std::max(g[i - 1], src[i]);
+    for (int i = n - 1; i >= 0; i--)
+        h[i] = i == n - 1 || (i + 1) % w == 0 ? src[i] : std::max(h[i + 1], src[i]);
+    for (int i = r; i < n - r; i++)
+        dst[i] = std::max(h[i - r], g[i + r]);
+}
+
+// the same down the columns of nrows rows of width values, a whole row at a
+// time; g and h hold nrows rows
+static void RunningMaxRows(float *dst, const float *src, int nrows, int width, int r, float *g, float *h)
+{
+    int const w = 2 * r + 1;
+    for (int k = 0; k < nrows; k++)
+    {
+        const float *s = src + (size_t) k * width;
+        float *gk = g + (size_t) k * width;
+        if (k % w == 0)
+            std::copy(s, s + width, gk);
+        else
+            for (int x = 0; x < width; x++)
+                gk[x] = std::max(gk[x - width], s[x]);
+    }
+    for (int k = nrows - 1; k >= 0; k--)
+    {
+        const float *s = src + (size_t) k * width;
+        float *hk = h + (size_t) k * width;
+        if (k == nrows - 1 || (k + 1) % w == 0)
+            std::copy(s, s + width, hk);
+        else
+            for (int x = 0; x < width; x++)
+                hk[x] = std::max(hk[x + width], s[x]);
+    }
+    for (int k = r; k < nrows - r; k++)
+    {
+        const float *hk = h + (size_t)(k - r) * width;
+        const float *gk = g + (size_t)(k + r) * width;
+        float *d = dst + (size_t) k * width;
+        for (int x = 0; x < width; x++)
+            d[x] = std::max(hk[x], gk[x]);
+    }
+}
+
+// find candidate local maxima, collected per strip in raster order so
+// that merging the strips in order reproduces the serial scan exactly. A
+// pixel is a local maximum when no pixel in its (2 srch + 1)^2 neighborhood
+// is brighter, found by comparing it to the neighborhood maximum from a
+// separable running max filter; the strip is filtered in bands of rows to
+// bound the scratch memory.
+struct FindPeaksJob : public ImageStripJob
+{
+    const FloatImg& conv;
+    const wxRect& convRect;
+    double global_stdev;
+    double threshold;
+    int downsample;
+    std::vector<std::vector<Peak> > peaks;
+
+    FindPeaksJob(const FloatImg& conv_, const wxRect& convRect_, double global_stdev_, double threshold_,
+                 int downsample_, int nstrips)
+        : conv(conv_), convRect(convRect_), global_stdev(global_stdev_), threshold(threshold_),
+          downsample(downsample_), peaks(nstrips) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        std::vector<Peak>& out = peaks[strip];
+
+        int const dw = conv.Size.GetWidth();
+        int const srch = 4;
+        int const x0 = convRect.GetLeft();
+        int const n = convRect.GetWidth();
+        int const y0 = std::max(rowBegin, convRect.GetTop() + srch);
+        int const y1 = std::min(rowEnd - 1, convRect.GetBottom() - srch);
+
+        if (y0 > y1 || n <= 2 * srch)
+            return;
+
+        enum { BAND_ROWS = 64 };
+        size_t const bufsize = (size_t)(BAND_ROWS + 2 * srch) * n;
+        std::vector<float> mx(bufsize), pre(bufsize), suf(bufsize);
+
+        for (int band = y0; band <= y1; band += BAND_ROWS)
+        {
+            int const bandEnd = std::min(band + BAND_ROWS - 1, y1);
+            int const nrows = bandEnd - band + 1 + 2 * srch;
+
+            // neighborhood maximum: along the rows, then down the columns
+            for (int k = 0; k < nrows; k++)
+                RunningMax(&mx[(size_t) k * n], &conv.px[(size_t) dw * (band - srch + k) + x0], n, srch, &pre[0], &suf[0]);
+            RunningMaxRows(&mx[0], &mx[0], nrows, n, srch, &pre[0], &suf[0]);
+
+            for (int y = band; y <= bandEnd; y++)
+            {
+                const float *nbrMax = &mx[(size_t)(y - band + srch) * n];
+
+                for (int x = x0 + srch; x <= convRect.GetRight() - srch; x++)
+                {
+                    float val = conv.px[dw * y + x];
+                    if (val <= 0.0 || nbrMax[x - x0] > val)
+                        continue;
+
+                    // compare local maximum to mean value of surrounding pixels
+                    const int local = 7;
+                    double local_mean, local_stdev;
+                    wxRect localRect(x - local, y - local, 2 * local + 1, 2 * local + 1);
+                    localRect.Intersect(convRect);
+                    GetStats(&local_mean, &local_stdev, conv, localRect);
+
+                    // this is our measure of star intensity
+                    double h = (val - local_mean) / global_stdev;
+
+                    if (h < threshold)
+                        continue;
+
+                    // coordinates on the original image
+                    int imgx = x * downsample + downsample / 2;
+                    int imgy = y * downsample + downsample / 2;
+
+                    out.push_back(Peak(imgx, imgy, h));
+                }
+            }
+        }
+    }
+};
+
+bool Star::AutoFind(const usImage& image, int extraEdgeAllowance, int searchRegion, std::vector<Star> *candidates)
+{
+    if (!image.Subframe.IsEmpty())
+    {
+        Debug.AddLine("Autofind called on subframe, returning error");
+        return false; // not found
+    }
+
+    Debug.Write(wxString::Format("Star::AutoFind called with edgeAllowance = %d searchRegion = %d\n", extraEdgeAllowance, searchRegion));
+
+    const int downsample = AutoFindDownsample(image.Size);
+
+    // bin the source image; a binned hot pixel is much fainter but is still
+    // removed by the median filter below
+    usImage binned;
+    const usImage *src = &image;
+    if (downsample > 1)
+    {
+        binned.Init(wxSize(image.Size.GetWidth() / downsample, image.Size.GetHeight() / downsample));
+        BinJob job(binned, image, downsample);
+        RunImageStrips(job, AutoFindStripCount(binned.Size.GetHeight()), binned.Size.GetHeight());
+        src = &binned;
+    }
+
+    int nstrips = AutoFindStripCount(src->Size.GetHeight());
+
+    Debug.Write(wxString::Format("AutoFind: downsample %d, processing %d strips\n", downsample, nstrips));
+
+    // run a 3x3 median first to eliminate hot pixels
+    usImage smoothed;
+    smoothed.Init(src->Size);
+    Median3(smoothed.ImageData, src->ImageData, src->Size, wxRect(src->Size));
+
+    // run the PSF convolution; the smoothed image is converted to floating
+    // point a few rows at a time as the convolution reaches them
+    const ConvKernel& kernel = AutoFindPsfKernel();
+    AutoFindBuffer convBuf;
+    FloatImg& conv = convBuf.img;
+    conv.Init(smoothed.Size);
+    {
+        UsImageRows rows(smoothed);
+        PsfConvJob<UsImageRows> job(conv, rows, kernel);
+        RunImageStrips(job, nstrips, conv.Size.GetHeight());
+    }
+
+    Debug.Write(wxString::Format("AutoFind: %s convolution, radius %d\n", ConvKernel::MethodName(kernel.GetMethod()), kernel.Radius()));
+
+    int const convRadius = kernel.Radius();
+    int dw = conv.Size.GetWidth();      // width of the downsampled image
+    int dh = conv.Size.GetHeight();     // height of the downsampled image
+    wxRect convRect(convRadius, convRadius, dw - 2 * convRadius, dh - 2 * convRadius);  // region containing valid data
+
+    SaveImage(conv, "PHD2_AutoFind.fit");
+
+    enum { TOP_N = 100 };  // keep track of the brightest stars
+    std::set<Peak> stars;  // sorted by ascending intensity
+
+    double global_mean, global_stdev;
+    GetStats(&global_mean, &global_stdev, conv, convRect);
+
+    Debug.Write(wxString::Format("AutoFind: global mean = %.1f, stdev %.1f\n", global_mean, global_stdev));
+
+    const double threshold = 0.1;
+    Debug.Write(wxString::Format("AutoFind: using threshold = %.1f\n", threshold));
+
+    // find each local maximum
+    {
+        FindPeaksJob job(conv, convRect, global_stdev, threshold, downsample, nstrips);
+        RunImageStrips(job, nstrips, dh);
+
+        // merge the strips in scan order, keeping the brightest in a bounded
+        // min-heap. As in the set, peaks of equal intensity are not both
+        // kept, so the first one in scan order wins.
+        std::vector<Peak> top;
+        top.reserve(TOP_N);
+        for (int i = 0; i < nstrips; i++)
+        {
+            const std::vector<Peak>& peaks = job.peaks[i];
+            for (std::vector<Peak>::const_iterator it = peaks.begin(); it != peaks.end(); ++it)
+            {
+                if (top.size() == TOP_N && !(top.front() < *it))
+                    continue;
+
+                bool dup = false;
+                for (size_t j = 0; j < top.size() && !dup; j++)
+                    dup = top[j].val == it->val;
+                if (dup)
+                    continue;
+
+                if (top.size() == TOP_N)
+                {
+                    std::pop_heap(top.begin(), top.end(), std::greater<Peak>());
+                    top.pop_back();
+                }
+                top.push_back(*it);
+                std::push_heap(top.begin(), top.end(), std::greater<Peak>());
+            }
+        }
+        stars.insert(top.begin(), top.end());
+    }
+
+    if (downsample > 1)
+    {
+        // the peaks are only located to within a binned pixel; move each one
+        // to the star's centroid in its neighborhood on the full frame,
+        // keeping the intensity measured on the binned frame for the ranking
+        std::set<Peak> refined;
+        for (std::set<Peak>::const_iterator it = stars.begin(); it != stars.end(); ++it)
+        {
+            Star tmp;
+            if (tmp.Find(&image, 2 * downsample, it->x, it->y, FIND_CENTROID))
+                refined.insert(Peak(ROUND(tmp.X), ROUND(tmp.Y), it->val));
+            else
+                refined.insert(*it);
+        }
+        stars.swap(refined);
+    }
+
+    for (std::set<Peak>::const_reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
+        Debug.Write(wxString::Format("AutoFind: local max [%d, %d] %.1f\n", it->x, it->y, it->val));
+
+    // merge stars that are very close into a single star
+    {
+        const int minlimitsq = 5 * 5;
+    repeat:
+        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
+        {
+            std::set<Peak>::const_iterator b = a;
+            ++b;
+            for (; b != stars.end(); ++b)
+            {
+                int dx = a->x - b->x;
+                int dy = a->y - b->y;
+                int d2 = dx * dx + dy * dy;
+                if (d2 < minlimitsq)
+                {
+                    // very close, treat as single star
+                    Debug.Write(wxString::Format("AutoFind: merge [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
+                    // erase the dimmer one
+                    stars.erase(a);
+                    goto repeat;
+                }
+            }
+        }
+    }
+
+    // exclude stars that would fit within a single searchRegion box
+    {
+        // build a list of stars to be excluded
+        std::set<int> to_erase;
+        const int extra = 5; // extra safety margin
+        const int fullw = searchRegion + extra;
+        for (std::set<Peak>::const_iterator a = stars.begin(); a != stars.end(); ++a)
+        {
+            std::set<Peak>::const_iterator b = a;
+            ++b;
+            for (; b != stars.end(); ++b)
+            {
+                int dx = abs(a->x - b->x);
+                int dy = abs(a->y - b->y);
+                if (dx <= fullw && dy <= fullw)
+                {
+                    // stars closer than search region, exclude them both
+                    // but do not let a very dim star eliminate a very bright star
+                    if (b->val / a->val >= 5.0)
+                    {
+                        Debug.Write(wxString::Format("AutoFind: close dim-bright [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
+                    }
+                    else
+                    {
+                        Debug.Write(wxString::Format("AutoFind: too close [%d, %d] %.1f - [%d, %d] %.1f\n", a->x, a->y, a->val, b->x, b->y, b->val));
+                        to_erase.insert(std::distance(stars.begin(), a));
+                        to_erase.insert(std::distance(stars.begin(), b));
+                    }
+                }
+            }
+        }
+        RemoveItems(stars, to_erase);
+    }
+
+    // exclude stars too close to the edge
+    {
+        enum { MIN_EDGE_DIST = 40 };
+        int edgeDist = MIN_EDGE_DIST + extraEdgeAllowance;
+
+        std::set<Peak>::iterator it = stars.begin();
+        while (it != stars.end())
+        {
+            std::set<Peak>::iterator next = it;
+            ++next;
+            if (it->x <= edgeDist || it->x >= image.Size.GetWidth() - edgeDist ||
+                it->y <= edgeDist || it->y >= image.Size.GetHeight() - edgeDist)
+            {
+                Debug.Write(wxString::Format("AutoFind: too close to edge [%d, %d] %.1f\n", it->x, it->y, it->val));
+                stars.erase(it);
+            }
+            it = next;
+        }
+    }
+
+    // At first I tried running Star::Find on the survivors to find the best
+    // star. This had the unfortunate effect of locating hot pixels which
+    // the psf convolution so nicely avoids. So, don't do that!  -ag
+
+    // try to identify the saturation point
+
+    //  first, find the peak pixel overall
+    unsigned short maxVal = 0;
+    for (unsigned int i = 0; i < image.NPixels; i++)
+        if (image.ImageData[i] > maxVal)
+            maxVal = image.ImageData[i];
+
+    // next see if any of the stars has a flat-top
+    bool foundSaturated = false;
+    for (std::set<Peak>::reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
+    {
+        Star tmp;
+        tmp.Find(&image, searchRegion, it->x, it->y, FIND_CENTROID);
+        if (tmp.WasFound() && tmp.GetError() == STAR_SATURATED)
+        {
+            if ((maxVal - tmp.PeakVal) * 255U > maxVal)
+            {
+                // false positive saturation, flat top but below maxVal
+                Debug.Write(wxString::Format("AutoSelect: false positive saturation peak = %hu, max = %hu\n", tmp.PeakVal, maxVal));
+            }
+            else
+            {
+                // a saturated star was found
+                foundSaturated = true;
+                break;
+            }
+        }
+    }
+
+    unsigned int sat_level; // saturation level, including pedestal
+    if (foundSaturated)
+    {
+        // use the peak overall pixel value as the saturation limit
+        Debug.Write(wxString::Format("AutoSelect: using saturation level peakVal = %hu\n", maxVal));
+        sat_level = maxVal; // includes pedestal
+    }
+    else
+    {
+        // no staurated stars found, can't make any assumption about whether the max val is saturated
+
+        Debug.Write(wxString::Format("AutoSelect: using saturation level from BPP %u and pedestal %hu\n",
+            image.BitsPerPixel, image.Pedestal));
+
+        sat_level = ((1U << image.BitsPerPixel) - 1) + image.Pedestal;
+        if (sat_level > 65535)
+            sat_level = 65535;
+    }
+    unsigned int diff = sat_level > image.Pedestal ? sat_level - image.Pedestal : 0U;
+    // "near-saturation" threshold at 90% saturation
+    unsigned short sat_thresh = (unsigned short)((unsigned int) image.Pedestal + 9 * diff / 10);
+
+    Debug.Write(wxString::Format("AutoSelect: BPP = %u, saturation at %u, pedestal %hu, thresh = %hu\n",
+        image.BitsPerPixel, sat_level, image.Pedestal, sat_thresh));
+
+    // Final star selection
+    //   pass 1: find brightest star with peak value < 90% saturation AND SNR > 6
+    //       this pass will reject saturated and nearly-saturated stars
+    //   pass 2: find brightest non-saturated star
+    //   pass 3: find brightest star, even if saturated
+
+    for (int pass = 1; pass <= 3; pass++)
+    {
+        Debug.Write(wxString::Format("AutoSelect: finding best star pass %d\n", pass));
+
+        for (std::set<Peak>::reverse_iterator it = stars.rbegin(); it != stars.rend(); ++it)
+        {
+            Star tmp;
+            tmp.Find(&image, searchRegion, it->x, it->y, FIND_CENTROID);
+            if (tmp.WasFound())
+            {
+                if (pass == 1)
+                {
+                    if (tmp.PeakVal > sat_thresh)
+                    {
+                        Debug.Write(wxString::Format("Autofind: near-saturated [%d, %d] %.1f Mass %.f SNR %.1f Peak %hu\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR, tmp.PeakVal));
+                        continue;
+                    }
+                    if (tmp.GetError() == STAR_SATURATED || tmp.SNR < 6.0)
+                        continue;
+                }
+                else if (pass == 2)
+                {
+                    if (tmp.GetError() == STAR_SATURATED)
+                    {
+                        Debug.Write(wxString::Format("Autofind: star saturated [%d, %d] %.1f Mass %.f SNR %.1f\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR));
+                        continue;
+                    }
+                }
+
+                // star accepted
+                SetXY(it->x, it->y);
+                Debug.Write(wxString::Format("Autofind returns star at [%d, %d] %.1f Mass %.f SNR %.1f\n", it->x, it->y, it->val, tmp.Mass, tmp.SNR));
+
+                if (candidates)
+                {
+                    // the remaining stars that would have passed pass 1, brightest first
+                    candidates->clear();
+                    for (std::set<Peak>::reverse_iterator c = stars.rbegin(); c != stars.rend(); ++c)
+                    {
+                        if (c == it)
+                            continue;
+                        Star cand;
+                        cand.Find(&image, searchRegion, c->x, c->y, FIND_CENTROID);
+                        if (cand.WasFound() && cand.GetError() != STAR_SATURATED && cand.PeakVal <= sat_thresh && cand.SNR >= 6.0)
+                            candidates->push_back(cand);
+                    }
+                    Debug.Write(wxString::Format("AutoFind: %u additional candidate stars\n", (unsigned int) candidates->size()));
+                }
+
+                return true;
+            }
+        }
+
+        if (pass == 1)
+            Debug.Write("AutoFind: could not find a star on Pass 1\n");
+        else if (pass == 2)
+            Debug.Write("AutoFind: could not find a non-saturated star!\n");
+    }
+
+    Debug.Write("Autofind: no star found\n");
+    return false;
+}
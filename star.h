@@ -40,6 +40,73 @@
 
 #include "point.h"
 
+// row and column profiles of the box of pixels around a star, filled in by
+// Star::Find for the star profile window
+struct StarProfile
+{
+    enum
+    {
+        HALFW = 10,
+        FULLW = 2 * HALFW + 1,
+    };
+
+    bool valid;
+    int midrow[FULLW];      // the row through the star
+    int horiz[FULLW];       // column sums
+    int vert[FULLW];        // row sums
+
+    StarProfile() : valid(false)
+    {
+        for (int i = 0; i < FULLW; i++)
+            midrow[i] = horiz[i] = vert[i] = 0;
+    }
+};
+
+// Running estimate of the sky background around the guide star, kept per
+// tile of the sensor and updated from each frame with exponential
+// forgetting. The star's own aperture, which moves with the star, is left
+// out of the update. Star::Find uses the noise of a tile, measured over many
+// frames, in place of the noise of the one annulus around the peak, so that
+// faint stars are judged against a steadier estimate.
+class StarBackground
+{
+public:
+    StarBackground(void);
+
+    void Reset(void);
+    // add the frame; star is where the star is expected to be in it
+    void Update(const usImage *pImg, const PHD_Point& star, int searchRegion);
+    // background level and variance of a pixel, false if there is no
+    // estimate yet
+    bool Lookup(int x, int y, double *mean, double *sigma2) const;
+
+private:
+    enum
+    {
+        TILE = 8,               // tile size, px
+        EXCLUDE_RADIUS = 9,     // around the star, px
+        MIN_FRAMES = 3,         // before a tile is used
+    };
+
+    struct Tile
+    {
+        double mean;
+        double var;
+        unsigned int frames;
+
+        Tile() : mean(0.0), var(0.0), frames(0) { }
+    };
+
+    void Relocate(int tx0, int ty0, int tx1, int ty1);
+    const Tile *At(int tx, int ty) const;
+
+    // tile coordinates of the tiles kept
+    int m_tx0, m_ty0, m_cols, m_rows;
+    std::vector<Tile> m_tiles;
+    wxSize m_imageSize;
+    int m_exposure;
+};
+
 class Star : public PHD_Point
 {
 public:
@@ -47,6 +114,7 @@ public:
     {
         FIND_CENTROID,
         FIND_PEAK,
+        FIND_GAUSSIAN,      // centroid refined by a Gaussian fit
     };
 
     enum FindResult
@@ -73,9 +141,11 @@ public:
      *       a boolean indicating success instead of a boolean indicating an
      *       error
      */
-    bool Find(const usImage *pImg, int searchRegion, FindMode mode);
-    bool Find(const usImage *pImg, int searchRegion, int X, int Y, FindMode mode);
-    bool AutoFind(const usImage& image, int edgeAllowance, int searchRegion);
+    bool Find(const usImage *pImg, int searchRegion, FindMode mode, StarProfile *profile = 0,
+        const StarBackground *background = 0);
+    bool Find(const usImage *pImg, int searchRegion, int X, int Y, FindMode mode, StarProfile *profile = 0,
+        const StarBackground *background = 0);
+    bool AutoFind(const usImage& image, int edgeAllowance, int searchRegion, std::vector<Star> *candidates = 0);
 
     bool WasFound(FindResult result);
     bool WasFound(void);
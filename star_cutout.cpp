@@ -0,0 +1,82 @@
+/*
+ *  star_cutout.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+StarCutout::StarCutout()
+    : m_generation(0),
+    m_valid(false)
+{
+}
+
+void StarCutout::Update(usImage *img, const PHD_Point& star)
+{
+    m_valid = false;
+
+    if (!img->ImageData || !star.IsValid())
+        return;
+
+    const wxRect& held = img->DataRect;
+    int width = wxMin((int) SIZE, held.GetWidth());
+    int height = wxMin((int) SIZE, held.GetHeight());
+    int x0 = ROUND(star.X) - width / 2;
+    int y0 = ROUND(star.Y) - height / 2;
+    x0 = wxMax(held.GetLeft(), wxMin(x0, held.GetRight() + 1 - width));
+    y0 = wxMax(held.GetTop(), wxMin(y0, held.GetBottom() + 1 - height));
+    wxRect rect(x0, y0, width, height);
+
+    // the cutout must be calibrated and filtered even if the rest of the frame is not yet
+    if (!img->LazyROI.IsEmpty() && !img->LazyROI.Contains(rect))
+        WorkerThread::CompleteLazyROI(*img);
+
+    if (m_img.Init(width, height))
+        return;
+
+    for (int y = 0; y < height; y++)
+        memcpy(&m_img.Pixel(0, y), &img->Pixel(x0, y0 + y), width * sizeof(unsigned short));
+
+    m_img.ImgStartTime = img->ImgStartTime;
+    m_img.ExposureStartUs = img->ExposureStartUs;
+    m_img.ExposureEndUs = img->ExposureEndUs;
+    m_img.ExposureTimed = img->ExposureTimed;
+    m_img.ImgExpDur = img->ImgExpDur;
+    m_img.BitsPerPixel = img->BitsPerPixel;
+    m_img.Pedestal = img->Pedestal;
+    m_img.FiltMin = img->FiltMin;
+    m_img.FiltMax = img->FiltMax;
+
+    m_rect = rect;
+    m_star = star;
+    ++m_generation;
+    m_valid = true;
+}
@@ -0,0 +1,68 @@
+/*
+ *  star_cutout.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_CUTOUT_INCLUDED
+#define STAR_CUTOUT_INCLUDED
+
+// The pixels around the guide star, cut out of each frame once the star has
+// been found and shared read-only by get_star_image and the star image log
+// until the next frame replaces them. The cutout is SIZE pixels square,
+// centered on the star but kept inside the pixels the frame holds, so it
+// covers the largest star image either of them takes. Main thread only.
+class StarCutout
+{
+    usImage m_img;              // the pixels, with the exposure details of the frame
+    wxRect m_rect;              // where they are in the frame
+    PHD_Point m_star;
+    unsigned int m_generation;  // counts the cutouts made
+    bool m_valid;
+
+public:
+    enum { SIZE = 64 };
+
+    StarCutout();
+
+    // cut out the star from img, or invalidate the cutout if there is no star
+    void Update(usImage *img, const PHD_Point& star);
+    void Invalidate(void) { m_valid = false; }
+
+    bool IsValid(void) const { return m_valid; }
+    unsigned int Generation(void) const { return m_generation; }
+    const wxRect& Rect(void) const { return m_rect; }
+    const PHD_Point& Star(void) const { return m_star; }
+    const usImage& Image(void) const { return m_img; }
+    // pixel (x, y) of the frame, which must be inside Rect()
+    const unsigned short *Pixel(int x, int y) const { return &m_img.Pixel(x - m_rect.x, y - m_rect.y); }
+};
+
+#endif
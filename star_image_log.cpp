@@ -0,0 +1,334 @@
+/*
+ *  star_image_log.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "phd.h"
+
+StarImageLog StarImageLogger;
+
+enum
+{
+    CROP_SIZE = 60,
+    MAX_QUEUED = 16,
+    WRITER_INTERVAL_MS = 500,
+};
+
+class StarImageLogWriter : public wxThread
+{
+    StarImageLog *m_log;
+    wxSemaphore m_wake;
+    volatile bool m_stop;
+
+public:
+    StarImageLogWriter(StarImageLog *log) : wxThread(wxTHREAD_JOINABLE), m_log(log), m_stop(false) { }
+
+    void Wake() { m_wake.Post(); }
+    void Stop() { m_stop = true; m_wake.Post(); }
+
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("star image log");
+        ThreadPriorityScope priority(THREAD_CLASS_BACKGROUND, "star image log");
+
+        while (true)
+        {
+            StarImageLog::Item *item = m_log->Pop();
+            if (item)
+            {
+                m_log->WriteItem(item);
+                delete item;
+                continue;
+            }
+            if (m_stop)
+                break;
+            m_wake.WaitTimeout(WRITER_INTERVAL_MS);
+        }
+        return 0;
+    }
+};
+
+StarImageLog::StarImageLog()
+    : m_written(0), m_dropped(0), m_reportedDrops(0), m_writer(0)
+{
+}
+
+StarImageLog::~StarImageLog()
+{
+    // the writer should have been stopped by Shutdown(); do not wait for it this late
+    for (std::deque<Item *>::iterator it = m_queue.begin(); it != m_queue.end(); ++it)
+        delete *it;
+}
+
+void StarImageLog::Post(const StarCutout& cut, const PHD_Point& lock, LOGGED_IMAGE_FORMAT format)
+{
+    if (!cut.IsValid())
+        return;
+
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        if (m_queue.size() >= MAX_QUEUED)
+        {
+            ++m_dropped;
+            return;
+        }
+    }
+
+    // the crop stays inside the cutout, which is already calibrated and filtered
+    const wxRect& held = cut.Rect();
+    const usImage *img = &cut.Image();
+    int width = wxMin(CROP_SIZE, held.GetWidth());
+    int height = wxMin(CROP_SIZE, held.GetHeight());
+    int start_x = ROUND(cut.Star().X) - width / 2;
+    int start_y = ROUND(cut.Star().Y) - height / 2;
+    start_x = wxMax(held.GetLeft(), wxMin(start_x, held.GetRight() + 1 - width));
+    start_y = wxMax(held.GetTop(), wxMin(start_y, held.GetBottom() + 1 - height));
+
+    Item *item = new Item();
+    if (item->crop.Init(width, height))
+    {
+        delete item;
+        return;
+    }
+
+    for (int y = 0; y < height; y++)
+        memcpy(&item->crop.Pixel(0, y), cut.Pixel(start_x, start_y + y), width * sizeof(unsigned short));
+
+    item->crop.ImgStartTime = img->ImgStartTime;
+    item->crop.ExposureStartUs = img->ExposureStartUs;
+    item->crop.ExposureEndUs = img->ExposureEndUs;
+    item->crop.ExposureTimed = img->ExposureTimed;
+    item->crop.ImgExpDur = img->ImgExpDur;
+    item->crop.BitsPerPixel = img->BitsPerPixel;
+    item->crop.Pedestal = img->Pedestal;
+    item->originX = start_x;
+    item->originY = start_y;
+    item->lockX = lock.IsValid() ? lock.X - start_x : -1.0;
+    item->lockY = lock.IsValid() ? lock.Y - start_y : -1.0;
+    item->blevel = img->FiltMin;
+    item->wlevel = img->FiltMax;
+    item->gamma = pFrame->Stretch_gamma;
+    item->format = format;
+    item->time = wxDateTime::Now();
+
+    bool start = false;
+    {
+        wxCriticalSectionLocker lck(m_lock);
+        m_queue.push_back(item);
+        start = !m_writer;
+    }
+
+    if (start)
+    {
+        StarImageLogWriter *writer = new StarImageLogWriter(this);
+        if (writer->Create() == wxTHREAD_NO_ERROR)
+        {
+            writer->SetPriority(WXTHREAD_MIN_PRIORITY);
+            if (writer->Run() == wxTHREAD_NO_ERROR)
+            {
+                m_writer = writer;
+                return;
+            }
+        }
+        // no thread, write synchronously
+        delete writer;
+        Debug.AddLine("StarImageLog: could not start writer thread");
+        while (Item *p = Pop())
+        {
+            WriteItem(p);
+            delete p;
+        }
+    }
+    else
+        m_writer->Wake();
+}
+
+StarImageLog::Item *StarImageLog::Pop()
+{
+    wxCriticalSectionLocker lck(m_lock);
+
+    if (m_queue.empty())
+        return 0;
+
+    Item *item = m_queue.front();
+    m_queue.pop_front();
+    return item;
+}
+
+void StarImageLog::Shutdown()
+{
+    if (m_writer)
+    {
+        m_writer->Stop();
+        m_writer->Wait();
+        delete m_writer;
+        m_writer = 0;
+    }
+
+    wxCriticalSectionLocker lck(m_lock);
+    if (m_dropped)
+        Debug.Write(wxString::Format("StarImageLog: %u images written, %u dropped\n", m_written, m_dropped));
+}
+
+void StarImageLog::GetStats(unsigned int *written, unsigned int *dropped, unsigned int *queued)
+{
+    wxCriticalSectionLocker lck(m_lock);
+    *written = m_written;
+    *dropped = m_dropped;
+    *queued = m_queue.size();
+}
+
+static bool WriteJPEG(StarImageLog::Item& item, const wxString& fname)
+{
+    wxImage *img = 0;
+    item.crop.CopyToImage(&img, item.blevel, item.wlevel, item.gamma);
+
+    // dotted green cross hair through the lock position
+    int w = img->GetWidth();
+    int h = img->GetHeight();
+    int lx = ROUND(item.lockX);
+    int ly = ROUND(item.lockY);
+    if (ly >= 0 && ly < h)
+        for (int x = 0; x < w; x += 2)
+            img->SetRGB(x, ly, 0, 255, 0);
+    if (lx >= 0 && lx < w)
+        for (int y = 0; y < h; y += 2)
+            img->SetRGB(lx, y, 0, 255, 0);
+
+    if (item.format == LIF_HI_Q_JPEG)
+    {
+        // set high(ish) JPEG quality
+        img->SetOption(wxIMAGE_OPTION_QUALITY, 100);
+    }
+
+    bool err = !img->SaveFile(fname, wxBITMAP_TYPE_JPEG);
+    delete img;
+    return err;
+}
+
+static bool WriteFITS(const StarImageLog::Item& item, const wxString& fname)
+{
+    const usImage& img = item.crop;
+
+    fitsfile *fptr;  // FITS file pointer
+    int status = 0;  // CFITSIO status value MUST be initialized to zero!
+    long fpixel[3] = {1,1,1};
+    long fsize[3];
+    char keyname[9]; // was 9
+    char keycomment[100];
+    char keystring[100];
+    int output_format=USHORT_IMG;
+
+    fsize[0] = img.Size.GetWidth();
+    fsize[1] = img.Size.GetHeight();
+    fsize[2] = 0;
+    PHD_fits_create_file(&fptr, fname, false, &status);
+    if (!status)
+    {
+        if (item.format == LIF_COMPRESSED_FITS)
+            fits_set_compression_type(fptr, RICE_1, &status);
+
+        if (!status) fits_create_img(fptr,output_format, 2, fsize, &status);
+
+        time_t now = item.time.GetTicks();
+        struct tm *timestruct = gmtime(&now);
+        sprintf(keyname,"DATE");
+        sprintf(keycomment,"UTC date that FITS file was created");
+        sprintf(keystring,"%.4d-%.2d-%.2d %.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
+        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
+
+        sprintf(keyname,"DATE-OBS");
+        sprintf(keycomment,"YYYY-MM-DDThh:mm:ss observation start, UT");
+        sprintf(keystring,"%s", (const char *) img.GetImgStartTime().c_str());
+        if (!status) fits_write_key(fptr, TSTRING, keyname, keystring, keycomment, &status);
+
+        sprintf(keyname,"EXPOSURE");
+        sprintf(keycomment,"Exposure time [s]");
+        float dur = (float) img.ImgExpDur / 1000.0;
+        if (!status) fits_write_key(fptr, TFLOAT, keyname, &dur, keycomment, &status);
+
+        unsigned int tmp = 1;
+        sprintf(keyname,"XBINNING");
+        sprintf(keycomment,"Camera binning mode");
+        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
+        sprintf(keyname,"YBINNING");
+        sprintf(keycomment,"Camera binning mode");
+        fits_write_key(fptr, TUINT, keyname, &tmp, keycomment, &status);
+
+        sprintf(keyname,"XORGSUB");
+        sprintf(keycomment,"Subframe x position in binned pixels");
+        int org = item.originX;
+        fits_write_key(fptr, TINT, keyname, &org, keycomment, &status);
+        sprintf(keyname,"YORGSUB");
+        sprintf(keycomment,"Subframe y position in binned pixels");
+        org = item.originY;
+        fits_write_key(fptr, TINT, keyname, &org, keycomment, &status);
+
+        if (!status) fits_write_pix(fptr,TUSHORT,fpixel,img.NPixels,img.ImageData,&status);
+
+        PHD_fits_close_file(fptr);
+    }
+
+    return status != 0;
+}
+
+void StarImageLog::WriteItem(Item *item)
+{
+    wxString fname = Debug.GetLogDir() + PATHSEPSTR + "PHD_GuideStar" + item->time.Format(_T("_%j_%H%M%S"));
+
+    bool err;
+    switch (item->format)
+    {
+    case LIF_RAW_FITS:
+        err = WriteFITS(*item, fname + ".fit");
+        break;
+    case LIF_COMPRESSED_FITS:
+        err = WriteFITS(*item, fname + ".fit.fz");
+        break;
+    default:
+        err = WriteJPEG(*item, fname + ".jpg");
+        break;
+    }
+
+    wxCriticalSectionLocker lck(m_lock);
+
+    if (err)
+        Debug.Write(wxString::Format("StarImageLog: could not write %s\n", fname));
+    else
+        ++m_written;
+
+    if (m_dropped != m_reportedDrops)
+    {
+        Debug.Write(wxString::Format("StarImageLog: disk not keeping up, %u images dropped\n", m_dropped - m_reportedDrops));
+        m_reportedDrops = m_dropped;
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ *  star_image_log.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2016 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef STAR_IMAGE_LOG_INCLUDED
+#define STAR_IMAGE_LOG_INCLUDED
+
+class StarImageLogWriter;
+
+// Image logging of the guide star. The guider posts a small crop around the
+// star for each frame; a background thread encodes it (JPEG, FITS or
+// compressed FITS) and writes it to the log directory. The queue is bounded:
+// when the disk cannot keep up, crops are dropped and counted.
+class StarImageLog
+{
+public:
+    struct Item
+    {
+        usImage crop;
+        int originX, originY;       // crop position in the full frame
+        double lockX, lockY;        // lock position, crop coordinates
+        int blevel, wlevel;         // display stretch, for JPEG
+        double gamma;
+        LOGGED_IMAGE_FORMAT format;
+        wxDateTime time;
+    };
+
+private:
+    wxCriticalSection m_lock;       // protects the queue and the counters
+    std::deque<Item *> m_queue;
+    unsigned int m_written;
+    unsigned int m_dropped;
+    unsigned int m_reportedDrops;
+    StarImageLogWriter *m_writer;
+
+    friend class StarImageLogWriter;
+
+    Item *Pop();
+    void WriteItem(Item *item);
+
+public:
+    StarImageLog();
+    ~StarImageLog();
+
+    void Post(const StarCutout& cut, const PHD_Point& lock, LOGGED_IMAGE_FORMAT format);
+    void Shutdown();                // write out what is queued and stop the thread
+    void GetStats(unsigned int *written, unsigned int *dropped, unsigned int *queued);
+};
+
+extern StarImageLog StarImageLogger;
+
+#endif
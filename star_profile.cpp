@@ -42,8 +42,7 @@ END_EVENT_TABLE()
 
 enum
 {
-    HALFW = 10,
-    FULLW = 2 * HALFW + 1,
+    FULLW = StarProfile::FULLW,
 };
 
 ProfileWindow::ProfileWindow(wxWindow *parent) :
@@ -54,12 +53,10 @@ ProfileWindow::ProfileWindow(wxWindow *parent) :
     this->visible = false;
     this->mode = 0; // 2D profile
     this->SetBackgroundStyle(wxBG_STYLE_CUSTOM);
-    this->data = new unsigned short[FULLW * FULLW];  // 21x21 subframe
 }
 
 ProfileWindow::~ProfileWindow()
 {
-    delete[] data;
 }
 
 void ProfileWindow::OnLClick(wxMouseEvent& WXUNUSED(mevent))
@@ -76,35 +73,19 @@ void ProfileWindow::SetState(bool is_active)
         Refresh();
 }
 
-void ProfileWindow::UpdateData(usImage *pImg, float xpos, float ypos)
+// the profile comes from Star::Find, which only computes it while the
+// window is shown
+bool ProfileWindow::IsActive(void) const
 {
-    if (this->data == NULL) return;
-    int xstart = ROUNDF(xpos) - HALFW;
-    int ystart = ROUNDF(ypos) - HALFW;
-    if (xstart < 0) xstart = 0;
-    else if (xstart > (pImg->Size.GetWidth() - (FULLW + 1)))
-        xstart = pImg->Size.GetWidth() - (FULLW + 1);
-    if (ystart < 0) ystart = 0;
-    else if (ystart > (pImg->Size.GetHeight() - (FULLW + 1)))
-        ystart = pImg->Size.GetHeight() - (FULLW + 1);
-
-    int x,y;
-    unsigned short *uptr = this->data;
-    const int xrowsize = pImg->Size.GetWidth();
-    for (x = 0; x < FULLW; x++)
-        horiz_profile[x] = vert_profile[x] = midrow_profile[x] = 0;
-    for (y = 0; y < FULLW; y++) {
-        for (x = 0; x < FULLW; x++, uptr++) {
-            *uptr = *(pImg->ImageData + xstart + x + (ystart + y) * xrowsize);
-            horiz_profile[x] += (int) *uptr;
-            vert_profile[y] += (int) *uptr;
-        }
-    }
-    uptr = this->data + (FULLW * HALFW);
-    for (x = 0; x < FULLW; x++, uptr++)
-        midrow_profile[x] = (int) *uptr;
-    if (this->visible)
-        Refresh();
+    return this->visible && !pFrame->IsHeadless();
+}
+
+void ProfileWindow::UpdateData(const StarProfile& starProfile)
+{
+    if (!IsActive() || !starProfile.valid)
+        return;
+    this->profile = starProfile;
+    pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_PROFILE);
 }
 
 void ProfileWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
@@ -159,15 +140,15 @@ void ProfileWindow::OnPaint(wxPaintEvent& WXUNUSED(evt))
     switch (this->mode) {  // Figure which profile to use
     case 0: // mid-row
     default:
-        profptr = midrow_profile;
+        profptr = profile.midrow;
         profileLabel = _("Mid row");
         break;
     case 1: // avg row
-        profptr = horiz_profile;
+        profptr = profile.horiz;
         profileLabel = _("Avg row");
         break;
     case 2:
-        profptr = vert_profile;
+        profptr = profile.vert;
         profileLabel = _("Avg col");
         break;
     }
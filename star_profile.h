@@ -40,15 +40,15 @@ class ProfileWindow : public wxWindow {
 public:
     ProfileWindow(wxWindow *parent);
     ~ProfileWindow(void);
-    void UpdateData(usImage *pImg, float xpos, float ypos);
+    void UpdateData(const StarProfile& starProfile);
     void OnPaint(wxPaintEvent& evt);
     void SetState(bool is_active);
+    bool IsActive(void) const;
     void OnLClick(wxMouseEvent& evt);
 private:
     int mode; // 0= 2D profile of mid-row, 1=2D of avg_row, 2=2D of avg_col
     bool visible;
-    unsigned short *data;
-    int horiz_profile[21], vert_profile[21], midrow_profile[21];
+    StarProfile profile;
     DECLARE_EVENT_TABLE()
 };
 
@@ -0,0 +1,351 @@
+/*
+ *  star_track.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "star_track.h"
+#include "guidelog_binary.h"
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+
+#include <atomic>
+
+struct StarTrackFrame
+{
+    wxString file;
+    int exposure;           // ms, 0 if the frame does not say
+    bool found;
+    double x, y;
+    double snr, hfd, mass;
+    int error;              // Star::FindResult
+    wxString message;       // why the frame could not be measured
+
+    StarTrackFrame() : exposure(0), found(false), x(0.), y(0.), snr(0.), hfd(0.), mass(0.), error(Star::STAR_ERROR) { }
+};
+
+// Reads a 2D FITS image from a memory-mapped file. CFITSIO is reentrant as
+// long as each thread has its own fitsfile, so frames can be read in
+// parallel. Returns true on error.
+static bool LoadMapped(const wxString& fname, usImage *img, wxString *errorMsg)
+{
+    MappedFileBuffer *map = new MappedFileBuffer();
+    if (map->Open(fname))
+    {
+        map->Release();
+        *errorMsg = "cannot map the file";
+        return true;
+    }
+
+    void *buf = map->MutableBase();
+    size_t size = map->Size();
+    int status = 0;
+    fitsfile *fptr;
+    bool err = true;
+
+    if (fits_open_memfile(&fptr, "", READONLY, &buf, &size, 0, NULL, &status))
+    {
+        *errorMsg = "not a FITS file";
+        map->Release();
+        return true;
+    }
+
+    int hdutype, naxis = 0, nhdus = 0;
+    long fsize[2];
+    if (fits_get_hdu_type(fptr, &hdutype, &status) || hdutype != IMAGE_HDU)
+        *errorMsg = "the FITS file is not of an image";
+    else
+    {
+        fits_get_img_dim(fptr, &naxis, &status);
+        fits_get_num_hdus(fptr, &nhdus, &status);
+        if (nhdus == 2 && naxis == 0)
+        {
+            // tile compressed, the image is in the extension
+            fits_movabs_hdu(fptr, 2, &hdutype, &status);
+            fits_get_img_dim(fptr, &naxis, &status);
+            nhdus = 1;
+        }
+        fits_get_img_size(fptr, 2, fsize, &status);
+
+        long fpixel[3] = { 1, 1, 1 };
+        if (status || nhdus != 1 || naxis != 2)
+            *errorMsg = "unsupported FITS image";
+        else if (img->Init((int) fsize[0], (int) fsize[1]))
+            *errorMsg = "memory allocation error";
+        else if (fits_read_pix(fptr, TUSHORT, fpixel, (long)(fsize[0] * fsize[1]), NULL, img->ImageData, NULL, &status))
+            *errorMsg = "error reading the image data";
+        else
+        {
+            float exposure;
+            status = 0;
+            if (fits_read_key(fptr, TFLOAT, const_cast<char *>("EXPOSURE"), &exposure, NULL, &status) == 0)
+                img->ImgExpDur = (int) (exposure * 1000.0);
+            else
+                img->ImgExpDur = 0;
+            err = false;
+        }
+    }
+
+    PHD_fits_close_file(fptr);
+    map->Release();
+
+    return err;
+}
+
+struct StarTrackJob : public ImageStripJob
+{
+    const StarTrackOptions& m_opts;
+    const usImage *m_dark;
+    const DefectMap *m_defects;
+    std::vector<StarTrackFrame>& m_frames;
+    std::atomic<int> m_next;
+
+    StarTrackJob(const StarTrackOptions& opts, const usImage *dark, const DefectMap *defects, std::vector<StarTrackFrame>& frames,
+                 int first)
+        : m_opts(opts), m_dark(dark), m_defects(defects), m_frames(frames), m_next(first) { }
+
+    // frames take about the same time, but each thread takes the next frame
+    // not yet started so a slow disk read does not hold up a whole strip
+    void ProcessRows(int strip, int rowBegin, int rowEnd)
+    {
+        int i;
+        while ((i = m_next.fetch_add(1)) < (int) m_frames.size())
+            Process(m_frames[i]);
+    }
+
+    void Process(StarTrackFrame& frame) const;
+};
+
+void StarTrackJob::Process(StarTrackFrame& frame) const
+{
+    usImage img;
+    if (LoadMapped(frame.file, &img, &frame.message))
+        return;
+    frame.exposure = img.ImgExpDur;
+
+    if (m_dark)
+    {
+        if (m_dark->Size != img.Size)
+        {
+            frame.message = "the dark is not the size of the frame";
+            return;
+        }
+        Subtract(img, *m_dark);
+    }
+    if (m_defects)
+        RemoveDefects(img, *m_defects);
+
+    int const search = m_opts.searchRegion;
+
+    Star star;
+    if (!star.AutoFind(img, 0, search))
+    {
+        frame.message = "no star found";
+        return;
+    }
+
+    Star s;
+    frame.found = s.Find(&img, search, ROUND(star.X), ROUND(star.Y), Star::FIND_CENTROID);
+    frame.x = s.X;
+    frame.y = s.Y;
+    frame.snr = s.SNR;
+    frame.hfd = s.HFD;
+    frame.mass = s.Mass;
+    frame.error = s.GetError();
+}
+
+static bool WriteCsv(const wxString& fname, const StarTrackOptions& opts, const std::vector<StarTrackFrame>& frames,
+                     wxString *errorMsg)
+{
+    wxFFile out(fname, "w");
+    if (!out.IsOpened())
+    {
+        *errorMsg = wxString::Format("cannot write %s", fname);
+        return true;
+    }
+
+    out.Write(wxString::Format("# PHD2 %s star track of %s, %s\n", FULLVER, opts.dir, wxDateTime::Now().FormatISOCombined(' ')));
+    out.Write("frame,file,exposure_ms,found,x,y,snr,hfd,mass,error,message\n");
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const StarTrackFrame& f = frames[i];
+        out.Write(wxString::Format("%u,\"%s\",%d,%d,%.3f,%.3f,%.2f,%.3f,%.1f,%d,\"%s\"\n", (unsigned int) i + 1,
+            wxFileName(f.file).GetFullName(), f.exposure, f.found ? 1 : 0, f.x, f.y, f.snr, f.hfd, f.mass, f.error, f.message));
+    }
+
+    if (!out.Close())
+    {
+        *errorMsg = wxString::Format("error writing %s", fname);
+        return true;
+    }
+    return false;
+}
+
+static bool WriteBinary(const wxString& fname, const StarTrackOptions& opts, const std::vector<StarTrackFrame>& frames,
+                        wxString *errorMsg)
+{
+    GuideLogBinaryWriter out;
+    if (out.Open(fname))
+    {
+        *errorMsg = wxString::Format("cannot write %s", fname);
+        return true;
+    }
+
+    wxDateTime now = wxDateTime::Now();
+    out.Event(GLB_EV_TEXT, wxString::Format("PHD2 version %s, star track of %s\n", FULLVER, opts.dir));
+    out.GuidingStarted(now);
+    out.Event(GLB_EV_GUIDING_BEGINS, "\nGuiding Begins at " + now.Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+
+    // the offsets are from the star in the first frame it was found in, and
+    // the step times are the exposures added up
+    double refX = 0., refY = 0.;
+    bool haveRef = false;
+    double t = 0.;
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const StarTrackFrame& f = frames[i];
+        t += f.exposure / 1000.0;
+
+        GuideLogBinStep step;
+        memset(&step, 0, sizeof(step));
+        step.time = t;
+        step.frame = (int) i + 1;
+        step.starError = f.error;
+
+        if (!f.found)
+        {
+            step.kind = GLB_STEP_DROPPED;
+            out.Step(step, f.message.empty() ? wxString("Star lost") : f.message);
+            continue;
+        }
+
+        if (!haveRef)
+        {
+            refX = f.x;
+            refY = f.y;
+            haveRef = true;
+        }
+
+        step.kind = GLB_STEP_MOUNT;
+        step.dx = (float) (f.x - refX);
+        step.dy = (float) (f.y - refY);
+        step.starMass = (float) f.mass;
+        step.starSNR = (float) f.snr;
+        out.Step(step);
+    }
+
+    out.Event(GLB_EV_GUIDING_ENDS, "Guiding Ends at " + wxDateTime::Now().Format(_T("%Y-%m-%d %H:%M:%S")) + "\n");
+    out.Close();
+
+    return false;
+}
+
+bool StarTrack::Run(const StarTrackOptions& opts, int *frameCount, int *foundCount, wxString *errorMsg)
+{
+    *frameCount = *foundCount = 0;
+
+    wxArrayString files;
+    if (wxDirExists(opts.dir))
+    {
+        wxDir::GetAllFiles(opts.dir, &files, "*.fit", wxDIR_FILES);
+        wxDir::GetAllFiles(opts.dir, &files, "*.fits", wxDIR_FILES);
+        wxDir::GetAllFiles(opts.dir, &files, "*.fz", wxDIR_FILES);
+    }
+    files.Sort();
+    if (files.empty())
+    {
+        *errorMsg = wxString::Format("no FITS frames in %s", opts.dir);
+        return true;
+    }
+
+    usImage dark;
+    if (!opts.darkFile.empty())
+    {
+        wxString err;
+        if (LoadMapped(opts.darkFile, &dark, &err))
+        {
+            *errorMsg = wxString::Format("cannot load the dark %s: %s", opts.darkFile, err);
+            return true;
+        }
+    }
+
+    DefectMap *defects = 0;
+    if (opts.defects)
+    {
+        defects = DefectMap::LoadDefectMap(pConfig->GetCurrentProfileId());
+        if (!defects)
+        {
+            *errorMsg = "the profile has no defect map";
+            return true;
+        }
+    }
+
+    std::vector<StarTrackFrame> frames(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+        frames[i].file = files[i];
+
+    wxStopWatch swatch;
+
+    // the first frame is measured on its own: AutoFind sets up its shared
+    // state on first use
+    StarTrackJob job(opts, opts.darkFile.empty() ? 0 : &dark, defects, frames, 1);
+    job.Process(frames[0]);
+
+    int const remaining = (int) frames.size() - 1;
+    if (remaining > 0)
+        RunImageStrips(job, ImageStripCount(remaining, 1), remaining);
+
+    delete defects;
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].found)
+            ++*foundCount;
+        else
+            Debug.Write(wxString::Format("StarTrack: %s: %s\n", frames[i].file,
+                frames[i].message.empty() ? wxString::Format("star error %d", frames[i].error) : frames[i].message));
+    }
+    *frameCount = (int) frames.size();
+
+    Debug.Write(wxString::Format("StarTrack: %d frames, star found in %d, in %ld ms\n", *frameCount, *foundCount, swatch.Time()));
+
+    wxString outFile = opts.outFile;
+    if (outFile.empty())
+        outFile = wxFileName(opts.dir, "PHD2_StarTrack.csv").GetFullPath();
+
+    if (outFile.Lower().EndsWith(".bin"))
+        return WriteBinary(outFile, opts, frames, errorMsg);
+    return WriteCsv(outFile, opts, frames, errorMsg);
+}
@@ -0,0 +1,65 @@
+/*
+ *  star_track.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STAR_TRACK_INCLUDED
+#define STAR_TRACK_INCLUDED
+
+struct StarTrackOptions
+{
+    wxString dir;           // directory of FITS frames, processed in file name order
+    wxString outFile;       // .csv, or .bin for the binary guide log format; default <dir>/PHD2_StarTrack.csv
+    wxString darkFile;      // optional dark frame of the same size as the frames
+    bool defects;           // remove the current profile's defect map
+    int searchRegion;       // pixels
+
+    StarTrackOptions() : defects(false), searchRegion(15) { }
+};
+
+// Batch star measurement of a directory of guide frames: each frame is
+// calibrated like a captured frame (dark subtraction, defect map), the star
+// is picked with Star::AutoFind and measured with Star::Find, and the
+// centroid, SNR, HFD and mass of every frame are written out. The frames are
+// memory-mapped and measured in parallel, each on its own, so the results do
+// not depend on the order the frames were processed in.
+//
+// CSV output has one row per frame; the binary output is a guide log (see
+// guidelog_binary.h) with a step per frame, the offset from the star in the
+// first frame as the camera offset and dropped frames where no star was
+// found, so the guide log tools can read it.
+struct StarTrack
+{
+    // returns true on error
+    static bool Run(const StarTrackOptions& opts, int *frames, int *found, wxString *errorMsg);
+};
+
+#endif
@@ -83,7 +83,7 @@ StatsWindow::StatsWindow(wxWindow *parent)
     m_grid1->ClearSelection();
 
     m_grid2 = new wxGrid(this, wxID_ANY);
-    m_grid2->CreateGrid(9, 2);
+    m_grid2->CreateGrid(11, 2);
     m_grid2->SetRowLabelSize(1);
     m_grid2->SetColLabelSize(1);
     m_grid2->EnableEditing(false);
@@ -111,6 +111,10 @@ StatsWindow::StatsWindow(wxWindow *parent)
     ++row, col = 0;
     m_grid2->SetCellValue(row, col++, _("Camera cooler"));
     m_grid2->SetCellValue(row, col, "-99" DEGREES_SYMBOL " / -99" DEGREES_SYMBOL ", 999%");
+    ++row, col = 0;
+    m_grid2->SetCellValue(row, col++, _("Cycle p95"));
+    ++row, col = 0;
+    m_grid2->SetCellValue(row, col++, _("Slow cycles"));
 
     m_grid2->AutoSize();
     m_grid2->SetCellValue(3, 1, _T(""));
@@ -179,42 +183,85 @@ void StatsWindow::UpdateStats(void)
 
     const double sampling = pFrame ? pFrame->GetCameraPixelScale() : 1.0;
 
-    m_grid1->BeginBatch();
-    m_grid2->BeginBatch();
+    // Only the cells whose values changed are set. The grids are not batched
+    // since EndBatch repaints the whole grid, while setting a cell outside a
+    // batch repaints just that cell.
 
     int row = 1, col = 1;
-    m_grid1->SetCellValue(row++, col, arcsecs(stats.rms_ra, sampling));
-    m_grid1->SetCellValue(row++, col, arcsecs(stats.rms_dec, sampling));
-    m_grid1->SetCellValue(row++, col, arcsecs(stats.rms_tot, sampling));
+    if (m_cells[CELL_RMS_RA].Changed(stats.rms_ra, sampling))
+        m_grid1->SetCellValue(row, col, arcsecs(stats.rms_ra, sampling));
+    ++row;
+    if (m_cells[CELL_RMS_DEC].Changed(stats.rms_dec, sampling))
+        m_grid1->SetCellValue(row, col, arcsecs(stats.rms_dec, sampling));
+    ++row;
+    if (m_cells[CELL_RMS_TOT].Changed(stats.rms_tot, sampling))
+        m_grid1->SetCellValue(row, col, arcsecs(stats.rms_tot, sampling));
 
     row = 1, col = 2;
-    m_grid1->SetCellValue(row++, col, arcsecs(stats.ra_peak, sampling));
-    m_grid1->SetCellValue(row++, col, arcsecs(stats.dec_peak, sampling));
+    if (m_cells[CELL_PEAK_RA].Changed(stats.ra_peak, sampling))
+        m_grid1->SetCellValue(row, col, arcsecs(stats.ra_peak, sampling));
+    ++row;
+    if (m_cells[CELL_PEAK_DEC].Changed(stats.dec_peak, sampling))
+        m_grid1->SetCellValue(row, col, arcsecs(stats.dec_peak, sampling));
 
     row = 0, col = 1;
-    if (stats.osc_alert)
-        m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
-    else
-        m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
-    m_grid2->SetCellValue(row++, col, wxString::Format("% .02f", stats.osc_index));
+    if (m_cells[CELL_OSC].Changed(stats.osc_index, stats.osc_alert))
+    {
+        if (stats.osc_alert)
+            m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
+        else
+            m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
+        m_grid2->SetCellValue(row, col, wxString::Format("% .02f", stats.osc_index));
+    }
+    ++row;
 
     unsigned int historyItems = wxMax(pFrame->pGraphLog->GetHistoryItemCount(), 1); // avoid divide-by-zero
-    if (stats.ra_limit_cnt > 0)
-        m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
-    else
-        m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
-    m_grid2->SetCellValue(row++, col, wxString::Format(" %u (%.f%%)", stats.ra_limit_cnt, stats.ra_limit_cnt * 100. / historyItems));
+    if (m_cells[CELL_RA_LIMITED].Changed(stats.ra_limit_cnt, historyItems))
+    {
+        if (stats.ra_limit_cnt > 0)
+            m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
+        else
+            m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
+        m_grid2->SetCellValue(row, col, wxString::Format(" %u (%.f%%)", stats.ra_limit_cnt, stats.ra_limit_cnt * 100. / historyItems));
+    }
+    ++row;
 
-    if (stats.dec_limit_cnt > 0)
-        m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
-    else
-        m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
-    m_grid2->SetCellValue(row++, col, wxString::Format(" %u (%.f%%)", stats.dec_limit_cnt, stats.dec_limit_cnt * 100. / historyItems));
+    if (m_cells[CELL_DEC_LIMITED].Changed(stats.dec_limit_cnt, historyItems))
+    {
+        if (stats.dec_limit_cnt > 0)
+            m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
+        else
+            m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
+        m_grid2->SetCellValue(row, col, wxString::Format(" %u (%.f%%)", stats.dec_limit_cnt, stats.dec_limit_cnt * 100. / historyItems));
+    }
+    ++row;
 
-    m_grid2->SetCellValue(row++, col, wxString::Format(" %u", stats.star_lost_cnt));
+    if (m_cells[CELL_STAR_LOST].Changed(stats.star_lost_cnt))
+        m_grid2->SetCellValue(row, col, wxString::Format(" %u", stats.star_lost_cnt));
+
+    // processing time per guide cycle over the last few minutes, see PerfStats
+    PerfSummary cycle;
+    PerfStats::GetWindow(PERF_STAGE_CYCLE, &cycle);
+    row = 9;
+    if (m_cells[CELL_CYCLE_P95].Changed(cycle.count > 0, cycle.count ? cycle.p95Ms : 0.0))
+    {
+        if (cycle.count)
+            m_grid2->SetCellValue(row, col, wxString::Format(" %.1f ms", cycle.p95Ms));
+        else
+            m_grid2->SetCellValue(row, col, _T(" -"));
+    }
+    ++row;
 
-    m_grid1->EndBatch();
-    m_grid2->EndBatch();
+    unsigned int cycles = wxMax(PerfStats::Cycles(), 1);
+    unsigned int slow = PerfStats::SlowCycles();
+    if (m_cells[CELL_SLOW_CYCLES].Changed(slow, cycles))
+    {
+        if (slow > 0)
+            m_grid2->SetCellTextColour(row, col, wxColour(185, 20, 0));
+        else
+            m_grid2->SetCellTextColour(row, col, *wxLIGHT_GREY);
+        m_grid2->SetCellValue(row, col, wxString::Format(" %u (%.f%%)", slow, slow * 100. / cycles));
+    }
 }
 
 static wxString CamCoolerStatus()
@@ -272,15 +319,15 @@ void StatsWindow::UpdateScopePointing()
 {
     if (pPointingSource)
     {
-        double declination = pPointingSource->GetDeclination();
-        PierSide pierSide = pPointingSource->SideOfPier();
+        double declination = PointingCache::Declination();
+        PierSide pierSide = PointingCache::SideOfPier();
 
         m_grid2->BeginBatch();
         int row = 4, col = 1;
         m_grid2->SetCellValue(row++, col, Mount::DeclinationStr(declination, "% .1f" DEGREES_SYMBOL));
         m_grid2->SetCellValue(row++, col, Mount::PierSideStr(pierSide));
         m_grid2->SetCellValue(row++, col, RotatorPosStr());
-        m_grid2->SetCellValue(row++, col, wxString::Format("%hu", pCamera->Binning));
+        m_grid2->SetCellValue(row++, col, wxString::Format("%hu", pCamera->EffectiveBinning()));
         m_grid2->EndBatch();
     }
 }
@@ -35,11 +35,49 @@
 #ifndef STATSWINDOW_INCLUDED
 #define STATSWINDOW_INCLUDED
 
+// The values a grid cell was last formatted from, so that a cell is only
+// reformatted and repainted when what it shows changes
+class StatsCell
+{
+    double m_val1;
+    double m_val2;
+    bool m_valid;
+
+public:
+    StatsCell() : m_valid(false) { }
+    bool Changed(double val1, double val2 = 0.0)
+    {
+        if (m_valid && val1 == m_val1 && val2 == m_val2)
+            return false;
+        m_val1 = val1;
+        m_val2 = val2;
+        m_valid = true;
+        return true;
+    }
+};
+
 class StatsWindow : public wxWindow
 {
+    enum StatsCells
+    {
+        CELL_RMS_RA,
+        CELL_RMS_DEC,
+        CELL_RMS_TOT,
+        CELL_PEAK_RA,
+        CELL_PEAK_DEC,
+        CELL_OSC,
+        CELL_RA_LIMITED,
+        CELL_DEC_LIMITED,
+        CELL_STAR_LOST,
+        CELL_CYCLE_P95,
+        CELL_SLOW_CYCLES,
+        NUM_STATS_CELLS
+    };
+
     bool m_visible;
     wxGrid *m_grid1;
     wxGrid *m_grid2;
+    StatsCell m_cells[NUM_STATS_CELLS];
     int m_length;
     OptionsButton *m_pLengthButton;
     wxTimer m_coolerTimer;
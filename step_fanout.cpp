@@ -0,0 +1,132 @@
+/*
+ *  step_fanout.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <algorithm>
+
+GuideStepFanOut StepFanOut;
+
+GuideStepFanOut::GuideStepFanOut()
+    : m_first(0), m_scheduled(false)
+{
+    for (int i = 0; i < NUM_CONSUMERS; i++)
+    {
+        m_next[i] = 0;
+        m_draining[i] = false;
+    }
+}
+
+void GuideStepFanOut::Publish(const GuideStepInfo& step, long long seq)
+{
+    Record rec;
+    rec.step = step;
+    rec.seq = seq;
+    m_records.push_back(rec);
+
+    if (!m_scheduled)
+    {
+        m_scheduled = true;
+        CallAfter(&GuideStepFanOut::DrainAll);
+    }
+}
+
+void GuideStepFanOut::Deliver(Consumer c, const Record& rec)
+{
+    const GuideStepInfo& step = rec.step;
+
+    switch (c)
+    {
+    case CONSUMER_LOG:
+        GuideLog.GuideStep(step);
+        break;
+
+    case CONSUMER_EVENTS:
+        EvtServer.NotifyGuideStep(step);
+        if (rec.seq >= 0 && rec.seq >= Telemetry.Begin())
+            TelemetryFeed.PublishGuideStep(rec.seq);
+        break;
+
+    case CONSUMER_VIEWS:
+        pFrame->UpdateGuiderInfo(step);
+        PolarDrift::NotifyGuideStep(step);
+        if (rec.seq >= 0)
+        {
+            // the windows show views of the telemetry, so they take the
+            // steps in the order they were stored
+            pFrame->pGraphLog->AppendData(step);
+            pFrame->pTarget->AppendData(step);
+            GuidingAssistant::NotifyGuideStep(step);
+            DriftTool::NotifyGuideStep(step);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void GuideStepFanOut::Drain(Consumer c)
+{
+    // a consumer writing its own entries while it takes a step must not
+    // take the next step ahead of this one
+    if (m_draining[c])
+        return;
+    m_draining[c] = true;
+
+    while (m_next[c] < m_first + (long long) m_records.size())
+    {
+        const Record rec = m_records[(size_t)(m_next[c] - m_first)];
+        ++m_next[c];
+        Deliver(c, rec);
+    }
+
+    m_draining[c] = false;
+
+    // drop the records every consumer has taken
+    long long done = m_next[0];
+    for (int i = 1; i < NUM_CONSUMERS; i++)
+        done = std::min(done, m_next[i]);
+    while (m_first < done)
+    {
+        m_records.pop_front();
+        ++m_first;
+    }
+}
+
+void GuideStepFanOut::DrainAll()
+{
+    m_scheduled = false;
+    for (int i = 0; i < NUM_CONSUMERS; i++)
+        Drain((Consumer) i);
+}
@@ -0,0 +1,84 @@
+/*
+ *  step_fanout.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef STEP_FANOUT_INCLUDED
+#define STEP_FANOUT_INCLUDED
+
+#include <deque>
+
+// After each guide step the guide path only adds the step to the telemetry
+// store and publishes it here. The other consumers of the step -- the guide
+// log, the event server with the multicast feed, and the windows -- take it
+// on the next turn of the event loop, after any exposure or move completion
+// already waiting to be handled. Each consumer reads the published steps in
+// order with its own cursor. The guide log and the event server drain the
+// steps queued for them before writing any other entry, so their output is
+// in the same order as when the steps were delivered inline.
+class GuideStepFanOut : public wxEvtHandler
+{
+public:
+    enum Consumer
+    {
+        CONSUMER_LOG,
+        CONSUMER_EVENTS,
+        CONSUMER_VIEWS,
+        NUM_CONSUMERS
+    };
+
+private:
+    struct Record
+    {
+        GuideStepInfo step;
+        long long seq;          // sequence number in the telemetry store, -1 for a direct move
+    };
+
+    std::deque<Record> m_records;
+    long long m_first;                  // number of the oldest record held
+    long long m_next[NUM_CONSUMERS];    // number of the next record for each consumer
+    bool m_draining[NUM_CONSUMERS];
+    bool m_scheduled;
+
+    void Deliver(Consumer c, const Record& rec);
+
+public:
+    GuideStepFanOut();
+
+    // main thread only
+    void Publish(const GuideStepInfo& step, long long seq);
+    void Drain(Consumer c);
+    void DrainAll();
+};
+
+extern GuideStepFanOut StepFanOut;
+
+#endif
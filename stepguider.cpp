@@ -58,6 +58,15 @@ StepGuider::StepGuider(void)
     m_bumpTimeoutAlertSent = false;
     m_bumpStepWeight = 1.0;
 
+    LoadSettings();
+}
+
+StepGuider::~StepGuider(void)
+{
+}
+
+void StepGuider::LoadSettings(void)
+{
     wxString prefix = "/" + GetMountClassName();
 
     int samplesToAverage = pConfig->Profile.GetInt(prefix + "/SamplesToAverage", DefaultSamplesToAverage);
@@ -79,10 +88,14 @@ StepGuider::StepGuider(void)
     SetYGuideAlgorithm(yGuideAlgorithm);
 
     m_bumpOnDither = pConfig->Profile.GetBoolean("/stepguider/BumpOnDither", true);
+    m_concurrentCalibration = pConfig->Profile.GetBoolean("/stepguider/ConcurrentCalibration", false);
 }
 
-StepGuider::~StepGuider(void)
+void StepGuider::LoadProfileSettings(void)
 {
+    Mount::LoadProfileSettings();
+
+    LoadSettings();
 }
 
 wxArrayString StepGuider::List(void)
@@ -322,6 +335,12 @@ void StepGuider::SetBumpOnDither(bool val)
     pConfig->Profile.SetBoolean("/stepguider/BumpOnDither", m_bumpOnDither);
 }
 
+void StepGuider::SetConcurrentCalibration(bool val)
+{
+    m_concurrentCalibration = val;
+    pConfig->Profile.SetBoolean("/stepguider/ConcurrentCalibration", m_concurrentCalibration);
+}
+
 int StepGuider::GetCalibrationStepsPerIteration(void)
 {
     return m_calibrationStepsPerIteration;
@@ -698,9 +717,9 @@ bool StepGuider::UpdateCalibrationState(const PHD_Point& currentLocation)
                 m_calibration.pierSide = PIER_SIDE_UNKNOWN;
                 m_calibration.raGuideParity = m_calibration.decGuideParity = GUIDE_PARITY_UNKNOWN;
                 m_calibration.rotatorAngle = Rotator::RotatorPosition();
-                m_calibration.binning = pCamera->Binning;
+                m_calibration.binning = pCamera->EffectiveBinning();
                 SetCalibration(m_calibration);
-                SetCalibrationDetails(m_calibrationDetails, m_calibration.xAngle, m_calibration.yAngle, pCamera->Binning);
+                SetCalibrationDetails(m_calibrationDetails, m_calibration.xAngle, m_calibration.yAngle, pCamera->EffectiveBinning());
                 status0 = _T("Calibration complete");
                 GuideLog.CalibrationComplete(this);
                 Debug.AddLine("Calibration Complete");
@@ -888,13 +907,7 @@ Mount::MOVE_RESULT StepGuider::Move(GUIDE_DIRECTION direction, int steps, MountM
 
             Debug.Write(wxString::Format("stepping direction=%d steps=%d xDirection=%d yDirection=%d\n", direction, steps, xDirection, yDirection));
 
-            if (WouldHitLimit(direction, steps))
-            {
-                int new_steps = MaxPosition(direction) - 1 - CurrentPosition(direction);
-                Debug.Write(wxString::Format("StepGuider step would hit limit: truncate move direction=%d steps=%d => %d\n", direction, steps, new_steps));
-                steps = new_steps;
-                limitReached = true;
-            }
+            LimitSteps(direction, &steps, &limitReached);
 
             if (steps > 0)
             {
@@ -926,6 +939,89 @@ Mount::MOVE_RESULT StepGuider::Move(GUIDE_DIRECTION direction, int steps, MountM
     return result;
 }
 
+void StepGuider::LimitSteps(GUIDE_DIRECTION direction, int *steps, bool *limitReached)
+{
+    if (WouldHitLimit(direction, *steps))
+    {
+        int new_steps = MaxPosition(direction) - 1 - CurrentPosition(direction);
+        Debug.Write(wxString::Format("StepGuider step would hit limit: truncate move direction=%d steps=%d => %d\n", direction, *steps, new_steps));
+        *steps = new_steps;
+        *limitReached = true;
+    }
+}
+
+Mount::MOVE_RESULT StepGuider::MoveAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps,
+                                        MountMoveType moveType, MoveResultInfo *xMoveResult, MoveResultInfo *yMoveResult)
+{
+    // batching only helps when both axes move
+    if (!CanStepAxes() || xSteps <= 0 || ySteps <= 0)
+        return Mount::MoveAxes(xDirection, xSteps, yDirection, ySteps, moveType, xMoveResult, yMoveResult);
+
+    MOVE_RESULT result = MOVE_OK;
+    bool xLimitReached = false;
+    bool yLimitReached = false;
+
+    try
+    {
+        Debug.Write(wxString::Format("MoveAxes(%d, %d, %d, %d, %d)\n", xDirection, xSteps, yDirection, ySteps, moveType));
+
+        if (!m_guidingEnabled)
+        {
+            throw THROW_INFO("Guiding disabled");
+        }
+
+        assert(xDirection == LEFT || xDirection == RIGHT);
+        assert(yDirection == UP || yDirection == DOWN);
+
+        LimitSteps(xDirection, &xSteps, &xLimitReached);
+        LimitSteps(yDirection, &ySteps, &yLimitReached);
+
+        if (xSteps > 0 || ySteps > 0)
+        {
+            if (StepAxes(xDirection, xSteps, yDirection, ySteps))
+            {
+                throw ERROR_INFO("step failed");
+            }
+
+            m_xOffset += xDirection == RIGHT ? xSteps : -xSteps;
+            m_yOffset += yDirection == UP ? ySteps : -ySteps;
+
+            Debug.Write(wxString::Format("stepped: xOffset=%d yOffset=%d\n", m_xOffset, m_yOffset));
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        xSteps = ySteps = 0;
+        result = MOVE_ERROR;
+    }
+
+    if (xMoveResult)
+    {
+        xMoveResult->amountMoved = xSteps;
+        xMoveResult->limited = xLimitReached;
+    }
+    if (yMoveResult)
+    {
+        yMoveResult->amountMoved = ySteps;
+        yMoveResult->limited = yLimitReached;
+    }
+
+    return result;
+}
+
+bool StepGuider::StepAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps)
+{
+    if (xSteps > 0 && Step(xDirection, xSteps))
+        return true;
+    return ySteps > 0 && Step(yDirection, ySteps);
+}
+
+bool StepGuider::CanStepAxes(void)
+{
+    return false;
+}
+
 static wxString SlowBumpWarningEnabledKey()
 {
     // we want the key to be under "/Confirm" so ConfirmDialog::ResetAllDontAskAgain() resets it, but we also want the setting to be per-profile
@@ -966,6 +1062,29 @@ Mount::MOVE_RESULT StepGuider::Move(const PHD_Point& cameraVectorEndpoint, Mount
 
         pFrame->pStepGuiderGraph->AppendData(m_xOffset, m_yOffset, m_avgOffset);
 
+        if (UpdateBump(moveType))
+        {
+            throw ERROR_INFO("UpdateBump failed");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        result = MOVE_ERROR;
+    }
+
+    return result;
+}
+
+// Starts, adjusts and stops mount bumps from the average AO position, and
+// schedules the next bump on the secondary mount's thread; returns true on
+// error. Bumps are only started or stopped on normal guiding moves.
+bool StepGuider::UpdateBump(MountMoveType moveType)
+{
+    bool bError = false;
+
+    try
+    {
         // consider bumping the secondary mount if this is a normal move
         if (moveType == MOVETYPE_ALGO && pSecondaryMount && pSecondaryMount->IsConnected())
         {
@@ -1090,10 +1209,37 @@ Mount::MOVE_RESULT StepGuider::Move(const PHD_Point& cameraVectorEndpoint, Mount
     catch (const wxString& Msg)
     {
         POSSIBLY_UNUSED(Msg);
-        result = MOVE_ERROR;
+        bError = true;
     }
 
-    return result;
+    return bError;
+}
+
+// One correction of the AO fast loop: the AO is stepped by the camera
+// vector, without the guide algorithms, position averaging, graph or bumps
+// of a guiding move
+Mount::MOVE_RESULT StepGuider::FastLoopMove(const PHD_Point& cameraVectorEndpoint)
+{
+    PHD_Point mountVectorEndpoint;
+    if (TransformCameraCoordinatesToMountCoordinates(cameraVectorEndpoint, mountVectorEndpoint))
+        return MOVE_ERROR;
+
+    GUIDE_DIRECTION xDirection = mountVectorEndpoint.X > 0.0 ? LEFT : RIGHT;
+    GUIDE_DIRECTION yDirection = mountVectorEndpoint.Y > 0.0 ? DOWN : UP;
+    int xSteps = (int) floor(fabs(mountVectorEndpoint.X / xRate()) + 0.5);
+    int ySteps = (int) floor(fabs(mountVectorEndpoint.Y / yRate()) + 0.5);
+
+    MoveResultInfo xMoveResult;
+    MoveResultInfo yMoveResult;
+    return MoveAxes(xDirection, xSteps, yDirection, ySteps, MOVETYPE_DIRECT, &xMoveResult, &yMoveResult);
+}
+
+// The AO fast loop bumps the mount from its own average of the AO position,
+// taken over many more frames than a guiding move averages
+bool StepGuider::FastLoopBump(const PHD_Point& avgOffset)
+{
+    m_avgOffset = avgOffset;
+    return UpdateBump(MOVETYPE_ALGO);
 }
 
 bool StepGuider::IsAtLimit(GUIDE_DIRECTION direction, bool *atLimit)
@@ -1151,7 +1297,7 @@ void StepGuider::AdjustCalibrationForScopePointing(void)
 {
     // compensate for binning change
 
-    unsigned short binning = pCamera->Binning;
+    unsigned short binning = pCamera->EffectiveBinning();
 
     if (binning == m_calibration.binning)
     {
@@ -1257,6 +1403,7 @@ void AOConfigDialogPane::LayoutControls(wxPanel *pParent, BrainCtrlIdMap& CtrlMa
     pAoDetailSizer->Add(GetSingleCtrl(CtrlMap, AD_cbBumpOnDither));
     pAoDetailSizer->Add(GetSingleCtrl(CtrlMap, AD_cbEnableAOGuiding));
     pAoDetailSizer->Add(GetSingleCtrl(CtrlMap, AD_cbClearAOCalibration));
+    pAoDetailSizer->Add(GetSingleCtrl(CtrlMap, AD_cbConcurrentCalibration));
     this->Add(pAoDetailSizer, def_flags);
 
 }
@@ -1309,6 +1456,9 @@ AOConfigDialogCtrlSet::AOConfigDialogCtrlSet(wxWindow *pParent, Mount *pStepGuid
     m_pEnableAOGuide = new wxCheckBox(GetParentWindow(AD_cbEnableAOGuiding), wxID_ANY, _("Enable AO corrections"));
     AddCtrl(CtrlMap, AD_cbEnableAOGuiding, m_pEnableAOGuide,
         _("Keep this checked for AO guiding. Un-check to disable AO corrections and use only mount guiding"));
+    m_concurrentCalibration = new wxCheckBox(GetParentWindow(AD_cbConcurrentCalibration), wxID_ANY, _("Calibrate with mount"));
+    AddCtrl(CtrlMap, AD_cbConcurrentCalibration, m_concurrentCalibration,
+        _("Calibrate the AO and the mount at the same time when both need calibrating, rather than one after the other"));
     m_pStepGuider->currConfigDialogCtrlSet = this;
 }
 
@@ -1323,6 +1473,7 @@ void AOConfigDialogCtrlSet::LoadValues()
     m_pClearAOCalibration->Enable(m_pStepGuider->IsCalibrated());
     m_pClearAOCalibration->SetValue(false);
     m_pEnableAOGuide->SetValue(m_pStepGuider->GetGuidingEnabled());
+    m_concurrentCalibration->SetValue(m_pStepGuider->GetConcurrentCalibration());
 }
 
 void AOConfigDialogCtrlSet::UnloadValues()
@@ -1340,5 +1491,6 @@ void AOConfigDialogCtrlSet::UnloadValues()
     }
 
     m_pStepGuider->SetGuidingEnabled(m_pEnableAOGuide->GetValue());
+    m_pStepGuider->SetConcurrentCalibration(m_concurrentCalibration->GetValue());
     //MountConfigDialogCtrlSet::UnloadValues();
 }
@@ -51,6 +51,7 @@ class AOConfigDialogCtrlSet : ConfigDialogCtrlSet
     wxCheckBox *m_bumpOnDither;
     wxCheckBox *m_pClearAOCalibration;
     wxCheckBox *m_pEnableAOGuide;
+    wxCheckBox *m_concurrentCalibration;
 
 public:
     AOConfigDialogCtrlSet(wxWindow *pParent, Mount *pStepGuider, AdvancedDialog* pAdvancedDialog, BrainCtrlIdMap& CtrlMap);
@@ -79,6 +80,7 @@ class StepGuider : public Mount, public OnboardST4
     int m_bumpPercentage;
     double m_bumpMaxStepsPerCycle;
     bool m_bumpOnDither;
+    bool m_concurrentCalibration;   // calibrate together with the mount, see ConcurrentCalibration
 
     int m_xBumpPos1;
     int m_xBumpPos2;
@@ -150,6 +152,7 @@ protected:
     friend class GraphLogWindow;
     friend class StepGuiderConfigDialogCtrlSet;
     friend class AOConfigDialogCtrlSet;
+    friend class ConcurrentCalibration;
 
 public:
     virtual MountConfigDialogPane *GetConfigDialogPane(wxWindow *pParent);
@@ -176,6 +179,7 @@ public:
     virtual bool BeginCalibration(const PHD_Point& currentLocation);
     bool UpdateCalibrationState(const PHD_Point& currentLocation);
     virtual void ClearCalibration(void);
+    virtual void LoadProfileSettings(void);
 
     virtual bool Connect(void);
     virtual bool Disconnect(void);
@@ -188,18 +192,29 @@ public:
 
     bool GetBumpOnDither(void) const;
     void SetBumpOnDither(bool val);
+    bool GetConcurrentCalibration(void) const { return m_concurrentCalibration; }
+    void SetConcurrentCalibration(bool val);
     void ForceStartBump(void);
     bool IsBumpInProgress(void) const;
 
+    // moves and bumps for the AO fast loop, see AOFastLoop
+    MOVE_RESULT FastLoopMove(const PHD_Point& cameraVectorEndpoint);
+    bool FastLoopBump(const PHD_Point& avgOffset);
+
     // functions with an implemenation in StepGuider that cannot be over-ridden
     // by a subclass
 private:
     virtual MOVE_RESULT Move(const PHD_Point& vectorEndpoint, MountMoveType moveType);
     MOVE_RESULT Move(GUIDE_DIRECTION direction, int amount, MountMoveType moveType, MoveResultInfo *moveResultInfo);
+    MOVE_RESULT MoveAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps,
+                         MountMoveType moveType, MoveResultInfo *xMoveResultInfo, MoveResultInfo *yMoveResultInfo);
+    void LimitSteps(GUIDE_DIRECTION direction, int *steps, bool *limitReached);
     MOVE_RESULT CalibrationMove(GUIDE_DIRECTION direction, int steps);
     int CalibrationMoveSize(void);
     int CalibrationTotDistance(void);
     void InitBumpPositions(void);
+    bool UpdateBump(MountMoveType moveType);
+    void LoadSettings(void);
 
     double CalibrationTime(int nCalibrationSteps);
 protected:
@@ -211,6 +226,11 @@ private:
     virtual int MaxPosition(GUIDE_DIRECTION direction) const = 0;
     virtual bool SetMaxPosition(int steps) = 0;
 
+    // a subclass that can send both axes in one command batch overrides this
+    // along with CanStepAxes; the default steps x then y
+private:
+    virtual bool StepAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps);
+
     // virtual functions -- these CAN be overridden by a subclass, which should
     // consider whether they need to call the base class functions as part of
     // their operation
@@ -218,6 +238,8 @@ public:
     virtual bool IsAtLimit(GUIDE_DIRECTION direction, bool *atLimit);
     virtual bool WouldHitLimit(GUIDE_DIRECTION direction, int steps);
     virtual int CurrentPosition(GUIDE_DIRECTION direction);
+    // can step both axes with a single StepAxes call
+    virtual bool CanStepAxes(void);
     virtual bool MoveToCenter(void);
 };
 
@@ -239,11 +239,36 @@ bool StepGuiderSxAO::SendThenReceive(const unsigned char *pBuffer, unsigned int
             throw ERROR_INFO("StepGuiderSxAO::SendThenReceive serial send failed");
         }
 
-        if (m_pSerialPort->Receive(receivedChar, 1))
+        if (ReceiveResponse(receivedChar))
         {
             throw ERROR_INFO("StepGuiderSxAO::SendThenReceive serial receive failed");
         }
         Debug.AddBytes(wxString::Format("StepGuiderSxAO::SendThenReceive received %c, sent", receivedChar), pBuffer, bufferSize);
+    }
+    catch (const wxString& Msg)
+    {
+        Debug.AddBytes("StepGuiderSxAO::SendThenReceive send", pBuffer, bufferSize);
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+/*
+ * Reads the response to one long command. The AO may send a 'W' ahead of the
+ * command character, which is skipped.
+ */
+bool StepGuiderSxAO::ReceiveResponse(unsigned char *receivedChar)
+{
+    bool bError = false;
+
+    try
+    {
+        if (m_pSerialPort->Receive(receivedChar, 1))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::ReceiveResponse serial receive failed");
+        }
 
         if (*receivedChar == 'W') // TODO: meaning
         {
@@ -255,7 +280,6 @@ bool StepGuiderSxAO::SendThenReceive(const unsigned char *pBuffer, unsigned int
     }
     catch (const wxString& Msg)
     {
-        Debug.AddBytes("StepGuiderSxAO::SendThenReceive send", pBuffer, bufferSize);
         POSSIBLY_UNUSED(Msg);
         bError = true;
     }
@@ -293,11 +317,37 @@ bool StepGuiderSxAO::SendLongCommand(unsigned char command, unsigned char parame
     {
         unsigned char cmdBuf[8]; // 7 chars + NULL
 
+        if (FormatLongCommand(cmdBuf, command, parameter, count))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand FormatLongCommand failed");
+        }
+
+        if (SendThenReceive(&cmdBuf[0], 7, response))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand SendThenReceive failed");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+// formats a 7 character long command into cmdBuf, which holds 8 chars
+bool StepGuiderSxAO::FormatLongCommand(unsigned char *cmdBuf, unsigned char command, unsigned char parameter, unsigned int count)
+{
+    bool bError = false;
+
+    try
+    {
         if (count > 99999)
         {
-            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand invalid count");
+            throw ERROR_INFO("StepGuiderSxAO::FormatLongCommand invalid count");
         }
-        int bufsize = sizeof(cmdBuf);
+        int bufsize = 8;
 #if defined (__WINDOWS__)
         // MSVC-ism _snprintf returns a negative number if there is not enough space in the buffer
         int ret = _snprintf((char *)&cmdBuf[0], bufsize, "%c%c%5.5d", command, parameter, count);
@@ -308,17 +358,12 @@ bool StepGuiderSxAO::SendLongCommand(unsigned char command, unsigned char parame
         
         if (ret < 0)
         {
-            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand snprintf failed");
+            throw ERROR_INFO("StepGuiderSxAO::FormatLongCommand snprintf failed");
         }
 
         if (ret >= bufsize)
         {
-            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand snprintf buffer to small");
-        }
-
-        if (SendThenReceive(&cmdBuf[0], 7, response))
-        {
-            throw ERROR_INFO("StepGuiderSxAO::SendLongCommand SendThenReceive failed");
+            throw ERROR_INFO("StepGuiderSxAO::FormatLongCommand snprintf buffer to small");
         }
     }
     catch (const wxString& Msg)
@@ -479,23 +524,9 @@ bool StepGuiderSxAO::Step(GUIDE_DIRECTION direction, int steps)
         unsigned char response;
         int currentPos = 0;
 
-        switch (direction)
+        if (StepParameter(direction, &parameter))
         {
-            case NORTH:
-                parameter = 'N';
-                break;
-            case SOUTH:
-                parameter = 'S';
-                break;
-            case EAST:
-                parameter = 'T';
-                break;
-            case WEST:
-                parameter = 'W';
-                break;
-            default:
-                throw ERROR_INFO("StepGuiderSxAO::step: invalid direction");
-                break;
+            throw ERROR_INFO("StepGuiderSxAO::step: invalid direction");
         }
 
         if (SendLongCommand(cmd, parameter, steps, &response))
@@ -523,6 +554,98 @@ bool StepGuiderSxAO::Step(GUIDE_DIRECTION direction, int steps)
     return bError;
 }
 
+bool StepGuiderSxAO::StepParameter(GUIDE_DIRECTION direction, unsigned char *parameter)
+{
+    switch (direction)
+    {
+        case NORTH:
+            *parameter = 'N';
+            break;
+        case SOUTH:
+            *parameter = 'S';
+            break;
+        case EAST:
+            *parameter = 'T';
+            break;
+        case WEST:
+            *parameter = 'W';
+            break;
+        default:
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Both step commands go out in a single write and the two responses are read
+ * afterwards, so a two axis move costs one serial round trip instead of two.
+ */
+bool StepGuiderSxAO::StepAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps)
+{
+    bool bError = false;
+
+    try
+    {
+        unsigned char const cmd = 'G';
+        unsigned char cmdBuf[16]; // 2 x 7 chars + NULL
+        unsigned char xParameter, yParameter;
+
+        if (StepParameter(xDirection, &xParameter) || StepParameter(yDirection, &yParameter))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes: invalid direction");
+        }
+
+        if (FormatLongCommand(&cmdBuf[0], cmd, xParameter, xSteps) ||
+            FormatLongCommand(&cmdBuf[7], cmd, yParameter, ySteps))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes: FormatLongCommand failed");
+        }
+
+        if (m_pSerialPort->Send(cmdBuf, 14))
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes serial send failed");
+        }
+
+        unsigned char xResponse, yResponse;
+
+        // read both responses before checking either so a rejected x step
+        // does not leave the y response to be taken as the answer to a later
+        // command
+        bool xError = ReceiveResponse(&xResponse);
+        bool yError = ReceiveResponse(&yResponse);
+
+        if (xError || yError)
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes serial receive failed");
+        }
+
+        Debug.AddBytes(wxString::Format("StepGuiderSxAO::StepAxes received %c %c, sent", xResponse, yResponse), cmdBuf, 14);
+
+        if (xResponse == 'L' || yResponse == 'L')
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes: at limit");
+        }
+
+        if (xResponse != cmd || yResponse != cmd)
+        {
+            throw ERROR_INFO("StepGuiderSxAO::StepAxes: response != cmd");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool StepGuiderSxAO::CanStepAxes(void)
+{
+    return true;
+}
+
 int StepGuiderSxAO::MaxPosition(GUIDE_DIRECTION direction) const
 {
     return m_maxSteps;
@@ -59,15 +59,20 @@ public:
 
 private:
     virtual bool Step(GUIDE_DIRECTION direction, int steps);
+    virtual bool StepAxes(GUIDE_DIRECTION xDirection, int xSteps, GUIDE_DIRECTION yDirection, int ySteps);
+    virtual bool CanStepAxes(void);
     virtual int MaxPosition(GUIDE_DIRECTION direction) const;
     virtual bool SetMaxPosition(int steps);
     virtual bool IsAtLimit(GUIDE_DIRECTION direction, bool *isAtLimit);
 
     bool SendThenReceive(unsigned char sendChar, unsigned char *receivedChar);
     bool SendThenReceive(const unsigned char *pBuffer, unsigned int bufferSize, unsigned char *receivedChar);
+    bool ReceiveResponse(unsigned char *receivedChar);
 
     bool SendShortCommand(unsigned char command, unsigned char *response);
     bool SendLongCommand(unsigned char command, unsigned char parameter, unsigned count, unsigned char *response);
+    bool FormatLongCommand(unsigned char *cmdBuf, unsigned char command, unsigned char parameter, unsigned int count);
+    bool StepParameter(GUIDE_DIRECTION direction, unsigned char *parameter);
 
     bool FirmwareVersion(unsigned int *version);
     bool Unjam(void);
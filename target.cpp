@@ -143,7 +143,7 @@ void TargetWindow::AppendData(const GuideStepInfo& step)
 
     if (this->m_visible)
     {
-        Refresh();
+        pFrame->ScheduleDisplayUpdate(DISPLAY_UPDATE_TARGET);
     }
 }
 
@@ -230,7 +230,8 @@ BEGIN_EVENT_TABLE(TargetClient, wxWindow)
 END_EVENT_TABLE()
 
 TargetClient::TargetClient(wxWindow *parent) :
-    wxWindow(parent, wxID_ANY, wxDefaultPosition, wxSize(201,201), wxFULL_REPAINT_ON_RESIZE )
+    wxWindow(parent, wxID_ANY, wxDefaultPosition, wxSize(201,201), wxFULL_REPAINT_ON_RESIZE ),
+    m_history(Telemetry, m_maxHistorySize)
 {
     SetBackgroundStyle(wxBG_STYLE_PAINT);
 
@@ -239,6 +240,10 @@ TargetClient::TargetClient(wxWindow *parent) :
 
     m_refCircleRadius = 0.0;
     m_nItems = 0;
+    m_appended = 0;
+    m_plotValid = false;
+    m_plotBegin = m_plotEnd = 0;
+    m_impactScale = 1.0;
     m_length = pConfig->Global.GetInt("/target/length", 100);
     m_zoom = pConfig->Global.GetDouble("/target/zoom", 1.0);
     if (m_zoom < MIN_ZOOM)
@@ -249,22 +254,30 @@ TargetClient::~TargetClient(void)
 {
 }
 
-void TargetClient::AppendData(const GuideStepInfo& step)
+void TargetClient::AppendData(const GuideStepInfo& WXUNUSED(step))
 {
-    memmove(&m_history, &m_history[1], sizeof(m_history[0])*(m_maxHistorySize-1));
-
-    m_history[m_maxHistorySize-1].ra = step.mountOffset.X;
-    m_history[m_maxHistorySize-1].dec = step.mountOffset.Y;
+    // the mount has added the step to the session telemetry
+    m_history.Advance();
 
     if (m_nItems < m_maxHistorySize)
     {
         m_nItems++;
     }
+    m_appended++;
 }
 
-void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
+bool TargetClient::PlotKey::operator==(const PlotKey& rhs) const
 {
-    wxAutoBufferedPaintDC dc(this);
+    return size == rhs.size && zoom == rhs.zoom && refCircleRadius == rhs.refCircleRadius &&
+        sampling == rhs.sampling && raParity == rhs.raParity && decParity == rhs.decParity;
+}
+
+void TargetClient::DrawBackground(const PlotKey& key)
+{
+    const wxSize& size = key.size;
+
+    m_background.Create(size.x, size.y);
+    wxMemoryDC dc(m_background);
 
     dc.SetBackground(*wxBLACK_BRUSH);
     //dc.SetBackground(wxColour(10,0,0));
@@ -279,7 +292,6 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     dc.SetPen(GreySolidPen);
     dc.SetBrush(*wxTRANSPARENT_BRUSH);
 
-    wxSize size = GetClientSize();
     wxPoint center(size.x/2, size.y/2);
     int radius_max = ((size.x < size.y ? size.x : size.y) - 6) / 2;
 
@@ -290,15 +302,15 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     if (radius_max < 10)
         radius_max = 10;
 
-    const double sampling = pFrame ? pFrame->GetCameraPixelScale() : 1.0;
+    const double sampling = key.sampling;
     double scale = radius_max / 2 * sampling;
 
     // Draw reference circle
-    if (m_refCircleRadius > 0.0)
+    if (key.refCircleRadius > 0.0)
     {
         wxDCBrushChanger b(dc, wxBrush(wxColor(55,55,55)));
         wxDCPenChanger p(dc, *wxTRANSPARENT_PEN);
-        dc.DrawCircle(center, m_refCircleRadius * scale * m_zoom / sampling);
+        dc.DrawCircle(center, key.refCircleRadius * scale * key.zoom / sampling);
     }
 
     // Draw circles
@@ -307,7 +319,7 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     {
         int rr = radius_max * i / 4;
         dc.DrawCircle(center, rr);
-        wxString l = wxString::Format(_T("%g%s"), i/2.0 / m_zoom, sampling != 1.0 ? "''" : "");
+        wxString l = wxString::Format(_T("%g%s"), i/2.0 / key.zoom, sampling != 1.0 ? "''" : "");
         wxSize sl = dc.GetTextExtent(l);
         dc.DrawText(l, center.x - sl.x - 1, center.y - rr - sl.y);
     }
@@ -316,7 +328,7 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     dc.DrawLine(3, center.y , size.x - 3, center.y);
     dc.DrawLine(center.x, 3, center.x, size.y - 3);
 
-    double r = radius_max / (2 / m_zoom);
+    double r = radius_max / (2 / key.zoom);
     int g = size.x / 100;
     for (double x = 0 ; x < size.x ; x += r/4)
     {
@@ -339,14 +351,35 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     dc.DrawText(_("RA"), leftEdge, center.y - 15);
     dc.DrawText(_("Dec"), center.x - 35, topEdge - 3);
 
-    // Draw impacts
-    unsigned int startPoint = m_maxHistorySize - m_length;
+    // label sky coordinate directions
 
-    if (m_nItems < m_length)
-    {
-        startPoint = m_maxHistorySize - m_nItems;
-    }
+    if (key.raParity == GUIDE_PARITY_EVEN)
+        dc.DrawText(_("SkyE"), size.x - 30, center.y + 5);  // sky E = mount E
+    else if (key.raParity == GUIDE_PARITY_ODD)
+        dc.DrawText(_("SkyE"), leftEdge, center.y + 5);     // sky E = mount W
 
+    if (key.decParity == GUIDE_PARITY_EVEN)
+        dc.DrawText(_("SkyN"), center.x + 5, topEdge - 3);  // sky N = mount N
+    else if (key.decParity == GUIDE_PARITY_ODD)
+        dc.DrawText(_("SkyN"), center.x + 5, size.y - 15);  // sky N = mount S
+
+    dc.SelectObject(wxNullBitmap);
+
+    // start over with no impacts on the plot
+    m_plot.Create(size.x, size.y);
+    wxMemoryDC plotDC(m_plot);
+    plotDC.DrawBitmap(m_background, 0, 0);
+
+    m_dotCount.assign(size.x * size.y, 0);
+    m_plotBegin = m_plotEnd = m_appended;
+    m_center = center;
+    m_impactScale = scale * key.zoom;
+    m_plotKey = key;
+    m_plotValid = true;
+}
+
+wxPoint TargetClient::ImpactPoint(unsigned int seq) const
+{
     // plot guide star offsets in mount coordinates:
     //   RA offset is distance W of lock pos
     //        => plot -dRA for East = positive
@@ -355,33 +388,96 @@ void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
     double const raSign = -1.0;
     double const decSign = -1.0;
 
-    // label sky coordinate directions
-
-    GuideParity raParity = pMount ? pMount->RAParity() : GUIDE_PARITY_UNKNOWN;
-    if (raParity == GUIDE_PARITY_EVEN)
-        dc.DrawText(_("SkyE"), size.x - 30, center.y + 5);  // sky E = mount E
-    else if (raParity == GUIDE_PARITY_ODD)
-        dc.DrawText(_("SkyE"), leftEdge, center.y + 5);     // sky E = mount W
+    const S_HISTORY h = m_history[m_history.size() - (m_appended - seq)];
+    return wxPoint((int)(m_center.x + h.ra * m_impactScale * raSign),
+        (int)(m_center.y - h.dec * m_impactScale * decSign));
+}
 
-    GuideParity decParity = pMount ? pMount->DecParity() : GUIDE_PARITY_UNKNOWN;
-    if (decParity == GUIDE_PARITY_EVEN)
-        dc.DrawText(_("SkyN"), center.x + 5, topEdge - 3);  // sky N = mount N
-    else if (decParity == GUIDE_PARITY_ODD)
-        dc.DrawText(_("SkyN"), center.x + 5, size.y - 15);  // sky N = mount S
+void TargetClient::DrawDot(wxDC& plotDC, wxDC& backgroundDC, unsigned int seq, bool add)
+{
+    // an impact is the ring of 8 pixels around its point
+    wxPoint pt = ImpactPoint(seq);
+    const wxSize& size = m_plotKey.size;
 
-    dc.SetPen(wxPen(wxColour(127, 127, 255), 1, wxSOLID));
-    for (unsigned int i = startPoint; i < m_maxHistorySize; i++)
+    for (int dy = -1; dy <= 1; dy++)
     {
-        int ximpact = center.x + m_history[i].ra * scale * m_zoom * raSign;
-        int yimpact = center.y - m_history[i].dec * scale * m_zoom * decSign;
-        if (i == m_maxHistorySize - 1)
+        for (int dx = -1; dx <= 1; dx++)
         {
-            const int lcrux = 4;
-            dc.SetPen(*wxRED_PEN);
-            dc.DrawLine(ximpact + lcrux, yimpact + lcrux, ximpact - lcrux - 1, yimpact - lcrux - 1);
-            dc.DrawLine(ximpact + lcrux, yimpact - lcrux, ximpact - lcrux - 1, yimpact + lcrux + 1);
+            int x = pt.x + dx;
+            int y = pt.y + dy;
+            if ((dx == 0 && dy == 0) || x < 0 || y < 0 || x >= size.x || y >= size.y)
+                continue;
+
+            unsigned short& count = m_dotCount[y * size.x + x];
+            if (add)
+            {
+                if (count++ == 0)
+                    plotDC.DrawPoint(x, y);
+            }
+            else if (count > 0 && --count == 0)
+                plotDC.Blit(x, y, 1, 1, &backgroundDC, x, y);
         }
-        else
-            dc.DrawCircle(ximpact, yimpact, 1);
+    }
+}
+
+void TargetClient::UpdatePlot(void)
+{
+    // the newest impact is drawn over the plot rather than on it
+    unsigned int count = wxMin(m_nItems, m_length);
+    unsigned int begin = m_appended - count;
+    unsigned int end = count > 0 ? m_appended - 1 : begin;
+
+    if (begin == m_plotBegin && end == m_plotEnd)
+        return;
+
+    wxMemoryDC plotDC(m_plot);
+    wxMemoryDC backgroundDC(m_background);
+    plotDC.SetPen(wxPen(wxColour(127, 127, 255), 1, wxSOLID));
+
+    for (unsigned int seq = m_plotBegin; seq < m_plotEnd; seq++)
+        if (seq < begin || seq >= end)
+            DrawDot(plotDC, backgroundDC, seq, false);
+
+    for (unsigned int seq = begin; seq < end; seq++)
+        if (seq < m_plotBegin || seq >= m_plotEnd)
+            DrawDot(plotDC, backgroundDC, seq, true);
+
+    m_plotBegin = begin;
+    m_plotEnd = end;
+}
+
+void TargetClient::OnPaint(wxPaintEvent& WXUNUSED(evt))
+{
+    wxAutoBufferedPaintDC dc(this);
+
+    PlotKey key;
+    key.size = GetClientSize();
+    key.zoom = m_zoom;
+    key.refCircleRadius = m_refCircleRadius;
+    key.sampling = pFrame ? pFrame->GetCameraPixelScale() : 1.0;
+    key.raParity = pMount ? pMount->RAParity() : GUIDE_PARITY_UNKNOWN;
+    key.decParity = pMount ? pMount->DecParity() : GUIDE_PARITY_UNKNOWN;
+
+    if (key.size.x <= 0 || key.size.y <= 0)
+        return;
+
+    // the impacts still on the plot must be in the history to be taken off
+    if (!m_plotValid || !(key == m_plotKey) ||
+        (m_plotBegin < m_plotEnd && m_appended - m_plotBegin > m_maxHistorySize))
+    {
+        DrawBackground(key);
+    }
+
+    UpdatePlot();
+
+    dc.DrawBitmap(m_plot, 0, 0);
+
+    if (m_nItems > 0 && m_length > 0)
+    {
+        wxPoint impact = ImpactPoint(m_appended - 1);
+        const int lcrux = 4;
+        dc.SetPen(*wxRED_PEN);
+        dc.DrawLine(impact.x + lcrux, impact.y + lcrux, impact.x - lcrux - 1, impact.y - lcrux - 1);
+        dc.DrawLine(impact.x + lcrux, impact.y - lcrux, impact.x - lcrux - 1, impact.y + lcrux + 1);
     }
 }
@@ -51,20 +51,49 @@ class TargetClient : public wxWindow
     unsigned int m_minHeight;
     unsigned int m_maxHeight;
 
-    struct
-    {
-        double ra;
-        double dec;
-    } m_history[m_maxHistorySize];
+    TelemetryView m_history;    // the latest m_maxHistorySize steps of the session telemetry
 
     unsigned int m_nItems;    // # of items in the history
     unsigned int m_length;     // # of items to display
     double m_zoom;
     double m_refCircleRadius;
+    unsigned int m_appended;   // # of items ever appended, the sequence number of the next item
+
+    // everything drawn on the cached plot depends on these
+    struct PlotKey
+    {
+        wxSize size;
+        double zoom;
+        double refCircleRadius;
+        double sampling;
+        int raParity;
+        int decParity;
+
+        bool operator==(const PlotKey& rhs) const;
+    };
+
+    // The circles, axes and labels are drawn once to m_background and
+    // copied to m_plot. The impacts are then added to and removed from
+    // m_plot as they enter and leave the displayed history; m_dotCount
+    // counts the impacts covering each pixel, and a pixel no impact covers
+    // is restored from m_background.
+    wxBitmap m_background;
+    wxBitmap m_plot;
+    PlotKey m_plotKey;
+    bool m_plotValid;
+    std::vector<unsigned short> m_dotCount;
+    unsigned int m_plotBegin;     // sequence numbers of the impacts on m_plot
+    unsigned int m_plotEnd;
+    wxPoint m_center;
+    double m_impactScale;
 
     void AppendData(const GuideStepInfo& step);
 
     void OnPaint(wxPaintEvent& evt);
+    void DrawBackground(const PlotKey& key);
+    void UpdatePlot(void);
+    wxPoint ImpactPoint(unsigned int seq) const;
+    void DrawDot(wxDC& plotDC, wxDC& backgroundDC, unsigned int seq, bool add);
 
     friend class TargetWindow;
 
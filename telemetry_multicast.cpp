@@ -0,0 +1,280 @@
+/*
+ *  telemetry_multicast.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined(__WINDOWS__)
+# include <winsock2.h>
+# include <ws2tcpip.h>
+#else
+# include <netinet/in.h>
+#endif
+
+TelemetryMulticast TelemetryFeed;
+
+enum
+{
+    MCAST_VERSION = 1,
+    MCAST_HEADER_SIZE = 24,
+    MCAST_MAX_TEXT = 1024,
+    HEARTBEAT_MS = 1000,
+};
+
+static const char *DefaultGroup = "239.255.42.99";
+static const int DefaultPort = 4800;
+
+static void put8(std::vector<unsigned char>& p, unsigned int v)
+{
+    p.push_back((unsigned char) v);
+}
+
+static void put16(std::vector<unsigned char>& p, unsigned int v)
+{
+    p.push_back((unsigned char) v);
+    p.push_back((unsigned char)(v >> 8));
+}
+
+static void put32(std::vector<unsigned char>& p, wxUint32 v)
+{
+    for (int i = 0; i < 4; i++, v >>= 8)
+        p.push_back((unsigned char) v);
+}
+
+static void put64(std::vector<unsigned char>& p, wxUint64 v)
+{
+    for (int i = 0; i < 8; i++, v >>= 8)
+        p.push_back((unsigned char) v);
+}
+
+static void putf(std::vector<unsigned char>& p, double d)
+{
+    float f = (float) d;
+    wxUint32 v;
+    memcpy(&v, &f, sizeof(v));
+    put32(p, v);
+}
+
+static void putd(std::vector<unsigned char>& p, double d)
+{
+    wxUint64 v;
+    memcpy(&v, &d, sizeof(v));
+    put64(p, v);
+}
+
+static void put_text(std::vector<unsigned char>& p, const wxString& s)
+{
+    wxCharBuffer utf8 = s.ToUTF8();
+    size_t len = wxMin(strlen(utf8.data()), (size_t) MCAST_MAX_TEXT);
+    put16(p, (unsigned int) len);
+    p.insert(p.end(), utf8.data(), utf8.data() + len);
+}
+
+TelemetryMulticast::TelemetryMulticast()
+    : m_socket(0), m_instance(1), m_sourceId(0), m_seq(0), m_lastState(-1), m_heartbeat(this)
+{
+    Bind(wxEVT_TIMER, &TelemetryMulticast::OnHeartbeat, this);
+}
+
+TelemetryMulticast::~TelemetryMulticast()
+{
+}
+
+bool TelemetryMulticast::Start(unsigned int instanceId)
+{
+    if (m_socket || !pConfig->Global.GetBoolean("/server/multicast/enable", false))
+        return false;
+
+    wxString group = pConfig->Global.GetString("/server/multicast/group", DefaultGroup);
+    int port = pConfig->Global.GetInt("/server/multicast/port", DefaultPort);
+    int ttl = pConfig->Global.GetInt("/server/multicast/ttl", 1);
+
+    if (!m_group.Hostname(group) || !m_group.Service((unsigned short) port))
+    {
+        Debug.Write(wxString::Format("multicast: bad group %s:%d\n", group, port));
+        return true;
+    }
+
+    wxIPV4address local;
+    local.AnyAddress();
+    local.Service(0);
+    m_socket = new wxDatagramSocket(local, wxSOCKET_NOWAIT);
+    if (!m_socket->IsOk())
+    {
+        Debug.Write("multicast: could not create socket\n");
+        m_socket->Destroy();
+        m_socket = 0;
+        return true;
+    }
+
+    ttl = wxMax(1, wxMin(ttl, 255));
+    if (!m_socket->SetOption(IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)))
+        Debug.Write(wxString::Format("multicast: could not set ttl %d\n", ttl));
+
+    m_instance = instanceId;
+    m_sourceId = (wxUint32)(::wxGetUTCTimeMillis().GetValue() * 2654435761U) ^ (wxUint32) wxGetProcessId();
+    m_seq = 0;
+    m_lastState = -1;
+
+    m_heartbeat.Start(HEARTBEAT_MS);
+    CheckAppState();
+
+    Debug.Write(wxString::Format("multicast: publishing to %s:%d, ttl %d\n", group, port, ttl));
+
+    return false;
+}
+
+void TelemetryMulticast::Stop()
+{
+    if (!m_socket)
+        return;
+
+    m_heartbeat.Stop();
+    m_socket->Destroy();
+    m_socket = 0;
+
+    Debug.Write(wxString::Format("multicast: stopped after %u packets\n", m_seq));
+}
+
+void TelemetryMulticast::Begin(MulticastPacketType type)
+{
+    std::vector<unsigned char>& p = m_pkt;
+    p.clear();
+    p.push_back('P');
+    p.push_back('H');
+    p.push_back('D');
+    p.push_back('M');
+    put8(p, MCAST_VERSION);
+    put8(p, type);
+    put16(p, m_instance);
+    put32(p, m_sourceId);
+    put32(p, m_seq++);
+    putd(p, ::wxGetUTCTimeMillis().ToDouble() / 1000.0);
+}
+
+void TelemetryMulticast::Send()
+{
+    // one datagram whatever the number of listeners; a full socket buffer
+    // drops the packet, which the sequence number shows
+    m_socket->SendTo(m_group, m_pkt.data(), (wxUint32) m_pkt.size());
+}
+
+void TelemetryMulticast::PublishGuideStep(long long seq)
+{
+    if (!m_socket || seq < Telemetry.Begin() || seq >= Telemetry.End())
+        return;
+
+    S_HISTORY h = Telemetry.Row(seq);
+    unsigned int flags = (h.raLimited ? GuideTelemetry::FLAG_RA_LIMITED : 0) |
+        (h.decLimited ? GuideTelemetry::FLAG_DEC_LIMITED : 0);
+
+    Begin(MCAST_GUIDE_STEP);
+    put64(m_pkt, (wxUint64) seq);
+    putd(m_pkt, (double) h.timestamp / 1000.0);
+    putf(m_pkt, h.dx);
+    putf(m_pkt, h.dy);
+    putf(m_pkt, h.ra);
+    putf(m_pkt, h.dec);
+    put32(m_pkt, (wxUint32) h.raDur);
+    put32(m_pkt, (wxUint32) h.decDur);
+    putf(m_pkt, h.starSNR);
+    putf(m_pkt, h.starMass);
+    put8(m_pkt, flags);
+    Send();
+
+    CheckAppState();
+}
+
+void TelemetryMulticast::CheckAppState()
+{
+    if (!m_socket)
+        return;
+
+    int st = Guider::GetExposedState();
+    if (st == m_lastState)
+        return;
+
+    m_lastState = st;
+    Begin(MCAST_APP_STATE);
+    put8(m_pkt, st);
+    Send();
+}
+
+void TelemetryMulticast::OnHeartbeat(wxTimerEvent& evt)
+{
+    // listeners that join late learn the state within a second
+    m_lastState = -1;
+    CheckAppState();
+}
+
+void TelemetryMulticast::PublishSettling(double distance, double time, double settleTime)
+{
+    if (!m_socket)
+        return;
+
+    Begin(MCAST_SETTLING);
+    putf(m_pkt, distance);
+    putf(m_pkt, time);
+    putf(m_pkt, settleTime);
+    Send();
+}
+
+void TelemetryMulticast::PublishSettleDone(const wxString& errorMsg)
+{
+    if (!m_socket)
+        return;
+
+    Begin(MCAST_SETTLE_DONE);
+    put8(m_pkt, errorMsg.empty() ? 0 : 1);
+    put_text(m_pkt, errorMsg);
+    Send();
+}
+
+void TelemetryMulticast::PublishAlert(const wxString& msg, int type)
+{
+    if (!m_socket)
+        return;
+
+    unsigned int kind;
+    switch (type)
+    {
+    case wxICON_QUESTION: kind = 1; break;
+    case wxICON_WARNING: kind = 2; break;
+    case wxICON_ERROR: kind = 3; break;
+    default: kind = 0; break;
+    }
+
+    Begin(MCAST_ALERT);
+    put8(m_pkt, kind);
+    put_text(m_pkt, msg);
+    Send();
+}
@@ -0,0 +1,114 @@
+/*
+ *  telemetry_multicast.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TELEMETRY_MULTICAST_INCLUDED
+#define TELEMETRY_MULTICAST_INCLUDED
+
+// Optional UDP multicast of guiding telemetry, for any number of monitoring
+// listeners at a fixed cost to the guider: every packet is encoded once and
+// sent once, to the group, whoever is listening. Off by default; the
+// /server/multicast settings give the group (239.255.42.99), the port
+// (4800, shared by all instances, which the packet header tells apart) and
+// the TTL (1, the local network).
+//
+// Each datagram is a 24 byte little-endian header followed by the payload:
+//
+//   char[4]  magic "PHDM"
+//   uint8    version (1)
+//   uint8    packet type
+//   uint16   PHD2 instance number
+//   uint32   source id, random per run, so listeners can tell hosts apart
+//   uint32   sequence number, one per packet; a gap means packets were lost
+//   double   time the packet was sent, seconds since the epoch
+//
+// Payloads by type:
+//
+//   1 GuideStep   int64 telemetry step number, double step time (s since the
+//                 epoch), float dx, dy (camera px), float ra, dec (mount px),
+//                 int32 ra, dec pulse (ms), float SNR, float mass,
+//                 uint8 flags (1 RA limited, 2 Dec limited)
+//   2 AppState    uint8 state, see EXPOSED_STATE; sent on every change and
+//                 once a second
+//   3 Settling    float distance (px), float time in range (s), float settle time (s)
+//   4 SettleDone  uint8 status (0 settled, 1 failed), uint16 length, UTF-8 error
+//   5 Alert       uint8 kind (0 info, 1 question, 2 warning, 3 error),
+//                 uint16 length, UTF-8 message
+//
+// The guide steps are published as they join the telemetry store, so the
+// step numbers are the store's sequence numbers.
+
+enum MulticastPacketType
+{
+    MCAST_GUIDE_STEP = 1,
+    MCAST_APP_STATE = 2,
+    MCAST_SETTLING = 3,
+    MCAST_SETTLE_DONE = 4,
+    MCAST_ALERT = 5,
+};
+
+class TelemetryMulticast : public wxEvtHandler
+{
+    wxDatagramSocket *m_socket;
+    wxIPV4address m_group;
+    unsigned int m_instance;
+    wxUint32 m_sourceId;
+    wxUint32 m_seq;
+    int m_lastState;
+    wxTimer m_heartbeat;
+    std::vector<unsigned char> m_pkt;
+
+    void Begin(MulticastPacketType type);
+    void Send();
+    void OnHeartbeat(wxTimerEvent& evt);
+
+public:
+    TelemetryMulticast();
+    ~TelemetryMulticast();
+
+    // returns true on error
+    bool Start(unsigned int instanceId);
+    void Stop();
+    bool IsActive() const { return m_socket != 0; }
+
+    // the step with this sequence number, just appended to the store
+    void PublishGuideStep(long long seq);
+    // sends the app state if it has changed
+    void CheckAppState();
+    void PublishSettling(double distance, double time, double settleTime);
+    void PublishSettleDone(const wxString& errorMsg);
+    void PublishAlert(const wxString& msg, int type);
+};
+
+extern TelemetryMulticast TelemetryFeed;
+
+#endif
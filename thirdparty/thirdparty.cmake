@@ -445,6 +445,9 @@ set_property(TARGET gtest_main PROPERTY FOLDER "Thirdparty/")
 #############################################
 # wxWidgets
 # The usage is a bit different on all the platforms. For having version >= 3.0, a version of cmake >= 3.0 should be used on Windows (on Linux/OSX it works properly this way).
+if(GUIDER_OPENGL_VIEW)
+  set(PHD_WX_GL gl)
+endif()
 if(WIN32)
   # wxWidgets
   set(wxWidgets_CONFIGURATION msw)
@@ -457,7 +460,7 @@ if(WIN32)
   set(wxWidgets_USE_STATIC ON)
   set(wxWidgets_USE_DEBUG ON)
   set(wxWidgets_USE_UNICODE OFF)
-  find_package(wxWidgets REQUIRED COMPONENTS propgrid base core aui adv html net)
+  find_package(wxWidgets REQUIRED COMPONENTS ${PHD_WX_GL} propgrid base core aui adv html net)
   include(${wxWidgets_USE_FILE})
   #message(${wxWidgets_USE_FILE})
 
@@ -472,7 +475,7 @@ else()
     endif()  
   endif()
   
-  find_package(wxWidgets REQUIRED COMPONENTS aui core base adv html net)
+  find_package(wxWidgets REQUIRED COMPONENTS ${PHD_WX_GL} aui core base adv html net)
   if(NOT wxWidgets_FOUND)
     message(FATAL_ERROR "WxWidget cannot be found. Please use wx-config prefix")
   endif()
@@ -484,6 +487,17 @@ endif()
 
 set(PHD_LINK_EXTERNAL ${PHD_LINK_EXTERNAL} ${wxWidgets_LIBRARIES})
 
+if(GUIDER_OPENGL_VIEW)
+  find_package(OpenGL REQUIRED)
+  set(PHD_LINK_EXTERNAL ${PHD_LINK_EXTERNAL} ${OPENGL_LIBRARIES})
+endif()
+
+if(PHD2_OPENCL)
+  find_package(OpenCL REQUIRED)
+  include_directories(${OpenCL_INCLUDE_DIRS})
+  set(PHD_LINK_EXTERNAL ${PHD_LINK_EXTERNAL} ${OpenCL_LIBRARIES})
+endif()
+
 
 
 
@@ -571,12 +585,19 @@ if(WIN32)
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/ShoestringLXUSB_DLL.lib)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/ShoestringLXUSB_DLL.dll)
   
+  # Vendor camera SDKs are delay-loaded: the DLL is only mapped when the
+  # matching camera driver is first used (see GuideCamera::LoadDriverDll)
+  set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      delayimp.lib)
+  set(PHD_DELAYLOAD_DLLS    sbigudrv.dll)
+
   # asi cameras
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/AsiCamera2.lib)
+  set(PHD_DELAYLOAD_DLLS    ${PHD_DELAYLOAD_DLLS}     ASICamera2.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/ASICamera2.dll)
   
   # altair cameras
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/altaircamsdk.lib)
+  set(PHD_DELAYLOAD_DLLS    ${PHD_DELAYLOAD_DLLS}     altaircamsdk.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/altaircamsdk.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/Altaircam.dll)
   
@@ -590,6 +611,7 @@ if(WIN32)
   
   # DICAMSDK
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/DICAMSDK.lib)
+  set(PHD_DELAYLOAD_DLLS    ${PHD_DELAYLOAD_DLLS}     DICAMSDK.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/DICAMSDK.dll)
   
   # SSAGIF
@@ -600,10 +622,12 @@ if(WIN32)
   # FCLib
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/FCLib.lib)
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/FcApi.lib)
+  set(PHD_DELAYLOAD_DLLS    ${PHD_DELAYLOAD_DLLS}     FCApi.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/FCAPI.dll)
   
   # SXUSB
   set(PHD_LINK_EXTERNAL     ${PHD_LINK_EXTERNAL}      ${PHD_PROJECT_ROOT_DIR}/cameras/SXUSB.lib)
+  set(PHD_DELAYLOAD_DLLS    ${PHD_DELAYLOAD_DLLS}     SXUSB.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/SXUSB.dll)
   
   # astroDLL
@@ -627,6 +651,11 @@ if(WIN32)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/SSPIAGCAM.dll)
   set(PHD_COPY_EXTERNAL_ALL ${PHD_COPY_EXTERNAL_ALL}  ${PHD_PROJECT_ROOT_DIR}/WinLibs/SSPIAGUSB_WIN.dll)
 
+  set(PHD_DELAYLOAD_FLAGS)
+  foreach(_dll ${PHD_DELAYLOAD_DLLS})
+    set(PHD_DELAYLOAD_FLAGS "${PHD_DELAYLOAD_FLAGS} /DELAYLOAD:${_dll}")
+  endforeach()
+
   # ASCOM
   # disabled since not used in the SLN
   #find_package(ASCOM_INTERFACE REQUIRED)
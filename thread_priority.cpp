@@ -0,0 +1,318 @@
+/*
+ *  thread_priority.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#if defined(__WINDOWS__)
+# include <windows.h>
+#elif defined(__APPLE__)
+# include <pthread.h>
+# include <pthread/qos.h>
+#elif defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# include <errno.h>
+# include <string.h>
+#endif
+
+#include <wx/tokenzr.h>
+
+enum
+{
+    BACKGROUND_NICE = 10,       // Linux nice value of background threads
+};
+
+// the settings are read once on the main thread and only read afterwards
+static bool s_realtime;
+static bool s_rr;
+static int s_rtPriority = 10;
+static wxString s_affinityText;
+static std::vector<int> s_cpus;
+static bool s_lowerBackground = true;
+
+static wxCriticalSection s_lock;        // protects s_threads
+static std::map<wxString, ThreadPriorityThread> s_threads;
+
+#if defined(__WINDOWS__)
+typedef HANDLE (WINAPI *AvSetMmThreadCharacteristicsFn)(LPCWSTR, LPDWORD);
+typedef BOOL (WINAPI *AvRevertMmThreadCharacteristicsFn)(HANDLE);
+static AvSetMmThreadCharacteristicsFn s_avSet;
+static AvRevertMmThreadCharacteristicsFn s_avRevert;
+#endif
+
+// "0,2-3" -> 0 2 3; returns true on error
+static bool parse_cpus(const wxString& text, std::vector<int> *cpus)
+{
+    cpus->clear();
+    wxStringTokenizer tok(text, ", ", wxTOKEN_STRTOK);
+    while (tok.HasMoreTokens())
+    {
+        wxString t = tok.GetNextToken();
+        wxString lo = t.BeforeFirst('-');
+        wxString hi = t.Contains("-") ? t.AfterFirst('-') : lo;
+        long a, b;
+        if (!lo.ToLong(&a) || !hi.ToLong(&b) || a < 0 || b < a || b >= 1024)
+            return true;
+        for (long cpu = a; cpu <= b; cpu++)
+            cpus->push_back((int) cpu);
+    }
+    return false;
+}
+
+void ThreadPriority::Init(void)
+{
+    s_realtime = pConfig->Global.GetBoolean("/threads/realtime", false);
+    s_rr = pConfig->Global.GetString("/threads/rt_policy", "fifo").CmpNoCase("rr") == 0;
+    s_rtPriority = wxMax(1, wxMin(99, pConfig->Global.GetInt("/threads/rt_priority", 10)));
+    s_lowerBackground = pConfig->Global.GetBoolean("/threads/lower_background", true);
+
+    s_affinityText = pConfig->Global.GetString("/threads/affinity", wxEmptyString).Trim(true).Trim(false);
+    if (parse_cpus(s_affinityText, &s_cpus))
+    {
+        Debug.Write(wxString::Format("ThreadPriority: ignoring invalid affinity \"%s\"\n", s_affinityText));
+        s_cpus.clear();
+        s_affinityText.clear();
+    }
+
+#if defined(__WINDOWS__)
+    if (s_realtime)
+    {
+        HMODULE avrt = LoadLibraryW(L"avrt.dll");
+        if (avrt)
+        {
+            s_avSet = (AvSetMmThreadCharacteristicsFn) GetProcAddress(avrt, "AvSetMmThreadCharacteristicsW");
+            s_avRevert = (AvRevertMmThreadCharacteristicsFn) GetProcAddress(avrt, "AvRevertMmThreadCharacteristics");
+            if (!s_avSet || !s_avRevert)
+                s_avSet = NULL;
+        }
+    }
+#endif
+
+    Debug.Write(wxString::Format("ThreadPriority: realtime %d%s, affinity \"%s\", lower background %d\n", s_realtime,
+        s_realtime ? wxString::Format(" (%s %d)", s_rr ? "rr" : "fifo", s_rtPriority) : wxString(),
+        s_affinityText, s_lowerBackground));
+}
+
+static wxString policy_name(void)
+{
+    if (!s_realtime)
+        return wxEmptyString;
+#if defined(__WINDOWS__)
+    return s_avSet ? "MMCSS Pro Audio" : "TIME_CRITICAL";
+#elif defined(__APPLE__)
+    return "QOS_CLASS_USER_INTERACTIVE";
+#else
+    return wxString::Format("%s %d", s_rr ? "SCHED_RR" : "SCHED_FIFO", s_rtPriority);
+#endif
+}
+
+ThreadPriorityStatus ThreadPriority::GetStatus(void)
+{
+    ThreadPriorityStatus st;
+    st.realtime = s_realtime;
+    st.policy = policy_name();
+    st.affinity = s_affinityText;
+    st.lowerBackground = s_lowerBackground;
+
+    wxCriticalSectionLocker lck(s_lock);
+    for (std::map<wxString, ThreadPriorityThread>::const_iterator it = s_threads.begin(); it != s_threads.end(); ++it)
+        st.threads.push_back(it->second);
+    return st;
+}
+
+// returns true on error
+static bool set_realtime(void **task, wxString *err)
+{
+#if defined(__WINDOWS__)
+    if (s_avSet)
+    {
+        DWORD taskIndex = 0;
+        HANDLE h = s_avSet(L"Pro Audio", &taskIndex);
+        if (h)
+        {
+            *task = h;
+            return false;
+        }
+        *err = wxString::Format("MMCSS error %lu", (unsigned long) GetLastError());
+        // fall back to a plain priority boost
+    }
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        *err += wxString::Format("%sSetThreadPriority error %lu", err->empty() ? "" : ", ", (unsigned long) GetLastError());
+        return true;
+    }
+    return false;
+#elif defined(__APPLE__)
+    int ret = pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    if (ret != 0)
+    {
+        *err = wxString::Format("QoS error %d", ret);
+        return true;
+    }
+    return false;
+#elif defined(__linux__)
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = s_rtPriority;
+    int ret = pthread_setschedparam(pthread_self(), s_rr ? SCHED_RR : SCHED_FIFO, &param);
+    if (ret != 0)
+    {
+        *err = ret == EPERM ? wxString("not permitted, needs CAP_SYS_NICE or an rtprio limit") : wxString(strerror(ret));
+        return true;
+    }
+    return false;
+#else
+    *err = "not supported";
+    return true;
+#endif
+}
+
+static bool set_affinity(wxString *err)
+{
+#if defined(__WINDOWS__)
+    DWORD_PTR mask = 0;
+    for (size_t i = 0; i < s_cpus.size(); i++)
+        if (s_cpus[i] < (int) (8 * sizeof(DWORD_PTR)))
+            mask |= (DWORD_PTR) 1 << s_cpus[i];
+    if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask))
+    {
+        *err = wxString::Format("affinity error %lu", (unsigned long) GetLastError());
+        return true;
+    }
+    return false;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < s_cpus.size(); i++)
+        if (s_cpus[i] < CPU_SETSIZE)
+            CPU_SET(s_cpus[i], &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        *err = wxString::Format("affinity: %s", strerror(ret));
+        return true;
+    }
+    return false;
+#else
+    *err = "affinity not supported";
+    return true;
+#endif
+}
+
+static bool set_background(wxString *err)
+{
+#if defined(__WINDOWS__)
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL))
+    {
+        *err = wxString::Format("SetThreadPriority error %lu", (unsigned long) GetLastError());
+        return true;
+    }
+    return false;
+#elif defined(__APPLE__)
+    int ret = pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+    if (ret != 0)
+    {
+        *err = wxString::Format("QoS error %d", ret);
+        return true;
+    }
+    return false;
+#elif defined(__linux__)
+    // the nice value is per thread on Linux
+    if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), BACKGROUND_NICE) != 0)
+    {
+        *err = strerror(errno);
+        return true;
+    }
+    return false;
+#else
+    *err = "not supported";
+    return true;
+#endif
+}
+
+ThreadPriorityScope::ThreadPriorityScope(ThreadClass cls, const char *name)
+    : m_task(NULL)
+{
+    ThreadPriorityThread t;
+    t.name = name;
+    t.cls = cls;
+    t.granted = true;
+
+    if (cls == THREAD_CLASS_GUIDE)
+    {
+        if (s_realtime)
+        {
+            wxString err;
+            bool failed = set_realtime(&m_task, &err);
+            t.detail = policy_name() + (failed ? " denied: " + err : err.empty() ? wxString(" granted") : " granted after " + err);
+            if (failed)
+                t.granted = false;
+        }
+        if (!s_cpus.empty())
+        {
+            wxString err;
+            bool failed = set_affinity(&err);
+            if (!t.detail.empty())
+                t.detail += ", ";
+            t.detail += "affinity " + s_affinityText + (failed ? " denied: " + err : wxString(" granted"));
+            if (failed)
+                t.granted = false;
+        }
+    }
+    else if (s_lowerBackground)
+    {
+        wxString err;
+        bool failed = set_background(&err);
+        t.detail = failed ? "lowered priority denied: " + err : wxString("lowered priority");
+        t.granted = !failed;
+    }
+
+    if (t.detail.empty())
+        return;
+
+    Debug.Write(wxString::Format("ThreadPriority: %s %s\n", name, t.detail));
+
+    wxCriticalSectionLocker lck(s_lock);
+    s_threads[t.name] = t;
+}
+
+ThreadPriorityScope::~ThreadPriorityScope()
+{
+#if defined(__WINDOWS__)
+    if (m_task)
+        s_avRevert((HANDLE) m_task);
+#endif
+}
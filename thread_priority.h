@@ -0,0 +1,103 @@
+/*
+ *  thread_priority.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef THREAD_PRIORITY_INCLUDED
+#define THREAD_PRIORITY_INCLUDED
+
+// Scheduling of PHD2's own threads. Threads on the path of the guide loop,
+// the capture and mount worker threads, the image strip and star finder
+// pools and the capture node threads, are in the guide class; threads that
+// log, write files or compute off the guide loop are in the background
+// class. Each declares a ThreadPriorityScope at the top of its Entry.
+//
+// Global settings, read at startup:
+//
+//   /threads/realtime          run guide class threads at elevated priority
+//                              (default false): SCHED_FIFO or SCHED_RR on
+//                              Linux, which needs CAP_SYS_NICE or an rtprio
+//                              limit; the MMCSS "Pro Audio" task on Windows,
+//                              or THREAD_PRIORITY_TIME_CRITICAL without
+//                              MMCSS; the user-interactive QoS class on macOS
+//   /threads/rt_policy         "fifo" (default) or "rr", Linux only
+//   /threads/rt_priority       1-99 (default 10), Linux only
+//   /threads/affinity          CPUs for the guide class threads, such as
+//                              "2,3" or "2-3"; empty (the default) for any
+//                              CPU. Linux and Windows only
+//   /threads/lower_background  run background class threads at lowered
+//                              priority (default true)
+//
+// Whether each request was granted is written to the debug log and
+// reported by get_metrics.
+
+enum ThreadClass
+{
+    THREAD_CLASS_GUIDE,
+    THREAD_CLASS_BACKGROUND,
+};
+
+struct ThreadPriorityThread
+{
+    wxString name;
+    ThreadClass cls;
+    bool granted;           // everything asked for was granted
+    wxString detail;        // what was asked for and what failed
+};
+
+struct ThreadPriorityStatus
+{
+    bool realtime;
+    wxString policy;        // the elevated priority asked for, empty if none
+    wxString affinity;
+    bool lowerBackground;
+    std::vector<ThreadPriorityThread> threads;  // the last thread of each name
+};
+
+class ThreadPriority
+{
+public:
+    static void Init(void);         // read the settings, on the main thread at startup
+    static ThreadPriorityStatus GetStatus(void);
+};
+
+// applies the scheduling of the class to the calling thread, and undoes
+// what has to be undone when the thread ends
+class ThreadPriorityScope
+{
+    void *m_task;           // MMCSS task handle
+
+public:
+    ThreadPriorityScope(ThreadClass cls, const char *name);
+    ~ThreadPriorityScope();
+};
+
+#endif
@@ -1,537 +1,1437 @@
-/*
- *  usimage.cpp
- *  PHD Guiding
- *
- *  Created by Craig Stark.
- *  Copyright (c) 2006-2010 Craig Stark.
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#include "phd.h"
-#include "image_math.h"
-
-bool usImage::Init(const wxSize& size)
-{
-    // Allocates space for image and sets params up
-    // returns true on error
-
-    int prev = NPixels;
-    NPixels = size.GetWidth() * size.GetHeight();
-    Size = size;
-    Subframe = wxRect(0, 0, 0, 0);
-    Min = Max = 0;
-
-    if (NPixels != prev)
-    {
-        delete[] ImageData;
-
-        if (NPixels)
-        {
-            ImageData = new unsigned short[NPixels];
-            if (!ImageData)
-            {
-                NPixels = 0;
-                return true;
-            }
-        }
-        else
-            ImageData = NULL;
-    }
-
-    return false;
-}
-
-void usImage::SwapImageData(usImage& other)
-{
-    unsigned short *t = ImageData;
-    ImageData = other.ImageData;
-    other.ImageData = t;
-}
-
-void usImage::CalcStats()
-{
-    if (!ImageData || !NPixels)
-        return;
-
-    Min = 65535; Max = 0;
-    FiltMin = 65535; FiltMax = 0;
-
-    if (Subframe.IsEmpty())
-    {
-        // full frame, no subframe
-
-        const unsigned short *src;
-
-        src = ImageData;
-        for (int i = 0; i < NPixels; i++)
-        {
-            int d = (int) *src++;
-            if (d < Min) Min = d;
-            if (d > Max) Max = d;
-        }
-
-        unsigned short *tmpdata = new unsigned short[NPixels];
-
-        Median3(tmpdata, ImageData, Size, wxRect(Size));
-
-        src = tmpdata;
-        for (int i = 0; i < NPixels; i++)
-        {
-            int d = (int) *src++;
-            if (d < FiltMin) FiltMin = d;
-            if (d > FiltMax) FiltMax = d;
-        }
-
-        delete[] tmpdata;
-    }
-    else
-    {
-        // Subframe
-
-        unsigned int pixcnt = Subframe.width * Subframe.height;
-        unsigned short *tmpdata = new unsigned short[pixcnt];
-
-        unsigned short *dst;
-
-        dst = tmpdata;
-        for (int y = 0; y < Subframe.height; y++)
-        {
-            const unsigned short *src = ImageData + Subframe.x + (Subframe.y + y) * Size.GetWidth();
-            for (int x = 0; x < Subframe.width; x++)
-            {
-               int d = (int) *src;
-               if (d < Min) Min = d;
-               if (d > Max) Max = d;
-               *dst++ = *src++;
-            }
-        }
-
-        dst = new unsigned short[pixcnt];
-
-        Median3(dst, tmpdata, Subframe.GetSize(), wxRect(Subframe.GetSize()));
-
-        const unsigned short *src = dst;
-        for (unsigned int i = 0; i < pixcnt; i++)
-        {
-            int d = (int) *src++;
-            if (d < FiltMin) FiltMin = d;
-            if (d > FiltMax) FiltMax = d;
-        }
-
-        delete[] dst;
-        delete[] tmpdata;
-    }
-}
-
-bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
-{
-    wxImage *img = *rawimg;
-
-    if (!img || !img->Ok() || (img->GetWidth() != Size.GetWidth()) || (img->GetHeight() != Size.GetHeight()) ) // can't reuse bitmap
-    {
-        delete img;
-        img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
-    }
-
-    unsigned char *ImgPtr = img->GetData();
-    unsigned short *RawPtr = ImageData;
-
-    if (power == 1.0 || blevel >= wlevel)
-    {
-        float range = (float) wxMax(1, wlevel);  // Go 0-max
-        for (int i = 0; i < NPixels; i++, RawPtr++)
-        {
-            float d;
-            if (*RawPtr >= range)
-                d = 255.0;
-            else
-                d = ((float) (*RawPtr) / range) * 255.0;
-
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-        }
-    }
-    else
-    {
-        float range = (float) (wlevel - blevel);
-        for (int i = 0; i < NPixels; i++, RawPtr++ )
-        {
-            float d;
-            if (*RawPtr <= blevel)
-                d = 0.0;
-            else if (*RawPtr >= wlevel)
-                d = 255.0;
-            else
-            {
-                d = ((float) (*RawPtr) - (float) blevel) / range;
-                d = pow(d, (float) power) * 255.0;
-            }
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-            *ImgPtr++ = (unsigned char) d;
-        }
-    }
-
-    *rawimg = img;
-    return false;
-}
-
-bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
-{
-    wxImage *img;
-    unsigned char *ImgPtr;
-    unsigned short *RawPtr;
-    int x,y;
-    float d;
-    //, s_factor;
-    int full_xsize, full_ysize;
-    int use_xsize, use_ysize;
-
-    full_xsize = Size.GetWidth();
-    full_ysize = Size.GetHeight();
-    use_xsize = full_xsize;
-    use_ysize = full_ysize;
-    if (use_xsize % 2) use_xsize--;
-    if (use_ysize % 2) use_ysize--;
-//  Binsize = 2;
-
-    img = *rawimg;
-    if ((!img->Ok()) || (img->GetWidth() != (full_xsize/2)) || (img->GetHeight() != (full_ysize/2)) ) {  // can't reuse bitmap
-        if (img->Ok()) {
-            delete img;  // Clear out current image if it exists
-            img = (wxImage *) NULL;
-        }
-        img = new wxImage(full_xsize/2, full_ysize/2, false);
-    }
-    ImgPtr = img->GetData();
-    RawPtr = ImageData;
-//  s_factor = (((float) Max - (float) Min) / 255.0);
-    float range = (float) (wlevel - blevel);
-
-    if ((power == 1.0) || (range == 0.0)) {
-        range = wlevel;  // Go 0-max
-        if (range == 0.0) range = 0.001;
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
-                d = (d / range) * 255.0;
-                if (d < 0.0) d = 0.0;
-                else if (d > 255.0) d = 255.0;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-            }
-        }
-    }
-    else {
-        for (y=0; y<use_ysize; y+=2) {
-            for (x=0; x<use_xsize; x+=2) {
-                RawPtr = ImageData + x + y*full_xsize;
-                d = (float) (*RawPtr + *(RawPtr+1) + *(RawPtr+full_xsize) + *(RawPtr+1+full_xsize)) / 4.0;
-                d = (d - (float) blevel) / range ;
-                if (d < 0.0) d= 0.0;
-                else if (d > 1.0) d = 1.0;
-                d = pow(d, (float) power) * 255.0;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-                *ImgPtr = (unsigned char) d;
-                ImgPtr++;
-            }
-        }
-    }
-    *rawimg = img;
-    return false;
-}
-
-void usImage::InitImgStartTime()
-{
-    ImgStartTime = wxDateTime::GetTimeNow();
-}
-
-wxString usImage::GetImgStartTime() const
-{
-    if (!ImgStartTime)
-        return wxEmptyString;
-
-    struct tm *timestruct = gmtime(&ImgStartTime);
-    return wxString::Format("%.4d-%.2d-%.2dT%.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,
-        timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
-}
-
-struct FITSHdrWriter
-{
-    fitsfile *fptr;
-    int *status;
-    FITSHdrWriter(fitsfile *fptr_, int *status_) : fptr(fptr_), status(status_) { }
-    void write(const char *key, float val, const char *comment) {
-        fits_write_key(fptr, TFLOAT, const_cast<char *>(key), &val, const_cast<char *>(comment), status);
-    }
-    void write(const char *key, unsigned int val, const char *comment) {
-        fits_write_key(fptr, TUINT, const_cast<char *>(key), &val, const_cast<char *>(comment), status);
-    }
-    void write(const char *key, const char *val, const char *comment) {
-        fits_write_key(fptr, TSTRING, const_cast<char *>(key), const_cast<char *>(val), const_cast<char *>(comment), status);
-    }
-};
-
-bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
-{
-    bool bError = false;
-
-    try
-    {
-        long fsize[3] = {
-            (long)Size.GetWidth(),
-            (long)Size.GetHeight(),
-            0L,
-        };
-        long fpixel[3] = { 1, 1, 1 };
-
-        fitsfile *fptr;  // FITS file pointer
-        int status = 0;  // CFITSIO status value MUST be initialized to zero!
-
-        PHD_fits_create_file(&fptr, fname, true, &status);
-        fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
-
-        FITSHdrWriter hdr(fptr, &status);
-
-        float exposure = (float) ImgExpDur / 1000.0;
-        hdr.write("EXPOSURE", exposure, "Exposure time in seconds");
-
-        if (ImgStackCnt > 1)
-            hdr.write("STACKCNT", (unsigned int) ImgStackCnt, "Stacked frame count");
-
-        if (!hdrNote.IsEmpty())
-            hdr.write("USERNOTE", hdrNote.utf8_str(), 0);
-
-        time_t now = wxDateTime::GetTimeNow();
-        struct tm *timestruct = gmtime(&now);
-        char buf[100];
-        sprintf(buf, "%.4d-%.2d-%.2d %.2d:%.2d:%.2d", timestruct->tm_year + 1900, timestruct->tm_mon + 1, timestruct->tm_mday, timestruct->tm_hour, timestruct->tm_min, timestruct->tm_sec);
-        hdr.write("DATE", buf, "Time FITS file was created");
-
-        hdr.write("DATE-OBS", GetImgStartTime().c_str(), "Time image was captured");
-        hdr.write("CREATOR", wxString(APPNAME _T(" ") FULLVER).c_str(), "Capture software");
-        if (pCamera)
-        {
-            hdr.write("INSTRUME", pCamera->Name.c_str(), "Instrument name");
-            unsigned int b = pCamera->Binning;
-            hdr.write("XBINNING", b, "Camera X Bin");
-            hdr.write("YBINNING", b, "Camera Y Bin");
-            hdr.write("CCDXBIN", b, "Camera X Bin");
-            hdr.write("CCDYBIN", b, "Camera Y Bin");
-            float sz = b * pCamera->GetCameraPixelSize();
-            hdr.write("XPIXSZ", sz, "pixel size in microns (with binning)");
-            hdr.write("YPIXSZ", sz, "pixel size in microns (with binning)");
-            unsigned int g = (unsigned int) pCamera->GuideCameraGain;
-            hdr.write("GAIN", g, "PHD Gain Value (0-100)");
-        }
-
-        if (pPointingSource)
-        {
-            double ra, dec, st;
-            bool err = pPointingSource->GetCoordinates(&ra, &dec, &st);
-            if (!err)
-            {
-                hdr.write("RA", (float) (ra * 360.0 / 24.0), "Object Right Ascension in degrees");
-                hdr.write("DEC", (float) dec, "Object Declination in degrees");
-
-                {
-                    int h = (int) ra;
-                    ra -= h;
-                    ra *= 60.0;
-                    int m = (int) ra;
-                    ra -= m;
-                    ra *= 60.0;
-                    hdr.write("OBJCTRA", wxString::Format("%02d %02d %06.3f", h, m, ra).c_str(), "Object Right Ascension in hms");
-                }
-
-                {
-                    int sign = dec < 0.0 ? -1 : +1;
-                    dec *= sign;
-                    int d = (int) dec;
-                    dec -= d;
-                    dec *= 60.0;
-                    int m = (int) dec;
-                    dec -= m;
-                    dec *= 60.0;
-                    hdr.write("OBJCTDEC", wxString::Format("%c%d %02d %06.3f", sign < 0 ? '-' : '+', d, m, dec).c_str(), "Object Declination in dms");
-                }
-            }
-        }
-
-        float sc = (float) pFrame->GetCameraPixelScale();
-        hdr.write("SCALE", sc, "Image scale (arcsec / pixel)");
-        hdr.write("PIXSCALE", sc, "Image scale (arcsec / pixel)");
-        hdr.write("PEDESTAL", (unsigned int) Pedestal, "dark subtraction bias value");
-
-        fits_write_pix(fptr, TUSHORT, fpixel, NPixels, ImageData, &status);
-
-        PHD_fits_close_file(fptr);
-
-        bError = status ? true : false;
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
-    }
-
-    return bError;
-}
-
-bool usImage::Load(const wxString& fname)
-{
-    bool bError = false;
-
-    try
-    {
-        if (!wxFileExists(fname))
-        {
-            pFrame->Alert(_("File does not exist - cannot load ") + fname);
-            throw ERROR_INFO("File does not exist");
-        }
-
-        int status = 0;  // CFITSIO status value MUST be initialized to zero!
-        fitsfile *fptr;  // FITS file pointer
-        if (!PHD_fits_open_diskfile(&fptr, fname, READONLY, &status))
-        {
-            int hdutype;
-            if (fits_get_hdu_type(fptr, &hdutype, &status) || hdutype != IMAGE_HDU)
-            {
-                pFrame->Alert(_("FITS file is not of an image: ") + fname);
-                throw ERROR_INFO("Fits file is not an image");
-            }
-
-            // Get HDUs and size
-            int naxis = 0;
-            fits_get_img_dim(fptr, &naxis, &status);
-            long fsize[3];
-            fits_get_img_size(fptr, 2, fsize, &status);
-            int nhdus = 0;
-            fits_get_num_hdus(fptr, &nhdus, &status);
-            if ((nhdus != 1) || (naxis != 2)) {
-                pFrame->Alert(_("Unsupported type or read error loading FITS file ") + fname);
-                throw ERROR_INFO("unsupported type");
-            }
-            if (Init((int) fsize[0], (int) fsize[1]))
-            {
-                pFrame->Alert(_("Memory allocation error loading FITS file ") + fname);
-                throw ERROR_INFO("Memory Allocation failure");
-            }
-            long fpixel[3] = { 1, 1, 1 };
-            if (fits_read_pix(fptr, TUSHORT, fpixel, (int)(fsize[0] * fsize[1]), NULL, ImageData, NULL, &status)) { // Read image
-                pFrame->Alert(_("Error reading data from FITS file ") + fname);
-                throw ERROR_INFO("Error reading");
-            }
-
-            char *key = const_cast<char *>("EXPOSURE");
-            float exposure;
-            status = 0;
-            fits_read_key(fptr, TFLOAT, key, &exposure, NULL, &status);
-            if (status == 0)
-                ImgExpDur = (int) (exposure * 1000.0);
-
-            key = const_cast<char *>("STACKCNT");
-            int stackcnt;
-            status = 0;
-            fits_read_key(fptr, TINT, key, &stackcnt, NULL, &status);
-            if (status == 0)
-                ImgStackCnt = (int) stackcnt;
-
-            PHD_fits_close_file(fptr);
-        }
-        else
-        {
-            pFrame->Alert(_("Error opening FITS file ") + fname);
-            throw ERROR_INFO("error opening file");
-        }
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
-    }
-
-    return bError;
-}
-
-bool usImage::CopyFrom(const usImage& src)
-{
-    if (Init(src.Size))
-        return true;
-    memcpy(ImageData, src.ImageData, NPixels * sizeof(unsigned short));
-    return false;
-}
-
-bool usImage::Rotate(double theta, bool mirror)
-{
-    wxImage *pImg = 0;
-
-    CalcStats();
-
-    CopyToImage(&pImg, Min, Max, 1.0);
-
-    wxImage mirrored = *pImg;
-
-    if (mirror)
-    {
-        mirrored = pImg->Mirror(false);
-    }
-
-    wxImage rotated = mirrored.Rotate(theta, wxPoint(0,0));
-
-    CopyFromImage(rotated);
-
-    delete pImg;
-
-    return false;
-}
-
-bool usImage::CopyFromImage(const wxImage& img)
-{
-    Init(img.GetSize());
-
-    const unsigned char *pSrc = img.GetData();
-    unsigned short *pDest = ImageData;
-
-    for (int i = 0; i < NPixels; i++)
-    {
-        *pDest++ = ((unsigned short) *pSrc) << 8;
-        pSrc += 3;
-    }
-
-    return false;
-}
+/*
+ *  usimage.cpp
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark.
+ *  Copyright (c) 2006-2010 Craig Stark.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+#include "image_math.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define HAVE_SSE2_INTRINSICS
+#endif
+
+#include <algorithm>
+
+// Each pool buffer is preceded by a header recording the allocation so that
+// Free() does not need to be told the buffer size
+struct PoolBufHdr
+{
+    void *raw;
+    unsigned int npixels;
+};
+
+struct ImageBufferPoolImpl
+{
+    enum { MAX_CACHED = 6 };  // enough for a few frames in flight plus temporaries
+
+    wxCriticalSection lock;
+    std::vector<unsigned short *> cached;  // most recently freed last
+
+    void Clear();
+};
+
+// never destroyed, usImage objects may outlive static destruction order
+static ImageBufferPoolImpl& s_pool = *new ImageBufferPoolImpl();
+
+inline static PoolBufHdr *pool_hdr(unsigned short *buf)
+{
+    return reinterpret_cast<PoolBufHdr *>(buf) - 1;
+}
+
+static void pool_release(unsigned short *buf)
+{
+    free(pool_hdr(buf)->raw);
+}
+
+void ImageBufferPoolImpl::Clear()
+{
+    wxCriticalSectionLocker lck(lock);
+    for (std::vector<unsigned short *>::iterator it = cached.begin(); it != cached.end(); ++it)
+        pool_release(*it);
+    cached.clear();
+}
+
+unsigned short *ImageBufferPool::Alloc(unsigned int npixels)
+{
+    {
+        wxCriticalSectionLocker lck(s_pool.lock);
+        for (std::vector<unsigned short *>::reverse_iterator it = s_pool.cached.rbegin(); it != s_pool.cached.rend(); ++it)
+        {
+            unsigned short *buf = *it;
+            if (pool_hdr(buf)->npixels == npixels)
+            {
+                s_pool.cached.erase(--it.base());
+                return buf;
+            }
+        }
+    }
+
+    size_t bytes = (size_t) npixels * sizeof(unsigned short) + sizeof(PoolBufHdr) + ALIGNMENT;
+    void *raw = malloc(bytes);
+    if (!raw)
+        return 0;
+
+    wxUIntPtr p = (wxUIntPtr) raw + sizeof(PoolBufHdr);
+    p = (p + ALIGNMENT - 1) & ~(wxUIntPtr) (ALIGNMENT - 1);
+    unsigned short *buf = reinterpret_cast<unsigned short *>(p);
+
+    PoolBufHdr *hdr = pool_hdr(buf);
+    hdr->raw = raw;
+    hdr->npixels = npixels;
+
+    return buf;
+}
+
+void ImageBufferPool::Free(unsigned short *buf)
+{
+    if (!buf)
+        return;
+
+    unsigned short *evict = 0;
+    {
+        wxCriticalSectionLocker lck(s_pool.lock);
+        s_pool.cached.push_back(buf);
+        if (s_pool.cached.size() > ImageBufferPoolImpl::MAX_CACHED)
+        {
+            evict = s_pool.cached.front();
+            s_pool.cached.erase(s_pool.cached.begin());
+        }
+    }
+
+    if (evict)
+        pool_release(evict);
+}
+
+void ImageBufferPool::Clear(void)
+{
+    s_pool.Clear();
+}
+
+static void FreeImages(std::vector<usImage *>& images)
+{
+    wxStopWatch swatch;
+    size_t const count = images.size();
+    for (std::vector<usImage *>::iterator it = images.begin(); it != images.end(); ++it)
+        delete *it;
+    images.clear();
+    ImageBufferPool::Clear();
+    Debug.Write(wxString::Format("image release: freed %u images in %ld ms\n", (unsigned int) count, swatch.Time()));
+}
+
+class ImageReleaseThread : public wxThread
+{
+    std::vector<usImage *> m_images;
+
+public:
+    ImageReleaseThread(std::vector<usImage *>& images) : wxThread(wxTHREAD_JOINABLE) { m_images.swap(images); }
+    ~ImageReleaseThread() { if (!m_images.empty()) FreeImages(m_images); }  // if the thread never ran
+
+protected:
+    ExitCode Entry()
+    {
+        PerfTrace::SetThreadName("image release");
+        FreeImages(m_images);
+        return 0;
+    }
+};
+
+static ImageReleaseThread *s_releaseThread;
+
+void ImageRelease::Start(std::vector<usImage *>& images)
+{
+    Finish();
+
+    if (images.empty())
+        return;
+
+    ImageReleaseThread *thread = new ImageReleaseThread(images);
+    if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        // the images are freed here instead
+        delete thread;
+        return;
+    }
+
+    s_releaseThread = thread;
+}
+
+void ImageRelease::Finish(void)
+{
+    if (!s_releaseThread)
+        return;
+
+    s_releaseThread->Wait();
+    delete s_releaseThread;
+    s_releaseThread = NULL;
+}
+
+bool usImage::Init(const wxSize& size)
+{
+    // Allocates space for image and sets params up
+    // returns true on error
+
+    return InitData(size, wxRect(size));
+}
+
+bool usImage::InitROI(const wxSize& size, const wxRect& roi)
+{
+    wxRect r(roi);
+    r.Intersect(wxRect(size));
+    if (r.IsEmpty())
+        return true;
+
+    if (InitData(size, r))
+        return true;
+
+    Subframe = r;
+    return false;
+}
+
+bool usImage::InitData(const wxSize& size, const wxRect& data)
+{
+    int prev = NPixels;
+    NPixels = data.GetWidth() * data.GetHeight();
+    Size = size;
+    DataRect = data;
+    Subframe = wxRect(0, 0, 0, 0);
+    Min = Max = 0;
+
+    if (NPixels != prev || BufferOwner)
+    {
+        FreeImageData();
+
+        if (NPixels)
+        {
+            ImageData = ImageBufferPool::Alloc(NPixels);
+            if (!ImageData)
+            {
+                NPixels = 0;
+                return true;
+            }
+        }
+        else
+            ImageData = NULL;
+    }
+
+    return false;
+}
+
+void usImage::FreeImageData(void)
+{
+    if (BufferOwner)
+    {
+        BufferOwner->Release();
+        BufferOwner = NULL;
+    }
+    else
+        ImageBufferPool::Free(ImageData);
+    ImageData = NULL;
+}
+
+// use pixel data owned by someone else; the image holds a reference to the
+// owner until the data is released
+void usImage::AttachImageData(unsigned short *data, const wxSize& size, ImageBufferOwner *owner)
+{
+    FreeImageData();
+
+    owner->AddRef();
+    BufferOwner = owner;
+    ImageData = data;
+    NPixels = size.GetWidth() * size.GetHeight();
+    Size = size;
+    DataRect = wxRect(size);
+    Subframe = wxRect(0, 0, 0, 0);
+    Min = Max = 0;
+}
+
+void usImage::SwapImageData(usImage& other)
+{
+    unsigned short *t = ImageData;
+    ImageData = other.ImageData;
+    other.ImageData = t;
+    ImageBufferOwner *o = BufferOwner;
+    BufferOwner = other.BufferOwner;
+    other.BufferOwner = o;
+    std::swap(DataRect, other.DataRect);
+    std::swap(NPixels, other.NPixels);
+}
+
+// full frame copy of an ROI-only image, zero outside the pixels it holds
+static bool ExpandInto(usImage *full, const usImage& src)
+{
+    if (full->Init(src.Size))
+        return true;
+    full->Clear();
+
+    const wxRect& r = src.DataRect;
+    for (int y = r.GetTop(); y <= r.GetBottom(); y++)
+        memcpy(&full->Pixel(r.GetLeft(), y), &src.Pixel(r.GetLeft(), y), r.GetWidth() * sizeof(unsigned short));
+
+    full->Subframe = src.Subframe;
+    return false;
+}
+
+bool usImage::ExpandToFullFrame(void)
+{
+    if (!IsROIOnly())
+        return false;
+
+    usImage full;
+    if (!ImageData || ExpandInto(&full, *this))
+        return true;
+
+    SwapImageData(full);
+    return false;
+}
+
+const usImage *usImage::FullFrame(usImage *scratch) const
+{
+    if (!IsROIOnly())
+        return this;
+
+    if (!ImageData || ExpandInto(scratch, *this))
+        return NULL;
+
+    return scratch;
+}
+
+void usImage::CalcStats()
+{
+    if (Subframe.IsEmpty())
+        CalcStats(wxRect(Size));
+    else
+        CalcStats(Subframe);
+}
+
+void usImage::CalcStats(const wxRect& rect)
+{
+    if (!ImageData || !NPixels)
+        return;
+
+    wxRect r(rect);
+    r.Intersect(DataRect);
+    if (r.GetWidth() < 2 || r.GetHeight() < 2)
+        return;
+
+    // Min/Max and the min/max of the 3x3 median filtered image are computed in
+    // a single pass without allocating a filtered copy of the image
+    Median3MinMax(*this, r, &Min, &Max, &FiltMin, &FiltMax);
+}
+
+// The display levels come from a histogram of about DISPLAY_SAMPLES pixels,
+// every 4th row and column of a 1 Mpixel frame, rather than from the full
+// frame stats. The black and white points are the LEVEL_BLACK and
+// LEVEL_WHITE points of the sample, in 1/10000 of its pixels; hot and cold
+// pixels fall outside them the way the median filter of CalcStats keeps them
+// out of FiltMin and FiltMax. The 16-bit histogram is built in two passes,
+// 256 bins of the high byte and then the low byte within the one or two bins
+// holding the points, which is exact for the sample.
+enum
+{
+    DISPLAY_SAMPLES = 65536,
+    LEVEL_BLACK = 10,
+    LEVEL_WHITE = 9995,
+};
+
+static int level_bin(const unsigned int *hist, unsigned int rank)
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < 256; i++)
+    {
+        sum += hist[i];
+        if (sum > rank)
+            return i;
+    }
+    return 255;
+}
+
+void usImage::CalcDisplayLevels(int *blevel, int *wlevel) const
+{
+    *blevel = *wlevel = 0;
+
+    if (!ImageData || !NPixels)
+        return;
+
+    wxRect r(Subframe.IsEmpty() ? wxRect(Size) : Subframe);
+    r.Intersect(DataRect);
+    if (r.IsEmpty())
+        return;
+
+    int step = (int) sqrt((double) r.GetWidth() * r.GetHeight() / DISPLAY_SAMPLES);
+    if (step < 1)
+        step = 1;
+
+    unsigned int coarse[256] = { 0 };
+    unsigned int n = 0;
+    for (int y = r.GetTop(); y <= r.GetBottom(); y += step)
+    {
+        const unsigned short *p = &Pixel(r.GetLeft(), y);
+        for (int x = 0; x < r.GetWidth(); x += step)
+            coarse[p[x] >> 8]++;
+        n += (r.GetWidth() + step - 1) / step;
+    }
+
+    unsigned int const rankB = (unsigned int) ((unsigned long long) n * LEVEL_BLACK / 10000);
+    unsigned int const rankW = (unsigned int) ((unsigned long long) n * LEVEL_WHITE / 10000);
+    int const hiB = level_bin(coarse, rankB);
+    int const hiW = level_bin(coarse, rankW);
+
+    // ranks within the two coarse bins
+    unsigned int belowB = 0, belowW = 0;
+    for (int i = 0; i < hiB; i++)
+        belowB += coarse[i];
+    for (int i = 0; i < hiW; i++)
+        belowW += coarse[i];
+
+    unsigned int fineB[256] = { 0 };
+    unsigned int fineW[256] = { 0 };
+    for (int y = r.GetTop(); y <= r.GetBottom(); y += step)
+    {
+        const unsigned short *p = &Pixel(r.GetLeft(), y);
+        for (int x = 0; x < r.GetWidth(); x += step)
+        {
+            int const hi = p[x] >> 8;
+            if (hi == hiB)
+                fineB[p[x] & 0xff]++;
+            if (hi == hiW)
+                fineW[p[x] & 0xff]++;
+        }
+    }
+
+    *blevel = (hiB << 8) | level_bin(fineB, rankB - belowB);
+    *wlevel = (hiW << 8) | level_bin(fineW, rankW - belowW);
+    if (*wlevel <= *blevel)
+        *wlevel = wxMin(*blevel + 1, 65535);
+}
+
+// Display stretch lookup table mapping each 16-bit pixel value to an 8-bit
+// display value. Building the table costs 64K evaluations of the stretch
+// function, so the table used by the main (display) thread is cached and only
+// rebuilt when the stretch parameters change.
+struct StretchLut
+{
+    int blevel;
+    int wlevel;
+    double power;
+    bool valid;
+    unsigned char val[65536];
+
+    StretchLut() : valid(false) { }
+
+    bool Matches(int blevel_, int wlevel_, double power_) const
+    {
+        return valid && blevel == blevel_ && wlevel == wlevel_ && power == power_;
+    }
+
+    void Build(int blevel_, int wlevel_, double power_);
+};
+
+void StretchLut::Build(int blevel_, int wlevel_, double power_)
+{
+    blevel = blevel_;
+    wlevel = wlevel_;
+    power = power_;
+
+    if (power == 1.0 || blevel >= wlevel)
+    {
+        float range = (float) wxMax(1, wlevel);  // Go 0-max
+        for (int i = 0; i < 65536; i++)
+        {
+            float d;
+            if (i >= range)
+                d = 255.0;
+            else
+                d = ((float) i / range) * 255.0;
+            val[i] = (unsigned char) d;
+        }
+    }
+    else
+    {
+        float range = (float) (wlevel - blevel);
+        for (int i = 0; i < 65536; i++)
+        {
+            float d;
+            if (i <= blevel)
+                d = 0.0;
+            else if (i >= wlevel)
+                d = 255.0;
+            else
+            {
+                d = ((float) i - (float) blevel) / range;
+                d = pow(d, (float) power) * 255.0;
+            }
+            val[i] = (unsigned char) d;
+        }
+    }
+
+    valid = true;
+}
+
+// The cached table is only used by the main thread. Other threads (image
+// rotation in the camera worker thread) get a private table.
+struct StretchLutRef
+{
+    StretchLut *m_tmp;
+    const unsigned char *val;
+
+    StretchLutRef(int blevel, int wlevel, double power)
+        : m_tmp(0)
+    {
+        if (wxThread::IsMain())
+        {
+            static StretchLut s_lut;
+            if (!s_lut.Matches(blevel, wlevel, power))
+                s_lut.Build(blevel, wlevel, power);
+            val = s_lut.val;
+        }
+        else
+        {
+            m_tmp = new StretchLut();
+            m_tmp->Build(blevel, wlevel, power);
+            val = m_tmp->val;
+        }
+    }
+    ~StretchLutRef() { delete m_tmp; }
+};
+
+
+bool usImage::CopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
+{
+    wxImage *img = *rawimg;
+
+    if (!img || !img->Ok() || (img->GetWidth() != Size.GetWidth()) || (img->GetHeight() != Size.GetHeight()) ) // can't reuse bitmap
+    {
+        delete img;
+        img = new wxImage(Size.GetWidth(), Size.GetHeight(), false);
+    }
+
+    StretchLutRef lut(blevel, wlevel, power);
+
+    if (IsROIOnly())
+    {
+        // only the subframe is stretched, the rest of the frame is black
+        unsigned char *data = img->GetData();
+        size_t const width = Size.GetWidth();
+        memset(data, 0, width * Size.GetHeight() * 3);
+        for (int y = DataRect.GetTop(); y <= DataRect.GetBottom(); y++)
+            Kernels.stretchToRGB(data + (y * width + DataRect.GetLeft()) * 3, &Pixel(DataRect.GetLeft(), y), DataRect.GetWidth(), lut.val);
+    }
+    else
+        Kernels.stretchToRGB(img->GetData(), ImageData, NPixels, lut.val);
+
+    *rawimg = img;
+    return false;
+}
+
+// Each pixel of the reduced image covers a box of source pixels, reduced to
+// its mean or to its maximum; the maximum keeps faint stars visible when a
+// large frame is shown in a small window.
+struct ScaledStretchJob : public ImageStripJob
+{
+    const usImage& src;
+    unsigned char *dst;
+    int width;
+    std::vector<int> xb;        // source columns of result column i are xb[i] .. xb[i+1] - 1
+    std::vector<int> yb;
+    const unsigned char *lut;
+    bool peak;
+
+    ScaledStretchJob(const usImage& src_, unsigned char *dst_, int width_, int height_, const unsigned char *lut_, bool peak_)
+        : src(src_), dst(dst_), width(width_), xb(width_ + 1), yb(height_ + 1), lut(lut_), peak(peak_)
+    {
+        int const sw = src.Size.GetWidth();
+        int const sh = src.Size.GetHeight();
+        for (int i = 0; i <= width; i++)
+            xb[i] = (int)((long long) i * sw / width);
+        for (int i = 0; i <= height_; i++)
+            yb[i] = (int)((long long) i * sh / height_);
+    }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void ScaledStretchJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const sw = src.Size.GetWidth();
+
+    std::vector<unsigned long long> acc(width);
+
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        std::fill(acc.begin(), acc.end(), 0);
+
+        for (int sy = yb[y]; sy < yb[y + 1]; sy++)
+        {
+            const unsigned short *s = src.ImageData + (size_t) sy * sw;
+            if (peak)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    unsigned int m = (unsigned int) acc[x];
+                    for (int sx = xb[x]; sx < xb[x + 1]; sx++)
+                        if (s[sx] > m)
+                            m = s[sx];
+                    acc[x] = m;
+                }
+            }
+            else
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    unsigned int t = 0;
+                    for (int sx = xb[x]; sx < xb[x + 1]; sx++)
+                        t += s[sx];
+                    acc[x] += t;
+                }
+            }
+        }
+
+        unsigned char *d = dst + (size_t) y * width * 3;
+        unsigned int const rows = yb[y + 1] - yb[y];
+        for (int x = 0; x < width; x++, d += 3)
+        {
+            unsigned int v = peak ? (unsigned int) acc[x] : (unsigned int)(acc[x] / (rows * (xb[x + 1] - xb[x])));
+            d[0] = d[1] = d[2] = lut[v];
+        }
+    }
+}
+
+bool usImage::CopyToImageScaled(wxImage **rawimg, int width, int height, int blevel, int wlevel, double power, bool peak) const
+{
+    // downsample and stretch in one pass, so only the pixels that will be
+    // shown go through the stretch
+    if (width < 1 || height < 1 || width > Size.GetWidth() || height > Size.GetHeight())
+        return true;
+
+    wxImage *img = *rawimg;
+
+    if (!img || !img->Ok() || img->GetWidth() != width || img->GetHeight() != height)
+    {
+        delete img;
+        img = new wxImage(width, height, false);
+    }
+
+    usImage scratch;
+    const usImage *full = FullFrame(&scratch);
+    if (!full)
+        return true;
+
+    StretchLutRef lut(blevel, wlevel, power);
+
+    ScaledStretchJob job(*full, img->GetData(), width, height, lut.val, peak);
+    RunImageStrips(job, ImageStripCount(height, 64), height);
+
+    *rawimg = img;
+    return false;
+}
+
+// one level of an ImagePyramid from the level above it
+struct PyramidLevelJob : public ImageStripJob
+{
+    const usImage& src;
+    usImage& dst;
+    bool peak;
+
+    PyramidLevelJob(const usImage& src_, usImage& dst_, bool peak_) : src(src_), dst(dst_), peak(peak_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+void PyramidLevelJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    int const sw = src.Size.GetWidth();
+    int const width = dst.Size.GetWidth();
+
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        const unsigned short *s = src.ImageData + (size_t)(y * 2) * sw;
+        unsigned short *d = dst.ImageData + (size_t) y * width;
+
+        if (peak)
+        {
+            for (int x = 0; x < width; x++, s += 2)
+                d[x] = std::max(std::max(s[0], s[1]), std::max(s[sw], s[sw + 1]));
+        }
+        else
+        {
+            for (int x = 0; x < width; x++, s += 2)
+                d[x] = (unsigned short)(((unsigned int) s[0] + s[1] + s[sw] + s[sw + 1]) >> 2);
+        }
+    }
+}
+
+ImagePyramid::~ImagePyramid()
+{
+    for (std::vector<usImage *>::iterator it = m_levels.begin(); it != m_levels.end(); ++it)
+        delete *it;
+}
+
+const usImage& ImagePyramid::Level(const usImage& frame, int width, int height, bool peak)
+{
+    if (peak != m_peak)
+    {
+        m_peak = peak;
+        m_built = 0;
+    }
+
+    const usImage *cur = &frame;
+
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    for (unsigned int i = 0; cur->Size.GetWidth() / 2 >= width && cur->Size.GetHeight() / 2 >= height; i++)
+    {
+        if (i >= m_built)
+        {
+            if (i == m_levels.size())
+                m_levels.push_back(new usImage());
+
+            usImage& level = *m_levels[i];
+            if (level.Init(cur->Size.GetWidth() / 2, cur->Size.GetHeight() / 2))
+                break;
+
+            // the first level of an ROI-only frame is built from a full
+            // frame copy of it
+            const usImage *src = cur->FullFrame(&m_full);
+            if (!src)
+                break;
+
+            PyramidLevelJob job(*src, level, m_peak);
+            RunImageStrips(job, ImageStripCount(level.Size.GetHeight(), 64), level.Size.GetHeight());
+            m_built = i + 1;
+        }
+        cur = m_levels[i];
+    }
+
+    return *cur;
+}
+
+bool usImage::BinnedCopyToImage(wxImage **rawimg, int blevel, int wlevel, double power)
+{
+    wxImage *img;
+    unsigned char *ImgPtr;
+    const unsigned short *RawPtr;
+    int x,y;
+    int full_xsize, full_ysize;
+    int use_xsize, use_ysize;
+
+    full_xsize = Size.GetWidth();
+    full_ysize = Size.GetHeight();
+    use_xsize = full_xsize;
+    use_ysize = full_ysize;
+    if (use_xsize % 2) use_xsize--;
+    if (use_ysize % 2) use_ysize--;
+
+    img = *rawimg;
+    if ((!img->Ok()) || (img->GetWidth() != (full_xsize/2)) || (img->GetHeight() != (full_ysize/2)) ) {  // can't reuse bitmap
+        if (img->Ok()) {
+            delete img;  // Clear out current image if it exists
+            img = (wxImage *) NULL;
+        }
+        img = new wxImage(full_xsize/2, full_ysize/2, false);
+    }
+    ImgPtr = img->GetData();
+
+    usImage scratch;
+    const usImage *full = FullFrame(&scratch);
+    if (!full)
+        return true;
+
+    StretchLutRef lut(blevel, wlevel, power);
+
+    for (y = 0; y < use_ysize; y += 2) {
+        RawPtr = full->ImageData + y * full_xsize;
+        for (x = 0; x < use_xsize; x += 2, RawPtr += 2) {
+            unsigned int sum = (unsigned int) RawPtr[0] + RawPtr[1] + RawPtr[full_xsize] + RawPtr[full_xsize + 1];
+            unsigned char d = lut.val[sum >> 2];
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+            *ImgPtr++ = d;
+        }
+    }
+
+    *rawimg = img;
+    return false;
+}
+
+// the start is the time of the capture request until the driver says
+// otherwise; the end is filled in when the capture completes
+void usImage::InitImgStartTime()
+{
+    ExposureStartUs = wxGetUTCTimeUSec().GetValue();
+    ExposureEndUs = 0;
+    ExposureTimed = false;
+    ImgStartTime = (time_t) (ExposureStartUs / 1000000);
+}
+
+void usImage::SetExposureTimes(wxLongLong_t startUs, wxLongLong_t endUs)
+{
+    ExposureStartUs = startUs;
+    ExposureEndUs = endUs;
+    ExposureTimed = true;
+    ImgStartTime = (time_t) (startUs / 1000000);
+}
+
+bool usImage::GetExposureMidTime(wxLongLong_t *us) const
+{
+    if (!ExposureStartUs || ExposureEndUs < ExposureStartUs)
+        return false;
+    *us = ExposureStartUs + (ExposureEndUs - ExposureStartUs) / 2;
+    return true;
+}
+
+wxString usImage::GetImgStartTime() const
+{
+    if (!ImgStartTime)
+        return wxEmptyString;
+
+    struct tm *timestruct = gmtime(&ImgStartTime);
+    wxString s = wxString::Format("%.4d-%.2d-%.2dT%.2d:%.2d:%.2d",timestruct->tm_year+1900,timestruct->tm_mon+1,
+        timestruct->tm_mday,timestruct->tm_hour,timestruct->tm_min,timestruct->tm_sec);
+    // the milliseconds, unless ImgStartTime was set on its own
+    if (ExposureStartUs && (time_t) (ExposureStartUs / 1000000) == ImgStartTime)
+        s += wxString::Format(".%.3d", (int) (ExposureStartUs / 1000 % 1000));
+    return s;
+}
+
+void usImage::GetFitsHeader(FITSHeader *phdr, const wxString& hdrNote) const
+{
+    FITSHeader& hdr = *phdr;
+
+    float exposure = (float) ImgExpDur / 1000.0;
+    hdr.write("EXPOSURE", exposure, "Exposure time in seconds");
+
+    if (ImgStackCnt > 1)
+        hdr.write("STACKCNT", (unsigned int) ImgStackCnt, "Stacked frame count");
+
+    if (!hdrNote.IsEmpty())
+        hdr.write("USERNOTE", hdrNote.utf8_str(), 0);
+
+    time_t now = wxDateTime::GetTimeNow();
+    struct tm *timestruct = gmtime(&now);
+    char buf[100];
+    sprintf(buf, "%.4d-%.2d-%.2d %.2d:%.2d:%.2d", timestruct->tm_year + 1900, timestruct->tm_mon + 1, timestruct->tm_mday, timestruct->tm_hour, timestruct->tm_min, timestruct->tm_sec);
+    hdr.write("DATE", buf, "Time FITS file was created");
+
+    hdr.write("DATE-OBS", GetImgStartTime().c_str(), "Time image was captured");
+    hdr.write("CREATOR", wxString(APPNAME _T(" ") FULLVER).c_str(), "Capture software");
+    if (pCamera)
+    {
+        hdr.write("INSTRUME", pCamera->Name.c_str(), "Instrument name");
+        unsigned int b = pCamera->EffectiveBinning();
+        hdr.write("XBINNING", b, "Camera X Bin");
+        hdr.write("YBINNING", b, "Camera Y Bin");
+        hdr.write("CCDXBIN", b, "Camera X Bin");
+        hdr.write("CCDYBIN", b, "Camera Y Bin");
+        float sz = b * pCamera->GetCameraPixelSize();
+        hdr.write("XPIXSZ", sz, "pixel size in microns (with binning)");
+        hdr.write("YPIXSZ", sz, "pixel size in microns (with binning)");
+        unsigned int g = (unsigned int) pCamera->GuideCameraGain;
+        hdr.write("GAIN", g, "PHD Gain Value (0-100)");
+    }
+
+    if (pPointingSource)
+    {
+        double ra, dec, st;
+        bool err = PointingCache::GetCoordinates(&ra, &dec, &st);
+        if (!err)
+        {
+            hdr.write("RA", (float) (ra * 360.0 / 24.0), "Object Right Ascension in degrees");
+            hdr.write("DEC", (float) dec, "Object Declination in degrees");
+
+            {
+                int h = (int) ra;
+                ra -= h;
+                ra *= 60.0;
+                int m = (int) ra;
+                ra -= m;
+                ra *= 60.0;
+                hdr.write("OBJCTRA", wxString::Format("%02d %02d %06.3f", h, m, ra).c_str(), "Object Right Ascension in hms");
+            }
+
+            {
+                int sign = dec < 0.0 ? -1 : +1;
+                dec *= sign;
+                int d = (int) dec;
+                dec -= d;
+                dec *= 60.0;
+                int m = (int) dec;
+                dec -= m;
+                dec *= 60.0;
+                hdr.write("OBJCTDEC", wxString::Format("%c%d %02d %06.3f", sign < 0 ? '-' : '+', d, m, dec).c_str(), "Object Declination in dms");
+            }
+        }
+    }
+
+    float sc = (float) pFrame->GetCameraPixelScale();
+    hdr.write("SCALE", sc, "Image scale (arcsec / pixel)");
+    hdr.write("PIXSCALE", sc, "Image scale (arcsec / pixel)");
+    hdr.write("PEDESTAL", (unsigned int) Pedestal, "dark subtraction bias value");
+}
+
+bool usImage::WriteFits(const wxString& fname, const FITSHeader& hdr, bool compress) const
+{
+    long fsize[3] = {
+        (long)Size.GetWidth(),
+        (long)Size.GetHeight(),
+        0L,
+    };
+    long fpixel[3] = { 1, 1, 1 };
+
+    usImage scratch;
+    const usImage *full = FullFrame(&scratch);
+    if (!full)
+        return true;
+
+    fitsfile *fptr;  // FITS file pointer
+    int status = 0;  // CFITSIO status value MUST be initialized to zero!
+
+    PHD_fits_create_file(&fptr, fname, true, &status);
+    if (status)
+        return true;
+
+    // lossless Rice tile compression of the 16-bit pixels; the image goes in
+    // an extension after an empty primary HDU
+    if (compress)
+        fits_set_compression_type(fptr, RICE_1, &status);
+
+    fits_create_img(fptr, USHORT_IMG, 2, fsize, &status);
+
+    hdr.WriteTo(fptr, &status);
+
+    fits_write_pix(fptr, TUSHORT, fpixel, full->NPixels, full->ImageData, &status);
+
+    PHD_fits_close_file(fptr);
+
+    return status ? true : false;
+}
+
+bool usImage::Save(const wxString& fname, const wxString& hdrNote) const
+{
+    FITSHeader hdr;
+    GetFitsHeader(&hdr, hdrNote);
+    return WriteFits(fname, hdr, false);
+}
+
+// The header keywords LoadSimpleFits needs, from the primary header only
+struct SimpleFitsHeader
+{
+    bool simple;
+    int bitpix;
+    int naxis;
+    long naxis1;
+    long naxis2;
+    double bzero;
+    double bscale;
+    bool haveExposure;
+    double exposure;
+    bool haveStackCnt;
+    long stackCnt;
+    size_t dataOffset;
+
+    SimpleFitsHeader()
+        : simple(false), bitpix(0), naxis(-1), naxis1(0), naxis2(0), bzero(0.0), bscale(1.0),
+          haveExposure(false), exposure(0.0), haveStackCnt(false), stackCnt(1), dataOffset(0) { }
+};
+
+enum
+{
+    FITS_BLOCK = 2880,
+    FITS_CARD = 80,
+    FITS_MAX_HEADER_BLOCKS = 64,
+};
+
+// parse the 80 character cards up to END; true if the header is cut short
+// or malformed
+static bool ParseSimpleFitsHeader(const char *p, size_t size, SimpleFitsHeader *hdr)
+{
+    size_t const limit = wxMin(size, (size_t) FITS_BLOCK * FITS_MAX_HEADER_BLOCKS);
+
+    for (size_t pos = 0; pos + FITS_CARD <= limit; pos += FITS_CARD)
+    {
+        const char *card = p + pos;
+
+        char key[9];
+        memcpy(key, card, 8);
+        key[8] = 0;
+        for (int i = 7; i >= 0 && key[i] == ' '; i--)
+            key[i] = 0;
+
+        if (strcmp(key, "END") == 0)
+        {
+            hdr->dataOffset = (pos / FITS_BLOCK + 1) * FITS_BLOCK;
+            return false;
+        }
+
+        // the first card must be SIMPLE
+        if (pos == 0 && strcmp(key, "SIMPLE") != 0)
+            return true;
+
+        if (card[8] != '=' || card[9] != ' ')
+            continue;   // COMMENT, HISTORY, blank
+
+        char val[FITS_CARD - 9];
+        memcpy(val, card + 10, sizeof(val) - 1);
+        val[sizeof(val) - 1] = 0;
+        char *slash = strchr(val, '/');
+        if (slash && !strchr(val, '\''))
+            *slash = 0;
+
+        if (strcmp(key, "SIMPLE") == 0)
+            hdr->simple = strchr(val, 'T') != NULL;
+        else if (strcmp(key, "BITPIX") == 0)
+            hdr->bitpix = atoi(val);
+        else if (strcmp(key, "NAXIS") == 0)
+            hdr->naxis = atoi(val);
+        else if (strcmp(key, "NAXIS1") == 0)
+            hdr->naxis1 = atol(val);
+        else if (strcmp(key, "NAXIS2") == 0)
+            hdr->naxis2 = atol(val);
+        else if (strcmp(key, "BZERO") == 0)
+            hdr->bzero = atof(val);
+        else if (strcmp(key, "BSCALE") == 0)
+            hdr->bscale = atof(val);
+        else if (strcmp(key, "EXPOSURE") == 0)
+        {
+            hdr->exposure = atof(val);
+            hdr->haveExposure = true;
+        }
+        else if (strcmp(key, "STACKCNT") == 0)
+        {
+            hdr->stackCnt = atol(val);
+            hdr->haveStackCnt = true;
+        }
+    }
+
+    return true;
+}
+
+// big-endian 16-bit FITS integers to unsigned pixels: swap the bytes, then
+// flip the sign bit (BZERO 32768)
+static void SwapUnsignedFits16(unsigned short *dst, const unsigned char *src, size_t n)
+{
+    size_t i = 0;
+
+#if defined(HAVE_SSE2_INTRINSICS)
+    if (!ImageMathReference())
+    {
+        __m128i const sign = _mm_set1_epi16((short) 0x8000);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, sign));
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = (unsigned short) (((src[2 * i] << 8) | src[2 * i + 1]) ^ 0x8000);
+}
+
+static bool LoadSimpleFits(usImage& img, const MappedFileBuffer& map)
+{
+    SimpleFitsHeader hdr;
+    if (ParseSimpleFitsHeader(map.Base(), map.Size(), &hdr))
+        return true;
+
+    if (!hdr.simple || hdr.bitpix != 16 || hdr.naxis != 2 || hdr.naxis1 <= 0 || hdr.naxis2 <= 0 ||
+        hdr.bzero != 32768.0 || hdr.bscale != 1.0)
+        return true;
+
+    size_t const npix = (size_t) hdr.naxis1 * (size_t) hdr.naxis2;
+    size_t const dataEnd = hdr.dataOffset + npix * 2;
+    size_t const padded = (dataEnd + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+
+    // anything after the padded image is an extension Load does not read
+    if (map.Size() < dataEnd || map.Size() > padded || npix > (size_t) INT_MAX)
+        return true;
+
+    if (img.Init((int) hdr.naxis1, (int) hdr.naxis2))
+        return true;
+
+    SwapUnsignedFits16(img.ImageData, reinterpret_cast<const unsigned char *>(map.Base() + hdr.dataOffset), npix);
+
+    if (hdr.haveExposure)
+        img.ImgExpDur = (int) ((float) hdr.exposure * 1000.0);
+    if (hdr.haveStackCnt)
+        img.ImgStackCnt = (int) hdr.stackCnt;
+
+    return false;
+}
+
+// Load fast path for a single uncompressed 2-D image of unsigned 16-bit
+// pixels, the format Save writes and most cameras produce: the file is
+// memory-mapped, the header parsed here and the pixels swapped straight into
+// the pooled image buffer. Returns true for any other file, which is left to
+// CFITSIO.
+static bool LoadSimpleFits(usImage& img, const wxString& fname)
+{
+    MappedFileBuffer *map = new MappedFileBuffer();
+    bool bError = map->Open(fname) || LoadSimpleFits(img, *map);
+    map->Release();
+    return bError;
+}
+
+bool usImage::Load(const wxString& fname)
+{
+    bool bError = false;
+
+    try
+    {
+        if (!wxFileExists(fname))
+        {
+            pFrame->Alert(_("File does not exist - cannot load ") + fname);
+            throw ERROR_INFO("File does not exist");
+        }
+
+        if (!LoadSimpleFits(*this, fname))
+        {
+            return false;
+        }
+
+        int status = 0;  // CFITSIO status value MUST be initialized to zero!
+        fitsfile *fptr;  // FITS file pointer
+        if (!PHD_fits_open_diskfile(&fptr, fname, READONLY, &status))
+        {
+            int hdutype;
+            if (fits_get_hdu_type(fptr, &hdutype, &status) || hdutype != IMAGE_HDU)
+            {
+                pFrame->Alert(_("FITS file is not of an image: ") + fname);
+                throw ERROR_INFO("Fits file is not an image");
+            }
+
+            // Get HDUs and size
+            int naxis = 0;
+            fits_get_img_dim(fptr, &naxis, &status);
+            int nhdus = 0;
+            fits_get_num_hdus(fptr, &nhdus, &status);
+            if (nhdus == 2 && naxis == 0)
+            {
+                // tile compressed (see WriteFits): the image is in the extension
+                fits_movabs_hdu(fptr, 2, &hdutype, &status);
+                fits_get_img_dim(fptr, &naxis, &status);
+                nhdus = 1;
+            }
+            long fsize[3];
+            fits_get_img_size(fptr, 2, fsize, &status);
+            if ((nhdus != 1) || (naxis != 2)) {
+                pFrame->Alert(_("Unsupported type or read error loading FITS file ") + fname);
+                throw ERROR_INFO("unsupported type");
+            }
+            if (Init((int) fsize[0], (int) fsize[1]))
+            {
+                pFrame->Alert(_("Memory allocation error loading FITS file ") + fname);
+                throw ERROR_INFO("Memory Allocation failure");
+            }
+            long fpixel[3] = { 1, 1, 1 };
+            if (fits_read_pix(fptr, TUSHORT, fpixel, (int)(fsize[0] * fsize[1]), NULL, ImageData, NULL, &status)) { // Read image
+                pFrame->Alert(_("Error reading data from FITS file ") + fname);
+                throw ERROR_INFO("Error reading");
+            }
+
+            char *key = const_cast<char *>("EXPOSURE");
+            float exposure;
+            status = 0;
+            fits_read_key(fptr, TFLOAT, key, &exposure, NULL, &status);
+            if (status == 0)
+                ImgExpDur = (int) (exposure * 1000.0);
+
+            key = const_cast<char *>("STACKCNT");
+            int stackcnt;
+            status = 0;
+            fits_read_key(fptr, TINT, key, &stackcnt, NULL, &status);
+            if (status == 0)
+                ImgStackCnt = (int) stackcnt;
+
+            PHD_fits_close_file(fptr);
+        }
+        else
+        {
+            pFrame->Alert(_("Error opening FITS file ") + fname);
+            throw ERROR_INFO("error opening file");
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        bError = true;
+    }
+
+    return bError;
+}
+
+bool usImage::CopyFrom(const usImage& src)
+{
+    if (src.IsROIOnly() ? InitROI(src.Size, src.DataRect) : Init(src.Size))
+        return true;
+    memcpy(ImageData, src.ImageData, NPixels * sizeof(unsigned short));
+    return false;
+}
+
+// Rotation works backwards from each pixel of the rotated image to the point
+// it came from in the source image. The map is affine, so a row of the rotated
+// image traces a straight line through the source and the part of the line
+// that falls inside the source can be found once per row. Inside that span
+// the source position is stepped in fixed point with no per-pixel tests; only
+// the pixels within a pixel of the source edges go through RotSampleClamped.
+struct RotateJob : public ImageStripJob
+{
+    const usImage& src;
+    usImage& dst;
+    bool interpolate;
+    // source position of destination pixel (x, y) is
+    //   (sx0 + x * dsx + y * rsx, sy0 + x * dsy + y * rsy)
+    double sx0, sy0;
+    double dsx, dsy;
+    double rsx, rsy;
+
+    RotateJob(const usImage& src_, usImage& dst_, bool interpolate_)
+        : src(src_), dst(dst_), interpolate(interpolate_) { }
+
+    void ProcessRows(int strip, int rowBegin, int rowEnd);
+};
+
+// narrow [*a, *b) to the x for which lo <= p + x * dp < hi, give or take rounding
+inline static void RotClipSpan(double p, double dp, double lo, double hi, int *a, int *b)
+{
+    if (dp == 0.0)
+    {
+        if (p < lo || p >= hi)
+            *b = *a;
+        return;
+    }
+
+    double t0 = (lo - p) / dp;
+    double t1 = (hi - p) / dp;
+    if (dp < 0.0)
+        std::swap(t0, t1);
+
+    double fa = ceil(t0);
+    double fb = ceil(t1);
+    if (fa > *a)
+        *a = fa < *b ? (int) fa : *b;
+    if (fb < *b)
+        *b = fb > *a ? (int) fb : *a;
+}
+
+inline static int clampi(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+static unsigned short RotSampleClamped(const usImage& img, double sx, double sy, bool interpolate)
+{
+    int const w = img.Size.GetWidth();
+    int const h = img.Size.GetHeight();
+
+    if (!interpolate)
+        return img.Pixel(clampi((int) floor(sx + 0.5), 0, w - 1), clampi((int) floor(sy + 0.5), 0, h - 1));
+
+    double fx = floor(sx);
+    double fy = floor(sy);
+    double ax = sx - fx;
+    double ay = sy - fy;
+    int x0 = clampi((int) fx, 0, w - 1);
+    int x1 = clampi((int) fx + 1, 0, w - 1);
+    int y0 = clampi((int) fy, 0, h - 1);
+    int y1 = clampi((int) fy + 1, 0, h - 1);
+
+    double top = img.Pixel(x0, y0) * (1.0 - ax) + img.Pixel(x1, y0) * ax;
+    double bot = img.Pixel(x0, y1) * (1.0 - ax) + img.Pixel(x1, y1) * ax;
+    return (unsigned short)(top * (1.0 - ay) + bot * ay + 0.5);
+}
+
+void RotateJob::ProcessRows(int strip, int rowBegin, int rowEnd)
+{
+    enum { FRAC_BITS = 32, WEIGHT_BITS = 16 };
+    static const double ONE = (double)(1LL << FRAC_BITS);
+
+    int const sw = src.Size.GetWidth();
+    int const sh = src.Size.GetHeight();
+    int const dw = dst.Size.GetWidth();
+    const unsigned short *const s = src.ImageData;
+
+    long long const stepx = (long long) floor(dsx * ONE + 0.5);
+    long long const stepy = (long long) floor(dsy * ONE + 0.5);
+
+    for (int y = rowBegin; y < rowEnd; y++)
+    {
+        double const px = sx0 + y * rsx;
+        double const py = sy0 + y * rsy;
+        unsigned short *const d = dst.ImageData + (size_t) y * dw;
+
+        // pixels whose nearest source pixel is in the source image
+        int xa = 0, xb = dw;
+        RotClipSpan(px, dsx, -0.5, sw - 0.5, &xa, &xb);
+        RotClipSpan(py, dsy, -0.5, sh - 0.5, &xa, &xb);
+
+        // pixels whose samples all lie inside the source image, less one pixel
+        // at each end to absorb rounding
+        int ia = xa, ib = xb;
+        if (interpolate)
+        {
+            RotClipSpan(px, dsx, 0.0, sw - 1.0, &ia, &ib);
+            RotClipSpan(py, dsy, 0.0, sh - 1.0, &ia, &ib);
+        }
+        if (ib - ia > 2)
+        {
+            ++ia;
+            --ib;
+        }
+        else
+            ia = ib = xa;
+
+        int x = 0;
+        for (; x < xa; x++)
+            d[x] = 0;
+        for (; x < ia; x++)
+            d[x] = RotSampleClamped(src, px + x * dsx, py + x * dsy, interpolate);
+
+        long long fx = (long long) floor((px + ia * dsx) * ONE + 0.5);
+        long long fy = (long long) floor((py + ia * dsy) * ONE + 0.5);
+
+        if (interpolate)
+        {
+            for (; x < ib; x++, fx += stepx, fy += stepy)
+            {
+                unsigned int const wx = (unsigned int)(fx >> (FRAC_BITS - WEIGHT_BITS)) & 0xffff;
+                unsigned int const wy = (unsigned int)(fy >> (FRAC_BITS - WEIGHT_BITS)) & 0xffff;
+                const unsigned short *p = s + (size_t)(fy >> FRAC_BITS) * sw + (int)(fx >> FRAC_BITS);
+                // 16 bit pixels times 16 bit weights, the vertical pass needs 48 bits
+                unsigned int const top = p[0] * (65536U - wx) + p[1] * wx;
+                unsigned int const bot = p[sw] * (65536U - wx) + p[sw + 1] * wx;
+                unsigned long long const v = (unsigned long long) top * (65536U - wy) + (unsigned long long) bot * wy;
+                d[x] = (unsigned short)((v + (1ULL << 31)) >> 32);
+            }
+        }
+        else
+        {
+            long long const half = 1LL << (FRAC_BITS - 1);
+            for (; x < ib; x++, fx += stepx, fy += stepy)
+                d[x] = s[(size_t)((fy + half) >> FRAC_BITS) * sw + (int)((fx + half) >> FRAC_BITS)];
+        }
+
+        for (; x < xb; x++)
+            d[x] = RotSampleClamped(src, px + x * dsx, py + x * dsy, interpolate);
+        for (; x < dw; x++)
+            d[x] = 0;
+    }
+}
+
+// Rotate the image by theta radians about its origin, counter-clockwise as
+// displayed, after flipping it top to bottom if mirror is set. The rotated
+// image is sized to hold the whole source and uncovered pixels are set to 0.
+bool usImage::Rotate(double theta, bool mirror, bool interpolate)
+{
+    if (!ImageData || NPixels == 0 || ExpandToFullFrame())
+        return true;
+
+    int const w = Size.GetWidth();
+    int const h = Size.GetHeight();
+
+    double c = cos(theta);
+    double s = sin(theta);
+
+    // make quarter turns exact so that they reduce to pixel copies
+    static const double EPS = 1e-12;
+    if (fabs(c) < EPS) c = 0.0;
+    if (fabs(s) < EPS) s = 0.0;
+    if (fabs(fabs(c) - 1.0) < EPS) c = c > 0.0 ? 1.0 : -1.0;
+    if (fabs(fabs(s) - 1.0) < EPS) s = s > 0.0 ? 1.0 : -1.0;
+
+    // destination (X, Y) comes from source (X c - Y s, X s + Y c); the
+    // source pixel centers map to X = sx c + sy s, Y = sy c - sx s
+    double const cx[4] = { 0.0, w - 1.0, 0.0, w - 1.0 };
+    double const cy[4] = { 0.0, 0.0, h - 1.0, h - 1.0 };
+    double minX = 0.0, maxX = 0.0, minY = 0.0, maxY = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        double X = cx[i] * c + cy[i] * s;
+        double Y = cy[i] * c - cx[i] * s;
+        if (i == 0 || X < minX) minX = X;
+        if (i == 0 || X > maxX) maxX = X;
+        if (i == 0 || Y < minY) minY = Y;
+        if (i == 0 || Y > maxY) maxY = Y;
+    }
+    static const double SIZE_EPS = 1e-6;
+    int const x0 = (int) floor(minX + SIZE_EPS);
+    int const y0 = (int) floor(minY + SIZE_EPS);
+    int const dw = (int) ceil(maxX - SIZE_EPS) - x0 + 1;
+    int const dh = (int) ceil(maxY - SIZE_EPS) - y0 + 1;
+
+    usImage rotated;
+    if (rotated.Init(dw, dh))
+        return true;
+
+    RotateJob job(*this, rotated, interpolate);
+    job.dsx = c;
+    job.rsx = -s;
+    job.sx0 = x0 * c - y0 * s;
+    job.dsy = s;
+    job.rsy = c;
+    job.sy0 = x0 * s + y0 * c;
+    if (mirror)
+    {
+        job.sy0 = (h - 1) - job.sy0;
+        job.dsy = -job.dsy;
+        job.rsy = -job.rsy;
+    }
+
+    RunImageStrips(job, ImageStripCount(dh, 64), dh);
+
+    // take over the rotated pixels, the old buffer goes with the temporary image
+    SwapImageData(rotated);
+    Size = rotated.Size;
+    Subframe = wxRect(0, 0, 0, 0);
+    LazyROI = wxRect(0, 0, 0, 0);
+    Min = Max = FiltMin = FiltMax = 0;
+
+    return false;
+}
+
+bool usImage::CopyFromImage(const wxImage& img)
+{
+    Init(img.GetSize());
+
+    const unsigned char *pSrc = img.GetData();
+    unsigned short *pDest = ImageData;
+
+    for (int i = 0; i < NPixels; i++)
+    {
+        *pDest++ = ((unsigned short) *pSrc) << 8;
+        pSrc += 3;
+    }
+
+    return false;
+}
@@ -1,89 +1,188 @@
-/*
- *  usImage.h
- *  PHD Guiding
- *
- *  Created by Craig Stark on 9/20/08.
- *  Copyright (c) 2006-2009 Craig Stark.
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#ifndef USIMAGECLASS
-#define USIMAGECLASS
-
-class usImage
-{
-public:
-    unsigned short      *ImageData;     // Pointer to raw data
-    wxSize              Size;               // Dimensions of image
-    wxRect              Subframe;       // were the valid data is
-    int                 NPixels;
-    int                 Min;
-    int                 Max;
-    int                 FiltMin, FiltMax;
-    time_t              ImgStartTime;
-    int                 ImgExpDur;
-    int                 ImgStackCnt;
-    wxByte              BitsPerPixel;
-    unsigned short      Pedestal;
-
-    usImage() {
-        Min = Max = FiltMin = FiltMax = 0;
-        NPixels = 0;
-        ImageData = NULL;
-        ImgStartTime = 0;
-        ImgExpDur = 0;
-        ImgStackCnt = 1;
-        BitsPerPixel = 0;
-        Pedestal = 0;
-    }
-    ~usImage() { delete[] ImageData; }
-
-    bool                Init(const wxSize& size);
-    bool                Init(int width, int height) { return Init(wxSize(width, height)); }
-    void                SwapImageData(usImage& other);
-    void                CalcStats();
-    void                InitImgStartTime();
-    wxString            GetImgStartTime() const;
-    bool                CopyFrom(const usImage& src);
-    bool                CopyToImage(wxImage **img, int blevel, int wlevel, double power);
-    bool                BinnedCopyToImage(wxImage **img, int blevel, int wlevel, double power); // Does 2x2 bin during copy
-    bool                CopyFromImage(const wxImage& img);
-    bool                Load(const wxString& fname);
-    bool                Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
-    bool                Rotate(double theta, bool mirror=false);
-    unsigned short&     Pixel(int x, int y) { return ImageData[y * Size.x + x]; }
-    const unsigned short& Pixel(int x, int y) const { return ImageData[y * Size.x + x]; }
-    void                Clear(void);
-};
-
-inline void usImage::Clear(void)
-{
-    memset(ImageData, 0, NPixels * sizeof(unsigned short));
-}
-
-#endif
+/*
+ *  usImage.h
+ *  PHD Guiding
+ *
+ *  Created by Craig Stark on 9/20/08.
+ *  Copyright (c) 2006-2009 Craig Stark.
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef USIMAGECLASS
+#define USIMAGECLASS
+
+class FITSHeader;
+
+// Size-keyed pool of aligned pixel buffers. Frames are allocated in the camera
+// worker thread and released in the main thread once the next frame has been
+// displayed, so recycling the buffers avoids a full-frame heap allocation per
+// guide cycle.
+class ImageBufferPool
+{
+public:
+    enum { ALIGNMENT = 64 };
+
+    static unsigned short *Alloc(unsigned int npixels);
+    static void Free(unsigned short *buf);
+    static void Clear(void);  // release all cached buffers
+};
+
+// Frees images on a thread of its own, then clears the ImageBufferPool. It
+// is used at shutdown, once the UI has closed, for the dark library; Finish
+// waits for it to be done.
+class ImageRelease
+{
+public:
+    static void Start(std::vector<usImage *>& images);  // takes the images, leaving the vector empty
+    static void Finish(void);
+};
+
+// Reference-counted owner of pixel memory that does not come from the
+// ImageBufferPool, e.g. a memory-mapped dark library cache
+class ImageBufferOwner
+{
+    wxAtomicInt m_refcnt;
+
+protected:
+    virtual ~ImageBufferOwner() { }
+
+public:
+    ImageBufferOwner() : m_refcnt(1) { }
+    void AddRef() { wxAtomicInc(m_refcnt); }
+    void Release() { if (wxAtomicDec(m_refcnt) == 0) delete this; }
+};
+
+class usImage
+{
+public:
+    unsigned short      *ImageData;     // Pointer to raw data
+    wxSize              Size;               // Dimensions of image
+    wxRect              Subframe;       // were the valid data is
+    wxRect              DataRect;       // the part of the frame held in ImageData: all of it, or just the subframe after InitROI
+    int                 NPixels;        // pixels held in ImageData
+    int                 Min;
+    int                 Max;
+    int                 FiltMin, FiltMax;
+    time_t              ImgStartTime;
+    wxLongLong_t        ExposureStartUs;    // exposure start and end, UTC microseconds on this computer's clock, 0 = unknown
+    wxLongLong_t        ExposureEndUs;
+    bool                ExposureTimed;      // the driver timed the exposure, the times are not estimated from the request
+    int                 ImgExpDur;
+    int                 ImgStackCnt;
+    wxByte              BitsPerPixel;
+    unsigned short      Pedestal;
+    ImageBufferOwner   *BufferOwner;    // owner of ImageData if it was not allocated from the pool
+    wxRect              LazyROI;        // if not empty, only this region has been calibrated and filtered, see WorkerThread::CompleteLazyROI
+    bool                LazyDark;       // dark subtraction was limited to LazyROI
+
+    usImage() {
+        Min = Max = FiltMin = FiltMax = 0;
+        NPixels = 0;
+        ImageData = NULL;
+        ImgStartTime = 0;
+        ExposureStartUs = ExposureEndUs = 0;
+        ExposureTimed = false;
+        ImgExpDur = 0;
+        ImgStackCnt = 1;
+        BitsPerPixel = 0;
+        Pedestal = 0;
+        BufferOwner = NULL;
+        LazyDark = false;
+    }
+    ~usImage() { FreeImageData(); }
+
+    bool                Init(const wxSize& size);
+    // hold only the pixels of roi, which becomes the subframe, so memory and
+    // bandwidth scale with the subframe instead of the sensor
+    bool                InitROI(const wxSize& size, const wxRect& roi);
+    bool                IsROIOnly() const { return DataRect.GetSize() != Size; }
+    // give an ROI-only image a full frame buffer, zero outside the subframe
+    bool                ExpandToFullFrame(void);
+    // the image itself, or a full frame copy of its pixels in scratch if it
+    // is ROI-only; NULL if the copy could not be made
+    const usImage      *FullFrame(usImage *scratch) const;
+    void                AttachImageData(unsigned short *data, const wxSize& size, ImageBufferOwner *owner);
+    bool                Init(int width, int height) { return Init(wxSize(width, height)); }
+    void                SwapImageData(usImage& other);  // the buffers with their DataRect and NPixels
+    void                CalcStats();
+    void                CalcStats(const wxRect& rect);  // stats for a region of the image only
+    // display stretch black and white points from a sample of the valid pixels
+    void                CalcDisplayLevels(int *blevel, int *wlevel) const;
+    void                InitImgStartTime();
+    wxString            GetImgStartTime() const;
+    // for drivers that know when the exposure really started and ended
+    void                SetExposureTimes(wxLongLong_t startUs, wxLongLong_t endUs);
+    bool                GetExposureMidTime(wxLongLong_t *us) const;
+    bool                CopyFrom(const usImage& src);
+    bool                CopyToImage(wxImage **img, int blevel, int wlevel, double power);
+    // reduce to width x height (no larger than the image) while stretching; peak keeps the brightest pixel of each box
+    bool                CopyToImageScaled(wxImage **img, int width, int height, int blevel, int wlevel, double power, bool peak) const;
+    bool                BinnedCopyToImage(wxImage **img, int blevel, int wlevel, double power); // Does 2x2 bin during copy
+    bool                CopyFromImage(const wxImage& img);
+    bool                Load(const wxString& fname);
+    bool                Save(const wxString& fname, const wxString& hdrComment = wxEmptyString) const;
+    // the two halves of Save(), for writing on another thread (see FitsWriter)
+    void                GetFitsHeader(FITSHeader *hdr, const wxString& hdrComment) const;
+    bool                WriteFits(const wxString& fname, const FITSHeader& hdr, bool compress) const;
+    bool                Rotate(double theta, bool mirror=false, bool interpolate=true);
+    // (x, y) must be inside DataRect
+    unsigned short&     Pixel(int x, int y) { return ImageData[(y - DataRect.y) * DataRect.width + (x - DataRect.x)]; }
+    const unsigned short& Pixel(int x, int y) const { return ImageData[(y - DataRect.y) * DataRect.width + (x - DataRect.x)]; }
+    void                Clear(void);
+
+private:
+    bool                InitData(const wxSize& size, const wxRect& data);
+    void                FreeImageData(void);
+};
+
+inline void usImage::Clear(void)
+{
+    memset(ImageData, 0, NPixels * sizeof(unsigned short));
+}
+
+// Successive 2x2 reductions of a frame, each half the size of the one before,
+// so that showing the frame reduced only reads the pixels of the smallest
+// level at least the size of the display. Levels are built when they are
+// first asked for and kept until Invalidate; their buffers are reused for
+// the next frame.
+class ImagePyramid
+{
+    std::vector<usImage *> m_levels;    // m_levels[i] is reduced by 2^(i+1)
+    unsigned int m_built;               // levels valid for the current frame
+    bool m_peak;                        // levels keep the brightest pixel rather than the mean
+    usImage m_full;                     // full frame copy of an ROI-only frame
+
+public:
+    ImagePyramid() : m_built(0), m_peak(false) { }
+    ~ImagePyramid();
+
+    void Invalidate(void) { m_built = 0; }
+    // the smallest level of frame at least width x height, or frame itself
+    const usImage& Level(const usImage& frame, int width, int height, bool peak);
+};
+
+#endif
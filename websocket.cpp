@@ -0,0 +1,381 @@
+/*
+ *  websocket.cpp
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+#include <wx/base64.h>
+#include <wx/mstream.h>
+#include <wx/tokenzr.h>
+#include <wx/zstream.h>
+
+enum
+{
+    MAX_REQUEST_SIZE = 8192,
+    MIN_DEFLATE_SIZE = 128,     // shorter messages are sent as they are
+};
+
+static const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// SHA-1 (FIPS 180-4), needed only for Sec-WebSocket-Accept
+static void sha1(const unsigned char *msg, size_t len, unsigned char digest[20])
+{
+    wxUint32 h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+    std::vector<unsigned char> m(msg, msg + len);
+    m.push_back(0x80);
+    while (m.size() % 64 != 56)
+        m.push_back(0);
+    unsigned long long bits = (unsigned long long) len * 8;
+    for (int i = 7; i >= 0; i--)
+        m.push_back((unsigned char)(bits >> (i * 8)));
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+    for (size_t blk = 0; blk < m.size(); blk += 64)
+    {
+        wxUint32 w[80];
+        for (int i = 0; i < 16; i++)
+        {
+            const unsigned char *p = &m[blk + i * 4];
+            w[i] = ((wxUint32) p[0] << 24) | ((wxUint32) p[1] << 16) | ((wxUint32) p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++)
+            w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        wxUint32 a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            wxUint32 f, k;
+            if (i < 20)      { f = (b & c) | (~b & d); k = 0x5a827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ed9eba1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+            else             { f = b ^ c ^ d; k = 0xca62c1d6; }
+            wxUint32 t = ROL(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = ROL(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+#undef ROL
+
+    for (int i = 0; i < 5; i++)
+    {
+        digest[i * 4] = (unsigned char)(h[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(h[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(h[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char) h[i];
+    }
+}
+
+static wxCharBuffer make_buf(const std::string& s)
+{
+    wxCharBuffer buf(s.size());
+    memcpy(buf.data(), s.data(), s.size());
+    return buf;
+}
+
+size_t WebSocket::RequestSize(const char *buf, size_t len)
+{
+    for (size_t i = 3; i < len; i++)
+    {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r')
+            return i + 1;
+    }
+    return 0;
+}
+
+// true if the comma separated header value has the token, ignoring case
+static bool has_token(const wxString& value, const char *token)
+{
+    wxStringTokenizer tok(value, ",");
+    while (tok.HasMoreTokens())
+    {
+        if (tok.GetNextToken().Strip(wxString::both).CmpNoCase(token) == 0)
+            return true;
+    }
+    return false;
+}
+
+// We deflate with the full 32K window, so an offer that limits the server's
+// window is declined and the connection runs uncompressed.
+static bool accept_deflate(const wxString& extensions)
+{
+    wxStringTokenizer offers(extensions, ",");
+    while (offers.HasMoreTokens())
+    {
+        wxArrayString params = wxSplit(offers.GetNextToken(), ';', 0);
+        if (params.empty() || params[0].Strip(wxString::both).CmpNoCase("permessage-deflate") != 0)
+            continue;
+
+        bool ok = true;
+        for (size_t i = 1; i < params.size(); i++)
+        {
+            if (params[i].Strip(wxString::both).BeforeFirst('=').Strip(wxString::both).CmpNoCase("server_max_window_bits") == 0)
+                ok = false;
+        }
+        if (ok)
+            return true;
+    }
+    return false;
+}
+
+bool WebSocket::ParseHandshake(const char *req, size_t len, Handshake *hs)
+{
+    wxString text = wxString::FromUTF8(req, len);
+    wxArrayString lines = wxSplit(text, '\n', 0);
+    if (lines.empty())
+        return true;
+
+    // GET <target> HTTP/1.1
+    wxArrayString reqline = wxStringTokenize(lines[0].Strip(wxString::both), " ", wxTOKEN_STRTOK);
+    if (reqline.size() != 3 || reqline[0] != "GET" || !reqline[2].StartsWith("HTTP/1."))
+        return true;
+
+    hs->path = reqline[1].BeforeFirst('?');
+    hs->query = reqline[1].AfterFirst('?');
+    hs->key.clear();
+    hs->deflate = false;
+
+    bool upgrade = false, connection = false, version = false;
+    wxString extensions;
+
+    for (size_t i = 1; i < lines.size(); i++)
+    {
+        wxString line = lines[i].Strip(wxString::both);
+        if (line.empty())
+            break;
+        wxString name = line.BeforeFirst(':').Strip(wxString::both);
+        wxString value = line.AfterFirst(':').Strip(wxString::both);
+
+        if (name.CmpNoCase("Upgrade") == 0)
+            upgrade = has_token(value, "websocket");
+        else if (name.CmpNoCase("Connection") == 0)
+            connection = has_token(value, "upgrade");
+        else if (name.CmpNoCase("Sec-WebSocket-Version") == 0)
+            version = value == "13";
+        else if (name.CmpNoCase("Sec-WebSocket-Key") == 0)
+            hs->key = value;
+        else if (name.CmpNoCase("Sec-WebSocket-Extensions") == 0)
+        {
+            if (!extensions.empty())
+                extensions += ",";
+            extensions += value;
+        }
+    }
+
+    if (!upgrade || !connection || !version || hs->key.empty())
+        return true;
+
+    hs->deflate = accept_deflate(extensions);
+
+    return false;
+}
+
+wxCharBuffer WebSocket::HandshakeResponse(const Handshake& hs)
+{
+    std::string keyguid = std::string(hs.key.ToAscii()) + WS_GUID;
+    unsigned char digest[20];
+    sha1((const unsigned char *) keyguid.data(), keyguid.size(), digest);
+
+    std::string resp = "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: ";
+    resp += wxBase64Encode(digest, sizeof(digest)).ToAscii();
+    resp += "\r\n";
+    if (hs.deflate)
+        resp += "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover\r\n";
+    resp += "\r\n";
+
+    return make_buf(resp);
+}
+
+wxCharBuffer WebSocket::ErrorResponse(const char *status)
+{
+    std::string resp = std::string("HTTP/1.1 ") + status + "\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    return make_buf(resp);
+}
+
+int WebSocket::ParseFrame(const char *buf, size_t len, size_t maxPayload, FrameHeader *hdr)
+{
+    const unsigned char *p = (const unsigned char *) buf;
+
+    if (len < 2)
+        return 0;
+
+    hdr->fin = (p[0] & 0x80) != 0;
+    hdr->compressed = (p[0] & 0x40) != 0;
+    hdr->opcode = p[0] & 0x0f;
+    hdr->masked = (p[1] & 0x80) != 0;
+
+    if (p[0] & 0x30)
+        return -1;              // RSV2, RSV3: no extension defines them
+
+    unsigned long long size = p[1] & 0x7f;
+    size_t pos = 2;
+
+    if (size == 126)
+    {
+        if (len < 4)
+            return 0;
+        size = ((unsigned int) p[2] << 8) | p[3];
+        pos = 4;
+    }
+    else if (size == 127)
+    {
+        if (len < 10)
+            return 0;
+        size = 0;
+        for (int i = 0; i < 8; i++)
+            size = (size << 8) | p[2 + i];
+        pos = 10;
+    }
+
+    // control frames are short and never fragmented
+    if ((hdr->opcode & 0x8) && (!hdr->fin || size > 125))
+        return -1;
+
+    if (size > maxPayload)
+        return -1;
+
+    if (hdr->masked)
+    {
+        if (len < pos + 4)
+            return 0;
+        memcpy(hdr->mask, p + pos, 4);
+        pos += 4;
+    }
+
+    hdr->headerSize = pos;
+    hdr->payloadSize = (size_t) size;
+
+    return len >= pos + hdr->payloadSize ? 1 : 0;
+}
+
+void WebSocket::Unmask(char *payload, size_t len, const unsigned char mask[4])
+{
+    for (size_t i = 0; i < len; i++)
+        payload[i] ^= mask[i & 3];
+}
+
+// raw deflate of one message, ending with an empty stored block (the
+// 00 00 ff ff of a sync flush), which permessage-deflate leaves off
+static bool deflate_message(const char *data, size_t len, std::vector<char> *out)
+{
+    wxMemoryOutputStream mem;
+    wxZlibOutputStream z(mem, wxZ_BEST_SPEED, wxZLIB_NO_HEADER);
+    z.Write(data, len);
+    z.Sync();
+    if (!z.IsOk())
+        return true;
+
+    size_t n = mem.GetSize();
+    if (n < 4)
+        return true;
+    out->resize(n);
+    mem.CopyTo(out->data(), n);
+    if (memcmp(out->data() + n - 4, "\x00\x00\xff\xff", 4) != 0)
+        return true;
+
+    out->resize(n - 4);
+    return false;
+}
+
+wxCharBuffer WebSocket::Frame(Opcode op, const char *data, size_t len, bool compress)
+{
+    std::vector<char> deflated;
+    bool rsv1 = false;
+    if (compress && len >= MIN_DEFLATE_SIZE && !deflate_message(data, len, &deflated) && deflated.size() < len)
+    {
+        data = deflated.data();
+        len = deflated.size();
+        rsv1 = true;
+    }
+
+    size_t hdrlen = len < 126 ? 2 : len < 65536 ? 4 : 10;
+    wxCharBuffer buf(hdrlen + len);
+    unsigned char *p = (unsigned char *) buf.data();
+
+    p[0] = (unsigned char)(0x80 | (rsv1 ? 0x40 : 0) | op);
+    if (len < 126)
+        p[1] = (unsigned char) len;
+    else if (len < 65536)
+    {
+        p[1] = 126;
+        p[2] = (unsigned char)(len >> 8);
+        p[3] = (unsigned char) len;
+    }
+    else
+    {
+        p[1] = 127;
+        unsigned long long n = len;
+        for (int i = 7; i >= 0; i--, n >>= 8)
+            p[2 + i] = (unsigned char) n;
+    }
+    memcpy(p + hdrlen, data, len);
+
+    return buf;
+}
+
+wxCharBuffer WebSocket::CloseFrame(int code)
+{
+    char payload[2] = { (char)(code >> 8), (char) code };
+    return Frame(OP_CLOSE, payload, sizeof(payload), false);
+}
+
+bool WebSocket::Inflate(const char *data, size_t len, size_t maxSize, std::string *out)
+{
+    // restore the sync flush trailer and end the stream with an empty final
+    // block, so the inflater sees a clean end rather than running out of input
+    std::vector<char> in(data, data + len);
+    static const char trailer[] = { 0x00, 0x00, (char) 0xff, (char) 0xff, 0x03, 0x00 };
+    in.insert(in.end(), trailer, trailer + sizeof(trailer));
+
+    wxMemoryInputStream mem(in.data(), in.size());
+    wxZlibInputStream z(mem, wxZLIB_NO_HEADER);
+
+    out->clear();
+    char buf[4096];
+    while (true)
+    {
+        size_t n = z.Read(buf, sizeof(buf)).LastRead();
+        if (n == 0)
+            break;
+        out->append(buf, n);
+        if (out->size() > maxSize)
+            return true;
+    }
+
+    return z.GetLastError() != wxSTREAM_EOF && z.GetLastError() != wxSTREAM_NO_ERROR;
+}
@@ -0,0 +1,110 @@
+/*
+ *  websocket.h
+ *  PHD Guiding
+ *
+ *  Copyright (c) 2026 openphdguiding.org
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of openphdguiding.org nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKET_INCLUDED
+#define WEBSOCKET_INCLUDED
+
+// The server side of the WebSocket protocol (RFC 6455) with the
+// permessage-deflate extension (RFC 7692), for the event server's browser
+// endpoint. Only what a server needs: the opening handshake, framing of
+// outgoing messages, which are never masked, and parsing of the masked
+// frames clients send.
+//
+// Compression is negotiated without context takeover in either direction,
+// so every message is deflated and inflated on its own and a client needs
+// no per-connection compressor state on our side.
+
+struct WebSocket
+{
+    enum Opcode
+    {
+        OP_CONTINUATION = 0x0,
+        OP_TEXT = 0x1,
+        OP_BINARY = 0x2,
+        OP_CLOSE = 0x8,
+        OP_PING = 0x9,
+        OP_PONG = 0xa,
+    };
+
+    enum
+    {
+        CLOSE_NORMAL = 1000,
+        CLOSE_PROTOCOL_ERROR = 1002,
+        CLOSE_TOO_BIG = 1009,
+    };
+
+    struct Handshake
+    {
+        wxString path;          // the request target up to any '?'
+        wxString query;         // after the '?', not decoded
+        wxString key;           // Sec-WebSocket-Key
+        bool deflate;           // the client offered permessage-deflate
+    };
+
+    struct FrameHeader
+    {
+        bool fin;
+        bool compressed;        // RSV1, set on the first frame of a deflated message
+        int opcode;
+        bool masked;
+        unsigned char mask[4];
+        size_t headerSize;
+        size_t payloadSize;
+    };
+
+    // size of the HTTP request at the start of buf, 0 if it is not complete yet
+    static size_t RequestSize(const char *buf, size_t len);
+
+    // parses an upgrade request; returns true on error
+    static bool ParseHandshake(const char *req, size_t len, Handshake *hs);
+
+    static wxCharBuffer HandshakeResponse(const Handshake& hs);
+    static wxCharBuffer ErrorResponse(const char *status);
+
+    // parses the header of the frame at the start of buf; returns 1 when the
+    // whole frame is in buf, 0 when more input is needed, -1 for a frame that
+    // is malformed or larger than maxPayload
+    static int ParseFrame(const char *buf, size_t len, size_t maxPayload, FrameHeader *hdr);
+
+    static void Unmask(char *payload, size_t len, const unsigned char mask[4]);
+
+    // a complete unfragmented frame holding the message, deflated if
+    // compress is set and that makes it smaller
+    static wxCharBuffer Frame(Opcode op, const char *data, size_t len, bool compress);
+    static wxCharBuffer CloseFrame(int code);
+
+    // inflates a compressed message; returns true on error
+    static bool Inflate(const char *data, size_t len, size_t maxSize, std::string *out);
+};
+
+#endif
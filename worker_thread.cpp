@@ -1,416 +1,789 @@
-/*
- *  worker_thread.cpp
- *  PHD Guiding
- *
- *  Created by Bret McKee
- *  Copyright (c) 2012 Bret McKee
- *  All rights reserved.
- *
- *  This source code is distributed under the following "BSD" license
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are met:
- *    Redistributions of source code must retain the above copyright notice,
- *     this list of conditions and the following disclaimer.
- *    Redistributions in binary form must reproduce the above copyright notice,
- *     this list of conditions and the following disclaimer in the
- *     documentation and/or other materials provided with the distribution.
- *    Neither the name of Bret McKee, Dad Dog Development,
- *     Craig Stark, Stark Labs nor the names of its
- *     contributors may be used to endorse or promote products derived from
- *     this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
- *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
- *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
- *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
- *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
- *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
- *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
- *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
- *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
- *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
- *  POSSIBILITY OF SUCH DAMAGE.
- *
- */
-
-#include "phd.h"
-
-WorkerThread::WorkerThread(MyFrame *pFrame)
-    : wxThread(wxTHREAD_JOINABLE),
-      m_interruptRequested(0),
-      m_killable(true),
-      m_skipSendExposeComplete(false)
-{
-    m_pFrame = pFrame;
-    Debug.Write("WorkerThread constructor called\n");
-}
-
-WorkerThread::~WorkerThread(void)
-{
-    Debug.Write("WorkerThread destructor called\n");
-}
-
-void WorkerThread::EnqueueMessage(const WORKER_THREAD_REQUEST& message)
-{
-    wxMessageQueueError queueError;
-
-    if (message.request == REQUEST_EXPOSE)
-    {
-        queueError = m_lowPriorityQueue.Post(message);
-    }
-    else
-    {
-        queueError = m_highPriorityQueue.Post(message);
-    }
-
-    assert(queueError == wxMSGQUEUE_NO_ERROR);
-
-    queueError = m_wakeupQueue.Post(true);
-
-    assert(queueError == wxMSGQUEUE_NO_ERROR);
-}
-
-/*************      Terminate      **************************/
-
-void WorkerThread::EnqueueWorkerThreadTerminateRequest(void)
-{
-    m_interruptRequested = INT_STOP | INT_TERMINATE;
-
-    WORKER_THREAD_REQUEST message;
-    memset(&message, 0, sizeof(message));
-
-    message.request = REQUEST_TERMINATE;
-    EnqueueMessage(message);
-}
-
-/*************      Expose      **************************/
-
-void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe)
-{
-    m_interruptRequested &= ~INT_STOP;
-
-    WORKER_THREAD_REQUEST message;
-    memset(&message, 0, sizeof(message));
-
-    Debug.Write("Enqueuing Expose request\n");
-
-    message.request                      = REQUEST_EXPOSE;
-    message.args.expose.pImage           = pImage;
-    message.args.expose.exposureDuration = exposureDuration;
-    message.args.expose.options          = exposureOptions;
-    message.args.expose.subframe         = subframe;
-    message.args.expose.pSemaphore       = 0;
-
-    EnqueueMessage(message);
-}
-
-unsigned int WorkerThread::MilliSleep(int ms, unsigned int checkInterrupts)
-{
-    enum { MAX_SLEEP = 100 };
-
-    if (ms <= MAX_SLEEP)
-    {
-        if (ms > 0)
-            wxMilliSleep(ms);
-        return WorkerThread::InterruptRequested() & checkInterrupts;
-    }
-
-    WorkerThread *thr = WorkerThread::This();
-    wxStopWatch swatch;
-
-    long elapsed = 0;
-    do {
-        wxMilliSleep(wxMin((long) ms - elapsed, (long) MAX_SLEEP));
-        unsigned int val = thr ? (thr->m_interruptRequested & checkInterrupts) : 0;
-        if (val)
-            return val;
-        elapsed = swatch.Time();
-    } while (elapsed < ms);
-
-    return 0;
-}
-
-void WorkerThread::SetSkipExposeComplete()
-{
-    Debug.Write("worker thread setting skip send exposure complete\n");
-    m_skipSendExposeComplete = true;
-}
-
-bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
-{
-    bool bError = false;
-
-    try
-    {
-        if (WorkerThread::MilliSleep(m_pFrame->GetTimeLapse(), INT_ANY))
-        {
-            throw ERROR_INFO("Time lapse interrupted");
-        }
-
-        if (pCamera->HasNonGuiCapture())
-        {
-            Debug.Write(wxString::Format("Handling exposure in thread, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
-                                         req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height));
-
-            if (GuideCamera::Capture(pCamera, req->exposureDuration, *req->pImage, req->options, req->subframe))
-            {
-                throw ERROR_INFO("Capture failed");
-            }
-        }
-        else
-        {
-            Debug.Write(wxString::Format("Handling exposure in myFrame, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
-                                         req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height));
-
-            wxSemaphore semaphore;
-            req->pSemaphore = &semaphore;
-
-            wxCommandEvent evt(REQUEST_EXPOSURE_EVENT, GetId());
-            evt.SetClientData(req);
-            wxQueueEvent(m_pFrame, evt.Clone());
-
-            // wait for the request to complete
-            req->pSemaphore->Wait();
-
-            bError = req->error;
-            req->pSemaphore = NULL;
-        }
-
-        Debug.Write("Exposure complete\n");
-
-        if (!bError)
-        {
-            switch (m_pFrame->GetNoiseReductionMethod())
-            {
-                case NR_NONE:
-                    break;
-                case NR_2x2MEAN:
-                    QuickLRecon(*req->pImage);
-                    break;
-                case NR_3x3MEDIAN:
-                    Median3(*req->pImage);
-                    break;
-            }
-
-            req->pImage->CalcStats();
-        }
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        bError = true;
-    }
-
-    return  bError;
-}
-
-void WorkerThread::SendWorkerThreadExposeComplete(usImage *pImage, bool bError)
-{
-    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE);
-    event->SetPayload<usImage *>(pImage);
-    event->SetInt(bError);
-    wxQueueEvent(m_pFrame, event);
-}
-
-/*************      Move       **************************/
-
-void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const PHD_Point& vectorEndpoint, MountMoveType moveType)
-{
-    m_interruptRequested &= ~INT_STOP;
-
-    WORKER_THREAD_REQUEST message;
-    memset(&message, 0, sizeof(message));
-
-    Debug.Write(wxString::Format("Enqueuing Move request for %s (%.2f, %.2f)\n", mount->GetMountClassName(), vectorEndpoint.X, vectorEndpoint.Y));
-
-    message.request                   = REQUEST_MOVE;
-    message.args.move.pMount          = mount;
-    message.args.move.calibrationMove = false;
-    message.args.move.vectorEndpoint  = vectorEndpoint;
-    message.args.move.moveType        = moveType;
-    message.args.move.pSemaphore      = NULL;
-
-    EnqueueMessage(message);
-}
-
-void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const GUIDE_DIRECTION direction, int duration)
-{
-    m_interruptRequested &= ~INT_STOP;
-
-    WORKER_THREAD_REQUEST message;
-    memset(&message, 0, sizeof(message));
-
-    Debug.Write(wxString::Format("Enqueuing Calibration Move request for direction %d\n", direction));
-
-    message.request                   = REQUEST_MOVE;
-    message.args.move.pMount          = mount;
-    message.args.move.calibrationMove = true;
-    message.args.move.direction       = direction;
-    message.args.move.duration        = duration;
-    message.args.move.moveType        = MOVETYPE_DIRECT;
-    message.args.move.pSemaphore      = NULL;
-
-    EnqueueMessage(message);
-}
-
-Mount::MOVE_RESULT WorkerThread::HandleMove(MOVE_REQUEST *pArgs)
-{
-    Mount::MOVE_RESULT result = Mount::MOVE_OK;
-
-    try
-    {
-        if (pArgs->pMount->HasNonGuiMove())
-        {
-            Debug.Write(wxString::Format("Handling move in thread for %s dir=%d\n",
-                    pArgs->pMount->GetMountClassName(),
-                    pArgs->direction));
-
-            if (pArgs->calibrationMove)
-            {
-                Debug.Write("calibration move\n");
-
-                result = pArgs->pMount->CalibrationMove(pArgs->direction, pArgs->duration);
-                if (result != Mount::MOVE_OK)
-                {
-                    throw ERROR_INFO("CalibrationMove failed");
-                }
-            }
-            else
-            {
-                Debug.Write(wxString::Format("endpoint = (%.2f, %.2f)\n",
-                    pArgs->vectorEndpoint.X, pArgs->vectorEndpoint.Y));
-
-                result = pArgs->pMount->Move(pArgs->vectorEndpoint, pArgs->moveType);
-                if (result != Mount::MOVE_OK)
-                {
-                    throw ERROR_INFO("Move failed");
-                }
-            }
-        }
-        else
-        {
-            // we don't have a non-gui guide function, so we send this to the
-            // main frame routine that handles guides requests
-
-            Debug.Write("Sending move to myFrame\n");
-
-            wxSemaphore semaphore;
-            pArgs->pSemaphore = &semaphore;
-
-            wxCommandEvent evt(REQUEST_MOUNT_MOVE_EVENT, GetId());
-            evt.SetClientData(pArgs);
-            wxQueueEvent(m_pFrame, evt.Clone());
-
-            // wait for the request to complete
-            pArgs->pSemaphore->Wait();
-
-            pArgs->pSemaphore = NULL;
-            result = pArgs->moveResult;
-
-            if (result != Mount::MOVE_OK)
-            {
-                throw ERROR_INFO("myFrame handled move failed");
-            }
-        }
-    }
-    catch (const wxString& Msg)
-    {
-        POSSIBLY_UNUSED(Msg);
-        if (result == Mount::MOVE_OK)
-            result = Mount::MOVE_ERROR;
-    }
-
-    Debug.Write(wxString::Format("move complete, result=%d\n", result));
-
-    return result;
-}
-
-void WorkerThread::SendWorkerThreadMoveComplete(Mount *mount, Mount::MOVE_RESULT moveResult)
-{
-    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_MOVE_COMPLETE);
-    event->SetInt(moveResult);
-    event->SetPayload<Mount *>(mount);
-    wxQueueEvent(m_pFrame, event);
-}
-
-/*
- * entry point for the background thread
- */
-wxThread::ExitCode WorkerThread::Entry()
-{
-    bool bDone = TestDestroy();
-
-    Debug.Write("WorkerThread::Entry() begins\n");
-
-#if defined(__WINDOWS__)
-    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
-    Debug.Write(wxString::Format("worker thread CoInitializeEx returns %x\n", hr));
-#endif
-
-    while (!bDone)
-    {
-        WORKER_THREAD_REQUEST message;
-        bool dummy;
-        wxMessageQueueError queueError = m_wakeupQueue.Receive(dummy);
-
-        Debug.Write("Worker thread wakes up\n");
-
-        assert(queueError == wxMSGQUEUE_NO_ERROR);
-
-        queueError = m_highPriorityQueue.ReceiveTimeout(0, message);
-
-        if (queueError == wxMSGQUEUE_TIMEOUT)
-        {
-            queueError = m_lowPriorityQueue.ReceiveTimeout(0, message);
-            assert(queueError != wxMSGQUEUE_TIMEOUT);
-        }
-
-        assert(queueError == wxMSGQUEUE_NO_ERROR);
-
-        switch(message.request)
-        {
-            bool bError;
-
-            case REQUEST_TERMINATE:
-                Debug.Write("worker thread servicing REQUEST_TERMINATE\n");
-                bDone = true;
-                break;
-
-            case REQUEST_EXPOSE:
-                Debug.Write(wxString::Format("worker thread servicing REQUEST_EXPOSE %d\n",
-                    message.args.expose.exposureDuration));
-                bError = HandleExpose(&message.args.expose);
-                if (m_skipSendExposeComplete)
-                {
-                    Debug.Write("worker thread skipping SendWorkerThreadExposeComplete\n");
-                    delete message.args.expose.pImage; // should be null though
-                    message.args.expose.pImage = 0;
-                    m_skipSendExposeComplete = false;
-                }
-                else
-                    SendWorkerThreadExposeComplete(message.args.expose.pImage, bError);
-                break;
-
-            case REQUEST_MOVE: {
-                Debug.Write(wxString::Format("worker thread servicing REQUEST_MOVE %s dir %d (%.2f, %.2f)\n",
-                    message.args.move.pMount->GetMountClassName(), message.args.move.direction,
-                    message.args.move.vectorEndpoint.X, message.args.move.vectorEndpoint.Y));
-                Mount::MOVE_RESULT moveResult = HandleMove(&message.args.move);
-                SendWorkerThreadMoveComplete(message.args.move.pMount, moveResult);
-                break;
-            }
-
-            default:
-                Debug.Write(wxString::Format("worker thread servicing unknown request %d\n", message.request));
-                break;
-        }
-
-        Debug.Write("worker thread done servicing request\n");
-        bDone |= TestDestroy();
-    }
-
-    Debug.Write("WorkerThread::Entry() ends\n");
-    Debug.Flush();
-
-    return (wxThread::ExitCode)0;
-}
+/*
+ *  worker_thread.cpp
+ *  PHD Guiding
+ *
+ *  Created by Bret McKee
+ *  Copyright (c) 2012 Bret McKee
+ *  All rights reserved.
+ *
+ *  This source code is distributed under the following "BSD" license
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *    Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *    Neither the name of Bret McKee, Dad Dog Development,
+ *     Craig Stark, Stark Labs nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "phd.h"
+
+WorkerThread::WorkerThread(MyFrame *pFrame, const char *name)
+    : wxThread(wxTHREAD_JOINABLE),
+      m_name(name),
+      m_wakeCond(m_wakeMutex),
+      m_wakePending(false),
+      m_interruptRequested(0),
+      m_killable(true),
+      m_skipSendExposeComplete(false),
+      m_moveCond(m_moveMutex),
+      m_movesEnqueued(0),
+      m_movesCompleted(0),
+      m_cadenceNext(-1),
+      m_cadenceLast(-1)
+{
+    m_pFrame = pFrame;
+    Debug.Write("WorkerThread constructor called\n");
+}
+
+WorkerThread::~WorkerThread(void)
+{
+    Debug.Write("WorkerThread destructor called\n");
+}
+
+WorkerThreadStats WorkerThread::GetStats(void)
+{
+    wxCriticalSectionLocker lock(m_statsLock);
+    return m_stats;
+}
+
+void WorkerThread::ResetStats(void)
+{
+    wxCriticalSectionLocker lock(m_statsLock);
+    m_stats = WorkerThreadStats();
+}
+
+static wxString LatencyStr(const WorkerThreadLatency& lat)
+{
+    return wxString::Format("n=%u last=%.0f mean=%.1f max=%.0f", lat.count, lat.lastMs, lat.MeanMs(), lat.maxMs);
+}
+
+void WorkerThread::LogStats(const wxString& name)
+{
+    WorkerThreadStats stats = GetStats();
+
+    if (stats.exposeService.count)
+    {
+        Debug.Write(wxString::Format("%s thread expose latency (ms): queue %s, handoff %s, service %s\n", name,
+            LatencyStr(stats.exposeQueue), LatencyStr(stats.exposeHandoff), LatencyStr(stats.exposeService)));
+    }
+    if (stats.moveService.count)
+    {
+        Debug.Write(wxString::Format("%s thread move latency (ms): queue %s, service %s\n", name,
+            LatencyStr(stats.moveQueue), LatencyStr(stats.moveService)));
+    }
+    if (stats.cadenceJitter.count || stats.cadenceOverrun.count)
+    {
+        Debug.Write(wxString::Format("%s thread cadence (ms): jitter %s, overruns %s\n", name,
+            LatencyStr(stats.cadenceJitter), LatencyStr(stats.cadenceOverrun)));
+    }
+}
+
+template<typename T, unsigned int N>
+void WorkerThread::EnqueueRequest(RequestRing<QUEUED_REQUEST<T>, N>& ring, const T& args)
+{
+    QUEUED_REQUEST<T> entry;
+    entry.args = args;
+    entry.enqueueTime = PerfTrace::Now();
+
+    if (!ring.Push(entry))
+    {
+        // not expected, see the ring sizes; wait for the thread to catch up
+        Debug.Write(wxString::Format("%s thread request ring full, waiting\n", m_name));
+        while (!ring.Push(entry))
+            wxMilliSleep(1);
+    }
+
+    wxSemaError err = m_requestSem.Post();
+    assert(err == wxSEMA_NO_ERROR);
+    POSSIBLY_UNUSED(err);
+}
+
+/*************      Terminate      **************************/
+
+void WorkerThread::RequestInterrupt(unsigned int interrupts)
+{
+    { // lock scope
+        wxMutexLocker lck(m_wakeMutex);
+        m_interruptRequested |= interrupts;
+    } // lock scope
+
+    // the thread may be sleeping in MilliSleep or WaitForWake
+    m_wakeCond.Broadcast();
+}
+
+void WorkerThread::EnqueueWorkerThreadTerminateRequest(void)
+{
+    RequestInterrupt(INT_STOP | INT_TERMINATE);
+
+    EnqueueRequest(m_controlRing, CONTROL_TERMINATE);
+}
+
+void WorkerThread::EnqueueWorkerThreadStopStreamRequest(void)
+{
+    Debug.Write("Enqueuing Stop Stream request\n");
+
+    EnqueueRequest(m_controlRing, CONTROL_STOP_STREAM);
+}
+
+/*************      Expose      **************************/
+
+void WorkerThread::EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe,
+    WorkerThread *moveThread, int settleMs)
+{
+    m_interruptRequested &= ~INT_STOP;
+
+    EXPOSE_REQUEST req;
+
+    Debug.Write("Enqueuing Expose request\n");
+
+    req.pImage           = pImage;
+    req.exposureDuration = exposureDuration;
+    req.options          = exposureOptions;
+    req.subframe         = subframe;
+    req.error            = false;
+    req.pSemaphore       = 0;
+    req.pMoveThread      = moveThread;
+    req.moveBarrier      = moveThread ? moveThread->MovesEnqueued() : 0;
+    req.settleMs         = moveThread ? settleMs : 0;
+
+    EnqueueRequest(m_exposeRing, req);
+}
+
+// Sleep on the wakeup condition until the deadline, in microseconds on the
+// monotonic PerfTrace::Now() clock, has passed, one of checkInterrupts is
+// requested, or, if wake is true, Wake() is called. The condition wait only
+// has millisecond resolution and may return early, so the remaining time is
+// rounded up and the wait repeated until the deadline has really passed; a
+// change of the wall clock does not shorten or stretch the sleep.
+unsigned int WorkerThread::WaitEvent(long long deadline, unsigned int checkInterrupts, bool wake)
+{
+    wxMutexLocker lck(m_wakeMutex);
+
+    while (true)
+    {
+        unsigned int val = m_interruptRequested & checkInterrupts;
+        if (val)
+            return val;
+        if (wake && m_wakePending)
+        {
+            m_wakePending = false;
+            return 0;
+        }
+        long long const remaining = deadline - PerfTrace::Now();
+        if (remaining <= 0)
+            return 0;
+        m_wakeCond.WaitTimeout((unsigned long) ((remaining + 999) / 1000));
+    }
+}
+
+unsigned int WorkerThread::MilliSleep(int ms, unsigned int checkInterrupts)
+{
+    WorkerThread *thr = WorkerThread::This();
+
+    if (!thr)
+    {
+        if (ms > 0)
+            wxMilliSleep(ms);
+        return 0;
+    }
+
+    return thr->WaitEvent(PerfTrace::Now() + (long long) ms * 1000, checkInterrupts, false);
+}
+
+void WorkerThread::Wake(void)
+{
+    { // lock scope
+        wxMutexLocker lck(m_wakeMutex);
+        m_wakePending = true;
+    } // lock scope
+
+    m_wakeCond.Broadcast();
+}
+
+void WorkerThread::ClearWake(void)
+{
+    wxMutexLocker lck(m_wakeMutex);
+    m_wakePending = false;
+}
+
+unsigned int WorkerThread::WaitForWake(int ms, unsigned int checkInterrupts)
+{
+    enum { POLL_INTERVAL_MS = 5 };
+
+    WorkerThread *thr = WorkerThread::This();
+
+    if (!thr)
+    {
+        // nothing can wake other threads, the caller checks again after a
+        // short sleep
+        if (ms > 0)
+            wxMilliSleep(wxMin(ms, (int) POLL_INTERVAL_MS));
+        return 0;
+    }
+
+    return thr->WaitEvent(PerfTrace::Now() + (long long) ms * 1000, checkInterrupts, true);
+}
+
+void WorkerThread::SetSkipExposeComplete()
+{
+    Debug.Write("worker thread setting skip send exposure complete\n");
+    m_skipSendExposeComplete = true;
+}
+
+// noise reduction for the pixels of the frame inside rect only
+static void ReduceNoise(usImage& img, const wxRect& rect)
+{
+    switch (pFrame->GetNoiseReductionMethod())
+    {
+        case NR_NONE:
+            break;
+        case NR_2x2MEAN:
+            QuickLRecon(img, rect);
+            break;
+        case NR_3x3MEDIAN:
+            Median3(img, rect);
+            break;
+    }
+}
+
+// Calibrate and filter the part of a lazy ROI frame outside its ROI, so the
+// frame can be displayed, saved or searched in full. Called from the main
+// thread when a frame is needed in full; frames that were processed in full
+// are left alone. Filtering is done a band at a time, so the pixels right at
+// the edge of the ROI see the ROI's already filtered neighbors.
+void WorkerThread::CompleteLazyROI(usImage& img)
+{
+    if (img.LazyROI.IsEmpty() || !img.ImageData)
+        return;
+
+    wxRect const roi(img.LazyROI);
+    int const width = img.Size.GetWidth();
+    int const height = img.Size.GetHeight();
+
+    Debug.Write(wxString::Format("CompleteLazyROI (%d,%d,%d,%d)\n", roi.x, roi.y, roi.width, roi.height));
+
+    // the frame outside the ROI: full-width bands above and below it, and
+    // the parts of its rows to the left and right of it
+    wxRect bands[4] = {
+        wxRect(0, 0, width, roi.GetTop()),
+        wxRect(0, roi.GetBottom() + 1, width, height - roi.GetBottom() - 1),
+        wxRect(0, roi.GetTop(), roi.GetLeft(), roi.GetHeight()),
+        wxRect(roi.GetRight() + 1, roi.GetTop(), width - roi.GetRight() - 1, roi.GetHeight()),
+    };
+
+    if (img.LazyDark && pCamera)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            if (bands[i].IsEmpty())
+                continue;
+            img.Subframe = bands[i];
+            pCamera->SubtractDark(img);
+        }
+        img.Subframe = wxRect(0, 0, 0, 0);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (!bands[i].IsEmpty())
+            ReduceNoise(img, bands[i]);
+    }
+
+    img.LazyROI = wxRect(0, 0, 0, 0);
+    img.LazyDark = false;
+    img.CalcStats();
+}
+
+// Sleep until the next slot of a fixed cadence schedule. The slots are
+// absolute times on a monotonic clock, so the time spent downloading and
+// processing a frame comes out of the wait instead of adding to the period.
+// An exposure that misses its slot starts at once and the schedule restarts
+// from it; so does the first exposure after a gap of more than a few periods,
+// which is looping having been stopped rather than an overrun.
+unsigned int WorkerThread::WaitForCadence(int cadence)
+{
+    long long const period = (long long) cadence * 1000;
+    long long now = PerfTrace::Now();
+
+    // allow for the scheduling latency of the wakeup
+    static const int Slack = 1000;
+
+    bool restart = m_cadenceNext < 0 || now - m_cadenceNext > period * 3 + 5000000;
+
+    if (restart)
+    {
+        m_cadenceNext = now;
+    }
+    else if (now > m_cadenceNext + Slack)
+    {
+        double const lateMs = (double) (now - m_cadenceNext) / 1000.0;
+        Debug.Write(wxString::Format("Cadence: exposure %.0f ms late, restarting the schedule\n", lateMs));
+        {
+            wxCriticalSectionLocker lock(m_statsLock);
+            m_stats.cadenceOverrun.Add(lateMs);
+        }
+        m_cadenceNext = now;
+        restart = true;
+    }
+    else if (now < m_cadenceNext)
+    {
+        // sleep to the slot itself rather than for a rounded number of ms
+        unsigned int val = WaitEvent(m_cadenceNext, INT_ANY, false);
+        if (val)
+        {
+            m_cadenceNext = -1;
+            return val;
+        }
+        now = PerfTrace::Now();
+    }
+
+    if (!restart && m_cadenceLast >= 0)
+    {
+        wxCriticalSectionLocker lock(m_statsLock);
+        m_stats.cadenceJitter.Add(fabs((double) (now - m_cadenceLast - period)) / 1000.0);
+    }
+
+    m_cadenceLast = now;
+    m_cadenceNext += period;
+
+    return 0;
+}
+
+bool WorkerThread::HandleExpose(EXPOSE_REQUEST *req)
+{
+    PERF_STAGE(PERF_STAGE_EXPOSE);
+
+    bool bError = false;
+    int const options = req->options;
+
+    try
+    {
+        int const cadence = m_pFrame->GetCadence();
+
+        if (!cadence && WorkerThread::MilliSleep(m_pFrame->GetTimeLapse(), INT_ANY))
+        {
+            throw ERROR_INFO("Time lapse interrupted");
+        }
+
+        if (req->pMoveThread)
+        {
+            // do not start the exposure until the corrections scheduled before
+            // it have been applied
+            wxStopWatch swatch;
+            if (req->pMoveThread->WaitForMovesCompleted(req->moveBarrier))
+            {
+                throw ERROR_INFO("Wait for mount moves interrupted");
+            }
+            {
+                wxCriticalSectionLocker lock(m_statsLock);
+                m_stats.exposeHandoff.Add(swatch.Time());
+            }
+
+            if (req->settleMs && WorkerThread::MilliSleep(req->settleMs, INT_ANY))
+            {
+                throw ERROR_INFO("Settle wait interrupted");
+            }
+        }
+
+        // the corrections were sent before the wait, so they are normally
+        // complete by the time the slot comes round
+        if (cadence && WaitForCadence(cadence))
+        {
+            throw ERROR_INFO("Cadence wait interrupted");
+        }
+
+        long long const captureStart = PerfTrace::Now();
+
+        // A full frame is calibrated in a single pass after capture rather
+        // than dark subtracted by the camera and then filtered and measured
+        // separately. The defect learner samples the dark subtracted frame
+        // before it is filtered, so it keeps the separate passes.
+        bool fused = m_pFrame->GetFusedCalibration() && (options & CAPTURE_SUBTRACT_DARK) &&
+            !((options & CAPTURE_LAZY_ROI) && !req->subframe.IsEmpty()) && !DefectLearning.IsEnabled();
+        if (fused)
+            req->options &= ~CAPTURE_SUBTRACT_DARK;
+
+        if (pCamera->HasNonGuiCapture())
+        {
+            DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "Handling exposure in thread, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
+                      req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height);
+
+            if (GuideCamera::CaptureStreamFrame(pCamera, req->exposureDuration, *req->pImage, req->options, req->subframe))
+            {
+                throw ERROR_INFO("Capture failed");
+            }
+        }
+        else
+        {
+            DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "Handling exposure in myFrame, d=%d o=%x r=(%d,%d,%d,%d)\n", req->exposureDuration,
+                      req->options, req->subframe.x, req->subframe.y, req->subframe.width, req->subframe.height);
+
+            wxSemaphore semaphore;
+            req->pSemaphore = &semaphore;
+
+            wxCommandEvent evt(REQUEST_EXPOSURE_EVENT, GetId());
+            evt.SetClientData(req);
+            wxQueueEvent(m_pFrame, evt.Clone());
+
+            // wait for the request to complete
+            req->pSemaphore->Wait();
+
+            bError = req->error;
+            req->pSemaphore = NULL;
+        }
+
+        req->options = options;
+
+        DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "Exposure complete\n");
+
+        if (!bError)
+        {
+            usImage& img = *req->pImage;
+
+            bool const statsSubframe = (options & CAPTURE_STATS_SUBFRAME) && img.Subframe.IsEmpty() && !req->subframe.IsEmpty();
+
+            if (fused && !img.Subframe.IsEmpty())
+            {
+                // the camera read a subframe
+                pCamera->SubtractDark(img);
+                fused = false;
+            }
+            else if (fused && pCamera->CalibrateFrame(img, m_pFrame->GetNoiseReductionMethod(), !statsSubframe))
+                fused = false;
+
+            // a camera that read a subframe has nothing to defer
+            if (!img.Subframe.IsEmpty())
+                img.LazyROI = wxRect(0, 0, 0, 0);
+            else
+                img.LazyROI.Intersect(wxRect(img.Size));
+
+            // before noise reduction, which would hide the defects
+            if ((req->options & CAPTURE_LIGHT) == CAPTURE_LIGHT)
+                DefectLearning.ProcessFrame(img);
+
+            if (fused)
+            {
+                // the stats are only needed around the guide star
+                if (statsSubframe)
+                    img.CalcStats(req->subframe);
+            }
+            else if (!img.LazyROI.IsEmpty())
+            {
+                // lazy ROI: only the guide star region is filtered now, the
+                // rest of the frame waits for CompleteLazyROI
+                DEBUG_LOG(DBGLOG_WORKER, DBGLOG_VERBOSE, "Lazy ROI (%d,%d,%d,%d)\n", img.LazyROI.x, img.LazyROI.y, img.LazyROI.width, img.LazyROI.height);
+
+                ReduceNoise(img, img.LazyROI);
+                img.CalcStats(req->subframe);
+            }
+            else
+            {
+                switch (m_pFrame->GetNoiseReductionMethod())
+                {
+                    case NR_NONE:
+                        break;
+                    case NR_2x2MEAN:
+                        QuickLRecon(img);
+                        break;
+                    case NR_3x3MEDIAN:
+                        Median3(img);
+                        break;
+                }
+
+                if (statsSubframe)
+                {
+                    // the display estimates its own stretch levels, the stats are
+                    // only needed around the guide star
+                    img.CalcStats(req->subframe);
+                }
+                else
+                    img.CalcStats();
+            }
+
+            pCamera->CaptureComplete();
+
+            PerfStats::CaptureDone(captureStart, PerfTrace::Now(), req->exposureDuration);
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        req->options = options;
+        bError = true;
+    }
+
+    return  bError;
+}
+
+void WorkerThread::SendWorkerThreadExposeComplete(usImage *pImage, bool bError)
+{
+    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_EXPOSE_COMPLETE);
+    event->SetPayload<usImage *>(pImage);
+    event->SetInt(bError);
+    wxQueueEvent(m_pFrame, event);
+}
+
+/*************      Move       **************************/
+
+void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const PHD_Point& vectorEndpoint, MountMoveType moveType)
+{
+    m_interruptRequested &= ~INT_STOP;
+
+    MOVE_REQUEST req;
+
+    DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "Enqueuing Move request for %s (%.2f, %.2f)\n", mount->GetMountClassName(), vectorEndpoint.X, vectorEndpoint.Y);
+
+    req.pMount          = mount;
+    req.duration        = 0;
+    req.direction       = NONE;
+    req.calibrationMove = false;
+    req.vectorEndpoint  = vectorEndpoint;
+    req.moveType        = moveType;
+    req.moveResult      = Mount::MOVE_OK;
+    req.pSemaphore      = NULL;
+
+    ++m_movesEnqueued;
+    EnqueueRequest(m_moveRing, req);
+}
+
+void WorkerThread::EnqueueWorkerThreadMoveRequest(Mount *mount, const GUIDE_DIRECTION direction, int duration)
+{
+    m_interruptRequested &= ~INT_STOP;
+
+    MOVE_REQUEST req;
+
+    Debug.Write(wxString::Format("Enqueuing Calibration Move request for direction %d\n", direction));
+
+    req.pMount          = mount;
+    req.calibrationMove = true;
+    req.direction       = direction;
+    req.duration        = duration;
+    req.moveType        = MOVETYPE_DIRECT;
+    req.moveResult      = Mount::MOVE_OK;
+    req.pSemaphore      = NULL;
+
+    ++m_movesEnqueued;
+    EnqueueRequest(m_moveRing, req);
+}
+
+unsigned int WorkerThread::WaitForMovesCompleted(unsigned int barrier, unsigned int checkInterrupts)
+{
+    enum { POLL_INTERVAL_MS = 100 };
+
+    wxMutexLocker lock(m_moveMutex);
+
+    // the counters wrap, so compare the difference
+    while ((int)(m_movesCompleted - barrier) < 0)
+    {
+        m_moveCond.WaitTimeout(POLL_INTERVAL_MS);
+        unsigned int val = WorkerThread::InterruptRequested() & checkInterrupts;
+        if (val)
+            return val;
+    }
+
+    return 0;
+}
+
+Mount::MOVE_RESULT WorkerThread::HandleMove(MOVE_REQUEST *pArgs)
+{
+    Mount::MOVE_RESULT result = Mount::MOVE_OK;
+
+    try
+    {
+        if (pArgs->pMount->HasNonGuiMove())
+        {
+            Debug.Write(wxString::Format("Handling move in thread for %s dir=%d\n",
+                    pArgs->pMount->GetMountClassName(),
+                    pArgs->direction));
+
+            if (pArgs->calibrationMove)
+            {
+                Debug.Write("calibration move\n");
+
+                result = pArgs->pMount->CalibrationMove(pArgs->direction, pArgs->duration);
+                if (result != Mount::MOVE_OK)
+                {
+                    throw ERROR_INFO("CalibrationMove failed");
+                }
+            }
+            else
+            {
+                Debug.Write(wxString::Format("endpoint = (%.2f, %.2f)\n",
+                    pArgs->vectorEndpoint.X, pArgs->vectorEndpoint.Y));
+
+                result = pArgs->pMount->Move(pArgs->vectorEndpoint, pArgs->moveType);
+                if (result != Mount::MOVE_OK)
+                {
+                    throw ERROR_INFO("Move failed");
+                }
+            }
+        }
+        else
+        {
+            // we don't have a non-gui guide function, so we send this to the
+            // main frame routine that handles guides requests
+
+            Debug.Write("Sending move to myFrame\n");
+
+            wxSemaphore semaphore;
+            pArgs->pSemaphore = &semaphore;
+
+            wxCommandEvent evt(REQUEST_MOUNT_MOVE_EVENT, GetId());
+            evt.SetClientData(pArgs);
+            wxQueueEvent(m_pFrame, evt.Clone());
+
+            // wait for the request to complete
+            pArgs->pSemaphore->Wait();
+
+            pArgs->pSemaphore = NULL;
+            result = pArgs->moveResult;
+
+            if (result != Mount::MOVE_OK)
+            {
+                throw ERROR_INFO("myFrame handled move failed");
+            }
+        }
+    }
+    catch (const wxString& Msg)
+    {
+        POSSIBLY_UNUSED(Msg);
+        if (result == Mount::MOVE_OK)
+            result = Mount::MOVE_ERROR;
+    }
+
+    Debug.Write(wxString::Format("move complete, result=%d\n", result));
+
+    return result;
+}
+
+void WorkerThread::SendWorkerThreadMoveComplete(Mount *mount, Mount::MOVE_RESULT moveResult)
+{
+    wxThreadEvent *event = new wxThreadEvent(wxEVT_THREAD, MYFRAME_WORKER_THREAD_MOVE_COMPLETE);
+    event->SetInt(moveResult);
+    event->SetPayload<Mount *>(mount);
+    wxQueueEvent(m_pFrame, event);
+}
+
+/*
+ * entry point for the background thread
+ */
+wxThread::ExitCode WorkerThread::Entry()
+{
+    bool bDone = TestDestroy();
+
+    PerfTrace::SetThreadName(m_name);
+    ThreadPriorityScope priority(THREAD_CLASS_GUIDE, m_name);
+    Debug.Write(wxString::Format("WorkerThread::Entry() begins (%s)\n", m_name));
+
+#if defined(__WINDOWS__)
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    Debug.Write(wxString::Format("worker thread CoInitializeEx returns %x\n", hr));
+#endif
+
+    while (!bDone)
+    {
+        wxSemaError semaError = m_requestSem.Wait();
+
+        DEBUG_LOG(DBGLOG_WORKER, DBGLOG_VERBOSE, "Worker thread wakes up\n");
+
+        assert(semaError == wxSEMA_NO_ERROR);
+        POSSIBLY_UNUSED(semaError);
+
+        MOVE_ENTRY move;
+        CONTROL_ENTRY control;
+        EXPOSE_ENTRY expose;
+
+        if (m_moveRing.Pop(&move))
+        {
+            double queueMs = (double) (PerfTrace::Now() - move.enqueueTime) / 1000.0;
+            wxStopWatch serviceTime;
+
+            DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "worker thread servicing REQUEST_MOVE %s dir %d (%.2f, %.2f)\n",
+                move.args.pMount->GetMountClassName(), move.args.direction,
+                move.args.vectorEndpoint.X, move.args.vectorEndpoint.Y);
+            Mount::MOVE_RESULT moveResult = HandleMove(&move.args);
+            {
+                wxCriticalSectionLocker lock(m_statsLock);
+                m_stats.moveQueue.Add(queueMs);
+                m_stats.moveService.Add(serviceTime.Time());
+            }
+            {
+                wxMutexLocker lock(m_moveMutex);
+                ++m_movesCompleted;
+                m_moveCond.Broadcast();
+            }
+            SendWorkerThreadMoveComplete(move.args.pMount, moveResult);
+        }
+        else if (m_controlRing.Pop(&control))
+        {
+            switch (control.args)
+            {
+                case CONTROL_TERMINATE:
+                    Debug.Write("worker thread servicing REQUEST_TERMINATE\n");
+                    if (pCamera)
+                        pCamera->StopStream();
+                    bDone = true;
+                    break;
+                case CONTROL_STOP_STREAM:
+                    Debug.Write("worker thread servicing REQUEST_STOP_STREAM\n");
+                    if (pCamera)
+                        pCamera->StopStream();
+                    break;
+            }
+        }
+        else if (m_exposeRing.Pop(&expose))
+        {
+            double queueMs = (double) (PerfTrace::Now() - expose.enqueueTime) / 1000.0;
+            wxStopWatch serviceTime;
+
+            DEBUG_LOG(DBGLOG_WORKER, DBGLOG_INFO, "worker thread servicing REQUEST_EXPOSE %d\n",
+                expose.args.exposureDuration);
+            bool bError = HandleExpose(&expose.args);
+            {
+                wxCriticalSectionLocker lock(m_statsLock);
+                m_stats.exposeQueue.Add(queueMs);
+                m_stats.exposeService.Add(serviceTime.Time());
+            }
+            if (m_skipSendExposeComplete)
+            {
+                Debug.Write("worker thread skipping SendWorkerThreadExposeComplete\n");
+                delete expose.args.pImage; // should be null though
+                expose.args.pImage = 0;
+                m_skipSendExposeComplete = false;
+            }
+            else
+                SendWorkerThreadExposeComplete(expose.args.pImage, bError);
+        }
+        else
+        {
+            // every post of the semaphore follows a push
+            assert(false);
+        }
+
+        DEBUG_LOG(DBGLOG_WORKER, DBGLOG_VERBOSE, "worker thread done servicing request\n");
+        bDone |= TestDestroy();
+    }
+
+    Debug.Write("WorkerThread::Entry() ends\n");
+    Debug.Flush();
+
+    return (wxThread::ExitCode)0;
+}
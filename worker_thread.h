@@ -37,25 +37,36 @@
 #define WORKER_THREAD_H_INCLUDED
 
 class MyFrame;
+class WorkerThread;
 
 /*
- * There are two worker threads in PHD.  The primary thread handles all exposure requests,
- * and move requests for the first mount.  The secondary thread handles move requests for the
+ * There are three worker threads in PHD.  The primary (capture) thread handles all exposure
+ * requests, and move requests for mounts that must be serialized with the camera
+ * (Mount::SynchronousOnly()).  The mount thread handles all other move requests for the
+ * first mount, so that a slow pulse guide call does not hold up the camera and a slow
+ * readout does not hold up a correction.  The secondary thread handles move requests for the
  * second mount, so that on systems with two mounts (probably an AO and a telescope), the
  * second mount can be moving while we image and guide with the first mount.
  *
- * The worker threads have three queues, one for move requests (higher priority)
- * and one for exposure requests (lower priority) and one "wakeup queue". The wx queue
- * routines do not have a way to wait on multiple queues, so there is no easy way
- * to implement the dual queue priority model without a third queue.
+ * The handoff between the mount thread and the capture thread is an expose request
+ * barrier: each expose request records how many moves had been queued on the mount thread
+ * when it was scheduled, and the capture thread waits for those moves to complete before
+ * starting the exposure.  The correction computed from one frame has therefore finished
+ * before the next exposure starts, unless pipelined capture started that exposure early.
  *
- * When something is enqueued on either of the work queues, a dummy message is
- * also enqueued on the wakeup queue, which wakes the thread up.  It then finds
- * the work item by looking first on the high priority queue and then the low
- * priority queue.
+ * Each worker thread has a typed request ring per kind of request: move requests
+ * (highest priority), control requests (terminate) and exposure requests (lowest
+ * priority).  The rings are fixed-size single-producer single-consumer rings, so
+ * enqueueing a request neither locks nor allocates; the requests are only ever
+ * enqueued by MyFrame under m_CSpWorkerThread, which makes them single-producer.
+ * Every request enqueued also posts a semaphore that the thread waits on when it
+ * is idle; for each post it takes one request, from the highest priority ring
+ * that has one.
  *
  */
 
+#include <atomic>
+
 struct EXPOSE_REQUEST
 {
     usImage         *pImage;
@@ -64,6 +75,9 @@ struct EXPOSE_REQUEST
     wxRect           subframe;
     bool             error;
     wxSemaphore     *pSemaphore;
+    WorkerThread    *pMoveThread;   // wait for moves queued on this thread before exposing
+    unsigned int     moveBarrier;
+    int              settleMs;      // then wait this long for the mount to settle
 };
 
 struct MOVE_REQUEST
@@ -78,39 +92,122 @@ struct MOVE_REQUEST
     wxSemaphore       *pSemaphore;
 };
 
+struct WorkerThreadLatency
+{
+    unsigned int count;
+    double       lastMs;
+    double       maxMs;
+    double       totalMs;
+
+    WorkerThreadLatency() { Reset(); }
+    void Reset() { count = 0; lastMs = maxMs = totalMs = 0.0; }
+    void Add(double ms)
+    {
+        ++count;
+        lastMs = ms;
+        if (ms > maxMs)
+            maxMs = ms;
+        totalMs += ms;
+    }
+    double MeanMs() const { return count ? totalMs / count : 0.0; }
+};
+
+struct WorkerThreadStats
+{
+    WorkerThreadLatency exposeQueue;    // expose request enqueued -> serviced
+    WorkerThreadLatency exposeHandoff;  // waiting for outstanding mount moves
+    WorkerThreadLatency exposeService;  // capture and image processing, including the handoff
+    WorkerThreadLatency moveQueue;      // move request enqueued -> serviced
+    WorkerThreadLatency moveService;    // mount move
+    WorkerThreadLatency cadenceJitter;  // |interval between exposure starts - cadence|, on schedule
+    WorkerThreadLatency cadenceOverrun; // how late the exposures that missed their start were
+};
+
+// Fixed-capacity ring with one producer and one consumer. Each index is only
+// written by one side, the release store publishing the slot to the other.
+template<typename T, unsigned int N>
+class RequestRing
+{
+    T m_slots[N];
+    std::atomic<unsigned int> m_head;   // next slot to read, written by the consumer
+    std::atomic<unsigned int> m_tail;   // next slot to write, written by the producer
+
+public:
+    RequestRing() : m_head(0), m_tail(0) { }
+
+    // returns false if the ring is full
+    bool Push(const T& item)
+    {
+        unsigned int const tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+            return false;
+        m_slots[tail % N] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the ring is empty
+    bool Pop(T *item)
+    {
+        unsigned int const head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        *item = m_slots[head % N];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
 class WorkerThread : public wxThread
 {
-    // types and routines for the server->worker message queue
-    enum WORKER_REQUEST_TYPE
+    // types and routines for the server->worker request rings
+    enum WORKER_CONTROL_TYPE
     {
-        REQUEST_NONE,       // not used
-        REQUEST_TERMINATE,
-        REQUEST_EXPOSE,
-        REQUEST_MOVE,
+        CONTROL_TERMINATE,
+        CONTROL_STOP_STREAM,
     };
 
-    /*
-    * this struct is passed through the message queue to the worker thread
-    * to request work
-    */
-    struct WORKER_THREAD_REQUEST
+    template<typename T>
+    struct QUEUED_REQUEST
     {
-        WORKER_REQUEST_TYPE request;
-        struct // we'd prefer a union, but the request types are not POD
-        {
-            EXPOSE_REQUEST expose;
-            MOVE_REQUEST move;
-        } args;
+        T args;
+        long long enqueueTime;  // PerfTrace::Now()
     };
 
+    typedef QUEUED_REQUEST<EXPOSE_REQUEST> EXPOSE_ENTRY;
+    typedef QUEUED_REQUEST<MOVE_REQUEST> MOVE_ENTRY;
+    typedef QUEUED_REQUEST<WORKER_CONTROL_TYPE> CONTROL_ENTRY;
+
+    // there is at most one exposure outstanding, and a mount at most two
+    // moves (see Mount::IncrementRequestCount); a full ring makes the
+    // producer wait
+    enum { EXPOSE_RING_SIZE = 8, MOVE_RING_SIZE = 16, CONTROL_RING_SIZE = 4 };
+
     MyFrame *m_pFrame;
+    const char *m_name;
+    wxMutex m_wakeMutex;
+    wxCondition m_wakeCond;         // signaled by interrupt requests and by Wake()
+    bool m_wakePending;             // protected by m_wakeMutex
     volatile unsigned int m_interruptRequested;
     volatile bool m_killable;
-    wxMessageQueue<bool> m_wakeupQueue;
-    wxMessageQueue<WORKER_THREAD_REQUEST> m_highPriorityQueue;
-    wxMessageQueue<WORKER_THREAD_REQUEST> m_lowPriorityQueue;
+    wxSemaphore m_requestSem;       // posted once per request enqueued
+    RequestRing<MOVE_ENTRY, MOVE_RING_SIZE> m_moveRing;
+    RequestRing<CONTROL_ENTRY, CONTROL_RING_SIZE> m_controlRing;
+    RequestRing<EXPOSE_ENTRY, EXPOSE_RING_SIZE> m_exposeRing;
     bool m_skipSendExposeComplete;
 
+    wxMutex m_moveMutex;
+    wxCondition m_moveCond;
+    unsigned int m_movesEnqueued;   // only updated under MyFrame::m_CSpWorkerThread
+    unsigned int m_movesCompleted;  // protected by m_moveMutex
+
+    wxCriticalSection m_statsLock;
+    WorkerThreadStats m_stats;
+
+    // fixed cadence schedule, PerfTrace::Now() microseconds, -1 when not running
+    long long m_cadenceNext;
+    long long m_cadenceLast;
+
 public:
 
     enum InterruptBits {
@@ -123,11 +220,15 @@ public:
         INT_ANY = (INT_STOP | INT_TERMINATE),
     };
 
-    WorkerThread(MyFrame *pFrame);
+    WorkerThread(MyFrame *pFrame, const char *name);
     ~WorkerThread(void);
 
     static WorkerThread *This(void);
 
+    WorkerThreadStats GetStats(void);
+    void ResetStats(void);
+    void LogStats(const wxString& name);
+
 private:
     wxThread::ExitCode Entry();
 
@@ -159,10 +260,19 @@ public:
     static unsigned int TerminateRequested(void);
     static unsigned int MilliSleep(int ms, unsigned int checkInterrupts = INT_TERMINATE);
 
+    // Wake the thread from WaitForWake, from any thread. A wake with nobody
+    // waiting is remembered until the next WaitForWake or ClearWake.
+    void Wake(void);
+    void ClearWake(void);
+    static unsigned int WaitForWake(int ms, unsigned int checkInterrupts = INT_ANY);
+
     bool IsKillable() const;
     bool SetKillable(bool killable);
 
 protected:
+    void RequestInterrupt(unsigned int interrupts);
+    unsigned int WaitEvent(long long deadline, unsigned int checkInterrupts, bool wake);
+
     // there is no struct ARGS_TERMINATE
     // there is no HandleTerminate(ARGS_TERMINATE *pArgs) routine
     // there is no HandleTerminate(ARGS_TERMINATE *pArgs) routine
@@ -171,10 +281,16 @@ protected:
 
     /*************      Expose      **************************/
 public:
-    void EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe);
+    void EnqueueWorkerThreadExposeRequest(usImage *pImage, int exposureDuration, int exposureOptions, const wxRect& subframe,
+        WorkerThread *moveThread = NULL, int settleMs = 0);
     void SetSkipExposeComplete();
+    // the exposures are frames of a camera stream that runs from the first
+    // exposure until this request, made when looping stops
+    void EnqueueWorkerThreadStopStreamRequest(void);
+    static void CompleteLazyROI(usImage& img);
 protected:
     bool HandleExpose(EXPOSE_REQUEST *pArgs);
+    unsigned int WaitForCadence(int cadence);
     void SendWorkerThreadExposeComplete(usImage *pImage, bool bError);
     // in the frame class: void MyFrame::OnWorkerThreadExposeComplete(wxThreadEvent& event);
 
@@ -182,22 +298,32 @@ protected:
 public:
     void EnqueueWorkerThreadMoveRequest(Mount *pMount, const PHD_Point& vectorEndpoint, MountMoveType moveType);
     void EnqueueWorkerThreadMoveRequest(Mount *pMount, const GUIDE_DIRECTION direction, int duration);
+    unsigned int MovesEnqueued(void) const;
+    unsigned int WaitForMovesCompleted(unsigned int barrier, unsigned int checkInterrupts = INT_ANY);
 protected:
     Mount::MOVE_RESULT HandleMove(MOVE_REQUEST *pArgs);
     void SendWorkerThreadMoveComplete(Mount *pMount, Mount::MOVE_RESULT moveResult);
     // in the frame class: void MyFrame::OnWorkerThreadGuideComplete(wxThreadEvent& event);
 
-    void EnqueueMessage(const WORKER_THREAD_REQUEST& message);
+    template<typename T, unsigned int N>
+    void EnqueueRequest(RequestRing<QUEUED_REQUEST<T>, N>& ring, const T& args);
 };
 
 inline void WorkerThread::RequestStop(void)
 {
-    m_interruptRequested |= INT_STOP;
+    RequestInterrupt(INT_STOP);
+}
+
+inline unsigned int WorkerThread::MovesEnqueued(void) const
+{
+    return m_movesEnqueued;
 }
 
 inline WorkerThread *WorkerThread::This(void)
 {
-    return static_cast<WorkerThread *>(wxThread::This());
+    // other threads (image strip threads, the dark builder) may call into code
+    // that checks for interrupts
+    return dynamic_cast<WorkerThread *>(wxThread::This());
 }
 
 inline unsigned int WorkerThread::InterruptRequested(void)
@@ -253,7 +379,16 @@ public:
     bool Expired(void) const { return Time() > m_timeout_ms; }
 };
 
-typedef Watchdog CameraWatchdog;
+// also expires as soon as the capture watchdog finds the camera's capture
+// overdue, see GuideCamera::CaptureOverdue
+class CameraWatchdog : public Watchdog
+{
+public:
+    CameraWatchdog(unsigned int timeout_ms, unsigned int grace_period_ms) : Watchdog(timeout_ms, grace_period_ms)
+        { }
+    bool Expired(void) const;
+};
+
 typedef Watchdog MountWatchdog;
 
 #endif /* WORKER_THREAD_H_INCLUDED */